@@ -30,27 +30,99 @@
  */
 
 #include "bgpstream_int.h"
+#include "bgpstream_dedup.h"
 #include "bgpstream_di_mgr.h"
 #include "bgpstream_log.h"
+#include "bgpstream_mem.h"
+#include "bgpstream_perf.h"
 #include "utils.h"
 #include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* first line of checkpoint files (see bgpstream_save_checkpoint) */
+#define CHECKPOINT_HEADER "# bgpstream checkpoint v1"
+#define CHECKPOINT_TEMP_SUFFIX ".temp"
+#define CHECKPOINT_LINE_LEN 1024
+
+/* suffix of the file that bgpstream_write_metrics writes before renaming it */
+#define METRICS_TEMP_SUFFIX ".temp"
+
+/* label values of the indexed statistics (see bgpstream_write_metrics) */
+static const char *metrics_stage_names[] = {
+  "broker", "open",  "open_wait", "read", "decompress",
+  "decode", "elems", "merge",     "wait",
+};
+
+static const char *metrics_transport_names[] = {
+  "file", "kafka", "cache", "http", "websocket", "shmring",
+};
+
+static const char *metrics_filter_names[] = {
+  "elem_type", "ipversion", "peer_asn",  "not_peer_asn",
+  "origin_asn", "prefix",   "community", "aspath",       "sample",
+};
 
 struct bgpstream {
 
   /* filter manager instance */
   bgpstream_filter_mgr_t *filter_mgr;
 
+  /* filter manager the data interfaces were created with. they keep using it
+   * once the filters have been reloaded, so it lives as long as the stream */
+  bgpstream_filter_mgr_t *di_filter_mgr;
+
+  /* filters being built by bgpstream_begin_filter_reload (NULL if none) */
+  bgpstream_filter_mgr_t *reload_filter_mgr;
+
+  /* elem fields that every filter manager used so far looks at, and so that
+   * every open reader decodes */
+  uint8_t reload_fields;
+
   /* data interface manager */
   bgpstream_di_mgr_t *di_mgr;
 
+  /* bytes of filters accounted in the memory stats of the stream */
+  size_t filters_mem;
+
+  /* drops duplicate elems (NULL unless bgpstream_set_dedup was called) */
+  bgpstream_dedup_t *dedup;
+
   /* set to 1 once BGPStream has been started */
   int started;
 };
 
 /* ========== INTERNAL METHODS (see bgpstream_int.h) ========== */
 
+/* bring the memory stats up to date with the filters now in use */
+static void account_filters(bgpstream_t *bs)
+{
+  size_t size = bgpstream_filter_mgr_get_mem_size(bs->filter_mgr);
+
+  if (bs->filter_mgr != bs->di_filter_mgr) {
+    size += bgpstream_filter_mgr_get_mem_size(bs->di_filter_mgr);
+  }
+  bgpstream_mem_add(bgpstream_di_mgr_get_mem(bs->di_mgr),
+                    BGPSTREAM_MEM_FILTERS,
+                    (int64_t)size - (int64_t)bs->filters_mem);
+  bs->filters_mem = size;
+}
+
+/* the filter manager that filters are added to: the one being built by a
+ * reload, or the one the stream will start with */
+static bgpstream_filter_mgr_t *added_filters(bgpstream_t *bs)
+{
+  if (bs->reload_filter_mgr != NULL) {
+    return bs->reload_filter_mgr;
+  }
+  assert(!bs->started);
+  return bs->filter_mgr;
+}
+
 /* ========== PUBLIC METHODS (see bgpstream_int.h) ========== */
 
 bgpstream_t *bgpstream_create()
@@ -64,6 +136,7 @@ bgpstream_t *bgpstream_create()
   if ((bs->filter_mgr = bgpstream_filter_mgr_create()) == NULL) {
     goto err;
   }
+  bs->di_filter_mgr = bs->filter_mgr;
 
   if ((bs->di_mgr = bgpstream_di_mgr_create(bs->filter_mgr)) == NULL) {
     goto err;
@@ -76,19 +149,263 @@ err:
   return NULL;
 }
 
+bgpstream_t *bgpstream_create_with_context(bgpstream_context_t *ctx)
+{
+  bgpstream_t *bs;
+
+  if ((bs = bgpstream_create()) == NULL) {
+    return NULL;
+  }
+  if (bgpstream_di_mgr_set_context(bs->di_mgr, ctx) != 0) {
+    bgpstream_destroy(bs);
+    return NULL;
+  }
+  return bs;
+}
+
 /* configure filters in order to select a subset of the bgp data available */
 int bgpstream_add_filter(bgpstream_t *bs, bgpstream_filter_type_t filter_type,
                           const char *filter_value)
 {
-  return bgpstream_filter_mgr_filter_add(bs->filter_mgr, filter_type,
+  return bgpstream_filter_mgr_filter_add(added_filters(bs), filter_type,
       filter_value);
 }
 
+int bgpstream_add_filter_file(bgpstream_t *bs,
+                              bgpstream_filter_type_t filter_type,
+                              const char *path)
+{
+  return bgpstream_filter_mgr_filter_add_file(added_filters(bs), filter_type,
+                                              path);
+}
+
+int bgpstream_add_filter_set(bgpstream_t *bs, const char *name)
+{
+  return bgpstream_filter_mgr_set_add(added_filters(bs), name);
+}
+
+int bgpstream_add_set_filter(bgpstream_t *bs, int set,
+                             bgpstream_filter_type_t filter_type,
+                             const char *filter_value)
+{
+  return bgpstream_filter_mgr_set_filter_add(added_filters(bs), set,
+                                             filter_type, filter_value);
+}
+
+int bgpstream_add_set_filter_file(bgpstream_t *bs, int set,
+                                  bgpstream_filter_type_t filter_type,
+                                  const char *path)
+{
+  return bgpstream_filter_mgr_set_filter_add_file(added_filters(bs), set,
+                                                  filter_type, path);
+}
+
+const char *bgpstream_get_filter_set_name(bgpstream_t *bs, int set)
+{
+  if (set < 0 || set >= bs->filter_mgr->sets_cnt) {
+    return NULL;
+  }
+  return bs->filter_mgr->set_names[set];
+}
+
+int bgpstream_begin_filter_reload(bgpstream_t *bs)
+{
+  assert(bs->started && bs->reload_filter_mgr == NULL);
+  if ((bs->reload_filter_mgr = bgpstream_filter_mgr_create_like(
+         bs->filter_mgr)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create reloaded filters");
+    return -1;
+  }
+  return 0;
+}
+
+int bgpstream_commit_filter_reload(bgpstream_t *bs)
+{
+  bgpstream_filter_mgr_t *mgr = bs->reload_filter_mgr;
+  bgpstream_filter_mgr_t *old = bs->filter_mgr;
+  uint8_t fields;
+
+  assert(mgr != NULL);
+  bs->reload_filter_mgr = NULL;
+
+  // open readers only decode the unused fields that their filters needed
+  fields = bgpstream_filter_mgr_elem_fields(mgr);
+  if ((fields & mgr->unused_elem_fields & ~bs->reload_fields) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Reloaded filters look at elem fields that are not decoded");
+    goto err;
+  }
+  if (bgpstream_filter_mgr_validate(mgr) != 0) {
+    goto err;
+  }
+  bgpstream_filter_mgr_compile(mgr);
+
+  // the RIB period may have been changed since the reload began, and its
+  // state goes along with it
+  mgr->rib_period = old->rib_period;
+  mgr->last_processed_ts = old->last_processed_ts;
+  old->last_processed_ts = NULL;
+
+  // as do the totals of the filter statistics (see bgpstream_get_perf_stats)
+  mgr->elem_prog.elems = old->elem_prog.elems;
+  mgr->elem_prog.type_rejects = old->elem_prog.type_rejects;
+  memcpy(mgr->elem_prog.op_runs, old->elem_prog.op_runs,
+         sizeof(mgr->elem_prog.op_runs));
+  memcpy(mgr->elem_prog.op_rejects, old->elem_prog.op_rejects,
+         sizeof(mgr->elem_prog.op_rejects));
+
+  // once the readers have switched, nothing but the data interfaces can be
+  // using the old filters
+  bgpstream_di_mgr_set_filter_mgr(bs->di_mgr, mgr);
+  bs->filter_mgr = mgr;
+  bs->reload_fields &= fields;
+  if (old != bs->di_filter_mgr) {
+    bgpstream_filter_mgr_destroy(old);
+  }
+  account_filters(bs);
+  return 0;
+
+err:
+  bgpstream_filter_mgr_destroy(mgr);
+  return -1;
+}
+
+void bgpstream_abort_filter_reload(bgpstream_t *bs)
+{
+  bgpstream_filter_mgr_destroy(bs->reload_filter_mgr);
+  bs->reload_filter_mgr = NULL;
+}
+
 int bgpstream_add_rib_period_filter(bgpstream_t *bs, uint32_t period)
 {
   return bgpstream_filter_mgr_rib_period_filter_add(bs->filter_mgr, period);
 }
 
+int bgpstream_save_checkpoint(bgpstream_t *bs, const char *filename,
+                              uint32_t time)
+{
+  collector_ts_t *ts = bs->filter_mgr->last_processed_ts;
+  char *temp_path;
+  size_t len;
+  khiter_t k;
+  FILE *f;
+  int rc;
+
+  len = strlen(filename) + sizeof(CHECKPOINT_TEMP_SUFFIX);
+  if ((temp_path = malloc(len)) == NULL) {
+    return -1;
+  }
+  snprintf(temp_path, len, "%s%s", filename, CHECKPOINT_TEMP_SUFFIX);
+  if ((f = fopen(temp_path, "w")) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create checkpoint %s: %s",
+                  temp_path, strerror(errno));
+    free(temp_path);
+    return -1;
+  }
+
+  rc = fprintf(f, "%s\ntime %" PRIu32 "\n", CHECKPOINT_HEADER, time) < 0;
+  if (ts != NULL) {
+    for (k = kh_begin(ts); k != kh_end(ts) && rc == 0; ++k) {
+      if (kh_exist(ts, k)) {
+        rc = fprintf(f, "rib %s %" PRIu32 "\n", kh_key(ts, k),
+                     kh_val(ts, k)) < 0;
+      }
+    }
+  }
+  if (fclose(f) != 0 || rc != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not write checkpoint %s: %s",
+                  temp_path, strerror(errno));
+    goto err;
+  }
+  if (rename(temp_path, filename) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not rename %s: %s", temp_path,
+                  strerror(errno));
+    goto err;
+  }
+  free(temp_path);
+  return 0;
+
+err:
+  unlink(temp_path);
+  free(temp_path);
+  return -1;
+}
+
+int bgpstream_load_checkpoint(bgpstream_t *bs, const char *filename,
+                              uint32_t *time)
+{
+  collector_ts_t *ts = bs->filter_mgr->last_processed_ts;
+  char line[CHECKPOINT_LINE_LEN];
+  char name[CHECKPOINT_LINE_LEN];
+  uint32_t value;
+  int have_time = 0;
+  khiter_t k;
+  char *key;
+  FILE *f;
+  int khret;
+
+  assert(!bs->started);
+  if ((f = fopen(filename, "r")) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open checkpoint %s: %s",
+                  filename, strerror(errno));
+    return -1;
+  }
+  if (fgets(line, sizeof(line), f) == NULL ||
+      strncmp(line, CHECKPOINT_HEADER, strlen(CHECKPOINT_HEADER)) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "%s is not a checkpoint", filename);
+    goto err;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "time %" SCNu32, time) == 1) {
+      have_time = 1;
+    } else if (sscanf(line, "rib %s %" SCNu32, name, &value) == 2) {
+      if (ts == NULL) {
+        // no RIB period filter, so no state to restore
+        continue;
+      }
+      if ((k = kh_get(collector_ts, ts, name)) == kh_end(ts)) {
+        if ((key = strdup(name)) == NULL) {
+          goto err;
+        }
+        k = kh_put(collector_ts, ts, key, &khret);
+        if (khret < 0) {
+          free(key);
+          goto err;
+        }
+      }
+      kh_val(ts, k) = value;
+    } else {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid checkpoint line in %s: %s",
+                    filename, line);
+      goto err;
+    }
+  }
+  if (!have_time) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Checkpoint %s has no time", filename);
+    goto err;
+  }
+  fclose(f);
+  return 0;
+
+err:
+  fclose(f);
+  return -1;
+}
+
+int bgpstream_add_shard_filter(bgpstream_t *bs, uint32_t shard,
+                               uint32_t shard_cnt, uint32_t span)
+{
+  return bgpstream_filter_mgr_shard_filter_add(bs->filter_mgr, shard,
+                                               shard_cnt, span);
+}
+
+int bgpstream_add_sample_filter(bgpstream_t *bs, bgpstream_sample_key_t key,
+                                uint32_t slice, uint32_t slice_cnt)
+{
+  return bgpstream_filter_mgr_sample_filter_add(added_filters(bs), key, slice,
+                                                slice_cnt);
+}
+
 int bgpstream_add_recent_interval_filter(bgpstream_t *bs, const char *interval,
                                          int islive)
 {
@@ -202,6 +519,367 @@ void bgpstream_set_live_mode(bgpstream_t *bs)
   bgpstream_di_mgr_set_blocking(bs->di_mgr);
 }
 
+int bgpstream_set_reader_readahead(bgpstream_t *bs, int depth)
+{
+  assert(!bs->started);
+  if (depth < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid read-ahead depth: %d", depth);
+    return -1;
+  }
+  bgpstream_di_mgr_set_reader_readahead(bs->di_mgr, depth);
+  return 0;
+}
+
+int bgpstream_set_max_open_resources(bgpstream_t *bs, int max_open)
+{
+  assert(!bs->started);
+  if (bgpstream_di_mgr_set_max_open(bs->di_mgr, max_open) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid open resource limit %d",
+                  max_open);
+    return -1;
+  }
+  return 0;
+}
+
+void bgpstream_set_mem_limit(bgpstream_t *bs, uint64_t limit)
+{
+  assert(!bs->started);
+  bgpstream_mem_set_limit(bgpstream_di_mgr_get_mem(bs->di_mgr), limit);
+}
+
+void bgpstream_get_mem_stats(bgpstream_t *bs, bgpstream_mem_stats_t *stats)
+{
+  bgpstream_mem_get_stats(bgpstream_di_mgr_get_mem(bs->di_mgr), stats);
+}
+
+int bgpstream_set_dedup(bgpstream_t *bs, uint32_t window,
+                        uint32_t max_entries)
+{
+  bgpstream_mem_t *mem = bgpstream_di_mgr_get_mem(bs->di_mgr);
+
+  assert(!bs->started);
+  if (max_entries == 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid deduplication table size: 0");
+    return -1;
+  }
+  if (bs->dedup != NULL) {
+    bgpstream_mem_add(mem, BGPSTREAM_MEM_DEDUP,
+                      -(int64_t)bgpstream_dedup_get_mem_size(bs->dedup));
+    bgpstream_dedup_destroy(bs->dedup);
+    bs->filter_mgr->dedup = NULL;
+  }
+  if ((bs->dedup = bgpstream_dedup_create(window, max_entries)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Could not create the deduplication table");
+    return -1;
+  }
+  bgpstream_mem_add(mem, BGPSTREAM_MEM_DEDUP,
+                    bgpstream_dedup_get_mem_size(bs->dedup));
+  bs->filter_mgr->dedup = bs->dedup;
+  return 0;
+}
+
+void bgpstream_set_perf_timing(bgpstream_t *bs)
+{
+  assert(!bs->started);
+  bgpstream_perf_set_timing(bgpstream_di_mgr_get_perf(bs->di_mgr));
+}
+
+void bgpstream_get_perf_stats(bgpstream_t *bs, bgpstream_perf_stats_t *stats)
+{
+  bgpstream_perf_get_stats(bgpstream_di_mgr_get_perf(bs->di_mgr), stats);
+  bgpstream_filter_mgr_get_perf_stats(bs->filter_mgr, stats);
+  if (bs->dedup != NULL) {
+    bgpstream_dedup_get_stats(bs->dedup, stats);
+  } else {
+    stats->elems_duplicate = stats->dedup_evictions = 0;
+  }
+  stats->open_resources = bgpstream_di_mgr_get_open_cnt(bs->di_mgr);
+}
+
+int bgpstream_get_collector_stats(bgpstream_t *bs,
+                                  bgpstream_collector_stats_t *stats, int len)
+{
+  return bgpstream_perf_get_collector_stats(
+    bgpstream_di_mgr_get_perf(bs->di_mgr), stats, len);
+}
+
+/* write a label value, escaped as the exposition format needs */
+static void metrics_print_label(FILE *f, const char *value)
+{
+  for (; *value != '\0'; value++) {
+    if (*value == '\\' || *value == '"') {
+      fputc('\\', f);
+      fputc(*value, f);
+    } else if (*value == '\n') {
+      fputs("\\n", f);
+    } else {
+      fputc(*value, f);
+    }
+  }
+}
+
+static void metrics_print_header(FILE *f, const char *name, const char *type,
+                                 const char *help)
+{
+  fprintf(f, "# HELP bgpstream_%s %s\n# TYPE bgpstream_%s %s\n", name, help,
+          name, type);
+}
+
+static void metrics_print_indexed(FILE *f, const char *name, const char *label,
+                                  const char **values, const uint64_t *counts,
+                                  int cnt, double scale)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++) {
+    fprintf(f, "bgpstream_%s{%s=\"%s\"} %.9g\n", name, label, values[i],
+            counts[i] * scale);
+  }
+}
+
+static int metrics_write(bgpstream_t *bs, FILE *f)
+{
+  bgpstream_perf_stats_t perf;
+  bgpstream_mem_stats_t mem;
+  bgpstream_collector_stats_t *colls = NULL;
+  uint32_t now = epoch_sec();
+  int i, cnt;
+
+  bgpstream_get_perf_stats(bs, &perf);
+  bgpstream_get_mem_stats(bs, &mem);
+  cnt = bgpstream_get_collector_stats(bs, NULL, 0);
+  if (cnt > 0 && ((colls = malloc(sizeof(*colls) * cnt)) == NULL ||
+                  bgpstream_get_collector_stats(bs, colls, cnt) != cnt)) {
+    free(colls);
+    return -1;
+  }
+
+  metrics_print_header(f, "records_total", "counter",
+                       "Records returned by the stream");
+  fprintf(f, "bgpstream_records_total %" PRIu64 "\n", perf.records);
+  metrics_print_header(f, "elems_total", "counter",
+                       "Elems checked by the filters of the stream");
+  fprintf(f, "bgpstream_elems_total %" PRIu64 "\n", perf.elems);
+  metrics_print_header(f, "elems_passed_total", "counter",
+                       "Elems that passed the filters of the stream");
+  fprintf(f, "bgpstream_elems_passed_total %" PRIu64 "\n", perf.elems_passed);
+  metrics_print_header(f, "elems_duplicate_total", "counter",
+                       "Elems dropped as duplicates");
+  fprintf(f, "bgpstream_elems_duplicate_total %" PRIu64 "\n",
+          perf.elems_duplicate);
+
+  metrics_print_header(f, "filter_runs_total", "counter",
+                       "Elems checked by each filter");
+  metrics_print_indexed(f, "filter_runs_total", "filter",
+                        metrics_filter_names, perf.filter_runs,
+                        _BGPSTREAM_PERF_FILTER_CNT, 1);
+  metrics_print_header(f, "filter_rejects_total", "counter",
+                       "Elems rejected by each filter");
+  metrics_print_indexed(f, "filter_rejects_total", "filter",
+                        metrics_filter_names, perf.filter_rejects,
+                        _BGPSTREAM_PERF_FILTER_CNT, 1);
+
+  metrics_print_header(f, "collector_records_total", "counter",
+                       "Records of each collector returned by the stream");
+  for (i = 0; i < cnt; i++) {
+    fprintf(f, "bgpstream_collector_records_total{collector=\"");
+    metrics_print_label(f, colls[i].name);
+    fprintf(f, "\"} %" PRIu64 "\n", colls[i].records);
+  }
+  metrics_print_header(f, "collector_last_record_timestamp_seconds", "gauge",
+                       "Time of the latest record of each collector");
+  for (i = 0; i < cnt; i++) {
+    fprintf(f, "bgpstream_collector_last_record_timestamp_seconds{"
+               "collector=\"");
+    metrics_print_label(f, colls[i].name);
+    fprintf(f, "\"} %" PRIu32 "\n", colls[i].last_time);
+  }
+  metrics_print_header(f, "collector_lag_seconds", "gauge",
+                       "How far the latest record of each collector is "
+                       "behind the time the metrics were written");
+  for (i = 0; i < cnt; i++) {
+    fprintf(f, "bgpstream_collector_lag_seconds{collector=\"");
+    metrics_print_label(f, colls[i].name);
+    fprintf(f, "\"} %" PRId64 "\n", (int64_t)now - colls[i].last_time);
+  }
+  free(colls);
+
+  metrics_print_header(f, "open_resources", "gauge",
+                       "Resources open at the moment");
+  fprintf(f, "bgpstream_open_resources %" PRIu32 "\n", perf.open_resources);
+  metrics_print_header(f, "polls_again_total", "counter",
+                       "Polls of stream resources that had no record ready");
+  fprintf(f, "bgpstream_polls_again_total %" PRIu64 "\n", perf.polls_again);
+  metrics_print_header(f, "data_interface_queries_total", "counter",
+                       "Times the data interface was asked for resources");
+  fprintf(f, "bgpstream_data_interface_queries_total %" PRIu64 "\n",
+          perf.di_queries);
+  metrics_print_header(f, "kafka_consumer_lag_messages", "gauge",
+                       "Messages that Kafka consumers have yet to read");
+  fprintf(f, "bgpstream_kafka_consumer_lag_messages %" PRIu64 "\n",
+          perf.kafka_lag);
+
+  metrics_print_header(f, "transport_read_bytes_total", "counter",
+                       "Bytes read from each transport");
+  metrics_print_indexed(f, "transport_read_bytes_total", "transport",
+                        metrics_transport_names, perf.transport_bytes,
+                        _BGPSTREAM_PERF_TRANSPORT_CNT, 1);
+  metrics_print_header(f, "transport_reads_total", "counter",
+                       "Reads from each transport");
+  metrics_print_indexed(f, "transport_reads_total", "transport",
+                        metrics_transport_names, perf.transport_reads,
+                        _BGPSTREAM_PERF_TRANSPORT_CNT, 1);
+  metrics_print_header(f, "transport_read_seconds_total", "counter",
+                       "Time spent reading from each transport");
+  metrics_print_indexed(f, "transport_read_seconds_total", "transport",
+                        metrics_transport_names, perf.transport_read_ns,
+                        _BGPSTREAM_PERF_TRANSPORT_CNT, 1e-9);
+  metrics_print_header(f, "stage_seconds_total", "counter",
+                       "Time spent in each stage, summed over threads");
+  metrics_print_indexed(f, "stage_seconds_total", "stage", metrics_stage_names,
+                        perf.stage_ns, _BGPSTREAM_PERF_STAGE_CNT, 1e-9);
+
+  metrics_print_header(f, "memory_bytes", "gauge", "Bytes in use");
+  fprintf(f, "bgpstream_memory_bytes %" PRIu64 "\n", mem.total);
+  metrics_print_header(f, "memory_peak_bytes", "gauge",
+                       "Most bytes in use at once");
+  fprintf(f, "bgpstream_memory_peak_bytes %" PRIu64 "\n", mem.peak);
+
+  metrics_print_header(f, "metrics_timestamp_seconds", "gauge",
+                       "Time the metrics were written");
+  fprintf(f, "bgpstream_metrics_timestamp_seconds %" PRIu32 "\n", now);
+  return 0;
+}
+
+int bgpstream_write_metrics(bgpstream_t *bs, const char *filename)
+{
+  char *temp_path;
+  size_t len;
+  FILE *f;
+  int rc;
+
+  len = strlen(filename) + sizeof(METRICS_TEMP_SUFFIX);
+  if ((temp_path = malloc(len)) == NULL) {
+    return -1;
+  }
+  snprintf(temp_path, len, "%s%s", filename, METRICS_TEMP_SUFFIX);
+  if ((f = fopen(temp_path, "w")) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create metrics file %s: %s",
+                  temp_path, strerror(errno));
+    free(temp_path);
+    return -1;
+  }
+
+  rc = metrics_write(bs, f);
+  if (fclose(f) != 0 || rc != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not write metrics file %s",
+                  temp_path);
+    goto err;
+  }
+  if (rename(temp_path, filename) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not rename %s: %s", temp_path,
+                  strerror(errno));
+    goto err;
+  }
+  free(temp_path);
+  return 0;
+
+err:
+  unlink(temp_path);
+  free(temp_path);
+  return -1;
+}
+
+void bgpstream_set_prefetch(bgpstream_t *bs, uint32_t horizon)
+{
+  assert(!bs->started);
+  bgpstream_di_mgr_set_prefetch(bs->di_mgr, horizon);
+}
+
+void bgpstream_set_unordered(bgpstream_t *bs)
+{
+  assert(!bs->started);
+  bgpstream_di_mgr_set_unordered(bs->di_mgr);
+}
+
+int bgpstream_set_max_skew(bgpstream_t *bs, uint32_t max_skew)
+{
+  assert(!bs->started);
+  if (bgpstream_di_mgr_set_max_skew(bs->di_mgr, max_skew) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create the reorder buffer");
+    return -1;
+  }
+  return 0;
+}
+
+void bgpstream_set_nonblocking(bgpstream_t *bs)
+{
+  assert(!bs->started);
+  bgpstream_di_mgr_set_nonblocking(bs->di_mgr);
+}
+
+void bgpstream_set_lazy_elems(bgpstream_t *bs)
+{
+  assert(!bs->started);
+  bs->filter_mgr->lazy_elems = 1;
+}
+
+void bgpstream_set_elem_fields(bgpstream_t *bs, uint8_t fields)
+{
+  assert(!bs->started);
+  bs->filter_mgr->unused_elem_fields = ~fields & BGPSTREAM_ELEM_FIELD_ALL;
+}
+
+int bgpstream_set_decode_threads(bgpstream_t *bs, int threads)
+{
+  assert(!bs->started);
+  if (threads < 1) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid number of decode threads: %d",
+                  threads);
+    return -1;
+  }
+  bs->filter_mgr->decode_threads = threads;
+  return 0;
+}
+
+void bgpstream_set_raw_records(bgpstream_t *bs)
+{
+  assert(!bs->started);
+  bs->filter_mgr->raw_records = 1;
+}
+
+void bgpstream_set_resource_summaries(bgpstream_t *bs)
+{
+  assert(!bs->started);
+  bs->filter_mgr->use_summaries = 1;
+}
+
+void bgpstream_set_heap_merge(bgpstream_t *bs)
+{
+  assert(!bs->started);
+  bgpstream_di_mgr_set_heap_merge(bs->di_mgr);
+}
+
+int bgpstream_set_worker_threads(bgpstream_t *bs, int threads)
+{
+  assert(!bs->started);
+  if (threads <= 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid number of worker threads: %d",
+                  threads);
+    return -1;
+  }
+  return bgpstream_di_mgr_set_worker_threads(bs->di_mgr, threads);
+}
+
+int bgpstream_set_thread_affinity(bgpstream_t *bs,
+                                  bgpstream_thread_affinity_t policy,
+                                  const char *cpus)
+{
+  assert(!bs->started);
+  return bgpstream_di_mgr_set_thread_affinity(bs->di_mgr, policy, cpus);
+}
+
 /* turn on the bgpstream interface, i.e.:
  * it makes the interface ready
  * for a new get next call
@@ -215,6 +893,9 @@ int bgpstream_start(bgpstream_t *bs)
   if ((rc = bgpstream_filter_mgr_validate(bs->filter_mgr)) != 0) {
     return rc;
   }
+  bgpstream_filter_mgr_compile(bs->filter_mgr);
+  bs->reload_fields = bgpstream_filter_mgr_elem_fields(bs->filter_mgr);
+  account_filters(bs);
 
   // start the data interface
   if (bgpstream_di_mgr_start(bs->di_mgr) != 0) {
@@ -225,6 +906,12 @@ int bgpstream_start(bgpstream_t *bs)
   return 0;
 }
 
+int bgpstream_get_fd(bgpstream_t *bs)
+{
+  assert(bs->started);
+  return bgpstream_di_mgr_get_fd(bs->di_mgr);
+}
+
 int bgpstream_get_next_record(bgpstream_t *bs, bgpstream_record_t **record)
 {
   assert(bs->started);
@@ -233,6 +920,33 @@ int bgpstream_get_next_record(bgpstream_t *bs, bgpstream_record_t **record)
   return bgpstream_di_mgr_get_next_record(bs->di_mgr, record);
 }
 
+int bgpstream_get_next_records(bgpstream_t *bs, bgpstream_record_t **records,
+                               int n)
+{
+  assert(bs->started);
+  if (n <= 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid batch size %d", n);
+    return -1;
+  }
+  // one trip through the manager stack for the whole batch
+  return bgpstream_di_mgr_get_next_records(bs->di_mgr, records, n);
+}
+
+int bgpstream_foreach_elem(bgpstream_t *bs, bgpstream_elem_cb_t *cb,
+                           void *user)
+{
+  bgpstream_record_t *record;
+  int rc;
+
+  assert(bs->started);
+  while ((rc = bgpstream_di_mgr_get_next_record(bs->di_mgr, &record)) > 0) {
+    if ((rc = bgpstream_record_foreach_elem(record, cb, user)) != 0) {
+      return rc;
+    }
+  }
+  return rc;
+}
+
 /* destroy a bgpstream interface instance */
 void bgpstream_destroy(bgpstream_t *bs)
 {
@@ -243,10 +957,31 @@ void bgpstream_destroy(bgpstream_t *bs)
   bgpstream_di_mgr_destroy(bs->di_mgr);
   bs->di_mgr = NULL;
 
+  bgpstream_filter_mgr_destroy(bs->reload_filter_mgr);
+  bs->reload_filter_mgr = NULL;
+
+  if (bs->di_filter_mgr != bs->filter_mgr) {
+    bgpstream_filter_mgr_destroy(bs->di_filter_mgr);
+  }
+  bs->di_filter_mgr = NULL;
+
   bgpstream_filter_mgr_destroy(bs->filter_mgr);
   bs->filter_mgr = NULL;
 
+  bgpstream_dedup_destroy(bs->dedup);
+  bs->dedup = NULL;
+
   bs->started = 0;
 
   free(bs);
 }
+
+int bgpstream_start_async_log(void)
+{
+  return bgpstream_log_async_start();
+}
+
+void bgpstream_stop_async_log(void)
+{
+  bgpstream_log_async_stop();
+}
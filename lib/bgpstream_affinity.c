@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_affinity.h"
+#include "bgpstream_log.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+
+/* Where the NUMA topology is described */
+#define NODE_ONLINE_PATH "/sys/devices/system/node/online"
+#define NODE_CPULIST_PATH "/sys/devices/system/node/node%d/cpulist"
+
+/* Longest CPU list read from the topology */
+#define CPULIST_LEN 4096
+
+/* The NUMA node of each CPU, read the first time it is needed (all CPUs are
+ * on node 0 if the topology cannot be read) */
+static struct {
+  pthread_once_t once;
+  uint8_t nodes[CPU_SETSIZE];
+} topo = {PTHREAD_ONCE_INIT, {0}};
+
+/* The placement of the calling thread, for the threads that it starts */
+static __thread const bgpstream_affinity_t *thread_aff = NULL;
+
+// parses a list of CPUs (or nodes) such as "0-3,8" into the given set. returns
+// 0 if successful, -1 otherwise
+static int parse_cpulist(const char *list, cpu_set_t *set)
+{
+  const char *p = list;
+  char *end;
+  unsigned long first, last;
+
+  CPU_ZERO(set);
+  while (*p != '\0' && *p != '\n') {
+    first = last = strtoul(p, &end, 10);
+    if (end == p) {
+      return -1;
+    }
+    if (*end == '-') {
+      p = end + 1;
+      last = strtoul(p, &end, 10);
+      if (end == p) {
+        return -1;
+      }
+    }
+    if (last < first || last >= CPU_SETSIZE) {
+      return -1;
+    }
+    for (; first <= last; first++) {
+      CPU_SET(first, set);
+    }
+    p = end;
+    if (*p == ',') {
+      p++;
+    } else if (*p != '\0' && *p != '\n') {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// reads a CPU list file from sysfs. returns 0 if successful, -1 otherwise
+static int read_cpulist(const char *path, cpu_set_t *set)
+{
+  char buf[CPULIST_LEN];
+  FILE *fp;
+  int rc = -1;
+
+  if ((fp = fopen(path, "r")) == NULL) {
+    return -1;
+  }
+  if (fgets(buf, sizeof(buf), fp) != NULL) {
+    rc = parse_cpulist(buf, set);
+  }
+  fclose(fp);
+  return rc;
+}
+
+static void read_topology(void)
+{
+  char path[64];
+  cpu_set_t nodes, cpus;
+  int node, cpu;
+
+  if (read_cpulist(NODE_ONLINE_PATH, &nodes) != 0) {
+    // not a NUMA host (or not Linux): everything is on node 0
+    return;
+  }
+  for (node = 0; node < CPU_SETSIZE; node++) {
+    if (CPU_ISSET(node, &nodes) == 0) {
+      continue;
+    }
+    snprintf(path, sizeof(path), NODE_CPULIST_PATH, node);
+    if (read_cpulist(path, &cpus) != 0) {
+      continue;
+    }
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &cpus) != 0) {
+        topo.nodes[cpu] = node % BGPSTREAM_AFFINITY_MAX_NODES;
+      }
+    }
+  }
+}
+
+#endif
+
+int bgpstream_affinity_init(bgpstream_affinity_t *aff,
+                            bgpstream_thread_affinity_t policy,
+                            const char *cpus)
+{
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+  cpu_set_t allowed;
+#endif
+
+  switch (policy) {
+  case BGPSTREAM_THREAD_AFFINITY_NONE:
+    aff->policy = policy;
+    return 0;
+
+  case BGPSTREAM_THREAD_AFFINITY_NODE:
+  case BGPSTREAM_THREAD_AFFINITY_CPU:
+    break;
+
+  default:
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Unknown thread affinity policy %d",
+                  policy);
+    return -1;
+  }
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not get the CPUs of the process");
+    return -1;
+  }
+  if (cpus == NULL) {
+    aff->cpus = allowed;
+  } else if (parse_cpulist(cpus, &aff->cpus) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid CPU list '%s'", cpus);
+    return -1;
+  } else {
+    CPU_AND(&aff->cpus, &aff->cpus, &allowed);
+  }
+  if ((aff->cpus_cnt = CPU_COUNT(&aff->cpus)) == 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "None of the CPUs '%s' may be used",
+                  cpus);
+    return -1;
+  }
+  aff->policy = policy;
+  return 0;
+#else
+  bgpstream_log(BGPSTREAM_LOG_ERR,
+                "Thread placement is not supported on this platform");
+  return -1;
+#endif
+}
+
+void bgpstream_affinity_resolve(bgpstream_affinity_t *aff)
+{
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+  cpu_set_t local;
+  int node, cpu;
+
+  if (aff->policy != BGPSTREAM_THREAD_AFFINITY_NODE) {
+    return;
+  }
+  node = bgpstream_affinity_get_node();
+  CPU_ZERO(&local);
+  for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &aff->cpus) != 0 && topo.nodes[cpu] == node) {
+      CPU_SET(cpu, &local);
+    }
+  }
+  if (CPU_COUNT(&local) == 0) {
+    bgpstream_log(BGPSTREAM_LOG_WARN,
+                  "None of the CPUs of the workers are on NUMA node %d",
+                  node);
+    return;
+  }
+  aff->cpus = local;
+  aff->cpus_cnt = CPU_COUNT(&local);
+#endif
+}
+
+void bgpstream_affinity_apply(const bgpstream_affinity_t *aff, int idx)
+{
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+  cpu_set_t set;
+  int cpu, rc;
+
+  thread_aff = aff;
+  if (aff == NULL || aff->policy == BGPSTREAM_THREAD_AFFINITY_NONE) {
+    return;
+  }
+  if (aff->policy == BGPSTREAM_THREAD_AFFINITY_CPU) {
+    // the CPUs are handed out in turn
+    idx %= aff->cpus_cnt;
+    CPU_ZERO(&set);
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &aff->cpus) != 0 && idx-- == 0) {
+        CPU_SET(cpu, &set);
+        break;
+      }
+    }
+  } else {
+    set = aff->cpus;
+  }
+  if ((rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_WARN, "Could not place worker thread: %s",
+                  strerror(rc));
+  }
+#endif
+}
+
+int bgpstream_affinity_thread_create(pthread_t *thread,
+                                     void *(*func)(void *), void *arg)
+{
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+  pthread_attr_t attr;
+  int rc;
+
+  // other threads already inherit the CPUs of their placement
+  if (thread_aff == NULL ||
+      thread_aff->policy != BGPSTREAM_THREAD_AFFINITY_CPU) {
+    return pthread_create(thread, NULL, func, arg);
+  }
+  if ((rc = pthread_attr_init(&attr)) != 0) {
+    return rc;
+  }
+  if ((rc = pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t),
+                                        &thread_aff->cpus)) == 0) {
+    rc = pthread_create(thread, &attr, func, arg);
+  }
+  pthread_attr_destroy(&attr);
+  return rc;
+#else
+  return pthread_create(thread, NULL, func, arg);
+#endif
+}
+
+int bgpstream_affinity_get_node(void)
+{
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(HAVE_SCHED_GETCPU)
+  int cpu;
+
+  pthread_once(&topo.once, read_topology);
+  if ((cpu = sched_getcpu()) < 0 || cpu >= CPU_SETSIZE) {
+    return 0;
+  }
+  return topo.nodes[cpu];
+#else
+  return 0;
+#endif
+}
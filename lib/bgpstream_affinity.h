@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_AFFINITY_H
+#define __BGPSTREAM_AFFINITY_H
+
+#include "config.h"
+#include "bgpstream.h"
+#include <pthread.h>
+#include <sched.h>
+
+/** @file
+ *
+ * @brief Header file for the placement of worker threads on CPUs and NUMA
+ * nodes (see bgpstream_set_thread_affinity). Placement is only supported on
+ * Linux; elsewhere every thread runs wherever the OS schedules it, and every
+ * thread is considered to be on node 0.
+ */
+
+/** Most NUMA nodes told apart (threads on further nodes are considered to be
+ * on one of these) */
+#define BGPSTREAM_AFFINITY_MAX_NODES 8
+
+/** Where a set of threads may run */
+typedef struct bgpstream_affinity {
+
+  /** How the threads are placed on the CPUs */
+  bgpstream_thread_affinity_t policy;
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+  /** CPUs that the threads may run on */
+  cpu_set_t cpus;
+
+  /** Number of CPUs in cpus */
+  int cpus_cnt;
+#endif
+
+} bgpstream_affinity_t;
+
+/** Initialize a thread placement
+ *
+ * @param aff           pointer to the placement to initialize
+ * @param policy        how to place the threads
+ * @param cpus          list of the CPUs that the threads may use (e.g.,
+ *                      "0-7,16-23"), or NULL for every CPU of the process
+ * @return 0 if successful, -1 if the list is invalid, or placement is not
+ * supported
+ */
+int bgpstream_affinity_init(bgpstream_affinity_t *aff,
+                            bgpstream_thread_affinity_t policy,
+                            const char *cpus);
+
+/** Restrict a placement to the NUMA node of the calling thread, if its policy
+ * asks for it
+ *
+ * @param aff           pointer to the placement
+ *
+ * Called when the threads are about to be started, so that they run on the
+ * node of the thread that will consume their work.
+ */
+void bgpstream_affinity_resolve(bgpstream_affinity_t *aff);
+
+/** Place the calling thread
+ *
+ * @param aff           pointer to the placement, which must outlive the
+ *                      thread (may be NULL, for no placement)
+ * @param idx           index of the thread among those sharing the placement
+ *
+ * The placement is also remembered for the threads that the calling thread
+ * starts using bgpstream_affinity_thread_create.
+ */
+void bgpstream_affinity_apply(const bgpstream_affinity_t *aff, int idx);
+
+/** Start a helper thread that may run on any of the CPUs of the placement of
+ * the calling thread
+ *
+ * @param thread        pointer to the thread to start
+ * @param func          function that the thread runs
+ * @param arg           argument to pass to func
+ * @return 0 if the thread was started, an error number otherwise (as
+ * pthread_create)
+ *
+ * A thread created using pthread_create inherits the CPU of a thread pinned to
+ * a single CPU, which it would then compete with.
+ */
+int bgpstream_affinity_thread_create(pthread_t *thread,
+                                     void *(*func)(void *), void *arg);
+
+/** Get the NUMA node that the calling thread is running on
+ *
+ * @return the node (less than BGPSTREAM_AFFINITY_MAX_NODES), 0 if unknown
+ *
+ * This is cheap enough to call for each allocation.
+ */
+int bgpstream_affinity_get_node(void);
+
+#endif /* __BGPSTREAM_AFFINITY_H */
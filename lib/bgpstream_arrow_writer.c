@@ -0,0 +1,1139 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_arrow_writer.h"
+#include "bgpstream_log.h"
+#include "khash.h"
+#include "utils.h"
+#include "wandio.h"
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+// compression level used for compressed output (the zlib default)
+#define ARROW_WRITER_COMPRESS_LEVEL 6
+
+// number of rows that are written together as one record batch
+#define ARROW_WRITER_BATCH_ROWS 65536
+
+// endianness of this host, as given in the schema (the body of each message is
+// written in host byte order, while the flatbuffers metadata is always little
+// endian)
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_ENDIANNESS 1
+#else
+#define HOST_ENDIANNESS 0
+#endif
+
+// values of the flatbuffers enums and unions used (see Schema.fbs and
+// Message.fbs in the Arrow format specification)
+#define METADATA_VERSION_V5 4
+#define HEADER_SCHEMA 1
+#define HEADER_DICTIONARY_BATCH 2
+#define HEADER_RECORD_BATCH 3
+#define TYPE_INT 2
+#define TYPE_UTF8 5
+#define TYPE_TIMESTAMP 10
+#define TIME_UNIT_SECOND 0
+
+// most fields any of the flatbuffers tables we write has
+#define FB_MAX_FIELDS 8
+
+// columns of the stream
+enum {
+  COL_TYPE,
+  COL_TIME,
+  COL_PROJECT,
+  COL_COLLECTOR,
+  COL_PEER_ASN,
+  COL_PREFIX,
+  COL_ORIGIN_ASN,
+  COL_AS_PATH,
+  COL_CNT,
+};
+
+// dictionaries of the dictionary-encoded columns (their IDs in the stream)
+enum {
+  DICT_PROJECT,
+  DICT_COLLECTOR,
+  DICT_AS_PATH,
+  DICT_CNT,
+};
+
+static const struct {
+  const char *name;
+  int nullable;
+  int type;
+  // bit width and signedness of integer columns
+  int bits;
+  int is_signed;
+  // dictionary of the column, -1 if it is not dictionary-encoded
+  int dict;
+} columns[COL_CNT] = {
+  {"type", 0, TYPE_INT, 8, 0, -1},
+  {"time", 0, TYPE_TIMESTAMP, 64, 1, -1},
+  {"project", 0, TYPE_UTF8, 0, 0, DICT_PROJECT},
+  {"collector", 0, TYPE_UTF8, 0, 0, DICT_COLLECTOR},
+  {"peer_asn", 0, TYPE_INT, 32, 0, -1},
+  {"prefix", 1, TYPE_UTF8, 0, 0, -1},
+  {"origin_asn", 1, TYPE_INT, 32, 0, -1},
+  {"as_path", 1, TYPE_UTF8, 0, 0, DICT_AS_PATH},
+};
+
+KHASH_INIT(arrow_str, char *, int32_t, 1, kh_str_hash_func, kh_str_hash_equal)
+KHASH_INIT(arrow_path, uint64_t, int32_t, 1, kh_int64_hash_func,
+           kh_int64_hash_equal)
+
+// growable byte buffer. once an allocation fails, the buffer stays failed and
+// further writes to it are ignored, so that errors are only checked once a
+// whole message has been built
+typedef struct buf {
+  uint8_t *data;
+  size_t len;
+  size_t alloc;
+  int failed;
+} buf_t;
+
+// strings of a dictionary-encoded column
+typedef struct str_dict {
+
+  // index of each string (owned keys)
+  khash_t(arrow_str) * idx;
+
+  // strings in index order (borrowed from idx)
+  char **strs;
+  int cnt;
+  int alloc;
+
+  // number of strings that have been written
+  int sent;
+
+  // index of the string last looked up
+  int32_t last;
+
+} str_dict_t;
+
+// a path of the as_path dictionary: a store path, as observed by a peer
+typedef struct path_entry {
+  bgpstream_as_path_store_path_t *spath;
+  uint32_t peer_asn;
+} path_entry_t;
+
+// a field of a flatbuffers table: a scalar of the given size, or (if it is an
+// offset) a placeholder that is patched once the object it refers to has been
+// written. size 0 means the field is absent
+typedef struct fb_field {
+  int size;
+  uint64_t val;
+} fb_field_t;
+
+struct bgpstream_arrow_writer {
+
+  // path of the file being written (for log messages)
+  char *path;
+
+  // wandio writer for the file
+  iow_t *iow;
+
+  // has the schema been written
+  int started;
+
+  // which columns are written (all of them, unless set otherwise)
+  int col_on[COL_CNT];
+
+  // has each dictionary been written (later batches of it are deltas)
+  int dict_started[DICT_CNT];
+
+  // interns the paths of the as_path column
+  bgpstream_as_path_store_t *path_store;
+
+  // as_path dictionary index of each store path (for core paths, of each
+  // store path and peer ASN, since the peer ASN is part of the full path)
+  khash_t(arrow_path) * paths;
+
+  // paths added to the dictionary since it was last written
+  path_entry_t *new_paths;
+  int new_paths_cnt;
+  int new_paths_alloc;
+
+  // rows that have not been written yet
+  bgpstream_elem_columns_t *cols;
+
+  // project, collector and as_path dictionary indexes of the rows
+  int32_t *project;
+  int32_t *collector;
+  int32_t *as_path;
+  int rows_alloc;
+
+  str_dict_t projects;
+  str_dict_t collectors;
+
+  // flatbuffers metadata and body of the message being built
+  buf_t meta;
+  buf_t body;
+
+  // field nodes and buffers (offset, length) of the body
+  int64_t nodes[COL_CNT][2];
+  int nodes_cnt;
+  int64_t bufs[COL_CNT * 3][2];
+  int bufs_cnt;
+
+  // offsets and bytes of the strings of the utf8 column being built
+  buf_t offsets;
+  buf_t strs;
+};
+
+/* ========== BUFFERS ========== */
+
+static int buf_reserve(buf_t *b, size_t len)
+{
+  size_t alloc;
+  uint8_t *tmp;
+
+  if (b->failed != 0) {
+    return -1;
+  }
+  if (b->len + len <= b->alloc) {
+    return 0;
+  }
+  alloc = b->alloc == 0 ? 4096 : b->alloc;
+  while (alloc < b->len + len) {
+    alloc *= 2;
+  }
+  if ((tmp = realloc(b->data, alloc)) == NULL) {
+    b->failed = 1;
+    return -1;
+  }
+  b->data = tmp;
+  b->alloc = alloc;
+  return 0;
+}
+
+static void buf_put(buf_t *b, const void *data, size_t len)
+{
+  if (len == 0 || buf_reserve(b, len) != 0) {
+    return;
+  }
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+}
+
+// write the low size bytes of val, least significant first
+static void buf_put_le(buf_t *b, uint64_t val, int size)
+{
+  int i;
+
+  if (buf_reserve(b, size) != 0) {
+    return;
+  }
+  for (i = 0; i < size; i++) {
+    b->data[b->len++] = (val >> (8 * i)) & 0xff;
+  }
+}
+
+static void buf_pad(buf_t *b, size_t align)
+{
+  while (b->failed == 0 && (b->len % align) != 0) {
+    buf_put_le(b, 0, 1);
+  }
+}
+
+static void buf_reset(buf_t *b)
+{
+  b->len = 0;
+  b->failed = 0;
+}
+
+/* ========== FLATBUFFERS ========== */
+
+// point the offset field at the given position to the object at target
+static void fb_patch(buf_t *b, size_t at, size_t target)
+{
+  uint32_t off = target - at;
+  int i;
+
+  if (b->failed != 0) {
+    return;
+  }
+  for (i = 0; i < 4; i++) {
+    b->data[at + i] = (off >> (8 * i)) & 0xff;
+  }
+}
+
+// write a table with the given fields (largest first, so that each is aligned
+// without padding between them), preceded by its vtable. pos is set to the
+// position of each field, and the position of the table is returned
+static size_t fb_table(buf_t *b, int n, const fb_field_t *f, size_t *pos)
+{
+  size_t off[FB_MAX_FIELDS];
+  size_t cur = 4, vt, t;
+  int size, i;
+
+  assert(n <= FB_MAX_FIELDS);
+  for (size = 8; size > 0; size /= 2) {
+    for (i = 0; i < n; i++) {
+      if (f[i].size == size) {
+        cur = (cur + size - 1) & ~(size_t)(size - 1);
+        off[i] = cur;
+        cur += size;
+      }
+    }
+  }
+
+  buf_pad(b, 2);
+  vt = b->len;
+  buf_put_le(b, 4 + 2 * n, 2);
+  buf_put_le(b, cur, 2);
+  for (i = 0; i < n; i++) {
+    buf_put_le(b, f[i].size != 0 ? off[i] : 0, 2);
+  }
+
+  // the table starts 8-byte aligned, so that its 8-byte fields are too
+  buf_pad(b, 8);
+  t = b->len;
+  buf_put_le(b, t - vt, 4);
+  while (b->failed == 0 && b->len < t + cur) {
+    buf_put_le(b, 0, 1);
+  }
+  for (i = 0; i < n; i++) {
+    if (f[i].size != 0 && b->failed == 0) {
+      b->len = t + off[i];
+      buf_put_le(b, f[i].val, f[i].size);
+      pos[i] = t + off[i];
+    }
+  }
+  b->len = t + cur;
+  return t;
+}
+
+// write the length of a vector of cnt elements, which the caller then writes
+// (8-byte aligned). the position of the vector is returned
+static size_t fb_vector(buf_t *b, size_t cnt)
+{
+  size_t v;
+
+  buf_pad(b, 4);
+  if ((b->len % 8) == 0) {
+    buf_put_le(b, 0, 4);
+  }
+  v = b->len;
+  buf_put_le(b, cnt, 4);
+  return v;
+}
+
+static size_t fb_string(buf_t *b, const char *str)
+{
+  size_t s, len = strlen(str);
+
+  buf_pad(b, 4);
+  s = b->len;
+  buf_put_le(b, len, 4);
+  buf_put(b, str, len);
+  buf_put_le(b, 0, 1);
+  return s;
+}
+
+// write an Int type table
+static size_t fb_int_type(buf_t *b, int bits, int is_signed)
+{
+  fb_field_t f[] = {{4, bits}, {1, is_signed}};
+  size_t pos[2];
+
+  return fb_table(b, 2, f, pos);
+}
+
+// write the Field table of the given column (and the tables it refers to)
+static size_t fb_column(buf_t *b, int col)
+{
+  fb_field_t f[] = {
+    {4, 0},                             // name
+    {1, columns[col].nullable},         // nullable
+    {1, columns[col].type},             // type_type
+    {4, 0},                             // type
+    {columns[col].dict < 0 ? 0 : 4, 0}, // dictionary
+    {4, 0},                             // children
+  };
+  fb_field_t ts[] = {{2, TIME_UNIT_SECOND}, {4, 0}};
+  fb_field_t enc[] = {{8, 0}, {4, 0}};
+  size_t pos[6], type_pos[2], enc_pos[2];
+  size_t field;
+
+  field = fb_table(b, 6, f, pos);
+  fb_patch(b, pos[0], fb_string(b, columns[col].name));
+
+  switch (columns[col].type) {
+  case TYPE_INT:
+    fb_patch(b, pos[3], fb_int_type(b, columns[col].bits,
+                                    columns[col].is_signed));
+    break;
+  case TYPE_TIMESTAMP:
+    fb_patch(b, pos[3], fb_table(b, 2, ts, type_pos));
+    fb_patch(b, type_pos[1], fb_string(b, "UTC"));
+    break;
+  default:
+    // Utf8 has no fields
+    fb_patch(b, pos[3], fb_table(b, 0, NULL, type_pos));
+    break;
+  }
+
+  if (columns[col].dict >= 0) {
+    enc[0].val = columns[col].dict;
+    fb_patch(b, pos[4], fb_table(b, 2, enc, enc_pos));
+    fb_patch(b, enc_pos[1], fb_int_type(b, 32, 1));
+  }
+
+  fb_patch(b, pos[5], fb_vector(b, 0));
+  return field;
+}
+
+// start a Message table with the given header type, returning the position of
+// its header field
+static size_t fb_message(buf_t *b, int header_type, size_t body_len)
+{
+  fb_field_t f[] = {
+    {2, METADATA_VERSION_V5}, // version
+    {1, header_type},         // header_type
+    {4, 0},                   // header
+    {8, body_len},            // bodyLength
+  };
+  size_t pos[4];
+
+  // root offset
+  buf_put_le(b, 0, 4);
+  fb_patch(b, 0, fb_table(b, 4, f, pos));
+  return pos[2];
+}
+
+/* ========== MESSAGES ========== */
+
+static int write_bytes(bgpstream_arrow_writer_t *writer, const void *buf,
+                       size_t len)
+{
+  if (len != 0 && wandio_wwrite(writer->iow, buf, len) != (int64_t)len) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not write to %s", writer->path);
+    return -1;
+  }
+  return 0;
+}
+
+// frame and write the metadata and body that have been built
+static int write_message(bgpstream_arrow_writer_t *writer)
+{
+  uint8_t prefix[8];
+  buf_t *m = &writer->meta;
+  int i;
+
+  buf_pad(m, 8);
+  if (m->failed != 0 || writer->body.failed != 0 ||
+      writer->offsets.failed != 0 || writer->strs.failed != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not build Arrow message");
+    return -1;
+  }
+
+  // continuation marker, then the metadata length
+  for (i = 0; i < 4; i++) {
+    prefix[i] = 0xff;
+    prefix[4 + i] = (m->len >> (8 * i)) & 0xff;
+  }
+  if (write_bytes(writer, prefix, sizeof(prefix)) != 0 ||
+      write_bytes(writer, m->data, m->len) != 0 ||
+      write_bytes(writer, writer->body.data, writer->body.len) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+static int write_schema(bgpstream_arrow_writer_t *writer)
+{
+  buf_t *b = &writer->meta;
+  fb_field_t f[] = {{2, HOST_ENDIANNESS}, {4, 0}};
+  size_t pos[2], header, fields;
+  int col, cnt = 0;
+
+  for (col = 0; col < COL_CNT; col++) {
+    cnt += writer->col_on[col];
+  }
+
+  buf_reset(b);
+  buf_reset(&writer->body);
+  header = fb_message(b, HEADER_SCHEMA, 0);
+  fb_patch(b, header, fb_table(b, 2, f, pos));
+  fields = fb_vector(b, cnt);
+  fb_patch(b, pos[1], fields);
+  for (col = 0; col < cnt; col++) {
+    buf_put_le(b, 0, 4);
+  }
+  for (col = 0, cnt = 0; col < COL_CNT; col++) {
+    if (writer->col_on[col] != 0) {
+      fb_patch(b, fields + 4 + 4 * cnt++, fb_column(b, col));
+    }
+  }
+
+  writer->started = 1;
+  return write_message(writer);
+}
+
+static void body_reset(bgpstream_arrow_writer_t *writer)
+{
+  buf_reset(&writer->body);
+  writer->nodes_cnt = 0;
+  writer->bufs_cnt = 0;
+}
+
+static void body_add_node(bgpstream_arrow_writer_t *writer, int64_t length,
+                          int64_t null_cnt)
+{
+  writer->nodes[writer->nodes_cnt][0] = length;
+  writer->nodes[writer->nodes_cnt][1] = null_cnt;
+  writer->nodes_cnt++;
+}
+
+// add a buffer of len bytes to the body, returning a pointer to it that is
+// only valid until the next buffer is added (NULL if out of memory). the
+// buffer is padded to 8 bytes
+static void *body_add_buf(bgpstream_arrow_writer_t *writer, size_t len)
+{
+  buf_t *b = &writer->body;
+  size_t padded = (len + 7) & ~(size_t)7;
+  uint8_t *p;
+
+  assert(writer->bufs_cnt < COL_CNT * 3);
+  writer->bufs[writer->bufs_cnt][0] = b->len;
+  writer->bufs[writer->bufs_cnt][1] = len;
+  writer->bufs_cnt++;
+  if (padded == 0) {
+    return b->data;
+  }
+  if (buf_reserve(b, padded) != 0) {
+    return NULL;
+  }
+  p = b->data + b->len;
+  memset(p + len, 0, padded - len);
+  b->len += padded;
+  return p;
+}
+
+// add the strings that have been collected in offsets/strs as a utf8 column
+static void body_add_strings(bgpstream_arrow_writer_t *writer)
+{
+  void *p;
+
+  if ((p = body_add_buf(writer, writer->offsets.len)) != NULL &&
+      writer->offsets.len != 0) {
+    memcpy(p, writer->offsets.data, writer->offsets.len);
+  }
+  if ((p = body_add_buf(writer, writer->strs.len)) != NULL &&
+      writer->strs.len != 0) {
+    memcpy(p, writer->strs.data, writer->strs.len);
+  }
+}
+
+static void strings_reset(bgpstream_arrow_writer_t *writer)
+{
+  int32_t zero = 0;
+
+  buf_reset(&writer->offsets);
+  buf_reset(&writer->strs);
+  buf_put(&writer->offsets, &zero, sizeof(zero));
+}
+
+// add a string to offsets/strs (NULL for an empty string)
+static void strings_add(bgpstream_arrow_writer_t *writer, const char *str)
+{
+  int32_t end;
+
+  if (str != NULL) {
+    buf_put(&writer->strs, str, strlen(str));
+  }
+  end = writer->strs.len;
+  buf_put(&writer->offsets, &end, sizeof(end));
+}
+
+// write the body that has been built as a record batch, or as a batch of the
+// given dictionary if dict is not negative
+static int write_batch(bgpstream_arrow_writer_t *writer, int64_t length,
+                       int dict)
+{
+  buf_t *b = &writer->meta;
+  fb_field_t dict_f[] = {{8, dict}, {4, 0}, {1, 0}};
+  fb_field_t batch_f[] = {{8, length}, {4, 0}, {4, 0}};
+  size_t pos[3], dict_pos[3], header, v;
+  int i;
+
+  buf_reset(b);
+  if (dict >= 0) {
+    header = fb_message(b, HEADER_DICTIONARY_BATCH, writer->body.len);
+    dict_f[2].val = writer->dict_started[dict];
+    fb_patch(b, header, fb_table(b, 3, dict_f, dict_pos));
+    header = dict_pos[1];
+    writer->dict_started[dict] = 1;
+  } else {
+    header = fb_message(b, HEADER_RECORD_BATCH, writer->body.len);
+  }
+  fb_patch(b, header, fb_table(b, 3, batch_f, pos));
+
+  // FieldNode and Buffer structs are pairs of longs
+  fb_patch(b, pos[1], (v = fb_vector(b, writer->nodes_cnt)));
+  for (i = 0; i < writer->nodes_cnt; i++) {
+    buf_put_le(b, writer->nodes[i][0], 8);
+    buf_put_le(b, writer->nodes[i][1], 8);
+  }
+  fb_patch(b, pos[2], (v = fb_vector(b, writer->bufs_cnt)));
+  for (i = 0; i < writer->bufs_cnt; i++) {
+    buf_put_le(b, writer->bufs[i][0], 8);
+    buf_put_le(b, writer->bufs[i][1], 8);
+  }
+
+  return write_message(writer);
+}
+
+// write the strings that have been added to the dictionary since it was last
+// written (the first batch of each dictionary is written even if it is empty)
+static int write_str_dict(bgpstream_arrow_writer_t *writer, str_dict_t *sd,
+                          int dict)
+{
+  int i;
+
+  if (sd->sent == sd->cnt && writer->dict_started[dict] != 0) {
+    return 0;
+  }
+  body_reset(writer);
+  strings_reset(writer);
+  for (i = sd->sent; i < sd->cnt; i++) {
+    strings_add(writer, sd->strs[i]);
+  }
+  body_add_node(writer, sd->cnt - sd->sent, 0);
+  body_add_buf(writer, 0);
+  body_add_strings(writer);
+  if (write_batch(writer, sd->cnt - sd->sent, dict) != 0) {
+    return -1;
+  }
+  sd->sent = sd->cnt;
+  return 0;
+}
+
+// write a path as it was observed by the peer
+static int path_snprintf(char *buf, size_t len, path_entry_t *entry)
+{
+  bgpstream_as_path_store_path_iter_t iter;
+  bgpstream_as_path_seg_t *seg;
+  size_t written = 0;
+
+  bgpstream_as_path_store_path_iter_reset(entry->spath, &iter,
+                                          entry->peer_asn);
+  buf[0] = '\0';
+  while ((seg = bgpstream_as_path_store_path_get_next_seg(&iter)) != NULL) {
+    if (written != 0 && written + 1 < len) {
+      buf[written++] = ' ';
+      buf[written] = '\0';
+    }
+    written += bgpstream_as_path_seg_snprintf(
+      buf + written, written < len ? len - written : 0, seg);
+    if (written >= len) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// write the paths that have been added to the dictionary since it was last
+// written
+static int write_path_dict(bgpstream_arrow_writer_t *writer)
+{
+  char buf[4096];
+  int i;
+
+  if (writer->new_paths_cnt == 0 && writer->dict_started[DICT_AS_PATH] != 0) {
+    return 0;
+  }
+  body_reset(writer);
+  strings_reset(writer);
+  for (i = 0; i < writer->new_paths_cnt; i++) {
+    if (path_snprintf(buf, sizeof(buf), &writer->new_paths[i]) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "AS path too long for Arrow output");
+      return -1;
+    }
+    strings_add(writer, buf);
+  }
+  body_add_node(writer, writer->new_paths_cnt, 0);
+  body_add_buf(writer, 0);
+  body_add_strings(writer);
+  if (write_batch(writer, writer->new_paths_cnt, DICT_AS_PATH) != 0) {
+    return -1;
+  }
+  writer->new_paths_cnt = 0;
+  return 0;
+}
+
+/* ========== ROWS ========== */
+
+static int row_has_path(bgpstream_elem_columns_t *cols, int row)
+{
+  return cols->type[row] == BGPSTREAM_ELEM_TYPE_RIB ||
+         cols->type[row] == BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT;
+}
+
+static int row_valid(bgpstream_elem_columns_t *cols, int col, int row)
+{
+  switch (col) {
+  case COL_PREFIX:
+    return cols->prefix[row].address.version != 0;
+  case COL_ORIGIN_ASN:
+    return cols->origin_asn[row] != 0;
+  case COL_AS_PATH:
+    return row_has_path(cols, row);
+  default:
+    return 1;
+  }
+}
+
+// add the field node and validity bitmap of a column to the body
+static void body_add_validity(bgpstream_arrow_writer_t *writer, int col)
+{
+  bgpstream_elem_columns_t *cols = writer->cols;
+  uint8_t *bits;
+  int row, null_cnt = 0;
+
+  if (columns[col].nullable != 0) {
+    for (row = 0; row < cols->cnt; row++) {
+      null_cnt += !row_valid(cols, col, row);
+    }
+  }
+  body_add_node(writer, cols->cnt, null_cnt);
+  if (null_cnt == 0) {
+    body_add_buf(writer, 0);
+    return;
+  }
+  if ((bits = body_add_buf(writer, (cols->cnt + 7) / 8)) == NULL) {
+    return;
+  }
+  memset(bits, 0, (cols->cnt + 7) / 8);
+  for (row = 0; row < cols->cnt; row++) {
+    if (row_valid(cols, col, row)) {
+      bits[row / 8] |= 1 << (row % 8);
+    }
+  }
+}
+
+// add a column of fixed-width values to the body
+#define BODY_ADD_VALUES(writer, vtype, expr)                                   \
+  do {                                                                         \
+    vtype *vals;                                                               \
+    int row;                                                                   \
+    if ((vals = body_add_buf((writer), sizeof(vtype) * cols->cnt)) != NULL) {  \
+      for (row = 0; row < cols->cnt; row++) {                                  \
+        vals[row] = (expr);                                                    \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+// look up the as_path dictionary indexes of the rows, adding the paths that
+// are new to the dictionary
+static int index_paths(bgpstream_arrow_writer_t *writer)
+{
+  bgpstream_elem_columns_t *cols = writer->cols;
+  path_entry_t entry, *tmp;
+  uint64_t key;
+  khiter_t k;
+  int row, khret;
+
+  for (row = 0; row < cols->cnt; row++) {
+    writer->as_path[row] = 0;
+    if (row_has_path(cols, row) == 0) {
+      continue;
+    }
+    if ((entry.spath = bgpstream_as_path_store_get_store_path(
+           writer->path_store, cols->path_id[row])) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "AS path missing from store");
+      return -1;
+    }
+    entry.peer_asn = bgpstream_as_path_store_path_is_core(entry.spath) != 0
+                       ? cols->peer_asn[row]
+                       : 0;
+    key = ((uint64_t)bgpstream_as_path_store_path_get_idx(entry.spath) << 32) |
+          entry.peer_asn;
+
+    if ((k = kh_get(arrow_path, writer->paths, key)) !=
+        kh_end(writer->paths)) {
+      writer->as_path[row] = kh_val(writer->paths, k);
+      continue;
+    }
+
+    if (writer->new_paths_cnt == writer->new_paths_alloc) {
+      if ((tmp = realloc(writer->new_paths,
+                         sizeof(path_entry_t) *
+                           (writer->new_paths_alloc * 2 + 64))) == NULL) {
+        return -1;
+      }
+      writer->new_paths = tmp;
+      writer->new_paths_alloc = writer->new_paths_alloc * 2 + 64;
+    }
+    k = kh_put(arrow_path, writer->paths, key, &khret);
+    if (khret < 0) {
+      return -1;
+    }
+    writer->as_path[row] = kh_val(writer->paths, k) =
+      kh_size(writer->paths) - 1;
+    writer->new_paths[writer->new_paths_cnt++] = entry;
+  }
+  return 0;
+}
+
+static int write_rows(bgpstream_arrow_writer_t *writer)
+{
+  bgpstream_elem_columns_t *cols = writer->cols;
+  char buf[INET6_ADDRSTRLEN + 4];
+  int row;
+
+  if (writer->started == 0 && write_schema(writer) != 0) {
+    return -1;
+  }
+  if (cols->cnt == 0) {
+    return 0;
+  }
+
+  // dictionaries come before the batch that uses them (and are only
+  // written for the columns that are)
+  if ((writer->col_on[COL_AS_PATH] != 0 &&
+       (index_paths(writer) != 0 || write_path_dict(writer) != 0)) ||
+      (writer->col_on[COL_PROJECT] != 0 &&
+       write_str_dict(writer, &writer->projects, DICT_PROJECT) != 0) ||
+      (writer->col_on[COL_COLLECTOR] != 0 &&
+       write_str_dict(writer, &writer->collectors, DICT_COLLECTOR) != 0)) {
+    return -1;
+  }
+
+  body_reset(writer);
+
+  if (writer->col_on[COL_TYPE] != 0) {
+    body_add_validity(writer, COL_TYPE);
+    BODY_ADD_VALUES(writer, uint8_t, cols->type[row]);
+  }
+
+  if (writer->col_on[COL_TIME] != 0) {
+    body_add_validity(writer, COL_TIME);
+    BODY_ADD_VALUES(writer, int64_t, cols->time_sec[row]);
+  }
+
+  if (writer->col_on[COL_PROJECT] != 0) {
+    body_add_validity(writer, COL_PROJECT);
+    BODY_ADD_VALUES(writer, int32_t, writer->project[row]);
+  }
+
+  if (writer->col_on[COL_COLLECTOR] != 0) {
+    body_add_validity(writer, COL_COLLECTOR);
+    BODY_ADD_VALUES(writer, int32_t, writer->collector[row]);
+  }
+
+  if (writer->col_on[COL_PEER_ASN] != 0) {
+    body_add_validity(writer, COL_PEER_ASN);
+    BODY_ADD_VALUES(writer, uint32_t, cols->peer_asn[row]);
+  }
+
+  if (writer->col_on[COL_PREFIX] != 0) {
+    body_add_validity(writer, COL_PREFIX);
+    strings_reset(writer);
+    for (row = 0; row < cols->cnt; row++) {
+      if (row_valid(cols, COL_PREFIX, row) &&
+          bgpstream_pfx_snprintf(buf, sizeof(buf), &cols->prefix[row]) !=
+            NULL) {
+        strings_add(writer, buf);
+      } else {
+        strings_add(writer, NULL);
+      }
+    }
+    body_add_strings(writer);
+  }
+
+  if (writer->col_on[COL_ORIGIN_ASN] != 0) {
+    body_add_validity(writer, COL_ORIGIN_ASN);
+    BODY_ADD_VALUES(writer, uint32_t, cols->origin_asn[row]);
+  }
+
+  if (writer->col_on[COL_AS_PATH] != 0) {
+    body_add_validity(writer, COL_AS_PATH);
+    BODY_ADD_VALUES(writer, int32_t, writer->as_path[row]);
+  }
+
+  if (write_batch(writer, cols->cnt, -1) != 0) {
+    return -1;
+  }
+  bgpstream_elem_columns_clear(cols);
+  return 0;
+}
+
+// get the dictionary index of str
+static int32_t str_dict_get(str_dict_t *sd, const char *str)
+{
+  khiter_t k;
+  char *cpy, **tmp;
+  int khret;
+
+  // consecutive rows mostly come from the same collector
+  if (sd->cnt != 0 && strcmp(sd->strs[sd->last], str) == 0) {
+    return sd->last;
+  }
+  if ((k = kh_get(arrow_str, sd->idx, (char *)str)) != kh_end(sd->idx)) {
+    return (sd->last = kh_val(sd->idx, k));
+  }
+
+  if (sd->cnt == sd->alloc) {
+    if ((tmp = realloc(sd->strs, sizeof(char *) * (sd->alloc * 2 + 8))) ==
+        NULL) {
+      return -1;
+    }
+    sd->strs = tmp;
+    sd->alloc = sd->alloc * 2 + 8;
+  }
+  if ((cpy = strdup(str)) == NULL) {
+    return -1;
+  }
+  k = kh_put(arrow_str, sd->idx, cpy, &khret);
+  if (khret < 0) {
+    free(cpy);
+    return -1;
+  }
+  sd->strs[sd->cnt] = cpy;
+  return (sd->last = kh_val(sd->idx, k) = sd->cnt++);
+}
+
+static void str_dict_destroy(str_dict_t *sd)
+{
+  khiter_t k;
+
+  if (sd->idx != NULL) {
+    for (k = kh_begin(sd->idx); k != kh_end(sd->idx); ++k) {
+      if (kh_exist(sd->idx, k)) {
+        free(kh_key(sd->idx, k));
+      }
+    }
+    kh_destroy(arrow_str, sd->idx);
+    sd->idx = NULL;
+  }
+  free(sd->strs);
+  sd->strs = NULL;
+}
+
+// set the project and collector indexes of the rows from first onwards
+static int index_rows(bgpstream_arrow_writer_t *writer,
+                      const bgpstream_record_t *record, int first)
+{
+  int32_t project, collector, *tmp;
+  int alloc, row;
+
+  if (writer->cols->cnt > writer->rows_alloc) {
+    alloc = writer->rows_alloc == 0 ? 1024 : writer->rows_alloc;
+    while (alloc < writer->cols->cnt) {
+      alloc *= 2;
+    }
+#define GROW_ROWS(field)                                                       \
+  do {                                                                         \
+    if ((tmp = realloc(writer->field, sizeof(int32_t) * alloc)) == NULL) {    \
+      return -1;                                                               \
+    }                                                                          \
+    writer->field = tmp;                                                       \
+  } while (0)
+    GROW_ROWS(project);
+    GROW_ROWS(collector);
+    GROW_ROWS(as_path);
+#undef GROW_ROWS
+    writer->rows_alloc = alloc;
+  }
+
+  if ((project = str_dict_get(&writer->projects, record->project_name)) < 0 ||
+      (collector = str_dict_get(&writer->collectors,
+                                record->collector_name)) < 0) {
+    return -1;
+  }
+  for (row = first; row < writer->cols->cnt; row++) {
+    writer->project[row] = project;
+    writer->collector[row] = collector;
+  }
+
+  if (writer->cols->cnt >= ARROW_WRITER_BATCH_ROWS) {
+    return write_rows(writer);
+  }
+  return 0;
+}
+
+/* ========== PUBLIC FUNCTIONS BELOW ========== */
+
+bgpstream_arrow_writer_t *bgpstream_arrow_writer_create(const char *path)
+{
+  bgpstream_arrow_writer_t *writer;
+  int col;
+
+  if ((writer = malloc_zero(sizeof(bgpstream_arrow_writer_t))) == NULL) {
+    return NULL;
+  }
+  for (col = 0; col < COL_CNT; col++) {
+    writer->col_on[col] = 1;
+  }
+
+  if ((writer->path = strdup(path)) == NULL ||
+      (writer->path_store = bgpstream_as_path_store_create()) == NULL ||
+      (writer->cols = bgpstream_elem_columns_create(writer->path_store)) ==
+        NULL ||
+      (writer->paths = kh_init(arrow_path)) == NULL ||
+      (writer->projects.idx = kh_init(arrow_str)) == NULL ||
+      (writer->collectors.idx = kh_init(arrow_str)) == NULL) {
+    goto err;
+  }
+
+  if ((writer->iow = wandio_wcreate(path, wandio_detect_compression_type(path),
+                                    ARROW_WRITER_COMPRESS_LEVEL, O_CREAT)) ==
+      NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open %s for writing: %s",
+                  path, strerror(errno));
+    goto err;
+  }
+
+  return writer;
+
+err:
+  bgpstream_arrow_writer_destroy(writer);
+  return NULL;
+}
+
+int bgpstream_arrow_writer_set_columns(bgpstream_arrow_writer_t *writer,
+                                       const char *names)
+{
+  int col_on[COL_CNT] = {0};
+  const char *c = names, *end;
+  size_t len;
+  int col, cnt = 0;
+
+  if (writer->started != 0 || writer->cols->cnt != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Arrow columns must be set before any elem is added");
+    return -1;
+  }
+
+  while (*c != '\0') {
+    if ((end = strchr(c, ',')) == NULL) {
+      end = c + strlen(c);
+    }
+    len = end - c;
+    for (col = 0; col < COL_CNT; col++) {
+      if (strlen(columns[col].name) == len &&
+          strncmp(columns[col].name, c, len) == 0) {
+        break;
+      }
+    }
+    if (col == COL_CNT) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Unknown Arrow column '%.*s'",
+                    (int)len, c);
+      return -1;
+    }
+    cnt += !col_on[col];
+    col_on[col] = 1;
+    c = *end == ',' ? end + 1 : end;
+  }
+  if (cnt == 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "No Arrow columns given");
+    return -1;
+  }
+
+  memcpy(writer->col_on, col_on, sizeof(col_on));
+  return 0;
+}
+
+int bgpstream_arrow_writer_add_elem(bgpstream_arrow_writer_t *writer,
+                                    const bgpstream_record_t *record,
+                                    bgpstream_elem_t *elem)
+{
+  int first = writer->cols->cnt;
+
+  if (bgpstream_elem_columns_add_elem(writer->cols, record, elem) != 0) {
+    return -1;
+  }
+  return index_rows(writer, record, first);
+}
+
+int bgpstream_arrow_writer_write(bgpstream_arrow_writer_t *writer,
+                                 bgpstream_record_t *record)
+{
+  int first = writer->cols->cnt;
+  int cnt;
+
+  if ((cnt = bgpstream_record_get_elem_columns(record, writer->cols)) < 0 ||
+      (cnt > 0 && index_rows(writer, record, first) != 0)) {
+    return -1;
+  }
+  return cnt;
+}
+
+int bgpstream_arrow_writer_flush(bgpstream_arrow_writer_t *writer)
+{
+  return write_rows(writer);
+}
+
+void bgpstream_arrow_writer_destroy(bgpstream_arrow_writer_t *writer)
+{
+  // end-of-stream marker
+  static const uint8_t eos[8] = {0xff, 0xff, 0xff, 0xff, 0, 0, 0, 0};
+
+  if (writer == NULL) {
+    return;
+  }
+
+  if (writer->iow != NULL) {
+    if (write_rows(writer) != 0 || write_bytes(writer, eos, sizeof(eos)) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not finish Arrow stream %s",
+                    writer->path);
+    }
+    wandio_wdestroy(writer->iow);
+    writer->iow = NULL;
+  }
+
+  bgpstream_elem_columns_destroy(writer->cols);
+  writer->cols = NULL;
+  bgpstream_as_path_store_destroy(writer->path_store);
+  writer->path_store = NULL;
+  if (writer->paths != NULL) {
+    kh_destroy(arrow_path, writer->paths);
+    writer->paths = NULL;
+  }
+  str_dict_destroy(&writer->projects);
+  str_dict_destroy(&writer->collectors);
+
+  free(writer->project);
+  free(writer->collector);
+  free(writer->as_path);
+  free(writer->new_paths);
+  free(writer->meta.data);
+  free(writer->body.data);
+  free(writer->offsets.data);
+  free(writer->strs.data);
+
+  free(writer->path);
+  writer->path = NULL;
+
+  free(writer);
+}
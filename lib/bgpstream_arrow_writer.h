@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_ARROW_WRITER_H
+#define __BGPSTREAM_ARROW_WRITER_H
+
+#include "bgpstream_record.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of the BGPStream Arrow
+ * writer, which writes the elems read from a stream to an Apache Arrow IPC
+ * stream file.
+ *
+ * The file has one row per elem, with the following columns:
+ *
+ * - `type` (uint8): the elem type (see bgpstream_elem_type_t)
+ * - `time` (timestamp[s, UTC]): the collection time of the record
+ * - `project` (dictionary<int32, utf8>): the project name of the record
+ * - `collector` (dictionary<int32, utf8>): the collector name of the record
+ * - `peer_asn` (uint32): the peer AS number
+ * - `prefix` (utf8, nullable): the prefix, e.g., "192.0.2.0/24"
+ * - `origin_asn` (uint32, nullable): the origin AS number, null if the elem
+ *   has no AS path or the path does not end in a simple ASN
+ * - `as_path` (dictionary<int32, utf8>, nullable): the AS path, e.g.,
+ *   "25152 3356 15169", interned using an AS path store so that each distinct
+ *   path is only written once
+ *
+ * Only some of the columns may be written instead (see
+ * bgpstream_arrow_writer_set_columns), in which case the work of building the
+ * others (e.g., interning AS paths) is skipped as well.
+ *
+ * Rows are written in record batches of up to 65536 rows, each preceded by
+ * deltas of the dictionaries that hold the strings the batch adds.
+ */
+
+/**
+ * @name Public Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure that represents an Arrow IPC stream being written */
+typedef struct bgpstream_arrow_writer bgpstream_arrow_writer_t;
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new Arrow writer
+ *
+ * @param path          path of the file to write (compressed according to its
+ *                      extension, e.g., ".gz" or ".bz2")
+ * @return pointer to the writer if successful, NULL otherwise
+ */
+bgpstream_arrow_writer_t *bgpstream_arrow_writer_create(const char *path);
+
+/** Set which columns are written to the Arrow stream
+ *
+ * @param writer        pointer to the writer
+ * @param names         comma-separated names of the columns to write (e.g.,
+ *                      "time,prefix,as_path")
+ * @return 0 if the columns were set, -1 if a name is unknown, no column is
+ *         given, or elems have already been added
+ *
+ * The columns are always written in the order listed above, whatever the
+ * order of the names.
+ */
+int bgpstream_arrow_writer_set_columns(bgpstream_arrow_writer_t *writer,
+                                       const char *names);
+
+/** Add the given elem to the Arrow stream
+ *
+ * @param writer        pointer to the writer
+ * @param record        pointer to the record the elem came from
+ * @param elem          pointer to the elem to add (e.g., as returned by
+ *                      bgpstream_record_get_next_elem)
+ * @return 0 if the elem was added, -1 if an error occurred
+ *
+ * Elems are buffered, and written once a full record batch has been added (or
+ * the writer is flushed).
+ */
+int bgpstream_arrow_writer_add_elem(bgpstream_arrow_writer_t *writer,
+                                    const bgpstream_record_t *record,
+                                    bgpstream_elem_t *elem);
+
+/** Add the remaining elems of the given record to the Arrow stream
+ *
+ * @param writer        pointer to the writer
+ * @param record        pointer to the record to take the elems from
+ * @return the number of elems added, -1 if an error occurred
+ *
+ * This consumes the elems of the record in the same way as
+ * bgpstream_record_get_elem_columns.
+ */
+int bgpstream_arrow_writer_write(bgpstream_arrow_writer_t *writer,
+                                 bgpstream_record_t *record);
+
+/** Write the elems that have been added as a record batch
+ *
+ * @param writer        pointer to the writer
+ * @return 0 if successful, -1 if an error occurred
+ */
+int bgpstream_arrow_writer_flush(bgpstream_arrow_writer_t *writer);
+
+/** Flush and close the Arrow stream, and destroy the writer
+ *
+ * @param writer        pointer to the writer to destroy
+ */
+void bgpstream_arrow_writer_destroy(bgpstream_arrow_writer_t *writer);
+
+/** @} */
+
+#endif /* __BGPSTREAM_ARROW_WRITER_H */
@@ -77,6 +77,11 @@ char *bgpstream_record_elem_bgpdump_snprintf(char *buf, size_t len,
     return buf;
   }
 
+  /* a lazy elem is logically unchanged by decoding its attributes */
+  if (bgpstream_elem_get_as_path((bgpstream_elem_t *)elem) == NULL) {
+    return NULL;
+  }
+
   /* Record type */
   switch (elem->type) {
   case BGPSTREAM_ELEM_TYPE_RIB:
@@ -0,0 +1,405 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_binary.h"
+#include "bgpstream_log.h"
+#include "khash.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+// byte order of this host, as given in the stream header
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_BYTE_ORDER 2
+#else
+#define HOST_BYTE_ORDER 1
+#endif
+
+KHASH_INIT(bsbin_str, char *, uint16_t, 1, kh_str_hash_func,
+           kh_str_hash_equal)
+
+struct bgpstream_binary_writer {
+
+  // encoded bytes of the current record (and the frames that precede it)
+  uint8_t *buf;
+  size_t len;
+  size_t alloc;
+
+  // offsets of the record frame, and of its elem count
+  size_t rec_off;
+  size_t cnt_off;
+  uint32_t elem_cnt;
+
+  // has the stream header been written
+  int started;
+
+  // IDs of the strings that have been written (owned keys)
+  khash_t(bsbin_str) * strings;
+  uint16_t next_str_id;
+};
+
+// makes room for len more bytes
+static int reserve(bgpstream_binary_writer_t *writer, size_t len)
+{
+  uint8_t *tmp;
+  size_t alloc = writer->alloc == 0 ? 4096 : writer->alloc;
+
+  if (writer->len + len <= writer->alloc) {
+    return 0;
+  }
+  while (alloc < writer->len + len) {
+    alloc *= 2;
+  }
+  if ((tmp = realloc(writer->buf, alloc)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not grow binary record buffer");
+    return -1;
+  }
+  writer->buf = tmp;
+  writer->alloc = alloc;
+  return 0;
+}
+
+#define PUT(writer, val)                                                       \
+  do {                                                                         \
+    memcpy((writer)->buf + (writer)->len, &(val), sizeof(val));                \
+    (writer)->len += sizeof(val);                                              \
+  } while (0)
+
+#define PUT_U8(writer, val)                                                    \
+  do {                                                                         \
+    uint8_t u8 = (val);                                                        \
+    PUT(writer, u8);                                                           \
+  } while (0)
+
+#define PUT_U16(writer, val)                                                   \
+  do {                                                                         \
+    uint16_t u16 = (val);                                                      \
+    PUT(writer, u16);                                                          \
+  } while (0)
+
+#define PUT_U32(writer, val)                                                   \
+  do {                                                                         \
+    uint32_t u32 = (val);                                                      \
+    PUT(writer, u32);                                                          \
+  } while (0)
+
+static void put_bytes(bgpstream_binary_writer_t *writer, const void *buf,
+                      size_t len)
+{
+  memcpy(writer->buf + writer->len, buf, len);
+  writer->len += len;
+}
+
+// an address takes at most 17 bytes
+#define ADDR_MAX_LEN 17
+
+static void put_addr(bgpstream_binary_writer_t *writer,
+                     const bgpstream_ip_addr_t *addr)
+{
+  switch (addr->version) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    PUT_U8(writer, 4);
+    put_bytes(writer, &addr->bs_ipv4.addr, sizeof(addr->bs_ipv4.addr));
+    break;
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    PUT_U8(writer, 6);
+    put_bytes(writer, &addr->bs_ipv6.addr, sizeof(addr->bs_ipv6.addr));
+    break;
+
+  default:
+    PUT_U8(writer, 0);
+    break;
+  }
+}
+
+// writes the frame header, leaving the length to be set by end_frame
+static size_t begin_frame(bgpstream_binary_writer_t *writer,
+                          bgpstream_binary_frame_type_t type)
+{
+  size_t off = writer->len;
+  PUT_U32(writer, 0);
+  PUT_U8(writer, type);
+  return off;
+}
+
+static void end_frame(bgpstream_binary_writer_t *writer, size_t off)
+{
+  uint32_t len = writer->len - off;
+  memcpy(writer->buf + off, &len, sizeof(len));
+}
+
+// finds the ID of the given string, writing its definition if needed
+static int intern(bgpstream_binary_writer_t *writer, const char *str,
+                  uint16_t *id)
+{
+  khiter_t k;
+  int khret;
+  size_t len = strlen(str);
+  size_t off;
+  char *cpy;
+
+  if (len == 0) {
+    *id = 0;
+    return 0;
+  }
+  if ((k = kh_get(bsbin_str, writer->strings, (char *)str)) !=
+      kh_end(writer->strings)) {
+    *id = kh_val(writer->strings, k);
+    return 0;
+  }
+
+  if (len > UINT8_MAX) {
+    len = UINT8_MAX;
+  }
+  // the string only gets an ID once nothing can stop its definition from
+  // being written, since later records would otherwise refer to an undefined
+  // ID
+  if (reserve(writer, BGPSTREAM_BINARY_FRAME_HDR_LEN + 3 + len) != 0 ||
+      (cpy = strdup(str)) == NULL) {
+    return -1;
+  }
+  k = kh_put(bsbin_str, writer->strings, cpy, &khret);
+  if (khret == -1) {
+    free(cpy);
+    return -1;
+  }
+  *id = kh_val(writer->strings, k) = ++writer->next_str_id;
+
+  off = begin_frame(writer, BGPSTREAM_BINARY_FRAME_STRING);
+  PUT_U16(writer, *id);
+  PUT_U8(writer, len);
+  put_bytes(writer, str, len);
+  end_frame(writer, off);
+  return 0;
+}
+
+/* ==================== PUBLIC API BELOW HERE ==================== */
+
+bgpstream_binary_writer_t *bgpstream_binary_writer_create(void)
+{
+  bgpstream_binary_writer_t *writer;
+
+  if ((writer = malloc_zero(sizeof(bgpstream_binary_writer_t))) == NULL) {
+    return NULL;
+  }
+
+  if ((writer->strings = kh_init(bsbin_str)) == NULL) {
+    bgpstream_binary_writer_destroy(writer);
+    return NULL;
+  }
+
+  return writer;
+}
+
+int bgpstream_binary_writer_begin_record(bgpstream_binary_writer_t *writer,
+                                         const bgpstream_record_t *record)
+{
+  uint16_t project, collector, router;
+  size_t off;
+
+  writer->len = 0;
+  writer->elem_cnt = 0;
+
+  // start a new stream if the record might need more IDs than are left
+  if (writer->next_str_id > UINT16_MAX - 3) {
+    bgpstream_binary_writer_reset(writer);
+  }
+
+  if (writer->started == 0) {
+    if (reserve(writer, BGPSTREAM_BINARY_FRAME_HDR_LEN + 6) != 0) {
+      return -1;
+    }
+    off = begin_frame(writer, BGPSTREAM_BINARY_FRAME_HEADER);
+    put_bytes(writer, BGPSTREAM_BINARY_MAGIC, 4);
+    PUT_U8(writer, BGPSTREAM_BINARY_VERSION);
+    PUT_U8(writer, HOST_BYTE_ORDER);
+    end_frame(writer, off);
+    writer->started = 1;
+  }
+
+  if (intern(writer, record->project_name, &project) != 0 ||
+      intern(writer, record->collector_name, &collector) != 0 ||
+      intern(writer, record->router_name, &router) != 0) {
+    return -1;
+  }
+
+  if (reserve(writer, BGPSTREAM_BINARY_FRAME_HDR_LEN + 25 + ADDR_MAX_LEN) !=
+      0) {
+    return -1;
+  }
+  writer->rec_off = begin_frame(writer, BGPSTREAM_BINARY_FRAME_RECORD);
+  PUT_U32(writer, record->time_sec);
+  PUT_U32(writer, record->time_usec);
+  PUT_U32(writer, record->dump_time_sec);
+  PUT_U8(writer, record->type);
+  PUT_U8(writer, record->status);
+  PUT_U8(writer, record->dump_pos);
+  PUT_U16(writer, project);
+  PUT_U16(writer, collector);
+  PUT_U16(writer, router);
+  put_addr(writer, &record->router_ip);
+  writer->cnt_off = writer->len;
+  PUT_U32(writer, 0);
+
+  return 0;
+}
+
+int bgpstream_binary_writer_add_elem(bgpstream_binary_writer_t *writer,
+                                     bgpstream_elem_t *elem)
+{
+  bgpstream_as_path_t *path = bgpstream_elem_get_as_path(elem);
+  bgpstream_community_set_t *comms = bgpstream_elem_get_communities(elem);
+  uint8_t *path_data = NULL;
+  uint16_t path_len = 0;
+  int comm_cnt = 0, large_cnt = 0;
+  uint8_t flags = 0;
+  int i;
+
+  if (path != NULL) {
+    path_len = bgpstream_as_path_get_data(path, &path_data);
+  }
+  if (comms != NULL) {
+    comm_cnt = bgpstream_community_set_size(comms);
+    large_cnt = bgpstream_community_set_large_size(comms);
+  }
+
+  if (reserve(writer, 43 + (4 * ADDR_MAX_LEN) + path_len +
+                        (comm_cnt * sizeof(bgpstream_community_t)) +
+                        (large_cnt * sizeof(bgpstream_large_community_t))) !=
+      0) {
+    return -1;
+  }
+
+  PUT_U8(writer, elem->type);
+  PUT_U32(writer, elem->orig_time_sec);
+  PUT_U32(writer, elem->orig_time_usec);
+  put_addr(writer, &elem->peer_ip);
+  PUT_U32(writer, elem->peer_asn);
+  PUT_U8(writer, elem->prefix.mask_len);
+  put_addr(writer, &elem->prefix.address);
+  put_addr(writer, &elem->nexthop);
+
+  PUT_U16(writer, path_len);
+  if (path_len > 0) {
+    put_bytes(writer, path_data, path_len);
+  }
+
+  // communities (and large communities) are aligned within the frame so that
+  // readers can use them in place
+  PUT_U16(writer, comm_cnt);
+  if (comm_cnt > 0) {
+    while (((writer->len - writer->rec_off) & 3) != 0) {
+      PUT_U8(writer, 0);
+    }
+  }
+  for (i = 0; i < comm_cnt; i++) {
+    put_bytes(writer, bgpstream_community_set_get(comms, i),
+              sizeof(bgpstream_community_t));
+  }
+
+  PUT_U16(writer, large_cnt);
+  if (large_cnt > 0) {
+    while (((writer->len - writer->rec_off) & 3) != 0) {
+      PUT_U8(writer, 0);
+    }
+  }
+  for (i = 0; i < large_cnt; i++) {
+    put_bytes(writer, bgpstream_community_set_get_large(comms, i),
+              sizeof(bgpstream_large_community_t));
+  }
+
+  PUT_U8(writer, elem->old_state);
+  PUT_U8(writer, elem->new_state);
+
+  if (elem->has_origin != 0) {
+    flags |= BGPSTREAM_BINARY_ELEM_HAS_ORIGIN;
+  }
+  if (elem->has_med != 0) {
+    flags |= BGPSTREAM_BINARY_ELEM_HAS_MED;
+  }
+  if (elem->has_local_pref != 0) {
+    flags |= BGPSTREAM_BINARY_ELEM_HAS_LOCAL_PREF;
+  }
+  if (elem->atomic_aggregate != 0) {
+    flags |= BGPSTREAM_BINARY_ELEM_ATOMIC_AGGREGATE;
+  }
+  if (elem->aggregator.has_aggregator != 0) {
+    flags |= BGPSTREAM_BINARY_ELEM_HAS_AGGREGATOR;
+  }
+  PUT_U8(writer, flags);
+  PUT_U8(writer, elem->origin);
+  PUT_U32(writer, elem->med);
+  PUT_U32(writer, elem->local_pref);
+  PUT_U32(writer, elem->aggregator.aggregator_asn);
+  put_addr(writer, &elem->aggregator.aggregator_addr);
+
+  writer->elem_cnt++;
+  return 0;
+}
+
+ssize_t bgpstream_binary_writer_end_record(bgpstream_binary_writer_t *writer,
+                                           const uint8_t **buf)
+{
+  memcpy(writer->buf + writer->cnt_off, &writer->elem_cnt,
+         sizeof(writer->elem_cnt));
+  end_frame(writer, writer->rec_off);
+
+  *buf = writer->buf;
+  return writer->len;
+}
+
+void bgpstream_binary_writer_reset(bgpstream_binary_writer_t *writer)
+{
+  khiter_t k;
+
+  for (k = kh_begin(writer->strings); k != kh_end(writer->strings); ++k) {
+    if (kh_exist(writer->strings, k)) {
+      free(kh_key(writer->strings, k));
+    }
+  }
+  kh_clear(bsbin_str, writer->strings);
+  writer->next_str_id = 0;
+  writer->started = 0;
+}
+
+void bgpstream_binary_writer_destroy(bgpstream_binary_writer_t *writer)
+{
+  if (writer == NULL) {
+    return;
+  }
+
+  if (writer->strings != NULL) {
+    bgpstream_binary_writer_reset(writer);
+    kh_destroy(bsbin_str, writer->strings);
+    writer->strings = NULL;
+  }
+
+  free(writer->buf);
+  writer->buf = NULL;
+
+  free(writer);
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_BINARY_H
+#define __BGPSTREAM_BINARY_H
+
+#include "bgpstream_elem.h"
+#include "bgpstream_record.h"
+#include <sys/types.h>
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of the BGPStream binary
+ * format, a compact encoding of records and their elems for passing them
+ * between processes.
+ *
+ * A binary stream is a sequence of frames. Each frame starts with a 5-byte
+ * header: the length of the whole frame (uint32, including the header) and
+ * the frame type (uint8, see bgpstream_binary_frame_type_t). Integers are in
+ * the byte order of the host that wrote the stream, which is given by the
+ * stream header, and AS paths and communities are stored in the same layout
+ * that BGPStream uses in memory, so that a reader can point elems at them
+ * rather than copying them. Frames of unknown types are skipped by readers.
+ *
+ * Streams written using a bgpstream_binary_writer_t can be read back using the
+ * "binary" resource format (e.g., the "rib-type" and "upd-type" options of the
+ * singlefile data interface).
+ */
+
+/**
+ * @name Public Constants
+ *
+ * @{ */
+
+/** Version of the binary encoding written by this library */
+#define BGPSTREAM_BINARY_VERSION 3
+
+/** Magic bytes at the start of the stream header frame body */
+#define BGPSTREAM_BINARY_MAGIC "BSBF"
+
+/** Length of the header at the start of every frame */
+#define BGPSTREAM_BINARY_FRAME_HDR_LEN 5
+
+/** @} */
+
+/**
+ * @name Public Enums
+ *
+ * @{ */
+
+/** Types of the frames in a binary stream */
+typedef enum {
+
+  /** Stream header: the magic bytes, the version (uint8) and the byte order
+   * (uint8, 1 for little-endian, 2 for big-endian). Starts a stream, and
+   * forgets the strings defined before it. */
+  BGPSTREAM_BINARY_FRAME_HEADER = 1,
+
+  /** Interned string: its ID (uint16, never 0, which is the empty string),
+   * its length (uint8) and its characters (not NUL-terminated) */
+  BGPSTREAM_BINARY_FRAME_STRING = 2,
+
+  /** A record: time_sec, time_usec and dump_time_sec (uint32), type, status
+   * and dump_pos (uint8), the IDs of the project, collector and router names
+   * (uint16), the router IP, and the number of elems (uint32), followed by the
+   * elems.
+   *
+   * Each elem is: type (uint8), orig_time_sec and orig_time_usec (uint32),
+   * peer IP, peer ASN (uint32), prefix length (uint8), prefix address,
+   * next-hop, AS path length (uint16) and data, community count (uint16) and
+   * (if there are any) 0-3 bytes of padding, so that they start at a multiple
+   * of 4 bytes from the start of the frame, and communities (4 bytes each),
+   * large community count (uint16), padded in the same way, and large
+   * communities (12 bytes each), old_state and new_state (uint8), flags
+   * (uint8, see bgpstream_binary_elem_flag_t), origin (uint8), MED and
+   * LOCAL_PREF (uint32), aggregator ASN (uint32) and aggregator address.
+   * Version 1 streams have no large communities (nor their count), and streams
+   * before version 3 do not pad communities.
+   *
+   * Each IP address is a version (uint8: 0, 4 or 6), followed by 0, 4 or 16
+   * bytes of address (in network byte order).
+   */
+  BGPSTREAM_BINARY_FRAME_RECORD = 3,
+
+} bgpstream_binary_frame_type_t;
+
+/** Flags of an encoded elem that say which of its optional fields are set */
+typedef enum {
+
+  /** The origin field is valid */
+  BGPSTREAM_BINARY_ELEM_HAS_ORIGIN = 0x01,
+
+  /** The MED field is valid */
+  BGPSTREAM_BINARY_ELEM_HAS_MED = 0x02,
+
+  /** The LOCAL_PREF field is valid */
+  BGPSTREAM_BINARY_ELEM_HAS_LOCAL_PREF = 0x04,
+
+  /** The ATOMIC_AGGREGATE attribute was present */
+  BGPSTREAM_BINARY_ELEM_ATOMIC_AGGREGATE = 0x08,
+
+  /** The aggregator fields are valid */
+  BGPSTREAM_BINARY_ELEM_HAS_AGGREGATOR = 0x10,
+
+} bgpstream_binary_elem_flag_t;
+
+/** @} */
+
+/**
+ * @name Public Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure that encodes records into a binary stream */
+typedef struct bgpstream_binary_writer bgpstream_binary_writer_t;
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new binary writer
+ *
+ * @return pointer to the writer if successful, NULL otherwise
+ */
+bgpstream_binary_writer_t *bgpstream_binary_writer_create(void);
+
+/** Start encoding the given record
+ *
+ * @param writer        pointer to the writer
+ * @param record        pointer to the record to encode
+ * @return 0 if successful, -1 otherwise
+ *
+ * The elems of the record are then added using bgpstream_binary_writer_add_elem
+ * (so the caller chooses which elems to keep), and the encoding is finished
+ * using bgpstream_binary_writer_end_record.
+ */
+int bgpstream_binary_writer_begin_record(bgpstream_binary_writer_t *writer,
+                                         const bgpstream_record_t *record);
+
+/** Add the given elem to the record being encoded
+ *
+ * @param writer        pointer to the writer
+ * @param elem          pointer to the elem to add
+ * @return 0 if successful, -1 otherwise
+ */
+int bgpstream_binary_writer_add_elem(bgpstream_binary_writer_t *writer,
+                                     bgpstream_elem_t *elem);
+
+/** Finish encoding the current record
+ *
+ * @param writer        pointer to the writer
+ * @param[out] buf      set to point to the encoded bytes
+ * @return the number of encoded bytes, or -1 if an error occurred
+ *
+ * The encoded bytes start with the stream header if this is the first record
+ * written (or the writer was reset), and with the definitions of any strings
+ * not yet written, so they may be written out (or sent) as they are. The
+ * buffer belongs to the writer, and is valid until the next record is begun.
+ */
+ssize_t bgpstream_binary_writer_end_record(bgpstream_binary_writer_t *writer,
+                                           const uint8_t **buf);
+
+/** Start a new stream
+ *
+ * @param writer        pointer to the writer
+ *
+ * The next record is encoded with a new stream header, and with all the
+ * strings it uses, so that it can be decoded without the records before it
+ * (e.g., when each record is sent in its own message).
+ */
+void bgpstream_binary_writer_reset(bgpstream_binary_writer_t *writer);
+
+/** Destroy the given binary writer
+ *
+ * @param writer        pointer to the writer to destroy
+ */
+void bgpstream_binary_writer_destroy(bgpstream_binary_writer_t *writer);
+
+/** @} */
+
+#endif /* __BGPSTREAM_BINARY_H */
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_breaker.h"
+#include "bgpstream_log.h"
+#include "khash.h"
+#include "utils.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Consecutive failed opens (of different URLs) after which a host is not
+   tried for a while */
+#define BREAKER_THRESHOLD 3
+
+/* How long a host is not tried for the first time it trips (in msec), and the
+   longest it is not tried for after failing its probes */
+#define BREAKER_MIN_COOLDOWN_MSEC 15000
+#define BREAKER_MAX_COOLDOWN_MSEC 600000
+
+/* Longest host name that we track (longer ones are truncated) */
+#define BREAKER_HOST_LEN 256
+
+typedef struct host_state {
+  // consecutive failed opens (of different URLs)
+  int failures;
+
+  // hash of the URL that failed last, so that retries of a single bad file do
+  // not trip the host
+  uint64_t last_url;
+
+  // when the host may be tried again (0 if it is not tripped)
+  uint64_t open_until;
+
+  // how long the host is not tried for the next time it trips
+  uint32_t cooldown;
+
+  // set while the open that probes a tripped host is under way
+  int probing;
+} host_state_t;
+
+KHASH_INIT(breaker_host, char *, host_state_t, 1, kh_str_hash_func,
+           kh_str_hash_equal)
+
+struct bgpstream_breaker {
+  pthread_mutex_t mutex;
+
+  // host name -> state (the keys are owned by the table)
+  khash_t(breaker_host) * hosts;
+};
+
+// copies the host of the given URL into buf. returns 0 if it has none
+static int get_host(const char *url, char *buf)
+{
+  const char *start, *end;
+  size_t len;
+
+  if ((start = strstr(url, "://")) == NULL) {
+    return 0;
+  }
+  start += 3;
+  // the host is everything up to the path (the port included)
+  end = start + strcspn(start, "/?#");
+  if ((len = end - start) == 0) {
+    return 0;
+  }
+  if (len >= BREAKER_HOST_LEN) {
+    len = BREAKER_HOST_LEN - 1;
+  }
+  memcpy(buf, start, len);
+  buf[len] = '\0';
+  return 1;
+}
+
+static uint64_t url_hash(const char *url)
+{
+  uint64_t h = 5381;
+
+  for (; *url != '\0'; url++) {
+    h = h * 33 + (unsigned char)*url;
+  }
+  return h;
+}
+
+// returns the state of the given host, adding it if needed. must be called
+// with the mutex held
+static host_state_t *get_state(bgpstream_breaker_t *breaker, const char *host)
+{
+  host_state_t *hs;
+  khiter_t k;
+  char *key;
+  int khret;
+
+  if ((k = kh_get(breaker_host, breaker->hosts, (char *)host)) !=
+      kh_end(breaker->hosts)) {
+    return &kh_val(breaker->hosts, k);
+  }
+  if ((key = strdup(host)) == NULL) {
+    return NULL;
+  }
+  k = kh_put(breaker_host, breaker->hosts, key, &khret);
+  if (khret < 0) {
+    free(key);
+    return NULL;
+  }
+  hs = &kh_val(breaker->hosts, k);
+  memset(hs, 0, sizeof(*hs));
+  hs->cooldown = BREAKER_MIN_COOLDOWN_MSEC;
+  return hs;
+}
+
+/* ========== PUBLIC FUNCTIONS BELOW ========== */
+
+bgpstream_breaker_t *bgpstream_breaker_create(void)
+{
+  bgpstream_breaker_t *breaker;
+
+  if ((breaker = malloc_zero(sizeof(bgpstream_breaker_t))) == NULL) {
+    return NULL;
+  }
+  if ((breaker->hosts = kh_init(breaker_host)) == NULL) {
+    free(breaker);
+    return NULL;
+  }
+  pthread_mutex_init(&breaker->mutex, NULL);
+  return breaker;
+}
+
+void bgpstream_breaker_destroy(bgpstream_breaker_t *breaker)
+{
+  khiter_t k;
+
+  if (breaker == NULL) {
+    return;
+  }
+  for (k = kh_begin(breaker->hosts); k != kh_end(breaker->hosts); k++) {
+    if (kh_exist(breaker->hosts, k)) {
+      free(kh_key(breaker->hosts, k));
+    }
+  }
+  kh_destroy(breaker_host, breaker->hosts);
+  pthread_mutex_destroy(&breaker->mutex);
+  free(breaker);
+}
+
+uint32_t bgpstream_breaker_check(bgpstream_breaker_t *breaker,
+                                 const char *url)
+{
+  char host[BREAKER_HOST_LEN];
+  host_state_t *hs;
+  uint64_t now;
+  uint32_t wait = 0;
+
+  if (breaker == NULL || get_host(url, host) == 0) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&breaker->mutex);
+  if ((hs = get_state(breaker, host)) == NULL || hs->open_until == 0) {
+    // untracked hosts are tried rather than refused
+    goto done;
+  }
+  now = epoch_msec();
+  if (now < hs->open_until) {
+    wait = hs->open_until - now;
+  } else if (hs->probing != 0) {
+    // someone else is probing the host, try again once they should be done
+    wait = BREAKER_MIN_COOLDOWN_MSEC;
+  } else {
+    hs->probing = 1;
+  }
+
+done:
+  pthread_mutex_unlock(&breaker->mutex);
+  return wait;
+}
+
+void bgpstream_breaker_report(bgpstream_breaker_t *breaker, const char *url,
+                              int ok)
+{
+  char host[BREAKER_HOST_LEN];
+  host_state_t *hs;
+
+  if (breaker == NULL || get_host(url, host) == 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&breaker->mutex);
+  if ((hs = get_state(breaker, host)) == NULL) {
+    goto done;
+  }
+  if (ok != 0) {
+    if (hs->open_until != 0) {
+      bgpstream_log(BGPSTREAM_LOG_INFO, "Host %s is back, opening from it",
+                    host);
+    }
+    memset(hs, 0, sizeof(*hs));
+    hs->cooldown = BREAKER_MIN_COOLDOWN_MSEC;
+    goto done;
+  }
+
+  if (hs->probing == 0 && url_hash(url) == hs->last_url) {
+    goto done;
+  }
+  hs->last_url = url_hash(url);
+  hs->failures++;
+  if (hs->probing != 0 || hs->failures == BREAKER_THRESHOLD) {
+    bgpstream_log(BGPSTREAM_LOG_WARN,
+                  "Could not open from %s %d times in a row, not trying it "
+                  "for %" PRIu32 " sec",
+                  host, hs->failures, hs->cooldown / 1000);
+    hs->open_until = epoch_msec() + hs->cooldown;
+    // a host that keeps failing its probes is tried less and less often
+    if (hs->probing != 0) {
+      hs->cooldown *= 2;
+      if (hs->cooldown > BREAKER_MAX_COOLDOWN_MSEC) {
+        hs->cooldown = BREAKER_MAX_COOLDOWN_MSEC;
+      }
+    }
+    hs->probing = 0;
+  }
+
+done:
+  pthread_mutex_unlock(&breaker->mutex);
+}
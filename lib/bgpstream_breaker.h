@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_BREAKER_H
+#define __BGPSTREAM_BREAKER_H
+
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Header file for the circuit breaker of a stream, which keeps track of
+ * the hosts that resources fail to open from. Once opens from a host have
+ * failed several times in a row, the host is not tried again until a cooldown
+ * has passed, after which one open is let through to probe it. The breaker
+ * may be used from any thread.
+ */
+
+/** Opaque structure that holds the state of the hosts of a stream */
+typedef struct bgpstream_breaker bgpstream_breaker_t;
+
+/** Create a circuit breaker
+ *
+ * @return pointer to the breaker if successful, NULL otherwise
+ */
+bgpstream_breaker_t *bgpstream_breaker_create(void);
+
+/** Destroy the given circuit breaker */
+void bgpstream_breaker_destroy(bgpstream_breaker_t *breaker);
+
+/** Check whether the host of the given URL may be tried
+ *
+ * @param breaker       pointer to the breaker (may be NULL, in which case every
+ *                      host may be tried)
+ * @param url           URL to open
+ * @return 0 if the URL may be opened now, otherwise how long (in msec) until
+ * its host may be tried again
+ *
+ * URLs without a host (e.g., local files) may always be opened. If this
+ * returns 0, the outcome of the open must be given to
+ * bgpstream_breaker_report.
+ */
+uint32_t bgpstream_breaker_check(bgpstream_breaker_t *breaker,
+                                 const char *url);
+
+/** Report the outcome of opening the given URL
+ *
+ * @param breaker       pointer to the breaker (may be NULL)
+ * @param url           URL that was opened
+ * @param ok            non-zero if the open succeeded
+ */
+void bgpstream_breaker_report(bgpstream_breaker_t *breaker, const char *url,
+                              int ok);
+
+#endif /* __BGPSTREAM_BREAKER_H */
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_context.h"
+#include "bgpstream_affinity.h"
+#include "bgpstream_log.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+/* Number of worker threads shared by the streams of a context, unless
+   configured otherwise (the same as a single stream starts) */
+#define CONTEXT_DEFAULT_WORKER_THREADS 16
+
+/* Most records (of each format type) to keep for reuse by the streams of a
+   context */
+#define CONTEXT_RECORD_POOL_SIZE 4096
+
+struct bgpstream_context {
+
+  // references held by the user and by the streams of the context
+  int refcnt;
+
+  // records given back by the closed readers of every stream
+  bgpstream_record_pool_t *record_pool;
+
+  // hosts that resources keep failing to open from
+  bgpstream_breaker_t *breaker;
+
+  // number of worker threads to start the pool with, and where they run
+  int worker_threads;
+  bgpstream_affinity_t affinity;
+
+  // ALL BELOW HERE MUST USE MUTEX
+  pthread_mutex_t mutex;
+
+  // pool of threads that open (and decode) resources for every stream (started
+  // when the first stream opens a resource)
+  bgpstream_worker_pool_t *pool;
+};
+
+/* ========== PUBLIC FUNCTIONS BELOW ========== */
+
+bgpstream_context_t *bgpstream_context_create(void)
+{
+  bgpstream_context_t *ctx;
+
+  if ((ctx = malloc_zero(sizeof(bgpstream_context_t))) == NULL) {
+    return NULL;
+  }
+  ctx->refcnt = 1;
+  ctx->worker_threads = CONTEXT_DEFAULT_WORKER_THREADS;
+  pthread_mutex_init(&ctx->mutex, NULL);
+
+  if ((ctx->record_pool =
+         bgpstream_record_pool_create(CONTEXT_RECORD_POOL_SIZE)) == NULL ||
+      (ctx->breaker = bgpstream_breaker_create()) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create stream context");
+    bgpstream_context_destroy(ctx);
+    return NULL;
+  }
+
+  return ctx;
+}
+
+int bgpstream_context_set_worker_threads(bgpstream_context_t *ctx,
+                                         int threads)
+{
+  int rc = -1;
+
+  pthread_mutex_lock(&ctx->mutex);
+  if (ctx->pool == NULL && threads > 0) {
+    ctx->worker_threads = threads;
+    rc = 0;
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+
+  return rc;
+}
+
+int bgpstream_context_set_thread_affinity(bgpstream_context_t *ctx,
+                                          bgpstream_thread_affinity_t policy,
+                                          const char *cpus)
+{
+  int rc = -1;
+
+  pthread_mutex_lock(&ctx->mutex);
+  if (ctx->pool == NULL) {
+    rc = bgpstream_affinity_init(&ctx->affinity, policy, cpus);
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+
+  return rc;
+}
+
+bgpstream_context_t *bgpstream_context_retain(bgpstream_context_t *ctx)
+{
+  __atomic_add_fetch(&ctx->refcnt, 1, __ATOMIC_RELAXED);
+  return ctx;
+}
+
+bgpstream_worker_pool_t *bgpstream_context_get_pool(bgpstream_context_t *ctx)
+{
+  bgpstream_worker_pool_t *pool;
+
+  pthread_mutex_lock(&ctx->mutex);
+  if (ctx->pool == NULL &&
+      (ctx->pool = bgpstream_worker_pool_create(ctx->worker_threads,
+                                                &ctx->affinity)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Failed to create shared worker pool");
+  }
+  pool = ctx->pool;
+  pthread_mutex_unlock(&ctx->mutex);
+
+  return pool;
+}
+
+bgpstream_record_pool_t *
+bgpstream_context_get_record_pool(bgpstream_context_t *ctx)
+{
+  return ctx->record_pool;
+}
+
+bgpstream_breaker_t *bgpstream_context_get_breaker(bgpstream_context_t *ctx)
+{
+  return ctx->breaker;
+}
+
+void bgpstream_context_destroy(bgpstream_context_t *ctx)
+{
+  if (ctx == NULL ||
+      __atomic_sub_fetch(&ctx->refcnt, 1, __ATOMIC_ACQ_REL) != 0) {
+    return;
+  }
+
+  // every stream is gone, so the workers are idle
+  bgpstream_worker_pool_destroy(ctx->pool);
+  ctx->pool = NULL;
+
+  // and no longer need their records
+  bgpstream_record_pool_destroy(ctx->record_pool);
+  ctx->record_pool = NULL;
+
+  bgpstream_breaker_destroy(ctx->breaker);
+  ctx->breaker = NULL;
+
+  pthread_mutex_destroy(&ctx->mutex);
+  free(ctx);
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_CONTEXT_H
+#define __BGPSTREAM_CONTEXT_H
+
+#include "bgpstream.h"
+#include "bgpstream_breaker.h"
+#include "bgpstream_record_int.h"
+#include "bgpstream_worker_pool.h"
+
+/** @file
+ *
+ * @brief Header file for the internal interface of stream contexts, which hold
+ * what the streams created in them share: the worker threads that open and
+ * decode their resources, the records kept for reuse, and the state of the
+ * hosts that resources are fetched from. (The HTTP connections, cache indexes,
+ * decompression threads and interned names are already shared by every stream
+ * of the process.) The public interface is in bgpstream.h.
+ */
+
+/** Take another reference to the given context
+ *
+ * @param ctx           pointer to the context to keep
+ * @return the same pointer
+ *
+ * The context is only destroyed once bgpstream_context_destroy has been called
+ * for every reference.
+ */
+bgpstream_context_t *bgpstream_context_retain(bgpstream_context_t *ctx);
+
+/** Get the worker pool of the context, starting its threads if needed
+ *
+ * @param ctx           pointer to a context
+ * @return borrowed pointer to the pool, NULL if it could not be started
+ *
+ * Streams should use a view of the pool (see
+ * bgpstream_worker_pool_create_view) so that their events are their own.
+ */
+bgpstream_worker_pool_t *bgpstream_context_get_pool(bgpstream_context_t *ctx);
+
+/** Get the record pool of the context
+ *
+ * @param ctx           pointer to a context
+ * @return borrowed pointer to the record pool
+ */
+bgpstream_record_pool_t *
+bgpstream_context_get_record_pool(bgpstream_context_t *ctx);
+
+/** Get the circuit breaker of the context
+ *
+ * @param ctx           pointer to a context
+ * @return borrowed pointer to the breaker
+ */
+bgpstream_breaker_t *bgpstream_context_get_breaker(bgpstream_context_t *ctx);
+
+#endif /* __BGPSTREAM_CONTEXT_H */
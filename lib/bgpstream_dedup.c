@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_dedup.h"
+#include "bgpstream_log.h"
+#include "utils.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+// entries per bucket. a route may go in any entry of its bucket
+#define BUCKET_SIZE 4
+
+typedef struct dedup_entry {
+
+  // hash of the route (0 if the entry is unused)
+  uint64_t route;
+
+  // hash of the type and attributes of the last elem of the route
+  uint32_t attrs;
+
+  // when the last elem of the route was seen
+  uint32_t time;
+
+} dedup_entry_t;
+
+struct bgpstream_dedup {
+
+  // seconds for which an elem is remembered (0 for no limit)
+  uint32_t window;
+
+  // table of buckets_cnt * BUCKET_SIZE entries
+  dedup_entry_t *entries;
+  uint64_t buckets_cnt;
+
+  // elems of many records may be checked at once
+  pthread_mutex_t mutex;
+
+  // elems found to be duplicates, and entries replaced by other routes
+  uint64_t duplicates;
+  uint64_t evictions;
+};
+
+// finalizer of splitmix64, to spread the bits of the hashes we combine
+static inline uint64_t mix64(uint64_t h)
+{
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
+// announcements and withdrawals share a route, so that one replaces the other,
+// while RIB elems (which are repeated in every dump) have routes of their own
+static uint64_t route_hash(bgpstream_elem_t *elem)
+{
+  uint64_t h;
+
+  h = mix64(bgpstream_addr_hash(&elem->peer_ip) ^
+            ((uint64_t)elem->peer_asn << 32));
+  h = mix64(h ^ bgpstream_pfx_hash(&elem->prefix) ^
+            ((uint64_t)elem->prefix.mask_len << 56));
+  h = mix64(h ^ (elem->type == BGPSTREAM_ELEM_TYPE_RIB));
+  // 0 marks unused entries
+  return h != 0 ? h : 1;
+}
+
+static int attrs_hash(bgpstream_elem_t *elem, uint32_t *attrs)
+{
+  bgpstream_as_path_t *path;
+  bgpstream_community_set_t *comms;
+  uint64_t h = elem->type;
+
+  if (elem->type != BGPSTREAM_ELEM_TYPE_WITHDRAWAL) {
+    // decodes the attributes of lazy elems
+    if ((path = bgpstream_elem_get_as_path(elem)) == NULL ||
+        (comms = bgpstream_elem_get_communities(elem)) == NULL) {
+      return -1;
+    }
+    h = mix64(h ^ bgpstream_addr_hash(&elem->nexthop));
+    h = mix64(h ^ bgpstream_as_path_hash(path));
+    h = mix64(h ^ bgpstream_community_set_hash(comms));
+  }
+  *attrs = (uint32_t)(h ^ (h >> 32));
+  return 0;
+}
+
+// elems of different records may be a little out of order
+static inline uint32_t entry_age(dedup_entry_t *e, uint32_t time)
+{
+  return time > e->time ? time - e->time : 0;
+}
+
+bgpstream_dedup_t *bgpstream_dedup_create(uint32_t window,
+                                          uint32_t max_entries)
+{
+  bgpstream_dedup_t *dedup;
+
+  if ((dedup = malloc_zero(sizeof(bgpstream_dedup_t))) == NULL) {
+    return NULL;
+  }
+  dedup->window = window;
+
+  dedup->buckets_cnt = 1;
+  while (dedup->buckets_cnt * BUCKET_SIZE < max_entries) {
+    dedup->buckets_cnt <<= 1;
+  }
+  if ((dedup->entries = malloc_zero(sizeof(dedup_entry_t) * BUCKET_SIZE *
+                                    dedup->buckets_cnt)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Could not allocate a deduplication table of %" PRIu64
+                  " entries",
+                  dedup->buckets_cnt * BUCKET_SIZE);
+    free(dedup);
+    return NULL;
+  }
+  pthread_mutex_init(&dedup->mutex, NULL);
+
+  return dedup;
+}
+
+void bgpstream_dedup_destroy(bgpstream_dedup_t *dedup)
+{
+  if (dedup == NULL) {
+    return;
+  }
+  pthread_mutex_destroy(&dedup->mutex);
+  free(dedup->entries);
+  free(dedup);
+}
+
+int bgpstream_dedup_check(bgpstream_dedup_t *dedup, uint32_t time,
+                          bgpstream_elem_t *elem)
+{
+  dedup_entry_t *bucket, *e, *victim = NULL;
+  uint64_t route;
+  uint32_t attrs, age, oldest = 0;
+  int dup = 0;
+  int i;
+
+  if (elem->type == BGPSTREAM_ELEM_TYPE_PEERSTATE ||
+      attrs_hash(elem, &attrs) != 0) {
+    return 0;
+  }
+  route = route_hash(elem);
+
+  pthread_mutex_lock(&dedup->mutex);
+  bucket = &dedup->entries[(route & (dedup->buckets_cnt - 1)) * BUCKET_SIZE];
+  for (i = 0; i < BUCKET_SIZE; i++) {
+    e = &bucket[i];
+    if (e->route == route) {
+      victim = e;
+      break;
+    }
+    // otherwise, use a free entry, or replace the one seen the longest ago
+    age = e->route == 0 ? UINT32_MAX : entry_age(e, time);
+    if (victim == NULL || age > oldest) {
+      victim = e;
+      oldest = age;
+    }
+  }
+  e = victim;
+
+  if (e->route == route) {
+    // duplicates do not refresh the time, so an elem that keeps repeating
+    // passes once per window
+    dup = e->attrs == attrs &&
+          (dedup->window == 0 || entry_age(e, time) <= dedup->window);
+  } else if (e->route != 0 &&
+             (dedup->window == 0 || oldest <= dedup->window)) {
+    dedup->evictions++;
+  }
+  if (dup == 0) {
+    e->route = route;
+    e->attrs = attrs;
+    e->time = time;
+  } else {
+    dedup->duplicates++;
+  }
+  pthread_mutex_unlock(&dedup->mutex);
+
+  return dup;
+}
+
+size_t bgpstream_dedup_get_mem_size(const bgpstream_dedup_t *dedup)
+{
+  return sizeof(bgpstream_dedup_t) +
+         sizeof(dedup_entry_t) * BUCKET_SIZE * dedup->buckets_cnt;
+}
+
+void bgpstream_dedup_get_stats(bgpstream_dedup_t *dedup,
+                               bgpstream_perf_stats_t *stats)
+{
+  pthread_mutex_lock(&dedup->mutex);
+  stats->elems_duplicate = dedup->duplicates;
+  stats->dedup_evictions = dedup->evictions;
+  pthread_mutex_unlock(&dedup->mutex);
+}
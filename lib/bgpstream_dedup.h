@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_DEDUP_H
+#define __BGPSTREAM_DEDUP_H
+
+#include "bgpstream.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Header file for the deduplication of elems (see bgpstream_set_dedup),
+ * which drops elems that repeat one the stream returned shortly before, e.g.,
+ * the same update from a peer that feeds several collectors. Each route (the
+ * peer, the prefix, and whether the elem comes from a RIB dump or an update
+ * dump) has an entry in a hash table of fixed size, which holds a hash of the
+ * last elem of the route and when it was seen. The table is split into small
+ * buckets, and when a bucket is full the entry seen the longest ago is
+ * replaced, so memory stays bounded and only old routes are forgotten. Checks
+ * may be done from any thread.
+ */
+
+/** Opaque structure that holds the deduplication state of a stream */
+typedef struct bgpstream_dedup bgpstream_dedup_t;
+
+/** Create a deduplication object
+ *
+ * @param window        seconds for which an elem is remembered (0 to remember
+ *                      it until its entry is replaced)
+ * @param max_entries   maximum number of routes to remember (rounded up to a
+ *                      power of two)
+ * @return pointer to the object if successful, NULL otherwise
+ */
+bgpstream_dedup_t *bgpstream_dedup_create(uint32_t window,
+                                          uint32_t max_entries);
+
+/** Destroy the given deduplication object */
+void bgpstream_dedup_destroy(bgpstream_dedup_t *dedup);
+
+/** Check whether an elem is a duplicate, and remember it if it is not
+ *
+ * @param dedup         pointer to the deduplication object
+ * @param time          time of the record that the elem belongs to
+ * @param elem          pointer to the elem to check
+ * @return 1 if the elem has the same type, next hop, AS path and communities
+ * as the last elem of its route, and that elem was seen at most window
+ * seconds earlier, 0 otherwise
+ *
+ * Peer state elems are never duplicates.
+ */
+int bgpstream_dedup_check(bgpstream_dedup_t *dedup, uint32_t time,
+                          bgpstream_elem_t *elem);
+
+/** Get the number of bytes allocated for the table
+ *
+ * @param dedup         pointer to the deduplication object
+ * @return the size of the table in bytes
+ */
+size_t bgpstream_dedup_get_mem_size(const bgpstream_dedup_t *dedup);
+
+/** Get the deduplication statistics
+ *
+ * @param dedup         pointer to the deduplication object
+ * @param[out] stats    filled with the duplicate and eviction counts (the
+ *                      other fields are left alone)
+ */
+void bgpstream_dedup_get_stats(bgpstream_dedup_t *dedup,
+                               bgpstream_perf_stats_t *stats);
+
+#endif /* __BGPSTREAM_DEDUP_H */
@@ -85,6 +85,7 @@
     NULL,                                                                      \
     NULL,                                                                      \
     NULL,                                                                      \
+    NULL,                                                                      \
   };                                                                           \
   bsdi_t *bsdi_##classname##_alloc()                                           \
   {                                                                            \
@@ -164,6 +165,19 @@ struct bsdi {
    */
   int (*update_resources)(bsdi_t *di);
 
+  /** (Optional) Get a file descriptor that becomes readable when the interface
+   * may have new resources
+   *
+   * @param di          pointer to the data interface
+   * @return a file descriptor, or -1 if there is none at the moment
+   *
+   * In blocking mode, the data interface manager waits on this descriptor
+   * (rather than sleeping) between calls to update_resources, so that new
+   * data is picked up as soon as it appears. Interfaces that support this set
+   * the pointer in their init method, it is NULL otherwise.
+   */
+  int (*get_fd)(bsdi_t *di);
+
   /** }@ */
 
   /**
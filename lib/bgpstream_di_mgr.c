@@ -26,10 +26,12 @@
 
 #include "bgpstream_di_mgr.h"
 #include "bgpstream_log.h"
+#include "bgpstream_perf.h"
 #include "config.h"
 #include "utils.h"
 #include <assert.h>
 #include <inttypes.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
@@ -58,6 +60,10 @@
 #include "bsdi_broker.h"
 #endif
 
+#ifdef WITH_DATA_INTERFACE_DIRECTORY
+#include "bsdi_directory.h"
+#endif
+
 /* After 10 retries, start exponential backoff */
 #define DATA_INTERFACE_BLOCKING_RETRY_CNT 10
 /* Wait at least 20 seconds if the broker has no new data for us */
@@ -88,6 +94,10 @@ struct bgpstream_di_mgr {
   int backoff_time;
   int retry_cnt;
 
+  // non-blocking query state (when to next ask the DI for resources)
+  int nonblocking;
+  int next_retry;
+
   // polling state when mixing streams and batch resources
   int next_poll;
   int poll_freq;
@@ -136,6 +146,12 @@ static const di_alloc_func_t di_alloc_functions[] = {
   NULL,
 #endif
 
+#ifdef WITH_DATA_INTERFACE_DIRECTORY
+  bsdi_directory_alloc,
+#else
+  NULL,
+#endif
+
 };
 
 #define GET_DEFAULT_STR_VALUE(var_store, default_value)                        \
@@ -211,6 +227,147 @@ static bsdi_t *get_di(bgpstream_di_mgr_t *di_mgr,
   return NULL;
 }
 
+// waits for the active DI to have new resources, or for the backoff time to
+// elapse, whichever comes first. returns -1 if interrupted
+static int wait_di(bgpstream_di_mgr_t *di_mgr)
+{
+  struct pollfd pfd;
+
+  if (ACTIVE_DI->get_fd == NULL ||
+      (pfd.fd = ACTIVE_DI->get_fd(ACTIVE_DI)) < 0) {
+    return (sleep(di_mgr->backoff_time) != 0) ? -1 : 0;
+  }
+  pfd.events = POLLIN;
+  return (poll(&pfd, 1, di_mgr->backoff_time * 1000) < 0) ? -1 : 0;
+}
+
+// fills records with up to n records, returning the number of records read
+static int fill_records(bgpstream_di_mgr_t *di_mgr,
+                        bgpstream_record_t **records, int n)
+{
+  // this function is responsible for blocking if we're in live mode
+  bgpstream_perf_t *perf = bgpstream_resource_mgr_get_perf(di_mgr->res_mgr);
+  bgpstream_perf_timer_t timer;
+  int rc;
+
+  // in non-blocking mode, don't ask the DI for more resources until our backoff
+  // time has elapsed
+  if (di_mgr->nonblocking != 0 &&
+      bgpstream_resource_mgr_empty(di_mgr->res_mgr) != 0 &&
+      epoch_sec() < di_mgr->next_retry) {
+    return BGPSTREAM_WOULD_BLOCK;
+  }
+
+  while (1) {
+    // if our queue is empty, or we only have stream resources and the
+    // poll timer has expired, then ask the DI for more resources
+    if (bgpstream_resource_mgr_empty(di_mgr->res_mgr) != 0 ||
+        (bgpstream_resource_mgr_stream_only(di_mgr->res_mgr) != 0 &&
+         epoch_sec() >= di_mgr->next_poll)) {
+
+      bgpstream_perf_start(perf, &timer);
+      rc = ACTIVE_DI->update_resources(ACTIVE_DI);
+      bgpstream_perf_stop(perf, BGPSTREAM_PERF_STAGE_BROKER, &timer);
+      bgpstream_perf_add_di_query(perf);
+      if (rc != 0) {
+        // an error occurred
+        return -1;
+      }
+
+      if (bgpstream_resource_mgr_stream_only(di_mgr->res_mgr) == 0) {
+        // we now have some non-stream resources, so reset the
+        // polling frequency
+        di_mgr->poll_freq = DATA_INTERFACE_BLOCKING_MIN_WAIT;
+      } else {
+        // still stream-only, so let's consider backing off our polling
+        if (di_mgr->poll_cnt >= DATA_INTERFACE_BLOCKING_RETRY_CNT) {
+          // we've made >= 10 polls without getting anything, so back off
+          di_mgr->poll_freq *= 2;
+          if (di_mgr->poll_freq > DATA_INTERFACE_BLOCKING_MAX_WAIT) {
+            // we've backed off our polling frequency to > 150
+            // seconds, so let's revert to 150
+            di_mgr->poll_freq = DATA_INTERFACE_BLOCKING_MAX_WAIT;
+          }
+        }
+        di_mgr->poll_cnt++;
+      }
+      di_mgr->next_poll = epoch_sec() + di_mgr->poll_freq;
+    }
+
+    // if the queue is not empty, then grab a record
+    if (bgpstream_resource_mgr_empty(di_mgr->res_mgr) == 0) {
+      if ((rc = bgpstream_resource_mgr_get_records(di_mgr->res_mgr, records,
+                                                   n)) == BGPSTREAM_WOULD_BLOCK) {
+        return rc;
+      }
+      if (rc < 0) {
+        // an error occurred
+        return -1;
+      }
+      if (rc > 0) {
+        break;
+      }
+      // must be EOS, try immediately to refill the queue
+      continue;
+    } else if (di_mgr->blocking == 0) {
+      // queue is empty after a fill attempt, and we're not in blocking mode, so
+      // signal EOS
+      rc = 0;
+      break;
+    }
+
+    // either the queue was empty, or it is now
+    assert(bgpstream_resource_mgr_empty(di_mgr->res_mgr) != 0);
+
+    // we're in blocking mode, so we sleep (or in non-blocking mode, let the
+    // user do something else until it is time to try again)
+    if (di_mgr->nonblocking != 0) {
+      di_mgr->next_retry = epoch_sec() + di_mgr->backoff_time;
+    } else if (wait_di(di_mgr) != 0) {
+      // interrupted
+      return -1;
+    }
+    // adjust our sleep time, perhaps
+    if (di_mgr->retry_cnt >= DATA_INTERFACE_BLOCKING_RETRY_CNT) {
+      di_mgr->backoff_time *= 2;
+      if (di_mgr->backoff_time > DATA_INTERFACE_BLOCKING_MAX_WAIT) {
+        di_mgr->backoff_time = DATA_INTERFACE_BLOCKING_MAX_WAIT;
+      }
+    }
+    di_mgr->retry_cnt++;
+
+    if (di_mgr->nonblocking != 0) {
+      return BGPSTREAM_WOULD_BLOCK;
+    }
+  }
+
+  di_mgr->backoff_time = DATA_INTERFACE_BLOCKING_MIN_WAIT;
+  di_mgr->retry_cnt = 0;
+
+  return rc;
+}
+
+// fill_records, with the time spent waiting and the records returned counted
+static int get_next_records(bgpstream_di_mgr_t *di_mgr,
+                            bgpstream_record_t **records, int n)
+{
+  bgpstream_perf_t *perf = bgpstream_resource_mgr_get_perf(di_mgr->res_mgr);
+  bgpstream_perf_timer_t timer;
+  int i, rc;
+
+  bgpstream_perf_start(perf, &timer);
+  rc = fill_records(di_mgr, records, n);
+  bgpstream_perf_stop(perf, BGPSTREAM_PERF_STAGE_WAIT, &timer);
+  if (rc > 0) {
+    bgpstream_perf_add_records(perf, rc);
+  }
+  for (i = 0; i < rc; i++) {
+    bgpstream_perf_add_collector_record(perf, records[i]->collector_name,
+                                        records[i]->time_sec);
+  }
+  return rc;
+}
+
 /* ========== PUBLIC FUNCTIONS BELOW HERE ========== */
 
 bgpstream_di_mgr_t *bgpstream_di_mgr_create(bgpstream_filter_mgr_t *filter_mgr)
@@ -338,85 +495,103 @@ void bgpstream_di_mgr_set_blocking(bgpstream_di_mgr_t *di_mgr)
   di_mgr->blocking = 1;
 }
 
-int bgpstream_di_mgr_get_next_record(bgpstream_di_mgr_t *di_mgr,
-                                     bgpstream_record_t **record)
+void bgpstream_di_mgr_set_reader_readahead(bgpstream_di_mgr_t *di_mgr,
+                                           int readahead)
 {
-  // this function is responsible for blocking if we're in live mode
-  int rc;
+  bgpstream_resource_mgr_set_reader_readahead(di_mgr->res_mgr, readahead);
+}
 
-  while (1) {
-    // if our queue is empty, or we only have stream resources and the
-    // poll timer has expired, then ask the DI for more resources
-    if (bgpstream_resource_mgr_empty(di_mgr->res_mgr) != 0 ||
-        (bgpstream_resource_mgr_stream_only(di_mgr->res_mgr) != 0 &&
-         epoch_sec() >= di_mgr->next_poll)) {
+int bgpstream_di_mgr_set_max_open(bgpstream_di_mgr_t *di_mgr, int max_open)
+{
+  return bgpstream_resource_mgr_set_max_open(di_mgr->res_mgr, max_open);
+}
 
-      if (ACTIVE_DI->update_resources(ACTIVE_DI) != 0) {
-        // an error occurred
-        return -1;
-      }
+struct bgpstream_mem *bgpstream_di_mgr_get_mem(bgpstream_di_mgr_t *di_mgr)
+{
+  return bgpstream_resource_mgr_get_mem(di_mgr->res_mgr);
+}
 
-      if (bgpstream_resource_mgr_stream_only(di_mgr->res_mgr) == 0) {
-        // we now have some non-stream resources, so reset the
-        // polling frequency
-        di_mgr->poll_freq = DATA_INTERFACE_BLOCKING_MIN_WAIT;
-      } else {
-        // still stream-only, so let's consider backing off our polling
-        if (di_mgr->poll_cnt >= DATA_INTERFACE_BLOCKING_RETRY_CNT) {
-          // we've made >= 10 polls without getting anything, so back off
-          di_mgr->poll_freq *= 2;
-          if (di_mgr->poll_freq > DATA_INTERFACE_BLOCKING_MAX_WAIT) {
-            // we've backed off our polling frequency to > 150
-            // seconds, so let's revert to 150
-            di_mgr->poll_freq = DATA_INTERFACE_BLOCKING_MAX_WAIT;
-          }
-        }
-        di_mgr->poll_cnt++;
-      }
-      di_mgr->next_poll = epoch_sec() + di_mgr->poll_freq;
-    }
+struct bgpstream_perf *bgpstream_di_mgr_get_perf(bgpstream_di_mgr_t *di_mgr)
+{
+  return bgpstream_resource_mgr_get_perf(di_mgr->res_mgr);
+}
 
-    // if the queue is not empty, then grab a record
-    if (bgpstream_resource_mgr_empty(di_mgr->res_mgr) == 0) {
-      if ((rc = bgpstream_resource_mgr_get_record(di_mgr->res_mgr, record)) <
-          0) {
-        // an error occurred
-        return -1;
-      }
-      if (rc > 0) {
-        break;
-      }
-      // must be EOS, try immediately to refill the queue
-      continue;
-    } else if (di_mgr->blocking == 0) {
-      // queue is empty after a fill attempt, and we're not in blocking mode, so
-      // signal EOS
-      rc = 0;
-      break;
-    }
+int bgpstream_di_mgr_get_open_cnt(bgpstream_di_mgr_t *di_mgr)
+{
+  return bgpstream_resource_mgr_get_open_cnt(di_mgr->res_mgr);
+}
 
-    // either the queue was empty, or it is now
-    assert(bgpstream_resource_mgr_empty(di_mgr->res_mgr) != 0);
+void bgpstream_di_mgr_set_prefetch(bgpstream_di_mgr_t *di_mgr,
+                                   uint32_t horizon)
+{
+  bgpstream_resource_mgr_set_prefetch(di_mgr->res_mgr, horizon);
+}
 
-    // we're in blocking mode, so we sleep
-    if (sleep(di_mgr->backoff_time) != 0) {
-      // interrupted
-      return -1;
-    }
-    // adjust our sleep time, perhaps
-    if (di_mgr->retry_cnt >= DATA_INTERFACE_BLOCKING_RETRY_CNT) {
-      di_mgr->backoff_time *= 2;
-      if (di_mgr->backoff_time > DATA_INTERFACE_BLOCKING_MAX_WAIT) {
-        di_mgr->backoff_time = DATA_INTERFACE_BLOCKING_MAX_WAIT;
-      }
-    }
-    di_mgr->retry_cnt++;
-  }
+void bgpstream_di_mgr_set_nonblocking(bgpstream_di_mgr_t *di_mgr)
+{
+  di_mgr->nonblocking = 1;
+  bgpstream_resource_mgr_set_nonblocking(di_mgr->res_mgr);
+}
 
-  di_mgr->backoff_time = DATA_INTERFACE_BLOCKING_MIN_WAIT;
-  di_mgr->retry_cnt = 0;
+int bgpstream_di_mgr_get_fd(bgpstream_di_mgr_t *di_mgr)
+{
+  return bgpstream_resource_mgr_get_fd(di_mgr->res_mgr);
+}
 
-  return rc;
+void bgpstream_di_mgr_set_unordered(bgpstream_di_mgr_t *di_mgr)
+{
+  bgpstream_resource_mgr_set_unordered(di_mgr->res_mgr);
+}
+
+int bgpstream_di_mgr_set_max_skew(bgpstream_di_mgr_t *di_mgr,
+                                  uint32_t max_skew)
+{
+  return bgpstream_resource_mgr_set_max_skew(di_mgr->res_mgr, max_skew);
+}
+
+void bgpstream_di_mgr_set_heap_merge(bgpstream_di_mgr_t *di_mgr)
+{
+  bgpstream_resource_mgr_set_heap_merge(di_mgr->res_mgr);
+}
+
+int bgpstream_di_mgr_set_worker_threads(bgpstream_di_mgr_t *di_mgr,
+                                        int threads)
+{
+  return bgpstream_resource_mgr_set_worker_threads(di_mgr->res_mgr, threads);
+}
+
+int bgpstream_di_mgr_set_thread_affinity(bgpstream_di_mgr_t *di_mgr,
+                                         bgpstream_thread_affinity_t policy,
+                                         const char *cpus)
+{
+  return bgpstream_resource_mgr_set_thread_affinity(di_mgr->res_mgr, policy,
+                                                    cpus);
+}
+
+int bgpstream_di_mgr_set_context(bgpstream_di_mgr_t *di_mgr,
+                                 bgpstream_context_t *ctx)
+{
+  return bgpstream_resource_mgr_set_context(di_mgr->res_mgr, ctx);
+}
+
+void bgpstream_di_mgr_set_filter_mgr(bgpstream_di_mgr_t *di_mgr,
+                                     bgpstream_filter_mgr_t *filter_mgr)
+{
+  // the data interfaces have built their queries from the filters they
+  // started with, so they keep them
+  bgpstream_resource_mgr_set_filter_mgr(di_mgr->res_mgr, filter_mgr);
+}
+
+int bgpstream_di_mgr_get_next_record(bgpstream_di_mgr_t *di_mgr,
+                                     bgpstream_record_t **record)
+{
+  return get_next_records(di_mgr, record, 1);
+}
+
+int bgpstream_di_mgr_get_next_records(bgpstream_di_mgr_t *di_mgr,
+                                      bgpstream_record_t **records, int n)
+{
+  return get_next_records(di_mgr, records, n);
 }
 
 void bgpstream_di_mgr_destroy(bgpstream_di_mgr_t *di_mgr)
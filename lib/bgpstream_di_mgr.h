@@ -132,6 +132,130 @@ int bgpstream_di_mgr_set_data_interface_option(
  */
 void bgpstream_di_mgr_set_blocking(bgpstream_di_mgr_t *di_mgr);
 
+/** Set the number of records that resource readers decode ahead of the
+ * consumer
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param readahead     number of records to decode ahead (0 to disable)
+ */
+void bgpstream_di_mgr_set_reader_readahead(bgpstream_di_mgr_t *di_mgr,
+                                           int readahead);
+
+/** Merge open resources using a min-heap
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ */
+void bgpstream_di_mgr_set_heap_merge(bgpstream_di_mgr_t *di_mgr);
+
+/** Limit the number of resources that are open at once
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param max_open      maximum number of open resources (0 for no limit)
+ * @return 0 if the limit was set, -1 if it is invalid
+ */
+int bgpstream_di_mgr_set_max_open(bgpstream_di_mgr_t *di_mgr, int max_open);
+
+/** Get the memory accounting of the stream
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @return pointer to the memory accounting of the resource queue
+ */
+struct bgpstream_mem *bgpstream_di_mgr_get_mem(bgpstream_di_mgr_t *di_mgr);
+
+/** Get the throughput accounting of the stream
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @return pointer to the throughput accounting of the resource queue
+ */
+struct bgpstream_perf *bgpstream_di_mgr_get_perf(bgpstream_di_mgr_t *di_mgr);
+
+/** Get the number of open resources
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @return the number of resources whose readers are open
+ */
+int bgpstream_di_mgr_get_open_cnt(bgpstream_di_mgr_t *di_mgr);
+
+/** Open resources before they are needed
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param horizon       how far ahead (in seconds) to open resources (0 to
+ *                      disable)
+ */
+void bgpstream_di_mgr_set_prefetch(bgpstream_di_mgr_t *di_mgr,
+                                   uint32_t horizon);
+
+/** Return records as soon as any open resource has one
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ */
+void bgpstream_di_mgr_set_unordered(bgpstream_di_mgr_t *di_mgr);
+
+/** Put records that are slightly out of order back into time order
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param max_skew      how far (in seconds) a record may be out of order
+ * @return 0 if the reorder buffer was created successfully, -1 otherwise
+ */
+int bgpstream_di_mgr_set_max_skew(bgpstream_di_mgr_t *di_mgr,
+                                  uint32_t max_skew);
+
+/** Return BGPSTREAM_WOULD_BLOCK rather than wait for data
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ */
+void bgpstream_di_mgr_set_nonblocking(bgpstream_di_mgr_t *di_mgr);
+
+/** Get a file descriptor that becomes readable when a record may be available
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @return a file descriptor owned by the manager, -1 if an error occurred
+ */
+int bgpstream_di_mgr_get_fd(bgpstream_di_mgr_t *di_mgr);
+
+/** Switch the resources and readers to another filter manager
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param filter_mgr    pointer to the filter manager to use from now on
+ *
+ * The data interfaces keep using the filter manager they were created with (to
+ * find resources), but every resource they find is checked against the new
+ * filters. Once this returns, the previous filter manager (if it is not the one
+ * the data interfaces use) may be destroyed.
+ */
+void bgpstream_di_mgr_set_filter_mgr(bgpstream_di_mgr_t *di_mgr,
+                                     bgpstream_filter_mgr_t *filter_mgr);
+
+/** Set the number of worker threads used to open and decode resources
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param threads       number of threads (must be > 0)
+ * @return 0 if the number was set successfully, -1 otherwise
+ */
+int bgpstream_di_mgr_set_worker_threads(bgpstream_di_mgr_t *di_mgr,
+                                        int threads);
+
+/** Set where the worker threads run
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param policy        how to place the threads on CPUs
+ * @param cpus          list of the CPUs that the threads may use, or NULL for
+ *                      every CPU of the process
+ * @return 0 if the placement was set successfully, -1 otherwise
+ */
+int bgpstream_di_mgr_set_thread_affinity(bgpstream_di_mgr_t *di_mgr,
+                                         bgpstream_thread_affinity_t policy,
+                                         const char *cpus);
+
+/** Share the workers (and the other state) of a stream context
+ *
+ * @param di_mgr        pointer to a data interface manager instance
+ * @param ctx           pointer to the context to share
+ * @return 0 if the context was set, -1 if resources have already been opened
+ */
+int bgpstream_di_mgr_set_context(bgpstream_di_mgr_t *di_mgr,
+                                 bgpstream_context_t *ctx);
+
 /** Start the data interface
  *
  * @param di_mgr        pointer to a data interface manager instance
@@ -150,11 +274,26 @@ int bgpstream_di_mgr_start(bgpstream_di_mgr_t *di_mgr);
  * reached, <0 if an error occurred.
  *
  * If the stream is in live mode, this method will block until data is
- * available, otherwise it will return 0 to indicate EOF.
+ * available (or, in non-blocking mode, return BGPSTREAM_WOULD_BLOCK), otherwise
+ * it will return 0 to indicate EOF.
  */
 int bgpstream_di_mgr_get_next_record(bgpstream_di_mgr_t *di_mgr,
                                      bgpstream_record_t **record);
 
+/** Get a batch of records from the stream, in order
+ *
+ * @param di_mgr        pointer to the DI manager instance
+ * @param[out] records  array of at least n pointers to fill with borrowed
+ *                      pointers to records
+ * @param n             maximum number of records to get
+ * @return the number of records read, 0 if end-of-stream has been reached, <0
+ * if an error occurred.
+ *
+ * The records remain valid until the next call for records.
+ */
+int bgpstream_di_mgr_get_next_records(bgpstream_di_mgr_t *di_mgr,
+                                      bgpstream_record_t **records, int n);
+
 /** Destroy the given data interface manager
  *
  * @param di_mgr        pointer to a data interface manager instance to destroy
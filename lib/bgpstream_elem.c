@@ -40,8 +40,38 @@
 #include <string.h>
 #include <errno.h>
 
+/* ==================== PRIVATE FUNCTIONS ==================== */
+
+static int decode_lazy(bgpstream_elem_t *elem)
+{
+  const void *attrs = elem->__lazy_attrs;
+
+  if (attrs == NULL) {
+    return 0;
+  }
+  // only try once, even if decoding fails
+  elem->__lazy_attrs = NULL;
+  if (elem->__lazy_decode(elem, attrs) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not decode lazy elem attributes");
+    return -1;
+  }
+  return 0;
+}
+
 /* ==================== PROTECTED FUNCTIONS ==================== */
 
+void bgpstream_elem_set_lazy(bgpstream_elem_t *elem,
+                             int (*decode)(bgpstream_elem_t *elem,
+                                           const void *attrs),
+                             const void *attrs)
+{
+  // the elem may be re-used, so drop any previously decoded values
+  bgpstream_as_path_clear(elem->as_path);
+  bgpstream_community_set_clear(elem->communities);
+  elem->__lazy_decode = decode;
+  elem->__lazy_attrs = attrs;
+}
+
 /* ==================== PUBLIC FUNCTIONS ==================== */
 
 bgpstream_elem_t *bgpstream_elem_create()
@@ -101,6 +131,7 @@ void bgpstream_elem_clear(bgpstream_elem_t *elem)
   elem->has_local_pref = 0;
   elem->atomic_aggregate = 0;
   elem->aggregator.has_aggregator = 0;
+  elem->__lazy_attrs = NULL;
 }
 
 bgpstream_elem_t *bgpstream_elem_copy(bgpstream_elem_t *dst,
@@ -125,9 +156,31 @@ bgpstream_elem_t *bgpstream_elem_copy(bgpstream_elem_t *dst,
     return NULL;
   }
 
+  // the attributes of a lazy elem may not outlive src, so decode them now
+  if (decode_lazy(dst) != 0) {
+    return NULL;
+  }
+
   return dst;
 }
 
+bgpstream_as_path_t *bgpstream_elem_get_as_path(bgpstream_elem_t *elem)
+{
+  if (decode_lazy(elem) != 0) {
+    return NULL;
+  }
+  return elem->as_path;
+}
+
+bgpstream_community_set_t *
+bgpstream_elem_get_communities(bgpstream_elem_t *elem)
+{
+  if (decode_lazy(elem) != 0) {
+    return NULL;
+  }
+  return elem->communities;
+}
+
 int bgpstream_elem_type_snprintf(char *buf, size_t len,
                                  bgpstream_elem_type_t type)
 {
@@ -238,6 +291,11 @@ char *bgpstream_elem_custom_snprintf(char *buf, size_t len,
   char *buf_p = buf;
   bgpstream_as_path_seg_t *seg;
 
+  /* a lazy elem is logically unchanged by decoding its attributes */
+  if (decode_lazy((bgpstream_elem_t *)elem) != 0) {
+    return NULL;
+  }
+
   /* common fields */
 
   /* [message_type|]peer_asn|peer_ip| */
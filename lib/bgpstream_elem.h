@@ -129,6 +129,36 @@ typedef enum {
 
 } bgpstream_elem_type_t;
 
+/** Elem fields that are populated from BGP path attributes, used to declare
+ * which of them are needed (see bgpstream_set_elem_fields) */
+typedef enum {
+
+  /** Next-hop (the MP_REACH next-hop is always available) */
+  BGPSTREAM_ELEM_FIELD_NEXTHOP = 0x01,
+
+  /** AS path */
+  BGPSTREAM_ELEM_FIELD_AS_PATH = 0x02,
+
+  /** Communities */
+  BGPSTREAM_ELEM_FIELD_COMMUNITIES = 0x04,
+
+  /** Origin */
+  BGPSTREAM_ELEM_FIELD_ORIGIN = 0x08,
+
+  /** Multi-exit discriminator */
+  BGPSTREAM_ELEM_FIELD_MED = 0x10,
+
+  /** Local preference */
+  BGPSTREAM_ELEM_FIELD_LOCAL_PREF = 0x20,
+
+  /** Atomic aggregate and aggregator */
+  BGPSTREAM_ELEM_FIELD_AGGREGATOR = 0x40,
+
+  /** All of the above */
+  BGPSTREAM_ELEM_FIELD_ALL = 0x7F,
+
+} bgpstream_elem_field_t;
+
 typedef struct struct_bgpstream_annotations_t {
 
   /** RPKI active */
@@ -214,13 +244,17 @@ typedef struct bgpstream_elem {
 
   /** AS path
    *
-   * Available only for RIB and Announcement elem types
+   * Available only for RIB and Announcement elem types. If lazy elems are
+   * enabled (see bgpstream_set_lazy_elems), use bgpstream_elem_get_as_path
+   * instead.
    */
   bgpstream_as_path_t *as_path;
 
   /** Communities
    *
-   * Available only for RIB and Announcement elem types
+   * Available only for RIB and Announcement elem types. If lazy elems are
+   * enabled (see bgpstream_set_lazy_elems), use bgpstream_elem_get_communities
+   * instead.
    */
   bgpstream_community_set_t *communities;
 
@@ -270,6 +304,14 @@ typedef struct bgpstream_elem {
   /** Atomic aggregate attribute */
   bgpstream_elem_aggregator_t aggregator;
 
+  /* ---------- INTERNAL FIELDS: ---------- */
+
+  /** INTERNAL: attributes that have not been decoded yet. Do not use. */
+  const void *__lazy_attrs;
+
+  /** INTERNAL: function that decodes __lazy_attrs. Do not use. */
+  int (*__lazy_decode)(struct bgpstream_elem *elem, const void *attrs);
+
 } bgpstream_elem_t;
 
 /** @} */
@@ -310,6 +352,29 @@ void bgpstream_elem_clear(bgpstream_elem_t *elem);
 bgpstream_elem_t *bgpstream_elem_copy(bgpstream_elem_t *dst,
                                       const bgpstream_elem_t *src);
 
+/** Get the AS path of the given elem
+ *
+ * @param elem          pointer to a BGP Stream Elem
+ * @return borrowed pointer to the AS path, NULL if it could not be decoded
+ *
+ * If lazy elems are enabled (see bgpstream_set_lazy_elems), the AS path and
+ * communities of RIB elems are only decoded the first time either of them is
+ * requested using this function or bgpstream_elem_get_communities. Otherwise
+ * this simply returns the `as_path` field.
+ */
+bgpstream_as_path_t *bgpstream_elem_get_as_path(bgpstream_elem_t *elem);
+
+/** Get the communities of the given elem
+ *
+ * @param elem          pointer to a BGP Stream Elem
+ * @return borrowed pointer to the community set, NULL if it could not be
+ * decoded
+ *
+ * See bgpstream_elem_get_as_path for details about lazy decoding.
+ */
+bgpstream_community_set_t *
+bgpstream_elem_get_communities(bgpstream_elem_t *elem);
+
 /** Write the string representation of the elem type into the provided buffer
  *
  * @param buf           pointer to a char array
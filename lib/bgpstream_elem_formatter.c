@@ -0,0 +1,884 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_elem_formatter.h"
+#include "bgpstream_log.h"
+#include "config.h"
+#ifdef WITH_RPKI
+#include "bgpstream_utils_rpki.h"
+#endif
+#include "utils.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// templates that render elems as bgpstream_record_elem_snprintf and
+// bgpstream_record_elem_bgpdump_snprintf do
+#define DEFAULT_TEMPLATE                                                       \
+  "%{record_type}|%{elem_type}|%{time}|%{project}|%{collector}|%{router}|"    \
+  "%{router_ip}|%{peer_asn}|%{peer_ip}|%{prefix}|%{next_hop}|%{as_path}|"     \
+  "%{origin_asn}|%{communities}|%{old_state}|%{new_state}%{rpki}"
+#define BGPDUMP_ROUTE_FIELDS                                                   \
+  "%{peer_ip}|%{peer_asn}|%{prefix}|%{as_path}|%{origin}|%{next_hop}|"        \
+  "%{local_pref}|%{med}|%{communities}|%{atomic_aggregate}|%{aggregator}|"
+
+static const struct {
+  bgpstream_elem_type_t type;
+  const char *template;
+} bgpdump_templates[] = {
+  {BGPSTREAM_ELEM_TYPE_RIB, "TABLE_DUMP2|%{time_sec}|B|" BGPDUMP_ROUTE_FIELDS},
+  {BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT,
+   "BGP4MP|%{time_sec}|A|" BGPDUMP_ROUTE_FIELDS},
+  {BGPSTREAM_ELEM_TYPE_WITHDRAWAL,
+   "BGP4MP|%{time_sec}|W|%{peer_ip}|%{peer_asn}|%{prefix}"},
+  {BGPSTREAM_ELEM_TYPE_PEERSTATE,
+   "BGP4MP|%{time_sec}|STATE|%{peer_ip}|%{peer_asn}|%{old_state_code}|"
+   "%{new_state_code}"},
+};
+
+// number of elem types that templates can be set for
+#define ELEM_TYPE_CNT (BGPSTREAM_ELEM_TYPE_END_OF_RIB + 1)
+
+// longest a number, address or prefix may be once rendered
+#define U32_MAX_LEN 10
+#define ADDR_MAX_LEN 46
+#define PFX_MAX_LEN (ADDR_MAX_LEN + 4)
+
+// space given to the RPKI validation result
+#define RPKI_RESULT_LEN 4096
+
+// the buffer is never smaller than this
+#define BUF_MIN_ALLOC (64 * 1024)
+
+enum {
+  FIELD_LITERAL,
+  FIELD_RECORD_TYPE,
+  FIELD_ELEM_TYPE,
+  FIELD_TIME,
+  FIELD_TIME_SEC,
+  FIELD_PROJECT,
+  FIELD_COLLECTOR,
+  FIELD_ROUTER,
+  FIELD_ROUTER_IP,
+  FIELD_PEER_ASN,
+  FIELD_PEER_IP,
+  FIELD_PREFIX,
+  FIELD_NEXT_HOP,
+  FIELD_AS_PATH,
+  FIELD_ORIGIN_ASN,
+  FIELD_COMMUNITIES,
+  FIELD_ORIGIN,
+  FIELD_LOCAL_PREF,
+  FIELD_MED,
+  FIELD_ATOMIC_AGGREGATE,
+  FIELD_AGGREGATOR,
+  FIELD_OLD_STATE,
+  FIELD_NEW_STATE,
+  FIELD_OLD_STATE_CODE,
+  FIELD_NEW_STATE_CODE,
+  FIELD_RPKI,
+};
+
+// names of the fields, indexed by field
+static const char *field_names[] = {
+  NULL,           "record_type", "elem_type",  "time",
+  "time_sec",     "project",     "collector",  "router",
+  "router_ip",    "peer_asn",    "peer_ip",    "prefix",
+  "next_hop",     "as_path",     "origin_asn", "communities",
+  "origin",       "local_pref",  "med",        "atomic_aggregate",
+  "aggregator",   "old_state",   "new_state",  "old_state_code",
+  "new_state_code", "rpki",
+};
+
+// one step of a compiled template: either a field, or a run of literal text
+typedef struct op {
+  int field;
+  const char *lit;
+  size_t lit_len;
+} op_t;
+
+// compiled template of an elem type
+typedef struct tmpl {
+  // copy of the template, that literal ops point into
+  char *text;
+  op_t *ops;
+  int ops_cnt;
+} tmpl_t;
+
+struct bgpstream_elem_formatter {
+  // template of each elem type, NULL if elems of the type are skipped
+  tmpl_t *tmpls[ELEM_TYPE_CNT];
+
+  // rendered text, always nul-terminated
+  char *buf;
+  size_t len;
+  size_t alloc;
+};
+
+// names of the elem types, indexed by type
+static const char *elem_type_names[ELEM_TYPE_CNT] = {
+  "", "R", "A", "W", "S", "E",
+};
+
+// names of the peer states, indexed by state
+static const char *peerstate_names[] = {
+  "",         "IDLE",        "CONNECT",     "ACTIVE",  "OPENSENT",
+  "OPENCONFIRM", "ESTABLISHED", "CLEARING", "DELETED",
+};
+
+static void tmpl_destroy(tmpl_t *tmpl)
+{
+  if (tmpl == NULL) {
+    return;
+  }
+  free(tmpl->text);
+  free(tmpl->ops);
+  free(tmpl);
+}
+
+static int add_op(tmpl_t *tmpl, int field, const char *lit, size_t lit_len)
+{
+  op_t *ops;
+
+  // merge adjacent literals, e.g., the two halves around a "%%"
+  if (field == FIELD_LITERAL && tmpl->ops_cnt > 0 &&
+      tmpl->ops[tmpl->ops_cnt - 1].field == FIELD_LITERAL &&
+      tmpl->ops[tmpl->ops_cnt - 1].lit +
+          tmpl->ops[tmpl->ops_cnt - 1].lit_len == lit) {
+    tmpl->ops[tmpl->ops_cnt - 1].lit_len += lit_len;
+    return 0;
+  }
+
+  if ((ops = realloc(tmpl->ops, sizeof(op_t) * (tmpl->ops_cnt + 1))) ==
+      NULL) {
+    return -1;
+  }
+  tmpl->ops = ops;
+  tmpl->ops[tmpl->ops_cnt].field = field;
+  tmpl->ops[tmpl->ops_cnt].lit = lit;
+  tmpl->ops[tmpl->ops_cnt].lit_len = lit_len;
+  tmpl->ops_cnt++;
+  return 0;
+}
+
+static int find_field(const char *name, size_t len)
+{
+  int i;
+
+  for (i = FIELD_LITERAL + 1; i < (int)ARR_CNT(field_names); i++) {
+    if (strlen(field_names[i]) == len &&
+        strncmp(field_names[i], name, len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static tmpl_t *tmpl_compile(const char *template)
+{
+  tmpl_t *tmpl;
+  char *p, *lit, *end;
+  int field;
+
+  if ((tmpl = malloc_zero(sizeof(tmpl_t))) == NULL ||
+      (tmpl->text = strdup(template)) == NULL) {
+    goto err;
+  }
+
+  p = lit = tmpl->text;
+  while (*p != '\0') {
+    if (*p != '%') {
+      p++;
+      continue;
+    }
+    // "%%" is a literal '%', so keep the first one as part of the literal
+    if (p[1] == '%') {
+      if (add_op(tmpl, FIELD_LITERAL, lit, p + 1 - lit) != 0) {
+        goto err;
+      }
+      p += 2;
+      lit = p;
+      continue;
+    }
+    if (p[1] != '{' || (end = strchr(p + 2, '}')) == NULL ||
+        (field = find_field(p + 2, end - (p + 2))) < 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR,
+                    "Invalid elem template field at '%s' in '%s'", p,
+                    template);
+      goto err;
+    }
+    if ((p != lit && add_op(tmpl, FIELD_LITERAL, lit, p - lit) != 0) ||
+        add_op(tmpl, field, NULL, 0) != 0) {
+      goto err;
+    }
+    p = lit = end + 1;
+  }
+  if (p != lit && add_op(tmpl, FIELD_LITERAL, lit, p - lit) != 0) {
+    goto err;
+  }
+
+  return tmpl;
+
+err:
+  tmpl_destroy(tmpl);
+  return NULL;
+}
+
+// make room for at least len more chars (and the nul) in the buffer
+static int reserve(bgpstream_elem_formatter_t *fmt, size_t len)
+{
+  size_t alloc;
+  char *buf;
+
+  if (fmt->len + len + 1 <= fmt->alloc) {
+    return 0;
+  }
+  alloc = fmt->alloc;
+  while (alloc < fmt->len + len + 1) {
+    alloc *= 2;
+  }
+  if ((buf = realloc(fmt->buf, alloc)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not grow elem formatter buffer");
+    return -1;
+  }
+  fmt->buf = buf;
+  fmt->alloc = alloc;
+  return 0;
+}
+
+// the put_* functions write to p, which must have enough room, and return the
+// number of chars written
+
+static size_t put_u32(char *p, uint32_t v)
+{
+  char tmp[U32_MAX_LEN];
+  size_t n = 0, i;
+
+  do {
+    tmp[n++] = '0' + (v % 10);
+    v /= 10;
+  } while (v != 0);
+  for (i = 0; i < n; i++) {
+    p[i] = tmp[n - 1 - i];
+  }
+  return n;
+}
+
+// zero-padded to six digits, as "%06u" does
+static size_t put_usec(char *p, uint32_t usec)
+{
+  int i;
+
+  if (usec >= 1000000) {
+    return put_u32(p, usec);
+  }
+  for (i = 5; i >= 0; i--) {
+    p[i] = '0' + (usec % 10);
+    usec /= 10;
+  }
+  return 6;
+}
+
+static size_t put_hex16(char *p, uint16_t v)
+{
+  static const char digits[] = "0123456789abcdef";
+  size_t n = 0;
+  int shift;
+
+  for (shift = 12; shift > 0 && (v >> shift) == 0; shift -= 4)
+    ;
+  for (; shift >= 0; shift -= 4) {
+    p[n++] = digits[(v >> shift) & 0xf];
+  }
+  return n;
+}
+
+static size_t put_ipv4(char *p, const uint8_t *a)
+{
+  size_t n = 0;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    if (i != 0) {
+      p[n++] = '.';
+    }
+    n += put_u32(p + n, a[i]);
+  }
+  return n;
+}
+
+// same output as inet_ntop: the longest run of (at least two) zero words is
+// compressed to "::", and IPv4-compatible and -mapped addresses end in a
+// dotted quad
+static size_t put_ipv6(char *p, const uint8_t *a)
+{
+  uint16_t words[8];
+  int best = -1, best_len = 0, cur = -1, cur_len = 0;
+  size_t n = 0;
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    words[i] = (a[2 * i] << 8) | a[2 * i + 1];
+    if (words[i] == 0) {
+      if (cur == -1) {
+        cur = i;
+        cur_len = 0;
+      }
+      cur_len++;
+      if (cur_len > best_len) {
+        best = cur;
+        best_len = cur_len;
+      }
+    } else {
+      cur = -1;
+    }
+  }
+  if (best_len < 2) {
+    best = -1;
+  }
+
+  for (i = 0; i < 8; i++) {
+    if (best != -1 && i >= best && i < best + best_len) {
+      if (i == best) {
+        p[n++] = ':';
+      }
+      continue;
+    }
+    if (i != 0) {
+      p[n++] = ':';
+    }
+    if (i == 6 && best == 0 &&
+        (best_len == 6 || (best_len == 5 && words[5] == 0xffff))) {
+      return n + put_ipv4(p + n, a + 12);
+    }
+    n += put_hex16(p + n, words[i]);
+  }
+  if (best != -1 && best + best_len == 8) {
+    p[n++] = ':';
+  }
+  return n;
+}
+
+// addresses of unknown versions are rendered as an empty string
+static size_t put_addr(char *p, const bgpstream_ip_addr_t *addr)
+{
+  switch (addr->version) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    return put_ipv4(p, (const uint8_t *)&addr->addr);
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    return put_ipv6(p, (const uint8_t *)&addr->addr);
+  default:
+    return 0;
+  }
+}
+
+static size_t put_str(char *p, const char *str, size_t len)
+{
+  memcpy(p, str, len);
+  return len;
+}
+
+static int render_prefix(bgpstream_elem_formatter_t *fmt,
+                         const bgpstream_elem_t *elem)
+{
+  char *p;
+
+  if (elem->prefix.address.version != BGPSTREAM_ADDR_VERSION_IPV4 &&
+      elem->prefix.address.version != BGPSTREAM_ADDR_VERSION_IPV6) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Malformed prefix");
+    return -1;
+  }
+  if (reserve(fmt, PFX_MAX_LEN) != 0) {
+    return -1;
+  }
+  p = fmt->buf + fmt->len;
+  p += put_addr(p, &elem->prefix.address);
+  *(p++) = '/';
+  p += put_u32(p, elem->prefix.mask_len);
+  fmt->len = p - fmt->buf;
+  return 0;
+}
+
+static int render_seg(bgpstream_elem_formatter_t *fmt,
+                      const bgpstream_as_path_seg_t *seg)
+{
+  const char *chars;
+  char *p;
+  int i;
+
+  if (seg->type == BGPSTREAM_AS_PATH_SEG_ASN) {
+    if (reserve(fmt, U32_MAX_LEN) != 0) {
+      return -1;
+    }
+    fmt->len += put_u32(fmt->buf + fmt->len, seg->asn.asn);
+    return 0;
+  }
+
+  switch (seg->type) {
+  case BGPSTREAM_AS_PATH_SEG_SET:
+    chars = "{,}";
+    break;
+  case BGPSTREAM_AS_PATH_SEG_CONFED_SEQ:
+    chars = "( )";
+    break;
+  case BGPSTREAM_AS_PATH_SEG_CONFED_SET:
+    chars = "[,]";
+    break;
+  default:
+    chars = "< >";
+    break;
+  }
+  if (reserve(fmt, (size_t)seg->set.asn_cnt * (U32_MAX_LEN + 1) + 2) != 0) {
+    return -1;
+  }
+  p = fmt->buf + fmt->len;
+  *(p++) = chars[0];
+  for (i = 0; i < seg->set.asn_cnt; i++) {
+    if (i > 0) {
+      *(p++) = chars[1];
+    }
+    p += put_u32(p, seg->set.asn[i]);
+  }
+  *(p++) = chars[2];
+  fmt->len = p - fmt->buf;
+  return 0;
+}
+
+static int render_as_path(bgpstream_elem_formatter_t *fmt,
+                          const bgpstream_as_path_t *path)
+{
+  bgpstream_as_path_iter_t iter;
+  bgpstream_as_path_seg_t *seg;
+  int need_sep = 0;
+
+  bgpstream_as_path_iter_reset(&iter);
+  while ((seg = bgpstream_as_path_get_next_seg(path, &iter)) != NULL) {
+    if (need_sep != 0) {
+      if (reserve(fmt, 1) != 0) {
+        return -1;
+      }
+      fmt->buf[fmt->len++] = ' ';
+    }
+    need_sep = 1;
+    if (render_seg(fmt, seg) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int render_communities(bgpstream_elem_formatter_t *fmt,
+                              const bgpstream_community_set_t *set)
+{
+  const bgpstream_community_t *comm;
+  const bgpstream_large_community_t *lcomm;
+  int cnt = bgpstream_community_set_size(set);
+  int lcnt = bgpstream_community_set_large_size(set);
+  char *p;
+  int i;
+
+  if (reserve(fmt, (size_t)cnt * 12 + (size_t)lcnt * (3 * U32_MAX_LEN + 3)) !=
+      0) {
+    return -1;
+  }
+  p = fmt->buf + fmt->len;
+  for (i = 0; i < cnt; i++) {
+    if (i > 0) {
+      *(p++) = ' ';
+    }
+    comm = bgpstream_community_set_get(set, i);
+    p += put_u32(p, comm->asn);
+    *(p++) = ':';
+    p += put_u32(p, comm->value);
+  }
+  for (i = 0; i < lcnt; i++) {
+    if (cnt > 0 || i > 0) {
+      *(p++) = ' ';
+    }
+    lcomm = bgpstream_community_set_get_large(set, i);
+    p += put_u32(p, lcomm->global_admin);
+    *(p++) = ':';
+    p += put_u32(p, lcomm->local_1);
+    *(p++) = ':';
+    p += put_u32(p, lcomm->local_2);
+  }
+  fmt->len = p - fmt->buf;
+  return 0;
+}
+
+static int render_field(bgpstream_elem_formatter_t *fmt, int field,
+                        const bgpstream_record_t *record,
+                        bgpstream_elem_t *elem)
+{
+  bgpstream_as_path_seg_t *seg;
+  const char *str = NULL;
+  char *p;
+  int is_route = elem->type == BGPSTREAM_ELEM_TYPE_RIB ||
+                 elem->type == BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT;
+  int is_state = elem->type == BGPSTREAM_ELEM_TYPE_PEERSTATE;
+
+  // everything other than the variable-length fields fits in this
+  if (reserve(fmt, PFX_MAX_LEN + U32_MAX_LEN + 2) != 0) {
+    return -1;
+  }
+  p = fmt->buf + fmt->len;
+
+  switch (field) {
+  case FIELD_RECORD_TYPE:
+    if (record->type == BGPSTREAM_RIB) {
+      str = "R";
+    } else if (record->type == BGPSTREAM_UPDATE) {
+      str = "U";
+    }
+    break;
+
+  case FIELD_ELEM_TYPE:
+    str = elem_type_names[elem->type];
+    break;
+
+  case FIELD_TIME:
+    p += put_u32(p, record->time_sec);
+    *(p++) = '.';
+    p += put_usec(p, record->time_usec);
+    break;
+
+  case FIELD_TIME_SEC:
+    p += put_u32(p, record->time_sec);
+    break;
+
+  case FIELD_PROJECT:
+    str = record->project_name;
+    break;
+
+  case FIELD_COLLECTOR:
+    str = record->collector_name;
+    break;
+
+  case FIELD_ROUTER:
+    str = record->router_name;
+    break;
+
+  case FIELD_ROUTER_IP:
+    p += put_addr(p, &record->router_ip);
+    break;
+
+  case FIELD_PEER_ASN:
+    p += put_u32(p, elem->peer_asn);
+    break;
+
+  case FIELD_PEER_IP:
+    p += put_addr(p, &elem->peer_ip);
+    break;
+
+  case FIELD_PREFIX:
+    if (is_route || elem->type == BGPSTREAM_ELEM_TYPE_WITHDRAWAL ||
+        elem->type == BGPSTREAM_ELEM_TYPE_END_OF_RIB) {
+      return render_prefix(fmt, elem);
+    }
+    break;
+
+  case FIELD_NEXT_HOP:
+    if (is_route) {
+      p += put_addr(p, &elem->nexthop);
+    }
+    break;
+
+  case FIELD_AS_PATH:
+    if (is_route) {
+      return render_as_path(fmt, elem->as_path);
+    }
+    break;
+
+  case FIELD_ORIGIN_ASN:
+    if (is_route &&
+        (seg = bgpstream_as_path_get_origin_seg(elem->as_path)) != NULL) {
+      return render_seg(fmt, seg);
+    }
+    break;
+
+  case FIELD_COMMUNITIES:
+    if (is_route) {
+      return render_communities(fmt, elem->communities);
+    }
+    break;
+
+  case FIELD_ORIGIN:
+    if (is_route && elem->has_origin) {
+      switch (elem->origin) {
+      case BGPSTREAM_ELEM_BGP_UPDATE_ORIGIN_IGP:
+        str = "IGP";
+        break;
+      case BGPSTREAM_ELEM_BGP_UPDATE_ORIGIN_EGP:
+        str = "EGP";
+        break;
+      case BGPSTREAM_ELEM_BGP_UPDATE_ORIGIN_INCOMPLETE:
+        str = "INCOMPLETE";
+        break;
+      default:
+        break;
+      }
+    }
+    break;
+
+  case FIELD_LOCAL_PREF:
+    if (is_route) {
+      p += put_u32(p, elem->has_local_pref ? elem->local_pref : 0);
+    }
+    break;
+
+  case FIELD_MED:
+    if (is_route) {
+      p += put_u32(p, elem->has_med ? elem->med : 0);
+    }
+    break;
+
+  case FIELD_ATOMIC_AGGREGATE:
+    if (is_route) {
+      str = elem->atomic_aggregate == 1 ? "AG" : "NAG";
+    }
+    break;
+
+  case FIELD_AGGREGATOR:
+    if (is_route && elem->aggregator.has_aggregator > 0) {
+      p += put_u32(p, elem->aggregator.aggregator_asn);
+      *(p++) = ' ';
+      p += put_addr(p, &elem->aggregator.aggregator_addr);
+    }
+    break;
+
+  case FIELD_OLD_STATE:
+  case FIELD_NEW_STATE:
+    if (is_state) {
+      bgpstream_elem_peerstate_t state =
+        field == FIELD_OLD_STATE ? elem->old_state : elem->new_state;
+      if ((size_t)state < ARR_CNT(peerstate_names)) {
+        str = peerstate_names[state];
+      }
+    }
+    break;
+
+  case FIELD_OLD_STATE_CODE:
+    if (is_state) {
+      p += put_u32(p, elem->old_state);
+    }
+    break;
+
+  case FIELD_NEW_STATE_CODE:
+    if (is_state) {
+      p += put_u32(p, elem->new_state);
+    }
+    break;
+
+  case FIELD_RPKI:
+#ifdef WITH_RPKI
+    // the elem can only be validated if RPKI was set up for it
+    if (is_route && elem->annotations.rpki_active) {
+      if (reserve(fmt, RPKI_RESULT_LEN) != 0) {
+        return -1;
+      }
+      p = fmt->buf + fmt->len;
+      if (bgpstream_rpki_validate(elem, p, RPKI_RESULT_LEN)) {
+        p += strlen(p);
+      }
+    }
+#endif
+    break;
+
+  default:
+    assert(0);
+    return -1;
+  }
+
+  if (str != NULL) {
+    size_t len = strlen(str);
+    if (reserve(fmt, len) != 0) {
+      return -1;
+    }
+    fmt->len += put_str(fmt->buf + fmt->len, str, len);
+  } else {
+    fmt->len = p - fmt->buf;
+  }
+  return 0;
+}
+
+bgpstream_elem_formatter_t *
+bgpstream_elem_formatter_create(const char *template)
+{
+  bgpstream_elem_formatter_t *fmt;
+  int i;
+
+  if ((fmt = malloc_zero(sizeof(bgpstream_elem_formatter_t))) == NULL ||
+      (fmt->buf = malloc(BUF_MIN_ALLOC)) == NULL) {
+    goto err;
+  }
+  fmt->alloc = BUF_MIN_ALLOC;
+  fmt->buf[0] = '\0';
+
+  if (template == NULL) {
+    template = DEFAULT_TEMPLATE;
+  }
+  for (i = BGPSTREAM_ELEM_TYPE_RIB; i < ELEM_TYPE_CNT; i++) {
+    if (bgpstream_elem_formatter_set_template(fmt, i, template) != 0) {
+      goto err;
+    }
+  }
+
+  return fmt;
+
+err:
+  bgpstream_elem_formatter_destroy(fmt);
+  return NULL;
+}
+
+bgpstream_elem_formatter_t *bgpstream_elem_formatter_create_bgpdump(void)
+{
+  bgpstream_elem_formatter_t *fmt;
+  int i;
+
+  // bgpdump has no representation of End-of-RIB markers
+  if ((fmt = bgpstream_elem_formatter_create(NULL)) == NULL ||
+      bgpstream_elem_formatter_set_template(
+        fmt, BGPSTREAM_ELEM_TYPE_END_OF_RIB, NULL) != 0) {
+    goto err;
+  }
+  for (i = 0; i < (int)ARR_CNT(bgpdump_templates); i++) {
+    if (bgpstream_elem_formatter_set_template(
+          fmt, bgpdump_templates[i].type, bgpdump_templates[i].template) !=
+        0) {
+      goto err;
+    }
+  }
+
+  return fmt;
+
+err:
+  bgpstream_elem_formatter_destroy(fmt);
+  return NULL;
+}
+
+int bgpstream_elem_formatter_set_template(bgpstream_elem_formatter_t *fmt,
+                                          bgpstream_elem_type_t type,
+                                          const char *template)
+{
+  tmpl_t *tmpl = NULL;
+
+  if (type <= BGPSTREAM_ELEM_TYPE_UNKNOWN || type >= ELEM_TYPE_CNT) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid elem type %d", type);
+    return -1;
+  }
+  if (template != NULL && (tmpl = tmpl_compile(template)) == NULL) {
+    return -1;
+  }
+  tmpl_destroy(fmt->tmpls[type]);
+  fmt->tmpls[type] = tmpl;
+  return 0;
+}
+
+int bgpstream_elem_formatter_add_elem(bgpstream_elem_formatter_t *fmt,
+                                      const bgpstream_record_t *record,
+                                      bgpstream_elem_t *elem)
+{
+  size_t len = fmt->len;
+  tmpl_t *tmpl;
+  op_t *op;
+  int i;
+
+  if (elem->type <= BGPSTREAM_ELEM_TYPE_UNKNOWN ||
+      elem->type >= ELEM_TYPE_CNT) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Error during elem processing");
+    return -1;
+  }
+  if ((tmpl = fmt->tmpls[elem->type]) == NULL) {
+    return 0;
+  }
+
+  // a lazy elem is logically unchanged by decoding its attributes
+  if (bgpstream_elem_get_as_path(elem) == NULL) {
+    return -1;
+  }
+
+  for (i = 0; i < tmpl->ops_cnt; i++) {
+    op = &tmpl->ops[i];
+    if (op->field == FIELD_LITERAL) {
+      if (reserve(fmt, op->lit_len) != 0) {
+        goto err;
+      }
+      fmt->len += put_str(fmt->buf + fmt->len, op->lit, op->lit_len);
+    } else if (render_field(fmt, op->field, record, elem) != 0) {
+      goto err;
+    }
+  }
+  if (reserve(fmt, 1) != 0) {
+    goto err;
+  }
+  fmt->buf[fmt->len++] = '\n';
+  fmt->buf[fmt->len] = '\0';
+  return 0;
+
+err:
+  // drop the partly rendered elem
+  fmt->len = len;
+  fmt->buf[fmt->len] = '\0';
+  return -1;
+}
+
+size_t bgpstream_elem_formatter_get_output(bgpstream_elem_formatter_t *fmt,
+                                           const char **out)
+{
+  *out = fmt->buf;
+  return fmt->len;
+}
+
+void bgpstream_elem_formatter_clear(bgpstream_elem_formatter_t *fmt)
+{
+  fmt->len = 0;
+  fmt->buf[0] = '\0';
+}
+
+int bgpstream_elem_formatter_write(bgpstream_elem_formatter_t *fmt,
+                                   FILE *file)
+{
+  if (fmt->len != 0 && fwrite(fmt->buf, 1, fmt->len, file) != fmt->len) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not write formatted elems");
+    return -1;
+  }
+  bgpstream_elem_formatter_clear(fmt);
+  return 0;
+}
+
+void bgpstream_elem_formatter_destroy(bgpstream_elem_formatter_t *fmt)
+{
+  int i;
+
+  if (fmt == NULL) {
+    return;
+  }
+  for (i = 0; i < ELEM_TYPE_CNT; i++) {
+    tmpl_destroy(fmt->tmpls[i]);
+  }
+  free(fmt->buf);
+  free(fmt);
+}
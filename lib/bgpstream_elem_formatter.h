@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_ELEM_FORMATTER_H
+#define __BGPSTREAM_ELEM_FORMATTER_H
+
+#include "bgpstream_elem.h"
+#include "bgpstream_record.h"
+#include <stdio.h>
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of the BGPStream elem
+ * formatter, which renders elems as lines of text into a reusable output
+ * buffer.
+ *
+ * What each line looks like is given by a template, which is compiled once
+ * when it is set. A template is literal text in which `%{field}` is replaced
+ * by the value of the given field of the elem (or its record), and `%%` stands
+ * for a single `%`. Fields that do not apply to the type of an elem (e.g., the
+ * AS path of a withdrawal) are rendered as an empty string. The fields are:
+ *
+ * - `record_type`: the record type ("R" or "U")
+ * - `elem_type`: the elem type ("R", "A", "W", "S" or "E")
+ * - `time`: the record time, as "<sec>.<usec>" with six digits of usec
+ * - `time_sec`: the record time in seconds
+ * - `project`, `collector`, `router`: names that the record came from
+ * - `router_ip`: the IP address of the router, if there is one
+ * - `peer_asn`, `peer_ip`: the peer that the elem came from
+ * - `prefix`: the prefix of RIB entries, announcements, withdrawals and
+ *   End-of-RIB markers
+ * - `next_hop`, `as_path`, `origin_asn`, `communities`: attributes of RIB
+ *   entries and announcements
+ * - `origin`, `local_pref`, `med`, `atomic_aggregate`, `aggregator`:
+ *   attributes of RIB entries and announcements, as printed by bgpdump -m
+ *   ("IGP", "0" if there is no LOCAL_PREF or MED, "AG"/"NAG" and
+ *   "<asn> <ip>")
+ * - `old_state`, `new_state`: the peer states of state changes (e.g.,
+ *   "ESTABLISHED")
+ * - `old_state_code`, `new_state_code`: the same, as numbers
+ * - `rpki`: the RPKI validation result, if RPKI validation is active for the
+ *   elem
+ *
+ * Each rendered elem is followed by a newline. The default template renders
+ * elems in the same format as bgpstream_record_elem_snprintf, and
+ * bgpstream_elem_formatter_create_bgpdump creates a formatter with the format
+ * of bgpstream_record_elem_bgpdump_snprintf.
+ */
+
+/**
+ * @name Public Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure that represents an elem formatter */
+typedef struct bgpstream_elem_formatter bgpstream_elem_formatter_t;
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new elem formatter
+ *
+ * @param template      template used for all elem types, or NULL to use the
+ *                      bgpstream_record_elem_snprintf format
+ * @return pointer to the formatter if successful, NULL otherwise
+ */
+bgpstream_elem_formatter_t *
+bgpstream_elem_formatter_create(const char *template);
+
+/** Create a new elem formatter that renders elems in bgpdump -m format
+ *
+ * @return pointer to the formatter if successful, NULL otherwise
+ *
+ * As bgpdump does, the formatter skips End-of-RIB markers.
+ */
+bgpstream_elem_formatter_t *bgpstream_elem_formatter_create_bgpdump(void);
+
+/** Set the template used for elems of the given type
+ *
+ * @param fmt           pointer to the formatter
+ * @param type          elem type to set the template for
+ * @param template      template to use, or NULL to skip elems of this type
+ * @return 0 if the template was set, -1 if it is invalid or an error occurred
+ */
+int bgpstream_elem_formatter_set_template(bgpstream_elem_formatter_t *fmt,
+                                          bgpstream_elem_type_t type,
+                                          const char *template);
+
+/** Render the given elem at the end of the output buffer
+ *
+ * @param fmt           pointer to the formatter
+ * @param record        pointer to the record the elem came from
+ * @param elem          pointer to the elem to render (e.g., as returned by
+ *                      bgpstream_record_get_next_elem)
+ * @return 0 if the elem was rendered (or skipped), -1 if an error occurred
+ *
+ * The buffer grows as needed, and is only emptied by
+ * bgpstream_elem_formatter_clear or bgpstream_elem_formatter_write.
+ */
+int bgpstream_elem_formatter_add_elem(bgpstream_elem_formatter_t *fmt,
+                                      const bgpstream_record_t *record,
+                                      bgpstream_elem_t *elem);
+
+/** Get the text rendered since the buffer was last emptied
+ *
+ * @param fmt           pointer to the formatter
+ * @param[out] out      set to point to the text, which is nul-terminated and
+ *                      owned by the formatter
+ * @return the length of the text
+ */
+size_t bgpstream_elem_formatter_get_output(bgpstream_elem_formatter_t *fmt,
+                                           const char **out);
+
+/** Empty the output buffer of the formatter
+ *
+ * @param fmt           pointer to the formatter
+ */
+void bgpstream_elem_formatter_clear(bgpstream_elem_formatter_t *fmt);
+
+/** Write the rendered text to the given file and empty the output buffer
+ *
+ * @param fmt           pointer to the formatter
+ * @param file          file to write to
+ * @return 0 if successful, -1 if an error occurred
+ */
+int bgpstream_elem_formatter_write(bgpstream_elem_formatter_t *fmt,
+                                   FILE *file);
+
+/** Destroy the given formatter
+ *
+ * @param fmt           pointer to the formatter to destroy
+ */
+void bgpstream_elem_formatter_destroy(bgpstream_elem_formatter_t *fmt);
+
+/** @} */
+
+#endif /* __BGPSTREAM_ELEM_FORMATTER_H */
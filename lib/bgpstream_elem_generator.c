@@ -28,9 +28,13 @@
 #include "utils.h"
 #include <assert.h>
 
+/* elems are allocated in blocks, the first of this many elems, and each later
+ * one as large as all those before it */
+#define ELEM_BLOCK_MIN 16
+
 struct bgpstream_elem_generator {
 
-  /** Array of elems */
+  /** Array of elems (pointers into the blocks) */
   bgpstream_elem_t **elems;
 
   /** Number of elems that are active in the elems list */
@@ -39,12 +43,69 @@ struct bgpstream_elem_generator {
   /** Number of allocated elems in the elems list */
   int elems_alloc_cnt;
 
+  /** Blocks of contiguous elems, in the order they were allocated */
+  bgpstream_elem_t **blocks;
+
+  /** Number of blocks */
+  int blocks_cnt;
+
   /* Current iterator position (iter == cnt means end-of-list) */
   int iter;
 };
 
 /* ==================== PRIVATE FUNCTIONS ==================== */
 
+/* add a block of elems, doubling the number allocated */
+static int add_block(bgpstream_elem_generator_t *self)
+{
+  bgpstream_elem_t **elems, **blocks;
+  bgpstream_elem_t *block;
+  int size, i;
+
+  size = self->elems_alloc_cnt == 0 ? ELEM_BLOCK_MIN : self->elems_alloc_cnt;
+
+  if ((elems = realloc(self->elems, sizeof(bgpstream_elem_t *) *
+                                      (self->elems_alloc_cnt + size))) ==
+      NULL) {
+    return -1;
+  }
+  self->elems = elems;
+  if ((blocks = realloc(self->blocks, sizeof(bgpstream_elem_t *) *
+                                        (self->blocks_cnt + 1))) == NULL) {
+    return -1;
+  }
+  self->blocks = blocks;
+
+  // the AS paths and community sets keep their buffers across clears, so once
+  // the generator has grown, populating it no longer allocates
+  if ((block = malloc_zero(sizeof(bgpstream_elem_t) * size)) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < size; i++) {
+    if ((block[i].as_path = bgpstream_as_path_create()) == NULL ||
+        (block[i].communities = bgpstream_community_set_create()) == NULL) {
+      goto err;
+    }
+    self->elems[self->elems_alloc_cnt + i] = &block[i];
+  }
+
+  self->blocks[self->blocks_cnt++] = block;
+  self->elems_alloc_cnt += size;
+  return 0;
+
+err:
+  for (; i >= 0; i--) {
+    if (block[i].as_path != NULL) {
+      bgpstream_as_path_destroy(block[i].as_path);
+    }
+    if (block[i].communities != NULL) {
+      bgpstream_community_set_destroy(block[i].communities);
+    }
+  }
+  free(block);
+  return -1;
+}
+
 /* ==================== PROTECTED FUNCTIONS ==================== */
 
 bgpstream_elem_generator_t *bgpstream_elem_generator_create()
@@ -70,11 +131,15 @@ void bgpstream_elem_generator_destroy(bgpstream_elem_generator_t *self)
 
   /* free all the alloc'd elems */
   for (i = 0; i < self->elems_alloc_cnt; i++) {
-    bgpstream_elem_destroy(self->elems[i]);
-    self->elems[i] = NULL;
+    bgpstream_as_path_destroy(self->elems[i]->as_path);
+    bgpstream_community_set_destroy(self->elems[i]->communities);
+  }
+  for (i = 0; i < self->blocks_cnt; i++) {
+    free(self->blocks[i]);
   }
 
   free(self->elems);
+  free(self->blocks);
 
   self->elems_cnt = self->elems_alloc_cnt = self->iter = 0;
 
@@ -106,22 +171,8 @@ bgpstream_elem_generator_get_new_elem(bgpstream_elem_generator_t *self)
   bgpstream_elem_t *elem = NULL;
 
   /* check if we need to alloc more elems */
-  if (self->elems_cnt + 1 >= self->elems_alloc_cnt) {
-
-    /* alloc more memory */
-    if ((self->elems = realloc(self->elems, sizeof(bgpstream_elem_t *) *
-                                              (self->elems_alloc_cnt + 1))) ==
-        NULL) {
-      return NULL;
-    }
-
-    /* create an elem */
-    if ((self->elems[self->elems_alloc_cnt] = bgpstream_elem_create()) ==
-        NULL) {
-      return NULL;
-    }
-
-    self->elems_alloc_cnt++;
+  if (self->elems_cnt >= self->elems_alloc_cnt && add_block(self) != 0) {
+    return NULL;
   }
 
   elem = self->elems[self->elems_cnt];
@@ -55,6 +55,21 @@ char *bgpstream_elem_custom_snprintf(char *buf, size_t len,
                                      const bgpstream_elem_t *elem,
                                      int print_type);
 
+/** Defer decoding of the AS path and communities of the given elem
+ *
+ * @param elem          pointer to a BGP Stream Elem
+ * @param decode        function that populates the elem from attrs
+ * @param attrs         opaque attributes passed to decode
+ *
+ * The attributes must remain valid until the elem is cleared (i.e., until the
+ * format module populates the next elem). They are decoded (and forgotten)
+ * the first time the AS path or communities are requested.
+ */
+void bgpstream_elem_set_lazy(bgpstream_elem_t *elem,
+                             int (*decode)(bgpstream_elem_t *elem,
+                                           const void *attrs),
+                             const void *attrs);
+
 /** @} */
 
 #endif /* __BGPSTREAM_ELEM_INT_H */
@@ -37,6 +37,7 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <ctype.h>
 
@@ -49,10 +50,41 @@ bgpstream_filter_mgr_t *bgpstream_filter_mgr_create()
   if (bs_filter_mgr == NULL) {
     return NULL; // can't allocate memory
   }
+  // until filters are added, every elem passes
+  bgpstream_filter_mgr_compile(bs_filter_mgr);
   bgpstream_log(BGPSTREAM_LOG_VFINE, "\tBSF_MGR: create end");
   return bs_filter_mgr;
 }
 
+bgpstream_filter_mgr_t *
+bgpstream_filter_mgr_create_like(const bgpstream_filter_mgr_t *mgr)
+{
+  bgpstream_filter_mgr_t *this;
+
+  if ((this = bgpstream_filter_mgr_create()) == NULL) {
+    return NULL;
+  }
+  if (mgr->time_interval != NULL &&
+      bgpstream_filter_mgr_interval_filter_add(
+        this, mgr->time_interval->begin_time, mgr->time_interval->end_time) ==
+        0) {
+    bgpstream_filter_mgr_destroy(this);
+    return NULL;
+  }
+  // the RIB period state is handed over once the new filters are in use
+  this->rib_period = mgr->rib_period;
+  this->shard = mgr->shard;
+  this->shard_cnt = mgr->shard_cnt;
+  this->shard_span = mgr->shard_span;
+  this->lazy_elems = mgr->lazy_elems;
+  this->unused_elem_fields = mgr->unused_elem_fields;
+  this->raw_records = mgr->raw_records;
+  this->use_summaries = mgr->use_summaries;
+  this->decode_threads = mgr->decode_threads;
+  this->dedup = mgr->dedup;
+  return this;
+}
+
 // Create *setp if needed, and insert value into *setp.
 // Returns 1 for success, 0 for failure.
 static int bsf_id_set_insert(bgpstream_id_set_t **setp, uint32_t value)
@@ -212,6 +244,13 @@ int bgpstream_filter_mgr_filter_add(bgpstream_filter_mgr_t *this,
     }
     this->aspath_exprs[this->aspath_expr_cnt-1].re = re;
     this->aspath_exprs[this->aspath_expr_cnt-1].negate = negate;
+    // most expressions can be matched on the ASNs of a path, keeping the
+    // regex for paths with sets and confederations
+    if ((this->aspath_exprs[this->aspath_expr_cnt - 1].match =
+           bgpstream_as_path_match_create(filter_value)) != NULL) {
+      bgpstream_log(BGPSTREAM_LOG_FINE, "matching \"%s\" on ASNs",
+                    filter_value);
+    }
     return 1;
   }
 
@@ -254,40 +293,55 @@ int bgpstream_filter_mgr_filter_add(bgpstream_filter_mgr_t *this,
     return 1;
   }
   case BGPSTREAM_FILTER_TYPE_ELEM_COMMUNITY: {
-    int mask = 0;
-    khiter_t k;
+    bgpstream_community_filter_t *cf;
+    bgpstream_community_t comm;
+    bgpstream_large_community_t lcomm;
+    int mask;
     int khret;
 
-    bgpstream_community_t comm;
-    if (this->communities == NULL) {
-      if ((this->communities = kh_init(bgpstream_community_filter)) ==
-          NULL) {
+    if (this->communities == NULL &&
+        (this->communities =
+           malloc_zero(sizeof(bgpstream_community_filter_t))) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "can't allocate memory");
+      return 0;
+    }
+    cf = this->communities;
+
+    // communities with three parts are large communities
+    if (strchr(filter_value, ':') != strrchr(filter_value, ':')) {
+      if ((mask = bgpstream_str2large_community(filter_value, &lcomm)) < 0) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "invalid large community '%s'",
+                      filter_value);
+        return 0;
+      }
+      if ((cf->large[mask] == NULL &&
+           (cf->large[mask] = kh_init(bgpstream_large_community_idx)) ==
+             NULL) ||
+          (kh_put(bgpstream_large_community_idx, cf->large[mask], lcomm,
+                  &khret),
+           khret < 0)) {
         bgpstream_log(BGPSTREAM_LOG_ERR, "can't allocate memory");
         return 0;
       }
+      return 1;
     }
+
+    // the wildcard parts are left untouched, and so stay zero
+    comm.ui32 = 0;
     if ((mask = bgpstream_str2community(filter_value, &comm)) < 0) {
       bgpstream_log(BGPSTREAM_LOG_ERR, "invalid community '%s'",
           filter_value);
       return 0;
     }
-
-    if ((k = kh_get(bgpstream_community_filter, this->communities,
-                    comm)) == kh_end(this->communities)) {
-      k = kh_put(bgpstream_community_filter, this->communities, comm,
-                 &khret);
-      kh_value(this->communities, k) = (uint8_t)mask;
+    /* a community matches when it matches the filter of any mask, so e.g.
+     * 10:0, 10:* is equivalent to 10:* */
+    if ((cf->comms[mask] == NULL &&
+         (cf->comms[mask] = kh_init(bgpstream_community_idx)) == NULL) ||
+        (kh_put(bgpstream_community_idx, cf->comms[mask], comm.ui32, &khret),
+         khret < 0)) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "can't allocate memory");
+      return 0;
     }
-
-    /* we use the AND because the less restrictive filter wins over the more
-     * restrictive:
-     * e.g. 10:0, 10:* is equivalent to 10:*
-     */
-    kh_value(this->communities, k) =
-      kh_value(this->communities, k) & mask;
-    /* DEBUG: fprintf(stderr, "%s - %d\n",
-     *                filter_value, kh_value(this->communities, k) );
-     */
     return 1;
   }
 
@@ -355,6 +409,45 @@ int bgpstream_filter_mgr_rib_period_filter_add(
   return 1;
 }
 
+int bgpstream_filter_mgr_shard_filter_add(bgpstream_filter_mgr_t *this,
+                                          uint32_t shard, uint32_t shard_cnt,
+                                          uint32_t span)
+{
+  assert(this != NULL);
+  if (shard_cnt == 0 || shard >= shard_cnt) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "invalid shard %" PRIu32 " of %" PRIu32,
+                  shard, shard_cnt);
+    return 0;
+  }
+  this->shard = shard;
+  this->shard_cnt = shard_cnt;
+  this->shard_span = (span != 0) ? span : BGPSTREAM_SHARD_DEFAULT_SPAN;
+  return 1;
+}
+
+int bgpstream_filter_mgr_sample_filter_add(bgpstream_filter_mgr_t *this,
+                                           bgpstream_sample_key_t key,
+                                           uint32_t slice, uint32_t slice_cnt)
+{
+  assert(this != NULL);
+  if ((key != BGPSTREAM_SAMPLE_KEY_PREFIX &&
+       key != BGPSTREAM_SAMPLE_KEY_PEER_ASN) ||
+      slice_cnt == 0 || slice >= slice_cnt) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "invalid sample %" PRIu32 " of %" PRIu32 " (key %d)", slice,
+                  slice_cnt, key);
+    return 0;
+  }
+  if (this->sample_key != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "only one sample filter can be set");
+    return 0;
+  }
+  this->sample_key = key;
+  this->sample_slice = slice;
+  this->sample_slice_cnt = slice_cnt;
+  return 1;
+}
+
 int bgpstream_filter_mgr_interval_filter_add(
   bgpstream_filter_mgr_t *this, uint32_t begin_time, uint32_t end_time)
 {
@@ -378,6 +471,119 @@ int bgpstream_filter_mgr_interval_filter_add(
   return 1;
 }
 
+int bgpstream_filter_mgr_set_add(bgpstream_filter_mgr_t *this,
+                                 const char *name)
+{
+  int i;
+
+  if (this->sets_cnt == BGPSTREAM_FILTER_SETS_MAX) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "At most %d filter sets can be added",
+                  BGPSTREAM_FILTER_SETS_MAX);
+    return -1;
+  }
+  for (i = 0; i < this->sets_cnt; i++) {
+    if (strcmp(this->set_names[i], name) == 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Duplicate filter set '%s'", name);
+      return -1;
+    }
+  }
+  if ((this->set_names[i] = strdup(name)) == NULL) {
+    return -1;
+  }
+  if ((this->sets[i] = bgpstream_filter_mgr_create()) == NULL) {
+    free(this->set_names[i]);
+    this->set_names[i] = NULL;
+    return -1;
+  }
+  return this->sets_cnt++;
+}
+
+// can the filter be added to a filter set? the resources to read are shared
+// by every set, so only elem filters can
+static int is_set_filter(bgpstream_filter_mgr_t *this, int set,
+                         bgpstream_filter_type_t filter_type)
+{
+  if (set < 0 || set >= this->sets_cnt) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Unknown filter set %d", set);
+    return 0;
+  }
+
+  switch (filter_type) {
+  case BGPSTREAM_FILTER_TYPE_ELEM_NOT_PEER_ASN:
+  case BGPSTREAM_FILTER_TYPE_ELEM_PEER_ASN:
+  case BGPSTREAM_FILTER_TYPE_ELEM_ORIGIN_ASN:
+  case BGPSTREAM_FILTER_TYPE_ELEM_PREFIX:
+  case BGPSTREAM_FILTER_TYPE_ELEM_COMMUNITY:
+  case BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_EXACT:
+  case BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_MORE:
+  case BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_LESS:
+  case BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_ANY:
+  case BGPSTREAM_FILTER_TYPE_ELEM_ASPATH:
+  case BGPSTREAM_FILTER_TYPE_ELEM_IP_VERSION:
+  case BGPSTREAM_FILTER_TYPE_ELEM_TYPE:
+    return 1;
+
+  default:
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Only elem filters can be added to filter set '%s'",
+                  this->set_names[set]);
+    return 0;
+  }
+}
+
+int bgpstream_filter_mgr_set_filter_add(bgpstream_filter_mgr_t *this, int set,
+                                        bgpstream_filter_type_t filter_type,
+                                        const char *filter_value)
+{
+  if (!is_set_filter(this, set, filter_type)) {
+    return 0;
+  }
+  return bgpstream_filter_mgr_filter_add(this->sets[set], filter_type,
+                                         filter_value);
+}
+
+int bgpstream_filter_mgr_set_filter_add_file(
+  bgpstream_filter_mgr_t *this, int set, bgpstream_filter_type_t filter_type,
+  const char *path)
+{
+  if (!is_set_filter(this, set, filter_type)) {
+    return 0;
+  }
+  return bgpstream_filter_mgr_filter_add_file(this->sets[set], filter_type,
+                                              path);
+}
+
+#define FREEZE(type, set)                                                     \
+  do {                                                                         \
+    if ((set) != NULL && bgpstream_##type##_set_freeze(set) != 0) {            \
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not freeze filter set");         \
+      return -1;                                                               \
+    }                                                                          \
+  } while (0)
+
+/* the sets no longer change once the stream starts, so give them faster
+   read-only lookups */
+static int freeze_sets(bgpstream_filter_mgr_t *mgr)
+{
+  int i;
+
+  FREEZE(str, mgr->projects);
+  FREEZE(str, mgr->collectors);
+  FREEZE(str, mgr->routers);
+  FREEZE(str, mgr->bgp_types);
+  FREEZE(str, mgr->res_types);
+  FREEZE(id, mgr->peer_asns);
+  FREEZE(id, mgr->not_peer_asns);
+  FREEZE(id, mgr->origin_asns);
+
+  for (i = 0; i < mgr->sets_cnt; i++) {
+    if (freeze_sets(mgr->sets[i]) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
 int bgpstream_filter_mgr_validate(bgpstream_filter_mgr_t *filter_mgr)
 {
   /* currently we only validate the interval */
@@ -391,10 +597,361 @@ int bgpstream_filter_mgr_validate(bgpstream_filter_mgr_t *filter_mgr)
     return -1;
   }
 
-  return 0;
+  return freeze_sets(filter_mgr);
+}
+
+static void prog_add_op(bgpstream_filter_prog_t *prog,
+                        bgpstream_filter_op_type_t type, uint32_t cost)
+{
+  bgpstream_filter_op_t *op = &prog->ops[prog->ops_cnt++];
+
+  op->type = type;
+  op->cost = cost;
+  op->runs = 0;
+  op->rejects = 0;
+}
+
+void bgpstream_filter_mgr_compile(bgpstream_filter_mgr_t *filter_mgr)
+{
+  bgpstream_filter_prog_t *prog = &filter_mgr->elem_prog;
+  static const struct {
+    bgpstream_elem_type_t type;
+    uint8_t filter;
+  } elem_types[] = {
+    {BGPSTREAM_ELEM_TYPE_RIB, BGPSTREAM_FILTER_ELEM_TYPE_RIB},
+    {BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT, BGPSTREAM_FILTER_ELEM_TYPE_ANNOUNCEMENT},
+    {BGPSTREAM_ELEM_TYPE_WITHDRAWAL, BGPSTREAM_FILTER_ELEM_TYPE_WITHDRAWAL},
+    {BGPSTREAM_ELEM_TYPE_PEERSTATE, BGPSTREAM_FILTER_ELEM_TYPE_PEERSTATE},
+    {BGPSTREAM_ELEM_TYPE_END_OF_RIB, BGPSTREAM_FILTER_ELEM_TYPE_END_OF_RIB},
+  };
+  uint8_t set_types;
+  int i;
+
+  // elem types that are not asked for, or that lack what a filter looks at,
+  // are rejected with a single test
+  prog->elem_types = 0xff;
+  if (filter_mgr->elemtype_mask) {
+    for (i = 0; i < ARR_CNT(elem_types); i++) {
+      if ((filter_mgr->elemtype_mask & elem_types[i].filter) == 0) {
+        prog->elem_types &= ~(1 << elem_types[i].type);
+      }
+    }
+  }
+  if (filter_mgr->ipversion || filter_mgr->prefixes ||
+      filter_mgr->sample_key == BGPSTREAM_SAMPLE_KEY_PREFIX) {
+    // peer state elems have no prefix
+    prog->elem_types &= ~(1 << BGPSTREAM_ELEM_TYPE_PEERSTATE);
+  }
+  if (filter_mgr->origin_asns || filter_mgr->aspath_exprs ||
+      filter_mgr->communities) {
+    // nor do they (or withdrawals) have path attributes
+    prog->elem_types &= ~((1 << BGPSTREAM_ELEM_TYPE_PEERSTATE) |
+                          (1 << BGPSTREAM_ELEM_TYPE_WITHDRAWAL));
+  }
+
+  // the remaining checks start out cheapest first, and are reordered by how
+  // often they reject elems as the stream goes
+  prog->ops_cnt = 0;
+  prog->checked = 0;
+  if (filter_mgr->ipversion) {
+    prog_add_op(prog, BGPSTREAM_FILTER_OP_IPVERSION, 1);
+  }
+  if (filter_mgr->sample_key) {
+    prog_add_op(prog, BGPSTREAM_FILTER_OP_SAMPLE, 2);
+  }
+  if (filter_mgr->peer_asns) {
+    prog_add_op(prog, BGPSTREAM_FILTER_OP_PEER_ASN, 2);
+  }
+  if (filter_mgr->not_peer_asns) {
+    prog_add_op(prog, BGPSTREAM_FILTER_OP_NOT_PEER_ASN, 2);
+  }
+  if (filter_mgr->origin_asns) {
+    prog_add_op(prog, BGPSTREAM_FILTER_OP_ORIGIN_ASN, 4);
+  }
+  if (filter_mgr->prefixes) {
+    prog_add_op(prog, BGPSTREAM_FILTER_OP_PREFIX, 8);
+    bgpstream_pfx_index_destroy(filter_mgr->prefix_index);
+    if ((filter_mgr->prefix_index =
+           bgpstream_pfx_index_create(filter_mgr->prefixes)) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_WARN,
+                    "Matching prefix filters without an index");
+    }
+  }
+  if (filter_mgr->communities) {
+    prog_add_op(prog, BGPSTREAM_FILTER_OP_COMMUNITY, 16);
+  }
+  if (filter_mgr->aspath_exprs) {
+    // expressions matched on ASNs are far cheaper than regexes
+    for (i = 0; i < filter_mgr->aspath_expr_cnt &&
+                filter_mgr->aspath_exprs[i].match != NULL;
+         i++)
+      ;
+    prog_add_op(prog, BGPSTREAM_FILTER_OP_ASPATH,
+                i == filter_mgr->aspath_expr_cnt ? 8 : 64);
+  }
+  prog->order = 0;
+  for (i = 0; i < prog->ops_cnt; i++) {
+    prog->order |= (uint32_t)i << (i * BGPSTREAM_FILTER_ORDER_BITS);
+  }
+
+  // an elem that can pass no set can be rejected as early as one that fails
+  // the filters of the stream
+  if (filter_mgr->sets_cnt != 0) {
+    set_types = 0;
+    for (i = 0; i < filter_mgr->sets_cnt; i++) {
+      bgpstream_filter_mgr_compile(filter_mgr->sets[i]);
+      set_types |= filter_mgr->sets[i]->elem_prog.elem_types;
+    }
+    prog->elem_types &= set_types;
+  }
+}
+
+uint8_t bgpstream_filter_mgr_elem_fields(bgpstream_filter_mgr_t *filter_mgr)
+{
+  bgpstream_filter_mgr_t *mgr;
+  uint8_t fields = 0;
+  int i;
+
+  for (i = -1; i < filter_mgr->sets_cnt; i++) {
+    mgr = i < 0 ? filter_mgr : filter_mgr->sets[i];
+    if (mgr->aspath_exprs != NULL || mgr->origin_asns != NULL) {
+      fields |= BGPSTREAM_ELEM_FIELD_AS_PATH;
+    }
+    if (mgr->communities != NULL) {
+      fields |= BGPSTREAM_ELEM_FIELD_COMMUNITIES;
+    }
+  }
+  return fields;
 }
 
 /* destroy the memory allocated for bgpstream filter */
+static bgpstream_patricia_walk_cb_result_t pfx_exists(
+    const bgpstream_patricia_tree_t *pt, const bgpstream_patricia_node_t *node,
+    void *data)
+{
+  *(int*)data = 1;
+  return BGPSTREAM_PATRICIA_WALK_END_ALL;
+}
+
+static bgpstream_patricia_walk_cb_result_t pfx_allows_more_specifics(
+    const bgpstream_patricia_tree_t *pt, const bgpstream_patricia_node_t *node,
+    void *data)
+{
+  const bgpstream_pfx_t *pfx = bgpstream_patricia_tree_get_pfx(node);
+  if (pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_ANY ||
+      pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_MORE) {
+    *(int*)data = 1;
+    return BGPSTREAM_PATRICIA_WALK_END_ALL;
+  }
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+static bgpstream_patricia_walk_cb_result_t pfx_allows_less_specifics(
+    const bgpstream_patricia_tree_t *pt, const bgpstream_patricia_node_t *node,
+    void *data)
+{
+  const bgpstream_pfx_t *pfx = bgpstream_patricia_tree_get_pfx(node);
+  if (pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_ANY ||
+      pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_LESS) {
+    *(int*)data = 1;
+    return BGPSTREAM_PATRICIA_WALK_END_ALL;
+  }
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+int bgpstream_filter_mgr_prefix_match(bgpstream_filter_mgr_t *this,
+                                      bgpstream_pfx_t *pfx)
+{
+  int matched = 0;
+
+  if (this->prefix_index != NULL) {
+    return bgpstream_pfx_index_match(this->prefix_index, pfx);
+  }
+  bgpstream_patricia_tree_walk_up_down(this->prefixes, pfx, pfx_exists,
+      pfx_allows_more_specifics, pfx_allows_less_specifics, &matched);
+  return matched;
+}
+
+// FNV-1a over the bytes of a key, followed by the finaliser of MurmurHash3 so
+// that keys which differ in their last bits (e.g., adjacent prefixes) are
+// spread over every slice. the hash must not depend on the platform or the
+// run, so that samples are comparable
+static uint64_t sample_hash(const uint8_t *key, int len)
+{
+  uint64_t h = 14695981039346656037ULL;
+  int i;
+
+  for (i = 0; i < len; i++) {
+    h = (h ^ key[i]) * 1099511628211ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static int sample_selects(bgpstream_filter_mgr_t *this, uint64_t h)
+{
+  return h % this->sample_slice_cnt == this->sample_slice;
+}
+
+int bgpstream_filter_mgr_sample_pfx(bgpstream_filter_mgr_t *this,
+                                    bgpstream_pfx_t *pfx)
+{
+  uint8_t key[2 + 16];
+  int len;
+
+  // the version and length, then the network bytes, with any host bits that
+  // were left set cleared (the values of AF_INET6 differ across platforms)
+  key[0] = pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV6 ? 6 : 4;
+  key[1] = pfx->mask_len;
+  len = (pfx->mask_len + 7) / 8;
+  if (len > 16) {
+    len = 16;
+  }
+  memcpy(&key[2], pfx->address.addr, len);
+  if (len > 0 && (pfx->mask_len % 8) != 0) {
+    key[1 + len] &= 0xff << (8 - pfx->mask_len % 8);
+  }
+  return sample_selects(this, sample_hash(key, 2 + len));
+}
+
+int bgpstream_filter_mgr_sample_peer(bgpstream_filter_mgr_t *this,
+                                     uint32_t peer_asn)
+{
+  uint8_t key[4];
+
+  key[0] = peer_asn >> 24;
+  key[1] = peer_asn >> 16;
+  key[2] = peer_asn >> 8;
+  key[3] = peer_asn;
+  return sample_selects(this, sample_hash(key, sizeof(key)));
+}
+
+int bgpstream_filter_mgr_peer_wanted(bgpstream_filter_mgr_t *this,
+                                     uint32_t peer_asn)
+{
+  if (this->sample_key == BGPSTREAM_SAMPLE_KEY_PEER_ASN &&
+      bgpstream_filter_mgr_sample_peer(this, peer_asn) == 0) {
+    return 0;
+  }
+  if (this->peer_asns != NULL &&
+      bgpstream_id_set_exists(this->peer_asns, peer_asn) == 0) {
+    return 0;
+  }
+  if (this->not_peer_asns != NULL &&
+      bgpstream_id_set_exists(this->not_peer_asns, peer_asn) != 0) {
+    return 0;
+  }
+  return 1;
+}
+
+int bgpstream_filter_mgr_pfx_wanted(bgpstream_filter_mgr_t *this,
+                                    bgpstream_pfx_t *pfx)
+{
+  if (this->ipversion != 0 && pfx->address.version != this->ipversion) {
+    return 0;
+  }
+  if (this->sample_key == BGPSTREAM_SAMPLE_KEY_PREFIX &&
+      bgpstream_filter_mgr_sample_pfx(this, pfx) == 0) {
+    return 0;
+  }
+  if (this->prefixes != NULL &&
+      bgpstream_filter_mgr_prefix_match(this, pfx) == 0) {
+    return 0;
+  }
+  return 1;
+}
+
+// approximate number of bytes that each prefix takes up in a patricia tree
+// (its node, a share of the glue nodes, and the prefix itself)
+#define PATRICIA_PFX_MEM 96
+
+// approximate number of bytes that each entry of a string or ID set takes up
+#define SET_ENTRY_MEM 32
+
+static size_t str_set_mem_size(bgpstream_str_set_t *set)
+{
+  return set == NULL ? 0 : bgpstream_str_set_size(set) * SET_ENTRY_MEM;
+}
+
+static size_t id_set_mem_size(bgpstream_id_set_t *set)
+{
+  return set == NULL ? 0 : bgpstream_id_set_size(set) * SET_ENTRY_MEM;
+}
+
+void bgpstream_filter_mgr_get_perf_stats(bgpstream_filter_mgr_t *mgr,
+                                         bgpstream_perf_stats_t *stats)
+{
+  bgpstream_filter_prog_t *prog = &mgr->elem_prog;
+  uint64_t rejects;
+  int i;
+
+  // the elem type is checked first, and then the ops, which are in the same
+  // order as the filters after it
+  stats->elems = __atomic_load_n(&prog->elems, __ATOMIC_RELAXED);
+  stats->filter_runs[BGPSTREAM_PERF_FILTER_ELEM_TYPE] = stats->elems;
+  rejects = stats->filter_rejects[BGPSTREAM_PERF_FILTER_ELEM_TYPE] =
+    __atomic_load_n(&prog->type_rejects, __ATOMIC_RELAXED);
+  for (i = 0; i < BGPSTREAM_FILTER_OP_CNT; i++) {
+    stats->filter_runs[i + 1] =
+      __atomic_load_n(&prog->op_runs[i], __ATOMIC_RELAXED);
+    stats->filter_rejects[i + 1] =
+      __atomic_load_n(&prog->op_rejects[i], __ATOMIC_RELAXED);
+    rejects += stats->filter_rejects[i + 1];
+  }
+  stats->elems_passed = stats->elems > rejects ? stats->elems - rejects : 0;
+}
+
+size_t bgpstream_filter_mgr_get_mem_size(const bgpstream_filter_mgr_t *mgr)
+{
+  size_t size;
+  int i;
+
+  if (mgr == NULL) {
+    return 0;
+  }
+  size = sizeof(*mgr);
+  size += str_set_mem_size(mgr->projects);
+  size += str_set_mem_size(mgr->collectors);
+  size += str_set_mem_size(mgr->routers);
+  size += str_set_mem_size(mgr->bgp_types);
+  size += str_set_mem_size(mgr->res_types);
+  size += id_set_mem_size(mgr->peer_asns);
+  size += id_set_mem_size(mgr->not_peer_asns);
+  size += id_set_mem_size(mgr->origin_asns);
+  size += mgr->aspath_expr_alloc_cnt * sizeof(bgpstream_aspath_expr_t);
+  if (mgr->prefixes != NULL) {
+    size += PATRICIA_PFX_MEM *
+            (bgpstream_patricia_prefix_count(mgr->prefixes,
+                                             BGPSTREAM_ADDR_VERSION_IPV4) +
+             bgpstream_patricia_prefix_count(mgr->prefixes,
+                                             BGPSTREAM_ADDR_VERSION_IPV6));
+  }
+  size += bgpstream_pfx_index_get_mem_size(mgr->prefix_index);
+  if (mgr->communities != NULL) {
+    size += sizeof(*mgr->communities);
+    for (i = 0; i <= BGPSTREAM_COMMUNITY_FILTER_EXACT; i++) {
+      if (mgr->communities->comms[i] != NULL) {
+        size += kh_n_buckets(mgr->communities->comms[i]) *
+                (sizeof(khint32_t) + 1);
+      }
+    }
+    for (i = 0; i <= BGPSTREAM_LARGE_COMMUNITY_FILTER_EXACT; i++) {
+      if (mgr->communities->large[i] != NULL) {
+        size += kh_n_buckets(mgr->communities->large[i]) *
+                (sizeof(bgpstream_large_community_t) + 1);
+      }
+    }
+  }
+  for (i = 0; i < mgr->sets_cnt; i++) {
+    size += bgpstream_filter_mgr_get_mem_size(mgr->sets[i]);
+  }
+  return size;
+}
+
 void bgpstream_filter_mgr_destroy(bgpstream_filter_mgr_t *this)
 {
   bgpstream_log(BGPSTREAM_LOG_VFINE, "\tBSF_MGR:: destroy start");
@@ -441,6 +998,7 @@ void bgpstream_filter_mgr_destroy(bgpstream_filter_mgr_t *this)
       if (this->aspath_exprs[i].re) {
         regfree(this->aspath_exprs[i].re);
       }
+      bgpstream_as_path_match_destroy(this->aspath_exprs[i].match);
     }
     free(this->aspath_exprs);
   }
@@ -448,9 +1006,20 @@ void bgpstream_filter_mgr_destroy(bgpstream_filter_mgr_t *this)
   if (this->prefixes != NULL) {
     bgpstream_patricia_tree_destroy(this->prefixes);
   }
+  bgpstream_pfx_index_destroy(this->prefix_index);
   // communities
   if (this->communities != NULL) {
-    kh_destroy(bgpstream_community_filter, this->communities);
+    for (int i = 0; i <= BGPSTREAM_COMMUNITY_FILTER_EXACT; i++) {
+      if (this->communities->comms[i] != NULL) {
+        kh_destroy(bgpstream_community_idx, this->communities->comms[i]);
+      }
+    }
+    for (int i = 0; i <= BGPSTREAM_LARGE_COMMUNITY_FILTER_EXACT; i++) {
+      if (this->communities->large[i] != NULL) {
+        kh_destroy(bgpstream_large_community_idx, this->communities->large[i]);
+      }
+    }
+    free(this->communities);
   }
   // time_interval
   if (this->time_interval != NULL) {
@@ -466,6 +1035,11 @@ void bgpstream_filter_mgr_destroy(bgpstream_filter_mgr_t *this)
     }
     kh_destroy(collector_ts, this->last_processed_ts);
   }
+  // filter sets
+  for (int i = 0; i < this->sets_cnt; i++) {
+    bgpstream_filter_mgr_destroy(this->sets[i]);
+    free(this->set_names[i]);
+  }
   // free the mgr structure
   free(this);
   this = NULL;
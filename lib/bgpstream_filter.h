@@ -34,6 +34,8 @@
 
 #include "bgpstream.h"
 #include "bgpstream_constants.h"
+#include "bgpstream_filter_pfx.h"
+#include "bgpstream_utils_as_path_match.h"
 #include "khash.h"
 #include <regex.h>
 
@@ -43,11 +45,24 @@
 #define BGPSTREAM_FILTER_ELEM_TYPE_PEERSTATE 0x8
 #define BGPSTREAM_FILTER_ELEM_TYPE_END_OF_RIB 0x10
 
-/* hash table community filter:
- * community -> filter mask (asn only, value only, both) */
-KHASH_INIT(bgpstream_community_filter, bgpstream_community_t, uint8_t, 1,
-           bgpstream_community_hash_value, bgpstream_community_equal_value)
-typedef khash_t(bgpstream_community_filter) bgpstream_community_filter_t;
+/* community filter indexes: one set for each filter mask (asn only, value
+ * only, both, neither), holding the filter communities with the parts that
+ * are not matched zeroed. An elem community then matches if its masked value
+ * is in the set of any mask that is in use. */
+KHASH_SET_INIT_INT(bgpstream_community_idx)
+KHASH_INIT(bgpstream_large_community_idx, bgpstream_large_community_t, char, 0,
+           bgpstream_large_community_hash_value,
+           bgpstream_large_community_equal_value)
+
+typedef struct struct_bgpstream_community_filter_t {
+  /* indexed by BGPSTREAM_COMMUNITY_FILTER_* mask, NULL if not used */
+  khash_t(bgpstream_community_idx) *
+    comms[BGPSTREAM_COMMUNITY_FILTER_EXACT + 1];
+
+  /* indexed by BGPSTREAM_LARGE_COMMUNITY_FILTER_* mask, NULL if not used */
+  khash_t(bgpstream_large_community_idx) *
+    large[BGPSTREAM_LARGE_COMMUNITY_FILTER_EXACT + 1];
+} bgpstream_community_filter_t;
 
 typedef struct struct_bgpstream_interval_filter_t {
   uint32_t begin_time;
@@ -61,9 +76,67 @@ typedef khash_t(collector_ts) collector_ts_t;
 
 typedef struct struct_bgpstream_aspath_expr_t {
   regex_t *re;
+  /* the expression matched on ASNs (NULL if it must be run as a regex) */
+  bgpstream_as_path_match_t *match;
   uint8_t negate;
 } bgpstream_aspath_expr_t;
 
+/* the elem checks a compiled filter program can run (in order of increasing
+ * cost) */
+typedef enum {
+  BGPSTREAM_FILTER_OP_IPVERSION,
+  BGPSTREAM_FILTER_OP_PEER_ASN,
+  BGPSTREAM_FILTER_OP_NOT_PEER_ASN,
+  BGPSTREAM_FILTER_OP_ORIGIN_ASN,
+  BGPSTREAM_FILTER_OP_PREFIX,
+  BGPSTREAM_FILTER_OP_COMMUNITY,
+  BGPSTREAM_FILTER_OP_ASPATH,
+  BGPSTREAM_FILTER_OP_SAMPLE,
+  BGPSTREAM_FILTER_OP_CNT,
+} bgpstream_filter_op_type_t;
+
+/* one check of a compiled filter program, with how often it has run and
+ * rejected an elem lately */
+typedef struct struct_bgpstream_filter_op_t {
+  bgpstream_filter_op_type_t type;
+  uint32_t cost;
+  uint32_t runs;
+  uint32_t rejects;
+} bgpstream_filter_op_t;
+
+/* bits of bgpstream_filter_prog_t.order used by each index into ops */
+#define BGPSTREAM_FILTER_ORDER_BITS 3
+#define BGPSTREAM_FILTER_ORDER_MASK ((1 << BGPSTREAM_FILTER_ORDER_BITS) - 1)
+
+/* the elem filters, compiled by bgpstream_filter_mgr_compile. the elems of
+ * different records may be filtered by several threads at once, so the ops
+ * never move: they are reordered by storing a new order word, and the
+ * statistics are updated with relaxed loads and stores (which may lose the odd
+ * count when threads race, but need no locking) */
+typedef struct struct_bgpstream_filter_prog_t {
+  /* bit (1 << type) is set for each elem type that can pass the filters */
+  uint8_t elem_types;
+
+  /* the checks for the filters that are set */
+  bgpstream_filter_op_t ops[BGPSTREAM_FILTER_OP_CNT];
+  int ops_cnt;
+
+  /* indexes into ops, most worthwhile first, BGPSTREAM_FILTER_ORDER_BITS bits
+   * each (starting from the low bits) */
+  uint32_t order;
+
+  /* elems checked since the ops were last reordered */
+  uint32_t checked;
+
+  /* totals since the filters were created: elems checked, elems rejected for
+   * their type, and runs and rejections of each check (indexed by
+   * bgpstream_filter_op_type_t) */
+  uint64_t elems;
+  uint64_t type_rejects;
+  uint64_t op_runs[BGPSTREAM_FILTER_OP_CNT];
+  uint64_t op_rejects[BGPSTREAM_FILTER_OP_CNT];
+} bgpstream_filter_prog_t;
+
 typedef struct struct_bgpstream_filter_mgr_t {
   bgpstream_str_set_t *projects;
   bgpstream_str_set_t *collectors;
@@ -77,17 +150,47 @@ typedef struct struct_bgpstream_filter_mgr_t {
   bgpstream_id_set_t *not_peer_asns;
   bgpstream_id_set_t *origin_asns;
   bgpstream_patricia_tree_t *prefixes;
+  /* prefixes compiled for matching, falls back to walking the tree if NULL */
+  bgpstream_pfx_index_t *prefix_index;
   bgpstream_community_filter_t *communities;
   bgpstream_interval_filter_t *time_interval;
   collector_ts_t *last_processed_ts;
   uint32_t rib_period;
+  uint32_t shard;
+  uint32_t shard_cnt;
+  uint32_t shard_span;
+  /* the sample filter (see bgpstream_add_sample_filter), unset if sample_key
+   * is 0 */
+  uint8_t sample_key;
+  uint32_t sample_slice;
+  uint32_t sample_slice_cnt;
   uint8_t ipversion;
   uint8_t elemtype_mask;
+  uint8_t lazy_elems;
+  uint8_t unused_elem_fields;
+  uint8_t raw_records;
+  uint8_t use_summaries;
+  int decode_threads;
+  /* drops duplicate elems after the filters (see bgpstream_set_dedup). owned
+   * by the stream, and shared by the filters that replace these */
+  struct bgpstream_dedup *dedup;
+  bgpstream_filter_prog_t elem_prog;
+  /* named sets of elem filters (see bgpstream_add_filter_set), each kept in a
+   * filter manager of its own. elems must pass the filters above, and those
+   * of at least one set */
+  struct struct_bgpstream_filter_mgr_t *sets[BGPSTREAM_FILTER_SETS_MAX];
+  char *set_names[BGPSTREAM_FILTER_SETS_MAX];
+  int sets_cnt;
 } bgpstream_filter_mgr_t;
 
 /* allocate memory for a new bgpstream filter */
 bgpstream_filter_mgr_t *bgpstream_filter_mgr_create(void);
 
+/* allocate a filter manager with the time interval, RIB period, shard,
+ * decoding and deduplication options of mgr, but none of its filters */
+bgpstream_filter_mgr_t *
+bgpstream_filter_mgr_create_like(const bgpstream_filter_mgr_t *mgr);
+
 /* configure filters in order to select a subset of the bgp data available */
 int bgpstream_filter_mgr_filter_add(bgpstream_filter_mgr_t *bs_filter_mgr,
                                     bgpstream_filter_type_t filter_type,
@@ -96,13 +199,81 @@ int bgpstream_filter_mgr_filter_add(bgpstream_filter_mgr_t *bs_filter_mgr,
 int bgpstream_filter_mgr_rib_period_filter_add(
   bgpstream_filter_mgr_t *bs_filter_mgr, uint32_t period);
 
+int bgpstream_filter_mgr_shard_filter_add(bgpstream_filter_mgr_t *bs_filter_mgr,
+                                          uint32_t shard, uint32_t shard_cnt,
+                                          uint32_t span);
+
 int bgpstream_filter_mgr_interval_filter_add(
   bgpstream_filter_mgr_t *bs_filter_mgr, uint32_t begin_time,
   uint32_t end_time);
 
+int bgpstream_filter_mgr_sample_filter_add(bgpstream_filter_mgr_t *mgr,
+                                           bgpstream_sample_key_t key,
+                                           uint32_t slice, uint32_t slice_cnt);
+
+/* add the filters of the given type listed in a file (see
+ * bgpstream_add_filter_file). returns 1 for success, 0 for failure */
+int bgpstream_filter_mgr_filter_add_file(bgpstream_filter_mgr_t *mgr,
+                                         bgpstream_filter_type_t filter_type,
+                                         const char *path);
+
+/* add a named filter set. returns the ID of the set, or -1 on error */
+int bgpstream_filter_mgr_set_add(bgpstream_filter_mgr_t *mgr,
+                                 const char *name);
+
+/* add an elem filter to the given filter set. returns 1 for success, 0 for
+ * failure (including filters that are not elem filters) */
+int bgpstream_filter_mgr_set_filter_add(bgpstream_filter_mgr_t *mgr, int set,
+                                        bgpstream_filter_type_t filter_type,
+                                        const char *filter_value);
+
+/* add the elem filters listed in a file to the given filter set. returns 1 for
+ * success, 0 for failure */
+int bgpstream_filter_mgr_set_filter_add_file(
+  bgpstream_filter_mgr_t *mgr, int set, bgpstream_filter_type_t filter_type,
+  const char *path);
+
 /* validate the current filters */
 int bgpstream_filter_mgr_validate(bgpstream_filter_mgr_t *mgr);
 
+/* compile the elem filters into mgr->elem_prog (and those of each filter set
+ * into its own program) */
+void bgpstream_filter_mgr_compile(bgpstream_filter_mgr_t *mgr);
+
+/* the elem fields (BGPSTREAM_ELEM_FIELD_* flags) that the elem filters of the
+ * manager and its filter sets look at */
+uint8_t bgpstream_filter_mgr_elem_fields(bgpstream_filter_mgr_t *mgr);
+
+/* check whether the prefix filters match the given prefix */
+int bgpstream_filter_mgr_prefix_match(bgpstream_filter_mgr_t *mgr,
+                                      bgpstream_pfx_t *pfx);
+
+/* check whether the sample filter (which must be set) selects the given
+ * prefix (resp. peer ASN) */
+int bgpstream_filter_mgr_sample_pfx(bgpstream_filter_mgr_t *mgr,
+                                    bgpstream_pfx_t *pfx);
+
+int bgpstream_filter_mgr_sample_peer(bgpstream_filter_mgr_t *mgr,
+                                     uint32_t peer_asn);
+
+/* record-level pre-checks, used by formats to skip every elem of a record
+ * before extracting any of them. return 0 if no elem with the given peer ASN
+ * (resp. prefix) can pass the elem filters */
+int bgpstream_filter_mgr_peer_wanted(bgpstream_filter_mgr_t *mgr,
+                                     uint32_t peer_asn);
+
+int bgpstream_filter_mgr_pfx_wanted(bgpstream_filter_mgr_t *mgr,
+                                    bgpstream_pfx_t *pfx);
+
+/* estimate the number of bytes allocated for the filters (including those of
+ * the filter sets) */
+size_t bgpstream_filter_mgr_get_mem_size(const bgpstream_filter_mgr_t *mgr);
+
+/* fill in the elem and filter counts of the given statistics from the elem
+ * filters of the manager (but not those of its filter sets) */
+void bgpstream_filter_mgr_get_perf_stats(bgpstream_filter_mgr_t *mgr,
+                                         bgpstream_perf_stats_t *stats);
+
 /* destroy the memory allocated for bgpstream filter */
 void bgpstream_filter_mgr_destroy(bgpstream_filter_mgr_t *bs_filter_mgr);
 
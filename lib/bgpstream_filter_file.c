@@ -0,0 +1,406 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_filter.h"
+#include "bgpstream_log.h"
+#include "utils.h"
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wandio.h>
+
+/* size of each read from the filter file */
+#define READ_LEN (1024 * 1024)
+
+/* lists with at least this many prefixes build their IPv4 and IPv6 trees in
+ * parallel */
+#define PARALLEL_PFXS 65536
+
+/* values parsed from a filter file, before they are added to the filters */
+typedef struct values {
+  uint32_t *asns;
+  int asns_cnt;
+  int asns_alloc;
+
+  bgpstream_pfx_t *pfxs;
+  int pfxs_cnt;
+  int pfxs_alloc;
+} values_t;
+
+// reads the whole file (which may be compressed, or remote) into a buffer with
+// room for a NUL after the content. returns the length, or -1 on error
+static int64_t read_file(const char *path, char **bufp)
+{
+  io_t *fh;
+  char *buf = NULL, *tmp;
+  size_t len = 0, alloc = 0;
+  int64_t rc;
+
+  if ((fh = wandio_create(path)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open filter file %s", path);
+    return -1;
+  }
+  while (1) {
+    if (alloc - len < READ_LEN + 1) {
+      alloc = (alloc == 0) ? READ_LEN + 1 : alloc * 2;
+      if ((tmp = realloc(buf, alloc)) == NULL) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "can't allocate memory");
+        goto err;
+      }
+      buf = tmp;
+    }
+    if ((rc = wandio_read(fh, buf + len, READ_LEN)) < 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not read filter file %s", path);
+      goto err;
+    }
+    if (rc == 0) {
+      break;
+    }
+    len += rc;
+  }
+  wandio_destroy(fh);
+  buf[len] = '\0';
+  *bufp = buf;
+  return len;
+
+err:
+  wandio_destroy(fh);
+  free(buf);
+  return -1;
+}
+
+static int add_asn(values_t *vals, uint32_t asn)
+{
+  uint32_t *tmp;
+
+  if (vals->asns_cnt == vals->asns_alloc) {
+    vals->asns_alloc = (vals->asns_alloc == 0) ? 1024 : vals->asns_alloc * 2;
+    if ((tmp = realloc(vals->asns, sizeof(uint32_t) * vals->asns_alloc)) ==
+        NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "can't allocate memory");
+      return -1;
+    }
+    vals->asns = tmp;
+  }
+  vals->asns[vals->asns_cnt++] = asn;
+  return 0;
+}
+
+static int add_pfx(values_t *vals, const bgpstream_pfx_t *pfx)
+{
+  bgpstream_pfx_t *tmp;
+
+  if (vals->pfxs_cnt == vals->pfxs_alloc) {
+    vals->pfxs_alloc = (vals->pfxs_alloc == 0) ? 1024 : vals->pfxs_alloc * 2;
+    if ((tmp = realloc(vals->pfxs,
+                       sizeof(bgpstream_pfx_t) * vals->pfxs_alloc)) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "can't allocate memory");
+      return -1;
+    }
+    vals->pfxs = tmp;
+  }
+  vals->pfxs[vals->pfxs_cnt++] = *pfx;
+  return 0;
+}
+
+// parses a decimal number of at most max, which must span [p, end)
+static int parse_num(const char *p, const char *end, uint64_t max,
+                     uint64_t *val)
+{
+  uint64_t v = 0;
+
+  if (p == end || end - p > 10) {
+    return -1;
+  }
+  for (; p < end; p++) {
+    if (*p < '0' || *p > '9') {
+      return -1;
+    }
+    v = v * 10 + (*p - '0');
+  }
+  if (v > max) {
+    return -1;
+  }
+  *val = v;
+  return 0;
+}
+
+// parses an ASN (optionally written AS<n>)
+static int parse_asn(const char *p, const char *end, uint32_t *asn)
+{
+  uint64_t v;
+
+  if (end - p > 2 && (p[0] == 'A' || p[0] == 'a') &&
+      (p[1] == 'S' || p[1] == 's')) {
+    p += 2;
+  }
+  if (parse_num(p, end, UINT32_MAX, &v) != 0) {
+    return -1;
+  }
+  *asn = (uint32_t)v;
+  return 0;
+}
+
+// parses a prefix, which ends at a NUL. IPv4 prefixes, by far the most common,
+// are parsed without going through inet_pton
+static int parse_pfx(const char *p, const char *end, bgpstream_pfx_t *pfx)
+{
+  const char *dot;
+  uint32_t addr = 0;
+  uint64_t v;
+  int i;
+
+  if (memchr(p, ':', end - p) != NULL) {
+    return (bgpstream_str2pfx(p, pfx) == NULL) ? -1 : 0;
+  }
+  for (i = 0; i < 4; i++) {
+    dot = p + strcspn(p, (i < 3) ? "." : "/");
+    if (*dot == '\0' || parse_num(p, dot, 255, &v) != 0) {
+      return -1;
+    }
+    addr = addr << 8 | (uint32_t)v;
+    p = dot + 1;
+  }
+  if (parse_num(p, end, 32, &v) != 0) {
+    return -1;
+  }
+  pfx->address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+  pfx->bs_ipv4.address.addr.s_addr = htonl(addr);
+  pfx->mask_len = (uint8_t)v;
+  bgpstream_addr_mask(&pfx->address, pfx->mask_len);
+  return 0;
+}
+
+static int is_asn_filter(bgpstream_filter_type_t filter_type)
+{
+  return filter_type == BGPSTREAM_FILTER_TYPE_ELEM_PEER_ASN ||
+         filter_type == BGPSTREAM_FILTER_TYPE_ELEM_NOT_PEER_ASN ||
+         filter_type == BGPSTREAM_FILTER_TYPE_ELEM_ORIGIN_ASN;
+}
+
+// the type of matches a prefix filter allows, or -1 for other filters
+static int pfx_matches(bgpstream_filter_type_t filter_type)
+{
+  switch (filter_type) {
+  case BGPSTREAM_FILTER_TYPE_ELEM_PREFIX:
+  case BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_MORE:
+    return BGPSTREAM_PREFIX_MATCH_MORE;
+  case BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_LESS:
+    return BGPSTREAM_PREFIX_MATCH_LESS;
+  case BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_EXACT:
+    return BGPSTREAM_PREFIX_MATCH_EXACT;
+  case BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_ANY:
+    return BGPSTREAM_PREFIX_MATCH_ANY;
+  default:
+    return -1;
+  }
+}
+
+// parses a text filter file, with one value per line. values of filters that
+// are not loaded in bulk are added one by one
+static int parse_text(bgpstream_filter_mgr_t *mgr,
+                      bgpstream_filter_type_t filter_type, const char *path,
+                      char *buf, size_t len, values_t *vals)
+{
+  char *p = buf, *end = buf + len, *nl, *e, *c;
+  bgpstream_pfx_t pfx;
+  uint32_t asn;
+  int line, rc;
+
+  for (line = 1; p < end; line++, p = nl + 1) {
+    if ((nl = memchr(p, '\n', end - p)) == NULL) {
+      nl = end;
+    }
+    // trim comments and surrounding spaces
+    e = nl;
+    if ((c = memchr(p, '#', e - p)) != NULL) {
+      e = c;
+    }
+    while (p < e && isspace((unsigned char)*p)) {
+      p++;
+    }
+    while (e > p && isspace((unsigned char)e[-1])) {
+      e--;
+    }
+    if (p == e) {
+      continue;
+    }
+    *e = '\0';
+
+    if (is_asn_filter(filter_type)) {
+      rc = (parse_asn(p, e, &asn) == 0) ? add_asn(vals, asn) : -2;
+    } else if (pfx_matches(filter_type) >= 0) {
+      rc = (parse_pfx(p, e, &pfx) == 0) ? add_pfx(vals, &pfx) : -2;
+    } else {
+      rc = (bgpstream_filter_mgr_filter_add(mgr, filter_type, p) != 0) ? 0
+                                                                       : -2;
+    }
+    if (rc == -2) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "invalid filter value '%s' (%s:%d)", p,
+                    path, line);
+    }
+    if (rc != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// parses a binary filter file (see bgpstream_add_filter_file)
+static int parse_binary(bgpstream_filter_type_t filter_type, const char *path,
+                        const uint8_t *p, size_t len, values_t *vals)
+{
+  const uint8_t *end = p + len;
+  bgpstream_pfx_t pfx;
+  size_t addr_len;
+
+  if (is_asn_filter(filter_type)) {
+    if (len % 4 != 0) {
+      goto corrupted;
+    }
+    for (; p < end; p += 4) {
+      if (add_asn(vals, (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+                          (uint32_t)p[2] << 8 | p[3]) != 0) {
+        return -1;
+      }
+    }
+    return 0;
+  }
+
+  if (pfx_matches(filter_type) < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Binary filter files only hold ASNs or prefixes (%s)", path);
+    return -1;
+  }
+  while (p < end) {
+    if (end - p < 2) {
+      goto corrupted;
+    }
+    memset(&pfx, 0, sizeof(pfx));
+    if (p[0] == 4) {
+      pfx.address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+      addr_len = 4;
+    } else if (p[0] == 6) {
+      pfx.address.version = BGPSTREAM_ADDR_VERSION_IPV6;
+      addr_len = 16;
+    } else {
+      goto corrupted;
+    }
+    pfx.mask_len = p[1];
+    if (pfx.mask_len > addr_len * 8 || (size_t)(end - p) < 2 + addr_len) {
+      goto corrupted;
+    }
+    memcpy((addr_len == 4) ? (void *)&pfx.bs_ipv4.address.addr
+                           : (void *)&pfx.bs_ipv6.address.addr,
+           p + 2, addr_len);
+    bgpstream_addr_mask(&pfx.address, pfx.mask_len);
+    if (add_pfx(vals, &pfx) != 0) {
+      return -1;
+    }
+    p += 2 + addr_len;
+  }
+  return 0;
+
+corrupted:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Corrupted binary filter file %s", path);
+  return -1;
+}
+
+// adds the parsed values to the filters, in one go
+static int add_values(bgpstream_filter_mgr_t *mgr,
+                      bgpstream_filter_type_t filter_type, values_t *vals)
+{
+  bgpstream_id_set_t **setp = NULL;
+  int i, matches = pfx_matches(filter_type);
+
+  if (vals->asns_cnt != 0) {
+    if (filter_type == BGPSTREAM_FILTER_TYPE_ELEM_PEER_ASN) {
+      setp = &mgr->peer_asns;
+    } else if (filter_type == BGPSTREAM_FILTER_TYPE_ELEM_NOT_PEER_ASN) {
+      setp = &mgr->not_peer_asns;
+    } else {
+      setp = &mgr->origin_asns;
+    }
+    if ((*setp == NULL && (*setp = bgpstream_id_set_create()) == NULL) ||
+        bgpstream_id_set_insert_bulk(*setp, vals->asns, vals->asns_cnt) < 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "can't allocate memory");
+      return -1;
+    }
+  }
+
+  if (vals->pfxs_cnt != 0) {
+    for (i = 0; i < vals->pfxs_cnt; i++) {
+      vals->pfxs[i].allowed_matches = matches;
+    }
+    if (mgr->prefixes == NULL &&
+        (mgr->prefixes = bgpstream_patricia_tree_create(NULL)) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "can't allocate memory");
+      return -1;
+    }
+    if (bgpstream_patricia_tree_insert_bulk(
+          mgr->prefixes, vals->pfxs, vals->pfxs_cnt, NULL,
+          vals->pfxs_cnt >= PARALLEL_PFXS) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "can't add prefixes");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int bgpstream_filter_mgr_filter_add_file(bgpstream_filter_mgr_t *mgr,
+                                         bgpstream_filter_type_t filter_type,
+                                         const char *path)
+{
+  values_t vals = {0};
+  char *buf = NULL;
+  int64_t len;
+  int rc = 0;
+  size_t magic_len = strlen(BGPSTREAM_FILTER_FILE_MAGIC);
+
+  if ((len = read_file(path, &buf)) < 0) {
+    return 0;
+  }
+  if ((size_t)len >= magic_len &&
+      memcmp(buf, BGPSTREAM_FILTER_FILE_MAGIC, magic_len) == 0) {
+    if (parse_binary(filter_type, path, (uint8_t *)buf + magic_len,
+                     len - magic_len, &vals) != 0) {
+      goto done;
+    }
+  } else if (parse_text(mgr, filter_type, path, buf, len, &vals) != 0) {
+    goto done;
+  }
+  if (add_values(mgr, filter_type, &vals) != 0) {
+    goto done;
+  }
+  rc = 1;
+
+done:
+  free(buf);
+  free(vals.asns);
+  free(vals.pfxs);
+  return rc;
+}
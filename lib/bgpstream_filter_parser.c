@@ -79,7 +79,9 @@ static const char *bgpstream_filter_type_to_string(bgpstream_filter_type_t type)
   return "Unknown filter term ??";
 }
 
-static int instantiate_filter(bgpstream_t *bs, bgpstream_filter_item_t *item)
+// add the filter to the stream, or to the given filter set if set >= 0
+static int instantiate_filter(bgpstream_t *bs, int set,
+                              bgpstream_filter_item_t *item)
 {
   bgpstream_filter_type_t usetype = item->termtype;
 
@@ -102,7 +104,8 @@ static int instantiate_filter(bgpstream_t *bs, bgpstream_filter_item_t *item)
   case BGPSTREAM_FILTER_TYPE_RESOURCE_TYPE:
     bgpstream_log(BGPSTREAM_LOG_FINE, "Adding filter: %s '%s'",
         bgpstream_filter_type_to_string(item->termtype), item->value);
-    if (!bgpstream_add_filter(bs, usetype, item->value))
+    if (set < 0 ? !bgpstream_add_filter(bs, usetype, item->value)
+                : !bgpstream_add_set_filter(bs, set, usetype, item->value))
       return 0;
     break;
 
@@ -276,7 +279,7 @@ static fp_state_t bgpstream_parse_endvalue(const char *conj, size_t len,
   }
 }
 
-int bgpstream_parse_filter_string(bgpstream_t *bs, const char *fstring)
+static int parse_filter_string(bgpstream_t *bs, int set, const char *fstring)
 {
   int repeatable[] = {
     #define TERM_REPEATABLE(repeatable, word, alt, termtype, state)   (repeatable),
@@ -313,7 +316,7 @@ retry_token:
         goto endparsing;
       }
       if (state == ENDVALUE) {
-        if (!instantiate_filter(bs, filteritem))
+        if (!instantiate_filter(bs, set, filteritem))
           goto endparsing;
       }
       break;
@@ -322,7 +325,7 @@ retry_token:
       if (bgpstream_parse_value(p, &len, &state, filteritem) == FAIL) {
         goto endparsing;
       }
-      if (!instantiate_filter(bs, filteritem))
+      if (!instantiate_filter(bs, set, filteritem))
         goto endparsing;
       break;
 
@@ -360,3 +363,14 @@ endparsing:
 
   return success;
 }
+
+int bgpstream_parse_filter_string(bgpstream_t *bs, const char *fstring)
+{
+  return parse_filter_string(bs, -1, fstring);
+}
+
+int bgpstream_parse_set_filter_string(bgpstream_t *bs, int set,
+                                      const char *fstring)
+{
+  return parse_filter_string(bs, set, fstring);
+}
@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_filter_pfx.h"
+#include "bgpstream_log.h"
+#include "utils.h"
+#include <arpa/inet.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LEN 128
+
+/* a prefix as a 128 bit number (IPv4 addresses use the top 32 bits), with the
+ * host bits cleared */
+typedef struct pfx_key {
+  uint64_t hi;
+  uint64_t lo;
+  uint8_t len;
+  uint8_t matches;
+} pfx_key_t;
+
+/* the filter prefixes of one IP version */
+typedef struct pfx_family {
+
+  /* open addressing hash of every filter prefix, by address and length */
+  pfx_key_t *slots;
+  uint8_t *used;
+  uint32_t slots_mask;
+
+  /* lengths of the filter prefixes, in increasing order, and whether a filter
+   * prefix of that length allows more specific matches */
+  uint8_t lens[MAX_LEN + 1];
+  uint8_t lens_more[MAX_LEN + 1];
+  int lens_cnt;
+
+  /* filter prefixes that allow less specific matches, sorted by address then
+   * by decreasing length */
+  pfx_key_t *less;
+  uint32_t less_cnt;
+
+} pfx_family_t;
+
+struct bgpstream_pfx_index {
+  pfx_family_t v4;
+  pfx_family_t v6;
+};
+
+static void key_mask(pfx_key_t *key, uint8_t len)
+{
+  key->len = len;
+  if (len == 0) {
+    key->hi = key->lo = 0;
+  } else if (len <= 64) {
+    key->hi &= UINT64_MAX << (64 - len);
+    key->lo = 0;
+  } else {
+    key->lo &= UINT64_MAX << (128 - len);
+  }
+}
+
+static void pfx_to_key(const bgpstream_pfx_t *pfx, pfx_key_t *key)
+{
+  uint32_t u32[4];
+
+  if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
+    key->hi = (uint64_t)ntohl(pfx->bs_ipv4.address.addr.s_addr) << 32;
+    key->lo = 0;
+  } else {
+    memcpy(u32, &pfx->bs_ipv6.address.addr, sizeof(u32));
+    key->hi = (uint64_t)ntohl(u32[0]) << 32 | ntohl(u32[1]);
+    key->lo = (uint64_t)ntohl(u32[2]) << 32 | ntohl(u32[3]);
+  }
+  key->matches = pfx->allowed_matches;
+  key_mask(key, pfx->mask_len);
+}
+
+static uint32_t key_hash(const pfx_key_t *key)
+{
+  uint64_t h = key->hi ^ (key->lo * 0x9e3779b97f4a7c15ULL) ^ key->len;
+
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+  return (uint32_t)(h ^ (h >> 31));
+}
+
+static int key_cmp_addr(const pfx_key_t *a, const pfx_key_t *b)
+{
+  if (a->hi != b->hi) {
+    return a->hi < b->hi ? -1 : 1;
+  }
+  if (a->lo != b->lo) {
+    return a->lo < b->lo ? -1 : 1;
+  }
+  return 0;
+}
+
+static int key_cmp_less(const void *va, const void *vb)
+{
+  const pfx_key_t *a = va, *b = vb;
+  int cmp;
+
+  if ((cmp = key_cmp_addr(a, b)) != 0) {
+    return cmp;
+  }
+  return (int)b->len - (int)a->len;
+}
+
+static int allows_more(uint8_t matches)
+{
+  return matches == BGPSTREAM_PREFIX_MATCH_ANY ||
+         matches == BGPSTREAM_PREFIX_MATCH_MORE;
+}
+
+static int allows_less(uint8_t matches)
+{
+  return matches == BGPSTREAM_PREFIX_MATCH_ANY ||
+         matches == BGPSTREAM_PREFIX_MATCH_LESS;
+}
+
+static int family_init(pfx_family_t *fam, uint64_t cnt)
+{
+  uint32_t size = 16;
+
+  // at most half full, so that probe chains stay short
+  while (size < cnt * 2) {
+    size <<= 1;
+  }
+  fam->slots_mask = size - 1;
+  if ((fam->slots = malloc(sizeof(pfx_key_t) * size)) == NULL ||
+      (fam->used = malloc_zero(size)) == NULL ||
+      (fam->less = malloc(sizeof(pfx_key_t) * (cnt + 1))) == NULL) {
+    return -1;
+  }
+  return 0;
+}
+
+static void family_add(pfx_family_t *fam, const pfx_key_t *key)
+{
+  uint32_t i = key_hash(key) & fam->slots_mask;
+
+  // the tree holds each prefix once
+  while (fam->used[i]) {
+    i = (i + 1) & fam->slots_mask;
+  }
+  fam->slots[i] = *key;
+  fam->used[i] = 1;
+
+  // flag the length for now, family_finish turns this into a list
+  fam->lens[key->len] = 1;
+  fam->lens_more[key->len] |= allows_more(key->matches);
+  if (allows_less(key->matches)) {
+    fam->less[fam->less_cnt++] = *key;
+  }
+}
+
+static void family_finish(pfx_family_t *fam)
+{
+  int len;
+
+  fam->lens_cnt = 0;
+  for (len = 0; len <= MAX_LEN; len++) {
+    if (fam->lens[len]) {
+      fam->lens_more[fam->lens_cnt] = fam->lens_more[len];
+      fam->lens[fam->lens_cnt++] = len;
+    }
+  }
+  qsort(fam->less, fam->less_cnt, sizeof(pfx_key_t), key_cmp_less);
+}
+
+static const pfx_key_t *family_find(const pfx_family_t *fam,
+                                    const pfx_key_t *key)
+{
+  uint32_t i = key_hash(key) & fam->slots_mask;
+
+  while (fam->used[i]) {
+    if (fam->slots[i].len == key->len &&
+        key_cmp_addr(&fam->slots[i], key) == 0) {
+      return &fam->slots[i];
+    }
+    i = (i + 1) & fam->slots_mask;
+  }
+  return NULL;
+}
+
+/* index of the first filter in less whose address is >= (or > if after is
+ * set) that of the key */
+static uint32_t less_search(const pfx_family_t *fam, const pfx_key_t *key,
+                            int after)
+{
+  uint32_t lo = 0, hi = fam->less_cnt, mid;
+  int cmp;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    cmp = key_cmp_addr(&fam->less[mid], key);
+    if (cmp < 0 || (after && cmp == 0)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static int family_match(const pfx_family_t *fam, const pfx_key_t *elem)
+{
+  pfx_key_t probe, last;
+  const pfx_key_t *found;
+  uint32_t i;
+  int l;
+
+  // the prefix itself, and the less specific filters that allow more
+  // specific matches
+  for (l = 0; l < fam->lens_cnt && fam->lens[l] <= elem->len; l++) {
+    if (fam->lens[l] < elem->len && !fam->lens_more[l]) {
+      continue;
+    }
+    probe = *elem;
+    key_mask(&probe, fam->lens[l]);
+    if ((found = family_find(fam, &probe)) != NULL &&
+        (found->len == elem->len || allows_more(found->matches))) {
+      return 1;
+    }
+  }
+
+  // the more specific filters that allow less specific matches all have an
+  // address within the elem prefix. those with the address of the elem
+  // prefix come longest first, so only the first of them needs checking
+  if (fam->less_cnt == 0) {
+    return 0;
+  }
+  i = less_search(fam, elem, 0);
+  if (i < fam->less_cnt && key_cmp_addr(&fam->less[i], elem) == 0 &&
+      fam->less[i].len <= elem->len) {
+    i = less_search(fam, elem, 1);
+  }
+  if (i == fam->less_cnt) {
+    return 0;
+  }
+  // the last address of the elem prefix
+  last = *elem;
+  if (elem->len < 64) {
+    last.hi |= UINT64_MAX >> elem->len;
+    last.lo = UINT64_MAX;
+  } else if (elem->len < 128) {
+    last.lo |= UINT64_MAX >> (elem->len - 64);
+  }
+  return key_cmp_addr(&fam->less[i], &last) <= 0;
+}
+
+static bgpstream_patricia_walk_cb_result_t
+add_pfx(const bgpstream_patricia_tree_t *pt,
+        const bgpstream_patricia_node_t *node, void *data)
+{
+  bgpstream_pfx_index_t *idx = (bgpstream_pfx_index_t *)data;
+  const bgpstream_pfx_t *pfx = bgpstream_patricia_tree_get_pfx(node);
+  pfx_key_t key;
+
+  pfx_to_key(pfx, &key);
+  family_add(pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4 ? &idx->v4
+                                                                 : &idx->v6,
+             &key);
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+bgpstream_pfx_index_t *
+bgpstream_pfx_index_create(const bgpstream_patricia_tree_t *prefixes)
+{
+  bgpstream_pfx_index_t *idx;
+
+  if ((idx = malloc_zero(sizeof(bgpstream_pfx_index_t))) == NULL) {
+    return NULL;
+  }
+  if (family_init(&idx->v4, bgpstream_patricia_prefix_count(
+                              prefixes, BGPSTREAM_ADDR_VERSION_IPV4)) != 0 ||
+      family_init(&idx->v6, bgpstream_patricia_prefix_count(
+                              prefixes, BGPSTREAM_ADDR_VERSION_IPV6)) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not allocate the prefix index");
+    bgpstream_pfx_index_destroy(idx);
+    return NULL;
+  }
+
+  bgpstream_patricia_tree_walk(prefixes, add_pfx, idx);
+  family_finish(&idx->v4);
+  family_finish(&idx->v6);
+  return idx;
+}
+
+int bgpstream_pfx_index_match(const bgpstream_pfx_index_t *idx,
+                              const bgpstream_pfx_t *pfx)
+{
+  pfx_key_t key;
+
+  switch (pfx->address.version) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    pfx_to_key(pfx, &key);
+    return family_match(&idx->v4, &key);
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    pfx_to_key(pfx, &key);
+    return family_match(&idx->v6, &key);
+
+  default:
+    return 0;
+  }
+}
+
+static size_t family_mem_size(const pfx_family_t *fam)
+{
+  if (fam->slots == NULL) {
+    return fam->less_cnt * sizeof(pfx_key_t);
+  }
+  return (fam->slots_mask + 1) * (sizeof(pfx_key_t) + sizeof(uint8_t)) +
+         fam->less_cnt * sizeof(pfx_key_t);
+}
+
+size_t bgpstream_pfx_index_get_mem_size(const bgpstream_pfx_index_t *idx)
+{
+  if (idx == NULL) {
+    return 0;
+  }
+  return sizeof(*idx) + family_mem_size(&idx->v4) + family_mem_size(&idx->v6);
+}
+
+void bgpstream_pfx_index_destroy(bgpstream_pfx_index_t *idx)
+{
+  if (idx == NULL) {
+    return;
+  }
+  free(idx->v4.slots);
+  free(idx->v4.used);
+  free(idx->v4.less);
+  free(idx->v6.slots);
+  free(idx->v6.used);
+  free(idx->v6.less);
+  free(idx);
+}
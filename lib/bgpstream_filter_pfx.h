@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _BGPSTREAM_FILTER_PFX_H
+#define _BGPSTREAM_FILTER_PFX_H
+
+#include "bgpstream_utils_patricia.h"
+#include "bgpstream_utils_pfx.h"
+
+/* read-only index of the prefix filters, compiled from the prefix tree of a
+ * filter manager so that matching an elem prefix takes a few hash probes and
+ * binary searches, rather than a walk of the tree */
+typedef struct bgpstream_pfx_index bgpstream_pfx_index_t;
+
+/* build the index of the prefixes (and their allowed matches) of the tree.
+ * returns NULL on error */
+bgpstream_pfx_index_t *
+bgpstream_pfx_index_create(const bgpstream_patricia_tree_t *prefixes);
+
+/* returns 1 if the prefix matches one of the indexed filter prefixes (itself,
+ * a less specific prefix that allows more specific matches, or a more specific
+ * one that allows less specific matches), 0 otherwise */
+int bgpstream_pfx_index_match(const bgpstream_pfx_index_t *idx,
+                              const bgpstream_pfx_t *pfx);
+
+/* the number of bytes allocated for the index */
+size_t bgpstream_pfx_index_get_mem_size(const bgpstream_pfx_index_t *idx);
+
+/* destroy the index */
+void bgpstream_pfx_index_destroy(bgpstream_pfx_index_t *idx);
+
+#endif /* _BGPSTREAM_FILTER_PFX_H */
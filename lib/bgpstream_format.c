@@ -27,11 +27,14 @@
 #include "bgpstream_format.h"
 #include "bgpstream_record_int.h"
 #include "bgpstream_log.h"
+#include "bgpstream_mem.h"
+#include "bgpstream_perf.h"
 #include "bgpstream_resource.h"
 #include "bgpstream_transport.h"
 #include "utils.h"
 #include <assert.h>
 
+#include "bs_format_binary.h"
 #include "bs_format_bmp.h"
 #include "bs_format_mrt.h"
 #include "bs_format_rislive.h"
@@ -53,12 +56,17 @@ static const format_create_func_t create_functions[] = {
 
   bs_format_rislive_create,
 
+  bs_format_binary_create,
+
 };
 
 bgpstream_format_t *bgpstream_format_create(bgpstream_resource_t *res,
                                             bgpstream_filter_mgr_t *filter_mgr)
 {
   bgpstream_format_t *format = NULL;
+  bgpstream_perf_timer_t timer;
+
+  bgpstream_perf_start(res->perf, &timer);
 
   // check that the format type is valid
   if (res->format_type >= ARR_CNT(create_functions)) {
@@ -80,7 +88,8 @@ bgpstream_format_t *bgpstream_format_create(bgpstream_resource_t *res,
     goto err;
   }
 
-  format->res = res;
+  format->res = bgpstream_resource_retain(res);
+  format->refcnt = 1;
 
   // create the transport reader
   if ((format->transport = bgpstream_transport_create(res)) == NULL) {
@@ -93,20 +102,37 @@ bgpstream_format_t *bgpstream_format_create(bgpstream_resource_t *res,
     goto err;
   }
 
+  bgpstream_perf_stop(res->perf, BGPSTREAM_PERF_STAGE_OPEN, &timer);
   return format;
 
 err:
+  bgpstream_perf_stop(res->perf, BGPSTREAM_PERF_STAGE_OPEN, &timer);
+  if (format != NULL) {
+    bgpstream_resource_destroy(format->res);
+  }
   free(format);
   return NULL;
 }
 
+void bgpstream_format_set_filter_mgr(bgpstream_format_t *format,
+                                     bgpstream_filter_mgr_t *filter_mgr)
+{
+  format->filter_mgr = filter_mgr;
+}
+
 bgpstream_format_status_t
 bgpstream_format_populate_record(bgpstream_format_t *format,
                                  bgpstream_record_t *record)
 {
+  bgpstream_perf_timer_t timer;
+  bgpstream_format_status_t status;
+
   // it is a programming error to use a record with a different format
   assert(record->__int->format == format);
-  return format->populate_record(format, record);
+  bgpstream_perf_start(format->res->perf, &timer);
+  status = format->populate_record(format, record);
+  bgpstream_perf_stop(format->res->perf, BGPSTREAM_PERF_STAGE_DECODE, &timer);
+  return status;
 }
 
 int bgpstream_format_get_next_elem(bgpstream_format_t *format,
@@ -120,10 +146,23 @@ int bgpstream_format_get_next_elem(bgpstream_format_t *format,
 
 #define DATA(record) ((record)->__int)
 
+/* Memory accounted for the data of a record: its elem, plus roughly what the
+   AS path and communities of the elem allocate */
+#define RECORD_DATA_MEM (sizeof(bgpstream_elem_t) + 256)
+
 int bgpstream_format_init_data(bgpstream_record_t *record)
 {
-  return DATA(record)->format->init_data(DATA(record)->format,
-                                         &DATA(record)->data);
+  bgpstream_format_t *format = DATA(record)->format;
+
+  // a record without a format (e.g., one made by hand) has no data
+  if (format == NULL) {
+    return 0;
+  }
+  if (format->init_data(format, &DATA(record)->data) != 0) {
+    return -1;
+  }
+  bgpstream_mem_add(format->res->mem, BGPSTREAM_MEM_ELEMS, RECORD_DATA_MEM);
+  return 0;
 }
 
 void bgpstream_format_clear_data(bgpstream_record_t *record)
@@ -142,14 +181,29 @@ void bgpstream_format_destroy_data(bgpstream_record_t *record)
     return;
   }
   DATA(record)->format->destroy_data(DATA(record)->format, DATA(record)->data);
+  bgpstream_mem_add(DATA(record)->format->res->mem, BGPSTREAM_MEM_ELEMS,
+                    -(int64_t)RECORD_DATA_MEM);
 
   DATA(record)->format = NULL;
   DATA(record)->data = NULL;
 }
 
+void bgpstream_format_account_data(bgpstream_format_t *format, int cnt)
+{
+  bgpstream_mem_add(format->res->mem, BGPSTREAM_MEM_ELEMS,
+                    (int64_t)cnt * RECORD_DATA_MEM);
+}
+
+bgpstream_format_t *bgpstream_format_retain(bgpstream_format_t *format)
+{
+  __atomic_add_fetch(&format->refcnt, 1, __ATOMIC_RELAXED);
+  return format;
+}
+
 void bgpstream_format_destroy(bgpstream_format_t *format)
 {
-  if (format == NULL) {
+  if (format == NULL ||
+      __atomic_sub_fetch(&format->refcnt, 1, __ATOMIC_ACQ_REL) != 0) {
     return;
   }
 
@@ -159,5 +213,8 @@ void bgpstream_format_destroy(bgpstream_format_t *format)
   bgpstream_transport_destroy(format->transport);
   format->transport = NULL;
 
+  bgpstream_resource_destroy(format->res);
+  format->res = NULL;
+
   free(format);
 }
@@ -58,6 +58,18 @@ typedef enum {
 bgpstream_format_t *bgpstream_format_create(bgpstream_resource_t *res,
                                             bgpstream_filter_mgr_t *filter_mgr);
 
+/** Switch the format to another filter manager
+ *
+ * @param format        pointer to the format object to update
+ * @param filter_mgr    pointer to the filter manager to use from now on
+ *
+ * The caller must make sure that the format is not in use while this is
+ * called, and that the new filters look at no elem fields that the format does
+ * not decode (see bgpstream_filter_mgr_elem_fields).
+ */
+void bgpstream_format_set_filter_mgr(bgpstream_format_t *format,
+                                     bgpstream_filter_mgr_t *filter_mgr);
+
 /** Populate the given record with the next available record from this resource
  *
  * @param format        pointer to the format object to use
@@ -105,7 +117,30 @@ void bgpstream_format_clear_data(bgpstream_record_t *record);
  */
 void bgpstream_format_destroy_data(bgpstream_record_t *record);
 
-/** Destroy the given format module
+/** Move the format data of records into (or out of) the memory accounting of
+ * the format's stream
+ *
+ * @param format        pointer to the format the records belong to
+ * @param cnt           number of records whose data to account for (negative
+ *                      to stop accounting for them)
+ *
+ * Used by the record pool, whose records may be reused by another stream.
+ */
+void bgpstream_format_account_data(bgpstream_format_t *format, int cnt);
+
+/** Take another reference to the given format module
+ *
+ * @param format        pointer to the format instance to keep
+ * @return the same pointer
+ *
+ * This lets records outlive the reader that created them (see
+ * bgpstream_record_retain). The format, and its resource, are only destroyed
+ * once bgpstream_format_destroy has been called for every reference.
+ */
+bgpstream_format_t *bgpstream_format_retain(bgpstream_format_t *format);
+
+/** Drop a reference to the given format module, and destroy it if that was the
+ * last one
  *
  * @param format        pointer to the format instance to destroy
  */
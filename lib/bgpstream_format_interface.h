@@ -146,6 +146,9 @@ struct bgpstream_format {
   /** An opaque pointer to format-specific state if needed */
   void *state;
 
+  /** Number of references to the format (see bgpstream_format_retain) */
+  int refcnt;
+
   /** }@ */
 };
 
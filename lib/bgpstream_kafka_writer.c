@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+#include "bgpstream_kafka_writer.h"
+#include "bgpstream_binary.h"
+#include "bgpstream_elem_formatter.h"
+#include "bgpstream_log.h"
+#include "utils.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WITH_KAFKA
+#include <librdkafka/rdkafka.h>
+#endif
+
+#ifdef WITH_KAFKA
+
+// how long to wait for room in the queue of librdkafka when it is full
+#define QUEUE_FULL_POLL_MSEC 100
+
+// how long destroying a writer waits for its queued messages to be delivered
+#define DESTROY_FLUSH_MSEC 10000
+
+// every field of the elem and its record, as one JSON object. the fields that
+// may be empty (or hold spaces) are strings
+#define JSON_TEMPLATE                                                          \
+  "{\"type\":\"%{elem_type}\",\"time\":%{time},\"project\":\"%{project}\","    \
+  "\"collector\":\"%{collector}\",\"router\":\"%{router}\","                   \
+  "\"router_ip\":\"%{router_ip}\",\"peer_asn\":%{peer_asn},"                   \
+  "\"peer_ip\":\"%{peer_ip}\",\"prefix\":\"%{prefix}\","                       \
+  "\"next_hop\":\"%{next_hop}\",\"as_path\":\"%{as_path}\","                   \
+  "\"communities\":\"%{communities}\",\"old_state\":\"%{old_state}\","         \
+  "\"new_state\":\"%{new_state}\"}"
+
+struct bgpstream_kafka_writer {
+
+  // topic being produced to (for log messages)
+  char *topic;
+
+  bgpstream_kafka_writer_encoding_t encoding;
+  bgpstream_kafka_writer_partition_t partition;
+
+  // configuration of the producer, until it is created (by the first message)
+  rd_kafka_conf_t *conf;
+
+  rd_kafka_t *rk;
+  rd_kafka_topic_t *rkt;
+
+  // encoders of the messages (only the one of the encoding is created)
+  bgpstream_binary_writer_t *bin;
+  bgpstream_elem_formatter_t *fmt;
+
+  // record being produced, and the number of elems added to it
+  const bgpstream_record_t *record;
+  int elems_cnt;
+
+  // number of messages that could not be delivered
+  uint64_t failed;
+};
+
+// called by rd_kafka_poll (and so in the thread producing) for every message
+static void delivery_cb(rd_kafka_t *rk, const rd_kafka_message_t *msg,
+                        void *opaque)
+{
+  bgpstream_kafka_writer_t *writer = opaque;
+
+  if (msg->err != 0) {
+    if (writer->failed++ == 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not deliver message to %s: %s",
+                    writer->topic, rd_kafka_err2str(msg->err));
+    }
+  }
+}
+
+static int set_config(rd_kafka_conf_t *conf, const char *name,
+                      const char *value)
+{
+  char errstr[512];
+
+  if (rd_kafka_conf_set(conf, name, value, errstr, sizeof(errstr)) !=
+      RD_KAFKA_CONF_OK) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Config Error: %s", errstr);
+    return -1;
+  }
+  return 0;
+}
+
+// create the producer, once the options have all been set
+static int start_producer(bgpstream_kafka_writer_t *writer)
+{
+  char errstr[512];
+
+  if ((writer->rk = rd_kafka_new(RD_KAFKA_PRODUCER, writer->conf, errstr,
+                                 sizeof(errstr))) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create Kafka producer: %s",
+                  errstr);
+    return -1;
+  }
+  // the producer owns the configuration now
+  writer->conf = NULL;
+
+  if ((writer->rkt = rd_kafka_topic_new(writer->rk, writer->topic, NULL)) ==
+      NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create Kafka topic %s: %s",
+                  writer->topic, rd_kafka_err2str(rd_kafka_last_error()));
+    return -1;
+  }
+  return 0;
+}
+
+static int produce(bgpstream_kafka_writer_t *writer, const void *payload,
+                   size_t len, const char *key)
+{
+  if (writer->rk == NULL && start_producer(writer) != 0) {
+    return -1;
+  }
+
+  while (rd_kafka_produce(writer->rkt, RD_KAFKA_PARTITION_UA,
+                          RD_KAFKA_MSG_F_COPY, (void *)payload, len, key,
+                          key == NULL ? 0 : strlen(key), NULL) != 0) {
+    if (rd_kafka_last_error() != RD_KAFKA_RESP_ERR__QUEUE_FULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not produce to %s: %s",
+                    writer->topic, rd_kafka_err2str(rd_kafka_last_error()));
+      return -1;
+    }
+    // wait for some of the queued messages to be delivered
+    rd_kafka_poll(writer->rk, QUEUE_FULL_POLL_MSEC);
+  }
+  // serve the delivery reports
+  rd_kafka_poll(writer->rk, 0);
+  return writer->failed == 0 ? 0 : -1;
+}
+
+// the key of the message of an elem (or of the current record, if elem is
+// NULL), written into buf
+static const char *get_key(bgpstream_kafka_writer_t *writer,
+                           bgpstream_elem_t *elem, char *buf, size_t len)
+{
+  switch (writer->partition) {
+  case BGPSTREAM_KAFKA_WRITER_BY_PREFIX:
+    if (elem == NULL || elem->type == BGPSTREAM_ELEM_TYPE_PEERSTATE) {
+      return NULL;
+    }
+    return bgpstream_pfx_snprintf(buf, len, &elem->prefix);
+
+  case BGPSTREAM_KAFKA_WRITER_BY_PEER:
+    if (elem == NULL) {
+      return NULL;
+    }
+    snprintf(buf, len, "%" PRIu32, elem->peer_asn);
+    return buf;
+
+  default:
+    return writer->record->collector_name;
+  }
+}
+
+// produce the record being encoded by the binary writer
+static int produce_binary(bgpstream_kafka_writer_t *writer, const char *key)
+{
+  const uint8_t *buf;
+  ssize_t len;
+
+  if ((len = bgpstream_binary_writer_end_record(writer->bin, &buf)) < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not encode record");
+    return -1;
+  }
+  return produce(writer, buf, len, key);
+}
+
+bgpstream_kafka_writer_t *
+bgpstream_kafka_writer_create(const char *brokers, const char *topic,
+                              bgpstream_kafka_writer_encoding_t encoding,
+                              bgpstream_kafka_writer_partition_t partition)
+{
+  bgpstream_kafka_writer_t *writer;
+
+  if ((writer = malloc_zero(sizeof(bgpstream_kafka_writer_t))) == NULL) {
+    return NULL;
+  }
+  writer->encoding = encoding;
+  writer->partition = partition;
+
+  if ((writer->topic = strdup(topic)) == NULL ||
+      (writer->conf = rd_kafka_conf_new()) == NULL) {
+    goto err;
+  }
+  rd_kafka_conf_set_opaque(writer->conf, writer);
+  rd_kafka_conf_set_dr_msg_cb(writer->conf, delivery_cb);
+  if (set_config(writer->conf, "metadata.broker.list", brokers) != 0 ||
+      set_config(writer->conf, "queue.buffering.max.ms", "100") != 0 ||
+      set_config(writer->conf, "batch.num.messages", "10000") != 0 ||
+      set_config(writer->conf, "compression.codec", "lz4") != 0) {
+    goto err;
+  }
+
+  if (encoding == BGPSTREAM_KAFKA_WRITER_JSON) {
+    if ((writer->fmt = bgpstream_elem_formatter_create(JSON_TEMPLATE)) ==
+        NULL) {
+      goto err;
+    }
+  } else if ((writer->bin = bgpstream_binary_writer_create()) == NULL) {
+    goto err;
+  }
+  return writer;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create Kafka writer for %s",
+                topic);
+  bgpstream_kafka_writer_destroy(writer);
+  return NULL;
+}
+
+int bgpstream_kafka_writer_set_option(bgpstream_kafka_writer_t *writer,
+                                      const char *name, const char *value)
+{
+  if (writer->conf == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Kafka options must be set before the first message");
+    return -1;
+  }
+  return set_config(writer->conf, name, value);
+}
+
+int bgpstream_kafka_writer_begin_record(bgpstream_kafka_writer_t *writer,
+                                        const bgpstream_record_t *record)
+{
+  writer->record = record;
+  writer->elems_cnt = 0;
+  if (writer->bin != NULL &&
+      writer->partition == BGPSTREAM_KAFKA_WRITER_BY_COLLECTOR) {
+    // every message starts a stream of its own, so it can be decoded alone
+    bgpstream_binary_writer_reset(writer->bin);
+    return bgpstream_binary_writer_begin_record(writer->bin, record);
+  }
+  return 0;
+}
+
+int bgpstream_kafka_writer_add_elem(bgpstream_kafka_writer_t *writer,
+                                    bgpstream_elem_t *elem)
+{
+  char buf[INET6_ADDRSTRLEN + 4];
+  const char *out;
+  size_t len;
+
+  writer->elems_cnt++;
+  if (writer->fmt != NULL) {
+    // one object per message, without the newline that ends it
+    bgpstream_elem_formatter_clear(writer->fmt);
+    if (bgpstream_elem_formatter_add_elem(writer->fmt, writer->record, elem) !=
+        0) {
+      return -1;
+    }
+    if ((len = bgpstream_elem_formatter_get_output(writer->fmt, &out)) == 0) {
+      // skipped by the formatter
+      return 0;
+    }
+    return produce(writer, out, len - 1,
+                   get_key(writer, elem, buf, sizeof(buf)));
+  }
+
+  if (writer->partition == BGPSTREAM_KAFKA_WRITER_BY_COLLECTOR) {
+    return bgpstream_binary_writer_add_elem(writer->bin, elem);
+  }
+  // elems with different keys go to different partitions, so each gets a
+  // message (and a record) of its own
+  bgpstream_binary_writer_reset(writer->bin);
+  if (bgpstream_binary_writer_begin_record(writer->bin, writer->record) != 0 ||
+      bgpstream_binary_writer_add_elem(writer->bin, elem) != 0) {
+    return -1;
+  }
+  return produce_binary(writer, get_key(writer, elem, buf, sizeof(buf)));
+}
+
+int bgpstream_kafka_writer_end_record(bgpstream_kafka_writer_t *writer)
+{
+  int rc = 0;
+
+  if (writer->bin != NULL &&
+      writer->partition == BGPSTREAM_KAFKA_WRITER_BY_COLLECTOR &&
+      writer->elems_cnt > 0) {
+    rc = produce_binary(writer, get_key(writer, NULL, NULL, 0));
+  }
+  writer->record = NULL;
+  return rc == 0 && writer->failed == 0 ? 0 : -1;
+}
+
+int bgpstream_kafka_writer_flush(bgpstream_kafka_writer_t *writer,
+                                 int timeout_ms)
+{
+  rd_kafka_resp_err_t err;
+
+  if (writer->rk == NULL) {
+    return 0;
+  }
+  if ((err = rd_kafka_flush(writer->rk, timeout_ms)) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not flush messages to %s: %s",
+                  writer->topic, rd_kafka_err2str(err));
+    return -1;
+  }
+  return writer->failed == 0 ? 0 : -1;
+}
+
+void bgpstream_kafka_writer_destroy(bgpstream_kafka_writer_t *writer)
+{
+  if (writer == NULL) {
+    return;
+  }
+  if (writer->rk != NULL) {
+    bgpstream_kafka_writer_flush(writer, DESTROY_FLUSH_MSEC);
+  }
+  if (writer->rkt != NULL) {
+    rd_kafka_topic_destroy(writer->rkt);
+  }
+  if (writer->rk != NULL) {
+    rd_kafka_destroy(writer->rk);
+  }
+  if (writer->conf != NULL) {
+    rd_kafka_conf_destroy(writer->conf);
+  }
+  bgpstream_binary_writer_destroy(writer->bin);
+  bgpstream_elem_formatter_destroy(writer->fmt);
+  free(writer->topic);
+  free(writer);
+}
+
+#else
+
+// without librdkafka, the writer cannot be created, so the rest is never used
+
+bgpstream_kafka_writer_t *
+bgpstream_kafka_writer_create(const char *brokers, const char *topic,
+                              bgpstream_kafka_writer_encoding_t encoding,
+                              bgpstream_kafka_writer_partition_t partition)
+{
+  bgpstream_log(BGPSTREAM_LOG_ERR,
+                "Kafka output requires libbgpstream to be built with Kafka "
+                "support");
+  return NULL;
+}
+
+int bgpstream_kafka_writer_set_option(bgpstream_kafka_writer_t *writer,
+                                      const char *name, const char *value)
+{
+  return -1;
+}
+
+int bgpstream_kafka_writer_begin_record(bgpstream_kafka_writer_t *writer,
+                                        const bgpstream_record_t *record)
+{
+  return -1;
+}
+
+int bgpstream_kafka_writer_add_elem(bgpstream_kafka_writer_t *writer,
+                                    bgpstream_elem_t *elem)
+{
+  return -1;
+}
+
+int bgpstream_kafka_writer_end_record(bgpstream_kafka_writer_t *writer)
+{
+  return -1;
+}
+
+int bgpstream_kafka_writer_flush(bgpstream_kafka_writer_t *writer,
+                                 int timeout_ms)
+{
+  return -1;
+}
+
+void bgpstream_kafka_writer_destroy(bgpstream_kafka_writer_t *writer)
+{
+}
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_KAFKA_WRITER_H
+#define __BGPSTREAM_KAFKA_WRITER_H
+
+#include "bgpstream_elem.h"
+#include "bgpstream_record.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of the BGPStream Kafka
+ * writer, which produces the records and elems read from a stream to a Kafka
+ * topic.
+ *
+ * Each message is self-contained: in the binary encoding it is a complete
+ * binary stream (see bgpstream_binary.h) that holds one record, and in the
+ * JSON encoding it is a single JSON object that describes one elem. Messages
+ * are produced asynchronously, and batched and compressed by librdkafka.
+ *
+ * The writer is only functional if libbgpstream was built with Kafka support,
+ * otherwise bgpstream_kafka_writer_create fails.
+ */
+
+/**
+ * @name Public Enums
+ *
+ * @{ */
+
+/** Encodings of the messages produced by a Kafka writer */
+typedef enum {
+
+  /** A binary stream (see bgpstream_binary.h) with one record, which holds
+   * the elems added for it (or a single elem, when messages are partitioned
+   * by prefix or peer) */
+  BGPSTREAM_KAFKA_WRITER_BINARY = 0,
+
+  /** A JSON object with the fields of one elem and of its record: "type",
+   * "time", "project", "collector", "router", "router_ip", "peer_asn",
+   * "peer_ip", "prefix", "next_hop", "as_path", "communities", "old_state" and
+   * "new_state" (each a string, except for "time" and "peer_asn", and empty
+   * if it does not apply to the type of the elem) */
+  BGPSTREAM_KAFKA_WRITER_JSON = 1,
+
+} bgpstream_kafka_writer_encoding_t;
+
+/** How a Kafka writer picks the key (and so the partition) of its messages */
+typedef enum {
+
+  /** Key on the collector name, so that the messages of each collector keep
+   * their order */
+  BGPSTREAM_KAFKA_WRITER_BY_COLLECTOR = 0,
+
+  /** Key on the prefix of each elem (e.g., "192.0.2.0/24"), so that the
+   * messages of each prefix keep their order. Elems that have no prefix (peer
+   * state changes) are spread across partitions. */
+  BGPSTREAM_KAFKA_WRITER_BY_PREFIX = 1,
+
+  /** Key on the peer ASN of each elem (in decimal), so that the messages of
+   * each peer keep their order */
+  BGPSTREAM_KAFKA_WRITER_BY_PEER = 2,
+
+} bgpstream_kafka_writer_partition_t;
+
+/** @} */
+
+/**
+ * @name Public Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure that represents a Kafka topic being produced to */
+typedef struct bgpstream_kafka_writer bgpstream_kafka_writer_t;
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new Kafka writer
+ *
+ * @param brokers       comma-separated list of the Kafka brokers (host:port)
+ * @param topic         name of the topic to produce to
+ * @param encoding      encoding of the messages
+ * @param partition     how messages are spread across the partitions of the
+ *                      topic
+ * @return pointer to the writer if successful, NULL otherwise
+ *
+ * Messages are batched for up to 100 ms (or 10000 messages), and compressed
+ * using LZ4, unless other options are set using
+ * bgpstream_kafka_writer_set_option.
+ */
+bgpstream_kafka_writer_t *
+bgpstream_kafka_writer_create(const char *brokers, const char *topic,
+                              bgpstream_kafka_writer_encoding_t encoding,
+                              bgpstream_kafka_writer_partition_t partition);
+
+/** Set a librdkafka producer option
+ *
+ * @param writer        pointer to the writer
+ * @param name          name of the option (e.g., "linger.ms",
+ *                      "batch.num.messages" or "compression.codec")
+ * @param value         value of the option
+ * @return 0 if the option was set, -1 if it is invalid, or the first message
+ * has already been produced
+ */
+int bgpstream_kafka_writer_set_option(bgpstream_kafka_writer_t *writer,
+                                      const char *name, const char *value);
+
+/** Start producing the given record
+ *
+ * @param writer        pointer to the writer
+ * @param record        pointer to the record to produce
+ * @return 0 if successful, -1 otherwise
+ *
+ * The elems of the record are then added using bgpstream_kafka_writer_add_elem
+ * (so the caller chooses which elems to keep), and the record is finished using
+ * bgpstream_kafka_writer_end_record. The record must stay valid until then.
+ */
+int bgpstream_kafka_writer_begin_record(bgpstream_kafka_writer_t *writer,
+                                        const bgpstream_record_t *record);
+
+/** Add the given elem to the record being produced
+ *
+ * @param writer        pointer to the writer
+ * @param elem          pointer to the elem to add
+ * @return 0 if successful, -1 otherwise
+ */
+int bgpstream_kafka_writer_add_elem(bgpstream_kafka_writer_t *writer,
+                                    bgpstream_elem_t *elem);
+
+/** Finish producing the current record
+ *
+ * @param writer        pointer to the writer
+ * @return 0 if successful, -1 if a message could not be produced (or an
+ * earlier one could not be delivered)
+ *
+ * A record that no elem was added to is not produced.
+ */
+int bgpstream_kafka_writer_end_record(bgpstream_kafka_writer_t *writer);
+
+/** Wait until every message produced so far has been delivered
+ *
+ * @param writer        pointer to the writer
+ * @param timeout_ms    how long to wait for, in milliseconds
+ * @return 0 if every message was delivered, -1 otherwise
+ */
+int bgpstream_kafka_writer_flush(bgpstream_kafka_writer_t *writer,
+                                 int timeout_ms);
+
+/** Deliver the messages still queued (waiting for up to 10 seconds), and
+ * destroy the writer
+ *
+ * @param writer        pointer to the writer to destroy
+ */
+void bgpstream_kafka_writer_destroy(bgpstream_kafka_writer_t *writer);
+
+/** @} */
+
+#endif /* __BGPSTREAM_KAFKA_WRITER_H */
@@ -25,6 +25,10 @@
  */
 
 #include "bgpstream_log.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,42 +36,322 @@
 #include <time.h>
 #include <unistd.h> // getpid()
 
+/* number of messages the async ring buffer holds (a power of 2) */
+#define ASYNC_SLOTS 1024
+
+/* longest message kept by the ring buffer, longer ones are truncated */
+#define ASYNC_MSG_LEN 1024
+
+/* how long the writer thread sleeps when there is nothing to write */
+#define ASYNC_IDLE_USEC 10000
+
+/* most messages written per second, errors excepted, before the rest are
+ * suppressed */
+#define ASYNC_RATE_LIMIT 100
+
+typedef struct log_slot {
+  // sequence number of the slot (see ring_push and ring_pop)
+  uint64_t seq;
+
+  int level;
+  const char *file;
+  int line;
+  time_t time;
+  char msg[ASYNC_MSG_LEN];
+} log_slot_t;
+
+/* a bounded MPSC queue: any thread pushes, only the writer thread pops. The
+ * sequence number of each slot says whether it is free for the producer that
+ * claimed its position or holds a message for the consumer */
+typedef struct log_ring {
+  log_slot_t slots[ASYNC_SLOTS];
+
+  // next position to push to, claimed by producers with a CAS
+  uint64_t head;
+
+  // next position to pop from, only used by the writer thread
+  uint64_t tail;
+
+  // messages lost because the ring was full
+  uint64_t dropped;
+
+  // set to tell the writer thread to exit once the ring is empty
+  int stop;
+
+  pthread_t thread;
+} log_ring_t;
+
+/* the ring of the async mode, NULL when logging synchronously */
+static log_ring_t *async_ring = NULL;
+
+/* threads in the middle of a push, which the ring must outlive */
+static int async_users = 0;
+
+static const char *level_prefix(int level)
+{
+  return (level <= BGPSTREAM_LOG_ERR)
+           ? "ERROR: "
+           : (level <= BGPSTREAM_LOG_WARN)
+               ? "WARNING: "
+               : (level <= BGPSTREAM_LOG_INFO)
+                   ? "INFO: "
+                   : (level <= BGPSTREAM_LOG_CONFIG)
+                       ? "CONFIG: "
+                       : (level <= BGPSTREAM_LOG_FINE)
+                           ? "FINE: "
+                           : (level <= BGPSTREAM_LOG_VFINE)
+                               ? "VERYFINE: "
+                               : (level <= BGPSTREAM_LOG_FINEST) ? "FINEST: "
+                                                                 : "";
+}
+
+static void log_print(int level, const char *file, int line, time_t t,
+                      const char *msg)
+{
+  FILE *bgpstream_log_file = stderr;
+  char datebuf[32];
+  struct tm tm;
+
+  strftime(datebuf, sizeof(datebuf), "%Y-%m-%d %H:%M:%S",
+           localtime_r(&t, &tm));
+  fprintf(bgpstream_log_file, "%s %u: %s:%d: %s%s\n", datebuf, getpid(), file,
+          line, level_prefix(level), msg);
+  fflush(bgpstream_log_file);
+}
+
+// returns 0 if the message was queued, -1 if the ring was full
+static int ring_push(log_ring_t *ring, int level, const char *file, int line,
+                     const char *fmt, va_list ap)
+{
+  log_slot_t *slot;
+  uint64_t pos, seq;
+
+  pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  while (1) {
+    slot = &ring->slots[pos & (ASYNC_SLOTS - 1)];
+    seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if (seq == pos) {
+      if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+      // pos has been reloaded by the failed CAS
+    } else if ((int64_t)(seq - pos) < 0) {
+      // the writer has not consumed this slot yet: drop, never wait
+      __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+      return -1;
+    } else {
+      pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    }
+  }
+
+  slot->level = level;
+  slot->file = file;
+  slot->line = line;
+  slot->time = time(NULL);
+  vsnprintf(slot->msg, sizeof(slot->msg), fmt, ap);
+  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+// returns the slot of the next message, or NULL if the ring is empty. the
+// slot must be handed back with ring_release
+static log_slot_t *ring_pop(log_ring_t *ring)
+{
+  log_slot_t *slot = &ring->slots[ring->tail & (ASYNC_SLOTS - 1)];
+
+  if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ring->tail + 1) {
+    return NULL;
+  }
+  return slot;
+}
+
+static void ring_release(log_ring_t *ring, log_slot_t *slot)
+{
+  __atomic_store_n(&slot->seq, ring->tail + ASYNC_SLOTS, __ATOMIC_RELEASE);
+  ring->tail++;
+}
+
+/* state of the writer thread used to dedup and rate limit messages */
+typedef struct writer_state {
+  // the last message written, to collapse repeats of it
+  int level;
+  const char *file;
+  int line;
+  char msg[ASYNC_MSG_LEN];
+  uint64_t repeats;
+
+  // when the repeats were last reported
+  time_t repeats_time;
+
+  // the second the rate limit is being counted for
+  time_t second;
+  int written;
+  uint64_t suppressed;
+} writer_state_t;
+
+static void flush_repeats(writer_state_t *ws, time_t now)
+{
+  char buf[64];
+
+  if (ws->repeats != 0) {
+    snprintf(buf, sizeof(buf), "Last message repeated %" PRIu64 " times",
+             ws->repeats);
+    log_print(ws->level, ws->file, ws->line, now, buf);
+    ws->repeats = 0;
+  }
+  ws->repeats_time = now;
+}
+
+static void flush_suppressed(writer_state_t *ws, log_ring_t *ring, time_t now)
+{
+  uint64_t dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+  char buf[128];
+
+  if (ws->suppressed != 0) {
+    snprintf(buf, sizeof(buf),
+             "Suppressed %" PRIu64 " log messages (more than %d per second)",
+             ws->suppressed, ASYNC_RATE_LIMIT);
+    log_print(BGPSTREAM_LOG_WARN, __FILE__, __LINE__, now, buf);
+    ws->suppressed = 0;
+  }
+  if (dropped != 0) {
+    snprintf(buf, sizeof(buf),
+             "Dropped %" PRIu64 " log messages (log queue full)", dropped);
+    log_print(BGPSTREAM_LOG_WARN, __FILE__, __LINE__, now, buf);
+  }
+}
+
+static void write_slot(writer_state_t *ws, log_ring_t *ring, log_slot_t *slot)
+{
+  // repeats of the last message are only counted
+  if (slot->file == ws->file && slot->line == ws->line &&
+      slot->level == ws->level && strcmp(slot->msg, ws->msg) == 0) {
+    ws->repeats++;
+    return;
+  }
+  flush_repeats(ws, slot->time);
+
+  if (slot->time != ws->second) {
+    flush_suppressed(ws, ring, slot->time);
+    ws->second = slot->time;
+    ws->written = 0;
+  }
+  if (slot->level > BGPSTREAM_LOG_ERR && ws->written >= ASYNC_RATE_LIMIT) {
+    ws->suppressed++;
+    return;
+  }
+  ws->written++;
+
+  log_print(slot->level, slot->file, slot->line, slot->time, slot->msg);
+  ws->level = slot->level;
+  ws->file = slot->file;
+  ws->line = slot->line;
+  strcpy(ws->msg, slot->msg);
+}
+
+static void *writer_thread(void *user)
+{
+  log_ring_t *ring = user;
+  writer_state_t ws;
+  log_slot_t *slot;
+  time_t now;
+  int stop;
+
+  memset(&ws, 0, sizeof(ws));
+  while (1) {
+    if ((slot = ring_pop(ring)) != NULL) {
+      write_slot(&ws, ring, slot);
+      ring_release(ring, slot);
+      continue;
+    }
+    // idle: report what has been held back, at most once a second unless
+    // this is the last chance to
+    stop = __atomic_load_n(&ring->stop, __ATOMIC_ACQUIRE);
+    now = time(NULL);
+    if (stop || now != ws.repeats_time) {
+      flush_repeats(&ws, now);
+    }
+    if (stop || now != ws.second) {
+      flush_suppressed(&ws, ring, now);
+    }
+    if (stop) {
+      break;
+    }
+    usleep(ASYNC_IDLE_USEC);
+  }
+  return NULL;
+}
+
+int bgpstream_log_async_start(void)
+{
+  log_ring_t *ring;
+  uint64_t i;
+
+  if (async_ring != NULL) {
+    return -1;
+  }
+  if ((ring = malloc(sizeof(*ring))) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < ASYNC_SLOTS; i++) {
+    ring->slots[i].seq = i;
+  }
+  ring->head = ring->tail = 0;
+  ring->dropped = 0;
+  ring->stop = 0;
+  if (pthread_create(&ring->thread, NULL, writer_thread, ring) != 0) {
+    free(ring);
+    return -1;
+  }
+  __atomic_store_n(&async_ring, ring, __ATOMIC_RELEASE);
+  return 0;
+}
+
+void bgpstream_log_async_stop(void)
+{
+  log_ring_t *ring = async_ring;
+
+  if (ring == NULL) {
+    return;
+  }
+  // stop new pushes, then wait for those in flight before draining the ring
+  __atomic_store_n(&async_ring, NULL, __ATOMIC_SEQ_CST);
+  while (__atomic_load_n(&async_users, __ATOMIC_SEQ_CST) != 0) {
+    sched_yield();
+  }
+  __atomic_store_n(&ring->stop, 1, __ATOMIC_RELEASE);
+  pthread_join(ring->thread, NULL);
+  free(ring);
+}
+
 void bgpstream_log_func(int level, const char *file, int line, const char *fmt,
                         ...)
 {
   va_list va_ap;
+  log_ring_t *ring;
 
-  FILE *bgpstream_log_file = stderr;
+  if (level > BGPSTREAM_LOG_LEVEL) {
+    return;
+  }
 
-  if (level <= BGPSTREAM_LOG_LEVEL) {
-    char msgbuf[4096];
-    va_start(va_ap, fmt);
-    vsnprintf(msgbuf, sizeof(msgbuf) - 1, fmt, va_ap);
-    msgbuf[sizeof(msgbuf) - 1] = '\0';
-    va_end(va_ap);
-
-    char datebuf[32];
-    time_t t = time(NULL);
-    strftime(datebuf, sizeof(datebuf), "%Y-%m-%d %H:%M:%S", localtime(&t));
-
-    const char *prefix =
-      (level <= BGPSTREAM_LOG_ERR)
-        ? "ERROR: "
-        : (level <= BGPSTREAM_LOG_WARN)
-            ? "WARNING: "
-            : (level <= BGPSTREAM_LOG_INFO)
-                ? "INFO: "
-                : (level <= BGPSTREAM_LOG_CONFIG)
-                    ? "CONFIG: "
-                    : (level <= BGPSTREAM_LOG_FINE)
-                        ? "FINE: "
-                        : (level <= BGPSTREAM_LOG_VFINE)
-                            ? "VERYFINE: "
-                            : (level <= BGPSTREAM_LOG_FINEST) ? "FINEST: " : "";
-
-    fprintf(bgpstream_log_file, "%s %u: %s:%d: %s%s\n", datebuf, getpid(), file,
-            line, prefix, msgbuf);
-
-    fflush(bgpstream_log_file);
+  if (__atomic_load_n(&async_ring, __ATOMIC_RELAXED) != NULL) {
+    __atomic_add_fetch(&async_users, 1, __ATOMIC_SEQ_CST);
+    if ((ring = __atomic_load_n(&async_ring, __ATOMIC_SEQ_CST)) != NULL) {
+      va_start(va_ap, fmt);
+      ring_push(ring, level, file, line, fmt, va_ap);
+      va_end(va_ap);
+      __atomic_sub_fetch(&async_users, 1, __ATOMIC_SEQ_CST);
+      return;
+    }
+    // the async mode was stopped in the meantime
+    __atomic_sub_fetch(&async_users, 1, __ATOMIC_SEQ_CST);
   }
+
+  char msgbuf[4096];
+  va_start(va_ap, fmt);
+  vsnprintf(msgbuf, sizeof(msgbuf) - 1, fmt, va_ap);
+  msgbuf[sizeof(msgbuf) - 1] = '\0';
+  va_end(va_ap);
+  log_print(level, file, line, time(NULL), msgbuf);
 }
@@ -50,4 +50,21 @@ void bgpstream_log_func(int level, const char *file, int line,
                         const char *format, ...)
   __attribute__((format(printf, 4, 5)));
 
+/** Switch to logging asynchronously
+ *
+ * @return 0 if the async mode was started, -1 if it was already running or an
+ * error occurred
+ *
+ * Messages are queued in a lock-free ring buffer and written by a background
+ * thread, so that logging never blocks the thread that logs. When the ring is
+ * full messages are dropped, repeats of a message are collapsed and at most
+ * 100 messages (errors excepted) are written per second. The writer reports
+ * how many messages it dropped or suppressed.
+ */
+int bgpstream_log_async_start(void);
+
+/** Write the queued messages and switch back to logging synchronously
+ */
+void bgpstream_log_async_stop(void);
+
 #endif /* _BGPSTREAM_DEBUG_H */
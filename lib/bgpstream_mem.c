@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_mem.h"
+#include "utils.h"
+#include <stdlib.h>
+
+struct bgpstream_mem {
+
+  // bytes in use by each part of the stream, and in total
+  int64_t used[_BGPSTREAM_MEM_TYPE_CNT];
+  int64_t total;
+
+  // most bytes in use at once
+  int64_t peak;
+
+  // limit on the total (0 for no limit)
+  uint64_t limit;
+
+  // number of times the limit delayed opening a resource
+  uint64_t throttled;
+};
+
+bgpstream_mem_t *bgpstream_mem_create()
+{
+  return malloc_zero(sizeof(bgpstream_mem_t));
+}
+
+void bgpstream_mem_destroy(bgpstream_mem_t *mem)
+{
+  free(mem);
+}
+
+void bgpstream_mem_add(bgpstream_mem_t *mem, bgpstream_mem_type_t type,
+                       int64_t delta)
+{
+  int64_t total, peak;
+
+  if (mem == NULL || delta == 0) {
+    return;
+  }
+  __atomic_add_fetch(&mem->used[type], delta, __ATOMIC_RELAXED);
+  total = __atomic_add_fetch(&mem->total, delta, __ATOMIC_RELAXED);
+
+  peak = __atomic_load_n(&mem->peak, __ATOMIC_RELAXED);
+  while (total > peak &&
+         !__atomic_compare_exchange_n(&mem->peak, &peak, total, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+void bgpstream_mem_set_limit(bgpstream_mem_t *mem, uint64_t limit)
+{
+  __atomic_store_n(&mem->limit, limit, __ATOMIC_RELAXED);
+}
+
+uint64_t bgpstream_mem_get_limit(bgpstream_mem_t *mem)
+{
+  return __atomic_load_n(&mem->limit, __ATOMIC_RELAXED);
+}
+
+int bgpstream_mem_over_limit(bgpstream_mem_t *mem)
+{
+  uint64_t limit = bgpstream_mem_get_limit(mem);
+  int64_t total = __atomic_load_n(&mem->total, __ATOMIC_RELAXED);
+
+  return limit != 0 && total > 0 && (uint64_t)total >= limit;
+}
+
+void bgpstream_mem_throttled(bgpstream_mem_t *mem)
+{
+  __atomic_add_fetch(&mem->throttled, 1, __ATOMIC_RELAXED);
+}
+
+void bgpstream_mem_get_stats(bgpstream_mem_t *mem,
+                             bgpstream_mem_stats_t *stats)
+{
+  int64_t used;
+  int i;
+
+  // the parts may be updated as we read them, so only the sum of what we
+  // read is given as the total
+  stats->total = 0;
+  for (i = 0; i < _BGPSTREAM_MEM_TYPE_CNT; i++) {
+    used = __atomic_load_n(&mem->used[i], __ATOMIC_RELAXED);
+    stats->used[i] = used > 0 ? used : 0;
+    stats->total += stats->used[i];
+  }
+  used = __atomic_load_n(&mem->peak, __ATOMIC_RELAXED);
+  stats->peak = (uint64_t)used > stats->total ? (uint64_t)used : stats->total;
+  stats->limit = bgpstream_mem_get_limit(mem);
+  stats->throttled = __atomic_load_n(&mem->throttled, __ATOMIC_RELAXED);
+}
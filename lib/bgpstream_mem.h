@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_MEM_H
+#define __BGPSTREAM_MEM_H
+
+#include "bgpstream.h"
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Header file for the memory accounting of a stream, which tracks how
+ * much memory each part of the stream is using (see bgpstream_get_mem_stats).
+ *
+ * Memory is accounted where large buffers are allocated and freed (rather than
+ * for every allocation), so the numbers are estimates. Accounting may be done
+ * from any thread.
+ */
+
+/** Opaque structure that holds the memory accounting of a stream */
+typedef struct bgpstream_mem bgpstream_mem_t;
+
+/** Create a memory accounting object
+ *
+ * @return pointer to the object if successful, NULL otherwise
+ */
+bgpstream_mem_t *bgpstream_mem_create(void);
+
+/** Destroy the given memory accounting object */
+void bgpstream_mem_destroy(bgpstream_mem_t *mem);
+
+/** Account for memory allocated (or, if delta is negative, freed)
+ *
+ * @param mem           pointer to the accounting object (may be NULL, in
+ *                      which case this does nothing)
+ * @param type          part of the stream that the memory belongs to
+ * @param delta         number of bytes allocated
+ */
+void bgpstream_mem_add(bgpstream_mem_t *mem, bgpstream_mem_type_t type,
+                       int64_t delta);
+
+/** Set the memory limit
+ *
+ * @param mem           pointer to the accounting object
+ * @param limit         limit in bytes (0 for no limit)
+ */
+void bgpstream_mem_set_limit(bgpstream_mem_t *mem, uint64_t limit);
+
+/** Get the memory limit
+ *
+ * @param mem           pointer to the accounting object
+ * @return the limit in bytes, 0 if there is none
+ */
+uint64_t bgpstream_mem_get_limit(bgpstream_mem_t *mem);
+
+/** Check whether the memory limit has been reached
+ *
+ * @param mem           pointer to the accounting object
+ * @return 1 if there is a limit and the memory in use has reached it, 0
+ * otherwise
+ */
+int bgpstream_mem_over_limit(bgpstream_mem_t *mem);
+
+/** Count a resource whose opening was delayed by the memory limit
+ *
+ * @param mem           pointer to the accounting object
+ */
+void bgpstream_mem_throttled(bgpstream_mem_t *mem);
+
+/** Get the memory statistics
+ *
+ * @param mem           pointer to the accounting object
+ * @param[out] stats    filled with the statistics
+ */
+void bgpstream_mem_get_stats(bgpstream_mem_t *mem,
+                             bgpstream_mem_stats_t *stats);
+
+#endif /* __BGPSTREAM_MEM_H */
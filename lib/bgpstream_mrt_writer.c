@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_mrt_writer.h"
+#include "bgpstream_record_int.h"
+#include "bgpstream_log.h"
+#include "utils.h"
+#include "wandio.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+// compression level used for compressed output (the zlib default)
+#define MRT_WRITER_COMPRESS_LEVEL 6
+
+struct bgpstream_mrt_writer {
+
+  // path of the file being written (for log messages)
+  char *path;
+
+  // wandio writer for the file
+  iow_t *iow;
+
+  // ID of the raw prefix (e.g., peer index table) last written, 0 if none
+  uint64_t prefix_id;
+};
+
+static int write_bytes(bgpstream_mrt_writer_t *writer, const uint8_t *buf,
+                       size_t len)
+{
+  if (wandio_wwrite(writer->iow, buf, len) != (int64_t)len) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not write to %s", writer->path);
+    return -1;
+  }
+  return 0;
+}
+
+bgpstream_mrt_writer_t *bgpstream_mrt_writer_create(const char *path)
+{
+  bgpstream_mrt_writer_t *writer;
+
+  if ((writer = malloc_zero(sizeof(bgpstream_mrt_writer_t))) == NULL) {
+    return NULL;
+  }
+
+  if ((writer->path = strdup(path)) == NULL) {
+    goto err;
+  }
+
+  if ((writer->iow = wandio_wcreate(path, wandio_detect_compression_type(path),
+                                    MRT_WRITER_COMPRESS_LEVEL, O_CREAT)) ==
+      NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open %s for writing: %s",
+                  path, strerror(errno));
+    goto err;
+  }
+
+  return writer;
+
+err:
+  bgpstream_mrt_writer_destroy(writer);
+  return NULL;
+}
+
+int bgpstream_mrt_writer_write(bgpstream_mrt_writer_t *writer,
+                               const bgpstream_record_t *record)
+{
+  bgpstream_record_internal_t *ri = record->__int;
+
+  if (ri == NULL || ri->raw_len == 0) {
+    return 0;
+  }
+
+  if (ri->raw_prefix != NULL && ri->raw_prefix->id != writer->prefix_id) {
+    if (write_bytes(writer, ri->raw_prefix->data, ri->raw_prefix->len) != 0) {
+      return -1;
+    }
+    writer->prefix_id = ri->raw_prefix->id;
+  }
+
+  if (write_bytes(writer, ri->raw, ri->raw_len) != 0) {
+    return -1;
+  }
+
+  return 1;
+}
+
+void bgpstream_mrt_writer_destroy(bgpstream_mrt_writer_t *writer)
+{
+  if (writer == NULL) {
+    return;
+  }
+
+  if (writer->iow != NULL) {
+    wandio_wdestroy(writer->iow);
+    writer->iow = NULL;
+  }
+
+  free(writer->path);
+  writer->path = NULL;
+
+  free(writer);
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_MRT_WRITER_H
+#define __BGPSTREAM_MRT_WRITER_H
+
+#include "bgpstream_record.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of the BGPStream MRT
+ * writer, which writes the records read from a stream to a new MRT file.
+ *
+ */
+
+/**
+ * @name Public Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure that represents an MRT file being written */
+typedef struct bgpstream_mrt_writer bgpstream_mrt_writer_t;
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new MRT writer
+ *
+ * @param path          path of the file to write (compressed according to its
+ *                      extension, e.g., ".gz" or ".bz2")
+ * @return pointer to the writer if successful, NULL otherwise
+ *
+ * Records are written using the raw bytes kept by the stream, so the stream
+ * that produces them must be configured using bgpstream_set_raw_records.
+ */
+bgpstream_mrt_writer_t *bgpstream_mrt_writer_create(const char *path);
+
+/** Write the given record to the MRT file
+ *
+ * @param writer        pointer to the writer
+ * @param record        pointer to the record to write
+ * @return 1 if the record was written, 0 if it has no raw bytes (e.g., it was
+ * not read from an MRT resource), -1 if an error occurred
+ *
+ * Records are written exactly as they were read. The TABLE_DUMP_V2 peer index
+ * table that a RIB record depends on is written before it whenever it differs
+ * from the one last written, so RIB records from several dumps may be written
+ * to the same file, and the file can be read again using the singlefile data
+ * interface.
+ */
+int bgpstream_mrt_writer_write(bgpstream_mrt_writer_t *writer,
+                               const bgpstream_record_t *record);
+
+/** Flush and close the MRT file, and destroy the writer
+ *
+ * @param writer        pointer to the writer to destroy
+ */
+void bgpstream_mrt_writer_destroy(bgpstream_mrt_writer_t *writer);
+
+/** @} */
+
+#endif /* __BGPSTREAM_MRT_WRITER_H */
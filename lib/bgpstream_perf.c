@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_perf.h"
+#include "bgpstream_log.h"
+#include "khash.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+KHASH_INIT(perf_collector, char *, int, 1, kh_str_hash_func, kh_str_hash_equal)
+
+struct bgpstream_perf {
+
+  // are stages timed?
+  int timing;
+
+  // records returned to the user
+  uint64_t records;
+
+  // queries to the data interface
+  uint64_t di_queries;
+
+  // polls of stream resources that had no record ready
+  uint64_t polls_again;
+
+  // messages that the Kafka consumers have yet to read
+  uint64_t kafka_lag;
+
+  // bytes read from, reads of, and time spent reading from each type of
+  // transport
+  uint64_t transport_bytes[_BGPSTREAM_PERF_TRANSPORT_CNT];
+  uint64_t transport_reads[_BGPSTREAM_PERF_TRANSPORT_CNT];
+  uint64_t transport_read_ns[_BGPSTREAM_PERF_TRANSPORT_CNT];
+
+  // nanoseconds spent in each stage
+  uint64_t stage_ns[_BGPSTREAM_PERF_STAGE_CNT];
+
+  // statistics of each collector, and the index of each collector in them.
+  // only used by the thread that reads records
+  khash_t(perf_collector) *collector_idx;
+  bgpstream_collector_stats_t *collectors;
+  int collectors_cnt;
+  int collectors_alloc;
+
+  // collector of the last record, which the next record is likely to share
+  int collector_last;
+};
+
+// nanoseconds that this thread has accounted to stages, which lets a stage
+// leave out the time spent in stages nested inside it
+static __thread uint64_t thread_ns;
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+bgpstream_perf_t *bgpstream_perf_create()
+{
+  return malloc_zero(sizeof(bgpstream_perf_t));
+}
+
+void bgpstream_perf_destroy(bgpstream_perf_t *perf)
+{
+  khiter_t k;
+
+  if (perf == NULL) {
+    return;
+  }
+  if (perf->collector_idx != NULL) {
+    for (k = kh_begin(perf->collector_idx); k != kh_end(perf->collector_idx);
+         ++k) {
+      if (kh_exist(perf->collector_idx, k)) {
+        free(kh_key(perf->collector_idx, k));
+      }
+    }
+    kh_destroy(perf_collector, perf->collector_idx);
+  }
+  free(perf->collectors);
+  free(perf);
+}
+
+void bgpstream_perf_set_timing(bgpstream_perf_t *perf)
+{
+  perf->timing = 1;
+}
+
+void bgpstream_perf_add_records(bgpstream_perf_t *perf, uint64_t cnt)
+{
+  if (perf == NULL) {
+    return;
+  }
+  __atomic_add_fetch(&perf->records, cnt, __ATOMIC_RELAXED);
+}
+
+// returns the index of the stats of the given collector, adding them if
+// needed, or -1 if an error occurred
+static int collector_get(bgpstream_perf_t *perf, const char *name)
+{
+  bgpstream_collector_stats_t *c;
+  khiter_t k;
+  char *key;
+  int khret, alloc;
+
+  if (perf->collector_idx == NULL &&
+      (perf->collector_idx = kh_init(perf_collector)) == NULL) {
+    return -1;
+  }
+  if ((k = kh_get(perf_collector, perf->collector_idx, (char *)name)) !=
+      kh_end(perf->collector_idx)) {
+    return kh_val(perf->collector_idx, k);
+  }
+
+  if (perf->collectors_cnt == perf->collectors_alloc) {
+    alloc = perf->collectors_alloc == 0 ? 4 : perf->collectors_alloc * 2;
+    if ((c = realloc(perf->collectors, sizeof(*c) * alloc)) == NULL) {
+      return -1;
+    }
+    perf->collectors = c;
+    perf->collectors_alloc = alloc;
+  }
+  if ((key = strdup(name)) == NULL) {
+    return -1;
+  }
+  k = kh_put(perf_collector, perf->collector_idx, key, &khret);
+  if (khret < 0) {
+    free(key);
+    return -1;
+  }
+  kh_val(perf->collector_idx, k) = perf->collectors_cnt;
+
+  c = &perf->collectors[perf->collectors_cnt];
+  memset(c, 0, sizeof(*c));
+  strncpy(c->name, name, sizeof(c->name) - 1);
+  return perf->collectors_cnt++;
+}
+
+void bgpstream_perf_add_collector_record(bgpstream_perf_t *perf,
+                                         const char *collector, uint32_t time)
+{
+  bgpstream_collector_stats_t *c;
+  int i;
+
+  if (perf == NULL) {
+    return;
+  }
+  i = perf->collector_last;
+  if (i >= perf->collectors_cnt ||
+      strcmp(perf->collectors[i].name, collector) != 0) {
+    if ((i = collector_get(perf, collector)) < 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not count the records of %s",
+                    collector);
+      return;
+    }
+    perf->collector_last = i;
+  }
+  c = &perf->collectors[i];
+  c->records++;
+  if (time > c->last_time) {
+    c->last_time = time;
+  }
+}
+
+void bgpstream_perf_add_poll_again(bgpstream_perf_t *perf)
+{
+  if (perf == NULL) {
+    return;
+  }
+  __atomic_add_fetch(&perf->polls_again, 1, __ATOMIC_RELAXED);
+}
+
+void bgpstream_perf_add_kafka_lag(bgpstream_perf_t *perf, int64_t delta)
+{
+  if (perf == NULL || delta == 0) {
+    return;
+  }
+  __atomic_add_fetch(&perf->kafka_lag, (uint64_t)delta, __ATOMIC_RELAXED);
+}
+
+void bgpstream_perf_add_di_query(bgpstream_perf_t *perf)
+{
+  if (perf == NULL) {
+    return;
+  }
+  __atomic_add_fetch(&perf->di_queries, 1, __ATOMIC_RELAXED);
+}
+
+void bgpstream_perf_add_read(bgpstream_perf_t *perf, int type, int64_t bytes,
+                             uint64_t ns)
+{
+  if (perf == NULL || type < 0 || type >= _BGPSTREAM_PERF_TRANSPORT_CNT) {
+    return;
+  }
+  __atomic_add_fetch(&perf->transport_reads[type], 1, __ATOMIC_RELAXED);
+  if (bytes > 0) {
+    __atomic_add_fetch(&perf->transport_bytes[type], bytes, __ATOMIC_RELAXED);
+  }
+  if (ns != 0) {
+    __atomic_add_fetch(&perf->transport_read_ns[type], ns, __ATOMIC_RELAXED);
+  }
+}
+
+void bgpstream_perf_start(bgpstream_perf_t *perf,
+                          bgpstream_perf_timer_t *timer)
+{
+  if (perf == NULL || perf->timing == 0) {
+    timer->start = 0;
+    return;
+  }
+  timer->start = now_ns();
+  timer->inner = thread_ns;
+}
+
+uint64_t bgpstream_perf_stop(bgpstream_perf_t *perf,
+                             bgpstream_perf_stage_t stage,
+                             bgpstream_perf_timer_t *timer)
+{
+  uint64_t elapsed, own;
+
+  if (timer->start == 0) {
+    return 0;
+  }
+  elapsed = now_ns() - timer->start;
+  // the time of nested stages has been accounted already
+  own = elapsed - (thread_ns - timer->inner);
+  __atomic_add_fetch(&perf->stage_ns[stage], own, __ATOMIC_RELAXED);
+  // and a stage that this one is nested in must leave all of it out
+  thread_ns = timer->inner + elapsed;
+  return own;
+}
+
+void bgpstream_perf_get_stats(bgpstream_perf_t *perf,
+                              bgpstream_perf_stats_t *stats)
+{
+  int i;
+
+  stats->records = __atomic_load_n(&perf->records, __ATOMIC_RELAXED);
+  stats->di_queries = __atomic_load_n(&perf->di_queries, __ATOMIC_RELAXED);
+  stats->polls_again = __atomic_load_n(&perf->polls_again, __ATOMIC_RELAXED);
+  stats->kafka_lag = __atomic_load_n(&perf->kafka_lag, __ATOMIC_RELAXED);
+  for (i = 0; i < _BGPSTREAM_PERF_TRANSPORT_CNT; i++) {
+    stats->transport_bytes[i] =
+      __atomic_load_n(&perf->transport_bytes[i], __ATOMIC_RELAXED);
+    stats->transport_reads[i] =
+      __atomic_load_n(&perf->transport_reads[i], __ATOMIC_RELAXED);
+    stats->transport_read_ns[i] =
+      __atomic_load_n(&perf->transport_read_ns[i], __ATOMIC_RELAXED);
+  }
+  for (i = 0; i < _BGPSTREAM_PERF_STAGE_CNT; i++) {
+    stats->stage_ns[i] = __atomic_load_n(&perf->stage_ns[i], __ATOMIC_RELAXED);
+  }
+}
+
+int bgpstream_perf_get_collector_stats(bgpstream_perf_t *perf,
+                                       bgpstream_collector_stats_t *stats,
+                                       int len)
+{
+  if (len > perf->collectors_cnt) {
+    len = perf->collectors_cnt;
+  }
+  if (len > 0) {
+    memcpy(stats, perf->collectors, sizeof(*stats) * len);
+  }
+  return perf->collectors_cnt;
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_PERF_H
+#define __BGPSTREAM_PERF_H
+
+#include "bgpstream.h"
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Header file for the throughput accounting of a stream, which counts
+ * records, data interface queries and the reads of transports, and times each
+ * stage of the stream (see bgpstream_get_perf_stats). Accounting may be done
+ * from any thread.
+ */
+
+/** Opaque structure that holds the throughput accounting of a stream */
+typedef struct bgpstream_perf bgpstream_perf_t;
+
+/** Timer for one run of a stage (see bgpstream_perf_start) */
+typedef struct bgpstream_perf_timer {
+
+  /** When the stage started (0 if timing is disabled) */
+  uint64_t start;
+
+  /** Time the thread had accounted to stages when the stage started */
+  uint64_t inner;
+
+} bgpstream_perf_timer_t;
+
+/** Create a throughput accounting object
+ *
+ * @return pointer to the object if successful, NULL otherwise
+ */
+bgpstream_perf_t *bgpstream_perf_create(void);
+
+/** Destroy the given throughput accounting object */
+void bgpstream_perf_destroy(bgpstream_perf_t *perf);
+
+/** Enable the timing of stages
+ *
+ * @param perf          pointer to the accounting object
+ */
+void bgpstream_perf_set_timing(bgpstream_perf_t *perf);
+
+/** Count records returned to the user
+ *
+ * @param perf          pointer to the accounting object (may be NULL, in
+ *                      which case this does nothing)
+ * @param cnt           number of records
+ */
+void bgpstream_perf_add_records(bgpstream_perf_t *perf, uint64_t cnt);
+
+/** Count a record returned to the user towards the stats of its collector
+ *
+ * @param perf          pointer to the accounting object
+ * @param collector     name of the collector of the record
+ * @param time          time of the record
+ *
+ * Unlike the other counts, this must only be done by the thread that reads
+ * records from the stream.
+ */
+void bgpstream_perf_add_collector_record(bgpstream_perf_t *perf,
+                                         const char *collector, uint32_t time);
+
+/** Count a poll of a stream resource that had no record ready
+ *
+ * @param perf          pointer to the accounting object (may be NULL, in
+ *                      which case this does nothing)
+ */
+void bgpstream_perf_add_poll_again(bgpstream_perf_t *perf);
+
+/** Change the number of messages that Kafka consumers have yet to read
+ *
+ * @param perf          pointer to the accounting object (may be NULL, in
+ *                      which case this does nothing)
+ * @param delta         change in the lag of one consumer
+ *
+ * Each consumer adds the changes of its own lag, and takes it all away again
+ * when it is destroyed, so that the lag is summed over the consumers.
+ */
+void bgpstream_perf_add_kafka_lag(bgpstream_perf_t *perf, int64_t delta);
+
+/** Count a query to the data interface
+ *
+ * @param perf          pointer to the accounting object (may be NULL, in
+ *                      which case this does nothing)
+ */
+void bgpstream_perf_add_di_query(bgpstream_perf_t *perf);
+
+/** Count a read from a transport
+ *
+ * @param perf          pointer to the accounting object (may be NULL, in
+ *                      which case this does nothing)
+ * @param type          type of the transport (a
+ *                      bgpstream_resource_transport_type_t)
+ * @param bytes         number of bytes read (ignored unless positive)
+ * @param ns            nanoseconds the read took (as returned by
+ *                      bgpstream_perf_stop)
+ */
+void bgpstream_perf_add_read(bgpstream_perf_t *perf, int type, int64_t bytes,
+                             uint64_t ns);
+
+/** Start timing a stage
+ *
+ * @param perf          pointer to the accounting object (may be NULL)
+ * @param[out] timer    timer to pass to bgpstream_perf_stop
+ *
+ * Does nothing (beyond clearing the timer) unless timing is enabled.
+ */
+void bgpstream_perf_start(bgpstream_perf_t *perf,
+                          bgpstream_perf_timer_t *timer);
+
+/** Stop timing a stage, and account the time it took
+ *
+ * @param perf          pointer to the accounting object (may be NULL)
+ * @param stage         stage that was timed
+ * @param timer         timer that was started with bgpstream_perf_start by
+ *                      the same thread
+ * @return the nanoseconds accounted to the stage (0 unless timing is enabled)
+ *
+ * Time that the thread accounted to other stages while this one ran is left
+ * out, so that each nanosecond is only accounted to one stage.
+ */
+uint64_t bgpstream_perf_stop(bgpstream_perf_t *perf,
+                             bgpstream_perf_stage_t stage,
+                             bgpstream_perf_timer_t *timer);
+
+/** Get the throughput statistics
+ *
+ * @param perf          pointer to the accounting object
+ * @param[out] stats    filled with the record, transport and stage statistics
+ *                      (the other fields are left alone)
+ */
+void bgpstream_perf_get_stats(bgpstream_perf_t *perf,
+                              bgpstream_perf_stats_t *stats);
+
+/** Get the statistics of the records of each collector
+ *
+ * @param perf          pointer to the accounting object
+ * @param[out] stats    filled with the statistics of up to len collectors
+ * @param len           number of structures in the stats array
+ * @return the number of collectors seen so far
+ */
+int bgpstream_perf_get_collector_stats(bgpstream_perf_t *perf,
+                                       bgpstream_collector_stats_t *stats,
+                                       int len);
+
+#endif /* __BGPSTREAM_PERF_H */
@@ -26,7 +26,10 @@
 
 #include "bgpstream_reader.h"
 #include "bgpstream_record_int.h"
+#include "bgpstream_breaker.h"
 #include "bgpstream_log.h"
+#include "bgpstream_mem.h"
+#include "bgpstream_perf.h"
 #include "utils.h"
 #include <assert.h>
 #include <pthread.h>
@@ -35,8 +38,30 @@
 #define DUMP_OPEN_MAX_RETRIES 5
 #define DUMP_OPEN_MIN_RETRY_WAIT 10
 
-#define PREFETCH_IDX (reader->rec_buf_prefetch_idx)
-#define EXPORTED_IDX ((reader->rec_buf_prefetch_idx + 1) % 2)
+/* If polling a stream for new data took at least this long (in msec) then the
+   transport waits for data to arrive (e.g., Kafka), and so the worker can keep
+   polling without spinning */
+#define STREAM_BLOCKING_POLL_MSEC 10
+
+/* The ring starts out holding the exported record and the one being
+   prefetched behind it, plus however many records the read-ahead worker is
+   allowed to decode in advance. It grows if the user holds on to more exported
+   records than that (see bgpstream_reader_get_next_record). */
+#define RING_SIZE (reader->rec_buf_size)
+
+/* Memory accounted for a reader with a ring of the given size (the records in
+   it come from the record pool, but they are only there while it needs them) */
+#define READER_MEM(size)                                                       \
+  (sizeof(bgpstream_reader_t) +                                                \
+   (size) * (sizeof(bgpstream_record_t *) + sizeof(bgpstream_record_t) +       \
+             sizeof(struct bgpstream_record_internal)))
+
+#define HEAD_IDX (reader->rec_buf_head)
+#define TAIL_IDX ((reader->rec_buf_head + reader->rec_buf_cnt) % RING_SIZE)
+#define LAST_IDX                                                               \
+  ((reader->rec_buf_head + reader->rec_buf_cnt + RING_SIZE - 1) % RING_SIZE)
+
+#define IS_STREAM (reader->res->duration == BGPSTREAM_FOREVER)
 
 struct bgpstream_reader {
 
@@ -46,22 +71,41 @@ struct bgpstream_reader {
   // borrowed pointer to a filter manager instance
   bgpstream_filter_mgr_t *filter_mgr;
 
-  // internal flip-flop buffers for storing records
-  bgpstream_record_t *rec_buf[2];
-  int rec_buf_filled[2];
+  // number of records the worker may decode ahead of the consumer (0 means
+  // decode synchronously in get_next_record)
+  int readahead;
 
-  // which of the flip-flop buffers is currently holding the "prefetch" record
-  // the other ((this+1)%2) is holding the "exported" record
-  int rec_buf_prefetch_idx;
+  // borrowed pointer to the pool that runs our open and read-ahead jobs
+  bgpstream_worker_pool_t *pool;
 
-  // status of the underlying reader
-  bgpstream_format_status_t status;
+  // borrowed pointer to the pool that our records come from (may be NULL)
+  bgpstream_record_pool_t *record_pool;
 
-  // handle for the thread that will do the actual opening
-  pthread_t opener_thread;
+  // the job that does the actual opening (and the read-ahead decoding if
+  // enabled)
+  bgpstream_worker_pool_job_t job;
 
   // ALL BELOW HERE MUST USE MUTEX
 
+  // is the job queued or running?
+  int job_pending;
+
+  // ring of RING_SIZE records. rec_buf_cnt filled records start at
+  // rec_buf_head, and the rec_buf_exported slots before the head are records
+  // that have been handed to the user and are still in use
+  bgpstream_record_t **rec_buf;
+  int rec_buf_size;
+  int rec_buf_head;
+  int rec_buf_cnt;
+  int rec_buf_exported;
+
+  // signalled whenever a record is added to, or removed from, the ring, and
+  // when the job finishes
+  pthread_cond_t rec_buf_cond;
+
+  // status of the underlying reader
+  bgpstream_format_status_t status;
+
   // format instance
   bgpstream_format_t *format;
 
@@ -73,66 +117,116 @@ struct bgpstream_reader {
   // can the dump open check be skipped?
   int skip_dump_check;
 
-  // what is the time of the next record (PREFETCH)
+  // set when the reader is being destroyed
+  int shutdown;
+
+  // failed attempts to open the dump so far (from all of its URLs), and how
+  // long (in sec) to wait before the next one
+  int open_retries;
+  int open_delay;
+
+  // set while the job waits to try opening the dump again
+  int open_retry_wait;
+
+  // the URL the dump was given (if we have failed over to a mirror), and the
+  // index of the URL we are on (0 for that one, then the mirrors)
+  char *first_url;
+  int url_idx;
+
+  // number of records the worker currently decodes ahead, as given its share
+  // of the read-ahead by the resource manager (starts out as readahead)
+  int readahead_limit;
+
+  // set while the filter manager is being switched, to keep the job from
+  // decoding (or requeueing itself)
+  int paused;
+
+  // what is the time of the most recently prefetched record
   uint32_t next_time;
 };
 
-static int prefetch_record(bgpstream_reader_t *reader)
+// updates the ring with the result of decoding a record into the TAIL slot.
+// must be called with the mutex held if read-ahead is enabled.
+static void publish_record(bgpstream_reader_t *reader,
+                           bgpstream_format_status_t status)
 {
-  bgpstream_record_t *record;
-  assert(reader->status == BGPSTREAM_FORMAT_OK);
-  assert(reader->rec_buf_filled[PREFETCH_IDX] == 0);
+  bgpstream_record_t *record = reader->rec_buf[TAIL_IDX];
 
-  record = reader->rec_buf[PREFETCH_IDX];
-
-  // first, clear up our record
-  // note that this only destroys the reader struct and resets the elem
-  // generator. it does not clear the collector name etc as we reuse that.
-  bgpstream_record_clear(record);
-
-  // try and get the next entry from the resource (will do filtering)
-  reader->status = bgpstream_format_populate_record(reader->format, record);
+  reader->status = status;
 
   // if we got any of the non-error END_OF_DUMP messages but this is a stream
   // resource, then pretend we're ok.  but beware that now we'll be "OK", with
   // an unfilled prefetch record
-  if (reader->res->duration == BGPSTREAM_FOREVER &&
-      (reader->status == BGPSTREAM_FORMAT_END_OF_DUMP ||
-       reader->status == BGPSTREAM_FORMAT_FILTERED_DUMP ||
-       reader->status == BGPSTREAM_FORMAT_EMPTY_DUMP ||
-       reader->status == BGPSTREAM_FORMAT_CORRUPTED_DUMP)) {
+  if (IS_STREAM && (reader->status == BGPSTREAM_FORMAT_END_OF_DUMP ||
+                    reader->status == BGPSTREAM_FORMAT_FILTERED_DUMP ||
+                    reader->status == BGPSTREAM_FORMAT_EMPTY_DUMP ||
+                    reader->status == BGPSTREAM_FORMAT_CORRUPTED_DUMP)) {
     reader->status = BGPSTREAM_FORMAT_OK;
-    return 0;
+    return;
   }
 
   // if we see corrupted or unsupported message, we still
   // fill the buffer and should continue reading
   if (reader->status == BGPSTREAM_FORMAT_CORRUPTED_MSG ||
       reader->status == BGPSTREAM_FORMAT_UNSUPPORTED_MSG) {
-    reader->rec_buf_filled[PREFETCH_IDX] = 1;
+    reader->rec_buf_cnt++;
     reader->status = BGPSTREAM_FORMAT_OK;
-    return 0;
+    return;
   }
 
   reader->next_time = record->time_sec;
 
   // set the previous record position to END if we didn't skip any records. we
   // know this because the format has set the position of the current record to
-  // END (if records were skipped, it would be set to MIDDLE)
+  // END (if records were skipped, it would be set to MIDDLE). the previous
+  // record is never exported before this record has been prefetched, so it is
+  // still in the ring.
   if (reader->status == BGPSTREAM_FORMAT_END_OF_DUMP &&
-      record->dump_pos == BGPSTREAM_DUMP_END &&
-      reader->rec_buf_filled[EXPORTED_IDX] == 1) {
-    reader->rec_buf[EXPORTED_IDX]->dump_pos = BGPSTREAM_DUMP_END;
+      record->dump_pos == BGPSTREAM_DUMP_END && reader->rec_buf_cnt > 0) {
+    reader->rec_buf[LAST_IDX]->dump_pos = BGPSTREAM_DUMP_END;
   }
 
   // we export a meta record for every status except end of dump
   if (reader->status != BGPSTREAM_FORMAT_END_OF_DUMP) {
-    reader->rec_buf_filled[PREFETCH_IDX] = 1;
+    reader->rec_buf_cnt++;
   }
+}
+
+// decode the next record into the given (unused) ring slot
+static bgpstream_format_status_t decode_record(bgpstream_reader_t *reader,
+                                               bgpstream_record_t *record)
+{
+  // first, clear up our record
+  // note that this only destroys the reader struct and resets the elem
+  // generator. it does not clear the collector name etc as we reuse that.
+  bgpstream_record_clear(record);
+
+  // try and get the next entry from the resource (will do filtering)
+  return bgpstream_format_populate_record(reader->format, record);
+}
+
+static int prefetch_record(bgpstream_reader_t *reader)
+{
+  assert(reader->status == BGPSTREAM_FORMAT_OK);
+  assert(reader->rec_buf_cnt + reader->rec_buf_exported < RING_SIZE);
+
+  publish_record(reader, decode_record(reader, reader->rec_buf[TAIL_IDX]));
 
   return 0;
 }
 
+// can the HEAD record be handed to the user? a dump record is only exported
+// once the record after it has been prefetched (so that we know if it was the
+// last one in the dump), or once the dump has finished.
+static int head_exportable(bgpstream_reader_t *reader)
+{
+  if (reader->rec_buf_cnt == 0) {
+    return 0;
+  }
+  return IS_STREAM || reader->rec_buf_cnt > 1 ||
+         reader->status != BGPSTREAM_FORMAT_OK;
+}
+
 // fills the record with resource-level info that doesn't change per-record
 static int prepopulate_record(bgpstream_record_t *record,
                               bgpstream_resource_t *res)
@@ -145,6 +239,14 @@ static int prepopulate_record(bgpstream_record_t *record,
   strncpy(record->collector_name, res->collector, BGPSTREAM_UTILS_STR_NAME_LEN);
   record->collector_name[BGPSTREAM_UTILS_STR_NAME_LEN - 1] = '\0';
 
+  // and their IDs
+  if (bgpstream_record_intern_name(record->project_name,
+                                   &record->project_id) != 0 ||
+      bgpstream_record_intern_name(record->collector_name,
+                                   &record->collector_id) != 0) {
+    return -1;
+  }
+
   // dump type
   record->type = res->record_type;
 
@@ -154,46 +256,255 @@ static int prepopulate_record(bgpstream_record_t *record,
   return 0;
 }
 
-static void *threaded_opener(void *user)
+// doubles the size of the ring so that another record can be decoded while the
+// user is holding on to all the exported ones. the records keep their order
+// (oldest exported record first), so the slot the job may be decoding into is
+// still the TAIL slot afterward. must be called with the mutex held if
+// read-ahead is enabled.
+static int grow_ring(bgpstream_reader_t *reader)
 {
-  bgpstream_reader_t *reader = (bgpstream_reader_t *)user;
-  int retries = 0;
-  int delay = DUMP_OPEN_MIN_RETRY_WAIT;
+  bgpstream_record_t **rec_buf;
+  int size = RING_SIZE * 2;
+  int first = (HEAD_IDX + RING_SIZE - reader->rec_buf_exported) % RING_SIZE;
+  int i;
+
+  if ((rec_buf = malloc_zero(sizeof(bgpstream_record_t *) * size)) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < RING_SIZE; i++) {
+    rec_buf[i] = reader->rec_buf[(first + i) % RING_SIZE];
+  }
+  for (i = RING_SIZE; i < size; i++) {
+    if ((rec_buf[i] = bgpstream_record_pool_get(reader->record_pool,
+                                                reader->format)) == NULL ||
+        prepopulate_record(rec_buf[i], reader->res) != 0) {
+      goto err;
+    }
+  }
+
+  free(reader->rec_buf);
+  bgpstream_mem_add(reader->res->mem, BGPSTREAM_MEM_READERS,
+                    READER_MEM(size) - READER_MEM(RING_SIZE));
+  reader->rec_buf = rec_buf;
+  reader->rec_buf_head = reader->rec_buf_exported;
+  reader->rec_buf_size = size;
+  return 0;
+
+err:
+  for (i = RING_SIZE; i < size; i++) {
+    bgpstream_record_pool_put(reader->record_pool, rec_buf[i]);
+  }
+  free(rec_buf);
+  return -1;
+}
+
+// takes back the exported records that the user is done with. a record that is
+// still retained (see bgpstream_record_retain) is left to its holders, and a new
+// record takes its slot. must be called with the mutex held if read-ahead is
+// enabled.
+static int reclaim_exported(bgpstream_reader_t *reader)
+{
+  bgpstream_record_t **slot;
+  int i;
+
+  for (i = 1; i <= reader->rec_buf_exported; i++) {
+    slot = &reader->rec_buf[(HEAD_IDX + RING_SIZE - i) % RING_SIZE];
+    if (bgpstream_record_detach(*slot) == 0) {
+      continue;
+    }
+    if ((*slot = bgpstream_record_pool_get(reader->record_pool,
+                                           reader->format)) == NULL ||
+        prepopulate_record(*slot, reader->res) != 0) {
+      return -1;
+    }
+  }
+  reader->rec_buf_exported = 0;
+  return 0;
+}
+
+// is there a free ring slot for the job to decode into (within its current
+// share of the read-ahead)? must be called with the mutex held.
+static int ring_has_room(bgpstream_reader_t *reader)
+{
+  return reader->rec_buf_cnt + reader->rec_buf_exported < RING_SIZE &&
+         reader->rec_buf_cnt < reader->readahead_limit + 2;
+}
+
+// decodes records into free ring slots until the ring is full, the dump ends,
+// or the reader is destroyed. a stream resource that has no new data is only
+// polled once, and every record decoded from a stream posts a pool event to
+// wake the consumer. returns 1 if the stream had no data but its transport
+// waited for some, 0 otherwise. must be called with the mutex held.
+static int readahead_fill(bgpstream_reader_t *reader)
+{
+  bgpstream_record_t *record;
+  bgpstream_format_status_t status;
+  uint64_t start = 0;
+  int cnt;
+
+  while (reader->shutdown == 0 && reader->paused == 0 &&
+         reader->status == BGPSTREAM_FORMAT_OK && ring_has_room(reader)) {
+    // only the job adds records, so the TAIL slot cannot be taken from us
+    // while we decode without the lock
+    record = reader->rec_buf[TAIL_IDX];
+    pthread_mutex_unlock(&reader->mutex);
+    if (IS_STREAM) {
+      start = epoch_msec();
+    }
+    status = decode_record(reader, record);
+    pthread_mutex_lock(&reader->mutex);
+
+    cnt = reader->rec_buf_cnt;
+    publish_record(reader, status);
+    pthread_cond_broadcast(&reader->rec_buf_cond);
+
+    if (IS_STREAM) {
+      if (cnt == reader->rec_buf_cnt) {
+        return (epoch_msec() - start >= STREAM_BLOCKING_POLL_MSEC);
+      }
+      bgpstream_worker_pool_post_event(reader->pool);
+    }
+  }
+
+  return 0;
+}
+
+// must be called with the mutex held
+static void schedule_job(bgpstream_reader_t *reader)
+{
+  if (reader->job_pending != 0 || reader->shutdown != 0) {
+    return;
+  }
+  reader->job_pending = 1;
+  bgpstream_worker_pool_submit(reader->pool, &reader->job);
+}
+
+// must be called with the mutex held
+static void schedule_readahead(bgpstream_reader_t *reader)
+{
+  if (reader->readahead > 0 && reader->status == BGPSTREAM_FORMAT_OK &&
+      ring_has_room(reader)) {
+    schedule_job(reader);
+  }
+}
+
+// moves the resource on to its next URL (see BGPSTREAM_RESOURCE_ATTR_MIRRORS).
+// returns 1 if there is a mirror left to try, 0 if we are back to the first URL
+// (or there are no mirrors), -1 if an error occurred
+static int next_url(bgpstream_reader_t *reader)
+{
+  const char *mirrors, *url;
+  char *next = NULL;
+  size_t len = 0;
   int i;
 
+  mirrors = bgpstream_resource_get_attr(reader->res,
+                                        BGPSTREAM_RESOURCE_ATTR_MIRRORS);
+  if (mirrors == NULL) {
+    return 0;
+  }
+  // find the next mirror, skipping empty lines
+  for (i = 0, url = mirrors; *url != '\0'; url += len + (url[len] != '\0')) {
+    len = strcspn(url, "\n");
+    if (len != 0 && i++ == reader->url_idx) {
+      break;
+    }
+  }
+
+  if (*url == '\0') {
+    // every mirror has been tried
+    if (reader->first_url == NULL) {
+      return 0;
+    }
+    reader->url_idx = 0;
+    return bgpstream_resource_set_url(reader->res, reader->first_url);
+  }
+  if ((reader->first_url == NULL &&
+       (reader->first_url = strdup(reader->res->url)) == NULL) ||
+      (next = strndup(url, len)) == NULL ||
+      bgpstream_resource_set_url(reader->res, next) != 0) {
+    free(next);
+    return -1;
+  }
+  free(next);
+  reader->url_idx++;
+  return 1;
+}
+
+// opens the dump. returns 1 if the attempt failed and the job has been
+// scheduled to try again later, 0 otherwise
+static int open_dump(bgpstream_reader_t *reader)
+{
+  bgpstream_breaker_t *breaker = reader->res->breaker;
+  uint32_t wait;
+  int i, rc;
+
   /* all we do is open the dump */
-  /* but try a few times in case there is a transient failure */
-  while (retries < DUMP_OPEN_MAX_RETRIES && reader->format == NULL) {
-    if ((reader->format =
-           bgpstream_format_create(reader->res, reader->filter_mgr)) == NULL) {
-      bgpstream_log(BGPSTREAM_LOG_WARN, "Could not open (%s). Attempt %d of %d",
-                    reader->res->url, retries + 1, DUMP_OPEN_MAX_RETRIES);
-      retries++;
-      if (retries < DUMP_OPEN_MAX_RETRIES) {
-        sleep(delay);
-        delay *= 2;
+  /* but try a few times in case there is a transient failure, going through
+     the mirrors of the dump (if any) each time */
+  while (reader->format == NULL) {
+    // hosts that keep failing are not tried
+    if ((wait = bgpstream_breaker_check(breaker, reader->res->url)) == 0) {
+      reader->format = bgpstream_format_create(reader->res, reader->filter_mgr);
+      bgpstream_breaker_report(breaker, reader->res->url,
+                               reader->format != NULL);
+      if (reader->format != NULL) {
+        break;
       }
     }
+    bgpstream_log(BGPSTREAM_LOG_WARN, "Could not open (%s)%s",
+                  reader->res->url,
+                  wait != 0 ? ", its host is failing" : "");
+    if ((rc = next_url(reader)) < 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not fail over to another URL");
+      reader->open_retries = DUMP_OPEN_MAX_RETRIES;
+      break;
+    } else if (rc > 0) {
+      bgpstream_log(BGPSTREAM_LOG_INFO, "Trying mirror %s", reader->res->url);
+      continue;
+    }
+    // every URL has failed
+    reader->open_retries++;
+    bgpstream_log(BGPSTREAM_LOG_WARN, "Attempt %d of %d to open (%s) failed",
+                  reader->open_retries, DUMP_OPEN_MAX_RETRIES,
+                  reader->res->url);
+    break;
   }
 
   pthread_mutex_lock(&reader->mutex);
+  if (reader->format == NULL && reader->open_retries < DUMP_OPEN_MAX_RETRIES &&
+      reader->shutdown == 0) {
+    // rather than hold on to the worker while we wait, have the pool run the
+    // job again once the delay has passed (the job stays pending)
+    if (reader->open_delay == 0) {
+      reader->open_delay = DUMP_OPEN_MIN_RETRY_WAIT;
+    }
+    bgpstream_worker_pool_submit_delayed(reader->pool, &reader->job,
+                                         reader->open_delay * 1000);
+    reader->open_delay *= 2;
+    reader->open_retry_wait = 1;
+    pthread_cond_broadcast(&reader->dump_ready_cond);
+    pthread_mutex_unlock(&reader->mutex);
+    return 1;
+  }
   if (reader->format == NULL) {
     bgpstream_log(BGPSTREAM_LOG_ERR,
                   "Could not open dumpfile (%s) after %d attempts. Giving up.",
-                  reader->res->url, DUMP_OPEN_MAX_RETRIES);
+                  reader->res->url, reader->open_retries);
     reader->status = BGPSTREAM_FORMAT_CANT_OPEN_DUMP;
   } else {
-    // create the pair of records
-    for (i = 0; i < 2; i++) {
-      if ((reader->rec_buf[i] = bgpstream_record_create(reader->format)) ==
-            NULL ||
+    // create the ring of records
+    for (i = 0; i < RING_SIZE; i++) {
+      if ((reader->rec_buf[i] = bgpstream_record_pool_get(
+             reader->record_pool, reader->format)) == NULL ||
           prepopulate_record(reader->rec_buf[i], reader->res) != 0) {
         reader->status = BGPSTREAM_FORMAT_CANT_OPEN_DUMP;
         break;
       }
-      reader->rec_buf_filled[i] = 0;
     }
-    reader->rec_buf_prefetch_idx = 0;
+    reader->rec_buf_head = 0;
+    reader->rec_buf_cnt = 0;
+    reader->rec_buf_exported = 0;
     if (reader->status != BGPSTREAM_FORMAT_CANT_OPEN_DUMP) {
       // prefetch the first record (will set reader->status to error if needed)
       prefetch_record(reader);
@@ -202,14 +513,46 @@ static void *threaded_opener(void *user)
   reader->dump_ready = 1;
   pthread_cond_signal(&reader->dump_ready_cond);
   pthread_mutex_unlock(&reader->mutex);
+  return 0;
+}
+
+static void reader_job(void *user)
+{
+  bgpstream_reader_t *reader = (bgpstream_reader_t *)user;
+  int need_open;
+
+  // the first run of the job opens the resource (unless the reader was
+  // destroyed before we got to run)
+  pthread_mutex_lock(&reader->mutex);
+  need_open = (reader->dump_ready == 0 && reader->shutdown == 0);
+  reader->open_retry_wait = 0;
+  pthread_mutex_unlock(&reader->mutex);
+  if (need_open != 0 && open_dump(reader) != 0) {
+    // we will be run again when it is time to retry
+    return;
+  }
 
-  return NULL;
+  pthread_mutex_lock(&reader->mutex);
+  // keep decoding ahead of the consumer
+  if (reader->readahead > 0 && readahead_fill(reader) != 0 &&
+      reader->shutdown == 0 && reader->paused == 0) {
+    // the stream transport waits for data, so rather than wait for the consumer
+    // to poll us, go to the back of the queue and wait for more
+    bgpstream_worker_pool_submit(reader->pool, &reader->job);
+  } else {
+    reader->job_pending = 0;
+  }
+  pthread_cond_broadcast(&reader->rec_buf_cond);
+  pthread_mutex_unlock(&reader->mutex);
 }
 
 /* ========== PUBLIC FUNCTIONS BELOW ========== */
 
-bgpstream_reader_t *bgpstream_reader_create(bgpstream_resource_t *resource,
-                                            bgpstream_filter_mgr_t *filter_mgr)
+bgpstream_reader_t *
+bgpstream_reader_create(bgpstream_resource_t *resource,
+                        bgpstream_filter_mgr_t *filter_mgr,
+                        bgpstream_worker_pool_t *pool,
+                        bgpstream_record_pool_t *record_pool, int readahead)
 {
   bgpstream_reader_t *reader;
 
@@ -219,23 +562,101 @@ bgpstream_reader_t *bgpstream_reader_create(bgpstream_resource_t *resource,
 
   reader->res = resource;
   reader->filter_mgr = filter_mgr;
+  reader->pool = pool;
+  reader->record_pool = record_pool;
   reader->status = BGPSTREAM_FORMAT_OK;
+  reader->readahead = readahead > 0 ? readahead : 0;
+  reader->readahead_limit = reader->readahead;
+  reader->rec_buf_size = reader->readahead + 2;
 
-  // initialize and start the thread to open the resource
+  if ((reader->rec_buf = malloc_zero(sizeof(bgpstream_record_t *) *
+                                     RING_SIZE)) == NULL) {
+    free(reader);
+    return NULL;
+  }
+  bgpstream_mem_add(reader->res->mem, BGPSTREAM_MEM_READERS,
+                    READER_MEM(RING_SIZE));
+
+  // initialize and queue the job to open the resource
   // this will also pre-fetch the first record
   pthread_mutex_init(&reader->mutex, NULL);
   pthread_cond_init(&reader->dump_ready_cond, NULL);
+  pthread_cond_init(&reader->rec_buf_cond, NULL);
   reader->dump_ready = 0;
   reader->skip_dump_check = 0;
-  pthread_create(&reader->opener_thread, NULL, threaded_opener, reader);
+  reader->job.func = reader_job;
+  reader->job.user = reader;
+  pthread_mutex_lock(&reader->mutex);
+  schedule_job(reader);
+  pthread_mutex_unlock(&reader->mutex);
 
   return reader;
 }
 
+void bgpstream_reader_set_filter_mgr(bgpstream_reader_t *reader,
+                                     bgpstream_filter_mgr_t *filter_mgr)
+{
+  pthread_mutex_lock(&reader->mutex);
+  // wait for the job to stop using the current filters
+  reader->paused = 1;
+  while (reader->job_pending != 0) {
+    pthread_cond_wait(&reader->rec_buf_cond, &reader->mutex);
+  }
+  reader->filter_mgr = filter_mgr;
+  if (reader->format != NULL) {
+    bgpstream_format_set_filter_mgr(reader->format, filter_mgr);
+  }
+  reader->paused = 0;
+  schedule_readahead(reader);
+  pthread_mutex_unlock(&reader->mutex);
+}
+
+void bgpstream_reader_set_readahead_share(bgpstream_reader_t *reader,
+                                          int readahead, int grow)
+{
+  if (reader->readahead == 0) {
+    return;
+  }
+  if (readahead < 1) {
+    readahead = 1;
+  }
+
+  pthread_mutex_lock(&reader->mutex);
+  // the ring is only filled once the dump is open, and never shrinks
+  while (grow != 0 && reader->dump_ready != 0 &&
+         reader->status == BGPSTREAM_FORMAT_OK && RING_SIZE < readahead + 2) {
+    if (grow_ring(reader) != 0) {
+      // make do with the ring we have
+      break;
+    }
+  }
+  if (readahead > reader->readahead_limit) {
+    reader->readahead_limit = readahead;
+    schedule_readahead(reader);
+  } else {
+    reader->readahead_limit = readahead;
+  }
+  pthread_mutex_unlock(&reader->mutex);
+}
+
 uint32_t bgpstream_reader_get_next_time(bgpstream_reader_t *reader)
 {
+  uint32_t next_time;
+
   assert(bgpstream_reader_open_wait(reader) == 0);
-  return reader->next_time;
+
+  pthread_mutex_lock(&reader->mutex);
+  // wait for the worker to decode the next record we will export
+  while (!IS_STREAM && reader->rec_buf_cnt == 0 &&
+         reader->status == BGPSTREAM_FORMAT_OK) {
+    schedule_readahead(reader);
+    pthread_cond_wait(&reader->rec_buf_cond, &reader->mutex);
+  }
+  next_time = (reader->rec_buf_cnt > 0) ? reader->rec_buf[HEAD_IDX]->time_sec
+                                        : reader->next_time;
+  pthread_mutex_unlock(&reader->mutex);
+
+  return next_time;
 }
 
 void bgpstream_reader_destroy(bgpstream_reader_t *reader)
@@ -244,18 +665,39 @@ void bgpstream_reader_destroy(bgpstream_reader_t *reader)
     return;
   }
 
-  // Ensure the thread is done
-  pthread_join(reader->opener_thread, NULL);
+  // Ensure the job is done (a job waiting to retry the open is not worth
+  // waiting for)
+  pthread_mutex_lock(&reader->mutex);
+  reader->shutdown = 1;
+  if (reader->job_pending != 0 &&
+      bgpstream_worker_pool_cancel(reader->pool, &reader->job) != 0) {
+    reader->job_pending = 0;
+  }
+  while (reader->job_pending != 0) {
+    pthread_cond_wait(&reader->rec_buf_cond, &reader->mutex);
+  }
+  pthread_mutex_unlock(&reader->mutex);
   pthread_mutex_destroy(&reader->mutex);
   pthread_cond_destroy(&reader->dump_ready_cond);
+  pthread_cond_destroy(&reader->rec_buf_cond);
 
   int i;
-  for (i = 0; i < 2; i++) {
-    bgpstream_record_destroy(reader->rec_buf[i]);
+  // hand the records back while their format is still around (unless they are
+  // retained, in which case they keep the format alive themselves)
+  for (i = 0; i < RING_SIZE; i++) {
+    if (reader->rec_buf[i] != NULL &&
+        bgpstream_record_detach(reader->rec_buf[i]) == 0) {
+      bgpstream_record_pool_put(reader->record_pool, reader->rec_buf[i]);
+    }
     reader->rec_buf[i] = NULL;
   }
+  free(reader->rec_buf);
+  reader->rec_buf = NULL;
+  bgpstream_mem_add(reader->res->mem, BGPSTREAM_MEM_READERS,
+                    -(int64_t)READER_MEM(RING_SIZE));
 
   bgpstream_format_destroy(reader->format);
+  free(reader->first_url);
 
   free(reader);
 }
@@ -266,13 +708,22 @@ int bgpstream_reader_open_wait(bgpstream_reader_t *reader)
     return 0;
   }
 
+  bgpstream_perf_timer_t timer;
+  int cant_open;
+
   pthread_mutex_lock(&reader->mutex);
-  while (reader->dump_ready == 0) {
-    pthread_cond_wait(&reader->dump_ready_cond, &reader->mutex);
+  if (reader->dump_ready == 0) {
+    bgpstream_perf_start(reader->res->perf, &timer);
+    while (reader->dump_ready == 0) {
+      pthread_cond_wait(&reader->dump_ready_cond, &reader->mutex);
+    }
+    bgpstream_perf_stop(reader->res->perf, BGPSTREAM_PERF_STAGE_OPEN_WAIT,
+                        &timer);
   }
+  cant_open = (reader->status == BGPSTREAM_FORMAT_CANT_OPEN_DUMP);
   pthread_mutex_unlock(&reader->mutex);
 
-  if (reader->status == BGPSTREAM_FORMAT_CANT_OPEN_DUMP) {
+  if (cant_open) {
     return -1;
   }
 
@@ -280,48 +731,149 @@ int bgpstream_reader_open_wait(bgpstream_reader_t *reader)
   return 0;
 }
 
+int bgpstream_reader_open_attempt_wait(bgpstream_reader_t *reader)
+{
+  bgpstream_perf_timer_t timer;
+  int cant_open;
+
+  if (reader->skip_dump_check != 0) {
+    return 0;
+  }
+  pthread_mutex_lock(&reader->mutex);
+  if (reader->dump_ready == 0 && reader->open_retry_wait == 0) {
+    bgpstream_perf_start(reader->res->perf, &timer);
+    while (reader->dump_ready == 0 && reader->open_retry_wait == 0) {
+      pthread_cond_wait(&reader->dump_ready_cond, &reader->mutex);
+    }
+    bgpstream_perf_stop(reader->res->perf, BGPSTREAM_PERF_STAGE_OPEN_WAIT,
+                        &timer);
+  }
+  cant_open = (reader->status == BGPSTREAM_FORMAT_CANT_OPEN_DUMP);
+  pthread_mutex_unlock(&reader->mutex);
+
+  return cant_open ? -1 : 0;
+}
+
+int bgpstream_reader_open_done(bgpstream_reader_t *reader)
+{
+  int done;
+
+  if (reader->skip_dump_check != 0) {
+    return 1;
+  }
+
+  pthread_mutex_lock(&reader->mutex);
+  done = reader->dump_ready;
+  pthread_mutex_unlock(&reader->mutex);
+
+  return done;
+}
+
+int bgpstream_reader_ready(bgpstream_reader_t *reader)
+{
+  int ready;
+
+  if (reader->readahead == 0) {
+    return 1;
+  }
+
+  pthread_mutex_lock(&reader->mutex);
+  ready = reader->dump_ready != 0 &&
+          (head_exportable(reader) || reader->status != BGPSTREAM_FORMAT_OK);
+  // make sure the job is decoding (an idle stream needs to be polled again)
+  if (reader->dump_ready != 0 && ready == 0) {
+    schedule_readahead(reader);
+  }
+  pthread_mutex_unlock(&reader->mutex);
+
+  return ready;
+}
+
 int bgpstream_reader_get_next_record(bgpstream_reader_t *reader,
-                                     bgpstream_record_t **record)
+                                     bgpstream_record_t **record,
+                                     int keep_exported)
 {
+  bgpstream_reader_status_t rc;
+
   // DO NOT use the prefetch record before open_wait!
 
   if (bgpstream_reader_open_wait(reader) != 0) {
     // cant even open the dump file
     // we're not going to last long, but we should return the record saying
     // we're a failure
-    *record = reader->rec_buf[PREFETCH_IDX];
+    *record = reader->rec_buf[HEAD_IDX];
     (*record)->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_SOURCE;
     assert((*record)->__int->data == NULL);
     return BGPSTREAM_READER_STATUS_EOS;
   }
 
-  // mark the previous record as unfilled (about to become PREFETCH_IDX)
-  reader->rec_buf_filled[EXPORTED_IDX] = 0;
-  // the record contents will be cleared by the next prefetch
-
-  // flip-flop the buffers (EXPORTED will mean "about to export")
-  reader->rec_buf_prefetch_idx = EXPORTED_IDX;
+  if (reader->readahead == 0) {
+    // unless the user is still using them, the previous records can be re-used
+    // by the prefetch (their contents will be cleared by the prefetch)
+    if (keep_exported == 0 && reclaim_exported(reader) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not replace retained records");
+      return BGPSTREAM_READER_STATUS_ERROR;
+    }
+    if (reader->status == BGPSTREAM_FORMAT_OK &&
+        reader->rec_buf_cnt + reader->rec_buf_exported == RING_SIZE &&
+        grow_ring(reader) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not grow record ring");
+      return BGPSTREAM_READER_STATUS_ERROR;
+    }
 
-  // prefetch the next message (so we can see if the record we're about to
-  // export would be the last one)
-  if (reader->status == BGPSTREAM_FORMAT_OK && prefetch_record(reader) != 0) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Prefetch failed");
-    return BGPSTREAM_READER_STATUS_ERROR;
+    // prefetch the next message (so we can see if the record we're about to
+    // export would be the last one)
+    if (reader->status == BGPSTREAM_FORMAT_OK && prefetch_record(reader) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Prefetch failed");
+      return BGPSTREAM_READER_STATUS_ERROR;
+    }
+  } else {
+    pthread_mutex_lock(&reader->mutex);
+    // hand the previous records back to the job
+    if (keep_exported == 0 && reclaim_exported(reader) != 0) {
+      pthread_mutex_unlock(&reader->mutex);
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not replace retained records");
+      return BGPSTREAM_READER_STATUS_ERROR;
+    }
+    // if the user is holding on to every record the ring has room for, make
+    // room for the job to decode the one we need
+    if (reader->status == BGPSTREAM_FORMAT_OK && !head_exportable(reader) &&
+        reader->rec_buf_cnt + reader->rec_buf_exported == RING_SIZE &&
+        grow_ring(reader) != 0) {
+      pthread_mutex_unlock(&reader->mutex);
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not grow record ring");
+      return BGPSTREAM_READER_STATUS_ERROR;
+    }
+    schedule_readahead(reader);
+    // streams never block here, they return AGAIN instead
+    while (!IS_STREAM && !head_exportable(reader) &&
+           reader->status == BGPSTREAM_FORMAT_OK) {
+      schedule_readahead(reader);
+      pthread_cond_wait(&reader->rec_buf_cond, &reader->mutex);
+    }
   }
 
-  // if the EXPORT record is not filled then we need to return EOS or AGAIN
-  if (reader->rec_buf_filled[EXPORTED_IDX] == 0) {
-    if (reader->res->duration == BGPSTREAM_FOREVER &&
-        reader->status == BGPSTREAM_FORMAT_OK) {
-      return BGPSTREAM_READER_STATUS_AGAIN;
-    } else {
-      return BGPSTREAM_READER_STATUS_EOS;
+  // if there is nothing to export then we need to return EOS or AGAIN
+  if (head_exportable(reader) == 0) {
+    rc = (IS_STREAM && reader->status == BGPSTREAM_FORMAT_OK)
+           ? BGPSTREAM_READER_STATUS_AGAIN
+           : BGPSTREAM_READER_STATUS_EOS;
+    if (reader->readahead > 0) {
+      pthread_mutex_unlock(&reader->mutex);
     }
+    return rc;
   }
 
-  // we have something in our EXPORT record, so go ahead and copy that into the
-  // user's record
-  *record = reader->rec_buf[EXPORTED_IDX];
+  // we have something at the head of the ring, so go ahead and hand that to
+  // the user. it stays untouched until a call that doesn't keep it.
+  *record = reader->rec_buf[HEAD_IDX];
+  reader->rec_buf_head = (reader->rec_buf_head + 1) % RING_SIZE;
+  reader->rec_buf_cnt--;
+  reader->rec_buf_exported++;
+
+  if (reader->readahead > 0) {
+    pthread_mutex_unlock(&reader->mutex);
+  }
 
   return BGPSTREAM_READER_STATUS_OK;
 }
@@ -28,7 +28,9 @@
 #define __BGPSTREAM_READER_H
 
 #include "bgpstream_filter.h"
+#include "bgpstream_record_int.h"
 #include "bgpstream_resource.h"
+#include "bgpstream_worker_pool.h"
 
 /** Opaque structure representing a reader instance */
 typedef struct bgpstream_reader bgpstream_reader_t;
@@ -50,9 +52,50 @@ typedef enum {
 
 } bgpstream_reader_status_t;
 
-/** Create a new reader for the given resource */
-bgpstream_reader_t *bgpstream_reader_create(bgpstream_resource_t *resource,
-                                            bgpstream_filter_mgr_t *filter_mgr);
+/** Create a new reader for the given resource
+ *
+ * @param resource      pointer to the resource to read from
+ * @param filter_mgr    pointer to the filter manager to use
+ * @param pool          pointer to the worker pool that will open the resource
+ *                      (and decode records if read-ahead is enabled)
+ * @param record_pool   pointer to the pool to take records from and return
+ *                      them to (NULL to create and destroy them directly)
+ * @param readahead     number of records to decode in a background thread
+ *                      ahead of the consumer (0 to decode synchronously in
+ *                      bgpstream_reader_get_next_record)
+ * @return pointer to the reader created, NULL if an error occurred
+ */
+bgpstream_reader_t *
+bgpstream_reader_create(bgpstream_resource_t *resource,
+                        bgpstream_filter_mgr_t *filter_mgr,
+                        bgpstream_worker_pool_t *pool,
+                        bgpstream_record_pool_t *record_pool, int readahead);
+
+/** Switch the reader to another filter manager
+ *
+ * @param reader        pointer to a reader instance
+ * @param filter_mgr    pointer to the filter manager to use from now on
+ *
+ * Waits for a record being decoded in the background to be done, so that once
+ * this returns the previous filter manager is no longer used by the reader.
+ * Records already decoded are not filtered again, but their elems are checked
+ * against the new filters.
+ */
+void bgpstream_reader_set_filter_mgr(bgpstream_reader_t *reader,
+                                     bgpstream_filter_mgr_t *filter_mgr);
+
+/** Set how many records the reader decodes ahead of the consumer
+ *
+ * @param reader        pointer to a reader instance
+ * @param readahead     number of records to decode ahead (at least 1)
+ * @param grow          if non-zero, the ring of records may be grown to hold
+ *                      them, otherwise the share is capped by its current size
+ *
+ * Lets the resource manager give more read-ahead to the readers whose records
+ * will be needed first. Ignored if the reader was created without read-ahead.
+ */
+void bgpstream_reader_set_readahead_share(bgpstream_reader_t *reader,
+                                          int readahead, int grow);
 
 /** Get the time of the next record available in the reader
  *
@@ -64,6 +107,36 @@ uint32_t bgpstream_reader_get_next_time(bgpstream_reader_t *reader);
 /** Block until the resource has opened */
 int bgpstream_reader_open_wait(bgpstream_reader_t *reader);
 
+/** Block until the current attempt at opening the resource is over
+ *
+ * @param reader        pointer to a reader instance
+ * @return 0 if the resource has opened, or failed and is waiting to be tried
+ * again, -1 if it could not be opened at all
+ *
+ * Unlike bgpstream_reader_open_wait, this does not wait for the retries of a
+ * resource that failed to open, during which no connection is being made.
+ */
+int bgpstream_reader_open_attempt_wait(bgpstream_reader_t *reader);
+
+/** Check if the resource has opened (or failed to open) without blocking
+ *
+ * @param reader        pointer to a reader instance
+ * @return 1 if a call to bgpstream_reader_open_wait would not block, 0
+ * otherwise
+ */
+int bgpstream_reader_open_done(bgpstream_reader_t *reader);
+
+/** Check if the reader has a record (or EOS) ready to be returned
+ *
+ * @param reader        pointer to a reader instance
+ * @return 1 if a call to bgpstream_reader_get_next_record would not have to
+ * wait for the record to be decoded, 0 otherwise
+ *
+ * This always returns 1 if read-ahead is disabled, since the record is decoded
+ * by bgpstream_reader_get_next_record itself.
+ */
+int bgpstream_reader_ready(bgpstream_reader_t *reader);
+
 /** Destroy the given reader */
 void bgpstream_reader_destroy(bgpstream_reader_t *reader);
 
@@ -71,7 +144,11 @@ void bgpstream_reader_destroy(bgpstream_reader_t *reader);
  *
  * @param reader        pointer to a reader instance
  * @param[out] record   set to a borrowed pointer to a record if the return
- *                      code is >0
+ *                      code is >0. The record remains valid until the next
+ *                      call to this function with keep_exported set to 0.
+ * @param keep_exported if non-zero, records previously returned by this
+ *                      function remain valid (the ring of records grows if
+ *                      needed)
  * @return -1 if an unrecoverable error occurred, 0 if there are no further
  * records to be read (i.e. EOS has been reached), 1 if the record has not been
  * populated, but a future call yield data (only used by stream resource), and 2
@@ -80,6 +157,7 @@ void bgpstream_reader_destroy(bgpstream_reader_t *reader);
  */
 bgpstream_reader_status_t
 bgpstream_reader_get_next_record(bgpstream_reader_t *reader,
-                                 bgpstream_record_t **record);
+                                 bgpstream_record_t **record,
+                                 int keep_exported);
 
 #endif /* __BGPSTREAM_READER_H */
@@ -30,16 +30,70 @@
  */
 
 #include "bgpstream_record.h"
+#include "bgpstream_affinity.h"
+#include "bgpstream_dedup.h"
 #include "bgpstream_elem_int.h"
 #include "bgpstream_format_interface.h" // to access filter mgr
 #include "bgpstream_int.h"
 #include "bgpstream_log.h"
+#include "bgpstream_perf.h"
+#include "khash.h"
 #include "utils.h"
 #include <assert.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <regex.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+/* how many elems are checked between reorderings of the filter program */
+#define FILTER_REORDER_INTERVAL 4096
+
+/* add one to a filter statistic that other threads may be updating. a relaxed
+ * load and store is as cheap as a plain increment, but loses the odd count when
+ * threads race */
+#define STAT_INC(stat)                                                         \
+  __atomic_store_n(&(stat), __atomic_load_n(&(stat), __ATOMIC_RELAXED) + 1,    \
+                   __ATOMIC_RELAXED)
+
+/* how many rows elem columns first have room for (they double from there) */
+#define ELEM_COLUMNS_MIN 256
+
+/* interned names are stored in chunks that never move, so that they can be
+ * looked up by ID without taking the lock */
+#define NAME_CHUNK_BITS 10
+#define NAME_CHUNK_SIZE (1 << NAME_CHUNK_BITS)
+#define NAME_CHUNKS_MAX 1024
+
+KHASH_INIT(name_ids, char *, bgpstream_name_id_t, 1, kh_str_hash_func,
+           kh_str_hash_equal)
+
+/* the names interned by every stream of the process. ID 0 is the empty
+ * string, which is never stored. */
+static struct {
+  pthread_rwlock_t lock;
+  khash_t(name_ids) * ids;
+  char **chunks[NAME_CHUNKS_MAX];
+  uint32_t cnt;
+} names = {PTHREAD_RWLOCK_INITIALIZER, NULL, {NULL}, 1};
+
+/* the records that are not in use, for each format type. the data of a record
+ * was created by a format instance that may be gone by the time it is reused
+ * (or destroyed), which is fine since the data of a format type does not
+ * depend on the instance. records are only reused on the NUMA node they were
+ * allocated on, so that the worker filling a record has it in local memory. */
+struct bgpstream_record_pool {
+  pthread_mutex_t mutex;
+  int max_records;
+  struct {
+    // records of each node (allocated when the first one is put back)
+    bgpstream_record_t **records[BGPSTREAM_AFFINITY_MAX_NODES];
+    int cnt[BGPSTREAM_AFFINITY_MAX_NODES];
+    // how the data of these records is destroyed
+    void (*destroy_data)(bgpstream_format_t *format, void *data);
+  } types[_BGPSTREAM_RESOURCE_FORMAT_TYPE_CNT];
+};
 
 bgpstream_record_t *bgpstream_record_create(bgpstream_format_t *format)
 {
@@ -54,11 +108,85 @@ bgpstream_record_t *bgpstream_record_create(bgpstream_format_t *format)
   }
 
   record->__int->format = format;
+  record->__int->refcnt = 1;
+  record->__int->node = bgpstream_affinity_get_node();
   bgpstream_format_init_data(record);
 
   return record;
 }
 
+int bgpstream_record_intern_name(const char *name, bgpstream_name_id_t *id)
+{
+  char ***chunk;
+  char *cpy;
+  khiter_t k;
+  int khret;
+
+  if (name[0] == '\0') {
+    *id = 0;
+    return 0;
+  }
+
+  // most names have been seen before
+  pthread_rwlock_rdlock(&names.lock);
+  if (names.ids != NULL &&
+      (k = kh_get(name_ids, names.ids, (char *)name)) != kh_end(names.ids)) {
+    *id = kh_val(names.ids, k);
+    pthread_rwlock_unlock(&names.lock);
+    return 0;
+  }
+  pthread_rwlock_unlock(&names.lock);
+
+  pthread_rwlock_wrlock(&names.lock);
+  if (names.ids == NULL && (names.ids = kh_init(name_ids)) == NULL) {
+    goto err;
+  }
+  // another thread may have added it in the meantime
+  if ((k = kh_get(name_ids, names.ids, (char *)name)) != kh_end(names.ids)) {
+    *id = kh_val(names.ids, k);
+    pthread_rwlock_unlock(&names.lock);
+    return 0;
+  }
+  if ((names.cnt >> NAME_CHUNK_BITS) >= NAME_CHUNKS_MAX) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Too many names to intern '%s'", name);
+    goto err;
+  }
+  chunk = &names.chunks[names.cnt >> NAME_CHUNK_BITS];
+  if (*chunk == NULL &&
+      (*chunk = malloc(sizeof(char *) * NAME_CHUNK_SIZE)) == NULL) {
+    goto err;
+  }
+  if ((cpy = strdup(name)) == NULL) {
+    goto err;
+  }
+  k = kh_put(name_ids, names.ids, cpy, &khret);
+  if (khret < 0) {
+    free(cpy);
+    goto err;
+  }
+  *id = kh_val(names.ids, k) = names.cnt;
+  (*chunk)[names.cnt & (NAME_CHUNK_SIZE - 1)] = cpy;
+  // the name must be in place before lookups can see its ID
+  __atomic_store_n(&names.cnt, names.cnt + 1, __ATOMIC_RELEASE);
+  pthread_rwlock_unlock(&names.lock);
+  return 0;
+
+err:
+  pthread_rwlock_unlock(&names.lock);
+  return -1;
+}
+
+const char *bgpstream_record_get_name(bgpstream_name_id_t id)
+{
+  if (id == 0) {
+    return "";
+  }
+  if (id >= __atomic_load_n(&names.cnt, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+  return names.chunks[id >> NAME_CHUNK_BITS][id & (NAME_CHUNK_SIZE - 1)];
+}
+
 void bgpstream_record_destroy(bgpstream_record_t *record)
 {
   if (record == NULL) {
@@ -67,10 +195,164 @@ void bgpstream_record_destroy(bgpstream_record_t *record)
 
   bgpstream_format_destroy_data(record);
 
+  if (record->__int != NULL) {
+    free(record->__int->raw);
+    bgpstream_record_raw_prefix_release(record->__int->raw_prefix);
+  }
   free(record->__int);
   free(record);
 }
 
+bgpstream_record_pool_t *bgpstream_record_pool_create(int max_records)
+{
+  bgpstream_record_pool_t *pool;
+
+  if ((pool = malloc_zero(sizeof(bgpstream_record_pool_t))) == NULL) {
+    return NULL;
+  }
+  pthread_mutex_init(&pool->mutex, NULL);
+  pool->max_records = max_records;
+  return pool;
+}
+
+bgpstream_record_t *bgpstream_record_pool_get(bgpstream_record_pool_t *pool,
+                                              bgpstream_format_t *format)
+{
+  bgpstream_record_t *record = NULL;
+  int type, node, cnt;
+
+  if (pool != NULL) {
+    type = format->res->format_type;
+    node = bgpstream_affinity_get_node();
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->types[type].cnt[node] > 0) {
+      cnt = --pool->types[type].cnt[node];
+      record = pool->types[type].records[node][cnt];
+    }
+    pthread_mutex_unlock(&pool->mutex);
+  }
+  if (record != NULL) {
+    // the pool may be shared by several streams, so its records are only
+    // accounted to the stream using them
+    bgpstream_format_account_data(format, 1);
+  } else if ((record = bgpstream_record_create(format)) == NULL) {
+    return NULL;
+  }
+  record->__int->format = format;
+  record->__int->refcnt = 1;
+  record->__int->pool = pool;
+  return record;
+}
+
+void bgpstream_record_pool_put(bgpstream_record_pool_t *pool,
+                               bgpstream_record_t *record)
+{
+  bgpstream_format_t *format;
+  bgpstream_record_t ***records;
+  int type, node, kept = 0;
+
+  if (record == NULL) {
+    return;
+  }
+  if (pool == NULL || (format = record->__int->format) == NULL) {
+    bgpstream_record_destroy(record);
+    return;
+  }
+
+  // detach the (cleared) record from its format, which is about to go
+  bgpstream_record_clear(record);
+  type = format->res->format_type;
+  node = record->__int->node;
+  records = &pool->types[type].records[node];
+
+  pthread_mutex_lock(&pool->mutex);
+  if (*records == NULL) {
+    *records = malloc(sizeof(bgpstream_record_t *) * pool->max_records);
+  }
+  if (*records != NULL && pool->types[type].cnt[node] < pool->max_records) {
+    pool->types[type].destroy_data = format->destroy_data;
+    record->__int->format = NULL;
+    (*records)[pool->types[type].cnt[node]++] = record;
+    kept = 1;
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  if (kept == 0) {
+    bgpstream_record_destroy(record);
+  } else {
+    bgpstream_format_account_data(format, -1);
+  }
+}
+
+int bgpstream_record_detach(bgpstream_record_t *record)
+{
+  bgpstream_format_t *format = record->__int->format;
+
+  // only the reader can retain a record that it alone holds, so there is
+  // nothing to race with
+  if (__atomic_load_n(&record->__int->refcnt, __ATOMIC_ACQUIRE) == 1) {
+    return 0;
+  }
+
+  // the holders may release the record as soon as we let go of it, so the
+  // format they need must be kept first
+  bgpstream_format_retain(format);
+  if (__atomic_sub_fetch(&record->__int->refcnt, 1, __ATOMIC_ACQ_REL) != 0) {
+    return 1;
+  }
+
+  // every holder released it in the meantime
+  record->__int->refcnt = 1;
+  bgpstream_format_destroy(format);
+  return 0;
+}
+
+bgpstream_record_t *bgpstream_record_retain(bgpstream_record_t *record)
+{
+  __atomic_add_fetch(&record->__int->refcnt, 1, __ATOMIC_RELAXED);
+  return record;
+}
+
+void bgpstream_record_release(bgpstream_record_t *record)
+{
+  bgpstream_format_t *format;
+
+  if (record == NULL) {
+    return;
+  }
+  format = record->__int->format;
+  if (__atomic_sub_fetch(&record->__int->refcnt, 1, __ATOMIC_ACQ_REL) != 0) {
+    return;
+  }
+
+  // the reader detached the record, and it was the last holder
+  bgpstream_record_pool_put(record->__int->pool, record);
+  bgpstream_format_destroy(format);
+}
+
+void bgpstream_record_pool_destroy(bgpstream_record_pool_t *pool)
+{
+  bgpstream_record_t *record;
+  int i, j, node;
+
+  if (pool == NULL) {
+    return;
+  }
+  for (i = 0; i < _BGPSTREAM_RESOURCE_FORMAT_TYPE_CNT; i++) {
+    for (node = 0; node < BGPSTREAM_AFFINITY_MAX_NODES; node++) {
+      for (j = 0; j < pool->types[i].cnt[node]; j++) {
+        record = pool->types[i].records[node][j];
+        pool->types[i].destroy_data(NULL, record->__int->data);
+        record->__int->data = NULL;
+        bgpstream_record_destroy(record);
+      }
+      free(pool->types[i].records[node]);
+    }
+  }
+  pthread_mutex_destroy(&pool->mutex);
+  free(pool);
+}
+
 /* NOTE: this function deliberately does not reset many of the fields in a
    record, since in the v2 implementation of BGPStream records are specific to a
    reader and thus these fields can be reused between reads. */
@@ -81,196 +363,388 @@ void bgpstream_record_clear(bgpstream_record_t *record)
   // reset the record timestamps
   record->time_sec = 0;
   record->time_usec = 0;
+
+  // forget the raw bytes (but keep the buffer)
+  record->__int->raw_len = 0;
+  bgpstream_record_raw_prefix_release(record->__int->raw_prefix);
+  record->__int->raw_prefix = NULL;
+
+  record->__int->position = 0;
+  record->__int->elem_filter_sets = 0;
 }
 
-static bgpstream_patricia_walk_cb_result_t pfx_exists(
-    const bgpstream_patricia_tree_t *pt, const bgpstream_patricia_node_t *node,
-    void *data)
+int bgpstream_record_set_raw(bgpstream_record_t *record, const uint8_t *raw,
+                             size_t len)
 {
-  *(int*)data = 1;
-  return BGPSTREAM_PATRICIA_WALK_END_ALL;
+  bgpstream_record_internal_t *ri = record->__int;
+  uint8_t *tmp;
+
+  if (len > ri->raw_alloc) {
+    if ((tmp = realloc(ri->raw, len)) == NULL) {
+      return -1;
+    }
+    ri->raw = tmp;
+    ri->raw_alloc = len;
+  }
+  memcpy(ri->raw, raw, len);
+  ri->raw_len = len;
+  return 0;
 }
 
-static bgpstream_patricia_walk_cb_result_t pfx_allows_more_specifics(
-    const bgpstream_patricia_tree_t *pt, const bgpstream_patricia_node_t *node,
-    void *data)
+bgpstream_record_raw_prefix_t *
+bgpstream_record_raw_prefix_create(const uint8_t *raw, size_t len, uint64_t id)
 {
-  const bgpstream_pfx_t *pfx = bgpstream_patricia_tree_get_pfx(node);
-  if (pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_ANY ||
-      pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_MORE) {
-    *(int*)data = 1;
-    return BGPSTREAM_PATRICIA_WALK_END_ALL;
+  bgpstream_record_raw_prefix_t *prefix;
+
+  if ((prefix = malloc(sizeof(bgpstream_record_raw_prefix_t) + len)) == NULL) {
+    return NULL;
   }
-  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+  prefix->refcnt = 1;
+  prefix->id = id;
+  prefix->len = len;
+  memcpy(prefix->data, raw, len);
+  return prefix;
 }
 
-static bgpstream_patricia_walk_cb_result_t pfx_allows_less_specifics(
-    const bgpstream_patricia_tree_t *pt, const bgpstream_patricia_node_t *node,
-    void *data)
+void bgpstream_record_raw_prefix_release(bgpstream_record_raw_prefix_t *prefix)
 {
-  const bgpstream_pfx_t *pfx = bgpstream_patricia_tree_get_pfx(node);
-  if (pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_ANY ||
-      pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_LESS) {
-    *(int*)data = 1;
-    return BGPSTREAM_PATRICIA_WALK_END_ALL;
+  if (prefix == NULL) {
+    return;
+  }
+  // records may be released by the consumer while the format creates more
+  if (__atomic_sub_fetch(&prefix->refcnt, 1, __ATOMIC_ACQ_REL) == 0) {
+    free(prefix);
   }
-  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
 }
 
-static int bgpstream_elem_prefix_match(bgpstream_patricia_tree_t *prefixes,
-                                       bgpstream_pfx_t *search)
+void bgpstream_record_set_raw_prefix(bgpstream_record_t *record,
+                                     bgpstream_record_raw_prefix_t *prefix)
 {
-  int matched = 0;
+  __atomic_add_fetch(&prefix->refcnt, 1, __ATOMIC_RELAXED);
+  bgpstream_record_raw_prefix_release(record->__int->raw_prefix);
+  record->__int->raw_prefix = prefix;
+}
 
-  bgpstream_patricia_tree_walk_up_down(prefixes, search, pfx_exists,
-      pfx_allows_more_specifics, pfx_allows_less_specifics, &matched);
-  return matched;
+size_t bgpstream_record_get_raw(const bgpstream_record_t *record,
+                                const uint8_t **raw)
+{
+  *raw = record->__int->raw;
+  return record->__int->raw_len;
 }
 
-static int elem_check_filters(bgpstream_record_t *record,
-                              bgpstream_elem_t *elem)
+int bgpstream_record_ack(bgpstream_record_t *record)
 {
-  bgpstream_filter_mgr_t *filter_mgr = record->__int->format->filter_mgr;
+  if (record->__int->format == NULL || record->__int->position == 0) {
+    return 0;
+  }
+  return bgpstream_transport_checkpoint(record->__int->format->transport,
+                                        record->__int->position);
+}
 
-  /* First up, check if this element is the right type */
-  if (filter_mgr->elemtype_mask) {
+// for each filter mask in use, either probe its index with each community of
+// the elem, or look up each of its communities in the (sorted) elem set,
+// whichever takes fewer lookups
+static int community_filter_match(const bgpstream_community_filter_t *cf,
+                                  bgpstream_community_set_t *comms)
+{
+  const bgpstream_community_t *c;
+  const bgpstream_large_community_t *lc;
+  bgpstream_community_t key;
+  bgpstream_large_community_t lkey;
+  int cnt = bgpstream_community_set_size(comms);
+  int i, mask;
+  khiter_t k;
+
+  // "*:*" and "*:*:*" match any community at all
+  if ((cf->comms[0] != NULL && cnt > 0) ||
+      (cf->large[0] != NULL && bgpstream_community_set_large_size(comms) > 0)) {
+    return 1;
+  }
 
-    if (elem->type == BGPSTREAM_ELEM_TYPE_PEERSTATE &&
-        !(filter_mgr->elemtype_mask & BGPSTREAM_FILTER_ELEM_TYPE_PEERSTATE)) {
-      return 0;
-    }
+  // if the index cannot be built, the set is simply scanned
+  bgpstream_community_set_index(comms);
 
-    if (elem->type == BGPSTREAM_ELEM_TYPE_RIB &&
-        !(filter_mgr->elemtype_mask & BGPSTREAM_FILTER_ELEM_TYPE_RIB)) {
-      return 0;
+  for (mask = 1; mask <= BGPSTREAM_COMMUNITY_FILTER_EXACT; mask++) {
+    if (cf->comms[mask] == NULL) {
+      continue;
     }
-
-    if (elem->type == BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT &&
-        !(filter_mgr->elemtype_mask &
-          BGPSTREAM_FILTER_ELEM_TYPE_ANNOUNCEMENT)) {
-      return 0;
+    if ((mask & BGPSTREAM_COMMUNITY_FILTER_ASN) &&
+        kh_size(cf->comms[mask]) < (khint_t)cnt) {
+      for (k = kh_begin(cf->comms[mask]); k != kh_end(cf->comms[mask]); k++) {
+        if (!kh_exist(cf->comms[mask], k)) {
+          continue;
+        }
+        key.ui32 = kh_key(cf->comms[mask], k);
+        if (bgpstream_community_set_match(comms, &key, mask)) {
+          return 1;
+        }
+      }
+      continue;
     }
-
-    if (elem->type == BGPSTREAM_ELEM_TYPE_WITHDRAWAL &&
-        !(filter_mgr->elemtype_mask & BGPSTREAM_FILTER_ELEM_TYPE_WITHDRAWAL)) {
-      return 0;
+    for (i = 0; i < cnt; i++) {
+      c = bgpstream_community_set_get(comms, i);
+      key.ui32 = 0;
+      if (mask & BGPSTREAM_COMMUNITY_FILTER_ASN) {
+        key.asn = c->asn;
+      }
+      if (mask & BGPSTREAM_COMMUNITY_FILTER_VALUE) {
+        key.value = c->value;
+      }
+      if (kh_get(bgpstream_community_idx, cf->comms[mask], key.ui32) !=
+          kh_end(cf->comms[mask])) {
+        return 1;
+      }
     }
+  }
 
-    if (elem->type == BGPSTREAM_ELEM_TYPE_END_OF_RIB &&
-        !(filter_mgr->elemtype_mask & BGPSTREAM_FILTER_ELEM_TYPE_END_OF_RIB)) {
-      return 0;
+  for (i = 0; i < bgpstream_community_set_large_size(comms); i++) {
+    lc = bgpstream_community_set_get_large(comms, i);
+    for (mask = 1; mask <= BGPSTREAM_LARGE_COMMUNITY_FILTER_EXACT; mask++) {
+      if (cf->large[mask] == NULL) {
+        continue;
+      }
+      lkey.global_admin =
+        (mask & BGPSTREAM_LARGE_COMMUNITY_FILTER_GLOBAL) ? lc->global_admin : 0;
+      lkey.local_1 =
+        (mask & BGPSTREAM_LARGE_COMMUNITY_FILTER_LOCAL1) ? lc->local_1 : 0;
+      lkey.local_2 =
+        (mask & BGPSTREAM_LARGE_COMMUNITY_FILTER_LOCAL2) ? lc->local_2 : 0;
+      if (kh_get(bgpstream_large_community_idx, cf->large[mask], lkey) !=
+          kh_end(cf->large[mask])) {
+        return 1;
+      }
     }
   }
 
-  /* Checking peer ASNs: if the filter is on and the peer asn is not in the
-   * set, return 0 */
-  if (filter_mgr->peer_asns &&
-      bgpstream_id_set_exists(filter_mgr->peer_asns, elem->peer_asn) == 0) {
-    return 0;
-  }
+  return 0;
+}
 
-  /* Checking not peer ASNs: if the filter is on and the peer asn is in the
-  * set, return 0 */
-  if (filter_mgr->not_peer_asns &&
-      bgpstream_id_set_exists(filter_mgr->not_peer_asns, elem->peer_asn) == 1) {
-    return 0;
-  }
+/* run a single check of the filter program, returning 0 if the elem is
+ * rejected */
+static int elem_run_op(bgpstream_filter_mgr_t *filter_mgr,
+                       bgpstream_filter_op_type_t op, bgpstream_elem_t *elem)
+{
+  bgpstream_as_path_t *path;
 
-  /* Checking origin ASN */
-  if (filter_mgr->origin_asns) {
-    if (elem->type == BGPSTREAM_ELEM_TYPE_WITHDRAWAL ||
-        elem->type == BGPSTREAM_ELEM_TYPE_PEERSTATE) {
-      return 0;
-    }
+  switch (op) {
+  case BGPSTREAM_FILTER_OP_IPVERSION:
+    return elem->prefix.address.version == filter_mgr->ipversion;
+
+  case BGPSTREAM_FILTER_OP_PEER_ASN:
+    return bgpstream_id_set_exists(filter_mgr->peer_asns, elem->peer_asn);
+
+  case BGPSTREAM_FILTER_OP_NOT_PEER_ASN:
+    return bgpstream_id_set_exists(filter_mgr->not_peer_asns,
+                                   elem->peer_asn) == 0;
+
+  case BGPSTREAM_FILTER_OP_ORIGIN_ASN: {
     uint32_t origin_asn;
 
-    if (bgpstream_as_path_get_origin_val(elem->as_path, &origin_asn) < 0) {
+    if ((path = bgpstream_elem_get_as_path(elem)) == NULL ||
+        bgpstream_as_path_get_origin_val(path, &origin_asn) < 0) {
       return 0;
     }
+    return bgpstream_id_set_exists(filter_mgr->origin_asns, origin_asn);
+  }
+
+  case BGPSTREAM_FILTER_OP_PREFIX:
+    return bgpstream_filter_mgr_prefix_match(filter_mgr, &elem->prefix);
 
-    if (bgpstream_id_set_exists(filter_mgr->origin_asns, origin_asn) == 0) {
+  case BGPSTREAM_FILTER_OP_COMMUNITY: {
+    bgpstream_community_set_t *comms;
+
+    if ((comms = bgpstream_elem_get_communities(elem)) == NULL) {
       return 0;
     }
+    return community_filter_match(filter_mgr->communities, comms);
   }
 
-  if (filter_mgr->ipversion) {
-    /* Determine address version for the element prefix */
+  case BGPSTREAM_FILTER_OP_ASPATH: {
+    bgpstream_aspath_expr_t *expr;
+    uint32_t asns[BGPSTREAM_AS_PATH_MATCH_MAX_ASNS];
+    int asns_cnt = -1;
+    char aspath[65536];
+    int pathlen = -1;
+    int result;
 
-    if (elem->type == BGPSTREAM_ELEM_TYPE_PEERSTATE) {
+    if ((path = bgpstream_elem_get_as_path(elem)) == NULL) {
       return 0;
     }
 
-    if (elem->prefix.address.version != filter_mgr->ipversion)
-      return 0;
+    for (int i = 0; i < filter_mgr->aspath_expr_cnt; i++) {
+      expr = &filter_mgr->aspath_exprs[i];
+      // the path is only turned into ASNs, or a string, once it is needed
+      if (expr->match != NULL && asns_cnt == -1) {
+        asns_cnt = bgpstream_as_path_match_get_asns(path, asns, ARR_CNT(asns));
+      }
+      if (expr->match != NULL && asns_cnt >= 0) {
+        result = bgpstream_as_path_match_exec(expr->match, asns, asns_cnt);
+      } else {
+        if (pathlen == -1 &&
+            (pathlen = bgpstream_as_path_snprintf(aspath, sizeof(aspath),
+                                                  path)) >= sizeof(aspath)) {
+          bgpstream_log(BGPSTREAM_LOG_WARN,
+                        "AS Path is too long? Filter may not work well.");
+        }
+        result = regexec(expr->re, aspath, 0, NULL, 0) == 0;
+      }
+      // All aspath expressions must match
+      if (result != (expr->negate == 0)) {
+        return 0;
+      }
+    }
+    return 1;
   }
 
-  if (filter_mgr->prefixes) {
-    if (elem->type == BGPSTREAM_ELEM_TYPE_PEERSTATE) {
-      return 0;
+  case BGPSTREAM_FILTER_OP_SAMPLE:
+    if (filter_mgr->sample_key == BGPSTREAM_SAMPLE_KEY_PREFIX) {
+      return bgpstream_filter_mgr_sample_pfx(filter_mgr, &elem->prefix);
     }
-    if (bgpstream_elem_prefix_match(filter_mgr->prefixes, &elem->prefix) == 0)
-      return 0;
+    return bgpstream_filter_mgr_sample_peer(filter_mgr, elem->peer_asn);
+
+  default:
+    assert(0);
+    return 1;
   }
+}
 
-  /* Checking AS Path expressions */
-  if (filter_mgr->aspath_exprs) {
-    char aspath[65536];
-    int pathlen;
+/* is op a better first check than other? (i.e., does it reject more elems
+ * for its cost) */
+static int op_before(const bgpstream_filter_op_t *op,
+                     const bgpstream_filter_op_t *other)
+{
+  // the estimated rejection rate starts at 1/2 for checks that have not run
+  return (uint64_t)(op->rejects + 1) * (other->runs + 2) * other->cost >
+         (uint64_t)(other->rejects + 1) * (op->runs + 2) * op->cost;
+}
 
-    if (elem->type == BGPSTREAM_ELEM_TYPE_WITHDRAWAL ||
-        elem->type == BGPSTREAM_ELEM_TYPE_PEERSTATE) {
-      return 0;
+/* sort the checks by how worthwhile they have been lately */
+static void prog_reorder(bgpstream_filter_prog_t *prog)
+{
+  bgpstream_filter_op_t ops[BGPSTREAM_FILTER_OP_CNT];
+  int idx[BGPSTREAM_FILTER_OP_CNT];
+  uint32_t order = __atomic_load_n(&prog->order, __ATOMIC_RELAXED);
+  int i, j, tmp;
+
+  // sort a snapshot of the statistics, starting from the current order
+  for (i = 0; i < prog->ops_cnt; i++) {
+    ops[i].type = prog->ops[i].type;
+    ops[i].cost = prog->ops[i].cost;
+    ops[i].runs = __atomic_load_n(&prog->ops[i].runs, __ATOMIC_RELAXED);
+    ops[i].rejects = __atomic_load_n(&prog->ops[i].rejects, __ATOMIC_RELAXED);
+    idx[i] = (order >> (i * BGPSTREAM_FILTER_ORDER_BITS)) &
+             BGPSTREAM_FILTER_ORDER_MASK;
+  }
+  for (i = 1; i < prog->ops_cnt; i++) {
+    tmp = idx[i];
+    for (j = i; j > 0 && op_before(&ops[tmp], &ops[idx[j - 1]]); j--) {
+      idx[j] = idx[j - 1];
     }
+    idx[j] = tmp;
+  }
+  order = 0;
+  for (i = 0; i < prog->ops_cnt; i++) {
+    order |= (uint32_t)idx[i] << (i * BGPSTREAM_FILTER_ORDER_BITS);
+  }
+  __atomic_store_n(&prog->order, order, __ATOMIC_RELAXED);
 
-    pathlen = bgpstream_as_path_snprintf(aspath, sizeof(aspath), elem->as_path);
+  // let the statistics follow changes in the data
+  for (i = 0; i < prog->ops_cnt; i++) {
+    __atomic_store_n(&prog->ops[i].runs, ops[i].runs / 2, __ATOMIC_RELAXED);
+    __atomic_store_n(&prog->ops[i].rejects, ops[i].rejects / 2,
+                     __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&prog->checked, 0, __ATOMIC_RELAXED);
+}
 
-    if (pathlen >= sizeof(aspath)) {
-      bgpstream_log(BGPSTREAM_LOG_WARN,
-                    "AS Path is too long? Filter may not work well.");
-    }
+static int elem_check_filters(bgpstream_filter_mgr_t *filter_mgr,
+                              bgpstream_elem_t *elem)
+{
+  bgpstream_filter_prog_t *prog = &filter_mgr->elem_prog;
+  bgpstream_filter_op_t *op;
+  uint32_t order, checked;
+  int pass = 1;
+  int i;
 
-    for (int i = 0; i < filter_mgr->aspath_expr_cnt; i++) {
-      int result = regexec(filter_mgr->aspath_exprs[i].re, aspath, 0, NULL, 0);
-      // All aspath regexes must match
-      if ((result == 0) != (filter_mgr->aspath_exprs[i].negate == 0)) {
-        return 0;
-      }
-    }
+  STAT_INC(prog->elems);
+
+  /* First up, check if this element is of a type that can pass */
+  if ((prog->elem_types & (1 << elem->type)) == 0) {
+    STAT_INC(prog->type_rejects);
+    return 0;
   }
 
-  /* Checking communities (unless it is a withdrawal message) */
-  if (filter_mgr->communities) {
-    int pass = 0;
-    if (elem->type == BGPSTREAM_ELEM_TYPE_WITHDRAWAL ||
-        elem->type == BGPSTREAM_ELEM_TYPE_PEERSTATE) {
-      return 0;
+  order = __atomic_load_n(&prog->order, __ATOMIC_RELAXED);
+  for (i = 0; i < prog->ops_cnt; i++) {
+    op = &prog->ops[order & BGPSTREAM_FILTER_ORDER_MASK];
+    order >>= BGPSTREAM_FILTER_ORDER_BITS;
+    STAT_INC(op->runs);
+    STAT_INC(prog->op_runs[op->type]);
+    if (elem_run_op(filter_mgr, op->type, elem) == 0) {
+      STAT_INC(op->rejects);
+      STAT_INC(prog->op_rejects[op->type]);
+      pass = 0;
+      break;
     }
+  }
 
-    bgpstream_community_t *c;
-    khiter_t k;
-    for (k = kh_begin(filter_mgr->communities);
-         k != kh_end(filter_mgr->communities); ++k) {
-      if (kh_exist(filter_mgr->communities, k)) {
-        c = &(kh_key(filter_mgr->communities, k));
-        if (bgpstream_community_set_match(
-              elem->communities, c, kh_value(filter_mgr->communities, k))) {
-          pass = 1;
-          break;
-        }
-      }
+  if (prog->ops_cnt > 1) {
+    checked = __atomic_load_n(&prog->checked, __ATOMIC_RELAXED) + 1;
+    if (checked >= FILTER_REORDER_INTERVAL) {
+      prog_reorder(prog);
+    } else {
+      __atomic_store_n(&prog->checked, checked, __ATOMIC_RELAXED);
     }
-    if (pass == 0) {
-      return 0;
+  }
+  return pass;
+}
+
+/* returns the filter sets that an elem that passed the filters of the stream
+ * passes */
+static uint64_t elem_check_sets(bgpstream_filter_mgr_t *filter_mgr,
+                                bgpstream_elem_t *elem)
+{
+  uint64_t sets = 0;
+  int i;
+
+  for (i = 0; i < filter_mgr->sets_cnt; i++) {
+    if (elem_check_filters(filter_mgr->sets[i], elem) != 0) {
+      sets |= (uint64_t)1 << i;
     }
   }
+  return sets;
+}
 
+/* returns 1 if the elem passes the filters of the stream (and, if there are
+ * any, at least one filter set, whose bitmap is saved in the record), and is
+ * not a duplicate */
+static inline int elem_passes(bgpstream_filter_mgr_t *filter_mgr,
+                              bgpstream_record_t *record,
+                              bgpstream_elem_t *elem)
+{
+  if (elem_check_filters(filter_mgr, elem) == 0) {
+    return 0;
+  }
+  if (filter_mgr->sets_cnt != 0 &&
+      (record->__int->elem_filter_sets = elem_check_sets(filter_mgr, elem)) ==
+        0) {
+    return 0;
+  }
+  // only elems that pass the filters are remembered
+  if (filter_mgr->dedup != NULL &&
+      bgpstream_dedup_check(filter_mgr->dedup, record->time_sec, elem) != 0) {
+    return 0;
+  }
   return 1;
 }
 
 int bgpstream_record_get_next_elem(bgpstream_record_t *record,
                                    bgpstream_elem_t **elemp)
 {
-  int rc;
+  int rc = 1;
+  bgpstream_filter_mgr_t *filter_mgr;
+  bgpstream_perf_t *perf;
+  bgpstream_perf_timer_t timer;
   bgpstream_elem_t *elem = NULL;
   *elemp = NULL;
 
@@ -280,20 +754,226 @@ int bgpstream_record_get_next_elem(bgpstream_record_t *record,
     return 0; // treat as end-of-elems
   }
 
+  filter_mgr = record->__int->format->filter_mgr;
+  perf = record->__int->format->res->perf;
+  record->__int->elem_filter_sets = 0;
+
+  bgpstream_perf_start(perf, &timer);
   while (elem == NULL) {
     if ((rc = bgpstream_format_get_next_elem(record->__int->format, record,
                                              &elem)) <= 0) {
       // either error or end-of-elems
-      return rc;
+      break;
     }
 
-    if (elem_check_filters(record, elem) == 0) {
+    if (elem_passes(filter_mgr, record, elem) == 0) {
       elem = NULL;
     }
   }
+  bgpstream_perf_stop(perf, BGPSTREAM_PERF_STAGE_ELEMS, &timer);
 
   *elemp = elem;
-  return 1;
+  return rc;
+}
+
+int bgpstream_record_foreach_elem(bgpstream_record_t *record,
+                                  bgpstream_elem_cb_t *cb, void *user)
+{
+  bgpstream_format_t *format;
+  bgpstream_filter_mgr_t *filter_mgr;
+  bgpstream_perf_timer_t timer;
+  bgpstream_elem_t *elem;
+  int rc;
+
+  if (record == NULL ||
+      record->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD ||
+      record->__int->format == NULL) {
+    return 0; // no elems to visit
+  }
+
+  // look these up once for the whole record
+  format = record->__int->format;
+  filter_mgr = format->filter_mgr;
+  record->__int->elem_filter_sets = 0;
+
+  // the time spent in the callback is not ours
+  bgpstream_perf_start(format->res->perf, &timer);
+  while ((rc = bgpstream_format_get_next_elem(format, record, &elem)) > 0) {
+    if (elem_passes(filter_mgr, record, elem) != 0) {
+      bgpstream_perf_stop(format->res->perf, BGPSTREAM_PERF_STAGE_ELEMS,
+                          &timer);
+      if (cb(record, elem, user) != 0) {
+        return 1;
+      }
+      bgpstream_perf_start(format->res->perf, &timer);
+    }
+  }
+  bgpstream_perf_stop(format->res->perf, BGPSTREAM_PERF_STAGE_ELEMS, &timer);
+
+  // either error or end-of-elems
+  return rc;
+}
+
+uint64_t bgpstream_record_get_elem_filter_sets(const bgpstream_record_t *record)
+{
+  return record->__int->elem_filter_sets;
+}
+
+// double the room in every column of cols
+static int elem_columns_grow(bgpstream_elem_columns_t *cols)
+{
+  int alloc = cols->__alloc == 0 ? ELEM_COLUMNS_MIN : cols->__alloc * 2;
+  void *tmp;
+
+#define GROW_COLUMN(col)                                                       \
+  do {                                                                         \
+    if ((tmp = realloc(cols->col, sizeof(*cols->col) * alloc)) == NULL) {      \
+      return -1;                                                               \
+    }                                                                          \
+    cols->col = tmp;                                                           \
+  } while (0)
+
+  GROW_COLUMN(type);
+  GROW_COLUMN(time_sec);
+  GROW_COLUMN(peer_asn);
+  GROW_COLUMN(prefix);
+  GROW_COLUMN(origin_asn);
+  GROW_COLUMN(record_idx);
+  if (cols->__path_store != NULL) {
+    GROW_COLUMN(path_id);
+  }
+
+#undef GROW_COLUMN
+
+  cols->__alloc = alloc;
+  return 0;
+}
+
+// append elem as a new row of cols
+static int elem_columns_add_row(bgpstream_elem_columns_t *cols,
+                                const bgpstream_record_t *record,
+                                bgpstream_elem_t *elem, int record_idx)
+{
+  bgpstream_as_path_t *path;
+  int row;
+
+  if (cols->cnt == cols->__alloc && elem_columns_grow(cols) != 0) {
+    return -1;
+  }
+  row = cols->cnt;
+
+  cols->type[row] = elem->type;
+  cols->time_sec[row] = record->time_sec;
+  cols->peer_asn[row] = elem->peer_asn;
+  cols->record_idx[row] = record_idx;
+
+  if (elem->type == BGPSTREAM_ELEM_TYPE_RIB ||
+      elem->type == BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT ||
+      elem->type == BGPSTREAM_ELEM_TYPE_WITHDRAWAL) {
+    cols->prefix[row] = elem->prefix;
+  } else {
+    memset(&cols->prefix[row], 0, sizeof(bgpstream_pfx_t));
+  }
+
+  cols->origin_asn[row] = 0;
+  if (cols->__path_store != NULL) {
+    memset(&cols->path_id[row], 0, sizeof(*cols->path_id));
+  }
+  if (elem->type == BGPSTREAM_ELEM_TYPE_RIB ||
+      elem->type == BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT) {
+    // (decodes the attributes of lazy elems)
+    if ((path = bgpstream_elem_get_as_path(elem)) == NULL) {
+      return -1;
+    }
+    if (bgpstream_as_path_get_origin_val(path, &cols->origin_asn[row]) != 0) {
+      cols->origin_asn[row] = 0;
+    }
+    if (cols->__path_store != NULL &&
+        bgpstream_as_path_store_get_path_id(cols->__path_store, path,
+                                            elem->peer_asn,
+                                            &cols->path_id[row]) != 0) {
+      return -1;
+    }
+  }
+
+  cols->cnt++;
+  return 0;
+}
+
+// append the remaining elems of record to cols, one row per elem
+static int elem_columns_add(bgpstream_elem_columns_t *cols,
+                            bgpstream_record_t *record, int record_idx)
+{
+  bgpstream_elem_t *elem;
+  int rc, added = 0;
+
+  while ((rc = bgpstream_record_get_next_elem(record, &elem)) > 0) {
+    if (elem_columns_add_row(cols, record, elem, record_idx) != 0) {
+      return -1;
+    }
+    added++;
+  }
+
+  return rc < 0 ? -1 : added;
+}
+
+bgpstream_elem_columns_t *
+bgpstream_elem_columns_create(bgpstream_as_path_store_t *path_store)
+{
+  bgpstream_elem_columns_t *cols;
+
+  if ((cols = malloc_zero(sizeof(bgpstream_elem_columns_t))) == NULL) {
+    return NULL;
+  }
+  cols->__path_store = path_store;
+  return cols;
+}
+
+void bgpstream_elem_columns_clear(bgpstream_elem_columns_t *cols)
+{
+  cols->cnt = 0;
+}
+
+void bgpstream_elem_columns_destroy(bgpstream_elem_columns_t *cols)
+{
+  if (cols == NULL) {
+    return;
+  }
+  free(cols->type);
+  free(cols->time_sec);
+  free(cols->peer_asn);
+  free(cols->prefix);
+  free(cols->origin_asn);
+  free(cols->path_id);
+  free(cols->record_idx);
+  free(cols);
+}
+
+int bgpstream_elem_columns_add_elem(bgpstream_elem_columns_t *cols,
+                                    const bgpstream_record_t *record,
+                                    bgpstream_elem_t *elem)
+{
+  return elem_columns_add_row(cols, record, elem, 0);
+}
+
+int bgpstream_record_get_elem_columns(bgpstream_record_t *record,
+                                      bgpstream_elem_columns_t *cols)
+{
+  return elem_columns_add(cols, record, 0);
+}
+
+int bgpstream_records_get_elem_columns(bgpstream_record_t **records, int n,
+                                       bgpstream_elem_columns_t *cols)
+{
+  int i, rc, added = 0;
+
+  for (i = 0; i < n; i++) {
+    if ((rc = elem_columns_add(cols, records[i], i)) < 0) {
+      return -1;
+    }
+    added += rc;
+  }
+  return added;
 }
 
 int bgpstream_record_type_snprintf(char *buf, size_t len,
@@ -54,6 +54,10 @@ typedef struct bgpstream_record_internal bgpstream_record_internal_t;
  *
  * @{ */
 
+/** Type of the ID of an interned project, collector or router name (see
+ * bgpstream_record_get_name) */
+typedef uint32_t bgpstream_name_id_t;
+
 /** @} */
 
 /**
@@ -203,6 +207,17 @@ typedef struct bgpstream_record {
    */
   bgpstream_ip_addr_t router_ip;
 
+  /** IDs of the project, collector and router names
+   *
+   * Every name is given an ID the first time it is seen, which all the
+   * records (of every stream in the process) with that name then share. The
+   * empty string always has ID 0. Comparing or hashing IDs is cheaper than
+   * doing so for the names, which can be found with bgpstream_record_get_name.
+   */
+  bgpstream_name_id_t project_id;
+  bgpstream_name_id_t collector_id;
+  bgpstream_name_id_t router_id;
+
   /* ---------- DUMP-ONLY FIELDS: ---------- */
 
   /** Position of this record in the dump */
@@ -220,6 +235,68 @@ typedef struct bgpstream_record {
 
 } bgpstream_record_t;
 
+/** Callback that is given the elems of a record in turn (see
+ * bgpstream_record_foreach_elem)
+ *
+ * @param record        pointer to the record that the elem belongs to
+ * @param elem          borrowed pointer to the elem
+ * @param user          the user pointer given to the foreach function
+ * @return 0 to carry on with the next elem, non-zero to stop
+ *
+ * The elem is only valid until the callback returns.
+ */
+typedef int(bgpstream_elem_cb_t)(bgpstream_record_t *record,
+                                 bgpstream_elem_t *elem, void *user);
+
+/** Columns of elem fields
+ *
+ * Row i of every column holds a field of the same elem, so that analyses that
+ * only need a few fields can scan (or export) them without touching the rest
+ * of the elems. See bgpstream_record_get_elem_columns.
+ */
+typedef struct bgpstream_elem_columns {
+
+  /** Number of elems (rows) in the columns */
+  int cnt;
+
+  /** Elem type */
+  bgpstream_elem_type_t *type;
+
+  /** Collection time of the record that the elem came from (seconds
+      component, see the `time_sec` field of bgpstream_record_t) */
+  uint32_t *time_sec;
+
+  /** Peer AS number */
+  uint32_t *peer_asn;
+
+  /** IP prefix (zeroed for elem types without a prefix) */
+  bgpstream_pfx_t *prefix;
+
+  /** Origin AS number, 0 if the elem has no AS path or the origin segment of
+      its path is not a simple ASN */
+  uint32_t *origin_asn;
+
+  /** ID of the AS path of the elem in the store given to
+      bgpstream_elem_columns_create (zeroed for elems without an AS path), or
+      NULL if the columns were created without a store */
+  bgpstream_as_path_store_path_id_t *path_id;
+
+  /** Index of the record that the elem came from, in the array of records
+      given to bgpstream_records_get_elem_columns (0 for
+      bgpstream_record_get_elem_columns) */
+  int *record_idx;
+
+  /* ---------- INTERNAL FIELDS: ---------- */
+
+  /** INTERNAL: number of rows the columns have room for. Do not use. */
+  int __alloc;
+
+  /** INTERNAL: borrowed pointer to the store path IDs come from. Do not
+      use. */
+  bgpstream_as_path_store_t *__path_store;
+
+} bgpstream_elem_columns_t;
+
 /** @} */
 
 /**
@@ -244,6 +321,168 @@ typedef struct bgpstream_record {
 int bgpstream_record_get_next_elem(bgpstream_record_t *record,
                                    bgpstream_elem_t **elem);
 
+/** Create a new set of (empty) elem columns
+ *
+ * @param path_store    pointer to an AS path store to take the IDs of the
+ *                      `path_id` column from (NULL to leave it out)
+ * @return pointer to the columns if successful, NULL otherwise
+ *
+ * The store is borrowed, and must outlive the columns.
+ */
+bgpstream_elem_columns_t *
+bgpstream_elem_columns_create(bgpstream_as_path_store_t *path_store);
+
+/** Remove all rows from the given elem columns
+ *
+ * @param cols          pointer to the columns to clear
+ *
+ * The memory of the columns is kept for the rows that are added next.
+ */
+void bgpstream_elem_columns_clear(bgpstream_elem_columns_t *cols);
+
+/** Destroy the given elem columns
+ *
+ * @param cols          pointer to the columns to destroy
+ */
+void bgpstream_elem_columns_destroy(bgpstream_elem_columns_t *cols);
+
+/** Add the given elem to the columns as a new row
+ *
+ * @param cols          pointer to the columns to add the elem to
+ * @param record        pointer to the BGP Stream Record the elem came from
+ * @param elem          pointer to the elem to add (e.g., as returned by
+ *                      bgpstream_record_get_next_elem)
+ * @return 0 if the elem was added, -1 if an error occurred
+ *
+ * The `record_idx` column of the row is set to 0.
+ */
+int bgpstream_elem_columns_add_elem(bgpstream_elem_columns_t *cols,
+                                    const bgpstream_record_t *record,
+                                    bgpstream_elem_t *elem);
+
+/** Add the remaining elems of the record to the given columns
+ *
+ * @param record        pointer to the BGP Stream Record to take the elems from
+ * @param cols          pointer to the columns to add the elems to
+ * @return the number of rows added, -1 if an error occurred
+ *
+ * Elems are filtered as they are by bgpstream_record_get_next_elem, and this
+ * consumes them in the same way, so the two should not be mixed for one
+ * record. The rows are appended to those already in the columns (see
+ * bgpstream_elem_columns_clear).
+ */
+int bgpstream_record_get_elem_columns(bgpstream_record_t *record,
+                                      bgpstream_elem_columns_t *cols);
+
+/** Add the elems of a batch of records to the given columns
+ *
+ * @param records       array of pointers to the records to take the elems from
+ *                      (e.g., as filled by bgpstream_get_next_records)
+ * @param n             number of records in the array
+ * @param cols          pointer to the columns to add the elems to
+ * @return the number of rows added, -1 if an error occurred
+ *
+ * This is the same as calling bgpstream_record_get_elem_columns for each
+ * record in turn, except that the `record_idx` column is set to the index of
+ * the record in the array.
+ */
+int bgpstream_records_get_elem_columns(bgpstream_record_t **records, int n,
+                                       bgpstream_elem_columns_t *cols);
+
+/** Pass each of the remaining elems of the record to the given callback
+ *
+ * @param record        pointer to the BGP Stream Record to visit the elems of
+ * @param cb            callback to give each elem that passes the filters to
+ * @param user          user pointer to give to the callback
+ * @return 0 if every elem was visited, 1 if the callback stopped the
+ * iteration, -1 if an error occurred
+ *
+ * Elems are filtered, and consumed, as they are by
+ * bgpstream_record_get_next_elem, but in a single call for the whole record.
+ * The callback may use bgpstream_record_get_elem_filter_sets to get the filter
+ * sets of the elem it is given.
+ */
+int bgpstream_record_foreach_elem(bgpstream_record_t *record,
+                                  bgpstream_elem_cb_t *cb, void *user);
+
+/** Get the filter sets that the elem last returned by
+ * bgpstream_record_get_next_elem passes
+ *
+ * @param record        pointer to the BGP Stream Record
+ * @return a bitmap in which bit (1 << set ID) is set for each filter set (see
+ * bgpstream_add_filter_set) that the elem passes, or 0 if the stream has no
+ * filter sets
+ */
+uint64_t bgpstream_record_get_elem_filter_sets(const bgpstream_record_t *record);
+
+/** Retrieve the raw bytes of the record, as they were read from the resource
+ *
+ * @param record        pointer to the BGP Stream Record
+ * @param[out] raw      set to point to the borrowed raw bytes
+ * @return the number of raw bytes, or 0 if they were not kept
+ *
+ * The raw bytes are only kept when the stream was configured using
+ * bgpstream_set_raw_records, and only for MRT records. They are valid as long
+ * as the elems of the record (see bgpstream_record_get_next_elem).
+ */
+size_t bgpstream_record_get_raw(const bgpstream_record_t *record,
+                                const uint8_t **raw);
+
+/** Acknowledge that the given record has been fully processed
+ *
+ * @param record        pointer to the BGP Stream Record to acknowledge
+ * @return 0 if successful, -1 if an error occurred
+ *
+ * Acknowledging a record also acknowledges every record that came before it
+ * from the same resource. Resources that support checkpoints (currently Kafka
+ * streams with checkpointing enabled) periodically commit the position of the
+ * last acknowledged record, so that a restarted consumer resumes right after
+ * it. For other resources this does nothing.
+ *
+ * The record must be acknowledged before it is re-used by a subsequent call
+ * to bgpstream_get_next_record.
+ */
+int bgpstream_record_ack(bgpstream_record_t *record);
+
+/** Keep the given record (and its elems) beyond the next call to
+ * bgpstream_get_next_record
+ *
+ * @param record        pointer to the BGP Stream Record to keep
+ * @return the same pointer
+ *
+ * Records are normally reused by the stream once the user has moved on to the
+ * next one. A retained record is instead left untouched (the stream starts
+ * using a new record in its place) until bgpstream_record_release has been
+ * called once for each time it was retained. This lets a record be handed to
+ * other threads without copying its elems with bgpstream_elem_copy.
+ *
+ * Retaining is done from the thread that got the record from the stream (or by
+ * a thread that already holds it), and releasing may be done from any thread.
+ * The elems of a retained record may be read by one thread at a time, but not
+ * while the filters of the stream are being reloaded. Every retained record
+ * must be released before the stream is destroyed.
+ */
+bgpstream_record_t *bgpstream_record_retain(bgpstream_record_t *record);
+
+/** Release a record that was kept with bgpstream_record_retain
+ *
+ * @param record        pointer to the BGP Stream Record to release
+ *
+ * Once every holder has released it, the record is recycled, and must not be
+ * used any more.
+ */
+void bgpstream_record_release(bgpstream_record_t *record);
+
+/** Get the name that the given name ID stands for
+ *
+ * @param id            a project, collector or router ID of a record
+ * @return borrowed pointer to the name, or NULL if no name has the ID
+ *
+ * Names are kept until the process exits, and may be looked up from any
+ * thread.
+ */
+const char *bgpstream_record_get_name(bgpstream_name_id_t id);
+
 /** Write the string representation of the record type into the provided buffer
  *
  * @param buf           pointer to a char array
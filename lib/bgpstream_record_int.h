@@ -45,6 +45,26 @@
  *
  * @{ */
 
+/** Immutable raw bytes shared by the records that must be preceded by them
+ * (e.g., the MRT TABLE_DUMP_V2 peer index table), freed once the last holder
+ * releases them */
+typedef struct bgpstream_record_raw_prefix {
+
+  /** Number of holders (the format, and each record that refers to it) */
+  uint32_t refcnt;
+
+  /** Identifies the prefix (different prefixes have different IDs, even if
+   * their bytes are the same) */
+  uint64_t id;
+
+  /** Number of raw bytes */
+  size_t len;
+
+  /** The raw bytes */
+  uint8_t data[];
+
+} bgpstream_record_raw_prefix_t;
+
 struct bgpstream_record_internal {
 
   /** Pointer to the format module that created this data */
@@ -52,8 +72,41 @@ struct bgpstream_record_internal {
 
   /** Private data-structure (optionally) populated by the format module */
   void *data;
+
+  /** Copy of the raw bytes of the record (only kept when raw records are
+   * enabled, and the format supports it) */
+  uint8_t *raw;
+  size_t raw_len;
+  size_t raw_alloc;
+
+  /** Raw bytes that must precede the record for it to be understood, of
+   * which the record holds a reference (NULL if there are none) */
+  bgpstream_record_raw_prefix_t *raw_prefix;
+
+  /** Number of bytes read from the transport up to the end of the record, or
+   * 0 if the format does not track it (see bgpstream_record_ack) */
+  uint64_t position;
+
+  /** Filter sets that the elem last returned by bgpstream_record_get_next_elem
+   * passes (one bit per set) */
+  uint64_t elem_filter_sets;
+
+  /** Number of references to the record: one for the reader that owns it
+   * (until it is detached), plus one for each bgpstream_record_retain */
+  int refcnt;
+
+  /** Borrowed pointer to the pool that the record goes back to once it is
+   * released (may be NULL) */
+  struct bgpstream_record_pool *pool;
+
+  /** NUMA node of the thread that allocated the record (and its data) */
+  int node;
 };
 
+/** Opaque structure holding records that are not in use, so that they can be
+ * reused by the readers of other resources */
+typedef struct bgpstream_record_pool bgpstream_record_pool_t;
+
 /** @} */
 
 /**
@@ -86,6 +139,109 @@ void bgpstream_record_destroy(bgpstream_record_t *record);
  */
 void bgpstream_record_clear(bgpstream_record_t *record);
 
+/** Keep a copy of the raw bytes of the given record
+ *
+ * @param record        pointer to the record to update
+ * @param raw           pointer to the raw bytes of the record
+ * @param len           number of raw bytes
+ * @return 0 if the bytes were copied successfully, -1 otherwise
+ */
+int bgpstream_record_set_raw(bgpstream_record_t *record, const uint8_t *raw,
+                             size_t len);
+
+/** Create a raw prefix from a copy of the given bytes
+ *
+ * @param raw           pointer to the raw bytes to copy
+ * @param len           number of raw bytes
+ * @param id            identifier of the raw bytes
+ * @return pointer to the prefix (held by the caller) if successful, NULL
+ * otherwise
+ */
+bgpstream_record_raw_prefix_t *
+bgpstream_record_raw_prefix_create(const uint8_t *raw, size_t len, uint64_t id);
+
+/** Release a reference to the given raw prefix
+ *
+ * @param prefix        pointer to the prefix to release (may be NULL)
+ *
+ * The prefix is freed once its last holder releases it. This may be called
+ * from any thread.
+ */
+void bgpstream_record_raw_prefix_release(bgpstream_record_raw_prefix_t *prefix);
+
+/** Set the raw bytes that must precede the given record
+ *
+ * @param record        pointer to the record to update
+ * @param prefix        pointer to the raw prefix, of which the record takes a
+ *                      reference until it is cleared
+ */
+void bgpstream_record_set_raw_prefix(bgpstream_record_t *record,
+                                     bgpstream_record_raw_prefix_t *prefix);
+
+/** Get the ID of the given project, collector or router name
+ *
+ * @param name          the name to look up
+ * @param[out] id       set to the ID of the name
+ * @return 0 if successful, -1 if the name could not be added
+ *
+ * The name is added if it has not been seen before. This may be called from
+ * any thread.
+ */
+int bgpstream_record_intern_name(const char *name, bgpstream_name_id_t *id);
+
+/** Create a new record pool
+ *
+ * @param max_records   most records to keep for each format type (on each
+ *                      NUMA node)
+ * @return pointer to a pool if successful, NULL otherwise
+ *
+ * The pool may be used from several threads at once.
+ */
+bgpstream_record_pool_t *bgpstream_record_pool_create(int max_records);
+
+/** Get a record for the given format from the pool
+ *
+ * @param pool          pointer to a pool (if NULL, a new record is created)
+ * @param format        pointer to the format the record will be used with
+ * @return a pointer to a cleared record, NULL if one could not be created
+ *
+ * A record that was returned to the pool by a reader of the same format type
+ * is reused if there is one that was allocated on the NUMA node of the calling
+ * thread, and a new record (local to the thread) is created otherwise.
+ */
+bgpstream_record_t *bgpstream_record_pool_get(bgpstream_record_pool_t *pool,
+                                              bgpstream_format_t *format);
+
+/** Return a record to the pool
+ *
+ * @param pool          pointer to a pool (if NULL, the record is destroyed)
+ * @param record        pointer to the record to return
+ *
+ * The record is destroyed if the pool already holds as many records of its
+ * format type as it may. This must be called before the format of the record
+ * is destroyed.
+ */
+void bgpstream_record_pool_put(bgpstream_record_pool_t *pool,
+                               bgpstream_record_t *record);
+
+/** Drop the reader's reference to the given record
+ *
+ * @param record        pointer to the record to detach
+ * @return 0 if nothing else holds the record, which the reader may then reuse,
+ * 1 if it is still retained
+ *
+ * A record that is still retained keeps its format alive, and goes back to
+ * its pool once the last holder calls bgpstream_record_release. The reader
+ * must use a new record in its place.
+ */
+int bgpstream_record_detach(bgpstream_record_t *record);
+
+/** Destroy the given pool and the records it holds
+ *
+ * @param pool          pointer to the pool to destroy
+ */
+void bgpstream_record_pool_destroy(bgpstream_record_pool_t *pool);
+
 /** @} */
 
 #endif /* __BGPSTREAM_RECORD_INT_H */
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_reorder.h"
+#include "utils.h"
+#include <stdlib.h>
+
+typedef struct reorder_entry {
+
+  // time that the record is ordered by, and the order it was added in (to keep
+  // records with the same time in their original order)
+  uint32_t time;
+  uint64_t seq;
+
+  bgpstream_record_t *record;
+
+} reorder_entry_t;
+
+struct bgpstream_reorder {
+
+  uint32_t max_skew;
+  int max_records;
+
+  // min-heap of the records in the buffer
+  reorder_entry_t *heap;
+  int heap_cnt;
+  int heap_alloc;
+
+  // latest (non-zero) record time added so far
+  uint32_t latest;
+
+  // number of records added so far
+  uint64_t seq;
+
+  // records taken out since the last bgpstream_reorder_release
+  bgpstream_record_t **out;
+  int out_cnt;
+  int out_alloc;
+};
+
+static int entry_before(const reorder_entry_t *a, const reorder_entry_t *b)
+{
+  return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static void heap_swap(bgpstream_reorder_t *reorder, int i, int j)
+{
+  reorder_entry_t tmp = reorder->heap[i];
+  reorder->heap[i] = reorder->heap[j];
+  reorder->heap[j] = tmp;
+}
+
+static void heap_up(bgpstream_reorder_t *reorder, int idx)
+{
+  int parent;
+
+  while (idx > 0) {
+    parent = (idx - 1) / 2;
+    if (!entry_before(&reorder->heap[idx], &reorder->heap[parent])) {
+      break;
+    }
+    heap_swap(reorder, idx, parent);
+    idx = parent;
+  }
+}
+
+static void heap_down(bgpstream_reorder_t *reorder, int idx)
+{
+  int child;
+
+  while ((child = 2 * idx + 1) < reorder->heap_cnt) {
+    if (child + 1 < reorder->heap_cnt &&
+        entry_before(&reorder->heap[child + 1], &reorder->heap[child])) {
+      child++;
+    }
+    if (!entry_before(&reorder->heap[child], &reorder->heap[idx])) {
+      break;
+    }
+    heap_swap(reorder, idx, child);
+    idx = child;
+  }
+}
+
+bgpstream_reorder_t *bgpstream_reorder_create(uint32_t max_skew,
+                                              int max_records)
+{
+  bgpstream_reorder_t *reorder;
+
+  if (max_records <= 0 ||
+      (reorder = malloc_zero(sizeof(bgpstream_reorder_t))) == NULL) {
+    return NULL;
+  }
+  reorder->max_skew = max_skew;
+  reorder->max_records = max_records;
+  return reorder;
+}
+
+int bgpstream_reorder_push(bgpstream_reorder_t *reorder,
+                           bgpstream_record_t *record)
+{
+  reorder_entry_t *heap;
+  bgpstream_record_t **out;
+  int alloc;
+
+  // make room for the record both in the heap, and once it is taken out
+  if (reorder->out_cnt + reorder->heap_cnt == reorder->out_alloc) {
+    alloc = (reorder->out_alloc == 0) ? 64 : reorder->out_alloc * 2;
+    if ((out = realloc(reorder->out, sizeof(bgpstream_record_t *) * alloc)) ==
+        NULL) {
+      return -1;
+    }
+    reorder->out = out;
+    reorder->out_alloc = alloc;
+  }
+  if (reorder->heap_cnt == reorder->heap_alloc) {
+    alloc = (reorder->heap_alloc == 0) ? 64 : reorder->heap_alloc * 2;
+    if ((heap = realloc(reorder->heap, sizeof(reorder_entry_t) * alloc)) ==
+        NULL) {
+      return -1;
+    }
+    reorder->heap = heap;
+    reorder->heap_alloc = alloc;
+  }
+
+  if (record->time_sec > reorder->latest) {
+    reorder->latest = record->time_sec;
+  }
+  heap = &reorder->heap[reorder->heap_cnt];
+  heap->time = (record->time_sec != 0) ? record->time_sec : reorder->latest;
+  heap->seq = reorder->seq++;
+  heap->record = bgpstream_record_retain(record);
+  heap_up(reorder, reorder->heap_cnt++);
+  return 0;
+}
+
+bgpstream_record_t *bgpstream_reorder_pop(bgpstream_reorder_t *reorder,
+                                          int flush)
+{
+  bgpstream_record_t *record;
+
+  if (reorder->heap_cnt == 0) {
+    return NULL;
+  }
+  // a record can come out once every record still to come (which is at most
+  // max_skew behind the latest one) is after it
+  if (flush == 0 && reorder->heap_cnt < reorder->max_records &&
+      (uint64_t)reorder->heap[0].time + reorder->max_skew >
+        reorder->latest) {
+    return NULL;
+  }
+
+  // (push made room for it in out)
+  record = reorder->heap[0].record;
+  reorder->heap[0] = reorder->heap[--reorder->heap_cnt];
+  heap_down(reorder, 0);
+  reorder->out[reorder->out_cnt++] = record;
+  return record;
+}
+
+void bgpstream_reorder_release(bgpstream_reorder_t *reorder)
+{
+  int i;
+
+  for (i = 0; i < reorder->out_cnt; i++) {
+    bgpstream_record_release(reorder->out[i]);
+  }
+  reorder->out_cnt = 0;
+}
+
+int bgpstream_reorder_get_cnt(bgpstream_reorder_t *reorder)
+{
+  return reorder->heap_cnt;
+}
+
+void bgpstream_reorder_destroy(bgpstream_reorder_t *reorder)
+{
+  int i;
+
+  if (reorder == NULL) {
+    return;
+  }
+  bgpstream_reorder_release(reorder);
+  for (i = 0; i < reorder->heap_cnt; i++) {
+    bgpstream_record_release(reorder->heap[i].record);
+  }
+  free(reorder->heap);
+  free(reorder->out);
+  free(reorder);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_REORDER_H
+#define __BGPSTREAM_REORDER_H
+
+#include "bgpstream.h"
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Header file for the reorder buffer, which puts records that are
+ * slightly out of order (e.g., small bursts in update dumps) back into time
+ * order (see bgpstream_set_max_skew).
+ *
+ * Records are retained (see bgpstream_record_retain) while they are in the
+ * buffer, and until the caller is done with them once they are taken out.
+ */
+
+/** Opaque structure holding records being put back into time order */
+typedef struct bgpstream_reorder bgpstream_reorder_t;
+
+/** Create a reorder buffer
+ *
+ * @param max_skew      how far (in seconds) behind the latest record that a
+ *                      record may be
+ * @param max_records   number of records to hold at most (once it is reached,
+ *                      the earliest record is taken out regardless of where the
+ *                      latest one is)
+ * @return pointer to the buffer if successful, NULL otherwise
+ */
+bgpstream_reorder_t *bgpstream_reorder_create(uint32_t max_skew,
+                                              int max_records);
+
+/** Add a record to the buffer
+ *
+ * @param reorder       pointer to the buffer
+ * @param record        pointer to the record to add (it is retained)
+ * @return 0 if the record was added successfully, -1 otherwise
+ *
+ * A record whose time is 0 (e.g., a BMP message without a timestamp) is
+ * ordered as if it had the time of the latest record, so that it stays next to
+ * the records that it arrived with.
+ */
+int bgpstream_reorder_push(bgpstream_reorder_t *reorder,
+                           bgpstream_record_t *record);
+
+/** Take the earliest record out of the buffer if no later record can come
+ * before it
+ *
+ * @param reorder       pointer to the buffer
+ * @param flush         if set, take the earliest record out even if it may not
+ *                      be in order yet (e.g., because no more records will be
+ *                      added)
+ * @return pointer to the record, or NULL if there is no record that can be
+ * taken out
+ *
+ * The record remains valid until bgpstream_reorder_release is called.
+ * Records with the same (ordering) time come out in the order they were added.
+ */
+bgpstream_record_t *bgpstream_reorder_pop(bgpstream_reorder_t *reorder,
+                                          int flush);
+
+/** Release the records taken out of the buffer since the last call
+ *
+ * @param reorder       pointer to the buffer
+ */
+void bgpstream_reorder_release(bgpstream_reorder_t *reorder);
+
+/** Get the number of records in the buffer
+ *
+ * @param reorder       pointer to the buffer
+ * @return the number of records that have been added but not taken out
+ */
+int bgpstream_reorder_get_cnt(bgpstream_reorder_t *reorder);
+
+/** Destroy the given reorder buffer, releasing all of its records
+ *
+ * @param reorder       pointer to the buffer to destroy
+ */
+void bgpstream_reorder_destroy(bgpstream_reorder_t *reorder);
+
+#endif /* __BGPSTREAM_REORDER_H */
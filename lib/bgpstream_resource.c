@@ -61,6 +61,7 @@ bgpstream_resource_t *bgpstream_resource_create(
   if ((res = malloc_zero(sizeof(bgpstream_resource_t))) == NULL) {
     return NULL;
   }
+  res->refcnt = 1;
 
   res->transport_type = transport_type;
   res->format_type = format_type;
@@ -84,10 +85,21 @@ err:
   return NULL;
 }
 
+bgpstream_resource_t *bgpstream_resource_retain(bgpstream_resource_t *resource)
+{
+  __atomic_add_fetch(&resource->refcnt, 1, __ATOMIC_RELAXED);
+  return resource;
+}
+
 void bgpstream_resource_destroy(bgpstream_resource_t *resource)
 {
   int i;
 
+  if (resource == NULL ||
+      __atomic_sub_fetch(&resource->refcnt, 1, __ATOMIC_ACQ_REL) != 0) {
+    return;
+  }
+
   free(resource->url);
   resource->url = NULL;
 
@@ -128,6 +140,19 @@ int bgpstream_resource_set_attr(bgpstream_resource_t *resource,
   return 0;
 }
 
+int bgpstream_resource_set_url(bgpstream_resource_t *resource,
+                               const char *url)
+{
+  char *dup;
+
+  if ((dup = strdup(url)) == NULL) {
+    return -1;
+  }
+  free(resource->url);
+  resource->url = dup;
+  return 0;
+}
+
 const char *bgpstream_resource_get_attr(bgpstream_resource_t *resource,
                                         bgpstream_resource_attr_type_t type)
 {
@@ -44,15 +44,18 @@ typedef enum {
   /** Data is served from a Kafka queue */
   BGPSTREAM_RESOURCE_TRANSPORT_KAFKA = 1,
 
-  /** Data is streamed via websockets */
-  //  BGPSTREAM_RESOURCE_TRANSPORT_WEBSOCKET = 2,
-
   /** Data is locally cached */
   BGPSTREAM_RESOURCE_TRANSPORT_CACHE = 2,
 
   /** Data is streamed via http */
   BGPSTREAM_RESOURCE_TRANSPORT_HTTP = 3,
 
+  /** Data is streamed via websockets (one message per line) */
+  BGPSTREAM_RESOURCE_TRANSPORT_WEBSOCKET = 4,
+
+  /** Data is read from a shared-memory ring written by a local process */
+  BGPSTREAM_RESOURCE_TRANSPORT_SHMRING = 5,
+
 } bgpstream_resource_transport_type_t;
 
 /** Encapsulation/encoding formats supported */
@@ -67,6 +70,13 @@ typedef enum bgpstream_resource_format_type {
   /** RIPE-format data encapsulated in JSON */
   BGPSTREAM_RESOURCE_FORMAT_RISLIVE = 2,
 
+  /** BGPStream records and elems in the BGPStream binary format (see
+      bgpstream_binary.h) */
+  BGPSTREAM_RESOURCE_FORMAT_BINARY = 3,
+
+  /** INTERNAL: The number of format types */
+  _BGPSTREAM_RESOURCE_FORMAT_TYPE_CNT = 4,
+
 } bgpstream_resource_format_type_t;
 
 /** Set of possible resource attribute types */
@@ -87,6 +97,35 @@ typedef enum bgpstream_resource_attr_type {
   /** The path toward a local cache */
   BGPSTREAM_RESOURCE_ATTR_CACHE_DIR_PATH = 3,
 
+  /** The maximum size (in bytes) of the local cache. If unset, the cache is
+      unbounded */
+  BGPSTREAM_RESOURCE_ATTR_CACHE_MAX_SIZE = 4,
+
+  /** The number of reads after which a cached resource is stored
+      uncompressed. If unset, cached resources are always stored compressed */
+  BGPSTREAM_RESOURCE_ATTR_CACHE_HOT_READS = 5,
+
+  /** The maximum number of Kafka messages consumed at once. If unset,
+      defaults to BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_BATCH_SIZE */
+  BGPSTREAM_RESOURCE_ATTR_KAFKA_BATCH_SIZE = 6,
+
+  /** Newline-separated "name=value" librdkafka consumer settings, applied on
+      top of the transport defaults */
+  BGPSTREAM_RESOURCE_ATTR_KAFKA_CONFIG = 7,
+
+  /** The partitions to consume (comma-separated), which are then assigned to
+      the consumer directly. If unset, the consumer group decides */
+  BGPSTREAM_RESOURCE_ATTR_KAFKA_PARTITIONS = 8,
+
+  /** If set to "1", the offsets of Kafka messages are only committed once the
+      records decoded from them have been acknowledged (see
+      bgpstream_record_ack) */
+  BGPSTREAM_RESOURCE_ATTR_KAFKA_CHECKPOINT = 9,
+
+  /** Newline-separated alternate URLs of the resource (e.g., other mirrors of
+      an archive), tried in turn when it cannot be opened from its URL */
+  BGPSTREAM_RESOURCE_ATTR_MIRRORS = 10,
+
   /** INTERNAL: The total number of attribute types in use */
   _BGPSTREAM_RESOURCE_ATTR_CNT,
 
@@ -139,6 +178,21 @@ typedef struct bgpstream_resource {
    */
   struct attr *attrs[_BGPSTREAM_RESOURCE_ATTR_CNT];
 
+  /** Number of references to the resource (see bgpstream_resource_retain) */
+  int refcnt;
+
+  /** Memory accounting of the stream that the resource belongs to, which the
+   * reader, transport and format count their buffers in (NULL if none) */
+  struct bgpstream_mem *mem;
+
+  /** Throughput accounting of the stream that the resource belongs to, which
+   * the transport and format count their reads and time in (NULL if none) */
+  struct bgpstream_perf *perf;
+
+  /** Circuit breaker of the stream that the resource belongs to, which keeps
+   * the reader from opening from hosts that keep failing (NULL if none) */
+  struct bgpstream_breaker *breaker;
+
 } bgpstream_resource_t;
 
 /** Create a new resource metadata object */
@@ -148,7 +202,19 @@ bgpstream_resource_t *bgpstream_resource_create(
   uint32_t initial_time, uint32_t duration, const char *project,
   const char *collector, bgpstream_record_type_t record_type);
 
-/** Destroy the given resource metadata object */
+/** Take another reference to the given resource metadata object
+ *
+ * @param resource      pointer to the resource to keep
+ * @return the same pointer
+ *
+ * The resource is only destroyed once bgpstream_resource_destroy has been
+ * called for every reference (the one returned by bgpstream_resource_create
+ * included). This may be done from any thread.
+ */
+bgpstream_resource_t *bgpstream_resource_retain(bgpstream_resource_t *resource);
+
+/** Drop a reference to the given resource metadata object, and destroy it if
+ * that was the last one */
 void bgpstream_resource_destroy(bgpstream_resource_t *resource);
 
 /** Helper function for setting an attribute for a resource object
@@ -172,6 +238,19 @@ int bgpstream_resource_set_attr(bgpstream_resource_t *resource,
 const char *bgpstream_resource_get_attr(bgpstream_resource_t *resource,
                                         bgpstream_resource_attr_type_t type);
 
+/** Change the URL that the resource is opened from
+ *
+ * @param resource      pointer to the resource object
+ * @param url           borrowed pointer to the new URL
+ * @return 0 if the URL was changed successfully, -1 otherwise
+ *
+ * This must only be done by the reader of the resource before it is opened
+ * (e.g., to fail over to a mirror), since nothing else may be using the URL
+ * then.
+ */
+int bgpstream_resource_set_url(bgpstream_resource_t *resource,
+                               const char *url);
+
 /** Get a unique hash of the resource
  *
  * @param buf           pointer to the buffer that stores the hash value
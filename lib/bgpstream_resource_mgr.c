@@ -25,12 +25,20 @@
  */
 
 #include "bgpstream_resource_mgr.h"
+#include "bgpstream_affinity.h"
+#include "bgpstream_breaker.h"
+#include "bgpstream_context.h"
 #include "bgpstream_filter.h"
 #include "bgpstream_log.h"
+#include "bgpstream_mem.h"
+#include "bgpstream_perf.h"
 #include "bgpstream_reader.h"
+#include "bgpstream_reorder.h"
+#include "bgpstream_summary_int.h"
 #include "config.h"
 #include "utils.h"
 #include <assert.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -39,9 +47,9 @@
 #define BUFFER_LEN 1024
 
 /** Approximately how frequently should stream resources that return AGAIN be
-    polled? (in msec) */
+    polled? (in msec). Since stream readers decode in the background and wake
+    us when they have data, this is the longest we wait between polls. */
 #define AGAIN_POLL_INTERVAL 100
-#define MSEC_TO_NSEC 1000000
 
 struct res_list_elem {
   /** The resource info */
@@ -57,6 +65,19 @@ struct res_list_elem {
       immediately) */
   uint32_t next_poll;
 
+  /** Worker pool event sequence number when this resource last had no data
+      (any later event may mean that it has some now) */
+  uint64_t poll_seq;
+
+  /** Index of this elem in the merge heap (-1 if it is in a group) */
+  int heap_idx;
+
+  /** Cached next time of the reader (only valid while in the merge heap) */
+  uint32_t heap_time;
+
+  /** Tie-breaker for elems with the same time and type in the merge heap */
+  uint64_t heap_seq;
+
   /** Previous list elem */
   struct res_list_elem *prev;
 
@@ -94,6 +115,10 @@ struct res_group {
   struct res_group *next;
 };
 
+/* RIPE RIS doesn't like it if we try to open too many connections at once, so
+   we cap the number of resources being opened at the same time */
+#define MAX_SIMULTANEOUS_GROUP_CONNECTIONS (15)
+
 struct bgpstream_resource_mgr {
 
   /** Ordered queue of resources, grouped by timestamp (i.e. group by second).
@@ -113,10 +138,130 @@ struct bgpstream_resource_mgr {
 
   // borrowed pointer to a filter manager instance
   bgpstream_filter_mgr_t *filter_mgr;
+
+  // number of records each reader should decode ahead of the consumer
+  int reader_readahead;
+
+  // pool of threads that open (and decode) resources for our readers
+  bgpstream_worker_pool_t *pool;
+
+  // number of threads to start the pool with
+  int worker_threads;
+
+  // where the threads of the pool run
+  bgpstream_affinity_t affinity;
+
+  // records given back by closed readers, for the readers we open next
+  bgpstream_record_pool_t *record_pool;
+
+  // memory accounting of the stream. once its limit is reached, resources are
+  // opened as if the open budget were used up
+  bgpstream_mem_t *mem;
+
+  // throughput accounting of the stream
+  bgpstream_perf_t *perf;
+
+  // hosts that resources keep failing to open from
+  bgpstream_breaker_t *breaker;
+
+  // context whose workers, record pool and breaker we share (NULL if the ones
+  // above are our own)
+  bgpstream_context_t *ctx;
+
+  // should open resources be merged using the heap rather than the groups?
+  int heap_merge;
+
+  // maximum number of readers to have open at once (0 for no limit). only
+  // resources that must be read to keep records in order are opened beyond it
+  int max_open;
+
+  // number of resources whose opening was deferred by the budget in the
+  // current batch, and whether the last batch was limited by the budget
+  int open_deferred;
+  int open_limited;
+
+  // readers of the current batch that may still be opening, as a ring (oldest
+  // first). the window is shared by all the groups of the batch, so that they
+  // are opened concurrently rather than one list at a time.
+  bgpstream_reader_t *opening[MAX_SIMULTANEOUS_GROUP_CONNECTIONS];
+  int opening_head;
+  int opening_cnt;
+
+  // time of the last group in the batch that was most recently opened. groups
+  // after this are only sorted once they are part of a batch.
+  uint32_t batch_end_time;
+
+  // groups that start within this many seconds of the current time are opened
+  // (and their first record read) before they are needed (0 to disable), and
+  // the time at which we last did so
+  uint32_t prefetch_horizon;
+  uint32_t prefetch_time;
+
+  // should records be returned as soon as any resource has one (rather than in
+  // time order)?
+  int unordered;
+
+  // records that are slightly out of order are put back into time order here
+  // before they are returned (NULL to return them as they come)
+  bgpstream_reorder_t *reorder;
+
+  // index in the heap array of the next resource to try in unordered mode
+  int unordered_next;
+
+  // should we return BGPSTREAM_WOULD_BLOCK rather than wait for a stream
+  // resource to have data? would_block is set when we would have waited.
+  int nonblocking;
+  int would_block;
+
+  // min-heap of open resources, ordered by (next time, RIBs first, seq). only
+  // used when heap_merge is set, in which case groups only hold resources
+  // that have not been opened (and sorted) yet. in unordered mode this holds
+  // the open resources in no particular order.
+  struct res_list_elem **heap;
+  int heap_cnt;
+  int heap_alloc;
+  uint64_t heap_seq;
+
+  // open resources in the order their records will be merged (used to share
+  // out the read-ahead), and the number of records returned since we last did
+  struct res_list_elem **ra_order;
+  int ra_alloc;
+  int ra_records;
+
+  // resources that reached EOS while the user may still hold records from them
+  // (linked by their next pointers). destroyed at the start of the next call
+  // for records.
+  struct res_list_elem *retired;
 };
 
+#define HEAP_TOP_TIME (q->heap[0]->heap_time)
+
 static int open_batch(bgpstream_resource_mgr_t *q, struct res_group *gp);
 
+static int create_pool(bgpstream_resource_mgr_t *q)
+{
+  bgpstream_worker_pool_t *shared;
+
+  if (q->pool != NULL) {
+    return 0;
+  }
+  if (q->ctx == NULL) {
+    q->pool = bgpstream_worker_pool_create(q->worker_threads, &q->affinity);
+  } else if ((shared = bgpstream_context_get_pool(q->ctx)) != NULL) {
+    // our own view of the context's workers, so that other streams' events do
+    // not wake us up (nor ours them)
+    q->pool = bgpstream_worker_pool_create_view(shared);
+  }
+  if (q->pool == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Failed to create worker pool");
+    return -1;
+  }
+  // the opens we keep in flight are sized by the threads that serve them,
+  // which for a context are those of its shared pool
+  q->worker_threads = bgpstream_worker_pool_get_thread_cnt(q->pool);
+  return 0;
+}
+
 static void res_list_destroy(struct res_list_elem *l, int destroy_resource)
 {
   if (l == NULL) {
@@ -149,20 +294,122 @@ static struct res_list_elem *res_list_elem_create(bgpstream_resource_t *res)
   }
 
   el->res = res;
+  el->heap_idx = -1;
 
   // its up the caller to connect it to something...
 
   return el;
 }
 
-#define MAX_SIMULTANEOUS_GROUP_CONNECTIONS (15)
+/* Enough workers that a full batch of simultaneous connections can be opened
+   in parallel */
+#define DEFAULT_WORKER_THREADS (MAX_SIMULTANEOUS_GROUP_CONNECTIONS + 1)
+
+/* Read-ahead depth used in unordered mode if none has been configured (records
+   can only be decoded in parallel if they are decoded ahead of the consumer) */
+#define UNORDERED_DEFAULT_READAHEAD 32
+
+/* Read-ahead depth used for stream resources if none has been configured, so
+   that they are polled in the background and can wake the consumer as soon as
+   they have data */
+#define STREAM_DEFAULT_READAHEAD 16
+
+/* Most records (of each format type) to keep from closed readers for reuse by
+   the readers opened after them. Enough for a full batch of simultaneous
+   connections with unordered read-ahead. */
+#define RECORD_POOL_SIZE                                                       \
+  (MAX_SIMULTANEOUS_GROUP_CONNECTIONS * (UNORDERED_DEFAULT_READAHEAD + 2))
+
+/* Most records to hold in the reorder buffer. Records of a RIB dump all have
+   the same time, so without a bound the buffer would hold the whole RIB until
+   the first record that is max_skew later. */
+#define REORDER_MAX_RECORDS 4096
+
+/* Maximum number of prefetched resources that may be waiting to open at once
+   (so that the worker pool is still free to decode the resources being read) */
+#define PREFETCH_MAX_PENDING                                                   \
+  (q->worker_threads > 1 ? q->worker_threads / 2 : 1)
+
+// is there an open budget? (the heap merge and unordered modes always open
+// whole groups)
+#define OPEN_BUDGETED                                                          \
+  (q->heap_merge == 0 && q->unordered == 0 &&                                  \
+   (q->max_open != 0 || bgpstream_mem_get_limit(q->mem) != 0))
+
+// is the open budget used up? (by the number of open readers, or by the memory
+// limit, which always leaves room for one reader)
+#define OPEN_BUDGET_FULL                                                       \
+  (q->heap_merge == 0 && q->unordered == 0 &&                                  \
+   ((q->max_open != 0 && q->res_open_cnt >= q->max_open) ||                    \
+    (q->res_open_cnt != 0 && bgpstream_mem_over_limit(q->mem))))
+
+// creates a reader for the given resource. the resource is opened (and its
+// first record read) by the worker pool, so this does not wait
+static int open_res_el(bgpstream_resource_mgr_t *q, struct res_group *gp,
+                       struct res_list_elem *el)
+{
+  int readahead = q->reader_readahead;
 
-static int open_res_list(bgpstream_resource_mgr_t *q, struct res_group *gp,
-                         struct res_list_elem *el)
+  if (readahead == 0) {
+    if (q->unordered != 0) {
+      readahead = UNORDERED_DEFAULT_READAHEAD;
+    } else if (el->res->duration == BGPSTREAM_FOREVER) {
+      readahead = STREAM_DEFAULT_READAHEAD;
+    }
+  }
+
+  // start the worker threads the first time we open something
+  if (create_pool(q) != 0) {
+    return -1;
+  }
+
+  if ((el->reader = bgpstream_reader_create(el->res, q->filter_mgr, q->pool,
+                                            q->record_pool, readahead)) ==
+      NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Failed to open resource: %s",
+                  el->res->url);
+    return -1;
+  }
+  // update stats
+  q->res_open_cnt++;
+  gp->res_open_cnt++;
+
+  return 0;
+}
+
+// adds a reader to the window of those being opened, first waiting for the
+// current attempt of the oldest one if the window is full
+static int opening_push(bgpstream_resource_mgr_t *q, bgpstream_reader_t *reader)
+{
+  if (q->opening_cnt == MAX_SIMULTANEOUS_GROUP_CONNECTIONS) {
+    // a resource that is waiting to retry its open is not using a connection
+    if (bgpstream_reader_open_attempt_wait(q->opening[q->opening_head]) !=
+        0) {
+      return -1;
+    }
+    q->opening_head =
+      (q->opening_head + 1) % MAX_SIMULTANEOUS_GROUP_CONNECTIONS;
+    q->opening_cnt--;
+  }
+  q->opening[(q->opening_head + q->opening_cnt) %
+             MAX_SIMULTANEOUS_GROUP_CONNECTIONS] = reader;
+  q->opening_cnt++;
+  return 0;
+}
+
+// forgets the readers in the window (they are waited for when they are sorted,
+// and may be destroyed after that)
+static void opening_clear(bgpstream_resource_mgr_t *q)
 {
-  int outstanding = 0;
-  bgpstream_reader_t *last = NULL;
+  q->opening_head = 0;
+  q->opening_cnt = 0;
+}
 
+// opens the resources in the given list. if the open budget is full, only the
+// first unopened resource is opened (and only if need_one is set)
+static int open_res_list(bgpstream_resource_mgr_t *q, struct res_group *gp,
+                         struct res_list_elem *el, int need_one)
+{
   while (el != NULL) {
     assert(el->res != NULL);
     // it is possible that this is already open (because of re-sorting)
@@ -170,57 +417,75 @@ static int open_res_list(bgpstream_resource_mgr_t *q, struct res_group *gp,
       el = el->next;
       continue;
     }
-    // open this resource
-    if ((el->reader = bgpstream_reader_create(el->res, q->filter_mgr)) ==
-        NULL) {
-      bgpstream_log(BGPSTREAM_LOG_ERR, "Failed to open resource: %s",
+    if (OPEN_BUDGET_FULL) {
+      if (need_one == 0) {
+        // leave the rest for later
+        if (bgpstream_mem_over_limit(q->mem)) {
+          bgpstream_mem_throttled(q->mem);
+        }
+        while (el != NULL) {
+          if (el->reader == NULL) {
+            q->open_deferred++;
+          }
+          el = el->next;
+        }
+        break;
+      }
+      bgpstream_log(BGPSTREAM_LOG_FINE,
+                    "Exceeding open budget (%d readers, %" PRIu64
+                    " bytes) to keep records in order: %s",
+                    q->max_open, bgpstream_mem_get_limit(q->mem),
                     el->res->url);
-      return -1;
     }
-    // update stats
-    q->res_open_cnt++;
-    gp->res_open_cnt++;
-
-    outstanding ++;
-    /* RIPE RIS doesn't like it if we try to open too many connections at
-     * once, so we have to arbitrarily cap the number of reader threads that
-     * we start before checking for a completed connection.
-     */
-    if (outstanding > MAX_SIMULTANEOUS_GROUP_CONNECTIONS) {
-      if (bgpstream_reader_open_wait(el->reader) != 0) {
-        return -1;
-      }
-      outstanding = 0;
-      last = NULL;
-    } else {
-      last = el->reader;
+    need_one = 0;
+    // open this resource (without waiting for it, unless too many are being
+    // opened already)
+    if (open_res_el(q, gp, el) != 0 || opening_push(q, el->reader) != 0) {
+      return -1;
     }
     el = el->next;
   }
 
-  if (outstanding > 0 && last != NULL) {
-    if (bgpstream_reader_open_wait(last) != 0) {
-      return -1;
+  return 0;
+}
+
+// does the list have a resource that has been opened (or is being opened)?
+static int res_list_has_reader(struct res_list_elem *el)
+{
+  for (; el != NULL; el = el->next) {
+    if (el->reader != NULL) {
+      return 1;
     }
   }
-
   return 0;
 }
 
 static int open_group(bgpstream_resource_mgr_t *q, struct res_group *gp)
 {
+  int need_rib = 0, need_upd = 0;
+
   // do nothing if everything is open
   if (gp->res_open_cnt == gp->res_cnt) {
     return 0;
   }
 
+  // regardless of the open budget, the head group must have a resource open
+  // in the list that pop_record reads from
+  if (gp == q->head) {
+    if (gp->res_list[BGPSTREAM_RIB] != NULL) {
+      need_rib = !res_list_has_reader(gp->res_list[BGPSTREAM_RIB]);
+    } else {
+      need_upd = !res_list_has_reader(gp->res_list[BGPSTREAM_UPDATE]);
+    }
+  }
+
   // first open RIBs
-  if (open_res_list(q, gp, gp->res_list[BGPSTREAM_RIB]) != 0) {
+  if (open_res_list(q, gp, gp->res_list[BGPSTREAM_RIB], need_rib) != 0) {
     return -1;
   }
 
   // then open updates
-  if (open_res_list(q, gp, gp->res_list[BGPSTREAM_UPDATE]) != 0) {
+  if (open_res_list(q, gp, gp->res_list[BGPSTREAM_UPDATE], need_upd) != 0) {
     return -1;
   }
 
@@ -512,7 +777,7 @@ static void pop_res_el(bgpstream_resource_mgr_t *q, struct res_group *gp,
   assert(q->res_stream_cnt >= 0);
   assert(q->res_stream_cnt <= q->res_cnt);
   assert(gp->res_open_checked_cnt <= gp->res_open_cnt);
-  assert(gp->res_open_cnt >= gp->res_cnt);
+  assert(gp->res_open_cnt <= gp->res_cnt);
   assert(gp->res_cnt <= q->res_cnt);
   assert(gp->res_open_cnt <= q->res_open_cnt);
 
@@ -553,6 +818,159 @@ static void reap_groups(bgpstream_resource_mgr_t *q)
   }
 }
 
+/* ========== MERGE HEAP ========== */
+
+// should a be read before b?
+static int heap_el_before(struct res_list_elem *a, struct res_list_elem *b)
+{
+  if (a->heap_time != b->heap_time) {
+    return a->heap_time < b->heap_time;
+  }
+  // RIBs are read before updates with the same timestamp
+  if (a->res->record_type != b->res->record_type) {
+    return a->res->record_type == BGPSTREAM_RIB;
+  }
+  return a->heap_seq < b->heap_seq;
+}
+
+static void heap_swap(bgpstream_resource_mgr_t *q, int i, int j)
+{
+  struct res_list_elem *tmp = q->heap[i];
+  q->heap[i] = q->heap[j];
+  q->heap[j] = tmp;
+  q->heap[i]->heap_idx = i;
+  q->heap[j]->heap_idx = j;
+}
+
+// restore the heap property for the elem at idx after its key changed
+static void heap_fix(bgpstream_resource_mgr_t *q, int idx)
+{
+  int parent, child;
+
+  // sift up
+  while (idx > 0) {
+    parent = (idx - 1) / 2;
+    if (!heap_el_before(q->heap[idx], q->heap[parent])) {
+      break;
+    }
+    heap_swap(q, idx, parent);
+    idx = parent;
+  }
+
+  // sift down
+  while ((child = 2 * idx + 1) < q->heap_cnt) {
+    if (child + 1 < q->heap_cnt &&
+        heap_el_before(q->heap[child + 1], q->heap[child])) {
+      child++;
+    }
+    if (!heap_el_before(q->heap[child], q->heap[idx])) {
+      break;
+    }
+    heap_swap(q, idx, child);
+    idx = child;
+  }
+}
+
+// adds an open resource to the end of the heap array (without restoring the
+// heap property)
+static int heap_append(bgpstream_resource_mgr_t *q, struct res_list_elem *el)
+{
+  struct res_list_elem **new_heap;
+  int new_alloc;
+
+  assert(el->heap_idx == -1 && el->open != 0);
+
+  if (q->heap_cnt == q->heap_alloc) {
+    new_alloc = (q->heap_alloc == 0) ? 64 : q->heap_alloc * 2;
+    if ((new_heap = realloc(q->heap, sizeof(struct res_list_elem *) *
+                                       new_alloc)) == NULL) {
+      return -1;
+    }
+    q->heap = new_heap;
+    q->heap_alloc = new_alloc;
+  }
+
+  el->heap_idx = q->heap_cnt;
+  q->heap[q->heap_cnt++] = el;
+
+  // count the resource
+  q->res_cnt++;
+  q->res_open_cnt++;
+  if (el->res->duration == BGPSTREAM_FOREVER) {
+    q->res_stream_cnt++;
+  }
+
+  return 0;
+}
+
+static int heap_push(bgpstream_resource_mgr_t *q, struct res_list_elem *el)
+{
+  el->heap_time = get_next_time(el);
+  el->heap_seq = q->heap_seq++;
+  if (heap_append(q, el) != 0) {
+    return -1;
+  }
+  heap_fix(q, el->heap_idx);
+  return 0;
+}
+
+static void heap_remove(bgpstream_resource_mgr_t *q, struct res_list_elem *el)
+{
+  int idx = el->heap_idx;
+
+  assert(idx >= 0 && idx < q->heap_cnt && q->heap[idx] == el);
+
+  q->heap_cnt--;
+  if (idx != q->heap_cnt) {
+    q->heap[idx] = q->heap[q->heap_cnt];
+    q->heap[idx]->heap_idx = idx;
+    // in unordered mode the array is not a heap
+    if (q->unordered == 0) {
+      heap_fix(q, idx);
+    }
+  }
+  el->heap_idx = -1;
+
+  q->res_cnt--;
+  q->res_open_cnt--;
+  if (el->res->duration == BGPSTREAM_FOREVER) {
+    q->res_stream_cnt--;
+  }
+}
+
+// move the resources of every group that has been fully opened and sorted into
+// the merge heap (and reap the emptied groups)
+static int activate_groups(bgpstream_resource_mgr_t *q)
+{
+  struct res_group *gp;
+  struct res_list_elem *el;
+  int empty_groups = 0;
+  int i;
+
+  for (gp = q->head; gp != NULL; gp = gp->next) {
+    if (gp->res_cnt == 0 || gp->res_open_checked_cnt != gp->res_cnt) {
+      continue;
+    }
+    // RIBs first so that they keep their priority over updates
+    for (i = _BGPSTREAM_RECORD_TYPE_CNT - 1; i >= 0; i--) {
+      while ((el = gp->res_list[i]) != NULL) {
+        pop_res_el(q, gp, el);
+        if (heap_push(q, el) != 0) {
+          res_list_destroy(el, 1);
+          return -1;
+        }
+      }
+    }
+    empty_groups++;
+  }
+
+  if (empty_groups != 0) {
+    reap_groups(q);
+  }
+
+  return 0;
+}
+
 static int sort_res_list(bgpstream_resource_mgr_t *q, struct res_group *gp,
                          struct res_list_elem *el)
 {
@@ -610,8 +1028,10 @@ static int sort_batch(bgpstream_resource_mgr_t *q)
   int empty_groups = 0;
   int dirty_cnt_total = 0, dirty_cnt = 0;
 
-  // wait for the batch to open first
-  while (cur != NULL && cur->res_open_cnt != 0) {
+  // wait for the batch to open first (but not for any groups after it that are
+  // being prefetched)
+  while (cur != NULL && cur->res_open_cnt != 0 &&
+         cur->time <= q->batch_end_time) {
 
     if (cur->res_open_checked_cnt == cur->res_open_cnt) {
       cur = cur->next;
@@ -648,12 +1068,16 @@ static int open_batch(bgpstream_resource_mgr_t *q, struct res_group *gp)
   uint32_t last_overlap_end = 0;
   uint32_t original_time = 0;
 
+  q->open_deferred = 0;
+
   while (cur != NULL && (first != 0 || last_overlap_end > cur->overlap_start)) {
     // this is included in the batch
 
     if (open_group(q, cur) != 0) {
+      opening_clear(q);
       return -1;
     }
+    q->batch_end_time = cur->time;
 
     if (first == 1) {
         original_time = cur->time;
@@ -672,33 +1096,119 @@ static int open_batch(bgpstream_resource_mgr_t *q, struct res_group *gp)
 
     cur = cur->next;
   }
+  // the whole batch is being opened now, sort_batch waits for it
+  opening_clear(q);
+
+  // let the user know when the budget is serialising the batch
+  if (q->open_deferred != 0 && q->open_limited == 0) {
+    bgpstream_log(BGPSTREAM_LOG_INFO,
+                  "Open budget (%d readers, %" PRIu64
+                  " bytes) reached, deferring opening %d overlapping "
+                  "resources",
+                  q->max_open, bgpstream_mem_get_limit(q->mem),
+                  q->open_deferred);
+  }
+  q->open_limited = (q->open_deferred != 0);
 
   return 0;
 }
 
+// waits until it is time to poll the given (stream) resource again. rather
+// than sleep for the whole poll interval, we wake up as soon as any stream
+// reader decodes new data. if keep_exported is set, or we are in non-blocking
+// mode, returns AGAIN instead of waiting.
+static bgpstream_reader_status_t wait_poll(bgpstream_resource_mgr_t *q,
+                                           struct res_list_elem *el,
+                                           int keep_exported)
+{
+  uint32_t now = epoch_msec();
+
+  if (el->next_poll > now &&
+      bgpstream_worker_pool_get_event_seq(q->pool) == el->poll_seq) {
+    if (keep_exported != 0 || q->nonblocking != 0) {
+      // part way through a batch (or the user will wait for the event fd), so
+      // don't wait for more data
+      q->would_block = 1;
+      return BGPSTREAM_READER_STATUS_AGAIN;
+    }
+    bgpstream_worker_pool_wait_event(q->pool, el->poll_seq,
+                                     el->next_poll - now);
+  }
+  el->next_poll = 0;
+
+  return BGPSTREAM_READER_STATUS_OK;
+}
+
+// the records exported by a resource at EOS may still be in use (e.g., by an
+// earlier record in the same batch), so the resource is only destroyed when the
+// user next asks for records
+static void retire_res_el(bgpstream_resource_mgr_t *q, struct res_list_elem *el)
+{
+  el->prev = NULL;
+  el->next = q->retired;
+  q->retired = el;
+}
+
+static void reap_retired(bgpstream_resource_mgr_t *q)
+{
+  struct res_list_elem *el;
+
+  while ((el = q->retired) != NULL) {
+    q->retired = el->next;
+    el->next = NULL;
+    res_list_destroy(el, 1);
+  }
+}
+
+// returns the resource that pop_record should read from, or NULL if it has not
+// been opened yet. if the open budget left some resources of the head group
+// unopened, the first open one is moved to the head of its list.
+static struct res_list_elem *head_res_el(bgpstream_resource_mgr_t *q)
+{
+  struct res_list_elem **list;
+  struct res_list_elem *el;
+
+  if (q->head->res_list[BGPSTREAM_RIB] != NULL) {
+    list = &q->head->res_list[BGPSTREAM_RIB];
+  } else {
+    list = &q->head->res_list[BGPSTREAM_UPDATE];
+  }
+
+  for (el = *list; el != NULL && el->open == 0; el = el->next)
+    ;
+  if (el != NULL && el != *list) {
+    // unlink, and push to the head of the list
+    el->prev->next = el->next;
+    if (el->next != NULL) {
+      el->next->prev = el->prev;
+    }
+    el->prev = NULL;
+    el->next = *list;
+    (*list)->prev = el;
+    *list = el;
+  }
+
+  return el;
+}
+
 // when this is called we are guaranteed to have at least one open resource, and
 // if things have gone right, we should read from the first resource in the
 // queue. once we have read from the resource, we should check the new time of
 // the resource and see if it needs to be moved.
 static bgpstream_reader_status_t pop_record(bgpstream_resource_mgr_t *q,
-                                            bgpstream_record_t **record)
+                                            bgpstream_record_t **record,
+                                            int keep_exported)
 {
   uint32_t prev_time;
   bgpstream_reader_status_t rs;
   struct res_list_elem *el = NULL;
   struct res_group *gp = NULL;
-  uint32_t now;
-  uint64_t sleep_nsec;
-  struct timespec rqtp;
+  uint64_t poll_seq;
 
   // the resource we want to read from MUST be in the first group (q->head), and
-  // will either be the head of the RIBS list if there are any ribs, otherwise
-  // it will be the head of the updates list
-  if (q->head->res_list[BGPSTREAM_RIB] != NULL) {
-    el = q->head->res_list[BGPSTREAM_RIB];
-  } else {
-    el = q->head->res_list[BGPSTREAM_UPDATE];
-  }
+  // will either be the first open resource of the RIBS list if there are any
+  // ribs, otherwise it will be the first open resource of the updates list
+  el = head_res_el(q);
   assert(el != NULL && el->res != NULL);
   assert(el->prev == NULL);
   assert(el->open != 0);
@@ -706,18 +1216,9 @@ static bgpstream_reader_status_t pop_record(bgpstream_resource_mgr_t *q,
   // we assume that if this resource has a poll timer set that has not expired
   // then since it would have been pushed to the end of the group and as such
   // all other resources already polled.
-  if (el->next_poll > 0) {
-    now = epoch_msec();
-    if (el->next_poll > now) {
-      sleep_nsec = (el->next_poll - now) * MSEC_TO_NSEC;
-      rqtp.tv_sec = sleep_nsec / 1000000000;
-      rqtp.tv_nsec = sleep_nsec % 1000000000;
-      if (nanosleep(&rqtp, NULL) != 0) {
-        // interrupted
-        return -1;
-      }
-    }
-    el->next_poll = 0;
+  if (el->next_poll > 0 &&
+      (rs = wait_poll(q, el, keep_exported)) != BGPSTREAM_READER_STATUS_OK) {
+    return rs;
   }
 
   // cache the current time so we can check if we need to remove and re-insert
@@ -726,7 +1227,9 @@ static bgpstream_reader_status_t pop_record(bgpstream_resource_mgr_t *q,
   // ask the resource to give us the next record (that it has already read). it
   // will internally grab the next record from the resource and update the time
   // of the resource.
-  if ((rs = bgpstream_reader_get_next_record(el->reader, record)) ==
+  poll_seq = bgpstream_worker_pool_get_event_seq(q->pool);
+  if ((rs = bgpstream_reader_get_next_record(el->reader, record,
+                                              keep_exported)) ==
       BGPSTREAM_READER_STATUS_ERROR) {
     // some kind of error occurred
     bgpstream_log(BGPSTREAM_LOG_ERR, "Failed to get next record from reader");
@@ -736,6 +1239,7 @@ static bgpstream_reader_status_t pop_record(bgpstream_resource_mgr_t *q,
   // if we got AGAIN, then move ourselves to the end of our group to give others
   // a fair shake
   if (rs == BGPSTREAM_READER_STATUS_AGAIN) {
+    bgpstream_perf_add_poll_again(q->perf);
     assert(el->prev == NULL);
     assert(q->head->res_list[el->res->record_type] == el);
     if (el->next != NULL) {
@@ -761,6 +1265,7 @@ static bgpstream_reader_status_t pop_record(bgpstream_resource_mgr_t *q,
     // and then tell the caller that while we didn't get anything useful, they
     // should try again soon
     el->next_poll = epoch_msec() + AGAIN_POLL_INTERVAL;
+    el->poll_seq = poll_seq;
     assert(q->head->res_list[el->res->record_type]->prev == NULL);
     return rs;
   }
@@ -790,8 +1295,8 @@ static bgpstream_reader_status_t pop_record(bgpstream_resource_mgr_t *q,
     }
 
     if (rs == BGPSTREAM_READER_STATUS_EOS) {
-      // we're at EOS, so destroy the resource
-      res_list_destroy(el, 1);
+      // we're at EOS, so retire the resource
+      retire_res_el(q, el);
     } else if (get_next_time(el) != prev_time) {
       // time has changed, so we need to re-insert
       if (insert_resource_elem(q, el) < 0) {
@@ -804,143 +1309,373 @@ static bgpstream_reader_status_t pop_record(bgpstream_resource_mgr_t *q,
   return rs;
 }
 
-static int wanted_resource(bgpstream_resource_t *res,
-                           bgpstream_filter_mgr_t *filter_mgr)
+// heap merge version of pop_record. reads from the resource at the top of the
+// heap and then re-positions it based on its new next time.
+static bgpstream_reader_status_t heap_pop_record(bgpstream_resource_mgr_t *q,
+                                                 bgpstream_record_t **record,
+                                                 int keep_exported)
 {
-  char buffer[BUFFER_LEN];
-  khiter_t k;
-  int khret;
+  bgpstream_reader_status_t rs;
+  struct res_list_elem *el = q->heap[0];
+  uint64_t poll_seq;
 
-  if (res->record_type != BGPSTREAM_RIB || filter_mgr->rib_period == 0) {
-    // its an updates file or there is no rib period set
-    return 1;
+  assert(el->open != 0);
+
+  // as with the groups, if the top of the heap has an unexpired poll timer then
+  // every other resource with the same time has already been polled
+  if (el->next_poll > 0 &&
+      (rs = wait_poll(q, el, keep_exported)) != BGPSTREAM_READER_STATUS_OK) {
+    return rs;
   }
 
-  snprintf(buffer, BUFFER_LEN, "%s.%s", res->project, res->collector);
+  poll_seq = bgpstream_worker_pool_get_event_seq(q->pool);
+  if ((rs = bgpstream_reader_get_next_record(el->reader, record,
+                                              keep_exported)) ==
+      BGPSTREAM_READER_STATUS_ERROR) {
+    // some kind of error occurred
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Failed to get next record from reader");
+    return rs;
+  }
 
-  if ((k = kh_get(collector_ts, filter_mgr->last_processed_ts, buffer)) ==
-      kh_end(filter_mgr->last_processed_ts)) {
-    // first time we've seen a rib for this collector
-    k = kh_put(collector_ts, filter_mgr->last_processed_ts, strdup(buffer),
-               &khret);
-    kh_value(filter_mgr->last_processed_ts, k) = res->initial_time;
-    return 1;
+  if (rs == BGPSTREAM_READER_STATUS_AGAIN) {
+    bgpstream_perf_add_poll_again(q->perf);
+    // move behind everything else with the same time and type
+    el->heap_time = get_next_time(el);
+    el->heap_seq = q->heap_seq++;
+    heap_fix(q, 0);
+    el->next_poll = epoch_msec() + AGAIN_POLL_INTERVAL;
+    el->poll_seq = poll_seq;
+    return rs;
   }
 
-  if (res->initial_time <
-      kh_value(filter_mgr->last_processed_ts, k) + filter_mgr->rib_period) {
-    // still within our period
-    return 0;
+  // otherwise we must valid, or EOS
+  assert(rs == BGPSTREAM_READER_STATUS_EOS || rs == BGPSTREAM_READER_STATUS_OK);
+
+  if (rs == BGPSTREAM_READER_STATUS_EOS) {
+    heap_remove(q, el);
+    retire_res_el(q, el);
+  } else if (get_next_time(el) != el->heap_time) {
+    el->heap_time = get_next_time(el);
+    heap_fix(q, 0);
   }
 
-  // we've found a rib we like!
-  kh_value(filter_mgr->last_processed_ts, k) = res->initial_time;
-  return 1;
+  return rs;
 }
 
-/* ========== PUBLIC METHODS BELOW HERE ========== */
+/* ========== READ-AHEAD SHARES ========== */
 
-bgpstream_resource_mgr_t *
-bgpstream_resource_mgr_create(bgpstream_filter_mgr_t *filter_mgr)
+/* Number of records returned between re-shares of the read-ahead */
+#define READAHEAD_SHARE_RECORDS 1024
+
+// adds an open (non-stream) resource to the end of the share order
+static int ra_order_add(bgpstream_resource_mgr_t *q, struct res_list_elem *el,
+                        int *cnt)
 {
-  bgpstream_resource_mgr_t *q;
+  struct res_list_elem **order;
 
-  if ((q = malloc_zero(sizeof(bgpstream_resource_mgr_t))) == NULL) {
-    return NULL;
+  if (el->open == 0 || el->res->duration == BGPSTREAM_FOREVER) {
+    return 0;
   }
+  if (*cnt == q->ra_alloc) {
+    if ((order = realloc(q->ra_order, sizeof(struct res_list_elem *) *
+                                        (q->ra_alloc * 2 + 16))) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not realloc read-ahead order");
+      return -1;
+    }
+    q->ra_order = order;
+    q->ra_alloc = q->ra_alloc * 2 + 16;
+  }
+  q->ra_order[(*cnt)++] = el;
+  return 0;
+}
 
-  q->filter_mgr = filter_mgr;
+static int heap_el_cmp(const void *a, const void *b)
+{
+  struct res_list_elem *ela = *(struct res_list_elem *const *)a;
+  struct res_list_elem *elb = *(struct res_list_elem *const *)b;
 
-  return q;
+  return heap_el_before(ela, elb) ? -1 : heap_el_before(elb, ela);
 }
 
-void bgpstream_resource_mgr_destroy(bgpstream_resource_mgr_t *q)
+// shares the read-ahead of the open resources (the configured depth for each)
+// out between them by how soon their records will be merged. the reader at the
+// merge frontier gets the largest share (close to twice the depth), falling
+// off linearly to the reader whose next record is furthest away, so that a
+// slow transport at the frontier (e.g., a RIB fetched over HTTP) is not held
+// up by workers decoding records that are not needed yet.
+static int share_readahead(bgpstream_resource_mgr_t *q)
 {
-  if (q == NULL) {
-    return;
-  }
-  struct res_group *cur = q->head;
+  struct res_group *gp;
+  struct res_list_elem *el;
+  int cnt = 0;
+  int grow;
+  int i;
 
-  while (cur != NULL) {
-    q->head = cur->next;
-    res_group_destroy(cur, 1);
-    cur = q->head;
+  q->ra_records = 0;
+  if (q->reader_readahead == 0 || q->unordered != 0) {
+    return 0;
   }
-  q->tail = NULL;
-
-  // filter manager is a borrowed pointer
-  q->filter_mgr = NULL;
-
-  free(q);
-}
 
-int bgpstream_resource_mgr_push(
-  bgpstream_resource_mgr_t *q,
-  bgpstream_resource_transport_type_t transport_type,
-  bgpstream_resource_format_type_t format_type, const char *url,
-  uint32_t initial_time, uint32_t duration, const char *project,
-  const char *collector, bgpstream_record_type_t record_type,
-  bgpstream_resource_t **resp)
+  if (q->heap_merge != 0) {
+    for (i = 0; i < q->heap_cnt; i++) {
+      if (ra_order_add(q, q->heap[i], &cnt) != 0) {
+        return -1;
+      }
+    }
+    qsort(q->ra_order, cnt, sizeof(struct res_list_elem *), heap_el_cmp);
+  } else {
+    // open resources are kept in the group of their next time (RIBs first)
+    for (gp = q->head; gp != NULL; gp = gp->next) {
+      for (i = _BGPSTREAM_RECORD_TYPE_CNT - 1; i >= 0; i--) {
+        for (el = gp->res_list[i]; el != NULL; el = el->next) {
+          if (ra_order_add(q, el, &cnt) != 0) {
+            return -1;
+          }
+        }
+      }
+    }
+  }
+  if (cnt < 2) {
+    return 0;
+  }
+
+  // the shares add up to the depth of every reader, so the rings only need
+  // to grow for the readers near the frontier (and not if memory is short)
+  grow = !bgpstream_mem_over_limit(q->mem);
+  for (i = 0; i < cnt; i++) {
+    bgpstream_reader_set_readahead_share(
+      q->ra_order[i]->reader,
+      (int)((int64_t)2 * q->reader_readahead * (cnt - i) / (cnt + 1)), grow);
+  }
+
+  return 0;
+}
+
+/* ========== UNORDERED MODE ========== */
+
+// open resources from the head of the queue until we have (at least) one for
+// every worker to decode, ignoring the order of the resources
+static int unordered_fill(bgpstream_resource_mgr_t *q)
 {
-  bgpstream_resource_t *res = NULL;
+  struct res_group *gp;
+  struct res_list_elem *el;
+  int i, rc;
+
+  while (q->head != NULL && q->heap_cnt < q->worker_threads) {
+    gp = q->head;
+    rc = open_group(q, gp);
+    opening_clear(q);
+    if (rc != 0) {
+      return -1;
+    }
+    for (i = _BGPSTREAM_RECORD_TYPE_CNT - 1; i >= 0; i--) {
+      while ((el = gp->res_list[i]) != NULL) {
+        if (bgpstream_reader_open_wait(el->reader) != 0) {
+          return -1;
+        }
+        el->open = 1;
+        gp->res_open_checked_cnt++;
+        pop_res_el(q, gp, el);
+        if (heap_append(q, el) != 0) {
+          res_list_destroy(el, 1);
+          return -1;
+        }
+      }
+    }
+    reap_groups(q);
+  }
+
+  return 0;
+}
+
+// reads from the first open resource that has a record ready to be exported
+// (trying each in turn), or if none are ready, waits for the next one in turn
+static bgpstream_reader_status_t
+unordered_pop_record(bgpstream_resource_mgr_t *q, bgpstream_record_t **record,
+                     int keep_exported)
+{
+  bgpstream_reader_status_t rs;
   struct res_list_elem *el = NULL;
-  if (resp != NULL) {
-    *resp = NULL;
+  uint64_t poll_seq;
+  int idx = 0;
+  int i;
+
+  for (i = 0; i < q->heap_cnt; i++) {
+    idx = (q->unordered_next + i) % q->heap_cnt;
+    if (bgpstream_reader_ready(q->heap[idx]->reader) != 0) {
+      el = q->heap[idx];
+      break;
+    }
+  }
+  if (el == NULL) {
+    if (keep_exported != 0 || q->nonblocking != 0) {
+      // part way through a batch (or the user will wait for the event fd), so
+      // don't wait for a record
+      q->would_block = 1;
+      return BGPSTREAM_READER_STATUS_AGAIN;
+    }
+    idx = q->unordered_next % q->heap_cnt;
+    el = q->heap[idx];
   }
+  q->unordered_next = idx + 1;
 
-  // first create the resource
-  if ((res = bgpstream_resource_create(transport_type, format_type, url,
-                                       initial_time, duration, project,
-                                       collector, record_type)) == NULL) {
-    return -1;
+  if (el->next_poll > 0 &&
+      (rs = wait_poll(q, el, keep_exported)) != BGPSTREAM_READER_STATUS_OK) {
+    return rs;
   }
 
-  // before we insert, lets check if it matches our RIB period filter (if we
-  // have one)
-  if (wanted_resource(res, q->filter_mgr) == 0) {
-    bgpstream_resource_destroy(res);
+  poll_seq = bgpstream_worker_pool_get_event_seq(q->pool);
+  if ((rs = bgpstream_reader_get_next_record(el->reader, record,
+                                              keep_exported)) ==
+      BGPSTREAM_READER_STATUS_ERROR) {
+    // some kind of error occurred
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Failed to get next record from reader");
+    return rs;
+  }
+
+  if (rs == BGPSTREAM_READER_STATUS_AGAIN) {
+    bgpstream_perf_add_poll_again(q->perf);
+    el->next_poll = epoch_msec() + AGAIN_POLL_INTERVAL;
+    el->poll_seq = poll_seq;
+  } else if (rs == BGPSTREAM_READER_STATUS_EOS) {
+    heap_remove(q, el);
+    retire_res_el(q, el);
+  }
+
+  return rs;
+}
+
+// is the resource in the time slice of its collector that is assigned to our
+// shard? consecutive slices of a collector go to consecutive shards, and the
+// shard of its first slice is given by a hash of the collector name
+static int in_shard(bgpstream_resource_t *res,
+                    bgpstream_filter_mgr_t *filter_mgr, const char *name)
+{
+  uint32_t slice = 0;
+  uint32_t hash;
+
+  if (filter_mgr->shard_cnt == 0) {
+    return 1;
+  }
+
+  // stream resources have no end, so they are only sharded by collector
+  if (res->duration != BGPSTREAM_FOREVER) {
+    slice = res->initial_time / filter_mgr->shard_span;
+  }
+  hash = kh_str_hash_func(name);
+
+  return ((hash % filter_mgr->shard_cnt) + (slice % filter_mgr->shard_cnt)) %
+           filter_mgr->shard_cnt ==
+         filter_mgr->shard;
+}
+
+static int wanted_resource(bgpstream_resource_t *res,
+                           bgpstream_filter_mgr_t *filter_mgr)
+{
+  char buffer[BUFFER_LEN];
+  khiter_t k;
+  int khret;
+
+  snprintf(buffer, BUFFER_LEN, "%s.%s", res->project, res->collector);
+
+  // shard first so that the rib period applies to the ribs in our shard
+  if (in_shard(res, filter_mgr, buffer) == 0) {
     return 0;
   }
 
-  // now create a list element to hold the resource
-  if ((el = res_list_elem_create(res)) == NULL) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create list element");
-    goto err;
+  if (res->record_type != BGPSTREAM_RIB || filter_mgr->rib_period == 0) {
+    // its an updates file or there is no rib period set
+    return 1;
   }
 
-  // now we know we want to keep it
-  if (insert_resource_elem(q, el) < 0) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not insert resource into queue");
-    goto err;
+  if ((k = kh_get(collector_ts, filter_mgr->last_processed_ts, buffer)) ==
+      kh_end(filter_mgr->last_processed_ts)) {
+    // first time we've seen a rib for this collector
+    k = kh_put(collector_ts, filter_mgr->last_processed_ts, strdup(buffer),
+               &khret);
+    kh_value(filter_mgr->last_processed_ts, k) = res->initial_time;
+    return 1;
   }
 
-  if (resp != NULL) {
-    *resp = res;
+  if (res->initial_time <
+      kh_value(filter_mgr->last_processed_ts, k) + filter_mgr->rib_period) {
+    // still within our period
+    return 0;
   }
-  return 1;
 
-err:
-  res_list_destroy(el, 1);
-  bgpstream_resource_destroy(res);
-  return -1;
+  // we've found a rib we like!
+  kh_value(filter_mgr->last_processed_ts, k) = res->initial_time;
+  return 1;
 }
 
-int bgpstream_resource_mgr_empty(bgpstream_resource_mgr_t *q)
+// starts opening the resources in groups that are after the current batch but
+// start within the prefetch horizon of the given (current) time, so that their
+// connection setup and first read overlap with reading the current batch. does
+// not wait for the opens to complete.
+static int prefetch_groups(bgpstream_resource_mgr_t *q, uint32_t now)
 {
-  return (q->head == NULL);
+  struct res_group *gp;
+  struct res_list_elem *el;
+  int pending = 0;
+  int i;
+
+  // only look again once time has moved on
+  if (now == q->prefetch_time) {
+    return 0;
+  }
+  q->prefetch_time = now;
+
+  for (gp = q->head; gp != NULL && gp->time <= now + q->prefetch_horizon;
+       gp = gp->next) {
+    if (gp->time <= q->batch_end_time ||
+        gp->res_open_checked_cnt == gp->res_cnt) {
+      continue;
+    }
+    // RIBs first, since they will be read first
+    for (i = _BGPSTREAM_RECORD_TYPE_CNT - 1; i >= 0; i--) {
+      for (el = gp->res_list[i]; el != NULL; el = el->next) {
+        if (el->reader != NULL) {
+          if (el->open == 0 && bgpstream_reader_open_done(el->reader) == 0) {
+            pending++;
+          }
+          continue;
+        }
+        // leave some workers free for the resources we are reading now
+        if (pending >= PREFETCH_MAX_PENDING || OPEN_BUDGET_FULL) {
+          return 0;
+        }
+        if (open_res_el(q, gp, el) != 0) {
+          return -1;
+        }
+        pending++;
+      }
+    }
+  }
+
+  return 0;
 }
 
-int bgpstream_resource_mgr_stream_only(bgpstream_resource_mgr_t *q)
+// drains the event fd (if the user is waiting on it) before we look for data,
+// so that data that arrives after we look makes it readable again
+static void clear_fd(bgpstream_resource_mgr_t *q)
 {
-  return (q->res_stream_cnt == q->res_cnt);
+  if (q->nonblocking != 0 && q->pool != NULL) {
+    bgpstream_worker_pool_clear_event_fd(q->pool);
+  }
 }
 
-int bgpstream_resource_mgr_get_record(bgpstream_resource_mgr_t *q,
-                                      bgpstream_record_t **record)
+// gets the next record in order. if keep_exported is set then records returned
+// by previous calls remain valid, and rather than wait for a stream resource to
+// have more data, 0 is returned (or BGPSTREAM_WOULD_BLOCK in non-blocking
+// mode).
+static int get_record(bgpstream_resource_mgr_t *q, bgpstream_record_t **record,
+                      int keep_exported)
 {
   int rs = BGPSTREAM_READER_STATUS_EOS;
   int dirty_cnt = 0;
 
+  q->would_block = 0;
+
   // don't let EOF mean EOS until we have no more resources left
   while (rs == BGPSTREAM_READER_STATUS_EOS ||
          rs == BGPSTREAM_READER_STATUS_AGAIN) {
@@ -949,12 +1684,67 @@ int bgpstream_resource_mgr_get_record(bgpstream_resource_mgr_t *q,
       return 0;
     }
 
+    if (q->unordered != 0) {
+      if (unordered_fill(q) != 0) {
+        goto err;
+      }
+      assert(q->heap_cnt != 0);
+
+      if ((rs = unordered_pop_record(q, record, keep_exported)) ==
+          BGPSTREAM_READER_STATUS_ERROR) {
+        return -1;
+      } else if (rs == BGPSTREAM_READER_STATUS_OK) {
+        return 1;
+      } else if (rs == BGPSTREAM_READER_STATUS_AGAIN && keep_exported != 0) {
+        return 0;
+      } else if (q->would_block != 0) {
+        return BGPSTREAM_WOULD_BLOCK;
+      }
+      continue;
+    }
+
+    if (q->heap_merge != 0) {
+      // open (and sort) any resources that may have records at, or before, the
+      // earliest record we have open
+      while (q->head != NULL &&
+             (q->heap_cnt == 0 || q->head->time <= HEAP_TOP_TIME)) {
+        if (open_batch(q, q->head) != 0 || sort_batch(q) < 0 ||
+            activate_groups(q) != 0) {
+          goto err;
+        }
+      }
+      assert(q->heap_cnt != 0);
+
+      if ((rs = heap_pop_record(q, record, keep_exported)) ==
+          BGPSTREAM_READER_STATUS_ERROR) {
+        return -1;
+      } else if (rs == BGPSTREAM_READER_STATUS_OK) {
+        if (q->prefetch_horizon != 0 && q->heap_cnt != 0 &&
+            prefetch_groups(q, HEAP_TOP_TIME) != 0) {
+          goto err;
+        }
+        if (++q->ra_records == READAHEAD_SHARE_RECORDS &&
+            share_readahead(q) != 0) {
+          goto err;
+        }
+        return 1;
+      } else if (rs == BGPSTREAM_READER_STATUS_AGAIN && keep_exported != 0) {
+        return 0;
+      } else if (q->would_block != 0) {
+        return BGPSTREAM_WOULD_BLOCK;
+      }
+      continue;
+    }
+
     // we know we have something in the queue, but if we have nothing open, then
     // it is time to open some resources!
     // we do this inside a loop since in some cases the first batch we open get
     // sorted elsewhere in the queue, leaving the head still unopened.
     dirty_cnt = 0;
-    while (q->head->res_open_cnt != q->head->res_cnt || dirty_cnt > 0) {
+    while ((!OPEN_BUDGETED
+              ? q->head->res_open_checked_cnt != q->head->res_cnt
+              : head_res_el(q) == NULL) ||
+           dirty_cnt > 0) {
       if (open_batch(q, q->head) != 0) {
         goto err;
       }
@@ -972,10 +1762,23 @@ int bgpstream_resource_mgr_get_record(bgpstream_resource_mgr_t *q,
     assert(q->res_open_cnt != 0);
 
     // we now know that we have open resources to read from, lets do it
-    if ((rs = pop_record(q, record)) == BGPSTREAM_READER_STATUS_ERROR) {
+    if ((rs = pop_record(q, record, keep_exported)) ==
+        BGPSTREAM_READER_STATUS_ERROR) {
       return -1;
     } else if (rs == BGPSTREAM_READER_STATUS_OK) {
+      if (q->prefetch_horizon != 0 && q->head != NULL &&
+          prefetch_groups(q, q->head->time) != 0) {
+        goto err;
+      }
+      if (++q->ra_records == READAHEAD_SHARE_RECORDS &&
+          share_readahead(q) != 0) {
+        goto err;
+      }
       return 1;
+    } else if (rs == BGPSTREAM_READER_STATUS_AGAIN && keep_exported != 0) {
+      return 0;
+    } else if (q->would_block != 0) {
+      return BGPSTREAM_WOULD_BLOCK;
     }
     // otherwise, could be EOS or AGAIN, so keep trying (from other resources in
     // the case of EOS)
@@ -984,3 +1787,420 @@ int bgpstream_resource_mgr_get_record(bgpstream_resource_mgr_t *q,
 err:
   return -1;
 }
+
+// gets the next record from get_record, by way of the reorder buffer
+static int get_reordered_record(bgpstream_resource_mgr_t *q,
+                                bgpstream_record_t **record, int keep_exported)
+{
+  bgpstream_record_t *rec;
+  int rc;
+
+  while ((*record = bgpstream_reorder_pop(q->reorder, 0)) == NULL) {
+    if ((rc = get_record(q, &rec, keep_exported)) == 0 && q->res_cnt == 0) {
+      // no more records are coming, so those we hold are in order
+      *record = bgpstream_reorder_pop(q->reorder, 1);
+      return (*record != NULL);
+    }
+    if (rc <= 0) {
+      // error, or no record right now
+      return rc;
+    }
+    if (bgpstream_reorder_push(q->reorder, rec) != 0) {
+      return -1;
+    }
+  }
+
+  return 1;
+}
+
+/* ========== PUBLIC METHODS BELOW HERE ========== */
+
+bgpstream_resource_mgr_t *
+bgpstream_resource_mgr_create(bgpstream_filter_mgr_t *filter_mgr)
+{
+  bgpstream_resource_mgr_t *q;
+
+  if ((q = malloc_zero(sizeof(bgpstream_resource_mgr_t))) == NULL) {
+    return NULL;
+  }
+
+  q->filter_mgr = filter_mgr;
+  q->worker_threads = DEFAULT_WORKER_THREADS;
+
+  if ((q->record_pool = bgpstream_record_pool_create(RECORD_POOL_SIZE)) ==
+        NULL ||
+      (q->mem = bgpstream_mem_create()) == NULL ||
+      (q->perf = bgpstream_perf_create()) == NULL ||
+      (q->breaker = bgpstream_breaker_create()) == NULL) {
+    bgpstream_record_pool_destroy(q->record_pool);
+    bgpstream_mem_destroy(q->mem);
+    bgpstream_perf_destroy(q->perf);
+    free(q);
+    return NULL;
+  }
+
+  return q;
+}
+
+void bgpstream_resource_mgr_set_reader_readahead(bgpstream_resource_mgr_t *q,
+                                                 int readahead)
+{
+  q->reader_readahead = readahead;
+}
+
+int bgpstream_resource_mgr_set_max_open(bgpstream_resource_mgr_t *q,
+                                        int max_open)
+{
+  if (max_open < 0) {
+    return -1;
+  }
+  q->max_open = max_open;
+  return 0;
+}
+
+bgpstream_mem_t *bgpstream_resource_mgr_get_mem(bgpstream_resource_mgr_t *q)
+{
+  return q->mem;
+}
+
+bgpstream_perf_t *bgpstream_resource_mgr_get_perf(bgpstream_resource_mgr_t *q)
+{
+  return q->perf;
+}
+
+int bgpstream_resource_mgr_get_open_cnt(bgpstream_resource_mgr_t *q)
+{
+  return q->res_open_cnt;
+}
+
+void bgpstream_resource_mgr_set_prefetch(bgpstream_resource_mgr_t *q,
+                                         uint32_t horizon)
+{
+  q->prefetch_horizon = horizon;
+}
+
+void bgpstream_resource_mgr_set_unordered(bgpstream_resource_mgr_t *q)
+{
+  q->unordered = 1;
+}
+
+int bgpstream_resource_mgr_set_max_skew(bgpstream_resource_mgr_t *q,
+                                        uint32_t max_skew)
+{
+  bgpstream_reorder_destroy(q->reorder);
+  if ((q->reorder =
+         bgpstream_reorder_create(max_skew, REORDER_MAX_RECORDS)) == NULL) {
+    return -1;
+  }
+  return 0;
+}
+
+void bgpstream_resource_mgr_set_nonblocking(bgpstream_resource_mgr_t *q)
+{
+  q->nonblocking = 1;
+}
+
+int bgpstream_resource_mgr_get_fd(bgpstream_resource_mgr_t *q)
+{
+  if (create_pool(q) != 0) {
+    return -1;
+  }
+  return bgpstream_worker_pool_get_event_fd(q->pool);
+}
+
+void bgpstream_resource_mgr_set_heap_merge(bgpstream_resource_mgr_t *q)
+{
+  assert(q->res_cnt == 0);
+  q->heap_merge = 1;
+}
+
+int bgpstream_resource_mgr_set_worker_threads(bgpstream_resource_mgr_t *q,
+                                              int threads)
+{
+  if (q->ctx != NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "The worker threads of a stream in a context are set on "
+                  "the context");
+    return -1;
+  }
+  if (q->pool != NULL || threads <= 0) {
+    return -1;
+  }
+  q->worker_threads = threads;
+  return 0;
+}
+
+int bgpstream_resource_mgr_set_thread_affinity(
+  bgpstream_resource_mgr_t *q, bgpstream_thread_affinity_t policy,
+  const char *cpus)
+{
+  if (q->pool != NULL) {
+    return -1;
+  }
+  if (q->ctx != NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "The worker threads of a stream in a context are placed by "
+                  "the context");
+    return -1;
+  }
+  return bgpstream_affinity_init(&q->affinity, policy, cpus);
+}
+
+int bgpstream_resource_mgr_set_context(bgpstream_resource_mgr_t *q,
+                                       bgpstream_context_t *ctx)
+{
+  if (q->pool != NULL || q->res_cnt != 0 || q->ctx != NULL) {
+    return -1;
+  }
+
+  // nothing has used our own yet
+  bgpstream_record_pool_destroy(q->record_pool);
+  bgpstream_breaker_destroy(q->breaker);
+
+  q->ctx = bgpstream_context_retain(ctx);
+  q->record_pool = bgpstream_context_get_record_pool(ctx);
+  q->breaker = bgpstream_context_get_breaker(ctx);
+  return 0;
+}
+
+static void res_list_set_filter_mgr(struct res_list_elem *el,
+                                    bgpstream_filter_mgr_t *filter_mgr)
+{
+  for (; el != NULL; el = el->next) {
+    if (el->reader != NULL) {
+      bgpstream_reader_set_filter_mgr(el->reader, filter_mgr);
+    }
+  }
+}
+
+void bgpstream_resource_mgr_set_filter_mgr(bgpstream_resource_mgr_t *q,
+                                           bgpstream_filter_mgr_t *filter_mgr)
+{
+  struct res_group *gp;
+  int i;
+
+  q->filter_mgr = filter_mgr;
+
+  // every reader still around, including the retired ones whose records the
+  // user may hold
+  for (gp = q->head; gp != NULL; gp = gp->next) {
+    for (i = 0; i < _BGPSTREAM_RECORD_TYPE_CNT; i++) {
+      res_list_set_filter_mgr(gp->res_list[i], filter_mgr);
+    }
+  }
+  for (i = 0; i < q->heap_cnt; i++) {
+    // heap elems are not linked to each other
+    if (q->heap[i]->reader != NULL) {
+      bgpstream_reader_set_filter_mgr(q->heap[i]->reader, filter_mgr);
+    }
+  }
+  res_list_set_filter_mgr(q->retired, filter_mgr);
+}
+
+void bgpstream_resource_mgr_destroy(bgpstream_resource_mgr_t *q)
+{
+  if (q == NULL) {
+    return;
+  }
+
+  // hand the records we hold back to their readers (or to the pool)
+  bgpstream_reorder_destroy(q->reorder);
+  q->reorder = NULL;
+
+  struct res_group *cur = q->head;
+
+  while (cur != NULL) {
+    q->head = cur->next;
+    res_group_destroy(cur, 1);
+    cur = q->head;
+  }
+  q->tail = NULL;
+
+  int i;
+  for (i = 0; i < q->heap_cnt; i++) {
+    res_list_destroy(q->heap[i], 1);
+  }
+  free(q->heap);
+  q->heap = NULL;
+  q->heap_cnt = q->heap_alloc = 0;
+
+  free(q->ra_order);
+  q->ra_order = NULL;
+  q->ra_alloc = 0;
+
+  reap_retired(q);
+
+  // all readers are gone, so the workers are idle (at least as far as we are
+  // concerned, if they are the context's)
+  bgpstream_worker_pool_destroy(q->pool);
+  q->pool = NULL;
+
+  // and no longer need their records
+  if (q->ctx == NULL) {
+    bgpstream_record_pool_destroy(q->record_pool);
+  }
+  q->record_pool = NULL;
+
+  bgpstream_mem_destroy(q->mem);
+  q->mem = NULL;
+
+  bgpstream_perf_destroy(q->perf);
+  q->perf = NULL;
+
+  if (q->ctx == NULL) {
+    bgpstream_breaker_destroy(q->breaker);
+  }
+  q->breaker = NULL;
+
+  bgpstream_context_destroy(q->ctx);
+  q->ctx = NULL;
+
+  // filter manager is a borrowed pointer
+  q->filter_mgr = NULL;
+
+  free(q);
+}
+
+// check the summary of a dump file (if it has one) against the elem filters
+static int summary_may_pass(bgpstream_resource_t *res,
+                            bgpstream_filter_mgr_t *filter_mgr)
+{
+  bgpstream_summary_t *summary;
+  int may_pass;
+
+  if (filter_mgr->use_summaries == 0 || res->duration == BGPSTREAM_FOREVER ||
+      (filter_mgr->peer_asns == NULL && filter_mgr->origin_asns == NULL &&
+       filter_mgr->prefixes == NULL && filter_mgr->ipversion == 0)) {
+    return 1;
+  }
+  if ((summary = bgpstream_summary_load(res->url)) == NULL) {
+    return 1;
+  }
+  if ((may_pass = bgpstream_summary_filter_may_pass(summary, filter_mgr)) ==
+      0) {
+    bgpstream_log(BGPSTREAM_LOG_FINE,
+                  "Skipping %s: no elem of its summary passes the filters",
+                  res->url);
+  }
+  bgpstream_summary_destroy(summary);
+  return may_pass;
+}
+
+int bgpstream_resource_mgr_push(
+  bgpstream_resource_mgr_t *q,
+  bgpstream_resource_transport_type_t transport_type,
+  bgpstream_resource_format_type_t format_type, const char *url,
+  uint32_t initial_time, uint32_t duration, const char *project,
+  const char *collector, bgpstream_record_type_t record_type,
+  bgpstream_resource_t **resp)
+{
+  bgpstream_resource_t *res = NULL;
+  struct res_list_elem *el = NULL;
+  if (resp != NULL) {
+    *resp = NULL;
+  }
+
+  // first create the resource
+  if ((res = bgpstream_resource_create(transport_type, format_type, url,
+                                       initial_time, duration, project,
+                                       collector, record_type)) == NULL) {
+    return -1;
+  }
+  res->mem = q->mem;
+  res->perf = q->perf;
+  res->breaker = q->breaker;
+
+  // before we insert, lets check if it matches our RIB period filter (if we
+  // have one), and whether its summary shows that it is worth opening
+  if (wanted_resource(res, q->filter_mgr) == 0 ||
+      summary_may_pass(res, q->filter_mgr) == 0) {
+    bgpstream_resource_destroy(res);
+    return 0;
+  }
+
+  // now create a list element to hold the resource
+  if ((el = res_list_elem_create(res)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create list element");
+    goto err;
+  }
+
+  // now we know we want to keep it
+  if (insert_resource_elem(q, el) < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not insert resource into queue");
+    goto err;
+  }
+
+  if (resp != NULL) {
+    *resp = res;
+  }
+  return 1;
+
+err:
+  res_list_destroy(el, 1);
+  bgpstream_resource_destroy(res);
+  return -1;
+}
+
+int bgpstream_resource_mgr_empty(bgpstream_resource_mgr_t *q)
+{
+  return (q->head == NULL && q->heap_cnt == 0 &&
+          (q->reorder == NULL || bgpstream_reorder_get_cnt(q->reorder) == 0));
+}
+
+int bgpstream_resource_mgr_stream_only(bgpstream_resource_mgr_t *q)
+{
+  return (q->res_stream_cnt == q->res_cnt);
+}
+
+int bgpstream_resource_mgr_get_record(bgpstream_resource_mgr_t *q,
+                                      bgpstream_record_t **record)
+{
+  bgpstream_perf_timer_t timer;
+  int rc;
+
+  // reading the records is timed by the stages nested inside this one
+  bgpstream_perf_start(q->perf, &timer);
+  reap_retired(q);
+  clear_fd(q);
+  if (q->reorder != NULL) {
+    bgpstream_reorder_release(q->reorder);
+    rc = get_reordered_record(q, record, 0);
+  } else {
+    rc = get_record(q, record, 0);
+  }
+  bgpstream_perf_stop(q->perf, BGPSTREAM_PERF_STAGE_MERGE, &timer);
+  return rc;
+}
+
+int bgpstream_resource_mgr_get_records(bgpstream_resource_mgr_t *q,
+                                       bgpstream_record_t **records, int n)
+{
+  bgpstream_perf_timer_t timer;
+  int i;
+  int rc = 0;
+
+  bgpstream_perf_start(q->perf, &timer);
+  reap_retired(q);
+  clear_fd(q);
+  if (q->reorder != NULL) {
+    bgpstream_reorder_release(q->reorder);
+  }
+
+  for (i = 0; i < n; i++) {
+    // only the first record may wait for data
+    rc = (q->reorder != NULL) ? get_reordered_record(q, &records[i], i > 0)
+                              : get_record(q, &records[i], i > 0);
+    if (rc <= 0) {
+      break;
+    }
+  }
+  bgpstream_perf_stop(q->perf, BGPSTREAM_PERF_STAGE_MERGE, &timer);
+
+  if (rc == BGPSTREAM_WOULD_BLOCK) {
+    return rc;
+  }
+  if (rc < 0) {
+    return -1;
+  }
+  return i;
+}
@@ -44,6 +44,187 @@ bgpstream_resource_mgr_create(bgpstream_filter_mgr_t *filter_mgr);
 /** Destroy the given resource queue */
 void bgpstream_resource_mgr_destroy(bgpstream_resource_mgr_t *q);
 
+/** Set the number of records that readers decode ahead of the consumer
+ *
+ * @param q             pointer to the queue
+ * @param readahead     number of records to decode ahead (0 to disable)
+ *
+ * Only affects resources that are opened after this call. This is the depth
+ * given to each reader on average: as records are read, readers whose next
+ * record is closer to the one being merged are given more read-ahead than
+ * those whose records are not needed yet.
+ */
+void bgpstream_resource_mgr_set_reader_readahead(bgpstream_resource_mgr_t *q,
+                                                 int readahead);
+
+/** Merge open resources using a min-heap instead of the time-ordered groups
+ *
+ * @param q             pointer to the queue
+ *
+ * Resources are still grouped by time until they have been opened, but once
+ * open they are kept in a heap keyed on the time of their next record (with
+ * RIBs before updates at the same time), so re-positioning a resource after a
+ * read is O(log n) rather than a walk of the group list. Must be called before
+ * any resources are added to the queue.
+ */
+void bgpstream_resource_mgr_set_heap_merge(bgpstream_resource_mgr_t *q);
+
+/** Limit the number of resources that are open at once
+ *
+ * @param q             pointer to the queue
+ * @param max_open      maximum number of open resources (0 for no limit)
+ * @return 0 if the limit was set, -1 if it is invalid
+ *
+ * Overlapping resources are normally all opened together. With a limit,
+ * resources beyond it are only opened once they are the next to be read, so
+ * records are still returned in order (e.g., RIBs with the same timestamp are
+ * read one after another rather than at the same time). The limit is exceeded
+ * only when that is the only way to keep records in order. Ignored in heap
+ * merge and unordered modes.
+ */
+int bgpstream_resource_mgr_set_max_open(bgpstream_resource_mgr_t *q,
+                                        int max_open);
+
+/** Get the memory accounting of the queue
+ *
+ * @param q             pointer to the queue
+ * @return pointer to the memory accounting that the resources of the queue
+ * count their buffers in
+ *
+ * Once the limit set on it is reached, resources are opened as if the open
+ * budget (see bgpstream_resource_mgr_set_max_open) were used up.
+ */
+struct bgpstream_mem *
+bgpstream_resource_mgr_get_mem(bgpstream_resource_mgr_t *q);
+
+/** Get the throughput accounting of the queue
+ *
+ * @param q             pointer to the queue
+ * @return pointer to the throughput accounting that the resources of the queue
+ * count their reads and time in
+ */
+struct bgpstream_perf *
+bgpstream_resource_mgr_get_perf(bgpstream_resource_mgr_t *q);
+
+/** Get the number of open resources
+ *
+ * @param q             pointer to the queue
+ * @return the number of resources whose readers are open
+ */
+int bgpstream_resource_mgr_get_open_cnt(bgpstream_resource_mgr_t *q);
+
+/** Open resources before they are needed
+ *
+ * @param q             pointer to the queue
+ * @param horizon       how far ahead (in seconds) to open resources (0 to
+ *                      disable)
+ *
+ * Resources in groups that start within horizon seconds of the record being
+ * read are opened (and their first record read) in the background, so that
+ * reading them does not have to wait for the transport to connect. Ignored in
+ * unordered mode.
+ */
+void bgpstream_resource_mgr_set_prefetch(bgpstream_resource_mgr_t *q,
+                                         uint32_t horizon);
+
+/** Return records as soon as any open resource has one, rather than in time
+ * order
+ *
+ * @param q             pointer to the queue
+ *
+ * Resources are opened (roughly oldest first) until there is one for every
+ * worker thread, and each decodes records ahead of the consumer on the worker
+ * pool. Records from a single resource are still returned in the order they
+ * appear in the resource. Must be called before any resources are added to the
+ * queue.
+ */
+void bgpstream_resource_mgr_set_unordered(bgpstream_resource_mgr_t *q);
+
+/** Put records that are slightly out of order back into time order
+ *
+ * @param q             pointer to the queue
+ * @param max_skew      how far (in seconds) a record may be behind the latest
+ *                      record returned by its resource
+ * @return 0 if the reorder buffer was created successfully, -1 otherwise
+ *
+ * Records are held in a small buffer until no record within max_skew of the
+ * latest one can come before them. Must be called before any records are read.
+ */
+int bgpstream_resource_mgr_set_max_skew(bgpstream_resource_mgr_t *q,
+                                        uint32_t max_skew);
+
+/** Return rather than wait when no stream resource has a record
+ *
+ * @param q             pointer to the queue
+ *
+ * In non-blocking mode, bgpstream_resource_mgr_get_record(s) return
+ * BGPSTREAM_WOULD_BLOCK instead of waiting for a stream resource to decode
+ * data. The file descriptor returned by bgpstream_resource_mgr_get_fd becomes
+ * readable when there may be data again.
+ */
+void bgpstream_resource_mgr_set_nonblocking(bgpstream_resource_mgr_t *q);
+
+/** Get a file descriptor that becomes readable when a record may be available
+ *
+ * @param q             pointer to the queue
+ * @return a file descriptor owned by the queue, -1 if an error occurred
+ *
+ * Starts the worker threads if they have not already been started.
+ */
+int bgpstream_resource_mgr_get_fd(bgpstream_resource_mgr_t *q);
+
+/** Switch the queue and its readers to another filter manager
+ *
+ * @param q             pointer to the queue
+ * @param filter_mgr    pointer to the filter manager to use from now on
+ *
+ * Resources that are pushed from now on are checked against the new filters,
+ * while those already in the queue are read with them. Once this returns, the
+ * previous filter manager is no longer used by the queue.
+ */
+void bgpstream_resource_mgr_set_filter_mgr(bgpstream_resource_mgr_t *q,
+                                           bgpstream_filter_mgr_t *filter_mgr);
+
+/** Set the number of worker threads used to open and decode resources
+ *
+ * @param q             pointer to the queue
+ * @param threads       number of threads (must be > 0)
+ * @return 0 if the number was set, -1 if it is invalid or the workers have
+ * already been started
+ *
+ * The workers are started the first time a resource is opened and are shared
+ * by all resources for the lifetime of the queue.
+ */
+int bgpstream_resource_mgr_set_worker_threads(bgpstream_resource_mgr_t *q,
+                                              int threads);
+
+/** Set where the worker threads run
+ *
+ * @param q             pointer to the queue
+ * @param policy        how to place the threads on CPUs
+ * @param cpus          list of the CPUs that the threads may use, or NULL for
+ *                      every CPU of the process
+ * @return 0 if the placement was set, -1 if it is invalid, the workers have
+ * already been started, or they are those of a context
+ */
+int bgpstream_resource_mgr_set_thread_affinity(
+  bgpstream_resource_mgr_t *q, bgpstream_thread_affinity_t policy,
+  const char *cpus);
+
+/** Share the workers, record pool and host breaker of a stream context
+ *
+ * @param q             pointer to the queue
+ * @param ctx           pointer to the context to share
+ * @return 0 if the context was set, -1 if the queue has already been used (or
+ * already has a context)
+ *
+ * The queue holds a reference to the context until it is destroyed. The number
+ * of worker threads of the queue then only bounds how many resources it opens
+ * at once.
+ */
+int bgpstream_resource_mgr_set_context(bgpstream_resource_mgr_t *q,
+                                       bgpstream_context_t *ctx);
+
 /** Add a resource item to the queue
  *
  * @param q               pointer to the queue
@@ -87,10 +268,29 @@ int bgpstream_resource_mgr_stream_only(bgpstream_resource_mgr_t *q);
  * @param[out] record   set to a borrowed pointer to a record if the return
  *                      code is >0
  * @return >0 if a record was read successfully, 0 if end-of-stream has been
- * reached, <0 if an error occurred.
+ * reached, BGPSTREAM_WOULD_BLOCK if in non-blocking mode and no record is
+ * available yet, <0 if an error occurred.
  *
  */
 int bgpstream_resource_mgr_get_record(bgpstream_resource_mgr_t *q,
                                       bgpstream_record_t **record);
 
+/** Get a batch of records from the stream, in order
+ *
+ * @param q             pointer to the queue
+ * @param[out] records  array of at least n pointers, the first (return value)
+ *                      of which are set to borrowed pointers to records
+ * @param n             maximum number of records to get
+ * @return the number of records read (0 if end-of-stream has been reached),
+ * BGPSTREAM_WOULD_BLOCK if in non-blocking mode and no record is available yet,
+ * <0 if an error occurred.
+ *
+ * All of the records remain valid until the next call to this function (or to
+ * bgpstream_resource_mgr_get_record). Only the first record may wait for a
+ * stream resource to have data, so fewer than n records may be returned even
+ * if the stream has not ended.
+ */
+int bgpstream_resource_mgr_get_records(bgpstream_resource_mgr_t *q,
+                                       bgpstream_record_t **records, int n);
+
 #endif /* __BGPSTREAM_RESOURCE_MGR_H */
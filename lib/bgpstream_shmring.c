@@ -0,0 +1,455 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_shmring.h"
+#include "bgpstream_log.h"
+#include "utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Ring magic ("BSSHMRNG") and version */
+#define SHMRING_MAGIC "BSSHMRNG"
+#define SHMRING_VERSION 1
+
+/** Smallest size of the data of a ring */
+#define SHMRING_MIN_SIZE (64 * 1024)
+
+/** Largest size of the data of a ring */
+#define SHMRING_MAX_SIZE ((uint64_t)1 << 40)
+
+/** Size of a cache line: the fields written by the writer and by each reader
+    live on separate lines, so that they do not slow each other down */
+#define CACHE_LINE 64
+
+/** Number of times to yield before sleeping while waiting on the other end */
+#define WAIT_SPIN_CNT 64
+
+/** How long to sleep for while waiting on the other end (at most) */
+#define WAIT_SLEEP_USEC 1000
+
+/** How often to check that the other end is still alive while waiting */
+#define WAIT_ALIVE_MSEC 1000
+
+/** Position of one reader (as stored in the shared memory object) */
+typedef struct ring_reader {
+
+  /** Number of bytes that the reader has read (only valid if pid is set) */
+  uint64_t tail;
+
+  /** PID of the reader, 0 if the slot is free */
+  uint32_t pid;
+
+  uint8_t unused[CACHE_LINE - 12];
+
+} ring_reader_t;
+
+/** Header of the shared memory object, which the data of the ring follows */
+typedef struct ring_hdr {
+
+  /** Written last by the writer, once the ring is ready */
+  char magic[8];
+
+  uint32_t version;
+  uint32_t readers_max;
+
+  /** Size of the data (a power of two) */
+  uint64_t size;
+
+  /** PID of the writer */
+  uint32_t writer_pid;
+
+  /** Set once the writer has written its last message */
+  uint32_t closed;
+
+  uint8_t unused[CACHE_LINE - 32];
+
+  /** Number of bytes that the writer has written */
+  uint64_t head;
+
+  uint8_t unused_head[CACHE_LINE - 8];
+
+  ring_reader_t readers[BGPSTREAM_SHMRING_READERS_MAX];
+
+} ring_hdr_t;
+
+struct bgpstream_shmring {
+
+  /** Name of the shared memory object (starting with a '/') */
+  char *name;
+
+  /** Shared mapping of the object */
+  void *map;
+  size_t map_len;
+  ring_hdr_t *hdr;
+  uint8_t *data;
+  uint64_t mask;
+
+  /** Is this the writer */
+  int writer;
+
+  /** Slot of this reader, NULL for the writer */
+  ring_reader_t *reader;
+
+  /** Number of bytes written (by the writer) or read (by a reader). This is
+      the only copy that is ever read, the shared one is for the other end */
+  uint64_t pos;
+};
+
+// build the name of the shared memory object of a ring
+static char *object_name(const char *name)
+{
+  char *obj;
+
+  if (*name == '/') {
+    name++;
+  }
+  if (*name == '\0' || strchr(name, '/') != NULL ||
+      (obj = malloc(strlen(name) + 2)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid shared memory ring name '%s'",
+                  name);
+    return NULL;
+  }
+  obj[0] = '/';
+  strcpy(obj + 1, name);
+  return obj;
+}
+
+// wait a little for the other end, yielding at first and then sleeping for
+// longer and longer. returns 1 once it is time to check that the other end is
+// still alive
+static int wait_other_end(int *waits, uint64_t *alive_ms)
+{
+  int nap;
+
+  if (*waits < WAIT_SPIN_CNT) {
+    (*waits)++;
+    sched_yield();
+    return 0;
+  }
+  nap = (*waits - WAIT_SPIN_CNT + 1) * 10;
+  if (nap < WAIT_SLEEP_USEC) {
+    (*waits)++;
+  } else {
+    nap = WAIT_SLEEP_USEC;
+  }
+  usleep(nap);
+
+  if (*alive_ms == 0) {
+    *alive_ms = epoch_msec();
+  } else if (epoch_msec() - *alive_ms >= WAIT_ALIVE_MSEC) {
+    *alive_ms = epoch_msec();
+    return 1;
+  }
+  return 0;
+}
+
+static int pid_alive(uint32_t pid)
+{
+  return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+}
+
+// the position of the slowest reader, or that of the writer if there are no
+// readers
+static uint64_t min_tail(bgpstream_shmring_t *ring, int reap)
+{
+  ring_reader_t *rd;
+  uint64_t tail, min = ring->pos;
+  uint32_t pid;
+  int i;
+
+  for (i = 0; i < BGPSTREAM_SHMRING_READERS_MAX; i++) {
+    rd = &ring->hdr->readers[i];
+    // (pairs with the claim of a slot by a reader, see bgpstream_shmring_read)
+    if ((pid = __atomic_load_n(&rd->pid, __ATOMIC_SEQ_CST)) == 0) {
+      continue;
+    }
+    // readers that are gone without detaching (i.e., crashed) would block
+    // the ring forever
+    if (reap && !pid_alive(pid)) {
+      bgpstream_log(BGPSTREAM_LOG_WARN,
+                    "Shared memory ring %s: reader %" PRIu32 " is gone",
+                    ring->name, pid);
+      __atomic_store_n(&rd->pid, 0, __ATOMIC_RELEASE);
+      continue;
+    }
+    tail = __atomic_load_n(&rd->tail, __ATOMIC_ACQUIRE);
+    if (tail < min) {
+      min = tail;
+    }
+  }
+  return min;
+}
+
+// map an open shared memory object of the given size
+static int map_object(bgpstream_shmring_t *ring, int fd, size_t map_len)
+{
+  if ((ring->map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                        0)) == MAP_FAILED) {
+    ring->map = NULL;
+    return -1;
+  }
+  ring->map_len = map_len;
+  ring->hdr = ring->map;
+  ring->data = (uint8_t *)(ring->hdr + 1);
+  return 0;
+}
+
+/* ==================== PUBLIC API BELOW HERE ==================== */
+
+bgpstream_shmring_t *bgpstream_shmring_create(const char *name, size_t size)
+{
+  bgpstream_shmring_t *ring;
+  uint64_t ring_size = SHMRING_MIN_SIZE;
+  int fd = -1;
+
+  if (size == 0) {
+    size = BGPSTREAM_SHMRING_DEFAULT_SIZE;
+  }
+  if ((uint64_t)size > SHMRING_MAX_SIZE) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Shared memory ring of %zu bytes is too "
+                                     "large", size);
+    return NULL;
+  }
+  while (ring_size < (uint64_t)size) {
+    ring_size <<= 1;
+  }
+
+  if ((ring = malloc_zero(sizeof(bgpstream_shmring_t))) == NULL ||
+      (ring->name = object_name(name)) == NULL) {
+    goto err;
+  }
+
+  // readers of a previous ring keep their mapping of it
+  shm_unlink(ring->name);
+  if ((fd = shm_open(ring->name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0 ||
+      ftruncate(fd, sizeof(ring_hdr_t) + ring_size) != 0 ||
+      map_object(ring, fd, sizeof(ring_hdr_t) + ring_size) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Could not create shared memory ring %s: %s", ring->name,
+                  strerror(errno));
+    goto err;
+  }
+  close(fd);
+  fd = -1;
+
+  ring->writer = 1;
+  ring->mask = ring_size - 1;
+  ring->hdr->version = SHMRING_VERSION;
+  ring->hdr->readers_max = BGPSTREAM_SHMRING_READERS_MAX;
+  ring->hdr->size = ring_size;
+  ring->hdr->writer_pid = (uint32_t)getpid();
+  // (readers check the magic before anything else)
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(ring->hdr->magic, SHMRING_MAGIC, sizeof(ring->hdr->magic));
+
+  return ring;
+
+err:
+  if (fd >= 0) {
+    close(fd);
+    shm_unlink(ring->name);
+  }
+  bgpstream_shmring_destroy(ring);
+  return NULL;
+}
+
+bgpstream_shmring_t *bgpstream_shmring_attach(const char *name)
+{
+  bgpstream_shmring_t *ring;
+  struct stat st;
+  uint32_t pid = (uint32_t)getpid(), free_pid;
+  int fd = -1, i;
+
+  if ((ring = malloc_zero(sizeof(bgpstream_shmring_t))) == NULL ||
+      (ring->name = object_name(name)) == NULL) {
+    goto err;
+  }
+
+  if ((fd = shm_open(ring->name, O_RDWR, 0)) < 0 || fstat(fd, &st) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open shared memory ring %s: %s",
+                  ring->name, strerror(errno));
+    goto err;
+  }
+  if ((size_t)st.st_size <= sizeof(ring_hdr_t) ||
+      map_object(ring, fd, st.st_size) != 0 ||
+      memcmp(ring->hdr->magic, SHMRING_MAGIC, sizeof(ring->hdr->magic)) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "%s is not a shared memory ring",
+                  ring->name);
+    goto err;
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (ring->hdr->version != SHMRING_VERSION ||
+      ring->hdr->readers_max != BGPSTREAM_SHMRING_READERS_MAX ||
+      sizeof(ring_hdr_t) + ring->hdr->size != (uint64_t)st.st_size) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Shared memory ring %s has an unsupported format",
+                  ring->name);
+    goto err;
+  }
+  close(fd);
+  fd = -1;
+  ring->mask = ring->hdr->size - 1;
+
+  for (i = 0; i < BGPSTREAM_SHMRING_READERS_MAX && ring->reader == NULL;
+       i++) {
+    free_pid = 0;
+    if (__atomic_compare_exchange_n(&ring->hdr->readers[i].pid, &free_pid, pid,
+                                    0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+      ring->reader = &ring->hdr->readers[i];
+    }
+  }
+  if (ring->reader == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Shared memory ring %s already has %d readers", ring->name,
+                  BGPSTREAM_SHMRING_READERS_MAX);
+    goto err;
+  }
+  // start with the next message. the writer sees the slot before it sees this
+  // position, but (until then) the position left from the last reader of the
+  // slot only makes it wait for longer
+  ring->pos = __atomic_load_n(&ring->hdr->head, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&ring->reader->tail, ring->pos, __ATOMIC_RELEASE);
+
+  return ring;
+
+err:
+  if (fd >= 0) {
+    close(fd);
+  }
+  bgpstream_shmring_destroy(ring);
+  return NULL;
+}
+
+int bgpstream_shmring_write(bgpstream_shmring_t *ring, const uint8_t *buf,
+                            size_t len)
+{
+  uint64_t size = ring->mask + 1, off, alive_ms = 0;
+  size_t first;
+  int waits = 0, reap = 0;
+
+  if ((uint64_t)len > size) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Message of %zu bytes does not fit in shared memory ring %s",
+                  len, ring->name);
+    return -1;
+  }
+
+  // wait for the slowest reader to make room
+  while (ring->pos + len - min_tail(ring, reap) > size) {
+    reap = wait_other_end(&waits, &alive_ms);
+  }
+
+  off = ring->pos & ring->mask;
+  first = (size - off < len) ? (size_t)(size - off) : len;
+  memcpy(ring->data + off, buf, first);
+  memcpy(ring->data, buf + first, len - first);
+  ring->pos += len;
+  __atomic_store_n(&ring->hdr->head, ring->pos, __ATOMIC_SEQ_CST);
+  return 0;
+}
+
+int64_t bgpstream_shmring_read(bgpstream_shmring_t *ring, uint8_t *buf,
+                               int64_t len)
+{
+  uint64_t size = ring->mask + 1, off, head, alive_ms = 0;
+  size_t first;
+  int waits = 0;
+
+  while ((head = __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE)) ==
+         ring->pos) {
+    if (__atomic_load_n(&ring->hdr->closed, __ATOMIC_ACQUIRE) != 0) {
+      // (the writer may have written more just before closing)
+      if (__atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE) == ring->pos) {
+        return 0;
+      }
+      continue;
+    }
+    if (wait_other_end(&waits, &alive_ms) &&
+        !pid_alive(ring->hdr->writer_pid) &&
+        __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE) == ring->pos) {
+      bgpstream_log(BGPSTREAM_LOG_WARN,
+                    "Shared memory ring %s: writer is gone", ring->name);
+      return 0;
+    }
+  }
+  if (head - ring->pos > size) {
+    // only happens if the writer took this reader for a crashed one
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Shared memory ring %s was overwritten before it was read",
+                  ring->name);
+    return -1;
+  }
+
+  if ((uint64_t)len > head - ring->pos) {
+    len = head - ring->pos;
+  }
+  off = ring->pos & ring->mask;
+  first = (size - off < (uint64_t)len) ? (size_t)(size - off) : (size_t)len;
+  memcpy(buf, ring->data + off, first);
+  memcpy(buf + first, ring->data, len - first);
+  ring->pos += len;
+  __atomic_store_n(&ring->reader->tail, ring->pos, __ATOMIC_RELEASE);
+  return len;
+}
+
+int bgpstream_shmring_get_readers_cnt(bgpstream_shmring_t *ring)
+{
+  int i, cnt = 0;
+
+  for (i = 0; i < BGPSTREAM_SHMRING_READERS_MAX; i++) {
+    if (__atomic_load_n(&ring->hdr->readers[i].pid, __ATOMIC_RELAXED) != 0) {
+      cnt++;
+    }
+  }
+  return cnt;
+}
+
+void bgpstream_shmring_destroy(bgpstream_shmring_t *ring)
+{
+  if (ring == NULL) {
+    return;
+  }
+  if (ring->map != NULL) {
+    if (ring->reader != NULL) {
+      __atomic_store_n(&ring->reader->pid, 0, __ATOMIC_RELEASE);
+    } else if (ring->writer != 0) {
+      __atomic_store_n(&ring->hdr->closed, 1, __ATOMIC_RELEASE);
+      shm_unlink(ring->name);
+    }
+    munmap(ring->map, ring->map_len);
+  }
+  free(ring->name);
+  free(ring);
+}
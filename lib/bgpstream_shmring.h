@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_SHMRING_H
+#define __BGPSTREAM_SHMRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Header file that exposes the protected interface of the BGPStream
+ * shared-memory ring, which one process writes messages to, and which other
+ * processes on the same host read as a stream of bytes.
+ *
+ * The ring lives in a POSIX shared memory object. Every reader has its own
+ * position in the ring, and the writer waits for the slowest reader before it
+ * overwrites data, so readers never miss data (but a slow reader slows the
+ * writer down). A reader starts with the first message written after it
+ * attached, and only ever sees whole messages.
+ */
+
+/** Default size of the data of a ring, in bytes */
+#define BGPSTREAM_SHMRING_DEFAULT_SIZE (64 * 1024 * 1024)
+
+/** Maximum number of readers attached to a ring at once */
+#define BGPSTREAM_SHMRING_READERS_MAX 64
+
+/** Opaque structure that represents one end of a shared-memory ring */
+typedef struct bgpstream_shmring bgpstream_shmring_t;
+
+/** Create a new ring, as its writer
+ *
+ * @param name          name of the ring (e.g., "bgpstream"), a shared memory
+ *                      object that any previous ring of that name is replaced
+ *                      by
+ * @param size          size of the data of the ring, in bytes (rounded up to a
+ *                      power of two), or 0 for BGPSTREAM_SHMRING_DEFAULT_SIZE
+ * @return pointer to the ring if successful, NULL otherwise
+ */
+bgpstream_shmring_t *bgpstream_shmring_create(const char *name, size_t size);
+
+/** Attach to an existing ring, as a reader
+ *
+ * @param name          name of the ring
+ * @return pointer to the ring if successful, NULL otherwise (e.g., the ring
+ * does not exist, or already has BGPSTREAM_SHMRING_READERS_MAX readers)
+ */
+bgpstream_shmring_t *bgpstream_shmring_attach(const char *name);
+
+/** Write a message to the ring, waiting for the readers to make room for it
+ *
+ * @param ring          pointer to the ring (as its writer)
+ * @param buf           the message to write
+ * @param len           the length of the message (at most the size of the
+ *                      ring)
+ * @return 0 if successful, -1 otherwise
+ */
+int bgpstream_shmring_write(bgpstream_shmring_t *ring, const uint8_t *buf,
+                            size_t len);
+
+/** Read bytes from the ring, waiting for the writer if there are none
+ *
+ * @param ring          pointer to the ring (as a reader)
+ * @param buf           the buffer to read to
+ * @param len           the maximum number of bytes to read
+ * @return the number of bytes read, 0 once the writer has gone and every
+ * byte it wrote has been read, or -1 on error
+ */
+int64_t bgpstream_shmring_read(bgpstream_shmring_t *ring, uint8_t *buf,
+                               int64_t len);
+
+/** Get the number of readers attached to the ring
+ *
+ * @param ring          pointer to the ring
+ * @return the number of readers attached
+ */
+int bgpstream_shmring_get_readers_cnt(bgpstream_shmring_t *ring);
+
+/** Detach from the ring, and destroy it
+ *
+ * @param ring          pointer to the ring to destroy
+ *
+ * When the writer destroys the ring, its name is removed so that no reader may
+ * attach any more, but the readers already attached still read everything that
+ * was written to it.
+ */
+void bgpstream_shmring_destroy(bgpstream_shmring_t *ring);
+
+#endif /* __BGPSTREAM_SHMRING_H */
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_shmring_writer.h"
+#include "bgpstream_binary.h"
+#include "bgpstream_log.h"
+#include "bgpstream_shmring.h"
+#include "utils.h"
+#include <stdlib.h>
+
+struct bgpstream_shmring_writer {
+
+  bgpstream_shmring_t *ring;
+
+  // encoder of the records
+  bgpstream_binary_writer_t *bin;
+
+  // number of elems added to the record being written
+  int elems_cnt;
+};
+
+bgpstream_shmring_writer_t *bgpstream_shmring_writer_create(const char *name,
+                                                            size_t size)
+{
+  bgpstream_shmring_writer_t *writer;
+
+  if ((writer = malloc_zero(sizeof(bgpstream_shmring_writer_t))) == NULL ||
+      (writer->ring = bgpstream_shmring_create(name, size)) == NULL ||
+      (writer->bin = bgpstream_binary_writer_create()) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Could not create shared memory ring writer for %s", name);
+    bgpstream_shmring_writer_destroy(writer);
+    return NULL;
+  }
+  return writer;
+}
+
+int bgpstream_shmring_writer_begin_record(bgpstream_shmring_writer_t *writer,
+                                          const bgpstream_record_t *record)
+{
+  writer->elems_cnt = 0;
+  // every record starts a stream of its own, so that readers may attach at
+  // any record
+  bgpstream_binary_writer_reset(writer->bin);
+  return bgpstream_binary_writer_begin_record(writer->bin, record);
+}
+
+int bgpstream_shmring_writer_add_elem(bgpstream_shmring_writer_t *writer,
+                                      bgpstream_elem_t *elem)
+{
+  writer->elems_cnt++;
+  return bgpstream_binary_writer_add_elem(writer->bin, elem);
+}
+
+int bgpstream_shmring_writer_end_record(bgpstream_shmring_writer_t *writer)
+{
+  const uint8_t *buf;
+  ssize_t len;
+
+  if (writer->elems_cnt == 0) {
+    return 0;
+  }
+  if ((len = bgpstream_binary_writer_end_record(writer->bin, &buf)) < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not encode record");
+    return -1;
+  }
+  return bgpstream_shmring_write(writer->ring, buf, len);
+}
+
+int bgpstream_shmring_writer_get_readers_cnt(
+  bgpstream_shmring_writer_t *writer)
+{
+  return bgpstream_shmring_get_readers_cnt(writer->ring);
+}
+
+void bgpstream_shmring_writer_destroy(bgpstream_shmring_writer_t *writer)
+{
+  if (writer == NULL) {
+    return;
+  }
+  bgpstream_shmring_destroy(writer->ring);
+  bgpstream_binary_writer_destroy(writer->bin);
+  free(writer);
+}
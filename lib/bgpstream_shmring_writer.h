@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_SHMRING_WRITER_H
+#define __BGPSTREAM_SHMRING_WRITER_H
+
+#include "bgpstream_elem.h"
+#include "bgpstream_record.h"
+#include <stddef.h>
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of the BGPStream
+ * shared-memory ring writer, which hands the records and elems read from a
+ * stream to other processes on the same host.
+ *
+ * Records are written to a ring in a POSIX shared memory object, each as a
+ * complete binary stream (see bgpstream_binary.h) that holds the record and
+ * the elems added for it. Any number of processes (up to 64) read the ring
+ * using the singlefile data interface, with a binary file of
+ * "shm://<name>", e.g.:
+ *
+ *     bgpreader -d singlefile -o upd-type=binary -o upd-file=shm://bgpstream
+ *
+ * Readers start with the record written after they attached. The writer never
+ * overwrites a record that a reader has not read yet: it waits for the slowest
+ * reader instead.
+ */
+
+/**
+ * @name Public Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure that represents a shared-memory ring being written to */
+typedef struct bgpstream_shmring_writer bgpstream_shmring_writer_t;
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new shared-memory ring writer
+ *
+ * @param name          name of the ring (e.g., "bgpstream"), which replaces
+ *                      any previous ring of the same name
+ * @param size          size of the ring, in bytes (rounded up to a power of
+ *                      two), or 0 for the default (64 MiB). A record (with
+ *                      its elems) must fit in the ring.
+ * @return pointer to the writer if successful, NULL otherwise
+ */
+bgpstream_shmring_writer_t *bgpstream_shmring_writer_create(const char *name,
+                                                            size_t size);
+
+/** Start writing the given record
+ *
+ * @param writer        pointer to the writer
+ * @param record        pointer to the record to write
+ * @return 0 if successful, -1 otherwise
+ *
+ * The elems of the record are then added using
+ * bgpstream_shmring_writer_add_elem (so the caller chooses which elems to
+ * keep), and the record is written using bgpstream_shmring_writer_end_record.
+ */
+int bgpstream_shmring_writer_begin_record(bgpstream_shmring_writer_t *writer,
+                                          const bgpstream_record_t *record);
+
+/** Add the given elem to the record being written
+ *
+ * @param writer        pointer to the writer
+ * @param elem          pointer to the elem to add
+ * @return 0 if successful, -1 otherwise
+ */
+int bgpstream_shmring_writer_add_elem(bgpstream_shmring_writer_t *writer,
+                                      bgpstream_elem_t *elem);
+
+/** Write the current record to the ring, waiting for the readers to make room
+ * for it
+ *
+ * @param writer        pointer to the writer
+ * @return 0 if successful, -1 otherwise
+ *
+ * A record that no elem was added to is not written.
+ */
+int bgpstream_shmring_writer_end_record(bgpstream_shmring_writer_t *writer);
+
+/** Get the number of readers attached to the ring
+ *
+ * @param writer        pointer to the writer
+ * @return the number of readers attached
+ *
+ * Readers only see the records written after they attached, so a writer may
+ * use this to wait for its readers before it writes the first record.
+ */
+int bgpstream_shmring_writer_get_readers_cnt(
+  bgpstream_shmring_writer_t *writer);
+
+/** Destroy the writer
+ *
+ * @param writer        pointer to the writer to destroy
+ *
+ * Readers still read the records written so far, and then reach the end of
+ * the stream.
+ */
+void bgpstream_shmring_writer_destroy(bgpstream_shmring_writer_t *writer);
+
+/** @} */
+
+#endif /* __BGPSTREAM_SHMRING_WRITER_H */
@@ -0,0 +1,579 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_summary_int.h"
+#include "bgpstream_log.h"
+#include "khash.h"
+#include "utils.h"
+#include "wandio.h"
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// the summary file starts with this magic, followed by the format version
+#define SUMMARY_MAGIC "BSSUM"
+#define SUMMARY_MAGIC_LEN 5
+#define SUMMARY_VERSION 1
+
+// the family has at least one prefix
+#define SUMMARY_FLAG_HAS_V4 0x01
+#define SUMMARY_FLAG_HAS_V6 0x02
+// the family has prefixes shorter than a bucket, which are not in the buckets
+// bloom filter
+#define SUMMARY_FLAG_SHORT_V4 0x04
+#define SUMMARY_FLAG_SHORT_V6 0x08
+
+// number of leading bits of a prefix that give its bucket
+#define SUMMARY_BUCKET_LEN_V4 8
+#define SUMMARY_BUCKET_LEN_V6 32
+
+// filter prefixes that cover more buckets than this are not checked against
+// the buckets bloom filter, and are assumed to be matched (the false positives
+// of many lookups would make the check worthless anyway)
+#define SUMMARY_MAX_BUCKET_PROBES 256
+
+// with 10 bits per key and 7 hashes, about 1% of the lookups of keys that
+// were not added are false positives
+#define BLOOM_BITS_PER_KEY 10
+#define BLOOM_HASH_CNT 7
+#define BLOOM_MIN_BITS 64
+#define BLOOM_MAX_BITS (1 << 28)
+
+KHASH_SET_INIT_INT64(summary_bucket)
+
+// the bloom filters of a summary
+enum {
+  SUMMARY_BLOOM_PEER = 0,
+  SUMMARY_BLOOM_ORIGIN = 1,
+  SUMMARY_BLOOM_BUCKET = 2,
+  SUMMARY_BLOOM_CNT = 3,
+};
+
+typedef struct bloom {
+
+  // number of bits (always a power of two)
+  uint32_t nbits;
+
+  // number of bits set for each key
+  uint8_t k;
+
+  // nbits / 8 bytes of bits
+  uint8_t *bits;
+
+} bloom_t;
+
+struct bgpstream_summary {
+
+  // SUMMARY_FLAG_* flags
+  uint8_t flags;
+
+  // keys added to the summary being built (NULL when it was loaded)
+  bgpstream_id_set_t *peers;
+  bgpstream_id_set_t *origins;
+  khash_t(summary_bucket) *buckets;
+
+  // bloom filters of the keys (built when the summary is written)
+  bloom_t blooms[SUMMARY_BLOOM_CNT];
+};
+
+// splitmix64 finalizer, so that close keys (e.g., ASNs) set unrelated bits
+static uint64_t hash_key(uint64_t key)
+{
+  key += 0x9e3779b97f4a7c15ULL;
+  key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+  return key ^ (key >> 31);
+}
+
+static int bloom_init(bloom_t *bloom, uint32_t nbits, uint8_t k)
+{
+  bloom->nbits = nbits;
+  bloom->k = k;
+  if ((bloom->bits = malloc_zero(nbits / 8)) == NULL) {
+    return -1;
+  }
+  return 0;
+}
+
+// the k bits of a key are picked using double hashing
+static uint32_t bloom_bit(bloom_t *bloom, uint64_t hash, int i)
+{
+  uint32_t h1 = (uint32_t)hash;
+  uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+
+  return (h1 + (uint32_t)i * h2) & (bloom->nbits - 1);
+}
+
+static void bloom_add(bloom_t *bloom, uint64_t key)
+{
+  uint64_t hash = hash_key(key);
+  uint32_t bit;
+  int i;
+
+  for (i = 0; i < bloom->k; i++) {
+    bit = bloom_bit(bloom, hash, i);
+    bloom->bits[bit >> 3] |= (uint8_t)(1 << (bit & 7));
+  }
+}
+
+static int bloom_may_contain(bloom_t *bloom, uint64_t key)
+{
+  uint64_t hash = hash_key(key);
+  uint32_t bit;
+  int i;
+
+  for (i = 0; i < bloom->k; i++) {
+    bit = bloom_bit(bloom, hash, i);
+    if ((bloom->bits[bit >> 3] & (1 << (bit & 7))) == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int bloom_build_ids(bloom_t *bloom, bgpstream_id_set_t *ids)
+{
+  uint32_t nbits = BLOOM_MIN_BITS;
+  uint32_t *id;
+
+  while (nbits < BLOOM_MAX_BITS &&
+         nbits < (uint64_t)bgpstream_id_set_size(ids) * BLOOM_BITS_PER_KEY) {
+    nbits <<= 1;
+  }
+  if (bloom_init(bloom, nbits, BLOOM_HASH_CNT) != 0) {
+    return -1;
+  }
+  bgpstream_id_set_rewind(ids);
+  while ((id = bgpstream_id_set_next(ids)) != NULL) {
+    bloom_add(bloom, *id);
+  }
+  return 0;
+}
+
+static int bloom_build_buckets(bloom_t *bloom, khash_t(summary_bucket) *keys)
+{
+  uint32_t nbits = BLOOM_MIN_BITS;
+  khiter_t k;
+
+  while (nbits < BLOOM_MAX_BITS &&
+         nbits < (uint64_t)kh_size(keys) * BLOOM_BITS_PER_KEY) {
+    nbits <<= 1;
+  }
+  if (bloom_init(bloom, nbits, BLOOM_HASH_CNT) != 0) {
+    return -1;
+  }
+  for (k = kh_begin(keys); k != kh_end(keys); ++k) {
+    if (kh_exist(keys, k)) {
+      bloom_add(bloom, kh_key(keys, k));
+    }
+  }
+  return 0;
+}
+
+// bucket of the first bucket length bits of the address. the family is part
+// of the key, and does not depend on the value of AF_INET6 on the platform
+static uint64_t addr_bucket(const bgpstream_ip_addr_t *addr)
+{
+  uint32_t bucket;
+
+  if (addr->version == BGPSTREAM_ADDR_VERSION_IPV4) {
+    return ntohl(addr->bs_ipv4.addr.s_addr) >> (32 - SUMMARY_BUCKET_LEN_V4);
+  }
+  memcpy(&bucket, &addr->bs_ipv6.addr.s6_addr, sizeof(bucket));
+  return (1ULL << 32) | ntohl(bucket);
+}
+
+static int bucket_len(bgpstream_addr_version_t version)
+{
+  return version == BGPSTREAM_ADDR_VERSION_IPV4 ? SUMMARY_BUCKET_LEN_V4
+                                                : SUMMARY_BUCKET_LEN_V6;
+}
+
+static uint8_t has_flag(bgpstream_addr_version_t version)
+{
+  return version == BGPSTREAM_ADDR_VERSION_IPV4 ? SUMMARY_FLAG_HAS_V4
+                                                : SUMMARY_FLAG_HAS_V6;
+}
+
+static uint8_t short_flag(bgpstream_addr_version_t version)
+{
+  return version == BGPSTREAM_ADDR_VERSION_IPV4 ? SUMMARY_FLAG_SHORT_V4
+                                                : SUMMARY_FLAG_SHORT_V6;
+}
+
+bgpstream_summary_t *bgpstream_summary_create(void)
+{
+  bgpstream_summary_t *summary;
+
+  if ((summary = malloc_zero(sizeof(bgpstream_summary_t))) == NULL) {
+    return NULL;
+  }
+  if ((summary->peers = bgpstream_id_set_create()) == NULL ||
+      (summary->origins = bgpstream_id_set_create()) == NULL ||
+      (summary->buckets = kh_init(summary_bucket)) == NULL) {
+    goto err;
+  }
+  return summary;
+
+err:
+  bgpstream_summary_destroy(summary);
+  return NULL;
+}
+
+int bgpstream_summary_add_elem(bgpstream_summary_t *summary,
+                               bgpstream_elem_t *elem)
+{
+  bgpstream_as_path_t *path;
+  bgpstream_addr_version_t version;
+  uint32_t origin_asn;
+  int khret;
+
+  assert(summary->peers != NULL);
+
+  if (bgpstream_id_set_insert(summary->peers, elem->peer_asn) < 0) {
+    return -1;
+  }
+
+  // elems without an origin ASN never pass the origin ASN filters
+  if ((path = bgpstream_elem_get_as_path(elem)) != NULL &&
+      bgpstream_as_path_get_origin_val(path, &origin_asn) == 0 &&
+      bgpstream_id_set_insert(summary->origins, origin_asn) < 0) {
+    return -1;
+  }
+
+  // elems without a prefix (e.g., peer state changes) never pass the prefix
+  // and IP version filters
+  version = elem->prefix.address.version;
+  if (version != BGPSTREAM_ADDR_VERSION_IPV4 &&
+      version != BGPSTREAM_ADDR_VERSION_IPV6) {
+    return 0;
+  }
+  summary->flags |= has_flag(version);
+  if (elem->prefix.mask_len < bucket_len(version)) {
+    summary->flags |= short_flag(version);
+    return 0;
+  }
+  kh_put(summary_bucket, summary->buckets, addr_bucket(&elem->prefix.address),
+         &khret);
+  if (khret < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+static int write_bytes(iow_t *iow, const char *path, const void *buf,
+                       size_t len)
+{
+  if (wandio_wwrite(iow, buf, len) != (int64_t)len) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not write to %s", path);
+    return -1;
+  }
+  return 0;
+}
+
+int bgpstream_summary_write(bgpstream_summary_t *summary, const char *path)
+{
+  iow_t *iow = NULL;
+  uint8_t hdr[SUMMARY_MAGIC_LEN + 2];
+  uint32_t nbits;
+  bloom_t *bloom;
+  int i;
+
+  assert(summary->peers != NULL);
+
+  // (re)build the blooms now that all the keys are known
+  for (i = 0; i < SUMMARY_BLOOM_CNT; i++) {
+    free(summary->blooms[i].bits);
+    summary->blooms[i].bits = NULL;
+  }
+  if (bloom_build_ids(&summary->blooms[SUMMARY_BLOOM_PEER], summary->peers) !=
+        0 ||
+      bloom_build_ids(&summary->blooms[SUMMARY_BLOOM_ORIGIN],
+                      summary->origins) != 0 ||
+      bloom_build_buckets(&summary->blooms[SUMMARY_BLOOM_BUCKET],
+                          summary->buckets) != 0) {
+    return -1;
+  }
+
+  if ((iow = wandio_wcreate(path, WANDIO_COMPRESS_NONE, 0, O_CREAT)) ==
+      NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open %s for writing: %s",
+                  path, strerror(errno));
+    return -1;
+  }
+
+  memcpy(hdr, SUMMARY_MAGIC, SUMMARY_MAGIC_LEN);
+  hdr[SUMMARY_MAGIC_LEN] = SUMMARY_VERSION;
+  hdr[SUMMARY_MAGIC_LEN + 1] = summary->flags;
+  if (write_bytes(iow, path, hdr, sizeof(hdr)) != 0) {
+    goto err;
+  }
+
+  // each bloom is written as <nbits (u32)> <k (u8)> <bits>
+  for (i = 0; i < SUMMARY_BLOOM_CNT; i++) {
+    bloom = &summary->blooms[i];
+    nbits = htonl(bloom->nbits);
+    if (write_bytes(iow, path, &nbits, sizeof(nbits)) != 0 ||
+        write_bytes(iow, path, &bloom->k, sizeof(bloom->k)) != 0 ||
+        write_bytes(iow, path, bloom->bits, bloom->nbits / 8) != 0) {
+      goto err;
+    }
+  }
+
+  wandio_wdestroy(iow);
+  return 0;
+
+err:
+  wandio_wdestroy(iow);
+  return -1;
+}
+
+static int read_bytes(io_t *io, void *buf, size_t len)
+{
+  int64_t rc;
+  size_t done = 0;
+
+  while (done < len) {
+    if ((rc = wandio_read(io, (uint8_t *)buf + done, len - done)) <= 0) {
+      return -1;
+    }
+    done += rc;
+  }
+  return 0;
+}
+
+bgpstream_summary_t *bgpstream_summary_load(const char *url)
+{
+  bgpstream_summary_t *summary = NULL;
+  io_t *io = NULL;
+  char *path;
+  uint8_t hdr[SUMMARY_MAGIC_LEN + 2];
+  uint32_t nbits;
+  uint8_t k;
+  bloom_t *bloom;
+  int i;
+
+  if ((path = malloc(strlen(url) + sizeof(BGPSTREAM_SUMMARY_SUFFIX))) ==
+      NULL) {
+    return NULL;
+  }
+  strcpy(path, url);
+  strcat(path, BGPSTREAM_SUMMARY_SUFFIX);
+
+  // most local resources have no summary, which is not worth an error
+  if (strstr(path, "://") == NULL && access(path, R_OK) != 0) {
+    goto err;
+  }
+  if ((io = wandio_create(path)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_FINE, "No summary at %s", path);
+    goto err;
+  }
+
+  if ((summary = malloc_zero(sizeof(bgpstream_summary_t))) == NULL) {
+    goto err;
+  }
+  if (read_bytes(io, hdr, sizeof(hdr)) != 0 ||
+      memcmp(hdr, SUMMARY_MAGIC, SUMMARY_MAGIC_LEN) != 0 ||
+      hdr[SUMMARY_MAGIC_LEN] != SUMMARY_VERSION) {
+    goto corrupt;
+  }
+  summary->flags = hdr[SUMMARY_MAGIC_LEN + 1];
+
+  for (i = 0; i < SUMMARY_BLOOM_CNT; i++) {
+    bloom = &summary->blooms[i];
+    if (read_bytes(io, &nbits, sizeof(nbits)) != 0 ||
+        read_bytes(io, &k, sizeof(k)) != 0) {
+      goto corrupt;
+    }
+    nbits = ntohl(nbits);
+    if (nbits < BLOOM_MIN_BITS || nbits > BLOOM_MAX_BITS ||
+        (nbits & (nbits - 1)) != 0 || k == 0 || k > 32) {
+      goto corrupt;
+    }
+    if (bloom_init(bloom, nbits, k) != 0) {
+      goto err;
+    }
+    if (read_bytes(io, bloom->bits, nbits / 8) != 0) {
+      goto corrupt;
+    }
+  }
+
+  wandio_destroy(io);
+  free(path);
+  return summary;
+
+corrupt:
+  bgpstream_log(BGPSTREAM_LOG_WARN, "Ignoring invalid summary %s", path);
+err:
+  if (io != NULL) {
+    wandio_destroy(io);
+  }
+  free(path);
+  bgpstream_summary_destroy(summary);
+  return NULL;
+}
+
+typedef struct pfx_check {
+  bgpstream_summary_t *summary;
+  uint8_t ipversion;
+  int matched;
+} pfx_check_t;
+
+// check whether an elem of the summary may match the given filter prefix
+static int pfx_may_match(bgpstream_summary_t *summary,
+                         const bgpstream_pfx_t *pfx)
+{
+  bgpstream_addr_version_t version = pfx->address.version;
+  int blen = bucket_len(version);
+  int shorter = (summary->flags & short_flag(version)) != 0;
+  uint8_t matches = pfx->allowed_matches;
+  uint64_t bucket, cnt, i;
+
+  if ((summary->flags & has_flag(version)) == 0) {
+    return 0;
+  }
+  bucket = addr_bucket(&pfx->address);
+
+  if (pfx->mask_len >= blen) {
+    // elems that are equal to, more specific than, or (at least bucket long)
+    // less specific than the filter prefix are all in its bucket
+    if (bloom_may_contain(&summary->blooms[SUMMARY_BLOOM_BUCKET], bucket)) {
+      return 1;
+    }
+    // shorter elems can only be less specific
+    return shorter && (matches == BGPSTREAM_PREFIX_MATCH_ANY ||
+                       matches == BGPSTREAM_PREFIX_MATCH_LESS);
+  }
+
+  // elems that are equal to or less specific than the filter prefix are all
+  // shorter than a bucket, and the more specific ones fill its buckets
+  if (shorter) {
+    return 1;
+  }
+  if (matches != BGPSTREAM_PREFIX_MATCH_ANY &&
+      matches != BGPSTREAM_PREFIX_MATCH_MORE) {
+    return 0;
+  }
+  cnt = 1ULL << (blen - pfx->mask_len);
+  if (cnt > SUMMARY_MAX_BUCKET_PROBES) {
+    return 1;
+  }
+  bucket &= ~(cnt - 1);
+  for (i = 0; i < cnt; i++) {
+    if (bloom_may_contain(&summary->blooms[SUMMARY_BLOOM_BUCKET],
+                          bucket + i)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static bgpstream_patricia_walk_cb_result_t
+check_pfx(const bgpstream_patricia_tree_t *pt,
+          const bgpstream_patricia_node_t *node, void *data)
+{
+  pfx_check_t *check = (pfx_check_t *)data;
+  const bgpstream_pfx_t *pfx = bgpstream_patricia_tree_get_pfx(node);
+
+  // prefixes of the other IP version are never passed by the elem filters
+  if (check->ipversion != 0 && pfx->address.version != check->ipversion) {
+    return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+  }
+  if (pfx_may_match(check->summary, pfx)) {
+    check->matched = 1;
+    return BGPSTREAM_PATRICIA_WALK_END_ALL;
+  }
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+static int ids_may_intersect(bloom_t *bloom, bgpstream_id_set_t *ids)
+{
+  uint32_t *id;
+
+  bgpstream_id_set_rewind(ids);
+  while ((id = bgpstream_id_set_next(ids)) != NULL) {
+    if (bloom_may_contain(bloom, *id)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int bgpstream_summary_filter_may_pass(bgpstream_summary_t *summary,
+                                      bgpstream_filter_mgr_t *filter_mgr)
+{
+  pfx_check_t check = {summary, filter_mgr->ipversion, 0};
+
+  assert(summary->blooms[SUMMARY_BLOOM_PEER].bits != NULL);
+
+  if (filter_mgr->ipversion != 0 &&
+      (summary->flags & has_flag(filter_mgr->ipversion)) == 0) {
+    return 0;
+  }
+  if (filter_mgr->peer_asns != NULL &&
+      ids_may_intersect(&summary->blooms[SUMMARY_BLOOM_PEER],
+                        filter_mgr->peer_asns) == 0) {
+    return 0;
+  }
+  if (filter_mgr->origin_asns != NULL &&
+      ids_may_intersect(&summary->blooms[SUMMARY_BLOOM_ORIGIN],
+                        filter_mgr->origin_asns) == 0) {
+    return 0;
+  }
+  if (filter_mgr->prefixes != NULL) {
+    bgpstream_patricia_tree_walk(filter_mgr->prefixes, check_pfx, &check);
+    if (check.matched == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void bgpstream_summary_destroy(bgpstream_summary_t *summary)
+{
+  int i;
+
+  if (summary == NULL) {
+    return;
+  }
+  if (summary->peers != NULL) {
+    bgpstream_id_set_destroy(summary->peers);
+  }
+  if (summary->origins != NULL) {
+    bgpstream_id_set_destroy(summary->origins);
+  }
+  if (summary->buckets != NULL) {
+    kh_destroy(summary_bucket, summary->buckets);
+  }
+  for (i = 0; i < SUMMARY_BLOOM_CNT; i++) {
+    free(summary->blooms[i].bits);
+  }
+  free(summary);
+}
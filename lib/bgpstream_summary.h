@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_SUMMARY_H
+#define __BGPSTREAM_SUMMARY_H
+
+#include "bgpstream_elem.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of BGPStream resource
+ * summaries, which describe the elems of a dump file so that a stream can
+ * skip the file without opening it when no elem can pass its filters.
+ *
+ */
+
+/**
+ * @name Public Constants
+ *
+ * @{ */
+
+/** Suffix appended to the URL of a resource to get the URL of its summary */
+#define BGPSTREAM_SUMMARY_SUFFIX ".bsum"
+
+/** @} */
+
+/**
+ * @name Public Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure that represents the summary of a resource */
+typedef struct bgpstream_summary bgpstream_summary_t;
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new, empty, summary
+ *
+ * @return pointer to the summary if successful, NULL otherwise
+ */
+bgpstream_summary_t *bgpstream_summary_create(void);
+
+/** Add the given elem to the summary
+ *
+ * @param summary       pointer to the summary
+ * @param elem          pointer to the elem to add
+ * @return 0 if the elem was added successfully, -1 otherwise
+ *
+ * The peer ASN, origin ASN and prefix of the elem are recorded. Every elem
+ * of the resource must be added, otherwise streams that use the summary may
+ * skip elems that pass their filters.
+ */
+int bgpstream_summary_add_elem(bgpstream_summary_t *summary,
+                               bgpstream_elem_t *elem);
+
+/** Write the summary to a file
+ *
+ * @param summary       pointer to the summary
+ * @param path          path of the file to write
+ * @return 0 if the summary was written successfully, -1 otherwise
+ *
+ * The peer ASNs, origin ASNs and prefix buckets (the first 8 bits of IPv4
+ * prefixes and the first 32 bits of IPv6 prefixes) are stored as bloom
+ * filters, so the file is small whatever the size of the resource. To be used
+ * by a stream, the summary of a resource must be written next to it, at the
+ * URL of the resource followed by BGPSTREAM_SUMMARY_SUFFIX.
+ */
+int bgpstream_summary_write(bgpstream_summary_t *summary, const char *path);
+
+/** Destroy the given summary
+ *
+ * @param summary       pointer to the summary to destroy
+ */
+void bgpstream_summary_destroy(bgpstream_summary_t *summary);
+
+/** @} */
+
+#endif /* __BGPSTREAM_SUMMARY_H */
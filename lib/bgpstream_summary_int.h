@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_SUMMARY_INT_H
+#define __BGPSTREAM_SUMMARY_INT_H
+
+#include "bgpstream_filter.h"
+#include "bgpstream_summary.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the private interface of BGPStream resource
+ * summaries.
+ *
+ */
+
+/**
+ * @name Private API Functions
+ *
+ * @{ */
+
+/** Load the summary of the resource at the given URL
+ *
+ * @param url           URL of the resource (not of its summary)
+ * @return pointer to the summary if one was loaded, NULL if the resource has
+ * no summary, or it could not be read
+ */
+bgpstream_summary_t *bgpstream_summary_load(const char *url);
+
+/** Check whether an elem of the summarized resource may pass the filters
+ *
+ * @param summary       pointer to the summary
+ * @param filter_mgr    pointer to the filter manager
+ * @return 0 if no elem can pass the peer ASN, origin ASN, prefix and IP
+ * version filters, 1 if some may
+ */
+int bgpstream_summary_filter_may_pass(bgpstream_summary_t *summary,
+                                      bgpstream_filter_mgr_t *filter_mgr);
+
+/** @} */
+
+#endif /* __BGPSTREAM_SUMMARY_INT_H */
@@ -31,17 +31,23 @@
 
 #include "bgpstream_transport.h"
 #include "bgpstream_log.h"
+#include "bgpstream_perf.h"
 #include "bgpstream_resource.h"
 #include "utils.h"
 
 #include "bs_transport_cache.h"
 #include "bs_transport_file.h"
 #include "bs_transport_http.h"
+#include "bs_transport_shmring.h"
 
 #ifdef WITH_KAFKA
 #include "bs_transport_kafka.h"
 #endif
 
+#ifdef WITH_CURL
+#include "bs_transport_websocket.h"
+#endif
+
 /** Convenience typedef for the transport create function type */
 typedef int (*transport_create_func_t)(bgpstream_transport_t *transport);
 
@@ -62,6 +68,14 @@ static const transport_create_func_t create_functions[] = {
   bs_transport_cache_create,
 
   bs_transport_http_create,
+
+#ifdef WITH_CURL
+  bs_transport_websocket_create,
+#else
+  NULL,
+#endif
+
+  bs_transport_shmring_create,
 };
 
 bgpstream_transport_t *bgpstream_transport_create(bgpstream_resource_t *res)
@@ -105,10 +119,62 @@ err:
   return NULL;
 }
 
+/* account a read of the given transport that was timed with timer */
+static void account_read(bgpstream_transport_t *transport,
+                         bgpstream_perf_timer_t *timer, int64_t rc)
+{
+  uint64_t ns =
+    bgpstream_perf_stop(transport->res->perf, BGPSTREAM_PERF_STAGE_READ, timer);
+
+  bgpstream_perf_add_read(transport->res->perf, transport->res->transport_type,
+                          rc, ns);
+}
+
 int64_t bgpstream_transport_read(bgpstream_transport_t *transport, void *buffer,
                                  int64_t len)
 {
-  return transport->read(transport, buffer, len);
+  bgpstream_perf_timer_t timer;
+  int64_t rc;
+
+  bgpstream_perf_start(transport->res->perf, &timer);
+  rc = transport->read(transport, buffer, len);
+  account_read(transport, &timer, rc);
+  return rc;
+}
+
+int64_t bgpstream_transport_map(bgpstream_transport_t *transport,
+                                uint8_t **data)
+{
+  bgpstream_perf_timer_t timer;
+  int64_t rc;
+
+  if (transport->map == NULL) {
+    return -1;
+  }
+  bgpstream_perf_start(transport->res->perf, &timer);
+  rc = transport->map(transport, data);
+  account_read(transport, &timer, rc);
+  return rc;
+}
+
+int bgpstream_transport_checkpoint(bgpstream_transport_t *transport,
+                                   uint64_t pos)
+{
+  if (transport->checkpoint == NULL) {
+    return 0;
+  }
+  return transport->checkpoint(transport, pos);
+}
+
+int64_t bgpstream_transport_write(bgpstream_transport_t *transport,
+                                  const void *buffer, int64_t len)
+{
+  if (transport->write == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Transport for %s does not support writes",
+                  transport->res->url);
+    return -1;
+  }
+  return transport->write(transport, buffer, len);
 }
 
 void bgpstream_transport_destroy(bgpstream_transport_t *transport)
@@ -125,5 +191,11 @@ void bgpstream_transport_destroy(bgpstream_transport_t *transport)
 int64_t bgpstream_transport_readline(bgpstream_transport_t *transport,
                                      void *buffer, int64_t len)
 {
-  return transport->readline(transport, buffer, len);
+  bgpstream_perf_timer_t timer;
+  int64_t rc;
+
+  bgpstream_perf_start(transport->res->perf, &timer);
+  rc = transport->readline(transport, buffer, len);
+  account_read(transport, &timer, rc);
+  return rc;
 }
@@ -60,6 +60,41 @@ int64_t bgpstream_transport_read(bgpstream_transport_t *transport, void *buffer,
 int64_t bgpstream_transport_readline(bgpstream_transport_t *transport,
                                      void *buffer, int64_t len);
 
+/** Get the whole content of the given transport handler in memory
+ *
+ * @param transport     pointer to a transport handler to map
+ * @param[out] data     set to the content of the transport
+ * @return the length of the content if successful, -1 if the transport cannot
+ * expose its content in memory (in which case it must be read instead)
+ *
+ * The content remains valid until the transport is destroyed, and may be
+ * modified in place. It must not be mixed with reads from the transport.
+ */
+int64_t bgpstream_transport_map(bgpstream_transport_t *transport,
+                                uint8_t **data);
+
+/** Record that data read from the given transport has been processed
+ *
+ * @param transport     pointer to a transport handler to checkpoint
+ * @param pos           number of bytes read from the transport that have been
+ *                      fully processed
+ * @return 0 if successful (or the transport does not support checkpoints), -1
+ * otherwise
+ */
+int bgpstream_transport_checkpoint(bgpstream_transport_t *transport,
+                                   uint64_t pos);
+
+/** Send a message through the given transport handler
+ *
+ * @param transport     pointer to a transport handler to write to
+ * @param buffer        the message to send
+ * @param len           the length of the message
+ * @return the number of bytes sent if successful, -1 otherwise (including if
+ * the transport does not support writes)
+ */
+int64_t bgpstream_transport_write(bgpstream_transport_t *transport,
+                                  const void *buffer, int64_t len);
+
 /** Shutdown and destroy the given transport handler
  *
  * @param transport     pointer to a transport handler to destroy
@@ -98,6 +98,44 @@ struct bgpstream_transport {
    */
   void (*destroy)(struct bgpstream_transport *transport);
 
+  /** Get the whole content of this transport in memory (optional)
+   *
+   * @param t           The data transport object to map
+   * @param[out] data   Set to the content of the transport
+   * @return the length of the content if successful, -1 if the transport
+   * cannot expose its content in memory
+   *
+   * The content remains valid until the transport is destroyed, and is
+   * private to the caller (it may be modified in place). Transports that set
+   * this must still support read.
+   */
+  int64_t (*map)(struct bgpstream_transport *t, uint8_t **data);
+
+  /** Record that data up to the given position has been processed (optional)
+   *
+   * @param t           The data transport object to checkpoint
+   * @param pos         Number of bytes read from the transport that have been
+   *                    fully processed
+   * @return 0 if successful, -1 otherwise
+   *
+   * This may be called from a different thread than the one reading from the
+   * transport, and positions only ever increase.
+   */
+  int (*checkpoint)(struct bgpstream_transport *t, uint64_t pos);
+
+  /** Send a message to the other end of this transport (optional)
+   *
+   * @param t           The data transport object to write to
+   * @param buffer      The message to send
+   * @param len         The length of the message
+   * @return the number of bytes sent if successful, -1 otherwise
+   *
+   * Only transports talking to a server that accepts requests once the
+   * connection is open (e.g., a WebSocket subscription) set this.
+   */
+  int64_t (*write)(struct bgpstream_transport *t, const uint8_t *buffer,
+                   int64_t len);
+
   /** }@ */
 
   /**
@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2019 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_worker_pool.h"
+#include "bgpstream_log.h"
+#include "utils.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+struct bgpstream_worker_pool {
+
+  // worker threads
+  pthread_t *threads;
+  int threads_cnt;
+
+  // where the worker threads run, and how many of them have placed themselves
+  bgpstream_affinity_t aff;
+  int placed_cnt;
+
+  // borrowed pointer to the pool whose workers run our jobs, if we are a view
+  // of it (we then have no workers, and only keep our own events)
+  bgpstream_worker_pool_t *parent;
+
+  // ALL BELOW HERE MUST USE MUTEX
+  pthread_mutex_t mutex;
+
+  // signalled when a job is queued, or the pool is shutting down
+  pthread_cond_t job_cond;
+
+  // FIFO queue of jobs waiting for a worker
+  bgpstream_worker_pool_job_t *head;
+  bgpstream_worker_pool_job_t *tail;
+
+  // jobs waiting for their delay to pass, sorted by due time
+  bgpstream_worker_pool_job_t *delayed;
+
+  // set when the pool is being destroyed
+  int shutdown;
+
+  // incremented (and event_cond broadcast) whenever a job posts an event
+  uint64_t event_seq;
+  pthread_cond_t event_cond;
+
+  // pipe that is made readable when an event is posted (only created if the
+  // consumer asks for it)
+  int event_fds[2];
+
+  // set when a byte has been written to the pipe and not yet drained
+  int event_fd_ready;
+};
+
+static uint64_t now_msec(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// the pool that queues (and runs) the jobs submitted to the given pool
+#define JOBS_POOL(pool) ((pool)->parent != NULL ? (pool)->parent : (pool))
+
+// must be called with the mutex held
+static void enqueue(bgpstream_worker_pool_t *pool,
+                    bgpstream_worker_pool_job_t *job)
+{
+  job->next = NULL;
+  if (pool->tail == NULL) {
+    pool->head = job;
+  } else {
+    pool->tail->next = job;
+  }
+  pool->tail = job;
+}
+
+// moves the delayed jobs that are due (or all of them if the pool is shutting
+// down) to the queue. must be called with the mutex held
+static void enqueue_due(bgpstream_worker_pool_t *pool)
+{
+  bgpstream_worker_pool_job_t *job;
+  uint64_t now = now_msec();
+
+  while ((job = pool->delayed) != NULL &&
+         (job->due_msec <= now || pool->shutdown != 0)) {
+    pool->delayed = job->next;
+    enqueue(pool, job);
+  }
+}
+
+// waits for a job to be queued, or the first delayed job to be due. must be
+// called with the mutex held
+static void wait_job(bgpstream_worker_pool_t *pool)
+{
+  struct timespec abstime;
+
+  if (pool->delayed == NULL) {
+    pthread_cond_wait(&pool->job_cond, &pool->mutex);
+    return;
+  }
+  abstime.tv_sec = pool->delayed->due_msec / 1000;
+  abstime.tv_nsec = (long)(pool->delayed->due_msec % 1000) * 1000000;
+  pthread_cond_timedwait(&pool->job_cond, &pool->mutex, &abstime);
+}
+
+static void *worker_thread(void *user)
+{
+  bgpstream_worker_pool_t *pool = (bgpstream_worker_pool_t *)user;
+  bgpstream_worker_pool_job_t *job;
+  bgpstream_worker_pool_job_func_t *func;
+  void *job_user;
+
+  bgpstream_affinity_apply(
+    &pool->aff, __atomic_fetch_add(&pool->placed_cnt, 1, __ATOMIC_RELAXED));
+
+  pthread_mutex_lock(&pool->mutex);
+  while (1) {
+    if (pool->delayed != NULL) {
+      enqueue_due(pool);
+    }
+    if (pool->head == NULL) {
+      if (pool->shutdown != 0) {
+        break;
+      }
+      wait_job(pool);
+      continue;
+    }
+
+    // pop the oldest job
+    job = pool->head;
+    pool->head = job->next;
+    if (pool->head == NULL) {
+      pool->tail = NULL;
+    }
+
+    // the job may be re-submitted (or freed) as soon as it starts, so we must
+    // not touch it after this point
+    func = job->func;
+    job_user = job->user;
+    job->next = NULL;
+
+    pthread_mutex_unlock(&pool->mutex);
+    func(job_user);
+    pthread_mutex_lock(&pool->mutex);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+/* ========== PUBLIC FUNCTIONS BELOW ========== */
+
+bgpstream_worker_pool_t *
+bgpstream_worker_pool_create(int threads, const bgpstream_affinity_t *aff)
+{
+  bgpstream_worker_pool_t *pool;
+
+  assert(threads > 0);
+
+  if ((pool = malloc_zero(sizeof(bgpstream_worker_pool_t))) == NULL) {
+    return NULL;
+  }
+  if (aff != NULL) {
+    pool->aff = *aff;
+    bgpstream_affinity_resolve(&pool->aff);
+  }
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->job_cond, NULL);
+  pthread_cond_init(&pool->event_cond, NULL);
+  pool->event_fds[0] = pool->event_fds[1] = -1;
+
+  if ((pool->threads = malloc_zero(sizeof(pthread_t) * threads)) == NULL) {
+    goto err;
+  }
+
+  for (pool->threads_cnt = 0; pool->threads_cnt < threads;
+       pool->threads_cnt++) {
+    if (pthread_create(&pool->threads[pool->threads_cnt], NULL, worker_thread,
+                       pool) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not start worker thread");
+      goto err;
+    }
+  }
+
+  return pool;
+
+err:
+  bgpstream_worker_pool_destroy(pool);
+  return NULL;
+}
+
+bgpstream_worker_pool_t *
+bgpstream_worker_pool_create_view(bgpstream_worker_pool_t *parent)
+{
+  bgpstream_worker_pool_t *pool;
+
+  if ((pool = malloc_zero(sizeof(bgpstream_worker_pool_t))) == NULL) {
+    return NULL;
+  }
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->job_cond, NULL);
+  pthread_cond_init(&pool->event_cond, NULL);
+  pool->event_fds[0] = pool->event_fds[1] = -1;
+  pool->parent = JOBS_POOL(parent);
+
+  return pool;
+}
+
+void bgpstream_worker_pool_submit(bgpstream_worker_pool_t *pool,
+                                  bgpstream_worker_pool_job_t *job)
+{
+  pool = JOBS_POOL(pool);
+  pthread_mutex_lock(&pool->mutex);
+  assert(pool->shutdown == 0);
+  enqueue(pool, job);
+  pthread_cond_signal(&pool->job_cond);
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+void bgpstream_worker_pool_submit_delayed(bgpstream_worker_pool_t *pool,
+                                          bgpstream_worker_pool_job_t *job,
+                                          uint32_t delay_msec)
+{
+  bgpstream_worker_pool_job_t **prev;
+
+  pool = JOBS_POOL(pool);
+  pthread_mutex_lock(&pool->mutex);
+  assert(pool->shutdown == 0);
+  job->due_msec = now_msec() + delay_msec;
+  // jobs with the same due time keep the order they were submitted in
+  for (prev = &pool->delayed;
+       *prev != NULL && (*prev)->due_msec <= job->due_msec;
+       prev = &(*prev)->next)
+    ;
+  job->next = *prev;
+  *prev = job;
+  // a worker may need to wait for less time than it is now
+  pthread_cond_signal(&pool->job_cond);
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+int bgpstream_worker_pool_cancel(bgpstream_worker_pool_t *pool,
+                                 bgpstream_worker_pool_job_t *job)
+{
+  bgpstream_worker_pool_job_t **prev, *last = NULL;
+  int found = 0;
+
+  pool = JOBS_POOL(pool);
+  pthread_mutex_lock(&pool->mutex);
+  for (prev = &pool->delayed; *prev != NULL; prev = &(*prev)->next) {
+    if (*prev == job) {
+      *prev = job->next;
+      found = 1;
+      goto done;
+    }
+  }
+  for (prev = &pool->head; *prev != NULL; prev = &(*prev)->next) {
+    if (*prev == job) {
+      *prev = job->next;
+      if (pool->tail == job) {
+        pool->tail = last;
+      }
+      found = 1;
+      goto done;
+    }
+    last = *prev;
+  }
+
+done:
+  if (found != 0) {
+    job->next = NULL;
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  return found;
+}
+
+void bgpstream_worker_pool_post_event(bgpstream_worker_pool_t *pool)
+{
+  pthread_mutex_lock(&pool->mutex);
+  pool->event_seq++;
+  pthread_cond_broadcast(&pool->event_cond);
+  // one byte is enough to make the pipe readable
+  if (pool->event_fds[1] != -1 && pool->event_fd_ready == 0 &&
+      write(pool->event_fds[1], "", 1) == 1) {
+    pool->event_fd_ready = 1;
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+uint64_t bgpstream_worker_pool_get_event_seq(bgpstream_worker_pool_t *pool)
+{
+  uint64_t seq;
+
+  pthread_mutex_lock(&pool->mutex);
+  seq = pool->event_seq;
+  pthread_mutex_unlock(&pool->mutex);
+
+  return seq;
+}
+
+void bgpstream_worker_pool_wait_event(bgpstream_worker_pool_t *pool,
+                                      uint64_t seq, uint32_t timeout_msec)
+{
+  struct timespec abstime;
+  int rc = 0;
+
+  clock_gettime(CLOCK_REALTIME, &abstime);
+  abstime.tv_sec += timeout_msec / 1000;
+  abstime.tv_nsec += (long)(timeout_msec % 1000) * 1000000;
+  if (abstime.tv_nsec >= 1000000000) {
+    abstime.tv_sec++;
+    abstime.tv_nsec -= 1000000000;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  while (pool->event_seq == seq && rc != ETIMEDOUT) {
+    rc = pthread_cond_timedwait(&pool->event_cond, &pool->mutex, &abstime);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+int bgpstream_worker_pool_get_event_fd(bgpstream_worker_pool_t *pool)
+{
+  int fd = -1;
+
+  pthread_mutex_lock(&pool->mutex);
+  if (pool->event_fds[0] == -1) {
+    if (pipe(pool->event_fds) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create event pipe");
+      pool->event_fds[0] = pool->event_fds[1] = -1;
+      goto done;
+    }
+    // neither end may block (we never wait on the pipe ourselves)
+    fcntl(pool->event_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(pool->event_fds[1], F_SETFL, O_NONBLOCK);
+    // consumers may have missed events posted before the pipe existed
+    if (write(pool->event_fds[1], "", 1) == 1) {
+      pool->event_fd_ready = 1;
+    }
+  }
+  fd = pool->event_fds[0];
+
+done:
+  pthread_mutex_unlock(&pool->mutex);
+  return fd;
+}
+
+void bgpstream_worker_pool_clear_event_fd(bgpstream_worker_pool_t *pool)
+{
+  char buf[16];
+
+  pthread_mutex_lock(&pool->mutex);
+  if (pool->event_fd_ready != 0) {
+    while (read(pool->event_fds[0], buf, sizeof(buf)) > 0)
+      ;
+    pool->event_fd_ready = 0;
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+int bgpstream_worker_pool_get_thread_cnt(bgpstream_worker_pool_t *pool)
+{
+  return JOBS_POOL(pool)->threads_cnt;
+}
+
+void bgpstream_worker_pool_destroy(bgpstream_worker_pool_t *pool)
+{
+  int i;
+
+  if (pool == NULL) {
+    return;
+  }
+
+  // let the workers drain the queue and then exit (a view has no workers, and
+  // its jobs are run by those of its parent)
+  pthread_mutex_lock(&pool->mutex);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->job_cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (i = 0; i < pool->threads_cnt; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  free(pool->threads);
+  pool->threads = NULL;
+
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_cond_destroy(&pool->job_cond);
+  pthread_cond_destroy(&pool->event_cond);
+
+  if (pool->event_fds[0] != -1) {
+    close(pool->event_fds[0]);
+    close(pool->event_fds[1]);
+  }
+
+  free(pool);
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2019 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_WORKER_POOL_H
+#define __BGPSTREAM_WORKER_POOL_H
+
+#include "bgpstream_affinity.h"
+#include <stdint.h>
+
+/** Opaque structure representing a pool of worker threads */
+typedef struct bgpstream_worker_pool bgpstream_worker_pool_t;
+
+/** Function to be run by a worker thread */
+typedef void(bgpstream_worker_pool_job_func_t)(void *user);
+
+/** A unit of work to be run by the pool
+ *
+ * Jobs are owned by the caller (usually embedded in a larger structure) so that
+ * submitting work does not need an allocation. A job must not be re-submitted
+ * or freed until its function has started running.
+ */
+typedef struct bgpstream_worker_pool_job {
+
+  /** Function to run */
+  bgpstream_worker_pool_job_func_t *func;
+
+  /** User pointer to pass to the function */
+  void *user;
+
+  /** Next job in the queue (used internally by the pool) */
+  struct bgpstream_worker_pool_job *next;
+
+  /** When a delayed job is due, in msec since the epoch (used internally by
+      the pool) */
+  uint64_t due_msec;
+
+} bgpstream_worker_pool_job_t;
+
+/** Create a new pool of worker threads
+ *
+ * @param threads       number of worker threads to start (must be > 0)
+ * @param aff           pointer to the placement of the threads (copied by the
+ *                      pool), or NULL if they are not placed
+ * @return pointer to the pool created, NULL if an error occurred
+ *
+ * A placement restricted to a NUMA node is restricted to the node of the
+ * calling thread.
+ */
+bgpstream_worker_pool_t *
+bgpstream_worker_pool_create(int threads, const bgpstream_affinity_t *aff);
+
+/** Create a view of a pool, which shares its worker threads
+ *
+ * @param parent        pointer to the pool whose workers should run the jobs
+ * @return pointer to the view created, NULL if an error occurred
+ *
+ * Jobs submitted to the view are queued with those of the parent, but events
+ * posted to the view (and its event file descriptor) are its own, so that the
+ * consumers sharing the workers only wake for their own jobs. The parent must
+ * outlive its views, and a view must only be destroyed once its jobs are done.
+ */
+bgpstream_worker_pool_t *
+bgpstream_worker_pool_create_view(bgpstream_worker_pool_t *parent);
+
+/** Queue a job to be run by the first available worker
+ *
+ * @param pool          pointer to a worker pool
+ * @param job           borrowed pointer to the job to run
+ *
+ * Jobs are started in the order they are submitted.
+ */
+void bgpstream_worker_pool_submit(bgpstream_worker_pool_t *pool,
+                                  bgpstream_worker_pool_job_t *job);
+
+/** Queue a job to be run once the given delay has passed
+ *
+ * @param pool          pointer to a worker pool
+ * @param job           borrowed pointer to the job to run
+ * @param delay_msec    how long to wait before the job may run (in msec)
+ *
+ * No worker is tied up while the job waits, so this is how jobs retry after a
+ * transient failure. If the pool is destroyed first, the job is run
+ * immediately.
+ */
+void bgpstream_worker_pool_submit_delayed(bgpstream_worker_pool_t *pool,
+                                          bgpstream_worker_pool_job_t *job,
+                                          uint32_t delay_msec);
+
+/** Take a job out of the pool before it starts running
+ *
+ * @param pool          pointer to a worker pool
+ * @param job           borrowed pointer to the job to cancel
+ * @return 1 if the job was waiting (delayed or queued) and has been removed, 0
+ * if it was not in the pool (i.e., it may be running)
+ */
+int bgpstream_worker_pool_cancel(bgpstream_worker_pool_t *pool,
+                                 bgpstream_worker_pool_job_t *job);
+
+/** Notify anyone waiting on the pool that a job has made progress
+ *
+ * @param pool          pointer to a worker pool
+ *
+ * Used by jobs that read stream resources to signal that data is available, so
+ * that the consumer can wait for data rather than poll for it.
+ */
+void bgpstream_worker_pool_post_event(bgpstream_worker_pool_t *pool);
+
+/** Get the current event sequence number of the pool
+ *
+ * @param pool          pointer to a worker pool
+ * @return the number of events posted so far
+ */
+uint64_t bgpstream_worker_pool_get_event_seq(bgpstream_worker_pool_t *pool);
+
+/** Wait until an event is posted, or the timeout expires
+ *
+ * @param pool          pointer to a worker pool
+ * @param seq           sequence number (from
+ *                      bgpstream_worker_pool_get_event_seq) to wait for a
+ *                      newer event than
+ * @param timeout_msec  maximum time to wait (in msec)
+ *
+ * Returns immediately if an event has been posted since seq was read.
+ */
+void bgpstream_worker_pool_wait_event(bgpstream_worker_pool_t *pool,
+                                      uint64_t seq, uint32_t timeout_msec);
+
+/** Get a file descriptor that becomes readable when an event is posted
+ *
+ * @param pool          pointer to a worker pool
+ * @return a file descriptor that may be passed to poll/select/epoll, -1 if an
+ * error occurred
+ *
+ * The descriptor is owned by the pool and remains readable until
+ * bgpstream_worker_pool_clear_event_fd is called. It is created the first time
+ * this function is called, and starts out readable.
+ */
+int bgpstream_worker_pool_get_event_fd(bgpstream_worker_pool_t *pool);
+
+/** Drain the event file descriptor
+ *
+ * @param pool          pointer to a worker pool
+ *
+ * Should be called before checking for data so that an event posted after the
+ * check is not lost.
+ */
+void bgpstream_worker_pool_clear_event_fd(bgpstream_worker_pool_t *pool);
+
+/** Get the number of worker threads in the pool
+ *
+ * @param pool          pointer to a worker pool
+ * @return the number of threads in the pool
+ */
+int bgpstream_worker_pool_get_thread_cnt(bgpstream_worker_pool_t *pool);
+
+/** Destroy the given pool
+ *
+ * @param pool          pointer to the pool to destroy
+ *
+ * Any jobs that are still queued are run before the workers exit.
+ */
+void bgpstream_worker_pool_destroy(bgpstream_worker_pool_t *pool);
+
+#endif /* __BGPSTREAM_WORKER_POOL_H */
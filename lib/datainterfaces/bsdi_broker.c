@@ -31,6 +31,7 @@
 
 #include "bsdi_broker.h"
 #include "bgpstream_log.h"
+#include "bgpstream_mem.h"
 #include "config.h"
 #include "utils.h"
 #include "jsmn_utils.h"
@@ -42,8 +43,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <wandio.h>
 
@@ -61,6 +64,11 @@ enum {
   OPTION_BROKER_URL,
   OPTION_PARAM,
   OPTION_CACHE_DIR,
+  OPTION_CACHE_SIZE,
+  OPTION_CACHE_HOT_READS,
+  OPTION_PREFETCH,
+  OPTION_PARALLEL_QUERIES,
+  OPTION_CATALOG_DIR,
 #if WITH_KAFKA
   OPTION_KAFKA_GROUP,
   OPTION_KAFKA_OFFSET,
@@ -90,6 +98,46 @@ static bgpstream_data_interface_option_t options[] = {
     "cache-dir",                                 // name
     "Enable local cache at provided directory.", // description
   },
+  /* Broker Cache size */
+  {
+    BGPSTREAM_DATA_INTERFACE_BROKER, // interface ID
+    OPTION_CACHE_SIZE,               // internal ID
+    "cache-size",                    // name
+    "Maximum size of the local cache, in bytes (with optional K/M/G/T "
+    "suffix) (default: unlimited)", // description
+  },
+  /* Broker Cache hot reads */
+  {
+    BGPSTREAM_DATA_INTERFACE_BROKER, // interface ID
+    OPTION_CACHE_HOT_READS,          // internal ID
+    "cache-hot-reads",               // name
+    "Store cached resources uncompressed once they have been read this many "
+    "times (default: never)", // description
+  },
+  /* Broker prefetch */
+  {
+    BGPSTREAM_DATA_INTERFACE_BROKER, // interface ID
+    OPTION_PREFETCH,                 // internal ID
+    "prefetch",                      // name
+    "Fetch the next window of resources while the current one is being "
+    "read (0 or 1) (default: 1)", // description
+  },
+  /* Broker parallel queries */
+  {
+    BGPSTREAM_DATA_INTERFACE_BROKER, // interface ID
+    OPTION_PARALLEL_QUERIES,         // internal ID
+    "parallel-queries",              // name
+    "Split the query into up to this many concurrent sub-queries, by "
+    "collector (or project) (default: 1)", // description
+  },
+  /* Broker catalog */
+  {
+    BGPSTREAM_DATA_INTERFACE_BROKER, // interface ID
+    OPTION_CATALOG_DIR,              // internal ID
+    "catalog-dir",                   // name
+    "Keep broker responses for settled historical data in the provided "
+    "directory, and re-use them instead of querying the broker", // description
+  },
 #if WITH_KAFKA
   /* Kafka group */
   {
@@ -125,6 +173,69 @@ BSDI_CREATE_CLASS(
 
 #define BROKER_VERSION 2
 
+/* The maximum number of sub-queries a query can be split into */
+#define MAX_QUERIES 32
+
+/* In live mode, only prefetch while we are at least this far (in seconds)
+   behind the broker, otherwise the prefetched response would be stale by the
+   time it is used */
+#define PREFETCH_LIVE_LAG 3600
+
+/* Broker responses are only kept in the catalog once the query interval has
+   ended at least this long (in seconds) ago, so that data that is published
+   late has had time to show up */
+#define CATALOG_MIN_AGE 86400
+
+/* The maximum number of parameters of a query kept in the catalog */
+#define CATALOG_MAX_PARAMS 512
+
+// a (sub-)query of the broker, and the response window it has reached
+typedef struct broker_query {
+
+  // filter parameters specific to this sub-query (NULL if not split)
+  char *params;
+
+  // full URL of the current request of this query
+  char url[URL_BUFLEN];
+
+  // normalised form of url, and the catalog file for it (empty if the
+  // response may not be kept)
+  char catalog_key[URL_BUFLEN];
+  char catalog_path[PATH_MAX];
+
+  // was the current response read from the catalog?
+  int from_catalog;
+
+  // time of the last response we got from the broker
+  uint32_t last_response_time;
+
+  // the max (file_time + duration) that we have seen
+  uint32_t current_window_end;
+
+  // number of file resources found in the current response
+  int file_cnt;
+
+  // number of resources of the current response pushed so far (so that a
+  // retry does not push them again)
+  int res_pushed;
+
+  // response fetched in the background (valid once the thread is joined)
+  pthread_t thread;
+  int fetching;
+  char *resp;
+  size_t resp_len;
+  size_t resp_alloc;
+  int resp_rc;
+
+  // size of the response buffer as counted in the memory stats of the stream
+  // (only updated from the thread that uses the stream)
+  size_t resp_accounted;
+
+  // has the current response been processed?
+  int done;
+
+} broker_query_t;
+
 typedef struct bsdi_broker_state {
 
   /* user-provided options: */
@@ -141,6 +252,22 @@ typedef struct bsdi_broker_state {
   // User-specified location for cache: NULL means cache disabled
   char *cache_dir;
 
+  // Maximum size of the cache (in bytes, as a string): NULL means unlimited
+  char *cache_size;
+
+  // Number of reads after which cached resources are stored uncompressed:
+  // NULL means never
+  char *cache_hot_reads;
+
+  // Should the next window be fetched in the background?
+  int prefetch;
+
+  // Maximum number of sub-queries to split the query into
+  int parallel_queries;
+
+  // Directory of the response catalog: NULL means no catalog
+  char *catalog_dir;
+
 #if WITH_KAFKA
   // Kafka group name
   char *kafka_group;
@@ -162,11 +289,29 @@ typedef struct bsdi_broker_state {
   // have any parameters been added to the url?
   int first_param;
 
-  // time of the last response we got from the broker
-  uint32_t last_response_time;
+  // value of first_param at the end of the common query url
+  int url_first_param;
 
-  // the max (file_time + duration) that we have seen
-  uint32_t current_window_end;
+  // filter set that the query is split by (NULL if not split)
+  bgpstream_str_set_t *split_set;
+
+  // sub-queries (just one if the query is not split)
+  broker_query_t queries[MAX_QUERIES];
+  int queries_cnt;
+
+  // query whose response is being processed
+  broker_query_t *cur;
+
+  // only look for the end of the window of the response (don't push)
+  int scan_only;
+
+  // if non-zero, file resources starting at or after this time are left for
+  // the next window
+  uint32_t window_limit;
+
+  // if non-zero, a live query is first run up to this time (so that its
+  // responses can be kept in the catalog) before it carries on live
+  uint32_t catalog_end;
 
 } bsdi_broker_state_t;
 
@@ -214,20 +359,75 @@ static void unescape_char(char *url, char c)
 
 #define NEXT_TOK t++
 
-static int process_json(bsdi_t *di, const char *js, jsmntok_t *root_tok,
-                        size_t count)
+/* Maximum nesting of the broker response that we follow */
+#define JSON_MAX_DEPTH 16
+
+/* Maximum length of the object keys that we track */
+#define JSON_KEY_LEN 32
+
+/* Number of bytes read from the broker at once */
+#define JSON_READ_LEN 65536
+
+// state of a broker response as it is being read. each object of the
+// data.resources array is parsed (and pushed) as soon as it has been read,
+// everything else (the "envelope") is kept and parsed once the response ends
+typedef struct json_stream {
+
+  // containers ('{' or '[') we are nested in, and the last key of each
+  char nest[JSON_MAX_DEPTH];
+  char keys[JSON_MAX_DEPTH][JSON_KEY_LEN];
+  int depth;
+
+  // string state (in_key is set if the string is an object key)
+  int in_str;
+  int esc;
+  int in_key;
+  size_t key_len;
+
+  // is the next string an object key?
+  int want_key;
+
+  // depth inside the resources array (0 if not inside it)
+  int res_depth;
+
+  // the envelope, and the resource object currently being read
+  char *env;
+  size_t env_len;
+  size_t env_alloc;
+  char *obj;
+  size_t obj_len;
+  size_t obj_alloc;
+
+  // tokens used to parse a resource object (and then the envelope)
+  jsmntok_t *tok;
+  size_t tokcount;
+
+  // buffers for resource strings, re-used between resources
+  char *url;
+  size_t url_len;
+  char *kafka_topic;
+  size_t topic_len;
+  char *mirrors;
+  size_t mirrors_len;
+  size_t mirrors_alloc;
+
+  // index of the next resource in the response
+  int res_idx;
+
+} json_stream_t;
+
+// processes the resource object at t. returns 0 if successful (or the
+// resource was skipped), ERR_RETRY if the resource is invalid
+static int process_resource(bsdi_t *di, json_stream_t *s, const char *js,
+                            jsmntok_t *t)
 {
-  int i, j, k, l, m;
-  jsmntok_t *t = root_tok + 1;
-
-  int arr_len, obj_len, attr_len;
-
-  int time_set = 0;
+  int k, m, n;
+  int obj_len, attr_len, mirror_cnt;
+  size_t len;
 
   // per-file info
-  char *url = NULL;
-  size_t url_len = 0;
   int url_set = 0;
+  int mirrors_set = 0;
   char collector[BGPSTREAM_UTILS_STR_NAME_LEN] = "";
   int collector_set = 0;
   char project[BGPSTREAM_UTILS_STR_NAME_LEN] = "";
@@ -241,17 +441,331 @@ static int process_json(bsdi_t *di, const char *js, jsmntok_t *root_tok,
   unsigned long initial_time = 0;
   int initial_time_set = 0;
   unsigned long duration = 0;
-  unsigned long version = 0;
   int duration_set = 0;
-  char *kafka_topic = NULL;
-  size_t topic_len = 0;
 
   // local cache related variables.
   bgpstream_resource_t *res = NULL;
 
+  jsmn_type_assert(t, JSMN_OBJECT);
+  obj_len = t->size;
+  NEXT_TOK;
+
+  for (k = 0; k < obj_len; k++) {
+    if (jsmn_streq(js, t, "url") == 1) {
+      NEXT_TOK;
+      jsmn_type_assert(t, JSMN_STRING);
+      if (s->url_len < (t->end - t->start + 1)) {
+        s->url_len = t->end - t->start + 1;
+        if ((s->url = realloc(s->url, s->url_len)) == NULL) {
+          bgpstream_log(BGPSTREAM_LOG_ERR, "Could not realloc URL string");
+          goto err;
+        }
+      }
+      jsmn_strcpy(s->url, t, js);
+      unescape_char(s->url, '/');
+      url_set = 1;
+      NEXT_TOK;
+    } else if (jsmn_streq(js, t, "project") == 1) {
+      NEXT_TOK;
+      jsmn_type_assert(t, JSMN_STRING);
+      jsmn_strcpy(project, t, js);
+      project_set = 1;
+      NEXT_TOK;
+    } else if (jsmn_streq(js, t, "collector") == 1) {
+      NEXT_TOK;
+      jsmn_type_assert(t, JSMN_STRING);
+      jsmn_strcpy(collector, t, js);
+      collector_set = 1;
+      NEXT_TOK;
+    } else if (jsmn_streq(js, t, "type") == 1) {
+      NEXT_TOK;
+      jsmn_type_assert(t, JSMN_STRING);
+      if (jsmn_streq(js, t, "ribs") == 1) {
+        type = BGPSTREAM_RIB;
+      } else if (jsmn_streq(js, t, "updates") == 1) {
+        type = BGPSTREAM_UPDATE;
+      } else {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid type '%.*s'",
+                      t->end - t->start, js + t->start);
+        goto err;
+      }
+      type_set = 1;
+      NEXT_TOK;
+    } else if (jsmn_streq(js, t, "initialTime") == 1) {
+      NEXT_TOK;
+      jsmn_type_assert(t, JSMN_PRIMITIVE);
+      jsmn_strtoul(&initial_time, js, t);
+      initial_time_set = 1;
+      NEXT_TOK;
+    } else if (jsmn_streq(js, t, "duration") == 1) {
+      NEXT_TOK;
+      jsmn_type_assert(t, JSMN_PRIMITIVE);
+      jsmn_strtoul(&duration, js, t);
+      duration_set = 1;
+      NEXT_TOK;
+    } else if (jsmn_streq(js, t, "transport") == 1) {
+      NEXT_TOK;
+      jsmn_type_assert(t, JSMN_STRING);
+      if (jsmn_streq(js, t, "file") == 1) {
+        transport_type = BGPSTREAM_RESOURCE_TRANSPORT_FILE;
+      } else if (jsmn_streq(js, t, "http") == 1) {
+        transport_type = BGPSTREAM_RESOURCE_TRANSPORT_HTTP;
+      } else if (jsmn_streq(js, t, "kafka") == 1) {
+        transport_type = BGPSTREAM_RESOURCE_TRANSPORT_KAFKA;
+      } else if (jsmn_streq(js, t, "websocket") == 1) {
+        transport_type = BGPSTREAM_RESOURCE_TRANSPORT_WEBSOCKET;
+      } else {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid transport type '%.*s'",
+                      t->end - t->start, js + t->start);
+        goto err;
+      }
+      transport_type_set = 1;
+      NEXT_TOK;
+    } else if (jsmn_streq(js, t, "format") == 1) {
+      NEXT_TOK;
+      jsmn_type_assert(t, JSMN_STRING);
+      if (jsmn_streq(js, t, "mrt") == 1) {
+        format_type = BGPSTREAM_RESOURCE_FORMAT_MRT;
+      } else if (jsmn_streq(js, t, "ris-live") == 1) {
+        format_type = BGPSTREAM_RESOURCE_FORMAT_RISLIVE;
+      } else if (jsmn_streq(js, t, "bmp") == 1) {
+        format_type = BGPSTREAM_RESOURCE_FORMAT_BMP;
+      } else {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid format type '%.*s'",
+                      t->end - t->start, js + t->start);
+        goto err;
+      }
+      format_type_set = 1;
+      NEXT_TOK;
+    } else if (jsmn_streq(js, t, "attr") == 1) {
+      NEXT_TOK;
+      attr_len = t->size;
+      NEXT_TOK;
+      for (m = 0; m < attr_len; m++) {
+        if (jsmn_streq(js, t, "kafka-topics") == 1) {
+          NEXT_TOK;
+          jsmn_type_assert(t, JSMN_STRING);
+          if (s->topic_len < (t->end - t->start + 1)) {
+            s->topic_len = t->end - t->start + 1;
+            if ((s->kafka_topic = realloc(s->kafka_topic, s->topic_len)) ==
+                NULL) {
+              bgpstream_log(BGPSTREAM_LOG_ERR,
+                            "Could not realloc kafka topic string");
+              goto err;
+            }
+          }
+          jsmn_strcpy(s->kafka_topic, t, js);
+          unescape_char(s->kafka_topic, '\\');
+          url_set = 1;
+          NEXT_TOK;
+        } else if (jsmn_streq(js, t, "mirrors") == 1) {
+          // alternate URLs of the resource, kept one per line
+          NEXT_TOK;
+          jsmn_type_assert(t, JSMN_ARRAY);
+          mirror_cnt = t->size;
+          NEXT_TOK;
+          s->mirrors_len = 0;
+          for (n = 0; n < mirror_cnt; n++) {
+            jsmn_type_assert(t, JSMN_STRING);
+            len = t->end - t->start;
+            if (s->mirrors_alloc < s->mirrors_len + len + 2) {
+              s->mirrors_alloc = s->mirrors_len + len + 2;
+              if ((s->mirrors = realloc(s->mirrors, s->mirrors_alloc)) ==
+                  NULL) {
+                bgpstream_log(BGPSTREAM_LOG_ERR,
+                              "Could not realloc mirrors string");
+                goto err;
+              }
+            }
+            if (s->mirrors_len != 0) {
+              s->mirrors[s->mirrors_len++] = '\n';
+            }
+            memcpy(s->mirrors + s->mirrors_len, js + t->start, len);
+            s->mirrors_len += len;
+            s->mirrors[s->mirrors_len] = '\0';
+            NEXT_TOK;
+          }
+          if (s->mirrors_len != 0) {
+            unescape_char(s->mirrors, '/');
+            mirrors_set = 1;
+          }
+        } else {
+          bgpstream_log(BGPSTREAM_LOG_ERR, "Unknown field '%.*s'",
+                        t->end - t->start, js + t->start);
+          goto err;
+        }
+      }
+    } else {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Unknown field '%.*s'",
+                    t->end - t->start, js + t->start);
+      goto err;
+    }
+  }
+
+#ifdef BROKER_DEBUG
+  bgpstream_log(BGPSTREAM_LOG_INFO, "----------");
+  bgpstream_log(BGPSTREAM_LOG_INFO, "Transport Type: %d", transport_type);
+  bgpstream_log(BGPSTREAM_LOG_INFO, "Format Type: %d", format_type);
+  bgpstream_log(BGPSTREAM_LOG_INFO, "URL: %s", s->url);
+  bgpstream_log(BGPSTREAM_LOG_INFO, "Project: %s", project);
+  bgpstream_log(BGPSTREAM_LOG_INFO, "Collector: %s", collector);
+  bgpstream_log(BGPSTREAM_LOG_INFO, "Type: %d", type);
+  bgpstream_log(BGPSTREAM_LOG_INFO, "InitialTime: %lu", initial_time);
+  bgpstream_log(BGPSTREAM_LOG_INFO, "Duration: %lu", duration);
+#ifdef WITH_KAFKA
+  if (transport_type == BGPSTREAM_RESOURCE_TRANSPORT_KAFKA &&
+      s->kafka_topic != NULL) {
+    bgpstream_log(BGPSTREAM_LOG_INFO, "Kafka topic: %s", s->kafka_topic);
+  }
+#endif
+#endif
+  if (url_set == 0 || project_set == 0 || collector_set == 0 ||
+      type_set == 0 || initial_time_set == 0 || duration_set == 0 ||
+      format_type_set == 0 || transport_type_set == 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid resource record");
+    return ERR_RETRY;
+  }
+
+#ifndef WITH_KAFKA
+  // we are built without kafka support, so ignore kafka resources
+  if (transport_type == BGPSTREAM_RESOURCE_TRANSPORT_KAFKA) {
+    bgpstream_log(
+      BGPSTREAM_LOG_WARN,
+      "Skipping unsuported kafka-based resource (rebuild libbgpstream "
+      "with kafka support to handle this resource)");
+    return 0;
+  }
+#endif
+
+#ifndef WITH_CURL
+  // the websocket transport is built on libcurl
+  if (transport_type == BGPSTREAM_RESOURCE_TRANSPORT_WEBSOCKET) {
+    bgpstream_log(BGPSTREAM_LOG_WARN,
+                  "Skipping unsupported websocket-based resource (rebuild "
+                  "libbgpstream with libcurl support to handle this resource)");
+    return 0;
+  }
+#endif
+
+  // an earlier attempt at this response may have pushed it already
+  if (s->res_idx++ < STATE->cur->res_pushed) {
+    return 0;
+  }
+
+  // do we need to update our current_window_end?
+  if (transport_type == BGPSTREAM_RESOURCE_TRANSPORT_FILE) {
+
+    if (STATE->window_limit != 0 && initial_time >= STATE->window_limit) {
+      return 0;
+    }
+    STATE->cur->file_cnt++;
+
+    if (initial_time + duration > STATE->cur->current_window_end) {
+      STATE->cur->current_window_end = (initial_time + duration);
+    }
+
+    if (STATE->cache_dir != NULL) {
+      transport_type = BGPSTREAM_RESOURCE_TRANSPORT_CACHE;
+    }
+  }
+
+  if (STATE->scan_only != 0) {
+    return 0;
+  }
+
+  if (bgpstream_resource_mgr_push(BSDI_GET_RES_MGR(di), transport_type,
+                                  format_type, s->url, initial_time, duration,
+                                  project, collector, type, &res) < 0) {
+
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Unable to push resource");
+    goto err;
+  }
+  STATE->cur->res_pushed++;
+
+  if (mirrors_set != 0 &&
+      bgpstream_resource_set_attr(res, BGPSTREAM_RESOURCE_ATTR_MIRRORS,
+                                  s->mirrors) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Unable to set mirrors of %s", s->url);
+    goto err;
+  }
+
+#if WITH_KAFKA
+  // handle kafka-specific configuration
+  if (transport_type == BGPSTREAM_RESOURCE_TRANSPORT_KAFKA) {
+    if (s->kafka_topic == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR,
+                    "Missing bmp kafka topic from the broker");
+      goto err;
+    }
+    if (bgpstream_resource_set_attr(res, BGPSTREAM_RESOURCE_ATTR_KAFKA_TOPICS,
+                                    s->kafka_topic) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Unable to set kafka topic to %s",
+                    s->kafka_topic);
+      goto err;
+    }
+
+    if (STATE->kafka_group != NULL &&
+        bgpstream_resource_set_attr(
+          res, BGPSTREAM_RESOURCE_ATTR_KAFKA_CONSUMER_GROUP,
+          STATE->kafka_group) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Unable to set kafka group to %s",
+                    STATE->kafka_group);
+      goto err;
+    }
+
+    if (STATE->kafka_offset != NULL &&
+        bgpstream_resource_set_attr(res,
+                                    BGPSTREAM_RESOURCE_ATTR_KAFKA_INIT_OFFSET,
+                                    STATE->kafka_offset) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Unable to set kafka offset to %s",
+                    STATE->kafka_offset);
+      goto err;
+    }
+  }
+#endif
+
+  // set cache attribute to resource
+  if (transport_type == BGPSTREAM_RESOURCE_TRANSPORT_CACHE &&
+      bgpstream_resource_set_attr(res, BGPSTREAM_RESOURCE_ATTR_CACHE_DIR_PATH,
+                                  STATE->cache_dir) != 0) {
+    return ERR_FATAL;
+  }
+  if (transport_type == BGPSTREAM_RESOURCE_TRANSPORT_CACHE &&
+      STATE->cache_size != NULL &&
+      bgpstream_resource_set_attr(res, BGPSTREAM_RESOURCE_ATTR_CACHE_MAX_SIZE,
+                                  STATE->cache_size) != 0) {
+    return ERR_FATAL;
+  }
+  if (transport_type == BGPSTREAM_RESOURCE_TRANSPORT_CACHE &&
+      STATE->cache_hot_reads != NULL &&
+      bgpstream_resource_set_attr(res, BGPSTREAM_RESOURCE_ATTR_CACHE_HOT_READS,
+                                  STATE->cache_hot_reads) != 0) {
+    return ERR_FATAL;
+  }
+
+  return 0;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_ERR,
+                "Invalid JSON response received from broker");
+  return ERR_RETRY;
+}
+
+static int process_json(bsdi_t *di, json_stream_t *s, const char *js,
+                        jsmntok_t *root_tok, size_t count)
+{
+  int i, j, l, rc;
+  jsmntok_t *t = root_tok + 1;
+
+  int arr_len;
+
+  int time_set = 0;
+
+  unsigned long version = 0;
+
   if (count == 0) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "Empty JSON response from broker");
-    goto retry;
+    return ERR_RETRY;
   }
 
   if (root_tok->type != JSMN_OBJECT) {
@@ -282,7 +796,7 @@ static int process_json(bsdi_t *di, const char *js, jsmntok_t *root_tok,
       jsmn_type_assert(t, JSMN_PRIMITIVE);
       unsigned long tmp = 0;
       jsmn_strtoul(&tmp, js, t);
-      STATE->last_response_time = (uint32_t)tmp;
+      STATE->cur->last_response_time = (uint32_t)tmp;
       time_set = 1;
       NEXT_TOK;
     } else if (jsmn_streq(js, t, "type") == 1) {
@@ -313,239 +827,13 @@ static int process_json(bsdi_t *di, const char *js, jsmntok_t *root_tok,
         jsmn_str_assert(js, t, "resources");
         NEXT_TOK;
         jsmn_type_assert(t, JSMN_ARRAY);
-        arr_len = t->size; // number of dump files
+        arr_len = t->size; // number of dump files (normally already streamed)
         NEXT_TOK;          // first elem in array
         for (j = 0; j < arr_len; j++) {
-          jsmn_type_assert(t, JSMN_OBJECT);
-          obj_len = t->size;
-          NEXT_TOK;
-
-          url_set = 0;
-          project_set = 0;
-          collector_set = 0;
-          type_set = 0;
-          initial_time_set = 0;
-          duration_set = 0;
-
-          for (k = 0; k < obj_len; k++) {
-            if (jsmn_streq(js, t, "url") == 1) {
-              NEXT_TOK;
-              jsmn_type_assert(t, JSMN_STRING);
-              if (url_len < (t->end - t->start + 1)) {
-                url_len = t->end - t->start + 1;
-                if ((url = realloc(url, url_len)) == NULL) {
-                  bgpstream_log(BGPSTREAM_LOG_ERR,
-                                "Could not realloc URL string");
-                  goto err;
-                }
-              }
-              jsmn_strcpy(url, t, js);
-              unescape_char(url,'/');
-              url_set = 1;
-              NEXT_TOK;
-            } else if (jsmn_streq(js, t, "project") == 1) {
-              NEXT_TOK;
-              jsmn_type_assert(t, JSMN_STRING);
-              jsmn_strcpy(project, t, js);
-              project_set = 1;
-              NEXT_TOK;
-            } else if (jsmn_streq(js, t, "collector") == 1) {
-              NEXT_TOK;
-              jsmn_type_assert(t, JSMN_STRING);
-              jsmn_strcpy(collector, t, js);
-              collector_set = 1;
-              NEXT_TOK;
-            } else if (jsmn_streq(js, t, "type") == 1) {
-              NEXT_TOK;
-              jsmn_type_assert(t, JSMN_STRING);
-              if (jsmn_streq(js, t, "ribs") == 1) {
-                type = BGPSTREAM_RIB;
-              } else if (jsmn_streq(js, t, "updates") == 1) {
-                type = BGPSTREAM_UPDATE;
-              } else {
-                bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid type '%.*s'",
-                              t->end - t->start, js + t->start);
-                goto err;
-              }
-              type_set = 1;
-              NEXT_TOK;
-            } else if (jsmn_streq(js, t, "initialTime") == 1) {
-              NEXT_TOK;
-              jsmn_type_assert(t, JSMN_PRIMITIVE);
-              jsmn_strtoul(&initial_time, js, t);
-              initial_time_set = 1;
-              NEXT_TOK;
-            } else if (jsmn_streq(js, t, "duration") == 1) {
-              NEXT_TOK;
-              jsmn_type_assert(t, JSMN_PRIMITIVE);
-              jsmn_strtoul(&duration, js, t);
-              duration_set = 1;
-              NEXT_TOK;
-            } else if (jsmn_streq(js, t, "transport") == 1) {
-              NEXT_TOK;
-              jsmn_type_assert(t, JSMN_STRING);
-              if (jsmn_streq(js, t, "file") == 1) {
-                transport_type = BGPSTREAM_RESOURCE_TRANSPORT_FILE;
-              } else if (jsmn_streq(js, t, "http") == 1) {
-                transport_type = BGPSTREAM_RESOURCE_TRANSPORT_HTTP;
-              } else if (jsmn_streq(js, t, "kafka") == 1) {
-                transport_type = BGPSTREAM_RESOURCE_TRANSPORT_KAFKA;
-              } else {
-                bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid transport type '%.*s'",
-                              t->end - t->start, js + t->start);
-                goto err;
-              }
-              transport_type_set = 1;
-              NEXT_TOK;
-            } else if (jsmn_streq(js, t, "format") == 1) {
-              NEXT_TOK;
-              jsmn_type_assert(t, JSMN_STRING);
-              if (jsmn_streq(js, t, "mrt") == 1) {
-                format_type = BGPSTREAM_RESOURCE_FORMAT_MRT;
-              } else if (jsmn_streq(js, t, "ris-live") == 1) {
-                format_type = BGPSTREAM_RESOURCE_FORMAT_RISLIVE;
-              } else if (jsmn_streq(js, t, "bmp") == 1) {
-                format_type = BGPSTREAM_RESOURCE_FORMAT_BMP;
-              } else {
-                bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid format type '%.*s'",
-                              t->end - t->start, js + t->start);
-                goto err;
-              }
-              format_type_set = 1;
-              NEXT_TOK;
-            } else if (jsmn_streq(js, t, "attr") == 1) {
-              NEXT_TOK;
-              attr_len = t->size;
-              NEXT_TOK;
-              for (m = 0; m < attr_len; m++) {
-                if (jsmn_streq(js, t, "kafka-topics") == 1) {
-                  NEXT_TOK;
-                  jsmn_type_assert(t, JSMN_STRING);
-                  if (topic_len < (t->end - t->start + 1)) {
-                    topic_len = t->end - t->start + 1;
-                    if ((kafka_topic = realloc(kafka_topic, topic_len)) == NULL) {
-                      bgpstream_log(BGPSTREAM_LOG_ERR,
-                                    "Could not realloc kafka topic string");
-                      goto err;
-                    }
-                  }
-                  jsmn_strcpy(kafka_topic, t, js);
-                  unescape_char(kafka_topic, '\\');
-                  url_set = 1;
-                  NEXT_TOK;
-                } else {
-                  bgpstream_log(BGPSTREAM_LOG_ERR, "Unknown field '%.*s'",
-                                t->end - t->start, js + t->start);
-                  goto err;
-                }
-              }
-            } else {
-              bgpstream_log(BGPSTREAM_LOG_ERR, "Unknown field '%.*s'",
-                            t->end - t->start, js + t->start);
-              goto err;
-            }
-          }
-
-#ifdef BROKER_DEBUG
-          bgpstream_log(BGPSTREAM_LOG_INFO, "----------");
-          bgpstream_log(BGPSTREAM_LOG_INFO, "Transport Type: %d", transport_type);
-          bgpstream_log(BGPSTREAM_LOG_INFO, "Format Type: %d", format_type);
-          bgpstream_log(BGPSTREAM_LOG_INFO, "URL: %s", url);
-          bgpstream_log(BGPSTREAM_LOG_INFO, "Project: %s", project);
-          bgpstream_log(BGPSTREAM_LOG_INFO, "Collector: %s", collector);
-          bgpstream_log(BGPSTREAM_LOG_INFO, "Type: %d", type);
-          bgpstream_log(BGPSTREAM_LOG_INFO, "InitialTime: %lu", initial_time);
-          bgpstream_log(BGPSTREAM_LOG_INFO, "Duration: %lu", duration);
-#ifdef WITH_KAFKA
-          if (transport_type == BGPSTREAM_RESOURCE_TRANSPORT_KAFKA && kafka_topic != NULL){
-            bgpstream_log(BGPSTREAM_LOG_INFO, "Kafka topic: %s", kafka_topic);
-          }
-#endif
-#endif
-          if (url_set == 0 || project_set == 0 || collector_set == 0 ||
-              type_set == 0 || initial_time_set == 0 || duration_set == 0 ||
-              format_type_set == 0 || transport_type_set == 0) {
-            bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid resource record");
-            goto retry;
-          }
-
-
-#ifndef WITH_KAFKA
-          // we are built without kafka support, so ignore kafka resources
-          if (transport_type == BGPSTREAM_RESOURCE_TRANSPORT_KAFKA) {
-            bgpstream_log(
-              BGPSTREAM_LOG_WARN,
-              "Skipping unsuported kafka-based resource (rebuild libbgpstream "
-              "with kafka support to handle this resource)");
-            continue;
-          }
-#endif
-
-          // do we need to update our current_window_end?
-          if (transport_type == BGPSTREAM_RESOURCE_TRANSPORT_FILE){
-
-            if(initial_time + duration > STATE->current_window_end) {
-              STATE->current_window_end = (initial_time + duration);
-            }
-
-            if(STATE->cache_dir != NULL){
-              transport_type = BGPSTREAM_RESOURCE_TRANSPORT_CACHE;
-            }
-          }
-
-          if (bgpstream_resource_mgr_push(BSDI_GET_RES_MGR(di), transport_type,
-                                          format_type, url,
-                                          initial_time, duration, project,
-                                          collector, type, &res) < 0) {
-
-            bgpstream_log(BGPSTREAM_LOG_ERR, "Unable to push resource");
-            goto err;
-          }
-
-#if WITH_KAFKA
-          // handle kafka-specific configuration
-          if (transport_type == BGPSTREAM_RESOURCE_TRANSPORT_KAFKA) {
-            if (kafka_topic == NULL) {
-              bgpstream_log(BGPSTREAM_LOG_ERR,
-                            "Missing bmp kafka topic from the broker");
-              goto err;
-            }
-            if (bgpstream_resource_set_attr(
-                  res, BGPSTREAM_RESOURCE_ATTR_KAFKA_TOPICS, kafka_topic) !=
-                0) {
-              bgpstream_log(BGPSTREAM_LOG_ERR,
-                            "Unable to set kafka topic to %s", kafka_topic);
-              goto err;
-            }
-
-            if (STATE->kafka_group != NULL &&
-                bgpstream_resource_set_attr(
-                  res, BGPSTREAM_RESOURCE_ATTR_KAFKA_CONSUMER_GROUP,
-                  STATE->kafka_group) != 0) {
-              bgpstream_log(BGPSTREAM_LOG_ERR,
-                            "Unable to set kafka group to %s", STATE->kafka_group);
-              goto err;
-            }
-
-            if (STATE->kafka_offset != NULL &&
-                bgpstream_resource_set_attr(
-                  res, BGPSTREAM_RESOURCE_ATTR_KAFKA_INIT_OFFSET,
-                  STATE->kafka_offset) != 0) {
-              bgpstream_log(BGPSTREAM_LOG_ERR,
-                            "Unable to set kafka offset to %s",
-                            STATE->kafka_offset);
-              goto err;
-            }
-          }
-#endif
-
-          // set cache attribute to resource
-          if (transport_type == BGPSTREAM_RESOURCE_TRANSPORT_CACHE &&
-              bgpstream_resource_set_attr(res,
-                                          BGPSTREAM_RESOURCE_ATTR_CACHE_DIR_PATH,
-                                          STATE->cache_dir) != 0) {
-            return -1;
+          if ((rc = process_resource(di, s, js, t)) != 0) {
+            return rc;
           }
+          t = jsmn_skip(t);
         }
       }
     }
@@ -554,99 +842,247 @@ static int process_json(bsdi_t *di, const char *js, jsmntok_t *root_tok,
     goto err;
   }
 
-  free(url);
-  free(kafka_topic);
   return 0;
 
-retry:
-  free(url);
-  return ERR_RETRY;
-
 err:
   bgpstream_log(BGPSTREAM_LOG_ERR,
                 "Invalid JSON response received from broker");
-  free(url);
   return ERR_RETRY;
 }
 
-static int read_json(bsdi_t *di, io_t *jsonfile)
+// parses the given JSON text into the stream tokens. returns the number of
+// tokens, or ERR_RETRY if the text is not valid JSON
+static int parse_json(json_stream_t *s, const char *js, size_t len)
 {
   jsmn_parser p;
-  jsmntok_t *tok = NULL;
-  size_t tokcount = 128;
-
   int ret;
-  char *js = NULL;
-  size_t jslen = 0;
-#define BUFSIZE 1024
-  char buf[BUFSIZE];
-
-  // prepare parser
-  jsmn_init(&p);
-
-  // allocate some tokens to start
-  if ((tok = malloc(sizeof(jsmntok_t) * tokcount)) == NULL) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not malloc initial tokens");
-    goto err;
-  }
 
-  // slurp the whole file into a buffer
+  // objects are small, so re-parsing after growing the tokens is cheap
   while (1) {
-    /* do a read */
-    ret = wandio_read(jsonfile, buf, BUFSIZE);
-    if (ret < 0) {
-      bgpstream_log(BGPSTREAM_LOG_ERR, "Reading from broker failed");
-      goto err;
-    }
-    if (ret == 0) {
-      // we're done
+    jsmn_init(&p);
+    if ((ret = jsmn_parse(&p, js, len, s->tok, s->tokcount)) !=
+        JSMN_ERROR_NOMEM) {
       break;
     }
-    if ((js = realloc(js, jslen + ret + 1)) == NULL) {
-      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not realloc json string");
-      goto err;
+    s->tokcount *= 2;
+    if ((s->tok = realloc(s->tok, sizeof(jsmntok_t) * s->tokcount)) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not realloc tokens");
+      return ERR_FATAL;
     }
-    strncpy(js + jslen, buf, ret);
-    jslen += ret;
   }
-  js[jslen] = '\0';
-
-again:
-  if ((ret = jsmn_parse(&p, js, jslen, tok, tokcount)) < 0) {
-    if (ret == JSMN_ERROR_NOMEM) {
-      tokcount *= 2;
-      if ((tok = realloc(tok, sizeof(jsmntok_t) * tokcount)) == NULL) {
-        bgpstream_log(BGPSTREAM_LOG_ERR, "Could not realloc tokens");
-        goto err;
-      }
-      goto again;
-    }
-    if (ret == JSMN_ERROR_INVAL) {
-      bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid character in JSON string");
-      goto err;
-    }
-    bgpstream_log(BGPSTREAM_LOG_ERR, "JSON parser returned %d", ret);
-    goto err;
+  if (ret == JSMN_ERROR_INVAL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid character in JSON string");
+    return ERR_RETRY;
   }
-  ret = process_json(di, js, tok, p.toknext);
-
-  free(js);
-  free(tok);
-  if (ret == ERR_FATAL) {
-    bgpstream_log(BGPSTREAM_LOG_ERR,
-                  "Received fatal error from process_json");
+  if (ret < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "JSON parser returned %d", ret);
+    return ERR_RETRY;
   }
-  return ret;
-
-err:
-  free(js);
-  free(tok);
-  bgpstream_log(BGPSTREAM_LOG_ERR, "%s: Returning fatal error code",
-                __func__);
-  return ERR_FATAL;
+  return p.toknext;
 }
 
-static int update_query_url(bsdi_t *di)
+// appends c to the given buffer (keeping it NUL-terminated)
+static int json_append(char **buf, size_t *len, size_t *alloc, char c)
+{
+  char *tmp;
+
+  if (*len + 2 > *alloc) {
+    if ((tmp = realloc(*buf, *alloc * 2 + 1024)) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not realloc json string");
+      return ERR_FATAL;
+    }
+    *buf = tmp;
+    *alloc = *alloc * 2 + 1024;
+  }
+  (*buf)[(*len)++] = c;
+  (*buf)[*len] = '\0';
+  return 0;
+}
+
+#define APPEND(what)                                                           \
+  json_append(&s->what, &s->what##_len, &s->what##_alloc, c)
+
+// scans the next bytes of the response, pushing resources as soon as their
+// object has been read
+static int json_stream_feed(bsdi_t *di, json_stream_t *s, const char *buf,
+                            size_t len)
+{
+  size_t i;
+  char c;
+  int rc, open_res = 0;
+
+  for (i = 0; i < len; i++) {
+    c = buf[i];
+
+    // everything inside a resource object goes to the object buffer,
+    // everything between resources (except the closing bracket) is dropped,
+    // and everything else is the envelope
+    if (s->in_str != 0) {
+      if (s->esc != 0) {
+        s->esc = 0;
+      } else if (c == '\\') {
+        s->esc = 1;
+      } else if (c == '"') {
+        s->in_str = 0;
+        if (s->in_key != 0) {
+          s->keys[s->depth - 1][s->key_len] = '\0';
+        }
+      }
+      if (s->in_str != 0 && s->in_key != 0 && s->key_len < JSON_KEY_LEN - 1) {
+        s->keys[s->depth - 1][s->key_len++] = c;
+      }
+      rc = (s->res_depth == 0 || s->depth < s->res_depth)
+             ? APPEND(env)
+             : (s->depth > s->res_depth) ? APPEND(obj) : 0;
+      if (rc != 0) {
+        return rc;
+      }
+      continue;
+    }
+
+    switch (c) {
+    case '"':
+      s->in_str = 1;
+      s->in_key = (s->want_key != 0);
+      s->key_len = 0;
+      break;
+
+    case '{':
+    case '[':
+      if (s->depth == JSON_MAX_DEPTH) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Broker response nested too deeply");
+        return ERR_RETRY;
+      }
+      // data.resources is the only array that we stream
+      if (c == '[' && s->depth == 2 && s->res_depth == 0 &&
+          strcmp(s->keys[0], "data") == 0 &&
+          strcmp(s->keys[1], "resources") == 0) {
+        open_res = 1;
+      } else if (s->res_depth != 0 && s->depth == s->res_depth) {
+        // start of a resource object
+        s->obj_len = 0;
+      }
+      s->nest[s->depth] = c;
+      s->keys[s->depth][0] = '\0';
+      s->depth++;
+      s->want_key = (c == '{');
+      break;
+
+    case '}':
+    case ']':
+      if (s->depth == 0 || s->nest[s->depth - 1] != (c == '}' ? '{' : '[')) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Unbalanced broker response");
+        return ERR_RETRY;
+      }
+      break;
+
+    case ',':
+      s->want_key = (s->depth > 0 && s->nest[s->depth - 1] == '{');
+      break;
+
+    case ':':
+      s->want_key = 0;
+      break;
+    }
+
+    if (s->res_depth == 0 || s->depth < s->res_depth ||
+        (s->depth == s->res_depth && c == ']')) {
+      rc = APPEND(env);
+    } else if (s->depth > s->res_depth) {
+      rc = APPEND(obj);
+    } else {
+      rc = 0;
+    }
+    if (rc != 0) {
+      return rc;
+    }
+    if (open_res != 0) {
+      // the bracket itself belongs to the envelope
+      s->res_depth = s->depth;
+      open_res = 0;
+    }
+
+    if (c == '}' || c == ']') {
+      s->depth--;
+      if (s->res_depth != 0 && s->depth == s->res_depth && c == '}') {
+        // a whole resource object has been read
+        if ((rc = parse_json(s, s->obj, s->obj_len)) < 0 ||
+            (rc = process_resource(di, s, s->obj, s->tok)) != 0) {
+          return rc;
+        }
+      } else if (s->res_depth != 0 && s->depth < s->res_depth) {
+        // end of the resources array
+        s->res_depth = 0;
+      }
+    }
+  }
+
+  return 0;
+}
+
+// reads the broker response from jsonfile or, if jsonfile is NULL, from the
+// resp_len bytes at resp
+static int read_json(bsdi_t *di, io_t *jsonfile, const char *resp,
+                     size_t resp_len)
+{
+  json_stream_t s = {0};
+  char *buf = NULL;
+  int64_t len = 0;
+  int ret;
+
+  // allocate some tokens to start
+  s.tokcount = 128;
+  if ((s.tok = malloc(sizeof(jsmntok_t) * s.tokcount)) == NULL ||
+      (jsonfile != NULL && (buf = malloc(JSON_READ_LEN)) == NULL)) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not malloc JSON buffers");
+    ret = ERR_FATAL;
+    goto done;
+  }
+
+  if (jsonfile == NULL) {
+    if ((ret = json_stream_feed(di, &s, resp, resp_len)) != 0) {
+      goto done;
+    }
+  }
+  // resources are pushed while the response is still being read
+  while (jsonfile != NULL &&
+         (len = wandio_read(jsonfile, buf, JSON_READ_LEN)) > 0) {
+    if ((ret = json_stream_feed(di, &s, buf, len)) != 0) {
+      goto done;
+    }
+  }
+  if (len < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Reading from broker failed");
+    ret = ERR_RETRY;
+    goto done;
+  }
+  if (s.depth != 0 || s.in_str != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Truncated broker response");
+    ret = ERR_RETRY;
+    goto done;
+  }
+
+  // and finally the envelope (which has an empty resources array by now)
+  if ((ret = parse_json(&s, (s.env != NULL) ? s.env : "", s.env_len)) >= 0) {
+    ret = process_json(di, &s, s.env, s.tok, ret);
+  }
+
+done:
+  free(buf);
+  free(s.env);
+  free(s.obj);
+  free(s.tok);
+  free(s.url);
+  free(s.kafka_topic);
+  free(s.mirrors);
+  if (ret == ERR_FATAL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Received fatal error from process_json");
+  }
+  return ret;
+}
+
+static int update_query_url(bsdi_t *di)
 {
   bgpstream_filter_mgr_t *filter_mgr = BSDI_GET_FILTER_MGR(di);
 
@@ -668,9 +1104,10 @@ static int update_query_url(bsdi_t *di)
   // projects, collectors, bgp_types, res_types, and time_interval are
   // used as filters only if they are provided by the user
 
-  // projects
+  // projects (unless the query is split by them)
   char *f;
-  if (filter_mgr->projects != NULL) {
+  if (filter_mgr->projects != NULL &&
+      filter_mgr->projects != STATE->split_set) {
     bgpstream_str_set_rewind(filter_mgr->projects);
     while ((f = bgpstream_str_set_next(filter_mgr->projects)) != NULL) {
       AMPORQ;
@@ -678,8 +1115,9 @@ static int update_query_url(bsdi_t *di)
       APPEND_STR(f);
     }
   }
-  // collectors
-  if (filter_mgr->collectors != NULL) {
+  // collectors (unless the query is split by them)
+  if (filter_mgr->collectors != NULL &&
+      filter_mgr->collectors != STATE->split_set) {
     bgpstream_str_set_rewind(filter_mgr->collectors);
     while ((f = bgpstream_str_set_next(filter_mgr->collectors)) != NULL) {
       AMPORQ;
@@ -753,7 +1191,9 @@ static int update_query_url(bsdi_t *di)
     APPEND_STR(",");
 
     // END TIME
-    if (snprintf(int_buf, BUFLEN, "%" PRIu32, TIF->end_time) >= BUFLEN) {
+    if (snprintf(int_buf, BUFLEN, "%" PRIu32,
+                 (STATE->catalog_end != 0) ? STATE->catalog_end
+                                           : TIF->end_time) >= BUFLEN) {
       goto err;
     }
     APPEND_STR(int_buf);
@@ -763,13 +1203,386 @@ static int update_query_url(bsdi_t *di)
   // query later
   STATE->query_url_end = STATE->query_url_buf + strlen(STATE->query_url_buf);
   assert((*STATE->query_url_end) == '\0');
+  STATE->url_first_param = STATE->first_param;
+
+  return 0;
+
+err:
+  return -1;
+}
+
+static int is_live(bsdi_t *di)
+{
+  bgpstream_filter_mgr_t *filter_mgr = BSDI_GET_FILTER_MGR(di);
+
+  return (TIF == NULL || TIF->end_time == BGPSTREAM_FOREVER) &&
+         STATE->catalog_end == 0;
+}
+
+static int cmp_param(const void *a, const void *b)
+{
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// sets up the catalog key and path of q, if its response may be kept
+static void catalog_init_query(bsdi_t *di, broker_query_t *q)
+{
+  bgpstream_filter_mgr_t *filter_mgr = BSDI_GET_FILTER_MGR(di);
+  char *params[CATALOG_MAX_PARAMS];
+  int params_cnt = 0;
+  char *buf, *c, *tok;
+  uint64_t hash = 14695981039346656037ULL;
+  uint32_t end;
+  int i;
+
+  q->catalog_path[0] = '\0';
+  if (STATE->catalog_dir == NULL || is_live(di) != 0) {
+    return;
+  }
+  end = (STATE->catalog_end != 0) ? STATE->catalog_end : TIF->end_time;
+  if ((uint64_t)end + CATALOG_MIN_AGE > epoch_sec()) {
+    return;
+  }
+
+  // the order of the parameters does not change the response, so sort them
+  strcpy(q->catalog_key, q->url);
+  if ((buf = strchr(q->catalog_key, '?')) != NULL) {
+    *(buf++) = '\0';
+    c = buf = strdup(buf);
+    if (buf == NULL) {
+      return;
+    }
+    while ((tok = strsep(&c, "&")) != NULL) {
+      if (params_cnt == CATALOG_MAX_PARAMS) {
+        free(buf);
+        return;
+      }
+      params[params_cnt++] = tok;
+    }
+    qsort(params, params_cnt, sizeof(char *), cmp_param);
+    for (i = 0; i < params_cnt; i++) {
+      strcat(q->catalog_key, (i == 0) ? "?" : "&");
+      strcat(q->catalog_key, params[i]);
+    }
+    free(buf);
+  }
 
+  // FNV-1a
+  for (c = q->catalog_key; *c != '\0'; c++) {
+    hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+  }
+  if (snprintf(q->catalog_path, PATH_MAX, "%s/broker-%016" PRIx64 ".json",
+               STATE->catalog_dir, hash) >= PATH_MAX) {
+    q->catalog_path[0] = '\0';
+  }
+}
+
+// reads the response to q from the catalog. returns 0 if it was there
+static int catalog_load(broker_query_t *q)
+{
+  FILE *f;
+  long len;
+  size_t key_len = strlen(q->catalog_key);
+
+  if ((f = fopen(q->catalog_path, "r")) == NULL) {
+    return -1;
+  }
+  if (fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0 ||
+      fseek(f, 0, SEEK_SET) != 0 || (size_t)len <= key_len) {
+    goto err;
+  }
+  if (q->resp_alloc < (size_t)len) {
+    free(q->resp);
+    q->resp_alloc = 0;
+    if ((q->resp = malloc(len)) == NULL) {
+      goto err;
+    }
+    q->resp_alloc = len;
+  }
+  if (fread(q->resp, 1, len, f) != (size_t)len) {
+    goto err;
+  }
+  fclose(f);
+
+  // the file starts with the key it is for (a hash collision is a miss)
+  if (memcmp(q->resp, q->catalog_key, key_len) != 0 ||
+      q->resp[key_len] != '\n') {
+    return -1;
+  }
+  q->resp_len = len - key_len - 1;
+  memmove(q->resp, q->resp + key_len + 1, q->resp_len);
   return 0;
 
 err:
+  fclose(f);
   return -1;
 }
 
+// keeps the response to q in the catalog (if it may be kept)
+static void catalog_store(broker_query_t *q)
+{
+  char tmp[PATH_MAX];
+  FILE *f;
+
+  if (q->catalog_path[0] == '\0' || q->from_catalog != 0) {
+    return;
+  }
+  // written aside first so that concurrent readers never see part of it
+  if (snprintf(tmp, PATH_MAX, "%s.%d.tmp", q->catalog_path, (int)getpid()) >=
+        PATH_MAX ||
+      (f = fopen(tmp, "w")) == NULL) {
+    return;
+  }
+  if (fprintf(f, "%s\n", q->catalog_key) < 0 ||
+      fwrite(q->resp, 1, q->resp_len, f) != q->resp_len) {
+    fclose(f);
+    unlink(tmp);
+    return;
+  }
+  if (fclose(f) != 0 || rename(tmp, q->catalog_path) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_WARN, "Could not add %s to the catalog: %s",
+                  q->catalog_path, strerror(errno));
+    unlink(tmp);
+  }
+}
+
+// removes the response to q from the catalog if it turned out to be invalid
+static void catalog_drop(broker_query_t *q)
+{
+  if (q->from_catalog != 0) {
+    bgpstream_log(BGPSTREAM_LOG_WARN, "Removing invalid catalog entry %s",
+                  q->catalog_path);
+    unlink(q->catalog_path);
+    q->from_catalog = 0;
+  }
+}
+
+// builds the URL of the next request of q from the common query url
+static int build_query_url(bsdi_t *di, broker_query_t *q)
+{
+  // we need to set two parameters:
+  //  - dataAddedSince ("time" from last response we got)
+  //  - minInitialTime (max("initialTime"+"duration") of any file we've ever
+  //  seen)
+
+#define BUFLEN 20
+  char buf[BUFLEN];
+
+  // reset the variable params
+  *STATE->query_url_end = '\0';
+  STATE->query_url_remaining = URL_BUFLEN - strlen(STATE->query_url_buf);
+  STATE->first_param = STATE->url_first_param;
+
+  if (q->params != NULL) {
+    AMPORQ;
+    APPEND_STR(q->params);
+  }
+
+  if (q->last_response_time > 0 && is_live(di) != 0) {
+    // need to add dataAddedSince
+    if (snprintf(buf, BUFLEN, "%" PRIu32, q->last_response_time) >= BUFLEN) {
+      bgpstream_log(BGPSTREAM_LOG_ERR,
+                    "Could not build dataAddedSince param string");
+      goto err;
+    }
+    AMPORQ;
+    APPEND_STR("dataAddedSince=");
+    APPEND_STR(buf);
+  }
+  if (q->current_window_end > 0) {
+    // need to add minInitialTime
+    if (snprintf(buf, BUFLEN, "%" PRIu32, q->current_window_end) >= BUFLEN) {
+      bgpstream_log(BGPSTREAM_LOG_ERR,
+                    "Could not build minInitialTime param string");
+      goto err;
+    }
+    AMPORQ;
+    APPEND_STR("minInitialTime=");
+    APPEND_STR(buf);
+  }
+
+  strcpy(q->url, STATE->query_url_buf);
+  q->res_pushed = 0;
+  catalog_init_query(di, q);
+  return 0;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Could not build broker query URL");
+  return -1;
+}
+
+// reads the whole response to q into q->resp (run by the fetch thread)
+static int fetch_response(broker_query_t *q)
+{
+  io_t *jsonfile;
+  int64_t len;
+  char *tmp;
+
+  q->from_catalog = 0;
+  if (q->catalog_path[0] != '\0' && catalog_load(q) == 0) {
+    q->from_catalog = 1;
+    return 0;
+  }
+
+#ifdef BROKER_DEBUG
+  bgpstream_log(BGPSTREAM_LOG_INFO, "Query URL: \"%s\"", q->url);
+#endif
+
+  if ((jsonfile = wandio_create(q->url)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open %s for reading", q->url);
+    return ERR_RETRY;
+  }
+
+  q->resp_len = 0;
+  do {
+    if (q->resp_alloc - q->resp_len < JSON_READ_LEN) {
+      if ((tmp = realloc(q->resp, q->resp_alloc * 2 + JSON_READ_LEN)) ==
+          NULL) {
+        wandio_destroy(jsonfile);
+        return ERR_FATAL;
+      }
+      q->resp = tmp;
+      q->resp_alloc = q->resp_alloc * 2 + JSON_READ_LEN;
+    }
+    if ((len = wandio_read(jsonfile, q->resp + q->resp_len, JSON_READ_LEN)) >
+        0) {
+      q->resp_len += len;
+    }
+  } while (len > 0);
+  wandio_destroy(jsonfile);
+
+  if (len < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Reading from broker failed");
+    return ERR_RETRY;
+  }
+  return 0;
+}
+
+static void *fetch_thread(void *user)
+{
+  broker_query_t *q = (broker_query_t *)user;
+
+  q->resp_rc = fetch_response(q);
+  return NULL;
+}
+
+// starts fetching the response to q in the background
+static int start_fetch(broker_query_t *q)
+{
+  assert(q->fetching == 0);
+  if (pthread_create(&q->thread, NULL, fetch_thread, q) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not start broker fetch thread");
+    return -1;
+  }
+  q->fetching = 1;
+  return 0;
+}
+
+// waits for the background fetch of q, returns its result
+static int finish_fetch(broker_query_t *q)
+{
+  assert(q->fetching != 0);
+  pthread_join(q->thread, NULL);
+  q->fetching = 0;
+  return q->resp_rc;
+}
+
+// bring the memory stats up to date with the response buffer of the query
+static void account_resp(bsdi_t *di, broker_query_t *q)
+{
+  bgpstream_mem_add(bgpstream_resource_mgr_get_mem(BSDI_GET_RES_MGR(di)),
+                    BGPSTREAM_MEM_BROKER,
+                    (int64_t)q->resp_alloc - (int64_t)q->resp_accounted);
+  q->resp_accounted = q->resp_alloc;
+}
+
+// splits the query if asked to and if the filters allow it
+static int init_queries(bsdi_t *di)
+{
+  bgpstream_filter_mgr_t *filter_mgr = BSDI_GET_FILTER_MGR(di);
+  const char *key = NULL;
+  broker_query_t *q;
+  char *f, *tmp;
+  size_t len;
+  int i = 0;
+
+  STATE->queries_cnt = 1;
+  if (STATE->parallel_queries <= 1) {
+    return 0;
+  }
+  if (filter_mgr->collectors != NULL &&
+      bgpstream_str_set_size(filter_mgr->collectors) > 1) {
+    STATE->split_set = filter_mgr->collectors;
+    key = "collectors[]=";
+  } else if (filter_mgr->projects != NULL &&
+             bgpstream_str_set_size(filter_mgr->projects) > 1) {
+    STATE->split_set = filter_mgr->projects;
+    key = "projects[]=";
+  } else {
+    bgpstream_log(BGPSTREAM_LOG_INFO,
+                  "Not splitting broker query: it needs more than one "
+                  "collector or project");
+    return 0;
+  }
+
+  STATE->queries_cnt = bgpstream_str_set_size(STATE->split_set);
+  if (STATE->queries_cnt > STATE->parallel_queries) {
+    STATE->queries_cnt = STATE->parallel_queries;
+  }
+
+  // deal the collectors (or projects) out to the sub-queries
+  bgpstream_str_set_rewind(STATE->split_set);
+  while ((f = bgpstream_str_set_next(STATE->split_set)) != NULL) {
+    q = &STATE->queries[i++ % STATE->queries_cnt];
+    len = (q->params != NULL) ? strlen(q->params) : 0;
+    if ((tmp = realloc(q->params, len + strlen(key) + strlen(f) + 2)) ==
+        NULL) {
+      return -1;
+    }
+    q->params = tmp;
+    sprintf(q->params + len, "%s%s%s", (len != 0) ? "&" : "", key, f);
+  }
+  return 0;
+}
+
+// parses a size such as "512M" into a number of bytes
+static int parse_size(const char *str, uint64_t *size)
+{
+  char *end;
+  unsigned long long val;
+  int shift = 0;
+
+  errno = 0;
+  val = strtoull(str, &end, 10);
+  if (end == str || errno != 0 || *str == '-') {
+    return -1;
+  }
+  switch (*end) {
+  case 'T':
+  case 't':
+    shift += 10;
+    /* fall through */
+  case 'G':
+  case 'g':
+    shift += 10;
+    /* fall through */
+  case 'M':
+  case 'm':
+    shift += 10;
+    /* fall through */
+  case 'K':
+  case 'k':
+    shift += 10;
+    end++;
+    break;
+  }
+  if (*end != '\0' || (shift != 0 && val > (UINT64_MAX >> shift))) {
+    return -1;
+  }
+  *size = (uint64_t)val << shift;
+  return 0;
+}
+
 /* ========== PUBLIC METHODS BELOW HERE ========== */
 
 int bsdi_broker_init(bsdi_t *di)
@@ -785,6 +1598,8 @@ int bsdi_broker_init(bsdi_t *di)
   if ((state->broker_url = strdup(BGPSTREAM_DI_BROKER_URL)) == NULL) {
     goto err;
   }
+  state->prefetch = 1;
+  state->parallel_queries = 1;
 
   return 0;
 err:
@@ -794,6 +1609,24 @@ err:
 
 int bsdi_broker_start(bsdi_t *di)
 {
+  bgpstream_filter_mgr_t *filter_mgr = BSDI_GET_FILTER_MGR(di);
+  uint32_t end;
+
+  if (init_queries(di) != 0) {
+    return -1;
+  }
+
+  // a live query can use the catalog for the settled part of its history. the
+  // end of that part is aligned to a day so that runs during the same day
+  // share catalog entries
+  if (STATE->catalog_dir != NULL && TIF != NULL &&
+      TIF->end_time == BGPSTREAM_FOREVER) {
+    end = (epoch_sec() - CATALOG_MIN_AGE) / 86400 * 86400;
+    if (end > TIF->begin_time) {
+      STATE->catalog_end = end;
+    }
+  }
+
   return update_query_url(di);
 }
 
@@ -801,6 +1634,10 @@ int bsdi_broker_set_option(bsdi_t *di,
                            const bgpstream_data_interface_option_t *option_type,
                            const char *option_value)
 {
+  uint64_t cache_size;
+  unsigned long hot_reads, val;
+  char buf[32], *end;
+
   switch (option_type->id) {
   case OPTION_BROKER_URL:
     // replaces our current URL
@@ -836,6 +1673,69 @@ int bsdi_broker_set_option(bsdi_t *di,
     }
     break;
 
+  case OPTION_CACHE_SIZE:
+    // normalize to a number of bytes so that transports need not parse it
+    if (parse_size(option_value, &cache_size) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid cache size: %s", option_value);
+      return -1;
+    }
+    snprintf(buf, sizeof(buf), "%" PRIu64, cache_size);
+    free(STATE->cache_size);
+    if ((STATE->cache_size = strdup(buf)) == NULL) {
+      return -1;
+    }
+    break;
+
+  case OPTION_CACHE_HOT_READS:
+    errno = 0;
+    hot_reads = strtoul(option_value, &end, 10);
+    if (end == option_value || *end != '\0' || errno != 0 ||
+        hot_reads == 0 || hot_reads > UINT32_MAX) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid cache hot reads: %s",
+                    option_value);
+      return -1;
+    }
+    snprintf(buf, sizeof(buf), "%lu", hot_reads);
+    free(STATE->cache_hot_reads);
+    if ((STATE->cache_hot_reads = strdup(buf)) == NULL) {
+      return -1;
+    }
+    break;
+
+  case OPTION_CATALOG_DIR:
+    if (access(option_value, W_OK) == -1) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Cannot access catalog directory %s: %s.",
+                    option_value, strerror(errno));
+      return -1;
+    }
+    free(STATE->catalog_dir);
+    if ((STATE->catalog_dir = strdup(option_value)) == NULL) {
+      return -1;
+    }
+    break;
+
+  case OPTION_PREFETCH:
+    if (strcmp(option_value, "0") != 0 && strcmp(option_value, "1") != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid prefetch setting: %s",
+                    option_value);
+      return -1;
+    }
+    STATE->prefetch = (option_value[0] == '1');
+    break;
+
+  case OPTION_PARALLEL_QUERIES:
+    errno = 0;
+    val = strtoul(option_value, &end, 10);
+    if (end == option_value || *end != '\0' || errno != 0 || val == 0 ||
+        val > MAX_QUERIES) {
+      bgpstream_log(BGPSTREAM_LOG_ERR,
+                    "Invalid number of parallel queries: %s (must be 1-%d)",
+                    option_value, MAX_QUERIES);
+      return -1;
+    }
+    STATE->parallel_queries = val;
+    break;
+
 #if WITH_KAFKA
   case OPTION_KAFKA_GROUP:
     // replaces our current group
@@ -888,6 +1788,23 @@ void bsdi_broker_destroy(bsdi_t *di)
   free(STATE->cache_dir);
   STATE->cache_dir = NULL;
 
+  free(STATE->cache_size);
+  STATE->cache_size = NULL;
+
+  free(STATE->cache_hot_reads);
+  STATE->cache_hot_reads = NULL;
+
+  free(STATE->catalog_dir);
+  STATE->catalog_dir = NULL;
+
+  for (i = 0; i < MAX_QUERIES; i++) {
+    if (STATE->queries[i].fetching != 0) {
+      finish_fetch(&STATE->queries[i]);
+    }
+    free(STATE->queries[i].params);
+    free(STATE->queries[i].resp);
+  }
+
 #if WITH_KAFKA
   free(STATE->kafka_group);
   STATE->kafka_group = NULL;
@@ -900,50 +1817,91 @@ void bsdi_broker_destroy(bsdi_t *di)
   BSDI_SET_STATE(di, NULL);
 }
 
-int bsdi_broker_update_resources(bsdi_t *di)
+// reads the response to the single (unsplit) query, retrying until it
+// succeeds. a prefetched response is used if there is one, otherwise the
+// response is processed while it is being read (unless it is for the catalog)
+static int update_single(bsdi_t *di, broker_query_t *q)
 {
-  bgpstream_filter_mgr_t *filter_mgr = BSDI_GET_FILTER_MGR(di);
-
-  // we need to set two parameters:
-  //  - dataAddedSince ("time" from last response we got)
-  //  - minInitialTime (max("initialTime"+"duration") of any file we've ever
-  //  seen)
-
-#define BUFLEN 20
-  char buf[BUFLEN];
-
   io_t *jsonfile = NULL;
 
-  int rc;
+  int rc = ERR_RETRY;
   int attempts = 0;
   int wait_time = 1;
 
-  int success = 0;
+  if (q->fetching == 0 && build_query_url(di, q) != 0) {
+    goto err;
+  }
 
-  if (STATE->last_response_time > 0 &&
-      (TIF == NULL || TIF->end_time == BGPSTREAM_FOREVER)) {
-    // need to add dataAddedSince
-    if (snprintf(buf, BUFLEN, "%" PRIu32, STATE->last_response_time) >=
-        BUFLEN) {
+  while (rc != 0) {
+    if (attempts > 0) {
+      bgpstream_log(BGPSTREAM_LOG_WARN,
+                    "WARN: Broker request failed, waiting %ds before retry",
+                    wait_time);
+      sleep(wait_time);
+      if (wait_time < MAX_WAIT_TIME) {
+        wait_time *= 2;
+      }
+    }
+    attempts++;
+
+    if (q->fetching != 0 || q->catalog_path[0] != '\0') {
+      rc = (q->fetching != 0) ? finish_fetch(q) : fetch_response(q);
+      account_resp(di, q);
+      if (rc == 0) {
+        rc = read_json(di, NULL, q->resp, q->resp_len);
+      }
+    } else {
+#ifdef BROKER_DEBUG
+      bgpstream_log(BGPSTREAM_LOG_INFO, "Query URL: \"%s\"", q->url);
+#endif
+      if ((jsonfile = wandio_create(q->url)) == NULL) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open %s for reading",
+                      q->url);
+        continue;
+      }
+      rc = read_json(di, jsonfile, NULL, 0);
+      wandio_destroy(jsonfile);
+      jsonfile = NULL;
+    }
+
+    if (rc == ERR_FATAL) {
       bgpstream_log(BGPSTREAM_LOG_ERR,
-                    "Could not build dataAddedSince param string");
+                    "Received fatal error code from read_json");
       goto err;
     }
-    AMPORQ;
-    APPEND_STR("dataAddedSince=");
-    APPEND_STR(buf);
+    if (rc == ERR_RETRY) {
+      catalog_drop(q);
+    }
   }
-  if (STATE->current_window_end > 0) {
-    // need to add minInitialTime
-    if (snprintf(buf, BUFLEN, "%" PRIu32, STATE->current_window_end) >=
-        BUFLEN) {
-      bgpstream_log(BGPSTREAM_LOG_ERR,
-                    "Could not build minInitialTime param string");
-      goto err;
+  catalog_store(q);
+
+  return 0;
+
+err:
+  if (jsonfile != NULL) {
+    wandio_destroy(jsonfile);
+  }
+  return -1;
+}
+
+// fetches the responses to all sub-queries concurrently, retrying those that
+// fail until all of them succeed. the responses are only scanned for the end
+// of their window if scan_only is set, otherwise they are pushed
+static int update_split(bsdi_t *di, int scan_only)
+{
+  broker_query_t *q;
+
+  int i, rc;
+  int failed;
+  int attempts = 0;
+  int wait_time = 1;
+
+  for (i = 0; i < STATE->queries_cnt; i++) {
+    q = &STATE->queries[i];
+    q->done = 0;
+    if (q->fetching == 0 && build_query_url(di, q) != 0) {
+      return -1;
     }
-    AMPORQ;
-    APPEND_STR("minInitialTime=");
-    APPEND_STR(buf);
   }
 
   do {
@@ -958,44 +1916,139 @@ int bsdi_broker_update_resources(bsdi_t *di)
     }
     attempts++;
 
-#ifdef BROKER_DEBUG
-    bgpstream_log(BGPSTREAM_LOG_INFO, "Query URL: \"%s\"",
-                  STATE->query_url_buf);
-#endif
+    // (re-)start the fetches that have not been prefetched
+    for (i = 0; i < STATE->queries_cnt; i++) {
+      q = &STATE->queries[i];
+      if (q->done == 0 && q->fetching == 0 && start_fetch(q) != 0) {
+        return -1;
+      }
+    }
 
-    if ((jsonfile = wandio_create(STATE->query_url_buf)) == NULL) {
-      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open %s for reading",
-                    STATE->query_url_buf);
-      goto retry;
+    failed = 0;
+    for (i = 0; i < STATE->queries_cnt; i++) {
+      q = &STATE->queries[i];
+      if (q->done != 0) {
+        continue;
+      }
+      rc = finish_fetch(q);
+      account_resp(di, q);
+      if (rc == 0) {
+        STATE->cur = q;
+        STATE->scan_only = scan_only;
+        q->file_cnt = 0;
+        rc = read_json(di, NULL, q->resp, q->resp_len);
+        STATE->scan_only = 0;
+      }
+      if (rc == ERR_FATAL) {
+        return -1;
+      }
+      if (rc == ERR_RETRY) {
+        catalog_drop(q);
+        failed++;
+      } else {
+        catalog_store(q);
+        q->done = 1;
+      }
     }
+  } while (failed != 0);
 
-    if ((rc = read_json(di, jsonfile)) == ERR_FATAL) {
-      bgpstream_log(BGPSTREAM_LOG_ERR,
-                    "Received fatal error code from read_json");
+  return 0;
+}
+
+int bsdi_broker_update_resources(bsdi_t *di)
+{
+  broker_query_t *q;
+  uint32_t window_end = 0;
+  int file_cnt = 0;
+  int behind = 0;
+  int i;
+
+again:
+  if (STATE->queries_cnt == 1) {
+    q = STATE->cur = &STATE->queries[0];
+    q->file_cnt = 0;
+    if (update_single(di, q) != 0) {
+      goto err;
+    }
+  } else if (is_live(di) != 0) {
+    // new data can show up anywhere, so each sub-query follows its own window
+    if (update_split(di, 0) != 0) {
+      goto err;
+    }
+  } else {
+    // each sub-query gets a window of its own from the broker, but only the
+    // part that all of them cover can be read without going out of order. we
+    // find that first, and then push what starts before its end
+    if (update_split(di, 1) != 0) {
       goto err;
-    } else if (rc == ERR_RETRY) {
-      goto retry;
-    } else {
-      // success!
-      success = 1;
     }
+    for (i = 0; i < STATE->queries_cnt; i++) {
+      q = &STATE->queries[i];
+      if (q->file_cnt != 0 &&
+          (window_end == 0 || q->current_window_end < window_end)) {
+        window_end = q->current_window_end;
+      }
+    }
+    if (window_end != 0) {
+      STATE->window_limit = window_end;
+      for (i = 0; i < STATE->queries_cnt; i++) {
+        q = STATE->cur = &STATE->queries[i];
+        q->file_cnt = 0;
+        q->res_pushed = 0;
+        if (read_json(di, NULL, q->resp, q->resp_len) != 0) {
+          STATE->window_limit = 0;
+          goto err;
+        }
+        // the rest of the window of this sub-query is asked for again
+        q->current_window_end = window_end;
+      }
+      STATE->window_limit = 0;
+    }
+  }
 
-  retry:
-    if (jsonfile != NULL) {
-      wandio_destroy(jsonfile);
-      jsonfile = NULL;
+  for (i = 0; i < STATE->queries_cnt; i++) {
+    q = &STATE->queries[i];
+    file_cnt += q->file_cnt;
+  }
+
+  if (STATE->catalog_end != 0 && file_cnt == 0) {
+    // we are through the history that can be kept in the catalog, so carry
+    // on with the live edge from the end of the last window. the response
+    // time is only meaningful for the live query itself
+    bgpstream_log(BGPSTREAM_LOG_INFO,
+                  "Broker catalog window done, switching to live queries");
+    STATE->catalog_end = 0;
+    for (i = 0; i < STATE->queries_cnt; i++) {
+      STATE->queries[i].last_response_time = 0;
+    }
+    if (update_query_url(di) != 0) {
+      goto err;
     }
-  } while (success == 0);
+    goto again;
+  }
+
+  for (i = 0; i < STATE->queries_cnt; i++) {
+    q = &STATE->queries[i];
+    if (q->current_window_end + PREFETCH_LIVE_LAG < q->last_response_time) {
+      behind = 1;
+    }
+  }
+
+  // as long as there is more to come, start fetching the next window while
+  // this one is read
+  if (STATE->prefetch != 0 && file_cnt != 0 &&
+      (is_live(di) == 0 || behind != 0)) {
+    for (i = 0; i < STATE->queries_cnt; i++) {
+      q = &STATE->queries[i];
+      if (build_query_url(di, q) != 0 || start_fetch(q) != 0) {
+        goto err;
+      }
+    }
+  }
 
-  // reset the variable params
-  *STATE->query_url_end = '\0';
-  STATE->query_url_remaining = URL_BUFLEN - strlen(STATE->query_url_end);
   return 0;
 
 err:
   bgpstream_log(BGPSTREAM_LOG_ERR, "Fatal error in broker data source");
-  if (jsonfile != NULL) {
-    wandio_destroy(jsonfile);
-  }
   return -1;
 }
@@ -30,13 +30,20 @@
 #include "utils.h"
 #include "libcsv/csv.h"
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <wandio.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 
 #define STATE (BSDI_GET_STATE(di, csvfile))
 #define TIF filter_mgr->time_interval
@@ -95,6 +102,29 @@ typedef struct bsdi_csvfile_state {
   uint32_t last_processed_ts;
   /* maximum timestamp accepted in the current round */
   uint32_t max_accepted_ts;
+
+  /* tail-follow state (for plain local files): */
+
+  // is the CSV file followed (rather than re-read on every update)?
+  int tail;
+
+  // has the file been read at least once?
+  int started;
+
+  // offset up to which the file has been read, and the file it is in
+  off_t offset;
+  dev_t dev;
+  ino_t ino;
+
+  // offset of the line being parsed
+  off_t line_off;
+
+  // offset of the first line that was too new to accept (-1 if none), which
+  // is where the next update starts reading again
+  off_t resume_off;
+
+  // inotify instance watching the file (-1 if none)
+  int inotify_fd;
 } bsdi_csvfile_state_t;
 
 enum {
@@ -237,6 +267,12 @@ static void parse_rowend(int c, void *user_data)
   /* ensure fields read is compliant with the expected file format */
   assert(STATE->current_field == CSVFILE_FIELDCNT);
 
+  /* lines that are too new are read again by the next update */
+  if (STATE->tail != 0 && STATE->timestamp > STATE->max_accepted_ts &&
+      STATE->resume_off == -1) {
+    STATE->resume_off = STATE->line_off;
+  }
+
   /* check if the timestamp is acceptable */
   if (STATE->timestamp > STATE->last_processed_ts &&
       STATE->timestamp <= STATE->max_accepted_ts) {
@@ -257,6 +293,177 @@ static void parse_rowend(int c, void *user_data)
   STATE->current_field = 0;
 }
 
+/* Number of bytes of the CSV file read at once when following it */
+#define TAIL_BUF_LEN 65536
+
+// checks whether the CSV file is a plain (uncompressed) local file, that can
+// be followed by offset
+static int can_tail(const char *path)
+{
+  static const uint8_t magics[][4] = {
+    {0x1f, 0x8b},             // gzip
+    {'B', 'Z', 'h'},          // bzip2
+    {0xfd, '7', 'z', 'X'},    // xz
+    {0x28, 0xb5, 0x2f, 0xfd}, // zstd
+    {0x04, 0x22, 0x4d, 0x18}, // lz4
+  };
+  uint8_t buf[4] = {0};
+  struct stat st;
+  unsigned int i, j;
+  int fd;
+
+  if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) ||
+      (fd = open(path, O_RDONLY)) == -1) {
+    return 0;
+  }
+  if (read(fd, buf, sizeof(buf)) < 0) {
+    close(fd);
+    return 0;
+  }
+  close(fd);
+  for (i = 0; i < ARR_CNT(magics); i++) {
+    for (j = 0; j < sizeof(magics[i]) && magics[i][j] != 0; j++) {
+      if (buf[j] != magics[i][j]) {
+        break;
+      }
+    }
+    if (j == sizeof(magics[i]) || magics[i][j] == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+static void watch_file(bsdi_t *di)
+{
+  if (STATE->inotify_fd == -1 &&
+      (STATE->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1) {
+    return;
+  }
+  if (inotify_add_watch(STATE->inotify_fd, STATE->csv_file,
+                        IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF |
+                          IN_DELETE_SELF) == -1) {
+    // the file may be being replaced, so just poll it until it is back
+    close(STATE->inotify_fd);
+    STATE->inotify_fd = -1;
+  }
+}
+
+// returns 1 if the file may have changed since the last call
+static int file_changed(bsdi_t *di)
+{
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *ev;
+  int changed = 0, replaced = 0;
+  ssize_t len;
+  char *p;
+
+  if (STATE->inotify_fd == -1) {
+    watch_file(di);
+    return 1;
+  }
+  while ((len = read(STATE->inotify_fd, buf, sizeof(buf))) > 0) {
+    changed = 1;
+    for (p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+      ev = (const struct inotify_event *)p;
+      if (ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED)) {
+        replaced = 1;
+      }
+    }
+  }
+  if (replaced != 0) {
+    // follow whatever file is at the path now
+    close(STATE->inotify_fd);
+    STATE->inotify_fd = -1;
+    watch_file(di);
+  }
+  return changed;
+}
+#endif
+
+// reads the lines appended to the CSV file since the last update
+static int read_tail(bsdi_t *di)
+{
+  char *buf = NULL;
+  struct stat st;
+  char *line, *nl, *end;
+  off_t off;
+  ssize_t len;
+  int fd;
+
+  if ((fd = open(STATE->csv_file, O_RDONLY)) == -1 || fstat(fd, &st) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "can't open file %s: %s",
+                  STATE->csv_file, strerror(errno));
+    goto err;
+  }
+  if (STATE->started != 0 &&
+      (st.st_dev != STATE->dev || st.st_ino != STATE->ino ||
+       st.st_size < STATE->offset)) {
+    // already seen rows are skipped by their timestamp
+    bgpstream_log(BGPSTREAM_LOG_INFO,
+                  "CSV file %s was replaced, reading it from the start",
+                  STATE->csv_file);
+    STATE->offset = 0;
+  }
+  STATE->dev = st.st_dev;
+  STATE->ino = st.st_ino;
+  STATE->started = 1;
+  if (st.st_size == STATE->offset) {
+    close(fd);
+    return 0;
+  }
+
+  if ((buf = malloc(TAIL_BUF_LEN)) == NULL) {
+    goto err;
+  }
+  STATE->resume_off = -1;
+  off = STATE->offset;
+
+  // only complete lines are parsed, a line still being written is left for
+  // the next update
+  while ((len = pread(fd, buf, TAIL_BUF_LEN, off)) > 0) {
+    end = buf + len;
+    if ((nl = memrchr(buf, '\n', len)) == NULL) {
+      if (len == TAIL_BUF_LEN) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "CSV line at offset %" PRId64
+                      " is too long", (int64_t)off);
+        goto err;
+      }
+      break;
+    }
+    end = nl + 1;
+    for (line = buf; line < end; line = nl + 1) {
+      nl = memchr(line, '\n', end - line);
+      STATE->line_off = off + (line - buf);
+      if (csv_parse(&(STATE->parser), line, nl + 1 - line, parse_field,
+                    parse_rowend, di) != (size_t)(nl + 1 - line)) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "CSV parsing error %s",
+                      csv_strerror(csv_error(&STATE->parser)));
+        goto err;
+      }
+    }
+    off += end - buf;
+  }
+  if (len < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "can't read file %s: %s",
+                  STATE->csv_file, strerror(errno));
+    goto err;
+  }
+
+  STATE->offset = (STATE->resume_off != -1) ? STATE->resume_off : off;
+  free(buf);
+  close(fd);
+  return 0;
+
+err:
+  free(buf);
+  if (fd != -1) {
+    close(fd);
+  }
+  return -1;
+}
+
 /* ========== PUBLIC METHODS BELOW HERE ========== */
 
 int bsdi_csvfile_init(bsdi_t *di)
@@ -276,6 +483,8 @@ int bsdi_csvfile_init(bsdi_t *di)
     goto err;
   }
   STATE->current_field = CSVFILE_PATH;
+  STATE->resume_off = -1;
+  STATE->inotify_fd = -1;
 
   return 0;
 err:
@@ -286,6 +495,7 @@ err:
 int bsdi_csvfile_start(bsdi_t *di)
 {
   if (STATE->csv_file) {
+    STATE->tail = can_tail(STATE->csv_file);
     return 0;
   } else {
     bgpstream_log(BGPSTREAM_LOG_ERR, "The 'csv-file' option must be set");
@@ -327,6 +537,10 @@ void bsdi_csvfile_destroy(bsdi_t *di)
 
   csv_free(&STATE->parser);
 
+  if (STATE->inotify_fd != -1) {
+    close(STATE->inotify_fd);
+  }
+
   free(STATE);
   BSDI_SET_STATE(di, NULL);
 }
@@ -338,11 +552,26 @@ int bsdi_csvfile_update_resources(bsdi_t *di)
   char buffer[BUFFER_LEN];
   int read = 0;
 
+#ifdef HAVE_SYS_INOTIFY_H
+  /* nothing to do if nothing was appended (and no lines are waiting) */
+  if (STATE->tail != 0 && STATE->started != 0 && STATE->resume_off == -1 &&
+      file_changed(di) == 0) {
+    return 0;
+  }
+#endif
+
   /* we accept all timestamp earlier than now() - 1 second */
   STATE->max_accepted_ts = epoch_sec() - 1;
 
   STATE->max_ts_infile = 0;
 
+  if (STATE->tail != 0) {
+    if (read_tail(di) != 0) {
+      goto err;
+    }
+    goto done;
+  }
+
   if ((file_io = wandio_create(STATE->csv_file)) == NULL) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "can't open file %s", STATE->csv_file);
     goto err;
@@ -365,9 +594,16 @@ int bsdi_csvfile_update_resources(bsdi_t *di)
 
   wandio_destroy(file_io);
 
-  STATE->last_processed_ts = STATE->max_ts_infile;
+done:
+  /* a pass that finds nothing new must not let old rows in again */
+  if (STATE->max_ts_infile > STATE->last_processed_ts) {
+    STATE->last_processed_ts = STATE->max_ts_infile;
+  }
   return 0;
 
 err:
+  if (file_io != NULL) {
+    wandio_destroy(file_io);
+  }
   return -1;
 }
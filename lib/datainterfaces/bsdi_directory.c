@@ -0,0 +1,799 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bsdi_directory.h"
+#include "bgpstream_log.h"
+#include "bgpstream_summary.h"
+#include "config.h"
+#include "utils.h"
+#include <assert.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+#define STATE (BSDI_GET_STATE(di, directory))
+#define TIF filter_mgr->time_interval
+
+// seconds of dumps that are handed to the resource manager per update
+#define WINDOW_LEN (2 * 3600)
+
+// how deep below the root directory we look for dumps
+#define MAX_DEPTH 16
+
+// when rescanning a live tree, files modified less than this many seconds ago
+// may still be being written and are left for the next scan
+#define SETTLE_TIME 10
+
+// time spans of the dumps published by the RIS and RouteViews archives
+#define RIB_SPAN 120
+#define RIS_UPDATES_SPAN 300
+#define RV_UPDATES_SPAN 900
+
+/* ---------- START CLASS DEFINITION ---------- */
+
+/* define the internal option ID values */
+enum {
+  OPTION_DIR,
+};
+
+/* define the options this data interface accepts */
+static bgpstream_data_interface_option_t options[] = {
+  /* Root directory */
+  {
+    BGPSTREAM_DATA_INTERFACE_DIRECTORY, // interface ID
+    OPTION_DIR,                         // internal ID
+    "dir",                              // name
+    "directory tree holding the mrt dumps to read (default: " STR(
+      BGPSTREAM_DI_DIRECTORY_DIR) ")",
+  },
+};
+
+/* create the class structure for this data interface */
+BSDI_CREATE_CLASS(directory, BGPSTREAM_DATA_INTERFACE_DIRECTORY,
+                  "Retrieve MRT dumps from a local archive mirror", options)
+
+/* ---------- END CLASS DEFINITION ---------- */
+
+/* a dump found in the directory tree */
+typedef struct dir_entry {
+  char *path;
+  const char *project;
+  const char *collector;
+  bgpstream_record_type_t type;
+  uint32_t filetime;
+  uint32_t time_span;
+} dir_entry_t;
+
+/* a watched directory */
+typedef struct dir_watch {
+  char *path;
+  int depth;
+} dir_watch_t;
+
+typedef struct bsdi_directory_state {
+  /* user-provided options */
+
+  // Root of the directory tree to read
+  char *dir;
+
+  /* internal state: */
+
+  // is the tree followed for new dumps?
+  int live;
+
+  // project and collector names, which the entries point into
+  char **names;
+  int names_cnt;
+
+  // index of the name that was interned last (dumps of a collector usually
+  // come one after the other)
+  int last_name;
+
+  // catalogued dumps not pushed yet, sorted by time from next onwards when
+  // sorted is set
+  dir_entry_t *entries;
+  int entries_cnt;
+  int entries_alloc;
+  int next;
+  int sorted;
+
+  // every dump whose filetime is before this has been pushed
+  uint32_t pushed_until;
+
+  // project/collector/type/filetime of every dump catalogued so far, so that
+  // a dump is only read once however many copies of it the tree holds
+  bgpstream_str_set_t *seen;
+
+  // inotify instance watching every directory of the tree (-1 if none), and
+  // the directories, indexed by watch descriptor
+  int inotify_fd;
+  dir_watch_t *watches;
+  int watches_cnt;
+
+  // directories holding dumps that were still being written when they were
+  // scanned, and when to scan them again
+  dir_watch_t *unsettled;
+  int unsettled_cnt;
+  uint32_t unsettled_time;
+} bsdi_directory_state_t;
+
+/* ========== PRIVATE METHODS BELOW HERE ========== */
+
+// days since the epoch of a (proleptic gregorian) date
+static int64_t days_from_civil(int y, int m, int d)
+{
+  int64_t era;
+  int yoe, doy, doe;
+
+  y -= m <= 2;
+  era = (y >= 0 ? y : y - 399) / 400;
+  yoe = y - era * 400;
+  doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+// parse the "YYYYMMDD.HHMM" time of an archive file name, which must be
+// followed by the end of the name or by an extension
+static int parse_archive_time(const char *s, uint32_t *t)
+{
+  int y, mo, d, h, mi, i;
+
+  for (i = 0; i < 13; i++) {
+    if (i == 8 ? s[i] != '.' : !isdigit((unsigned char)s[i])) {
+      return -1;
+    }
+  }
+  if (s[13] != '\0' && s[13] != '.') {
+    return -1;
+  }
+  y = (s[0] - '0') * 1000 + (s[1] - '0') * 100 + (s[2] - '0') * 10 +
+      (s[3] - '0');
+  mo = (s[4] - '0') * 10 + (s[5] - '0');
+  d = (s[6] - '0') * 10 + (s[7] - '0');
+  h = (s[9] - '0') * 10 + (s[10] - '0');
+  mi = (s[11] - '0') * 10 + (s[12] - '0');
+  if (mo < 1 || mo > 12 || d < 1 || d > 31 || h > 23 || mi > 59) {
+    return -1;
+  }
+  *t = days_from_civil(y, mo, d) * 86400 + h * 3600 + mi * 60;
+  return 0;
+}
+
+// return the interned copy of the given name
+static const char *intern_name(bsdi_t *di, const char *name, size_t len)
+{
+  char **tmp;
+  int i;
+
+  for (i = STATE->last_name; i < STATE->names_cnt + STATE->last_name; i++) {
+    const char *n = STATE->names[i % STATE->names_cnt];
+    if (strncmp(n, name, len) == 0 && n[len] == '\0') {
+      STATE->last_name = i % STATE->names_cnt;
+      return n;
+    }
+  }
+
+  if ((tmp = realloc(STATE->names, sizeof(char *) * (STATE->names_cnt + 1))) ==
+      NULL) {
+    return NULL;
+  }
+  STATE->names = tmp;
+  if ((STATE->names[STATE->names_cnt] = strndup(name, len)) == NULL) {
+    return NULL;
+  }
+  STATE->last_name = STATE->names_cnt;
+  return STATE->names[STATE->names_cnt++];
+}
+
+// find the RIS or RouteViews collector an archive path belongs to: RIS keeps
+// the dumps of each collector below a "rrcNN" directory, RouteViews below
+// "<collector>/bgpdata" (or just "bgpdata" for route-views2)
+static int archive_collector(bsdi_t *di, const char *path, dir_entry_t *e)
+{
+  const char *c = path, *end, *prev = NULL;
+  size_t len, prev_len = 0;
+
+  while (*c != '\0') {
+    if ((end = strchr(c, '/')) == NULL) {
+      end = c + strlen(c);
+    }
+    len = end - c;
+    if (len == 5 && strncmp(c, "rrc", 3) == 0 && isdigit((unsigned char)c[3]) &&
+        isdigit((unsigned char)c[4])) {
+      e->project = intern_name(di, "ris", 3);
+      e->collector = intern_name(di, c, len);
+      return 0;
+    }
+    if (len == 7 && strncmp(c, "bgpdata", 7) == 0) {
+      e->project = intern_name(di, "routeviews", 10);
+      if (prev != NULL && prev_len > 11 &&
+          strncmp(prev, "route-views", 11) == 0) {
+        e->collector = intern_name(di, prev, prev_len);
+      } else {
+        e->collector = intern_name(di, "route-views2", 12);
+      }
+      return 0;
+    }
+    prev = c;
+    prev_len = len;
+    c = *end == '\0' ? end : end + 1;
+  }
+  return -1;
+}
+
+// work out which dump a file holds from its path. we know about the RIS and
+// RouteViews archive layouts and about the
+// "<project>.<collector>.<ribs|updates>.<filetime>[.ext]" names bgpstream
+// uses elsewhere. returns 0 if the file is a dump, 1 if not, -1 on error
+static int parse_path(bsdi_t *di, const char *path, dir_entry_t *e)
+{
+  const char *name, *p, *type;
+  char *end;
+  unsigned long t;
+  size_t len;
+
+  name = (name = strrchr(path, '/')) == NULL ? path : name + 1;
+  e->project = e->collector = NULL;
+
+  // summaries are named after the dump they describe
+  len = strlen(name);
+  if (len > strlen(BGPSTREAM_SUMMARY_SUFFIX) &&
+      strcmp(name + len - strlen(BGPSTREAM_SUMMARY_SUFFIX),
+             BGPSTREAM_SUMMARY_SUFFIX) == 0) {
+    return 1;
+  }
+
+  if ((type = strstr(name, ".ribs.")) != NULL) {
+    e->type = BGPSTREAM_RIB;
+  } else if ((type = strstr(name, ".updates.")) != NULL) {
+    e->type = BGPSTREAM_UPDATE;
+  }
+  if (type != NULL && (p = strchr(name, '.')) < type && p > name) {
+    errno = 0;
+    t = strtoul(strchr(type + 1, '.') + 1, &end, 10);
+    if (errno == 0 && t <= UINT32_MAX && isdigit((unsigned char)end[-1]) &&
+        (*end == '\0' || *end == '.')) {
+      e->filetime = t;
+      e->project = intern_name(di, name, p - name);
+      e->collector = intern_name(di, p + 1, type - p - 1);
+      goto found;
+    }
+  }
+
+  if (strncmp(name, "bview.", 6) == 0 || strncmp(name, "rib.", 4) == 0) {
+    e->type = BGPSTREAM_RIB;
+  } else if (strncmp(name, "updates.", 8) == 0) {
+    e->type = BGPSTREAM_UPDATE;
+  } else {
+    return 1;
+  }
+  if (parse_archive_time(strchr(name, '.') + 1, &e->filetime) != 0 ||
+      archive_collector(di, path, e) != 0) {
+    return 1;
+  }
+
+found:
+  if (e->project == NULL || e->collector == NULL) {
+    return -1;
+  }
+  if (e->type == BGPSTREAM_RIB) {
+    e->time_span = RIB_SPAN;
+  } else if (strcmp(e->project, "ris") == 0) {
+    e->time_span = RIS_UPDATES_SPAN;
+  } else {
+    e->time_span = RV_UPDATES_SPAN;
+  }
+  return 0;
+}
+
+static int filters_match(bsdi_t *di, dir_entry_t *e)
+{
+  bgpstream_filter_mgr_t *filter_mgr = BSDI_GET_FILTER_MGR(di);
+
+  // projects
+  if (filter_mgr->projects != NULL &&
+      bgpstream_str_set_exists(filter_mgr->projects, (char *)e->project) == 0) {
+    return 0;
+  }
+
+  // collectors
+  if (filter_mgr->collectors != NULL &&
+      bgpstream_str_set_exists(filter_mgr->collectors, (char *)e->collector) ==
+        0) {
+    return 0;
+  }
+
+  // bgp_types
+  if (filter_mgr->bgp_types != NULL &&
+      bgpstream_str_set_exists(filter_mgr->bgp_types, e->type == BGPSTREAM_RIB
+                                                        ? "ribs"
+                                                        : "updates") == 0) {
+    return 0;
+  }
+
+  // time_interval
+  if (TIF != NULL) {
+    // filetime (we consider 15 mins before to consider routeviews updates
+    // and 120 seconds to have some margins)
+    if (!(e->filetime >= (TIF->begin_time - (15 * 60) - 120) &&
+          (TIF->end_time == BGPSTREAM_FOREVER ||
+           e->filetime <= TIF->end_time))) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+// add a file to the catalog if it is a dump we want and have not seen yet
+static int add_file(bsdi_t *di, const char *path)
+{
+  dir_entry_t e, *tmp;
+  char key[BGPSTREAM_DUMP_MAX_LEN];
+  int rc;
+
+  if ((rc = parse_path(di, path, &e)) != 0) {
+    return rc < 0 ? -1 : 0;
+  }
+  if (filters_match(di, &e) == 0) {
+    return 0;
+  }
+  snprintf(key, sizeof(key), "%s/%s/%d/%" PRIu32, e.project, e.collector,
+           e.type, e.filetime);
+  if ((rc = bgpstream_str_set_insert(STATE->seen, key)) <= 0) {
+    return rc;
+  }
+
+  if (STATE->entries_cnt == STATE->entries_alloc) {
+    STATE->entries_alloc =
+      STATE->entries_alloc == 0 ? 1024 : STATE->entries_alloc * 2;
+    if ((tmp = realloc(STATE->entries,
+                       sizeof(dir_entry_t) * STATE->entries_alloc)) == NULL) {
+      return -1;
+    }
+    STATE->entries = tmp;
+  }
+  if ((e.path = strdup(path)) == NULL) {
+    return -1;
+  }
+  STATE->entries[STATE->entries_cnt++] = e;
+  STATE->sorted = 0;
+  return 0;
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+static void stop_watching(bsdi_t *di)
+{
+  int i;
+
+  for (i = 0; i < STATE->watches_cnt; i++) {
+    free(STATE->watches[i].path);
+  }
+  free(STATE->watches);
+  STATE->watches = NULL;
+  STATE->watches_cnt = 0;
+  if (STATE->inotify_fd != -1) {
+    close(STATE->inotify_fd);
+    STATE->inotify_fd = -1;
+  }
+}
+
+// watch a directory for new dumps and subdirectories. if we run out of
+// watches, we fall back to rescanning the tree on every update
+static int add_watch(bsdi_t *di, const char *path, int depth)
+{
+  dir_watch_t *tmp;
+  int wd, i;
+
+  if (STATE->inotify_fd == -1) {
+    return 0;
+  }
+  if ((wd = inotify_add_watch(STATE->inotify_fd, path,
+                              IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE |
+                                IN_ONLYDIR)) == -1) {
+    bgpstream_log(BGPSTREAM_LOG_WARN,
+                  "Could not watch %s (%s), rescanning %s on every update",
+                  path, strerror(errno), STATE->dir);
+    stop_watching(di);
+    return 0;
+  }
+  if (wd >= STATE->watches_cnt) {
+    if ((tmp = realloc(STATE->watches, sizeof(dir_watch_t) * (wd + 1))) ==
+        NULL) {
+      return -1;
+    }
+    STATE->watches = tmp;
+    for (i = STATE->watches_cnt; i <= wd; i++) {
+      STATE->watches[i].path = NULL;
+    }
+    STATE->watches_cnt = wd + 1;
+  }
+  // a directory that is watched already keeps its descriptor
+  if (STATE->watches[wd].path == NULL &&
+      (STATE->watches[wd].path = strdup(path)) == NULL) {
+    return -1;
+  }
+  STATE->watches[wd].depth = depth;
+  return 0;
+}
+#endif
+
+static int add_unsettled(bsdi_t *di, const char *path, int depth)
+{
+  dir_watch_t *tmp;
+
+  if ((tmp = realloc(STATE->unsettled,
+                     sizeof(dir_watch_t) * (STATE->unsettled_cnt + 1))) ==
+      NULL) {
+    return -1;
+  }
+  STATE->unsettled = tmp;
+  if ((tmp[STATE->unsettled_cnt].path = strdup(path)) == NULL) {
+    return -1;
+  }
+  tmp[STATE->unsettled_cnt++].depth = depth;
+  return 0;
+}
+// catalog the dumps below a directory
+static int scan_dir(bsdi_t *di, const char *path, int depth)
+{
+  DIR *dir;
+  struct dirent *de;
+  struct stat st;
+  char child[BGPSTREAM_DUMP_MAX_LEN];
+  uint32_t now = epoch_sec();
+  int fresh = 0;
+  int rc = -1;
+
+#ifdef HAVE_SYS_INOTIFY_H
+  // watch before listing so that nothing created meanwhile is missed
+  if (add_watch(di, path, depth) != 0) {
+    return -1;
+  }
+#endif
+  if ((dir = opendir(path)) == NULL) {
+    // the directory may have gone away since we were told about it
+    bgpstream_log(BGPSTREAM_LOG_WARN, "Could not open %s: %s", path,
+                  strerror(errno));
+    return depth == 0 ? -1 : 0;
+  }
+
+  while ((de = readdir(dir)) != NULL) {
+    // skip ".", ".." and the temporary files of rsync and friends
+    if (de->d_name[0] == '.') {
+      continue;
+    }
+    if (snprintf(child, sizeof(child), "%s/%s", path, de->d_name) >=
+        (int)sizeof(child)) {
+      bgpstream_log(BGPSTREAM_LOG_WARN, "Skipping %s/%s: path too long", path,
+                    de->d_name);
+      continue;
+    }
+    // symlinked directories are not followed, so the tree cannot loop
+    if (lstat(child, &st) != 0) {
+      continue;
+    }
+    if (S_ISDIR(st.st_mode)) {
+      if (depth < MAX_DEPTH && scan_dir(di, child, depth + 1) != 0) {
+        goto done;
+      }
+      continue;
+    }
+    if (S_ISLNK(st.st_mode) && (stat(child, &st) != 0 || S_ISDIR(st.st_mode))) {
+      continue;
+    }
+    if (!S_ISREG(st.st_mode)) {
+      continue;
+    }
+    if (STATE->live != 0 && st.st_mtime + SETTLE_TIME > now) {
+      fresh = 1;
+      continue;
+    }
+    if (add_file(di, child) != 0) {
+      goto done;
+    }
+  }
+  rc = 0;
+
+  // a dump that was closed before we started watching will not be reported,
+  // so we have to come back for it (rescans will find it anyway)
+  if (fresh != 0 && STATE->inotify_fd != -1) {
+    rc = add_unsettled(di, path, depth);
+    STATE->unsettled_time = now + SETTLE_TIME;
+  }
+
+done:
+  closedir(dir);
+  return rc;
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+// catalog the dumps and directories that appeared since the last update
+static int read_events(bsdi_t *di)
+{
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *ev;
+  char path[BGPSTREAM_DUMP_MAX_LEN];
+  ssize_t len;
+  char *p;
+  dir_watch_t *w;
+
+  while (STATE->inotify_fd != -1 &&
+         (len = read(STATE->inotify_fd, buf, sizeof(buf))) > 0) {
+    for (p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+      ev = (const struct inotify_event *)p;
+      if ((ev->mask & IN_Q_OVERFLOW) != 0) {
+        // we lost track, so look at everything again
+        bgpstream_log(BGPSTREAM_LOG_WARN, "Missed changes to %s, rescanning",
+                      STATE->dir);
+        return scan_dir(di, STATE->dir, 0);
+      }
+      if (ev->len == 0 || ev->name[0] == '.' || ev->wd < 0 ||
+          ev->wd >= STATE->watches_cnt ||
+          (w = &STATE->watches[ev->wd])->path == NULL) {
+        continue;
+      }
+      if (snprintf(path, sizeof(path), "%s/%s", w->path, ev->name) >=
+          (int)sizeof(path)) {
+        continue;
+      }
+      if ((ev->mask & IN_ISDIR) != 0) {
+        if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) != 0 &&
+            w->depth < MAX_DEPTH && scan_dir(di, path, w->depth + 1) != 0) {
+          return -1;
+        }
+      } else if ((ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0 &&
+                 add_file(di, path) != 0) {
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+// scan the directories that held dumps which were still being written
+static int scan_unsettled(bsdi_t *di)
+{
+  dir_watch_t *dirs = STATE->unsettled;
+  int cnt = STATE->unsettled_cnt, i, rc = 0;
+
+  if (cnt == 0 || epoch_sec() < STATE->unsettled_time) {
+    return 0;
+  }
+  // scanning may find more of them
+  STATE->unsettled = NULL;
+  STATE->unsettled_cnt = 0;
+  for (i = 0; i < cnt; i++) {
+    if (rc == 0 && scan_dir(di, dirs[i].path, dirs[i].depth) != 0) {
+      rc = -1;
+    }
+    free(dirs[i].path);
+  }
+  free(dirs);
+  return rc;
+}
+#endif
+
+// catalog the dumps that appeared since the last update
+static int refresh(bsdi_t *di)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+  if (STATE->inotify_fd != -1) {
+    if (read_events(di) != 0) {
+      return -1;
+    }
+    return scan_unsettled(di);
+  }
+#endif
+  // without inotify (or with more directories than we can watch) we look at
+  // the whole tree again
+  return scan_dir(di, STATE->dir, 0);
+}
+
+static int entry_cmp(const void *a, const void *b)
+{
+  const dir_entry_t *ea = a, *eb = b;
+
+  if (ea->filetime != eb->filetime) {
+    return ea->filetime < eb->filetime ? -1 : 1;
+  }
+  return strcmp(ea->path, eb->path);
+}
+
+static int get_fd(bsdi_t *di)
+{
+  return STATE->inotify_fd;
+}
+
+/* ========== PUBLIC METHODS BELOW HERE ========== */
+
+int bsdi_directory_init(bsdi_t *di)
+{
+  bsdi_directory_state_t *state;
+
+  if ((state = malloc_zero(sizeof(bsdi_directory_state_t))) == NULL) {
+    goto err;
+  }
+  BSDI_SET_STATE(di, state);
+
+  /* set default state */
+  state->inotify_fd = -1;
+  if ((state->seen = bgpstream_str_set_create()) == NULL) {
+    goto err;
+  }
+
+  di->get_fd = get_fd;
+
+  return 0;
+err:
+  bsdi_directory_destroy(di);
+  return -1;
+}
+
+int bsdi_directory_start(bsdi_t *di)
+{
+  bgpstream_filter_mgr_t *filter_mgr = BSDI_GET_FILTER_MGR(di);
+
+  if (STATE->dir == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "The 'dir' option must be set");
+    return -1;
+  }
+
+  // only a tree we keep reading from needs watching
+  STATE->live = TIF != NULL && TIF->end_time == BGPSTREAM_FOREVER;
+#ifdef HAVE_SYS_INOTIFY_H
+  if (STATE->live != 0 &&
+      (STATE->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1) {
+    bgpstream_log(BGPSTREAM_LOG_WARN,
+                  "Could not initialize inotify (%s), rescanning %s on every "
+                  "update",
+                  strerror(errno), STATE->dir);
+  }
+#endif
+
+  if (scan_dir(di, STATE->dir, 0) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not scan %s", STATE->dir);
+    return -1;
+  }
+  bgpstream_log(BGPSTREAM_LOG_FINE, "Found %d dumps below %s",
+                STATE->entries_cnt, STATE->dir);
+  return 0;
+}
+
+int bsdi_directory_set_option(
+  bsdi_t *di, const bgpstream_data_interface_option_t *option_type,
+  const char *option_value)
+{
+  size_t len;
+
+  switch (option_type->id) {
+  case OPTION_DIR:
+    // replaces our current directory
+    free(STATE->dir);
+    if ((STATE->dir = strdup(option_value)) == NULL) {
+      return -1;
+    }
+    // so that the paths we build have a single separator
+    len = strlen(STATE->dir);
+    while (len > 1 && STATE->dir[len - 1] == '/') {
+      STATE->dir[--len] = '\0';
+    }
+    break;
+
+  default:
+    return -1;
+  }
+
+  return 0;
+}
+
+void bsdi_directory_destroy(bsdi_t *di)
+{
+  int i;
+
+  if (di == NULL || STATE == NULL) {
+    return;
+  }
+
+  free(STATE->dir);
+  STATE->dir = NULL;
+
+  for (i = STATE->next; i < STATE->entries_cnt; i++) {
+    free(STATE->entries[i].path);
+  }
+  free(STATE->entries);
+
+  for (i = 0; i < STATE->names_cnt; i++) {
+    free(STATE->names[i]);
+  }
+  free(STATE->names);
+
+  bgpstream_str_set_destroy(STATE->seen);
+
+  for (i = 0; i < STATE->unsettled_cnt; i++) {
+    free(STATE->unsettled[i].path);
+  }
+  free(STATE->unsettled);
+
+#ifdef HAVE_SYS_INOTIFY_H
+  stop_watching(di);
+#endif
+
+  free(STATE);
+  BSDI_SET_STATE(di, NULL);
+}
+
+int bsdi_directory_update_resources(bsdi_t *di)
+{
+  dir_entry_t *e;
+  uint32_t window_end;
+
+  if (STATE->live != 0 && refresh(di) != 0) {
+    return -1;
+  }
+
+  if (STATE->next == STATE->entries_cnt) {
+    // everything has been pushed, so start over at the front
+    STATE->next = STATE->entries_cnt = 0;
+    return 0;
+  }
+  if (STATE->sorted == 0) {
+    qsort(&STATE->entries[STATE->next], STATE->entries_cnt - STATE->next,
+          sizeof(dir_entry_t), entry_cmp);
+    STATE->sorted = 1;
+  }
+
+  // push the next window of dumps, along with any that turned up late
+  window_end = STATE->entries[STATE->next].filetime + WINDOW_LEN;
+  if (window_end < STATE->pushed_until) {
+    window_end = STATE->pushed_until;
+  }
+  while (STATE->next < STATE->entries_cnt &&
+         (e = &STATE->entries[STATE->next])->filetime < window_end) {
+    if (bgpstream_resource_mgr_push(
+          BSDI_GET_RES_MGR(di), BGPSTREAM_RESOURCE_TRANSPORT_FILE,
+          BGPSTREAM_RESOURCE_FORMAT_MRT, e->path, e->filetime, e->time_span,
+          e->project, e->collector, e->type, NULL) < 0) {
+      return -1;
+    }
+    free(e->path);
+    STATE->next++;
+  }
+  STATE->pushed_until = window_end;
+
+  return 0;
+}
@@ -44,6 +44,7 @@ static const char *type_strs[] = {
   "mrt",      // BGPSTREAM_RESOURCE_FORMAT_MRT
   "bmp",      // BGPSTREAM_RESOURCE_FORMAT_BMP
   "ris-live",  // BGPSTREAM_RESOURCE_FORMAT_RISLIVE
+  "binary",   // BGPSTREAM_RESOURCE_FORMAT_BINARY
 };
 
 // allowed offset types
@@ -56,13 +57,35 @@ static const char *offset_strs[] = {
 
 /* define the internal option ID values */
 enum {
-  OPTION_BROKERS,        // stored in res->url
-  OPTION_TOPIC,          // stored in kafka_topic res attribute
-  OPTION_CONSUMER_GROUP, // allow multiple BGPStream instances to load-balance
-  OPTION_OFFSET,         // begin, end, committed
-  OPTION_DATA_TYPE,      //
-  OPTION_PROJECT,        //
-  OPTION_COLLECTOR,      //
+  OPTION_BROKERS,             // stored in res->url
+  OPTION_TOPIC,               // stored in kafka_topic res attribute
+  OPTION_CONSUMER_GROUP,      // allow multiple BGPStream instances to load-balance
+  OPTION_OFFSET,              // begin, end, committed
+  OPTION_DATA_TYPE,           //
+  OPTION_PROJECT,             //
+  OPTION_COLLECTOR,           //
+  OPTION_BATCH_SIZE,          // stored in kafka_batch_size res attribute
+  OPTION_FETCH_MAX_BYTES,     // the rest are stored in kafka_config
+  OPTION_FETCH_MIN_BYTES,     //
+  OPTION_FETCH_WAIT_MS,       //
+  OPTION_QUEUED_MAX_KBYTES,   //
+  OPTION_ASSIGNMENT_STRATEGY, //
+  OPTION_CONFIG,              // any other librdkafka consumer setting
+  OPTION_PARTITIONS,          // one resource per partition group
+  OPTION_PARTITION_STREAMS,   // split partitions into this many resources
+  OPTION_CHECKPOINT_INTERVAL, // commit acknowledged offsets this often
+};
+
+// mapping from tuning option to the librdkafka setting it controls
+static const struct {
+  int option;
+  const char *name;
+} config_names[] = {
+  {OPTION_FETCH_MAX_BYTES, "fetch.message.max.bytes"},
+  {OPTION_FETCH_MIN_BYTES, "fetch.min.bytes"},
+  {OPTION_FETCH_WAIT_MS, "fetch.wait.max.ms"},
+  {OPTION_QUEUED_MAX_KBYTES, "queued.max.messages.kbytes"},
+  {OPTION_ASSIGNMENT_STRATEGY, "partition.assignment.strategy"},
 };
 
 /* define the options this data interface accepts */
@@ -100,7 +123,7 @@ static bgpstream_data_interface_option_t options[] = {
     BGPSTREAM_DATA_INTERFACE_KAFKA, // interface ID
     OPTION_DATA_TYPE,               // internal ID
     "data-type",                    // name
-    "data type (mrt/bmp/ris-live) (default: bmp)",
+    "data type (mrt/bmp/ris-live/binary) (default: bmp)",
   },
   /* Project */
   {
@@ -116,6 +139,78 @@ static bgpstream_data_interface_option_t options[] = {
     "collector",                    // name
     "set collector name (default: unset)",
   },
+  /* Batch size */
+  {
+    BGPSTREAM_DATA_INTERFACE_KAFKA, // interface ID
+    OPTION_BATCH_SIZE,              // internal ID
+    "batch-size",                   // name
+    "max messages consumed at once (default: " STR(
+      BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_BATCH_SIZE) ")",
+  },
+  /* Max fetch size */
+  {
+    BGPSTREAM_DATA_INTERFACE_KAFKA, // interface ID
+    OPTION_FETCH_MAX_BYTES,         // internal ID
+    "fetch-max-bytes",              // name
+    "max bytes fetched per partition (default: " BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_FETCH_MAX_BYTES ")",
+  },
+  /* Min fetch size */
+  {
+    BGPSTREAM_DATA_INTERFACE_KAFKA, // interface ID
+    OPTION_FETCH_MIN_BYTES,         // internal ID
+    "fetch-min-bytes",              // name
+    "min bytes the broker waits for before answering a fetch (default: 1)",
+  },
+  /* Max fetch wait */
+  {
+    BGPSTREAM_DATA_INTERFACE_KAFKA, // interface ID
+    OPTION_FETCH_WAIT_MS,           // internal ID
+    "fetch-wait-ms",                // name
+    "max ms the broker waits to fill a fetch (default: " BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_FETCH_WAIT_MS ")",
+  },
+  /* Local queue size */
+  {
+    BGPSTREAM_DATA_INTERFACE_KAFKA, // interface ID
+    OPTION_QUEUED_MAX_KBYTES,       // internal ID
+    "queued-max-kbytes",            // name
+    "max KB prefetched into the local queue (default: librdkafka)",
+  },
+  /* Partition assignment strategy */
+  {
+    BGPSTREAM_DATA_INTERFACE_KAFKA, // interface ID
+    OPTION_ASSIGNMENT_STRATEGY,     // internal ID
+    "assignment-strategy",          // name
+    "partition assignment strategy (default: " BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_ASSIGNMENT_STRATEGY ")",
+  },
+  /* Arbitrary consumer setting */
+  {
+    BGPSTREAM_DATA_INTERFACE_KAFKA, // interface ID
+    OPTION_CONFIG,                  // internal ID
+    "config",                       // name
+    "set a librdkafka consumer setting (name=value) (repeatable)",
+  },
+  /* Explicit partition groups */
+  {
+    BGPSTREAM_DATA_INTERFACE_KAFKA, // interface ID
+    OPTION_PARTITIONS,              // internal ID
+    "partitions",                   // name
+    "partition groups to consume as separate streams (e.g., 0,1;2,3)",
+  },
+  /* Automatic partition groups */
+  {
+    BGPSTREAM_DATA_INTERFACE_KAFKA, // interface ID
+    OPTION_PARTITION_STREAMS,       // internal ID
+    "partition-streams",            // name
+    "split the topic partitions into this many streams (default: 1)",
+  },
+  /* Checkpointing */
+  {
+    BGPSTREAM_DATA_INTERFACE_KAFKA, // interface ID
+    OPTION_CHECKPOINT_INTERVAL,     // internal ID
+    "checkpoint-interval",          // name
+    "commit offsets of acknowledged records every N ms (requires group) "
+    "(default: disabled)",
+  },
 };
 
 /* create the class structure for this data interface */
@@ -146,14 +241,150 @@ typedef struct bsdi_kafka_state {
   // explicitly set collector name
   char *collector;
 
+  // Max number of messages consumed at once
+  char *batch_size;
+
+  // Newline-separated librdkafka settings (name=value)
+  char *config;
+
+  // Semicolon-separated groups of comma-separated partitions
+  char *partitions;
+
+  // Number of streams to split the partitions into (if partitions is unset)
+  int partition_streams;
+
+  // Only commit offsets of acknowledged records?
+  int checkpoint;
+
   // Type of the data to be consumed
   bgpstream_resource_format_type_t data_type;
 
-  // we only ever yield one resource
+  // we only ever yield one set of resources
   int done;
 
 } bsdi_kafka_state_t;
 
+/* ========== PRIVATE METHODS BELOW HERE ========== */
+
+// append a name=value setting to the config passed to the transport. later
+// settings override earlier ones with the same name
+static int add_config(bsdi_t *di, const char *name, const char *value)
+{
+  size_t len = (STATE->config != NULL) ? strlen(STATE->config) : 0;
+  size_t add = strlen(name) + 1 + strlen(value) + 1;
+  char *tmp;
+
+  if (strchr(value, '\n') != NULL) {
+    fprintf(stderr, "ERROR: Kafka setting '%s' must not contain newlines\n",
+            name);
+    return -1;
+  }
+  if ((tmp = realloc(STATE->config, len + add + 1)) == NULL) {
+    return -1;
+  }
+  STATE->config = tmp;
+  snprintf(STATE->config + len, add + 1, "%s=%s\n", name, value);
+  return 0;
+}
+
+// push a stream resource that consumes the given partitions (or all of them
+// if partitions is NULL)
+static int push_resource(bsdi_t *di, const char *partitions)
+{
+  int rc;
+  bgpstream_resource_t *res = NULL;
+
+  // we treat kafka as having data from <recent> to <forever>
+  if ((rc = bgpstream_resource_mgr_push(
+         BSDI_GET_RES_MGR(di), BGPSTREAM_RESOURCE_TRANSPORT_KAFKA,
+         STATE->data_type, STATE->brokers,
+         0, // indicate we don't know how much historical data there is
+         BGPSTREAM_FOREVER, // indicate that the resource is a "stream"
+         STATE->project, STATE->collector, BGPSTREAM_UPDATE, &res)) <= 0) {
+    return rc;
+  }
+  assert(res != NULL);
+
+  if (bgpstream_resource_set_attr(res, BGPSTREAM_RESOURCE_ATTR_KAFKA_TOPICS,
+                                  STATE->topic_name) != 0) {
+    return -1;
+  }
+
+  if (STATE->group != NULL &&
+      bgpstream_resource_set_attr(
+        res, BGPSTREAM_RESOURCE_ATTR_KAFKA_CONSUMER_GROUP, STATE->group) != 0) {
+    return -1;
+  }
+
+  if (STATE->offset != NULL &&
+      bgpstream_resource_set_attr(
+        res, BGPSTREAM_RESOURCE_ATTR_KAFKA_INIT_OFFSET, STATE->offset) != 0) {
+    return -1;
+  }
+
+  if (STATE->batch_size != NULL &&
+      bgpstream_resource_set_attr(
+        res, BGPSTREAM_RESOURCE_ATTR_KAFKA_BATCH_SIZE, STATE->batch_size) != 0) {
+    return -1;
+  }
+
+  if (STATE->config != NULL &&
+      bgpstream_resource_set_attr(res, BGPSTREAM_RESOURCE_ATTR_KAFKA_CONFIG,
+                                  STATE->config) != 0) {
+    return -1;
+  }
+
+  if (partitions != NULL &&
+      bgpstream_resource_set_attr(
+        res, BGPSTREAM_RESOURCE_ATTR_KAFKA_PARTITIONS, partitions) != 0) {
+    return -1;
+  }
+
+  if (STATE->checkpoint != 0 &&
+      bgpstream_resource_set_attr(res, BGPSTREAM_RESOURCE_ATTR_KAFKA_CHECKPOINT,
+                                  "1") != 0) {
+    return -1;
+  }
+
+  return 0;
+}
+
+// split the partitions of the topic into contiguous groups and push a
+// resource for each
+static int push_partition_streams(bsdi_t *di)
+{
+  int cnt, streams, p, i;
+  char *buf = NULL;
+  size_t len;
+
+  if ((cnt = bs_transport_kafka_get_partition_cnt(STATE->brokers,
+                                                  STATE->topic_name)) <= 0) {
+    fprintf(stderr, "ERROR: Could not get the partitions of '%s'\n",
+            STATE->topic_name);
+    return -1;
+  }
+  streams = (STATE->partition_streams < cnt) ? STATE->partition_streams : cnt;
+
+  // room for every partition id (and separator) of the largest group
+  if ((buf = malloc((cnt / streams + 1) * 12)) == NULL) {
+    return -1;
+  }
+  p = 0;
+  for (i = 0; i < streams; i++) {
+    len = 0;
+    for (; p < cnt && (int64_t)p * streams / cnt == i; p++) {
+      len += sprintf(buf + len, "%s%d", (len == 0) ? "" : ",", p);
+    }
+    if (push_resource(di, buf) < 0) {
+      free(buf);
+      return -1;
+    }
+  }
+
+  free(buf);
+  return 0;
+}
+
 /* ========== PUBLIC METHODS BELOW HERE ========== */
 
 int bsdi_kafka_init(bsdi_t *di)
@@ -190,6 +421,12 @@ int bsdi_kafka_start(bsdi_t *di)
       "ERROR: The kafka data interface requires the 'topic' option be set\n");
     return -1;
   }
+  if (STATE->checkpoint != 0 && STATE->group == NULL) {
+    // a random group would never see its own checkpoints again
+    fprintf(stderr, "ERROR: The kafka data interface requires the 'group' "
+                    "option be set to use checkpoints\n");
+    return -1;
+  }
   return 0;
 }
 
@@ -198,6 +435,14 @@ int bsdi_kafka_set_option(bsdi_t *di,
                           const char *option_value)
 {
   int found = 0;
+  char *name, *value;
+  int rc;
+
+  for (int i = 0; i < ARR_CNT(config_names); i++) {
+    if (config_names[i].option == option_type->id) {
+      return add_config(di, config_names[i].name, option_value);
+    }
+  }
 
   switch (option_type->id) {
   case OPTION_BROKERS:
@@ -269,6 +514,62 @@ int bsdi_kafka_set_option(bsdi_t *di,
     }
     break;
 
+  case OPTION_BATCH_SIZE:
+    if (atoi(option_value) <= 0) {
+      fprintf(stderr, "ERROR: Invalid batch size '%s'\n", option_value);
+      return -1;
+    }
+    free(STATE->batch_size);
+    if ((STATE->batch_size = strdup(option_value)) == NULL) {
+      return -1;
+    }
+    break;
+
+  case OPTION_CONFIG:
+    if ((name = strdup(option_value)) == NULL) {
+      return -1;
+    }
+    if ((value = strchr(name, '=')) == NULL || value == name) {
+      fprintf(stderr,
+              "ERROR: Kafka setting '%s' is not of the form name=value\n",
+              option_value);
+      free(name);
+      return -1;
+    }
+    *(value++) = '\0';
+    rc = add_config(di, name, value);
+    free(name);
+    return rc;
+
+  case OPTION_PARTITIONS:
+    if (*option_value == '\0' ||
+        strspn(option_value, "0123456789,;") != strlen(option_value)) {
+      fprintf(stderr, "ERROR: Invalid partition groups '%s'\n", option_value);
+      return -1;
+    }
+    free(STATE->partitions);
+    if ((STATE->partitions = strdup(option_value)) == NULL) {
+      return -1;
+    }
+    break;
+
+  case OPTION_CHECKPOINT_INTERVAL:
+    if (atoi(option_value) <= 0) {
+      fprintf(stderr, "ERROR: Invalid checkpoint interval '%s'\n",
+              option_value);
+      return -1;
+    }
+    STATE->checkpoint = 1;
+    return add_config(di, "auto.commit.interval.ms", option_value);
+
+  case OPTION_PARTITION_STREAMS:
+    if ((STATE->partition_streams = atoi(option_value)) <= 0) {
+      fprintf(stderr, "ERROR: Invalid partition stream count '%s'\n",
+              option_value);
+      return -1;
+    }
+    break;
+
   default:
     return -1;
   }
@@ -300,48 +601,48 @@ void bsdi_kafka_destroy(bsdi_t *di)
   free(STATE->collector);
   STATE->collector = NULL;
 
+  free(STATE->batch_size);
+  STATE->batch_size = NULL;
+
+  free(STATE->config);
+  STATE->config = NULL;
+
+  free(STATE->partitions);
+  STATE->partitions = NULL;
+
   free(STATE);
   BSDI_SET_STATE(di, NULL);
 }
 
 int bsdi_kafka_update_resources(bsdi_t *di)
 {
-  int rc;
-  bgpstream_resource_t *res = NULL;
+  char *groups, *g, *tok;
+  int rc = 0;
 
-  // we only ever yield one resource
+  // we only ever yield one set of resources. each one is read (and decoded)
+  // in the background, and their records are merged by time
   if (STATE->done != 0) {
     return 0;
   }
   STATE->done = 1;
 
-  // we treat kafka as having data from <recent> to <forever>
-  if ((rc = bgpstream_resource_mgr_push(
-         BSDI_GET_RES_MGR(di), BGPSTREAM_RESOURCE_TRANSPORT_KAFKA,
-         STATE->data_type, STATE->brokers,
-         0, // indicate we don't know how much historical data there is
-         BGPSTREAM_FOREVER, // indicate that the resource is a "stream"
-         STATE->project, STATE->collector, BGPSTREAM_UPDATE, &res)) <= 0) {
-    return rc;
-  }
-  assert(res != NULL);
-
-  if (bgpstream_resource_set_attr(res, BGPSTREAM_RESOURCE_ATTR_KAFKA_TOPICS,
-                                  STATE->topic_name) != 0) {
-    return -1;
-  }
-
-  if (STATE->group != NULL &&
-      bgpstream_resource_set_attr(
-        res, BGPSTREAM_RESOURCE_ATTR_KAFKA_CONSUMER_GROUP, STATE->group) != 0) {
-    return -1;
+  if (STATE->partitions != NULL) {
+    if ((groups = strdup(STATE->partitions)) == NULL) {
+      return -1;
+    }
+    g = groups;
+    while (rc >= 0 && (tok = strsep(&g, ";")) != NULL) {
+      if (*tok != '\0') {
+        rc = push_resource(di, tok);
+      }
+    }
+    free(groups);
+    return (rc < 0) ? -1 : 0;
   }
 
-  if (STATE->offset != NULL &&
-      bgpstream_resource_set_attr(
-        res, BGPSTREAM_RESOURCE_ATTR_KAFKA_INIT_OFFSET, STATE->offset) != 0) {
-    return -1;
+  if (STATE->partition_streams > 1) {
+    return push_partition_streams(di);
   }
 
-  return 0;
+  return (push_resource(di, NULL) < 0) ? -1 : 0;
 }
@@ -28,14 +28,19 @@
 #include "bgpstream_log.h"
 #include "config.h"
 #include "utils.h"
+#include <errno.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <wandio.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
 
 #define STATE (BSDI_GET_STATE(di, singlefile))
 
@@ -44,6 +49,24 @@ static const char *type_strs[] = {
   "mrt",      // BGPSTREAM_RESOURCE_FORMAT_MRT
   "bmp",      // BGPSTREAM_RESOURCE_FORMAT_BMP
   "ris-live",  // BGPSTREAM_RESOURCE_FORMAT_RISLIVE
+  "binary",   // BGPSTREAM_RESOURCE_FORMAT_BINARY
+};
+
+// ways of telling that a file has been replaced
+enum {
+  DETECT_AUTO,    // inotify for local files if possible, stat otherwise
+  DETECT_INOTIFY, // inotify events on the file and its directory
+  DETECT_STAT,    // changes to the inode/size/mtime of the file
+  DETECT_HEADER,  // changes to the first bytes of the file
+  DETECT_ONCE,    // never replaced (e.g., a live stream)
+};
+
+static const char *detect_strs[] = {
+  "auto",    // DETECT_AUTO
+  "inotify", // DETECT_INOTIFY
+  "stat",    // DETECT_STAT
+  "header",  // DETECT_HEADER
+  "once",    // DETECT_ONCE
 };
 
 /* ---------- START CLASS DEFINITION ---------- */
@@ -54,6 +77,7 @@ enum {
   OPTION_RIB_TYPE,
   OPTION_UPDATE_FILE,
   OPTION_UPDATE_TYPE,
+  OPTION_DETECT,
 };
 
 /* define the options this data interface accepts */
@@ -70,7 +94,7 @@ static bgpstream_data_interface_option_t options[] = {
     BGPSTREAM_DATA_INTERFACE_SINGLEFILE, // interface ID
     OPTION_RIB_TYPE,                     // internal ID
     "rib-type",                          // name
-    "rib file type (mrt/bmp) (default: mrt)",
+    "rib file type (mrt/bmp/binary) (default: mrt)",
   },
   /* Update file path */
   {
@@ -85,7 +109,15 @@ static bgpstream_data_interface_option_t options[] = {
     BGPSTREAM_DATA_INTERFACE_SINGLEFILE, // interface ID
     OPTION_UPDATE_TYPE,                  // internal ID
     "upd-type",                          // name
-    "update file type (mrt/bmp/ris-live) (default: mrt)",
+    "update file type (mrt/bmp/ris-live/binary) (default: mrt)",
+  },
+  /* Change detection */
+  {
+    BGPSTREAM_DATA_INTERFACE_SINGLEFILE, // interface ID
+    OPTION_DETECT,                       // internal ID
+    "detect",                            // name
+    "how to tell that a file has been replaced "
+    "(auto/inotify/stat/header/once) (default: auto)",
   },
 };
 
@@ -104,6 +136,34 @@ BSDI_CREATE_CLASS(singlefile, BGPSTREAM_DATA_INTERFACE_SINGLEFILE,
 /* max number of bytes to read from file header (to detect file changes) */
 #define MAX_HEADER_READ_BYTES 1024
 
+// change detection state of one of the files
+typedef struct sf_watch {
+
+  // how changes to the file are detected
+  int detect;
+
+  // a few bytes from the beginning of the file (used to tell if a symlink
+  // has been updated)
+  char header[MAX_HEADER_READ_BYTES];
+
+  // timestamp of the last read
+  uint32_t last_filetime;
+
+  // the file as it was when it was last pushed, and when it was last checked
+  struct stat pushed;
+  struct stat seen;
+
+  // inotify watches on the file and on its directory (-1 if none), and
+  // whether any of them fired since the last check
+  int wd_file;
+  int wd_dir;
+  int pending;
+
+  // name of the file within its directory
+  const char *name;
+
+} sf_watch_t;
+
 typedef struct bsdi_singlefile_state {
   /* user-provided options: */
 
@@ -119,21 +179,17 @@ typedef struct bsdi_singlefile_state {
   // Type of the given Update file (MRT/BMP)
   bgpstream_resource_format_type_t update_type;
 
-  /* internal state: */
-
-  // a few bytes from the beginning of the RIB file (used to tell if a symlink
-  // has been updated)
-  char rib_header[MAX_HEADER_READ_BYTES];
+  // How to tell that the files have been replaced
+  int detect;
 
-  // timestamp of the last RIB read
-  uint32_t last_rib_filetime;
+  /* internal state: */
 
-  // a few bytes from the beginning of the update file (used to tell if a
-  // symlink has been updated)
-  char update_header[MAX_HEADER_READ_BYTES];
+  // change detection state of the RIB and update files
+  sf_watch_t rib_watch;
+  sf_watch_t update_watch;
 
-  // timestamp of the last updates read
-  uint32_t last_update_filetime;
+  // inotify instance shared by the watches (-1 if none)
+  int inotify_fd;
 } bsdi_singlefile_state_t;
 
 static int same_header(char *filename, char *prev_hdr)
@@ -165,6 +221,184 @@ static int same_header(char *filename, char *prev_hdr)
   return 0; // not the same header
 }
 
+static int same_stat(const struct stat *a, const struct stat *b)
+{
+  return a->st_dev == b->st_dev && a->st_ino == b->st_ino &&
+         a->st_size == b->st_size && a->st_mtime == b->st_mtime;
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+// watches the file and its directory, so that both writes to it and it being
+// replaced (by a rename or a new symlink) are seen
+static int add_inotify_watch(bsdi_t *di, char *path, sf_watch_t *w)
+{
+  char *slash = strrchr(path, '/');
+  const char *dir = ".";
+
+  if (STATE->inotify_fd == -1 &&
+      (STATE->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1) {
+    return -1;
+  }
+
+  w->name = path;
+  if (slash != NULL) {
+    // temporarily cut the path at its last slash to get the directory
+    *slash = '\0';
+    dir = (slash == path) ? "/" : path;
+    w->name = slash + 1;
+  }
+  w->wd_dir = inotify_add_watch(STATE->inotify_fd, dir,
+                                IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+  if (slash != NULL) {
+    *slash = '/';
+  }
+  if (w->wd_dir == -1) {
+    bgpstream_log(BGPSTREAM_LOG_WARN, "Could not watch directory of %s: %s",
+                  path, strerror(errno));
+    return -1;
+  }
+  // the file itself may not exist yet
+  w->wd_file = inotify_add_watch(STATE->inotify_fd, path, IN_CLOSE_WRITE);
+  return 0;
+}
+
+// marks the watches that have seen a change to their file
+static void read_inotify_events(bsdi_t *di)
+{
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *ev;
+  sf_watch_t *watches[] = {&STATE->rib_watch, &STATE->update_watch};
+  char *paths[] = {STATE->rib_file, STATE->update_file};
+  struct stat st;
+  ssize_t len;
+  unsigned int i;
+  char *p;
+
+  while ((len = read(STATE->inotify_fd, buf, sizeof(buf))) > 0) {
+    for (p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+      ev = (const struct inotify_event *)p;
+      for (i = 0; i < ARR_CNT(watches); i++) {
+        if (paths[i] == NULL || watches[i]->detect != DETECT_INOTIFY) {
+          continue;
+        }
+        if (ev->wd == watches[i]->wd_file ||
+            (ev->wd == watches[i]->wd_dir && ev->len != 0 &&
+             strcmp(ev->name, watches[i]->name) == 0 &&
+             // a new regular file is only ready once it has been written
+             ((ev->mask & IN_CREATE) == 0 ||
+              (lstat(paths[i], &st) == 0 && S_ISLNK(st.st_mode))))) {
+          watches[i]->pending = 1;
+        }
+      }
+    }
+  }
+}
+#endif
+
+// is the given path a WebSocket URL (read as a live stream)?
+static int is_websocket(const char *path)
+{
+  return strncmp(path, "ws://", 5) == 0 || strncmp(path, "wss://", 6) == 0;
+}
+
+// is the given path a shared-memory ring (read as a live stream)?
+static int is_shmring(const char *path)
+{
+  return strncmp(path, "shm://", 6) == 0;
+}
+
+// sets up change detection for the given file
+static int init_watch(bsdi_t *di, char *path, sf_watch_t *w)
+{
+  w->wd_file = w->wd_dir = -1;
+  w->detect = STATE->detect;
+
+  if (w->detect == DETECT_AUTO && (is_websocket(path) || is_shmring(path))) {
+    // a stream is opened once and read until the server (or the writer of
+    // the ring) closes it
+    w->detect = DETECT_ONCE;
+  } else if (w->detect == DETECT_AUTO) {
+    // remote files can only be told apart by their content
+    w->detect = (strstr(path, "://") != NULL) ? DETECT_HEADER : DETECT_INOTIFY;
+  }
+  if (w->detect == DETECT_INOTIFY) {
+#ifdef HAVE_SYS_INOTIFY_H
+    if (add_inotify_watch(di, path, w) == 0) {
+      // the first check always pushes the file
+      w->pending = 1;
+      return 0;
+    }
+#endif
+    if (STATE->detect == DETECT_INOTIFY) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not set up inotify for %s",
+                    path);
+      return -1;
+    }
+    w->detect = DETECT_STAT;
+  }
+  return 0;
+}
+
+// checks if the file has been replaced since it was last pushed. returns 1 if
+// it has (or has never been pushed), 0 otherwise
+static int file_changed(bsdi_t *di, char *path, sf_watch_t *w, uint32_t freq)
+{
+  struct stat st;
+  int first = (w->last_filetime == 0);
+
+  switch (w->detect) {
+  case DETECT_INOTIFY:
+#ifdef HAVE_SYS_INOTIFY_H
+    if (w->pending == 0) {
+      return 0;
+    }
+    w->pending = 0;
+    // a replacement has a new inode, so watch that one from now on
+    w->wd_file = inotify_add_watch(STATE->inotify_fd, path, IN_CLOSE_WRITE);
+    if (stat(path, &st) != 0 || (!first && same_stat(&st, &w->pushed))) {
+      return 0;
+    }
+    w->pushed = st;
+    return 1;
+#endif
+
+  case DETECT_STAT:
+    if (stat(path, &st) != 0) {
+      return 0;
+    }
+    // a file that changed is only pushed once it stops changing, as we cannot
+    // tell when its writer is done with it
+    if (!first && (same_stat(&st, &w->pushed) || !same_stat(&st, &w->seen))) {
+      w->seen = st;
+      return 0;
+    }
+    w->pushed = w->seen = st;
+    return 1;
+
+  case DETECT_ONCE:
+    return first;
+
+  default:
+    return (epoch_sec() - w->last_filetime) > freq &&
+           same_header(path, w->header) == 0;
+  }
+}
+
+// picks the transport that reads the given file
+static bgpstream_resource_transport_type_t get_transport(const char *path)
+{
+  if (is_shmring(path)) {
+    return BGPSTREAM_RESOURCE_TRANSPORT_SHMRING;
+  }
+  return is_websocket(path) ? BGPSTREAM_RESOURCE_TRANSPORT_WEBSOCKET
+                            : BGPSTREAM_RESOURCE_TRANSPORT_FILE;
+}
+
+static int get_fd(bsdi_t *di)
+{
+  return STATE->inotify_fd;
+}
+
 /* ========== PUBLIC METHODS BELOW HERE ========== */
 
 int bsdi_singlefile_init(bsdi_t *di)
@@ -179,6 +413,10 @@ int bsdi_singlefile_init(bsdi_t *di)
   /* set default state */
   state->rib_type = BGPSTREAM_RESOURCE_FORMAT_MRT;
   state->update_type = BGPSTREAM_RESOURCE_FORMAT_MRT;
+  state->detect = DETECT_AUTO;
+  state->inotify_fd = -1;
+
+  di->get_fd = get_fd;
 
   return 0;
 err:
@@ -189,6 +427,12 @@ err:
 int bsdi_singlefile_start(bsdi_t *di)
 {
   if (STATE->rib_file || STATE->update_file) {
+    if ((STATE->rib_file != NULL &&
+         init_watch(di, STATE->rib_file, &STATE->rib_watch) != 0) ||
+        (STATE->update_file != NULL &&
+         init_watch(di, STATE->update_file, &STATE->update_watch) != 0)) {
+      return -1;
+    }
     return 0;
   } else {
     bgpstream_log(BGPSTREAM_LOG_ERR,
@@ -259,6 +503,22 @@ int bsdi_singlefile_set_option(
     }
     break;
 
+  case OPTION_DETECT:
+    found = 0;
+    for (int i = 0; i < (int)ARR_CNT(detect_strs); i++) {
+      if (strcmp(option_value, detect_strs[i]) == 0) {
+        STATE->detect = i;
+        found = 1;
+        break;
+      }
+    }
+    if (found == 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid detect mode specified: '%s'",
+                    option_value);
+      return -1;
+    }
+    break;
+
   default:
     return -1;
   }
@@ -278,6 +538,10 @@ void bsdi_singlefile_destroy(bsdi_t *di)
   free(STATE->update_file);
   STATE->update_file = NULL;
 
+  if (STATE->inotify_fd != -1) {
+    close(STATE->inotify_fd);
+  }
+
   free(STATE);
   BSDI_SET_STATE(di, NULL);
 }
@@ -287,16 +551,22 @@ int bsdi_singlefile_update_resources(bsdi_t *di)
   uint32_t now = epoch_sec();
 
   /* if this is the first time we've read the file, then add it to the queue,
-     otherwise check the header to see if it has changed */
+     otherwise check to see if it has changed */
+
+#ifdef HAVE_SYS_INOTIFY_H
+  if (STATE->inotify_fd != -1) {
+    read_inotify_events(di);
+  }
+#endif
 
   if (STATE->rib_file != NULL &&
-      (now - STATE->last_rib_filetime) > RIB_FREQUENCY_CHECK &&
-      same_header(STATE->rib_file, STATE->rib_header) == 0) {
-    STATE->last_rib_filetime = now;
+      file_changed(di, STATE->rib_file, &STATE->rib_watch,
+                   RIB_FREQUENCY_CHECK) != 0) {
+    STATE->rib_watch.last_filetime = now;
 
     if (bgpstream_resource_mgr_push(
-          BSDI_GET_RES_MGR(di), BGPSTREAM_RESOURCE_TRANSPORT_FILE,
-          STATE->rib_type, STATE->rib_file, STATE->last_rib_filetime,
+          BSDI_GET_RES_MGR(di), get_transport(STATE->rib_file),
+          STATE->rib_type, STATE->rib_file, STATE->rib_watch.last_filetime,
           RIB_FREQUENCY_CHECK, "singlefile", "singlefile", BGPSTREAM_RIB,
           NULL) < 0) {
       goto err;
@@ -304,13 +574,14 @@ int bsdi_singlefile_update_resources(bsdi_t *di)
   }
 
   if (STATE->update_file != NULL &&
-      (now - STATE->last_update_filetime) > UPDATE_FREQUENCY_CHECK &&
-      same_header(STATE->update_file, STATE->update_header) == 0) {
-    STATE->last_update_filetime = now;
+      file_changed(di, STATE->update_file, &STATE->update_watch,
+                   UPDATE_FREQUENCY_CHECK) != 0) {
+    STATE->update_watch.last_filetime = now;
 
     if (bgpstream_resource_mgr_push(
-          BSDI_GET_RES_MGR(di), BGPSTREAM_RESOURCE_TRANSPORT_FILE,
-          STATE->update_type, STATE->update_file, STATE->last_update_filetime,
+          BSDI_GET_RES_MGR(di), get_transport(STATE->update_file),
+          STATE->update_type, STATE->update_file,
+          STATE->update_watch.last_filetime,
           UPDATE_FREQUENCY_CHECK, "singlefile", "singlefile", BGPSTREAM_UPDATE,
           NULL) < 0) {
       goto err;
@@ -81,6 +81,9 @@ typedef struct bsdi_sqlite_state {
   // statement handle
   sqlite3_stmt *stmt;
 
+  // statement to get the data version of the DB
+  sqlite3_stmt *version_stmt;
+
   // buffer for building queries XXX
   char query_buf[MAX_QUERY_LEN];
 
@@ -90,6 +93,10 @@ typedef struct bsdi_sqlite_state {
   // last timestamp
   uint32_t last_ts;
 
+  // data version of the DB, and when we first saw it
+  int data_version;
+  uint32_t version_time;
+
 } bsdi_sqlite_state_t;
 
 #define MAX_INTERVAL_LEN 16
@@ -104,6 +111,39 @@ typedef struct bsdi_sqlite_state {
     rem_buf_space -= len;                                                      \
   } while (0)
 
+// appends " AND <column> IN (<values of set>)" to the query
+static int append_set(bsdi_t *di, size_t *rem, const char *column,
+                      bgpstream_str_set_t *set)
+{
+  size_t rem_buf_space = *rem;
+  char quoted[BGPSTREAM_UTILS_STR_NAME_LEN * 2 + 3];
+  int first = 1;
+  char *f;
+
+  APPEND_STR(" AND ");
+  APPEND_STR(column);
+  APPEND_STR(" IN (");
+  bgpstream_str_set_rewind(set);
+  while ((f = bgpstream_str_set_next(set)) != NULL) {
+    if (strlen(f) >= BGPSTREAM_UTILS_STR_NAME_LEN) {
+      goto err;
+    }
+    if (!first) {
+      APPEND_STR(", ");
+    }
+    sqlite3_snprintf(sizeof(quoted), quoted, "%Q", f);
+    APPEND_STR(quoted);
+    first = 0;
+  }
+  APPEND_STR(" ) ");
+
+  *rem = rem_buf_space;
+  return 0;
+
+err:
+  return -1;
+}
+
 static int prepare_db(bsdi_t *di)
 {
   if (sqlite3_open_v2(STATE->db_file, &STATE->db, SQLITE_OPEN_READONLY, NULL) !=
@@ -114,7 +154,9 @@ static int prepare_db(bsdi_t *di)
   }
 
   if (sqlite3_prepare_v2(STATE->db, STATE->query_buf, -1, &STATE->stmt, NULL) !=
-      SQLITE_OK) {
+        SQLITE_OK ||
+      sqlite3_prepare_v2(STATE->db, "PRAGMA data_version", -1,
+                         &STATE->version_stmt, NULL) != SQLITE_OK) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "failed to prepare statement: %s",
                   sqlite3_errmsg(STATE->db));
     return -1;
@@ -122,6 +164,50 @@ static int prepare_db(bsdi_t *di)
   return 0;
 }
 
+// warns if the DB lacks the indexes that keep our queries from scanning
+// bgp_data (tools/bgpstream_sqlite_mgmt.py creates them)
+static void check_indexes(bsdi_t *di)
+{
+  static const char *indexes[] = {"bgp_data_ts_idx", "bgp_data_file_time_idx"};
+  sqlite3_stmt *stmt;
+  unsigned int i;
+
+  if (sqlite3_prepare_v2(STATE->db,
+                         "SELECT 1 FROM sqlite_master WHERE type = 'index' "
+                         "AND tbl_name = 'bgp_data' AND name = ?",
+                         -1, &stmt, NULL) != SQLITE_OK) {
+    return;
+  }
+  for (i = 0; i < ARR_CNT(indexes); i++) {
+    sqlite3_bind_text(stmt, 1, indexes[i], -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+      bgpstream_log(BGPSTREAM_LOG_WARN,
+                    "SQLite DB is missing index %s, queries will scan all "
+                    "files (create it with bgpstream_sqlite_mgmt.py -i)",
+                    indexes[i]);
+    }
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+}
+
+// gets the data version of the DB, which changes whenever another connection
+// commits a change to it
+static int get_data_version(bsdi_t *di)
+{
+  int version;
+
+  if (sqlite3_step(STATE->version_stmt) != SQLITE_ROW) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "failed to get data version: %s",
+                  sqlite3_errmsg(STATE->db));
+    sqlite3_reset(STATE->version_stmt);
+    return -1;
+  }
+  version = sqlite3_column_int(STATE->version_stmt, 0);
+  sqlite3_reset(STATE->version_stmt);
+  return version;
+}
+
 /* ========== PUBLIC METHODS BELOW HERE ========== */
 
 int bsdi_sqlite_init(bsdi_t *di)
@@ -162,58 +248,21 @@ static int build_query(bsdi_t *di)
   // projects, collectors, bgp_types, and time_interval are used as filters
   // only if they are provided by the user
   bgpstream_filter_mgr_t *filter_mgr = BSDI_GET_FILTER_MGR(di);
-  int first;
-  char *f;
 
-  // projects
-  first = 1;
-  if (filter_mgr->projects != NULL) {
-    APPEND_STR(" AND collectors.project IN (");
-    bgpstream_str_set_rewind(filter_mgr->projects);
-    while ((f = bgpstream_str_set_next(filter_mgr->projects)) != NULL) {
-      if (!first) {
-        APPEND_STR(", ");
-      }
-      APPEND_STR("'");
-      APPEND_STR(f);
-      APPEND_STR("'");
-      first = 0;
-    }
-    APPEND_STR(" ) ");
+  if (filter_mgr->projects != NULL &&
+      append_set(di, &rem_buf_space, "collectors.project",
+                 filter_mgr->projects) != 0) {
+    goto err;
   }
-
-  // collectors
-  first = 1;
-  if (filter_mgr->collectors != NULL) {
-    APPEND_STR(" AND collectors.name IN (");
-    bgpstream_str_set_rewind(filter_mgr->collectors);
-    while ((f = bgpstream_str_set_next(filter_mgr->collectors)) != NULL) {
-      if (!first) {
-        APPEND_STR(", ");
-      }
-      APPEND_STR("'");
-      APPEND_STR(f);
-      APPEND_STR("'");
-      first = 0;
-    }
-    APPEND_STR(" ) ");
+  if (filter_mgr->collectors != NULL &&
+      append_set(di, &rem_buf_space, "collectors.name",
+                 filter_mgr->collectors) != 0) {
+    goto err;
   }
-
-  // bgp_types
-  first = 1;
-  if (filter_mgr->bgp_types != NULL) {
-    APPEND_STR(" AND bgp_types.name IN (");
-    bgpstream_str_set_rewind(filter_mgr->bgp_types);
-    while ((f = bgpstream_str_set_next(filter_mgr->bgp_types)) != NULL) {
-      if (!first) {
-        APPEND_STR(", ");
-      }
-      APPEND_STR("'");
-      APPEND_STR(f);
-      APPEND_STR("'");
-      first = 0;
-    }
-    APPEND_STR(" ) ");
+  if (filter_mgr->bgp_types != NULL &&
+      append_set(di, &rem_buf_space, "bgp_types.name",
+                 filter_mgr->bgp_types) != 0) {
+    goto err;
   }
 
   // time_interval
@@ -233,6 +282,13 @@ static int build_query(bsdi_t *di)
     APPEND_STR("  - time_span.time_span - 120 )");
     APPEND_STR("  AND  ");
 
+    // the same bound again, but against a constant so that the file_time
+    // index can be used
+    APPEND_STR(" (bgp_data.file_time >=  ");
+    APPEND_STR(interval_str);
+    APPEND_STR("  - (SELECT MAX(time_span) FROM time_span) - 120 )");
+    APPEND_STR("  AND  ");
+
     // END TIME
     if (TIF->end_time != BGPSTREAM_FOREVER) {
       APPEND_STR(" (bgp_data.file_time <=  ");
@@ -279,7 +335,11 @@ int bsdi_sqlite_start(bsdi_t *di)
     return -1;
   }
 
-  return prepare_db(di);
+  if (prepare_db(di) != 0) {
+    return -1;
+  }
+  check_indexes(di);
+  return 0;
 }
 
 int bsdi_sqlite_set_option(bsdi_t *di,
@@ -315,6 +375,7 @@ void bsdi_sqlite_destroy(bsdi_t *di)
   STATE->db_file = NULL;
 
   sqlite3_finalize(STATE->stmt);
+  sqlite3_finalize(STATE->version_stmt);
   sqlite3_close(STATE->db);
 
   free(STATE);
@@ -323,11 +384,28 @@ void bsdi_sqlite_destroy(bsdi_t *di)
 
 int bsdi_sqlite_update_resources(bsdi_t *di)
 {
+  uint32_t now = epoch_sec();
+  int version;
   int rc;
 
+  // don't bother querying if nothing was committed since our last query. the
+  // rows of a commit are stamped no later than when we first see it, so that
+  // query must also have reached that time
+  if ((version = get_data_version(di)) < 0) {
+    goto err;
+  }
+  if (STATE->current_ts != 0 && version == STATE->data_version &&
+      STATE->current_ts >= STATE->version_time) {
+    return 0;
+  }
+  if (STATE->current_ts == 0 || version != STATE->data_version) {
+    STATE->data_version = version;
+    STATE->version_time = now;
+  }
+
   STATE->last_ts = STATE->current_ts;
   // update current_timestamp - we always ask for data 1 second old at least
-  STATE->current_ts = epoch_sec() - 1; // now() - 1 second
+  STATE->current_ts = now - 1; // now() - 1 second
 
   sqlite3_bind_int(STATE->stmt, 1, STATE->last_ts);
   sqlite3_bind_int(STATE->stmt, 2, STATE->current_ts);
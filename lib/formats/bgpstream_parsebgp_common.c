@@ -26,14 +26,23 @@
 
 #include "config.h"
 #include "bgpstream_parsebgp_common.h"
+#include "bgpstream_affinity.h"
+#include "bgpstream_elem_int.h"
 #include "bgpstream_format_interface.h"
 #include "bgpstream_record_int.h"
 #include "bgpstream_utils_as_path_int.h"
 #include "bgpstream_utils_community_int.h"
 #include "bgpstream_log.h"
+#include "utils.h"
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 // if the parser encounters an "invalid" message, it will be written to
 // "debug.msg" if this is set
@@ -50,6 +59,77 @@ static bgpstream_as_path_seg_type_t as_path_types[] = {
   BGPSTREAM_AS_PATH_SEG_CONFED_SET, // PARSEBGP_BGP_UPDATE_AS_PATH_SEG_CONFED_SET
 };
 
+// maximum number of messages (and bytes) in a chunk handed to a decode worker
+#define PDEC_CHUNK_RECS 64
+#define PDEC_CHUNK_LEN (256 * 1024)
+
+// number of chunks each decode worker may have queued
+#define PDEC_CHUNKS_PER_THREAD 4
+
+typedef enum {
+  CHUNK_EMPTY,
+  CHUNK_FILLED,
+  CHUNK_DECODING,
+  CHUNK_DECODED,
+} pdec_chunk_state_t;
+
+typedef struct pdec_chunk {
+
+  // MUST hold the mutex to access state
+  pdec_chunk_state_t state;
+
+  // consecutive raw messages (unused if the messages are decoded from a
+  // mapped transport)
+  uint8_t *buf;
+  size_t len;
+  size_t buf_alloc;
+
+  // each raw message (either in buf or in the mapped transport), and its
+  // length (0 if it was skipped by the peek filter)
+  uint8_t *rec_ptr[PDEC_CHUNK_RECS];
+  size_t rec_len[PDEC_CHUNK_RECS];
+  int rec_cnt;
+
+  // decoded messages, and the result of decoding them
+  parsebgp_msg_t *msgs[PDEC_CHUNK_RECS];
+  parsebgp_error_t errs[PDEC_CHUNK_RECS];
+
+  // index of the next message to give to the consumer
+  int next_rec;
+
+} pdec_chunk_t;
+
+struct bgpstream_parsebgp_pdecode {
+
+  // borrowed from the decode state
+  parsebgp_opts_t *opts;
+  parsebgp_msg_type_t msg_type;
+
+  // finds the length of a raw message
+  bgpstream_parsebgp_msg_len_cb_t *msg_len_cb;
+
+  pthread_t *threads;
+  int threads_cnt;
+
+  // ring of chunks. used chunks start at head, and are consumed in order
+  pdec_chunk_t *chunks;
+  int chunks_cnt;
+  int head;
+  int used;
+
+  // set (by the consumer) once no more chunks can be filled
+  int eof;
+  int read_failed;
+  int read_errno;
+
+  pthread_mutex_t mutex;
+  // signalled when a chunk is filled, or on shutdown
+  pthread_cond_t work_cond;
+  // signalled when a chunk has been decoded
+  pthread_cond_t done_cond;
+  int shutdown;
+};
+
 static int append_segments(bgpstream_as_path_t *bs_path,
                            parsebgp_bgp_update_as_path_t *pbgp_path,
                            int asns_cnt)
@@ -179,33 +259,219 @@ static int handle_as_paths(bgpstream_as_path_t *path,
   return 0;
 }
 
+// allocates a ring of len bytes (a multiple of the page size) that is mapped
+// twice in a row, so that [ring, ring + 2 * len) is valid and the second half
+// mirrors the first. returns NULL if this is not supported.
+static uint8_t *mirror_alloc(size_t len)
+{
+#ifdef HAVE_MEMFD_CREATE
+  int fd;
+  uint8_t *ring = MAP_FAILED;
+
+  if ((fd = memfd_create("bgpstream-decode", MFD_CLOEXEC)) < 0) {
+    return NULL;
+  }
+  if (ftruncate(fd, len) != 0) {
+    goto err;
+  }
+  // reserve space for both mappings, and then map the file into each half
+  if ((ring = mmap(NULL, 2 * len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+                   0)) == MAP_FAILED) {
+    goto err;
+  }
+  if (mmap(ring, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) !=
+        ring ||
+      mmap(ring + len, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+           0) != ring + len) {
+    goto err;
+  }
+  // the mappings keep the memory alive
+  close(fd);
+  return ring;
+
+err:
+  if (ring != MAP_FAILED) {
+    munmap(ring, 2 * len);
+  }
+  close(fd);
+  return NULL;
+#else
+  return NULL;
+#endif
+}
+
+// frees the buffer allocated by resize_buffer
+static void free_buffer(bgpstream_parsebgp_decode_state_t *state)
+{
+#ifdef HAVE_MEMFD_CREATE
+  if (state->mirrored != 0) {
+    munmap(state->buffer, 2 * state->buflen);
+  } else
+#endif
+  {
+    free(state->buffer);
+  }
+  bgpstream_mem_add(state->mem, BGPSTREAM_MEM_DECODE,
+                    -(int64_t)state->buflen);
+  state->buffer = NULL;
+  state->buflen = 0;
+}
+
+// a buffer that grew is considered for shrinking each time this many times its
+// initial length has been read
+#define RESIZE_WINDOW 16
+
+// (re)allocates the buffer with len bytes, keeping the unread data. returns 0
+// if successful, -1 otherwise
+static int resize_buffer(bgpstream_parsebgp_decode_state_t *state, size_t len)
+{
+  uint8_t *buffer;
+  int mirrored = 1;
+
+  assert(state->remain <= len);
+  // prefer a mirrored ring, but fall back to a plain buffer that is compacted
+  // before each read
+  if ((buffer = mirror_alloc(len)) == NULL) {
+    if ((buffer = malloc(len)) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR,
+                    "Could not allocate a %zu byte decode buffer", len);
+      return -1;
+    }
+    mirrored = 0;
+  }
+  if (state->remain != 0) {
+    // (unread data that wraps around a ring is contiguous in its mirror)
+    memcpy(buffer, state->ptr, state->remain);
+  }
+  if (state->buffer != NULL) {
+    free_buffer(state);
+  }
+  state->buffer = buffer;
+  state->ptr = buffer;
+  state->mirrored = mirrored;
+  state->buflen = len;
+  bgpstream_mem_add(state->mem, BGPSTREAM_MEM_DECODE, len);
+
+  state->max_msg_len = 0;
+  state->resize_read = state->read_total + RESIZE_WINDOW * state->min_buflen;
+  return 0;
+}
+
+// makes sure the buffer can hold need bytes, allocating or growing it if
+// needed. returns 1 if it can, 0 if need is more than the largest buffer, or -1
+// if the buffer could not be allocated
+static int reserve_buffer(bgpstream_parsebgp_decode_state_t *state,
+                          size_t need)
+{
+  size_t len = (state->buflen != 0) ? state->buflen : state->min_buflen;
+
+  if (need <= state->buflen) {
+    return 1;
+  }
+  if (need > BGPSTREAM_PARSEBGP_MAX_BUFLEN) {
+    return 0;
+  }
+  while (len < need) {
+    len *= 2;
+  }
+  return (resize_buffer(state, len) == 0) ? 1 : -1;
+}
+
+// shrinks the buffer if it grew for messages that have stopped coming, to the
+// smallest size (but no less than the initial one) in which the messages of the
+// last window would have used at most a quarter of it. returns 0 if
+// successful, -1 otherwise
+static int shrink_buffer(bgpstream_parsebgp_decode_state_t *state)
+{
+  size_t len = state->min_buflen;
+
+  while (len < 4 * state->max_msg_len || len < 2 * state->remain) {
+    len *= 2;
+  }
+  if (len >= state->buflen) {
+    // check again after the next window
+    state->max_msg_len = 0;
+    state->resize_read = state->read_total + RESIZE_WINDOW * state->min_buflen;
+    return 0;
+  }
+  return resize_buffer(state, len);
+}
+
 static ssize_t refill_buffer(bgpstream_parsebgp_decode_state_t *state,
                              bgpstream_transport_t *transport)
 {
   size_t len = 0;
   int64_t new_read = 0;
+  uint8_t *end;
+  int rc;
+
+  if (state->mapped != 0) {
+    // the whole content is already in the buffer
+    return state->remain;
+  }
+
+  // allocate the buffer for the first read (or the first since the stream was
+  // idle), and grow it if it is full of a message that does not fit
+  if ((rc = reserve_buffer(state, state->remain + 1)) == 0) {
+    // no more data can be read in
+    return state->remain;
+  }
+  if (rc < 0 || (state->read_total >= state->resize_read &&
+                 shrink_buffer(state) != 0)) {
+    return -1;
+  }
 
-  if (state->remain > 0) {
+  if (state->remain == 0) {
+    state->ptr = state->buffer;
+  } else if (state->mirrored != 0) {
+    // the remaining data stays where it is, and we read into the rest of the
+    // ring (which may wrap into the mirror)
+    len = state->remain;
+  } else {
     // need to move remaining data to start of buffer
-    memmove(state->buffer,
-            state->buffer + BGPSTREAM_PARSEBGP_BUFLEN - state->remain,
-            state->remain);
-    len += state->remain;
+    memmove(state->buffer, state->ptr, state->remain);
+    state->ptr = state->buffer;
+    len = state->remain;
+  }
+  end = state->ptr + len;
+  if (state->mirrored != 0 && end >= state->buffer + state->buflen) {
+    end -= state->buflen;
   }
 
   // try and do a read
-  if ((new_read = bgpstream_transport_read(transport, state->buffer + len,
-                                           BGPSTREAM_PARSEBGP_BUFLEN - len)) <
-      0) {
+  if ((new_read = bgpstream_transport_read(transport, end,
+                                           state->buflen - len)) < 0) {
     // read failed
     return new_read;
   }
+  state->read_total += new_read;
+
+  if (new_read == 0 && len == 0 && state->release_idle != 0) {
+    // there is nothing to keep the buffer for until the stream has data again
+    free_buffer(state);
+    state->ptr = NULL;
+  }
 
   // new_read could be 0, indicating EOF, so need to check returned len is
   // larger than passed in remain
   return len + new_read;
 }
 
+// marks len bytes of the buffer as read
+static void consume_buffer(bgpstream_parsebgp_decode_state_t *state,
+                           size_t len)
+{
+  state->ptr += len;
+  state->remain -= len;
+  if (state->mirrored != 0 && state->ptr >= state->buffer + state->buflen) {
+    // move back to the same byte in the first mapping
+    state->ptr -= state->buflen;
+  }
+  if (len > state->max_msg_len) {
+    state->max_msg_len = len;
+  }
+}
+
 static bgpstream_format_status_t
 handle_eof(bgpstream_parsebgp_decode_state_t *state, bgpstream_record_t *record,
            uint64_t skipped_cnt)
@@ -238,6 +504,146 @@ handle_eof(bgpstream_parsebgp_decode_state_t *state, bgpstream_record_t *record,
   return BGPSTREAM_FORMAT_END_OF_DUMP;
 }
 
+typedef struct attr_cache_entry {
+
+  // serialized AS_PATH, AS4_PATH and COMMUNITIES attributes
+  uint8_t *key;
+  size_t key_len;
+  size_t key_alloc;
+
+  // objects decoded from these attributes (shared by elems)
+  bgpstream_as_path_t *as_path;
+  bgpstream_community_set_t *communities;
+
+} attr_cache_entry_t;
+
+KHASH_INIT(attr_cache, uint64_t, int, 1, kh_int64_hash_func,
+           kh_int64_hash_equal)
+
+struct bgpstream_parsebgp_attr_cache {
+
+  // hash of a serialized key -> index of its entry
+  khash_t(attr_cache) * index;
+
+  // entries in use, followed by re-usable entries from earlier messages
+  attr_cache_entry_t *entries;
+  int entries_cnt;
+  int entries_alloc;
+
+  // key of the attributes currently being looked up
+  attr_cache_entry_t scratch;
+
+  // the elem's own AS path and communities while it points at an entry
+  bgpstream_as_path_t *elem_as_path;
+  bgpstream_community_set_t *elem_communities;
+};
+
+static int key_append(attr_cache_entry_t *e, const void *data, size_t len)
+{
+  uint8_t *tmp;
+  size_t new_alloc;
+
+  if (len == 0) {
+    return 0;
+  }
+  if (e->key_len + len > e->key_alloc) {
+    new_alloc = e->key_alloc == 0 ? 256 : e->key_alloc;
+    while (new_alloc < e->key_len + len) {
+      new_alloc *= 2;
+    }
+    if ((tmp = realloc(e->key, new_alloc)) == NULL) {
+      return -1;
+    }
+    e->key = tmp;
+    e->key_alloc = new_alloc;
+  }
+  memcpy(e->key + e->key_len, data, len);
+  e->key_len += len;
+  return 0;
+}
+
+static int key_append_as_path(attr_cache_entry_t *e,
+                              parsebgp_bgp_update_path_attr_t *attr, int type)
+{
+  parsebgp_bgp_update_as_path_t *path;
+  parsebgp_bgp_update_as_path_seg_t *seg;
+  uint8_t present = (attr->type == type);
+  int i;
+
+  if (key_append(e, &present, sizeof(present)) != 0) {
+    return -1;
+  }
+  if (present == 0) {
+    return 0;
+  }
+  path = attr->data.as_path;
+  if (key_append(e, &path->segs_cnt, sizeof(path->segs_cnt)) != 0) {
+    return -1;
+  }
+  for (i = 0; i < path->segs_cnt; i++) {
+    seg = &path->segs[i];
+    if (key_append(e, &seg->type, sizeof(seg->type)) != 0 ||
+        key_append(e, &seg->asns_cnt, sizeof(seg->asns_cnt)) != 0 ||
+        key_append(e, seg->asns, sizeof(seg->asns[0]) * seg->asns_cnt) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// serializes the attributes decode_as_path_communities reads into e->key
+static int build_key(attr_cache_entry_t *e,
+                     parsebgp_bgp_update_path_attr_t *attrs)
+{
+  parsebgp_bgp_update_path_attr_t *comms =
+    &attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES];
+  parsebgp_bgp_update_path_attr_t *lcomms =
+    &attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES];
+  uint8_t present = (comms->type == PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES);
+  uint8_t lpresent =
+    (lcomms->type == PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES);
+  parsebgp_bgp_update_large_communities_t *lc;
+
+  e->key_len = 0;
+  if (key_append_as_path(e, &attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH],
+                         PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH) != 0 ||
+      key_append_as_path(e, &attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH],
+                         PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH) != 0 ||
+      key_append(e, &present, sizeof(present)) != 0) {
+    return -1;
+  }
+  if (present != 0 &&
+      (key_append(e, &comms->len, sizeof(comms->len)) != 0 ||
+       key_append(e, comms->data.communities->raw, comms->len) != 0)) {
+    return -1;
+  }
+  if (key_append(e, &lpresent, sizeof(lpresent)) != 0) {
+    return -1;
+  }
+  if (lpresent != 0) {
+    lc = lcomms->data.large_communities;
+    if (key_append(e, &lc->communities_cnt, sizeof(lc->communities_cnt)) !=
+          0 ||
+        key_append(e, lc->communities,
+                   sizeof(lc->communities[0]) * lc->communities_cnt) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// 64-bit FNV-1a
+static uint64_t hash_key(attr_cache_entry_t *e)
+{
+  uint64_t h = 14695981039346656037ULL;
+  size_t i;
+
+  for (i = 0; i < e->key_len; i++) {
+    h = (h ^ e->key[i]) * 1099511628211ULL;
+  }
+  return h;
+}
+
 /* -------------------- PUBLIC API FUNCTIONS -------------------- */
 
 void bgpstream_parsebgp_upd_state_reset(
@@ -369,6 +775,146 @@ static int handle_end_of_rib(bgpstream_elem_t *elem,
   return 1;
 }
 
+// yield the only prefix of an update that carries exactly one, without going
+// through the generators
+static int process_single_nlri(bgpstream_parsebgp_upd_state_t *upd_state,
+                               bgpstream_elem_t *elem,
+                               parsebgp_bgp_update_t *update)
+{
+  parsebgp_bgp_update_path_attr_t *attrs = update->path_attrs.attrs;
+  bgpstream_elem_type_t elem_type = BGPSTREAM_ELEM_TYPE_WITHDRAWAL;
+  parsebgp_bgp_prefix_t *prefix;
+  int rc;
+
+  if (upd_state->withdrawal_v4_cnt != 0) {
+    prefix = update->withdrawn_nlris.prefixes;
+  } else if (upd_state->withdrawal_v6_cnt != 0) {
+    prefix = attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI]
+               .data.mp_unreach->withdrawn_nlris;
+  } else {
+    // announcement: we need the path attributes and the right next-hop
+    if (bgpstream_parsebgp_process_path_attrs(elem, attrs) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not extract path attributes");
+      return -1;
+    }
+    if (bgpstream_parsebgp_process_next_hop(
+          elem, attrs, upd_state->announce_v6_cnt != 0) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not extract next-hop");
+      return -1;
+    }
+    elem_type = BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT;
+    if (upd_state->announce_v4_cnt != 0) {
+      prefix = update->announced_nlris.prefixes;
+    } else {
+      prefix = attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI]
+                 .data.mp_reach->nlris;
+    }
+  }
+  rc = handle_prefix(elem, elem_type, prefix);
+
+  // the next call finds nothing left (and no End-of-RIB, which has no NLRIs)
+  upd_state->withdrawal_v4_cnt = 0;
+  upd_state->withdrawal_v6_cnt = 0;
+  upd_state->announce_v4_cnt = 0;
+  upd_state->announce_v6_cnt = 0;
+  upd_state->path_attr_done = 1;
+  upd_state->eor_done = 1;
+  return rc;
+}
+
+// checks whether any of the given NLRIs passes the ip version and prefix
+// filters
+static int nlris_wanted(bgpstream_filter_mgr_t *filter_mgr,
+                        parsebgp_bgp_prefix_t *prefixes, int prefixes_cnt)
+{
+  bgpstream_pfx_t pfx;
+  int i;
+
+  for (i = 0; i < prefixes_cnt; i++) {
+    if (prefixes[i].type != PARSEBGP_BGP_PREFIX_UNICAST_IPV4 &&
+        prefixes[i].type != PARSEBGP_BGP_PREFIX_UNICAST_IPV6) {
+      continue;
+    }
+    pfx.address.version = BGPSTREAM_ADDR_VERSION_UNKNOWN;
+    COPY_IP(&pfx.address, prefixes[i].afi, prefixes[i].addr, break);
+    if (pfx.address.version == BGPSTREAM_ADDR_VERSION_UNKNOWN) {
+      continue;
+    }
+    pfx.mask_len = prefixes[i].len;
+    if (bgpstream_filter_mgr_pfx_wanted(filter_mgr, &pfx) != 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int bgpstream_parsebgp_update_wanted(bgpstream_filter_mgr_t *filter_mgr,
+                                     uint32_t peer_asn,
+                                     parsebgp_bgp_msg_t *bgp)
+{
+  uint8_t elem_types = filter_mgr->elem_prog.elem_types;
+  parsebgp_bgp_update_t *update = bgp->types.update;
+  parsebgp_bgp_update_path_attr_t *attrs;
+  parsebgp_bgp_update_mp_reach_t *mp_reach = NULL;
+  parsebgp_bgp_update_mp_unreach_t *mp_unreach = NULL;
+  int want_withdrawals, want_announcements;
+  int nlris_cnt;
+
+  if (bgpstream_filter_mgr_peer_wanted(filter_mgr, peer_asn) == 0) {
+    return 0;
+  }
+  if (bgp->type != PARSEBGP_BGP_TYPE_UPDATE || update == NULL) {
+    // yields no elems anyway
+    return 1;
+  }
+  want_withdrawals = elem_types & (1 << BGPSTREAM_ELEM_TYPE_WITHDRAWAL);
+  want_announcements = elem_types & (1 << BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT);
+  if (want_withdrawals && want_announcements && filter_mgr->ipversion == 0 &&
+      filter_mgr->prefixes == NULL &&
+      filter_mgr->sample_key != BGPSTREAM_SAMPLE_KEY_PREFIX) {
+    return 1;
+  }
+
+  attrs = update->path_attrs.attrs;
+  if (attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI].type ==
+      PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI) {
+    mp_reach = attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI].data.mp_reach;
+  }
+  if (attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI].type ==
+      PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI) {
+    mp_unreach =
+      attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI].data.mp_unreach;
+  }
+
+  if (want_withdrawals &&
+      (nlris_wanted(filter_mgr, update->withdrawn_nlris.prefixes,
+                    update->withdrawn_nlris.prefixes_cnt) != 0 ||
+       (mp_unreach != NULL &&
+        nlris_wanted(filter_mgr, mp_unreach->withdrawn_nlris,
+                     mp_unreach->withdrawn_nlris_cnt) != 0))) {
+    return 1;
+  }
+  if (want_announcements &&
+      (nlris_wanted(filter_mgr, update->announced_nlris.prefixes,
+                    update->announced_nlris.prefixes_cnt) != 0 ||
+       (mp_reach != NULL &&
+        nlris_wanted(filter_mgr, mp_reach->nlris, mp_reach->nlris_cnt) !=
+          0))) {
+    return 1;
+  }
+
+  // an update without any NLRIs may still be an End-of-RIB marker
+  nlris_cnt = update->withdrawn_nlris.prefixes_cnt +
+              update->announced_nlris.prefixes_cnt;
+  if (mp_reach != NULL) {
+    nlris_cnt += mp_reach->nlris_cnt;
+  }
+  if (mp_unreach != NULL) {
+    nlris_cnt += mp_unreach->withdrawn_nlris_cnt;
+  }
+  return nlris_cnt == 0;
+}
+
 int bgpstream_parsebgp_process_update(bgpstream_parsebgp_upd_state_t *upd_state,
                                       bgpstream_elem_t *elem,
                                       parsebgp_bgp_msg_t *bgp)
@@ -414,6 +960,22 @@ int bgpstream_parsebgp_process_update(bgpstream_parsebgp_upd_state_t *upd_state,
     // all other flags left set to zero
 
     upd_state->ready = 1;
+
+    // most updates carry a single prefix
+    if (upd_state->withdrawal_v4_cnt + upd_state->withdrawal_v6_cnt +
+          upd_state->announce_v4_cnt + upd_state->announce_v6_cnt ==
+        1) {
+      return process_single_nlri(upd_state, elem, update);
+    }
+
+    // withdrawals never need the path attributes, and an update that carries
+    // any cannot be an End-of-RIB marker
+    if (upd_state->announce_v4_cnt == 0 && upd_state->announce_v6_cnt == 0 &&
+        (upd_state->withdrawal_v4_cnt != 0 ||
+         upd_state->withdrawal_v6_cnt != 0)) {
+      upd_state->path_attr_done = 1;
+      upd_state->eor_done = 1;
+    }
   }
 
   // are we at end-of-elems?
@@ -463,11 +1025,16 @@ int bgpstream_parsebgp_process_update(bgpstream_parsebgp_upd_state_t *upd_state,
   return 0;
 }
 
-int bgpstream_parsebgp_process_path_attrs(
-  bgpstream_elem_t *el, parsebgp_bgp_update_path_attr_t *attrs)
+// decode the (comparatively expensive) AS path and communities attributes
+static int decode_as_path_communities(bgpstream_as_path_t *as_path,
+                                      bgpstream_community_set_t *communities,
+                                      parsebgp_bgp_update_path_attr_t *attrs)
 {
   parsebgp_bgp_update_as_path_t *aspath = NULL;
   parsebgp_bgp_update_as_path_t *as4path = NULL;
+  parsebgp_bgp_update_large_communities_t *lcomms;
+  bgpstream_large_community_t lc;
+  int i;
 
   // AS Path(s)
   if (attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH].type ==
@@ -478,6 +1045,52 @@ int bgpstream_parsebgp_process_path_attrs(
       PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH) {
     as4path = attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH].data.as_path;
   }
+
+  if (handle_as_paths(as_path, aspath, as4path) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not parse AS_PATH");
+    return -1;
+  }
+
+  // Communities
+  bgpstream_community_set_clear(communities);
+  if (attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES].type ==
+        PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES &&
+      bgpstream_community_set_populate(
+        communities,
+        attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES].data.communities->raw,
+        attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES].len) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not parse COMMUNITIES");
+    return -1;
+  }
+  if (attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES].type ==
+      PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES) {
+    lcomms = attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES]
+               .data.large_communities;
+    for (i = 0; i < lcomms->communities_cnt; i++) {
+      lc.global_admin = lcomms->communities[i].global_admin;
+      lc.local_1 = lcomms->communities[i].local_1;
+      lc.local_2 = lcomms->communities[i].local_2;
+      if (bgpstream_community_set_insert_large(communities, &lc) != 0) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Could not parse LARGE_COMMUNITIES");
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static int process_as_path_communities(bgpstream_elem_t *el,
+                                       const void *data)
+{
+  return decode_as_path_communities(el->as_path, el->communities,
+                                    (parsebgp_bgp_update_path_attr_t *)data);
+}
+
+// decode the remaining (fixed-size) path attributes
+static int process_simple_attrs(bgpstream_elem_t *el,
+                                parsebgp_bgp_update_path_attr_t *attrs)
+{
   // ORIGIN: origin as-path attribute (IGP, EGP, INCOMPLETE)
   if (attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGIN].type ==
       PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGIN) {
@@ -532,23 +1145,157 @@ int bgpstream_parsebgp_process_path_attrs(
     el->aggregator.has_aggregator = 0;
   }
 
-  if (handle_as_paths(el->as_path, aspath, as4path) != 0) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not parse AS_PATH");
+  return 0;
+}
+
+int bgpstream_parsebgp_process_path_attrs(
+  bgpstream_elem_t *el, parsebgp_bgp_update_path_attr_t *attrs)
+{
+  if (process_simple_attrs(el, attrs) != 0 ||
+      process_as_path_communities(el, attrs) != 0) {
     return -1;
   }
+  return 0;
+}
 
-  // Communities
-  bgpstream_community_set_clear(el->communities);
-  if (attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES].type ==
-        PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES &&
-      bgpstream_community_set_populate(
-        el->communities,
-        attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES].data.communities->raw,
-        attrs[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES].len) != 0) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not parse COMMUNITIES");
+int bgpstream_parsebgp_process_path_attrs_lazy(
+  bgpstream_elem_t *el, parsebgp_bgp_update_path_attr_t *attrs)
+{
+  if (process_simple_attrs(el, attrs) != 0) {
     return -1;
   }
+  bgpstream_elem_set_lazy(el, process_as_path_communities, attrs);
+  return 0;
+}
+
+bgpstream_parsebgp_attr_cache_t *bgpstream_parsebgp_attr_cache_create(void)
+{
+  bgpstream_parsebgp_attr_cache_t *cache;
+
+  if ((cache = malloc_zero(sizeof(bgpstream_parsebgp_attr_cache_t))) ==
+      NULL) {
+    return NULL;
+  }
+  if ((cache->index = kh_init(attr_cache)) == NULL) {
+    free(cache);
+    return NULL;
+  }
+  return cache;
+}
+
+void bgpstream_parsebgp_attr_cache_release(
+  bgpstream_parsebgp_attr_cache_t *cache, bgpstream_elem_t *el)
+{
+  if (cache->elem_as_path == NULL) {
+    return;
+  }
+  el->as_path = cache->elem_as_path;
+  el->communities = cache->elem_communities;
+  cache->elem_as_path = NULL;
+  cache->elem_communities = NULL;
+}
+
+void bgpstream_parsebgp_attr_cache_clear(bgpstream_parsebgp_attr_cache_t *cache,
+                                         bgpstream_elem_t *el)
+{
+  bgpstream_parsebgp_attr_cache_release(cache, el);
+  kh_clear(attr_cache, cache->index);
+  cache->entries_cnt = 0;
+}
+
+void bgpstream_parsebgp_attr_cache_destroy(
+  bgpstream_parsebgp_attr_cache_t *cache)
+{
+  int i;
 
+  if (cache == NULL) {
+    return;
+  }
+  // the elem must have been given its own objects back
+  assert(cache->elem_as_path == NULL);
+  for (i = 0; i < cache->entries_alloc; i++) {
+    free(cache->entries[i].key);
+    bgpstream_as_path_destroy(cache->entries[i].as_path);
+    bgpstream_community_set_destroy(cache->entries[i].communities);
+  }
+  free(cache->entries);
+  free(cache->scratch.key);
+  kh_destroy(attr_cache, cache->index);
+  free(cache);
+}
+
+// returns a (cleared) entry for a new key, or NULL if out of memory
+static attr_cache_entry_t *
+attr_cache_add_entry(bgpstream_parsebgp_attr_cache_t *cache)
+{
+  attr_cache_entry_t *e, *tmp;
+  int new_alloc;
+
+  if (cache->entries_cnt == cache->entries_alloc) {
+    new_alloc = cache->entries_alloc == 0 ? 8 : cache->entries_alloc * 2;
+    if ((tmp = realloc(cache->entries, sizeof(attr_cache_entry_t) *
+                                         new_alloc)) == NULL) {
+      return NULL;
+    }
+    memset(&tmp[cache->entries_alloc], 0,
+           sizeof(attr_cache_entry_t) * (new_alloc - cache->entries_alloc));
+    cache->entries = tmp;
+    cache->entries_alloc = new_alloc;
+  }
+  e = &cache->entries[cache->entries_cnt];
+  if ((e->as_path == NULL &&
+       (e->as_path = bgpstream_as_path_create()) == NULL) ||
+      (e->communities == NULL &&
+       (e->communities = bgpstream_community_set_create()) == NULL)) {
+    return NULL;
+  }
+  e->key_len = 0;
+  return e;
+}
+
+int bgpstream_parsebgp_process_path_attrs_cached(
+  bgpstream_elem_t *el, parsebgp_bgp_update_path_attr_t *attrs,
+  bgpstream_parsebgp_attr_cache_t *cache)
+{
+  attr_cache_entry_t *e;
+  uint64_t h;
+  khiter_t k;
+  int khret;
+
+  if (process_simple_attrs(el, attrs) != 0 ||
+      build_key(&cache->scratch, attrs) != 0) {
+    return -1;
+  }
+  h = hash_key(&cache->scratch);
+
+  if ((k = kh_get(attr_cache, cache->index, h)) != kh_end(cache->index)) {
+    e = &cache->entries[kh_val(cache->index, k)];
+    if (e->key_len != cache->scratch.key_len ||
+        memcmp(e->key, cache->scratch.key, e->key_len) != 0) {
+      // hash collision, so just decode into the elem's own objects
+      bgpstream_parsebgp_attr_cache_release(cache, el);
+      return process_as_path_communities(el, attrs);
+    }
+  } else {
+    if ((e = attr_cache_add_entry(cache)) == NULL ||
+        key_append(e, cache->scratch.key, cache->scratch.key_len) != 0 ||
+        decode_as_path_communities(e->as_path, e->communities, attrs) != 0) {
+      return -1;
+    }
+    k = kh_put(attr_cache, cache->index, h, &khret);
+    if (khret == -1) {
+      return -1;
+    }
+    kh_val(cache->index, k) = cache->entries_cnt++;
+  }
+
+  // point the elem at the shared objects
+  if (cache->elem_as_path == NULL) {
+    cache->elem_as_path = el->as_path;
+    cache->elem_communities = el->communities;
+  }
+  el->as_path = e->as_path;
+  el->communities = e->communities;
   return 0;
 }
 
@@ -577,20 +1324,359 @@ int bgpstream_parsebgp_process_next_hop(bgpstream_elem_t *el,
   return 0;
 }
 
+// counts a message that was read but filtered out
+static void count_skipped(bgpstream_parsebgp_decode_state_t *state,
+                          uint64_t *skipped_cnt)
+{
+  if (*skipped_cnt == UINT64_MAX) {
+    // probably this will never happen, but lets just be careful we don't
+    // wrap and think we haven't skipped anything
+    *skipped_cnt = 0;
+  }
+  (*skipped_cnt)++;
+  state->successful_read_cnt++;
+}
+
+// lets the caller decide if they want a decoded message. returns 1 if the
+// message was filtered out (and the next one should be read), or 0 if status
+// has been set
+static int filter_msg(bgpstream_parsebgp_decode_state_t *state,
+                      parsebgp_msg_t *msg, bgpstream_format_t *format,
+                      bgpstream_record_t *record,
+                      bgpstream_parsebgp_check_filter_cb_t *filter_cb,
+                      uint64_t *skipped_cnt, bgpstream_format_status_t *status)
+{
+  bgpstream_parsebgp_check_filter_rc_t filter_rc;
+
+  filter_rc = filter_cb(format, record, msg);
+  if (filter_rc == BGPSTREAM_PARSEBGP_FILTER_ERROR) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Format-specific filtering failed");
+    *status = BGPSTREAM_FORMAT_UNKNOWN_ERROR;
+    return 0;
+  }
+
+  if (filter_rc == BGPSTREAM_PARSEBGP_KEEP) {
+    // valid message, and it passes our filters
+    state->valid_read_cnt++;
+    state->successful_read_cnt++;
+    record->status = BGPSTREAM_RECORD_STATUS_VALID_RECORD;
+  } else if (filter_rc == BGPSTREAM_PARSEBGP_EOS) {
+    if (state->successful_read_cnt > 0) {
+      // we can't tell if it is the end since we're not going to read any more,
+      // so we'll call it the middle.
+      record->dump_pos = BGPSTREAM_DUMP_MIDDLE;
+    }
+    record->status = BGPSTREAM_RECORD_STATUS_OUTSIDE_TIME_INTERVAL;
+    *status = BGPSTREAM_FORMAT_OUTSIDE_TIME_INTERVAL;
+    return 0;
+  } else {
+    // move on to the next record
+
+    if (filter_rc == BGPSTREAM_PARSEBGP_FILTER_OUT) {
+      count_skipped(state, skipped_cnt);
+    }
+    parsebgp_clear_msg(msg);
+    return 1;
+  }
+
+  // if this is the first record we read and no previous
+  // valid record has been discarded because of time
+  if (state->valid_read_cnt == 1 && state->successful_read_cnt == 1) {
+    record->dump_pos = BGPSTREAM_DUMP_START;
+  } else {
+    record->dump_pos = BGPSTREAM_DUMP_MIDDLE;
+    // NB when the *next* record is pre-fetched, this may be changed to
+    // end-of-dump by the reader (since we'll discover that there are no more
+    // records)
+  }
+
+  // record time was updated by filter_cb
+
+  // we successfully read a record
+  *status = BGPSTREAM_FORMAT_OK;
+  return 0;
+}
+
+/* -------------------- PARALLEL DECODING -------------------- */
+
+// decodes filled chunks until the decoder is shut down
+static void *pdec_worker(void *user)
+{
+  bgpstream_parsebgp_pdecode_t *pd = (bgpstream_parsebgp_pdecode_t *)user;
+  pdec_chunk_t *c = NULL;
+  size_t len;
+  int i;
+
+  pthread_mutex_lock(&pd->mutex);
+  while (1) {
+    // decode the oldest chunk that is waiting, so that the consumer is not
+    // kept waiting for the head
+    c = NULL;
+    for (i = 0; i < pd->used; i++) {
+      if (pd->chunks[(pd->head + i) % pd->chunks_cnt].state == CHUNK_FILLED) {
+        c = &pd->chunks[(pd->head + i) % pd->chunks_cnt];
+        break;
+      }
+    }
+    if (c == NULL) {
+      if (pd->shutdown != 0) {
+        break;
+      }
+      pthread_cond_wait(&pd->work_cond, &pd->mutex);
+      continue;
+    }
+    c->state = CHUNK_DECODING;
+    pthread_mutex_unlock(&pd->mutex);
+
+    for (i = 0; i < c->rec_cnt; i++) {
+      if (c->rec_len[i] == 0) {
+        // skipped by the peek filter
+        continue;
+      }
+      len = c->rec_len[i];
+      parsebgp_clear_msg(c->msgs[i]);
+      c->errs[i] = parsebgp_decode(*pd->opts, pd->msg_type, c->msgs[i],
+                                   c->rec_ptr[i], &len);
+    }
+
+    pthread_mutex_lock(&pd->mutex);
+    c->state = CHUNK_DECODED;
+    pthread_cond_broadcast(&pd->done_cond);
+  }
+  pthread_mutex_unlock(&pd->mutex);
+  return NULL;
+}
+
+// makes sure that at least need bytes are buffered. returns 1 if they are, 0
+// if the transport has no more data, or -1 if the read failed
+static int pdec_buffer(bgpstream_parsebgp_decode_state_t *state,
+                       bgpstream_format_t *format, size_t need)
+{
+  ssize_t fill_len;
+  int rc;
+
+  while (state->remain < need) {
+    if (state->mapped == 0 && (rc = reserve_buffer(state, need)) != 1) {
+      // the message can never fit in the buffer (0), or it could not grow
+      return rc;
+    }
+    if ((fill_len = refill_buffer(state, format->transport)) < 0) {
+      return -1;
+    }
+    if (fill_len == state->remain) {
+      return 0;
+    }
+    state->remain = fill_len;
+  }
+  return 1;
+}
+
+// splits buffered data into record-aligned chunks, and hands them to the
+// workers. returns 0 if successful, -1 if a read failed
+static int pdec_fill(bgpstream_parsebgp_decode_state_t *state,
+                     bgpstream_format_t *format,
+                     bgpstream_parsebgp_peek_filter_cb_t *peek_cb)
+{
+  bgpstream_parsebgp_pdecode_t *pd = state->pdec;
+  pdec_chunk_t *c;
+  size_t msg_len, off;
+  uint8_t *tmp;
+  int rc, i;
+
+  // only the consumer (i.e., us) changes head and used
+  while (pd->eof == 0 && pd->used < pd->chunks_cnt) {
+    c = &pd->chunks[(pd->head + pd->used) % pd->chunks_cnt];
+    assert(c->state == CHUNK_EMPTY);
+    c->len = 0;
+    c->rec_cnt = 0;
+    c->next_rec = 0;
+
+    while (c->rec_cnt < PDEC_CHUNK_RECS && c->len < PDEC_CHUNK_LEN) {
+      // find the length of the next message from its header
+      msg_len = 0;
+      while ((rc = pdec_buffer(state, format, msg_len + 1)) == 1 &&
+             (msg_len = pd->msg_len_cb(state->ptr, state->remain)) == 0) {
+        // the header is not complete yet
+        msg_len = state->remain;
+      }
+      if (rc == 1) {
+        rc = pdec_buffer(state, format, msg_len);
+      }
+      if (rc != 1) {
+        // no more (complete) messages. any partial message left in the buffer
+        // is reported once the chunks have been consumed
+        pd->eof = 1;
+        pd->read_failed = (rc < 0);
+        pd->read_errno = errno;
+        break;
+      }
+
+      if (peek_cb != NULL &&
+          peek_cb(format, state->ptr, state->remain, &msg_len) ==
+            BGPSTREAM_PARSEBGP_FILTER_OUT) {
+        c->rec_len[c->rec_cnt++] = 0;
+      } else if (state->mapped != 0) {
+        // the mapping outlives the chunk, so the message is decoded in place
+        c->rec_ptr[c->rec_cnt] = state->ptr;
+        c->rec_len[c->rec_cnt++] = msg_len;
+      } else {
+        if (c->len + msg_len > c->buf_alloc) {
+          if ((tmp = realloc(c->buf, c->len + msg_len)) == NULL) {
+            return -1;
+          }
+          c->buf = tmp;
+          c->buf_alloc = c->len + msg_len;
+        }
+        memcpy(c->buf + c->len, state->ptr, msg_len);
+        c->len += msg_len;
+        c->rec_len[c->rec_cnt++] = msg_len;
+      }
+      consume_buffer(state, msg_len);
+    }
+
+    if (c->rec_cnt == 0) {
+      break;
+    }
+    if (state->mapped == 0) {
+      // (buf may have moved while it grew)
+      for (i = 0, off = 0; i < c->rec_cnt; i++) {
+        c->rec_ptr[i] = c->buf + off;
+        off += c->rec_len[i];
+      }
+    }
+    pthread_mutex_lock(&pd->mutex);
+    c->state = CHUNK_FILLED;
+    pd->used++;
+    pthread_cond_signal(&pd->work_cond);
+    pthread_mutex_unlock(&pd->mutex);
+  }
+
+  return 0;
+}
+
+static bgpstream_format_status_t
+populate_record_parallel(bgpstream_parsebgp_decode_state_t *state,
+                         parsebgp_msg_t **msgp, bgpstream_format_t *format,
+                         bgpstream_record_t *record,
+                         bgpstream_parsebgp_peek_filter_cb_t *peek_cb,
+                         bgpstream_parsebgp_check_filter_cb_t *filter_cb)
+{
+  bgpstream_parsebgp_pdecode_t *pd = state->pdec;
+  pdec_chunk_t *c;
+  parsebgp_msg_t *tmp;
+  parsebgp_error_t err = PARSEBGP_OK;
+  uint64_t skipped_cnt = 0;
+  bgpstream_format_status_t status;
+  int skipped;
+
+  record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_SOURCE;
+
+  assert(record->time_sec == 0);
+
+  while (1) {
+    // keep the workers busy
+    if (pdec_fill(state, format, peek_cb) != 0) {
+      return BGPSTREAM_FORMAT_UNKNOWN_ERROR;
+    }
+
+    if (pd->used == 0) {
+      // everything that was read has been returned
+      if (pd->read_failed != 0) {
+        // as in the sequential decoder, EIO is probably a truncated file
+        if (pd->read_errno == EIO) {
+          bgpstream_log(BGPSTREAM_LOG_WARN, "Unexpected EOF. Input file "
+                                            "potentially truncated or "
+                                            "corrupted.");
+          record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_RECORD;
+          return BGPSTREAM_FORMAT_CORRUPTED_DUMP;
+        }
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Could not refill buffer");
+        return BGPSTREAM_FORMAT_READ_ERROR;
+      }
+      if (state->remain != 0) {
+        // a partial message was left at the end of the dump
+        record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_RECORD;
+        return BGPSTREAM_FORMAT_CORRUPTED_DUMP;
+      }
+      return handle_eof(state, record, skipped_cnt);
+    }
+
+    // wait for the oldest chunk, and take its next message
+    c = &pd->chunks[pd->head];
+    pthread_mutex_lock(&pd->mutex);
+    while (c->state != CHUNK_DECODED) {
+      pthread_cond_wait(&pd->done_cond, &pd->mutex);
+    }
+    pthread_mutex_unlock(&pd->mutex);
+
+    skipped = (c->rec_len[c->next_rec] == 0);
+    if (skipped == 0) {
+      // the record takes the decoded message, and leaves its (cleared) one
+      // for the worker to re-use
+      tmp = *msgp;
+      *msgp = c->msgs[c->next_rec];
+      c->msgs[c->next_rec] = tmp;
+      err = c->errs[c->next_rec];
+      // the chunk is not refilled until the next call
+      state->raw = c->rec_ptr[c->next_rec];
+      state->raw_len = c->rec_len[c->next_rec];
+    }
+    if (++c->next_rec == c->rec_cnt) {
+      pthread_mutex_lock(&pd->mutex);
+      c->state = CHUNK_EMPTY;
+      pd->head = (pd->head + 1) % pd->chunks_cnt;
+      pd->used--;
+      pthread_mutex_unlock(&pd->mutex);
+    }
+
+    if (skipped != 0) {
+      count_skipped(state, &skipped_cnt);
+      continue;
+    }
+
+    if (err == PARSEBGP_TRUNCATED_MSG) {
+      bgpstream_log(BGPSTREAM_LOG_WARN,
+                    "Read truncated record %" PRIu64 " from '%s'",
+                    state->successful_read_cnt, format->res->url);
+    } else if (err != PARSEBGP_OK) {
+      // the whole message was available, so even a partial one is invalid
+      parsebgp_clear_msg(*msgp);
+      bgpstream_log(BGPSTREAM_LOG_WARN,
+                    "Failed to parse message from '%s' (%d:%s)",
+                    format->res->url, err, parsebgp_strerror(err));
+      record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_RECORD;
+      return BGPSTREAM_FORMAT_CORRUPTED_MSG;
+    }
+
+    if (filter_msg(state, *msgp, format, record, filter_cb, &skipped_cnt,
+                   &status) == 0) {
+      return status;
+    }
+  }
+}
+
 bgpstream_format_status_t bgpstream_parsebgp_populate_record(
-  bgpstream_parsebgp_decode_state_t *state, parsebgp_msg_t *msg,
+  bgpstream_parsebgp_decode_state_t *state, parsebgp_msg_t **msgp,
   bgpstream_format_t *format, bgpstream_record_t *record,
   bgpstream_parsebgp_prep_buf_cb_t *prep_cb,
+  bgpstream_parsebgp_peek_filter_cb_t *peek_cb,
   bgpstream_parsebgp_check_filter_cb_t *filter_cb)
 {
   assert(record->__int->format == format);
 
+  if (state->pdec != NULL) {
+    assert(prep_cb == NULL);
+    return populate_record_parallel(state, msgp, format, record, peek_cb,
+                                    filter_cb);
+  }
+
+  parsebgp_msg_t *msg = *msgp;
   int refill = 0;
   ssize_t fill_len = 0;
   size_t dec_len = 0, hdr_len = 0;
   uint64_t skipped_cnt = 0;
   parsebgp_error_t err;
-  bgpstream_parsebgp_check_filter_rc_t filter_rc;
+  bgpstream_format_status_t status;
 
   record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_SOURCE;
 
@@ -629,9 +1715,8 @@ refill:
       record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_RECORD;
       return BGPSTREAM_FORMAT_CORRUPTED_DUMP;
     }
-    // here we have something new to read
+    // here we have something new to read (refill_buffer has set ptr)
     state->remain = fill_len;
-    state->ptr = state->buffer;
 
     // reset the "force refill" flag
     refill = 0;
@@ -650,8 +1735,18 @@ refill:
       bgpstream_log(BGPSTREAM_LOG_ERR, "Failed to prep data buffer");
       return BGPSTREAM_FORMAT_UNKNOWN_ERROR;
     }
-    state->ptr += hdr_len;
-    state->remain -= hdr_len;
+    consume_buffer(state, hdr_len);
+  }
+
+  // skip messages that can be filtered out without decoding them
+  if (peek_cb != NULL &&
+      peek_cb(format, state->ptr, state->remain, &dec_len) ==
+        BGPSTREAM_PARSEBGP_FILTER_OUT) {
+    assert(dec_len <= state->remain);
+    consume_buffer(state, dec_len);
+    count_skipped(state, &skipped_cnt);
+    refill = 0;
+    goto refill;
   }
 
   dec_len = state->remain;
@@ -681,50 +1776,19 @@ refill:
 #endif
 
     // move past this record in our buffer
-    state->ptr += dec_len;
-    state->remain -= dec_len;
+    consume_buffer(state, dec_len);
 
     record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_RECORD;
     return BGPSTREAM_FORMAT_CORRUPTED_MSG;
   }
-  // else: successful read
-  state->ptr += dec_len;
-  state->remain -= dec_len;
+  // else: successful read (the buffer is not refilled until the next call)
+  state->raw = state->ptr;
+  state->raw_len = dec_len;
+  consume_buffer(state, dec_len);
 
   // got a message!
-  // let the caller decide if they want it
-  filter_rc = filter_cb(format, record, msg);
-  if (filter_rc == BGPSTREAM_PARSEBGP_FILTER_ERROR) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Format-specific filtering failed");
-    return BGPSTREAM_FORMAT_UNKNOWN_ERROR;
-  }
-
-  if (filter_rc == BGPSTREAM_PARSEBGP_KEEP) {
-    // valid message, and it passes our filters
-    state->valid_read_cnt++;
-    state->successful_read_cnt++;
-    record->status = BGPSTREAM_RECORD_STATUS_VALID_RECORD;
-  } else if (filter_rc == BGPSTREAM_PARSEBGP_EOS) {
-    if (state->successful_read_cnt > 0) {
-      // we can't tell if it is the end since we're not going to read any more,
-      // so we'll call it the middle.
-      record->dump_pos = BGPSTREAM_DUMP_MIDDLE;
-    }
-    record->status = BGPSTREAM_RECORD_STATUS_OUTSIDE_TIME_INTERVAL;
-    return BGPSTREAM_FORMAT_OUTSIDE_TIME_INTERVAL;
-  } else {
-    // move on to the next record
-
-    if (filter_rc == BGPSTREAM_PARSEBGP_FILTER_OUT) {
-      if (skipped_cnt == UINT64_MAX) {
-        // probably this will never happen, but lets just be careful we don't
-        // wrap and think we haven't skipped anything
-        skipped_cnt = 0;
-      }
-      skipped_cnt++;
-      state->successful_read_cnt++;
-    }
-    parsebgp_clear_msg(msg);
+  if (filter_msg(state, msg, format, record, filter_cb, &skipped_cnt,
+                 &status) != 0) {
     // there is a cool corner case here when our buffer ends perfectly at the
     // end of a message, AND we filter the message out. previously i had a
     // simple "continue" which would have dropped out of the loop (since
@@ -736,22 +1800,206 @@ refill:
     refill = 0; // don't force the refill, just let it happen naturally
     goto refill;
   }
+  // the record ends where the unread part of the buffer begins
+  record->__int->position = state->read_total - state->remain;
+  return status;
+}
 
-  // if this is the first record we read and no previous
-  // valid record has been discarded because of time
-  if (state->valid_read_cnt == 1 && state->successful_read_cnt == 1) {
-    record->dump_pos = BGPSTREAM_DUMP_START;
+int bgpstream_parsebgp_decode_state_init(
+  bgpstream_parsebgp_decode_state_t *state, parsebgp_msg_type_t msg_type,
+  bgpstream_resource_t *res)
+{
+  state->msg_type = msg_type;
+  state->remain = 0;
+  state->pdec = NULL;
+  state->mapped = 0;
+  state->mem = res->mem;
+
+  // the buffer is allocated by the first read
+  state->buffer = NULL;
+  state->ptr = NULL;
+  state->buflen = 0;
+  state->mirrored = 0;
+  state->max_msg_len = 0;
+  state->resize_read = 0;
+
+  if (res->duration == BGPSTREAM_FOREVER) {
+    state->min_buflen = BGPSTREAM_PARSEBGP_STREAM_BUFLEN;
+    state->release_idle = 1;
+  } else if (res->record_type == BGPSTREAM_RIB) {
+    state->min_buflen = BGPSTREAM_PARSEBGP_BUFLEN;
+    state->release_idle = 0;
   } else {
-    record->dump_pos = BGPSTREAM_DUMP_MIDDLE;
-    // NB when the *next* record is pre-fetched, this may be changed to
-    // end-of-dump by the reader (since we'll discover that there are no more
-    // records)
+    state->min_buflen = BGPSTREAM_PARSEBGP_UPDATES_BUFLEN;
+    state->release_idle = 0;
   }
 
-  // record time was updated by filter_cb
+  return 0;
+}
+
+// stops the decode workers and frees their state
+static void pdec_destroy(bgpstream_parsebgp_pdecode_t *pd)
+{
+  int i, j;
+
+  pthread_mutex_lock(&pd->mutex);
+  pd->shutdown = 1;
+  pthread_cond_broadcast(&pd->work_cond);
+  pthread_mutex_unlock(&pd->mutex);
+  for (i = 0; i < pd->threads_cnt; i++) {
+    pthread_join(pd->threads[i], NULL);
+  }
+  free(pd->threads);
+
+  for (i = 0; pd->chunks != NULL && i < pd->chunks_cnt; i++) {
+    for (j = 0; j < PDEC_CHUNK_RECS; j++) {
+      if (pd->chunks[i].msgs[j] != NULL) {
+        parsebgp_destroy_msg(pd->chunks[i].msgs[j]);
+      }
+    }
+    free(pd->chunks[i].buf);
+  }
+  free(pd->chunks);
 
-  // we successfully read a record, return it
-  return BGPSTREAM_FORMAT_OK;
+  pthread_mutex_destroy(&pd->mutex);
+  pthread_cond_destroy(&pd->work_cond);
+  pthread_cond_destroy(&pd->done_cond);
+  free(pd);
+}
+
+int bgpstream_parsebgp_decode_state_set_threads(
+  bgpstream_parsebgp_decode_state_t *state, int threads,
+  bgpstream_parsebgp_msg_len_cb_t *msg_len_cb)
+{
+  bgpstream_parsebgp_pdecode_t *pd;
+  int i, j;
+
+  assert(state->pdec == NULL);
+  if (threads < 2) {
+    return 0;
+  }
+
+  if ((pd = malloc_zero(sizeof(bgpstream_parsebgp_pdecode_t))) == NULL) {
+    return -1;
+  }
+  state->pdec = pd;
+  pd->opts = &state->parser_opts;
+  pd->msg_type = state->msg_type;
+  pd->msg_len_cb = msg_len_cb;
+  pthread_mutex_init(&pd->mutex, NULL);
+  pthread_cond_init(&pd->work_cond, NULL);
+  pthread_cond_init(&pd->done_cond, NULL);
+
+  pd->chunks_cnt = threads * PDEC_CHUNKS_PER_THREAD;
+  if ((pd->chunks = malloc_zero(sizeof(pdec_chunk_t) * pd->chunks_cnt)) ==
+      NULL) {
+    goto err;
+  }
+  for (i = 0; i < pd->chunks_cnt; i++) {
+    for (j = 0; j < PDEC_CHUNK_RECS; j++) {
+      if ((pd->chunks[i].msgs[j] = parsebgp_create_msg()) == NULL) {
+        goto err;
+      }
+    }
+  }
+
+  if ((pd->threads = malloc(sizeof(pthread_t) * threads)) == NULL) {
+    goto err;
+  }
+  for (i = 0; i < threads; i++) {
+    if (bgpstream_affinity_thread_create(&pd->threads[i], pdec_worker, pd) !=
+        0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not start decode thread");
+      goto err;
+    }
+    pd->threads_cnt++;
+  }
+
+  return 0;
+
+err:
+  pdec_destroy(pd);
+  state->pdec = NULL;
+  return -1;
+}
+
+int bgpstream_parsebgp_decode_state_map(
+  bgpstream_parsebgp_decode_state_t *state, bgpstream_transport_t *transport)
+{
+  uint8_t *data;
+  int64_t len;
+
+  if (state->mapped != 0 || state->remain != 0 ||
+      (len = bgpstream_transport_map(transport, &data)) < 0) {
+    return 0;
+  }
+  // no buffer is needed: everything is decoded from the mapping
+  if (state->buffer != NULL) {
+    free_buffer(state);
+  }
+  state->buffer = data;
+  state->ptr = data;
+  state->remain = len;
+  state->read_total = len;
+  state->mirrored = 0;
+  state->mapped = 1;
+  return 1;
+}
+
+void bgpstream_parsebgp_decode_state_destroy(
+  bgpstream_parsebgp_decode_state_t *state)
+{
+  if (state->pdec != NULL) {
+    pdec_destroy(state->pdec);
+    state->pdec = NULL;
+  }
+  if (state->buffer == NULL) {
+    return;
+  }
+  if (state->mapped == 0) {
+    // (a mapped buffer is borrowed from the transport)
+    free_buffer(state);
+  }
+  state->buffer = NULL;
+  state->ptr = NULL;
+  state->remain = 0;
+}
+
+void bgpstream_parsebgp_opts_prune(parsebgp_opts_t *opts,
+                                   bgpstream_filter_mgr_t *filter_mgr)
+{
+  // fields that the elem filters (of the stream or of a filter set) look at
+  // are needed even if the user does not want them
+  uint8_t unused = filter_mgr->unused_elem_fields &
+                   ~bgpstream_filter_mgr_elem_fields(filter_mgr);
+  uint8_t *filter = opts->bgp.path_attr_filter;
+
+  // MP_REACH and MP_UNREACH carry NLRIs, so they are always needed
+  if (unused & BGPSTREAM_ELEM_FIELD_NEXTHOP) {
+    filter[PARSEBGP_BGP_PATH_ATTR_TYPE_NEXT_HOP] = 0;
+  }
+  if (unused & BGPSTREAM_ELEM_FIELD_AS_PATH) {
+    filter[PARSEBGP_BGP_PATH_ATTR_TYPE_AS_PATH] = 0;
+    filter[PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH] = 0;
+  }
+  if (unused & BGPSTREAM_ELEM_FIELD_COMMUNITIES) {
+    filter[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES] = 0;
+    filter[PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES] = 0;
+  }
+  if (unused & BGPSTREAM_ELEM_FIELD_ORIGIN) {
+    filter[PARSEBGP_BGP_PATH_ATTR_TYPE_ORIGIN] = 0;
+  }
+  if (unused & BGPSTREAM_ELEM_FIELD_MED) {
+    filter[PARSEBGP_BGP_PATH_ATTR_TYPE_MED] = 0;
+  }
+  if (unused & BGPSTREAM_ELEM_FIELD_LOCAL_PREF) {
+    filter[PARSEBGP_BGP_PATH_ATTR_TYPE_LOCAL_PREF] = 0;
+  }
+  if (unused & BGPSTREAM_ELEM_FIELD_AGGREGATOR) {
+    filter[PARSEBGP_BGP_PATH_ATTR_TYPE_ATOMIC_AGGREGATE] = 0;
+    filter[PARSEBGP_BGP_PATH_ATTR_TYPE_AGGREGATOR] = 0;
+    filter[PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_AGGREGATOR] = 0;
+  }
 }
 
 void bgpstream_parsebgp_opts_init(parsebgp_opts_t *opts)
@@ -766,6 +2014,7 @@ void bgpstream_parsebgp_opts_init(parsebgp_opts_t *opts)
   opts->bgp.path_attr_filter[PARSEBGP_BGP_PATH_ATTR_TYPE_ATOMIC_AGGREGATE] = 1;
   opts->bgp.path_attr_filter[PARSEBGP_BGP_PATH_ATTR_TYPE_AGGREGATOR] = 1;
   opts->bgp.path_attr_filter[PARSEBGP_BGP_PATH_ATTR_TYPE_COMMUNITIES] = 1;
+  opts->bgp.path_attr_filter[PARSEBGP_BGP_PATH_ATTR_TYPE_LARGE_COMMUNITIES] = 1;
   opts->bgp.path_attr_filter[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_REACH_NLRI] = 1;
   opts->bgp.path_attr_filter[PARSEBGP_BGP_PATH_ATTR_TYPE_MP_UNREACH_NLRI] = 1;
   opts->bgp.path_attr_filter[PARSEBGP_BGP_PATH_ATTR_TYPE_AS4_PATH] = 1;
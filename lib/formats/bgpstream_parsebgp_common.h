@@ -29,6 +29,7 @@
 
 #include "bgpstream_elem.h"
 #include "bgpstream_format.h"
+#include "bgpstream_mem.h"
 #include "parsebgp.h"
 
 #define COPY_IP(dst, afi, src, do_unknown)                                     \
@@ -47,10 +48,18 @@
     }                                                                          \
   } while (0)
 
-// read in chunks of 1MB to minimize the number of partial parses we end up
-// doing.  this is also the same length as the wandio thread buffer, so this
-// might help reduce the time waiting for locks
-#define BGPSTREAM_PARSEBGP_BUFLEN 1024 * 1024
+// read RIB dumps in chunks of 1MB to minimize the number of partial parses we
+// end up doing.  this is also the same length as the wandio thread buffer, so
+// this might help reduce the time waiting for locks
+#define BGPSTREAM_PARSEBGP_BUFLEN (1024 * 1024)
+
+// update dumps and streams have much smaller messages, and streams are often
+// idle, so their buffers start smaller (and grow if a message does not fit)
+#define BGPSTREAM_PARSEBGP_UPDATES_BUFLEN (256 * 1024)
+#define BGPSTREAM_PARSEBGP_STREAM_BUFLEN (64 * 1024)
+
+// messages that do not fit in a buffer this large are treated as corrupted
+#define BGPSTREAM_PARSEBGP_MAX_BUFLEN (16 * 1024 * 1024)
 
 /** Process the given path attributes and populate the given elem
  *
@@ -64,6 +73,77 @@
 int bgpstream_parsebgp_process_path_attrs(
   bgpstream_elem_t *el, parsebgp_bgp_update_path_attr_t *attrs);
 
+/** As bgpstream_parsebgp_process_path_attrs, but defer decoding the AS path
+ * and communities until they are first requested
+ *
+ * @param el            pointer to the elem to populate
+ * @param attrs         array of parsebgp path attributes to process
+ * @return 0 if processing was successful, -1 otherwise
+ *
+ * The attributes must remain valid until the elem is next populated (see
+ * bgpstream_elem_get_as_path).
+ */
+int bgpstream_parsebgp_process_path_attrs_lazy(
+  bgpstream_elem_t *el, parsebgp_bgp_update_path_attr_t *attrs);
+
+/** Opaque cache of AS paths and communities decoded from the path attributes
+ * of one message */
+typedef struct bgpstream_parsebgp_attr_cache bgpstream_parsebgp_attr_cache_t;
+
+/** Create a new attribute cache
+ *
+ * @return pointer to the cache if successful, NULL otherwise
+ */
+bgpstream_parsebgp_attr_cache_t *bgpstream_parsebgp_attr_cache_create(void);
+
+/** Give the elem back its own AS path and community set
+ *
+ * @param cache         pointer to the cache
+ * @param el            pointer to the elem populated using the cache
+ *
+ * This must be called before the elem is modified other than by
+ * bgpstream_parsebgp_process_path_attrs_cached (e.g., before it is cleared or
+ * destroyed).
+ */
+void bgpstream_parsebgp_attr_cache_release(
+  bgpstream_parsebgp_attr_cache_t *cache, bgpstream_elem_t *el);
+
+/** Release the elem and forget all cached attributes
+ *
+ * @param cache         pointer to the cache
+ * @param el            pointer to the elem populated using the cache
+ *
+ * This must be called before the message the attributes came from is re-used.
+ */
+void bgpstream_parsebgp_attr_cache_clear(bgpstream_parsebgp_attr_cache_t *cache,
+                                         bgpstream_elem_t *el);
+
+/** Destroy the given attribute cache
+ *
+ * @param cache         pointer to the cache to destroy
+ *
+ * The elem populated using the cache must have been released first.
+ */
+void bgpstream_parsebgp_attr_cache_destroy(
+  bgpstream_parsebgp_attr_cache_t *cache);
+
+/** As bgpstream_parsebgp_process_path_attrs, but share the AS path and
+ * communities between elems that have the same attributes
+ *
+ * @param el            pointer to the elem to populate
+ * @param attrs         array of parsebgp path attributes to process
+ * @param cache         pointer to the attribute cache of the message
+ * @return 0 if processing was successful, -1 otherwise
+ *
+ * The AS_PATH, AS4_PATH and COMMUNITIES attributes are only decoded the first
+ * time they are seen in the message. The `as_path` and `communities` fields of
+ * the elem then point at objects owned by the cache, which must not be
+ * modified.
+ */
+int bgpstream_parsebgp_process_path_attrs_cached(
+  bgpstream_elem_t *el, parsebgp_bgp_update_path_attr_t *attrs,
+  bgpstream_parsebgp_attr_cache_t *cache);
+
 /** Extract the appropriate NEXT-HOP information from the given attributes
  *
  * @param el            pointer to the elem to populate
@@ -132,6 +212,25 @@ int bgpstream_parsebgp_process_update(bgpstream_parsebgp_upd_state_t *upd_state,
                                       bgpstream_elem_t *elem,
                                       parsebgp_bgp_msg_t *bgp);
 
+/** Check whether any elem of the given BGP message could pass the elem filters
+ *
+ * @param filter_mgr    pointer to the filter manager to check against
+ * @param peer_asn      ASN of the peer the message was received from
+ * @param bgp           pointer to a parsed BGP message
+ * @return 0 if every elem of the message would be filtered out, 1 otherwise
+ *
+ * Only the peer ASN, the wanted elem types and the NLRIs (against the IP
+ * version and prefix filters) are checked, so that formats can skip records
+ * without extracting any elems. The remaining filters are left to the elem
+ * checks.
+ */
+int bgpstream_parsebgp_update_wanted(bgpstream_filter_mgr_t *filter_mgr,
+                                     uint32_t peer_asn,
+                                     parsebgp_bgp_msg_t *bgp);
+
+/** Opaque state of the worker threads used to decode messages in parallel */
+typedef struct bgpstream_parsebgp_pdecode bgpstream_parsebgp_pdecode_t;
+
 typedef struct bgpstream_parsebgp_decode_state {
 
   // outer message type to decode (MRT or BMP)
@@ -140,15 +239,52 @@ typedef struct bgpstream_parsebgp_decode_state {
   // options for libparsebgp
   parsebgp_opts_t parser_opts;
 
-  // raw data buffer
-  uint8_t buffer[BGPSTREAM_PARSEBGP_BUFLEN];
+  // raw data buffer (of buflen bytes, NULL until the first read). if mirrored
+  // is set, the buffer is a ring that is mapped twice, back to back, so that
+  // data that wraps around the end of the ring can still be read
+  // contiguously, and unread data never has to be moved to make room for more.
+  uint8_t *buffer;
+  int mirrored;
+  size_t buflen;
+
+  // size the buffer starts at (set by the type of the resource), and shrinks
+  // back to once messages that needed a larger one stop coming
+  size_t min_buflen;
+
+  // length of the longest message consumed since the buffer was last resized,
+  // and the value of read_total at which to check if it can shrink
+  size_t max_msg_len;
+  uint64_t resize_read;
+
+  // if set, the buffer is freed whenever a read finds no data (i.e., while a
+  // stream is idle)
+  int release_idle;
+
+  // memory accounting that the buffer is counted in (may be NULL)
+  bgpstream_mem_t *mem;
+
+  // if set, buffer is the whole content of the transport (see
+  // bgpstream_parsebgp_decode_state_map), and is never refilled
+  int mapped;
 
   // number of bytes left to read in the buffer
   size_t remain;
 
-  // pointer into buffer
+  // pointer into buffer (always within the first mapping of a mirrored ring)
   uint8_t *ptr;
 
+  // total number of bytes read from the transport into the buffer
+  uint64_t read_total;
+
+  // worker threads decoding messages ahead of the consumer (NULL if messages
+  // are decoded by the consumer)
+  bgpstream_parsebgp_pdecode_t *pdec;
+
+  // raw bytes of the message last returned by _populate_record (valid until
+  // the next call)
+  const uint8_t *raw;
+  size_t raw_len;
+
   // the total number of successful (filtered and not) reads
   uint64_t successful_read_cnt;
 
@@ -209,14 +345,119 @@ typedef int(bgpstream_parsebgp_prep_buf_cb_t)(bgpstream_format_t *format,
                                               uint8_t *buf, size_t *len,
                                               bgpstream_record_t *record);
 
-/** Use libparsebgp to decode a message */
+/** Called before a message is passed to parsebgp, giving the caller a chance
+ * to filter it out using only its raw header
+ *
+ * @param format        pointer to the format that originally called
+ *                      _populate_record
+ * @param buf           pointer to the raw message
+ * @param len           number of bytes available in the buffer
+ * @param[out] msg_len  set to the length of the message if it is filtered out
+ * @return BGPSTREAM_PARSEBGP_FILTER_OUT if the message should be skipped
+ * without being decoded, BGPSTREAM_PARSEBGP_KEEP if it should be decoded (and
+ * then passed to the check_filter callback)
+ *
+ * The buffer may hold only part of the message, in which case the callback
+ * should return BGPSTREAM_PARSEBGP_KEEP (and let the decoder refill it).
+ */
+typedef bgpstream_parsebgp_check_filter_rc_t(
+  bgpstream_parsebgp_peek_filter_cb_t)(bgpstream_format_t *format,
+                                       const uint8_t *buf, size_t len,
+                                       size_t *msg_len);
+
+/** Initialize the given decode state
+ *
+ * @param state         pointer to the decode state to initialize
+ * @param msg_type      outer message type to decode
+ * @param res           pointer to the resource the data is read from
+ * @return 0 if the state was initialized successfully, -1 otherwise
+ *
+ * The buffer is only allocated by the first read, at a size that depends on
+ * the type of the resource (large for RIB dumps, small for streams). It grows
+ * when a message does not fit, shrinks back once messages are small again,
+ * and is released while a stream has no data. It is counted in the memory
+ * accounting of the resource.
+ */
+int bgpstream_parsebgp_decode_state_init(
+  bgpstream_parsebgp_decode_state_t *state, parsebgp_msg_type_t msg_type,
+  bgpstream_resource_t *res);
+
+/** Find the length of a raw message from its header
+ *
+ * @param buf           pointer to the raw message
+ * @param len           number of bytes available in the buffer
+ * @return the total length of the message (including its header), or 0 if
+ * the buffer does not hold the whole header yet
+ */
+typedef size_t(bgpstream_parsebgp_msg_len_cb_t)(const uint8_t *buf,
+                                                size_t len);
+
+/** Decode messages using several worker threads
+ *
+ * @param state         pointer to an initialized decode state
+ * @param threads       number of threads to use (less than 2 to decode
+ *                      messages in the consumer, the default)
+ * @param msg_len_cb    callback used to split the data into messages
+ * @return 0 if the threads were started successfully, -1 otherwise
+ *
+ * The data is split into chunks of whole messages, which the workers decode
+ * while the consumer processes earlier messages. Messages are still returned
+ * in their original order, and the filter callback is called (by the
+ * consumer) in that order, so it may keep state across messages. The parser
+ * options must not be changed after this is called. Not supported with a
+ * prep_buf callback.
+ */
+int bgpstream_parsebgp_decode_state_set_threads(
+  bgpstream_parsebgp_decode_state_t *state, int threads,
+  bgpstream_parsebgp_msg_len_cb_t *msg_len_cb);
+
+/** Decode messages directly from the memory of the transport, if it can
+ * expose its content (e.g., a mapped local file)
+ *
+ * @param state         pointer to an initialized decode state
+ * @param transport     pointer to the transport the data is read from
+ * @return 1 if messages will be decoded from the transport memory, 0 if they
+ * will be read (copied) into the buffer as usual
+ *
+ * Must be called before the first message is read. Messages are then never
+ * copied, by either the sequential or the parallel decoder.
+ */
+int bgpstream_parsebgp_decode_state_map(
+  bgpstream_parsebgp_decode_state_t *state, bgpstream_transport_t *transport);
+
+/** Free the buffer (and stop the threads) owned by the given decode state
+ *
+ * @param state         pointer to the decode state to destroy
+ */
+void bgpstream_parsebgp_decode_state_destroy(
+  bgpstream_parsebgp_decode_state_t *state);
+
+/** Use libparsebgp to decode a message
+ *
+ * When decoding in parallel, the message pointed to by msgp is swapped for one
+ * that a worker has decoded (and ownership of the old one passes to the decode
+ * state).
+ */
 bgpstream_format_status_t bgpstream_parsebgp_populate_record(
-  bgpstream_parsebgp_decode_state_t *state, parsebgp_msg_t *msg,
+  bgpstream_parsebgp_decode_state_t *state, parsebgp_msg_t **msgp,
   bgpstream_format_t *format, bgpstream_record_t *record,
   bgpstream_parsebgp_prep_buf_cb_t *prep_cb,
+  bgpstream_parsebgp_peek_filter_cb_t *peek_cb,
   bgpstream_parsebgp_check_filter_cb_t *filter_cb);
 
 /** Set options specific to how we use libparsebgp in BGPStream */
 void bgpstream_parsebgp_opts_init(parsebgp_opts_t *opts);
 
+/** Stop libparsebgp from decoding path attributes that nothing will use
+ *
+ * @param opts          pointer to the options set up by
+ *                      bgpstream_parsebgp_opts_init
+ * @param filter_mgr    pointer to the filter manager
+ *
+ * The path attributes behind the elem fields that were declared unused are
+ * skipped, unless one of the active filters needs them.
+ */
+void bgpstream_parsebgp_opts_prune(parsebgp_opts_t *opts,
+                                   bgpstream_filter_mgr_t *filter_mgr);
+
 #endif /* __BGPSTREAM_PARSEBGP_COMMON_H */
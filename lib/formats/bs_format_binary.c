@@ -0,0 +1,693 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bs_format_binary.h"
+#include "bgpstream_binary.h"
+#include "bgpstream_format_interface.h"
+#include "bgpstream_record_int.h"
+#include "bgpstream_log.h"
+#include "utils.h"
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STATE ((state_t *)(format->state))
+
+#define RDATA ((rec_data_t *)(record->__int->data))
+
+#define TIF filter_mgr->time_interval
+
+// initial size of the read buffer (grown to fit the largest frame)
+#define BINARY_BUFLEN (1024 * 1024)
+
+// frames larger than this are treated as corrupt
+#define BINARY_MAX_FRAME_LEN (64 * 1024 * 1024)
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_BYTE_ORDER 2
+#else
+#define HOST_BYTE_ORDER 1
+#endif
+
+typedef struct rec_data {
+
+  // reusable elem instance
+  bgpstream_elem_t *elem;
+
+  // copy of the record frame, which the elem AS paths and communities point
+  // into
+  uint8_t *frame;
+  size_t frame_len;
+  size_t frame_alloc;
+
+  // offset of the next elem in the frame, and the number of elems left
+  size_t elem_off;
+  uint32_t elem_remain;
+
+  // aligned copy of the communities of the current elem, for streams (before
+  // version 3) that do not align them within the frame
+  bgpstream_community_t *comms;
+  int comms_alloc;
+
+} rec_data_t;
+
+typedef struct state {
+
+  // read buffer. unread data is between start and end
+  uint8_t *buf;
+  size_t buf_alloc;
+  size_t start;
+  size_t end;
+
+  // has a valid stream header been read
+  int started;
+
+  // version of the current stream
+  uint8_t version;
+
+  // interned strings, indexed by ID (0 is always the empty string)
+  char (*strings)[BGPSTREAM_UTILS_STR_NAME_LEN];
+  int strings_cnt;
+
+  // name IDs of the interned strings (see bgpstream_record_intern_name)
+  bgpstream_name_id_t *string_ids;
+
+  // the total number of successful (filtered and not) reads
+  uint64_t successful_read_cnt;
+
+  // the number of non-filtered reads (i.e. "useful")
+  uint64_t valid_read_cnt;
+
+} state_t;
+
+// bounds-checked reads from a frame
+typedef struct cursor {
+  const uint8_t *ptr;
+  size_t remain;
+} cursor_t;
+
+static int get_bytes(cursor_t *cur, void *dst, size_t len)
+{
+  if (cur->remain < len) {
+    return -1;
+  }
+  memcpy(dst, cur->ptr, len);
+  cur->ptr += len;
+  cur->remain -= len;
+  return 0;
+}
+
+#define GET(cur, val) get_bytes((cur), &(val), sizeof(val))
+
+static int get_addr(cursor_t *cur, bgpstream_ip_addr_t *addr)
+{
+  uint8_t version;
+
+  if (GET(cur, version) != 0) {
+    return -1;
+  }
+  switch (version) {
+  case 0:
+    addr->version = BGPSTREAM_ADDR_VERSION_UNKNOWN;
+    return 0;
+
+  case 4:
+    if (cur->remain < 4) {
+      return -1;
+    }
+    bgpstream_ipv4_addr_init(addr, cur->ptr);
+    cur->ptr += 4;
+    cur->remain -= 4;
+    return 0;
+
+  case 6:
+    if (cur->remain < 16) {
+      return -1;
+    }
+    bgpstream_ipv6_addr_init(addr, cur->ptr);
+    cur->ptr += 16;
+    cur->remain -= 16;
+    return 0;
+
+  default:
+    return -1;
+  }
+}
+
+static int get_string(bgpstream_format_t *format, cursor_t *cur, char *dst,
+                      bgpstream_name_id_t *name_id)
+{
+  uint16_t id;
+
+  if (GET(cur, id) != 0 || id >= STATE->strings_cnt) {
+    return -1;
+  }
+  memcpy(dst, STATE->strings[id], BGPSTREAM_UTILS_STR_NAME_LEN);
+  *name_id = STATE->string_ids[id];
+  return 0;
+}
+
+// reads the next frame into the buffer. the frame is valid until the next
+// call. returns 1 if a frame was read, 0 at the end of the data (which, for a
+// stream, may only be for now), and -1 on error
+static int read_frame(bgpstream_format_t *format, const uint8_t **frame,
+                      uint32_t *frame_len)
+{
+  size_t avail, need = BGPSTREAM_BINARY_FRAME_HDR_LEN;
+  uint8_t *tmp;
+  int64_t rc;
+
+  while (1) {
+    avail = STATE->end - STATE->start;
+    if (avail >= BGPSTREAM_BINARY_FRAME_HDR_LEN) {
+      memcpy(frame_len, STATE->buf + STATE->start, sizeof(*frame_len));
+      if (*frame_len < BGPSTREAM_BINARY_FRAME_HDR_LEN ||
+          *frame_len > BINARY_MAX_FRAME_LEN) {
+        bgpstream_log(BGPSTREAM_LOG_ERR,
+                      "Invalid binary frame length %" PRIu32, *frame_len);
+        return -1;
+      }
+      need = *frame_len;
+      if (avail >= need) {
+        *frame = STATE->buf + STATE->start;
+        STATE->start += need;
+        return 1;
+      }
+    }
+
+    // move the partial frame to the front to make room for more data
+    if (STATE->start != 0) {
+      memmove(STATE->buf, STATE->buf + STATE->start, avail);
+      STATE->start = 0;
+      STATE->end = avail;
+    }
+    if (need > STATE->buf_alloc) {
+      if ((tmp = realloc(STATE->buf, need)) == NULL) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Could not grow binary read buffer");
+        return -1;
+      }
+      STATE->buf = tmp;
+      STATE->buf_alloc = need;
+    }
+
+    if ((rc = bgpstream_transport_read(format->transport,
+                                       STATE->buf + STATE->end,
+                                       STATE->buf_alloc - STATE->end)) < 0) {
+      return -1;
+    }
+    if (rc == 0) {
+      return 0;
+    }
+    STATE->end += rc;
+  }
+}
+
+static int handle_header(bgpstream_format_t *format, cursor_t *cur)
+{
+  char magic[4];
+  uint8_t version, byte_order;
+
+  if (GET(cur, magic) != 0 || GET(cur, version) != 0 ||
+      GET(cur, byte_order) != 0 ||
+      memcmp(magic, BGPSTREAM_BINARY_MAGIC, sizeof(magic)) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid binary stream header in %s",
+                  format->res->url);
+    return -1;
+  }
+  if (version > BGPSTREAM_BINARY_VERSION) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Unsupported binary stream version %d in %s", version,
+                  format->res->url);
+    return -1;
+  }
+  if (byte_order != HOST_BYTE_ORDER) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Binary stream %s was written with another byte order",
+                  format->res->url);
+    return -1;
+  }
+
+  // strings from a previous stream are no longer valid
+  STATE->strings_cnt = 1;
+  STATE->started = 1;
+  STATE->version = version;
+  return 0;
+}
+
+static int handle_string(bgpstream_format_t *format, cursor_t *cur)
+{
+  uint16_t id;
+  uint8_t len;
+  void *tmp;
+
+  if (GET(cur, id) != 0 || id == 0 || GET(cur, len) != 0 ||
+      cur->remain < len) {
+    return -1;
+  }
+
+  if (id >= STATE->strings_cnt) {
+    if ((tmp = realloc(STATE->strings, (size_t)(id + 1) *
+                                        BGPSTREAM_UTILS_STR_NAME_LEN)) ==
+        NULL) {
+      return -1;
+    }
+    STATE->strings = tmp;
+    if ((tmp = realloc(STATE->string_ids,
+                       (size_t)(id + 1) * sizeof(bgpstream_name_id_t))) ==
+        NULL) {
+      return -1;
+    }
+    STATE->string_ids = tmp;
+    // IDs are defined in order, but be safe if some were skipped
+    memset(STATE->strings[STATE->strings_cnt], 0,
+           (size_t)(id + 1 - STATE->strings_cnt) *
+             BGPSTREAM_UTILS_STR_NAME_LEN);
+    memset(&STATE->string_ids[STATE->strings_cnt], 0,
+           (size_t)(id + 1 - STATE->strings_cnt) *
+             sizeof(bgpstream_name_id_t));
+    STATE->strings_cnt = id + 1;
+  }
+  memcpy(STATE->strings[id], cur->ptr, len);
+  STATE->strings[id][len] = '\0';
+  // strings are defined once per stream, so this is where they are interned
+  return bgpstream_record_intern_name(STATE->strings[id],
+                                      &STATE->string_ids[id]);
+}
+
+// fills the record fields from the start of a record frame, leaving the
+// cursor at the first elem
+static int handle_record(bgpstream_format_t *format, bgpstream_record_t *record,
+                         cursor_t *cur, uint32_t *elem_cnt)
+{
+  uint8_t type, status, dump_pos;
+
+  if (GET(cur, record->time_sec) != 0 || GET(cur, record->time_usec) != 0 ||
+      GET(cur, record->dump_time_sec) != 0 || GET(cur, type) != 0 ||
+      GET(cur, status) != 0 || GET(cur, dump_pos) != 0 ||
+      get_string(format, cur, record->project_name, &record->project_id) !=
+        0 ||
+      get_string(format, cur, record->collector_name,
+                 &record->collector_id) != 0 ||
+      get_string(format, cur, record->router_name, &record->router_id) != 0 ||
+      get_addr(cur, &record->router_ip) != 0 || GET(cur, *elem_cnt) != 0 ||
+      type >= _BGPSTREAM_RECORD_TYPE_CNT) {
+    return -1;
+  }
+  record->type = type;
+
+  // the position in the original dump is not meaningful in this one, so the
+  // position is found as for any other dump
+  return 0;
+}
+
+static int check_filters(bgpstream_record_t *record,
+                         bgpstream_filter_mgr_t *filter_mgr)
+{
+  // Project
+  if (filter_mgr->projects != NULL &&
+      bgpstream_str_set_exists(filter_mgr->projects, record->project_name) ==
+        0) {
+    return 0;
+  }
+
+  // Collector
+  if (filter_mgr->collectors != NULL &&
+      bgpstream_str_set_exists(filter_mgr->collectors,
+                               record->collector_name) == 0) {
+    return 0;
+  }
+
+  // Router
+  if (filter_mgr->routers != NULL &&
+      bgpstream_str_set_exists(filter_mgr->routers, record->router_name) ==
+        0) {
+    return 0;
+  }
+
+  // Time window
+  if (TIF != NULL &&
+      (record->time_sec < TIF->begin_time ||
+       (TIF->end_time != BGPSTREAM_FOREVER &&
+        record->time_sec > TIF->end_time))) {
+    return 0;
+  }
+
+  return 1;
+}
+
+static bgpstream_format_status_t handle_eof(bgpstream_format_t *format,
+                                            bgpstream_record_t *record,
+                                            uint64_t skipped_cnt)
+{
+  // just to be kind, set the record time to the dump time
+  record->time_sec = record->dump_time_sec;
+
+  if (skipped_cnt == 0) {
+    // signal that the previous record really was the last in the dump
+    record->dump_pos = BGPSTREAM_DUMP_END;
+  }
+  if (STATE->successful_read_cnt == 0) {
+    record->status = BGPSTREAM_RECORD_STATUS_EMPTY_SOURCE;
+    record->dump_pos = BGPSTREAM_DUMP_END;
+    return BGPSTREAM_FORMAT_EMPTY_DUMP;
+  }
+  if (STATE->valid_read_cnt == 0) {
+    record->status = BGPSTREAM_RECORD_STATUS_FILTERED_SOURCE;
+    record->dump_pos = BGPSTREAM_DUMP_END;
+    return BGPSTREAM_FORMAT_FILTERED_DUMP;
+  }
+  return BGPSTREAM_FORMAT_END_OF_DUMP;
+}
+
+/* ==================== PUBLIC API BELOW HERE ==================== */
+
+int bs_format_binary_create(bgpstream_format_t *format,
+                            bgpstream_resource_t *res)
+{
+  BS_FORMAT_SET_METHODS(binary, format);
+
+  if ((format->state = malloc_zero(sizeof(state_t))) == NULL) {
+    return -1;
+  }
+
+  if ((STATE->buf = malloc(BINARY_BUFLEN)) == NULL ||
+      (STATE->strings = malloc_zero(BGPSTREAM_UTILS_STR_NAME_LEN)) == NULL ||
+      (STATE->string_ids = malloc_zero(sizeof(bgpstream_name_id_t))) ==
+        NULL) {
+    bs_format_binary_destroy(format);
+    return -1;
+  }
+  STATE->buf_alloc = BINARY_BUFLEN;
+  STATE->strings_cnt = 1;
+
+  return 0;
+}
+
+bgpstream_format_status_t
+bs_format_binary_populate_record(bgpstream_format_t *format,
+                                 bgpstream_record_t *record)
+{
+  const uint8_t *frame;
+  uint32_t frame_len, elem_cnt;
+  uint64_t skipped_cnt = 0;
+  uint8_t *tmp;
+  cursor_t cur;
+  int rc;
+
+  record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_SOURCE;
+
+  while ((rc = read_frame(format, &frame, &frame_len)) > 0) {
+    cur.ptr = frame + BGPSTREAM_BINARY_FRAME_HDR_LEN;
+    cur.remain = frame_len - BGPSTREAM_BINARY_FRAME_HDR_LEN;
+
+    switch (frame[4]) {
+    case BGPSTREAM_BINARY_FRAME_HEADER:
+      if (handle_header(format, &cur) != 0) {
+        record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_RECORD;
+        return BGPSTREAM_FORMAT_CORRUPTED_DUMP;
+      }
+      continue;
+
+    case BGPSTREAM_BINARY_FRAME_STRING:
+      if (STATE->started == 0 || handle_string(format, &cur) != 0) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid binary string frame in %s",
+                      format->res->url);
+        record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_RECORD;
+        return BGPSTREAM_FORMAT_CORRUPTED_DUMP;
+      }
+      continue;
+
+    case BGPSTREAM_BINARY_FRAME_RECORD:
+      break;
+
+    default:
+      // a frame from a newer version that we can do without
+      continue;
+    }
+
+    if (STATE->started == 0 ||
+        handle_record(format, record, &cur, &elem_cnt) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_WARN, "Invalid binary record frame in %s",
+                    format->res->url);
+      record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_RECORD;
+      return BGPSTREAM_FORMAT_CORRUPTED_MSG;
+    }
+
+    STATE->successful_read_cnt++;
+    if (check_filters(record, format->filter_mgr) == 0) {
+      skipped_cnt++;
+      continue;
+    }
+    STATE->valid_read_cnt++;
+
+    // keep the frame with the record, so that its elems can point into it
+    if (frame_len > RDATA->frame_alloc) {
+      if ((tmp = realloc(RDATA->frame, frame_len)) == NULL) {
+        return BGPSTREAM_FORMAT_UNKNOWN_ERROR;
+      }
+      RDATA->frame = tmp;
+      RDATA->frame_alloc = frame_len;
+    }
+    memcpy(RDATA->frame, frame, frame_len);
+    RDATA->frame_len = frame_len;
+    RDATA->elem_off = cur.ptr - frame;
+    RDATA->elem_remain = elem_cnt;
+
+    record->status = BGPSTREAM_RECORD_STATUS_VALID_RECORD;
+    if (STATE->valid_read_cnt == 1 && STATE->successful_read_cnt == 1) {
+      record->dump_pos = BGPSTREAM_DUMP_START;
+    } else {
+      record->dump_pos = BGPSTREAM_DUMP_MIDDLE;
+    }
+    return BGPSTREAM_FORMAT_OK;
+  }
+
+  if (rc < 0) {
+    record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_RECORD;
+    return BGPSTREAM_FORMAT_CORRUPTED_DUMP;
+  }
+
+  // a partial frame at the end of a dump is left unread
+  if (STATE->end != STATE->start &&
+      format->res->duration != BGPSTREAM_FOREVER) {
+    record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_RECORD;
+    return BGPSTREAM_FORMAT_CORRUPTED_DUMP;
+  }
+
+  return handle_eof(format, record, skipped_cnt);
+}
+
+int bs_format_binary_get_next_elem(bgpstream_format_t *format,
+                                   bgpstream_record_t *record,
+                                   bgpstream_elem_t **elem)
+{
+  bgpstream_elem_t *el;
+  cursor_t cur;
+  uint8_t type, old_state, new_state, flags, origin;
+  uint16_t path_len, comm_cnt, large_cnt = 0;
+  uint8_t *path;
+  bgpstream_community_t *comms;
+  bgpstream_large_community_t *large;
+
+  *elem = NULL;
+
+  if (RDATA == NULL || RDATA->elem_remain == 0) {
+    // end-of-elems
+    return 0;
+  }
+
+  el = RDATA->elem;
+  bgpstream_elem_clear(el);
+  cur.ptr = RDATA->frame + RDATA->elem_off;
+  cur.remain = RDATA->frame_len - RDATA->elem_off;
+
+  if (GET(&cur, type) != 0 || GET(&cur, el->orig_time_sec) != 0 ||
+      GET(&cur, el->orig_time_usec) != 0 || get_addr(&cur, &el->peer_ip) != 0 ||
+      GET(&cur, el->peer_asn) != 0 || GET(&cur, el->prefix.mask_len) != 0 ||
+      get_addr(&cur, &el->prefix.address) != 0 ||
+      get_addr(&cur, &el->nexthop) != 0 || GET(&cur, path_len) != 0 ||
+      cur.remain < path_len) {
+    goto err;
+  }
+  el->type = type;
+
+  // the AS path and communities are used in place
+  path = (uint8_t *)cur.ptr;
+  cur.ptr += path_len;
+  cur.remain -= path_len;
+  if (bgpstream_as_path_populate_from_data_zc(el->as_path, path, path_len) !=
+      0) {
+    goto err;
+  }
+
+  if (GET(&cur, comm_cnt) != 0) {
+    goto err;
+  }
+  // which are aligned within the frame (and so within our copy of it)
+  if (STATE->version >= 3 && comm_cnt > 0) {
+    while (((cur.ptr - RDATA->frame) & 3) != 0 && cur.remain > 0) {
+      cur.ptr++;
+      cur.remain--;
+    }
+  }
+  if (cur.remain < comm_cnt * sizeof(bgpstream_community_t)) {
+    goto err;
+  }
+  if (((cur.ptr - RDATA->frame) & 3) == 0) {
+    comms = (bgpstream_community_t *)cur.ptr;
+  } else {
+    // (older streams) copied, rather than read at an unaligned address
+    if (comm_cnt > RDATA->comms_alloc) {
+      if ((comms = realloc(RDATA->comms,
+                           comm_cnt * sizeof(bgpstream_community_t))) == NULL) {
+        goto err;
+      }
+      RDATA->comms = comms;
+      RDATA->comms_alloc = comm_cnt;
+    }
+    comms = RDATA->comms;
+    memcpy(comms, cur.ptr, comm_cnt * sizeof(bgpstream_community_t));
+  }
+  cur.ptr += comm_cnt * sizeof(bgpstream_community_t);
+  cur.remain -= comm_cnt * sizeof(bgpstream_community_t);
+  if (bgpstream_community_set_populate_from_array_zc(el->communities, comms,
+                                                     comm_cnt) != 0) {
+    goto err;
+  }
+
+  // large communities are always aligned within the frame
+  if (STATE->version >= 2 && GET(&cur, large_cnt) != 0) {
+    goto err;
+  }
+  if (large_cnt > 0) {
+    while (((cur.ptr - RDATA->frame) & 3) != 0 && cur.remain > 0) {
+      cur.ptr++;
+      cur.remain--;
+    }
+    if (cur.remain < large_cnt * sizeof(bgpstream_large_community_t)) {
+      goto err;
+    }
+    large = (bgpstream_large_community_t *)cur.ptr;
+    cur.ptr += large_cnt * sizeof(bgpstream_large_community_t);
+    cur.remain -= large_cnt * sizeof(bgpstream_large_community_t);
+    if (bgpstream_community_set_populate_large_from_array_zc(
+          el->communities, large, large_cnt) != 0) {
+      goto err;
+    }
+  }
+
+  if (GET(&cur, old_state) != 0 || GET(&cur, new_state) != 0 ||
+      GET(&cur, flags) != 0 || GET(&cur, origin) != 0 ||
+      GET(&cur, el->med) != 0 || GET(&cur, el->local_pref) != 0 ||
+      GET(&cur, el->aggregator.aggregator_asn) != 0 ||
+      get_addr(&cur, &el->aggregator.aggregator_addr) != 0) {
+    goto err;
+  }
+  el->old_state = old_state;
+  el->new_state = new_state;
+  el->origin = origin;
+  el->has_origin = (flags & BGPSTREAM_BINARY_ELEM_HAS_ORIGIN) != 0;
+  el->has_med = (flags & BGPSTREAM_BINARY_ELEM_HAS_MED) != 0;
+  el->has_local_pref = (flags & BGPSTREAM_BINARY_ELEM_HAS_LOCAL_PREF) != 0;
+  el->atomic_aggregate = (flags & BGPSTREAM_BINARY_ELEM_ATOMIC_AGGREGATE) != 0;
+  el->aggregator.has_aggregator =
+    (flags & BGPSTREAM_BINARY_ELEM_HAS_AGGREGATOR) != 0;
+
+  RDATA->elem_off = cur.ptr - RDATA->frame;
+  RDATA->elem_remain--;
+
+  // return a borrowed pointer to the elem we populated
+  *elem = el;
+  return 1;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid binary elem in %s",
+                format->res->url);
+  RDATA->elem_remain = 0;
+  return -1;
+}
+
+int bs_format_binary_init_data(bgpstream_format_t *format, void **data)
+{
+  rec_data_t *rd;
+  *data = NULL;
+
+  if ((rd = malloc_zero(sizeof(rec_data_t))) == NULL) {
+    return -1;
+  }
+
+  if ((rd->elem = bgpstream_elem_create()) == NULL) {
+    free(rd);
+    return -1;
+  }
+
+  *data = rd;
+  return 0;
+}
+
+void bs_format_binary_clear_data(bgpstream_format_t *format, void *data)
+{
+  rec_data_t *rd = (rec_data_t *)data;
+  assert(rd != NULL);
+  bgpstream_elem_clear(rd->elem);
+  rd->frame_len = 0;
+  rd->elem_off = 0;
+  rd->elem_remain = 0;
+}
+
+void bs_format_binary_destroy_data(bgpstream_format_t *format, void *data)
+{
+  rec_data_t *rd = (rec_data_t *)data;
+  if (rd == NULL) {
+    return;
+  }
+  bgpstream_elem_destroy(rd->elem);
+  rd->elem = NULL;
+  free(rd->frame);
+  rd->frame = NULL;
+  free(rd->comms);
+  rd->comms = NULL;
+  free(data);
+}
+
+void bs_format_binary_destroy(bgpstream_format_t *format)
+{
+  if (format->state == NULL) {
+    return;
+  }
+
+  free(STATE->buf);
+  STATE->buf = NULL;
+
+  free(STATE->strings);
+  STATE->strings = NULL;
+  free(STATE->string_ids);
+  STATE->string_ids = NULL;
+
+  free(format->state);
+  format->state = NULL;
+}
@@ -38,6 +38,13 @@
 
 #define TIF filter_mgr->time_interval
 
+// number of routers whose OpenBMP header fields are remembered (a power of two)
+#define ROUTER_CACHE_SIZE 256
+
+// longest run of OpenBMP header fields, from the collector hash to the end of
+// the router name, that is remembered
+#define ROUTER_RAW_MAX 256
+
 typedef struct rec_data {
 
   // reusable elem instance
@@ -57,11 +64,52 @@ typedef struct rec_data {
 
 } rec_data_t;
 
+// OpenBMP header fields shared by all the BMP messages of one payload
+typedef struct payload {
+
+  // number of bytes of BMP data left in the payload (0 if not in a payload)
+  uint32_t remain;
+
+  // values parsed from the OpenBMP header
+  uint32_t time_sec;
+  uint32_t time_usec;
+  char collector_name[BGPSTREAM_UTILS_STR_NAME_LEN];
+  char router_name[BGPSTREAM_UTILS_STR_NAME_LEN];
+  bgpstream_ip_addr_t router_ip;
+  bgpstream_name_id_t collector_id;
+  bgpstream_name_id_t router_id;
+
+} payload_t;
+
+// collector and router fields of the OpenBMP headers of one router, as
+// decoded into a record
+typedef struct router_info {
+
+  // the header bytes that they were decoded from
+  uint8_t raw[ROUTER_RAW_MAX];
+  size_t raw_len;
+  int ipv6;
+
+  char collector_name[BGPSTREAM_UTILS_STR_NAME_LEN];
+  char router_name[BGPSTREAM_UTILS_STR_NAME_LEN];
+  bgpstream_ip_addr_t router_ip;
+  bgpstream_name_id_t collector_id;
+  bgpstream_name_id_t router_id;
+
+} router_info_t;
+
 typedef struct state {
 
   // parsebgp decode wrapper state
   bgpstream_parsebgp_decode_state_t decoder;
 
+  // the OpenBMP payload currently being decoded
+  payload_t payload;
+
+  // routers seen in OpenBMP headers, indexed by their router hash (allocated
+  // when first used)
+  router_info_t *routers[ROUTER_CACHE_SIZE];
+
 } state_t;
 
 static int handle_update(rec_data_t *rd, parsebgp_bgp_msg_t *bgp)
@@ -159,15 +207,171 @@ static int is_wanted_time(uint32_t record_time,
 #define IS_ROUTER_MSG (flags & 0x80)
 #define IS_ROUTER_IPV6 (flags & 0x40)
 
+// apply the OpenBMP header of the current payload to a record
+static void apply_payload(payload_t *pl, bgpstream_record_t *record)
+{
+  record->time_sec = pl->time_sec;
+  record->time_usec = pl->time_usec;
+  memcpy(record->collector_name, pl->collector_name,
+         sizeof(record->collector_name));
+  memcpy(record->router_name, pl->router_name, sizeof(record->router_name));
+  record->router_ip = pl->router_ip;
+  record->collector_id = pl->collector_id;
+  record->router_id = pl->router_id;
+}
+
+// remember the OpenBMP header just parsed into a record for the rest of the
+// BMP messages in its payload
+static void save_payload(payload_t *pl, bgpstream_record_t *record,
+                         uint32_t msg_len)
+{
+  pl->remain = msg_len;
+  pl->time_sec = record->time_sec;
+  pl->time_usec = record->time_usec;
+  memcpy(pl->collector_name, record->collector_name,
+         sizeof(pl->collector_name));
+  memcpy(pl->router_name, record->router_name, sizeof(pl->router_name));
+  pl->router_ip = record->router_ip;
+  pl->collector_id = record->collector_id;
+  pl->router_id = record->router_id;
+}
+
+// the length of the OpenBMP header fields from the collector hash to the end of
+// the router name, that buf starts with, or 0 if they are longer than len
+static size_t router_fields_len(const uint8_t *buf, size_t len)
+{
+  size_t off = 16;
+  uint16_t u16;
+
+  // collector hash, admin ID, router hash and router IP
+  if (len < off + sizeof(u16)) {
+    return 0;
+  }
+  memcpy(&u16, buf + off, sizeof(u16));
+  off += sizeof(u16) + ntohs(u16) + 16 + 16;
+
+  // router name
+  if (len < off + sizeof(u16)) {
+    return 0;
+  }
+  memcpy(&u16, buf + off, sizeof(u16));
+  off += sizeof(u16) + ntohs(u16);
+
+  return (len < off) ? 0 : off;
+}
+
+// copy a (possibly truncated) OpenBMP name field to name, returning the number
+// of bytes the field takes
+static size_t decode_name(const uint8_t *buf, char *name)
+{
+  uint16_t u16;
+  size_t name_len;
+
+  memcpy(&u16, buf, sizeof(u16));
+  u16 = ntohs(u16);
+  name_len = (u16 < BGPSTREAM_UTILS_STR_NAME_LEN)
+               ? u16
+               : BGPSTREAM_UTILS_STR_NAME_LEN - 1;
+  memcpy(name, buf + sizeof(u16), name_len);
+  name[name_len] = '\0';
+  return sizeof(u16) + u16;
+}
+
+// decode the OpenBMP header fields from the collector hash to the end of the
+// router name (see router_fields_len) into the record, except for the name IDs
+static void decode_router(const uint8_t *buf, int ipv6,
+                          bgpstream_record_t *record)
+{
+  // skip past the collector hash
+  buf += 16;
+
+  // grab the collector admin ID as collector name
+  // TODO: if there is no admin ID, use the hash
+  buf += decode_name(buf, record->collector_name);
+
+  // skip past the router hash
+  buf += 16;
+
+  // grab the router IP
+  if (ipv6) {
+    bgpstream_ipv6_addr_init(&record->router_ip, buf);
+  } else {
+    bgpstream_ipv4_addr_init(&record->router_ip, buf);
+  }
+  buf += 16;
+
+  // router name
+  // TODO: if there is no name, or it is "default", use the IP
+  decode_name(buf, record->router_name);
+}
+
+// the cache slot of the router whose OpenBMP header fields buf starts with
+static router_info_t **router_slot(bgpstream_format_t *format,
+                                   const uint8_t *buf)
+{
+  uint16_t u16;
+  uint32_t hash;
+
+  // the router hash (an MD5 digest) follows the admin ID
+  memcpy(&u16, buf + 16, sizeof(u16));
+  memcpy(&hash, buf + 16 + sizeof(u16) + ntohs(u16), sizeof(hash));
+  return &STATE->routers[hash & (ROUTER_CACHE_SIZE - 1)];
+}
+
+// fill the record with the fields decoded from the last OpenBMP header of the
+// same router, if the given header fields are the same. returns 0 if they are,
+// -1 if they must be decoded
+static int apply_router(bgpstream_format_t *format, const uint8_t *buf,
+                        size_t fields_len, int ipv6,
+                        bgpstream_record_t *record)
+{
+  router_info_t *ri = *router_slot(format, buf);
+
+  if (ri == NULL || ri->raw_len != fields_len || ri->ipv6 != ipv6 ||
+      memcmp(ri->raw, buf, fields_len) != 0) {
+    return -1;
+  }
+  memcpy(record->collector_name, ri->collector_name,
+         sizeof(record->collector_name));
+  memcpy(record->router_name, ri->router_name, sizeof(record->router_name));
+  record->router_ip = ri->router_ip;
+  record->collector_id = ri->collector_id;
+  record->router_id = ri->router_id;
+  return 0;
+}
+
+// remember the fields just decoded into the record for the next OpenBMP
+// headers of the same router
+static void save_router(bgpstream_format_t *format, const uint8_t *buf,
+                        size_t fields_len, int ipv6,
+                        bgpstream_record_t *record)
+{
+  router_info_t **slot = router_slot(format, buf), *ri;
+
+  if (fields_len > ROUTER_RAW_MAX ||
+      (*slot == NULL && (*slot = malloc(sizeof(router_info_t))) == NULL)) {
+    // (it will just be decoded again)
+    return;
+  }
+  ri = *slot;
+  memcpy(ri->raw, buf, fields_len);
+  ri->raw_len = fields_len;
+  ri->ipv6 = ipv6;
+  memcpy(ri->collector_name, record->collector_name,
+         sizeof(ri->collector_name));
+  memcpy(ri->router_name, record->router_name, sizeof(ri->router_name));
+  ri->router_ip = record->router_ip;
+  ri->collector_id = record->collector_id;
+  ri->router_id = record->router_id;
+}
+
 static int populate_prep_cb(bgpstream_format_t *format, uint8_t *buf,
                             size_t *lenp, bgpstream_record_t *record)
 {
-  size_t len = *lenp, nread = 0;
+  size_t len = *lenp, nread = 0, fields_len;
   int newln = 0;
   uint8_t ver_maj, ver_min, flags, u8;
-  uint16_t u16;
-  uint32_t u32;
-  int name_len = 0;
+  uint32_t u32, msg_len;
 
   // we want at least a few bytes to do header checks
   if (len < 4) {
@@ -175,6 +379,16 @@ static int populate_prep_cb(bgpstream_format_t *format, uint8_t *buf,
     return 0;
   }
 
+  // OpenBMP payloads often carry many BMP messages, but only the first one is
+  // preceded by the header, so the rest reuse what we parsed from it
+  if (STATE->payload.remain != 0 && *buf != 'V' &&
+      memcmp(buf, "OBMP", 4) != 0) {
+    apply_payload(&STATE->payload, record);
+    *lenp = 0;
+    return 0;
+  }
+  STATE->payload.remain = 0;
+
   // is this an OpenBMP ASCII header (either "text" or "legacy-text")?
   if (*buf == 'V') {
     // skip until we find double-newlines
@@ -216,10 +430,12 @@ static int populate_prep_cb(bgpstream_format_t *format, uint8_t *buf,
     return 0;
   }
 
-  // skip past the header length and the message length (since we'll parse the
-  // entire header anyway).
-  nread += 2 + 4;
-  buf += 2 + 4;
+  // skip past the header length (since we'll parse the entire header anyway),
+  // but keep the message length to know where the payload ends
+  nread += 2;
+  buf += 2;
+  DESERIALIZE_VAL(msg_len);
+  msg_len = ntohl(msg_len);
 
   // read the flags
   DESERIALIZE_VAL(flags);
@@ -242,70 +458,32 @@ static int populate_prep_cb(bgpstream_format_t *format, uint8_t *buf,
   DESERIALIZE_VAL(u32);
   record->time_usec = ntohl(u32);
 
-  // skip past the collector hash
-  nread += 16;
-  buf += 16;
-
-  // grab the collector admin ID as collector name
-  // TODO: if there is no admin ID, use the hash
-  DESERIALIZE_VAL(u16);
-  u16 = ntohs(u16);
-  // maybe truncate the collector name
-  if (u16 < BGPSTREAM_UTILS_STR_NAME_LEN) {
-    name_len = u16;
-  } else {
-    name_len = BGPSTREAM_UTILS_STR_NAME_LEN - 1;
-  }
-  // copy the collector name in
-  if ((len - nread) < u16) {
-    return -1;
-  }
-  memcpy(record->collector_name, buf, name_len);
-  record->collector_name[name_len] = '\0';
-  nread += u16;
-  buf += u16;
-
-  if ((len - nread) < 32) {
-    // not enough buffer left for router hash and IP
+  // every header of a router repeats the same collector and router fields,
+  // so they are only decoded (and their names interned) when they differ from
+  // the previous header of that router
+  if ((fields_len = router_fields_len(buf, len - nread)) == 0) {
     return -1;
   }
-
-  // skip past the router hash
-  nread += 16;
-  buf += 16;
-
-  // grab the router IP
-  if (IS_ROUTER_IPV6) {
-    bgpstream_ipv6_addr_init(&record->router_ip, buf);
-  } else {
-    bgpstream_ipv4_addr_init(&record->router_ip, buf);
-  }
-  nread += 16;
-  buf += 16;
-
-  // router name
-  // TODO: if there is no name, or it is "default", use the IP
-  DESERIALIZE_VAL(u16);
-  u16 = ntohs(u16);
-  // maybe truncate the router name
-  if (u16 < BGPSTREAM_UTILS_STR_NAME_LEN) {
-    name_len = u16;
-  } else {
-    name_len = BGPSTREAM_UTILS_STR_NAME_LEN - 1;
-  }
-  // copy the router name in
-  if ((len - nread) < u16) {
-    return -1;
+  if (apply_router(format, buf, fields_len, IS_ROUTER_IPV6 != 0, record) !=
+      0) {
+    decode_router(buf, IS_ROUTER_IPV6 != 0, record);
+    if (bgpstream_record_intern_name(record->collector_name,
+                                     &record->collector_id) != 0 ||
+        bgpstream_record_intern_name(record->router_name,
+                                     &record->router_id) != 0) {
+      return -1;
+    }
+    save_router(format, buf, fields_len, IS_ROUTER_IPV6 != 0, record);
   }
-  memcpy(record->router_name, buf, name_len);
-  record->router_name[name_len] = '\0';
-  nread += u16;
-  buf += u16;
+  nread += fields_len;
+  buf += fields_len;
 
   // and then ignore the row count
   nread += 4;
   buf += 4;
 
+  save_payload(&STATE->payload, record, msg_len);
+
   *lenp = nread;
   return 0;
 }
@@ -318,6 +496,14 @@ populate_filter_cb(bgpstream_format_t *format, bgpstream_record_t *record,
   uint32_t ts_sec = record->time_sec;
   assert(msg->type == PARSEBGP_MSG_TYPE_BMP);
 
+  // account for this message in the current payload (pre-v3 BMP messages
+  // carry no length, so we cannot tell where the payload ends)
+  if (bmp->len == 0 || bmp->len >= STATE->payload.remain) {
+    STATE->payload.remain = 0;
+  } else {
+    STATE->payload.remain -= bmp->len;
+  }
+
   // for now we only care about ROUTE_MON, PEER_DOWN, and PEER_UP messages
   if (bmp->type != PARSEBGP_BMP_TYPE_ROUTE_MON &&
       bmp->type != PARSEBGP_BMP_TYPE_PEER_DOWN &&
@@ -366,11 +552,20 @@ int bs_format_bmp_create(bgpstream_format_t *format, bgpstream_resource_t *res)
     return -1;
   }
 
-  STATE->decoder.msg_type = PARSEBGP_MSG_TYPE_BMP;
+  if (bgpstream_parsebgp_decode_state_init(&STATE->decoder,
+                                           PARSEBGP_MSG_TYPE_BMP, res) != 0) {
+    free(format->state);
+    format->state = NULL;
+    return -1;
+  }
 
   opts = &STATE->decoder.parser_opts;
   parsebgp_opts_init(opts);
   bgpstream_parsebgp_opts_init(opts);
+  bgpstream_parsebgp_opts_prune(opts, format->filter_mgr);
+
+  // local uncompressed files are decoded without copying them
+  bgpstream_parsebgp_decode_state_map(&STATE->decoder, format->transport);
 
   // DEBUG: force parsebgp to ignore things that it doesn't know about
   opts->ignore_not_implemented = 1;
@@ -385,11 +580,18 @@ bs_format_bmp_populate_record(bgpstream_format_t *format,
                               bgpstream_record_t *record)
 {
   bgpstream_format_status_t rc = bgpstream_parsebgp_populate_record(
-    &STATE->decoder, RDATA->msg, format, record, populate_prep_cb,
+    &STATE->decoder, &RDATA->msg, format, record, populate_prep_cb, NULL,
     populate_filter_cb);
 
+  // we cannot tell how long a corrupted message was, so the rest of its
+  // payload is decoded without the header
+  if (rc == BGPSTREAM_FORMAT_CORRUPTED_MSG) {
+    STATE->payload.remain = 0;
+  }
+
   if (record->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
     record->router_name[0] = '\0';
+    record->router_id = 0;
     record->router_ip.version = 0;
   }
 
@@ -411,6 +613,14 @@ int bs_format_bmp_get_next_elem(bgpstream_format_t *format,
 
   bmp = RDATA->msg->types.bmp;
 
+  // skip route monitoring messages none of whose elems can pass the filters
+  if (bmp->type == PARSEBGP_BMP_TYPE_ROUTE_MON && RDATA->peer_hdr_done == 0 &&
+      bgpstream_parsebgp_update_wanted(format->filter_mgr, bmp->peer_hdr.asn,
+                                       bmp->types.route_mon) == 0) {
+    RDATA->end_of_elems = 1;
+    return 0;
+  }
+
   // assume we'll find at least something juicy, so process the peer header and
   // fill the common parts of the elem
   if (RDATA->peer_hdr_done == 0 && handle_peer_hdr(RDATA->elem, bmp) != 0) {
@@ -492,6 +702,14 @@ void bs_format_bmp_destroy_data(bgpstream_format_t *format, void *data)
 
 void bs_format_bmp_destroy(bgpstream_format_t *format)
 {
+  int i;
+
+  bgpstream_parsebgp_decode_state_destroy(&STATE->decoder);
+
+  for (i = 0; i < ROUTER_CACHE_SIZE; i++) {
+    free(STATE->routers[i]);
+  }
+
   free(format->state);
   format->state = NULL;
 }
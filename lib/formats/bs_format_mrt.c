@@ -30,7 +30,9 @@
 #include "bgpstream_log.h"
 #include "bgpstream_parsebgp_common.h"
 #include "utils.h"
+#include <arpa/inet.h>
 #include <assert.h>
+#include <string.h>
 
 #define STATE ((state_t *)(format->state))
 
@@ -38,6 +40,10 @@
 
 #define TIF filter_mgr->time_interval
 
+// length of the MRT common header (timestamp, type, subtype, length). the
+// length field does not include the header itself
+#define MRT_HDR_LEN 12
+
 typedef struct peer_index_entry {
 
   /** Peer ASN */
@@ -51,8 +57,21 @@ typedef struct peer_index_entry {
 KHASH_INIT(td2_peer, int, peer_index_entry_t, 1, kh_int_hash_func,
            kh_int_hash_equal)
 
+struct rec_data;
+struct state;
+
+// decodes the next elem of a message whose type and subtype have been looked
+// at by select_decoder. returns 1 if an elem was decoded, 0 if there are no
+// more, -1 if an error occurred
+typedef int(elem_decoder_t)(struct rec_data *rd, struct state *state,
+                            parsebgp_mrt_msg_t *mrt,
+                            bgpstream_filter_mgr_t *filter_mgr);
+
 typedef struct rec_data {
 
+  // decoder of the elems of the current message (NULL until its first elem)
+  elem_decoder_t *decode;
+
   // reusable elem instance
   bgpstream_elem_t *elem;
 
@@ -62,6 +81,9 @@ typedef struct rec_data {
   // index of the NEXT rib entry to read from a TDv2 message
   int next_re;
 
+  // AS paths and communities shared by the rib entries of a TDv2 message
+  bgpstream_parsebgp_attr_cache_t *attr_cache;
+
   // state for UPDATE elem extraction
   bgpstream_parsebgp_upd_state_t upd_state;
 
@@ -78,8 +100,16 @@ typedef struct state {
   // state to store the "peer index table" when reading TABLE_DUMP_V2 records
   khash_t(td2_peer) * peer_table;
 
+  // raw copy of the peer index table (only kept for raw records), shared with
+  // the RIB records that follow it, so that a later table does not change
+  // what the records still in flight refer to
+  bgpstream_record_raw_prefix_t *peer_index_raw;
+
 } state_t;
 
+// source of raw peer index table IDs (shared by all MRT formats)
+static uint64_t peer_index_next_id = 0;
+
 static int handle_table_dump(rec_data_t *rd, parsebgp_mrt_msg_t *mrt)
 {
   bgpstream_elem_t *el = rd->elem;
@@ -113,9 +143,12 @@ static int handle_table_dump(rec_data_t *rd, parsebgp_mrt_msg_t *mrt)
   return 1;
 }
 
+// returns 1 if the elem was filled in, 0 if the entry is skipped since its
+// peer is filtered out, and -1 if an error occurred
 static int handle_td2_rib_entry(rec_data_t *rd, khash_t(td2_peer) * peer_table,
                                 parsebgp_mrt_msg_t *mrt, parsebgp_bgp_afi_t afi,
-                                parsebgp_mrt_table_dump_v2_rib_entry_t *re)
+                                parsebgp_mrt_table_dump_v2_rib_entry_t *re,
+                                bgpstream_filter_mgr_t *filter_mgr)
 {
   peer_index_entry_t *bs_pie;
   khiter_t k;
@@ -136,101 +169,87 @@ static int handle_td2_rib_entry(rec_data_t *rd, khash_t(td2_peer) * peer_table,
 
   rd->elem->peer_asn = bs_pie->peer_asn;
 
-  if (bgpstream_parsebgp_process_next_hop(
-        rd->elem, re->path_attrs.attrs, afi == PARSEBGP_BGP_AFI_IPV6 ? 1 : 0) !=
-      0) {
-    return -1;
+  // the peer is all we need to know to skip the entry
+  if (bgpstream_filter_mgr_peer_wanted(filter_mgr, bs_pie->peer_asn) == 0) {
+    return 0;
   }
 
-  if (bgpstream_parsebgp_process_path_attrs(rd->elem, re->path_attrs.attrs) !=
+  if (bgpstream_parsebgp_process_next_hop(
+        rd->elem, re->path_attrs.attrs, afi == PARSEBGP_BGP_AFI_IPV6 ? 1 : 0) !=
       0) {
     return -1;
   }
 
-  return 0;
-}
-
-static int
-handle_td2_afi_safi_rib(rec_data_t *rd, khash_t(td2_peer) * peer_table,
-                        parsebgp_mrt_msg_t *mrt, parsebgp_bgp_afi_t afi,
-                        parsebgp_mrt_table_dump_v2_afi_safi_rib_t *asr)
-{
-  // if this is the first time we've been called, prep the elem
-  if (rd->next_re == 0) {
-    rd->elem->type = BGPSTREAM_ELEM_TYPE_RIB;
-    COPY_IP(&rd->elem->prefix.address, afi, asr->prefix, return 0);
-    rd->elem->prefix.mask_len = asr->prefix_len;
-    // other elem fields are specific to the entry
-
-    // if we haven't seen a peer index table yet, then just give up
-    if (peer_table == NULL) {
-      bgpstream_log(BGPSTREAM_LOG_WARN,
-                    "Missing Peer Index Table, skipping RIB entry");
+  // the entry stays in rd->msg until the next elem, so the AS path and
+  // communities can be decoded only if they are asked for
+  if (filter_mgr->lazy_elems) {
+    bgpstream_parsebgp_attr_cache_release(rd->attr_cache, rd->elem);
+    if (bgpstream_parsebgp_process_path_attrs_lazy(rd->elem,
+                                                   re->path_attrs.attrs) != 0) {
       return -1;
     }
+    return 1;
   }
 
-  // since this is a generator, we just process one rib entry each time
-  if (handle_td2_rib_entry(rd, peer_table, mrt, afi,
-                           &asr->entries[rd->next_re]) != 0) {
+  // many peers often share the same attributes, so only decode them once
+  if (bgpstream_parsebgp_process_path_attrs_cached(
+        rd->elem, re->path_attrs.attrs, rd->attr_cache) != 0) {
     return -1;
   }
 
-  // move on to the next rib entry
-  rd->next_re++;
-  if (rd->next_re == asr->entry_count) {
-    rd->end_of_elems = 1;
-  }
-
   return 1;
 }
 
-static int handle_table_dump_v2(rec_data_t *rd, khash_t(td2_peer) * peer_table,
-                                parsebgp_mrt_msg_t *mrt)
+// decodes the next rib entry of a TDv2 RIB message (whose prefix has already
+// been set in the elem by select_decoder). the AFI is known for each subtype,
+// so the compiler can specialise the entry decoding for it.
+static inline int decode_td2_rib(rec_data_t *rd, state_t *state,
+                                 parsebgp_mrt_msg_t *mrt,
+                                 bgpstream_filter_mgr_t *filter_mgr,
+                                 parsebgp_bgp_afi_t afi)
 {
-  parsebgp_mrt_table_dump_v2_t *td2 = mrt->types.table_dump_v2;
+  parsebgp_mrt_table_dump_v2_afi_safi_rib_t *asr =
+    &mrt->types.table_dump_v2->afi_safi_rib;
+  int rc;
 
-  switch (mrt->subtype) {
-  case PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE:
-    if (peer_table != NULL) {
-      bgpstream_log(BGPSTREAM_LOG_ERR,
-                    "Peer index table has already been processed");
-      return 0;
+  // since this is a generator, we just process one rib entry each time (or
+  // more, when the peers of some are filtered out)
+  do {
+    rc = handle_td2_rib_entry(rd, state->peer_table, mrt, afi,
+                              &asr->entries[rd->next_re], filter_mgr);
+    // move on to the next rib entry
+    rd->next_re++;
+    if (rd->next_re == asr->entry_count) {
+      rd->end_of_elems = 1;
     }
-    // Peer Index tables are processed during get_next_record
-    assert(0);
-    break;
+  } while (rc == 0 && rd->end_of_elems == 0);
 
-  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
-    return handle_td2_afi_safi_rib(rd, peer_table, mrt, PARSEBGP_BGP_AFI_IPV4,
-                                   &td2->afi_safi_rib);
-  case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
-    return handle_td2_afi_safi_rib(rd, peer_table, mrt, PARSEBGP_BGP_AFI_IPV6,
-                                   &td2->afi_safi_rib);
-
-  default:
-    // do nothing
-    break;
-  }
+  return rc;
+}
 
-  return 0;
+static int decode_td2_rib_ipv4(rec_data_t *rd, state_t *state,
+                               parsebgp_mrt_msg_t *mrt,
+                               bgpstream_filter_mgr_t *filter_mgr)
+{
+  return decode_td2_rib(rd, state, mrt, filter_mgr, PARSEBGP_BGP_AFI_IPV4);
 }
 
-static int handle_bgp4mp_state_change(rec_data_t *rd,
-                                      parsebgp_mrt_bgp4mp_t *bgp4mp)
+static int decode_td2_rib_ipv6(rec_data_t *rd, state_t *state,
+                               parsebgp_mrt_msg_t *mrt,
+                               bgpstream_filter_mgr_t *filter_mgr)
 {
-  rd->elem->type = BGPSTREAM_ELEM_TYPE_PEERSTATE;
-  rd->elem->old_state = bgp4mp->data.state_change.old_state;
-  rd->elem->new_state = bgp4mp->data.state_change.new_state;
-  rd->end_of_elems = 1;
-  return 1;
+  return decode_td2_rib(rd, state, mrt, filter_mgr, PARSEBGP_BGP_AFI_IPV6);
 }
 
-static int handle_bgp4mp(rec_data_t *rd, parsebgp_mrt_msg_t *mrt)
+static int decode_table_dump(rec_data_t *rd, state_t *state,
+                             parsebgp_mrt_msg_t *mrt,
+                             bgpstream_filter_mgr_t *filter_mgr)
 {
-  int rc = 0;
-  parsebgp_mrt_bgp4mp_t *bgp4mp = mrt->types.bgp4mp;
+  return handle_table_dump(rd, mrt);
+}
 
+static void prep_bgp4mp(rec_data_t *rd, parsebgp_mrt_bgp4mp_t *bgp4mp)
+{
   // no originated time information in BGP4MP
   rd->elem->orig_time_sec = 0;
   rd->elem->orig_time_usec = 0;
@@ -241,31 +260,140 @@ static int handle_bgp4mp(rec_data_t *rd, parsebgp_mrt_msg_t *mrt)
           rd->elem->peer_ip.version = BGPSTREAM_ADDR_VERSION_UNKNOWN);
   rd->elem->peer_asn = bgp4mp->peer_asn;
   // other elem fields are specific to the message
+}
+
+static int decode_bgp4mp_state_change(rec_data_t *rd, state_t *state,
+                                      parsebgp_mrt_msg_t *mrt,
+                                      bgpstream_filter_mgr_t *filter_mgr)
+{
+  parsebgp_mrt_bgp4mp_t *bgp4mp = mrt->types.bgp4mp;
+
+  prep_bgp4mp(rd, bgp4mp);
+  rd->elem->type = BGPSTREAM_ELEM_TYPE_PEERSTATE;
+  rd->elem->old_state = bgp4mp->data.state_change.old_state;
+  rd->elem->new_state = bgp4mp->data.state_change.new_state;
+  rd->end_of_elems = 1;
+  return 1;
+}
+
+static int decode_bgp4mp_message(rec_data_t *rd, state_t *state,
+                                 parsebgp_mrt_msg_t *mrt,
+                                 bgpstream_filter_mgr_t *filter_mgr)
+{
+  parsebgp_mrt_bgp4mp_t *bgp4mp = mrt->types.bgp4mp;
+  int rc;
+
+  prep_bgp4mp(rd, bgp4mp);
+  rc = bgpstream_parsebgp_process_update(&rd->upd_state, rd->elem,
+                                         bgp4mp->data.bgp_msg);
+  if (rc == 0) {
+    rd->end_of_elems = 1;
+  }
+  return rc;
+}
+
+// picks the decoder for the elems of the current message, based on its type
+// and subtype, and does the checks that apply to the message as a whole.
+// returns 1 if rd->decode has been set, otherwise what get_next_elem should
+// return (0 if the message has no elems for us, -1 if an error occurred)
+static int select_decoder(rec_data_t *rd, state_t *state,
+                          parsebgp_mrt_msg_t *mrt,
+                          bgpstream_filter_mgr_t *filter_mgr)
+{
+  parsebgp_mrt_table_dump_v2_afi_safi_rib_t *asr;
+  parsebgp_mrt_bgp4mp_t *bgp4mp;
+  parsebgp_bgp_afi_t afi;
+
+  switch (mrt->type) {
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP:
+    rd->decode = decode_table_dump;
+    return 1;
+
+  case PARSEBGP_MRT_TYPE_TABLE_DUMP_V2:
+    switch (mrt->subtype) {
+    case PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE:
+      if (state->peer_table != NULL) {
+        bgpstream_log(BGPSTREAM_LOG_ERR,
+                      "Peer index table has already been processed");
+        return 0;
+      }
+      // Peer Index tables are processed during get_next_record
+      assert(0);
+      return 0;
+
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV4_UNICAST:
+      afi = PARSEBGP_BGP_AFI_IPV4;
+      rd->decode = decode_td2_rib_ipv4;
+      break;
+    case PARSEBGP_MRT_TABLE_DUMP_V2_RIB_IPV6_UNICAST:
+      afi = PARSEBGP_BGP_AFI_IPV6;
+      rd->decode = decode_td2_rib_ipv6;
+      break;
+
+    default:
+      // do nothing
+      return 0;
+    }
 
-  switch (mrt->subtype) {
-  case PARSEBGP_MRT_BGP4MP_STATE_CHANGE:
-  case PARSEBGP_MRT_BGP4MP_STATE_CHANGE_AS4:
-    rc = handle_bgp4mp_state_change(rd, bgp4mp);
-    break;
-
-  case PARSEBGP_MRT_BGP4MP_MESSAGE:
-  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
-  case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
-  case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
-    rc = bgpstream_parsebgp_process_update(&rd->upd_state, rd->elem,
-                                           bgp4mp->data.bgp_msg);
-    if (rc == 0) {
+    // prep the elem
+    asr = &mrt->types.table_dump_v2->afi_safi_rib;
+    rd->elem->type = BGPSTREAM_ELEM_TYPE_RIB;
+    COPY_IP(&rd->elem->prefix.address, afi, asr->prefix, return 0);
+    rd->elem->prefix.mask_len = asr->prefix_len;
+    // other elem fields are specific to the entry
+
+    // all the entries share the prefix, so they pass or fail its filters
+    // together
+    if (asr->entry_count == 0 ||
+        (filter_mgr->elem_prog.elem_types & (1 << BGPSTREAM_ELEM_TYPE_RIB)) ==
+          0 ||
+        bgpstream_filter_mgr_pfx_wanted(filter_mgr, &rd->elem->prefix) == 0) {
       rd->end_of_elems = 1;
+      return 0;
+    }
+
+    // if we haven't seen a peer index table yet, then just give up
+    if (state->peer_table == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_WARN,
+                    "Missing Peer Index Table, skipping RIB entry");
+      return -1;
+    }
+    return 1;
+
+  case PARSEBGP_MRT_TYPE_BGP4MP:
+  case PARSEBGP_MRT_TYPE_BGP4MP_ET:
+    bgp4mp = mrt->types.bgp4mp;
+    switch (mrt->subtype) {
+    case PARSEBGP_MRT_BGP4MP_STATE_CHANGE:
+    case PARSEBGP_MRT_BGP4MP_STATE_CHANGE_AS4:
+      rd->decode = decode_bgp4mp_state_change;
+      return 1;
+
+    case PARSEBGP_MRT_BGP4MP_MESSAGE:
+    case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4:
+    case PARSEBGP_MRT_BGP4MP_MESSAGE_LOCAL:
+    case PARSEBGP_MRT_BGP4MP_MESSAGE_AS4_LOCAL:
+      // skip the whole message if none of its elems can pass the filters
+      if (bgpstream_parsebgp_update_wanted(filter_mgr, bgp4mp->peer_asn,
+                                           bgp4mp->data.bgp_msg) == 0) {
+        rd->end_of_elems = 1;
+        return 0;
+      }
+      rd->decode = decode_bgp4mp_message;
+      return 1;
+
+    default:
+      bgpstream_log(BGPSTREAM_LOG_WARN,
+                    "Skipping unknown BGP4MP record subtype %d", mrt->subtype);
+      return 0;
     }
-    break;
 
   default:
-    bgpstream_log(BGPSTREAM_LOG_WARN,
-                  "Skipping unknown BGP4MP record subtype %d", mrt->subtype);
-    break;
+    // a type we don't care about, so return end-of-elems
+    bgpstream_log(BGPSTREAM_LOG_WARN, "Skipping unknown MRT record type %d",
+                  mrt->type);
+    return 0;
   }
-
-  return rc;
 }
 
 /* -------------------- RECORD FILTERING -------------------- */
@@ -292,6 +420,11 @@ static int handle_td2_peer_index(bgpstream_format_t *format,
   peer_index_entry_t *bs_pie;
   parsebgp_mrt_table_dump_v2_peer_entry_t *pie;
 
+  // a dump made by concatenating others may have more than one table
+  if (STATE->peer_table != NULL) {
+    kh_destroy(td2_peer, STATE->peer_table);
+  }
+
   // alloc the table hash
   if ((STATE->peer_table = kh_init(td2_peer)) == NULL) {
     return -1;
@@ -314,6 +447,22 @@ static int handle_td2_peer_index(bgpstream_format_t *format,
   return 0;
 }
 
+// keeps a copy of the raw peer index table, to write before raw RIB records
+static int keep_td2_peer_index_raw(bgpstream_format_t *format)
+{
+  bgpstream_parsebgp_decode_state_t *dec = &STATE->decoder;
+  bgpstream_record_raw_prefix_t *prefix;
+
+  if ((prefix = bgpstream_record_raw_prefix_create(
+         dec->raw, dec->raw_len,
+         __sync_add_and_fetch(&peer_index_next_id, 1))) == NULL) {
+    return -1;
+  }
+  bgpstream_record_raw_prefix_release(STATE->peer_index_raw);
+  STATE->peer_index_raw = prefix;
+  return 0;
+}
+
 static bgpstream_parsebgp_check_filter_rc_t
 populate_filter_cb(bgpstream_format_t *format, bgpstream_record_t *record,
                    parsebgp_msg_t *msg)
@@ -332,6 +481,11 @@ populate_filter_cb(bgpstream_format_t *format, bgpstream_record_t *record,
       bgpstream_log(BGPSTREAM_LOG_ERR, "Failed to process Peer Index Table");
       return BGPSTREAM_PARSEBGP_FILTER_ERROR;
     }
+    if (format->filter_mgr->raw_records != 0 &&
+        keep_td2_peer_index_raw(format) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Failed to copy Peer Index Table");
+      return BGPSTREAM_PARSEBGP_FILTER_ERROR;
+    }
     // indicate that we want this message SKIPPED
     return BGPSTREAM_PARSEBGP_SKIP;
   }
@@ -342,6 +496,7 @@ populate_filter_cb(bgpstream_format_t *format, bgpstream_record_t *record,
 
   // ensure the router fields are unset
   record->router_name[0] = '\0';
+  record->router_id = 0;
   record->router_ip.version = 0;
 
   // check the filters
@@ -362,6 +517,84 @@ populate_filter_cb(bgpstream_format_t *format, bgpstream_record_t *record,
   }
 }
 
+// checks the time filter using only the MRT common header, so that records
+// before the interval are not decoded at all
+static bgpstream_parsebgp_check_filter_rc_t
+peek_filter_cb(bgpstream_format_t *format, const uint8_t *buf, size_t len,
+               size_t *msg_len)
+{
+  uint32_t ts_sec, mrt_len;
+  uint16_t type, subtype;
+
+  if (format->TIF == NULL || len < MRT_HDR_LEN) {
+    return BGPSTREAM_PARSEBGP_KEEP;
+  }
+
+  memcpy(&ts_sec, buf, sizeof(ts_sec));
+  memcpy(&type, buf + 4, sizeof(type));
+  memcpy(&subtype, buf + 6, sizeof(subtype));
+  memcpy(&mrt_len, buf + 8, sizeof(mrt_len));
+  ts_sec = ntohl(ts_sec);
+  type = ntohs(type);
+  subtype = ntohs(subtype);
+  mrt_len = ntohl(mrt_len);
+
+  // the peer index table is needed by the RIB records that follow it, and
+  // records after the interval are left to populate_filter_cb (to end the
+  // stream)
+  if ((type == PARSEBGP_MRT_TYPE_TABLE_DUMP_V2 &&
+       subtype == PARSEBGP_MRT_TABLE_DUMP_V2_PEER_INDEX_TABLE) ||
+      ts_sec >= format->TIF->begin_time) {
+    return BGPSTREAM_PARSEBGP_KEEP;
+  }
+
+  // a partial record is decoded as usual, which will refill the buffer
+  if (len - MRT_HDR_LEN < mrt_len) {
+    return BGPSTREAM_PARSEBGP_KEEP;
+  }
+
+  *msg_len = MRT_HDR_LEN + mrt_len;
+  return BGPSTREAM_PARSEBGP_FILTER_OUT;
+}
+
+// finds the length of an MRT record from its common header
+static size_t msg_len_cb(const uint8_t *buf, size_t len)
+{
+  uint32_t mrt_len;
+
+  if (len < MRT_HDR_LEN) {
+    return 0;
+  }
+  memcpy(&mrt_len, buf + 8, sizeof(mrt_len));
+  return MRT_HDR_LEN + ntohl(mrt_len);
+}
+
+// copies the raw bytes of the record that was just populated
+static bgpstream_format_status_t keep_raw(bgpstream_format_t *format,
+                                          bgpstream_record_t *record)
+{
+  bgpstream_parsebgp_decode_state_t *dec = &STATE->decoder;
+  parsebgp_mrt_msg_t *mrt = RDATA->msg->types.mrt;
+
+  // a truncated record would not be valid MRT once written out
+  if (msg_len_cb(dec->raw, dec->raw_len) != dec->raw_len) {
+    return BGPSTREAM_FORMAT_OK;
+  }
+
+  if (bgpstream_record_set_raw(record, dec->raw, dec->raw_len) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not copy raw record");
+    return BGPSTREAM_FORMAT_UNKNOWN_ERROR;
+  }
+
+  // RIB entries refer to peers by their index in the peer index table
+  if (mrt->type == PARSEBGP_MRT_TYPE_TABLE_DUMP_V2 &&
+      STATE->peer_index_raw != NULL) {
+    bgpstream_record_set_raw_prefix(record, STATE->peer_index_raw);
+  }
+
+  return BGPSTREAM_FORMAT_OK;
+}
+
 /* ==================== PUBLIC API BELOW HERE ==================== */
 
 int bs_format_mrt_create(bgpstream_format_t *format, bgpstream_resource_t *res)
@@ -373,11 +606,31 @@ int bs_format_mrt_create(bgpstream_format_t *format, bgpstream_resource_t *res)
     return -1;
   }
 
-  STATE->decoder.msg_type = PARSEBGP_MSG_TYPE_MRT;
+  if (bgpstream_parsebgp_decode_state_init(&STATE->decoder,
+                                           PARSEBGP_MSG_TYPE_MRT, res) != 0) {
+    free(format->state);
+    format->state = NULL;
+    return -1;
+  }
 
   opts = &STATE->decoder.parser_opts;
   parsebgp_opts_init(opts);
   bgpstream_parsebgp_opts_init(opts);
+  bgpstream_parsebgp_opts_prune(opts, format->filter_mgr);
+
+  // local uncompressed files are decoded without copying them
+  bgpstream_parsebgp_decode_state_map(&STATE->decoder, format->transport);
+
+  // RIB dumps are large enough to be worth decoding using several threads
+  if (res->record_type == BGPSTREAM_RIB &&
+      bgpstream_parsebgp_decode_state_set_threads(
+        &STATE->decoder, format->filter_mgr->decode_threads, msg_len_cb) !=
+        0) {
+    bgpstream_parsebgp_decode_state_destroy(&STATE->decoder);
+    free(format->state);
+    format->state = NULL;
+    return -1;
+  }
 
   return 0;
 }
@@ -386,8 +639,15 @@ bgpstream_format_status_t
 bs_format_mrt_populate_record(bgpstream_format_t *format,
                               bgpstream_record_t *record)
 {
-  return bgpstream_parsebgp_populate_record(&STATE->decoder, RDATA->msg, format,
-                                            record, NULL, populate_filter_cb);
+  bgpstream_format_status_t rc;
+
+  rc = bgpstream_parsebgp_populate_record(&STATE->decoder, &RDATA->msg,
+                                          format, record, NULL, peek_filter_cb,
+                                          populate_filter_cb);
+  if (rc != BGPSTREAM_FORMAT_OK || format->filter_mgr->raw_records == 0) {
+    return rc;
+  }
+  return keep_raw(format, record);
 }
 
 int bs_format_mrt_get_next_elem(bgpstream_format_t *format,
@@ -405,27 +665,12 @@ int bs_format_mrt_get_next_elem(bgpstream_format_t *format,
   }
 
   mrt = RDATA->msg->types.mrt;
-  switch (mrt->type) {
-  case PARSEBGP_MRT_TYPE_TABLE_DUMP:
-    rc = handle_table_dump(RDATA, mrt);
-    break;
-
-  case PARSEBGP_MRT_TYPE_TABLE_DUMP_V2:
-    rc = handle_table_dump_v2(RDATA, STATE->peer_table, mrt);
-    break;
-
-  case PARSEBGP_MRT_TYPE_BGP4MP:
-  case PARSEBGP_MRT_TYPE_BGP4MP_ET:
-    rc = handle_bgp4mp(RDATA, mrt);
-    break;
-
-  default:
-    // a type we don't care about, so return end-of-elems
-    bgpstream_log(BGPSTREAM_LOG_WARN, "Skipping unknown MRT record type %d",
-                  mrt->type);
-    rc = 0;
-    break;
+  // the decoder only depends on the message, so it is picked at its first elem
+  if (RDATA->decode == NULL &&
+      (rc = select_decoder(RDATA, STATE, mrt, format->filter_mgr)) <= 0) {
+    return rc;
   }
+  rc = RDATA->decode(RDATA, STATE, mrt, format->filter_mgr);
 
   if (rc <= 0) {
     return rc;
@@ -449,6 +694,10 @@ int bs_format_mrt_init_data(bgpstream_format_t *format, void **data)
     return -1;
   }
 
+  if ((rd->attr_cache = bgpstream_parsebgp_attr_cache_create()) == NULL) {
+    return -1;
+  }
+
   if ((rd->msg = parsebgp_create_msg()) == NULL) {
     return -1;
   }
@@ -461,9 +710,11 @@ void bs_format_mrt_clear_data(bgpstream_format_t *format, void *data)
 {
   rec_data_t *rd = (rec_data_t *)data;
   assert(rd != NULL);
+  bgpstream_parsebgp_attr_cache_clear(rd->attr_cache, rd->elem);
   bgpstream_elem_clear(rd->elem);
   rd->end_of_elems = 0;
   rd->next_re = 0;
+  rd->decode = NULL;
   bgpstream_parsebgp_upd_state_reset(&rd->upd_state);
   parsebgp_clear_msg(rd->msg);
 }
@@ -474,6 +725,11 @@ void bs_format_mrt_destroy_data(bgpstream_format_t *format, void *data)
   if (rd == NULL) {
     return;
   }
+  if (rd->attr_cache != NULL) {
+    bgpstream_parsebgp_attr_cache_release(rd->attr_cache, rd->elem);
+    bgpstream_parsebgp_attr_cache_destroy(rd->attr_cache);
+    rd->attr_cache = NULL;
+  }
   bgpstream_elem_destroy(rd->elem);
   rd->elem = NULL;
   parsebgp_destroy_msg(rd->msg);
@@ -488,6 +744,11 @@ void bs_format_mrt_destroy(bgpstream_format_t *format)
     STATE->peer_table = NULL;
   }
 
+  bgpstream_record_raw_prefix_release(STATE->peer_index_raw);
+  STATE->peer_index_raw = NULL;
+
+  bgpstream_parsebgp_decode_state_destroy(&STATE->decoder);
+
   free(format->state);
   format->state = NULL;
 }
@@ -33,7 +33,13 @@
 #include "jsmn_utils.h"
 #include "libjsmn/jsmn.h"
 #include <assert.h>
+#include <inttypes.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define STATE ((state_t *)(format->state))
 #define RDATA ((rec_data_t *)(record->__int->data))
@@ -96,14 +102,32 @@ typedef struct state {
   // options
   parsebgp_opts_t opts;
 
-  // json bgp message string buffer
+  // current json bgp message string (points into the line arena)
   char *json_string_buffer;
 
-  // json bgp message string buffer length
+  // json bgp message string length
   int json_string_buffer_len;
 
-  // json bgp message bytes buffer
-  uint8_t json_bytes_buffer[4096];
+  // line arena: the transport reads into it in bulk and lines are handed out
+  // in place, only a trailing partial line is ever moved (NULL until the first
+  // read, and while a message stream is idle)
+  char *arena;
+
+  // size of the line arena
+  size_t arena_size;
+
+  // offsets of the unconsumed data in the line arena
+  size_t arena_start;
+  size_t arena_end;
+
+  // has the transport reached the end of the stream?
+  int arena_eof;
+
+  // number of bytes of kafka messages read so far (see bgpstream_record_ack)
+  uint64_t kafka_pos;
+
+  // json bgp message bytes buffer, large enough for RFC 8654 extended messages
+  uint8_t json_bytes_buffer[UINT16_MAX];
 
   // json bgp message field buffer
   uint8_t field_buffer[100];
@@ -115,6 +139,13 @@ typedef struct state {
 
 #define JSON_BUFLEN 1024*1024 // 1 MB buffer
 
+// initial size of the arena when lines are split from a byte stream (it grows
+// to fit longer lines)
+#define JSON_LINE_BUFLEN (64 * 1024)
+
+// lines longer than this are treated as a corrupted dump
+#define JSON_MAX_BUFLEN (16 * 1024 * 1024)
+
 /* ======================================================== */
 /* ======================================================== */
 /* ==================== JSON UTILITIES ==================== */
@@ -133,31 +164,79 @@ typedef struct state {
     FIELDPTR(field)[FIELDLEN(field)] = tmp;                                    \
   } while (0)
 
+// value of each hex digit with HEX_VALID set, zero for any other character
+#define HEX_VALID 0x10
+static const uint8_t hex_val[256] = {
+  ['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13, ['4'] = 0x14,
+  ['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17, ['8'] = 0x18, ['9'] = 0x19,
+  ['A'] = 0x1A, ['B'] = 0x1B, ['C'] = 0x1C, ['D'] = 0x1D, ['E'] = 0x1E,
+  ['F'] = 0x1F, ['a'] = 0x1A, ['b'] = 0x1B, ['c'] = 0x1C, ['d'] = 0x1D,
+  ['e'] = 0x1E, ['f'] = 0x1F,
+};
+
+#ifdef __SSE2__
+// convert 32 hex characters into 16 bytes, returns -1 if any of them is not a
+// hex digit
+static int hex32_to_bytes(uint8_t *buf, const char *hexstr)
+{
+  const __m128i lcase = _mm_set1_epi8(0x20);
+  const __m128i dig_lo = _mm_set1_epi8('0' - 1);
+  const __m128i dig_hi = _mm_set1_epi8('9' + 1);
+  const __m128i alpha_lo = _mm_set1_epi8('a' - 1);
+  const __m128i alpha_hi = _mm_set1_epi8('f' + 1);
+  const __m128i dig_off = _mm_set1_epi8('0');
+  const __m128i alpha_off = _mm_set1_epi8('a' - 10);
+  const __m128i low_byte = _mm_set1_epi16(0x00FF);
+  __m128i v, l, is_dig, is_alpha, nyb, pair[2];
+  int i;
+
+  for (i = 0; i < 2; i++) {
+    v = _mm_loadu_si128((const __m128i *)(hexstr + i * 16));
+    // the signed compares also reject anything >= 0x80
+    l = _mm_or_si128(v, lcase);
+    is_dig =
+      _mm_and_si128(_mm_cmpgt_epi8(v, dig_lo), _mm_cmplt_epi8(v, dig_hi));
+    is_alpha =
+      _mm_and_si128(_mm_cmpgt_epi8(l, alpha_lo), _mm_cmplt_epi8(l, alpha_hi));
+    if (_mm_movemask_epi8(_mm_or_si128(is_dig, is_alpha)) != 0xFFFF) {
+      return -1;
+    }
+    nyb = _mm_or_si128(_mm_and_si128(is_dig, _mm_sub_epi8(v, dig_off)),
+                       _mm_and_si128(is_alpha, _mm_sub_epi8(l, alpha_off)));
+    // each 16-bit lane holds (high nybble, low nybble), merge them into the
+    // low byte of the lane
+    pair[i] = _mm_and_si128(
+      _mm_or_si128(_mm_slli_epi16(nyb, 4), _mm_srli_epi16(nyb, 8)), low_byte);
+  }
+  _mm_storeu_si128((__m128i *)buf, _mm_packus_epi16(pair[0], pair[1]));
+  return 0;
+}
+#endif
+
 // convert char array to bytes
 static int hexstr_to_bytes(uint8_t *buf, const char *hexstr, size_t hexstr_len)
 {
-  size_t i;
-  char c;
-  for (i = 0; i < hexstr_len; i++) {
-    c = hexstr[i];
-    // sanity check on input characters
-    if (c < '0' || (c > '9' && c < 'A') || (c > 'F' && c < 'a') || c > 'f') {
+  size_t i = 0;
+  uint8_t hi, lo;
+
+#ifdef __SSE2__
+  for (; i + 32 <= hexstr_len; i += 32) {
+    if (hex32_to_bytes(buf, hexstr + i) != 0) {
       return -1;
     }
-    if (c >= 'a') {
-      c -= ('a' - '9' - 1);
-    } else if (c >= 'A') {
-      c -= ('A' - '9' - 1);
-    }
-    c -= '0';
+    buf += 16;
+  }
+#endif
 
-    if ((i & 0x1) == 0) {
-      // high-order
-      *buf = c << 4;
-    } else {
-      // low-order
-      *(buf++) |= c;
+  // scalar conversion of whatever is left, one octet at a time
+  for (; i + 1 < hexstr_len; i += 2) {
+    hi = hex_val[(uint8_t)hexstr[i]];
+    lo = hex_val[(uint8_t)hexstr[i + 1]];
+    // sanity check on input characters
+    if ((hi & lo & HEX_VALID) == 0) {
+      return -1;
     }
+    *(buf++) = ((hi & 0xF) << 4) | (lo & 0xF);
   }
   return 0;
 }
@@ -167,15 +246,16 @@ static int hexstr_to_bytes(uint8_t *buf, const char *hexstr, size_t hexstr_len)
 static ssize_t hexstr_to_bgpmsg(uint8_t *buf, size_t buflen, const char *hexstr,
                                 size_t hexstr_len)
 {
-  // 2 characters per octet, and BGP messages cannot be more than 4096 bytes
-  uint16_t msg_len = hexstr_len / 2;
+  // 2 characters per octet, and BGP messages cannot be more than 65535 bytes
+  // (RFC 8654)
+  size_t msg_len = hexstr_len / 2;
   if ((hexstr_len & 0x1) != 0) {
     bgpstream_log(BGPSTREAM_LOG_WARN, "Malformed RIS Live raw BGP message");
     return -1;
   }
-  if (hexstr_len > UINT16_MAX || msg_len > buflen) {
+  if (msg_len > buflen) {
     bgpstream_log(BGPSTREAM_LOG_WARN,
-                  "RIS Live raw BGP message too long (%"PRIu16" bytes)", msg_len);
+                  "RIS Live raw BGP message too long (%zu bytes)", msg_len);
     return -1;
   }
   // parse the hex string, one nybble at a time
@@ -185,6 +265,172 @@ static ssize_t hexstr_to_bgpmsg(uint8_t *buf, size_t buflen, const char *hexstr,
   return msg_len;
 }
 
+// characters the structural scanner stops at
+#define SCAN_STRING 0x1 // end of a string: quote or escape
+#define SCAN_NESTED 0x2 // strings and brackets: skipping a nested value
+static const uint8_t scan_class[256] = {
+  ['"'] = SCAN_STRING | SCAN_NESTED, ['\\'] = SCAN_STRING | SCAN_NESTED,
+  ['{'] = SCAN_NESTED, ['}'] = SCAN_NESTED,
+  ['['] = SCAN_NESTED, [']'] = SCAN_NESTED,
+};
+
+// find the first character of the given scan class in buf, returns len if
+// there is none
+static size_t scan_json(const char *buf, size_t len, int class)
+{
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i escape = _mm_set1_epi8('\\');
+  // '[' and ']' differ from '{' and '}' only in bit 0x20
+  const __m128i fold = _mm_set1_epi8(0x20);
+  const __m128i lbrace = _mm_set1_epi8('{');
+  const __m128i rbrace = _mm_set1_epi8('}');
+  __m128i v, f, m;
+  int mask;
+
+  for (; i + 16 <= len; i += 16) {
+    v = _mm_loadu_si128((const __m128i *)(buf + i));
+    m = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, escape));
+    if (class == SCAN_NESTED) {
+      f = _mm_or_si128(v, fold);
+      m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(f, lbrace),
+                                       _mm_cmpeq_epi8(f, rbrace)));
+    }
+    if ((mask = _mm_movemask_epi8(m)) != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+
+  for (; i < len; i++) {
+    if ((scan_class[(uint8_t)buf[i]] & class) != 0) {
+      return i;
+    }
+  }
+  return len;
+}
+
+// position in a JSON line being scanned
+typedef struct json_cursor {
+  char *buf;
+  size_t len;
+  size_t pos;
+} json_cursor_t;
+
+static void cursor_skip_ws(json_cursor_t *c)
+{
+  while (c->pos < c->len &&
+         (c->buf[c->pos] == ' ' || c->buf[c->pos] == '\t' ||
+          c->buf[c->pos] == '\r' || c->buf[c->pos] == '\n')) {
+    c->pos++;
+  }
+}
+
+// consume the given character (after any whitespace)
+static int cursor_expect(json_cursor_t *c, char ch)
+{
+  cursor_skip_ws(c);
+  if (c->pos >= c->len || c->buf[c->pos] != ch) {
+    return -1;
+  }
+  c->pos++;
+  return 0;
+}
+
+// consume the string at the cursor, the field covers its content without the
+// quotes (escapes are left as-is, like jsmn does)
+static int cursor_string(json_cursor_t *c, json_field_t *field)
+{
+  size_t start;
+
+  if (cursor_expect(c, '"') != 0) {
+    return -1;
+  }
+  start = c->pos;
+  while (1) {
+    c->pos += scan_json(c->buf + c->pos, c->len - c->pos, SCAN_STRING);
+    if (c->pos >= c->len) {
+      return -1;
+    }
+    if (c->buf[c->pos] == '"') {
+      break;
+    }
+    // escape: skip the escaped character
+    c->pos += 2;
+  }
+  field->ptr = c->buf + start;
+  field->len = c->pos - start;
+  c->pos++;
+  return 0;
+}
+
+// consume the value at the cursor, strings are returned like cursor_string,
+// everything else (including nested objects and arrays) verbatim
+static int cursor_value(json_cursor_t *c, json_field_t *field)
+{
+  json_field_t tmp;
+  size_t start;
+  int depth = 0;
+  char ch;
+
+  cursor_skip_ws(c);
+  if (c->pos >= c->len) {
+    return -1;
+  }
+  start = c->pos;
+  ch = c->buf[c->pos];
+
+  if (ch == '"') {
+    return cursor_string(c, field);
+  }
+
+  if (ch == '{' || ch == '[') {
+    while (1) {
+      c->pos += scan_json(c->buf + c->pos, c->len - c->pos, SCAN_NESTED);
+      if (c->pos >= c->len) {
+        return -1;
+      }
+      ch = c->buf[c->pos];
+      if (ch == '"') {
+        if (cursor_string(c, &tmp) != 0) {
+          return -1;
+        }
+        continue;
+      }
+      if (ch == '\\') {
+        // escapes are only valid inside strings
+        return -1;
+      }
+      c->pos++;
+      if (ch == '{' || ch == '[') {
+        depth++;
+      } else if (--depth == 0) {
+        break;
+      }
+    }
+  } else {
+    // primitive: number, true, false or null
+    while (c->pos < c->len && c->buf[c->pos] != ',' &&
+           c->buf[c->pos] != '}' && c->buf[c->pos] != ']' &&
+           c->buf[c->pos] != ' ' && c->buf[c->pos] != '\t' &&
+           c->buf[c->pos] != '\r' && c->buf[c->pos] != '\n') {
+      c->pos++;
+    }
+    if (c->pos == start) {
+      return -1;
+    }
+  }
+
+  field->ptr = c->buf + start;
+  field->len = c->pos - start;
+  return 0;
+}
+
+#define FIELDEQ(field, str)                                                    \
+  ((field).len == sizeof(str) - 1 && memcmp((field).ptr, str, (field).len) == 0)
+
 /* ====================================================================== */
 /* ====================================================================== */
 /* ==================== PRIVATE FUNCTIONS BELOW HERE ==================== */
@@ -203,6 +449,10 @@ static int process_common_fields(bgpstream_format_t *format,
   // populate collector name
   memcpy(record->collector_name, FIELDPTR(host), FIELDLEN(host));
   record->collector_name[FIELDLEN(host)] = '\0';
+  if (bgpstream_record_intern_name(record->collector_name,
+                                   &record->collector_id) != 0) {
+    return -1;
+  }
 
   // populate peer asn
   STRTOUL(peer_asn, RDATA->elem->peer_asn);
@@ -300,6 +550,7 @@ process_unsupported_message(bgpstream_format_t *format,
 {
   record->status = BGPSTREAM_RECORD_STATUS_UNSUPPORTED_RECORD;
   record->collector_name[0] = '\0';
+  record->collector_id = 0;
   return BGPSTREAM_FORMAT_UNSUPPORTED_MSG;
 }
 
@@ -311,6 +562,7 @@ process_corrupted_message(bgpstream_format_t *format,
                 STATE->json_string_buffer);
   record->status = BGPSTREAM_RECORD_STATUS_CORRUPTED_RECORD;
   record->collector_name[0] = '\0';
+  record->collector_id = 0;
   return BGPSTREAM_FORMAT_CORRUPTED_MSG;
 }
 
@@ -355,6 +607,91 @@ static int process_data(bgpstream_format_t *format,
   return 0;
 }
 
+#define SCANFIELD(field)                                                       \
+  if (FIELDEQ(key, STR(field))) {                                              \
+    STATE->json_fields.field = val;                                            \
+  }
+
+// extract the fields of the data object at the cursor
+static int scan_data_fields(bgpstream_format_t *format, json_cursor_t *c)
+{
+  json_field_t key, val;
+
+  if (cursor_expect(c, '{') != 0) {
+    return -1;
+  }
+  cursor_skip_ws(c);
+  if (c->pos < c->len && c->buf[c->pos] == '}') {
+    return 0;
+  }
+
+  while (1) {
+    if (cursor_string(c, &key) != 0 || cursor_expect(c, ':') != 0 ||
+        cursor_value(c, &val) != 0) {
+      return -1;
+    }
+    SCANFIELD(raw)             //
+    else SCANFIELD(timestamp)  //
+      else SCANFIELD(host)     //
+      else SCANFIELD(peer_asn) //
+      else SCANFIELD(peer)     //
+      else SCANFIELD(type)     //
+      else SCANFIELD(state)    //
+
+    cursor_skip_ws(c);
+    if (c->pos >= c->len) {
+      return -1;
+    }
+    if (c->buf[c->pos] == '}') {
+      return 0;
+    }
+    if (c->buf[c->pos++] != ',') {
+      return -1;
+    }
+  }
+}
+
+// fast path for the common case of a well-formed "ris_message": scan the line
+// once for the fields we need instead of tokenizing all of it. returns -1 if
+// the line must go through the full parser instead (errors, other envelope
+// types, malformed JSON)
+static int scan_json_fields(bgpstream_format_t *format)
+{
+  json_cursor_t c = {STATE->json_string_buffer,
+                     (size_t)STATE->json_string_buffer_len, 0};
+  json_field_t key, val;
+  int is_msg = 0;
+
+  if (cursor_expect(&c, '{') != 0) {
+    return -1;
+  }
+
+  while (1) {
+    if (cursor_string(&c, &key) != 0 || cursor_expect(&c, ':') != 0) {
+      return -1;
+    }
+    if (FIELDEQ(key, "data")) {
+      if (is_msg == 0) {
+        return -1;
+      }
+      return scan_data_fields(format, &c);
+    }
+    cursor_skip_ws(&c);
+    if (FIELDEQ(key, "type")) {
+      if (c.pos >= c.len || c.buf[c.pos] != '"' ||
+          cursor_string(&c, &val) != 0 || !FIELDEQ(val, "ris_message")) {
+        return -1;
+      }
+      is_msg = 1;
+    } else if (cursor_value(&c, &val) != 0) {
+      return -1;
+    }
+    if (cursor_expect(&c, ',') != 0) {
+      return -1;
+    }
+  }
+}
+
 static bgpstream_format_status_t
 bs_format_process_json_fields(bgpstream_format_t *format,
                               bgpstream_record_t *record)
@@ -363,9 +700,15 @@ bs_format_process_json_fields(bgpstream_format_t *format,
   bgpstream_format_status_t rc;
   jsmn_parser p;
 
-  jsmntok_t *t, *root_tok;
+  jsmntok_t *t, *root_tok = NULL;
   size_t tokcount = 128;
 
+  memset(&STATE->json_fields, 0, sizeof(STATE->json_fields));
+  if (scan_json_fields(format) == 0) {
+    goto process;
+  }
+  memset(&STATE->json_fields, 0, sizeof(STATE->json_fields));
+
   // prepare parser
   jsmn_init(&p);
 
@@ -457,6 +800,7 @@ again:
     }
   }
 
+process:
   if (FIELDLEN(type) == 0) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "Missing RIS Live message type");
     goto corrupted;
@@ -516,6 +860,109 @@ unsupported:
   return process_unsupported_message(format, record);
 }
 
+/* -------------------- LINE READING -------------------- */
+
+// get the next line of the stream, in place in the line arena and with the
+// newline replaced by a NUL. the line stays valid until the next call.
+// returns the line length, 0 at the end of the stream and -1 on error
+static int64_t read_line(bgpstream_format_t *format, char **line)
+{
+  size_t len, scanned = 0;
+  char *nl, *tmp;
+  int64_t rc;
+
+  // kafka and websockets deliver exactly one line per message, so there is
+  // nothing to split (and no need to wait for more data than one message)
+  if (format->res->transport_type == BGPSTREAM_RESOURCE_TRANSPORT_KAFKA ||
+      format->res->transport_type == BGPSTREAM_RESOURCE_TRANSPORT_WEBSOCKET) {
+    // a message must fit whole, so the arena cannot start small, but it only
+    // needs to exist while messages are coming in
+    if (STATE->arena == NULL) {
+      if ((STATE->arena = malloc(JSON_BUFLEN)) == NULL) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Could not allocate RIS Live buffer");
+        return -1;
+      }
+      STATE->arena_size = JSON_BUFLEN;
+    }
+    *line = STATE->arena;
+    if ((rc = bgpstream_transport_readline(
+           format->transport, (uint8_t *)STATE->arena, STATE->arena_size)) >
+        0) {
+      STATE->kafka_pos += rc;
+    } else if (rc == 0) {
+      free(STATE->arena);
+      STATE->arena = NULL;
+      STATE->arena_size = 0;
+    }
+    return rc;
+  }
+
+  if (STATE->arena == NULL) {
+    if ((STATE->arena = malloc(JSON_LINE_BUFLEN)) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not allocate RIS Live buffer");
+      return -1;
+    }
+    STATE->arena_size = JSON_LINE_BUFLEN;
+  }
+
+  while (1) {
+    len = STATE->arena_end - STATE->arena_start;
+    *line = STATE->arena + STATE->arena_start;
+    if ((nl = memchr(*line + scanned, '\n', len - scanned)) != NULL) {
+      *nl = '\0';
+      STATE->arena_start += (nl - *line) + 1;
+      scanned = 0;
+      if (nl == *line) {
+        // skip blank lines
+        continue;
+      }
+      return nl - *line;
+    }
+    scanned = len;
+
+    if (STATE->arena_eof != 0) {
+      if (len == 0) {
+        return 0;
+      }
+      // last line without a newline, there is always room for the NUL
+      (*line)[len] = '\0';
+      STATE->arena_start = STATE->arena_end;
+      return len;
+    }
+
+    // move the partial line to the front to make room for more data
+    if (STATE->arena_start != 0) {
+      memmove(STATE->arena, *line, len);
+      STATE->arena_start = 0;
+      STATE->arena_end = len;
+    }
+    if (STATE->arena_end + 1 >= STATE->arena_size) {
+      if (STATE->arena_size >= JSON_MAX_BUFLEN) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "RIS Live line longer than %d bytes",
+                      JSON_MAX_BUFLEN);
+        return -1;
+      }
+      if ((tmp = realloc(STATE->arena, STATE->arena_size * 2)) == NULL) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Could not grow RIS Live line buffer");
+        return -1;
+      }
+      STATE->arena = tmp;
+      STATE->arena_size *= 2;
+    }
+
+    // leave a byte for the NUL of a final unterminated line
+    if ((rc = bgpstream_transport_read(
+           format->transport, (uint8_t *)STATE->arena + STATE->arena_end,
+           STATE->arena_size - STATE->arena_end - 1)) < 0) {
+      return -1;
+    }
+    if (rc == 0) {
+      STATE->arena_eof = 1;
+    }
+    STATE->arena_end += rc;
+  }
+}
+
 /* -------------------- RECORD FILTERING -------------------- */
 
 static bgpstream_parsebgp_check_filter_rc_t
@@ -547,6 +994,171 @@ check_filters(bgpstream_record_t *record, bgpstream_filter_mgr_t *filter_mgr)
   return BGPSTREAM_PARSEBGP_KEEP;
 }
 
+/* -------------------- SUBSCRIPTION -------------------- */
+
+// the server is only asked to filter on prefixes if there are at most this many
+#define SUBSCRIBE_MAX_PFXS 64
+
+// longest AS path expression the server is asked to filter on
+#define SUBSCRIBE_MAX_ASNS 16
+
+#define SUBSCRIBE_BUFLEN 8192
+
+// a "ris_subscribe" message being built
+typedef struct subscribe {
+  char buf[SUBSCRIBE_BUFLEN];
+  size_t len;
+
+  // has the message outgrown the buffer?
+  int overflow;
+
+  // prefixes added so far, and whether any allows more/less specifics
+  int pfx_cnt;
+  int more;
+  int less;
+} subscribe_t;
+
+static void sub_printf(subscribe_t *sub, const char *fmt, ...)
+{
+  va_list ap;
+  int rc;
+
+  if (sub->overflow != 0) {
+    return;
+  }
+  va_start(ap, fmt);
+  rc = vsnprintf(sub->buf + sub->len, sizeof(sub->buf) - sub->len, fmt, ap);
+  va_end(ap);
+  if (rc < 0 || (size_t)rc >= sizeof(sub->buf) - sub->len) {
+    sub->overflow = 1;
+    return;
+  }
+  sub->len += rc;
+}
+
+static bgpstream_patricia_walk_cb_result_t
+sub_add_pfx(const bgpstream_patricia_tree_t *pt,
+            const bgpstream_patricia_node_t *node, void *data)
+{
+  subscribe_t *sub = (subscribe_t *)data;
+  const bgpstream_pfx_t *pfx = bgpstream_patricia_tree_get_pfx(node);
+  char buf[INET6_ADDRSTRLEN + 4];
+
+  if (bgpstream_pfx_snprintf(buf, sizeof(buf), pfx) == NULL) {
+    sub->overflow = 1;
+    return BGPSTREAM_PATRICIA_WALK_END_ALL;
+  }
+  sub_printf(sub, "%s\"%s\"", (sub->pfx_cnt++ == 0) ? "" : ",", buf);
+  if (pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_ANY ||
+      pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_MORE) {
+    sub->more = 1;
+  }
+  if (pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_ANY ||
+      pfx->allowed_matches == BGPSTREAM_PREFIX_MATCH_LESS) {
+    sub->less = 1;
+  }
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+// add the first AS path filter the server can run. the filters must all pass,
+// so matching on any one of them is enough to narrow the stream
+static void sub_add_path(subscribe_t *sub, bgpstream_filter_mgr_t *filter_mgr)
+{
+  uint32_t asns[SUBSCRIBE_MAX_ASNS];
+  int anchor_start, anchor_end;
+  int i, j, cnt;
+
+  for (i = 0; i < filter_mgr->aspath_expr_cnt; i++) {
+    if (filter_mgr->aspath_exprs[i].negate != 0 ||
+        filter_mgr->aspath_exprs[i].match == NULL ||
+        (cnt = bgpstream_as_path_match_get_seq(
+           filter_mgr->aspath_exprs[i].match, asns, SUBSCRIBE_MAX_ASNS,
+           &anchor_start, &anchor_end)) <= 0) {
+      continue;
+    }
+    sub_printf(sub, ",\"path\":\"%s", anchor_start ? "^" : "");
+    for (j = 0; j < cnt; j++) {
+      sub_printf(sub, "%s%" PRIu32, (j == 0) ? "" : ",", asns[j]);
+    }
+    sub_printf(sub, "%s\"", anchor_end ? "$" : "");
+    return;
+  }
+}
+
+// ask the server for the messages that can pass the filters of the stream.
+// the server only narrows the stream down, all the filters still run here
+static int subscribe(bgpstream_format_t *format)
+{
+  bgpstream_filter_mgr_t *filter_mgr = format->filter_mgr;
+  uint8_t upd_types = (1 << BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT) |
+                      (1 << BGPSTREAM_ELEM_TYPE_WITHDRAWAL);
+  uint8_t state_types = 1 << BGPSTREAM_ELEM_TYPE_PEERSTATE;
+  // the elem types found in RIS Live messages that can pass the filters
+  uint8_t types =
+    filter_mgr->elem_prog.elem_types & (upd_types | state_types);
+  subscribe_t *sub;
+  char *host;
+  size_t pfx_start;
+  int rc = -1;
+
+  if ((sub = malloc_zero(sizeof(subscribe_t))) == NULL) {
+    return -1;
+  }
+  sub_printf(sub, "{\"type\":\"ris_subscribe\",\"data\":{"
+                  "\"socketOptions\":{\"includeRaw\":true}");
+
+  // collector names are the RIS hosts
+  if (filter_mgr->collectors != NULL &&
+      bgpstream_str_set_size(filter_mgr->collectors) == 1) {
+    bgpstream_str_set_rewind(filter_mgr->collectors);
+    host = bgpstream_str_set_next(filter_mgr->collectors);
+    if (strpbrk(host, "\"\\") == NULL) {
+      sub_printf(sub, ",\"host\":\"%s\"", host);
+    }
+  }
+
+  if (types != 0 && (types & state_types) == 0) {
+    sub_printf(sub, ",\"type\":\"UPDATE\"");
+
+    // prefixes and paths are only found in updates
+    if (filter_mgr->prefixes != NULL &&
+        bgpstream_patricia_prefix_count(filter_mgr->prefixes,
+                                        BGPSTREAM_ADDR_VERSION_IPV4) +
+            bgpstream_patricia_prefix_count(filter_mgr->prefixes,
+                                            BGPSTREAM_ADDR_VERSION_IPV6) <=
+          SUBSCRIBE_MAX_PFXS) {
+      pfx_start = sub->len;
+      sub_printf(sub, ",\"prefix\":[");
+      bgpstream_patricia_tree_walk(filter_mgr->prefixes, sub_add_pfx, sub);
+      sub_printf(sub, "],\"moreSpecific\":%s,\"lessSpecific\":%s",
+                 sub->more ? "true" : "false", sub->less ? "true" : "false");
+      if (sub->pfx_cnt == 0) {
+        sub->len = pfx_start;
+      }
+    }
+    sub_add_path(sub, filter_mgr);
+  } else if (types == state_types) {
+    sub_printf(sub, ",\"type\":\"RIS_PEER_STATE\"");
+  }
+  sub_printf(sub, "}}");
+
+  if (sub->overflow != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "RIS Live subscription is too long");
+    goto done;
+  }
+  bgpstream_log(BGPSTREAM_LOG_INFO, "Subscribing to RIS Live: %.*s",
+                (int)sub->len, sub->buf);
+  if (bgpstream_transport_write(format->transport, sub->buf, sub->len) < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not subscribe to RIS Live");
+    goto done;
+  }
+  rc = 0;
+
+done:
+  free(sub);
+  return rc;
+}
+
 /* =============================================================== */
 /* =============================================================== */
 /* ==================== PUBLIC API BELOW HERE ==================== */
@@ -562,15 +1174,17 @@ int bs_format_rislive_create(bgpstream_format_t *format,
     return -1;
   }
 
-  if ((STATE->json_string_buffer = malloc(JSON_BUFLEN)) == NULL) {
-    return -1;
-  }
-
   parsebgp_opts_init(&STATE->opts);
   bgpstream_parsebgp_opts_init(&STATE->opts);
+  bgpstream_parsebgp_opts_prune(&STATE->opts, format->filter_mgr);
   STATE->opts.bgp.marker_omitted = 0;
   STATE->opts.bgp.asn_4_byte = 1;
 
+  if (res->transport_type == BGPSTREAM_RESOURCE_TRANSPORT_WEBSOCKET &&
+      subscribe(format) != 0) {
+    return -1;
+  }
+
   return 0;
 }
 
@@ -582,10 +1196,8 @@ bs_format_rislive_populate_record(bgpstream_format_t *format,
   int filter;
 
 retry:
-  STATE->json_string_buffer_len = bgpstream_transport_readline(
-    format->transport, STATE->json_string_buffer, BGPSTREAM_PARSEBGP_BUFLEN);
-
-  assert(STATE->json_string_buffer_len < BGPSTREAM_PARSEBGP_BUFLEN);
+  STATE->json_string_buffer_len =
+    read_line(format, &STATE->json_string_buffer);
 
   if (STATE->json_string_buffer_len < 0) {
     // corrupted record
@@ -613,6 +1225,7 @@ retry:
   }
   // valid message, and it passes our filters
   record->status = BGPSTREAM_RECORD_STATUS_VALID_RECORD;
+  record->__int->position = STATE->kafka_pos;
   return BGPSTREAM_FORMAT_OK;
 }
 
@@ -629,6 +1242,14 @@ int bs_format_rislive_get_next_elem(bgpstream_format_t *format,
 
   switch (RDATA->msg_type) {
   case RISLIVE_MSG_TYPE_UPDATE:
+    // skip the whole message if none of its elems can pass the filters
+    if (RDATA->upd_state.ready == 0 &&
+        bgpstream_parsebgp_update_wanted(format->filter_mgr,
+                                         RDATA->elem->peer_asn,
+                                         RDATA->msg->types.bgp) == 0) {
+      RDATA->end_of_elems = 1;
+      return 0;
+    }
     rc = bgpstream_parsebgp_process_update(&RDATA->upd_state, RDATA->elem,
                                            RDATA->msg->types.bgp);
     if (rc <= 0) {
@@ -702,7 +1323,7 @@ void bs_format_rislive_destroy_data(bgpstream_format_t *format, void *data)
 
 void bs_format_rislive_destroy(bgpstream_format_t *format)
 {
-  free(STATE->json_string_buffer);
+  free(STATE->arena);
   free(format->state);
   format->state = NULL;
 }
@@ -29,70 +29,89 @@
  */
 
 #include "bs_transport_cache.h"
+#include "bs_transport_cache_index.h"
+#include "bs_transport_decompress.h"
 #include "bgpstream_transport_interface.h"
 #include "bgpstream_log.h"
 #include "utils.h"
 #include "wandio.h"
 #include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/stat.h>
-#include <sys/types.h>
 #include <unistd.h>
-#include <stdarg.h>
-#include <errno.h>
 
 #define STATE ((cache_state_t *)(transport->state))
 
-#define CACHE_FILE_SUFFIX ".cache"
-#define CACHE_LOCK_FILE_SUFFIX ".lock"
-#define CACHE_TEMP_FILE_SUFFIX ".temp"
+/* How long to wait (in usec) before checking again whether the writer of an
+   entry we are tailing has written more of it */
+#define TAIL_POLL_USEC 10000
 
 typedef struct cache_state {
+  /** index of the local cache, or NULL if caching is disabled */
+  bs_transport_cache_index_t *index;
+
+  /** key of the resource in the cache index */
+  uint64_t key;
+
+  /** maximum size of the cache (0 for unlimited) */
+  uint64_t max_size;
+
+  /** number of reads after which the resource is cached uncompressed (0 for
+      never) */
+  uint32_t hot_reads;
+
+  /** encoding of the cache file being written */
+  bs_transport_cache_index_encoding_t encoding;
+
   /** absolute path for the local cache file */
   char *cache_file_path;
 
-  /** absolute path for the local cache lock file */
-  char *lock_file_path;
-
   /** absolute path for the local cache temporary file */
   char *temp_file_path;
 
   /** filename or URL of reader */
   char *reader_name;
 
-  /** file descriptor of cache lock file */
-  int lock_fd;
-
   /** content reader, either from local cache or from remote URL */
   io_t *reader;
 
   /** cache content writer, or NULL if we're not writing */
   iow_t *writer;
 
+  /** temporary file of an entry that someone else is writing, which we read
+      as it grows (-1 if we're not tailing) */
+  int tail_fd;
+
+  /** identity of the tailed file, to tell whether it is the one published */
+  dev_t tail_dev;
+  ino_t tail_ino;
+
+  /** decompressor of the tailed file, or NULL if we're not tailing */
+  bs_transport_decompress_t *tail;
+
+  /** number of (decompressed) bytes read from the tailed file */
+  uint64_t tail_off;
+
+  /** set to stop waiting for the writer of the tailed file */
+  int tail_stop;
+
 } cache_state_t;
 
-// Like sprintf(), but first allocate a string large enough to hold the output.
-#ifdef __GNUC__
-__attribute__((format(printf, 2, 3)))
-#endif
-static int bs_asprintf(char **strp, const char *fmt, ...)
+static char *cache_path(bgpstream_transport_t *transport, const char *suffix)
 {
-  va_list ap;
-  va_start(ap, fmt);
-  int len = vsnprintf(NULL, 0, fmt, ap);
-  va_end(ap);
-  if (len < 0 || !(*strp = malloc(len+1))) {
-    *strp = NULL;
-    return -1;
-  }
-  va_start(ap, fmt);
-  len = vsnprintf(*strp, len+1, fmt, ap);
-  va_end(ap);
-  if (len < 0) { // shouldn't happen
-    free(*strp);
-    *strp = NULL;
+  char *path;
+  int len = bs_transport_cache_index_snprintf_path(STATE->index, STATE->key,
+                                                   suffix, NULL, 0);
+
+  if (len < 0 || (path = malloc(len + 1)) == NULL) {
+    return NULL;
   }
-  return len;
+  bs_transport_cache_index_snprintf_path(STATE->index, STATE->key, suffix,
+                                         path, len + 1);
+  return path;
 }
 
 /**
@@ -100,7 +119,7 @@ static int bs_asprintf(char **strp, const char *fmt, ...)
 */
 static int init_state(bgpstream_transport_t *transport)
 {
-  char resource_hash[1024];
+  const char *max_size, *hot_reads;
 
   // allocate memory for cache_state type in transport data structure
   if ((transport->state = malloc_zero(sizeof(cache_state_t))) == NULL) {
@@ -109,18 +128,9 @@ static int init_state(bgpstream_transport_t *transport)
     return -1;
   }
 
-  STATE->lock_fd = -1;
   STATE->reader = NULL;
   STATE->writer = NULL;
-
-  // get a "hash" string from the resource
-  if ((bgpstream_resource_hash_snprintf(resource_hash, sizeof(resource_hash),
-                                        transport->res)) >=
-      sizeof(resource_hash)) {
-    bgpstream_log(BGPSTREAM_LOG_WARN,
-                  "WARNING: Could not get resource hash for cache file naming.");
-    return 0; // not fatal; we can still read, but won't be able to cache
-  }
+  STATE->tail_fd = -1;
 
   // get storage directory path
   const char *cache_dir_path = bgpstream_resource_get_attr(
@@ -131,63 +141,60 @@ static int init_state(bgpstream_transport_t *transport)
     return 0; // not fatal; we can't use cache, but can still read remote
   }
 
-  // set cache file paths (lock_file is last so if that's set we'll know all
-  // three are set)
-  if (bs_asprintf(&STATE->cache_file_path, "%s/%s%s",
-                  cache_dir_path, resource_hash, CACHE_FILE_SUFFIX) < 0 ||
-    bs_asprintf(&STATE->temp_file_path, "%s%s",
-                STATE->cache_file_path, CACHE_TEMP_FILE_SUFFIX) < 0 ||
-    bs_asprintf(&STATE->lock_file_path, "%s%s",
-                STATE->cache_file_path, CACHE_LOCK_FILE_SUFFIX) < 0)
-  {
+  // (the broker has already validated the size)
+  if ((max_size = bgpstream_resource_get_attr(
+         transport->res, BGPSTREAM_RESOURCE_ATTR_CACHE_MAX_SIZE)) != NULL) {
+    STATE->max_size = strtoull(max_size, NULL, 10);
+  }
+  if ((hot_reads = bgpstream_resource_get_attr(
+         transport->res, BGPSTREAM_RESOURCE_ATTR_CACHE_HOT_READS)) != NULL) {
+    STATE->hot_reads = strtoul(hot_reads, NULL, 10);
+  }
+
+  if ((STATE->index = bs_transport_cache_index_get(cache_dir_path)) == NULL) {
+    return 0; // not fatal; we can't use cache, but can still read remote
+  }
+  STATE->key = bs_transport_cache_index_key(transport->res->url);
+
+  if ((STATE->cache_file_path = cache_path(transport, "")) == NULL ||
+      (STATE->temp_file_path = cache_path(transport, ".temp")) == NULL) {
     bgpstream_log(BGPSTREAM_LOG_WARN,
                   "WARNING: Could not set cache file names.");
+    STATE->index = NULL;
     return 0; // not fatal; we can't use cache, but can still read remote
   }
 
   return 0;
 }
 
-static int bs_transport_cache_lock(bgpstream_transport_t *transport)
+static int open_cache_writer(bgpstream_transport_t *transport,
+                             bs_transport_cache_index_encoding_t encoding)
 {
-  // Note: POSIX fcntl(F_SETLK) locks can not synchronize different threads in
-  // the same process.  BSD flock() can, but is not POSIX.
-  struct flock lock;
-
-  if (!STATE->lock_file_path)
-    return -1;
-
-  if ((STATE->lock_fd = open(STATE->lock_file_path, O_CREAT | O_WRONLY, 0644)) < 0) {
-    bgpstream_log(BGPSTREAM_LOG_WARN, "WARNING: can't open lock file %s: %s",
-        STATE->lock_file_path, strerror(errno));
-    return -1;
+  // Create cache file writer using wandio, with compression enabled at
+  // default compression level (ZLib default compression level is 6:
+  // https://zlib.net/manual.html) unless the resource is read often enough
+  // that decompressing it every time is not worth the space.
+  STATE->encoding = encoding;
+  if (encoding == BS_TRANSPORT_CACHE_INDEX_ENCODING_RAW) {
+    STATE->writer = wandio_wcreate(STATE->temp_file_path,
+                                   WANDIO_COMPRESS_NONE, 0, O_CREAT);
+  } else {
+    STATE->writer = wandio_wcreate(STATE->temp_file_path,
+                                   WANDIO_COMPRESS_ZLIB, 6, O_CREAT);
   }
-
-  lock.l_type = F_WRLCK;
-  lock.l_whence = SEEK_SET;
-  lock.l_start = 0;
-  lock.l_len = 0;
-  if (fcntl(STATE->lock_fd, F_SETLK, &lock) < 0) {
-    bgpstream_log(BGPSTREAM_LOG_WARN, "WARNING: can't lock file %s: %s",
-        STATE->lock_file_path, strerror(errno));
-    close(STATE->lock_fd);
-    STATE->lock_fd = -1;
+  if (STATE->writer == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_WARN,
+                  "WARNING: Could not open %s for local caching: %s",
+                  STATE->temp_file_path, strerror(errno));
+    // failing to create the cache is not fatal
+    bs_transport_cache_index_abort(STATE->index, STATE->key);
     return -1;
   }
-
+  bgpstream_log(BGPSTREAM_LOG_FINE, "writing temp cache %s",
+                STATE->temp_file_path);
   return 0;
 }
 
-static void bs_transport_cache_unlock(bgpstream_transport_t *transport)
-{
-  // Note: even if we never explicitly release the lock, it will be released
-  // automatically when the lock_fd closes at program exit (the file will
-  // remain, but it will not be locked).
-  remove(STATE->lock_file_path);
-  close(STATE->lock_fd);
-  STATE->lock_fd = -1;
-}
-
 static int open_cache_reader(bgpstream_transport_t *transport)
 {
   // Create reader that reads from existing local cache file.
@@ -201,71 +208,164 @@ static int open_cache_reader(bgpstream_transport_t *transport)
   return -1;
 }
 
-int bs_transport_cache_create(bgpstream_transport_t *transport)
+// is the writer of the tailed file (still) writing it?
+static int tail_writer_active(bgpstream_transport_t *transport)
 {
-  // reset transport method
-  BS_TRANSPORT_SET_METHODS(cache, transport);
+  struct stat st;
 
-  // initialize cache_state data structure
-  if (init_state(transport) != 0) {
-    return -1;
+  // (an aborted file is unlinked, even if the entry was claimed again since)
+  return bs_transport_cache_index_is_writing(STATE->index, STATE->key) &&
+         fstat(STATE->tail_fd, &st) == 0 && st.st_nlink != 0;
+}
+
+// was the tailed file published whole?
+static int tail_published(bgpstream_transport_t *transport)
+{
+  struct stat st;
+
+  return stat(STATE->cache_file_path, &st) == 0 &&
+         st.st_dev == STATE->tail_dev && st.st_ino == STATE->tail_ino;
+}
+
+// reads raw bytes of the tailed file for its decompressor, waiting for the
+// writer to append more at the end of the file. fails if the writer gives up
+// before it has written the whole file
+static int64_t tail_read(void *user, uint8_t *buffer, int64_t len)
+{
+  bgpstream_transport_t *transport = user;
+  ssize_t ret;
+  int active;
+
+  while (!__atomic_load_n(&STATE->tail_stop, __ATOMIC_RELAXED)) {
+    // (check the writer before reading, so that we have read all it wrote
+    // once we find it is done)
+    active = tail_writer_active(transport);
+    if ((ret = read(STATE->tail_fd, buffer, len)) != 0) {
+      if (ret < 0 && errno == EINTR) {
+        continue;
+      }
+      return ret;
+    }
+    if (!active) {
+      return tail_published(transport) ? 0 : -1;
+    }
+    usleep(TAIL_POLL_USEC);
   }
+  return -1;
+}
 
-  // Check cache access before acquiring the lock, so that most cache readers
-  // never need to lock and multiple cache readers won't block each other.
-  if (STATE->cache_file_path && access(STATE->cache_file_path, R_OK) == 0) {
-    if (open_cache_reader(transport) == 0)
-      return 0; // reading from local cache
+static void close_cache_tail(bgpstream_transport_t *transport)
+{
+  if (STATE->tail_fd < 0) {
+    return;
   }
+  __atomic_store_n(&STATE->tail_stop, 1, __ATOMIC_RELAXED);
+  bs_transport_decompress_destroy(STATE->tail);
+  STATE->tail = NULL;
+  close(STATE->tail_fd);
+  STATE->tail_fd = -1;
+}
+
+static int open_cache_tail(bgpstream_transport_t *transport)
+{
+  struct stat st;
 
-  if (bs_transport_cache_lock(transport) == 0) {
-    // We own the lock.
-    // Check cache access again to avoid a race where another process finished
-    // writing a cache between our first access() and our getting the lock.
-    if (access(STATE->cache_file_path, R_OK) == 0) {
-      // local cache file exists and is readable
-      bs_transport_cache_unlock(transport);
-      if (open_cache_reader(transport) == 0)
-        return 0; // reading from local cache
-    } else if (errno == ENOENT) {
-      // Local cache file doesn't exist.  Hold on to the lock so we can write
-      // to the cache.
-    } else {
-      // local cache file is not readable for some other reason
-      bgpstream_log(BGPSTREAM_LOG_WARN, "WARNING: Could not read cache %s: %s",
-                    STATE->cache_file_path, strerror(errno));
-      bs_transport_cache_unlock(transport);
+  // the writer may not have created the file yet
+  while ((STATE->tail_fd = open(STATE->temp_file_path, O_RDONLY)) < 0) {
+    if (errno != ENOENT ||
+        !bs_transport_cache_index_is_writing(STATE->index, STATE->key)) {
+      return -1;
     }
+    usleep(TAIL_POLL_USEC);
+  }
+  if (fstat(STATE->tail_fd, &st) != 0 ||
+      (STATE->tail = bs_transport_decompress_create(
+         tail_read, transport, transport->res->perf)) == NULL) {
+    close(STATE->tail_fd);
+    STATE->tail_fd = -1;
+    return -1;
   }
+  STATE->tail_dev = st.st_dev;
+  STATE->tail_ino = st.st_ino;
+  STATE->reader_name = STATE->temp_file_path;
+  bgpstream_log(BGPSTREAM_LOG_FINE, "tailing temp cache %s",
+                STATE->temp_file_path);
+  return 0;
+}
 
-  // open reader that reads from remote file
+// open reader that reads from remote file (and the cache writer, if we own
+// the entry)
+static int open_remote(bgpstream_transport_t *transport, int writing)
+{
   STATE->reader_name = transport->res->url;
   if ((STATE->reader = wandio_create(STATE->reader_name)) == NULL) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "ERROR: Could not open %s for reading",
                   STATE->reader_name);
+    if (writing) {
+      bs_transport_cache_index_abort(STATE->index, STATE->key);
+    }
     return -1;
   }
   bgpstream_log(BGPSTREAM_LOG_FINE, "reading remote %s", STATE->reader_name);
 
-  if (STATE->lock_fd >= 0) {
-    // We own the lock.
-    // Create cache file writer using wandio with compression enabled at
-    // default compression level ZLib default compression level is 6:
-    // https://zlib.net/manual.html
-    STATE->writer = wandio_wcreate(STATE->temp_file_path,
-                                   WANDIO_COMPRESS_ZLIB, 6, O_CREAT);
-    if (STATE->writer == NULL) {
-      bgpstream_log(BGPSTREAM_LOG_WARN,
-                    "WARNING: Could not open %s for local caching: %s",
-                    STATE->temp_file_path, strerror(errno));
-      // failing to create the cache is not fatal
-      bs_transport_cache_unlock(transport);
-      return 0; // reading from remote file
+  if (writing) {
+    // We own the entry.
+    open_cache_writer(transport,
+                      STATE->hot_reads == 1
+                        ? BS_TRANSPORT_CACHE_INDEX_ENCODING_RAW
+                        : BS_TRANSPORT_CACHE_INDEX_ENCODING_ZLIB);
+  }
+  return 0;
+}
+
+int bs_transport_cache_create(bgpstream_transport_t *transport)
+{
+  bs_transport_cache_index_encoding_t encoding;
+  uint32_t reads;
+  int writing = 0;
+
+  // reset transport method
+  BS_TRANSPORT_SET_METHODS(cache, transport);
+
+  // initialize cache_state data structure
+  if (init_state(transport) != 0) {
+    return -1;
+  }
+
+  if (STATE->index != NULL) {
+    // Cache hits are found in the index without taking any lock, so that
+    // multiple cache readers never block each other.
+    // (wandio detects the encoding of cache files by itself)
+    if ((reads = bs_transport_cache_index_lookup(STATE->index, STATE->key,
+                                                 &encoding)) != 0 &&
+        open_cache_reader(transport) == 0) {
+      // Hot resources are rewritten uncompressed as we read them, so that
+      // later reads are little more than copies.
+      if (STATE->hot_reads != 0 && reads >= STATE->hot_reads &&
+          encoding != BS_TRANSPORT_CACHE_INDEX_ENCODING_RAW &&
+          bs_transport_cache_index_begin_rewrite(STATE->index, STATE->key) ==
+            1) {
+        open_cache_writer(transport, BS_TRANSPORT_CACHE_INDEX_ENCODING_RAW);
+      }
+      return 0; // reading from local cache
+    }
+    // Claim the entry, unless another process (or thread) is already writing
+    // it (or it was published since our lookup, in which case we just read
+    // remote).
+    writing = (bs_transport_cache_index_begin(STATE->index, STATE->key) == 1);
+
+    // Rather than downloading it again, read what the writer writes as it
+    // writes it (unless it gave up in the meantime).
+    if (!writing &&
+        bs_transport_cache_index_is_writing(STATE->index, STATE->key) &&
+        open_cache_tail(transport) == 0) {
+      return 0; // reading from someone else's temp cache
     }
-    bgpstream_log(BGPSTREAM_LOG_FINE, "writing temp cache %s",
-        STATE->temp_file_path);
   }
 
+  if (open_remote(transport, writing) != 0) {
+    return -1;
+  }
   return 0; // reading from remote file
 }
 
@@ -286,28 +386,65 @@ static void close_cache_writer(bgpstream_transport_t *transport, int valid)
   STATE->writer = NULL;
 
   if (valid) {
-    // rename temporary file to cache file
-    if (rename(STATE->temp_file_path, STATE->cache_file_path) != 0) {
-      bgpstream_log(BGPSTREAM_LOG_WARN, "WARNING: failed to rename %s: %s",
-                    STATE->temp_file_path, strerror(errno));
+    // publish the cache file (evicting others to make room for it)
+    if (bs_transport_cache_index_commit(STATE->index, STATE->key,
+                                        STATE->encoding,
+                                        STATE->max_size) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_FINE, "not caching %s",
+                    transport->res->url);
     }
 
   } else {
     // the cache is incomplete or corrupt; remove temporary file
-    if (remove(STATE->temp_file_path) != 0) {
-      bgpstream_log(BGPSTREAM_LOG_WARN, "WARNING: failed to remove %s: %s",
-                    STATE->temp_file_path, strerror(errno));
-    }
+    bs_transport_cache_index_abort(STATE->index, STATE->key);
   }
+}
 
-  bs_transport_cache_unlock(transport);
+// skip the given number of bytes of the remote file (caching them if we own
+// the entry)
+static int skip_remote(bgpstream_transport_t *transport, uint64_t len)
+{
+  uint8_t buf[4096];
+  int64_t ret;
+
+  while (len > 0) {
+    if ((ret = bs_transport_cache_read(
+           transport, buf, len < sizeof(buf) ? len : sizeof(buf))) <= 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR,
+                    "ERROR: Could not skip to where the temp cache of %s ended",
+                    transport->res->url);
+      return -1;
+    }
+    len -= ret;
+  }
+  return 0;
 }
 
 int64_t bs_transport_cache_read(bgpstream_transport_t *transport,
                                 uint8_t *buffer, int64_t len)
 {
+  int64_t ret;
+
+  if (STATE->tail != NULL) {
+    if ((ret = bs_transport_decompress_read(STATE->tail, buffer, len)) >= 0) {
+      STATE->tail_off += ret;
+      return ret;
+    }
+    // the writer gave up on the entry (or died), so read (and maybe cache)
+    // the rest ourselves
+    bgpstream_log(BGPSTREAM_LOG_WARN,
+                  "WARNING: temp cache %s was abandoned, reading remote %s",
+                  STATE->temp_file_path, transport->res->url);
+    close_cache_tail(transport);
+    if (open_remote(transport, bs_transport_cache_index_begin(
+                                 STATE->index, STATE->key) == 1) != 0 ||
+        skip_remote(transport, STATE->tail_off) != 0) {
+      return -1;
+    }
+  }
+
   // read content
-  int64_t ret = wandio_read(STATE->reader, buffer, len);
+  ret = wandio_read(STATE->reader, buffer, len);
 
   if (ret < 0) {
     // reader encountered an error
@@ -352,6 +489,8 @@ void bs_transport_cache_destroy(bgpstream_transport_t *transport)
     bs_transport_cache_read(transport, buf, sizeof(buf));
   }
 
+  close_cache_tail(transport);
+
   // close reader
   if (STATE->reader != NULL) {
     wandio_destroy(STATE->reader);
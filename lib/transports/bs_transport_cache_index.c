@@ -0,0 +1,590 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bs_transport_cache_index.h"
+#include "bgpstream_log.h"
+#include "utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Index file magic number ("BSCI") and version */
+#define INDEX_MAGIC 0x42534349
+#define INDEX_VERSION 2
+
+/** Name of the index file within the cache directory. The version is part of
+    the name so that processes using different layouts never share (and
+    resize) the same mapping */
+#define INDEX_FILE_NAME "bgpstream-cache-2.idx"
+
+/** Number of slots in the index (i.e., the maximum number of entries). Must
+    be a power of two */
+#define INDEX_SLOT_CNT (1 << 16)
+
+#define CACHE_FILE_SUFFIX ".cache"
+#define TEMP_FILE_SUFFIX ".temp"
+
+typedef enum {
+  SLOT_EMPTY = 0,
+  SLOT_WRITING = 1,
+  SLOT_READY = 2,
+  SLOT_DELETED = 3,
+} slot_state_t;
+
+/** One entry of the index (as stored in the index file) */
+typedef struct index_slot {
+
+  /** Key of the entry */
+  uint64_t key;
+
+  /** Size of the cache file (READY entries only) */
+  uint64_t size;
+
+  /** Value of the index clock when the entry was last used */
+  uint64_t last_use;
+
+  /** State of the slot (slot_state_t) */
+  uint32_t state;
+
+  /** PID of the process writing (or rewriting) the entry, 0 if none */
+  uint32_t owner;
+
+  /** Number of times the entry has been read */
+  uint32_t reads;
+
+  /** Encoding of the cache file (bs_transport_cache_index_encoding_t) */
+  uint16_t encoding;
+
+  /** Version of the encoding (BS_TRANSPORT_CACHE_INDEX_FORMAT_VERSION) */
+  uint16_t version;
+
+} index_slot_t;
+
+/** Header of the index file */
+typedef struct index_hdr {
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slot_cnt;
+  uint32_t unused;
+
+  /** Total size of the READY entries */
+  uint64_t total_size;
+
+  /** Incremented each time an entry is used */
+  uint64_t clock;
+
+} index_hdr_t;
+
+struct bs_transport_cache_index {
+
+  /** Path to the cache directory */
+  char *dir;
+
+  /** Index file, and its (shared) mapping */
+  int fd;
+  void *map;
+  size_t map_len;
+  index_hdr_t *hdr;
+  index_slot_t *slots;
+
+  /** Serializes updates within this process (fcntl locks only exclude other
+      processes) */
+  pthread_mutex_t mutex;
+
+  /** Next index in the list of open indexes */
+  struct bs_transport_cache_index *next;
+};
+
+/* All indexes opened by this process */
+static pthread_mutex_t indexes_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bs_transport_cache_index_t *indexes = NULL;
+
+static int file_lock(int fd, short type)
+{
+  struct flock lock;
+
+  lock.l_type = type;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = 0;
+  lock.l_len = 0;
+  while (fcntl(fd, F_SETLKW, &lock) < 0) {
+    if (errno != EINTR) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int index_lock(bs_transport_cache_index_t *index)
+{
+  pthread_mutex_lock(&index->mutex);
+  if (file_lock(index->fd, F_WRLCK) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_WARN, "WARNING: can't lock cache index: %s",
+                  strerror(errno));
+    pthread_mutex_unlock(&index->mutex);
+    return -1;
+  }
+  return 0;
+}
+
+static void index_unlock(bs_transport_cache_index_t *index)
+{
+  file_lock(index->fd, F_UNLCK);
+  pthread_mutex_unlock(&index->mutex);
+}
+
+static bs_transport_cache_index_t *index_open(const char *dir)
+{
+  bs_transport_cache_index_t *index;
+  struct stat st;
+  char *path = NULL;
+  int locked = 0;
+  size_t len;
+
+  if ((index = malloc_zero(sizeof(bs_transport_cache_index_t))) == NULL ||
+      (index->dir = strdup(dir)) == NULL) {
+    goto err;
+  }
+  index->fd = -1;
+  index->map = MAP_FAILED;
+  pthread_mutex_init(&index->mutex, NULL);
+  index->map_len = sizeof(index_hdr_t) + sizeof(index_slot_t) * INDEX_SLOT_CNT;
+
+  len = strlen(dir) + sizeof("/" INDEX_FILE_NAME);
+  if ((path = malloc(len)) == NULL) {
+    goto err;
+  }
+  snprintf(path, len, "%s/%s", dir, INDEX_FILE_NAME);
+
+  if ((index->fd = open(path, O_RDWR | O_CREAT, 0644)) < 0) {
+    bgpstream_log(BGPSTREAM_LOG_WARN, "WARNING: can't open cache index %s: %s",
+                  path, strerror(errno));
+    goto err;
+  }
+
+  // whoever gets the lock first initializes the index
+  if (file_lock(index->fd, F_WRLCK) != 0 || fstat(index->fd, &st) != 0) {
+    goto err;
+  }
+  locked = 1;
+  if (st.st_size == 0 && ftruncate(index->fd, index->map_len) != 0) {
+    goto err;
+  }
+  if (st.st_size != 0 && (size_t)st.st_size != index->map_len) {
+    bgpstream_log(BGPSTREAM_LOG_WARN,
+                  "WARNING: cache index %s has an unexpected size", path);
+    goto err;
+  }
+  if ((index->map = mmap(NULL, index->map_len, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, index->fd, 0)) == MAP_FAILED) {
+    goto err;
+  }
+  index->hdr = (index_hdr_t *)index->map;
+  index->slots = (index_slot_t *)(index->hdr + 1);
+
+  if (index->hdr->magic == 0) {
+    // new (zero-filled) index
+    index->hdr->version = INDEX_VERSION;
+    index->hdr->slot_cnt = INDEX_SLOT_CNT;
+    index->hdr->magic = INDEX_MAGIC;
+  } else if (index->hdr->magic != INDEX_MAGIC ||
+             index->hdr->version != INDEX_VERSION ||
+             index->hdr->slot_cnt != INDEX_SLOT_CNT) {
+    bgpstream_log(BGPSTREAM_LOG_WARN,
+                  "WARNING: cache index %s has an unsupported format", path);
+    goto err;
+  }
+
+  file_lock(index->fd, F_UNLCK);
+  free(path);
+  return index;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_WARN, "WARNING: local cache in %s disabled",
+                dir);
+  if (index != NULL) {
+    if (index->map != MAP_FAILED) {
+      munmap(index->map, index->map_len);
+    }
+    if (index->fd >= 0) {
+      if (locked) {
+        file_lock(index->fd, F_UNLCK);
+      }
+      close(index->fd);
+    }
+    pthread_mutex_destroy(&index->mutex);
+    free(index->dir);
+    free(index);
+  }
+  free(path);
+  return NULL;
+}
+
+// finds the slot of the given key (lock-free). if free is given, it is set to
+// the first slot that a new entry with this key could use (NULL if the index
+// is full)
+static index_slot_t *find_slot(bs_transport_cache_index_t *index, uint64_t key,
+                               index_slot_t **free)
+{
+  index_slot_t *slot;
+  uint32_t state, i;
+
+  if (free != NULL) {
+    *free = NULL;
+  }
+  for (i = 0; i < INDEX_SLOT_CNT; i++) {
+    slot = &index->slots[(key + i) & (INDEX_SLOT_CNT - 1)];
+    // (slots are published by writing the key before the state)
+    state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+    if (state == SLOT_EMPTY || state == SLOT_DELETED) {
+      if (free != NULL && *free == NULL) {
+        *free = slot;
+      }
+      if (state == SLOT_EMPTY) {
+        // deleted slots never become empty again, so the key is not further
+        return NULL;
+      }
+      continue;
+    }
+    if (__atomic_load_n(&slot->key, __ATOMIC_RELAXED) == key) {
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+static void set_state(index_slot_t *slot, slot_state_t state)
+{
+  __atomic_store_n(&slot->state, state, __ATOMIC_RELEASE);
+}
+
+// whether the owner of a slot is (still) writing it
+static int owner_alive(index_slot_t *slot)
+{
+  return slot->owner != 0 &&
+         (slot->owner == (uint32_t)getpid() ||
+          kill((pid_t)slot->owner, 0) == 0 || errno == EPERM);
+}
+
+static uint64_t tick(bs_transport_cache_index_t *index)
+{
+  return __atomic_add_fetch(&index->hdr->clock, 1, __ATOMIC_RELAXED);
+}
+
+static void remove_file(bs_transport_cache_index_t *index, uint64_t key,
+                        const char *suffix)
+{
+  char path[4096];
+
+  if (bs_transport_cache_index_snprintf_path(index, key, suffix, path,
+                                             sizeof(path)) <
+        (int)sizeof(path) &&
+      remove(path) != 0 && errno != ENOENT) {
+    bgpstream_log(BGPSTREAM_LOG_WARN, "WARNING: failed to remove %s: %s",
+                  path, strerror(errno));
+  }
+}
+
+// evicts least recently used entries (other than keep) until size more bytes
+// fit in the budget. called with the lock held
+static void evict(bs_transport_cache_index_t *index, index_slot_t *keep,
+                  uint64_t size, uint64_t max_size)
+{
+  index_slot_t *victim;
+  uint32_t i;
+
+  while (index->hdr->total_size + size > max_size) {
+    victim = NULL;
+    for (i = 0; i < INDEX_SLOT_CNT; i++) {
+      if (index->slots[i].state == SLOT_READY && &index->slots[i] != keep &&
+          (victim == NULL ||
+           index->slots[i].last_use < victim->last_use)) {
+        victim = &index->slots[i];
+      }
+    }
+    if (victim == NULL) {
+      break;
+    }
+    // mark the entry deleted before removing its file, so that new readers
+    // never find an entry without a file (existing readers keep theirs open)
+    set_state(victim, SLOT_DELETED);
+    index->hdr->total_size -= victim->size;
+    remove_file(index, victim->key, "");
+    bgpstream_log(BGPSTREAM_LOG_FINE, "evicted cache entry %016" PRIx64,
+                  victim->key);
+  }
+}
+
+/* ========== PUBLIC FUNCTIONS BELOW ========== */
+
+bs_transport_cache_index_t *bs_transport_cache_index_get(const char *dir)
+{
+  bs_transport_cache_index_t *index;
+
+  pthread_mutex_lock(&indexes_mutex);
+  for (index = indexes; index != NULL; index = index->next) {
+    if (strcmp(index->dir, dir) == 0) {
+      break;
+    }
+  }
+  if (index == NULL && (index = index_open(dir)) != NULL) {
+    index->next = indexes;
+    indexes = index;
+  }
+  pthread_mutex_unlock(&indexes_mutex);
+
+  return index;
+}
+
+uint64_t bs_transport_cache_index_key(const char *url)
+{
+  // 64-bit FNV-1a
+  uint64_t hash = 0xcbf29ce484222325ULL;
+
+  for (; *url != '\0'; url++) {
+    hash ^= (uint8_t)*url;
+    hash *= 0x100000001b3ULL;
+  }
+  return (hash == 0) ? 1 : hash;
+}
+
+int bs_transport_cache_index_snprintf_path(bs_transport_cache_index_t *index,
+                                           uint64_t key, const char *suffix,
+                                           char *buf, size_t len)
+{
+  return snprintf(buf, len, "%s/%016" PRIx64 CACHE_FILE_SUFFIX "%s",
+                  index->dir, key, suffix);
+}
+
+uint32_t bs_transport_cache_index_lookup(
+  bs_transport_cache_index_t *index, uint64_t key,
+  bs_transport_cache_index_encoding_t *encoding)
+{
+  index_slot_t *slot = find_slot(index, key, NULL);
+
+  if (slot == NULL ||
+      __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != SLOT_READY ||
+      slot->version != BS_TRANSPORT_CACHE_INDEX_FORMAT_VERSION) {
+    return 0;
+  }
+  // (racing updates of last_use are harmless: one of them wins)
+  __atomic_store_n(&slot->last_use, tick(index), __ATOMIC_RELAXED);
+  *encoding = __atomic_load_n(&slot->encoding, __ATOMIC_RELAXED);
+  return __atomic_add_fetch(&slot->reads, 1, __ATOMIC_RELAXED);
+}
+
+int bs_transport_cache_index_begin(bs_transport_cache_index_t *index,
+                                   uint64_t key)
+{
+  index_slot_t *slot, *free;
+  char path[4096];
+  int ret = 0;
+
+  if (index_lock(index) != 0) {
+    return -1;
+  }
+
+  if ((slot = find_slot(index, key, &free)) != NULL) {
+    if (slot->state == SLOT_READY) {
+      // a published entry whose file went missing (or that was written with
+      // another format version) may be rewritten
+      if (slot->version == BS_TRANSPORT_CACHE_INDEX_FORMAT_VERSION &&
+          (bs_transport_cache_index_snprintf_path(index, key, "", path,
+                                                  sizeof(path)) >=
+             (int)sizeof(path) ||
+           access(path, F_OK) == 0)) {
+        goto done;
+      }
+      if (owner_alive(slot)) {
+        // being rewritten by a live process
+        goto done;
+      }
+      index->hdr->total_size -= slot->size;
+    } else if (owner_alive(slot)) {
+      // being written by a live process
+      goto done;
+    }
+    // (otherwise the writer died: take over its entry)
+  } else if ((slot = free) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_WARN, "WARNING: cache index is full");
+    goto done;
+  }
+
+  // (a slot that was READY must be hidden before it changes)
+  set_state(slot, SLOT_DELETED);
+  slot->key = key;
+  slot->size = 0;
+  slot->owner = (uint32_t)getpid();
+  slot->reads = 1;
+  slot->last_use = tick(index);
+  set_state(slot, SLOT_WRITING);
+  ret = 1;
+
+done:
+  index_unlock(index);
+  if (ret == 1) {
+    // a previous writer may have left a partial file behind
+    remove_file(index, key, TEMP_FILE_SUFFIX);
+  }
+  return ret;
+}
+
+int bs_transport_cache_index_is_writing(bs_transport_cache_index_t *index,
+                                        uint64_t key)
+{
+  index_slot_t *slot = find_slot(index, key, NULL);
+
+  return slot != NULL &&
+         __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) == SLOT_WRITING &&
+         owner_alive(slot);
+}
+
+int bs_transport_cache_index_begin_rewrite(bs_transport_cache_index_t *index,
+                                           uint64_t key)
+{
+  index_slot_t *slot;
+  int ret = 0;
+
+  if (index_lock(index) != 0) {
+    return -1;
+  }
+  if ((slot = find_slot(index, key, NULL)) != NULL &&
+      slot->state == SLOT_READY &&
+      slot->version == BS_TRANSPORT_CACHE_INDEX_FORMAT_VERSION &&
+      !owner_alive(slot)) {
+    slot->owner = (uint32_t)getpid();
+    ret = 1;
+  }
+  index_unlock(index);
+
+  if (ret == 1) {
+    remove_file(index, key, TEMP_FILE_SUFFIX);
+  }
+  return ret;
+}
+
+int bs_transport_cache_index_commit(bs_transport_cache_index_t *index,
+                                    uint64_t key,
+                                    bs_transport_cache_index_encoding_t encoding,
+                                    uint64_t max_size)
+{
+  index_slot_t *slot;
+  char temp_path[4096], path[4096];
+  struct stat st;
+  int rewrite;
+  int ret = -1;
+
+  if (bs_transport_cache_index_snprintf_path(index, key, TEMP_FILE_SUFFIX,
+                                             temp_path, sizeof(temp_path)) >=
+        (int)sizeof(temp_path) ||
+      bs_transport_cache_index_snprintf_path(index, key, "", path,
+                                             sizeof(path)) >=
+        (int)sizeof(path) ||
+      index_lock(index) != 0) {
+    goto out;
+  }
+
+  if ((slot = find_slot(index, key, NULL)) == NULL ||
+      (slot->state != SLOT_WRITING && slot->state != SLOT_READY) ||
+      slot->owner != (uint32_t)getpid()) {
+    goto done;
+  }
+  rewrite = (slot->state == SLOT_READY);
+
+  if (stat(temp_path, &st) != 0 ||
+      (max_size != 0 && (uint64_t)st.st_size > max_size)) {
+    bgpstream_log(BGPSTREAM_LOG_FINE, "not caching %s (too large)", path);
+    goto fail;
+  }
+  if (rewrite) {
+    // (the previous file is replaced)
+    index->hdr->total_size -= slot->size;
+  }
+  if (max_size != 0) {
+    evict(index, slot, st.st_size, max_size);
+  }
+  if (rename(temp_path, path) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_WARN, "WARNING: failed to rename %s: %s",
+                  temp_path, strerror(errno));
+    if (rewrite) {
+      index->hdr->total_size += slot->size;
+    }
+    goto fail;
+  }
+
+  slot->size = st.st_size;
+  slot->encoding = encoding;
+  slot->version = BS_TRANSPORT_CACHE_INDEX_FORMAT_VERSION;
+  slot->owner = 0;
+  slot->last_use = tick(index);
+  set_state(slot, SLOT_READY);
+  index->hdr->total_size += st.st_size;
+  ret = 0;
+  goto done;
+
+fail:
+  if (rewrite) {
+    slot->owner = 0;
+  } else {
+    set_state(slot, SLOT_DELETED);
+  }
+
+done:
+  index_unlock(index);
+out:
+  if (ret != 0) {
+    remove_file(index, key, TEMP_FILE_SUFFIX);
+  }
+  return ret;
+}
+
+void bs_transport_cache_index_abort(bs_transport_cache_index_t *index,
+                                    uint64_t key)
+{
+  index_slot_t *slot;
+
+  if (index_lock(index) == 0) {
+    if ((slot = find_slot(index, key, NULL)) != NULL &&
+        slot->owner == (uint32_t)getpid()) {
+      if (slot->state == SLOT_WRITING) {
+        set_state(slot, SLOT_DELETED);
+      } else if (slot->state == SLOT_READY) {
+        slot->owner = 0;
+      }
+    }
+    index_unlock(index);
+  }
+  remove_file(index, key, TEMP_FILE_SUFFIX);
+}
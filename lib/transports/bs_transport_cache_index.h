@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BS_TRANSPORT_CACHE_INDEX_H
+#define __BS_TRANSPORT_CACHE_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Shared index of a local cache directory
+ *
+ * Each cache directory has an index file (memory-mapped by every process
+ * that uses the directory) that records which entries are complete, their
+ * size, and when they were last used. Cache hits are found in the index
+ * without scanning the directory or taking any lock; adding and evicting
+ * entries takes a single lock on the index file. Entries are evicted, least
+ * recently used first, to keep the directory within a byte budget.
+ *
+ * Entries are keyed by a hash of the resource URL (archive dumps never change
+ * once published), and stored as "<key>.cache" files in the directory.
+ *
+ * Each entry records how its content is encoded, and the version of that
+ * encoding: entries written with another version are treated as missing (and
+ * rewritten). Entries are also counted each time they are read, so that
+ * frequently read entries can be rewritten with a faster encoding.
+ */
+
+/** Version of the cache file encodings. Must be incremented whenever the
+    content of cache files changes in an incompatible way */
+#define BS_TRANSPORT_CACHE_INDEX_FORMAT_VERSION 1
+
+/** Encodings of the content of cache files */
+typedef enum {
+
+  /** Decompressed content, recompressed with zlib (gzip) */
+  BS_TRANSPORT_CACHE_INDEX_ENCODING_ZLIB = 1,
+
+  /** Uncompressed content */
+  BS_TRANSPORT_CACHE_INDEX_ENCODING_RAW = 2,
+
+} bs_transport_cache_index_encoding_t;
+
+/** Opaque structure representing the index of a cache directory */
+typedef struct bs_transport_cache_index bs_transport_cache_index_t;
+
+/** Get the index of the given cache directory, creating it if needed
+ *
+ * @param dir           path to the cache directory
+ * @return borrowed pointer to the index, NULL if an error occurred
+ *
+ * Indexes are shared by all transports of the process and are never
+ * destroyed.
+ */
+bs_transport_cache_index_t *bs_transport_cache_index_get(const char *dir);
+
+/** Compute the cache key of a resource
+ *
+ * @param url           URL of the resource
+ * @return key of the resource (never 0)
+ */
+uint64_t bs_transport_cache_index_key(const char *url);
+
+/** Write the path of a cache file to the given buffer
+ *
+ * @param index         pointer to a cache index
+ * @param key           key of the entry
+ * @param suffix        suffix to append to the file name ("" for the cache file
+ *                      itself, ".temp" for its temporary file)
+ * @param buf           buffer to write the path to
+ * @param len           length of the buffer
+ * @return the number of characters that would have been written if len was
+ * unlimited
+ */
+int bs_transport_cache_index_snprintf_path(bs_transport_cache_index_t *index,
+                                           uint64_t key, const char *suffix,
+                                           char *buf, size_t len);
+
+/** Look up (and mark as used) a complete entry
+ *
+ * @param index         pointer to a cache index
+ * @param key           key of the entry
+ * @param[out] encoding set to the encoding of the entry (if found)
+ * @return the number of times the entry has been read (including this one) if
+ * it is in the cache, 0 otherwise
+ */
+uint32_t bs_transport_cache_index_lookup(
+  bs_transport_cache_index_t *index, uint64_t key,
+  bs_transport_cache_index_encoding_t *encoding);
+
+/** Claim an entry so that this process may write it
+ *
+ * @param index         pointer to a cache index
+ * @param key           key of the entry
+ * @return 1 if the entry was claimed, 0 if it is already in the cache, being
+ * written by another process (or thread), or the index is full, -1 if an error
+ * occurred
+ */
+int bs_transport_cache_index_begin(bs_transport_cache_index_t *index,
+                                   uint64_t key);
+
+/** Check whether an entry is being written (lock-free)
+ *
+ * @param index         pointer to a cache index
+ * @param key           key of the entry
+ * @return 1 if a live process (possibly this one) is writing the entry for the
+ * first time, 0 otherwise
+ *
+ * While an entry is being written, its temporary file only ever grows, so
+ * other readers may read it as it is written instead of fetching the resource
+ * themselves. Once the entry is no longer being written, the file has either
+ * been published or abandoned (and unlinked).
+ */
+int bs_transport_cache_index_is_writing(bs_transport_cache_index_t *index,
+                                        uint64_t key);
+
+/** Claim a complete entry so that this process may rewrite it (with another
+ * encoding)
+ *
+ * @param index         pointer to a cache index
+ * @param key           key of the entry
+ * @return 1 if the entry was claimed, 0 if it is not in the cache or is
+ * already being rewritten, -1 if an error occurred
+ *
+ * The entry remains readable while it is rewritten.
+ */
+int bs_transport_cache_index_begin_rewrite(bs_transport_cache_index_t *index,
+                                           uint64_t key);
+
+/** Publish a claimed entry whose content has been written to its temporary
+ * file
+ *
+ * @param index         pointer to a cache index
+ * @param key           key of the entry
+ * @param encoding      encoding of the temporary file
+ * @param max_size      byte budget of the cache (0 for unlimited)
+ * @return 0 if the entry was published, -1 otherwise
+ *
+ * The temporary file is renamed into place, and (other) least recently used
+ * entries are evicted until the cache fits the budget. Entries larger than the
+ * budget are dropped (a rewritten entry keeps its previous file instead).
+ */
+int bs_transport_cache_index_commit(bs_transport_cache_index_t *index,
+                                    uint64_t key,
+                                    bs_transport_cache_index_encoding_t encoding,
+                                    uint64_t max_size);
+
+/** Release a claimed entry without publishing it
+ *
+ * @param index         pointer to a cache index
+ * @param key           key of the entry
+ *
+ * The temporary file (if any) is removed. A rewritten entry keeps its previous
+ * content.
+ */
+void bs_transport_cache_index_abort(bs_transport_cache_index_t *index,
+                                    uint64_t key);
+
+#endif /* __BS_TRANSPORT_CACHE_INDEX_H */
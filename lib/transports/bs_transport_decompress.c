@@ -0,0 +1,941 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bs_transport_decompress.h"
+#include "bgpstream_affinity.h"
+#include "bgpstream_log.h"
+#include "bgpstream_perf.h"
+#include "bgpstream_worker_pool.h"
+#include "utils.h"
+#include <assert.h>
+#include <bzlib.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/** Size of the buffer of raw bytes waiting to be decompressed (gzip) */
+#define DECOMPRESS_IN_LEN (1024 * 1024)
+
+/** Number of raw bytes to read at a time when splitting bzip2 blocks */
+#define DECOMPRESS_BZ_READ_LEN (256 * 1024)
+
+/** Size of each block of gzip output handed to the consumer */
+#define DECOMPRESS_OUT_LEN (1024 * 1024)
+
+/** Number of bytes needed to detect the compression type */
+#define DECOMPRESS_MAGIC_LEN BS_TRANSPORT_DECOMPRESS_MAGIC_LEN
+
+/** Maximum number of blocks in flight per stream (the actual number is the
+    number of pool threads plus two, so that every worker can be busy while
+    the consumer reads) */
+#define DECOMPRESS_MAX_BLOCKS 18
+
+/** Maximum number of threads in the (process-wide) decompression pool */
+#define DECOMPRESS_MAX_THREADS 16
+
+/** bzip2 block header and end-of-stream magic numbers (48 bits each) */
+#define BZ_BLOCK_MAGIC 0x314159265359ULL
+#define BZ_EOS_MAGIC 0x177245385090ULL
+#define BZ_MAGIC_MASK 0xffffffffffffULL
+
+/** Size of the bzip2 stream header ("BZh" and the block size digit) */
+#define BZ_HDR_LEN 4
+
+/** Number of bits at the start of a bzip2 block (or end-of-stream marker)
+    taken by the magic number and CRC */
+#define BZ_MAGIC_CRC_BITS 80
+
+/** Maximum number of adjacent bzip2 blocks merged when recovering from a
+    block magic number that appears inside compressed data */
+#define BZ_MAX_MERGE 8
+
+typedef enum {
+  DECOMPRESS_NONE,
+  DECOMPRESS_GZIP,
+  DECOMPRESS_BZIP2,
+} decompress_type_t;
+
+typedef enum {
+
+  /** Being filled by the producer (or waiting for a worker) */
+  BLOCK_PENDING,
+
+  /** Output is ready to be read */
+  BLOCK_DONE,
+
+  /** Decompression failed */
+  BLOCK_FAILED,
+
+} block_state_t;
+
+/** One block of output, and (for bzip2) the compressed block it comes from */
+typedef struct dec_block {
+
+  /** Back-pointer to the decompressor */
+  struct bs_transport_decompress *dec;
+
+  /** Worker pool job that decompresses this block */
+  bgpstream_worker_pool_job_t job;
+
+  /** State of the block (MUST USE MUTEX) */
+  block_state_t state;
+
+  /** Compressed block (bzip2 only): bits[0..bits_len) (in bits), starting with
+      the block magic, along with the block size digit and block CRC */
+  uint8_t *bits;
+  uint64_t bits_len;
+  size_t bits_alloc;
+  uint8_t level;
+  uint32_t crc;
+
+  /** Decompressed data: out[out_off..out_len) has not been read yet */
+  uint8_t *out;
+  size_t out_off;
+  size_t out_len;
+  size_t out_alloc;
+
+} dec_block_t;
+
+struct bs_transport_decompress {
+
+  /** Callback (and its user pointer) to read raw bytes with */
+  bs_transport_decompress_read_cb_t *read_cb;
+  void *user;
+
+  /** Accounting object that decompression is timed with (may be NULL) */
+  bgpstream_perf_t *perf;
+
+  /** Compression type, detected on the first read */
+  decompress_type_t type;
+  int detected;
+
+  /** Raw bytes read but not yet decompressed: in[in_off..in_len) */
+  uint8_t *in;
+  size_t in_off;
+  size_t in_len;
+  size_t in_alloc;
+
+  /** Has the raw stream reached EOF? */
+  int eof;
+
+  /** gzip state (producer thread only) */
+  z_stream zs;
+  int zs_init;
+  int zs_done;
+  int zs_pending;
+
+  /** Producer thread: inflates gzip data, or splits bzip2 data into blocks
+      for the worker pool */
+  pthread_t producer;
+  int producer_started;
+
+  /** Ring of blocks, read in order by the consumer */
+  dec_block_t blocks[DECOMPRESS_MAX_BLOCKS];
+  int blocks_cnt;
+
+  // ALL BELOW HERE MUST USE MUTEX
+  pthread_mutex_t mutex;
+
+  /** Signalled whenever a block changes state, or a slot is freed */
+  pthread_cond_t cond;
+
+  /** Sequence numbers of the next block to read, and to produce */
+  uint64_t head;
+  uint64_t tail;
+
+  /** Set by the producer when it has produced its last block */
+  int finished;
+
+  /** Set by the producer if the stream could not be decompressed */
+  int error;
+
+  /** Set when the decompressor is being destroyed */
+  int shutdown;
+};
+
+/* Pool of threads shared by all decompressors of the process, so that many
+   open resources do not each start a thread per core. It is separate from the
+   resource manager's pool because readers running there block on our
+   output. */
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static bgpstream_worker_pool_t *pool = NULL;
+static int pool_threads = 1;
+
+static void pool_init(void)
+{
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+  pool_threads = (cores < 1) ? 1 : (cores > DECOMPRESS_MAX_THREADS)
+                                     ? DECOMPRESS_MAX_THREADS
+                                     : (int)cores;
+
+  if ((pool = bgpstream_worker_pool_create(pool_threads, NULL)) == NULL) {
+    // not fatal: bzip2 blocks are then decompressed by the producer thread
+    bgpstream_log(BGPSTREAM_LOG_WARN, "Could not create decompression pool");
+  }
+}
+
+static decompress_type_t detect_type(const uint8_t *buf, size_t len)
+{
+  if (len >= 2 && buf[0] == 0x1f && buf[1] == 0x8b) {
+    return DECOMPRESS_GZIP;
+  }
+  if (len >= 3 && memcmp(buf, "BZh", 3) == 0) {
+    return DECOMPRESS_BZIP2;
+  }
+  return DECOMPRESS_NONE;
+}
+
+static int reserve(uint8_t **buf, size_t *alloc, size_t len)
+{
+  uint8_t *tmp;
+  size_t new_alloc = (*alloc == 0) ? 4096 : *alloc;
+
+  if (len <= *alloc) {
+    return 0;
+  }
+  while (new_alloc < len) {
+    new_alloc *= 2;
+  }
+  if ((tmp = realloc(*buf, new_alloc)) == NULL) {
+    return -1;
+  }
+  *buf = tmp;
+  *alloc = new_alloc;
+  return 0;
+}
+
+// drops consumed raw bytes, then reads until at least min bytes are buffered
+// or EOF is reached. returns the number of bytes buffered, or -1 on error
+static int64_t fill(bs_transport_decompress_t *dec, size_t min, size_t chunk)
+{
+  int64_t ret;
+
+  if (dec->in_off > 0) {
+    memmove(dec->in, dec->in + dec->in_off, dec->in_len - dec->in_off);
+    dec->in_len -= dec->in_off;
+    dec->in_off = 0;
+  }
+
+  while (dec->in_len < min && !dec->eof) {
+    if (reserve(&dec->in, &dec->in_alloc, dec->in_len + chunk) != 0) {
+      return -1;
+    }
+    if ((ret = dec->read_cb(dec->user, dec->in + dec->in_len, chunk)) < 0) {
+      return -1;
+    }
+    if (ret == 0) {
+      dec->eof = 1;
+    }
+    dec->in_len += ret;
+  }
+
+  return dec->in_len;
+}
+
+/* ========== BLOCK RING ========== */
+
+// waits for a free slot and claims it for the producer. returns NULL if the
+// decompressor is shutting down
+static dec_block_t *claim_block(bs_transport_decompress_t *dec)
+{
+  dec_block_t *blk = NULL;
+
+  pthread_mutex_lock(&dec->mutex);
+  while (!dec->shutdown && dec->tail - dec->head >= (uint64_t)dec->blocks_cnt) {
+    pthread_cond_wait(&dec->cond, &dec->mutex);
+  }
+  if (!dec->shutdown) {
+    blk = &dec->blocks[dec->tail % dec->blocks_cnt];
+    blk->state = BLOCK_PENDING;
+    blk->out_off = blk->out_len = 0;
+    dec->tail++;
+  }
+  pthread_mutex_unlock(&dec->mutex);
+
+  return blk;
+}
+
+static void set_block_state(dec_block_t *blk, block_state_t state)
+{
+  pthread_mutex_lock(&blk->dec->mutex);
+  blk->state = state;
+  pthread_cond_broadcast(&blk->dec->cond);
+  pthread_mutex_unlock(&blk->dec->mutex);
+}
+
+static void producer_finish(bs_transport_decompress_t *dec, int error)
+{
+  pthread_mutex_lock(&dec->mutex);
+  dec->finished = 1;
+  dec->error = error;
+  pthread_cond_broadcast(&dec->cond);
+  pthread_mutex_unlock(&dec->mutex);
+}
+
+/* ========== GZIP (PIPELINED) ========== */
+
+// (re)initializes zlib for the next gzip member
+static int gz_start(bs_transport_decompress_t *dec)
+{
+  if (dec->zs_init) {
+    if (inflateReset(&dec->zs) != Z_OK) {
+      return -1;
+    }
+  } else {
+    // 16 + MAX_WBITS: expect a gzip header and trailer
+    if (inflateInit2(&dec->zs, 16 + MAX_WBITS) != Z_OK) {
+      return -1;
+    }
+    dec->zs_init = 1;
+  }
+  dec->zs_pending = 0;
+  return 0;
+}
+
+// called at the end of a gzip member: starts the next one, if any
+static int gz_next_member(bs_transport_decompress_t *dec)
+{
+  int64_t avail;
+
+  if ((avail = fill(dec, DECOMPRESS_MAGIC_LEN, DECOMPRESS_IN_LEN)) < 0) {
+    return -1;
+  }
+  if (avail == 0) {
+    dec->zs_done = 1;
+    return 0;
+  }
+  if (detect_type(dec->in, avail) != DECOMPRESS_GZIP) {
+    bgpstream_log(BGPSTREAM_LOG_WARN,
+                  "Ignoring trailing garbage after compressed stream");
+    dec->zs_done = 1;
+    return 0;
+  }
+  return gz_start(dec);
+}
+
+// inflates up to len bytes. returns the number of bytes produced, 0 at the end
+// of the last member, or -1 on error
+static int64_t gz_read(bs_transport_decompress_t *dec, uint8_t *buffer,
+                       size_t len)
+{
+  bgpstream_perf_timer_t timer;
+  size_t avail_in;
+  int64_t produced;
+  int rc;
+
+  while (!dec->zs_done) {
+    if (dec->in_off == dec->in_len && !dec->zs_pending) {
+      if (fill(dec, 1, DECOMPRESS_IN_LEN) < 0) {
+        return -1;
+      }
+      if (dec->in_len == 0) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Compressed stream is truncated");
+        return -1;
+      }
+    }
+
+    avail_in = dec->in_len - dec->in_off;
+    dec->zs.next_in = dec->in + dec->in_off;
+    dec->zs.avail_in = avail_in;
+    dec->zs.next_out = buffer;
+    dec->zs.avail_out = len;
+    bgpstream_perf_start(dec->perf, &timer);
+    rc = inflate(&dec->zs, Z_NO_FLUSH);
+    bgpstream_perf_stop(dec->perf, BGPSTREAM_PERF_STAGE_DECOMPRESS, &timer);
+    // Z_BUF_ERROR only means that no progress was possible
+    if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "gzip decompression failed: %s",
+                    dec->zs.msg != NULL ? dec->zs.msg : "unknown error");
+      return -1;
+    }
+    dec->in_off += avail_in - dec->zs.avail_in;
+    produced = len - dec->zs.avail_out;
+    dec->zs_pending = (dec->zs.avail_out == 0);
+
+    if (rc == Z_STREAM_END && gz_next_member(dec) != 0) {
+      return -1;
+    }
+    if (produced > 0) {
+      return produced;
+    }
+  }
+
+  return 0;
+}
+
+// producer: inflates into output blocks, overlapping decompression with the
+// consumer's parsing
+static void gz_produce(bs_transport_decompress_t *dec)
+{
+  dec_block_t *blk;
+  int64_t ret = 0;
+
+  if (gz_start(dec) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not initialize zlib");
+    producer_finish(dec, 1);
+    return;
+  }
+
+  while (!dec->zs_done) {
+    if ((blk = claim_block(dec)) == NULL) {
+      break;
+    }
+    if (reserve(&blk->out, &blk->out_alloc, DECOMPRESS_OUT_LEN) != 0) {
+      ret = -1;
+    }
+    while (ret >= 0 && blk->out_len < DECOMPRESS_OUT_LEN &&
+           (ret = gz_read(dec, blk->out + blk->out_len,
+                          DECOMPRESS_OUT_LEN - blk->out_len)) > 0) {
+      blk->out_len += ret;
+    }
+    // a failed block still hands out the data decompressed before the error
+    set_block_state(blk, BLOCK_DONE);
+    if (ret < 0) {
+      producer_finish(dec, 1);
+      return;
+    }
+  }
+
+  producer_finish(dec, 0);
+}
+
+/* ========== BZIP2 (BLOCK-PARALLEL) ==========
+
+   bzip2 compresses each block (of up to 900k) independently, and blocks start
+   with a 48-bit magic number (not byte aligned). The producer scans for these
+   magic numbers and wraps each block as a standalone single-block stream that
+   a worker decompresses. The magic number can also appear by chance inside
+   compressed data: the two halves of such a block then both fail to
+   decompress, and are merged and decompressed again by the consumer. */
+
+static inline uint64_t get_bits(const uint8_t *buf, uint64_t bit, int n)
+{
+  uint64_t v = 0;
+  int i;
+
+  for (i = 0; i < n; i++, bit++) {
+    v = (v << 1) | ((buf[bit >> 3] >> (7 - (bit & 7))) & 1);
+  }
+  return v;
+}
+
+static inline void put_bits(uint8_t *buf, uint64_t *bit, uint64_t v, int n)
+{
+  int i;
+  uint64_t b;
+
+  for (i = n - 1; i >= 0; i--, (*bit)++) {
+    b = *bit;
+    if ((v >> i) & 1) {
+      buf[b >> 3] |= 0x80 >> (b & 7);
+    } else {
+      buf[b >> 3] &= ~(0x80 >> (b & 7));
+    }
+  }
+}
+
+// copies nbits from src (starting at bit src_bit) to dst (starting at bit
+// dst_bit). dst must have room for the bytes touched
+static void copy_bits(uint8_t *dst, uint64_t dst_bit, const uint8_t *src,
+                      uint64_t src_bit, uint64_t nbits)
+{
+  const uint8_t *s;
+  uint8_t *d;
+  int shift;
+
+  if ((dst_bit & 7) == 0) {
+    // whole bytes can be copied (and shifted into place if src is unaligned)
+    s = src + (src_bit >> 3);
+    d = dst + (dst_bit >> 3);
+    shift = src_bit & 7;
+    if (shift == 0) {
+      memcpy(d, s, nbits >> 3);
+    } else {
+      for (uint64_t i = 0; i < (nbits >> 3); i++) {
+        d[i] = (s[i] << shift) | (s[i + 1] >> (8 - shift));
+      }
+    }
+    dst_bit += nbits & ~7ULL;
+    src_bit += nbits & ~7ULL;
+    nbits &= 7;
+  }
+  while (nbits-- > 0) {
+    put_bits(dst, &dst_bit, get_bits(src, src_bit++, 1), 1);
+  }
+}
+
+// decompresses cnt adjacent blocks (normally one) as a single stream into the
+// output of the first. returns 0 if successful, -1 otherwise
+static int bz_decompress_blocks(dec_block_t **blks, int cnt)
+{
+  dec_block_t *out = blks[0];
+  bgpstream_perf_t *perf = out->dec->perf;
+  bgpstream_perf_timer_t timer;
+  uint8_t *stream = NULL;
+  uint64_t bit = 0, bits = 0;
+  bz_stream bz;
+  int i, rc = BZ_OK, bz_init = 0;
+
+  bgpstream_perf_start(perf, &timer);
+
+  for (i = 0; i < cnt; i++) {
+    bits += blks[i]->bits_len;
+  }
+  if ((stream = malloc(BZ_HDR_LEN + (bits + BZ_MAGIC_CRC_BITS + 7) / 8)) ==
+      NULL) {
+    goto err;
+  }
+
+  // "BZh" + block size, the block(s), then an end-of-stream marker whose
+  // combined CRC is that of the (single) real block
+  memcpy(stream, "BZh", 3);
+  stream[3] = '0' + out->level;
+  bit = BZ_HDR_LEN * 8;
+  for (i = 0; i < cnt; i++) {
+    copy_bits(stream, bit, blks[i]->bits, 0, blks[i]->bits_len);
+    bit += blks[i]->bits_len;
+  }
+  put_bits(stream, &bit, BZ_EOS_MAGIC, 48);
+  put_bits(stream, &bit, out->crc, 32);
+  while ((bit & 7) != 0) {
+    put_bits(stream, &bit, 0, 1);
+  }
+
+  memset(&bz, 0, sizeof(bz));
+  if (BZ2_bzDecompressInit(&bz, 0, 0) != BZ_OK) {
+    goto err;
+  }
+  bz_init = 1;
+  bz.next_in = (char *)stream;
+  bz.avail_in = bit / 8;
+
+  out->out_len = 0;
+  while (rc != BZ_STREAM_END) {
+    if (reserve(&out->out, &out->out_alloc,
+                out->out_len + DECOMPRESS_OUT_LEN) != 0) {
+      goto err;
+    }
+    bz.next_out = (char *)out->out + out->out_len;
+    bz.avail_out = out->out_alloc - out->out_len;
+    rc = BZ2_bzDecompress(&bz);
+    out->out_len = out->out_alloc - bz.avail_out;
+    // running out of input before the end-of-stream marker means the block
+    // was cut short
+    if ((rc != BZ_OK && rc != BZ_STREAM_END) ||
+        (rc == BZ_OK && bz.avail_in == 0 && bz.avail_out > 0)) {
+      goto err;
+    }
+  }
+
+  BZ2_bzDecompressEnd(&bz);
+  free(stream);
+  bgpstream_perf_stop(perf, BGPSTREAM_PERF_STAGE_DECOMPRESS, &timer);
+  return 0;
+
+err:
+  if (bz_init) {
+    BZ2_bzDecompressEnd(&bz);
+  }
+  free(stream);
+  out->out_len = 0;
+  bgpstream_perf_stop(perf, BGPSTREAM_PERF_STAGE_DECOMPRESS, &timer);
+  return -1;
+}
+
+// worker pool job
+static void bz_block_job(void *user)
+{
+  dec_block_t *blk = (dec_block_t *)user;
+
+  set_block_state(blk, bz_decompress_blocks(&blk, 1) == 0 ? BLOCK_DONE
+                                                          : BLOCK_FAILED);
+}
+
+// hands the block between bits start and end of the input buffer to a worker
+static int bz_emit(bs_transport_decompress_t *dec, uint8_t level,
+                   uint64_t start, uint64_t end)
+{
+  dec_block_t *blk;
+  uint64_t nbits = end - start;
+
+  if ((blk = claim_block(dec)) == NULL) {
+    return -1;
+  }
+  // the extra byte is read when copying whole bytes from an unaligned start
+  if (reserve(&blk->bits, &blk->bits_alloc, nbits / 8 + 2) != 0) {
+    set_block_state(blk, BLOCK_FAILED);
+    return -1;
+  }
+  copy_bits(blk->bits, 0, dec->in, start, nbits);
+  blk->bits_len = nbits;
+  blk->level = level;
+  blk->crc = get_bits(dec->in, start + 48, 32);
+
+  if (pool != NULL) {
+    bgpstream_worker_pool_submit(pool, &blk->job);
+  } else {
+    bz_block_job(blk);
+  }
+  return 0;
+}
+
+// is there a valid stream header (or EOF) at byte pos of the input?
+static int bz_stream_follows(bs_transport_decompress_t *dec, size_t pos)
+{
+  uint64_t magic;
+
+  if (pos == dec->in_len) {
+    return dec->eof;
+  }
+  if (pos + BZ_HDR_LEN + 6 > dec->in_len ||
+      memcmp(dec->in + pos, "BZh", 3) != 0 || dec->in[pos + 3] < '1' ||
+      dec->in[pos + 3] > '9') {
+    return 0;
+  }
+  magic = get_bits(dec->in, (pos + BZ_HDR_LEN) * 8, 48);
+  return magic == BZ_BLOCK_MAGIC || magic == BZ_EOS_MAGIC;
+}
+
+// splits one bzip2 stream (starting at in_off) into blocks. returns 1 if a
+// stream was split, 0 at EOF (or trailing garbage), -1 on error
+static int bz_split_stream(bs_transport_decompress_t *dec)
+{
+  uint8_t level;
+  uint64_t start, min, cand, v, reg = 0;
+  uint32_t combined = 0, crc;
+  size_t b, next, keep;
+  int s;
+
+  if (fill(dec, BZ_HDR_LEN + 16, DECOMPRESS_BZ_READ_LEN) < 0) {
+    return -1;
+  }
+  if (dec->in_len == 0) {
+    return 0;
+  }
+  if (dec->in_len < BZ_HDR_LEN + 6 || memcmp(dec->in, "BZh", 3) != 0 ||
+      dec->in[3] < '1' || dec->in[3] > '9') {
+    bgpstream_log(BGPSTREAM_LOG_WARN,
+                  "Ignoring trailing garbage after compressed stream");
+    return 0;
+  }
+  level = dec->in[3] - '0';
+
+  start = BZ_HDR_LEN * 8;
+  v = get_bits(dec->in, start, 48);
+  if (v == BZ_EOS_MAGIC) {
+    // empty stream
+    dec->in_off = (start + BZ_MAGIC_CRC_BITS + 7) / 8;
+    return 1;
+  }
+  if (v != BZ_BLOCK_MAGIC) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid bzip2 block header");
+    return -1;
+  }
+
+  // scan a byte at a time: after feeding byte b, reg holds the bits up to the
+  // end of b, and the 48-bit window shifted right by s starts at bit cand
+  min = start + BZ_MAGIC_CRC_BITS;
+  b = min / 8;
+  while (1) {
+    // keep enough look-ahead to check the end-of-stream marker
+    if (b + 17 > dec->in_len && !dec->eof) {
+      keep = start / 8;
+      dec->in_off = keep;
+      if (fill(dec, b - keep + 17, DECOMPRESS_BZ_READ_LEN) < 0) {
+        return -1;
+      }
+      start -= keep * 8;
+      min -= keep * 8;
+      b -= keep;
+      continue;
+    }
+    if (b >= dec->in_len) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Compressed stream is truncated");
+      return -1;
+    }
+
+    reg = (reg << 8) | dec->in[b];
+    for (s = 7; s >= 0; s--) {
+      cand = (b + 1) * 8 - 48 - s;
+      if ((b + 1) * 8 < 48 + (uint64_t)s || cand < min) {
+        continue;
+      }
+      v = (reg >> s) & BZ_MAGIC_MASK;
+      if (v == BZ_BLOCK_MAGIC) {
+        combined = ((combined << 1) | (combined >> 31)) ^
+                   (uint32_t)get_bits(dec->in, start + 48, 32);
+        if (bz_emit(dec, level, start, cand) != 0) {
+          return -1;
+        }
+        start = cand;
+        min = cand + BZ_MAGIC_CRC_BITS;
+        break;
+      }
+      if (v == BZ_EOS_MAGIC) {
+        // this is the real end of the stream if the combined CRC matches, or
+        // it is followed by another stream (or EOF)
+        crc = get_bits(dec->in, cand + 48, 32);
+        next = (cand + BZ_MAGIC_CRC_BITS + 7) / 8;
+        if (crc != (((combined << 1) | (combined >> 31)) ^
+                    (uint32_t)get_bits(dec->in, start + 48, 32)) &&
+            !bz_stream_follows(dec, next)) {
+          continue;
+        }
+        if (bz_emit(dec, level, start, cand) != 0) {
+          return -1;
+        }
+        dec->in_off = next;
+        return 1;
+      }
+    }
+    b++;
+  }
+}
+
+// producer: splits the stream(s) into blocks for the worker pool
+static void bz_produce(bs_transport_decompress_t *dec)
+{
+  int ret;
+
+  while ((ret = bz_split_stream(dec)) > 0)
+    ;
+
+  producer_finish(dec, ret < 0);
+}
+
+// called by the consumer for a block that failed to decompress: merges it with
+// the following failed blocks until they decompress. returns 0 if successful,
+// -1 otherwise. called with the mutex held
+static int bz_recover(bs_transport_decompress_t *dec, dec_block_t *blk)
+{
+  dec_block_t *blks[BZ_MAX_MERGE];
+  dec_block_t *next;
+  int cnt = 1, i, rc;
+
+  blks[0] = blk;
+  // (the producer cannot add blocks beyond a full ring)
+  while (cnt < BZ_MAX_MERGE && cnt < dec->blocks_cnt) {
+    // wait for the next block to be produced, and decompressed
+    while (!dec->finished && dec->head + cnt >= dec->tail) {
+      pthread_cond_wait(&dec->cond, &dec->mutex);
+    }
+    if (dec->head + cnt >= dec->tail) {
+      return -1;
+    }
+    next = &dec->blocks[(dec->head + cnt) % dec->blocks_cnt];
+    while (next->state == BLOCK_PENDING) {
+      pthread_cond_wait(&dec->cond, &dec->mutex);
+    }
+    // if the next block is fine, this one really is corrupt
+    if (next->state != BLOCK_FAILED) {
+      return -1;
+    }
+    blks[cnt++] = next;
+
+    pthread_mutex_unlock(&dec->mutex);
+    rc = bz_decompress_blocks(blks, cnt);
+    pthread_mutex_lock(&dec->mutex);
+    if (rc == 0) {
+      // the merged blocks are now empty
+      blk->state = BLOCK_DONE;
+      for (i = 1; i < cnt; i++) {
+        blks[i]->state = BLOCK_DONE;
+        blks[i]->out_off = blks[i]->out_len = 0;
+      }
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+static void *producer_thread(void *user)
+{
+  bs_transport_decompress_t *dec = (bs_transport_decompress_t *)user;
+
+  if (dec->type == DECOMPRESS_GZIP) {
+    gz_produce(dec);
+  } else {
+    bz_produce(dec);
+  }
+  return NULL;
+}
+
+/* ========== PUBLIC FUNCTIONS ========== */
+
+int bs_transport_decompress_is_supported(const uint8_t *buf, size_t len)
+{
+  return detect_type(buf, len) != DECOMPRESS_NONE;
+}
+
+bs_transport_decompress_t *
+bs_transport_decompress_create(bs_transport_decompress_read_cb_t *read_cb,
+                               void *user, struct bgpstream_perf *perf)
+{
+  bs_transport_decompress_t *dec;
+  int i;
+
+  pthread_once(&pool_once, pool_init);
+
+  if ((dec = malloc_zero(sizeof(bs_transport_decompress_t))) == NULL) {
+    return NULL;
+  }
+  dec->read_cb = read_cb;
+  dec->user = user;
+  dec->perf = perf;
+
+  pthread_mutex_init(&dec->mutex, NULL);
+  pthread_cond_init(&dec->cond, NULL);
+
+  dec->blocks_cnt = pool_threads + 2;
+  if (dec->blocks_cnt > DECOMPRESS_MAX_BLOCKS) {
+    dec->blocks_cnt = DECOMPRESS_MAX_BLOCKS;
+  }
+  for (i = 0; i < dec->blocks_cnt; i++) {
+    dec->blocks[i].dec = dec;
+    dec->blocks[i].job.func = bz_block_job;
+    dec->blocks[i].job.user = &dec->blocks[i];
+  }
+
+  return dec;
+}
+
+int64_t bs_transport_decompress_read(bs_transport_decompress_t *dec,
+                                     uint8_t *buffer, int64_t len)
+{
+  dec_block_t *blk;
+  int64_t avail;
+
+  if (!dec->detected) {
+    if ((avail = fill(dec, DECOMPRESS_MAGIC_LEN, DECOMPRESS_MAGIC_LEN)) < 0) {
+      return -1;
+    }
+    dec->type = detect_type(dec->in, avail);
+    dec->detected = 1;
+    if (dec->type != DECOMPRESS_NONE) {
+      if (bgpstream_affinity_thread_create(&dec->producer, producer_thread,
+                                           dec) != 0) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Could not start decompression");
+        return -1;
+      }
+      dec->producer_started = 1;
+    }
+  }
+
+  if (dec->type == DECOMPRESS_NONE) {
+    // hand out any bytes buffered during detection, then read directly
+    if ((avail = dec->in_len - dec->in_off) > 0) {
+      if (avail > len) {
+        avail = len;
+      }
+      memcpy(buffer, dec->in + dec->in_off, avail);
+      dec->in_off += avail;
+      return avail;
+    }
+    return dec->eof ? 0 : dec->read_cb(dec->user, buffer, len);
+  }
+
+  pthread_mutex_lock(&dec->mutex);
+  while (1) {
+    if (dec->head == dec->tail) {
+      if (dec->finished) {
+        avail = dec->error ? -1 : 0;
+        break;
+      }
+      pthread_cond_wait(&dec->cond, &dec->mutex);
+      continue;
+    }
+
+    blk = &dec->blocks[dec->head % dec->blocks_cnt];
+    if (blk->state == BLOCK_PENDING) {
+      pthread_cond_wait(&dec->cond, &dec->mutex);
+      continue;
+    }
+    if (blk->state == BLOCK_FAILED && bz_recover(dec, blk) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "bzip2 decompression failed");
+      avail = -1;
+      break;
+    }
+
+    if ((avail = blk->out_len - blk->out_off) > 0) {
+      if (avail > len) {
+        avail = len;
+      }
+      memcpy(buffer, blk->out + blk->out_off, avail);
+      blk->out_off += avail;
+      break;
+    }
+
+    // block fully read: free its slot
+    dec->head++;
+    pthread_cond_broadcast(&dec->cond);
+  }
+  pthread_mutex_unlock(&dec->mutex);
+
+  return avail;
+}
+
+void bs_transport_decompress_destroy(bs_transport_decompress_t *dec)
+{
+  uint64_t seq;
+  int i;
+
+  if (dec == NULL) {
+    return;
+  }
+
+  if (dec->producer_started) {
+    pthread_mutex_lock(&dec->mutex);
+    dec->shutdown = 1;
+    pthread_cond_broadcast(&dec->cond);
+    pthread_mutex_unlock(&dec->mutex);
+    pthread_join(dec->producer, NULL);
+
+    // wait for the workers to finish with our blocks
+    pthread_mutex_lock(&dec->mutex);
+    for (seq = dec->head; seq < dec->tail; seq++) {
+      while (dec->blocks[seq % dec->blocks_cnt].state == BLOCK_PENDING) {
+        pthread_cond_wait(&dec->cond, &dec->mutex);
+      }
+    }
+    pthread_mutex_unlock(&dec->mutex);
+  }
+
+  for (i = 0; i < dec->blocks_cnt; i++) {
+    free(dec->blocks[i].bits);
+    free(dec->blocks[i].out);
+  }
+  if (dec->zs_init) {
+    inflateEnd(&dec->zs);
+  }
+  pthread_mutex_destroy(&dec->mutex);
+  pthread_cond_destroy(&dec->cond);
+  free(dec->in);
+  free(dec);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BS_TRANSPORT_DECOMPRESS_H
+#define __BS_TRANSPORT_DECOMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Multi-threaded decompression stage for transports
+ *
+ * Transports wrap their raw byte stream in a decompressor so that
+ * decompression runs off the thread that parses the records. The compression
+ * type is detected from the magic bytes at the start of the stream:
+ *  - gzip is inflated by a producer thread, pipelined with the consumer
+ *  - bzip2 is split into its (independent) blocks by a producer thread, and
+ *    the blocks are decompressed in parallel by a process-wide pool of
+ *    threads (one per core)
+ * Concatenated gzip members and bzip2 streams are supported. Anything else is
+ * passed through unchanged.
+ */
+
+/** Number of bytes needed by bs_transport_decompress_is_supported */
+#define BS_TRANSPORT_DECOMPRESS_MAGIC_LEN 3
+
+struct bgpstream_perf;
+
+/** Opaque structure representing a decompressor instance */
+typedef struct bs_transport_decompress bs_transport_decompress_t;
+
+/** Callback used by a decompressor to read raw (compressed) bytes
+ *
+ * @param user          user pointer given to the decompressor
+ * @param buffer        buffer to read into
+ * @param len           maximum number of bytes to read
+ * @return the number of bytes read, 0 at EOF, or -1 if an error occurred
+ */
+typedef int64_t(bs_transport_decompress_read_cb_t)(void *user, uint8_t *buffer,
+                                                   int64_t len);
+
+/** Check whether the given stream is one that a decompressor decompresses
+ *
+ * @param buf           the first bytes of the stream
+ * @param len           number of bytes in buf (at most
+ *                      BS_TRANSPORT_DECOMPRESS_MAGIC_LEN are needed)
+ * @return 1 if the stream is gzip or bzip2 compressed, 0 otherwise
+ */
+int bs_transport_decompress_is_supported(const uint8_t *buf, size_t len);
+
+/** Create a decompressor that reads raw bytes using the given callback
+ *
+ * @param read_cb       callback to read raw bytes with
+ * @param user          user pointer to pass to the callback
+ * @param perf          accounting object to time decompression with (may be
+ *                      NULL)
+ * @return pointer to the decompressor if successful, NULL otherwise
+ *
+ * Once the first byte has been read from the decompressor, the callback is
+ * called from a separate thread (but never concurrently).
+ */
+bs_transport_decompress_t *
+bs_transport_decompress_create(bs_transport_decompress_read_cb_t *read_cb,
+                               void *user, struct bgpstream_perf *perf);
+
+/** Read decompressed bytes
+ *
+ * @param dec           pointer to the decompressor to read from
+ * @param buffer        buffer to read into
+ * @param len           maximum number of bytes to read
+ * @return the number of bytes read, 0 at EOF, or -1 if an error occurred
+ */
+int64_t bs_transport_decompress_read(bs_transport_decompress_t *dec,
+                                     uint8_t *buffer, int64_t len);
+
+/** Destroy the given decompressor
+ *
+ * @param dec           pointer to the decompressor to destroy
+ */
+void bs_transport_decompress_destroy(bs_transport_decompress_t *dec);
+
+#endif /* __BS_TRANSPORT_DECOMPRESS_H */
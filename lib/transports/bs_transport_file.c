@@ -27,41 +27,266 @@
 #include "bs_transport_file.h"
 #include "bgpstream_transport_interface.h"
 #include "bgpstream_log.h"
+#include "bs_transport_decompress.h"
+#ifdef WITH_IO_URING
+#include "bs_transport_uring.h"
+#endif
+#include "utils.h"
 #include "wandio.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define STATE ((file_state_t *)(transport->state))
+
+typedef struct file_state {
+
+  /** wandio reader (of the raw file if we decompress it ourselves) */
+  io_t *fh;
+
+  /** Decompression stage, NULL if wandio handles the file */
+  bs_transport_decompress_t *dec;
+
+#ifdef WITH_IO_URING
+  /** io_uring reader of the raw file, NULL if reading it using wandio */
+  bs_transport_uring_file_t *uf;
+#endif
+
+  /** Content of the file, if it is mapped (uncompressed local files only) */
+  uint8_t *map;
+  size_t map_len;
+
+  /** Offset of the next read from the mapping */
+  size_t map_off;
+
+} file_state_t;
+
+/** Magic numbers of the other compression formats that wandio detects.
+    Files starting with one of these are never mapped */
+static const struct {
+  const char *magic;
+  size_t len;
+} compressed_magics[] = {
+  {"\xfd" "7zXZ", 5},         // xz
+  {"\x28\xb5\x2f\xfd", 4}, // zstd
+  {"\x04\x22\x4d\x18", 4}, // lz4
+  {"\x89" "LZO", 4},          // lzo
+};
+
+static int is_compressed(const uint8_t *buf, size_t len)
+{
+  size_t i;
+
+  if (bs_transport_decompress_is_supported(buf, len)) {
+    return 1;
+  }
+  for (i = 0; i < ARR_CNT(compressed_magics); i++) {
+    if (len >= compressed_magics[i].len &&
+        memcmp(buf, compressed_magics[i].magic, compressed_magics[i].len) ==
+          0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int64_t map_content(bgpstream_transport_t *transport, uint8_t **data)
+{
+  *data = STATE->map;
+  return STATE->map_len;
+}
+
+// maps the file if it is a local, uncompressed, regular file. returns 0 if it
+// was mapped, -1 otherwise (and the file should be read instead)
+static int map_file(bgpstream_transport_t *transport)
+{
+  struct stat st;
+  uint8_t *map;
+  int fd;
+
+  if (strcmp(transport->res->url, "-") == 0 ||
+      (fd = open(transport->res->url, O_RDONLY)) < 0) {
+    return -1;
+  }
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+      (uint64_t)st.st_size > SIZE_MAX) {
+    close(fd);
+    return -1;
+  }
+  // the mapping is writable (but private) so that the format layer may decode
+  // in place. NB: (like for any mapped file) truncating the file while it is
+  // being read raises SIGBUS
+  map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return -1;
+  }
+  if (is_compressed(map, st.st_size)) {
+    munmap(map, st.st_size);
+    return -1;
+  }
+
+#ifdef HAVE_MADVISE
+  // dumps are read once, front to back: read ahead aggressively, and let
+  // pages be reclaimed once they have been read
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+  // (only honored by kernels that support huge pages for file mappings)
+  madvise(map, st.st_size, MADV_HUGEPAGE);
+#endif
+#endif
+
+  STATE->map = map;
+  STATE->map_len = st.st_size;
+  transport->map = map_content;
+  bgpstream_log(BGPSTREAM_LOG_FINE, "mapped %s (%zu bytes)",
+                transport->res->url, STATE->map_len);
+  return 0;
+}
+
+static int64_t read_raw(void *user, uint8_t *buffer, int64_t len)
+{
+  return wandio_read((io_t *)user, buffer, len);
+}
+
+#ifdef WITH_IO_URING
+static int64_t read_uring(void *user, uint8_t *buffer, int64_t len)
+{
+  return bs_transport_uring_read((bs_transport_uring_file_t *)user, buffer,
+                                 len);
+}
+
+// reads the file through the shared io_uring ring if it is a local, gzip or
+// bzip2 compressed, regular file. returns 0 if it is, -1 otherwise
+static int open_uring(bgpstream_transport_t *transport)
+{
+  uint8_t magic[BS_TRANSPORT_DECOMPRESS_MAGIC_LEN];
+  int64_t magic_len;
+
+  if (strcmp(transport->res->url, "-") == 0 ||
+      (STATE->uf = bs_transport_uring_open(transport->res->url)) == NULL) {
+    return -1;
+  }
+  if ((magic_len = bs_transport_uring_peek(STATE->uf, magic, sizeof(magic))) <
+        0 ||
+      !bs_transport_decompress_is_supported(magic, magic_len) ||
+      (STATE->dec = bs_transport_decompress_create(
+         read_uring, STATE->uf, transport->res->perf)) == NULL) {
+    // (other compression formats are left to wandio)
+    bs_transport_uring_close(STATE->uf);
+    STATE->uf = NULL;
+    return -1;
+  }
+  return 0;
+}
+#endif
 
 int bs_transport_file_create(bgpstream_transport_t *transport)
 {
-  io_t *fh = NULL;
+  uint8_t magic[BS_TRANSPORT_DECOMPRESS_MAGIC_LEN];
+  int64_t magic_len;
 
   BS_TRANSPORT_SET_METHODS(file, transport);
 
-  if ((fh = wandio_create(transport->res->url)) == NULL) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open %s for reading",
-                  transport->res->url);
-    return -1;
+  if ((transport->state = malloc_zero(sizeof(file_state_t))) == NULL) {
+    goto err;
+  }
+
+  // uncompressed local files are handed to the format layer as they are
+  if (map_file(transport) == 0) {
+    return 0;
+  }
+
+#ifdef WITH_IO_URING
+  // compressed local files are read asynchronously (using the ring that
+  // serves all open files), and decompressed on separate threads
+  if (open_uring(transport) == 0) {
+    return 0;
+  }
+#endif
+
+  // stdin cannot be re-opened once its magic has been read, so it is left to
+  // wandio, which detects (and decompresses) every format it supports
+  if (strcmp(transport->res->url, "-") == 0) {
+    if ((STATE->fh = wandio_create(transport->res->url)) == NULL) {
+      goto err;
+    }
+    return 0;
   }
 
-  transport->state = fh;
+  // gzip and bzip2 files (i.e., all archive dumps) are decompressed on
+  // separate threads. other formats are left to wandio
+  if ((STATE->fh = wandio_create_uncompressed(transport->res->url)) == NULL ||
+      (magic_len = wandio_peek(STATE->fh, magic, sizeof(magic))) < 0) {
+    goto err;
+  }
+  if (bs_transport_decompress_is_supported(magic, magic_len)) {
+    if ((STATE->dec = bs_transport_decompress_create(
+           read_raw, STATE->fh, transport->res->perf)) == NULL) {
+      goto err;
+    }
+  } else {
+    wandio_destroy(STATE->fh);
+    if ((STATE->fh = wandio_create(transport->res->url)) == NULL) {
+      goto err;
+    }
+  }
 
   return 0;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open %s for reading",
+                transport->res->url);
+  bs_transport_file_destroy(transport);
+  return -1;
 }
 
 int64_t bs_transport_file_read(bgpstream_transport_t *transport,
                                uint8_t *buffer, int64_t len)
 {
-  return wandio_read((io_t *)transport->state, buffer, len);
+  if (STATE->map != NULL) {
+    if (len > (int64_t)(STATE->map_len - STATE->map_off)) {
+      len = STATE->map_len - STATE->map_off;
+    }
+    memcpy(buffer, STATE->map + STATE->map_off, len);
+    STATE->map_off += len;
+    return len;
+  }
+  if (STATE->dec != NULL) {
+    return bs_transport_decompress_read(STATE->dec, buffer, len);
+  }
+  return wandio_read(STATE->fh, buffer, len);
 }
 
 int64_t bs_transport_file_readline(bgpstream_transport_t *transport,
                                    uint8_t *buffer, int64_t len)
 {
-  return wandio_fgets((io_t *)transport->state, buffer, len, 1);
+  if (STATE->map != NULL || STATE->dec != NULL) {
+    return wandio_generic_fgets(transport, buffer, len, 1,
+                                (read_cb_t *)bs_transport_file_read);
+  }
+  return wandio_fgets(STATE->fh, buffer, len, 1);
 }
 
 void bs_transport_file_destroy(bgpstream_transport_t *transport)
 {
-  if (transport->state != NULL) {
-    wandio_destroy((io_t *)transport->state);
-    transport->state = NULL;
+  if (transport->state == NULL) {
+    return;
+  }
+  // the decompressor reads from fh (on its own thread) until destroyed
+  bs_transport_decompress_destroy(STATE->dec);
+#ifdef WITH_IO_URING
+  bs_transport_uring_close(STATE->uf);
+#endif
+  if (STATE->fh != NULL) {
+    wandio_destroy(STATE->fh);
+  }
+  if (STATE->map != NULL) {
+    munmap(STATE->map, STATE->map_len);
   }
+  free(transport->state);
+  transport->state = NULL;
 }
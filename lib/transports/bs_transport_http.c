@@ -32,6 +32,546 @@
 #include <string.h>
 #include <assert.h>
 
+#ifdef WITH_CURL
+
+#include "bs_transport_decompress.h"
+#include "utils.h"
+#include <curl/curl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#define STATE ((http_state_t *)(transport->state))
+
+/** Size of each byte-range request. Resources no larger than this are fetched
+    with a single request */
+#define HTTP_RANGE_LEN (8 * 1024 * 1024)
+
+/** Maximum number of range requests in flight for one resource */
+#define HTTP_MAX_RANGES 4
+
+/** How long to wait for transfer activity before re-checking (ms) */
+#define HTTP_POLL_TIMEOUT_MS 1000
+
+static char http_user_agent[] = "libbgpstream/" PACKAGE_VERSION;
+
+typedef enum {
+
+  /** Waiting for the response to the first request */
+  HTTP_MODE_UNKNOWN,
+
+  /** The server honors range requests: fetch the resource in parallel
+      ranges */
+  HTTP_MODE_RANGES,
+
+  /** The server ignored the range: the whole resource is streamed by the
+      first request */
+  HTTP_MODE_STREAM,
+
+} http_mode_t;
+
+struct http_state;
+
+/** One (range) request and the bytes it has received */
+typedef struct http_range {
+
+  /** Back-pointer to the transport state */
+  struct http_state *state;
+
+  /** Easy handle, reused for every request made from this slot */
+  CURL *easy;
+
+  /** Received bytes: buf[off..len) have not been read yet */
+  uint8_t *buf;
+  size_t alloc;
+  size_t off;
+  size_t len;
+
+  /** Offset of the range in the resource */
+  uint64_t start;
+
+  /** Number of bytes the range should contain (0 until known) */
+  size_t expected;
+
+  /** Is the easy handle attached to the multi handle? */
+  int attached;
+
+  /** Has the request finished (and with what result)? */
+  int done;
+  CURLcode result;
+
+  /** Has the transfer been paused because the buffer is full? */
+  int paused;
+
+  char errbuf[CURL_ERROR_SIZE];
+
+} http_range_t;
+
+typedef struct http_state {
+
+  /** URL of the resource */
+  const char *url;
+
+  /** Multi handle driving the requests of this resource */
+  CURLM *multi;
+
+  /** Ring of requests, read in order starting at head */
+  http_range_t ranges[HTTP_MAX_RANGES];
+  int head;
+  int active_cnt;
+
+  http_mode_t mode;
+
+  /** Total size of the resource (from Content-Range), 0 if unknown */
+  uint64_t size;
+
+  /** Offset of the next range to request */
+  uint64_t next_start;
+
+  /** Decompression stage, reading raw bytes from the requests */
+  bs_transport_decompress_t *dec;
+
+} http_state_t;
+
+/* Connection pool shared by all HTTP transports of the process. Connections
+   (and DNS and TLS session caches) outlive the resource that opened them, so
+   consecutive resources from the same server reuse kept-alive connections
+   rather than paying for a new TCP and TLS handshake each. */
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static CURLSH *pool_share = NULL;
+static pthread_mutex_t pool_locks[CURL_LOCK_DATA_LAST];
+
+static void pool_lock(CURL *easy, curl_lock_data data, curl_lock_access access,
+                      void *user)
+{
+  pthread_mutex_lock(&pool_locks[data]);
+}
+
+static void pool_unlock(CURL *easy, curl_lock_data data, void *user)
+{
+  pthread_mutex_unlock(&pool_locks[data]);
+}
+
+static void pool_init(void)
+{
+  int i;
+
+  if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not initialize libcurl");
+    return;
+  }
+
+  for (i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+    pthread_mutex_init(&pool_locks[i], NULL);
+  }
+
+  if ((pool_share = curl_share_init()) == NULL ||
+      curl_share_setopt(pool_share, CURLSHOPT_LOCKFUNC, pool_lock) !=
+        CURLSHE_OK ||
+      curl_share_setopt(pool_share, CURLSHOPT_UNLOCKFUNC, pool_unlock) !=
+        CURLSHE_OK ||
+      curl_share_setopt(pool_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT) !=
+        CURLSHE_OK ||
+      curl_share_setopt(pool_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS) !=
+        CURLSHE_OK ||
+      curl_share_setopt(pool_share, CURLSHOPT_SHARE,
+                        CURL_LOCK_DATA_SSL_SESSION) != CURLSHE_OK) {
+    // not fatal: each resource just uses its own connections
+    bgpstream_log(BGPSTREAM_LOG_WARN,
+                  "Could not create shared HTTP connection pool");
+  }
+}
+
+static size_t header_cb(char *data, size_t size, size_t nmemb, void *user)
+{
+  http_range_t *range = (http_range_t *)user;
+  size_t len = size * nmemb;
+  char line[256];
+  uint64_t first, last, total;
+
+  // only the response to the first request decides the mode
+  if (range->state->mode != HTTP_MODE_UNKNOWN) {
+    return len;
+  }
+
+  if (len >= sizeof(line)) {
+    return len;
+  }
+  memcpy(line, data, len);
+  line[len] = '\0';
+
+  if (strncasecmp(line, "HTTP/", 5) == 0) {
+    // a new response (e.g., after a redirect)
+    range->state->size = 0;
+  } else if (strncasecmp(line, "Content-Range:", 14) == 0 &&
+             sscanf(line + 14, " bytes %" SCNu64 "-%" SCNu64 "/%" SCNu64,
+                    &first, &last, &total) == 3 &&
+             first == range->start) {
+    range->state->size = total;
+  }
+
+  return len;
+}
+
+// decides how the resource is fetched, based on the first response
+static int set_mode(http_state_t *state, http_range_t *range)
+{
+  long code = 0;
+
+  curl_easy_getinfo(range->easy, CURLINFO_RESPONSE_CODE, &code);
+
+  if (code == 206 && state->size > 0) {
+    state->mode = HTTP_MODE_RANGES;
+    range->expected =
+      (state->size < HTTP_RANGE_LEN) ? state->size : HTTP_RANGE_LEN;
+  } else if (code == 200) {
+    state->mode = HTTP_MODE_STREAM;
+  } else {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Unexpected HTTP response (%ld) for %s",
+                  code, state->url);
+    return -1;
+  }
+
+  return 0;
+}
+
+static size_t write_cb(char *data, size_t size, size_t nmemb, void *user)
+{
+  http_range_t *range = (http_range_t *)user;
+  http_state_t *state = range->state;
+  size_t len = size * nmemb;
+  size_t need;
+  uint8_t *tmp;
+
+  if (state->mode == HTTP_MODE_UNKNOWN && set_mode(state, range) != 0) {
+    return 0;
+  }
+
+  if (state->mode == HTTP_MODE_STREAM) {
+    // bound the buffer: curl keeps the data until we resume the transfer
+    if (range->len - range->off >= HTTP_RANGE_LEN) {
+      range->paused = 1;
+      return CURL_WRITEFUNC_PAUSE;
+    }
+    if (range->off > 0 && range->len + len > range->alloc) {
+      memmove(range->buf, range->buf + range->off, range->len - range->off);
+      range->len -= range->off;
+      range->off = 0;
+    }
+  } else if (range->len + len > range->expected) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Range overrun for %s at %" PRIu64,
+                  state->url, range->start);
+    return 0;
+  }
+
+  if ((need = range->len + len) > range->alloc) {
+    if (need < range->expected) {
+      need = range->expected;
+    }
+    if ((tmp = realloc(range->buf, need)) == NULL) {
+      return 0;
+    }
+    range->buf = tmp;
+    range->alloc = need;
+  }
+
+  memcpy(range->buf + range->len, data, len);
+  range->len += len;
+
+  return len;
+}
+
+// starts a request for len bytes at start, in the next free slot
+static int start_range(http_state_t *state, uint64_t start, size_t len)
+{
+  http_range_t *range =
+    &state->ranges[(state->head + state->active_cnt) % HTTP_MAX_RANGES];
+  char range_str[64];
+
+  assert(state->active_cnt < HTTP_MAX_RANGES && !range->attached);
+
+  if (range->easy == NULL) {
+    if ((range->easy = curl_easy_init()) == NULL) {
+      return -1;
+    }
+    range->state = state;
+    curl_easy_setopt(range->easy, CURLOPT_URL, state->url);
+    curl_easy_setopt(range->easy, CURLOPT_PRIVATE, range);
+    curl_easy_setopt(range->easy, CURLOPT_WRITEFUNCTION, write_cb);
+    curl_easy_setopt(range->easy, CURLOPT_WRITEDATA, range);
+    curl_easy_setopt(range->easy, CURLOPT_HEADERFUNCTION, header_cb);
+    curl_easy_setopt(range->easy, CURLOPT_HEADERDATA, range);
+    curl_easy_setopt(range->easy, CURLOPT_ERRORBUFFER, range->errbuf);
+    curl_easy_setopt(range->easy, CURLOPT_USERAGENT, http_user_agent);
+    curl_easy_setopt(range->easy, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(range->easy, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(range->easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(range->easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    // multiplex the ranges over one HTTP/2 connection when possible
+    curl_easy_setopt(range->easy, CURLOPT_HTTP_VERSION,
+                     (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(range->easy, CURLOPT_PIPEWAIT, 1L);
+    if (pool_share != NULL) {
+      curl_easy_setopt(range->easy, CURLOPT_SHARE, pool_share);
+    }
+  }
+
+  range->off = range->len = 0;
+  range->start = start;
+  range->expected = (state->mode == HTTP_MODE_RANGES) ? len : 0;
+  range->done = range->paused = 0;
+  range->result = CURLE_OK;
+  range->errbuf[0] = '\0';
+
+  snprintf(range_str, sizeof(range_str), "%" PRIu64 "-%" PRIu64, start,
+           start + len - 1);
+  curl_easy_setopt(range->easy, CURLOPT_RANGE, range_str);
+
+  if (curl_multi_add_handle(state->multi, range->easy) != CURLM_OK) {
+    return -1;
+  }
+  range->attached = 1;
+  state->active_cnt++;
+  state->next_start = start + len;
+
+  return 0;
+}
+
+// keeps HTTP_MAX_RANGES requests in flight until the whole resource has been
+// requested
+static int schedule_ranges(http_state_t *state)
+{
+  uint64_t len;
+
+  if (state->mode != HTTP_MODE_RANGES) {
+    return 0;
+  }
+
+  while (state->active_cnt < HTTP_MAX_RANGES &&
+         state->next_start < state->size) {
+    len = state->size - state->next_start;
+    if (len > HTTP_RANGE_LEN) {
+      len = HTTP_RANGE_LEN;
+    }
+    if (start_range(state, state->next_start, len) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+// runs the transfers. if wait is set, also waits (briefly) for activity when
+// the head request has nothing to read yet
+static int drive(http_state_t *state, int wait)
+{
+  http_range_t *head = &state->ranges[state->head];
+  http_range_t *range;
+  CURLMsg *msg;
+  CURLMcode mc;
+  int running, msgs;
+
+  if ((mc = curl_multi_perform(state->multi, &running)) != CURLM_OK) {
+    goto err;
+  }
+
+  while ((msg = curl_multi_info_read(state->multi, &msgs)) != NULL) {
+    if (msg->msg != CURLMSG_DONE) {
+      continue;
+    }
+    curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&range);
+    range->done = 1;
+    range->result = msg->data.result;
+    curl_multi_remove_handle(state->multi, range->easy);
+    range->attached = 0;
+  }
+
+  if (schedule_ranges(state) != 0) {
+    return -1;
+  }
+
+  if (wait && !head->done && head->len == head->off &&
+      (mc = curl_multi_poll(state->multi, NULL, 0, HTTP_POLL_TIMEOUT_MS,
+                            NULL)) != CURLM_OK) {
+    goto err;
+  }
+
+  return 0;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "HTTP transfer failed for %s: %s",
+                state->url, curl_multi_strerror(mc));
+  return -1;
+}
+
+// retires the (fully read) head request
+static int finish_range(http_state_t *state, http_range_t *range)
+{
+  if (range->result != CURLE_OK) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not read %s: %s", state->url,
+                  range->errbuf[0] != '\0' ? range->errbuf
+                                           : curl_easy_strerror(range->result));
+    return -1;
+  }
+  if (state->mode == HTTP_MODE_RANGES && range->len != range->expected) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Short range for %s at %" PRIu64 " (%zu of %zu bytes)",
+                  state->url, range->start, range->len, range->expected);
+    return -1;
+  }
+
+  state->head = (state->head + 1) % HTTP_MAX_RANGES;
+  state->active_cnt--;
+
+  return schedule_ranges(state);
+}
+
+// reads raw (possibly compressed) bytes, reassembling the ranges in order
+static int64_t read_raw(void *user, uint8_t *buffer, int64_t len)
+{
+  http_state_t *state = (http_state_t *)user;
+  http_range_t *range;
+  size_t avail;
+
+  // keep the other ranges moving while the head one is being read
+  if (state->active_cnt > 0 && drive(state, 0) != 0) {
+    return -1;
+  }
+
+  while (state->active_cnt > 0) {
+    range = &state->ranges[state->head];
+
+    if ((avail = range->len - range->off) > 0) {
+      if (avail > (size_t)len) {
+        avail = len;
+      }
+      memcpy(buffer, range->buf + range->off, avail);
+      range->off += avail;
+      if (state->mode == HTTP_MODE_STREAM && range->off == range->len) {
+        range->off = range->len = 0;
+      }
+      if (range->paused) {
+        range->paused = 0;
+        if (curl_easy_pause(range->easy, CURLPAUSE_CONT) != CURLE_OK) {
+          return -1;
+        }
+      }
+      return avail;
+    }
+
+    if (range->done) {
+      if (finish_range(state, range) != 0) {
+        return -1;
+      }
+      continue;
+    }
+
+    if (drive(state, 1) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+int bs_transport_http_create(bgpstream_transport_t *transport)
+{
+  BS_TRANSPORT_SET_METHODS(http, transport);
+
+  assert(strncmp(transport->res->url, "http", 4) == 0);
+
+  pthread_once(&pool_once, pool_init);
+
+  if ((transport->state = malloc_zero(sizeof(http_state_t))) == NULL) {
+    goto err;
+  }
+  STATE->url = transport->res->url;
+
+  if ((STATE->multi = curl_multi_init()) == NULL) {
+    goto err;
+  }
+  curl_multi_setopt(STATE->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+  curl_multi_setopt(STATE->multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+                    (long)HTTP_MAX_RANGES);
+
+  if ((STATE->dec = bs_transport_decompress_create(
+         read_raw, STATE, transport->res->perf)) == NULL) {
+    goto err;
+  }
+
+  // the first request also tells us whether the server supports ranges (and
+  // the size of the resource). wait for its response so that failures are
+  // reported when the resource is opened
+  if (start_range(STATE, 0, HTTP_RANGE_LEN) != 0) {
+    goto err;
+  }
+  while (STATE->mode == HTTP_MODE_UNKNOWN && !STATE->ranges[0].done) {
+    if (drive(STATE, 1) != 0) {
+      goto err;
+    }
+  }
+  if (STATE->ranges[0].done && STATE->ranges[0].result != CURLE_OK) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "%s",
+                  STATE->ranges[0].errbuf[0] != '\0'
+                    ? STATE->ranges[0].errbuf
+                    : curl_easy_strerror(STATE->ranges[0].result));
+    goto err;
+  }
+
+  return 0;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open %s for reading",
+                transport->res->url);
+  bs_transport_http_destroy(transport);
+  return -1;
+}
+
+int64_t bs_transport_http_read(bgpstream_transport_t *transport,
+                               uint8_t *buffer, int64_t len)
+{
+  return bs_transport_decompress_read(STATE->dec, buffer, len);
+}
+
+int64_t bs_transport_http_readline(bgpstream_transport_t *transport,
+                                   uint8_t *buffer, int64_t len)
+{
+  return wandio_generic_fgets(transport, buffer, len, 1,
+                              (read_cb_t *)bs_transport_http_read);
+}
+
+void bs_transport_http_destroy(bgpstream_transport_t *transport)
+{
+  http_range_t *range;
+  int i;
+
+  if (transport->state == NULL) {
+    return;
+  }
+
+  for (i = 0; i < HTTP_MAX_RANGES; i++) {
+    range = &STATE->ranges[i];
+    if (range->attached) {
+      curl_multi_remove_handle(STATE->multi, range->easy);
+    }
+    if (range->easy != NULL) {
+      curl_easy_cleanup(range->easy);
+    }
+    free(range->buf);
+  }
+  if (STATE->multi != NULL) {
+    curl_multi_cleanup(STATE->multi);
+  }
+  bs_transport_decompress_destroy(STATE->dec);
+
+  free(transport->state);
+  transport->state = NULL;
+}
+
+#else
+
 // https://developer.mozilla.org/en-US/docs/Web/HTTP/Headers/User-Agent
 static char http_user_agent_hdr[] = "User-Agent: libbgpstream/"PACKAGE_VERSION;
 
@@ -74,3 +614,5 @@ void bs_transport_http_destroy(bgpstream_transport_t *transport)
     transport->state = NULL;
   }
 }
+
+#endif /* WITH_CURL */
@@ -28,9 +28,11 @@
 #include "bs_transport_kafka.h"
 #include "bgpstream_transport_interface.h"
 #include "bgpstream_log.h"
+#include "bgpstream_perf.h"
 #include "utils.h"
 #include <assert.h>
 #include <librdkafka/rdkafka.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -38,16 +40,108 @@
 
 #define POLL_TIMEOUT_MSEC 500
 
+#define METADATA_TIMEOUT_MSEC 10000
+
+// consumer settings used unless overridden by the KAFKA_CONFIG attribute
+static const char *default_config[][2] = {
+  // Disable logging of connection close/idle timeouts caused by Kafka 0.9.x
+  //   See https://github.com/edenhill/librdkafka/issues/437 for more details.
+  // TODO: change this when librdkafka has better handling of idle disconnects
+  {"log.connection.close", "false"},
+
+  // Enable SO_KEEPALIVE in case we're behind a NAT
+  {"socket.keepalive.enable", "true"},
+
+  // Try to prevent slow consumers from getting batches that they can't
+  // download within the 1 minute that rdkafka will wait.
+  {"fetch.message.max.bytes", BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_FETCH_MAX_BYTES},
+
+  // Don't let the broker wait long before giving us data. We want realtime!
+  {"fetch.wait.max.ms", BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_FETCH_WAIT_MS},
+
+  // We don't want to use range rebalance strategy since often our
+  // topics only have one partition.
+  // TODO: use an incremental strategy and allow group.instance.id to be set.
+  {"partition.assignment.strategy",
+   BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_ASSIGNMENT_STRATEGY},
+};
+
+// a message whose offset can be stored once the data it holds is processed
+typedef struct ckpt_msg {
+
+  // position just past the message in the bytes we have handed out
+  uint64_t end;
+
+  // length of the message
+  uint64_t len;
+
+  // where the message came from (topic names are interned in the state)
+  const char *topic;
+  int32_t partition;
+  int64_t offset;
+
+} ckpt_msg_t;
+
+// how far behind the end of a partition the consumer is
+typedef struct part_lag {
+
+  char *topic;
+  int32_t partition;
+
+  // offset of the last message read from the partition
+  int64_t offset;
+
+} part_lag_t;
+
 typedef struct state {
 
   // convenience local copies of attrs
   char *topic;
   char *group;
   char *offset;
+  char *config;
+  char *partitions;
+  int batch_size;
 
   // rdkafka instance
   rd_kafka_t *rk;
 
+  // consumer queue that batches are taken from
+  rd_kafka_queue_t *queue;
+
+  // messages of the current batch, handed out from batch_idx onwards
+  rd_kafka_message_t **batch;
+  int batch_cnt;
+  int batch_idx;
+
+  // bytes of batch[batch_idx] already returned by a previous read
+  size_t msg_off;
+
+  // are offsets only stored once acknowledged (see bgpstream_record_ack)?
+  int checkpoint;
+
+  // total number of bytes handed out by read/readline
+  uint64_t pos;
+
+  // messages handed out, in order, that have not been fully acknowledged yet.
+  // filled by the reader and drained by bs_transport_kafka_checkpoint, which
+  // may run on another thread, with ckpt_mutex held
+  ckpt_msg_t *ckpt;
+  size_t ckpt_head;
+  size_t ckpt_cnt;
+  size_t ckpt_alloc;
+  pthread_mutex_t ckpt_mutex;
+
+  // names of the topics we have seen messages from
+  char **topic_names;
+  int topic_names_cnt;
+
+  // partitions we have read from, and the lag summed over them (as accounted
+  // in the perf stats of the stream)
+  part_lag_t *lags;
+  int lags_cnt;
+  int64_t lag;
+
   // topics
   rd_kafka_topic_partition_list_t *topics;
 
@@ -62,6 +156,7 @@ typedef struct state {
 static int parse_attrs(bgpstream_transport_t *transport)
 {
   char buf[1024];
+  const char *attr;
   uint64_t ts;
 
   // Topic Name (required)
@@ -112,10 +207,43 @@ static int parse_attrs(bgpstream_transport_t *transport)
     }
   }
 
+  // Batch size (optional)
+  if ((attr = bgpstream_resource_get_attr(
+         transport->res, BGPSTREAM_RESOURCE_ATTR_KAFKA_BATCH_SIZE)) == NULL) {
+    STATE->batch_size = BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_BATCH_SIZE;
+  } else if ((STATE->batch_size = atoi(attr)) <= 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid Kafka batch size: '%s'", attr);
+    return -1;
+  }
+
+  // Partitions (optional, use group-managed assignment if not present)
+  if ((attr = bgpstream_resource_get_attr(
+         transport->res, BGPSTREAM_RESOURCE_ATTR_KAFKA_PARTITIONS)) != NULL &&
+      (STATE->partitions = strdup(attr)) == NULL) {
+    return -1;
+  }
+
+  // Checkpointing (optional, offsets are stored as messages are read if not
+  // present)
+  if ((attr = bgpstream_resource_get_attr(
+         transport->res, BGPSTREAM_RESOURCE_ATTR_KAFKA_CHECKPOINT)) != NULL) {
+    STATE->checkpoint = (strcmp(attr, "0") != 0);
+  }
+
+  // Consumer configuration overrides (optional)
+  if ((attr = bgpstream_resource_get_attr(
+         transport->res, BGPSTREAM_RESOURCE_ATTR_KAFKA_CONFIG)) != NULL &&
+      (STATE->config = strdup(attr)) == NULL) {
+    return -1;
+  }
+
   bgpstream_log(
     BGPSTREAM_LOG_FINE,
-    "Kafka transport: brokers: '%s', topic: '%s', group: '%s', offset: %s",
-    transport->res->url, STATE->topic, STATE->group, STATE->offset);
+    "Kafka transport: brokers: '%s', topic: '%s', group: '%s', offset: %s, "
+    "batch size: %d, partitions: %s",
+    transport->res->url, STATE->topic, STATE->group, STATE->offset,
+    STATE->batch_size,
+    (STATE->partitions != NULL) ? STATE->partitions : "all");
   return 0;
 }
 
@@ -145,10 +273,26 @@ static void kafka_error_callback(rd_kafka_t *rk, int err, const char *reason,
                 rd_kafka_err2str(err), err, reason);
 }
 
+static int set_config(rd_kafka_conf_t *conf, const char *name,
+                      const char *value)
+{
+  char errstr[512];
+
+  if (rd_kafka_conf_set(conf, name, value, errstr, sizeof(errstr)) !=
+      RD_KAFKA_CONF_OK) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Config Error: %s", errstr);
+    return -1;
+  }
+  bgpstream_log(BGPSTREAM_LOG_FINE, "Kafka config: %s=%s", name, value);
+  return 0;
+}
+
 static int init_kafka_config(bgpstream_transport_t *transport,
                              rd_kafka_conf_t *conf)
 {
   char errstr[512];
+  char *config, *c, *tok, *value;
+  int i;
 
   // Set the opaque pointer that will be passed to callbacks
   rd_kafka_conf_set_opaque(conf, transport);
@@ -170,43 +314,41 @@ static int init_kafka_config(bgpstream_transport_t *transport,
     return -1;
   }
 
-  // Disable logging of connection close/idle timeouts caused by Kafka 0.9.x
-  //   See https://github.com/edenhill/librdkafka/issues/437 for more details.
-  // TODO: change this when librdkafka has better handling of idle disconnects
-  if (rd_kafka_conf_set(conf, "log.connection.close", "false", errstr,
-                        sizeof(errstr)) != RD_KAFKA_CONF_OK) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Config Error: %s", errstr);
-    return -1;
-  }
-
-  // Enable SO_KEEPALIVE in case we're behind a NAT
-  if (rd_kafka_conf_set(conf, "socket.keepalive.enable", "true", errstr,
-                        sizeof(errstr)) != RD_KAFKA_CONF_OK) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Config Error: %s", errstr);
-    return -1;
-  }
-
-  // Try to prevent slow consumers from getting batches that they can't download
-  // within the 1 minute that rdkafka will wait.
-  if (rd_kafka_conf_set(conf, "fetch.message.max.bytes", "131072", errstr,
-                        sizeof(errstr)) != RD_KAFKA_CONF_OK) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Config Error: %s", errstr);
-    return -1;
+  // Apply our defaults, then whatever the user asked for
+  for (i = 0; i < ARR_CNT(default_config); i++) {
+    if (set_config(conf, default_config[i][0], default_config[i][1]) != 0) {
+      return -1;
+    }
   }
-
-  // Don't let the broker wait long before giving us data. We want realtime!
-  if (rd_kafka_conf_set(conf, "fetch.wait.max.ms", "50", errstr,
-                        sizeof(errstr)) != RD_KAFKA_CONF_OK) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Config Error: %s", errstr);
-    return -1;
+  if (STATE->config != NULL) {
+    if ((config = strdup(STATE->config)) == NULL) {
+      return -1;
+    }
+    c = config;
+    while ((tok = strsep(&c, "\n")) != NULL) {
+      if (*tok == '\0') {
+        continue;
+      }
+      if ((value = strchr(tok, '=')) == NULL) {
+        bgpstream_log(BGPSTREAM_LOG_ERR,
+                      "Kafka config '%s' is not of the form name=value", tok);
+        free(config);
+        return -1;
+      }
+      *(value++) = '\0';
+      if (set_config(conf, tok, value) != 0) {
+        free(config);
+        return -1;
+      }
+    }
+    free(config);
   }
 
-  // We don't want to use range rebalance strategy since often our
-  // topics only have one partition.
-  // TODO: use an incremental strategy and allow group.instance.id to be set.
-  if (rd_kafka_conf_set(conf, "partition.assignment.strategy", "roundrobin", errstr,
-                        sizeof(errstr)) != RD_KAFKA_CONF_OK) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "Config Error: %s", errstr);
+  // Only store the offsets of messages whose records have been acknowledged,
+  // these are then committed every auto.commit.interval.ms (and on close)
+  if (STATE->checkpoint != 0 &&
+      (set_config(conf, "enable.auto.offset.store", "false") != 0 ||
+       set_config(conf, "enable.auto.commit", "true") != 0)) {
     return -1;
   }
 
@@ -225,7 +367,8 @@ static int init_topic(bgpstream_transport_t *transport)
 {
   rd_kafka_resp_err_t err;
   int topics_cnt = 1;
-  char *t, *tok;
+  char *t, *tok, *p, *end;
+  long partition;
 
   // sigh, first we need to count the topics
   t = STATE->topic;
@@ -244,11 +387,34 @@ static int init_topic(bgpstream_transport_t *transport)
   // and now go through and split the string
   t = STATE->topic;
   while ((tok = strsep(&t, ",")) != NULL) {
-    bgpstream_log(BGPSTREAM_LOG_FINE, "Subscribing to %s", tok);
-    rd_kafka_topic_partition_list_add(STATE->topics, tok, -1);
+    if (STATE->partitions == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_FINE, "Subscribing to %s", tok);
+      rd_kafka_topic_partition_list_add(STATE->topics, tok, -1);
+      continue;
+    }
+    // only consume the given partitions of each topic
+    p = STATE->partitions;
+    while (*p != '\0') {
+      partition = strtol(p, &end, 10);
+      if (end == p || partition < 0 || (*end != ',' && *end != '\0')) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid Kafka partition list: '%s'",
+                      STATE->partitions);
+        return -1;
+      }
+      bgpstream_log(BGPSTREAM_LOG_FINE, "Assigning %s [%ld]", tok, partition);
+      rd_kafka_topic_partition_list_add(STATE->topics, tok, partition);
+      p = (*end == ',') ? end + 1 : end;
+    }
   }
 
-  if ((err = rd_kafka_subscribe(STATE->rk, STATE->topics)) != 0) {
+  if (STATE->partitions != NULL) {
+    // the partitions are fixed, so there is no rebalancing to wait for
+    if ((err = rd_kafka_assign(STATE->rk, STATE->topics)) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not assign topic partitions: %s",
+                    rd_kafka_err2str(err));
+      return -1;
+    }
+  } else if ((err = rd_kafka_subscribe(STATE->rk, STATE->topics)) != 0) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "Could not start topic consumer: %s",
                   rd_kafka_err2str(err));
     return -1;
@@ -271,6 +437,10 @@ int bs_transport_kafka_create(bgpstream_transport_t *transport)
   if (parse_attrs(transport) != 0) {
     return -1;
   }
+  if (STATE->checkpoint != 0) {
+    pthread_mutex_init(&STATE->ckpt_mutex, NULL);
+    transport->checkpoint = bs_transport_kafka_checkpoint;
+  }
 
   // create Kafka config
   if ((conf = rd_kafka_conf_new()) == NULL ||
@@ -308,8 +478,16 @@ int bs_transport_kafka_create(bgpstream_transport_t *transport)
     return -1;
   }
 
-  // switch to consumer poll mode
+  // switch to consumer poll mode and grab the queue we consume batches from
   rd_kafka_poll_set_consumer(STATE->rk);
+  if ((STATE->queue = rd_kafka_queue_get_consumer(STATE->rk)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not get Kafka consumer queue");
+    return -1;
+  }
+  if ((STATE->batch = malloc(sizeof(rd_kafka_message_t *) *
+                             STATE->batch_size)) == NULL) {
+    return -1;
+  }
 
   bgpstream_log(BGPSTREAM_LOG_FINE, "Kafka connected!");
   return 0;
@@ -334,60 +512,321 @@ static int handle_err_msg(bgpstream_transport_t *transport,
   return rc;
 }
 
-int64_t bs_transport_kafka_readline(bgpstream_transport_t *transport,
-                                    uint8_t *buffer, int64_t len)
+// note the offset of a message, for the lag of its partition
+static int note_lag(bgpstream_transport_t *transport,
+                    rd_kafka_message_t *rk_msg)
 {
-  int rc = bs_transport_kafka_read(transport, buffer, len - 1);
+  const char *name = rd_kafka_topic_name(rk_msg->rkt);
+  part_lag_t *pl;
+  int i;
+
+  for (i = 0; i < STATE->lags_cnt; i++) {
+    pl = &STATE->lags[i];
+    if (pl->partition == rk_msg->partition && strcmp(pl->topic, name) == 0) {
+      if (rk_msg->offset > pl->offset) {
+        pl->offset = rk_msg->offset;
+      }
+      return 0;
+    }
+  }
+  if ((pl = realloc(STATE->lags, sizeof(*pl) * (STATE->lags_cnt + 1))) ==
+      NULL) {
+    return -1;
+  }
+  STATE->lags = pl;
+  pl = &STATE->lags[STATE->lags_cnt];
+  if ((pl->topic = strdup(name)) == NULL) {
+    return -1;
+  }
+  pl->partition = rk_msg->partition;
+  pl->offset = rk_msg->offset;
+  STATE->lags_cnt++;
+  return 0;
+}
 
-  if (rc <= 0) {
-    return rc;
+// update the lag of the consumer from the (cached) high watermarks of the
+// partitions it reads from
+static void update_lag(bgpstream_transport_t *transport)
+{
+  int64_t low, high, lag = 0;
+  int i;
+
+  for (i = 0; i < STATE->lags_cnt; i++) {
+    if (rd_kafka_get_watermark_offsets(STATE->rk, STATE->lags[i].topic,
+                                       STATE->lags[i].partition, &low,
+                                       &high) == RD_KAFKA_RESP_ERR_NO_ERROR &&
+        high > STATE->lags[i].offset + 1) {
+      lag += high - STATE->lags[i].offset - 1;
+    }
   }
+  bgpstream_perf_add_kafka_lag(transport->res->perf, lag - STATE->lag);
+  STATE->lag = lag;
+}
 
-  buffer[rc] = '\0';
-  // NOTE: we assume there is only one line per kafka message
-  assert(strchr((char *)buffer, '\n') == NULL);
+// wait for the next batch of messages. returns the number of messages
+// received, which is 0 if none arrived before the poll timeout
+static int fill_batch(bgpstream_transport_t *transport)
+{
+  ssize_t cnt, i;
 
-  return rc;
+  assert(STATE->batch_idx == STATE->batch_cnt);
+  STATE->batch_idx = STATE->batch_cnt = 0;
+  STATE->msg_off = 0;
+
+  if ((cnt = rd_kafka_consume_batch_queue(STATE->queue, POLL_TIMEOUT_MSEC,
+                                          STATE->batch, STATE->batch_size)) <
+      0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not consume from Kafka: %s",
+                  rd_kafka_err2str(rd_kafka_last_error()));
+    return -1;
+  }
+  STATE->batch_cnt = cnt;
+
+  if (cnt > 0) {
+    for (i = 0; i < cnt; i++) {
+      if (STATE->batch[i]->err == 0 &&
+          note_lag(transport, STATE->batch[i]) != 0) {
+        return -1;
+      }
+    }
+    update_lag(transport);
+  }
+  return cnt;
 }
 
-int64_t bs_transport_kafka_read(bgpstream_transport_t *transport,
-                                uint8_t *buffer, int64_t len)
+// take the current message out of the batch. the caller must destroy it
+static rd_kafka_message_t *pop_msg(bgpstream_transport_t *transport)
+{
+  STATE->msg_off = 0;
+  return STATE->batch[STATE->batch_idx++];
+}
+
+// remember where the given message ends in the data we hand out, so that its
+// offset can be stored once it has been processed
+static int note_msg(bgpstream_transport_t *transport,
+                    rd_kafka_message_t *rk_msg)
+{
+  const char *name = rd_kafka_topic_name(rk_msg->rkt);
+  ckpt_msg_t *tmp;
+  char **names;
+  int i;
+
+  // topic names live as long as we do (there are normally only a few)
+  for (i = 0; i < STATE->topic_names_cnt; i++) {
+    if (strcmp(STATE->topic_names[i], name) == 0) {
+      break;
+    }
+  }
+  if (i == STATE->topic_names_cnt) {
+    if ((names = realloc(STATE->topic_names,
+                         sizeof(char *) * (STATE->topic_names_cnt + 1))) ==
+        NULL) {
+      return -1;
+    }
+    STATE->topic_names = names;
+    if ((STATE->topic_names[i] = strdup(name)) == NULL) {
+      return -1;
+    }
+    STATE->topic_names_cnt++;
+  }
+
+  pthread_mutex_lock(&STATE->ckpt_mutex);
+  // drop acknowledged messages from the front before growing
+  if (STATE->ckpt_head + STATE->ckpt_cnt == STATE->ckpt_alloc &&
+      STATE->ckpt_head != 0) {
+    memmove(STATE->ckpt, STATE->ckpt + STATE->ckpt_head,
+            sizeof(ckpt_msg_t) * STATE->ckpt_cnt);
+    STATE->ckpt_head = 0;
+  }
+  if (STATE->ckpt_cnt == STATE->ckpt_alloc) {
+    if ((tmp = realloc(STATE->ckpt, sizeof(ckpt_msg_t) *
+                                      (STATE->ckpt_alloc * 2 + 64))) == NULL) {
+      pthread_mutex_unlock(&STATE->ckpt_mutex);
+      return -1;
+    }
+    STATE->ckpt = tmp;
+    STATE->ckpt_alloc = STATE->ckpt_alloc * 2 + 64;
+  }
+  tmp = &STATE->ckpt[STATE->ckpt_head + STATE->ckpt_cnt++];
+  tmp->end = STATE->pos + rk_msg->len;
+  tmp->len = rk_msg->len;
+  tmp->topic = STATE->topic_names[i];
+  tmp->partition = rk_msg->partition;
+  tmp->offset = rk_msg->offset;
+  pthread_mutex_unlock(&STATE->ckpt_mutex);
+  return 0;
+}
+
+// set the offset to commit for the partition of the given message
+static void set_ckpt_offset(rd_kafka_topic_partition_list_t *list,
+                            ckpt_msg_t *msg, int64_t offset)
+{
+  rd_kafka_topic_partition_t *tp;
+
+  if ((tp = rd_kafka_topic_partition_list_find(list, msg->topic,
+                                               msg->partition)) == NULL) {
+    tp = rd_kafka_topic_partition_list_add(list, msg->topic, msg->partition);
+  }
+  tp->offset = offset;
+}
+
+int bs_transport_kafka_checkpoint(bgpstream_transport_t *transport,
+                                  uint64_t pos)
+{
+  rd_kafka_topic_partition_list_t *list;
+  rd_kafka_resp_err_t err;
+  ckpt_msg_t *msg;
+
+  if ((list = rd_kafka_topic_partition_list_new(1)) == NULL) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&STATE->ckpt_mutex);
+  while (STATE->ckpt_cnt > 0) {
+    msg = &STATE->ckpt[STATE->ckpt_head];
+    if (msg->end <= pos) {
+      // the message is done, so we resume after it
+      set_ckpt_offset(list, msg, msg->offset + 1);
+      STATE->ckpt_head++;
+      STATE->ckpt_cnt--;
+      continue;
+    }
+    if (msg->end - msg->len < pos) {
+      // but a message that pos falls within has to be read again
+      set_ckpt_offset(list, msg, msg->offset);
+    }
+    break;
+  }
+  if (STATE->ckpt_cnt == 0) {
+    STATE->ckpt_head = 0;
+  }
+  pthread_mutex_unlock(&STATE->ckpt_mutex);
+
+  if (list->cnt > 0 && (err = rd_kafka_offsets_store(STATE->rk, list)) != 0) {
+    // e.g., the partition was revoked, in which case its new owner resumes
+    // from the last committed offset
+    bgpstream_log(BGPSTREAM_LOG_WARN, "Could not store Kafka offsets: %s",
+                  rd_kafka_err2str(err));
+  }
+  rd_kafka_topic_partition_list_destroy(list);
+  return 0;
+}
+
+int64_t bs_transport_kafka_readline(bgpstream_transport_t *transport,
+                                    uint8_t *buffer, int64_t len)
 {
   rd_kafka_message_t *rk_msg;
+  int rc;
 
-  // see if there is a message waiting for us
-  // POLL_TIMEOUT_MSEC is set very low (0) since the transport should be
-  // non-blocking
-  if ((rk_msg = rd_kafka_consumer_poll(STATE->rk, POLL_TIMEOUT_MSEC)) == NULL) {
-    return 0;
+  // NOTE: we assume there is only one line per kafka message
+  assert(STATE->msg_off == 0);
+  if (STATE->batch_idx == STATE->batch_cnt &&
+      (rc = fill_batch(transport)) <= 0) {
+    return rc;
   }
+  rk_msg = pop_msg(transport);
   if (rk_msg->err != 0) {
     return handle_err_msg(transport, rk_msg);
   }
 
-  // is the message too long?
-  // if this is really a problem (e.g., batches of MRT/BMP messages
-  // produced into a single Kafka message, then we can use a local
-  // buffer and split them up for the caller, but really the caller
-  // should have a large enough buffer.. so for now:
-  assert(rk_msg->len <= len);
-
-  // copy the message into the provided buffer
+  if ((int64_t)rk_msg->len >= len) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Kafka message of %zu bytes does not fit a %" PRId64
+                  " byte line",
+                  rk_msg->len, len);
+    rd_kafka_message_destroy(rk_msg);
+    return -1;
+  }
+  if (STATE->checkpoint != 0 && note_msg(transport, rk_msg) != 0) {
+    rd_kafka_message_destroy(rk_msg);
+    return -1;
+  }
   memcpy(buffer, rk_msg->payload, rk_msg->len);
+  buffer[rk_msg->len] = '\0';
   len = rk_msg->len;
+  STATE->pos += len;
   rd_kafka_message_destroy(rk_msg);
+  assert(strchr((char *)buffer, '\n') == NULL);
 
   return len;
 }
 
+int64_t bs_transport_kafka_read(bgpstream_transport_t *transport,
+                                uint8_t *buffer, int64_t len)
+{
+  rd_kafka_message_t *rk_msg;
+  int64_t written = 0;
+  size_t remain;
+  int rc;
+
+  // pack as many messages of the batch as we can into the buffer
+  while (written < len) {
+    if (STATE->batch_idx == STATE->batch_cnt) {
+      // only wait for more messages when we have nothing to give back yet
+      if (written != 0) {
+        break;
+      }
+      if ((rc = fill_batch(transport)) <= 0) {
+        return rc;
+      }
+    }
+    rk_msg = STATE->batch[STATE->batch_idx];
+
+    if (rk_msg->err != 0) {
+      // report errors only once the data that came before them is consumed
+      if (written != 0) {
+        break;
+      }
+      return handle_err_msg(transport, pop_msg(transport));
+    }
+
+    // OpenBMP headers must not be split, so only split a message across
+    // reads when it does not fit in the buffer on its own
+    remain = rk_msg->len - STATE->msg_off;
+    if (remain > (size_t)(len - written)) {
+      if (written != 0) {
+        break;
+      }
+      remain = len;
+    }
+    if (STATE->checkpoint != 0 && STATE->msg_off == 0 &&
+        note_msg(transport, rk_msg) != 0) {
+      return -1;
+    }
+    memcpy(buffer + written, (uint8_t *)rk_msg->payload + STATE->msg_off,
+           remain);
+    written += remain;
+    STATE->msg_off += remain;
+    STATE->pos += remain;
+
+    if (STATE->msg_off == rk_msg->len) {
+      rd_kafka_message_destroy(pop_msg(transport));
+    }
+  }
+
+  return written;
+}
+
 void bs_transport_kafka_destroy(bgpstream_transport_t *transport)
 {
   rd_kafka_resp_err_t err;
+  int i;
 
   if (transport->state == NULL) {
     return;
   }
 
+  // release whatever is left of the current batch
+  while (STATE->batch_idx < STATE->batch_cnt) {
+    rd_kafka_message_destroy(pop_msg(transport));
+  }
+  free(STATE->batch);
+
+  if (STATE->queue != NULL) {
+    rd_kafka_queue_destroy(STATE->queue);
+    STATE->queue = NULL;
+  }
+
   if (STATE->rk != NULL) {
     // shut down consumer
     if ((err = rd_kafka_consumer_close(STATE->rk)) != 0) {
@@ -406,7 +845,94 @@ void bs_transport_kafka_destroy(bgpstream_transport_t *transport)
   free(STATE->topic);
   free(STATE->group);
   free(STATE->offset);
+  free(STATE->config);
+  free(STATE->partitions);
+
+  if (STATE->checkpoint != 0) {
+    pthread_mutex_destroy(&STATE->ckpt_mutex);
+  }
+  free(STATE->ckpt);
+  for (i = 0; i < STATE->topic_names_cnt; i++) {
+    free(STATE->topic_names[i]);
+  }
+  free(STATE->topic_names);
+
+  // this consumer's lag no longer counts
+  bgpstream_perf_add_kafka_lag(transport->res->perf, -STATE->lag);
+  for (i = 0; i < STATE->lags_cnt; i++) {
+    free(STATE->lags[i].topic);
+  }
+  free(STATE->lags);
 
   free(transport->state);
   transport->state = NULL;
 }
+
+int bs_transport_kafka_get_partition_cnt(const char *brokers,
+                                         const char *topics)
+{
+  rd_kafka_t *rk = NULL;
+  rd_kafka_topic_t *rkt = NULL;
+  const struct rd_kafka_metadata *md = NULL;
+  rd_kafka_resp_err_t err;
+  char errstr[512];
+  char *names = NULL, *t, *tok;
+  int cnt = 0;
+
+  // a producer handle is enough to ask for metadata, and needs no group
+  if ((rk = rd_kafka_new(RD_KAFKA_PRODUCER, NULL, errstr, sizeof(errstr))) ==
+      NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create Kafka handle: %s",
+                  errstr);
+    goto err;
+  }
+  if (rd_kafka_brokers_add(rk, brokers) == 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not add Kafka brokers");
+    goto err;
+  }
+
+  if ((names = strdup(topics)) == NULL) {
+    goto err;
+  }
+  t = names;
+  while ((tok = strsep(&t, ",")) != NULL) {
+    if ((rkt = rd_kafka_topic_new(rk, tok, NULL)) == NULL) {
+      goto err;
+    }
+    if ((err = rd_kafka_metadata(rk, 0, rkt, &md, METADATA_TIMEOUT_MSEC)) !=
+        0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not get metadata for %s: %s",
+                    tok, rd_kafka_err2str(err));
+      goto err;
+    }
+    if (md->topic_cnt != 1 || md->topics[0].err != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not find Kafka topic %s", tok);
+      goto err;
+    }
+    // partition groups apply to every topic, so cover the largest one
+    if (md->topics[0].partition_cnt > cnt) {
+      cnt = md->topics[0].partition_cnt;
+    }
+    rd_kafka_metadata_destroy(md);
+    md = NULL;
+    rd_kafka_topic_destroy(rkt);
+    rkt = NULL;
+  }
+
+  free(names);
+  rd_kafka_destroy(rk);
+  return cnt;
+
+err:
+  if (md != NULL) {
+    rd_kafka_metadata_destroy(md);
+  }
+  if (rkt != NULL) {
+    rd_kafka_topic_destroy(rkt);
+  }
+  free(names);
+  if (rk != NULL) {
+    rd_kafka_destroy(rk);
+  }
+  return -1;
+}
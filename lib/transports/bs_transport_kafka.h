@@ -33,4 +33,39 @@ BS_TRANSPORT_GENERATE_PROTOS(kafka)
 
 #define BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_OFFSET "latest"
 
+/** Maximum number of messages taken from the consumer queue at once */
+#define BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_BATCH_SIZE 64
+
+/** Default value of the "fetch.message.max.bytes" consumer setting */
+#define BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_FETCH_MAX_BYTES "131072"
+
+/** Default value of the "fetch.wait.max.ms" consumer setting */
+#define BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_FETCH_WAIT_MS "50"
+
+/** Default value of the "partition.assignment.strategy" consumer setting */
+#define BGPSTREAM_TRANSPORT_KAFKA_DEFAULT_ASSIGNMENT_STRATEGY "roundrobin"
+
+/** Store the offsets of the messages processed up to the given position
+ *
+ * @param transport     pointer to a Kafka transport with checkpointing enabled
+ * @param pos           number of bytes read from the transport that have been
+ *                      fully processed
+ * @return 0 if successful, -1 otherwise
+ *
+ * A message that has only been partly processed is read again after a
+ * restart. Stored offsets are committed every auto.commit.interval.ms.
+ */
+int bs_transport_kafka_checkpoint(bgpstream_transport_t *transport,
+                                  uint64_t pos);
+
+/** Get the number of partitions of the given Kafka topics
+ *
+ * @param brokers       comma-separated list of brokers to ask
+ * @param topics        comma-separated list of topics
+ * @return the partition count of the topic with the most partitions, or -1 if
+ * the metadata could not be retrieved
+ */
+int bs_transport_kafka_get_partition_cnt(const char *brokers,
+                                         const char *topics);
+
 #endif /* __BS_TRANSPORT_KAFKA_H */
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bs_transport_shmring.h"
+#include "bgpstream_log.h"
+#include "bgpstream_shmring.h"
+#include "utils.h"
+#include "wandio.h"
+#include <string.h>
+
+#define STATE ((bgpstream_shmring_t *)(transport->state))
+
+int bs_transport_shmring_create(bgpstream_transport_t *transport)
+{
+  const char *url = transport->res->url;
+
+  BS_TRANSPORT_SET_METHODS(shmring, transport);
+
+  if (strncmp(url, BS_TRANSPORT_SHMRING_URL_PREFIX,
+              strlen(BS_TRANSPORT_SHMRING_URL_PREFIX)) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid shared memory ring URL %s", url);
+    return -1;
+  }
+  if ((transport->state = bgpstream_shmring_attach(
+         url + strlen(BS_TRANSPORT_SHMRING_URL_PREFIX))) == NULL) {
+    return -1;
+  }
+  return 0;
+}
+
+int64_t bs_transport_shmring_read(bgpstream_transport_t *transport,
+                                  uint8_t *buffer, int64_t len)
+{
+  return bgpstream_shmring_read(STATE, buffer, len);
+}
+
+int64_t bs_transport_shmring_readline(bgpstream_transport_t *transport,
+                                      uint8_t *buffer, int64_t len)
+{
+  return wandio_generic_fgets(transport, buffer, len, 1,
+                              (read_cb_t *)bs_transport_shmring_read);
+}
+
+void bs_transport_shmring_destroy(bgpstream_transport_t *transport)
+{
+  bgpstream_shmring_destroy(STATE);
+  transport->state = NULL;
+}
@@ -0,0 +1,622 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bs_transport_uring.h"
+#include "bgpstream_log.h"
+#include "utils.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/** Number of submission queue entries of the ring */
+#define URING_SQ_ENTRIES 256
+
+/** Number of completion queue entries of the ring (i.e., the number of reads
+    that may be in flight before the kernel has to hold completions back) */
+#define URING_CQ_ENTRIES 4096
+
+/** Number of reads queued ahead of the consumer of each file */
+#define URING_DEPTH 4
+
+/** Length of each read */
+#define URING_BUF_LEN (128 * 1024)
+
+/** Number of buffers registered with the kernel (shared by all files; files
+    that find none left use unregistered buffers) */
+#define URING_FIXED_BUFS 64
+
+typedef struct uring_req {
+
+  /** File the read is for */
+  bs_transport_uring_file_t *file;
+
+  /** Buffer of URING_BUF_LEN bytes, and its index among the registered
+      buffers (-1 if it is not registered) */
+  uint8_t *buf;
+  int fixed;
+
+  /** Offset of the read in the file */
+  uint64_t file_off;
+
+  /** Set while the read is in flight */
+  int pending;
+
+  /** Number of bytes read, or -errno (once the read has completed) */
+  int64_t res;
+
+  /** Number of bytes given to the consumer */
+  int64_t used;
+
+  /** Set if the read was failed while the kernel may still do it (its buffer
+      must then not be reused) */
+  int abandoned;
+
+} uring_req_t;
+
+struct bs_transport_uring_file {
+
+  int fd;
+
+  /** Size of the file (when last checked) */
+  uint64_t size;
+
+  /** Offset of the next read to queue */
+  uint64_t next_off;
+
+  /** Set once everything up to the size of the file has been queued */
+  int eof;
+
+  /** Ring of reads, consumed in order starting at head */
+  uring_req_t reqs[URING_DEPTH];
+  int head;
+  int queued;
+
+  /** Signalled when a read of this file completes */
+  pthread_cond_t cond;
+
+  /** List of the open files */
+  struct bs_transport_uring_file *prev;
+  struct bs_transport_uring_file *next;
+};
+
+/** The process-wide ring */
+static struct {
+
+  int fd;
+
+  /* submission queue */
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_entries;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+
+  /* completion queue */
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+
+  /* registered buffers (NULL if they could not be registered), and the
+     indexes of those not in use */
+  uint8_t *fixed;
+  int fixed_free[URING_FIXED_BUFS];
+  int fixed_free_cnt;
+
+  /* protects the submission queue, and the state of all files */
+  pthread_mutex_t mutex;
+
+  /* thread that reaps completions */
+  pthread_t reaper;
+
+  /* open files (so that their waiters can be woken if the reaper fails) */
+  bs_transport_uring_file_t *files;
+
+  /* set if the ring is usable */
+  int ok;
+
+  /* errno of the reaper's failure, after which no read completes */
+  int failed;
+
+} ring = {
+  .fd = -1,
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static pthread_once_t ring_once = PTHREAD_ONCE_INIT;
+
+static int sys_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                           unsigned flags)
+{
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                      NULL, 0);
+}
+
+static int sys_uring_register(int fd, unsigned opcode, void *arg,
+                              unsigned nr_args)
+{
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// completes the given read with an error (with the mutex held)
+static void fail_req(uring_req_t *req, int err)
+{
+  req->res = -err;
+  req->pending = 0;
+  pthread_cond_signal(&req->file->cond);
+}
+
+// fails every read that is still in flight, once the reaper can no longer
+// complete them (with the mutex held)
+static void fail_all(int err)
+{
+  bs_transport_uring_file_t *file;
+  int i;
+
+  ring.failed = err;
+  ring.ok = 0;
+  for (file = ring.files; file != NULL; file = file->next) {
+    for (i = 0; i < URING_DEPTH; i++) {
+      if (file->reqs[i].pending != 0) {
+        file->reqs[i].abandoned = 1;
+        fail_req(&file->reqs[i], err);
+      }
+    }
+  }
+}
+
+// hands completed reads to their files, until the ring fails
+static void *reaper(void *unused)
+{
+  struct io_uring_cqe *cqe;
+  uring_req_t *req;
+  unsigned head;
+
+  while (1) {
+    if (sys_uring_enter(ring.fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+        errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "io_uring wait failed: %s",
+                    strerror(errno));
+      pthread_mutex_lock(&ring.mutex);
+      fail_all(errno);
+      pthread_mutex_unlock(&ring.mutex);
+      return NULL;
+    }
+    pthread_mutex_lock(&ring.mutex);
+    head = *ring.cq_head;
+    while (head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+      cqe = &ring.cqes[head & *ring.cq_mask];
+      req = (uring_req_t *)(uintptr_t)cqe->user_data;
+      req->res = cqe->res;
+      req->pending = 0;
+      pthread_cond_signal(&req->file->cond);
+      head++;
+    }
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&ring.mutex);
+  }
+  return NULL;
+}
+
+static void register_buffers(void)
+{
+  struct iovec iovs[URING_FIXED_BUFS];
+  int i;
+
+  if ((ring.fixed = mmap(NULL, (size_t)URING_FIXED_BUFS * URING_BUF_LEN,
+                         PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                         -1, 0)) == MAP_FAILED) {
+    ring.fixed = NULL;
+    return;
+  }
+  for (i = 0; i < URING_FIXED_BUFS; i++) {
+    iovs[i].iov_base = ring.fixed + (size_t)i * URING_BUF_LEN;
+    iovs[i].iov_len = URING_BUF_LEN;
+    ring.fixed_free[i] = i;
+  }
+  if (sys_uring_register(ring.fd, IORING_REGISTER_BUFFERS, iovs,
+                         URING_FIXED_BUFS) != 0) {
+    // (usually because of RLIMIT_MEMLOCK) reads still work without them
+    bgpstream_log(BGPSTREAM_LOG_FINE, "could not register io_uring buffers: %s",
+                  strerror(errno));
+    munmap(ring.fixed, (size_t)URING_FIXED_BUFS * URING_BUF_LEN);
+    ring.fixed = NULL;
+    return;
+  }
+  ring.fixed_free_cnt = URING_FIXED_BUFS;
+}
+
+static void ring_init(void)
+{
+  struct io_uring_params p;
+  uint8_t *sq_ptr, *cq_ptr;
+  size_t sq_len, cq_len;
+
+  memset(&p, 0, sizeof(p));
+  p.flags = IORING_SETUP_CQSIZE;
+  p.cq_entries = URING_CQ_ENTRIES;
+  if ((ring.fd = sys_uring_setup(URING_SQ_ENTRIES, &p)) < 0) {
+    bgpstream_log(BGPSTREAM_LOG_FINE, "io_uring not available: %s",
+                  strerror(errno));
+    return;
+  }
+  // (reads need Linux 5.6, which also maps both queues at once)
+  if ((p.features & IORING_FEAT_SINGLE_MMAP) == 0 ||
+      (p.features & IORING_FEAT_NODROP) == 0) {
+    goto err;
+  }
+
+  sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (cq_len > sq_len) {
+    sq_len = cq_len;
+  }
+  if ((sq_ptr = mmap(NULL, sq_len, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING)) ==
+      MAP_FAILED) {
+    goto err;
+  }
+  cq_ptr = sq_ptr;
+  if ((ring.sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring.fd, IORING_OFF_SQES)) == MAP_FAILED) {
+    munmap(sq_ptr, sq_len);
+    goto err;
+  }
+
+  ring.sq_head = (unsigned *)(sq_ptr + p.sq_off.head);
+  ring.sq_tail = (unsigned *)(sq_ptr + p.sq_off.tail);
+  ring.sq_mask = (unsigned *)(sq_ptr + p.sq_off.ring_mask);
+  ring.sq_entries = (unsigned *)(sq_ptr + p.sq_off.ring_entries);
+  ring.sq_array = (unsigned *)(sq_ptr + p.sq_off.array);
+  ring.cq_head = (unsigned *)(cq_ptr + p.cq_off.head);
+  ring.cq_tail = (unsigned *)(cq_ptr + p.cq_off.tail);
+  ring.cq_mask = (unsigned *)(cq_ptr + p.cq_off.ring_mask);
+  ring.cqes = (struct io_uring_cqe *)(cq_ptr + p.cq_off.cqes);
+
+  register_buffers();
+
+  if (pthread_create(&ring.reaper, NULL, reaper, NULL) != 0) {
+    // (the ring is left mapped: it is never used)
+    goto err;
+  }
+  pthread_detach(ring.reaper);
+
+  ring.ok = 1;
+  return;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_FINE, "io_uring not available");
+  close(ring.fd);
+  ring.fd = -1;
+}
+
+// fails the entries that the kernel has not taken from the submission queue,
+// and takes them back (with the mutex held, so no one is entering the ring)
+static void fail_unsubmitted(int err)
+{
+  unsigned head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+  unsigned tail = *ring.sq_tail;
+  struct io_uring_sqe *sqe;
+
+  while (tail != head) {
+    tail--;
+    sqe = &ring.sqes[ring.sq_array[tail & *ring.sq_mask]];
+    fail_req((uring_req_t *)(uintptr_t)sqe->user_data, err);
+  }
+  __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+}
+
+// queues a read (with the mutex held, which is dropped while the kernel is
+// short of resources, so that the reaper can drain the completions)
+static void submit(uring_req_t *req)
+{
+  struct io_uring_sqe *sqe;
+  unsigned tail = *ring.sq_tail;
+  unsigned idx = tail & *ring.sq_mask;
+  unsigned todo;
+
+  req->used = 0;
+  if (ring.failed != 0 ||
+      tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) ==
+        *ring.sq_entries) {
+    // (the queue can only be full while other submitters are waiting)
+    fail_req(req, ring.failed != 0 ? ring.failed : EBUSY);
+    return;
+  }
+
+  sqe = &ring.sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  if (req->fixed >= 0) {
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->buf_index = req->fixed;
+  } else {
+    sqe->opcode = IORING_OP_READ;
+  }
+  sqe->fd = req->file->fd;
+  sqe->off = req->file_off;
+  sqe->addr = (uintptr_t)req->buf;
+  sqe->len = URING_BUF_LEN;
+  sqe->user_data = (uintptr_t)req;
+  ring.sq_array[idx] = idx;
+  __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  req->pending = 1;
+
+  // submit whatever is queued (which, while we wait, other threads may have
+  // added to, or submitted for us)
+  while ((todo = *ring.sq_tail -
+                 __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE)) != 0) {
+    if (sys_uring_enter(ring.fd, todo, 0, 0) >= 0 || errno == EINTR) {
+      continue;
+    }
+    if (errno != EAGAIN && errno != EBUSY) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "io_uring submission failed: %s",
+                    strerror(errno));
+      fail_unsubmitted(errno);
+      break;
+    }
+    // (the kernel is short of resources, or holding completions back until
+    // the reaper has drained them)
+    pthread_mutex_unlock(&ring.mutex);
+    sched_yield();
+    pthread_mutex_lock(&ring.mutex);
+  }
+}
+
+// queues reads until the file has URING_DEPTH in flight, or everything up to
+// its end is queued (with the mutex held)
+static void queue_reads(bs_transport_uring_file_t *file)
+{
+  uring_req_t *req;
+
+  while (file->eof == 0 && file->queued < URING_DEPTH) {
+    if (file->next_off >= file->size) {
+      file->eof = 1;
+      break;
+    }
+    req = &file->reqs[(file->head + file->queued) % URING_DEPTH];
+    req->file_off = file->next_off;
+    file->next_off += URING_BUF_LEN;
+    file->queued++;
+    submit(req);
+  }
+}
+
+// waits for the given read to complete (with the mutex held)
+static void wait_req(uring_req_t *req)
+{
+  while (req->pending != 0) {
+    pthread_cond_wait(&req->file->cond, &ring.mutex);
+  }
+}
+
+// once everything queued has been consumed, checks whether the file has grown
+// (with the mutex held). returns 1 if there is more to read, 0 otherwise
+static int queue_more(bs_transport_uring_file_t *file)
+{
+  struct stat st;
+
+  if (file->queued == 0 && fstat(file->fd, &st) == 0 &&
+      (uint64_t)st.st_size > file->next_off) {
+    file->size = st.st_size;
+    file->eof = 0;
+    queue_reads(file);
+  }
+  return file->queued != 0;
+}
+
+// drops the oldest read once it has been consumed (with the mutex held)
+static void release_head(bs_transport_uring_file_t *file)
+{
+  uring_req_t *req = &file->reqs[file->head];
+  int i;
+
+  file->head = (file->head + 1) % URING_DEPTH;
+  file->queued--;
+
+  if (req->res < URING_BUF_LEN) {
+    // a short read: the reads queued after it start at the wrong offset
+    for (i = 0; i < file->queued; i++) {
+      wait_req(&file->reqs[(file->head + i) % URING_DEPTH]);
+    }
+    file->queued = 0;
+    file->next_off = req->file_off + req->res;
+    if (req->res == 0) {
+      // the file is shorter than it was
+      file->size = file->next_off;
+    }
+  }
+  queue_reads(file);
+}
+
+/* ========== PUBLIC FUNCTIONS BELOW ========== */
+
+bs_transport_uring_file_t *bs_transport_uring_open(const char *path)
+{
+  bs_transport_uring_file_t *file;
+  struct stat st;
+  int fd, i;
+
+  pthread_once(&ring_once, ring_init);
+  if (ring.ok == 0) {
+    return NULL;
+  }
+
+  if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+      (file = malloc_zero(sizeof(bs_transport_uring_file_t))) == NULL) {
+    close(fd);
+    return NULL;
+  }
+  file->fd = fd;
+  file->size = st.st_size;
+  pthread_cond_init(&file->cond, NULL);
+  for (i = 0; i < URING_DEPTH; i++) {
+    file->reqs[i].file = file;
+    file->reqs[i].fixed = -1;
+  }
+
+  pthread_mutex_lock(&ring.mutex);
+  for (i = 0; i < URING_DEPTH; i++) {
+    if (ring.fixed_free_cnt > 0) {
+      file->reqs[i].fixed = ring.fixed_free[--ring.fixed_free_cnt];
+      file->reqs[i].buf =
+        ring.fixed + (size_t)file->reqs[i].fixed * URING_BUF_LEN;
+    } else {
+      file->reqs[i].fixed = -1;
+      if ((file->reqs[i].buf = malloc(URING_BUF_LEN)) == NULL) {
+        pthread_mutex_unlock(&ring.mutex);
+        bs_transport_uring_close(file);
+        return NULL;
+      }
+    }
+  }
+  if ((file->next = ring.files) != NULL) {
+    file->next->prev = file;
+  }
+  ring.files = file;
+  queue_reads(file);
+  pthread_mutex_unlock(&ring.mutex);
+
+  return file;
+}
+
+int64_t bs_transport_uring_peek(bs_transport_uring_file_t *file,
+                                uint8_t *buffer, int64_t len)
+{
+  uring_req_t *req;
+
+  pthread_mutex_lock(&ring.mutex);
+  if (queue_more(file) == 0) {
+    pthread_mutex_unlock(&ring.mutex);
+    return 0;
+  }
+  req = &file->reqs[file->head];
+  wait_req(req);
+  pthread_mutex_unlock(&ring.mutex);
+
+  if (req->res < 0) {
+    errno = -req->res;
+    return -1;
+  }
+  if (len > req->res) {
+    len = req->res;
+  }
+  memcpy(buffer, req->buf, len);
+  return len;
+}
+
+int64_t bs_transport_uring_read(bs_transport_uring_file_t *file,
+                                uint8_t *buffer, int64_t len)
+{
+  uring_req_t *req;
+  int64_t total = 0, n;
+
+  pthread_mutex_lock(&ring.mutex);
+  while (total < len && queue_more(file) != 0) {
+    req = &file->reqs[file->head];
+    wait_req(req);
+    if (req->res < 0) {
+      // (the error is returned once the data before it has been)
+      if (total == 0) {
+        errno = -req->res;
+        total = -1;
+      }
+      break;
+    }
+
+    // the buffer is only written by the kernel while the read is pending
+    n = req->res - req->used;
+    if (n > len - total) {
+      n = len - total;
+    }
+    memcpy(buffer + total, req->buf + req->used, n);
+    req->used += n;
+    total += n;
+
+    if (req->used == req->res) {
+      release_head(file);
+    }
+  }
+  pthread_mutex_unlock(&ring.mutex);
+
+  return total;
+}
+
+void bs_transport_uring_close(bs_transport_uring_file_t *file)
+{
+  int i;
+
+  if (file == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&ring.mutex);
+  for (i = 0; i < URING_DEPTH; i++) {
+    // the kernel may still write to the buffer
+    wait_req(&file->reqs[i]);
+    if (file->reqs[i].abandoned != 0) {
+      // (and, once the reaper has failed, nothing tells us when it is done)
+      continue;
+    }
+    if (file->reqs[i].fixed >= 0) {
+      ring.fixed_free[ring.fixed_free_cnt++] = file->reqs[i].fixed;
+    } else {
+      free(file->reqs[i].buf);
+    }
+  }
+  if (file->prev != NULL) {
+    file->prev->next = file->next;
+  } else if (ring.files == file) {
+    ring.files = file->next;
+  }
+  if (file->next != NULL) {
+    file->next->prev = file->prev;
+  }
+  pthread_mutex_unlock(&ring.mutex);
+
+  close(file->fd);
+  pthread_cond_destroy(&file->cond);
+  free(file);
+}
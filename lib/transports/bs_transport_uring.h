@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BS_TRANSPORT_URING_H
+#define __BS_TRANSPORT_URING_H
+
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Asynchronous reads of local files using io_uring
+ *
+ * All files opened by the process share a single io_uring submission ring.
+ * Each file keeps several reads queued ahead of its consumer, into buffers
+ * that are registered with the kernel when possible, and a single thread
+ * reaps the completions of all files. Opening a file fails (and the caller
+ * should read it some other way) if io_uring is not available at run time.
+ */
+
+/** Opaque structure representing a file read through io_uring */
+typedef struct bs_transport_uring_file bs_transport_uring_file_t;
+
+/** Open a local file for reading
+ *
+ * @param path          path to the file
+ * @return pointer to the file if successful, NULL if the file cannot be read
+ * using io_uring (e.g., it is not a regular file, or io_uring is not
+ * supported by the kernel)
+ *
+ * The first reads are queued immediately.
+ */
+bs_transport_uring_file_t *bs_transport_uring_open(const char *path);
+
+/** Copy the first bytes of the file, without consuming them
+ *
+ * @param file          pointer to a file
+ * @param buffer        buffer to copy the bytes to
+ * @param len           number of bytes to copy
+ * @return the number of bytes copied (less than len only if the file is
+ * shorter), or -1 if an error occurred
+ *
+ * Must be called before the file is read.
+ */
+int64_t bs_transport_uring_peek(bs_transport_uring_file_t *file,
+                                uint8_t *buffer, int64_t len);
+
+/** Read from a file
+ *
+ * @param file          pointer to a file
+ * @param buffer        buffer to read into
+ * @param len           maximum number of bytes to read
+ * @return the number of bytes read, 0 at EOF, or -1 if an error occurred
+ */
+int64_t bs_transport_uring_read(bs_transport_uring_file_t *file,
+                                uint8_t *buffer, int64_t len);
+
+/** Close a file
+ *
+ * @param file          pointer to the file to close
+ *
+ * Waits for the reads that are still queued to complete.
+ */
+void bs_transport_uring_close(bs_transport_uring_file_t *file);
+
+#endif /* __BS_TRANSPORT_URING_H */
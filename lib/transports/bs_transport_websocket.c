@@ -0,0 +1,881 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bs_transport_websocket.h"
+#include "bgpstream_transport_interface.h"
+#include "bgpstream_log.h"
+#include "config.h"
+#include "utils.h"
+#include <assert.h>
+#include <curl/curl.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define STATE ((ws_state_t *)(transport->state))
+
+/** How long to wait for the socket before re-checking (ms) */
+#define WS_POLL_TIMEOUT_MS 1000
+
+/** Number of polls without data after which the opening handshake fails */
+#define WS_HANDSHAKE_POLLS 30
+
+/** Largest (reassembled and inflated) message accepted from the server */
+#define WS_MAX_MSG_LEN (16 * 1024 * 1024)
+
+/** Largest response to the opening handshake */
+#define WS_MAX_HDRS_LEN (16 * 1024)
+
+/** Size of the receive buffer (grown to hold larger frames) */
+#define WS_RX_BUFLEN (64 * 1024)
+
+/** GUID the server hashes with our key to accept the connection (RFC 6455) */
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+/* frame opcodes */
+#define WS_OP_CONT 0x0
+#define WS_OP_TEXT 0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+
+/* frame header bits */
+#define WS_FIN 0x80
+#define WS_RSV1 0x40
+#define WS_MASK 0x80
+
+static char ws_user_agent[] = "libbgpstream/" PACKAGE_VERSION;
+
+/** A growable byte buffer */
+typedef struct ws_buf {
+  uint8_t *data;
+  size_t len;
+  size_t alloc;
+} ws_buf_t;
+
+typedef struct ws_state {
+
+  /** Easy handle owning the connection (and its TLS session) */
+  CURL *easy;
+
+  /** Socket of the connection, polled while waiting for data */
+  curl_socket_t sock;
+
+  char errbuf[CURL_ERROR_SIZE];
+
+  /** Received bytes: rx.data[rx_off..rx.len) have not been parsed yet */
+  ws_buf_t rx;
+  size_t rx_off;
+
+  /** Payloads of the frames of the message being received */
+  ws_buf_t frags;
+
+  /** Is the message being received compressed? -1 between messages */
+  int compressed;
+
+  /** The last message received (followed by a newline), and how much of it
+      read has returned */
+  ws_buf_t msg;
+  size_t msg_off;
+
+  /** Inflater for permessage-deflate, which keeps its window across
+      messages */
+  z_stream zs;
+  int zs_init;
+
+  /** Did the server accept permessage-deflate? */
+  int deflate;
+
+  /** Has the connection been closed (by either end)? */
+  int closed;
+
+  /** State of the generator of frame masks */
+  uint32_t mask_seed;
+
+} ws_state_t;
+
+/* ---------- SHA-1 AND BASE64 (for the opening handshake) ---------- */
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1_block(uint32_t h[5], const uint8_t *p)
+{
+  uint32_t w[80], a, b, c, d, e, f, k, t;
+  int i;
+
+  for (i = 0; i < 16; i++) {
+    w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 |
+           (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+  }
+  for (; i < 80; i++) {
+    w[i] = ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  }
+  a = h[0];
+  b = h[1];
+  c = h[2];
+  d = h[3];
+  e = h[4];
+  for (i = 0; i < 80; i++) {
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDC;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6;
+    }
+    t = ROL32(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = ROL32(b, 30);
+    b = a;
+    a = t;
+  }
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+}
+
+static void sha1(const uint8_t *data, size_t len, uint8_t digest[20])
+{
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+                   0xC3D2E1F0};
+  uint8_t last[128];
+  size_t i, rem = len % 64, pad;
+  uint64_t bits = (uint64_t)len * 8;
+
+  for (i = 0; i + 64 <= len; i += 64) {
+    sha1_block(h, data + i);
+  }
+  memcpy(last, data + i, rem);
+  last[rem] = 0x80;
+  pad = (rem < 56) ? 64 : 128;
+  memset(last + rem + 1, 0, pad - rem - 1);
+  for (i = 0; i < 8; i++) {
+    last[pad - 1 - i] = (uint8_t)(bits >> (8 * i));
+  }
+  sha1_block(h, last);
+  if (pad == 128) {
+    sha1_block(h, last + 64);
+  }
+  for (i = 0; i < 20; i++) {
+    digest[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+  }
+}
+
+// encodes len bytes into out, which must hold 4 * ((len + 2) / 3) + 1 bytes
+static void base64(const uint8_t *in, size_t len, char *out)
+{
+  static const char chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  uint32_t v;
+  size_t i;
+
+  for (i = 0; i < len; i += 3) {
+    v = (uint32_t)in[i] << 16;
+    if (i + 1 < len) {
+      v |= (uint32_t)in[i + 1] << 8;
+    }
+    if (i + 2 < len) {
+      v |= in[i + 2];
+    }
+    *out++ = chars[(v >> 18) & 0x3F];
+    *out++ = chars[(v >> 12) & 0x3F];
+    *out++ = (i + 1 < len) ? chars[(v >> 6) & 0x3F] : '=';
+    *out++ = (i + 2 < len) ? chars[v & 0x3F] : '=';
+  }
+  *out = '\0';
+}
+
+/* ---------- BUFFERS ---------- */
+
+// makes room for len more bytes in the buffer
+static int buf_reserve(ws_buf_t *buf, size_t len)
+{
+  size_t alloc = (buf->alloc != 0) ? buf->alloc : WS_RX_BUFLEN;
+  uint8_t *tmp;
+
+  if (buf->len + len <= buf->alloc) {
+    return 0;
+  }
+  while (alloc < buf->len + len) {
+    alloc *= 2;
+  }
+  if ((tmp = realloc(buf->data, alloc)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not grow WebSocket buffer");
+    return -1;
+  }
+  buf->data = tmp;
+  buf->alloc = alloc;
+  return 0;
+}
+
+static int buf_append(ws_buf_t *buf, const uint8_t *data, size_t len)
+{
+  if (buf->len + len > WS_MAX_MSG_LEN + 1) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "WebSocket message longer than %d bytes",
+                  WS_MAX_MSG_LEN);
+    return -1;
+  }
+  if (buf_reserve(buf, len) != 0) {
+    return -1;
+  }
+  memcpy(buf->data + buf->len, data, len);
+  buf->len += len;
+  return 0;
+}
+
+/* ---------- SOCKET I/O ---------- */
+
+// waits until the socket is ready for the given events. returns 1 if it is,
+// 0 if the poll timed out and -1 on error
+static int sock_wait(ws_state_t *state, short events)
+{
+  struct pollfd pfd = {state->sock, events, 0};
+  int rc;
+
+  if ((rc = poll(&pfd, 1, WS_POLL_TIMEOUT_MS)) < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not poll WebSocket connection");
+    return -1;
+  }
+  return rc;
+}
+
+static int sock_send(ws_state_t *state, const uint8_t *data, size_t len)
+{
+  size_t sent;
+  CURLcode rc;
+
+  while (len > 0) {
+    rc = curl_easy_send(state->easy, data, len, &sent);
+    if (rc == CURLE_AGAIN) {
+      if (sock_wait(state, POLLOUT) < 0) {
+        return -1;
+      }
+      continue;
+    }
+    if (rc != CURLE_OK) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not send on WebSocket: %s",
+                    curl_easy_strerror(rc));
+      return -1;
+    }
+    data += sent;
+    len -= sent;
+  }
+  return 0;
+}
+
+// receives more bytes into the receive buffer, waiting for them if needed (for
+// at most max_polls polls, or forever if 0). returns the number of bytes
+// received, 0 if the connection was closed and -1 on error
+static int64_t sock_recv(ws_state_t *state, int max_polls)
+{
+  size_t got;
+  CURLcode rc;
+  int polls = 0;
+
+  // drop the parsed bytes before making room for more
+  if (state->rx_off != 0) {
+    memmove(state->rx.data, state->rx.data + state->rx_off,
+            state->rx.len - state->rx_off);
+    state->rx.len -= state->rx_off;
+    state->rx_off = 0;
+  }
+  if (state->rx.alloc - state->rx.len < WS_RX_BUFLEN / 2 &&
+      buf_reserve(&state->rx, WS_RX_BUFLEN / 2) != 0) {
+    return -1;
+  }
+
+  while (1) {
+    rc = curl_easy_recv(state->easy, state->rx.data + state->rx.len,
+                        state->rx.alloc - state->rx.len, &got);
+    if (rc == CURLE_OK) {
+      state->rx.len += got;
+      return got;
+    }
+    if (rc != CURLE_AGAIN) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not receive on WebSocket: %s",
+                    curl_easy_strerror(rc));
+      return -1;
+    }
+    if ((rc = sock_wait(state, POLLIN)) < 0) {
+      return -1;
+    }
+    if (rc == 0 && max_polls != 0 && ++polls == max_polls) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Timed out waiting for WebSocket data");
+      return -1;
+    }
+  }
+}
+
+/* ---------- FRAMES ---------- */
+
+// sends a single (masked, as all client frames must be) frame
+static int send_frame(ws_state_t *state, int opcode, const uint8_t *payload,
+                      size_t len)
+{
+  uint8_t *frame;
+  size_t hdr_len = 2, i;
+  uint32_t mask;
+  int rc;
+
+  if ((frame = malloc(len + 14)) == NULL) {
+    return -1;
+  }
+  frame[0] = WS_FIN | opcode;
+  if (len < 126) {
+    frame[1] = WS_MASK | len;
+  } else if (len <= UINT16_MAX) {
+    frame[1] = WS_MASK | 126;
+    frame[2] = (uint8_t)(len >> 8);
+    frame[3] = (uint8_t)len;
+    hdr_len = 4;
+  } else {
+    frame[1] = WS_MASK | 127;
+    for (i = 0; i < 8; i++) {
+      frame[2 + i] = (uint8_t)((uint64_t)len >> (56 - 8 * i));
+    }
+    hdr_len = 10;
+  }
+
+  // masks only protect intermediaries from scripted clients, so they need not
+  // be strong random numbers here (RFC 6455 section 10.3)
+  state->mask_seed = state->mask_seed * 1103515245 + 12345;
+  mask = state->mask_seed;
+  memcpy(frame + hdr_len, &mask, 4);
+  for (i = 0; i < len; i++) {
+    frame[hdr_len + 4 + i] = payload[i] ^ frame[hdr_len + (i & 3)];
+  }
+
+  rc = sock_send(state, frame, hdr_len + 4 + len);
+  free(frame);
+  return rc;
+}
+
+// gets the next complete frame from the connection. returns 1 if there is
+// one, 0 if the connection was closed and -1 on error
+static int next_frame(ws_state_t *state, uint8_t *hdr, uint8_t **payload,
+                      size_t *len)
+{
+  uint8_t *p;
+  size_t avail, hdr_len;
+  uint64_t plen;
+  int64_t rc;
+  int i;
+
+  while (1) {
+    p = state->rx.data + state->rx_off;
+    avail = state->rx.len - state->rx_off;
+    if (avail >= 2) {
+      if ((p[1] & WS_MASK) != 0) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Masked frame from WebSocket server");
+        return -1;
+      }
+      plen = p[1] & 0x7F;
+      hdr_len = (plen == 126) ? 4 : (plen == 127) ? 10 : 2;
+      if (avail >= hdr_len) {
+        if (plen == 126) {
+          plen = (uint64_t)p[2] << 8 | p[3];
+        } else if (plen == 127) {
+          for (plen = 0, i = 0; i < 8; i++) {
+            plen = plen << 8 | p[2 + i];
+          }
+        }
+        if (plen > WS_MAX_MSG_LEN) {
+          bgpstream_log(BGPSTREAM_LOG_ERR,
+                        "WebSocket frame of %" PRIu64 " bytes is too long",
+                        plen);
+          return -1;
+        }
+        if (avail >= hdr_len + plen) {
+          *hdr = p[0];
+          *payload = p + hdr_len;
+          *len = plen;
+          state->rx_off += hdr_len + plen;
+          return 1;
+        }
+        // make sure a whole frame fits before receiving the rest of it
+        if (buf_reserve(&state->rx, hdr_len + plen - avail) != 0) {
+          return -1;
+        }
+      }
+    }
+    if ((rc = sock_recv(state, 0)) < 0) {
+      return -1;
+    }
+    if (rc == 0) {
+      return 0;
+    }
+  }
+}
+
+// inflates the compressed message in frags into msg
+static int inflate_msg(ws_state_t *state)
+{
+  // each message is flushed with an empty block whose tail is removed
+  static const uint8_t tail[] = {0x00, 0x00, 0xff, 0xff};
+  int rc;
+
+  if (buf_append(&state->frags, tail, sizeof(tail)) != 0) {
+    return -1;
+  }
+  state->zs.next_in = state->frags.data;
+  state->zs.avail_in = state->frags.len;
+  do {
+    if (state->msg.alloc - state->msg.len < WS_RX_BUFLEN / 2) {
+      if (state->msg.len > WS_MAX_MSG_LEN) {
+        bgpstream_log(BGPSTREAM_LOG_ERR,
+                      "WebSocket message longer than %d bytes", WS_MAX_MSG_LEN);
+        return -1;
+      }
+      if (buf_reserve(&state->msg, WS_RX_BUFLEN / 2) != 0) {
+        return -1;
+      }
+    }
+    state->zs.next_out = state->msg.data + state->msg.len;
+    state->zs.avail_out = state->msg.alloc - state->msg.len;
+    rc = inflate(&state->zs, Z_SYNC_FLUSH);
+    state->msg.len = state->zs.next_out - state->msg.data;
+    if (rc == Z_STREAM_END) {
+      // the server ended the stream (with a final block), the next message
+      // starts a new one
+      if (inflateReset(&state->zs) != Z_OK) {
+        return -1;
+      }
+    } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+      bgpstream_log(BGPSTREAM_LOG_ERR,
+                    "Could not inflate WebSocket message: %s",
+                    (state->zs.msg != NULL) ? state->zs.msg : "unknown error");
+      return -1;
+    }
+  } while (state->zs.avail_in != 0 || state->zs.avail_out == 0);
+  return 0;
+}
+
+// receives the next (non-empty) data message into msg, answering the control
+// frames that come before it. returns the length of the message, 0 if the
+// connection was closed and -1 on error
+static int64_t next_msg(ws_state_t *state)
+{
+  uint8_t hdr, *payload;
+  size_t len;
+  int rc;
+
+  state->msg.len = state->msg_off = 0;
+  if (state->closed != 0) {
+    return 0;
+  }
+
+  while (1) {
+    if ((rc = next_frame(state, &hdr, &payload, &len)) <= 0) {
+      state->closed = 1;
+      return rc;
+    }
+
+    switch (hdr & 0x0F) {
+    case WS_OP_PING:
+      if (send_frame(state, WS_OP_PONG, payload, len) != 0) {
+        return -1;
+      }
+      continue;
+
+    case WS_OP_PONG:
+      continue;
+
+    case WS_OP_CLOSE:
+      // echo the status code back, as the closing handshake requires
+      send_frame(state, WS_OP_CLOSE, payload, (len >= 2) ? 2 : 0);
+      state->closed = 1;
+      return 0;
+
+    case WS_OP_TEXT:
+    case WS_OP_BINARY:
+      if (state->compressed != -1) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Interleaved WebSocket messages");
+        return -1;
+      }
+      state->compressed = state->deflate && (hdr & WS_RSV1) != 0;
+      state->frags.len = 0;
+      break;
+
+    case WS_OP_CONT:
+      if (state->compressed == -1) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Unexpected WebSocket continuation");
+        return -1;
+      }
+      break;
+
+    default:
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Unknown WebSocket opcode %d",
+                    hdr & 0x0F);
+      return -1;
+    }
+
+    // unfragmented, uncompressed messages (the common case) are copied once
+    if (buf_append(state->compressed ? &state->frags : &state->msg, payload,
+                   len) != 0) {
+      return -1;
+    }
+    if ((hdr & WS_FIN) == 0) {
+      continue;
+    }
+    if (state->compressed && inflate_msg(state) != 0) {
+      return -1;
+    }
+    state->compressed = -1;
+    if (state->msg.len != 0) {
+      return state->msg.len;
+    }
+  }
+}
+
+/* ---------- OPENING HANDSHAKE ---------- */
+
+// finds the value of the given header in the response headers
+static const char *find_hdr(const char *hdrs, const char *name, size_t *len)
+{
+  size_t name_len = strlen(name);
+  const char *p = hdrs, *end;
+
+  while ((p = strstr(p, "\r\n")) != NULL) {
+    p += 2;
+    if (strncasecmp(p, name, name_len) == 0 && p[name_len] == ':') {
+      p += name_len + 1;
+      p += strspn(p, " \t");
+      end = strstr(p, "\r\n");
+      *len = end - p;
+      return p;
+    }
+  }
+  return NULL;
+}
+
+static int handshake(bgpstream_transport_t *transport, const char *host,
+                     const char *path)
+{
+  uint8_t nonce[16], digest[20];
+  char key[25], accept[29], key_guid[sizeof(key) + sizeof(WS_GUID)];
+  char *req = NULL, *hdrs, *end;
+  const char *val;
+  size_t len;
+  int fd, rc = -1;
+  int64_t got;
+
+  // the key only has to be unique to this connection
+  if ((fd = open("/dev/urandom", O_RDONLY)) < 0 ||
+      read(fd, nonce, sizeof(nonce)) != sizeof(nonce)) {
+    for (len = 0; len < sizeof(nonce); len++) {
+      nonce[len] = (uint8_t)random();
+    }
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  base64(nonce, sizeof(nonce), key);
+  memcpy(&STATE->mask_seed, nonce, sizeof(STATE->mask_seed));
+
+  snprintf(key_guid, sizeof(key_guid), "%s%s", key, WS_GUID);
+  sha1((uint8_t *)key_guid, strlen(key_guid), digest);
+  base64(digest, sizeof(digest), accept);
+
+  len = strlen(host) + strlen(path) + 512;
+  if ((req = malloc(len)) == NULL) {
+    goto done;
+  }
+  snprintf(req, len,
+           "GET %s HTTP/1.1\r\n"
+           "Host: %s\r\n"
+           "User-Agent: %s\r\n"
+           "Upgrade: websocket\r\n"
+           "Connection: Upgrade\r\n"
+           "Sec-WebSocket-Key: %s\r\n"
+           "Sec-WebSocket-Version: 13\r\n"
+           "Sec-WebSocket-Extensions: permessage-deflate; "
+           "client_max_window_bits\r\n"
+           "\r\n",
+           path, host, ws_user_agent, key);
+  if (sock_send(STATE, (uint8_t *)req, strlen(req)) != 0) {
+    goto done;
+  }
+
+  // the headers are kept NUL-terminated while they arrive
+  while (1) {
+    if (STATE->rx.len != 0) {
+      STATE->rx.data[STATE->rx.len] = '\0';
+      if ((end = strstr((char *)STATE->rx.data, "\r\n\r\n")) != NULL) {
+        break;
+      }
+    }
+    if (STATE->rx.len >= WS_MAX_HDRS_LEN) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "WebSocket response headers too long");
+      goto done;
+    }
+    if ((got = sock_recv(STATE, WS_HANDSHAKE_POLLS)) <= 0) {
+      if (got == 0) {
+        bgpstream_log(BGPSTREAM_LOG_ERR,
+                      "Connection closed during WebSocket handshake");
+      }
+      goto done;
+    }
+    // keep a byte for the NUL
+    if (STATE->rx.len == STATE->rx.alloc &&
+        buf_reserve(&STATE->rx, 1) != 0) {
+      goto done;
+    }
+  }
+  end[2] = '\0';
+  hdrs = (char *)STATE->rx.data;
+  STATE->rx_off = end + 4 - hdrs;
+
+  if (strncmp(hdrs, "HTTP/1.1 101", 12) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "WebSocket upgrade refused: %.*s",
+                  (int)strcspn(hdrs, "\r\n"), hdrs);
+    goto done;
+  }
+  if ((val = find_hdr(hdrs, "Sec-WebSocket-Accept", &len)) == NULL ||
+      len != strlen(accept) || strncmp(val, accept, len) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid WebSocket accept key");
+    goto done;
+  }
+  if ((val = find_hdr(hdrs, "Sec-WebSocket-Extensions", &len)) != NULL &&
+      strncmp(val, "permessage-deflate", strlen("permessage-deflate")) == 0) {
+    if (inflateInit2(&STATE->zs, -MAX_WBITS) != Z_OK) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not initialize zlib");
+      goto done;
+    }
+    STATE->zs_init = 1;
+    STATE->deflate = 1;
+  }
+  rc = 0;
+
+done:
+  free(req);
+  return rc;
+}
+
+// splits a ws(s) URL into the URL curl connects to, the host (with the port)
+// and the path
+static int parse_url(const char *url, char **conn_url, char **host,
+                     char **path)
+{
+  const char *authority, *rest;
+  int tls = (strncmp(url, "wss://", 6) == 0);
+  size_t len;
+
+  if (!tls && strncmp(url, "ws://", 5) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid WebSocket URL %s", url);
+    return -1;
+  }
+  authority = url + (tls ? 6 : 5);
+  len = strcspn(authority, "/?#");
+  rest = authority + len;
+
+  if ((*host = strndup(authority, len)) == NULL ||
+      (*path = malloc(strcspn(rest, "#") + 2)) == NULL ||
+      (*conn_url = malloc(strlen(url) + 2)) == NULL) {
+    return -1;
+  }
+  snprintf(*path, strcspn(rest, "#") + 2, "%s%.*s", (*rest == '/') ? "" : "/",
+           (int)strcspn(rest, "#"), rest);
+  sprintf(*conn_url, "%s://%s", tls ? "https" : "http", *host);
+  return 0;
+}
+
+static pthread_once_t curl_once = PTHREAD_ONCE_INIT;
+
+static void curl_init(void)
+{
+  if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not initialize libcurl");
+  }
+}
+
+/* ========== PUBLIC METHODS BELOW HERE ========== */
+
+int bs_transport_websocket_create(bgpstream_transport_t *transport)
+{
+  char *conn_url = NULL, *host = NULL, *path = NULL;
+  CURLcode rc;
+
+  BS_TRANSPORT_SET_METHODS(websocket, transport);
+  transport->write = bs_transport_websocket_write;
+
+  pthread_once(&curl_once, curl_init);
+
+  if ((transport->state = malloc_zero(sizeof(ws_state_t))) == NULL) {
+    goto err;
+  }
+  STATE->compressed = -1;
+
+  if (parse_url(transport->res->url, &conn_url, &host, &path) != 0 ||
+      (STATE->easy = curl_easy_init()) == NULL) {
+    goto err;
+  }
+
+  // curl only opens the connection (including TLS), the upgrade and the
+  // frames are handled here
+  curl_easy_setopt(STATE->easy, CURLOPT_URL, conn_url);
+  curl_easy_setopt(STATE->easy, CURLOPT_CONNECT_ONLY, 1L);
+  curl_easy_setopt(STATE->easy, CURLOPT_ERRORBUFFER, STATE->errbuf);
+  curl_easy_setopt(STATE->easy, CURLOPT_USERAGENT, ws_user_agent);
+  curl_easy_setopt(STATE->easy, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(STATE->easy, CURLOPT_TCP_KEEPALIVE, 1L);
+  curl_easy_setopt(STATE->easy, CURLOPT_TCP_NODELAY, 1L);
+  if ((rc = curl_easy_perform(STATE->easy)) != CURLE_OK) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "%s",
+                  (STATE->errbuf[0] != '\0') ? STATE->errbuf
+                                             : curl_easy_strerror(rc));
+    goto err;
+  }
+  if (curl_easy_getinfo(STATE->easy, CURLINFO_ACTIVESOCKET, &STATE->sock) !=
+      CURLE_OK) {
+    goto err;
+  }
+
+  if (buf_reserve(&STATE->rx, WS_RX_BUFLEN) != 0 ||
+      handshake(transport, host, path) != 0) {
+    goto err;
+  }
+
+  free(conn_url);
+  free(host);
+  free(path);
+  return 0;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open %s for reading",
+                transport->res->url);
+  free(conn_url);
+  free(host);
+  free(path);
+  if (transport->state != NULL) {
+    // there is no connection to close cleanly
+    STATE->closed = 1;
+  }
+  bs_transport_websocket_destroy(transport);
+  return -1;
+}
+
+int64_t bs_transport_websocket_read(bgpstream_transport_t *transport,
+                                    uint8_t *buffer, int64_t len)
+{
+  int64_t rc;
+
+  // one message at most, so that each is handed over as soon as it arrives
+  if (STATE->msg_off == STATE->msg.len) {
+    if ((rc = next_msg(STATE)) <= 0) {
+      return rc;
+    }
+    if (buf_append(&STATE->msg, (uint8_t *)"\n", 1) != 0) {
+      return -1;
+    }
+  }
+  if ((size_t)len > STATE->msg.len - STATE->msg_off) {
+    len = STATE->msg.len - STATE->msg_off;
+  }
+  memcpy(buffer, STATE->msg.data + STATE->msg_off, len);
+  STATE->msg_off += len;
+  return len;
+}
+
+int64_t bs_transport_websocket_readline(bgpstream_transport_t *transport,
+                                        uint8_t *buffer, int64_t len)
+{
+  int64_t rc;
+
+  // NOTE: like kafka, we assume there is only one line per message
+  assert(STATE->msg_off == STATE->msg.len);
+  if ((rc = next_msg(STATE)) <= 0) {
+    return rc;
+  }
+  STATE->msg_off = STATE->msg.len;
+  if (rc >= len) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "WebSocket message of %" PRId64
+                  " bytes does not fit a %" PRId64 " byte line",
+                  rc, len);
+    return -1;
+  }
+  memcpy(buffer, STATE->msg.data, rc);
+  buffer[rc] = '\0';
+  return rc;
+}
+
+int64_t bs_transport_websocket_write(bgpstream_transport_t *transport,
+                                     const uint8_t *buffer, int64_t len)
+{
+  if (STATE->closed != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "WebSocket connection is closed");
+    return -1;
+  }
+  // messages to the server are not compressed, which permessage-deflate
+  // allows for each message
+  if (send_frame(STATE, WS_OP_TEXT, buffer, len) != 0) {
+    return -1;
+  }
+  return len;
+}
+
+void bs_transport_websocket_destroy(bgpstream_transport_t *transport)
+{
+  // 1000: normal closure
+  static const uint8_t status[] = {0x03, 0xE8};
+
+  if (transport->state == NULL) {
+    return;
+  }
+
+  if (STATE->closed == 0) {
+    send_frame(STATE, WS_OP_CLOSE, status, sizeof(status));
+  }
+  if (STATE->easy != NULL) {
+    curl_easy_cleanup(STATE->easy);
+  }
+  if (STATE->zs_init != 0) {
+    inflateEnd(&STATE->zs);
+  }
+  free(STATE->rx.data);
+  free(STATE->frags.data);
+  free(STATE->msg.data);
+
+  free(transport->state);
+  transport->state = NULL;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BS_TRANSPORT_WEBSOCKET_H
+#define __BS_TRANSPORT_WEBSOCKET_H
+
+#include "bgpstream_transport_interface.h"
+
+/** @file
+ *
+ * @brief Header file for the WebSocket transport, which reads the messages of
+ * a ws:// or wss:// stream (e.g., RIS Live) as they arrive. Messages
+ * compressed with permessage-deflate (RFC 7692) are inflated, and readline
+ * returns exactly one message.
+ */
+
+BS_TRANSPORT_GENERATE_PROTOS(websocket)
+
+/** Send a text message to the server
+ *
+ * @param transport     pointer to a WebSocket transport
+ * @param buffer        the message to send
+ * @param len           the length of the message
+ * @return the number of bytes sent if successful, -1 otherwise
+ */
+int64_t bs_transport_websocket_write(bgpstream_transport_t *transport,
+                                     const uint8_t *buffer, int64_t len);
+
+#endif /* __BS_TRANSPORT_WEBSOCKET_H */
@@ -53,10 +53,13 @@
 #include "bgpstream_utils_community.h"     /* Community utilities */
 #include "bgpstream_utils_id_set.h"        /* ID Set utilities */
 #include "bgpstream_utils_ip_counter.h"    /* IP Overlap Counter */
+#include "bgpstream_utils_ipv4_bitmap.h"   /* IPv4 /24 Coverage Bitmap */
+#include "bgpstream_utils_lpm.h"           /* Longest Prefix Match tables */
 #include "bgpstream_utils_patricia.h"      /* Patricia Tree utilities */
 #include "bgpstream_utils_peer_sig_map.h"  /* Peer Signature utilities */
 #include "bgpstream_utils_pfx.h"           /* Prefix utilities */
 #include "bgpstream_utils_pfx_set.h"       /* Prefix Set utilities */
+#include "bgpstream_utils_snapshot.h"      /* Prefix snapshots */
 #include "bgpstream_utils_str_set.h"       /* String Set utilities */
 #include "bgpstream_utils_time.h"          /* Time management utilities */
 
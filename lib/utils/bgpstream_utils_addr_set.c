@@ -26,53 +26,98 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
-#include "khash.h"
 #include "utils.h"
 
 #include "bgpstream_utils_addr_set.h"
+#include "bgpstream_utils_swiss_int.h"
 
 /* PRIVATE */
 
-#define ADDR_HASH_VAL(arg) bgpstream_addr_hash(&(arg))
-#define ADDR_EQUAL_VAL(arg1, arg2) bgpstream_addr_equal(&(arg1), &(arg2))
+static inline uint64_t v6_hash(const bgpstream_ipv6_addr_t *addr)
+{
+  uint64_t ms, ls;
+  memcpy(&ms, &addr->addr.s6_addr[0], sizeof(ms));
+  memcpy(&ls, &addr->addr.s6_addr[8], sizeof(ls));
+  return (ms * 0x9E3779B97F4A7C15ULL) ^ ls;
+}
 
-#define V4_HASH_VAL(arg) bgpstream_ipv4_addr_hash(&(arg))
-#define V4_EQUAL_VAL(arg1, arg2) bgpstream_ipv4_addr_equal(&(arg1), &(arg2))
+static inline int v6_equal(const bgpstream_ipv6_addr_t *addr1,
+                           const bgpstream_ipv6_addr_t *addr2)
+{
+  return memcmp(&addr1->addr, &addr2->addr, sizeof(addr1->addr)) == 0;
+}
 
-#define V6_HASH_VAL(arg) bgpstream_ipv6_addr_hash(&(arg))
-#define V6_EQUAL_VAL(arg1, arg2) bgpstream_ipv6_addr_equal(&(arg1), &(arg2))
+static inline uint64_t addr_hash(const bgpstream_ip_addr_t *addr)
+{
+  if (addr->version == BGPSTREAM_ADDR_VERSION_IPV4) {
+    return addr->bs_ipv4.addr.s_addr;
+  }
+  return v6_hash(&addr->bs_ipv6);
+}
+
+static inline int addr_equal(const bgpstream_ip_addr_t *addr1,
+                             const bgpstream_ip_addr_t *addr2)
+{
+  if (addr1->version != addr2->version) {
+    return 0;
+  }
+  if (addr1->version == BGPSTREAM_ADDR_VERSION_IPV4) {
+    return addr1->bs_ipv4.addr.s_addr == addr2->bs_ipv4.addr.s_addr;
+  }
+  return v6_equal(&addr1->bs_ipv6, &addr2->bs_ipv6);
+}
+
+#define ADDR_HASH_VAL(arg) addr_hash(&(arg))
+#define ADDR_EQUAL_VAL(arg1, arg2) addr_equal(&(arg1), &(arg2))
+
+/* IPv4 addresses are stored inline (in network byte order) */
+#define V4_HASH_VAL(arg) ((uint64_t)(arg))
+#define V4_EQUAL_VAL(arg1, arg2) ((arg1) == (arg2))
+
+#define V6_HASH_VAL(arg) v6_hash(&(arg))
+#define V6_EQUAL_VAL(arg1, arg2) v6_equal(&(arg1), &(arg2))
 
 /* GENERIC ADDR */
-KHASH_INIT(bgpstream_ip_addr_set /* name */,
-           bgpstream_ip_addr_t /* khkey_t */, char /* khval_t */,
-           0 /* kh_is_set */, ADDR_HASH_VAL /*__hash_func */,
-           ADDR_EQUAL_VAL /* __hash_equal */)
+BS_SWISS_SET_INIT(bgpstream_ip_addr_set /* name */,
+                  bgpstream_ip_addr_t /* key_t */,
+                  ADDR_HASH_VAL /* hash_func */,
+                  ADDR_EQUAL_VAL /* equal_func */)
 
 struct bgpstream_ip_addr_set {
-  khash_t(bgpstream_ip_addr_set) * hash;
+  bs_swiss_bgpstream_ip_addr_set_t hash;
 };
 
 /* IPv4 */
-KHASH_INIT(bgpstream_ipv4_addr_set /* name */,
-           bgpstream_ipv4_addr_t /* khkey_t */, char /* khval_t */,
-           0 /* kh_is_set */, V4_HASH_VAL /*__hash_func */,
-           V4_EQUAL_VAL /* __hash_equal */)
+BS_SWISS_SET_INIT(bgpstream_ipv4_addr_set /* name */, uint32_t /* key_t */,
+                  V4_HASH_VAL /* hash_func */, V4_EQUAL_VAL /* equal_func */)
 
 struct bgpstream_ipv4_addr_set {
-  khash_t(bgpstream_ipv4_addr_set) * hash;
+  bs_swiss_bgpstream_ipv4_addr_set_t hash;
 };
 
 /* IPv6 */
-KHASH_INIT(bgpstream_ipv6_addr_set /* name */,
-           bgpstream_ipv6_addr_t /* khkey_t */, char /* khval_t */,
-           0 /* kh_is_set */, V6_HASH_VAL /*__hash_func */,
-           V6_EQUAL_VAL /* __hash_equal */)
+BS_SWISS_SET_INIT(bgpstream_ipv6_addr_set /* name */,
+                  bgpstream_ipv6_addr_t /* key_t */,
+                  V6_HASH_VAL /* hash_func */, V6_EQUAL_VAL /* equal_func */)
 
 struct bgpstream_ipv6_addr_set {
-  khash_t(bgpstream_ipv6_addr_set) * hash;
+  bs_swiss_bgpstream_ipv6_addr_set_t hash;
 };
 
+/* iterate over the keys of src, adding them to dst */
+#define MERGE(name, dst, src)                                                  \
+  do {                                                                         \
+    uint32_t k;                                                                \
+    for (k = bs_swiss_begin(src); k != bs_swiss_end(src); ++k) {               \
+      if (BS_SWISS_FULL(src, k) &&                                             \
+          bs_swiss_##name##_put((dst), bs_swiss_key(src, k)) < 0) {            \
+        return -1;                                                             \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
 /* PUBLIC FUNCTIONS */
 
 /* GENERIC ADDR */
@@ -86,56 +131,37 @@ bgpstream_ip_addr_set_t *bgpstream_ip_addr_set_create()
     return NULL;
   }
 
-  if ((set->hash = kh_init(bgpstream_ip_addr_set)) == NULL) {
-    bgpstream_ip_addr_set_destroy(set);
-    return NULL;
-  }
-
+  bs_swiss_bgpstream_ip_addr_set_init(&set->hash);
   return set;
 }
 
 int bgpstream_ip_addr_set_insert(bgpstream_ip_addr_set_t *set,
                                  bgpstream_ip_addr_t *addr)
 {
-  int khret;
-  khiter_t k;
-  if ((k = kh_get(bgpstream_ip_addr_set, set->hash, *addr)) ==
-      kh_end(set->hash)) {
-    k = kh_put(bgpstream_ip_addr_set, set->hash, *addr, &khret);
-    return 1;
-  }
-  return 0;
+  return bs_swiss_bgpstream_ip_addr_set_put(&set->hash, *addr);
 }
 
 int bgpstream_ip_addr_set_size(bgpstream_ip_addr_set_t *set)
 {
-  return kh_size(set->hash);
+  return bs_swiss_size(&set->hash);
 }
 
 int bgpstream_ip_addr_set_merge(bgpstream_ip_addr_set_t *dst_set,
                                 bgpstream_ip_addr_set_t *src_set)
 {
-  khiter_t k;
-  for (k = kh_begin(src_set->hash); k != kh_end(src_set->hash); ++k) {
-    if (kh_exist(src_set->hash, k)) {
-      if (bgpstream_ip_addr_set_insert(dst_set,
-                                       &(kh_key(src_set->hash, k))) < 0) {
-        return -1;
-      }
-    }
-  }
+  MERGE(bgpstream_ip_addr_set, &dst_set->hash, &src_set->hash);
   return 0;
 }
 
 void bgpstream_ip_addr_set_destroy(bgpstream_ip_addr_set_t *set)
 {
-  kh_destroy(bgpstream_ip_addr_set, set->hash);
+  bs_swiss_bgpstream_ip_addr_set_destroy(&set->hash);
   free(set);
 }
 
 void bgpstream_ip_addr_set_clear(bgpstream_ip_addr_set_t *set)
 {
-  kh_clear(bgpstream_ip_addr_set, set->hash);
+  bs_swiss_bgpstream_ip_addr_set_clear(&set->hash);
 }
 
 /* IPv4 */
@@ -149,56 +175,37 @@ bgpstream_ipv4_addr_set_t *bgpstream_ipv4_addr_set_create()
     return NULL;
   }
 
-  if ((set->hash = kh_init(bgpstream_ipv4_addr_set)) == NULL) {
-    bgpstream_ipv4_addr_set_destroy(set);
-    return NULL;
-  }
-
+  bs_swiss_bgpstream_ipv4_addr_set_init(&set->hash);
   return set;
 }
 
 int bgpstream_ipv4_addr_set_insert(bgpstream_ipv4_addr_set_t *set,
                                    bgpstream_ipv4_addr_t *addr)
 {
-  int khret;
-  khiter_t k;
-  if ((k = kh_get(bgpstream_ipv4_addr_set, set->hash, *addr)) ==
-      kh_end(set->hash)) {
-    k = kh_put(bgpstream_ipv4_addr_set, set->hash, *addr, &khret);
-    return 1;
-  }
-  return 0;
+  return bs_swiss_bgpstream_ipv4_addr_set_put(&set->hash, addr->addr.s_addr);
 }
 
 int bgpstream_ipv4_addr_set_size(bgpstream_ipv4_addr_set_t *set)
 {
-  return kh_size(set->hash);
+  return bs_swiss_size(&set->hash);
 }
 
 int bgpstream_ipv4_addr_set_merge(bgpstream_ipv4_addr_set_t *dst_set,
                                   bgpstream_ipv4_addr_set_t *src_set)
 {
-  khiter_t k;
-  for (k = kh_begin(src_set->hash); k != kh_end(src_set->hash); ++k) {
-    if (kh_exist(src_set->hash, k)) {
-      if (bgpstream_ipv4_addr_set_insert(dst_set, &(kh_key(src_set->hash, k))) <
-          0) {
-        return -1;
-      }
-    }
-  }
+  MERGE(bgpstream_ipv4_addr_set, &dst_set->hash, &src_set->hash);
   return 0;
 }
 
 void bgpstream_ipv4_addr_set_destroy(bgpstream_ipv4_addr_set_t *set)
 {
-  kh_destroy(bgpstream_ipv4_addr_set, set->hash);
+  bs_swiss_bgpstream_ipv4_addr_set_destroy(&set->hash);
   free(set);
 }
 
 void bgpstream_ipv4_addr_set_clear(bgpstream_ipv4_addr_set_t *set)
 {
-  kh_clear(bgpstream_ipv4_addr_set, set->hash);
+  bs_swiss_bgpstream_ipv4_addr_set_clear(&set->hash);
 }
 
 /* IPv6 */
@@ -212,54 +219,35 @@ bgpstream_ipv6_addr_set_t *bgpstream_ipv6_addr_set_create()
     return NULL;
   }
 
-  if ((set->hash = kh_init(bgpstream_ipv6_addr_set)) == NULL) {
-    bgpstream_ipv6_addr_set_destroy(set);
-    return NULL;
-  }
-
+  bs_swiss_bgpstream_ipv6_addr_set_init(&set->hash);
   return set;
 }
 
 int bgpstream_ipv6_addr_set_insert(bgpstream_ipv6_addr_set_t *set,
                                    bgpstream_ipv6_addr_t *addr)
 {
-  int khret;
-  khiter_t k;
-  if ((k = kh_get(bgpstream_ipv6_addr_set, set->hash, *addr)) ==
-      kh_end(set->hash)) {
-    k = kh_put(bgpstream_ipv6_addr_set, set->hash, *addr, &khret);
-    return 1;
-  }
-  return 0;
+  return bs_swiss_bgpstream_ipv6_addr_set_put(&set->hash, *addr);
 }
 
 int bgpstream_ipv6_addr_set_size(bgpstream_ipv6_addr_set_t *set)
 {
-  return kh_size(set->hash);
+  return bs_swiss_size(&set->hash);
 }
 
 int bgpstream_ipv6_addr_set_merge(bgpstream_ipv6_addr_set_t *dst_set,
                                   bgpstream_ipv6_addr_set_t *src_set)
 {
-  khiter_t k;
-  for (k = kh_begin(src_set->hash); k != kh_end(src_set->hash); ++k) {
-    if (kh_exist(src_set->hash, k)) {
-      if (bgpstream_ipv6_addr_set_insert(dst_set, &(kh_key(src_set->hash, k))) <
-          0) {
-        return -1;
-      }
-    }
-  }
+  MERGE(bgpstream_ipv6_addr_set, &dst_set->hash, &src_set->hash);
   return 0;
 }
 
 void bgpstream_ipv6_addr_set_destroy(bgpstream_ipv6_addr_set_t *set)
 {
-  kh_destroy(bgpstream_ipv6_addr_set, set->hash);
+  bs_swiss_bgpstream_ipv6_addr_set_destroy(&set->hash);
   free(set);
 }
 
 void bgpstream_ipv6_addr_set_clear(bgpstream_ipv6_addr_set_t *set)
 {
-  kh_clear(bgpstream_ipv6_addr_set, set->hash);
+  bs_swiss_bgpstream_ipv6_addr_set_clear(&set->hash);
 }
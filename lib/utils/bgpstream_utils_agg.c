@@ -0,0 +1,852 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "khash.h"
+#include "utils.h"
+
+#include "bgpstream_log.h"
+#include "bgpstream_utils_agg.h"
+#include "bgpstream_utils_as_path.h"
+#include "bgpstream_utils_id_set.h"
+#include "bgpstream_utils_pfx_set.h"
+
+/* Rows of the Count-Min sketches, and columns per key kept */
+#define AGG_CM_DEPTH 4
+#define AGG_CM_WIDTH_PER_KEY 4
+
+/* HyperLogLog sketches have 2^AGG_HLL_BITS registers (for a standard error of
+ * 1.04 / 2^(AGG_HLL_BITS / 2), i.e., 1.6%) */
+#define AGG_HLL_BITS 12
+#define AGG_HLL_REGS (1 << AGG_HLL_BITS)
+
+static uint64_t mix64(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static uint64_t key_hash64(const bgpstream_agg_key_t *key)
+{
+  switch (key->type) {
+  case BGPSTREAM_AGG_KEY_PFX:
+    return mix64(bgpstream_pfx_hash(&key->pfx));
+  case BGPSTREAM_AGG_KEY_ORIGIN:
+    return mix64(key->asn);
+  case BGPSTREAM_AGG_KEY_PEER:
+    return mix64(
+      bgpstream_addr_hash((bgpstream_ip_addr_t *)&key->peer_ip) ^
+      ((uint64_t)key->asn << 32));
+  }
+  return 0;
+}
+
+static khint32_t key_hash(bgpstream_agg_key_t key)
+{
+  return (khint32_t)key_hash64(&key);
+}
+
+static int key_equal(bgpstream_agg_key_t key1, bgpstream_agg_key_t key2)
+{
+  if (key1.type != key2.type) {
+    return 0;
+  }
+  switch (key1.type) {
+  case BGPSTREAM_AGG_KEY_PFX:
+    return bgpstream_pfx_equal(&key1.pfx, &key2.pfx);
+  case BGPSTREAM_AGG_KEY_ORIGIN:
+    return key1.asn == key2.asn;
+  case BGPSTREAM_AGG_KEY_PEER:
+    return key1.asn == key2.asn &&
+           bgpstream_addr_equal(&key1.peer_ip, &key2.peer_ip);
+  }
+  return 0;
+}
+
+/* Counts of the keys (exact states), or index in the heap of the keys that are
+ * kept (approximate states) */
+KHASH_INIT(agg_counts, bgpstream_agg_key_t, uint64_t, 1, key_hash, key_equal)
+
+struct bgpstream_agg_state {
+
+  bgpstream_agg_key_type_t key_type;
+
+  /* 0 for exact counts */
+  uint32_t max_keys;
+
+  uint64_t elem_cnt;
+
+  khash_t(agg_counts) *counts;
+
+  /* Exact distinct prefixes and origins */
+  bgpstream_pfx_set_t *pfxs;
+
+  bgpstream_id_set_t *origins;
+
+  /* Count-Min sketch of AGG_CM_DEPTH rows of cm_mask + 1 counters */
+  uint64_t *cm;
+
+  uint32_t cm_mask;
+
+  /* Kept keys, in a min-heap of their estimated counts */
+  bgpstream_agg_count_t *heap;
+
+  uint32_t heap_cnt;
+
+  /* HyperLogLog sketches of the distinct prefixes and origins */
+  uint8_t *pfx_hll;
+
+  uint8_t *origin_hll;
+};
+
+struct bgpstream_agg {
+
+  /* States of the slides of the current window, slide i in slides[i % cnt] */
+  bgpstream_agg_state_t **slides;
+
+  uint32_t slides_cnt;
+
+  uint32_t slide;
+
+  /* Merged slides, given to the callback (unused for tumbling windows) */
+  bgpstream_agg_state_t *window;
+
+  /* Latest slide (record time / slide), if started is set */
+  uint32_t cur;
+
+  int started;
+
+  bgpstream_agg_window_cb_t *cb;
+
+  void *user;
+};
+
+/* ==================== SKETCHES ==================== */
+
+/* Natural logarithm of x >= 1 (so that we do not need libm) */
+static double agg_ln(double x)
+{
+  double y, y2, term, sum = 0;
+  int k = 0, i;
+
+  while (x >= 2) {
+    x /= 2;
+    k++;
+  }
+  // ln(x) = 2 atanh((x - 1) / (x + 1)), which converges quickly for x < 2
+  y = (x - 1) / (x + 1);
+  y2 = y * y;
+  term = y;
+  for (i = 1; i < 40; i += 2) {
+    sum += term / i;
+    term *= y2;
+  }
+  return k * 0.69314718055994531 + 2 * sum;
+}
+
+static void hll_add(uint8_t *regs, uint64_t hash)
+{
+  uint32_t idx = hash >> (64 - AGG_HLL_BITS);
+  uint64_t rest = hash << AGG_HLL_BITS;
+  uint8_t rank;
+
+  rank = rest == 0 ? 64 - AGG_HLL_BITS + 1 : __builtin_clzll(rest) + 1;
+  if (regs[idx] < rank) {
+    regs[idx] = rank;
+  }
+}
+
+static uint64_t hll_estimate(const uint8_t *regs)
+{
+  double m = AGG_HLL_REGS, sum = 0, est;
+  uint32_t i, zeros = 0;
+
+  for (i = 0; i < AGG_HLL_REGS; i++) {
+    sum += 1.0 / (double)((uint64_t)1 << regs[i]);
+    if (regs[i] == 0) {
+      zeros++;
+    }
+  }
+  est = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+  // small cardinalities are better estimated by linear counting
+  if (est <= 2.5 * m && zeros != 0) {
+    est = m * agg_ln(m / zeros);
+  }
+  return (uint64_t)(est + 0.5);
+}
+
+/* Add n to the count of a key hash, and return its new estimate */
+static uint64_t cm_add(bgpstream_agg_state_t *state, uint64_t hash, uint64_t n)
+{
+  uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32) | 1;
+  uint64_t *c, est = UINT64_MAX;
+  int i;
+
+  for (i = 0; i < AGG_CM_DEPTH; i++) {
+    c = &state->cm[i * (state->cm_mask + 1) + ((h1 + i * h2) & state->cm_mask)];
+    *c += n;
+    if (*c < est) {
+      est = *c;
+    }
+  }
+  return est;
+}
+
+static uint64_t cm_query(bgpstream_agg_state_t *state, uint64_t hash)
+{
+  uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32) | 1;
+  uint64_t c, est = UINT64_MAX;
+  int i;
+
+  for (i = 0; i < AGG_CM_DEPTH; i++) {
+    c = state->cm[i * (state->cm_mask + 1) + ((h1 + i * h2) & state->cm_mask)];
+    if (c < est) {
+      est = c;
+    }
+  }
+  return est;
+}
+
+/* ==================== KEPT KEYS ==================== */
+
+/* Put a count at index i of the heap */
+static void heap_set(bgpstream_agg_state_t *state, uint32_t i,
+                     const bgpstream_agg_count_t *count)
+{
+  khiter_t k;
+
+  state->heap[i] = *count;
+  k = kh_get(agg_counts, state->counts, count->key);
+  assert(k != kh_end(state->counts));
+  kh_val(state->counts, k) = i;
+}
+
+static void heap_up(bgpstream_agg_state_t *state, uint32_t i)
+{
+  bgpstream_agg_count_t count = state->heap[i];
+  uint32_t parent;
+
+  while (i > 0 && state->heap[parent = (i - 1) / 2].count > count.count) {
+    heap_set(state, i, &state->heap[parent]);
+    i = parent;
+  }
+  heap_set(state, i, &count);
+}
+
+static void heap_down(bgpstream_agg_state_t *state, uint32_t i)
+{
+  bgpstream_agg_count_t count = state->heap[i];
+  uint32_t child;
+
+  while ((child = i * 2 + 1) < state->heap_cnt) {
+    if (child + 1 < state->heap_cnt &&
+        state->heap[child + 1].count < state->heap[child].count) {
+      child++;
+    }
+    if (state->heap[child].count >= count.count) {
+      break;
+    }
+    heap_set(state, i, &state->heap[child]);
+    i = child;
+  }
+  heap_set(state, i, &count);
+}
+
+/* Keep a key if its estimate is one of the highest */
+static int keep_key(bgpstream_agg_state_t *state,
+                    const bgpstream_agg_key_t *key, uint64_t est)
+{
+  bgpstream_agg_count_t count;
+  khiter_t k;
+  int khret;
+
+  if ((k = kh_get(agg_counts, state->counts, *key)) !=
+      kh_end(state->counts)) {
+    // estimates only grow
+    state->heap[kh_val(state->counts, k)].count = est;
+    heap_down(state, kh_val(state->counts, k));
+    return 0;
+  }
+  if (state->heap_cnt == state->max_keys) {
+    if (est <= state->heap[0].count) {
+      return 0;
+    }
+    // the key with the lowest estimate makes room
+    k = kh_get(agg_counts, state->counts, state->heap[0].key);
+    kh_del(agg_counts, state->counts, k);
+    state->heap[0] = state->heap[--state->heap_cnt];
+    if (state->heap_cnt != 0) {
+      heap_set(state, 0, &state->heap[0]);
+      heap_down(state, 0);
+    }
+  }
+  k = kh_put(agg_counts, state->counts, *key, &khret);
+  if (khret < 0) {
+    return -1;
+  }
+  count.key = *key;
+  count.count = est;
+  kh_val(state->counts, k) = state->heap_cnt;
+  state->heap[state->heap_cnt++] = count;
+  heap_up(state, state->heap_cnt - 1);
+  return 0;
+}
+
+static int count_add(bgpstream_agg_state_t *state,
+                     const bgpstream_agg_key_t *key, uint64_t n)
+{
+  khiter_t k;
+  int khret;
+
+  if (state->max_keys != 0) {
+    return keep_key(state, key, cm_add(state, key_hash64(key), n));
+  }
+  k = kh_put(agg_counts, state->counts, *key, &khret);
+  if (khret < 0) {
+    return -1;
+  }
+  if (khret != 0) {
+    kh_val(state->counts, k) = 0;
+  }
+  kh_val(state->counts, k) += n;
+  return 0;
+}
+
+/* Sort counts highest first */
+static int count_cmp(const void *a, const void *b)
+{
+  const bgpstream_agg_count_t *c1 = a, *c2 = b;
+
+  return c1->count < c2->count ? 1 : c1->count > c2->count ? -1 : 0;
+}
+
+/* Keep the keys of both states that have the highest estimates, once the
+ * sketch of src has been added to the one of dst */
+static int merge_kept(bgpstream_agg_state_t *dst, bgpstream_agg_state_t *src)
+{
+  bgpstream_agg_count_t *all;
+  uint32_t cnt = 0, i;
+  khiter_t k;
+  int khret;
+
+  if ((all = malloc(sizeof(bgpstream_agg_count_t) *
+                    (dst->heap_cnt + src->heap_cnt))) == NULL) {
+    return -1;
+  }
+  memcpy(all, dst->heap, sizeof(bgpstream_agg_count_t) * dst->heap_cnt);
+  cnt = dst->heap_cnt;
+  for (i = 0; i < src->heap_cnt; i++) {
+    if (kh_get(agg_counts, dst->counts, src->heap[i].key) ==
+        kh_end(dst->counts)) {
+      all[cnt++] = src->heap[i];
+    }
+  }
+  for (i = 0; i < cnt; i++) {
+    all[i].count = cm_query(dst, key_hash64(&all[i].key));
+  }
+  qsort(all, cnt, sizeof(bgpstream_agg_count_t), count_cmp);
+  if (cnt > dst->max_keys) {
+    cnt = dst->max_keys;
+  }
+
+  // the highest counts, lowest first, make a heap
+  kh_clear(agg_counts, dst->counts);
+  for (i = 0; i < cnt; i++) {
+    dst->heap[i] = all[cnt - i - 1];
+    k = kh_put(agg_counts, dst->counts, dst->heap[i].key, &khret);
+    if (khret < 0) {
+      free(all);
+      dst->heap_cnt = i;
+      return -1;
+    }
+    kh_val(dst->counts, k) = i;
+  }
+  dst->heap_cnt = cnt;
+  free(all);
+  return 0;
+}
+
+/* ==================== STATES ==================== */
+
+bgpstream_agg_state_t *
+bgpstream_agg_state_create(bgpstream_agg_key_type_t key_type,
+                           uint32_t max_keys)
+{
+  bgpstream_agg_state_t *state;
+  uint32_t width = 1;
+
+  if ((state = malloc_zero(sizeof(bgpstream_agg_state_t))) == NULL) {
+    return NULL;
+  }
+  state->key_type = key_type;
+  state->max_keys = max_keys;
+  if ((state->counts = kh_init(agg_counts)) == NULL) {
+    goto err;
+  }
+
+  if (max_keys == 0) {
+    if ((state->pfxs = bgpstream_pfx_set_create()) == NULL ||
+        (state->origins = bgpstream_id_set_create()) == NULL) {
+      goto err;
+    }
+    return state;
+  }
+
+  if (max_keys > UINT32_MAX / AGG_CM_WIDTH_PER_KEY / 2) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Too many aggregation keys (%" PRIu32 ")",
+                  max_keys);
+    goto err;
+  }
+  while (width < max_keys * AGG_CM_WIDTH_PER_KEY) {
+    width <<= 1;
+  }
+  state->cm_mask = width - 1;
+  if ((state->cm = calloc((size_t)width * AGG_CM_DEPTH, sizeof(uint64_t))) ==
+        NULL ||
+      (state->heap = malloc(sizeof(bgpstream_agg_count_t) * max_keys)) ==
+        NULL ||
+      (state->pfx_hll = calloc(AGG_HLL_REGS, 1)) == NULL ||
+      (state->origin_hll = calloc(AGG_HLL_REGS, 1)) == NULL) {
+    goto err;
+  }
+  return state;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create aggregation state");
+  bgpstream_agg_state_destroy(state);
+  return NULL;
+}
+
+void bgpstream_agg_state_destroy(bgpstream_agg_state_t *state)
+{
+  if (state == NULL) {
+    return;
+  }
+  if (state->counts != NULL) {
+    kh_destroy(agg_counts, state->counts);
+  }
+  if (state->pfxs != NULL) {
+    bgpstream_pfx_set_destroy(state->pfxs);
+  }
+  if (state->origins != NULL) {
+    bgpstream_id_set_destroy(state->origins);
+  }
+  free(state->cm);
+  free(state->heap);
+  free(state->pfx_hll);
+  free(state->origin_hll);
+  free(state);
+}
+
+void bgpstream_agg_state_clear(bgpstream_agg_state_t *state)
+{
+  state->elem_cnt = 0;
+  kh_clear(agg_counts, state->counts);
+  if (state->max_keys == 0) {
+    bgpstream_pfx_set_clear(state->pfxs);
+    bgpstream_id_set_clear(state->origins);
+    return;
+  }
+  memset(state->cm, 0,
+         sizeof(uint64_t) * ((size_t)state->cm_mask + 1) * AGG_CM_DEPTH);
+  state->heap_cnt = 0;
+  memset(state->pfx_hll, 0, AGG_HLL_REGS);
+  memset(state->origin_hll, 0, AGG_HLL_REGS);
+}
+
+int bgpstream_agg_state_add_elem(bgpstream_agg_state_t *state,
+                                 bgpstream_elem_t *elem)
+{
+  bgpstream_agg_key_t key;
+  bgpstream_as_path_t *path;
+  uint32_t origin;
+  int has_origin;
+
+  if (elem->type != BGPSTREAM_ELEM_TYPE_RIB &&
+      elem->type != BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT) {
+    return 0;
+  }
+  has_origin = (path = bgpstream_elem_get_as_path(elem)) != NULL &&
+               bgpstream_as_path_get_origin_val(path, &origin) == 0;
+  state->elem_cnt++;
+
+  if (state->max_keys == 0) {
+    if (bgpstream_pfx_set_insert(state->pfxs, &elem->prefix) < 0 ||
+        (has_origin && bgpstream_id_set_insert(state->origins, origin) < 0)) {
+      return -1;
+    }
+  } else {
+    hll_add(state->pfx_hll, mix64(bgpstream_pfx_hash(&elem->prefix)));
+    if (has_origin) {
+      hll_add(state->origin_hll, mix64(origin));
+    }
+  }
+
+  memset(&key, 0, sizeof(key));
+  key.type = state->key_type;
+  switch (state->key_type) {
+  case BGPSTREAM_AGG_KEY_PFX:
+    bgpstream_pfx_copy(&key.pfx, &elem->prefix);
+    break;
+  case BGPSTREAM_AGG_KEY_ORIGIN:
+    if (!has_origin) {
+      return 0;
+    }
+    key.asn = origin;
+    break;
+  case BGPSTREAM_AGG_KEY_PEER:
+    bgpstream_addr_copy(&key.peer_ip, &elem->peer_ip);
+    key.asn = elem->peer_asn;
+    break;
+  }
+  return count_add(state, &key, 1);
+}
+
+int bgpstream_agg_state_merge(bgpstream_agg_state_t *dst,
+                              bgpstream_agg_state_t *src)
+{
+  bgpstream_agg_key_t key;
+  size_t i, cm_cnt;
+  khiter_t k;
+
+  if (dst->key_type != src->key_type || dst->max_keys != src->max_keys) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Cannot merge aggregation states of different types");
+    return -1;
+  }
+  dst->elem_cnt += src->elem_cnt;
+
+  if (dst->max_keys == 0) {
+    for (k = kh_begin(src->counts); k != kh_end(src->counts); ++k) {
+      if (kh_exist(src->counts, k)) {
+        key = kh_key(src->counts, k);
+        if (count_add(dst, &key, kh_val(src->counts, k)) != 0) {
+          return -1;
+        }
+      }
+    }
+    if (bgpstream_pfx_set_merge(dst->pfxs, src->pfxs) != 0 ||
+        bgpstream_id_set_merge(dst->origins, src->origins) != 0) {
+      return -1;
+    }
+    return 0;
+  }
+
+  cm_cnt = ((size_t)dst->cm_mask + 1) * AGG_CM_DEPTH;
+  for (i = 0; i < cm_cnt; i++) {
+    dst->cm[i] += src->cm[i];
+  }
+  for (i = 0; i < AGG_HLL_REGS; i++) {
+    if (dst->pfx_hll[i] < src->pfx_hll[i]) {
+      dst->pfx_hll[i] = src->pfx_hll[i];
+    }
+    if (dst->origin_hll[i] < src->origin_hll[i]) {
+      dst->origin_hll[i] = src->origin_hll[i];
+    }
+  }
+  return merge_kept(dst, src);
+}
+
+uint64_t bgpstream_agg_state_get_elem_cnt(bgpstream_agg_state_t *state)
+{
+  return state->elem_cnt;
+}
+
+uint64_t bgpstream_agg_state_get_pfx_cnt(bgpstream_agg_state_t *state)
+{
+  if (state->max_keys == 0) {
+    return bgpstream_pfx_set_size(state->pfxs);
+  }
+  return hll_estimate(state->pfx_hll);
+}
+
+uint64_t bgpstream_agg_state_get_origin_cnt(bgpstream_agg_state_t *state)
+{
+  if (state->max_keys == 0) {
+    return bgpstream_id_set_size(state->origins);
+  }
+  return hll_estimate(state->origin_hll);
+}
+
+uint64_t bgpstream_agg_state_get_count(bgpstream_agg_state_t *state,
+                                       const bgpstream_agg_key_t *key)
+{
+  khiter_t k;
+
+  if (state->max_keys != 0) {
+    return cm_query(state, key_hash64(key));
+  }
+  if ((k = kh_get(agg_counts, state->counts, *key)) == kh_end(state->counts)) {
+    return 0;
+  }
+  return kh_val(state->counts, k);
+}
+
+int bgpstream_agg_state_get_top(bgpstream_agg_state_t *state,
+                                bgpstream_agg_count_t *top, int n)
+{
+  bgpstream_agg_count_t *all;
+  uint32_t cnt = 0;
+  khiter_t k;
+
+  if (n <= 0) {
+    return 0;
+  }
+  if ((all = malloc(sizeof(bgpstream_agg_count_t) *
+                    (kh_size(state->counts) + 1))) == NULL) {
+    return -1;
+  }
+  if (state->max_keys != 0) {
+    memcpy(all, state->heap, sizeof(bgpstream_agg_count_t) * state->heap_cnt);
+    cnt = state->heap_cnt;
+  } else {
+    for (k = kh_begin(state->counts); k != kh_end(state->counts); ++k) {
+      if (kh_exist(state->counts, k)) {
+        all[cnt].key = kh_key(state->counts, k);
+        all[cnt++].count = kh_val(state->counts, k);
+      }
+    }
+  }
+  qsort(all, cnt, sizeof(bgpstream_agg_count_t), count_cmp);
+  if (cnt > (uint32_t)n) {
+    cnt = n;
+  }
+  memcpy(top, all, sizeof(bgpstream_agg_count_t) * cnt);
+  free(all);
+  return cnt;
+}
+
+int bgpstream_agg_state_foreach(bgpstream_agg_state_t *state,
+                                bgpstream_agg_count_cb_t *cb, void *user)
+{
+  bgpstream_agg_count_t count;
+  khiter_t k;
+  uint32_t i;
+  int ret;
+
+  if (state->max_keys != 0) {
+    for (i = 0; i < state->heap_cnt; i++) {
+      if ((ret = cb(&state->heap[i], user)) != 0) {
+        return ret;
+      }
+    }
+    return 0;
+  }
+  for (k = kh_begin(state->counts); k != kh_end(state->counts); ++k) {
+    if (kh_exist(state->counts, k)) {
+      count.key = kh_key(state->counts, k);
+      count.count = kh_val(state->counts, k);
+      if ((ret = cb(&count, user)) != 0) {
+        return ret;
+      }
+    }
+  }
+  return 0;
+}
+
+/* ==================== WINDOWS ==================== */
+
+/* Give the window that ends with the given slide to the callback, unless it
+ * has no elems */
+static int emit_window(bgpstream_agg_t *agg, uint32_t last)
+{
+  bgpstream_agg_state_t *state = NULL;
+  uint32_t first, i;
+
+  // the first windows start before the first slide
+  first = last >= agg->slides_cnt - 1 ? last - (agg->slides_cnt - 1) : 0;
+  if (agg->window != NULL) {
+    bgpstream_agg_state_clear(agg->window);
+  }
+  for (i = first; i <= last; i++) {
+    if (bgpstream_agg_state_get_elem_cnt(agg->slides[i % agg->slides_cnt]) ==
+        0) {
+      continue;
+    }
+    if (agg->window == NULL) {
+      state = agg->slides[i % agg->slides_cnt];
+    } else if (bgpstream_agg_state_merge(
+                 agg->window, agg->slides[i % agg->slides_cnt]) != 0) {
+      return -1;
+    } else {
+      state = agg->window;
+    }
+  }
+  if (state == NULL) {
+    return 0;
+  }
+  if (agg->cb(first * agg->slide, (last + 1) * agg->slide, state,
+              agg->user) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/* End the windows up to the one that ends with the slide before the given
+ * one */
+static int advance(bgpstream_agg_t *agg, uint32_t slide)
+{
+  uint32_t steps = 0;
+
+  while (agg->cur < slide) {
+    if (emit_window(agg, agg->cur) != 0) {
+      return -1;
+    }
+    agg->cur++;
+    bgpstream_agg_state_clear(agg->slides[agg->cur % agg->slides_cnt]);
+    // the following windows have no elems
+    if (++steps == agg->slides_cnt) {
+      agg->cur = slide;
+    }
+  }
+  return 0;
+}
+
+bgpstream_agg_t *bgpstream_agg_create(bgpstream_agg_key_type_t key_type,
+                                      uint32_t max_keys, uint32_t window,
+                                      uint32_t slide,
+                                      bgpstream_agg_window_cb_t *cb,
+                                      void *user)
+{
+  bgpstream_agg_t *agg;
+  uint32_t i;
+
+  if (slide == 0 || window < slide || window % slide != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Invalid aggregation window (%" PRIu32 "s every %" PRIu32
+                  "s)",
+                  window, slide);
+    return NULL;
+  }
+  if ((agg = malloc_zero(sizeof(bgpstream_agg_t))) == NULL) {
+    return NULL;
+  }
+  agg->slides_cnt = window / slide;
+  agg->slide = slide;
+  agg->cb = cb;
+  agg->user = user;
+  if ((agg->slides = malloc_zero(sizeof(bgpstream_agg_state_t *) *
+                                 agg->slides_cnt)) == NULL) {
+    goto err;
+  }
+  for (i = 0; i < agg->slides_cnt; i++) {
+    if ((agg->slides[i] = bgpstream_agg_state_create(key_type, max_keys)) ==
+        NULL) {
+      goto err;
+    }
+  }
+  if (agg->slides_cnt > 1 &&
+      (agg->window = bgpstream_agg_state_create(key_type, max_keys)) == NULL) {
+    goto err;
+  }
+  return agg;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create aggregation");
+  bgpstream_agg_destroy(agg);
+  return NULL;
+}
+
+void bgpstream_agg_destroy(bgpstream_agg_t *agg)
+{
+  uint32_t i;
+
+  if (agg == NULL) {
+    return;
+  }
+  if (agg->slides != NULL) {
+    for (i = 0; i < agg->slides_cnt; i++) {
+      bgpstream_agg_state_destroy(agg->slides[i]);
+    }
+    free(agg->slides);
+  }
+  bgpstream_agg_state_destroy(agg->window);
+  free(agg);
+}
+
+int bgpstream_agg_add_elem(bgpstream_agg_t *agg,
+                           const bgpstream_record_t *record,
+                           bgpstream_elem_t *elem)
+{
+  uint32_t slide = record->time_sec / agg->slide;
+
+  if (!agg->started) {
+    agg->started = 1;
+    agg->cur = slide;
+  } else if (slide > agg->cur) {
+    if (advance(agg, slide) != 0) {
+      return -1;
+    }
+  } else if (agg->cur - slide >= agg->slides_cnt) {
+    // too late for the current window
+    return 0;
+  }
+  return bgpstream_agg_state_add_elem(agg->slides[slide % agg->slides_cnt],
+                                      elem);
+}
+
+int bgpstream_agg_add_record(bgpstream_agg_t *agg,
+                             bgpstream_record_t *record)
+{
+  bgpstream_elem_t *elem;
+  int rc;
+
+  while ((rc = bgpstream_record_get_next_elem(record, &elem)) > 0) {
+    if (bgpstream_agg_add_elem(agg, record, elem) != 0) {
+      return -1;
+    }
+  }
+  if (rc < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not read the elems of a record");
+    return -1;
+  }
+  return 0;
+}
+
+int bgpstream_agg_flush(bgpstream_agg_t *agg)
+{
+  uint32_t i;
+  int rc;
+
+  if (!agg->started) {
+    return 0;
+  }
+  rc = emit_window(agg, agg->cur);
+  for (i = 0; i < agg->slides_cnt; i++) {
+    bgpstream_agg_state_clear(agg->slides[i]);
+  }
+  agg->started = 0;
+  return rc;
+}
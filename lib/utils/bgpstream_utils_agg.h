@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_UTILS_AGG_H
+#define __BGPSTREAM_UTILS_AGG_H
+
+#include <stdint.h>
+
+#include "bgpstream_elem.h"
+#include "bgpstream_record.h"
+#include "bgpstream_utils_addr.h"
+#include "bgpstream_utils_pfx.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of the BGP Stream
+ * aggregations: the number of routes (RIB and announcement elems) seen for
+ * each prefix, origin AS or peer, and the number of distinct prefixes and
+ * origin ASes, over tumbling or sliding windows of record time.
+ *
+ * An aggregation state holds the counts of a set of elems. Its counts are
+ * either exact, or approximated by sketches whose size is fixed when the state
+ * is created: a Count-Min sketch (and the keys with the highest estimates)
+ * for the counts, and HyperLogLog sketches for the distinct prefixes and
+ * origins. States with the same configuration can be merged, e.g., to combine
+ * the windows of streams that each read a shard of the data.
+ *
+ * An aggregation splits the elems of a stream into slides of a fixed number of
+ * seconds of record time, keeps one state for each slide of the current
+ * window, and each time a window ends, gives the state of the whole window to
+ * a callback. Windows whose length is their slide are tumbling windows.
+ */
+
+/**
+ * @name Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure containing an aggregation state */
+typedef struct bgpstream_agg_state bgpstream_agg_state_t;
+
+/** Opaque structure containing a windowed aggregation */
+typedef struct bgpstream_agg bgpstream_agg_t;
+
+/** @} */
+
+/**
+ * @name Public Enums
+ *
+ * @{ */
+
+/** What the routes are counted by */
+typedef enum {
+
+  /** The prefix of the route */
+  BGPSTREAM_AGG_KEY_PFX = 0,
+
+  /** The origin AS of the route (routes whose origin is an AS set are not
+   * counted) */
+  BGPSTREAM_AGG_KEY_ORIGIN = 1,
+
+  /** The peer (address and ASN) that the route comes from */
+  BGPSTREAM_AGG_KEY_PEER = 2,
+
+} bgpstream_agg_key_type_t;
+
+/** @} */
+
+/**
+ * @name Public Data Structures
+ *
+ * @{ */
+
+/** What a count is for. Only the fields of the key type are set, and the
+ * others are zero */
+typedef struct bgpstream_agg_key {
+
+  bgpstream_agg_key_type_t type;
+
+  /** The prefix (BGPSTREAM_AGG_KEY_PFX) */
+  bgpstream_pfx_t pfx;
+
+  /** The peer address (BGPSTREAM_AGG_KEY_PEER) */
+  bgpstream_ip_addr_t peer_ip;
+
+  /** The origin ASN (BGPSTREAM_AGG_KEY_ORIGIN) or the peer ASN
+   * (BGPSTREAM_AGG_KEY_PEER) */
+  uint32_t asn;
+
+} bgpstream_agg_key_t;
+
+/** The number of routes seen for a key */
+typedef struct bgpstream_agg_count {
+
+  bgpstream_agg_key_t key;
+
+  uint64_t count;
+
+} bgpstream_agg_count_t;
+
+/** Callback for the counts visited by bgpstream_agg_state_foreach
+ *
+ * @param count         the count of a key
+ * @param user          the pointer given to bgpstream_agg_state_foreach
+ * @return 0 to continue, any other value to stop
+ */
+typedef int(bgpstream_agg_count_cb_t)(const bgpstream_agg_count_t *count,
+                                      void *user);
+
+/** Callback for the windows of an aggregation
+ *
+ * @param start         the first second of the window
+ * @param end           the second after the last second of the window
+ * @param state         borrowed pointer to the state of the window, which is
+ *                      only valid until the callback returns
+ * @param user          the pointer given to bgpstream_agg_create
+ * @return 0 if successful, any other value to make the call that ended the
+ * window fail
+ */
+typedef int(bgpstream_agg_window_cb_t)(uint32_t start, uint32_t end,
+                                       bgpstream_agg_state_t *state,
+                                       void *user);
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new aggregation state
+ *
+ * @param key_type      what the routes are counted by
+ * @param max_keys      0 for exact counts, or the number of keys to keep the
+ *                      (approximate) counts of, which caps the memory used
+ * @return a pointer to the state if successful, NULL otherwise
+ *
+ * With max_keys set, the counts are estimated with a Count-Min sketch (which
+ * may overestimate them) of 128 to 256 bytes per key, and only the max_keys
+ * keys with the highest estimates are kept. The numbers of distinct prefixes
+ * and origins are then estimated with HyperLogLog sketches, to within about
+ * 2%.
+ */
+bgpstream_agg_state_t *
+bgpstream_agg_state_create(bgpstream_agg_key_type_t key_type,
+                           uint32_t max_keys);
+
+/** Destroy the given aggregation state
+ *
+ * @param state         pointer to the state to destroy
+ */
+void bgpstream_agg_state_destroy(bgpstream_agg_state_t *state);
+
+/** Forget the elems added to the given state
+ *
+ * @param state         pointer to the state to clear
+ */
+void bgpstream_agg_state_clear(bgpstream_agg_state_t *state);
+
+/** Add an elem to the given state
+ *
+ * @param state         pointer to the state
+ * @param elem          the elem to count
+ * @return 0 if successful, -1 otherwise
+ *
+ * Only RIB and announcement elems are counted, others are ignored.
+ */
+int bgpstream_agg_state_add_elem(bgpstream_agg_state_t *state,
+                                 bgpstream_elem_t *elem);
+
+/** Add the counts of one state to another
+ *
+ * @param dst           pointer to the state to add the counts to
+ * @param src           pointer to the state whose counts to add
+ * @return 0 if successful, -1 if the states were not created with the same
+ * key type and max_keys, or an error occurred
+ *
+ * The merged state holds the counts of the elems of both states. Merging
+ * approximate states is as accurate as adding the elems of both to one state,
+ * except that keys which did not have one of the highest estimates in either
+ * state may be missing.
+ */
+int bgpstream_agg_state_merge(bgpstream_agg_state_t *dst,
+                              bgpstream_agg_state_t *src);
+
+/** Get the number of elems counted by the given state
+ *
+ * @param state         pointer to the state
+ * @return the number of routes counted (exactly)
+ */
+uint64_t bgpstream_agg_state_get_elem_cnt(bgpstream_agg_state_t *state);
+
+/** Get the (estimated) number of distinct prefixes of the given state
+ *
+ * @param state         pointer to the state
+ * @return the number of distinct prefixes of the routes counted
+ */
+uint64_t bgpstream_agg_state_get_pfx_cnt(bgpstream_agg_state_t *state);
+
+/** Get the (estimated) number of distinct origin ASes of the given state
+ *
+ * @param state         pointer to the state
+ * @return the number of distinct origin ASNs of the routes counted
+ */
+uint64_t bgpstream_agg_state_get_origin_cnt(bgpstream_agg_state_t *state);
+
+/** Get the (estimated) count of a key
+ *
+ * @param state         pointer to the state
+ * @param key           the key to look up, of the key type of the state
+ * @return the number of routes counted for the key
+ *
+ * Approximate states estimate the count of any key, including the ones that
+ * are not kept.
+ */
+uint64_t bgpstream_agg_state_get_count(bgpstream_agg_state_t *state,
+                                       const bgpstream_agg_key_t *key);
+
+/** Get the keys with the highest counts
+ *
+ * @param state         pointer to the state
+ * @param[out] top      array of at least n counts, filled with the highest
+ *                      counts, highest first
+ * @param n             the number of counts to get
+ * @return the number of counts filled, which is less than n if the state has
+ * fewer keys, or -1 if an error occurred
+ */
+int bgpstream_agg_state_get_top(bgpstream_agg_state_t *state,
+                                bgpstream_agg_count_t *top, int n);
+
+/** Visit the counts of the given state
+ *
+ * @param state         pointer to the state
+ * @param cb            callback to call for each count
+ * @param user          pointer passed to the callback
+ * @return 0 if every count was visited, or the non-zero value returned by the
+ * callback that stopped the visit
+ *
+ * Every key is visited for exact states, and the keys that are kept for
+ * approximate states, in no particular order.
+ */
+int bgpstream_agg_state_foreach(bgpstream_agg_state_t *state,
+                                bgpstream_agg_count_cb_t *cb, void *user);
+
+/** Create a new windowed aggregation
+ *
+ * @param key_type      what the routes are counted by
+ * @param max_keys      0 for exact counts, or the number of keys to keep (see
+ *                      bgpstream_agg_state_create)
+ * @param window        length of the windows, in seconds
+ * @param slide         seconds between the starts of consecutive windows,
+ *                      which window must be a multiple of (window for
+ *                      tumbling windows)
+ * @param cb            callback to call with the state of each window
+ * @param user          pointer passed to the callback
+ * @return a pointer to the aggregation if successful, NULL otherwise
+ *
+ * Windows start at multiples of slide seconds. Windows that have no elems are
+ * skipped.
+ */
+bgpstream_agg_t *bgpstream_agg_create(bgpstream_agg_key_type_t key_type,
+                                      uint32_t max_keys, uint32_t window,
+                                      uint32_t slide,
+                                      bgpstream_agg_window_cb_t *cb,
+                                      void *user);
+
+/** Destroy the given aggregation
+ *
+ * @param agg           pointer to the aggregation to destroy
+ *
+ * The window that has not ended is not given to the callback (see
+ * bgpstream_agg_flush).
+ */
+void bgpstream_agg_destroy(bgpstream_agg_t *agg);
+
+/** Add an elem to the given aggregation
+ *
+ * @param agg           pointer to the aggregation
+ * @param record        the record that the elem belongs to, whose time places
+ *                      the elem in a slide
+ * @param elem          the elem to count
+ * @return 0 if successful, -1 otherwise
+ *
+ * Records must be given in time order: the windows that end before the slide
+ * of the record are given to the callback first, and elems of records that are
+ * older than the current window are not counted.
+ */
+int bgpstream_agg_add_elem(bgpstream_agg_t *agg,
+                           const bgpstream_record_t *record,
+                           bgpstream_elem_t *elem);
+
+/** Add the elems of a record to the given aggregation
+ *
+ * @param agg           pointer to the aggregation
+ * @param record        the record whose elems to count
+ * @return 0 if successful, -1 otherwise
+ *
+ * This reads the elems of the record (see bgpstream_record_get_next_elem), so
+ * callers that also need the elems should use bgpstream_agg_add_elem instead.
+ */
+int bgpstream_agg_add_record(bgpstream_agg_t *agg,
+                             bgpstream_record_t *record);
+
+/** End the current window of the given aggregation
+ *
+ * @param agg           pointer to the aggregation
+ * @return 0 if successful, -1 otherwise
+ *
+ * The window that ends with the slide of the latest record is given to the
+ * callback (even though more elems of that slide could follow), e.g., once the
+ * stream has ended. The aggregation then starts again from the next record.
+ */
+int bgpstream_agg_flush(bgpstream_agg_t *agg);
+
+/** @} */
+
+#endif /* __BGPSTREAM_UTILS_AGG_H */
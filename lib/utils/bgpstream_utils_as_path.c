@@ -38,6 +38,7 @@
 #include <assert.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #define SIZEOF_SEG_SET(segp)                                                   \
   (sizeof(bgpstream_as_path_seg_set_t) +                                       \
@@ -48,6 +49,12 @@
      ? sizeof(bgpstream_as_path_seg_asn_t)                                     \
      : SIZEOF_SEG_SET(&(segp)->set))
 
+/* the most ASNs of a path that are flattened on the stack */
+#define FLAT_ASNS_MAX 256
+
+/* paths with more ASNs than this are checked for loops by sorting them */
+#define LOOP_PAIRWISE_MAX 64
+
 #define CUR_SEG(path, iter)                                                    \
   ((bgpstream_as_path_seg_t *)((path)->data + (iter)->cur_offset))
 
@@ -238,6 +245,44 @@ int bgpstream_as_path_snprintf(char *buf, size_t len,
   return written;
 }
 
+/* free the data of a path, if it was allocated for it */
+static void free_data(bgpstream_as_path_t *path)
+{
+  if (path->data_alloc_len != UINT16_MAX && path->data != path->inline_data) {
+    free(path->data);
+  }
+}
+
+/* make sure the path owns a data buffer of at least len bytes, using the
+   inline storage if possible. if keep is set, the current data is kept */
+static int reserve_data(bgpstream_as_path_t *path, size_t len, int keep)
+{
+  uint8_t *buf;
+  int owned = path->data_alloc_len != UINT16_MAX && path->data != NULL;
+
+  if (owned && path->data_alloc_len >= len) {
+    return 0;
+  }
+  if (owned && path->data != path->inline_data) {
+    if ((buf = realloc(path->data, len)) == NULL) {
+      return -1;
+    }
+  } else {
+    buf = len <= BGPSTREAM_AS_PATH_INLINE_LEN ? path->inline_data
+                                              : malloc(len);
+    if (buf == NULL) {
+      return -1;
+    }
+    if (keep && path->data != NULL && path->data != buf) {
+      memcpy(buf, path->data, path->data_len);
+    }
+  }
+  path->data = buf;
+  path->data_alloc_len =
+    buf == path->inline_data ? BGPSTREAM_AS_PATH_INLINE_LEN : len;
+  return 0;
+}
+
 bgpstream_as_path_t *bgpstream_as_path_create()
 {
   bgpstream_as_path_t *path;
@@ -260,9 +305,7 @@ void bgpstream_as_path_clear(bgpstream_as_path_t *path)
 
 void bgpstream_as_path_destroy(bgpstream_as_path_t *path)
 {
-  if (path->data_alloc_len != UINT16_MAX) {
-    free(path->data);
-  }
+  free_data(path);
   path->data = NULL;
   path->data_alloc_len = 0;
   bgpstream_as_path_clear(path);
@@ -272,15 +315,8 @@ void bgpstream_as_path_destroy(bgpstream_as_path_t *path)
 int bgpstream_as_path_copy(bgpstream_as_path_t *dst,
     const bgpstream_as_path_t *src)
 {
-  if (dst->data_alloc_len == UINT16_MAX) {
-    /* no longer points to external memory */
-    dst->data_alloc_len = 0;
-  }
-  if (dst->data_alloc_len < src->data_len) {
-    if ((dst->data = realloc(dst->data, src->data_len)) == NULL) {
-      return -1;
-    }
-    dst->data_alloc_len = src->data_len;
+  if (reserve_data(dst, src->data_len, 0) != 0) {
+    return -1;
   }
 
   memcpy(dst->data, src->data, src->data_len);
@@ -292,6 +328,41 @@ int bgpstream_as_path_copy(bgpstream_as_path_t *dst,
   return 0;
 }
 
+/* is seg a repeat of the simple ASN segment before it? */
+static int is_prepend(const bgpstream_as_path_seg_t *seg,
+                      const bgpstream_as_path_seg_t *prev)
+{
+  return prev != NULL && seg->type == BGPSTREAM_AS_PATH_SEG_ASN &&
+         prev->type == BGPSTREAM_AS_PATH_SEG_ASN &&
+         seg->asn.asn == prev->asn.asn;
+}
+
+int bgpstream_as_path_copy_collapsed(bgpstream_as_path_t *dst,
+                                     const bgpstream_as_path_t *src)
+{
+  bgpstream_as_path_iter_t iter;
+  bgpstream_as_path_seg_t *seg, *prev = NULL;
+  uint16_t len = 0;
+
+  assert(dst != src);
+  if (reserve_data(dst, src->data_len, 0) != 0) {
+    return -1;
+  }
+
+  bgpstream_as_path_iter_reset(&iter);
+  while ((seg = bgpstream_as_path_get_next_seg(src, &iter)) != NULL) {
+    if (!is_prepend(seg, prev)) {
+      memcpy(dst->data + len, seg, SIZEOF_SEG(seg));
+      len += SIZEOF_SEG(seg);
+    }
+    prev = seg;
+  }
+  dst->data_len = len;
+  bgpstream_as_path_update_fields(dst);
+
+  return 0;
+}
+
 bgpstream_as_path_seg_t *
 bgpstream_as_path_get_origin_seg(bgpstream_as_path_t *path)
 {
@@ -351,6 +422,112 @@ int bgpstream_as_path_get_len(bgpstream_as_path_t *path)
   return path->seg_cnt;
 }
 
+int bgpstream_as_path_get_unique_len(const bgpstream_as_path_t *path)
+{
+  bgpstream_as_path_iter_t iter;
+  bgpstream_as_path_seg_t *seg, *prev = NULL;
+  int len = 0;
+
+  bgpstream_as_path_iter_reset(&iter);
+  while ((seg = bgpstream_as_path_get_next_seg(path, &iter)) != NULL) {
+    if (!is_prepend(seg, prev)) {
+      len++;
+    }
+    prev = seg;
+  }
+  return len;
+}
+
+/* flatten the ASNs of a path into an array, since its 5-byte segments cannot
+   be compared a vector at a time. prepended ASNs are only kept once, and set
+   members are only included if sets is non-zero. returns buf, or a heap array
+   that the caller must free if buf is too short, or NULL if none could be
+   allocated */
+static uint32_t *flatten_asns(const bgpstream_as_path_t *path, uint32_t *buf,
+                              int buf_len, int sets, int *cnt)
+{
+  bgpstream_as_path_iter_t iter;
+  bgpstream_as_path_seg_t *seg, *prev = NULL;
+  /* every ASN takes at least 4 bytes of path data */
+  int max = path->data_len / sizeof(uint32_t);
+  uint32_t *asns = buf;
+  int i;
+
+  if (max > buf_len && (asns = malloc(sizeof(uint32_t) * max)) == NULL) {
+    return NULL;
+  }
+
+  *cnt = 0;
+  bgpstream_as_path_iter_reset(&iter);
+  while ((seg = bgpstream_as_path_get_next_seg(path, &iter)) != NULL) {
+    if (seg->type == BGPSTREAM_AS_PATH_SEG_ASN) {
+      if (!is_prepend(seg, prev)) {
+        asns[(*cnt)++] = seg->asn.asn;
+      }
+    } else if (sets != 0) {
+      for (i = 0; i < seg->set.asn_cnt; i++) {
+        asns[(*cnt)++] = seg->set.asn[i];
+      }
+    }
+    prev = seg;
+  }
+  return asns;
+}
+
+int bgpstream_as_path_contains_asn(const bgpstream_as_path_t *path,
+                                   uint32_t asn)
+{
+  uint32_t buf[FLAT_ASNS_MAX];
+  uint32_t *asns;
+  int cnt, found;
+
+  if ((asns = flatten_asns(path, buf, FLAT_ASNS_MAX, 1, &cnt)) == NULL) {
+    return -1;
+  }
+  found = bgpstream_as_path_asns_find(asns, cnt, asn) != -1;
+  if (asns != buf) {
+    free(asns);
+  }
+  return found;
+}
+
+static int asn_cmp(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+int bgpstream_as_path_has_loop(const bgpstream_as_path_t *path)
+{
+  uint32_t buf[FLAT_ASNS_MAX];
+  uint32_t *asns;
+  int cnt, i, loop = 0;
+
+  if ((asns = flatten_asns(path, buf, FLAT_ASNS_MAX, 0, &cnt)) == NULL) {
+    return -1;
+  }
+
+  /* with prepending collapsed, any ASN seen twice is a loop. most paths are
+     short enough that searching the rest of the path for each ASN beats
+     sorting it */
+  if (cnt <= LOOP_PAIRWISE_MAX) {
+    for (i = 0; i < cnt - 1 && loop == 0; i++) {
+      loop = bgpstream_as_path_asns_find(asns + i + 1, cnt - i - 1,
+                                         asns[i]) != -1;
+    }
+  } else {
+    qsort(asns, cnt, sizeof(uint32_t), asn_cmp);
+    for (i = 1; i < cnt && loop == 0; i++) {
+      loop = asns[i] == asns[i - 1];
+    }
+  }
+
+  if (asns != buf) {
+    free(asns);
+  }
+  return loop;
+}
+
 uint16_t bgpstream_as_path_get_data(bgpstream_as_path_t *path, uint8_t **data)
 {
   assert(data != NULL);
@@ -370,17 +547,8 @@ int bgpstream_as_path_populate_from_data(bgpstream_as_path_t *path,
 
   bgpstream_as_path_clear(path);
 
-  if (path->data_alloc_len == UINT16_MAX) {
-    /* the data is not owned by us */
-    path->data_alloc_len = 0;
-    path->data = NULL;
-  }
-
-  if (path->data_alloc_len < data_len) {
-    if ((path->data = realloc(path->data, data_len)) == NULL) {
-      return -1;
-    }
-    path->data_alloc_len = data_len;
+  if (reserve_data(path, data_len, 0) != 0) {
+    return -1;
   }
 
   memcpy(path->data, data, data_len);
@@ -399,6 +567,7 @@ int bgpstream_as_path_populate_from_data_zc(bgpstream_as_path_t *path,
   bgpstream_as_path_clear(path);
 
   /* signal that this is external data */
+  free_data(path);
   path->data_alloc_len = UINT16_MAX;
   path->data = data;
   path->data_len = data_len;
@@ -529,11 +698,8 @@ int bgpstream_as_path_append(bgpstream_as_path_t *path,
     assert(new_len < UINT16_MAX);
   }
 
-  if (path->data_alloc_len < new_len) {
-    if ((path->data = realloc(path->data, new_len)) == NULL) {
-      return -1;
-    }
-    path->data_alloc_len = new_len;
+  if (reserve_data(path, new_len, 1) != 0) {
+    return -1;
   }
   path->data_len = new_len;
 
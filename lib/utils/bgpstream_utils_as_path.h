@@ -283,6 +283,21 @@ void bgpstream_as_path_destroy(bgpstream_as_path_t *path);
 int bgpstream_as_path_copy(bgpstream_as_path_t *dst,
     const bgpstream_as_path_t *src);
 
+/** Copy an AS path with the prepending removed
+ *
+ * @param dst           pointer to the AS path structure to copy into
+ * @param src           pointer to the AS path structure to copy from
+ * @return 0 if the copy was successful, -1 otherwise
+ *
+ * Runs of the same simple ASN (e.g. "1 2 2 2 3") are collapsed into a single
+ * segment ("1 2 3"). Sets and confederations are copied as they are.
+ *
+ * @note dst and src must be different paths. As with bgpstream_as_path_copy,
+ * any data currently in dst is overwritten.
+ */
+int bgpstream_as_path_copy_collapsed(bgpstream_as_path_t *dst,
+                                     const bgpstream_as_path_t *src);
+
 /** Get the origin AS segment from the given path
  *
  * @param path          pointer to the AS path to extract the origin AS for
@@ -340,6 +355,37 @@ bgpstream_as_path_get_next_seg(const bgpstream_as_path_t *path,
  */
 int bgpstream_as_path_get_len(bgpstream_as_path_t *path);
 
+/** Get the number of hops in the AS Path once prepending is removed
+ *
+ * @param path          pointer to the path to get the length of
+ * @return the number of segments the path would have if runs of the same
+ *         simple ASN were collapsed into one
+ *
+ * Each set or confederation counts as a single hop.
+ */
+int bgpstream_as_path_get_unique_len(const bgpstream_as_path_t *path);
+
+/** Check if an ASN appears anywhere in the AS Path
+ *
+ * @param path          pointer to the path to search
+ * @param asn           ASN to look for
+ * @return 1 if the ASN is in the path (including within sets), 0 if it is
+ *         not, -1 if an error occurred
+ */
+int bgpstream_as_path_contains_asn(const bgpstream_as_path_t *path,
+                                   uint32_t asn);
+
+/** Check if the AS Path contains a loop
+ *
+ * @param path          pointer to the path to check
+ * @return 1 if a simple ASN appears in two places that are separated by some
+ *         other hop, 0 if it does not, -1 if an error occurred
+ *
+ * Prepending (the same ASN repeated back to back) is not a loop. Sets and
+ * confederations are ignored.
+ */
+int bgpstream_as_path_has_loop(const bgpstream_as_path_t *path);
+
 /** Provides access to the internal byte array that stores the path segments
  *
  * @param path          pointer to the path
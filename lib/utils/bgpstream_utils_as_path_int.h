@@ -29,6 +29,10 @@
 
 #include "bgpstream_utils_as_path.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /** @file
  *
  * @brief Header file that exposes the private interface of BGP Stream AS
@@ -43,6 +47,10 @@
  *
  * @{ */
 
+/** Number of bytes of path data stored in the path itself, enough for six
+    simple ASN segments */
+#define BGPSTREAM_AS_PATH_INLINE_LEN 32
+
 /** @} */
 
 /**
@@ -72,7 +80,8 @@ struct bgpstream_as_path {
   /* length of the byte array in use */
   uint16_t data_len;
 
-  /* allocated length of the byte array */
+  /* allocated length of the byte array, UINT16_MAX if the data belongs to
+     someone else */
   uint16_t data_alloc_len;
 
   /** The number of segments in the path */
@@ -80,6 +89,10 @@ struct bgpstream_as_path {
 
   /* offset of the origin segment */
   uint16_t origin_offset;
+
+  /* storage for paths of up to BGPSTREAM_AS_PATH_INLINE_LEN bytes, which data
+     points to while they fit (it is only allocated for longer paths) */
+  uint8_t inline_data[BGPSTREAM_AS_PATH_INLINE_LEN];
 };
 
 /** @} */
@@ -100,6 +113,37 @@ int bgpstream_as_path_append(bgpstream_as_path_t *path,
                              bgpstream_as_path_seg_type_t type, uint32_t *asns,
                              int asns_cnt);
 
+/** Find an ASN in an array of ASNs, four at a time where SSE2 is available
+ *
+ * @param asns          pointer to the array of ASNs to search
+ * @param cnt           number of ASNs in the array
+ * @param asn           ASN to look for
+ * @return the index of the first occurrence of asn, -1 if it is not there
+ */
+static inline int bgpstream_as_path_asns_find(const uint32_t *asns, int cnt,
+                                              uint32_t asn)
+{
+  int i = 0;
+#ifdef __SSE2__
+  __m128i needle = _mm_set1_epi32((int)asn);
+  int mask;
+
+  for (; i + 4 <= cnt; i += 4) {
+    mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(
+      _mm_loadu_si128((const __m128i *)(asns + i)), needle)));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; i < cnt; i++) {
+    if (asns[i] == asn) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 /** Update the internal fields once the data array has been changed
  *
  * @param path          pointer to the AS Path to update
@@ -0,0 +1,378 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_utils_as_path_match.h"
+#include "bgpstream_utils_as_path_int.h"
+#include "config.h"
+#include "utils.h"
+#include <assert.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the most ASN patterns, alternatives and digit units an expression may
+ * have */
+#define MAX_ITEMS 32
+#define MAX_ALTS 16
+#define MAX_UNITS 16
+
+/* no upper bound on the number of repeats of a unit */
+#define UNBOUNDED 255
+
+typedef enum {
+  ITEM_ASN,    // a single ASN
+  ITEM_ALTS,   // one of a few ASNs
+  ITEM_DIGITS, // an ASN whose decimal form matches a digit pattern
+} item_type_t;
+
+/* one digit (class) of a digit pattern, repeated min to max times */
+typedef struct unit {
+  uint16_t digits; // bit d is set if digit d matches
+  uint8_t min;
+  uint8_t max;
+} unit_t;
+
+/* an expression item, matching a single ASN of the path */
+typedef struct item {
+  item_type_t type;
+  union {
+    uint32_t asn;
+    struct {
+      uint32_t asns[MAX_ALTS];
+      int cnt;
+    } alts;
+    struct {
+      unit_t units[MAX_UNITS];
+      int cnt;
+    } digits;
+  };
+} item_t;
+
+struct bgpstream_as_path_match {
+  // must the items match at the start/end of the path?
+  int anchor_start;
+  int anchor_end;
+
+  // items matching consecutive ASNs of the path
+  item_t items[MAX_ITEMS];
+  int items_cnt;
+};
+
+// parse a decimal ASN (without leading zeros, which never appear in a path)
+static const char *parse_asn(const char *p, uint32_t *asn)
+{
+  uint64_t val = 0;
+
+  if (!isdigit((unsigned char)*p) ||
+      (*p == '0' && isdigit((unsigned char)p[1]))) {
+    return NULL;
+  }
+  while (isdigit((unsigned char)*p)) {
+    if ((val = val * 10 + (*p++ - '0')) > UINT32_MAX) {
+      return NULL;
+    }
+  }
+  *asn = val;
+  return p;
+}
+
+// parse "(A|B|...)"
+static const char *parse_alts(const char *p, item_t *item)
+{
+  item->type = ITEM_ALTS;
+  item->alts.cnt = 0;
+  do {
+    if (item->alts.cnt == MAX_ALTS ||
+        (p = parse_asn(p + 1, &item->alts.asns[item->alts.cnt++])) == NULL) {
+      return NULL;
+    }
+  } while (*p == '|');
+  return *p == ')' ? p + 1 : NULL;
+}
+
+// parse a sequence of digits and digit classes, with optional quantifiers
+static const char *parse_digits(const char *p, item_t *item)
+{
+  unit_t *u;
+  int lo, hi, d;
+  int min_len = 0;
+
+  item->type = ITEM_DIGITS;
+  item->digits.cnt = 0;
+  while (*p != '_' && *p != '$' && *p != '\0') {
+    if (item->digits.cnt == MAX_UNITS) {
+      return NULL;
+    }
+    u = &item->digits.units[item->digits.cnt++];
+    u->digits = 0;
+    u->min = u->max = 1;
+    if (isdigit((unsigned char)*p)) {
+      u->digits = 1 << (*p++ - '0');
+    } else if (*p == '[') {
+      // a class of digits and digit ranges only (spaces, commas etc. would
+      // let the class match across ASNs)
+      for (p++; *p != ']'; p++) {
+        if (!isdigit((unsigned char)*p)) {
+          return NULL;
+        }
+        lo = hi = *p - '0';
+        if (p[1] == '-' && isdigit((unsigned char)p[2])) {
+          hi = p[2] - '0';
+          p += 2;
+        }
+        for (d = lo; d <= hi; d++) {
+          u->digits |= 1 << d;
+        }
+      }
+      if (u->digits == 0) {
+        return NULL;
+      }
+      p++;
+    } else {
+      return NULL;
+    }
+    switch (*p) {
+    case '*':
+      u->min = 0;
+      u->max = UNBOUNDED;
+      p++;
+      break;
+    case '+':
+      u->max = UNBOUNDED;
+      p++;
+      break;
+    case '?':
+      u->min = 0;
+      p++;
+      break;
+    }
+    min_len += u->min;
+  }
+  // a pattern that matches nothing lets "_" match the start (or end) of the
+  // path twice over, so "_1*_" matches any path
+  return min_len == 0 ? NULL : p;
+}
+
+static const char *parse_item(const char *p, item_t *item)
+{
+  const char *end;
+
+  if (*p == '(') {
+    if ((p = parse_alts(p, item)) != NULL && item->alts.cnt == 1) {
+      item->type = ITEM_ASN;
+      item->asn = item->alts.asns[0];
+    }
+    return p;
+  }
+  // plain ASNs are compared as numbers
+  if ((end = parse_asn(p, &item->asn)) != NULL &&
+      (*end == '_' || *end == '$' || *end == '\0')) {
+    item->type = ITEM_ASN;
+    return end;
+  }
+  return parse_digits(p, item);
+}
+
+// does the decimal form s match units onwards?
+static int digits_match(const char *s, const unit_t *units, int cnt)
+{
+  int n;
+
+  if (cnt == 0) {
+    return *s == '\0';
+  }
+  // take as many repeats as possible, backing off until the rest matches
+  for (n = 0; n < units->max && s[n] != '\0' &&
+              (units->digits & (1 << (s[n] - '0'))) != 0;
+       n++)
+    ;
+  for (; n >= units->min; n--) {
+    if (digits_match(s + n, units + 1, cnt - 1)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int item_match(const item_t *item, uint32_t asn)
+{
+  char buf[16];
+  int i;
+
+  switch (item->type) {
+  case ITEM_ASN:
+    return asn == item->asn;
+
+  case ITEM_ALTS:
+    for (i = 0; i < item->alts.cnt; i++) {
+      if (asn == item->alts.asns[i]) {
+        return 1;
+      }
+    }
+    return 0;
+
+  case ITEM_DIGITS:
+    snprintf(buf, sizeof(buf), "%" PRIu32, asn);
+    return digits_match(buf, item->digits.units, item->digits.cnt);
+  }
+  return 0;
+}
+
+/* ========== PUBLIC FUNCTIONS ========== */
+
+bgpstream_as_path_match_t *bgpstream_as_path_match_create(const char *expr)
+{
+  bgpstream_as_path_match_t *match;
+  const char *p = expr;
+
+  if ((match = malloc_zero(sizeof(bgpstream_as_path_match_t))) == NULL) {
+    return NULL;
+  }
+
+  // the first item must start at the start of the path or of an ASN
+  if (*p == '^') {
+    match->anchor_start = 1;
+    p++;
+    // "_" also matches the start of the path
+    if (*p == '_') {
+      p++;
+    }
+  } else if (*p == '_') {
+    p++;
+  } else {
+    goto err;
+  }
+
+  while (1) {
+    if (match->items_cnt == MAX_ITEMS ||
+        (p = parse_item(p, &match->items[match->items_cnt++])) == NULL) {
+      goto err;
+    }
+    // and each item must end at the end of an ASN (or of the path)
+    if (*p == '_') {
+      p++;
+      if (*p == '\0') {
+        break;
+      }
+      if (*p != '$') {
+        continue;
+      }
+    }
+    if (*p == '$' && p[1] == '\0') {
+      match->anchor_end = 1;
+      break;
+    }
+    goto err;
+  }
+
+  return match;
+
+err:
+  bgpstream_as_path_match_destroy(match);
+  return NULL;
+}
+
+void bgpstream_as_path_match_destroy(bgpstream_as_path_match_t *match)
+{
+  free(match);
+}
+
+int bgpstream_as_path_match_get_asns(const bgpstream_as_path_t *path,
+                                     uint32_t *asns, int len)
+{
+  bgpstream_as_path_iter_t iter;
+  bgpstream_as_path_seg_t *seg;
+  int cnt = 0;
+
+  bgpstream_as_path_iter_reset(&iter);
+  while ((seg = bgpstream_as_path_get_next_seg(path, &iter)) != NULL) {
+    if (seg->type != BGPSTREAM_AS_PATH_SEG_ASN || cnt == len) {
+      return -1;
+    }
+    asns[cnt++] = seg->asn.asn;
+  }
+  return cnt;
+}
+
+int bgpstream_as_path_match_exec(const bgpstream_as_path_match_t *match,
+                                 const uint32_t *asns, int cnt)
+{
+  int first = 0, last = cnt - match->items_cnt;
+  int i, j, k;
+
+  if (last < 0) {
+    return 0;
+  }
+
+  // anchors pin down where the items can match, so that e.g. an origin check
+  // only looks at the last ASN
+  if (match->anchor_end != 0) {
+    first = last;
+  }
+  if (match->anchor_start != 0) {
+    last = 0;
+  }
+  for (i = first; i <= last; i++) {
+    // skip straight to the next place the leading ASN appears
+    if (match->items[0].type == ITEM_ASN) {
+      if ((k = bgpstream_as_path_asns_find(asns + i, last - i + 1,
+                                           match->items[0].asn)) == -1) {
+        return 0;
+      }
+      i += k;
+    }
+    for (j = 0; j < match->items_cnt &&
+                item_match(&match->items[j], asns[i + j]);
+         j++)
+      ;
+    if (j == match->items_cnt) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int bgpstream_as_path_match_get_seq(const bgpstream_as_path_match_t *match,
+                                    uint32_t *asns, int len,
+                                    int *anchor_start, int *anchor_end)
+{
+  int i;
+
+  if (match->items_cnt > len) {
+    return -1;
+  }
+  for (i = 0; i < match->items_cnt; i++) {
+    if (match->items[i].type != ITEM_ASN) {
+      return -1;
+    }
+    asns[i] = match->items[i].asn;
+  }
+  *anchor_start = match->anchor_start;
+  *anchor_end = match->anchor_end;
+  return match->items_cnt;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_UTILS_AS_PATH_MATCH_H
+#define __BGPSTREAM_UTILS_AS_PATH_MATCH_H
+
+#include "bgpstream_utils_as_path.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the private interface of the AS path
+ * expression matcher, which matches Cisco-style AS path regular expressions
+ * against the ASNs of a path rather than against its string form
+ *
+ */
+
+/**
+ * @name Private Constants
+ *
+ * @{ */
+
+/** The longest path (in ASNs) that the matcher takes */
+#define BGPSTREAM_AS_PATH_MATCH_MAX_ASNS 1024
+
+/** @} */
+
+/**
+ * @name Private Opaque Data Structures
+ *
+ * @{ */
+
+/** A compiled AS path expression */
+typedef struct bgpstream_as_path_match bgpstream_as_path_match_t;
+
+/** @} */
+
+/**
+ * @name Private API Functions
+ *
+ * @{ */
+
+/** Compile an AS path regular expression
+ *
+ * @param expr          Cisco-style AS path regular expression
+ * @return pointer to the compiled expression, or NULL if the expression cannot
+ * be matched natively (or memory could not be allocated)
+ *
+ * Expressions are matched natively when they are a sequence of ASN patterns,
+ * each delimited by `_`, `^` or `$`, e.g. `_3356_`, `_64512$`, `^174_3356_` or
+ * `_(701|702)_645[0-9]+_`. An ASN pattern is an ASN, an alternation of ASNs in
+ * parentheses, or a sequence of digits and digit classes (`[0-9]`, `[1-3]`,
+ * ...), each optionally followed by `*`, `+` or `?`. Within this subset, a
+ * match gives the same result as the regular expression does on the string
+ * form of a path made up of plain ASNs. Other expressions must be matched as
+ * regular expressions.
+ */
+bgpstream_as_path_match_t *bgpstream_as_path_match_create(const char *expr);
+
+/** Destroy a compiled AS path expression
+ *
+ * @param match         pointer to the compiled expression to destroy
+ */
+void bgpstream_as_path_match_destroy(bgpstream_as_path_match_t *match);
+
+/** Get the ASNs of a path for matching
+ *
+ * @param path          pointer to the path
+ * @param asns          array to fill with the ASNs of the path
+ * @param len           number of ASNs the array can hold
+ * @return the number of ASNs in the path, or -1 if the path holds AS sets or
+ * confederation segments, or is longer than len ASNs
+ *
+ * Paths that are not made of plain ASNs must be matched as strings.
+ */
+int bgpstream_as_path_match_get_asns(const bgpstream_as_path_t *path,
+                                     uint32_t *asns, int len);
+
+/** Match a compiled expression against the ASNs of a path
+ *
+ * @param match         pointer to the compiled expression
+ * @param asns          the ASNs of the path, as returned by
+ *                      bgpstream_as_path_match_get_asns
+ * @param cnt           the number of ASNs in the path
+ * @return 1 if the path matches, 0 if not
+ */
+int bgpstream_as_path_match_exec(const bgpstream_as_path_match_t *match,
+                                 const uint32_t *asns, int cnt);
+
+/** Get the ASNs a compiled expression matches, if it only matches plain ASNs
+ *
+ * @param match         pointer to the compiled expression
+ * @param asns          array to fill with the ASNs the expression matches, in
+ *                      order
+ * @param len           number of ASNs the array can hold
+ * @param[out] anchor_start set to 1 if the ASNs must start the path, 0
+ *                      otherwise
+ * @param[out] anchor_end set to 1 if the ASNs must end the path, 0 otherwise
+ * @return the number of ASNs, or -1 if the expression has alternations or
+ * digit patterns (or more than len ASNs)
+ *
+ * Such an expression matches the paths in which these ASNs appear
+ * consecutively (e.g., `^174_3356_` gives 174 and 3356, anchored at the
+ * start).
+ */
+int bgpstream_as_path_match_get_seq(const bgpstream_as_path_match_t *match,
+                                    uint32_t *asns, int len,
+                                    int *anchor_start, int *anchor_end);
+
+/** @} */
+
+#endif /* __BGPSTREAM_UTILS_AS_PATH_MATCH_H */
@@ -27,8 +27,15 @@
 #include "config.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "khash.h"
 #include "utils.h"
@@ -38,6 +45,23 @@
 
 #include "bgpstream_utils_as_path_store.h"
 
+/** Size of the blocks that paths are stored in */
+#define ARENA_BLOCK_SIZE (1 << 20)
+
+/** Pathsets with up to this many paths are searched linearly */
+#define PATHSET_LINEAR_MAX 8
+
+/** Store file magic number ("BSPA"), version and byte order marker */
+#define STORE_FILE_MAGIC 0x42535041
+#define STORE_FILE_VERSION 1
+#define STORE_FILE_BYTE_ORDER 0x01020304
+
+/** Suffix of the file a store is written to before being renamed */
+#define TEMP_FILE_SUFFIX ".temp"
+
+/** Number of buckets allocated up front for the pathsets of a store */
+#define PATHSETS_PREALLOC (1 << 24) /* 2^24 = 16.8M buckets */
+
 /* wrapper around an AS path */
 struct bgpstream_as_path_store_path {
 
@@ -47,141 +71,392 @@ struct bgpstream_as_path_store_path {
   /** Internal index of this path within the store */
   uint32_t idx;
 
-  /** Underlying AS Path structure */
+  /** Hash of the whole path (see store_path_hash) */
+  uint32_t hash;
+
+  /** ID of this path */
+  bgpstream_as_path_store_path_id_t id;
+
+  /** Underlying AS Path structure, with its data in the store arena */
   bgpstream_as_path_t path;
 };
 
 /** A per-origin set of AS Paths */
 typedef struct pathset {
 
-  /** Array of AS Paths in the set */
-  bgpstream_as_path_store_path_t *paths;
+  /** Array of (pointers to) the AS Paths in the set, indexed by path ID */
+  bgpstream_as_path_store_path_t **paths;
 
   /** Number of AS paths in the set */
-  uint16_t paths_cnt;
+  uint32_t paths_cnt;
+
+  /** Number of AS paths allocated */
+  uint32_t paths_alloc_cnt;
+
+  /** Open-addressing index of the paths by hash (path ID + 1, 0 for empty
+      slots), only built once the set has more than PATHSET_LINEAR_MAX paths */
+  uint32_t *index;
 
-} __attribute__((packed)) pathset_t;
+  /** Number of slots in the index (a power of 2) */
+  uint32_t index_cnt;
+
+} pathset_t;
 
 KHASH_INIT(pathset, uint32_t, pathset_t, 1, kh_int_hash_func,
            kh_int_hash_equal)
 
-struct bgpstream_as_path_store {
+/** A block of store paths and their data */
+typedef struct arena_block {
+
+  /** The previously filled block */
+  struct arena_block *next;
+
+  /** Number of bytes used */
+  size_t used;
+
+  /** Number of bytes allocated */
+  size_t size;
+
+  /** The store paths and path data */
+  uint8_t data[] __attribute__((aligned(8)));
+
+} arena_block_t;
+
+/** A shard of the store, holding the pathsets of some of the origins */
+typedef struct shard {
 
   khash_t(pathset) * path_set;
 
+  /** The block that paths are currently being added to */
+  arena_block_t *arena;
+
+  /** (pointers to) the paths of the shard, in the order they were added */
+  bgpstream_as_path_store_path_t **paths;
+
+  /** Number of paths in the shard */
+  uint32_t paths_cnt;
+
+  /** Number of paths allocated */
+  uint32_t paths_alloc_cnt;
+
+  /** Protects everything above in concurrent stores */
+  pthread_mutex_t lock;
+
+} shard_t;
+
+/** Header of a store file */
+typedef struct store_file_hdr {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t paths_cnt;
+  uint64_t file_len;
+} store_file_hdr_t;
+
+/** A path in a store file, followed by its data_len bytes of data. Paths of
+    each pathset are in path ID order */
+typedef struct store_file_path {
+  uint32_t path_hash;
+  uint32_t path_id;
+  uint16_t data_len;
+  uint8_t is_core;
+} __attribute__((packed)) store_file_path_t;
+
+struct bgpstream_as_path_store_iter {
+
+  /** The store being iterated over */
+  bgpstream_as_path_store_t *store;
+
+  /** The current shard */
+  int shard;
+
+  /** The current path within the current shard */
+  uint32_t path;
+};
+
+struct bgpstream_as_path_store {
+
+  /** Shards of the store, selected by the top bits of the path hash */
+  shard_t *shards;
+
+  /** Number of shards (a power of 2) */
+  int shards_cnt;
+
+  /** log2 of the number of shards */
+  int shards_bits;
+
+  /** Do the shards need locking? */
+  int concurrent;
+
   /** The total number of paths in the store */
   uint32_t paths_cnt;
 
-  /** The currently iterated pathset */
-  khiter_t cur_pathset;
+  /** Store file that loaded paths point into, MAP_FAILED if none */
+  uint8_t *map;
+  size_t map_len;
 
-  /** The current path within the current pathset */
-  int cur_path;
+  /** The internal iterator */
+  struct bgpstream_as_path_store_iter it;
 };
 
-static void store_path_destroy(bgpstream_as_path_store_path_t *spath)
+static inline shard_t *get_shard(bgpstream_as_path_store_t *store,
+                                 uint32_t path_hash)
 {
-  if (spath == NULL) {
-    return;
+  return &store->shards[store->shards_bits == 0
+                          ? 0
+                          : path_hash >> (32 - store->shards_bits)];
+}
+
+static inline void shard_lock(bgpstream_as_path_store_t *store, shard_t *shard)
+{
+  if (store->concurrent != 0) {
+    pthread_mutex_lock(&shard->lock);
   }
+}
 
-  /* destroy the path's data */
-  assert(spath->path.data_alloc_len != UINT16_MAX);
-  free(spath->path.data);
-  spath->path.data = NULL;
-  spath->path.data_alloc_len = 0;
+static inline void shard_unlock(bgpstream_as_path_store_t *store,
+                                shard_t *shard)
+{
+  if (store->concurrent != 0) {
+    pthread_mutex_unlock(&shard->lock);
+  }
 }
 
-static int store_path_dup(bgpstream_as_path_store_path_t *dst,
-                   bgpstream_as_path_store_path_t *src)
+static uint8_t *arena_alloc(shard_t *shard, size_t len)
 {
-  *dst = *src;
+  arena_block_t *block = shard->arena;
+  size_t size;
+
+  /* keep the store paths aligned */
+  len = (len + 7) & ~(size_t)7;
+  if (block == NULL || block->size - block->used < len) {
+    size = len > ARENA_BLOCK_SIZE ? len : ARENA_BLOCK_SIZE;
+    if ((block = malloc(sizeof(arena_block_t) + size)) == NULL) {
+      return NULL;
+    }
+    block->next = shard->arena;
+    block->used = 0;
+    block->size = size;
+    shard->arena = block;
+  }
+  block->used += len;
+  return block->data + block->used - len;
+}
 
-  /* copy the path data */
-  dst->path.data_alloc_len = 0;
-  if ((dst->path.data = malloc(src->path.data_len)) == NULL) {
-    goto err;
+/* 32-bit FNV-1a of the path data and core flag */
+static inline uint32_t store_path_hash(bgpstream_as_path_store_path_t *spath)
+{
+  uint32_t h = 2166136261U ^ spath->is_core;
+  uint16_t i;
+
+  for (i = 0; i < spath->path.data_len; i++) {
+    h = (h ^ spath->path.data[i]) * 16777619U;
   }
-  dst->path.data_alloc_len = src->path.data_len;
-  dst->path.data_len = src->path.data_len;
-  memcpy(dst->path.data, src->path.data, src->path.data_len);
+  return h;
+}
 
-  return 0;
+/* copy a path (and, unless it is in a loaded store file, its data) into the
+   arena, which owns it */
+static bgpstream_as_path_store_path_t *
+store_path_dup(shard_t *shard, bgpstream_as_path_store_path_t *src,
+               int copy_data)
+{
+  bgpstream_as_path_store_path_t *dst;
+  size_t extra = 0;
 
-err:
-  store_path_destroy(dst);
-  return -1;
+  /* short paths live in the inline storage of the path */
+  if (copy_data && src->path.data_len > BGPSTREAM_AS_PATH_INLINE_LEN) {
+    extra = src->path.data_len;
+  }
+  if ((dst = (bgpstream_as_path_store_path_t *)arena_alloc(
+         shard, sizeof(*dst) + extra)) == NULL) {
+    return NULL;
+  }
+  *dst = *src;
+
+  /* the path must not free its data */
+  dst->path.data_alloc_len = UINT16_MAX;
+  if (copy_data) {
+    dst->path.data = extra != 0 ? (uint8_t *)(dst + 1) : dst->path.inline_data;
+    memcpy(dst->path.data, src->path.data, src->path.data_len);
+  }
+
+  return dst;
 }
 
 static inline int store_path_equal(bgpstream_as_path_store_path_t *sp1,
                                    bgpstream_as_path_store_path_t *sp2)
 {
-  return (sp1->is_core == sp2->is_core) &&
+  return (sp1->hash == sp2->hash) && (sp1->is_core == sp2->is_core) &&
          bgpstream_as_path_equal(&sp1->path, &sp2->path);
 }
 
 static void pathset_destroy(pathset_t ps)
 {
-  int i;
+  /* the paths are in the arena */
+  free(ps.paths);
+  free(ps.index);
+}
 
-  /* destroy each store path */
-  for (i = 0; i < ps.paths_cnt; i++) {
-    store_path_destroy(&ps.paths[i]);
-  }
+static void pathset_index_add(pathset_t *ps, uint32_t path_id)
+{
+  uint32_t mask = ps->index_cnt - 1;
+  uint32_t i = ps->paths[path_id]->hash & mask;
 
-  /* destroy the array of paths */
-  free(ps.paths);
-  ps.paths = NULL;
-  ps.paths_cnt = 0;
+  while (ps->index[i] != 0) {
+    i = (i + 1) & mask;
+  }
+  ps->index[i] = path_id + 1;
 }
 
-static uint16_t pathset_get_path_id(bgpstream_as_path_store_t *store,
-                                    pathset_t *ps,
-                                    bgpstream_as_path_store_path_t *findme)
+/* (re)build the index, keeping it at most half full */
+static int pathset_index_build(pathset_t *ps)
 {
-  int i;
-  uint32_t path_id;
+  uint32_t cnt = ps->index_cnt == 0 ? 32 : ps->index_cnt;
+  uint32_t i;
 
-  /* check if it is already in the set */
+  while (cnt < ps->paths_cnt * 2) {
+    cnt *= 2;
+  }
+  free(ps->index);
+  if ((ps->index = calloc(cnt, sizeof(uint32_t))) == NULL) {
+    ps->index_cnt = 0;
+    return -1;
+  }
+  ps->index_cnt = cnt;
   for (i = 0; i < ps->paths_cnt; i++) {
-    if (store_path_equal(&ps->paths[i], findme) != 0) {
-      return i;
+    pathset_index_add(ps, i);
+  }
+  return 0;
+}
+
+static uint32_t pathset_find(pathset_t *ps,
+                             bgpstream_as_path_store_path_t *findme)
+{
+  uint32_t i, mask;
+
+  if (ps->index == NULL) {
+    for (i = 0; i < ps->paths_cnt; i++) {
+      if (store_path_equal(ps->paths[i], findme) != 0) {
+        return i;
+      }
     }
+    return UINT32_MAX;
   }
 
-  findme->idx = store->paths_cnt++;
+  mask = ps->index_cnt - 1;
+  for (i = findme->hash & mask; ps->index[i] != 0; i = (i + 1) & mask) {
+    if (store_path_equal(ps->paths[ps->index[i] - 1], findme) != 0) {
+      return ps->index[i] - 1;
+    }
+  }
+  return UINT32_MAX;
+}
+
+/* make sure there is room for one more pointer in the given array */
+static int grow_paths(bgpstream_as_path_store_path_t ***paths, uint32_t cnt,
+                      uint32_t *alloc_cnt)
+{
+  bgpstream_as_path_store_path_t **p;
+  uint32_t new_cnt;
+
+  if (cnt < *alloc_cnt) {
+    return 0;
+  }
+  new_cnt = *alloc_cnt == 0 ? 4 : *alloc_cnt * 2;
+  if ((p = realloc(*paths, sizeof(*p) * new_cnt)) == NULL) {
+    return -1;
+  }
+  *paths = p;
+  *alloc_cnt = new_cnt;
+  return 0;
+}
+
+/* must be called with the shard locked */
+static uint32_t pathset_get_path_id(bgpstream_as_path_store_t *store,
+                                    shard_t *shard, pathset_t *ps,
+                                    bgpstream_as_path_store_path_t *findme,
+                                    int copy_data)
+{
+  bgpstream_as_path_store_path_t *spath;
+  uint32_t path_id;
+
+  /* check if it is already in the set */
+  findme->hash = store_path_hash(findme);
+  if ((path_id = pathset_find(ps, findme)) != UINT32_MAX) {
+    return path_id;
+  }
 
   /* need to append this path */
-  if ((ps->paths = realloc(ps->paths, sizeof(bgpstream_as_path_store_path_t) *
-                                        (ps->paths_cnt + 1))) == NULL) {
+  if (ps->paths_cnt == UINT32_MAX - 1) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Too many paths for one origin");
+    return UINT32_MAX;
+  }
+  if (grow_paths(&ps->paths, ps->paths_cnt, &ps->paths_alloc_cnt) != 0 ||
+      grow_paths(&shard->paths, shard->paths_cnt, &shard->paths_alloc_cnt) !=
+        0) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "Could not realloc paths");
-    return UINT16_MAX;
+    return UINT32_MAX;
   }
-  if (store_path_dup(&ps->paths[ps->paths_cnt], findme) != 0) {
+  findme->id.path_id = ps->paths_cnt;
+  if ((spath = store_path_dup(shard, findme, copy_data)) == NULL) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create store path");
-    return UINT16_MAX;
+    return UINT32_MAX;
   }
+
+  /* index the set once a linear search gets too slow */
   path_id = ps->paths_cnt++;
-  assert(ps->paths_cnt <= UINT16_MAX);
+  ps->paths[path_id] = spath;
+  if (ps->paths_cnt > PATHSET_LINEAR_MAX) {
+    if (ps->paths_cnt * 2 > ps->index_cnt) {
+      if (pathset_index_build(ps) != 0) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Could not index paths");
+        ps->paths_cnt--;
+        return UINT32_MAX;
+      }
+    } else {
+      pathset_index_add(ps, path_id);
+    }
+  }
+
+  shard->paths[shard->paths_cnt++] = spath;
+  spath->idx = __atomic_fetch_add(&store->paths_cnt, 1, __ATOMIC_RELAXED);
 
   return path_id;
 }
 
-/* ==================== PUBLIC FUNCTIONS ==================== */
-
-bgpstream_as_path_store_t *bgpstream_as_path_store_create()
+static bgpstream_as_path_store_t *store_create(int shards_bits, int concurrent)
 {
   bgpstream_as_path_store_t *store;
+  int i;
 
   if ((store = malloc_zero(sizeof(bgpstream_as_path_store_t))) == NULL) {
     return NULL;
   }
+  store->shards_bits = shards_bits;
+  store->concurrent = concurrent;
+  store->map = MAP_FAILED;
+  store->it.store = store;
 
-  if ((store->path_set = kh_init(pathset)) == NULL) {
+  if ((store->shards = malloc_zero(sizeof(shard_t) << shards_bits)) == NULL) {
     goto err;
   }
-  /* pre-allocate to minimize resize events */
-  kh_resize(pathset, store->path_set, 1 << 24); /* 2^24 = 16.8M buckets */
+  for (i = 0; i < (1 << shards_bits); i++) {
+    if (concurrent != 0 &&
+        pthread_mutex_init(&store->shards[i].lock, NULL) != 0) {
+      goto err;
+    }
+    if ((store->shards[i].path_set = kh_init(pathset)) == NULL) {
+      if (concurrent != 0) {
+        pthread_mutex_destroy(&store->shards[i].lock);
+      }
+      goto err;
+    }
+    store->shards_cnt++;
+    /* pre-allocate to minimize resize events */
+    kh_resize(pathset, store->shards[i].path_set,
+              PATHSETS_PREALLOC >> shards_bits);
+  }
 
   return store;
 
@@ -190,16 +465,44 @@ err:
   return NULL;
 }
 
+/* ==================== PUBLIC FUNCTIONS ==================== */
+
+bgpstream_as_path_store_t *bgpstream_as_path_store_create()
+{
+  return store_create(0, 0);
+}
+
+bgpstream_as_path_store_t *bgpstream_as_path_store_create_concurrent()
+{
+  return store_create(BGPSTREAM_AS_PATH_STORE_SHARDS_BITS, 1);
+}
+
 void bgpstream_as_path_store_destroy(bgpstream_as_path_store_t *store)
 {
+  shard_t *shard;
+  arena_block_t *block;
+  int i;
+
   if (store == NULL) {
     return;
   }
 
-  if (store->path_set != NULL) {
-    kh_free_vals(pathset, store->path_set, pathset_destroy);
-    kh_destroy(pathset, store->path_set);
-    store->path_set = NULL;
+  for (i = 0; i < store->shards_cnt; i++) {
+    shard = &store->shards[i];
+    kh_free_vals(pathset, shard->path_set, pathset_destroy);
+    kh_destroy(pathset, shard->path_set);
+    free(shard->paths);
+    while ((block = shard->arena) != NULL) {
+      shard->arena = block->next;
+      free(block);
+    }
+    if (store->concurrent != 0) {
+      pthread_mutex_destroy(&shard->lock);
+    }
+  }
+  free(store->shards);
+  if (store->map != MAP_FAILED) {
+    munmap(store->map, store->map_len);
   }
 
   free(store);
@@ -207,39 +510,45 @@ void bgpstream_as_path_store_destroy(bgpstream_as_path_store_t *store)
 
 uint32_t bgpstream_as_path_store_get_size(bgpstream_as_path_store_t *store)
 {
-  return store->paths_cnt;
+  return __atomic_load_n(&store->paths_cnt, __ATOMIC_RELAXED);
 }
 
 static int get_path_id(bgpstream_as_path_store_t *store,
                        bgpstream_as_path_store_path_t *findme,
-                       bgpstream_as_path_store_path_id_t *id)
+                       bgpstream_as_path_store_path_id_t *id, int copy_data)
 {
+  shard_t *shard;
   khiter_t k;
   int khret;
 
   id->path_hash = bgpstream_as_path_hash(&findme->path);
+  findme->id.path_hash = id->path_hash;
+  shard = get_shard(store, id->path_hash);
+  shard_lock(store, shard);
 
-  k = kh_put(pathset, store->path_set, id->path_hash, &khret);
+  k = kh_put(pathset, shard->path_set, id->path_hash, &khret);
   if (khret == 1) {
     /* just added this pathset */
     /* clear the pathset fields */
-    kh_val(store->path_set, k).paths = NULL;
-    kh_val(store->path_set, k).paths_cnt = 0;
+    memset(&kh_val(shard->path_set, k), 0, sizeof(pathset_t));
   } else if (khret != 0) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "Could not add path set to the store");
     goto err;
   }
 
   /* now get the path id from the origin set */
-  if ((id->path_id = pathset_get_path_id(store, &kh_val(store->path_set, k),
-                                         findme)) == UINT16_MAX) {
+  if ((id->path_id = pathset_get_path_id(store, shard,
+                                         &kh_val(shard->path_set, k), findme,
+                                         copy_data)) == UINT32_MAX) {
     bgpstream_log(BGPSTREAM_LOG_ERR, "Could not add path to origin set");
     goto err;
   }
 
+  shard_unlock(store, shard);
   return 0;
 
 err:
+  shard_unlock(store, shard);
   return -1;
 }
 
@@ -256,7 +565,7 @@ int bgpstream_as_path_store_get_path_id(bgpstream_as_path_store_t *store,
   /* special case for empty path */
   if (path == NULL) {
     id->path_hash = UINT32_MAX;
-    id->path_id = UINT16_MAX;
+    id->path_id = UINT32_MAX;
     return 0;
   }
 
@@ -284,7 +593,7 @@ int bgpstream_as_path_store_get_path_id(bgpstream_as_path_store_t *store,
     findme.is_core = 0;
   }
 
-  return get_path_id(store, &findme, id);
+  return get_path_id(store, &findme, id, 1);
 }
 
 int bgpstream_as_path_store_insert_path(bgpstream_as_path_store_t *store,
@@ -293,89 +602,319 @@ int bgpstream_as_path_store_insert_path(bgpstream_as_path_store_t *store,
                                         bgpstream_as_path_store_path_id_t *id)
 {
   bgpstream_as_path_store_path_t findme;
+  memset(&findme, 0, sizeof(findme));
   findme.is_core = is_core;
 
   bgpstream_as_path_populate_from_data_zc(&findme.path, path_data, path_len);
 
-  return get_path_id(store, &findme, id);
+  return get_path_id(store, &findme, id, 1);
 }
 
-void bgpstream_as_path_store_iter_first_path(bgpstream_as_path_store_t *store)
+static int write_all(FILE *f, const void *buf, size_t len)
 {
-  store->cur_pathset = kh_begin(store->path_set);
+  return (len != 0 && fwrite(buf, 1, len, f) != len) ? -1 : 0;
+}
 
-  while (!kh_exist(store->path_set, store->cur_pathset) &&
-         store->cur_pathset < kh_end(store->path_set)) {
-    store->cur_pathset++;
+/* write the paths of all pathsets of a shard, in path ID order */
+static int write_shard(bgpstream_as_path_store_t *store, shard_t *shard,
+                       FILE *f, store_file_hdr_t *hdr)
+{
+  bgpstream_as_path_store_path_t *spath;
+  store_file_path_t fpath;
+  pathset_t *ps;
+  khiter_t k;
+  uint32_t i;
+  int rc = 0;
+
+  shard_lock(store, shard);
+  for (k = kh_begin(shard->path_set); k != kh_end(shard->path_set) && rc == 0;
+       ++k) {
+    if (!kh_exist(shard->path_set, k)) {
+      continue;
+    }
+    ps = &kh_val(shard->path_set, k);
+    for (i = 0; i < ps->paths_cnt && rc == 0; i++) {
+      spath = ps->paths[i];
+      fpath.path_hash = spath->id.path_hash;
+      fpath.path_id = spath->id.path_id;
+      fpath.data_len = spath->path.data_len;
+      fpath.is_core = spath->is_core;
+      rc = write_all(f, &fpath, sizeof(fpath)) != 0 ||
+           write_all(f, spath->path.data, spath->path.data_len) != 0;
+      hdr->paths_cnt++;
+      hdr->file_len += sizeof(fpath) + spath->path.data_len;
+    }
   }
+  shard_unlock(store, shard);
+  return rc == 0 ? 0 : -1;
+}
 
-  store->cur_path = 0;
+int bgpstream_as_path_store_save(bgpstream_as_path_store_t *store,
+                                 const char *filename)
+{
+  store_file_hdr_t hdr;
+  char *temp_path = NULL;
+  FILE *f = NULL;
+  size_t len;
+  int i;
+
+  len = strlen(filename) + sizeof(TEMP_FILE_SUFFIX);
+  if ((temp_path = malloc(len)) == NULL) {
+    goto err;
+  }
+  snprintf(temp_path, len, "%s%s", filename, TEMP_FILE_SUFFIX);
+  if ((f = fopen(temp_path, "wb")) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create path store %s: %s",
+                  temp_path, strerror(errno));
+    goto err;
+  }
+
+  // the header is written again once the paths (which may be added to
+  // concurrently) have been counted
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = STORE_FILE_MAGIC;
+  hdr.version = STORE_FILE_VERSION;
+  hdr.byte_order = STORE_FILE_BYTE_ORDER;
+  hdr.file_len = sizeof(hdr);
+  if (write_all(f, &hdr, sizeof(hdr)) != 0) {
+    goto write_err;
+  }
+  for (i = 0; i < store->shards_cnt; i++) {
+    if (write_shard(store, &store->shards[i], f, &hdr) != 0) {
+      goto write_err;
+    }
+  }
+  if (fseek(f, 0, SEEK_SET) != 0 ||
+      write_all(f, &hdr, sizeof(hdr)) != 0 || fclose(f) != 0) {
+    f = NULL;
+    goto write_err;
+  }
+  f = NULL;
+  if (rename(temp_path, filename) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not rename %s: %s", temp_path,
+                  strerror(errno));
+    goto err;
+  }
+
+  free(temp_path);
+  return 0;
+
+write_err:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Could not write path store %s: %s",
+                temp_path, strerror(errno));
+err:
+  if (f != NULL) {
+    fclose(f);
+  }
+  if (temp_path != NULL) {
+    unlink(temp_path);
+  }
+  free(temp_path);
+  return -1;
 }
 
-void bgpstream_as_path_store_iter_next_path(bgpstream_as_path_store_t *store)
+int bgpstream_as_path_store_load(bgpstream_as_path_store_t *store,
+                                 const char *filename)
 {
-  pathset_t *pathset;
+  const store_file_hdr_t *hdr;
+  store_file_path_t fpath;
+  bgpstream_as_path_store_path_t findme;
+  bgpstream_as_path_store_path_id_t id;
+  struct stat st;
+  uint64_t off;
+  uint32_t i;
+  int fd;
+
+  if (store->map != MAP_FAILED ||
+      bgpstream_as_path_store_get_size(store) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "Path stores can only be loaded into empty stores");
+    return -1;
+  }
 
-  if (store->cur_pathset >= kh_end(store->path_set)) {
-    return;
+  if ((fd = open(filename, O_RDONLY)) < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open path store %s: %s",
+                  filename, strerror(errno));
+    return -1;
+  }
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(store_file_hdr_t)) {
+    close(fd);
+    goto corrupt;
   }
+  store->map_len = st.st_size;
+  store->map = mmap(NULL, store->map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (store->map == MAP_FAILED) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not map path store %s: %s",
+                  filename, strerror(errno));
+    return -1;
+  }
+
+  hdr = (const store_file_hdr_t *)store->map;
+  if (hdr->magic != STORE_FILE_MAGIC || hdr->version != STORE_FILE_VERSION ||
+      hdr->byte_order != STORE_FILE_BYTE_ORDER) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Path store %s has an unsupported format",
+                  filename);
+    return -1;
+  }
+  if (hdr->file_len != store->map_len) {
+    goto corrupt;
+  }
+
+  // the paths get the same IDs again as long as they are added in the same
+  // order, which is checked as we go. their data stays in the file
+  memset(&findme, 0, sizeof(findme));
+  off = sizeof(store_file_hdr_t);
+  for (i = 0; i < hdr->paths_cnt; i++) {
+    if (store->map_len - off < sizeof(fpath)) {
+      goto corrupt;
+    }
+    memcpy(&fpath, store->map + off, sizeof(fpath));
+    off += sizeof(fpath);
+    if (store->map_len - off < fpath.data_len) {
+      goto corrupt;
+    }
+    findme.is_core = fpath.is_core;
+    bgpstream_as_path_populate_from_data_zc(&findme.path, store->map + off,
+                                            fpath.data_len);
+    off += fpath.data_len;
+    if (get_path_id(store, &findme, &id, 0) != 0) {
+      return -1;
+    }
+    if (id.path_hash != fpath.path_hash || id.path_id != fpath.path_id) {
+      goto corrupt;
+    }
+  }
+  if (off != store->map_len) {
+    goto corrupt;
+  }
+
+  return 0;
+
+corrupt:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Path store %s is corrupt", filename);
+  return -1;
+}
 
-  pathset = &kh_val(store->path_set, store->cur_pathset);
-  if (store->cur_path >= pathset->paths_cnt) {
-    /* move to the next pathset */
-    do {
-      store->cur_pathset++;
-    } while (store->cur_pathset < kh_end(store->path_set) &&
-             !kh_exist(store->path_set, store->cur_pathset));
-    store->cur_path = 0;
+/* move the iterator to the next path, skipping shards that have run out */
+static bgpstream_as_path_store_path_t *
+iter_next(struct bgpstream_as_path_store_iter *it, int advance)
+{
+  bgpstream_as_path_store_t *store = it->store;
+  bgpstream_as_path_store_path_t *spath = NULL;
+  shard_t *shard;
+
+  for (; it->shard < store->shards_cnt; it->shard++, it->path = 0) {
+    shard = &store->shards[it->shard];
+    shard_lock(store, shard);
+    if (it->path < shard->paths_cnt) {
+      spath = shard->paths[it->path];
+    }
+    shard_unlock(store, shard);
+    if (spath != NULL) {
+      it->path += advance;
+      return spath;
+    }
   }
+  return NULL;
+}
+
+void bgpstream_as_path_store_iter_first_path(bgpstream_as_path_store_t *store)
+{
+  bgpstream_as_path_store_iter_reset(&store->it);
+}
+
+void bgpstream_as_path_store_iter_next_path(bgpstream_as_path_store_t *store)
+{
+  /* moves on to the next shard if the current one has run out */
+  iter_next(&store->it, 0);
 }
 
 int bgpstream_as_path_store_iter_has_more_path(bgpstream_as_path_store_t *store)
 {
-  return (store->cur_pathset < kh_end(store->path_set)) &&
-         (store->cur_path <
-          kh_val(store->path_set, store->cur_pathset).paths_cnt);
+  return iter_next(&store->it, 0) != NULL;
 }
 
 bgpstream_as_path_store_path_t *
 bgpstream_as_path_store_iter_get_path(bgpstream_as_path_store_t *store)
 {
-  return &kh_val(store->path_set, store->cur_pathset).paths[store->cur_path++];
+  return iter_next(&store->it, 1);
 }
 
 bgpstream_as_path_store_path_id_t
 bgpstream_as_path_store_iter_get_path_id(bgpstream_as_path_store_t *store)
 {
-  bgpstream_as_path_store_path_id_t id;
-
-  id.path_hash = kh_key(store->path_set, store->cur_pathset);
-  id.path_id = store->cur_path;
+  bgpstream_as_path_store_path_t *spath = iter_next(&store->it, 0);
+  bgpstream_as_path_store_path_id_t id = {UINT32_MAX, UINT32_MAX};
 
+  if (spath != NULL) {
+    id = spath->id;
+  }
   return id;
 }
 
+bgpstream_as_path_store_iter_t *
+bgpstream_as_path_store_iter_create(bgpstream_as_path_store_t *store)
+{
+  bgpstream_as_path_store_iter_t *iter;
+
+  if ((iter = malloc(sizeof(bgpstream_as_path_store_iter_t))) == NULL) {
+    return NULL;
+  }
+  iter->store = store;
+  bgpstream_as_path_store_iter_reset(iter);
+  return iter;
+}
+
+void bgpstream_as_path_store_iter_destroy(bgpstream_as_path_store_iter_t *iter)
+{
+  free(iter);
+}
+
+void bgpstream_as_path_store_iter_reset(bgpstream_as_path_store_iter_t *iter)
+{
+  iter->shard = 0;
+  iter->path = 0;
+}
+
+bgpstream_as_path_store_path_t *
+bgpstream_as_path_store_iter_next(bgpstream_as_path_store_iter_t *iter,
+                                  bgpstream_as_path_store_path_id_t *id)
+{
+  bgpstream_as_path_store_path_t *spath = iter_next(iter, 1);
+
+  if (spath != NULL && id != NULL) {
+    *id = spath->id;
+  }
+  return spath;
+}
+
 bgpstream_as_path_store_path_t *
 bgpstream_as_path_store_get_store_path(bgpstream_as_path_store_t *store,
                                        bgpstream_as_path_store_path_id_t id)
 {
+  bgpstream_as_path_store_path_t *spath = NULL;
+  shard_t *shard;
+  pathset_t *ps;
   khiter_t k;
 
   /* special case for NULL path */
-  if (id.path_hash == UINT32_MAX && id.path_id == UINT16_MAX) {
+  if (id.path_hash == UINT32_MAX && id.path_id == UINT32_MAX) {
     return NULL;
   }
 
-  if ((k = kh_get(pathset, store->path_set, id.path_hash)) ==
-      kh_end(store->path_set)) {
-    return NULL;
-  }
-
-  if (id.path_id > kh_val(store->path_set, k).paths_cnt - 1) {
-    return NULL;
+  shard = get_shard(store, id.path_hash);
+  shard_lock(store, shard);
+  if ((k = kh_get(pathset, shard->path_set, id.path_hash)) !=
+      kh_end(shard->path_set)) {
+    ps = &kh_val(shard->path_set, k);
+    if (id.path_id < ps->paths_cnt) {
+      spath = ps->paths[id.path_id];
+    }
   }
+  shard_unlock(store, shard);
 
-  return &kh_val(store->path_set, k).paths[id.path_id];
+  return spath;
 }
 
 bgpstream_as_path_t *bgpstream_as_path_store_path_get_path(
@@ -398,9 +937,14 @@ bgpstream_as_path_t *bgpstream_as_path_store_path_get_path(
   /* otherwise, do some manual copying */
   bgpstream_as_path_clear(pc);
 
-  pc->data_alloc_len = pc->data_len =
+  pc->data_len =
     store_path->path.data_len + sizeof(bgpstream_as_path_seg_asn_t);
-  if ((pc->data = malloc(pc->data_len)) == NULL) {
+  if (pc->data_len <= BGPSTREAM_AS_PATH_INLINE_LEN) {
+    pc->data = pc->inline_data;
+    pc->data_alloc_len = BGPSTREAM_AS_PATH_INLINE_LEN;
+  } else if ((pc->data = malloc(pc->data_len)) != NULL) {
+    pc->data_alloc_len = pc->data_len;
+  } else {
     goto err;
   }
 
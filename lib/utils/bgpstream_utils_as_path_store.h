@@ -43,6 +43,9 @@
  *
  * @{ */
 
+/** log2 of the number of shards of a concurrent store */
+#define BGPSTREAM_AS_PATH_STORE_SHARDS_BITS 6
+
 /** @} */
 
 /**
@@ -63,6 +66,9 @@ typedef struct bgpstream_as_path_store bgpstream_as_path_store_t;
 /** Opaque pointer to an AS Path Store Path object */
 typedef struct bgpstream_as_path_store_path bgpstream_as_path_store_path_t;
 
+/** Opaque pointer to an iterator over the paths of an AS Path Store */
+typedef struct bgpstream_as_path_store_iter bgpstream_as_path_store_iter_t;
+
 /** @} */
 
 /**
@@ -80,7 +86,7 @@ typedef struct bgpstream_as_path_store_path_id {
   uint32_t path_hash;
 
   /** ID of the path within the origin pathset */
-  uint16_t path_id;
+  uint32_t path_id;
 
 } __attribute__((packed)) bgpstream_as_path_store_path_id_t;
 
@@ -111,6 +117,22 @@ typedef struct bgpstream_as_path_store_path_iter {
  */
 bgpstream_as_path_store_t *bgpstream_as_path_store_create(void);
 
+/** Create a new AS Path Store that can be used by several threads at once
+ *
+ * @return pointer to the created store if successful, NULL otherwise
+ *
+ * The origins are spread over 2^BGPSTREAM_AS_PATH_STORE_SHARDS_BITS shards,
+ * each with its own lock, so threads adding paths with different origins
+ * rarely wait for each other. All functions but the internal iterator ones
+ * (bgpstream_as_path_store_iter_first_path and friends) may then be called
+ * concurrently; use a bgpstream_as_path_store_iter_t per thread instead.
+ *
+ * A path gets its ID when it is first added, and keeps it: every thread that
+ * looks it up gets the same ID, and store paths never move, so the pointers
+ * returned for them stay valid until the store is destroyed.
+ */
+bgpstream_as_path_store_t *bgpstream_as_path_store_create_concurrent(void);
+
 /** Destroy the given AS Path Store
  *
  * @param store         pointer to the store to destroy
@@ -174,6 +196,36 @@ bgpstream_as_path_store_path_t *
 bgpstream_as_path_store_get_store_path(bgpstream_as_path_store_t *store,
                                        bgpstream_as_path_store_path_id_t id);
 
+/** Save the paths of the given store to a file
+ *
+ * @param store         pointer to the store to save
+ * @param filename      path of the file to write
+ * @return 0 if the store was saved successfully, -1 otherwise
+ *
+ * The file is written under a temporary name and then renamed, so readers
+ * never see a partial file. It holds each path with its ID, in host byte
+ * order. Paths added to a concurrent store while it is being saved may or
+ * may not be included.
+ */
+int bgpstream_as_path_store_save(bgpstream_as_path_store_t *store,
+                                 const char *filename);
+
+/** Load the paths of a store file into the given (empty) store
+ *
+ * @param store         pointer to the store to load the paths into
+ * @param filename      path of the file written by
+ *                      bgpstream_as_path_store_save
+ * @return 0 if the paths were loaded successfully, -1 otherwise
+ *
+ * Every path gets the same ID as it had in the saved store, so IDs can be
+ * shared between runs, and paths added afterwards get new IDs. The file is
+ * mapped rather than read, and the path data is not copied: it stays mapped
+ * until the store is destroyed. If loading fails the store may hold some of
+ * the paths, and should be destroyed.
+ */
+int bgpstream_as_path_store_load(bgpstream_as_path_store_t *store,
+                                 const char *filename);
+
 /** Reset the internal iterator to the first Path in the store
  *
  * @param store         pointer to the store
@@ -205,11 +257,47 @@ bgpstream_as_path_store_iter_get_path(bgpstream_as_path_store_t *store);
 /** Get the path ID of the current path from the iterator
  *
  * @param store         pointer to the store to get the current path ID from
- * @return path ID structure for the current path
+ * @return path ID structure for the path bgpstream_as_path_store_iter_get_path
+ * returns next (the ID of the empty path if there is none)
  */
 bgpstream_as_path_store_path_id_t
 bgpstream_as_path_store_iter_get_path_id(bgpstream_as_path_store_t *store);
 
+/** Create an iterator over the paths of a store
+ *
+ * @param store         pointer to the store to iterate over
+ * @return pointer to the iterator if successful, NULL otherwise
+ *
+ * Unlike the internal iterator, any number of these may be used at once, by
+ * different threads. Iterating over a concurrent store while paths are being
+ * added returns every path that was in the store when the iterator was reset,
+ * and possibly some of those that were added since.
+ */
+bgpstream_as_path_store_iter_t *
+bgpstream_as_path_store_iter_create(bgpstream_as_path_store_t *store);
+
+/** Destroy the given store iterator
+ *
+ * @param iter          pointer to the iterator to destroy
+ */
+void bgpstream_as_path_store_iter_destroy(bgpstream_as_path_store_iter_t *iter);
+
+/** Move the given iterator back to the first path of its store
+ *
+ * @param iter          pointer to the iterator
+ */
+void bgpstream_as_path_store_iter_reset(bgpstream_as_path_store_iter_t *iter);
+
+/** Get the next path from the given iterator
+ *
+ * @param iter          pointer to the iterator
+ * @param[out] id       if not NULL, set to the ID of the returned path
+ * @return borrowed pointer to the next path, NULL if there are no more
+ */
+bgpstream_as_path_store_path_t *
+bgpstream_as_path_store_iter_next(bgpstream_as_path_store_iter_t *iter,
+                                  bgpstream_as_path_store_path_id_t *id);
+
 /* STORE PATH FUNCTIONS */
 
 /** Convert the given store path to a native BGPStream AS Path
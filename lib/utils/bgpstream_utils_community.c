@@ -34,9 +34,18 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <stdio.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define COMMUNITY_MAX_STR_LEN 16
 
+/* sets smaller than this are scanned rather than indexed */
+#define COMMUNITY_SET_INDEX_MIN 16
+
+/* a community as a number that sorts by ASN, then value */
+#define COMMUNITY_KEY(c) (((uint32_t)(c)->asn << 16) | (c)->value)
+
 /** Set of community values */
 struct bgpstream_community_set {
 
@@ -52,6 +61,24 @@ struct bgpstream_community_set {
   /** Communities hash (OR between
    *  all communities in the set) */
   bgpstream_community_t communities_hash;
+
+  /** Array of large community values */
+  bgpstream_large_community_t *large_communities;
+
+  /** Number of large communities in the set */
+  int large_communities_cnt;
+
+  /** Number of large communities allocated in the set */
+  int large_communities_alloc_cnt;
+
+  /** Sorted COMMUNITY_KEY of each community, only valid if indexed is set */
+  uint32_t *sorted;
+
+  /** Number of keys allocated in the sorted array */
+  int sorted_alloc_cnt;
+
+  /** Whether the sorted array is up to date with the communities */
+  int indexed;
 };
 
 /* ========== PUBLIC FUNCTIONS ========== */
@@ -98,6 +125,88 @@ int bgpstream_str2community(const char *buf, bgpstream_community_t *comm)
   return (int)mask;
 }
 
+// parse one (possibly wildcard) part of a community string, returning a
+// pointer to the character after it, or NULL if it is invalid
+static const char *parse_part(const char *buf, unsigned long max,
+                              uint32_t *part, int *is_num)
+{
+  char *ptr;
+  unsigned long r;
+
+  if (*buf == '*') {
+    *part = 0;
+    *is_num = 0;
+    return buf + 1;
+  }
+  if (*buf < '0' || *buf > '9') {
+    return NULL;
+  }
+  errno = 0;
+  r = strtoul(buf, &ptr, 10);
+  if (errno || r > max) {
+    return NULL;
+  }
+  *part = (uint32_t)r;
+  *is_num = 1;
+  return ptr;
+}
+
+int bgpstream_large_community_snprintf(char *buf, size_t len,
+                                       const bgpstream_large_community_t *comm)
+{
+  return snprintf(buf, len, "%" PRIu32 ":%" PRIu32 ":%" PRIu32,
+                  comm->global_admin, comm->local_1, comm->local_2);
+}
+
+int bgpstream_str2large_community(const char *buf,
+                                  bgpstream_large_community_t *comm)
+{
+  static const uint8_t part_masks[] = {
+    BGPSTREAM_LARGE_COMMUNITY_FILTER_GLOBAL,
+    BGPSTREAM_LARGE_COMMUNITY_FILTER_LOCAL1,
+    BGPSTREAM_LARGE_COMMUNITY_FILTER_LOCAL2,
+  };
+  uint32_t *parts[3];
+  uint8_t mask = 0;
+  int is_num;
+  int i;
+
+  if (buf == NULL || comm == NULL) {
+    return -1;
+  }
+  parts[0] = &comm->global_admin;
+  parts[1] = &comm->local_1;
+  parts[2] = &comm->local_2;
+  for (i = 0; i < 3; i++) {
+    if (i > 0 && *(buf++) != ':') {
+      return -1;
+    }
+    if ((buf = parse_part(buf, UINT32_MAX, parts[i], &is_num)) == NULL) {
+      return -1;
+    }
+    if (is_num) {
+      mask |= part_masks[i];
+    }
+  }
+  if (*buf != '\0') {
+    return -1;
+  }
+  return (int)mask;
+}
+
+uint32_t bgpstream_large_community_hash_value(bgpstream_large_community_t comm)
+{
+  return comm.global_admin * 2654435761U ^ comm.local_1 * 40503U ^
+         comm.local_2;
+}
+
+int bgpstream_large_community_equal_value(bgpstream_large_community_t comm1,
+                                          bgpstream_large_community_t comm2)
+{
+  return comm1.global_admin == comm2.global_admin &&
+         comm1.local_1 == comm2.local_1 && comm1.local_2 == comm2.local_2;
+}
+
 bgpstream_community_t *bgpstream_community_dup(const bgpstream_community_t *src)
 {
   bgpstream_community_t *dst = NULL;
@@ -160,8 +269,21 @@ int bgpstream_community_set_snprintf(char *buf, size_t len,
       buf + written, len > written ? len - written : 0,
       bgpstream_community_set_get(set, i));
   }
+  for (i = 0; i < set->large_communities_cnt; i++) {
+    if (written > 0 || i > 0) {
+      if (written < len) {
+        buf[written] = ' ';
+      }
+      written++;
+    }
+    written += bgpstream_large_community_snprintf(
+      buf + written, len > written ? len - written : 0,
+      &set->large_communities[i]);
+  }
 
-  buf[(written < len) ? written : len - 1] = '\0';
+  if (len > 0) {
+    buf[(written < len) ? written : len - 1] = '\0';
+  }
   return written;
 }
 
@@ -176,10 +298,22 @@ bgpstream_community_set_t *bgpstream_community_set_create()
   return set;
 }
 
+/* forget the large communities of the set if they are not its own */
+static void drop_borrowed_large(bgpstream_community_set_t *set)
+{
+  if (set->large_communities_alloc_cnt < 0) {
+    set->large_communities = NULL;
+    set->large_communities_alloc_cnt = 0;
+  }
+  set->large_communities_cnt = 0;
+}
+
 void bgpstream_community_set_clear(bgpstream_community_set_t *set)
 {
   set->communities_cnt = 0;
   set->communities_hash.ui32 = 0;
+  drop_borrowed_large(set);
+  set->indexed = 0;
 }
 
 void bgpstream_community_set_destroy(bgpstream_community_set_t *set)
@@ -192,6 +326,10 @@ void bgpstream_community_set_destroy(bgpstream_community_set_t *set)
   set->communities_cnt = 0;
   set->communities_alloc_cnt = 0;
   set->communities_hash.ui32 = 0;
+  if (set->large_communities_alloc_cnt > 0) {
+    free(set->large_communities);
+  }
+  free(set->sorted);
 
   free(set);
 }
@@ -199,6 +337,8 @@ void bgpstream_community_set_destroy(bgpstream_community_set_t *set)
 int bgpstream_community_set_copy(bgpstream_community_set_t *dst,
                                  const bgpstream_community_set_t *src)
 {
+  int i;
+
   if (dst->communities_alloc_cnt < src->communities_cnt) {
     if ((dst->communities =
            realloc(dst->communities, sizeof(bgpstream_community_t) *
@@ -213,6 +353,15 @@ int bgpstream_community_set_copy(bgpstream_community_set_t *dst,
 
   dst->communities_cnt = src->communities_cnt;
   dst->communities_hash = src->communities_hash;
+  dst->indexed = 0;
+
+  dst->large_communities_cnt = 0;
+  for (i = 0; i < src->large_communities_cnt; i++) {
+    if (bgpstream_community_set_insert_large(dst,
+                                             &src->large_communities[i]) != 0) {
+      return -1;
+    }
+  }
 
   return 0;
 }
@@ -228,6 +377,17 @@ int bgpstream_community_set_size(const bgpstream_community_set_t *set)
   return set->communities_cnt;
 }
 
+const bgpstream_large_community_t *
+bgpstream_community_set_get_large(const bgpstream_community_set_t *set, int i)
+{
+  return (i < set->large_communities_cnt) ? &set->large_communities[i] : NULL;
+}
+
+int bgpstream_community_set_large_size(const bgpstream_community_set_t *set)
+{
+  return set->large_communities_cnt;
+}
+
 int bgpstream_community_set_insert(bgpstream_community_set_t *set,
                                    bgpstream_community_t *comm)
 {
@@ -243,6 +403,43 @@ int bgpstream_community_set_insert(bgpstream_community_set_t *set,
   set->communities[set->communities_cnt] = *comm;
   set->communities_cnt++;
   set->communities_hash.ui32 |= comm->ui32;
+  set->indexed = 0;
+  return 0;
+}
+
+int bgpstream_community_set_insert_large(
+  bgpstream_community_set_t *set, const bgpstream_large_community_t *comm)
+{
+  bgpstream_large_community_t *tmp;
+  int new_alloc;
+
+  if (set->large_communities_alloc_cnt < 0) {
+    /* the set borrows its large communities, so it needs a copy of its own */
+    new_alloc = set->large_communities_cnt < 2
+                  ? 4
+                  : set->large_communities_cnt * 2;
+    if ((tmp = malloc(sizeof(bgpstream_large_community_t) * new_alloc)) ==
+        NULL) {
+      return -1;
+    }
+    memcpy(tmp, set->large_communities,
+           sizeof(bgpstream_large_community_t) * set->large_communities_cnt);
+    set->large_communities = tmp;
+    set->large_communities_alloc_cnt = new_alloc;
+  } else if (set->large_communities_cnt == set->large_communities_alloc_cnt) {
+    new_alloc = set->large_communities_alloc_cnt == 0
+                  ? 4
+                  : set->large_communities_alloc_cnt * 2;
+    if ((tmp = realloc(set->large_communities,
+                       sizeof(bgpstream_large_community_t) * new_alloc)) ==
+        NULL) {
+      return -1;
+    }
+    set->large_communities = tmp;
+    set->large_communities_alloc_cnt = new_alloc;
+  }
+
+  set->large_communities[set->large_communities_cnt++] = *comm;
   return 0;
 }
 
@@ -251,6 +448,7 @@ int bgpstream_community_set_populate_from_array(bgpstream_community_set_t *set,
                                                 int comms_cnt)
 {
   bgpstream_community_set_t tmp;
+  memset(&tmp, 0, sizeof(tmp));
   if (bgpstream_community_set_populate_from_array_zc(&tmp, comms, comms_cnt) !=
       0) {
     return -1;
@@ -265,6 +463,8 @@ int bgpstream_community_set_populate_from_array_zc(
   set->communities = comms;
   set->communities_cnt = comms_cnt;
   set->communities_hash.ui32 = 0;
+  drop_borrowed_large(set);
+  set->indexed = 0;
   int i;
   for (i = 0; i < bgpstream_community_set_size(set); i++) {
     set->communities_hash.ui32 |= set->communities[i].ui32;
@@ -272,6 +472,19 @@ int bgpstream_community_set_populate_from_array_zc(
   return 0;
 }
 
+int bgpstream_community_set_populate_large_from_array_zc(
+  bgpstream_community_set_t *set, bgpstream_large_community_t *comms,
+  int comms_cnt)
+{
+  if (set->large_communities_alloc_cnt > 0) {
+    free(set->large_communities);
+  }
+  set->large_communities_alloc_cnt = -1; /* memory is not owned by us */
+  set->large_communities = comms;
+  set->large_communities_cnt = comms_cnt;
+  return 0;
+}
+
 uint32_t
 bgpstream_community_set_hash(const bgpstream_community_set_t *set)
 {
@@ -297,8 +510,15 @@ int bgpstream_community_set_equal(const bgpstream_community_set_t *set1,
 {
   return (set1->communities_hash.ui32 == set2->communities_hash.ui32) &&
          (set1->communities_cnt == set2->communities_cnt) &&
-         memcmp(set1->communities, set2->communities,
-              sizeof(bgpstream_community_t) * set1->communities_cnt);
+         (set1->large_communities_cnt == set2->large_communities_cnt) &&
+         (set1->communities_cnt == 0 ||
+          memcmp(set1->communities, set2->communities,
+                 sizeof(bgpstream_community_t) * set1->communities_cnt) ==
+            0) &&
+         (set1->large_communities_cnt == 0 ||
+          memcmp(set1->large_communities, set2->large_communities,
+                 sizeof(bgpstream_large_community_t) *
+                   set1->large_communities_cnt) == 0);
 }
 
 /* ========== PROTECTED FUNCTIONS ========== */
@@ -336,10 +556,95 @@ int bgpstream_community_set_populate(bgpstream_community_set_t *set,
   }
 
   set->communities_cnt = cnt;
+  set->indexed = 0;
+
+  return 0;
+}
+
+static int key_cmp(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+int bgpstream_community_set_index(bgpstream_community_set_t *set)
+{
+  uint32_t *tmp;
+  int i;
+
+  if (set->indexed != 0 || set->communities_cnt < COMMUNITY_SET_INDEX_MIN) {
+    return 0;
+  }
+
+  if (set->sorted_alloc_cnt < set->communities_cnt) {
+    if ((tmp = realloc(set->sorted, sizeof(uint32_t) * set->communities_cnt)) ==
+        NULL) {
+      return -1;
+    }
+    set->sorted = tmp;
+    set->sorted_alloc_cnt = set->communities_cnt;
+  }
+  for (i = 0; i < set->communities_cnt; i++) {
+    set->sorted[i] = COMMUNITY_KEY(&set->communities[i]);
+  }
+  qsort(set->sorted, set->communities_cnt, sizeof(uint32_t), key_cmp);
+  set->indexed = 1;
 
   return 0;
 }
 
+/* index of the first sorted key that is not less than key */
+static int lower_bound(const uint32_t *keys, int cnt, uint32_t key)
+{
+  const uint32_t *base = keys;
+  int half;
+
+  if (cnt == 0) {
+    return 0;
+  }
+  while (cnt > 1) {
+    half = cnt / 2;
+    base = (base[half] < key) ? base + half : base;
+    cnt -= half;
+  }
+  return (base - keys) + (*base < key);
+}
+
+/* look for a community whose masked fields equal those of com, comparing four
+   communities at a time where possible */
+static int scan_match(const bgpstream_community_set_t *set,
+                      const bgpstream_community_t *com, uint8_t mask)
+{
+  const bgpstream_community_t *comms = set->communities;
+  int n = set->communities_cnt;
+  bgpstream_community_t fields;
+  uint32_t needle;
+  int i = 0;
+
+  fields.asn = (mask & BGPSTREAM_COMMUNITY_FILTER_ASN) ? 0xFFFF : 0;
+  fields.value = (mask & BGPSTREAM_COMMUNITY_FILTER_VALUE) ? 0xFFFF : 0;
+  needle = com->ui32 & fields.ui32;
+
+#ifdef __SSE2__
+  __m128i vfields = _mm_set1_epi32((int)fields.ui32);
+  __m128i vneedle = _mm_set1_epi32((int)needle);
+  __m128i v;
+
+  for (; i + 4 <= n; i += 4) {
+    v = _mm_and_si128(_mm_loadu_si128((const __m128i *)&comms[i]), vfields);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(v, vneedle)) != 0) {
+      return 1;
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    if ((comms[i].ui32 & fields.ui32) == needle) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 int bgpstream_community_set_exists(const bgpstream_community_set_t *set,
                                    const bgpstream_community_t *com)
 {
@@ -351,32 +656,42 @@ int bgpstream_community_set_match(const bgpstream_community_set_t *set,
                                   const bgpstream_community_t *com, uint8_t mask)
 {
   const bgpstream_community_t *hash = &set->communities_hash;
+  uint32_t key = COMMUNITY_KEY(com);
+  int i;
 
   /* first we verify if the hash is compatible */
-  if ((!(mask & BGPSTREAM_COMMUNITY_FILTER_ASN) ||
-       (hash->asn & com->asn) == com->asn) &&
-      (!(mask & BGPSTREAM_COMMUNITY_FILTER_VALUE) ||
-       (hash->value & com->value) == com->value)) {
-    const bgpstream_community_t *c;
-    int i;
-    int n = bgpstream_community_set_size(set);
-    for (i = 0; i < n; i++) {
-      c = bgpstream_community_set_get(set, i);
-      /* checking if asn match is requested and compatible */
-      if (mask & BGPSTREAM_COMMUNITY_FILTER_ASN) {
-        if (c->asn != com->asn) {
-          continue;
-        }
-      }
-      /* checking if value match is requested and compatible */
-      if (mask & BGPSTREAM_COMMUNITY_FILTER_VALUE) {
-        if (c->value != com->value) {
-          continue;
-        }
-      }
+  if ((mask & BGPSTREAM_COMMUNITY_FILTER_ASN) &&
+      (hash->asn & com->asn) != com->asn) {
+    return 0;
+  }
+  if ((mask & BGPSTREAM_COMMUNITY_FILTER_VALUE) &&
+      (hash->value & com->value) != com->value) {
+    return 0;
+  }
 
-      return 1;
-    }
+  /* the sorted keys are grouped by ASN, so unless only the value is wanted
+     the match (if any) is where the key or ASN would be inserted */
+  if (set->indexed == 0 || !(mask & BGPSTREAM_COMMUNITY_FILTER_ASN)) {
+    return scan_match(set, com, mask);
   }
-  return 0;
+  if (mask & BGPSTREAM_COMMUNITY_FILTER_VALUE) {
+    i = lower_bound(set->sorted, set->communities_cnt, key);
+    return i < set->communities_cnt && set->sorted[i] == key;
+  }
+  i = lower_bound(set->sorted, set->communities_cnt, key & 0xFFFF0000);
+  return i < set->communities_cnt && (set->sorted[i] >> 16) == com->asn;
+}
+
+int bgpstream_community_set_match_bulk(const bgpstream_community_set_t *set,
+                                       const bgpstream_community_t *comms,
+                                       int comms_cnt, uint8_t mask,
+                                       uint8_t *matched)
+{
+  int i, cnt = 0;
+
+  for (i = 0; i < comms_cnt; i++) {
+    matched[i] = bgpstream_community_set_match(set, &comms[i], mask);
+    cnt += matched[i];
+  }
+  return cnt;
 }
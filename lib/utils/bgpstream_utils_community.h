@@ -66,6 +66,14 @@
 #define BGPSTREAM_COMMUNITY_FILTER_EXACT \
   (BGPSTREAM_COMMUNITY_FILTER_ASN | BGPSTREAM_COMMUNITY_FILTER_VALUE)
 
+#define BGPSTREAM_LARGE_COMMUNITY_FILTER_GLOBAL 0x04 ///< match the global admin
+#define BGPSTREAM_LARGE_COMMUNITY_FILTER_LOCAL1 0x02 ///< match local data part 1
+#define BGPSTREAM_LARGE_COMMUNITY_FILTER_LOCAL2 0x01 ///< match local data part 2
+#define BGPSTREAM_LARGE_COMMUNITY_FILTER_EXACT                                 \
+  (BGPSTREAM_LARGE_COMMUNITY_FILTER_GLOBAL |                                   \
+   BGPSTREAM_LARGE_COMMUNITY_FILTER_LOCAL1 |                                   \
+   BGPSTREAM_LARGE_COMMUNITY_FILTER_LOCAL2)
+
 /** @} */
 
 /**
@@ -96,6 +104,20 @@ typedef struct bgpstream_community {
 
 } __attribute__((packed)) bgpstream_community_t;
 
+/** Large community attribute value (see RFC 8092) */
+typedef struct bgpstream_large_community {
+
+  /** Global administrator (an ASN) */
+  uint32_t global_admin;
+
+  /** First local data part */
+  uint32_t local_1;
+
+  /** Second local data part */
+  uint32_t local_2;
+
+} bgpstream_large_community_t;
+
 /** @} */
 
 /**
@@ -180,6 +202,47 @@ int bgpstream_community_equal(const bgpstream_community_t *comm1,
 int bgpstream_community_equal_value(bgpstream_community_t comm1,
                                     bgpstream_community_t comm2);
 
+/** Write the string representation of the given large community into the
+ *  given character buffer.
+ * @param buf           pointer to a character buffer at least len bytes long
+ * @param len           length of the given character buffer
+ * @param comm          pointer to the large community value to convert
+ * @return the number of characters written given an infinite len (not including
+ * the trailing nul). If this value is greater than or equal to len, then the
+ * output was truncated.
+ */
+int bgpstream_large_community_snprintf(char *buf, size_t len,
+                                       const bgpstream_large_community_t *comm);
+
+/** Read the string representation of a large community in the form
+ * "<global>:<local1>:<local2>" from the buffer and populate the large community
+ * structure. Each part may be a number or a "*" wildcard, and wildcard parts
+ * are set to zero.
+ * @param buf           pointer to a character buffer at least len bytes long
+ * @param comm          pointer to the large community structure populate
+ * @return -1 if the operation failed, otherwise a bitwise-OR mask of zero or
+ * more of the #BGPSTREAM_LARGE_COMMUNITY_FILTER_GLOBAL,
+ * #BGPSTREAM_LARGE_COMMUNITY_FILTER_LOCAL1 and
+ * #BGPSTREAM_LARGE_COMMUNITY_FILTER_LOCAL2 values, one for each part that was
+ * a number
+ */
+int bgpstream_str2large_community(const char *buf,
+                                  bgpstream_large_community_t *comm);
+
+/** Hash the given large community into a 32bit number
+ * @param comm          large community to hash
+ * @return 32bit hash of the large community
+ */
+uint32_t bgpstream_large_community_hash_value(bgpstream_large_community_t comm);
+
+/** Compare two large communities for equality
+ * @param comm1         first large community to compare
+ * @param comm2         second large community to compare
+ * @return 0 if the communities are not equal, non-zero if they are equal
+ */
+int bgpstream_large_community_equal_value(bgpstream_large_community_t comm1,
+                                          bgpstream_large_community_t comm2);
+
 /** Write the string representation of the given community set into the given
  *  character buffer.
  *
@@ -189,6 +252,8 @@ int bgpstream_community_equal_value(bgpstream_community_t comm1,
  * @return the number of characters written given an infinite len (not including
  * the trailing nul). If this value is greater than or equal to len, then the
  * output was truncated.
+ *
+ * Large communities in the set are written after the regular ones.
  */
 int bgpstream_community_set_snprintf(char *buf, size_t len,
                                      const bgpstream_community_set_t *set);
@@ -244,6 +309,23 @@ bgpstream_community_set_get(const bgpstream_community_set_t *set, int i);
  */
 int bgpstream_community_set_size(const bgpstream_community_set_t *set);
 
+/** Get the large community value at the given index in the set
+ *
+ * @param set           pointer to the set to get the large community from
+ * @param i             index of the large community value to get
+ * @return **borrowed** pointer to the large community, NULL if index is out of
+ * bounds
+ */
+const bgpstream_large_community_t *
+bgpstream_community_set_get_large(const bgpstream_community_set_t *set, int i);
+
+/** Get the number of large communities in the set
+ *
+ * @param set           pointer to the set to get the large count of
+ * @return the number of large communities in the given set
+ */
+int bgpstream_community_set_large_size(const bgpstream_community_set_t *set);
+
 /** Insert the given community into the community set
  *
  * @param set           pointer to the set to populate
@@ -253,6 +335,15 @@ int bgpstream_community_set_size(const bgpstream_community_set_t *set);
 int bgpstream_community_set_insert(bgpstream_community_set_t *set,
                                    bgpstream_community_t *comm);
 
+/** Insert the given large community into the community set
+ *
+ * @param set           pointer to the set to populate
+ * @param comm          pointer to the large community
+ * @return 0 if the set was populated successfully, -1 otherwise
+ */
+int bgpstream_community_set_insert_large(
+  bgpstream_community_set_t *set, const bgpstream_large_community_t *comm);
+
 /** Populate the given community set from the given community array
  *
  * @param set           pointer to the set to populate
@@ -272,11 +363,28 @@ int bgpstream_community_set_populate_from_array(bgpstream_community_set_t *set,
  * @return 0 if the set was populated successfully, -1 otherwise
  *
  * @note this function **does not** copy the data into the set. The set is
- * only valid as long as the comms array passed to this function is valid.
+ * only valid as long as the comms array passed to this function is valid. Any
+ * large communities in the set are removed.
  */
 int bgpstream_community_set_populate_from_array_zc(
   bgpstream_community_set_t *set, bgpstream_community_t *comms, int comms_cnt);
 
+/** Populate the large communities of the given community set from the given
+ * large community array (Zero Copy)
+ * @param set           pointer to the set to populate
+ * @param comms         pointer to the large community array
+ * @param comms_cnt     number of large communities in the array
+ * @return 0 if the set was populated successfully, -1 otherwise
+ * @note this function **does not** copy the data into the set. The set is
+ * only valid as long as the comms array passed to this function is valid. The
+ * regular communities of the set are not changed, so this should be called
+ * after bgpstream_community_set_populate_from_array_zc (which removes the large
+ * communities).
+ */
+int bgpstream_community_set_populate_large_from_array_zc(
+  bgpstream_community_set_t *set, bgpstream_large_community_t *comms,
+  int comms_cnt);
+
 /** Hash the given community set into a 32bit number
  *
  * @param set           pointer to the community set to hash
@@ -319,6 +427,38 @@ int bgpstream_community_set_exists(const bgpstream_community_set_t *set,
 int bgpstream_community_set_match(const bgpstream_community_set_t *set,
                                   const bgpstream_community_t *com, uint8_t mask);
 
+/** Check many communities against a community set at once
+ *
+ * @param set          pointer to the community set to check
+ * @param comms        array of the communities to search for
+ * @param comms_cnt    number of communities in the array
+ * @param mask         it tells whether we check the entire community,
+ *                     the asn field or the value field
+ * @param matched      array of comms_cnt flags, each set to 1 if the
+ *                     corresponding community matches the set, 0 if not
+ * @return the number of communities that matched
+ *
+ * For large sets, calling bgpstream_community_set_index first makes this
+ * (and bgpstream_community_set_match) take a binary search per community.
+ */
+int bgpstream_community_set_match_bulk(const bgpstream_community_set_t *set,
+                                       const bgpstream_community_t *comms,
+                                       int comms_cnt, uint8_t mask,
+                                       uint8_t *matched);
+
+/** Build a sorted index of the communities in a set
+ *
+ * @param set          pointer to the community set to index
+ * @return 0 if the index was built (or is not needed), -1 otherwise
+ *
+ * Once indexed, matching the ASN (or the entire community) of a set is a
+ * binary search rather than a scan. The index is kept until the set is
+ * changed, so this should be called once the set is complete (e.g. once per
+ * elem). Sets of only a few communities are not indexed since scanning them
+ * is just as fast. Matching still works if building the index fails.
+ */
+int bgpstream_community_set_index(bgpstream_community_set_t *set);
+
 /** @} */
 
 #endif /* __BGPSTREAM_UTILS_COMMUNITY_H */
@@ -27,27 +27,79 @@
 #include <assert.h>
 #include <stdio.h>
 
-#include "khash.h"
 #include "utils.h"
 
 #include "bgpstream_utils_id_set.h"
+#include "bgpstream_utils_mphf_int.h"
+#include "bgpstream_utils_swiss_int.h"
 
 /* PRIVATE */
 
+#define ID_HASH_VAL(arg) ((uint64_t)(arg))
+#define ID_EQUAL_VAL(arg1, arg2) ((arg1) == (arg2))
+
+/* frozen sets of up to this many ids are searched as a sorted array */
+#define FROZEN_SMALL_MAX 32
+
 /** set of unique ids
  *  this structure maintains a set of unique
  *  ids (using a uint32 type)
  */
-KHASH_INIT(bgpstream_id_set /* name */, uint32_t /* khkey_t */,
-           char /* khval_t */, 0 /* kh_is_set */,
-           kh_int_hash_func /*__hash_func */,
-           kh_int_hash_equal /* __hash_equal */)
+BS_SWISS_SET_INIT(bgpstream_id_set /* name */, uint32_t /* key_t */,
+                  ID_HASH_VAL /* hash_func */, ID_EQUAL_VAL /* equal_func */)
 
 struct bgpstream_id_set {
-  khiter_t k;
-  khash_t(bgpstream_id_set) * hash;
+  uint32_t k;
+  bs_swiss_bgpstream_id_set_t hash;
+
+  /* lookup table built by bgpstream_id_set_freeze, used until the set is
+     modified: the ids either sorted (small sets) or in the slots of a
+     perfect hash function (mphf.disp is NULL for small sets) */
+  int frozen;
+  uint32_t *frozen_ids;
+  uint32_t frozen_cnt;
+  bs_mphf_t mphf;
 };
 
+static void thaw(bgpstream_id_set_t *set)
+{
+  if (set->frozen == 0) {
+    return;
+  }
+  free(set->frozen_ids);
+  set->frozen_ids = NULL;
+  set->frozen_cnt = 0;
+  bs_mphf_destroy(&set->mphf);
+  set->frozen = 0;
+}
+
+static int id_cmp(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static inline int frozen_exists(bgpstream_id_set_t *set, uint32_t id)
+{
+  const uint32_t *base = set->frozen_ids;
+  uint32_t len = set->frozen_cnt, half;
+
+  if (set->mphf.disp != NULL) {
+    return set->frozen_ids[bs_mphf_slot(&set->mphf, id)] == id;
+  }
+  if (len == 0) {
+    return 0;
+  }
+  // branchless search for the last id that is not larger than the one we
+  // are looking for
+  while (len > 1) {
+    half = len / 2;
+    base += (base[half] <= id) ? half : 0;
+    len -= half;
+  }
+  return *base == id;
+}
+
 /* PUBLIC FUNCTIONS */
 
 bgpstream_id_set_t *bgpstream_id_set_create()
@@ -59,41 +111,70 @@ bgpstream_id_set_t *bgpstream_id_set_create()
     return NULL;
   }
 
-  if ((set->hash = kh_init(bgpstream_id_set)) == NULL) {
-    bgpstream_id_set_destroy(set);
-    return NULL;
-  }
+  bs_swiss_bgpstream_id_set_init(&set->hash);
+  set->frozen = 0;
+  set->frozen_ids = NULL;
+  set->frozen_cnt = 0;
+  memset(&set->mphf, 0, sizeof(set->mphf));
   bgpstream_id_set_rewind(set);
   return set;
 }
 
 int bgpstream_id_set_insert(bgpstream_id_set_t *set, uint32_t id)
 {
-  int khret;
-  khiter_t k;
-  if ((k = kh_get(bgpstream_id_set, set->hash, id)) == kh_end(set->hash)) {
-    k = kh_put(bgpstream_id_set, set->hash, id, &khret);
-    return 1;
+  thaw(set);
+  return bs_swiss_bgpstream_id_set_put(&set->hash, id);
+}
+
+int bgpstream_id_set_insert_bulk(bgpstream_id_set_t *set, const uint32_t *ids,
+                                 int ids_cnt)
+{
+  uint64_t want = (uint64_t)bs_swiss_size(&set->hash) + ids_cnt;
+  uint32_t cap = set->hash.cap;
+  int i, rc, inserted = 0;
+
+  thaw(set);
+
+  // grow the table once, rather than doubling it over and over
+  if (want > set->hash.growth_left + bs_swiss_size(&set->hash)) {
+    if (cap == 0) {
+      cap = BS_SWISS_GROUP_SIZE;
+    }
+    while ((uint64_t)cap - cap / 8 < want && cap < (UINT32_C(1) << 31)) {
+      cap *= 2;
+    }
+    if (bs_swiss_bgpstream_id_set_resize(&set->hash, cap) != 0) {
+      return -1;
+    }
   }
-  return 0;
+
+  for (i = 0; i < ids_cnt; i++) {
+    if ((rc = bs_swiss_bgpstream_id_set_put(&set->hash, ids[i])) < 0) {
+      return -1;
+    }
+    inserted += rc;
+  }
+  return inserted;
 }
 
 int bgpstream_id_set_exists(bgpstream_id_set_t *set, uint32_t id)
 {
-  khiter_t k;
-  if ((k = kh_get(bgpstream_id_set, set->hash, id)) == kh_end(set->hash)) {
-    return 0;
+  if (set->frozen != 0) {
+    return frozen_exists(set, id);
   }
-  return 1;
+  return bs_swiss_bgpstream_id_set_get(&set->hash, id) !=
+         bs_swiss_end(&set->hash);
 }
 
 int bgpstream_id_set_merge(bgpstream_id_set_t *dst_set,
                            bgpstream_id_set_t *src_set)
 {
-  khiter_t k;
-  for (k = kh_begin(src_set->hash); k != kh_end(src_set->hash); ++k) {
-    if (kh_exist(src_set->hash, k)) {
-      if (bgpstream_id_set_insert(dst_set, kh_key(src_set->hash, k)) < 0) {
+  uint32_t k;
+  for (k = bs_swiss_begin(&src_set->hash); k != bs_swiss_end(&src_set->hash);
+       ++k) {
+    if (BS_SWISS_FULL(&src_set->hash, k)) {
+      if (bgpstream_id_set_insert(dst_set,
+                                  bs_swiss_key(&src_set->hash, k)) < 0) {
         return -1;
       }
     }
@@ -105,15 +186,15 @@ int bgpstream_id_set_merge(bgpstream_id_set_t *dst_set,
 
 void bgpstream_id_set_rewind(bgpstream_id_set_t *set)
 {
-  set->k = kh_begin(set->hash);
+  set->k = bs_swiss_begin(&set->hash);
 }
 
 uint32_t *bgpstream_id_set_next(bgpstream_id_set_t *set)
 {
   uint32_t *v = NULL;
-  for (; set->k != kh_end(set->hash); ++set->k) {
-    if (kh_exist(set->hash, set->k)) {
-      v = &kh_key(set->hash, set->k);
+  for (; set->k != bs_swiss_end(&set->hash); ++set->k) {
+    if (BS_SWISS_FULL(&set->hash, set->k)) {
+      v = &bs_swiss_key(&set->hash, set->k);
       set->k++;
       return v;
     }
@@ -123,17 +204,71 @@ uint32_t *bgpstream_id_set_next(bgpstream_id_set_t *set)
 
 int bgpstream_id_set_size(bgpstream_id_set_t *set)
 {
-  return kh_size(set->hash);
+  return bs_swiss_size(&set->hash);
+}
+
+int bgpstream_id_set_freeze(bgpstream_id_set_t *set)
+{
+  uint64_t *hashes = NULL;
+  uint32_t *ids = NULL;
+  uint32_t k, i = 0;
+  int rc;
+
+  thaw(set);
+  if ((ids = malloc(sizeof(uint32_t) * (bs_swiss_size(&set->hash) + 1))) ==
+      NULL) {
+    goto err;
+  }
+  for (k = bs_swiss_begin(&set->hash); k != bs_swiss_end(&set->hash); ++k) {
+    if (BS_SWISS_FULL(&set->hash, k)) {
+      ids[i++] = bs_swiss_key(&set->hash, k);
+    }
+  }
+
+  if (i > FROZEN_SMALL_MAX) {
+    if ((hashes = malloc(sizeof(uint64_t) * i)) == NULL) {
+      goto err;
+    }
+    for (k = 0; k < i; k++) {
+      hashes[k] = ids[k];
+    }
+    if ((rc = bs_mphf_build(&set->mphf, hashes, i)) < 0) {
+      goto err;
+    }
+    // ids are distinct, so the function can always be built, but should
+    // it not be, the sorted array still works
+    if (rc == 0) {
+      for (k = 0; k < i; k++) {
+        ids[bs_mphf_slot(&set->mphf, hashes[k])] = (uint32_t)hashes[k];
+      }
+    }
+    free(hashes);
+  }
+  if (set->mphf.disp == NULL) {
+    qsort(ids, i, sizeof(uint32_t), id_cmp);
+  }
+
+  set->frozen_ids = ids;
+  set->frozen_cnt = i;
+  set->frozen = 1;
+  return 0;
+
+err:
+  free(hashes);
+  free(ids);
+  return -1;
 }
 
 void bgpstream_id_set_destroy(bgpstream_id_set_t *set)
 {
-  kh_destroy(bgpstream_id_set, set->hash);
+  thaw(set);
+  bs_swiss_bgpstream_id_set_destroy(&set->hash);
   free(set);
 }
 
 void bgpstream_id_set_clear(bgpstream_id_set_t *set)
 {
+  thaw(set);
   bgpstream_id_set_rewind(set);
-  kh_clear(bgpstream_id_set, set->hash);
+  bs_swiss_bgpstream_id_set_clear(&set->hash);
 }
@@ -66,6 +66,19 @@ bgpstream_id_set_t *bgpstream_id_set_create(void);
  */
 int bgpstream_id_set_insert(bgpstream_id_set_t *set, uint32_t id);
 
+/** Insert many IDs into the given set at once
+ *
+ * @param set           pointer to the id set
+ * @param ids           array of ids to insert (which may contain duplicates)
+ * @param ids_cnt       number of ids in the array
+ * @return the number of ids that were inserted (i.e., that were not already in
+ * the set), -1 if an error occurred
+ *
+ * The set is grown to its final size once, rather than step by step.
+ */
+int bgpstream_id_set_insert_bulk(bgpstream_id_set_t *set, const uint32_t *ids,
+                                 int ids_cnt);
+
 /** Check whether an ID exists in the set
  *
  * @param set           pointer to the ID set
@@ -105,6 +118,18 @@ void bgpstream_id_set_rewind(bgpstream_id_set_t *set);
  */
 uint32_t *bgpstream_id_set_next(bgpstream_id_set_t *set);
 
+/** Freeze the ID set for faster lookups
+ *
+ * Builds a read-only lookup table (a sorted array for small sets, a minimal
+ * perfect hash otherwise) that bgpstream_id_set_exists uses until the set is
+ * next modified, which drops the table again. Meant for sets that are built
+ * once and then only queried, like filters.
+ *
+ * @param set           pointer to the ID set
+ * @return 0 if the set was frozen successfully, -1 otherwise
+ */
+int bgpstream_id_set_freeze(bgpstream_id_set_t *set);
+
 /** Destroy the given ID set
  *
  * @param set           pointer to the ID set to destroy
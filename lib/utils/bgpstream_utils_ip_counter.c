@@ -33,12 +33,14 @@
 #include <stdio.h>
 #include <string.h>
 
-/* static char buffer[INET6_ADDRSTRLEN]; */
+/* Intervals added since the last compaction are appended, unsorted, after the
+ * sorted ones. They are merged in when the counter is queried, or when there
+ * are more of them than COMPACT_MIN and the sorted intervals. */
+#define COMPACT_MIN 1024
 
 typedef struct struct_v4pfx_int_t {
   uint32_t start;
   uint32_t end;
-  struct struct_v4pfx_int_t *next;
 } v4pfx_int_t;
 
 typedef struct struct_v6pfx_int_t {
@@ -46,253 +48,209 @@ typedef struct struct_v6pfx_int_t {
   uint64_t start_ls;
   uint64_t end_ms;
   uint64_t end_ls;
-  struct struct_v6pfx_int_t *next;
 } v6pfx_int_t;
 
-/* IP Counter Linked List */
+/* Sorted array of disjoint intervals, followed by pending (unsorted) ones */
+#define INT_ARRAY(type)                                                        \
+  struct {                                                                     \
+    type *ints;                                                                \
+    size_t sorted_cnt;                                                         \
+    size_t cnt;                                                                \
+    size_t alloc;                                                              \
+  }
+
+/* IP Counter interval arrays */
 struct bgpstream_ip_counter {
-  v4pfx_int_t *v4list;
-  v6pfx_int_t *v6list;
+  INT_ARRAY(v4pfx_int_t) v4;
+  INT_ARRAY(v6pfx_int_t) v6;
 };
 
-/* static void */
-/* print_pfx_int_list(bgpstream_ip_counter_t *ipc) */
-/*  {  */
-/*    v4pfx_int_t *current4 = ipc->v4list; */
-/*    bgpstream_ipv4_addr_t ip4; */
-
-/*    ip4.version = BGPSTREAM_ADDR_VERSION_IPV4;  */
-/*    while(current4 != NULL)  */
-/*      {  */
-/*        ip4.addr.s_addr = htonl(current4->start);  */
-/*        bgpstream_addr_ntop(buffer, INET_ADDRSTRLEN, &ip4);  */
-/*        printf("IP space:\t%s\t", buffer);  */
-/*        ip4.addr.s_addr = htonl(current4->end);  */
-/*        bgpstream_addr_ntop(buffer, INET_ADDRSTRLEN, &ip4);  */
-/*        printf("%s\n", buffer);  */
-/*        current4 = current4->next;  */
-/*      } */
-
-/*    v6pfx_int_t *current6 = ipc->v6list;  */
-/*    bgpstream_ipv6_addr_t ip6; */
-/*    uint64_t tmp; */
-/*    ip6.version = BGPSTREAM_ADDR_VERSION_IPV6; */
-
-/*    while(current6 != NULL)  */
-/*      { */
-/*        tmp = htonll(current6->start_ms); */
-/*        memcpy(&ip6.addr.s6_addr[0], &tmp, sizeof(uint64_t)); */
-/*        tmp = htonll(current6->start_ls); */
-/*        memcpy(&ip6.addr.s6_addr[8], &tmp, sizeof(uint64_t)); */
-/*        bgpstream_addr_ntop(buffer, INET6_ADDRSTRLEN, &ip6);  */
-/*        printf("IP space:\t%s\t", buffer); */
-/*        tmp = htonll(current6->end_ms); */
-/*        memcpy(&ip6.addr.s6_addr[0], &tmp, sizeof(uint64_t)); */
-/*        tmp = htonll(current6->end_ls); */
-/*        memcpy(&ip6.addr.s6_addr[8],&tmp, sizeof(uint64_t)); */
-/*        bgpstream_addr_ntop(buffer, INET6_ADDRSTRLEN, &ip6);  */
-/*        printf("%s\n", buffer); */
-/*        current6 = current6->next;  */
-/*      } */
-/*  }  */
-
-static void one_step_merge4(v4pfx_int_t *pil)
+/* a <= b, for 128 bit values split in most and least significant halves */
+#define LE128(a_ms, a_ls, b_ms, b_ls)                                          \
+  ((a_ms) < (b_ms) || ((a_ms) == (b_ms) && (a_ls) <= (b_ls)))
+
+static int v4_int_cmp(const void *a, const void *b)
 {
-  v4pfx_int_t *current = pil;
-  v4pfx_int_t *previous = pil;
-  if (current->next == NULL) {
-    return;
+  const v4pfx_int_t *ia = a, *ib = b;
+  return (ia->start > ib->start) - (ia->start < ib->start);
+}
+
+static int v6_int_cmp(const void *a, const void *b)
+{
+  const v6pfx_int_t *ia = a, *ib = b;
+  if (ia->start_ms != ib->start_ms) {
+    return ia->start_ms < ib->start_ms ? -1 : 1;
+  }
+  return (ia->start_ls > ib->start_ls) - (ia->start_ls < ib->start_ls);
+}
+
+static void pfx4_interval(const bgpstream_ipv4_pfx_t *pfx, v4pfx_int_t *i)
+{
+  uint32_t mask = ~(((uint64_t)1 << (32 - pfx->mask_len)) - 1);
+
+  i->start = ntohl(pfx->address.addr.s_addr) & mask;
+  i->end = i->start | (~mask);
+}
+
+static void pfx6_interval(const bgpstream_ipv6_pfx_t *pfx, v6pfx_int_t *i)
+{
+  uint64_t mask_ms;
+  uint64_t mask_ls;
+
+  if (pfx->mask_len > 64) {
+    mask_ms = ~((uint64_t)0);
+    mask_ls = ~(((uint64_t)1 << (64 - (pfx->mask_len - 64))) - 1);
+  } else if (pfx->mask_len > 0) {
+    mask_ms = ~(((uint64_t)1 << (64 - pfx->mask_len)) - 1);
+    mask_ls = 0;
+  } else {
+    mask_ms = 0;
+    mask_ls = 0;
+  }
+  i->start_ms = nptohll(&pfx->address.addr.s6_addr[0]) & mask_ms;
+  i->end_ms = i->start_ms | (~mask_ms);
+  i->start_ls = nptohll(&pfx->address.addr.s6_addr[8]) & mask_ls;
+  i->end_ls = i->start_ls | (~mask_ls);
+}
+
+/* grow an interval array to hold at least need intervals */
+#define INT_ARRAY_RESERVE(a, need)                                             \
+  int_array_reserve((void **)&(a)->ints, &(a)->alloc, (need),                  \
+                    sizeof(*(a)->ints))
+
+static int int_array_reserve(void **ints, size_t *alloc, size_t need,
+                             size_t sz)
+{
+  size_t new_alloc = *alloc == 0 ? 64 : *alloc;
+  void *tmp;
+
+  if (need <= *alloc) {
+    return 0;
+  }
+  while (new_alloc < need) {
+    new_alloc *= 2;
   }
-  current = current->next;
+  if ((tmp = realloc(*ints, new_alloc * sz)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "can't grow IP counter intervals");
+    return -1;
+  }
+  *ints = tmp;
+  *alloc = new_alloc;
+  return 0;
+}
 
-  while (current != NULL) {
-    if (current->start <= previous->end) {
-      if (current->end > previous->end) {
-        previous->end = current->end;
+/* Merge the pending intervals into the sorted ones. Intervals that overlap
+ * are merged, adjacent ones are kept apart. */
+static void compact4(bgpstream_ip_counter_t *ipc)
+{
+  v4pfx_int_t *ints = ipc->v4.ints;
+  size_t i, n = 0;
+
+  if (ipc->v4.sorted_cnt == ipc->v4.cnt) {
+    return;
+  }
+  qsort(ints, ipc->v4.cnt, sizeof(v4pfx_int_t), v4_int_cmp);
+  for (i = 0; i < ipc->v4.cnt; i++) {
+    if (n > 0 && ints[i].start <= ints[n - 1].end) {
+      if (ints[i].end > ints[n - 1].end) {
+        ints[n - 1].end = ints[i].end;
       }
-      previous->next = current->next;
-      free(current);
-      current = previous->next;
     } else {
-      break;
+      ints[n++] = ints[i];
     }
   }
+  ipc->v4.sorted_cnt = ipc->v4.cnt = n;
 }
 
-static void one_step_merge6(v6pfx_int_t *pil)
+static void compact6(bgpstream_ip_counter_t *ipc)
 {
-  v6pfx_int_t *current = pil;
-  v6pfx_int_t *previous = pil;
-  if (current->next == NULL) {
+  v6pfx_int_t *ints = ipc->v6.ints;
+  size_t i, n = 0;
+
+  if (ipc->v6.sorted_cnt == ipc->v6.cnt) {
     return;
   }
-  current = current->next;
-
-  while (current != NULL) {
-
-    /* current->start <= previous->end */
-    if (current->start_ms < previous->end_ms ||
-        (current->start_ms == previous->end_ms &&
-         current->start_ls <= previous->end_ls)) {
-      /* current->end > previous->end */
-      if (current->end_ms > previous->end_ms ||
-          (current->end_ms == previous->end_ms &&
-           current->end_ls > previous->end_ls)) {
-        previous->end_ms = current->end_ms;
-        previous->end_ls = current->end_ls;
+  qsort(ints, ipc->v6.cnt, sizeof(v6pfx_int_t), v6_int_cmp);
+  for (i = 0; i < ipc->v6.cnt; i++) {
+    if (n > 0 && LE128(ints[i].start_ms, ints[i].start_ls, ints[n - 1].end_ms,
+                       ints[n - 1].end_ls)) {
+      if (!LE128(ints[i].end_ms, ints[i].end_ls, ints[n - 1].end_ms,
+                 ints[n - 1].end_ls)) {
+        ints[n - 1].end_ms = ints[i].end_ms;
+        ints[n - 1].end_ls = ints[i].end_ls;
       }
-      previous->next = current->next;
-      free(current);
-      current = previous->next;
     } else {
-      break;
+      ints[n++] = ints[i];
     }
   }
+  ipc->v6.sorted_cnt = ipc->v6.cnt = n;
 }
 
-static int merge_in_sorted_queue4(v4pfx_int_t **pil, uint32_t start,
-                                  uint32_t end)
+/* index of the first sorted interval that ends at or after the given
+ * address */
+static size_t find4(bgpstream_ip_counter_t *ipc, uint32_t start)
 {
-  // create new v4pfx_int_t
-  v4pfx_int_t *p = NULL;
-  v4pfx_int_t *previous = *pil;
-  v4pfx_int_t *current = *pil;
-
-  while (current != NULL) {
-    if (start > current->end) {
-      previous = current;
-      current = current->next;
-      continue;
-    }
-    if (end < current->start) {
-      /* found a position where to insert  */
-      if ((p = (v4pfx_int_t *)malloc_zero(sizeof(v4pfx_int_t))) == NULL) {
-        bgpstream_log(BGPSTREAM_LOG_ERR,
-                      "can't malloc v4pfx_int_t structure");
-        return -1;
-      }
-      p->start = start;
-      p->end = end;
-      p->next = NULL;
-      if (previous != current) {
-        previous->next = p;
-      } else {
-        *pil = p;
-      }
-      p->next = current;
-      return 0;
-    }
-    /* At this point S <= cE and E >= cS
-     * so we can merge them */
-    if (current->start > start) {
-      current->start = start;
-    }
-    if (current->end < end) {
-      current->end = end;
+  size_t lo = 0, hi = ipc->v4.sorted_cnt, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (ipc->v4.ints[mid].end < start) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
     }
-    /* Now check from here on if there are other things
-     * to merge */
-    one_step_merge4(current);
-    return 0;
   }
+  return lo;
+}
 
-  /*   if here we didn't find a place where to insert the
-   * interval, it is either the first position or the last */
-  if ((p = (v4pfx_int_t *)malloc_zero(sizeof(v4pfx_int_t))) == NULL) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "can't malloc v4pfx_int_t structure");
-    return -1;
-  }
-  p->start = start;
-  p->end = end;
-  p->next = NULL;
-  /* adding at the beginning of the queue */
-  if (previous == current) {
-    *pil = p;
-    return 0;
+static size_t find6(bgpstream_ip_counter_t *ipc, uint64_t start_ms,
+                    uint64_t start_ls)
+{
+  size_t lo = 0, hi = ipc->v6.sorted_cnt, mid;
+  const v6pfx_int_t *cur;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    cur = &ipc->v6.ints[mid];
+    if (!LE128(start_ms, start_ls, cur->end_ms, cur->end_ls)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
   }
-  // adding at the end of the queue
-  previous->next = p;
-  return 0;
+  return lo;
 }
 
-static int merge_in_sorted_queue6(v6pfx_int_t **pil, uint64_t start_ms,
-                                  uint64_t start_ls, uint64_t end_ms,
-                                  uint64_t end_ls)
+static int add_pfx(bgpstream_ip_counter_t *ipc, const bgpstream_pfx_t *pfx)
 {
-  // create new v4pfx_int_t
-  v6pfx_int_t *p = NULL;
-  v6pfx_int_t *previous = *pil;
-  v6pfx_int_t *current = *pil;
-
-  while (current != NULL) {
-    /* start > current->end */
-    if (start_ms > current->end_ms ||
-        (start_ms == current->end_ms && start_ls > current->end_ls)) {
-      previous = current;
-      current = current->next;
-      continue;
-    }
-    /* end < current->start */
-    if (end_ms < current->start_ms ||
-        (end_ms == current->start_ms && end_ls < current->start_ls)) {
-      /* found a position where to insert  */
-      if ((p = (v6pfx_int_t *)malloc_zero(sizeof(v6pfx_int_t))) == NULL) {
-        bgpstream_log(BGPSTREAM_LOG_ERR,
-                      "can't malloc v6pfx_int_t structure");
-        return -1;
-      }
-      p->start_ms = start_ms;
-      p->start_ls = start_ls;
-      p->end_ms = end_ms;
-      p->end_ls = end_ls;
-      p->next = NULL;
-      if (previous != current) {
-        previous->next = p;
-      } else {
-        *pil = p;
-      }
-      p->next = current;
-      return 0;
-    }
-    /* At this point S <= cE and E >= cS
-     * so we can merge them */
-    /* current->start > start */
-    if (current->start_ms > start_ms ||
-        (current->start_ms == start_ms && current->start_ls > start_ls)) {
-      current->start_ms = start_ms;
-      current->start_ls = start_ls;
+  if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
+    if (INT_ARRAY_RESERVE(&ipc->v4, ipc->v4.cnt + 1) != 0) {
+      return -1;
     }
-    /* current->end < end */
-    if (current->end_ms < end_ms ||
-        (current->end_ms == end_ms && current->end_ls < end_ls)) {
-      current->end_ms = end_ms;
-      current->end_ls = end_ls;
+    pfx4_interval(&pfx->bs_ipv4, &ipc->v4.ints[ipc->v4.cnt++]);
+  } else if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV6) {
+    if (INT_ARRAY_RESERVE(&ipc->v6, ipc->v6.cnt + 1) != 0) {
+      return -1;
     }
-    /* Now check from here on if there are other things
-     * to merge */
-    one_step_merge6(current);
-    return 0;
+    pfx6_interval(&pfx->bs_ipv6, &ipc->v6.ints[ipc->v6.cnt++]);
   }
+  return 0;
+}
 
-  /*   if here we didn't find a place where to insert the
-   * interval, it is either the first position or the last */
-  if ((p = (v6pfx_int_t *)malloc_zero(sizeof(v6pfx_int_t))) == NULL) {
-    bgpstream_log(BGPSTREAM_LOG_ERR, "can't malloc v6pfx_int_t structure");
-    return -1;
+/* keep the pending intervals from using much more memory than the merged
+ * ones */
+static void maybe_compact(bgpstream_ip_counter_t *ipc)
+{
+  size_t pending;
+
+  pending = ipc->v4.cnt - ipc->v4.sorted_cnt;
+  if (pending > COMPACT_MIN && pending > ipc->v4.sorted_cnt) {
+    compact4(ipc);
   }
-  p->start_ms = start_ms;
-  p->start_ls = start_ls;
-  p->end_ms = end_ms;
-  p->end_ls = end_ls;
-  p->next = NULL;
-  /* adding at the beginning of the queue */
-  if (previous == current) {
-    *pil = p;
-    return 0;
+  pending = ipc->v6.cnt - ipc->v6.sorted_cnt;
+  if (pending > COMPACT_MIN && pending > ipc->v6.sorted_cnt) {
+    compact6(ipc);
   }
-  // adding at the end of the queue
-  previous->next = p;
-  return 0;
 }
 
 bgpstream_ip_counter_t *bgpstream_ip_counter_create()
@@ -304,224 +262,108 @@ bgpstream_ip_counter_t *bgpstream_ip_counter_create()
                   "can't malloc bgpstream_ip_counter_t structure");
     return NULL;
   }
-  ipc->v4list = NULL;
-  ipc->v6list = NULL;
   return ipc;
 }
 
 int bgpstream_ip_counter_add(bgpstream_ip_counter_t *ipc, bgpstream_pfx_t *pfx)
 {
-  uint32_t start;
-  uint32_t end;
-  uint32_t mask;
-  unsigned char *tmp;
-  uint64_t start_ms = 0;
-  uint64_t start_ls = 0;
-  uint64_t end_ms = 0;
-  uint64_t end_ls = 0;
-  uint64_t mask_ms;
-  uint64_t mask_ls;
-
-  if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
-    mask = ~(((uint64_t)1 << (32 - pfx->mask_len)) - 1);
-    start = ntohl(pfx->address.bs_ipv4.addr.s_addr);
-    start = start & mask;
-    end = start | (~mask);
-    return merge_in_sorted_queue4(&ipc->v4list, start, end);
-  } else {
-    if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV6) {
-      tmp = &pfx->address.bs_ipv6.addr.s6_addr[0];
-      start_ms = nptohll(tmp);
-      tmp = &pfx->address.bs_ipv6.addr.s6_addr[8];
-      start_ls = nptohll(tmp);
-      /* printf("+++++++++  %"PRIu64" %"PRIu64"\n", start_ms, start_ls); */
-      if (pfx->mask_len > 64) {
-        /* len_ms = 0 */
-        mask_ms = ~((uint64_t)0);
-        /* len_ls = 64 - (pfx->mask_len - 64); */
-        mask_ls = ~(((uint64_t)1 << (64 - (pfx->mask_len - 64))) - 1);
-      } else {
-        /* len_ms = 64 - pfx->mask_len; */
-        mask_ms = ~(((uint64_t)1 << (64 - pfx->mask_len)) - 1);
-        /* len_ls = 64; */
-        /* mask_ls = ~( ((uint64_t)1 << 64) - 1); */
-        mask_ls = 0;
-      }
-
-      /* printf("MASKS:  %"PRIu64" %"PRIu64"\n", mask_ms, mask_ls); */
-
-      /* most significant */
-      start_ms = start_ms & mask_ms;
-      end_ms = start_ms | (~mask_ms);
-      /* printf("MS:  %"PRIu64" %"PRIu64"\n", start_ms, end_ms); */
+  if (add_pfx(ipc, pfx) != 0) {
+    return -1;
+  }
+  maybe_compact(ipc);
+  return 0;
+}
 
-      /* least significant */
-      start_ls = start_ls & mask_ls;
-      end_ls = start_ls | (~mask_ls);
-      /* printf("LS:  %"PRIu64" %"PRIu64"\n", start_ls, end_ls); */
+int bgpstream_ip_counter_add_bulk(bgpstream_ip_counter_t *ipc,
+                                  const bgpstream_pfx_t *pfxs, int pfxs_cnt)
+{
+  int i;
 
-      return merge_in_sorted_queue6(&ipc->v6list, start_ms, start_ls, end_ms,
-                                    end_ls);
+  for (i = 0; i < pfxs_cnt; i++) {
+    if (add_pfx(ipc, &pfxs[i]) != 0) {
+      return -1;
     }
   }
-  /* print_pfx_int_list(ipc); */
+  compact4(ipc);
+  compact6(ipc);
   return 0;
 }
 
-static uint32_t bgpstream_ip_counter_is_overlapping4(
+static uint64_t bgpstream_ip_counter_is_overlapping4(
     bgpstream_ip_counter_t *ipc,
-    bgpstream_ipv4_pfx_t *pfx,
+    const bgpstream_ipv4_pfx_t *pfx,
     uint8_t *more_specific)
 {
-  v4pfx_int_t *current = ipc->v4list;
-  uint32_t start = 0;
-  uint32_t end = 0;
-  uint32_t len = 0;
-  uint32_t pfx_size;
-  uint32_t overlap_count = 0;
-  *more_specific = 0;
-  len = 32 - pfx->mask_len;
-  start = ntohl(pfx->address.addr.s_addr);
-  start = (start >> len) << len;
-  end = 0;
-  end = ~end;
-  end = (end >> len) << len;
-  end = start | (~end);
-  pfx_size = end - start + 1;
+  const v4pfx_int_t *current;
+  v4pfx_int_t p;
+  uint64_t pfx_size;
+  uint64_t overlap_count = 0;
   /* intersection endpoints */
   uint32_t int_start;
   uint32_t int_end;
-  while (current != NULL) {
-    if (current->start > end) {
+  size_t i;
+
+  compact4(ipc);
+  pfx4_interval(pfx, &p);
+  pfx_size = (uint64_t)p.end - p.start + 1;
+
+  for (i = find4(ipc, p.start); i < ipc->v4.sorted_cnt; i++) {
+    current = &ipc->v4.ints[i];
+    if (current->start > p.end) {
       break;
     }
-    if (current->end < start) {
-      current = current->next;
-      continue;
-    }
     /* there is some overlap
      * max(start) and min(end) */
-    int_start = current->start;
-    int_end = current->end;
-    if (current->start < start) {
-      int_start = start;
-    }
-    if (current->end > end) {
-      int_end = end;
-    }
-    if ((int_end - int_start + 1) == pfx_size) {
+    int_start = current->start < p.start ? p.start : current->start;
+    int_end = current->end > p.end ? p.end : current->end;
+    if ((uint64_t)int_end - int_start + 1 == pfx_size) {
       *more_specific = 1;
     }
-    overlap_count += int_end - int_start + 1;
-    current = current->next;
+    overlap_count += (uint64_t)int_end - int_start + 1;
   }
   return overlap_count;
 }
 
 static uint64_t bgpstream_ip_counter_is_overlapping6(
     bgpstream_ip_counter_t *ipc,
-    bgpstream_ipv6_pfx_t *pfx,
+    const bgpstream_ipv6_pfx_t *pfx,
     uint8_t *more_specific)
 {
-  v6pfx_int_t *current = ipc->v6list;
-  v6pfx_int_t *previous = ipc->v6list;
-
-  uint64_t start_ms = 0;
-  uint64_t start_ls = 0;
-  uint64_t end_ms = 0;
-  uint64_t end_ls = 0;
-  uint64_t mask_ms;
-  uint64_t mask_ls;
-  unsigned char *tmp;
+  const v6pfx_int_t *current;
+  v6pfx_int_t p;
   uint64_t overlap_count = 0;
   uint64_t pfx_size;
-  *more_specific = 0;
-
-  tmp = &(pfx->address.addr.s6_addr[0]);
-  start_ms = nptohll(tmp);
-  tmp = &(pfx->address.addr.s6_addr[8]);
-  start_ls = nptohll(tmp);
-
-  /* printf("+++++++++  %"PRIu64" %"PRIu64"\n", start_ms, start_ls); */
-  if (pfx->mask_len > 64) {
-    /* len_ms = 0 */
-    mask_ms = ~((uint64_t)0);
-    /* len_ls = 64 - (pfx->mask_len - 64); */
-    mask_ls = ~(((uint64_t)1 << (64 - (pfx->mask_len - 64))) - 1);
-  } else {
-    /* len_ms = 64 - pfx->mask_len; */
-    mask_ms = ~(((uint64_t)1 << (64 - pfx->mask_len)) - 1);
-    /* len_ls = 64; */
-    /* mask_ls = ~( ((uint64_t)1 << 64) - 1); */
-    mask_ls = 0;
-  }
-
-  /* printf("MASKS:  %"PRIu64" %"PRIu64"\n", mask_ms, mask_ls); */
-
-  /* most significant */
-  start_ms = start_ms & mask_ms;
-  end_ms = start_ms | (~mask_ms);
-  /* printf("MS:  %"PRIu64" %"PRIu64"\n", start_ms, end_ms); */
-
-  /* least significant */
-  start_ls = start_ls & mask_ls;
-  end_ls = start_ls | (~mask_ls);
-  /* printf("LS:  %"PRIu64" %"PRIu64"\n", start_ls, end_ls); */
-
-  pfx_size = end_ms - start_ms + 1;
-
   /* intersection endpoints
-   * (only most significant)*/
+   * (only most significant, as /64s are counted) */
   uint64_t int_start_ms;
   uint64_t int_end_ms;
+  uint64_t last_ms = 0;
+  int counted = 0;
+  size_t i;
 
-  while (current != NULL) {
+  compact6(ipc);
+  pfx6_interval(pfx, &p);
+  pfx_size = p.end_ms - p.start_ms + 1;
+
+  for (i = find6(ipc, p.start_ms, p.start_ls); i < ipc->v6.sorted_cnt; i++) {
+    current = &ipc->v6.ints[i];
     /* current->start > end */
-    if (current->start_ms > end_ms ||
-        (current->start_ms == end_ms && current->start_ls > end_ls)) {
+    if (!LE128(current->start_ms, current->start_ls, p.end_ms, p.end_ls)) {
       break;
     }
-    /* current->end < start */
-    if (current->end_ms < start_ms ||
-        (current->end_ms == start_ms && current->end_ms < start_ls)) {
-      previous = current;
-      current = current->next;
-      continue;
-    }
-    /* there is some overlap
-     * max(start) and min(end) */
-    int_start_ms = current->start_ms;
-    int_end_ms = current->end_ms;
-    /* int_start_ls = current->start_ls; */
-    /* int_end_ls = current->end_ls; */
-    /* current->start < start */
-    if (current->start_ms < start_ms ||
-        (current->start_ms == start_ms && current->start_ms < start_ls)) {
-      int_start_ms = start_ms;
-      /* int_start_ls = start_ls; */
-    }
-    /* current->end > end */
-    if (current->end_ms > end_ms ||
-        (current->end_ms == end_ms && current->end_ls > end_ls)) {
-      int_end_ms = end_ms;
-      /* int_end_ls = end_ls; */
+    int_start_ms =
+      current->start_ms < p.start_ms ? p.start_ms : current->start_ms;
+    int_end_ms = current->end_ms > p.end_ms ? p.end_ms : current->end_ms;
+    if (int_end_ms - int_start_ms + 1 == pfx_size) {
+      *more_specific = 1;
     }
-    if (previous != current) {
-      if (current->start_ms != previous->start_ms ||
-          current->end_ms != previous->end_ms) {
-        if ((int_end_ms - int_start_ms + 1) == pfx_size) {
-          *more_specific = 1;
-        }
-        overlap_count += int_end_ms - int_start_ms + 1;
-      }
-    } else {
-      if ((int_end_ms - int_start_ms + 1) == pfx_size) {
-        *more_specific = 1;
-      }
-      overlap_count += int_end_ms - int_start_ms + 1;
+    overlap_count += int_end_ms - int_start_ms + 1;
+    /* a /64 shared with the previous interval is only counted once */
+    if (counted && int_start_ms == last_ms) {
+      overlap_count--;
     }
-    previous = current;
-    current = current->next;
+    last_ms = int_end_ms;
+    counted = 1;
   }
   return overlap_count;
 }
@@ -547,32 +389,23 @@ uint64_t bgpstream_ip_counter_get_ipcount(bgpstream_ip_counter_t *ipc,
                                           bgpstream_addr_version_t v)
 {
   uint64_t ip_count = 0;
-
-  v4pfx_int_t *current4 = ipc->v4list;
-  v6pfx_int_t *current6 = ipc->v6list;
-  v6pfx_int_t *previous6 = ipc->v6list;
+  size_t i;
 
   if (v == BGPSTREAM_ADDR_VERSION_IPV4) {
-    while (current4 != NULL) {
-      ip_count += (current4->end - current4->start) + 1;
-      current4 = current4->next;
+    compact4(ipc);
+    for (i = 0; i < ipc->v4.sorted_cnt; i++) {
+      ip_count += (ipc->v4.ints[i].end - ipc->v4.ints[i].start) + 1;
     }
   } else {
     if (v == BGPSTREAM_ADDR_VERSION_IPV6) {
-      while (current6 != NULL) {
-
-        if (previous6 != current6) {
-          /* add a new /64 to the count if the previous one
-           * was different (it could have been a /64+ */
-          if (current6->start_ms != previous6->start_ms ||
-              current6->end_ms != previous6->end_ms) {
-            ip_count += (current6->end_ms - current6->start_ms) + 1;
-          }
-        } else { /* if it is the first interval, than we always add it */
-          ip_count += (current6->end_ms - current6->start_ms) + 1;
+      compact6(ipc);
+      for (i = 0; i < ipc->v6.sorted_cnt; i++) {
+        ip_count += (ipc->v6.ints[i].end_ms - ipc->v6.ints[i].start_ms) + 1;
+        /* a /64 shared with the previous interval (which may be a /64+)
+         * is only counted once */
+        if (i > 0 && ipc->v6.ints[i].start_ms == ipc->v6.ints[i - 1].end_ms) {
+          ip_count--;
         }
-        previous6 = current6;
-        current6 = current6->next;
       }
     }
   }
@@ -581,28 +414,16 @@ uint64_t bgpstream_ip_counter_get_ipcount(bgpstream_ip_counter_t *ipc,
 
 void bgpstream_ip_counter_clear(bgpstream_ip_counter_t *ipc)
 {
-  v4pfx_int_t *current4 = ipc->v4list;
-  v4pfx_int_t *tmp4 = ipc->v4list;
-  v6pfx_int_t *current6 = ipc->v6list;
-  v6pfx_int_t *tmp6 = ipc->v6list;
-
-  while (tmp4 != NULL) {
-    current4 = tmp4;
-    tmp4 = tmp4->next;
-    free(current4);
-  }
-  ipc->v4list = NULL;
-
-  while (tmp6 != NULL) {
-    current6 = tmp6;
-    tmp6 = tmp6->next;
-    free(current6);
-  }
-  ipc->v6list = NULL;
+  ipc->v4.sorted_cnt = ipc->v4.cnt = 0;
+  ipc->v6.sorted_cnt = ipc->v6.cnt = 0;
 }
 
 void bgpstream_ip_counter_destroy(bgpstream_ip_counter_t *ipc)
 {
-  bgpstream_ip_counter_clear(ipc);
+  if (ipc == NULL) {
+    return;
+  }
+  free(ipc->v4.ints);
+  free(ipc->v6.ints);
   free(ipc);
 }
@@ -69,6 +69,19 @@ bgpstream_ip_counter_t *bgpstream_ip_counter_create(void);
  */
 int bgpstream_ip_counter_add(bgpstream_ip_counter_t *ipc, bgpstream_pfx_t *pfx);
 
+/** Add an array of prefixes to the IP Counter
+ *
+ * @param ipc          pointer to the IP Counter
+ * @param pfxs         array of prefixes to insert in IP Counter
+ * @param pfxs_cnt     number of prefixes in the array
+ * @return             0 if the prefixes were added correctly, -1 otherwise
+ *
+ * This is equivalent to adding the prefixes one by one, but they are merged
+ * with the ones already in the IP Counter in a single pass.
+ */
+int bgpstream_ip_counter_add_bulk(bgpstream_ip_counter_t *ipc,
+                                  const bgpstream_pfx_t *pfxs, int pfxs_cnt);
+
 /** Get the number of unique IPs in the IP Counter
  *
  * @param ipc            pointer to the IP Counter
@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bgpstream_log.h"
+#include "bgpstream_utils_ipv4_bitmap.h"
+#include "utils.h"
+
+/* The bitmap is split in one block per /8, which is only allocated once one
+ * of its /24s is covered. Each block has one bit per /24 of the /8. */
+#define BLOCK_CNT 256
+#define BLOCK_BITS (1 << 16)
+#define BLOCK_WORDS (BLOCK_BITS / 64)
+#define BLOCK_SIZE (sizeof(uint64_t) * BLOCK_WORDS)
+
+/* Compilers turn this into a POPCNT instruction (and vectorize the loops
+ * using it) when the target supports it */
+#define POPCOUNT(w) ((uint64_t)__builtin_popcountll(w))
+
+struct bgpstream_ipv4_bitmap {
+  uint64_t *blocks[BLOCK_CNT];
+};
+
+static uint64_t *get_block(bgpstream_ipv4_bitmap_t *bm, int b)
+{
+  if (bm->blocks[b] == NULL &&
+      (bm->blocks[b] = malloc_zero(BLOCK_SIZE)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "can't malloc IPv4 bitmap block");
+  }
+  return bm->blocks[b];
+}
+
+static void free_block(bgpstream_ipv4_bitmap_t *bm, int b)
+{
+  free(bm->blocks[b]);
+  bm->blocks[b] = NULL;
+}
+
+/* mask for the cnt bits from bit off of a word (cnt < 64) */
+#define WORD_MASK(off, cnt) ((((uint64_t)1 << (cnt)) - 1) << (off))
+
+/* The bits of a prefix are a power-of-two sized range aligned on its size,
+ * so either all fit within one word or the range is made of whole words */
+static void set_range(uint64_t *words, uint32_t start, uint32_t cnt)
+{
+  if (cnt >= 64) {
+    memset(&words[start / 64], 0xff, sizeof(uint64_t) * (cnt / 64));
+  } else {
+    words[start / 64] |= WORD_MASK(start % 64, cnt);
+  }
+}
+
+static uint64_t count_range(const uint64_t *words, uint32_t start,
+                            uint32_t cnt)
+{
+  uint64_t count = 0;
+  uint32_t i;
+
+  if (cnt < 64) {
+    return POPCOUNT(words[start / 64] & WORD_MASK(start % 64, cnt));
+  }
+  for (i = start / 64; i < (start + cnt) / 64; i++) {
+    count += POPCOUNT(words[i]);
+  }
+  return count;
+}
+
+/* first /8 and number of /8s of the prefix if it is a /8 or less specific,
+ * or the block, first bit and number of bits otherwise */
+typedef struct pfx_range {
+  int first_block;
+  int block_cnt;
+  uint32_t start;
+  uint32_t cnt;
+} pfx_range_t;
+
+static int pfx2range(const bgpstream_pfx_t *pfx, pfx_range_t *r)
+{
+  uint32_t addr;
+  int len;
+
+  if (pfx->address.version != BGPSTREAM_ADDR_VERSION_IPV4) {
+    return -1;
+  }
+  addr = ntohl(pfx->bs_ipv4.address.addr.s_addr);
+  len = pfx->mask_len > 24 ? 24 : pfx->mask_len;
+  if (len <= 8) {
+    r->block_cnt = 1 << (8 - len);
+    r->first_block = (addr >> 24) & ~(r->block_cnt - 1);
+    r->start = 0;
+    r->cnt = BLOCK_BITS;
+  } else {
+    r->block_cnt = 1;
+    r->first_block = addr >> 24;
+    r->cnt = 1 << (24 - len);
+    r->start = ((addr >> 8) & 0xffff) & ~(r->cnt - 1);
+  }
+  return 0;
+}
+
+bgpstream_ipv4_bitmap_t *bgpstream_ipv4_bitmap_create()
+{
+  bgpstream_ipv4_bitmap_t *bm;
+
+  if ((bm = malloc_zero(sizeof(bgpstream_ipv4_bitmap_t))) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR,
+                  "can't malloc bgpstream_ipv4_bitmap_t structure");
+    return NULL;
+  }
+  return bm;
+}
+
+int bgpstream_ipv4_bitmap_add(bgpstream_ipv4_bitmap_t *bm,
+                              const bgpstream_pfx_t *pfx)
+{
+  pfx_range_t r;
+  uint64_t *words;
+  int b;
+
+  if (pfx2range(pfx, &r) != 0) {
+    return 0;
+  }
+  for (b = r.first_block; b < r.first_block + r.block_cnt; b++) {
+    if ((words = get_block(bm, b)) == NULL) {
+      return -1;
+    }
+    set_range(words, r.start, r.cnt);
+  }
+  return 0;
+}
+
+int bgpstream_ipv4_bitmap_add_bulk(bgpstream_ipv4_bitmap_t *bm,
+                                   const bgpstream_pfx_t *pfxs, int pfxs_cnt)
+{
+  int i;
+
+  for (i = 0; i < pfxs_cnt; i++) {
+    if (bgpstream_ipv4_bitmap_add(bm, &pfxs[i]) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+uint64_t bgpstream_ipv4_bitmap_get_count(const bgpstream_ipv4_bitmap_t *bm)
+{
+  uint64_t count = 0;
+  int b, i;
+
+  for (b = 0; b < BLOCK_CNT; b++) {
+    if (bm->blocks[b] == NULL) {
+      continue;
+    }
+    for (i = 0; i < BLOCK_WORDS; i++) {
+      count += POPCOUNT(bm->blocks[b][i]);
+    }
+  }
+  return count;
+}
+
+uint64_t bgpstream_ipv4_bitmap_get_overlap(const bgpstream_ipv4_bitmap_t *bm,
+                                           const bgpstream_pfx_t *pfx)
+{
+  uint64_t count = 0;
+  pfx_range_t r;
+  int b;
+
+  if (pfx2range(pfx, &r) != 0) {
+    return 0;
+  }
+  for (b = r.first_block; b < r.first_block + r.block_cnt; b++) {
+    if (bm->blocks[b] != NULL) {
+      count += count_range(bm->blocks[b], r.start, r.cnt);
+    }
+  }
+  return count;
+}
+
+uint64_t bgpstream_ipv4_bitmap_and_count(const bgpstream_ipv4_bitmap_t *a,
+                                         const bgpstream_ipv4_bitmap_t *b)
+{
+  uint64_t count = 0;
+  int i, j;
+
+  for (i = 0; i < BLOCK_CNT; i++) {
+    if (a->blocks[i] == NULL || b->blocks[i] == NULL) {
+      continue;
+    }
+    for (j = 0; j < BLOCK_WORDS; j++) {
+      count += POPCOUNT(a->blocks[i][j] & b->blocks[i][j]);
+    }
+  }
+  return count;
+}
+
+int bgpstream_ipv4_bitmap_copy(bgpstream_ipv4_bitmap_t *dst,
+                               const bgpstream_ipv4_bitmap_t *src)
+{
+  int b;
+
+  for (b = 0; b < BLOCK_CNT; b++) {
+    if (src->blocks[b] == NULL) {
+      free_block(dst, b);
+    } else if (get_block(dst, b) == NULL) {
+      return -1;
+    } else {
+      memcpy(dst->blocks[b], src->blocks[b], BLOCK_SIZE);
+    }
+  }
+  return 0;
+}
+
+void bgpstream_ipv4_bitmap_and(bgpstream_ipv4_bitmap_t *dst,
+                               const bgpstream_ipv4_bitmap_t *src)
+{
+  int b, i;
+
+  for (b = 0; b < BLOCK_CNT; b++) {
+    if (dst->blocks[b] == NULL) {
+      continue;
+    }
+    if (src->blocks[b] == NULL) {
+      free_block(dst, b);
+      continue;
+    }
+    for (i = 0; i < BLOCK_WORDS; i++) {
+      dst->blocks[b][i] &= src->blocks[b][i];
+    }
+  }
+}
+
+int bgpstream_ipv4_bitmap_or(bgpstream_ipv4_bitmap_t *dst,
+                             const bgpstream_ipv4_bitmap_t *src)
+{
+  int b, i;
+
+  for (b = 0; b < BLOCK_CNT; b++) {
+    if (src->blocks[b] == NULL) {
+      continue;
+    }
+    if (get_block(dst, b) == NULL) {
+      return -1;
+    }
+    for (i = 0; i < BLOCK_WORDS; i++) {
+      dst->blocks[b][i] |= src->blocks[b][i];
+    }
+  }
+  return 0;
+}
+
+void bgpstream_ipv4_bitmap_andnot(bgpstream_ipv4_bitmap_t *dst,
+                                  const bgpstream_ipv4_bitmap_t *src)
+{
+  int b, i;
+
+  for (b = 0; b < BLOCK_CNT; b++) {
+    if (dst->blocks[b] == NULL || src->blocks[b] == NULL) {
+      continue;
+    }
+    for (i = 0; i < BLOCK_WORDS; i++) {
+      dst->blocks[b][i] &= ~src->blocks[b][i];
+    }
+  }
+}
+
+void bgpstream_ipv4_bitmap_clear(bgpstream_ipv4_bitmap_t *bm)
+{
+  int b;
+
+  for (b = 0; b < BLOCK_CNT; b++) {
+    free_block(bm, b);
+  }
+}
+
+void bgpstream_ipv4_bitmap_destroy(bgpstream_ipv4_bitmap_t *bm)
+{
+  if (bm == NULL) {
+    return;
+  }
+  bgpstream_ipv4_bitmap_clear(bm);
+  free(bm);
+}
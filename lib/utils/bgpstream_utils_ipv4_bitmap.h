@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_UTILS_IPV4_BITMAP_H
+#define __BGPSTREAM_UTILS_IPV4_BITMAP_H
+
+#include <stdint.h>
+
+#include "bgpstream_utils_pfx.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of BGP Stream IPv4
+ * Bitmap objects: IPv4 address space coverage counters with /24 granularity
+ *
+ * A bitmap has one bit per /24 (2 MB for the whole IPv4 address space, but
+ * only the /8s that are used are allocated), so adding a prefix and counting
+ * its overlap with the bitmap take time proportional to the number of /24s
+ * in the prefix, regardless of how many prefixes were added. Bitmaps can be
+ * combined with set operations.
+ *
+ * Prefixes more specific than a /24 mark their whole /24 as covered (as does
+ * bgpstream_patricia_tree_count_24subnets), and IPv6 prefixes are ignored.
+ * See bgpstream_ip_counter for exact counts and IPv6.
+ */
+
+/**
+ * @name Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure containing an IPv4 Bitmap instance */
+typedef struct bgpstream_ipv4_bitmap bgpstream_ipv4_bitmap_t;
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new (empty) IPv4 Bitmap instance
+ *
+ * @return a pointer to the structure, or NULL if an error occurred
+ */
+bgpstream_ipv4_bitmap_t *bgpstream_ipv4_bitmap_create(void);
+
+/** Add a prefix to the IPv4 Bitmap
+ *
+ * @param bm           pointer to the IPv4 Bitmap
+ * @param pfx          prefix to add
+ * @return 0 if the prefix was added correctly, -1 otherwise
+ */
+int bgpstream_ipv4_bitmap_add(bgpstream_ipv4_bitmap_t *bm,
+                              const bgpstream_pfx_t *pfx);
+
+/** Add an array of prefixes to the IPv4 Bitmap
+ *
+ * @param bm           pointer to the IPv4 Bitmap
+ * @param pfxs         array of prefixes to add
+ * @param pfxs_cnt     number of prefixes in the array
+ * @return 0 if the prefixes were added correctly, -1 otherwise
+ */
+int bgpstream_ipv4_bitmap_add_bulk(bgpstream_ipv4_bitmap_t *bm,
+                                   const bgpstream_pfx_t *pfxs, int pfxs_cnt);
+
+/** Get the number of /24s covered by the IPv4 Bitmap
+ *
+ * @param bm           pointer to the IPv4 Bitmap
+ * @return the number of /24s covered
+ */
+uint64_t bgpstream_ipv4_bitmap_get_count(const bgpstream_ipv4_bitmap_t *bm);
+
+/** Get the number of /24s of a prefix that are covered by the IPv4 Bitmap
+ *
+ * @param bm           pointer to the IPv4 Bitmap
+ * @param pfx          prefix to compare
+ * @return the number of /24s of pfx covered by the bitmap (0 for IPv6
+ * prefixes)
+ */
+uint64_t bgpstream_ipv4_bitmap_get_overlap(const bgpstream_ipv4_bitmap_t *bm,
+                                           const bgpstream_pfx_t *pfx);
+
+/** Get the number of /24s covered by both of two IPv4 Bitmaps
+ *
+ * @param a            pointer to the first IPv4 Bitmap
+ * @param b            pointer to the second IPv4 Bitmap
+ * @return the number of /24s in the intersection of the bitmaps
+ */
+uint64_t bgpstream_ipv4_bitmap_and_count(const bgpstream_ipv4_bitmap_t *a,
+                                         const bgpstream_ipv4_bitmap_t *b);
+
+/** Make an IPv4 Bitmap a copy of another
+ *
+ * @param dst          pointer to the IPv4 Bitmap to modify
+ * @param src          pointer to the IPv4 Bitmap to copy
+ * @return 0 if the bitmap was copied successfully, -1 otherwise
+ */
+int bgpstream_ipv4_bitmap_copy(bgpstream_ipv4_bitmap_t *dst,
+                               const bgpstream_ipv4_bitmap_t *src);
+
+/** Intersect an IPv4 Bitmap with another (dst = dst AND src)
+ *
+ * @param dst          pointer to the IPv4 Bitmap to modify
+ * @param src          pointer to the other IPv4 Bitmap
+ */
+void bgpstream_ipv4_bitmap_and(bgpstream_ipv4_bitmap_t *dst,
+                               const bgpstream_ipv4_bitmap_t *src);
+
+/** Add the /24s of an IPv4 Bitmap to another (dst = dst OR src)
+ *
+ * @param dst          pointer to the IPv4 Bitmap to modify
+ * @param src          pointer to the other IPv4 Bitmap
+ * @return 0 if the bitmaps were merged successfully, -1 otherwise
+ */
+int bgpstream_ipv4_bitmap_or(bgpstream_ipv4_bitmap_t *dst,
+                             const bgpstream_ipv4_bitmap_t *src);
+
+/** Remove the /24s of an IPv4 Bitmap from another (dst = dst AND NOT src)
+ *
+ * @param dst          pointer to the IPv4 Bitmap to modify
+ * @param src          pointer to the other IPv4 Bitmap
+ */
+void bgpstream_ipv4_bitmap_andnot(bgpstream_ipv4_bitmap_t *dst,
+                                  const bgpstream_ipv4_bitmap_t *src);
+
+/** Empty the IPv4 Bitmap
+ *
+ * @param bm           pointer to the IPv4 Bitmap to clear
+ */
+void bgpstream_ipv4_bitmap_clear(bgpstream_ipv4_bitmap_t *bm);
+
+/** Destroy the given IPv4 Bitmap
+ *
+ * @param bm           pointer to the IPv4 Bitmap to destroy
+ */
+void bgpstream_ipv4_bitmap_destroy(bgpstream_ipv4_bitmap_t *bm);
+
+/** @} */
+
+#endif /* __BGPSTREAM_UTILS_IPV4_BITMAP_H */
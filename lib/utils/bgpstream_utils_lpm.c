@@ -0,0 +1,606 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "bgpstream_log.h"
+#include "bgpstream_utils_lpm.h"
+#include "utils.h"
+
+/* Each address version has a multibit trie: a root table indexed by the first
+ * LPM_ROOT_BITS bits of the address, and groups of entries indexed by the next
+ * stride bits. Prefixes are expanded to the entries of the table (or group)
+ * that ends at or after their last bit, and entries for which more specific
+ * prefixes exist point to a group for the next bits instead, so a lookup only
+ * follows entries until it finds one that holds a prefix.
+ *
+ * IPv4 tables use 8-bit strides (so no lookup takes more than three memory
+ * accesses); IPv6 ones use 4-bit strides, which keeps groups the size of a
+ * cache line, as most IPv6 prefixes end in the middle of the address. */
+#define LPM_ROOT_BITS 16
+#define LPM_MAXBITS 128
+#define LPM_IPV4_STRIDE 8
+#define LPM_IPV6_STRIDE 4
+
+/* an entry is 0 if no prefix covers it, LPM_CHILD | the group for the next
+ * bits if more specific prefixes do, or the index of the prefix + 1 */
+#define LPM_CHILD 0x80000000
+#define LPM_MAX_GROUPS (LPM_CHILD - 1)
+#define LPM_MAX_PFXS (LPM_CHILD - 2)
+
+/* number of lookups of a batch that are interleaved */
+#define LPM_BATCH 32
+
+#define LPM_GROUP(t, e, slot)                                                  \
+  ((t)->groups[((size_t)((e) & ~LPM_CHILD) << (t)->stride) | (slot)])
+
+typedef struct lpm_table {
+  /* 1 << LPM_ROOT_BITS entries, NULL until the table is built */
+  uint32_t *root;
+
+  /* groups of 1 << stride entries */
+  uint32_t *groups;
+  uint32_t groups_cnt;
+  uint32_t groups_alloc;
+
+  uint8_t stride;
+} lpm_table_t;
+
+typedef struct lpm_pfx {
+  bgpstream_pfx_t pfx;
+  void *user;
+} lpm_pfx_t;
+
+struct bgpstream_lpm {
+  /* prefixes added, in the order they were added */
+  lpm_pfx_t *pfxs;
+  uint32_t pfxs_cnt;
+  uint32_t pfxs_alloc;
+
+  lpm_table_t v4;
+  lpm_table_t v6;
+};
+
+/* n bits of addr from bit off (which must not span more than two bytes) */
+static inline uint32_t lpm_bits(const uint8_t *addr, int addr_len, int off,
+                                int n)
+{
+  int i = off >> 3;
+  uint32_t v = (uint32_t)addr[i] << 8;
+
+  if (i + 1 < addr_len) {
+    v |= addr[i + 1];
+  }
+  return (v >> (16 - (off & 7) - n)) & ((1U << n) - 1);
+}
+
+static inline uint32_t lpm_ipv6_nibble(const uint8_t *addr, int off)
+{
+  return (addr[off >> 3] >> (4 - (off & 4))) & 0xf;
+}
+
+static void lpm_table_free(lpm_table_t *t)
+{
+  free(t->root);
+  t->root = NULL;
+  free(t->groups);
+  t->groups = NULL;
+  t->groups_cnt = 0;
+  t->groups_alloc = 0;
+}
+
+/* add a group with every entry set to fill, and return its index (or
+ * UINT32_MAX if an error occurred) */
+static uint32_t lpm_group_alloc(lpm_table_t *t, uint32_t fill)
+{
+  uint32_t *groups;
+  uint32_t alloc, i;
+  size_t group_entries = (size_t)1 << t->stride;
+
+  if (t->groups_cnt == t->groups_alloc) {
+    if (t->groups_alloc >= LPM_MAX_GROUPS) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Too many LPM groups");
+      return UINT32_MAX;
+    }
+    alloc = (t->groups_alloc == 0) ? 1024 : t->groups_alloc * 2;
+    if (alloc > LPM_MAX_GROUPS) {
+      alloc = LPM_MAX_GROUPS;
+    }
+    if ((groups = realloc(t->groups, sizeof(uint32_t) * group_entries *
+                                       alloc)) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not grow LPM groups");
+      return UINT32_MAX;
+    }
+    t->groups = groups;
+    t->groups_alloc = alloc;
+  }
+  for (i = 0; i < group_entries; i++) {
+    t->groups[t->groups_cnt * group_entries + i] = fill;
+  }
+  return t->groups_cnt++;
+}
+
+/* expand a prefix into the table. prefixes must be added from the least to
+ * the most specific, so that a prefix only overrides less specific ones (and
+ * never meets a group, which only more specific prefixes create) */
+static int lpm_table_add(lpm_table_t *t, const bgpstream_pfx_t *pfx,
+                         uint32_t val, int addr_len)
+{
+  const uint8_t *addr = (const uint8_t *)&pfx->address.addr;
+  uint32_t *tbl = t->root;
+  uint32_t slot, span, i, g;
+  size_t tbl_off;
+  int off = 0, n = LPM_ROOT_BITS;
+
+  for (;;) {
+    slot = lpm_bits(addr, addr_len, off, n);
+    if (pfx->mask_len <= off + n) {
+      span = 1U << (off + n - pfx->mask_len);
+      slot &= ~(span - 1);
+      for (i = slot; i < slot + span; i++) {
+        assert((tbl[i] & LPM_CHILD) == 0);
+        tbl[i] = val;
+      }
+      return 0;
+    }
+    if ((tbl[slot] & LPM_CHILD) == 0) {
+      /* the group may move, and tbl with it */
+      tbl_off = (tbl == t->root) ? SIZE_MAX : (size_t)(tbl - t->groups);
+      if ((g = lpm_group_alloc(t, tbl[slot])) == UINT32_MAX) {
+        return -1;
+      }
+      if (tbl_off != SIZE_MAX) {
+        tbl = t->groups + tbl_off;
+      }
+      tbl[slot] = LPM_CHILD | g;
+    }
+    tbl = &LPM_GROUP(t, tbl[slot], 0);
+    off += n;
+    n = t->stride;
+  }
+}
+
+static int lpm_table_build(bgpstream_lpm_t *lpm, lpm_table_t *t,
+                           bgpstream_addr_version_t v, uint32_t *order)
+{
+  uint32_t len_start[LPM_MAXBITS + 2];
+  uint32_t *groups;
+  uint32_t cnt = 0, i;
+  int addr_len = (v == BGPSTREAM_ADDR_VERSION_IPV4) ? 4 : 16;
+
+  lpm_table_free(t);
+  if ((t->root = malloc_zero(sizeof(uint32_t) << LPM_ROOT_BITS)) == NULL) {
+    return -1;
+  }
+
+  /* counting sort of the prefixes by mask length, which keeps identical
+   * prefixes in the order they were added (so that the last one wins) */
+  memset(len_start, 0, sizeof(len_start));
+  for (i = 0; i < lpm->pfxs_cnt; i++) {
+    if (lpm->pfxs[i].pfx.address.version == v) {
+      len_start[lpm->pfxs[i].pfx.mask_len + 1]++;
+      cnt++;
+    }
+  }
+  for (i = 1; i <= LPM_MAXBITS + 1; i++) {
+    len_start[i] += len_start[i - 1];
+  }
+  for (i = 0; i < lpm->pfxs_cnt; i++) {
+    if (lpm->pfxs[i].pfx.address.version == v) {
+      order[len_start[lpm->pfxs[i].pfx.mask_len]++] = i;
+    }
+  }
+
+  for (i = 0; i < cnt; i++) {
+    if (lpm_table_add(t, &lpm->pfxs[order[i]].pfx, order[i] + 1, addr_len) !=
+        0) {
+      lpm_table_free(t);
+      return -1;
+    }
+  }
+
+  /* the table is read-only from now on, so give back what was allocated
+   * ahead */
+  if (t->groups_cnt != 0 && t->groups_cnt < t->groups_alloc &&
+      (groups = realloc(t->groups, (sizeof(uint32_t) << t->stride) *
+                                     t->groups_cnt)) != NULL) {
+    t->groups = groups;
+    t->groups_alloc = t->groups_cnt;
+  }
+  return 0;
+}
+
+/* host byte order ip */
+static inline uint32_t lpm_ipv4_lookup(const lpm_table_t *t, uint32_t ip)
+{
+  uint32_t e = t->root[ip >> 16];
+
+  if (e & LPM_CHILD) {
+    e = LPM_GROUP(t, e, (ip >> 8) & 0xff);
+    if (e & LPM_CHILD) {
+      e = LPM_GROUP(t, e, ip & 0xff);
+    }
+  }
+  /* 0 (no prefix) becomes BGPSTREAM_LPM_NONE */
+  return e - 1;
+}
+
+static inline uint32_t lpm_ipv6_lookup(const lpm_table_t *t,
+                                       const uint8_t *addr)
+{
+  uint32_t e = t->root[((uint32_t)addr[0] << 8) | addr[1]];
+  int off = LPM_ROOT_BITS;
+
+  while (e & LPM_CHILD) {
+    e = LPM_GROUP(t, e, lpm_ipv6_nibble(addr, off));
+    off += LPM_IPV6_STRIDE;
+  }
+  return e - 1;
+}
+
+/* at most LPM_BATCH network byte order addresses */
+static void lpm_ipv4_lookup_batch(const lpm_table_t *t, const uint32_t *addrs,
+                                  int cnt, uint32_t *results)
+{
+  uint32_t ip[LPM_BATCH], e[LPM_BATCH];
+  int i = 0, level;
+
+#ifdef __AVX2__
+  /* byte swap and look up the root entries of 8 addresses at a time */
+  const __m256i bswap =
+    _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3,
+                     2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  for (; i + 8 <= cnt; i += 8) {
+    __m256i v = _mm256_shuffle_epi8(
+      _mm256_loadu_si256((const __m256i *)(addrs + i)), bswap);
+    _mm256_storeu_si256((__m256i *)(ip + i), v);
+    _mm256_storeu_si256(
+      (__m256i *)(e + i),
+      _mm256_i32gather_epi32((const int *)t->root, _mm256_srli_epi32(v, 16),
+                             4));
+  }
+#endif
+  for (; i < cnt; i++) {
+    ip[i] = ntohl(addrs[i]);
+    __builtin_prefetch(&t->root[ip[i] >> 16]);
+  }
+#ifdef __AVX2__
+  i = cnt - (cnt & 7);
+#else
+  i = 0;
+#endif
+  for (; i < cnt; i++) {
+    e[i] = t->root[ip[i] >> 16];
+  }
+
+  /* then follow the groups of all of them together, prefetching each entry
+   * before it is needed */
+  for (level = 1; level <= 2; level++) {
+    int shift = 16 - level * LPM_IPV4_STRIDE, pending = 0;
+    for (i = 0; i < cnt; i++) {
+      if (e[i] & LPM_CHILD) {
+        __builtin_prefetch(&LPM_GROUP(t, e[i], (ip[i] >> shift) & 0xff));
+        pending = 1;
+      }
+    }
+    if (pending == 0) {
+      break;
+    }
+    for (i = 0; i < cnt; i++) {
+      if (e[i] & LPM_CHILD) {
+        e[i] = LPM_GROUP(t, e[i], (ip[i] >> shift) & 0xff);
+      }
+    }
+  }
+
+  for (i = 0; i < cnt; i++) {
+    results[i] = e[i] - 1;
+  }
+}
+
+/* at most LPM_BATCH addresses */
+static void lpm_ipv6_lookup_batch(const lpm_table_t *t,
+                                  const uint8_t *const *addrs, int cnt,
+                                  uint32_t *results)
+{
+  uint32_t e[LPM_BATCH];
+  int i, off, pending;
+
+  for (i = 0; i < cnt; i++) {
+    __builtin_prefetch(&t->root[((uint32_t)addrs[i][0] << 8) | addrs[i][1]]);
+  }
+  for (i = 0; i < cnt; i++) {
+    e[i] = t->root[((uint32_t)addrs[i][0] << 8) | addrs[i][1]];
+  }
+
+  for (off = LPM_ROOT_BITS;; off += LPM_IPV6_STRIDE) {
+    pending = 0;
+    for (i = 0; i < cnt; i++) {
+      if (e[i] & LPM_CHILD) {
+        __builtin_prefetch(
+          &LPM_GROUP(t, e[i], lpm_ipv6_nibble(addrs[i], off)));
+        pending = 1;
+      }
+    }
+    if (pending == 0) {
+      break;
+    }
+    for (i = 0; i < cnt; i++) {
+      if (e[i] & LPM_CHILD) {
+        e[i] = LPM_GROUP(t, e[i], lpm_ipv6_nibble(addrs[i], off));
+      }
+    }
+  }
+
+  for (i = 0; i < cnt; i++) {
+    results[i] = e[i] - 1;
+  }
+}
+
+/* ========== PUBLIC FUNCTIONS ========== */
+
+bgpstream_lpm_t *bgpstream_lpm_create(void)
+{
+  bgpstream_lpm_t *lpm;
+
+  if ((lpm = malloc_zero(sizeof(bgpstream_lpm_t))) == NULL) {
+    return NULL;
+  }
+  lpm->v4.stride = LPM_IPV4_STRIDE;
+  lpm->v6.stride = LPM_IPV6_STRIDE;
+  return lpm;
+}
+
+int bgpstream_lpm_add(bgpstream_lpm_t *lpm, const bgpstream_pfx_t *pfx,
+                      void *user)
+{
+  lpm_pfx_t *pfxs;
+  uint32_t alloc;
+
+  if (pfx->address.version != BGPSTREAM_ADDR_VERSION_IPV4 &&
+      pfx->address.version != BGPSTREAM_ADDR_VERSION_IPV6) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid LPM prefix version");
+    return -1;
+  }
+  if (lpm->pfxs_cnt == lpm->pfxs_alloc) {
+    if (lpm->pfxs_alloc >= LPM_MAX_PFXS) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Too many LPM prefixes");
+      return -1;
+    }
+    alloc = (lpm->pfxs_alloc == 0) ? 1024 : lpm->pfxs_alloc * 2;
+    if (alloc > LPM_MAX_PFXS) {
+      alloc = LPM_MAX_PFXS;
+    }
+    if ((pfxs = realloc(lpm->pfxs, sizeof(lpm_pfx_t) * alloc)) == NULL) {
+      return -1;
+    }
+    lpm->pfxs = pfxs;
+    lpm->pfxs_alloc = alloc;
+  }
+  bgpstream_pfx_copy(&lpm->pfxs[lpm->pfxs_cnt].pfx, pfx);
+  lpm->pfxs[lpm->pfxs_cnt].user = user;
+  lpm->pfxs_cnt++;
+  return 0;
+}
+
+typedef struct lpm_add_state {
+  bgpstream_lpm_t *lpm;
+  int rc;
+} lpm_add_state_t;
+
+static bgpstream_patricia_walk_cb_result_t
+add_patricia_node(const bgpstream_patricia_tree_t *pt,
+                  const bgpstream_patricia_node_t *node, void *data)
+{
+  lpm_add_state_t *state = data;
+
+  if (bgpstream_lpm_add(
+        state->lpm, bgpstream_patricia_tree_get_pfx(node),
+        bgpstream_patricia_tree_get_user(bgpstream_nonconst_node(node))) !=
+      0) {
+    state->rc = -1;
+    return BGPSTREAM_PATRICIA_WALK_END_ALL;
+  }
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+int bgpstream_lpm_add_patricia(bgpstream_lpm_t *lpm,
+                               const bgpstream_patricia_tree_t *pt)
+{
+  lpm_add_state_t state = {lpm, 0};
+
+  bgpstream_patricia_tree_walk(pt, add_patricia_node, &state);
+  return state.rc;
+}
+
+static void add_set_pfx(bgpstream_pfx_t *pfx, void *data)
+{
+  lpm_add_state_t *state = data;
+
+  if (state->rc == 0 && bgpstream_lpm_add(state->lpm, pfx, NULL) != 0) {
+    state->rc = -1;
+  }
+}
+
+int bgpstream_lpm_add_pfx_set(bgpstream_lpm_t *lpm, bgpstream_pfx_set_t *set)
+{
+  lpm_add_state_t state = {lpm, 0};
+
+  if (bgpstream_pfx_set_iterate(set, add_set_pfx, &state) != 0) {
+    return -1;
+  }
+  return state.rc;
+}
+
+int bgpstream_lpm_build(bgpstream_lpm_t *lpm)
+{
+  uint32_t *order;
+
+  if ((order = malloc(sizeof(uint32_t) * (lpm->pfxs_cnt + 1))) == NULL) {
+    return -1;
+  }
+  if (lpm_table_build(lpm, &lpm->v4, BGPSTREAM_ADDR_VERSION_IPV4, order) !=
+        0 ||
+      lpm_table_build(lpm, &lpm->v6, BGPSTREAM_ADDR_VERSION_IPV6, order) !=
+        0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not build LPM table");
+    free(order);
+    return -1;
+  }
+  free(order);
+  return 0;
+}
+
+uint32_t bgpstream_lpm_get_pfx_cnt(const bgpstream_lpm_t *lpm)
+{
+  return lpm->pfxs_cnt;
+}
+
+const bgpstream_pfx_t *bgpstream_lpm_get_pfx(const bgpstream_lpm_t *lpm,
+                                             uint32_t idx)
+{
+  assert(idx < lpm->pfxs_cnt);
+  return &lpm->pfxs[idx].pfx;
+}
+
+void *bgpstream_lpm_get_user(const bgpstream_lpm_t *lpm, uint32_t idx)
+{
+  assert(idx < lpm->pfxs_cnt);
+  return lpm->pfxs[idx].user;
+}
+
+uint32_t bgpstream_lpm_lookup(const bgpstream_lpm_t *lpm,
+                              const bgpstream_ip_addr_t *addr)
+{
+  switch (addr->version) {
+  case BGPSTREAM_ADDR_VERSION_IPV4:
+    if (lpm->v4.root == NULL) {
+      return BGPSTREAM_LPM_NONE;
+    }
+    return lpm_ipv4_lookup(&lpm->v4, ntohl(addr->bs_ipv4.addr.s_addr));
+
+  case BGPSTREAM_ADDR_VERSION_IPV6:
+    if (lpm->v6.root == NULL) {
+      return BGPSTREAM_LPM_NONE;
+    }
+    return lpm_ipv6_lookup(&lpm->v6, addr->bs_ipv6.addr.s6_addr);
+
+  default:
+    return BGPSTREAM_LPM_NONE;
+  }
+}
+
+void bgpstream_lpm_lookup_batch(const bgpstream_lpm_t *lpm,
+                                const bgpstream_ip_addr_t *addrs, int cnt,
+                                uint32_t *results)
+{
+  uint32_t v4[LPM_BATCH], v4_res[LPM_BATCH], v6_res[LPM_BATCH];
+  const uint8_t *v6[LPM_BATCH];
+  int v4_pos[LPM_BATCH], v6_pos[LPM_BATCH];
+  int v4_cnt = 0, v6_cnt = 0;
+  int i, j;
+
+  /* sort the addresses into batches of each version */
+  for (i = 0; i < cnt; i++) {
+    if (addrs[i].version == BGPSTREAM_ADDR_VERSION_IPV4 &&
+        lpm->v4.root != NULL) {
+      v4[v4_cnt] = addrs[i].bs_ipv4.addr.s_addr;
+      v4_pos[v4_cnt++] = i;
+    } else if (addrs[i].version == BGPSTREAM_ADDR_VERSION_IPV6 &&
+               lpm->v6.root != NULL) {
+      v6[v6_cnt] = addrs[i].bs_ipv6.addr.s6_addr;
+      v6_pos[v6_cnt++] = i;
+    } else {
+      results[i] = BGPSTREAM_LPM_NONE;
+    }
+
+    if (v4_cnt == LPM_BATCH || (i == cnt - 1 && v4_cnt != 0)) {
+      lpm_ipv4_lookup_batch(&lpm->v4, v4, v4_cnt, v4_res);
+      for (j = 0; j < v4_cnt; j++) {
+        results[v4_pos[j]] = v4_res[j];
+      }
+      v4_cnt = 0;
+    }
+    if (v6_cnt == LPM_BATCH || (i == cnt - 1 && v6_cnt != 0)) {
+      lpm_ipv6_lookup_batch(&lpm->v6, v6, v6_cnt, v6_res);
+      for (j = 0; j < v6_cnt; j++) {
+        results[v6_pos[j]] = v6_res[j];
+      }
+      v6_cnt = 0;
+    }
+  }
+}
+
+void bgpstream_lpm_lookup_ipv4_batch(const bgpstream_lpm_t *lpm,
+                                     const uint32_t *addrs, int cnt,
+                                     uint32_t *results)
+{
+  int i, n;
+
+  if (lpm->v4.root == NULL) {
+    for (i = 0; i < cnt; i++) {
+      results[i] = BGPSTREAM_LPM_NONE;
+    }
+    return;
+  }
+  for (i = 0; i < cnt; i += n) {
+    n = (cnt - i < LPM_BATCH) ? (cnt - i) : LPM_BATCH;
+    lpm_ipv4_lookup_batch(&lpm->v4, addrs + i, n, results + i);
+  }
+}
+
+size_t bgpstream_lpm_get_mem_size(const bgpstream_lpm_t *lpm)
+{
+  size_t size = sizeof(bgpstream_lpm_t) + sizeof(lpm_pfx_t) * lpm->pfxs_alloc;
+
+  if (lpm->v4.root != NULL) {
+    size += sizeof(uint32_t) << LPM_ROOT_BITS;
+  }
+  if (lpm->v6.root != NULL) {
+    size += sizeof(uint32_t) << LPM_ROOT_BITS;
+  }
+  size += (sizeof(uint32_t) << LPM_IPV4_STRIDE) * lpm->v4.groups_alloc;
+  size += (sizeof(uint32_t) << LPM_IPV6_STRIDE) * lpm->v6.groups_alloc;
+  return size;
+}
+
+void bgpstream_lpm_destroy(bgpstream_lpm_t *lpm)
+{
+  if (lpm == NULL) {
+    return;
+  }
+  lpm_table_free(&lpm->v4);
+  lpm_table_free(&lpm->v6);
+  free(lpm->pfxs);
+  free(lpm);
+}
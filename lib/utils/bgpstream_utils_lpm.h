@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_UTILS_LPM_H
+#define __BGPSTREAM_UTILS_LPM_H
+
+#include <stdint.h>
+
+#include "bgpstream_utils_addr.h"
+#include "bgpstream_utils_patricia.h"
+#include "bgpstream_utils_pfx.h"
+#include "bgpstream_utils_pfx_set.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of the BGP Stream
+ * longest prefix match (LPM) tables: read-only tables, built from a set of
+ * prefixes, that map IP addresses to the most specific prefix that covers
+ * them.
+ *
+ * Prefixes are added (directly, or from a Patricia Tree or a prefix set), and
+ * the table is then built. Lookups give the index of the matching prefix, from
+ * which the prefix itself and the user pointer it was added with can be
+ * retrieved.
+ */
+
+/**
+ * @name Public Constants
+ *
+ * @{ */
+
+/** Index returned by lookups of addresses that no prefix covers */
+#define BGPSTREAM_LPM_NONE UINT32_MAX
+
+/** @} */
+
+/**
+ * @name Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure containing an LPM table instance */
+typedef struct bgpstream_lpm bgpstream_lpm_t;
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new, empty, LPM table
+ *
+ * @return a pointer to the table, or NULL if an error occurred
+ */
+bgpstream_lpm_t *bgpstream_lpm_create(void);
+
+/** Add a prefix to the table
+ *
+ * @param lpm           pointer to the table
+ * @param pfx           pointer to the prefix to add
+ * @param user          user pointer to associate with the prefix
+ * @return 0 if the prefix was added successfully, -1 otherwise
+ *
+ * The prefix is only matched by lookups once the table is (re)built. If the
+ * same prefix is added more than once, lookups give the one added last.
+ */
+int bgpstream_lpm_add(bgpstream_lpm_t *lpm, const bgpstream_pfx_t *pfx,
+                      void *user);
+
+/** Add every prefix of a Patricia Tree to the table, with the user pointer of
+ * its node
+ *
+ * @param lpm           pointer to the table
+ * @param pt            pointer to the patricia tree
+ * @return 0 if the prefixes were added successfully, -1 otherwise
+ */
+int bgpstream_lpm_add_patricia(bgpstream_lpm_t *lpm,
+                               const bgpstream_patricia_tree_t *pt);
+
+/** Add every prefix of a prefix set to the table, with a NULL user pointer
+ *
+ * @param lpm           pointer to the table
+ * @param set           pointer to the prefix set
+ * @return 0 if the prefixes were added successfully, -1 otherwise
+ */
+int bgpstream_lpm_add_pfx_set(bgpstream_lpm_t *lpm, bgpstream_pfx_set_t *set);
+
+/** Build the lookup tables from the prefixes added so far
+ *
+ * @param lpm           pointer to the table
+ * @return 0 if the table was built successfully, -1 otherwise
+ *
+ * Any previous build is replaced. Once built, the table may be looked up from
+ * any number of threads at once.
+ */
+int bgpstream_lpm_build(bgpstream_lpm_t *lpm);
+
+/** Get the number of prefixes added to the table
+ *
+ * @param lpm           pointer to the table
+ * @return the number of prefixes
+ */
+uint32_t bgpstream_lpm_get_pfx_cnt(const bgpstream_lpm_t *lpm);
+
+/** Get a prefix of the table
+ *
+ * @param lpm           pointer to the table
+ * @param idx           index of the prefix, as returned by a lookup
+ * @return a pointer to the prefix
+ */
+const bgpstream_pfx_t *bgpstream_lpm_get_pfx(const bgpstream_lpm_t *lpm,
+                                             uint32_t idx);
+
+/** Get the user pointer of a prefix of the table
+ *
+ * @param lpm           pointer to the table
+ * @param idx           index of the prefix, as returned by a lookup
+ * @return the user pointer the prefix was added with
+ */
+void *bgpstream_lpm_get_user(const bgpstream_lpm_t *lpm, uint32_t idx);
+
+/** Find the most specific prefix that covers an address
+ *
+ * @param lpm           pointer to the (built) table
+ * @param addr          pointer to the address to look up
+ * @return the index of the prefix, or BGPSTREAM_LPM_NONE if no prefix covers
+ * the address
+ */
+uint32_t bgpstream_lpm_lookup(const bgpstream_lpm_t *lpm,
+                              const bgpstream_ip_addr_t *addr);
+
+/** Find the most specific prefixes that cover many addresses
+ *
+ * @param lpm           pointer to the (built) table
+ * @param addrs         array of addresses to look up (IPv4 and IPv6 may be
+ *                      mixed)
+ * @param cnt           number of addresses in the array
+ * @param results       array of cnt indexes, filled with the result of each
+ *                      lookup (as returned by bgpstream_lpm_lookup)
+ *
+ * The lookups are interleaved, so that the memory accesses of one overlap with
+ * those of the others, which is much faster than looking up the addresses one
+ * at a time.
+ */
+void bgpstream_lpm_lookup_batch(const bgpstream_lpm_t *lpm,
+                                const bgpstream_ip_addr_t *addrs, int cnt,
+                                uint32_t *results);
+
+/** Find the most specific prefixes that cover many IPv4 addresses
+ *
+ * @param lpm           pointer to the (built) table
+ * @param addrs         array of IPv4 addresses (in network byte order, as in
+ *                      struct in_addr) to look up
+ * @param cnt           number of addresses in the array
+ * @param results       array of cnt indexes, filled with the result of each
+ *                      lookup (as returned by bgpstream_lpm_lookup)
+ */
+void bgpstream_lpm_lookup_ipv4_batch(const bgpstream_lpm_t *lpm,
+                                     const uint32_t *addrs, int cnt,
+                                     uint32_t *results);
+
+/** Get the memory used by the lookup tables
+ *
+ * @param lpm           pointer to the table
+ * @return the number of bytes used
+ */
+size_t bgpstream_lpm_get_mem_size(const bgpstream_lpm_t *lpm);
+
+/** Destroy the given LPM table
+ *
+ * @param lpm           pointer to the table to destroy
+ */
+void bgpstream_lpm_destroy(bgpstream_lpm_t *lpm);
+
+/** @} */
+
+#endif /* __BGPSTREAM_UTILS_LPM_H */
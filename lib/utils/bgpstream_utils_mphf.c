@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bgpstream_utils_mphf_int.h"
+
+/* PRIVATE */
+
+/* number of seeds to try before giving up */
+#define MAX_SEEDS 16
+
+/* number of displacements to try for a bucket before changing the seed */
+#define MAX_DISP (1 << 16)
+
+static int bucket_cmp(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? 1 : (x > y ? -1 : 0);
+}
+
+// place the keys of a bucket. returns 0 if they were placed, 1 if no
+// displacement was found, and -1 if two keys have the same hash
+static int place_bucket(bs_mphf_t *f, uint32_t bucket, const uint64_t *xs,
+                        uint32_t cnt, uint8_t *taken, uint32_t *slots)
+{
+  uint32_t d, i, j;
+
+  for (i = 1; i < cnt; i++) {
+    for (j = 0; j < i; j++) {
+      if (xs[i] == xs[j]) {
+        return -1;
+      }
+    }
+  }
+
+  for (d = 0; d < MAX_DISP; d++) {
+    for (i = 0; i < cnt; i++) {
+      slots[i] = bs_mphf_displace(xs[i], d, f->n);
+      if (taken[slots[i]] != 0) {
+        break;
+      }
+      for (j = 0; j < i && slots[j] != slots[i]; j++)
+        ;
+      if (j < i) {
+        break;
+      }
+    }
+    if (i == cnt) {
+      for (i = 0; i < cnt; i++) {
+        taken[slots[i]] = 1;
+      }
+      f->disp[bucket] = d;
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// try to build the function with the current seed. returns as
+// place_bucket does
+static int try_seed(bs_mphf_t *f, const uint64_t *hashes, uint64_t *xs,
+                    uint32_t *start, uint64_t *order, uint8_t *taken,
+                    uint32_t *slots)
+{
+  uint32_t i, b, cnt, free_slot = 0;
+  uint64_t x;
+  int rc;
+
+  // sort the mixed hashes by bucket
+  memset(start, 0, sizeof(uint32_t) * (f->buckets_cnt + 1));
+  for (i = 0; i < f->n; i++) {
+    start[bs_mphf_reduce(bs_mphf_mix(hashes[i] ^ f->seed), f->buckets_cnt) +
+          1]++;
+  }
+  for (b = 0; b < f->buckets_cnt; b++) {
+    order[b] = ((uint64_t)start[b + 1] << 32) | b;
+    start[b + 1] += start[b];
+  }
+  for (i = 0; i < f->n; i++) {
+    x = bs_mphf_mix(hashes[i] ^ f->seed);
+    b = bs_mphf_reduce(x, f->buckets_cnt);
+    // keys are filled in from the end of their bucket, which leaves
+    // start[b + 1] as the first index of bucket b once all keys are in
+    xs[--start[b + 1]] = x;
+  }
+
+  // place the largest buckets first, while there is most room
+  qsort(order, f->buckets_cnt, sizeof(uint64_t), bucket_cmp);
+  memset(taken, 0, f->n);
+  for (i = 0; i < f->buckets_cnt; i++) {
+    b = (uint32_t)order[i];
+    cnt = order[i] >> 32;
+    if (cnt == 0) {
+      f->disp[b] = 0;
+    } else if (cnt == 1) {
+      while (taken[free_slot] != 0) {
+        free_slot++;
+      }
+      taken[free_slot] = 1;
+      f->disp[b] = BS_MPHF_DIRECT | free_slot;
+    } else if ((rc = place_bucket(f, b, &xs[start[b + 1]], cnt, taken,
+                                  slots)) != 0) {
+      return rc;
+    }
+  }
+  return 0;
+}
+
+/* PUBLIC FUNCTIONS */
+
+int bs_mphf_build(bs_mphf_t *f, const uint64_t *hashes, uint32_t n)
+{
+  uint64_t *xs = NULL, *order = NULL;
+  uint32_t *start = NULL, *slots = NULL;
+  uint8_t *taken = NULL;
+  int rc = -1, i;
+
+  memset(f, 0, sizeof(*f));
+  if (n == 0 || n >= BS_MPHF_DIRECT) {
+    return 1;
+  }
+  f->n = n;
+  f->buckets_cnt = n / 4 + 1;
+
+  if ((f->disp = malloc(sizeof(uint32_t) * f->buckets_cnt)) == NULL ||
+      (xs = malloc(sizeof(uint64_t) * n)) == NULL ||
+      (order = malloc(sizeof(uint64_t) * f->buckets_cnt)) == NULL ||
+      (start = malloc(sizeof(uint32_t) * (f->buckets_cnt + 1))) == NULL ||
+      (slots = malloc(sizeof(uint32_t) * n)) == NULL ||
+      (taken = malloc(n)) == NULL) {
+    goto done;
+  }
+
+  rc = 1;
+  for (i = 0; i < MAX_SEEDS && rc == 1; i++) {
+    f->seed = bs_mphf_mix(i + 1);
+    rc = try_seed(f, hashes, xs, start, order, taken, slots);
+  }
+  if (rc < 0) {
+    // duplicate hashes, no seed will help
+    rc = 1;
+  }
+
+done:
+  if (rc != 0) {
+    bs_mphf_destroy(f);
+  }
+  free(xs);
+  free(order);
+  free(start);
+  free(slots);
+  free(taken);
+  return rc;
+}
+
+void bs_mphf_destroy(bs_mphf_t *f)
+{
+  free(f->disp);
+  f->disp = NULL;
+  f->n = f->buckets_cnt = 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_UTILS_MPHF_INT_H
+#define __BGPSTREAM_UTILS_MPHF_INT_H
+
+#include <stdint.h>
+
+/** @file
+ *
+ * @brief Header file that exposes the private interface of BGP Stream minimal
+ * perfect hash functions, used to freeze sets that no longer change
+ *
+ * The function is built over the (distinct) 64-bit hashes of a set of n keys
+ * and maps each of them to its own slot in [0, n), using the "hash and
+ * displace" scheme: keys are spread over about n/4 buckets, and each bucket
+ * gets a displacement that sends all its keys to free slots (buckets with a
+ * single key get their slot directly). Looking a key up costs two hash mixes
+ * and one read of the displacement array; other keys map to an arbitrary
+ * slot, so the caller must compare the key stored in it.
+ */
+
+/**
+ * @name Private Constants
+ *
+ * @{ */
+
+/** Displacement flag marking a bucket whose only key is in the given slot */
+#define BS_MPHF_DIRECT 0x80000000U
+
+/** @} */
+
+/**
+ * @name Private Data Structures
+ *
+ * @{ */
+
+/** Minimal perfect hash function */
+typedef struct bs_mphf {
+
+  /** Number of keys (and slots) */
+  uint32_t n;
+
+  /** Number of buckets */
+  uint32_t buckets_cnt;
+
+  /** Seed the function was built with */
+  uint64_t seed;
+
+  /** Displacement of each bucket */
+  uint32_t *disp;
+
+} bs_mphf_t;
+
+/** @} */
+
+/**
+ * @name Private API Functions
+ *
+ * @{ */
+
+/** Mix the bits of a 64-bit hash (the murmur3 finalizer) */
+static inline uint64_t bs_mphf_mix(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+/** Map the high 32 bits of a mixed hash to [0, n) */
+static inline uint32_t bs_mphf_reduce(uint64_t x, uint32_t n)
+{
+  return (uint32_t)(((x >> 32) * (uint64_t)n) >> 32);
+}
+
+/** Get the slot of the given displacement for a key */
+static inline uint32_t bs_mphf_displace(uint64_t x, uint32_t d, uint32_t n)
+{
+  return bs_mphf_reduce(
+    bs_mphf_mix(x ^ ((uint64_t)(d + 1) * 0x9E3779B97F4A7C15ULL)), n);
+}
+
+/** Build a minimal perfect hash function
+ *
+ * @param f             pointer to the function to build
+ * @param hashes        array of the hashes of the keys
+ * @param n             number of hashes (must be at least 1)
+ * @return 0 if the function was built, 1 if it could not be (e.g. because
+ * two hashes are equal), -1 if an error occurred
+ */
+int bs_mphf_build(bs_mphf_t *f, const uint64_t *hashes, uint32_t n);
+
+/** Get the slot of the key with the given hash
+ *
+ * @param f             pointer to the function
+ * @param hash          the hash of the key
+ * @return the slot of the key if it was one of the keys the function was
+ * built over, some slot in [0, n) otherwise
+ */
+static inline uint32_t bs_mphf_slot(const bs_mphf_t *f, uint64_t hash)
+{
+  uint64_t x = bs_mphf_mix(hash ^ f->seed);
+  uint32_t d = f->disp[bs_mphf_reduce(x, f->buckets_cnt)];
+
+  if ((d & BS_MPHF_DIRECT) != 0) {
+    return d & ~BS_MPHF_DIRECT;
+  }
+  return bs_mphf_displace(x, d, f->n);
+}
+
+/** Free the memory used by a function
+ *
+ * @param f             pointer to the function
+ */
+void bs_mphf_destroy(bs_mphf_t *f);
+
+/** @} */
+
+#endif /* __BGPSTREAM_UTILS_MPHF_INT_H */
@@ -0,0 +1,619 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+#include "bgpstream_log.h"
+#include "bgpstream_utils_as_path.h"
+#include "bgpstream_utils_origins.h"
+#include "bgpstream_utils_patricia.h"
+
+/* Longest collector name used to tell peers apart: "<collector>/<router>" */
+#define ORIGINS_COLL_KEY_LEN (BGPSTREAM_UTILS_STR_NAME_LEN * 2)
+
+/* Peers whose bits fit in one word, which is then kept inline */
+#define ORIGINS_WORD_BITS 64
+
+/* An origin of a prefix, and the peers that announce it, as one bit per peer
+ * ID */
+typedef struct origin {
+
+  uint32_t asn;
+
+  /* number of 64-bit words of peer bits (1 if they are inline) */
+  uint32_t words_cnt;
+
+  union {
+    uint64_t one;
+    uint64_t *many;
+  } peers;
+
+} origin_t;
+
+/* The origins of a prefix, stored as the user pointer of its patricia node.
+ * A single origin is kept inline */
+typedef struct pfx_origins {
+
+  uint32_t cnt;
+
+  union {
+    origin_t one;
+    origin_t *many;
+  } o;
+
+} pfx_origins_t;
+
+struct bgpstream_origins {
+
+  /* announced prefixes, with their origins */
+  bgpstream_patricia_tree_t *pt;
+
+  /* IDs of the peers */
+  bgpstream_peer_sig_map_t *peer_sigs;
+
+  /* number of routes of each peer (indexed by peer ID) */
+  uint32_t *peer_routes;
+  uint32_t peer_routes_alloc_cnt;
+
+  uint64_t pfx_cnt;
+  uint64_t moas_cnt;
+
+  bgpstream_origins_event_cb_t *cb;
+  void *user;
+};
+
+/* State of withdraw_peer: the changes to report, and the prefixes left with
+ * no origins */
+typedef struct withdraw {
+  bgpstream_origins_t *origins;
+  bgpstream_origins_event_t event;
+  bgpstream_pfx_t *empty;
+  uint32_t empty_cnt;
+  uint32_t empty_alloc_cnt;
+  int err;
+} withdraw_t;
+
+static inline uint64_t *origin_words(origin_t *o)
+{
+  return o->words_cnt == 1 ? &o->peers.one : o->peers.many;
+}
+
+static inline origin_t *pfx_origin(pfx_origins_t *po, uint32_t i)
+{
+  return po->cnt == 1 ? &po->o.one : &po->o.many[i];
+}
+
+static int origin_has_peer(origin_t *o, bgpstream_peer_id_t peer_id)
+{
+  uint32_t w = peer_id / ORIGINS_WORD_BITS;
+
+  return w < o->words_cnt &&
+         (origin_words(o)[w] >> (peer_id % ORIGINS_WORD_BITS) & 1) != 0;
+}
+
+static int origin_set_peer(origin_t *o, bgpstream_peer_id_t peer_id)
+{
+  uint32_t w = peer_id / ORIGINS_WORD_BITS;
+  uint64_t *words;
+
+  if (w >= o->words_cnt) {
+    if ((words = malloc_zero(sizeof(uint64_t) * (w + 1))) == NULL) {
+      return -1;
+    }
+    memcpy(words, origin_words(o), sizeof(uint64_t) * o->words_cnt);
+    if (o->words_cnt > 1) {
+      free(o->peers.many);
+    }
+    o->peers.many = words;
+    o->words_cnt = w + 1;
+  }
+  origin_words(o)[w] |= (uint64_t)1 << (peer_id % ORIGINS_WORD_BITS);
+  return 0;
+}
+
+/* returns 1 if no peer announces the origin anymore */
+static int origin_clear_peer(origin_t *o, bgpstream_peer_id_t peer_id)
+{
+  uint64_t *words = origin_words(o);
+  uint32_t i;
+
+  words[peer_id / ORIGINS_WORD_BITS] &=
+    ~((uint64_t)1 << (peer_id % ORIGINS_WORD_BITS));
+  for (i = 0; i < o->words_cnt; i++) {
+    if (words[i] != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void origin_free(origin_t *o)
+{
+  if (o->words_cnt > 1) {
+    free(o->peers.many);
+  }
+}
+
+static void pfx_origins_destroy(void *user)
+{
+  pfx_origins_t *po = user;
+  uint32_t i;
+
+  if (po == NULL) {
+    return;
+  }
+  for (i = 0; i < po->cnt; i++) {
+    origin_free(pfx_origin(po, i));
+  }
+  if (po->cnt > 1) {
+    free(po->o.many);
+  }
+  free(po);
+}
+
+/* returns the index of the origin that the peer announces, -1 if none */
+static int find_peer(pfx_origins_t *po, bgpstream_peer_id_t peer_id)
+{
+  uint32_t i;
+
+  for (i = 0; i < po->cnt; i++) {
+    if (origin_has_peer(pfx_origin(po, i), peer_id)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static int find_origin(pfx_origins_t *po, uint32_t asn)
+{
+  uint32_t i;
+
+  for (i = 0; i < po->cnt; i++) {
+    if (pfx_origin(po, i)->asn == asn) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* add an origin with no peers at the end of the origins */
+static origin_t *add_origin(bgpstream_origins_t *origins, pfx_origins_t *po,
+                            uint32_t asn)
+{
+  origin_t *many;
+
+  if (po->cnt == 0) {
+    po->cnt = 1;
+  } else {
+    if ((many = realloc(po->cnt == 1 ? NULL : po->o.many,
+                        sizeof(origin_t) * (po->cnt + 1))) == NULL) {
+      return NULL;
+    }
+    if (po->cnt == 1) {
+      many[0] = po->o.one;
+      origins->moas_cnt++;
+    }
+    po->o.many = many;
+    po->cnt++;
+  }
+  many = pfx_origin(po, po->cnt - 1);
+  memset(many, 0, sizeof(origin_t));
+  many->asn = asn;
+  many->words_cnt = 1;
+  return many;
+}
+
+static void remove_origin(bgpstream_origins_t *origins, pfx_origins_t *po,
+                          uint32_t i)
+{
+  origin_t *many = po->o.many;
+
+  origin_free(pfx_origin(po, i));
+  if (po->cnt == 1) {
+    po->cnt = 0;
+    return;
+  }
+  memmove(&many[i], &many[i + 1], sizeof(origin_t) * (po->cnt - i - 1));
+  po->cnt--;
+  if (po->cnt == 1) {
+    po->o.one = many[0];
+    free(many);
+    origins->moas_cnt--;
+  }
+}
+
+static int emit(bgpstream_origins_t *origins, bgpstream_origins_event_t *event)
+{
+  if (origins->cb != NULL && origins->cb(event, origins->user) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Origin change callback failed");
+    return -1;
+  }
+  return 0;
+}
+
+static int count_peer_route(bgpstream_origins_t *origins,
+                            bgpstream_peer_id_t peer_id, int delta)
+{
+  uint32_t *routes, alloc_cnt;
+
+  if (peer_id >= origins->peer_routes_alloc_cnt) {
+    alloc_cnt = peer_id * 2 + 1;
+    if (alloc_cnt > (uint32_t)UINT16_MAX + 1) {
+      alloc_cnt = (uint32_t)UINT16_MAX + 1;
+    }
+    if ((routes = realloc(origins->peer_routes,
+                          sizeof(uint32_t) * alloc_cnt)) == NULL) {
+      return -1;
+    }
+    memset(&routes[origins->peer_routes_alloc_cnt], 0,
+           sizeof(uint32_t) * (alloc_cnt - origins->peer_routes_alloc_cnt));
+    origins->peer_routes = routes;
+    origins->peer_routes_alloc_cnt = alloc_cnt;
+  }
+  origins->peer_routes[peer_id] += delta;
+  return 0;
+}
+
+static bgpstream_patricia_walk_cb_result_t
+find_covering(const bgpstream_patricia_tree_t *pt,
+              const bgpstream_patricia_node_t *node, void *data)
+{
+  bgpstream_pfx_copy(data, bgpstream_patricia_tree_get_pfx(node));
+  return BGPSTREAM_PATRICIA_WALK_END_ALL;
+}
+
+/* Set the origin of a peer for a prefix */
+static int announce(bgpstream_origins_t *origins,
+                    bgpstream_origins_event_t *event, uint32_t asn)
+{
+  bgpstream_patricia_node_t *node;
+  pfx_origins_t *po;
+  uint32_t old_asn = 0;
+  int old, created = 0, new_pfx = 0;
+
+  if ((node = bgpstream_patricia_tree_search_exact(origins->pt,
+                                                   &event->pfx)) == NULL) {
+    if ((node = bgpstream_patricia_tree_insert(origins->pt, &event->pfx)) ==
+        NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Could not insert origin prefix");
+      return -1;
+    }
+  }
+  if ((po = bgpstream_patricia_tree_get_user(node)) == NULL) {
+    if ((po = malloc_zero(sizeof(pfx_origins_t))) == NULL) {
+      return -1;
+    }
+    bgpstream_patricia_tree_set_user(origins->pt, node, po);
+    origins->pfx_cnt++;
+    new_pfx = 1;
+  }
+
+  if ((old = find_peer(po, event->peer_id)) >= 0) {
+    if ((old_asn = pfx_origin(po, old)->asn) == asn) {
+      return 0;
+    }
+  } else if (count_peer_route(origins, event->peer_id, 1) != 0) {
+    return -1;
+  }
+
+  // the new origin is added before the old one is removed, so that the
+  // prefix never looks unannounced
+  if (find_origin(po, asn) < 0) {
+    if (add_origin(origins, po, asn) == NULL) {
+      return -1;
+    }
+    created = 1;
+  }
+  if (origin_set_peer(pfx_origin(po, find_origin(po, asn)), event->peer_id) !=
+      0) {
+    return -1;
+  }
+  if (old >= 0 && origin_clear_peer(pfx_origin(po, old), event->peer_id)) {
+    remove_origin(origins, po, old);
+  } else {
+    old = -1;
+  }
+
+  event->origins_cnt = po->cnt;
+  if (created) {
+    event->origin = asn;
+    event->type = BGPSTREAM_ORIGINS_EVENT_NEW_ORIGIN;
+    if (new_pfx) {
+      event->type = BGPSTREAM_ORIGINS_EVENT_NEW_PFX;
+      memset(&event->covering, 0, sizeof(event->covering));
+      bgpstream_patricia_tree_walk_less_specifics(origins->pt, node,
+                                                  find_covering,
+                                                  &event->covering);
+      if (event->covering.address.version != BGPSTREAM_ADDR_VERSION_UNKNOWN) {
+        event->type = BGPSTREAM_ORIGINS_EVENT_NEW_SUBPFX;
+      }
+    }
+    if (emit(origins, event) != 0) {
+      return -1;
+    }
+  }
+  if (old >= 0) {
+    event->origin = old_asn;
+    event->type = BGPSTREAM_ORIGINS_EVENT_ORIGIN_WITHDRAWN;
+    if (emit(origins, event) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* Remove the origin of a peer for a prefix (from a node that has origins).
+ * Returns 1 if the origin was removed, 0 if the peer had no route, or -1 if
+ * the callback failed. The node is left with no origins if the peer was the
+ * last one to announce it */
+static int withdraw_node(bgpstream_origins_t *origins,
+                         bgpstream_origins_event_t *event, pfx_origins_t *po)
+{
+  int old;
+
+  if ((old = find_peer(po, event->peer_id)) < 0) {
+    return 0;
+  }
+  origins->peer_routes[event->peer_id]--;
+  if (!origin_clear_peer(pfx_origin(po, old), event->peer_id)) {
+    return 1;
+  }
+  event->origin = pfx_origin(po, old)->asn;
+  remove_origin(origins, po, old);
+  if (po->cnt == 0) {
+    origins->pfx_cnt--;
+  }
+  event->type = BGPSTREAM_ORIGINS_EVENT_ORIGIN_WITHDRAWN;
+  event->origins_cnt = po->cnt;
+  return emit(origins, event) != 0 ? -1 : 1;
+}
+
+static int withdraw(bgpstream_origins_t *origins,
+                    bgpstream_origins_event_t *event)
+{
+  bgpstream_patricia_node_t *node;
+  pfx_origins_t *po;
+  int rc;
+
+  if ((node = bgpstream_patricia_tree_search_exact(origins->pt,
+                                                   &event->pfx)) == NULL ||
+      (po = bgpstream_patricia_tree_get_user(node)) == NULL) {
+    return 0;
+  }
+  rc = withdraw_node(origins, event, po);
+  if (po->cnt == 0) {
+    bgpstream_patricia_tree_remove_node(origins->pt, node);
+  }
+  return rc < 0 ? -1 : 0;
+}
+
+static bgpstream_patricia_walk_cb_result_t
+withdraw_peer_node(const bgpstream_patricia_tree_t *pt,
+                   const bgpstream_patricia_node_t *node, void *data)
+{
+  withdraw_t *wd = data;
+  pfx_origins_t *po =
+    bgpstream_patricia_tree_get_user(bgpstream_nonconst_node(node));
+  bgpstream_pfx_t *empty;
+  uint32_t alloc_cnt;
+
+  if (po == NULL) {
+    return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+  }
+  bgpstream_pfx_copy(&wd->event.pfx, bgpstream_patricia_tree_get_pfx(node));
+  if (withdraw_node(wd->origins, &wd->event, po) < 0) {
+    wd->err = 1;
+    return BGPSTREAM_PATRICIA_WALK_END_ALL;
+  }
+
+  if (po->cnt == 0) {
+    if (wd->empty_cnt == wd->empty_alloc_cnt) {
+      alloc_cnt = wd->empty_alloc_cnt * 2 + 64;
+      if ((empty = realloc(wd->empty, sizeof(bgpstream_pfx_t) * alloc_cnt)) ==
+          NULL) {
+        // the prefix is left in the tree, with no origins
+        return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+      }
+      wd->empty = empty;
+      wd->empty_alloc_cnt = alloc_cnt;
+    }
+    bgpstream_pfx_copy(&wd->empty[wd->empty_cnt++], &wd->event.pfx);
+  }
+  return wd->origins->peer_routes[wd->event.peer_id] == 0
+           ? BGPSTREAM_PATRICIA_WALK_END_ALL
+           : BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+/* Withdraw every route of a peer */
+static int withdraw_peer(bgpstream_origins_t *origins,
+                         bgpstream_origins_event_t *event)
+{
+  withdraw_t wd;
+  uint32_t i;
+
+  if (event->peer_id >= origins->peer_routes_alloc_cnt ||
+      origins->peer_routes[event->peer_id] == 0) {
+    return 0;
+  }
+  memset(&wd, 0, sizeof(wd));
+  wd.origins = origins;
+  wd.event = *event;
+  bgpstream_patricia_tree_walk(origins->pt, withdraw_peer_node, &wd);
+
+  for (i = 0; i < wd.empty_cnt; i++) {
+    bgpstream_patricia_tree_remove(origins->pt, &wd.empty[i]);
+  }
+  free(wd.empty);
+
+  return wd.err ? -1 : 0;
+}
+
+/* ========== PUBLIC FUNCTIONS ========== */
+
+bgpstream_origins_t *bgpstream_origins_create(bgpstream_origins_event_cb_t *cb,
+                                              void *user)
+{
+  bgpstream_origins_t *origins;
+
+  if ((origins = malloc_zero(sizeof(bgpstream_origins_t))) == NULL) {
+    return NULL;
+  }
+  if ((origins->pt = bgpstream_patricia_tree_create(pfx_origins_destroy)) ==
+        NULL ||
+      (origins->peer_sigs = bgpstream_peer_sig_map_create()) == NULL) {
+    bgpstream_origins_destroy(origins);
+    return NULL;
+  }
+  origins->cb = cb;
+  origins->user = user;
+  return origins;
+}
+
+void bgpstream_origins_destroy(bgpstream_origins_t *origins)
+{
+  if (origins == NULL) {
+    return;
+  }
+  bgpstream_patricia_tree_destroy(origins->pt);
+  bgpstream_peer_sig_map_destroy(origins->peer_sigs);
+  free(origins->peer_routes);
+  free(origins);
+}
+
+void bgpstream_origins_clear(bgpstream_origins_t *origins)
+{
+  // peer IDs are kept, so that they stay valid
+  bgpstream_patricia_tree_clear(origins->pt);
+  if (origins->peer_routes_alloc_cnt != 0) {
+    memset(origins->peer_routes, 0,
+           sizeof(uint32_t) * origins->peer_routes_alloc_cnt);
+  }
+  origins->pfx_cnt = origins->moas_cnt = 0;
+}
+
+int bgpstream_origins_add_elem(bgpstream_origins_t *origins,
+                               const bgpstream_record_t *record,
+                               bgpstream_elem_t *elem)
+{
+  bgpstream_origins_event_t event;
+  bgpstream_as_path_t *path;
+  char key[ORIGINS_COLL_KEY_LEN];
+  uint32_t asn;
+
+  memset(&event, 0, sizeof(event));
+  event.time = record->time_sec;
+  if (record->router_name[0] == '\0') {
+    event.peer_id = bgpstream_peer_sig_map_get_id_cached(
+      origins->peer_sigs, record->collector_id, record->collector_name,
+      &elem->peer_ip, elem->peer_asn);
+  } else {
+    snprintf(key, sizeof(key), "%s/%s", record->collector_name,
+             record->router_name);
+    event.peer_id = bgpstream_peer_sig_map_get_id(
+      origins->peer_sigs, key, &elem->peer_ip, elem->peer_asn);
+  }
+  if (event.peer_id == 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not get the ID of a peer");
+    return -1;
+  }
+
+  switch (elem->type) {
+  case BGPSTREAM_ELEM_TYPE_RIB:
+  case BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT:
+    bgpstream_pfx_copy(&event.pfx, &elem->prefix);
+    if ((path = bgpstream_elem_get_as_path(elem)) != NULL &&
+        bgpstream_as_path_get_origin_val(path, &asn) == 0) {
+      return announce(origins, &event, asn);
+    }
+    return withdraw(origins, &event);
+
+  case BGPSTREAM_ELEM_TYPE_WITHDRAWAL:
+    bgpstream_pfx_copy(&event.pfx, &elem->prefix);
+    return withdraw(origins, &event);
+
+  case BGPSTREAM_ELEM_TYPE_PEERSTATE:
+    if (elem->new_state == BGPSTREAM_ELEM_PEERSTATE_ESTABLISHED) {
+      return 0;
+    }
+    return withdraw_peer(origins, &event);
+
+  default:
+    return 0;
+  }
+}
+
+int bgpstream_origins_add_record(bgpstream_origins_t *origins,
+                                 bgpstream_record_t *record)
+{
+  bgpstream_elem_t *elem;
+  int rc;
+
+  while ((rc = bgpstream_record_get_next_elem(record, &elem)) > 0) {
+    if (bgpstream_origins_add_elem(origins, record, elem) != 0) {
+      return -1;
+    }
+  }
+  return rc < 0 ? -1 : 0;
+}
+
+int bgpstream_origins_get(bgpstream_origins_t *origins,
+                          const bgpstream_pfx_t *pfx, uint32_t *asns, int len)
+{
+  bgpstream_patricia_node_t *node;
+  pfx_origins_t *po;
+  uint32_t i;
+
+  if ((node = bgpstream_patricia_tree_search_exact(origins->pt, pfx)) ==
+        NULL ||
+      (po = bgpstream_patricia_tree_get_user(node)) == NULL) {
+    return 0;
+  }
+  for (i = 0; i < po->cnt && (int)i < len; i++) {
+    asns[i] = pfx_origin(po, i)->asn;
+  }
+  return po->cnt;
+}
+
+uint64_t bgpstream_origins_get_pfx_cnt(const bgpstream_origins_t *origins)
+{
+  return origins->pfx_cnt;
+}
+
+uint64_t bgpstream_origins_get_moas_cnt(const bgpstream_origins_t *origins)
+{
+  return origins->moas_cnt;
+}
+
+bgpstream_peer_sig_t *bgpstream_origins_get_peer_sig(
+  bgpstream_origins_t *origins, bgpstream_peer_id_t peer_id)
+{
+  return bgpstream_peer_sig_map_get_sig(origins->peer_sigs, peer_id);
+}
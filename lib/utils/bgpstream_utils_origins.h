@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_UTILS_ORIGINS_H
+#define __BGPSTREAM_UTILS_ORIGINS_H
+
+#include <stdint.h>
+
+#include "bgpstream_elem.h"
+#include "bgpstream_record.h"
+#include "bgpstream_utils_peer_sig_map.h"
+#include "bgpstream_utils_pfx.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of the BGP Stream
+ * origin monitor, which keeps the origin ASes of each announced prefix as
+ * elems arrive, and reports changes that hijack and MOAS (multiple origin AS)
+ * detection look for: a new prefix, a new more specific of an announced
+ * prefix, a new origin of a prefix, and an origin that is no longer announced.
+ *
+ * Each prefix is a node of a patricia tree, which holds the origins of the
+ * prefix and, for each origin, a bitmap of the peers that announce it. The
+ * common case of a single origin seen by fewer than 64 peers is kept inline,
+ * in 24 bytes per prefix. Each elem only updates the state of its own prefix
+ * (and looks at the less specific prefixes of new prefixes), so the monitor
+ * can follow a live stream without ever scanning its state, except when a
+ * peer goes down and all of its routes are withdrawn.
+ */
+
+/**
+ * @name Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure containing an origin monitor */
+typedef struct bgpstream_origins bgpstream_origins_t;
+
+/** @} */
+
+/**
+ * @name Public Enums
+ *
+ * @{ */
+
+/** Types of origin changes */
+typedef enum {
+
+  /** No peer announced the prefix, and no announced prefix covers it */
+  BGPSTREAM_ORIGINS_EVENT_NEW_PFX = 0,
+
+  /** No peer announced the prefix, but a less specific prefix is announced
+   * (e.g., a sub-prefix hijack, or deaggregation) */
+  BGPSTREAM_ORIGINS_EVENT_NEW_SUBPFX = 1,
+
+  /** An announced prefix has a new origin (e.g., it becomes MOAS) */
+  BGPSTREAM_ORIGINS_EVENT_NEW_ORIGIN = 2,
+
+  /** No peer announces the origin for the prefix anymore */
+  BGPSTREAM_ORIGINS_EVENT_ORIGIN_WITHDRAWN = 3,
+
+} bgpstream_origins_event_type_t;
+
+/** @} */
+
+/**
+ * @name Public Data Structures
+ *
+ * @{ */
+
+/** A change of the origins of a prefix */
+typedef struct bgpstream_origins_event {
+
+  bgpstream_origins_event_type_t type;
+
+  /** The time of the record of the elem that caused the change */
+  uint32_t time;
+
+  /** The ID of the peer whose elem caused the change (see
+   * bgpstream_origins_get_peer_sig) */
+  bgpstream_peer_id_t peer_id;
+
+  /** The prefix */
+  bgpstream_pfx_t pfx;
+
+  /** The origin that was announced or withdrawn */
+  uint32_t origin;
+
+  /** The number of origins of the prefix after the change (more than 1 if it
+   * is MOAS, 0 if it is no longer announced) */
+  int origins_cnt;
+
+  /** The most specific announced prefix that covers the prefix
+   * (BGPSTREAM_ORIGINS_EVENT_NEW_SUBPFX only, see bgpstream_origins_get for
+   * its origins) */
+  bgpstream_pfx_t covering;
+
+} bgpstream_origins_event_t;
+
+/** Callback for the changes found by an origin monitor
+ *
+ * @param event         the change, which is only valid until the callback
+ *                      returns
+ * @param user          the pointer given to bgpstream_origins_create
+ * @return 0 if successful, any other value to make the call that found the
+ * change fail
+ *
+ * The state of the monitor is up to date with the change when the callback is
+ * called, so it may query the monitor (e.g., with bgpstream_origins_get), but
+ * must not add elems to it.
+ */
+typedef int(bgpstream_origins_event_cb_t)(
+  const bgpstream_origins_event_t *event, void *user);
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new origin monitor
+ *
+ * @param cb            callback for the changes found (NULL to only keep the
+ *                      state)
+ * @param user          pointer to pass to the callback
+ * @return a pointer to the monitor if successful, NULL otherwise
+ */
+bgpstream_origins_t *bgpstream_origins_create(bgpstream_origins_event_cb_t *cb,
+                                              void *user);
+
+/** Destroy the given origin monitor
+ *
+ * @param origins       pointer to the monitor to destroy
+ */
+void bgpstream_origins_destroy(bgpstream_origins_t *origins);
+
+/** Forget every prefix of the given origin monitor (without reporting any
+ * change)
+ *
+ * @param origins       pointer to the monitor to clear
+ */
+void bgpstream_origins_clear(bgpstream_origins_t *origins);
+
+/** Add an elem to the given origin monitor
+ *
+ * @param origins       pointer to the monitor
+ * @param record        the record that the elem belongs to
+ * @param elem          the elem to add
+ * @return 0 if successful, -1 otherwise (including when the callback fails)
+ *
+ * RIB and announcement elems set the origin of their peer for their prefix
+ * (replacing the one it announced before), and withdrawals remove it. Routes
+ * whose origin is an AS set are treated as withdrawals. A peer state elem for
+ * a peer that leaves the established state withdraws every route of the peer.
+ * Peers are told apart by their collector (and router), address and ASN.
+ */
+int bgpstream_origins_add_elem(bgpstream_origins_t *origins,
+                               const bgpstream_record_t *record,
+                               bgpstream_elem_t *elem);
+
+/** Add the elems of a record to the given origin monitor
+ *
+ * @param origins       pointer to the monitor
+ * @param record        the record whose elems to add
+ * @return 0 if successful, -1 otherwise
+ *
+ * This reads the elems of the record (see bgpstream_record_get_next_elem), so
+ * callers that also need the elems should use bgpstream_origins_add_elem
+ * instead.
+ */
+int bgpstream_origins_add_record(bgpstream_origins_t *origins,
+                                 bgpstream_record_t *record);
+
+/** Get the origins of a prefix
+ *
+ * @param origins       pointer to the monitor
+ * @param pfx           the prefix
+ * @param[out] asns     filled with (up to len of) the origins of the prefix
+ * @param len           the number of ASNs that asns can hold
+ * @return the number of origins of the prefix (which may be more than len), 0
+ * if no peer announces it
+ */
+int bgpstream_origins_get(bgpstream_origins_t *origins,
+                          const bgpstream_pfx_t *pfx, uint32_t *asns, int len);
+
+/** Get the number of prefixes that the monitor knows the origins of
+ *
+ * @param origins       pointer to the monitor
+ * @return the number of announced prefixes
+ */
+uint64_t bgpstream_origins_get_pfx_cnt(const bgpstream_origins_t *origins);
+
+/** Get the number of prefixes with more than one origin
+ *
+ * @param origins       pointer to the monitor
+ * @return the number of MOAS prefixes
+ */
+uint64_t bgpstream_origins_get_moas_cnt(const bgpstream_origins_t *origins);
+
+/** Get the signature of a peer
+ *
+ * @param origins       pointer to the monitor
+ * @param peer_id       the ID of the peer (e.g., from an event)
+ * @return borrowed pointer to the signature of the peer, NULL if the ID is
+ * unknown
+ */
+bgpstream_peer_sig_t *bgpstream_origins_get_peer_sig(
+  bgpstream_origins_t *origins, bgpstream_peer_id_t peer_id);
+
+/** @} */
+
+#endif /* __BGPSTREAM_UTILS_ORIGINS_H */
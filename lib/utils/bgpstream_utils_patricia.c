@@ -43,8 +43,11 @@
 #include <assert.h>
 #include <limits.h>
 #include <netdb.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -59,6 +62,10 @@
 
 #define BGPSTREAM_PATRICIA_MAXBITS 128
 
+/* Number of nodes in each chunk that nodes are carved out of (64 KiB of
+ * 64-byte nodes) */
+#define BGPSTREAM_PATRICIA_CHUNK_NODES 1024
+
 // Test the n'th bit in the array of bytes starting at *p.
 // In byte 0, most significant bit is 0, least is 7.
 #define BIT_ARRAY_TEST(p, n) (((p)[(n) >> 3]) & (0x80 >> ((n) & 0x07)))
@@ -103,6 +110,19 @@ struct bgpstream_patricia_node {
   void *user;
 };
 
+/* Nodes are carved out of chunks of BGPSTREAM_PATRICIA_CHUNK_NODES nodes,
+ * rather than allocated one at a time. Chunks up to chunk_cur are in use
+ * (chunk_cur itself up to chunk_used), and removed nodes are kept on free_nodes
+ * (linked by l) until they are reused. Clearing the tree only resets these, so
+ * the chunks are reused by the next nodes inserted. */
+typedef struct bgpstream_patricia_node_pool {
+  bgpstream_patricia_node_t **chunks;
+  int chunks_cnt;
+  int chunk_cur;
+  int chunk_used;
+  bgpstream_patricia_node_t *free_nodes;
+} bgpstream_patricia_node_pool_t;
+
 struct bgpstream_patricia_tree {
 
   /* IPv4 tree */
@@ -115,6 +135,14 @@ struct bgpstream_patricia_tree {
   uint64_t ipv4_active_nodes;
   uint64_t ipv6_active_nodes;
 
+  /* Nodes of the IPv4 and IPv6 trees (see bgpstream_patricia_node_alloc), kept
+   * apart so that the two trees can be built at the same time */
+  bgpstream_patricia_node_pool_t pool4;
+  bgpstream_patricia_node_pool_t pool6;
+
+  /* Readers and retired nodes of a concurrent tree, NULL otherwise */
+  struct bpt_rcu *rcu;
+
   /** Pointer to a function that destroys the user structure
    *  in the bgpstream_patricia_node_t structure */
   bgpstream_patricia_tree_destroy_user_t *node_user_destructor;
@@ -174,6 +202,266 @@ static inline void bgpstream_patricia_tree_result_set_clear(
 
 /* ======================= PATRICIA NODE FUNCTIONS ======================= */
 
+#define bgpstream_patricia_get_pool(pt, v)                                    \
+  ((v) == BGPSTREAM_ADDR_VERSION_IPV6 ? &(pt)->pool6 : &(pt)->pool4)
+
+/* get a zeroed node (for a prefix of the given version), from the free list or
+ * the current chunk */
+static bgpstream_patricia_node_t *
+bgpstream_patricia_node_alloc(bgpstream_patricia_tree_t *pt,
+                              bgpstream_addr_version_t v)
+{
+  bgpstream_patricia_node_pool_t *pool = bgpstream_patricia_get_pool(pt, v);
+  bgpstream_patricia_node_t **chunks;
+  bgpstream_patricia_node_t *node;
+
+  if ((node = pool->free_nodes) != NULL) {
+    pool->free_nodes = node->l;
+    memset(node, 0, sizeof(bgpstream_patricia_node_t));
+    return node;
+  }
+
+  if (pool->chunks_cnt == 0 ||
+      pool->chunk_used == BGPSTREAM_PATRICIA_CHUNK_NODES) {
+    /* move on to the next chunk, which may be left from before a clear */
+    if (pool->chunks_cnt == 0 || pool->chunk_cur + 1 == pool->chunks_cnt) {
+      if ((chunks = realloc(pool->chunks, sizeof(bgpstream_patricia_node_t *) *
+                                            (pool->chunks_cnt + 1))) == NULL) {
+        return NULL;
+      }
+      pool->chunks = chunks;
+      if ((pool->chunks[pool->chunks_cnt] =
+             malloc(sizeof(bgpstream_patricia_node_t) *
+                    BGPSTREAM_PATRICIA_CHUNK_NODES)) == NULL) {
+        return NULL;
+      }
+      pool->chunks_cnt++;
+    }
+    if (pool->chunk_used != 0) {
+      pool->chunk_cur++;
+    }
+    pool->chunk_used = 0;
+  }
+
+  node = &pool->chunks[pool->chunk_cur][pool->chunk_used++];
+  memset(node, 0, sizeof(bgpstream_patricia_node_t));
+  return node;
+}
+
+/* give a node that has been unlinked from the tree back for reuse */
+static void bgpstream_patricia_node_free(bgpstream_patricia_tree_t *pt,
+                                         bgpstream_patricia_node_t *node)
+{
+  bgpstream_patricia_node_pool_t *pool =
+    bgpstream_patricia_get_pool(pt, node->prefix.address.version);
+
+  node->user = NULL;
+  node->l = pool->free_nodes;
+  pool->free_nodes = node;
+}
+
+/* destroy the user data of every node in use (free nodes have none), walking
+ * the chunks rather than the tree */
+static void
+bgpstream_patricia_pool_destroy_users(bgpstream_patricia_tree_t *pt,
+                                      bgpstream_patricia_node_pool_t *pool)
+{
+  bgpstream_patricia_node_t *chunk;
+  int i, j, cnt;
+
+  if (pt->node_user_destructor == NULL) {
+    return;
+  }
+  for (i = 0; i < pool->chunks_cnt && i <= pool->chunk_cur; i++) {
+    chunk = pool->chunks[i];
+    cnt =
+      (i == pool->chunk_cur) ? pool->chunk_used : BGPSTREAM_PATRICIA_CHUNK_NODES;
+    for (j = 0; j < cnt; j++) {
+      if (chunk[j].user != NULL) {
+        pt->node_user_destructor(chunk[j].user);
+        chunk[j].user = NULL;
+      }
+    }
+  }
+}
+
+/* every node of the pool goes at once, and the chunks are kept for the next
+ * ones */
+static void bgpstream_patricia_pool_clear(bgpstream_patricia_node_pool_t *pool)
+{
+  pool->chunk_cur = 0;
+  pool->chunk_used = 0;
+  pool->free_nodes = NULL;
+}
+
+static void bgpstream_patricia_pool_free(bgpstream_patricia_node_pool_t *pool)
+{
+  int i;
+
+  for (i = 0; i < pool->chunks_cnt; i++) {
+    free(pool->chunks[i]);
+  }
+  free(pool->chunks);
+  pool->chunks = NULL;
+  pool->chunks_cnt = 0;
+  bgpstream_patricia_pool_clear(pool);
+}
+
+/* ======================= CONCURRENT ACCESS ======================= */
+
+/* Readers of a concurrent tree follow the links of the tree without locking,
+ * and the single writer only ever changes a link once whatever it leads to is
+ * complete. Nodes and user data the writer takes out of the tree are retired
+ * rather than freed: each is tagged with the current epoch, and is only freed
+ * once no reader is still in a read-side section that started in that epoch
+ * or before (and so might still be looking at it). */
+
+/* load/store a field that readers of a concurrent tree may follow while the
+ * writer changes it */
+#define BPT_LOAD(field) __atomic_load_n(&(field), __ATOMIC_ACQUIRE)
+#define BPT_STORE(field, val) __atomic_store_n(&(field), (val), __ATOMIC_RELEASE)
+
+/* number of retired nodes and user data to wait for before trying to free
+ * them */
+#define BPT_RCU_RECLAIM_BATCH 64
+
+struct bgpstream_patricia_tree_reader {
+  bgpstream_patricia_tree_t *pt;
+
+  /* epoch in which the current read-side section started, 0 if outside of
+   * one */
+  uint64_t epoch;
+};
+
+typedef struct bpt_retired {
+  /* a node taken out of the tree, or NULL */
+  bgpstream_patricia_node_t *node;
+
+  /* user data to destroy, or NULL */
+  void *user;
+
+  uint64_t epoch;
+} bpt_retired_t;
+
+typedef struct bpt_rcu {
+  /* current epoch, which the writer moves on after each update */
+  uint64_t epoch;
+
+  /* registered readers (protected by readers_lock) */
+  pthread_mutex_t readers_lock;
+  bgpstream_patricia_tree_reader_t **readers;
+  int readers_cnt;
+
+  /* nodes and user data waiting to be freed, oldest first */
+  bpt_retired_t *retired;
+  int retired_cnt;
+  int retired_alloc;
+} bpt_rcu_t;
+
+/* the oldest epoch a reader is still in, or UINT64_MAX if none is */
+static uint64_t bpt_rcu_min_epoch(bpt_rcu_t *rcu)
+{
+  uint64_t min = UINT64_MAX, e;
+  int i;
+
+  /* make sure we see every reader that entered before our last update
+   * (pairs with the fence in bgpstream_patricia_tree_read_lock) */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  pthread_mutex_lock(&rcu->readers_lock);
+  for (i = 0; i < rcu->readers_cnt; i++) {
+    e = __atomic_load_n(&rcu->readers[i]->epoch, __ATOMIC_ACQUIRE);
+    if (e != 0 && e < min) {
+      min = e;
+    }
+  }
+  pthread_mutex_unlock(&rcu->readers_lock);
+  return min;
+}
+
+static void bpt_retired_free(bgpstream_patricia_tree_t *pt,
+                             bpt_retired_t *retired)
+{
+  if (retired->user != NULL && pt->node_user_destructor != NULL) {
+    pt->node_user_destructor(retired->user);
+  }
+  if (retired->node != NULL) {
+    bgpstream_patricia_node_free(pt, retired->node);
+  }
+}
+
+/* free whatever no reader can still be looking at */
+static void bpt_rcu_reclaim(bgpstream_patricia_tree_t *pt)
+{
+  bpt_rcu_t *rcu = pt->rcu;
+  uint64_t min = bpt_rcu_min_epoch(rcu);
+  int i;
+
+  for (i = 0; i < rcu->retired_cnt && rcu->retired[i].epoch < min; i++) {
+    bpt_retired_free(pt, &rcu->retired[i]);
+  }
+  memmove(rcu->retired, &rcu->retired[i],
+          sizeof(bpt_retired_t) * (rcu->retired_cnt - i));
+  rcu->retired_cnt -= i;
+}
+
+/* wait until no reader can still be looking at anything retired so far, and
+ * free it all */
+static void bpt_rcu_synchronize(bgpstream_patricia_tree_t *pt)
+{
+  bpt_rcu_t *rcu = pt->rcu;
+  uint64_t epoch = __atomic_add_fetch(&rcu->epoch, 1, __ATOMIC_SEQ_CST);
+
+  while (bpt_rcu_min_epoch(rcu) < epoch) {
+    sched_yield();
+  }
+  bpt_rcu_reclaim(pt);
+}
+
+/* free (once readers are done with them) a node that has been unlinked from
+ * the tree and/or user data that has been detached from its node */
+static void bpt_retire(bgpstream_patricia_tree_t *pt,
+                       bgpstream_patricia_node_t *node, void *user)
+{
+  bpt_rcu_t *rcu = pt->rcu;
+  bpt_retired_t *retired;
+  bpt_retired_t r = {node, user, 0};
+
+  if (rcu == NULL) {
+    bpt_retired_free(pt, &r);
+    return;
+  }
+
+  r.epoch = __atomic_load_n(&rcu->epoch, __ATOMIC_RELAXED);
+  if (rcu->retired_cnt == rcu->retired_alloc) {
+    if ((retired = realloc(rcu->retired, sizeof(bpt_retired_t) *
+                                           (rcu->retired_alloc * 2 + 16))) ==
+        NULL) {
+      /* no room to defer it, so wait for the readers */
+      bpt_rcu_synchronize(pt);
+      bpt_retired_free(pt, &r);
+      return;
+    }
+    rcu->retired = retired;
+    rcu->retired_alloc = rcu->retired_alloc * 2 + 16;
+  }
+  rcu->retired[rcu->retired_cnt++] = r;
+}
+
+/* called by the writer once an update is visible to readers */
+static void bpt_rcu_update_done(bgpstream_patricia_tree_t *pt)
+{
+  bpt_rcu_t *rcu = pt->rcu;
+
+  if (rcu == NULL) {
+    return;
+  }
+  /* readers that enter from now on cannot reach what was retired so far */
+  __atomic_add_fetch(&rcu->epoch, 1, __ATOMIC_SEQ_CST);
+  if (rcu->retired_cnt >= BPT_RCU_RECLAIM_BATCH) {
+    bpt_rcu_reclaim(pt);
+  }
+}
+
 static bgpstream_patricia_node_t *
 bgpstream_patricia_node_create(bgpstream_patricia_tree_t *pt,
                                const bgpstream_pfx_t *pfx)
@@ -184,7 +472,8 @@ bgpstream_patricia_node_create(bgpstream_patricia_tree_t *pt,
   assert(pfx->mask_len <= BGPSTREAM_PATRICIA_MAXBITS);
   assert(pfx->address.version != BGPSTREAM_ADDR_VERSION_UNKNOWN);
 
-  if ((node = malloc_zero(sizeof(bgpstream_patricia_node_t))) == NULL) {
+  if ((node = bgpstream_patricia_node_alloc(pt, pfx->address.version)) ==
+      NULL) {
     return NULL;
   }
 
@@ -204,12 +493,14 @@ bgpstream_patricia_node_create(bgpstream_patricia_tree_t *pt,
   return node;
 }
 
-static bgpstream_patricia_node_t *bgpstream_patricia_gluenode_create(
-  const bgpstream_pfx_t *pfx, uint8_t mask_len)
+static bgpstream_patricia_node_t *
+bgpstream_patricia_gluenode_create(bgpstream_patricia_tree_t *pt,
+                                   const bgpstream_pfx_t *pfx, uint8_t mask_len)
 {
   bgpstream_patricia_node_t *node;
 
-  if ((node = malloc_zero(sizeof(bgpstream_patricia_node_t))) == NULL) {
+  if ((node = bgpstream_patricia_node_alloc(pt, pfx->address.version)) ==
+      NULL) {
     return NULL;
   }
   bgpstream_addr_copy(&node->prefix.address, &pfx->address);
@@ -224,9 +515,9 @@ static bgpstream_patricia_node_t *bgpstream_patricia_gluenode_create(
 
 /* ======================= PATRICIA TREE FUNCTIONS ======================= */
 
-#define bgpstream_patricia_get_head(pt, v)          \
-  ((v) == BGPSTREAM_ADDR_VERSION_IPV4 ? pt->head4 : \
-   (v) == BGPSTREAM_ADDR_VERSION_IPV6 ? pt->head6 : \
+#define bgpstream_patricia_get_head(pt, v)                    \
+  ((v) == BGPSTREAM_ADDR_VERSION_IPV4 ? BPT_LOAD(pt->head4) : \
+   (v) == BGPSTREAM_ADDR_VERSION_IPV6 ? BPT_LOAD(pt->head6) : \
    NULL)
 
 static void bgpstream_patricia_set_head(bgpstream_patricia_tree_t *pt,
@@ -235,10 +526,10 @@ static void bgpstream_patricia_set_head(bgpstream_patricia_tree_t *pt,
 {
   switch (v) {
   case BGPSTREAM_ADDR_VERSION_IPV4:
-    pt->head4 = n;
+    BPT_STORE(pt->head4, n);
     break;
   case BGPSTREAM_ADDR_VERSION_IPV6:
-    pt->head6 = n;
+    BPT_STORE(pt->head6, n);
     break;
   default:
     assert(0);
@@ -284,55 +575,44 @@ bgpstream_patricia_tree_count_subnets(const bgpstream_patricia_node_t *node,
   }
 }
 
-/* depth pecifies how many "children" to explore for each node */
-static int bgpstream_patricia_tree_add_more_specifics(
-  bgpstream_patricia_tree_result_set_t *set, bgpstream_patricia_node_t *node,
-  const uint8_t depth)
+/* pre-order walk (Node - Left - Right) of the subtrees of the given nodes
+ * (at most two, either may be NULL). if top_only is set, the descendants of
+ * nodes with actual prefixes are not visited */
+static bgpstream_patricia_walk_cb_result_t
+bpt_walk_subtrees(const bgpstream_patricia_tree_t *pt,
+                  const bgpstream_patricia_node_t *l,
+                  const bgpstream_patricia_node_t *r, int top_only,
+                  bgpstream_patricia_tree_process_node_t *fun, void *data)
 {
-  if (node == NULL || depth == 0) {
-    return 0;
-  }
-  uint8_t d = depth;
-  /* if it is a node containing a real prefix, then copy the address to a new
-   * result node */
-  if (node->actual) {
-    if (bgpstream_patricia_tree_result_set_add_node(set, node) != 0) {
-      return -1;
-    }
-    d--;
-  }
+  /* every node popped pushes at most its two children, so the stack never
+   * holds more than one node per level of the tree, plus one */
+  const bgpstream_patricia_node_t *stack[BGPSTREAM_PATRICIA_MAXBITS + 2];
+  const bgpstream_patricia_node_t *node;
+  bgpstream_patricia_walk_cb_result_t rc;
+  int sp = 0;
 
-  /* using pre-order R - Left - Right */
-  if (bgpstream_patricia_tree_add_more_specifics(set, node->l, d) != 0) {
-    return -1;
-  }
-  if (bgpstream_patricia_tree_add_more_specifics(set, node->r, d) != 0) {
-    return -1;
+  if (r != NULL) {
+    stack[sp++] = r;
   }
-  return 0;
-}
-
-/* depth pecifies how many "children" to explore for each node */
-static int bgpstream_patricia_tree_add_less_specifics(
-  bgpstream_patricia_tree_result_set_t *set, bgpstream_patricia_node_t *node,
-  const uint8_t depth)
-{
-  if (node == NULL) {
-    return 0;
+  if (l != NULL) {
+    stack[sp++] = l;
   }
-  uint8_t d = depth;
-  while (node != NULL && d > 0) {
-    /* if it is a node containing a real prefix, then copy the address to a new
-     * result node */
-    if (node->actual) {
-      if (bgpstream_patricia_tree_result_set_add_node(set, node) != 0) {
-        return -1;
-      }
-      d--;
+  while (sp > 0) {
+    node = stack[--sp];
+    if (BPT_LOAD(node->actual)) {
+      rc = fun(pt, node, data);
+      if (rc != BGPSTREAM_PATRICIA_WALK_CONTINUE) return rc;
+      if (top_only) continue;
+    }
+    assert(sp + 2 <= BGPSTREAM_PATRICIA_MAXBITS + 2);
+    if ((r = BPT_LOAD(node->r)) != NULL) {
+      stack[sp++] = r;
+    }
+    if ((l = BPT_LOAD(node->l)) != NULL) {
+      stack[sp++] = l;
     }
-    node = node->parent;
   }
-  return 0;
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
 }
 
 static int
@@ -396,8 +676,8 @@ static bgpstream_patricia_walk_cb_result_t bpt_walk_parents(
   bgpstream_patricia_tree_process_node_t *fun, void *data)
 {
   bgpstream_patricia_walk_cb_result_t rc;
-  for ( ; node; node = node->parent) {
-    if (node->actual) {
+  for ( ; node; node = BPT_LOAD(node->parent)) {
+    if (BPT_LOAD(node->actual)) {
       rc = fun(pt, node, data);
       if (rc != BGPSTREAM_PATRICIA_WALK_CONTINUE) return rc;
     }
@@ -424,21 +704,6 @@ static void bgpstream_patricia_tree_print_tree(
   bgpstream_patricia_tree_print_tree(node->r);
 }
 
-static void
-bgpstream_patricia_tree_destroy_tree(bgpstream_patricia_tree_t *pt,
-                                     bgpstream_patricia_node_t *head)
-{
-  if (head != NULL) {
-    bgpstream_patricia_node_t *l = head->l;
-    bgpstream_patricia_node_t *r = head->r;
-    bgpstream_patricia_tree_destroy_tree(pt, l);
-    bgpstream_patricia_tree_destroy_tree(pt, r);
-    if (head->user != NULL && pt->node_user_destructor != NULL) {
-      pt->node_user_destructor(head->user);
-    }
-    free(head);
-  }
-}
 
 /* ======================= PUBLIC API FUNCTIONS ======================= */
 
@@ -529,6 +794,107 @@ bgpstream_patricia_tree_t *bgpstream_patricia_tree_create(
   return pt;
 }
 
+bgpstream_patricia_tree_t *bgpstream_patricia_tree_create_concurrent(
+  bgpstream_patricia_tree_destroy_user_t *bspt_user_destructor)
+{
+  bgpstream_patricia_tree_t *pt;
+
+  if ((pt = bgpstream_patricia_tree_create(bspt_user_destructor)) == NULL) {
+    return NULL;
+  }
+  if ((pt->rcu = malloc_zero(sizeof(bpt_rcu_t))) == NULL) {
+    goto err;
+  }
+  /* epoch 0 marks readers outside of a read-side section */
+  pt->rcu->epoch = 1;
+  if (pthread_mutex_init(&pt->rcu->readers_lock, NULL) != 0) {
+    free(pt->rcu);
+    pt->rcu = NULL;
+    goto err;
+  }
+  return pt;
+
+err:
+  bgpstream_patricia_tree_destroy(pt);
+  return NULL;
+}
+
+bgpstream_patricia_tree_reader_t *
+bgpstream_patricia_tree_reader_create(bgpstream_patricia_tree_t *pt)
+{
+  bgpstream_patricia_tree_reader_t *reader, **readers;
+  bpt_rcu_t *rcu = pt->rcu;
+
+  assert(rcu != NULL);
+  if ((reader = malloc_zero(sizeof(bgpstream_patricia_tree_reader_t))) ==
+      NULL) {
+    return NULL;
+  }
+  reader->pt = pt;
+
+  pthread_mutex_lock(&rcu->readers_lock);
+  if ((readers = realloc(rcu->readers,
+                         sizeof(bgpstream_patricia_tree_reader_t *) *
+                           (rcu->readers_cnt + 1))) == NULL) {
+    pthread_mutex_unlock(&rcu->readers_lock);
+    free(reader);
+    return NULL;
+  }
+  rcu->readers = readers;
+  rcu->readers[rcu->readers_cnt++] = reader;
+  pthread_mutex_unlock(&rcu->readers_lock);
+
+  return reader;
+}
+
+void bgpstream_patricia_tree_reader_destroy(
+  bgpstream_patricia_tree_reader_t *reader)
+{
+  bpt_rcu_t *rcu;
+  int i;
+
+  if (reader == NULL) {
+    return;
+  }
+  assert(reader->epoch == 0);
+  rcu = reader->pt->rcu;
+
+  pthread_mutex_lock(&rcu->readers_lock);
+  for (i = 0; i < rcu->readers_cnt; i++) {
+    if (rcu->readers[i] == reader) {
+      rcu->readers[i] = rcu->readers[--rcu->readers_cnt];
+      break;
+    }
+  }
+  pthread_mutex_unlock(&rcu->readers_lock);
+  free(reader);
+}
+
+void bgpstream_patricia_tree_read_lock(bgpstream_patricia_tree_reader_t *reader)
+{
+  assert(reader->epoch == 0);
+  __atomic_store_n(&reader->epoch,
+                   __atomic_load_n(&reader->pt->rcu->epoch, __ATOMIC_SEQ_CST),
+                   __ATOMIC_SEQ_CST);
+  /* either the writer sees that we are reading, or we see its last update
+   * (pairs with the fence in bpt_rcu_min_epoch) */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void bgpstream_patricia_tree_read_unlock(
+  bgpstream_patricia_tree_reader_t *reader)
+{
+  assert(reader->epoch != 0);
+  __atomic_store_n(&reader->epoch, 0, __ATOMIC_RELEASE);
+}
+
+void bgpstream_patricia_tree_synchronize(bgpstream_patricia_tree_t *pt)
+{
+  if (pt->rcu != NULL) {
+    bpt_rcu_synchronize(pt);
+  }
+}
+
 /* Search below node for another node with the same branching bits as pfx, and
  * return
  *   - a node with the same len, if one exists
@@ -542,16 +908,17 @@ bpt_search_node(const bgpstream_patricia_node_t *node,
                 const bgpstream_pfx_t *pfx)
 {
   const unsigned char *addr = bgpstream_pfx_get_first_byte(pfx);
+  const bgpstream_patricia_node_t *next;
   while (node->prefix.mask_len < pfx->mask_len) {
     if (BIT_ARRAY_TEST(addr, node->prefix.mask_len)) {
       /* patricia_lookup: take right at node */
-      if (!node->r) return node;
-      node = node->r;
+      next = BPT_LOAD(node->r);
     } else {
       /* patricia_lookup: take left at node */
-      if (!node->l) return node;
-      node = node->l;
+      next = BPT_LOAD(node->l);
     }
+    if (next == NULL) return node;
+    node = next;
   }
   return node;
 }
@@ -675,7 +1042,7 @@ bgpstream_patricia_tree_insert(bgpstream_patricia_tree_t *pt,
     /* otherwise replace the info in the glue node with proper
      * prefix information and increment the right counter*/
     assert(bgpstream_pfx_equal(&node_it->prefix, pfx));
-    node_it->actual = 1;
+    BPT_STORE(node_it->actual, 1);
     if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
       pt->ipv4_active_nodes++;
     } else {
@@ -701,10 +1068,10 @@ bgpstream_patricia_tree_insert(bgpstream_patricia_tree_t *pt,
     if (node_it->prefix.mask_len < BGPSTREAM_PATRICIA_MAXBITS &&
         BIT_ARRAY_TEST(paddr, node_it->prefix.mask_len)) {
       assert(node_it->r == NULL);
-      node_it->r = new_node;
+      BPT_STORE(node_it->r, new_node);
     } else {
       assert(node_it->l == NULL);
-      node_it->l = new_node;
+      BPT_STORE(node_it->l, new_node);
     }
     /* patricia_lookup: new_node #2 (child) */
     /* DEBUG  fprintf(stderr, "Adding %s as a CHILD node\n", buffer); */
@@ -727,12 +1094,12 @@ bgpstream_patricia_tree_insert(bgpstream_patricia_tree_t *pt,
       bgpstream_patricia_set_head(pt, v, new_node);
     } else {
       if (node_it->parent->r == node_it) {
-        node_it->parent->r = new_node;
+        BPT_STORE(node_it->parent->r, new_node);
       } else {
-        node_it->parent->l = new_node;
+        BPT_STORE(node_it->parent->l, new_node);
       }
     }
-    node_it->parent = new_node;
+    BPT_STORE(node_it->parent, new_node);
     /* patricia_lookup: new_node #3 (parent) */
     /* DEBUG fprintf(stderr, "Adding %s as a PARENT node\n", buffer); */
     return new_node;
@@ -742,7 +1109,10 @@ bgpstream_patricia_tree_insert(bgpstream_patricia_tree_t *pt,
      * TO IT*/
 
     bgpstream_patricia_node_t *glue_node =
-      bgpstream_patricia_gluenode_create(pfx, differ_bit);
+      bgpstream_patricia_gluenode_create(pt, pfx, differ_bit);
+    if (glue_node == NULL) {
+      return NULL;
+    }
 
     glue_node->parent = node_it->parent;
 
@@ -762,12 +1132,12 @@ bgpstream_patricia_tree_insert(bgpstream_patricia_tree_t *pt,
       bgpstream_patricia_set_head(pt, v, glue_node);
     } else {
       if (node_it->parent->r == node_it) {
-        node_it->parent->r = glue_node;
+        BPT_STORE(node_it->parent->r, glue_node);
       } else {
-        node_it->parent->l = glue_node;
+        BPT_STORE(node_it->parent->l, glue_node);
       }
     }
-    node_it->parent = glue_node;
+    BPT_STORE(node_it->parent, glue_node);
     /* "patricia_lookup: new_node #4 (glue+node) */
     /* DEBUG fprintf(stderr, "Adding %s as a CHILD of a NEW GLUE node\n",
      * buffer); */
@@ -839,22 +1209,296 @@ void bgpstream_patricia_tree_walk_up_down(
   }
 }
 
+/* ======================= BULK LOADING ======================= */
+
+/* Number of prefixes of each version above which bulk loading builds the IPv4
+ * and IPv6 trees in parallel (when asked to) */
+#define BGPSTREAM_PATRICIA_BULK_PARALLEL_MIN 4096
+
+/* the first bit (before maxbits) that differs between a and b, or maxbits */
+static uint8_t bpt_first_differ_bit(const unsigned char *a,
+                                    const unsigned char *b, uint8_t maxbits)
+{
+  int i, j, r;
+
+  for (i = 0; i * 8 < maxbits; i++) {
+    if ((r = (a[i] ^ b[i])) == 0) {
+      continue;
+    }
+    for (j = 0; (r & (0x80 >> j)) == 0; j++)
+      ;
+    return (i * 8 + j < maxbits) ? (i * 8 + j) : maxbits;
+  }
+  return maxbits;
+}
+
+/* order of prefixes (of the same version) in a pre-order walk of the tree */
+static int bpt_pfx_preorder_cmp(const void *a, const void *b)
+{
+  const bgpstream_pfx_t *pa = *(const bgpstream_pfx_t *const *)a;
+  const bgpstream_pfx_t *pb = *(const bgpstream_pfx_t *const *)b;
+  const unsigned char *aaddr = bgpstream_pfx_get_first_byte(pa);
+  uint8_t check_bit = (pa->mask_len < pb->mask_len) ? pa->mask_len :
+    pb->mask_len;
+  uint8_t differ_bit = bpt_first_differ_bit(
+    aaddr, bgpstream_pfx_get_first_byte(pb), check_bit);
+
+  if (differ_bit < check_bit) {
+    return BIT_ARRAY_TEST(aaddr, differ_bit) ? 1 : -1;
+  }
+  /* one covers the other, and the less specific comes first */
+  return (int)pa->mask_len - (int)pb->mask_len;
+}
+
+/* does node cover pfx? */
+static int bpt_node_covers(const bgpstream_patricia_node_t *node,
+                           const bgpstream_pfx_t *pfx)
+{
+  return node->prefix.mask_len <= pfx->mask_len &&
+         comp_with_mask(bgpstream_pfx_get_first_byte(&node->prefix),
+                        bgpstream_pfx_get_first_byte(pfx),
+                        node->prefix.mask_len);
+}
+
+typedef struct bpt_bulk {
+  bgpstream_patricia_tree_t *pt;
+  bgpstream_addr_version_t v;
+
+  /* the prefixes of this version, in pre-order */
+  const bgpstream_pfx_t **pfxs;
+  int pfxs_cnt;
+
+  /* base of the caller's array of prefixes, and where to put the node of each
+   * (may be NULL) */
+  const bgpstream_pfx_t *base;
+  bgpstream_patricia_node_t **nodes;
+
+  int rc;
+} bpt_bulk_t;
+
+/* build the (empty) tree of one version from its prefixes in pre-order. every
+ * prefix comes after the nodes already in the tree, so it hangs off the path
+ * down the right edge of the tree (kept in spine), and each node is only
+ * pushed onto and popped off the spine once */
+static int bpt_bulk_build(bpt_bulk_t *bulk)
+{
+  bgpstream_patricia_tree_t *pt = bulk->pt;
+  bgpstream_patricia_node_t *spine[BGPSTREAM_PATRICIA_MAXBITS + 2];
+  bgpstream_patricia_node_t *anc, *below, *node, *glue;
+  const bgpstream_pfx_t *pfx;
+  const unsigned char *paddr;
+  uint8_t check_bit, differ_bit;
+  int sp = 0, i;
+
+  assert(bgpstream_patricia_get_head(pt, bulk->v) == NULL);
+
+  for (i = 0; i < bulk->pfxs_cnt; i++) {
+    pfx = bulk->pfxs[i];
+    paddr = bgpstream_pfx_get_first_byte(pfx);
+
+    /* find the deepest node of the spine that covers pfx, and the spine node
+     * below it (which does not) */
+    below = NULL;
+    while (sp > 0 && !bpt_node_covers(spine[sp - 1], pfx)) {
+      below = spine[--sp];
+    }
+    anc = (sp > 0) ? spine[sp - 1] : NULL;
+
+    if (anc != NULL && anc->prefix.mask_len == pfx->mask_len) {
+      /* duplicates are next to each other, so this is the last prefix */
+      assert(anc->actual && below == NULL);
+      node = anc;
+      goto done;
+    }
+
+    if ((node = bgpstream_patricia_node_create(pt, pfx)) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Error creating pt node");
+      return -1;
+    }
+
+    if (below == NULL) {
+      /* anc is the last node of the spine, and so has no children */
+      if (anc == NULL) {
+        bgpstream_patricia_set_head(pt, bulk->v, node);
+      } else if (BIT_ARRAY_TEST(paddr, anc->prefix.mask_len)) {
+        anc->r = node;
+        node->parent = anc;
+      } else {
+        anc->l = node;
+        node->parent = anc;
+      }
+    } else if (anc != NULL && anc->l == below &&
+               BIT_ARRAY_TEST(paddr, anc->prefix.mask_len)) {
+      /* pfx goes to the right of the subtree that ended the spine */
+      anc->r = node;
+      node->parent = anc;
+    } else {
+      /* pfx and below differ before either ends (neither covers the other, or
+       * pfx would come before below), so they go under a new glue node, with
+       * pfx to the right */
+      check_bit = (below->prefix.mask_len < pfx->mask_len) ?
+        below->prefix.mask_len : pfx->mask_len;
+      differ_bit = bpt_first_differ_bit(
+        paddr, bgpstream_pfx_get_first_byte(&below->prefix), check_bit);
+      assert(differ_bit < check_bit);
+      if ((glue = bgpstream_patricia_gluenode_create(pt, pfx, differ_bit)) ==
+          NULL) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Error creating pt glue node");
+        return -1;
+      }
+      glue->parent = anc;
+      if (anc == NULL) {
+        bgpstream_patricia_set_head(pt, bulk->v, glue);
+      } else if (anc->l == below) {
+        anc->l = glue;
+      } else {
+        anc->r = glue;
+      }
+      glue->l = below;
+      below->parent = glue;
+      glue->r = node;
+      node->parent = glue;
+      spine[sp++] = glue;
+    }
+    spine[sp++] = node;
+
+  done:
+    if (bulk->nodes != NULL) {
+      bulk->nodes[pfx - bulk->base] = node;
+    }
+  }
+
+  return 0;
+}
+
+static void *bpt_bulk_thread(void *user)
+{
+  bpt_bulk_t *bulk = user;
+  bulk->rc = bpt_bulk_build(bulk);
+  return NULL;
+}
+
+/* put the prefixes of the bulk in pre-order, unless they already are */
+static void bpt_bulk_sort(bpt_bulk_t *bulk)
+{
+  int i;
+
+  for (i = 1; i < bulk->pfxs_cnt; i++) {
+    if (bpt_pfx_preorder_cmp(&bulk->pfxs[i - 1], &bulk->pfxs[i]) > 0) {
+      qsort(bulk->pfxs, bulk->pfxs_cnt, sizeof(bgpstream_pfx_t *),
+            bpt_pfx_preorder_cmp);
+      return;
+    }
+  }
+}
+
+int bgpstream_patricia_tree_insert_bulk(bgpstream_patricia_tree_t *pt,
+                                        const bgpstream_pfx_t *pfxs,
+                                        int pfxs_cnt,
+                                        bgpstream_patricia_node_t **nodes,
+                                        int parallel)
+{
+  bpt_bulk_t bulk[2];
+  const bgpstream_pfx_t **sorted = NULL;
+  pthread_t thread;
+  int threaded = 0;
+  int i, b;
+
+  assert(pt);
+  assert(pfxs_cnt >= 0);
+
+  if (pfxs_cnt == 0) {
+    return 0;
+  }
+  if ((sorted = malloc(sizeof(bgpstream_pfx_t *) * pfxs_cnt)) == NULL) {
+    return -1;
+  }
+
+  /* IPv4 prefixes from the front of sorted, and IPv6 from the back */
+  memset(bulk, 0, sizeof(bulk));
+  bulk[0].v = BGPSTREAM_ADDR_VERSION_IPV4;
+  bulk[0].pfxs = sorted;
+  bulk[1].v = BGPSTREAM_ADDR_VERSION_IPV6;
+  bulk[1].pfxs = sorted + pfxs_cnt;
+  for (i = 0; i < pfxs_cnt; i++) {
+    assert(pfxs[i].mask_len <= BGPSTREAM_PATRICIA_MAXBITS);
+    if (pfxs[i].address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
+      bulk[0].pfxs[bulk[0].pfxs_cnt++] = &pfxs[i];
+    } else {
+      assert(pfxs[i].address.version == BGPSTREAM_ADDR_VERSION_IPV6);
+      *(--bulk[1].pfxs) = &pfxs[i];
+      bulk[1].pfxs_cnt++;
+    }
+  }
+
+  for (b = 0; b < 2; b++) {
+    bulk[b].pt = pt;
+    bulk[b].base = pfxs;
+    bulk[b].nodes = nodes;
+    if (bgpstream_patricia_get_head(pt, bulk[b].v) != NULL ||
+        pt->rcu != NULL) {
+      /* there is no right edge to append to (or readers could see the tree
+       * half-built), so insert them one by one */
+      for (i = 0; i < bulk[b].pfxs_cnt; i++) {
+        bgpstream_patricia_node_t *node;
+        if ((node = bgpstream_patricia_tree_insert(pt, bulk[b].pfxs[i])) ==
+            NULL) {
+          goto err;
+        }
+        if (nodes != NULL) {
+          nodes[bulk[b].pfxs[i] - pfxs] = node;
+        }
+      }
+      bulk[b].pfxs_cnt = 0;
+    }
+    bpt_bulk_sort(&bulk[b]);
+  }
+
+  if (parallel != 0 &&
+      bulk[0].pfxs_cnt >= BGPSTREAM_PATRICIA_BULK_PARALLEL_MIN &&
+      bulk[1].pfxs_cnt >= BGPSTREAM_PATRICIA_BULK_PARALLEL_MIN &&
+      pthread_create(&thread, NULL, bpt_bulk_thread, &bulk[1]) == 0) {
+    threaded = 1;
+  }
+  if (bulk[0].pfxs_cnt != 0) {
+    bulk[0].rc = bpt_bulk_build(&bulk[0]);
+  }
+  if (threaded != 0) {
+    pthread_join(thread, NULL);
+  } else if (bulk[1].pfxs_cnt != 0) {
+    bulk[1].rc = bpt_bulk_build(&bulk[1]);
+  }
+  if (bulk[0].rc != 0 || bulk[1].rc != 0) {
+    goto err;
+  }
+
+  free(sorted);
+  return 0;
+
+err:
+  free(sorted);
+  return -1;
+}
+
 void *bgpstream_patricia_tree_get_user(bgpstream_patricia_node_t *node)
 {
-  return node->user;
+  return BPT_LOAD(node->user);
 }
 
 int bgpstream_patricia_tree_set_user(bgpstream_patricia_tree_t *pt,
                                      bgpstream_patricia_node_t *node,
                                      void *user)
 {
-  if (node->user == user) {
+  void *old = node->user;
+
+  if (old == user) {
     return 0;
   }
-  if (node->user != NULL && pt->node_user_destructor != NULL) {
-    pt->node_user_destructor(node->user);
+  BPT_STORE(node->user, user);
+  if (old != NULL && pt->node_user_destructor != NULL) {
+    bpt_retire(pt, NULL, old);
+    bpt_rcu_update_done(pt);
   }
-  node->user = user;
   return 1;
 }
 
@@ -899,13 +1543,9 @@ void bgpstream_patricia_tree_remove(bgpstream_patricia_tree_t *pt,
     bgpstream_patricia_tree_search_exact(pt, pfx));
 }
 
-void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
-                                         bgpstream_patricia_node_t *node)
+static void bpt_remove_node(bgpstream_patricia_tree_t *pt,
+                            bgpstream_patricia_node_t *node)
 {
-  assert(pt);
-  if (node == NULL) {
-    return;
-  }
 
   bgpstream_addr_version_t v = node->prefix.address.version;
   bgpstream_patricia_node_t *parent;
@@ -921,9 +1561,9 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
 
   if (node->user != NULL) {
     if (pt->node_user_destructor != NULL) {
-      pt->node_user_destructor(node->user);
+      bpt_retire(pt, NULL, node->user);
     }
-    node->user = NULL;
+    BPT_STORE(node->user, NULL);
   }
 
   /* if node has both children */
@@ -931,7 +1571,7 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
     /* if it is a glue node, there is nothing to remove,
      * if it is node with a valid prefix, then it becomes a glue node
      */
-    node->actual = 0;
+    BPT_STORE(node->actual, 0);
     /* node data remains, unless we decide to pass a destroy function somewehere
      */
     /* node->user = NULL; */
@@ -942,7 +1582,7 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
   /* if node has no children */
   if (node->r == NULL && node->l == NULL) {
     parent = node->parent;
-    free(node);
+    bpt_retire(pt, node, NULL);
     (*num_active_node) = (*num_active_node) - 1;
 
     /* removing head of tree */
@@ -955,11 +1595,11 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
 
     /* check if the node was the right or the left child */
     if (parent->r == node) {
-      parent->r = NULL;
+      BPT_STORE(parent->r, NULL);
       child = parent->l;
     } else {
       assert(parent->l == node);
-      parent->l = NULL;
+      BPT_STORE(parent->l, NULL);
       child = parent->r;
     }
 
@@ -978,15 +1618,15 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
       bgpstream_patricia_set_head(pt, v, child);
     } else {
       if (parent->parent->r == parent) { /* if the parent is a right child */
-        parent->parent->r = child;
+        BPT_STORE(parent->parent->r, child);
       } else { /* if the parent is a left child */
         assert(parent->parent->l == parent);
-        parent->parent->l = child;
+        BPT_STORE(parent->parent->l, child);
       }
     }
     /* the child parent, is now the grand-parent */
-    child->parent = parent->parent;
-    free(parent);
+    BPT_STORE(child->parent, parent->parent);
+    bpt_retire(pt, parent, NULL);
     return;
   }
 
@@ -999,9 +1639,9 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
   }
   /* the child parent, is now the grand-parent */
   parent = node->parent;
-  child->parent = parent;
+  BPT_STORE(child->parent, parent);
 
-  free(node);
+  bpt_retire(pt, node, NULL);
   (*num_active_node) = (*num_active_node) - 1;
 
   if (parent == NULL) { /* if the parent is the head, then attach
@@ -1012,14 +1652,25 @@ void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
   } else {
     /* attach child node to the correct parent child pointer */
     if (parent->r == node) { /* if node was a right child */
-      parent->r = child;
+      BPT_STORE(parent->r, child);
     } else { /* if node was a left child */
       assert(parent->l == node);
-      parent->l = child;
+      BPT_STORE(parent->l, child);
     }
   }
 }
 
+void bgpstream_patricia_tree_remove_node(bgpstream_patricia_tree_t *pt,
+                                         bgpstream_patricia_node_t *node)
+{
+  assert(pt);
+  if (node == NULL) {
+    return;
+  }
+  bpt_remove_node(pt, node);
+  bpt_rcu_update_done(pt);
+}
+
 const bgpstream_patricia_node_t *
 bgpstream_patricia_tree_search_exact_const(const bgpstream_patricia_tree_t *pt,
                                            const bgpstream_pfx_t *pfx)
@@ -1041,7 +1692,7 @@ bgpstream_patricia_tree_search_exact_const(const bgpstream_patricia_tree_t *pt,
   node = bpt_search_node(node, pfx);
 
   // if node has the wrong length, or is a glue node, then no exact match
-  if (node->prefix.mask_len != bitlen || !node->actual) {
+  if (node->prefix.mask_len != bitlen || !BPT_LOAD(node->actual)) {
     return NULL;
   }
 
@@ -1080,60 +1731,102 @@ uint64_t bgpstream_patricia_tree_count_64subnets(
   return bgpstream_patricia_tree_count_subnets(pt->head6, 64);
 }
 
+typedef struct bpt_collect {
+  bgpstream_patricia_tree_result_set_t *set;
+  /* number of nodes still to collect, or -1 for all of them */
+  int remain;
+  int rc;
+} bpt_collect_t;
+
+static bgpstream_patricia_walk_cb_result_t
+collect_node(const bgpstream_patricia_tree_t *pt,
+             const bgpstream_patricia_node_t *node, void *data)
+{
+  bpt_collect_t *collect = data;
+
+  if (bgpstream_patricia_tree_result_set_add_node(
+        collect->set, bgpstream_nonconst_node(node)) != 0) {
+    collect->rc = -1;
+    return BGPSTREAM_PATRICIA_WALK_END_ALL;
+  }
+  if (collect->remain > 0 && --collect->remain == 0) {
+    return BGPSTREAM_PATRICIA_WALK_END_ALL;
+  }
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
 int bgpstream_patricia_tree_get_more_specifics(
   bgpstream_patricia_tree_t *pt, bgpstream_patricia_node_t *node,
   bgpstream_patricia_tree_result_set_t *results)
 {
-  bgpstream_patricia_tree_result_set_clear(results);
+  bpt_collect_t collect = {results, -1, 0};
 
-  if (node != NULL) { /* we do not return the node itself */
-    if (bgpstream_patricia_tree_add_more_specifics(
-          results, node->l, BGPSTREAM_PATRICIA_MAXBITS + 1) != 0) {
-      return -1;
-    }
-    if (bgpstream_patricia_tree_add_more_specifics(
-          results, node->r, BGPSTREAM_PATRICIA_MAXBITS + 1) != 0) {
-      return -1;
-    }
-  }
-  return 0;
+  bgpstream_patricia_tree_result_set_clear(results);
+  bgpstream_patricia_tree_walk_more_specifics(pt, node, collect_node,
+                                              &collect);
+  return collect.rc;
 }
 
 int bgpstream_patricia_tree_get_mincovering_prefix(
   bgpstream_patricia_tree_t *pt, bgpstream_patricia_node_t *node,
   bgpstream_patricia_tree_result_set_t *results)
 {
-  bgpstream_patricia_tree_result_set_clear(results);
+  bpt_collect_t collect = {results, 1, 0};
 
-  if (node == NULL) {
-    return 0;
-  }
-  /* we do not return the node itself (that's why we pass the parent node) */
-  return bgpstream_patricia_tree_add_less_specifics(results, node->parent, 1);
+  bgpstream_patricia_tree_result_set_clear(results);
+  bgpstream_patricia_tree_walk_less_specifics(pt, node, collect_node,
+                                              &collect);
+  return collect.rc;
 }
 
 int bgpstream_patricia_tree_get_less_specifics(
   bgpstream_patricia_tree_t *pt, bgpstream_patricia_node_t *node,
   bgpstream_patricia_tree_result_set_t *results)
 {
-  bgpstream_patricia_tree_result_set_clear(results);
+  bpt_collect_t collect = {results, -1, 0};
 
-  if (node == NULL) {
-    return 0;
-  }
-  /* we do not return the node itself (that's why we pass the parent node) */
-  return bgpstream_patricia_tree_add_less_specifics(
-    results, node->parent, BGPSTREAM_PATRICIA_MAXBITS + 1);
+  bgpstream_patricia_tree_result_set_clear(results);
+  bgpstream_patricia_tree_walk_less_specifics(pt, node, collect_node,
+                                              &collect);
+  return collect.rc;
 }
 
 int bgpstream_patricia_tree_get_minimum_coverage(
   bgpstream_patricia_tree_t *pt, bgpstream_addr_version_t v,
   bgpstream_patricia_tree_result_set_t *results)
 {
+  bpt_collect_t collect = {results, -1, 0};
+
   bgpstream_patricia_tree_result_set_clear(results);
-  bgpstream_patricia_node_t *head = bgpstream_patricia_get_head(pt, v);
-  /* we stop at the first layer, hence depth = 1 */
-  return bgpstream_patricia_tree_add_more_specifics(results, head, 1);
+  bgpstream_patricia_tree_walk_minimum_coverage(pt, v, collect_node, &collect);
+  return collect.rc;
+}
+
+void bgpstream_patricia_tree_walk_more_specifics(
+  const bgpstream_patricia_tree_t *pt, const bgpstream_patricia_node_t *node,
+  bgpstream_patricia_tree_process_node_t *fun, void *data)
+{
+  if (node != NULL) { /* we do not visit the node itself */
+    bpt_walk_subtrees(pt, node->l, node->r, 0, fun, data);
+  }
+}
+
+void bgpstream_patricia_tree_walk_less_specifics(
+  const bgpstream_patricia_tree_t *pt, const bgpstream_patricia_node_t *node,
+  bgpstream_patricia_tree_process_node_t *fun, void *data)
+{
+  if (node != NULL) { /* we do not visit the node itself */
+    bpt_walk_parents(pt, BPT_LOAD(node->parent), fun, data);
+  }
+}
+
+void bgpstream_patricia_tree_walk_minimum_coverage(
+  const bgpstream_patricia_tree_t *pt, bgpstream_addr_version_t v,
+  bgpstream_patricia_tree_process_node_t *fun, void *data)
+{
+  /* we stop at the first layer of actual prefixes */
+  bpt_walk_subtrees(pt, bgpstream_patricia_get_head(pt, v), NULL, 1, fun,
+                    data);
 }
 
 uint8_t
@@ -1201,13 +1894,27 @@ bgpstream_patricia_tree_get_pfx(const bgpstream_patricia_node_t *node)
 
 void bgpstream_patricia_tree_clear(bgpstream_patricia_tree_t *pt)
 {
+  int i;
+
   assert(pt);
 
-  bgpstream_patricia_tree_destroy_tree(pt, pt->head4);
+  /* every node goes anyway, but user data retired from them has to be
+   * destroyed */
+  if (pt->rcu != NULL) {
+    for (i = 0; i < pt->rcu->retired_cnt; i++) {
+      pt->rcu->retired[i].node = NULL;
+      bpt_retired_free(pt, &pt->rcu->retired[i]);
+    }
+    pt->rcu->retired_cnt = 0;
+  }
+
+  bgpstream_patricia_pool_destroy_users(pt, &pt->pool4);
+  bgpstream_patricia_pool_clear(&pt->pool4);
+  bgpstream_patricia_pool_destroy_users(pt, &pt->pool6);
+  bgpstream_patricia_pool_clear(&pt->pool6);
+
   pt->ipv4_active_nodes = 0;
   pt->head4 = NULL;
-
-  bgpstream_patricia_tree_destroy_tree(pt, pt->head6);
   pt->ipv6_active_nodes = 0;
   pt->head6 = NULL;
 }
@@ -1216,6 +1923,15 @@ void bgpstream_patricia_tree_destroy(bgpstream_patricia_tree_t *pt)
 {
   if (pt != NULL) {
     bgpstream_patricia_tree_clear(pt);
+    bgpstream_patricia_pool_free(&pt->pool4);
+    bgpstream_patricia_pool_free(&pt->pool6);
+    if (pt->rcu != NULL) {
+      assert(pt->rcu->readers_cnt == 0);
+      pthread_mutex_destroy(&pt->rcu->readers_lock);
+      free(pt->rcu->readers);
+      free(pt->rcu->retired);
+      free(pt->rcu);
+    }
     free(pt);
   }
 }
@@ -66,6 +66,9 @@ typedef struct bgpstream_patricia_node bgpstream_patricia_node_t;
 /** Opaque structure containing a Patricia Tree instance */
 typedef struct bgpstream_patricia_tree bgpstream_patricia_tree_t;
 
+/** Opaque structure containing a reader of a concurrent Patricia Tree */
+typedef struct bgpstream_patricia_tree_reader bgpstream_patricia_tree_reader_t;
+
 /** Opaque structure containing a Patricia Tree results set */
 typedef struct bgpstream_patricia_tree_result_set
   bgpstream_patricia_tree_result_set_t;
@@ -180,6 +183,81 @@ void bgpstream_patricia_tree_result_set_print(
 bgpstream_patricia_tree_t *bgpstream_patricia_tree_create(
   bgpstream_patricia_tree_destroy_user_t *bspt_user_destructor);
 
+/** Create a new Patricia Tree that may be read from many threads while one
+ * thread updates it
+ *
+ * @param bspt_user_destructor          a function that destroys the user
+ *                                      structure in the Patricia Tree Node
+ *                                      structure
+ * @return a pointer to the structure, or NULL if an error occurred
+ *
+ * A single writer thread may insert and remove prefixes and set user pointers,
+ * while other threads, each with its own reader (see
+ * bgpstream_patricia_tree_reader_create), search the tree without locking:
+ * bgpstream_patricia_tree_search_exact, bgpstream_patricia_tree_get_user and
+ * the less/more specific queries (including
+ * bgpstream_patricia_tree_get_mincovering_prefix) may be called between
+ * bgpstream_patricia_tree_read_lock and bgpstream_patricia_tree_read_unlock.
+ * Nodes, and user data that is replaced or removed, are only freed once no
+ * reader can still be looking at them, so nodes and user pointers found by a
+ * reader remain valid until it calls bgpstream_patricia_tree_read_unlock.
+ *
+ * Other functions (walks, merging, clearing, ...) must not run at the same
+ * time as readers or the writer, and bulk inserts into a concurrent tree
+ * insert the prefixes one by one.
+ */
+bgpstream_patricia_tree_t *bgpstream_patricia_tree_create_concurrent(
+  bgpstream_patricia_tree_destroy_user_t *bspt_user_destructor);
+
+/** Create a reader of a concurrent Patricia Tree
+ *
+ * @param pt           pointer to a tree created by
+ *                     bgpstream_patricia_tree_create_concurrent
+ * @return a pointer to the reader, or NULL if an error occurred
+ *
+ * A reader must only be used by one thread at a time, and must be destroyed
+ * before the tree.
+ */
+bgpstream_patricia_tree_reader_t *
+bgpstream_patricia_tree_reader_create(bgpstream_patricia_tree_t *pt);
+
+/** Destroy a reader of a concurrent Patricia Tree
+ *
+ * @param reader       pointer to the reader to destroy (outside of a read-side
+ *                     section)
+ */
+void bgpstream_patricia_tree_reader_destroy(
+  bgpstream_patricia_tree_reader_t *reader);
+
+/** Start a read-side section, in which the reader may search the tree
+ *
+ * @param reader       pointer to the reader
+ *
+ * Read-side sections should be short: nothing the writer removes from the
+ * tree is freed while one that started before the removal is still running.
+ */
+void bgpstream_patricia_tree_read_lock(bgpstream_patricia_tree_reader_t *reader);
+
+/** End a read-side section
+ *
+ * @param reader       pointer to the reader
+ *
+ * Nodes and user pointers found during the section must not be used after it
+ * ends.
+ */
+void bgpstream_patricia_tree_read_unlock(
+  bgpstream_patricia_tree_reader_t *reader);
+
+/** Wait for readers to leave the read-side sections they are in, and free
+ * everything the writer has removed from a concurrent tree
+ *
+ * @param pt           pointer to the patricia tree
+ *
+ * Only the writer may call this, and not from within a read-side section.
+ * Removed nodes are otherwise freed in batches, as readers move on.
+ */
+void bgpstream_patricia_tree_synchronize(bgpstream_patricia_tree_t *pt);
+
 /** Insert a new prefix, if it does not exist
  *
  * @param pt           pointer to the patricia tree to lookup in
@@ -191,6 +269,30 @@ bgpstream_patricia_node_t *
 bgpstream_patricia_tree_insert(bgpstream_patricia_tree_t *pt,
                                const bgpstream_pfx_t *pfx);
 
+/** Insert many prefixes at once
+ *
+ * @param pt           pointer to the patricia tree to insert into
+ * @param pfxs         array of prefixes to insert (IPv4 and IPv6 may be mixed,
+ *                     and the same prefix may appear more than once)
+ * @param pfxs_cnt     number of prefixes in the array
+ * @param nodes        if not NULL, an array of pfxs_cnt pointers that is filled
+ *                     with the node of each prefix
+ * @param parallel     if non-zero, the IPv4 and IPv6 trees may be built in
+ *                     parallel (only worthwhile for large arrays)
+ * @return 0 if the prefixes were inserted successfully, -1 otherwise
+ *
+ * When the tree of a version is empty, its prefixes are sorted (unless they
+ * already are in the order of a walk of the tree) and the tree is built in a
+ * single pass, which is much faster than inserting them one by one. Otherwise
+ * the prefixes are inserted one by one. The resulting tree is the same either
+ * way.
+ */
+int bgpstream_patricia_tree_insert_bulk(bgpstream_patricia_tree_t *pt,
+                                        const bgpstream_pfx_t *pfxs,
+                                        int pfxs_cnt,
+                                        bgpstream_patricia_node_t **nodes,
+                                        int parallel);
+
 /** Get the user pointer associated with the node
  *
  * @param node        pointer to a node
@@ -329,6 +431,52 @@ int bgpstream_patricia_tree_get_minimum_coverage(
   bgpstream_patricia_tree_t *pt, bgpstream_addr_version_t v,
   bgpstream_patricia_tree_result_set_t *results);
 
+/** Visit more specific prefixes, without filling a result set
+ *
+ * @param pt           pointer to the patricia tree
+ * @param node         pointer to the node
+ * @param fun          callback function for each more specific prefix
+ * @param data         pointer to data that can be used by the callback
+ *
+ * Nodes are visited in the same order as they are returned by
+ * bgpstream_patricia_tree_get_more_specifics, until the callback returns
+ * anything other than BGPSTREAM_PATRICIA_WALK_CONTINUE.
+ */
+void bgpstream_patricia_tree_walk_more_specifics(
+  const bgpstream_patricia_tree_t *pt, const bgpstream_patricia_node_t *node,
+  bgpstream_patricia_tree_process_node_t *fun, void *data);
+
+/** Visit less specific prefixes (the smallest first), without filling a
+ * result set
+ *
+ * @param pt           pointer to the patricia tree
+ * @param node         pointer to the node
+ * @param fun          callback function for each less specific prefix
+ * @param data         pointer to data that can be used by the callback
+ *
+ * The walk ends when the callback returns anything other than
+ * BGPSTREAM_PATRICIA_WALK_CONTINUE, so returning
+ * BGPSTREAM_PATRICIA_WALK_END_ALL from the first call gives the smallest less
+ * specific prefix.
+ */
+void bgpstream_patricia_tree_walk_less_specifics(
+  const bgpstream_patricia_tree_t *pt, const bgpstream_patricia_node_t *node,
+  bgpstream_patricia_tree_process_node_t *fun, void *data);
+
+/** Visit the prefixes of the minimum coverage, without filling a result set
+ *
+ * @param pt           pointer to the patricia tree
+ * @param v            IP version
+ * @param fun          callback function for each prefix of the coverage
+ * @param data         pointer to data that can be used by the callback
+ *
+ * The walk ends when the callback returns anything other than
+ * BGPSTREAM_PATRICIA_WALK_CONTINUE.
+ */
+void bgpstream_patricia_tree_walk_minimum_coverage(
+  const bgpstream_patricia_tree_t *pt, bgpstream_addr_version_t v,
+  bgpstream_patricia_tree_process_node_t *fun, void *data);
+
 /** Check whether a node overlaps with other prefixes in the tree
  *
  * @param pt           pointer to the patricia tree
@@ -25,16 +25,21 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 
 #include "khash.h"
 #include "utils.h"
 
+#include "bgpstream_log.h"
 #include "bgpstream_utils_peer_sig_map.h"
 
 #define IPV4_ID_OFFSET 1
 #define IPV6_ID_OFFSET 1
 
+/* the cache in front of the map has 1 << PEER_CACHE_BITS entries */
+#define PEER_CACHE_BITS 8
+
 /** Hash a peer signature into a 64bit number
  *
  * @param ps            the peer signature to hash
@@ -77,12 +82,29 @@ KHASH_INIT(bgpstream_peer_sig_id_map, bgpstream_peer_sig_t *,
 KHASH_INIT(bgpstream_peer_id_sig_map, bgpstream_peer_id_t,
            bgpstream_peer_sig_t *, 1, kh_int_hash_func, kh_int_hash_equal)
 
+/** A recently used peer, found by collector name ID and peer IP */
+typedef struct peer_cache_entry {
+  bgpstream_ip_addr_t peer_ip_addr;
+  uint32_t collector_id;
+  /* 0 if the entry is empty */
+  bgpstream_peer_id_t peer_id;
+} peer_cache_entry_t;
+
 /** Structure representing an instance of a Peer Signature Map */
 struct bgpstream_peer_sig_map {
   khash_t(bgpstream_peer_sig_id_map) * ps_id;
   khash_t(bgpstream_peer_id_sig_map) * id_ps;
   bgpstream_peer_id_t v4_next_id;
   bgpstream_peer_id_t v6_next_id;
+
+  /* direct-mapped cache used by bgpstream_peer_sig_map_get_id_cached */
+  peer_cache_entry_t cache[1 << PEER_CACHE_BITS];
+
+  /* does the map need locking? */
+  int concurrent;
+
+  /* protects everything above in concurrent maps */
+  pthread_mutex_t lock;
 };
 
 /* PRIVATE FUNCTIONS (static) */
@@ -92,41 +114,69 @@ static void sig_free(bgpstream_peer_sig_t *sig)
   free(sig);
 }
 
+static inline void map_lock(bgpstream_peer_sig_map_t *map)
+{
+  if (map->concurrent != 0) {
+    pthread_mutex_lock(&map->lock);
+  }
+}
+
+static inline void map_unlock(bgpstream_peer_sig_map_t *map)
+{
+  if (map->concurrent != 0) {
+    pthread_mutex_unlock(&map->lock);
+  }
+}
+
+/* add a new peer signature (copying it) to the map, returning its ID, or 0 if
+   it could not be added */
 static bgpstream_peer_id_t
-bgpstream_peer_sig_map_set_and_get_ps(bgpstream_peer_sig_map_t *map,
-                                      bgpstream_peer_sig_t *ps)
+bgpstream_peer_sig_map_add_ps(bgpstream_peer_sig_map_t *map,
+                              const bgpstream_peer_sig_t *ps)
 {
-  khiter_t k;
+  bgpstream_peer_sig_t *new_ps;
+  khiter_t k, ps_k;
   int khret;
   bgpstream_peer_id_t new_id;
 
-  if ((k = kh_get(bgpstream_peer_sig_id_map, map->ps_id, ps)) ==
-      kh_end(map->ps_id)) {
-    /* was not already in the map */
-    /* what ID should we use? */
-    if (map->v4_next_id >= IPV6_ID_OFFSET) {
-      /* v4 peers are in v6 range */
-      /* regardless of the version, use the v6 id */
-      new_id = map->v6_next_id++;
-    } else if (ps->peer_ip_addr.version == BGPSTREAM_ADDR_VERSION_IPV6) {
-      assert(map->v4_next_id < IPV6_ID_OFFSET);
-      new_id = map->v6_next_id++;
-    } else {
-      new_id = map->v4_next_id++;
-    }
+  /* what ID should we use? */
+  if (map->v4_next_id >= IPV6_ID_OFFSET) {
+    /* v4 peers are in v6 range */
+    /* regardless of the version, use the v6 id */
+    new_id = map->v6_next_id;
+  } else if (ps->peer_ip_addr.version == BGPSTREAM_ADDR_VERSION_IPV6) {
+    assert(map->v4_next_id < IPV6_ID_OFFSET);
+    new_id = map->v6_next_id;
+  } else {
+    new_id = map->v4_next_id;
+  }
+
+  if ((new_ps = malloc(sizeof(bgpstream_peer_sig_t))) == NULL) {
+    return 0;
+  }
+  *new_ps = *ps;
 
-    /* insert into both maps */
-    k = kh_put(bgpstream_peer_sig_id_map, map->ps_id, ps, &khret);
-    kh_value(map->ps_id, k) = new_id;
-    k = kh_put(bgpstream_peer_id_sig_map, map->id_ps, new_id, &khret);
-    kh_value(map->id_ps, k) = ps;
+  /* insert into both maps */
+  ps_k = kh_put(bgpstream_peer_sig_id_map, map->ps_id, new_ps, &khret);
+  if (khret == -1) {
+    free(new_ps);
+    return 0;
+  }
+  kh_value(map->ps_id, ps_k) = new_id;
+  k = kh_put(bgpstream_peer_id_sig_map, map->id_ps, new_id, &khret);
+  if (khret == -1) {
+    kh_del(bgpstream_peer_sig_id_map, map->ps_id, ps_k);
+    free(new_ps);
+    return 0;
+  }
+  kh_value(map->id_ps, k) = new_ps;
 
-    return new_id;
+  if (new_id == map->v6_next_id) {
+    map->v6_next_id++;
   } else {
-    /* already exists... */
-    free(ps); /* it was mallocd for us...*/
-    return kh_value(map->ps_id, k);
+    map->v4_next_id++;
   }
+  return new_id;
 }
 
 /* PROTECTED FUNCTIONS (_int.h) */
@@ -151,7 +201,7 @@ int bgpstream_peer_sig_equal(bgpstream_peer_sig_t *ps1,
 
 /* PUBLIC FUNCTIONS */
 
-bgpstream_peer_sig_map_t *bgpstream_peer_sig_map_create()
+static bgpstream_peer_sig_map_t *map_create(int concurrent)
 {
   bgpstream_peer_sig_map_t *map = NULL;
   if ((map = (bgpstream_peer_sig_map_t *)malloc_zero(
@@ -159,6 +209,14 @@ bgpstream_peer_sig_map_t *bgpstream_peer_sig_map_create()
     return NULL;
   }
 
+  if (concurrent != 0) {
+    if (pthread_mutex_init(&map->lock, NULL) != 0) {
+      free(map);
+      return NULL;
+    }
+    map->concurrent = 1;
+  }
+
   if ((map->ps_id = kh_init(bgpstream_peer_sig_id_map)) == NULL) {
     goto err;
   }
@@ -177,39 +235,165 @@ err:
   return NULL;
 }
 
+/* the lookup of bgpstream_peer_sig_map_get_id, with the map locked */
+static bgpstream_peer_id_t get_id(bgpstream_peer_sig_map_t *map,
+                                  const char *collector_str,
+                                  bgpstream_ip_addr_t *peer_ip_addr,
+                                  uint32_t peer_asnumber)
+{
+  bgpstream_peer_sig_t ps;
+  khiter_t k;
+
+  /* only a new signature needs to be copied */
+  bgpstream_addr_copy(&ps.peer_ip_addr, peer_ip_addr);
+  strcpy(ps.collector_str, collector_str);
+  ps.peer_asnumber = peer_asnumber;
+
+  if ((k = kh_get(bgpstream_peer_sig_id_map, map->ps_id, &ps)) !=
+      kh_end(map->ps_id)) {
+    return kh_value(map->ps_id, k);
+  }
+  return bgpstream_peer_sig_map_add_ps(map, &ps);
+}
+
+/* the lookup of bgpstream_peer_sig_map_get_sig, with the map locked */
+static bgpstream_peer_sig_t *get_sig(bgpstream_peer_sig_map_t *map,
+                                     bgpstream_peer_id_t id)
+{
+  khiter_t k;
+
+  if ((k = kh_get(bgpstream_peer_id_sig_map, map->id_ps, id)) !=
+      kh_end(map->id_ps)) {
+    return kh_value(map->id_ps, k);
+  }
+  return NULL;
+}
+
+/* PUBLIC FUNCTIONS */
+
+bgpstream_peer_sig_map_t *bgpstream_peer_sig_map_create()
+{
+  return map_create(0);
+}
+
+bgpstream_peer_sig_map_t *bgpstream_peer_sig_map_create_concurrent()
+{
+  return map_create(1);
+}
+
 bgpstream_peer_id_t bgpstream_peer_sig_map_get_id(
   bgpstream_peer_sig_map_t *map, const char *collector_str,
   bgpstream_ip_addr_t *peer_ip_addr, uint32_t peer_asnumber)
 {
-  bgpstream_peer_sig_t *new_ps;
-  if ((new_ps = malloc(sizeof(bgpstream_peer_sig_t))) == NULL) {
-    return -1;
-  }
+  bgpstream_peer_id_t id;
 
-  bgpstream_addr_copy(&new_ps->peer_ip_addr, peer_ip_addr);
-  strcpy(new_ps->collector_str, collector_str);
-  new_ps->peer_asnumber = peer_asnumber;
+  map_lock(map);
+  id = get_id(map, collector_str, peer_ip_addr, peer_asnumber);
+  map_unlock(map);
+  return id;
+}
 
-  return bgpstream_peer_sig_map_set_and_get_ps(map, new_ps);
+bgpstream_peer_id_t bgpstream_peer_sig_map_get_id_cached(
+  bgpstream_peer_sig_map_t *map, uint32_t collector_id,
+  const char *collector_str, bgpstream_ip_addr_t *peer_ip_addr,
+  uint32_t peer_asnumber)
+{
+  peer_cache_entry_t *e;
+  bgpstream_peer_id_t id;
+  uint32_t h;
+
+  h = ((uint32_t)bgpstream_addr_hash(peer_ip_addr) ^
+       (collector_id * 0x9E3779B9U)) *
+      0x9E3779B9U;
+
+  map_lock(map);
+  e = &map->cache[h >> (32 - PEER_CACHE_BITS)];
+  if (e->peer_id == 0 || e->collector_id != collector_id ||
+      !bgpstream_addr_equal(&e->peer_ip_addr, peer_ip_addr)) {
+    if ((e->peer_id = get_id(map, collector_str, peer_ip_addr,
+                             peer_asnumber)) != 0) {
+      bgpstream_addr_copy(&e->peer_ip_addr, peer_ip_addr);
+      e->collector_id = collector_id;
+    }
+  }
+  id = e->peer_id;
+  map_unlock(map);
+  return id;
 }
 
 bgpstream_peer_sig_t *
 bgpstream_peer_sig_map_get_sig(bgpstream_peer_sig_map_t *map,
                                bgpstream_peer_id_t id)
 {
-  bgpstream_peer_sig_t *ps = NULL;
-  khiter_t k;
-  if ((k = kh_get(bgpstream_peer_id_sig_map, map->id_ps, id)) !=
-      kh_end(map->id_ps)) {
-    ps = kh_value(map->id_ps, k);
-  }
+  bgpstream_peer_sig_t *ps;
+
+  map_lock(map);
+  ps = get_sig(map, id);
+  map_unlock(map);
   return ps;
 }
 
 int bgpstream_peer_sig_map_get_size(bgpstream_peer_sig_map_t *map)
 {
+  int size;
+
+  map_lock(map);
   assert(kh_size(map->id_ps) == kh_size(map->ps_id));
-  return kh_size(map->id_ps);
+  size = kh_size(map->id_ps);
+  map_unlock(map);
+  return size;
+}
+
+int bgpstream_peer_sig_map_merge(bgpstream_peer_sig_map_t *dst,
+                                 bgpstream_peer_sig_map_t *src,
+                                 bgpstream_peer_id_t **remap)
+{
+  bgpstream_peer_sig_t *sigs = NULL, *ps;
+  bgpstream_peer_id_t *ids = NULL;
+  int ids_cnt, id;
+
+  if (dst == src) {
+    return -1;
+  }
+
+  /* take a copy of the source peers (in ID order) so that the two maps are
+     never locked at once. until they are remapped, ids flags the IDs in use */
+  map_lock(src);
+  ids_cnt = src->v4_next_id > src->v6_next_id ? src->v4_next_id
+                                              : src->v6_next_id;
+  if ((sigs = malloc(sizeof(bgpstream_peer_sig_t) * ids_cnt)) == NULL ||
+      (ids = malloc_zero(sizeof(bgpstream_peer_id_t) * ids_cnt)) == NULL) {
+    map_unlock(src);
+    goto err;
+  }
+  for (id = 1; id < ids_cnt; id++) {
+    if ((ps = get_sig(src, id)) != NULL) {
+      sigs[id] = *ps;
+      ids[id] = 1;
+    }
+  }
+  map_unlock(src);
+
+  map_lock(dst);
+  for (id = 1; id < ids_cnt; id++) {
+    if (ids[id] != 0 &&
+        (ids[id] = get_id(dst, sigs[id].collector_str, &sigs[id].peer_ip_addr,
+                          sigs[id].peer_asnumber)) == 0) {
+      map_unlock(dst);
+      goto err;
+    }
+  }
+  map_unlock(dst);
+
+  free(sigs);
+  *remap = ids;
+  return ids_cnt;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Could not merge peer signature maps");
+  free(sigs);
+  free(ids);
+  return -1;
 }
 
 void bgpstream_peer_sig_map_destroy(bgpstream_peer_sig_map_t *map)
@@ -225,14 +409,20 @@ void bgpstream_peer_sig_map_destroy(bgpstream_peer_sig_map_t *map)
       kh_destroy(bgpstream_peer_id_sig_map, map->id_ps);
       map->id_ps = NULL;
     }
+    if (map->concurrent != 0) {
+      pthread_mutex_destroy(&map->lock);
+    }
     free(map);
   }
 }
 
 void bgpstream_peer_sig_map_clear(bgpstream_peer_sig_map_t *map)
 {
+  map_lock(map);
   /* only call free vals on ONE map, they are shared */
   kh_free_vals(bgpstream_peer_id_sig_map, map->id_ps, sig_free);
   kh_clear(bgpstream_peer_id_sig_map, map->id_ps);
   kh_clear(bgpstream_peer_sig_id_map, map->ps_id);
+  memset(map->cache, 0, sizeof(map->cache));
+  map_unlock(map);
 }
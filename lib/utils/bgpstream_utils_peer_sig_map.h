@@ -84,6 +84,16 @@ typedef struct struct_bgpstream_peer_sig_t {
  */
 bgpstream_peer_sig_map_t *bgpstream_peer_sig_map_create(void);
 
+/** Create a new peer signature map that can be shared by several threads
+ * @return a pointer to the created peer sig map if successful, NULL otherwise.
+ *
+ * All the functions may then be called concurrently, and every thread gets
+ * the same ID for a given peer. The map has a single lock, so threads that
+ * look up peers for every elem may prefer maps of their own, merged with
+ * bgpstream_peer_sig_map_merge once they are done.
+ */
+bgpstream_peer_sig_map_t *bgpstream_peer_sig_map_create_concurrent(void);
+
 /** Get (or set and get) the peer ID for the given peer signature
  *
  * @param map            pointer to the peer sig map to query
@@ -97,6 +107,26 @@ bgpstream_peer_id_t bgpstream_peer_sig_map_get_id(
   bgpstream_peer_sig_map_t *map, const char *collector_str,
   bgpstream_ip_addr_t *peer_ip_addr, uint32_t peer_asnumber);
 
+/** Get (or set and get) the peer ID for the given peer, looking it up by the
+ * ID of its collector name first
+ * @param map            pointer to the peer sig map to query
+ * @param collector_id   ID of the collector name (e.g. the collector_id of a
+ *                       record), which must only ever be used for collector_str
+ * @param collector_str  string name of the collector
+ * @param peer_ip_addr   pointer to the IP address of the peer
+ * @param peer_asnumber  AS number of the peer
+ * @return the peer ID for this peer signature, 0 if an error occurred
+ *
+ * This gives the same IDs as bgpstream_peer_sig_map_get_id, but the peers that
+ * were looked up recently are found in a small cache without hashing or
+ * comparing the collector name. This makes it suitable for calling once per
+ * elem.
+ */
+bgpstream_peer_id_t bgpstream_peer_sig_map_get_id_cached(
+  bgpstream_peer_sig_map_t *map, uint32_t collector_id,
+  const char *collector_str, bgpstream_ip_addr_t *peer_ip_addr,
+  uint32_t peer_asnumber);
+
 /** Get the peer signature for the given peer ID
  *
  * @param map           pointer to the peer sig map to query
@@ -115,6 +145,23 @@ bgpstream_peer_sig_map_get_sig(bgpstream_peer_sig_map_t *map,
  */
 int bgpstream_peer_sig_map_get_size(bgpstream_peer_sig_map_t *map);
 
+/** Add the peers of one peer signature map to another
+ * @param dst           pointer to the peer sig map to add the peers to
+ * @param src           pointer to the peer sig map to take the peers from
+ * @param[out] remap    set to an array that gives the ID in dst of each
+ *                      peer ID of src (0 for IDs that src does not use)
+ * @return the number of entries in the remap array if successful, -1
+ * otherwise
+ *
+ * Peers that are new to dst are given IDs in the order of their IDs in src,
+ * in the same way as bgpstream_peer_sig_map_get_id would, so merging the same
+ * maps in the same order always gives the same IDs. The remap array must be
+ * freed by the caller, and src is not changed.
+ */
+int bgpstream_peer_sig_map_merge(bgpstream_peer_sig_map_t *dst,
+                                 bgpstream_peer_sig_map_t *src,
+                                 bgpstream_peer_id_t **remap);
+
 /** Destroy the given peer signature map
  *
  * @param map           pointer to the peer sig map to destroy
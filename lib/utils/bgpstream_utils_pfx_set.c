@@ -26,55 +26,80 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
-#include "khash.h"
 #include "utils.h"
 
 #include "bgpstream_utils_pfx_set.h"
+#include "bgpstream_utils_swiss_int.h"
 
 /* ipv4 specific set */
 
-KHASH_INIT(bgpstream_ipv4_pfx_set /* name */,
-           bgpstream_ipv4_pfx_t /* khkey_t */, char /* khval_t */,
-           0 /* kh_is_map */,
-           bgpstream_ipv4_pfx_hash_val /*__hash_func */,
-           bgpstream_ipv4_pfx_equal_val /* __hash_equal */)
+/* IPv4 prefixes are stored inline as a single integer: the address (in
+ * network byte order) in the low 32 bits, then the mask length and the
+ * allowed matches, which are not part of the identity of the prefix */
+#define V4_KEY(pfx)                                                            \
+  ((uint64_t)(pfx)->address.addr.s_addr | (uint64_t)(pfx)->mask_len << 32 |    \
+   (uint64_t)(pfx)->allowed_matches << 40)
+#define V4_KEY_ID_MASK 0xffffffffffULL
+#define V4_HASH_VAL(arg) ((arg)&V4_KEY_ID_MASK)
+#define V4_EQUAL_VAL(arg1, arg2) ((((arg1) ^ (arg2)) & V4_KEY_ID_MASK) == 0)
+
+BS_SWISS_SET_INIT(bgpstream_ipv4_pfx_set /* name */, uint64_t /* key_t */,
+                  V4_HASH_VAL /* hash_func */, V4_EQUAL_VAL /* equal_func */)
 
 struct bgpstream_ipv4_pfx_set {
-  khash_t(bgpstream_ipv4_pfx_set) *hash;
+  bs_swiss_bgpstream_ipv4_pfx_set_t hash;
 };
 
-static inline int v4hash_insert(khash_t(bgpstream_ipv4_pfx_set) *hash,
-                                bgpstream_ipv4_pfx_t *pfx);
-static inline int v4hash_merge(khash_t(bgpstream_ipv4_pfx_set) *dst_hash,
-                               khash_t(bgpstream_ipv4_pfx_set) *src_hash);
+static void v4key_to_pfx(uint64_t key, bgpstream_pfx_t *pfx)
+{
+  pfx->address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+  pfx->bs_ipv4.address.addr.s_addr = (uint32_t)key;
+  pfx->mask_len = (uint8_t)(key >> 32);
+  pfx->allowed_matches = (uint8_t)(key >> 40);
+}
 
 /* ipv6 specific set */
 
-KHASH_INIT(bgpstream_ipv6_pfx_set /* name */,
-           bgpstream_ipv6_pfx_t /* khkey_t */, char /* khval_t */,
-           0 /* kh_is_map */,
-           bgpstream_ipv6_pfx_hash_val /*__hash_func */,
-           bgpstream_ipv6_pfx_equal_val /* __hash_equal */)
+/* unlike bgpstream_ipv6_pfx_hash, hash the whole address, so that more
+ * specifics than /64s do not all collide */
+static inline uint64_t v6_hash(const bgpstream_ipv6_pfx_t *pfx)
+{
+  uint64_t ms, ls;
+  memcpy(&ms, &pfx->address.addr.s6_addr[0], sizeof(ms));
+  memcpy(&ls, &pfx->address.addr.s6_addr[8], sizeof(ls));
+  return ((ms * 0x9E3779B97F4A7C15ULL) ^ ls) + pfx->mask_len;
+}
+
+static inline int v6_equal(const bgpstream_ipv6_pfx_t *pfx1,
+                           const bgpstream_ipv6_pfx_t *pfx2)
+{
+  return pfx1->mask_len == pfx2->mask_len &&
+         memcmp(&pfx1->address.addr, &pfx2->address.addr,
+                sizeof(pfx1->address.addr)) == 0;
+}
+
+#define V6_HASH_VAL(arg) v6_hash(&(arg))
+#define V6_EQUAL_VAL(arg1, arg2) v6_equal(&(arg1), &(arg2))
+
+BS_SWISS_SET_INIT(bgpstream_ipv6_pfx_set /* name */,
+                  bgpstream_ipv6_pfx_t /* key_t */,
+                  V6_HASH_VAL /* hash_func */, V6_EQUAL_VAL /* equal_func */)
 
 struct bgpstream_ipv6_pfx_set {
-  khash_t(bgpstream_ipv6_pfx_set) *hash;
+  bs_swiss_bgpstream_ipv6_pfx_set_t hash;
 };
 
-static inline int v6hash_insert(khash_t(bgpstream_ipv6_pfx_set) *hash,
-                                bgpstream_ipv6_pfx_t *pfx);
-static inline int v6hash_merge(khash_t(bgpstream_ipv6_pfx_set) *dst_hash,
-                               khash_t(bgpstream_ipv6_pfx_set) *src_hash);
-
 /** set of unique IP prefixes
- *  We store v4 and v6 in separate hashes, because it would be unsafe for the
- *  khash functions in _pfx_set_insert() and _pfx_set_exists() to dereference
+ *  We store v4 and v6 in separate sets, because it would be unsafe for the
+ *  hash functions in _pfx_set_insert() and _pfx_set_exists() to dereference
  *  pfx if it points to a ipv4_pfx.
- *  This also has the advantage of using less memory for the v4 hash.
+ *  This also has the advantage of using less memory for the v4 set.
  */
 struct bgpstream_pfx_set {
-  khash_t(bgpstream_ipv4_pfx_set) * v4hash;
-  khash_t(bgpstream_ipv6_pfx_set) * v6hash;
+  bgpstream_ipv4_pfx_set_t v4;
+  bgpstream_ipv6_pfx_set_t v6;
 };
 
 /* STORAGE */
@@ -87,11 +112,8 @@ bgpstream_pfx_set_t *bgpstream_pfx_set_create()
     return NULL;
   }
 
-  if ((set->v4hash = kh_init(bgpstream_ipv4_pfx_set)) == NULL ||
-      (set->v6hash = kh_init(bgpstream_ipv6_pfx_set)) == NULL) {
-    bgpstream_pfx_set_destroy(set);
-    return NULL;
-  }
+  bs_swiss_bgpstream_ipv4_pfx_set_init(&set->v4.hash);
+  bs_swiss_bgpstream_ipv6_pfx_set_init(&set->v6.hash);
   return set;
 }
 
@@ -99,9 +121,9 @@ int bgpstream_pfx_set_insert(bgpstream_pfx_set_t *set,
                              bgpstream_pfx_t *pfx)
 {
   if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
-    return v4hash_insert(set->v4hash, &pfx->bs_ipv4);
+    return bgpstream_ipv4_pfx_set_insert(&set->v4, &pfx->bs_ipv4);
   } else {
-    return v6hash_insert(set->v6hash, &pfx->bs_ipv6);
+    return bgpstream_ipv6_pfx_set_insert(&set->v6, &pfx->bs_ipv6);
   }
 }
 
@@ -109,17 +131,15 @@ int bgpstream_pfx_set_exists(bgpstream_pfx_set_t *set,
                              bgpstream_pfx_t *pfx)
 {
   if (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
-    return kh_get(bgpstream_ipv4_pfx_set, set->v4hash, pfx->bs_ipv4) !=
-      kh_end(set->v4hash);
+    return bgpstream_ipv4_pfx_set_exists(&set->v4, &pfx->bs_ipv4);
   } else {
-    return kh_get(bgpstream_ipv6_pfx_set, set->v6hash, pfx->bs_ipv6) !=
-      kh_end(set->v6hash);
+    return bgpstream_ipv6_pfx_set_exists(&set->v6, &pfx->bs_ipv6);
   }
 }
 
 int bgpstream_pfx_set_size(bgpstream_pfx_set_t *set)
 {
-  return kh_size(set->v4hash) + kh_size(set->v6hash);
+  return bs_swiss_size(&set->v4.hash) + bs_swiss_size(&set->v6.hash);
 }
 
 int bgpstream_pfx_set_version_size(bgpstream_pfx_set_t *set,
@@ -127,9 +147,9 @@ int bgpstream_pfx_set_version_size(bgpstream_pfx_set_t *set,
 {
   switch (v) {
   case BGPSTREAM_ADDR_VERSION_IPV4:
-    return kh_size(set->v4hash);
+    return bs_swiss_size(&set->v4.hash);
   case BGPSTREAM_ADDR_VERSION_IPV6:
-    return kh_size(set->v6hash);
+    return bs_swiss_size(&set->v6.hash);
   default:
     return -1;
   }
@@ -138,8 +158,8 @@ int bgpstream_pfx_set_version_size(bgpstream_pfx_set_t *set,
 int bgpstream_pfx_set_merge(bgpstream_pfx_set_t *dst_set,
                             bgpstream_pfx_set_t *src_set)
 {
-  if (v4hash_merge(dst_set->v4hash, src_set->v4hash) < 0 ||
-      v6hash_merge(dst_set->v6hash, src_set->v6hash) < 0) {
+  if (bgpstream_ipv4_pfx_set_merge(&dst_set->v4, &src_set->v4) < 0 ||
+      bgpstream_ipv6_pfx_set_merge(&dst_set->v6, &src_set->v6) < 0) {
     return -1;
   }
   return 0;
@@ -147,27 +167,22 @@ int bgpstream_pfx_set_merge(bgpstream_pfx_set_t *dst_set,
 
 void bgpstream_pfx_set_destroy(bgpstream_pfx_set_t *set)
 {
-  if (set->v4hash) kh_destroy(bgpstream_ipv4_pfx_set, set->v4hash);
-  if (set->v6hash) kh_destroy(bgpstream_ipv6_pfx_set, set->v6hash);
+  bs_swiss_bgpstream_ipv4_pfx_set_destroy(&set->v4.hash);
+  bs_swiss_bgpstream_ipv6_pfx_set_destroy(&set->v6.hash);
   free(set);
 }
 
 void bgpstream_pfx_set_clear(bgpstream_pfx_set_t *set)
 {
-  kh_clear(bgpstream_ipv4_pfx_set, set->v4hash);
-  kh_clear(bgpstream_ipv6_pfx_set, set->v6hash);
+  bs_swiss_bgpstream_ipv4_pfx_set_clear(&set->v4.hash);
+  bs_swiss_bgpstream_ipv6_pfx_set_clear(&set->v6.hash);
 }
 
 int bgpstream_pfx_set_iterate(bgpstream_pfx_set_t *set,
     void (*callback)(bgpstream_pfx_t *, void *), void *userdata)
 {
-  bgpstream_ipv4_pfx_set_t v4set;
-  bgpstream_ipv6_pfx_set_t v6set;
-
-  v4set.hash = set->v4hash;
-  v6set.hash = set->v6hash;
-  if (bgpstream_ipv4_pfx_set_iterate(&v4set, callback, userdata) < 0 ||
-      bgpstream_ipv6_pfx_set_iterate(&v6set, callback, userdata) < 0) {
+  if (bgpstream_ipv4_pfx_set_iterate(&set->v4, callback, userdata) < 0 ||
+      bgpstream_ipv6_pfx_set_iterate(&set->v6, callback, userdata) < 0) {
     return -1;
   }
   return 0;
@@ -184,81 +199,62 @@ bgpstream_ipv4_pfx_set_t *bgpstream_ipv4_pfx_set_create()
     return NULL;
   }
 
-  if ((set->hash = kh_init(bgpstream_ipv4_pfx_set)) == NULL) {
-    bgpstream_ipv4_pfx_set_destroy(set);
-    return NULL;
-  }
-
+  bs_swiss_bgpstream_ipv4_pfx_set_init(&set->hash);
   return set;
 }
 
-static inline int v4hash_insert(khash_t(bgpstream_ipv4_pfx_set) *hash,
-                                bgpstream_ipv4_pfx_t *pfx)
-{
-  int khret;
-  if (kh_get(bgpstream_ipv4_pfx_set, hash, *pfx) != kh_end(hash))
-    return 0;
-  kh_put(bgpstream_ipv4_pfx_set, hash, *pfx, &khret);
-  return (khret < 0) ? -1 : 1;
-}
-
 int bgpstream_ipv4_pfx_set_insert(bgpstream_ipv4_pfx_set_t *set,
                                   bgpstream_ipv4_pfx_t *pfx)
 {
-  return v4hash_insert(set->hash, pfx);
+  return bs_swiss_bgpstream_ipv4_pfx_set_put(&set->hash, V4_KEY(pfx));
 }
 
 int bgpstream_ipv4_pfx_set_exists(bgpstream_ipv4_pfx_set_t *set,
                                   bgpstream_ipv4_pfx_t *pfx)
 {
-  return kh_get(bgpstream_ipv4_pfx_set, set->hash, *pfx) != kh_end(set->hash);
+  return bs_swiss_bgpstream_ipv4_pfx_set_get(&set->hash, V4_KEY(pfx)) !=
+         bs_swiss_end(&set->hash);
 }
 
 int bgpstream_ipv4_pfx_set_size(bgpstream_ipv4_pfx_set_t *set)
 {
-  return kh_size(set->hash);
+  return bs_swiss_size(&set->hash);
 }
 
-static inline int v4hash_merge(khash_t(bgpstream_ipv4_pfx_set) *dst_hash,
-                               khash_t(bgpstream_ipv4_pfx_set) *src_hash)
+int bgpstream_ipv4_pfx_set_merge(bgpstream_ipv4_pfx_set_t *dst_set,
+                                 bgpstream_ipv4_pfx_set_t *src_set)
 {
-  khiter_t k;
-  for (k = kh_begin(src_hash); k != kh_end(src_hash); ++k) {
-    if (kh_exist(src_hash, k)) {
-      if (v4hash_insert(dst_hash, &(kh_key(src_hash, k))) < 0) {
-        return -1;
-      }
+  uint32_t k;
+  for (k = bs_swiss_begin(&src_set->hash); k != bs_swiss_end(&src_set->hash);
+       ++k) {
+    if (BS_SWISS_FULL(&src_set->hash, k) &&
+        bs_swiss_bgpstream_ipv4_pfx_set_put(
+          &dst_set->hash, bs_swiss_key(&src_set->hash, k)) < 0) {
+      return -1;
     }
   }
   return 0;
 }
 
-int bgpstream_ipv4_pfx_set_merge(bgpstream_ipv4_pfx_set_t *dst_set,
-                                 bgpstream_ipv4_pfx_set_t *src_set)
-{
-  return v4hash_merge(dst_set->hash, src_set->hash);
-}
-
 void bgpstream_ipv4_pfx_set_destroy(bgpstream_ipv4_pfx_set_t *set)
 {
-  kh_destroy(bgpstream_ipv4_pfx_set, set->hash);
+  bs_swiss_bgpstream_ipv4_pfx_set_destroy(&set->hash);
   free(set);
 }
 
 void bgpstream_ipv4_pfx_set_clear(bgpstream_ipv4_pfx_set_t *set)
 {
-  kh_clear(bgpstream_ipv4_pfx_set, set->hash);
+  bs_swiss_bgpstream_ipv4_pfx_set_clear(&set->hash);
 }
 
 int bgpstream_ipv4_pfx_set_iterate(bgpstream_ipv4_pfx_set_t *set,
         void (*callback)(bgpstream_pfx_t *, void *), void *userdata)
 {
-  khiter_t k;
+  uint32_t k;
   bgpstream_pfx_t pfx;
-  for (k = kh_begin(set->hash); k != kh_end(set->hash); ++k) {
-    if (kh_exist(set->hash, k)) {
-      pfx.bs_ipv4 = kh_key(set->hash, k);
-      pfx.address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+  for (k = bs_swiss_begin(&set->hash); k != bs_swiss_end(&set->hash); ++k) {
+    if (BS_SWISS_FULL(&set->hash, k)) {
+      v4key_to_pfx(bs_swiss_key(&set->hash, k), &pfx);
       callback(&pfx, userdata);
     }
   }
@@ -276,85 +272,65 @@ bgpstream_ipv6_pfx_set_t *bgpstream_ipv6_pfx_set_create()
     return NULL;
   }
 
-  if ((set->hash = kh_init(bgpstream_ipv6_pfx_set)) == NULL) {
-    bgpstream_ipv6_pfx_set_destroy(set);
-    return NULL;
-  }
-
+  bs_swiss_bgpstream_ipv6_pfx_set_init(&set->hash);
   return set;
 }
 
-static inline int v6hash_insert(khash_t(bgpstream_ipv6_pfx_set) *hash,
-                                bgpstream_ipv6_pfx_t *pfx)
-{
-  int khret;
-  if (kh_get(bgpstream_ipv6_pfx_set, hash, *pfx) != kh_end(hash))
-    return 0;
-  kh_put(bgpstream_ipv6_pfx_set, hash, *pfx, &khret);
-  return (khret < 0) ? -1 : 1;
-}
-
 int bgpstream_ipv6_pfx_set_insert(bgpstream_ipv6_pfx_set_t *set,
                                   bgpstream_ipv6_pfx_t *pfx)
 {
-  return v6hash_insert(set->hash, pfx);
+  return bs_swiss_bgpstream_ipv6_pfx_set_put(&set->hash, *pfx);
 }
 
 int bgpstream_ipv6_pfx_set_exists(bgpstream_ipv6_pfx_set_t *set,
                                   bgpstream_ipv6_pfx_t *pfx)
 {
-  return kh_get(bgpstream_ipv6_pfx_set, set->hash, *pfx) != kh_end(set->hash);
+  return bs_swiss_bgpstream_ipv6_pfx_set_get(&set->hash, *pfx) !=
+         bs_swiss_end(&set->hash);
 }
 
 int bgpstream_ipv6_pfx_set_size(bgpstream_ipv6_pfx_set_t *set)
 {
-  return kh_size(set->hash);
+  return bs_swiss_size(&set->hash);
 }
 
-static inline int v6hash_merge(khash_t(bgpstream_ipv6_pfx_set) *dst_hash,
-                               khash_t(bgpstream_ipv6_pfx_set) *src_hash)
+int bgpstream_ipv6_pfx_set_merge(bgpstream_ipv6_pfx_set_t *dst_set,
+                                 bgpstream_ipv6_pfx_set_t *src_set)
 {
-  khiter_t k;
-  for (k = kh_begin(src_hash); k != kh_end(src_hash); ++k) {
-    if (kh_exist(src_hash, k)) {
-      if (v6hash_insert(dst_hash, &(kh_key(src_hash, k))) < 0) {
-        return -1;
-      }
+  uint32_t k;
+  for (k = bs_swiss_begin(&src_set->hash); k != bs_swiss_end(&src_set->hash);
+       ++k) {
+    if (BS_SWISS_FULL(&src_set->hash, k) &&
+        bs_swiss_bgpstream_ipv6_pfx_set_put(
+          &dst_set->hash, bs_swiss_key(&src_set->hash, k)) < 0) {
+      return -1;
     }
   }
   return 0;
 }
 
-int bgpstream_ipv6_pfx_set_merge(bgpstream_ipv6_pfx_set_t *dst_set,
-                                 bgpstream_ipv6_pfx_set_t *src_set)
-{
-  return v6hash_merge(dst_set->hash, src_set->hash);
-}
-
 void bgpstream_ipv6_pfx_set_destroy(bgpstream_ipv6_pfx_set_t *set)
 {
-  kh_destroy(bgpstream_ipv6_pfx_set, set->hash);
+  bs_swiss_bgpstream_ipv6_pfx_set_destroy(&set->hash);
   free(set);
 }
 
 void bgpstream_ipv6_pfx_set_clear(bgpstream_ipv6_pfx_set_t *set)
 {
-  kh_clear(bgpstream_ipv6_pfx_set, set->hash);
+  bs_swiss_bgpstream_ipv6_pfx_set_clear(&set->hash);
 }
 
 int bgpstream_ipv6_pfx_set_iterate(bgpstream_ipv6_pfx_set_t *set,
         void (*callback)(bgpstream_pfx_t *, void *), void *userdata)
 {
-  khiter_t k;
+  uint32_t k;
   bgpstream_pfx_t pfx;
-  for (k = kh_begin(set->hash); k != kh_end(set->hash); ++k) {
-    if (kh_exist(set->hash, k)) {
-      pfx.bs_ipv6 = kh_key(set->hash, k);
+  for (k = bs_swiss_begin(&set->hash); k != bs_swiss_end(&set->hash); ++k) {
+    if (BS_SWISS_FULL(&set->hash, k)) {
+      pfx.bs_ipv6 = bs_swiss_key(&set->hash, k);
       pfx.address.version = BGPSTREAM_ADDR_VERSION_IPV6;
       callback(&pfx, userdata);
     }
   }
   return 0;
 }
-
-
@@ -0,0 +1,1779 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "khash.h"
+#include "utils.h"
+
+#include "bgpstream_log.h"
+#include "bgpstream_utils_patricia.h"
+#include "bgpstream_utils_rib.h"
+
+/* Longest collector name used as a key: "<collector>/<router>" */
+#define RIB_COLL_KEY_LEN (BGPSTREAM_UTILS_STR_NAME_LEN * 2)
+
+/* RIB files (see bgpstream_rib_save) */
+#define RIB_FILE_MAGIC 0x42535242
+#define RIB_FILE_VERSION 1
+#define RIB_FILE_BYTE_ORDER 0x01020304
+#define RIB_FILE_PATHS_SUFFIX ".paths"
+#define RIB_FILE_TEMP_SUFFIX ".temp"
+
+/* Routes with this attribute ID are tombstones: withdrawals seen while a RIB
+ * dump of the peer's collector is being applied, which must not be undone by
+ * the (older) routes of the dump */
+#define RIB_TOMBSTONE 0
+
+/* Routes of one prefix, sorted by peer ID, stored as the user pointer of its
+ * patricia node */
+typedef struct route_list {
+
+  bgpstream_rib_route_t *routes;
+
+  /* Number of routes, tombstones included */
+  uint32_t routes_cnt;
+
+  uint32_t routes_alloc_cnt;
+
+  /* Number of routes that are not tombstones */
+  uint32_t live_cnt;
+
+} route_list_t;
+
+/* An interned next hop and community set, shared by the routes that have
+ * both */
+typedef struct attrs {
+
+  bgpstream_ip_addr_t next_hop;
+
+  bgpstream_community_set_t *comms;
+
+  /* Number of routes (and tracked changes) that use these attributes */
+  uint32_t refcnt;
+
+  uint32_t id;
+
+} attrs_t;
+
+static khint32_t attrs_hash(attrs_t *attrs)
+{
+  return bgpstream_community_set_hash(attrs->comms) ^
+         (khint32_t)bgpstream_addr_hash(&attrs->next_hop);
+}
+
+static int attrs_equal(attrs_t *attrs1, attrs_t *attrs2)
+{
+  return bgpstream_addr_equal(&attrs1->next_hop, &attrs2->next_hop) &&
+         bgpstream_community_set_equal(attrs1->comms, attrs2->comms);
+}
+
+KHASH_INIT(rib_attrs, attrs_t *, char, 0, attrs_hash, attrs_equal)
+
+/* A route whose state when the RIB was marked has been saved */
+typedef struct log_key {
+
+  bgpstream_pfx_t pfx;
+
+  bgpstream_peer_id_t peer_id;
+
+} log_key_t;
+
+typedef struct log_val {
+
+  /* The route when the RIB was marked, if present is set */
+  bgpstream_rib_route_t route;
+
+  uint8_t present;
+
+} log_val_t;
+
+static khint32_t log_key_hash(log_key_t key)
+{
+  return (khint32_t)bgpstream_pfx_hash(&key.pfx) * 31 + key.peer_id;
+}
+
+static int log_key_equal(log_key_t key1, log_key_t key2)
+{
+  return key1.peer_id == key2.peer_id && bgpstream_pfx_equal(&key1.pfx,
+                                                             &key2.pfx);
+}
+
+KHASH_INIT(rib_log, log_key_t, log_val_t, 1, log_key_hash, log_key_equal)
+
+KHASH_INIT(rib_coll, char *, uint16_t, 1, kh_str_hash_func, kh_str_hash_equal)
+
+/* A collector (or a router of a collector) that peers belong to */
+typedef struct coll {
+
+  /* Dump time of the RIB dump being applied, if syncing is set */
+  uint32_t dump_time;
+
+  uint8_t syncing;
+
+} coll_t;
+
+typedef struct peer {
+
+  /* Number of routes, not counting tombstones */
+  uint32_t routes_cnt;
+
+  /* Number of tombstones */
+  uint32_t tombs_cnt;
+
+  uint32_t last_time;
+
+  /* Time the session was (last) established at, if session_syncing is set */
+  uint32_t session_time;
+
+  /* Index of the collector of the peer */
+  uint16_t coll;
+
+  uint8_t state;
+
+  uint8_t session_syncing;
+
+  uint8_t known;
+
+} peer_t;
+
+struct bgpstream_rib {
+
+  /* Patricia tree of the prefixes that have routes (or tombstones) */
+  bgpstream_patricia_tree_t *pt;
+
+  bgpstream_as_path_store_t *path_store;
+
+  bgpstream_peer_sig_map_t *peer_sigs;
+
+  /* Peers, indexed by peer ID (which the peer sig map hands out in order) */
+  peer_t *peers;
+
+  uint32_t peers_alloc_cnt;
+
+  /* Collectors, and their index by name */
+  coll_t *colls;
+
+  uint16_t colls_cnt;
+
+  khash_t(rib_coll) *coll_idx;
+
+  /* Interned attributes, and their index by ID */
+  khash_t(rib_attrs) *attrs;
+
+  attrs_t **attrs_by_id;
+
+  uint32_t attrs_alloc_cnt;
+
+  /* IDs of destroyed attributes, to be reused */
+  uint32_t *free_ids;
+
+  uint32_t free_ids_cnt;
+
+  /* Next ID never handed out */
+  uint32_t next_attrs_id;
+
+  /* Used for elems without communities or AS path */
+  bgpstream_community_set_t *empty_comms;
+
+  bgpstream_as_path_t *empty_path;
+
+  /* State of the routes that changed since the RIB was marked */
+  khash_t(rib_log) *log;
+
+  int marked;
+
+  /* Called for the routes removed by purges */
+  bgpstream_rib_route_cb_t *purge_cb;
+
+  void *purge_user;
+
+  /* The record given to bgpstream_rib_begin_record, and its collector */
+  const bgpstream_record_t *cur_record;
+
+  uint16_t cur_coll;
+
+  char cur_coll_key[RIB_COLL_KEY_LEN];
+
+  /* Latest time of the records applied */
+  uint32_t last_time;
+
+  uint64_t pfx_cnt;
+
+  uint64_t route_cnt;
+};
+
+/* A RIB file is this header, followed by the collectors (each with its
+ * name), the peers, the attributes (each with its communities and large
+ * communities) and the prefixes (each with its routes), in host byte order.
+ * The IDs in the file are the ones the RIB used when it was saved */
+typedef struct rib_file_hdr {
+
+  uint32_t magic;
+
+  uint32_t version;
+
+  uint32_t byte_order;
+
+  uint32_t last_time;
+
+  uint32_t colls_cnt;
+
+  uint32_t peers_cnt;
+
+  uint32_t attrs_cnt;
+
+  /* Attribute IDs in the file are lower than this */
+  uint32_t attrs_max_id;
+
+  uint64_t pfxs_cnt;
+
+} rib_file_hdr_t;
+
+typedef struct rib_file_coll {
+
+  uint32_t dump_time;
+
+  uint16_t name_len;
+
+  uint8_t syncing;
+
+} rib_file_coll_t;
+
+typedef struct rib_file_peer {
+
+  bgpstream_ip_addr_t peer_ip;
+
+  uint32_t peer_asn;
+
+  uint32_t last_time;
+
+  uint32_t session_time;
+
+  bgpstream_peer_id_t peer_id;
+
+  uint16_t coll;
+
+  uint8_t state;
+
+  uint8_t session_syncing;
+
+} rib_file_peer_t;
+
+typedef struct rib_file_attrs {
+
+  bgpstream_ip_addr_t next_hop;
+
+  uint32_t id;
+
+  uint32_t comms_cnt;
+
+  uint32_t large_comms_cnt;
+
+} rib_file_attrs_t;
+
+typedef struct rib_file_pfx {
+
+  bgpstream_pfx_t pfx;
+
+  uint32_t routes_cnt;
+
+} rib_file_pfx_t;
+
+/* What a purge removes: the tombstones, and the routes older than a time, of
+ * either one peer or every peer of a collector */
+typedef struct purge {
+
+  bgpstream_rib_t *rib;
+
+  bgpstream_peer_id_t peer_id;
+
+  uint16_t coll;
+
+  uint32_t before;
+
+  /* Prefixes left without routes, removed from the tree after the walk */
+  bgpstream_pfx_t *empty;
+
+  uint32_t empty_cnt;
+
+  uint32_t empty_alloc_cnt;
+
+  int err;
+
+} purge_t;
+
+typedef struct walk {
+
+  bgpstream_peer_id_t peer_id;
+
+  bgpstream_rib_route_cb_t *cb;
+
+  void *user;
+
+  int ret;
+
+} walk_t;
+
+static void route_list_destroy(void *user)
+{
+  route_list_t *list = user;
+
+  if (list == NULL) {
+    return;
+  }
+  free(list->routes);
+  free(list);
+}
+
+/* Find the route of a peer in a list. Returns 1 if it is there, with its index
+ * in idx, and 0 otherwise, with the index it would be inserted at */
+static int find_route(const route_list_t *list, bgpstream_peer_id_t peer_id,
+                      uint32_t *idx)
+{
+  uint32_t lo = 0, hi = list->routes_cnt, mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (list->routes[mid].peer_id < peer_id) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  *idx = lo;
+  return lo < list->routes_cnt && list->routes[lo].peer_id == peer_id;
+}
+
+static int route_equal(const bgpstream_rib_route_t *route1,
+                       const bgpstream_rib_route_t *route2)
+{
+  return route1->attrs_id == route2->attrs_id &&
+         route1->path_id.path_hash == route2->path_id.path_hash &&
+         route1->path_id.path_id == route2->path_id.path_id;
+}
+
+/* ==================== ATTRIBUTES ==================== */
+
+static void attrs_ref(bgpstream_rib_t *rib, uint32_t id)
+{
+  if (id != RIB_TOMBSTONE) {
+    rib->attrs_by_id[id]->refcnt++;
+  }
+}
+
+static void attrs_unref(bgpstream_rib_t *rib, uint32_t id)
+{
+  attrs_t *attrs;
+  khiter_t k;
+
+  if (id == RIB_TOMBSTONE || --rib->attrs_by_id[id]->refcnt > 0) {
+    return;
+  }
+  attrs = rib->attrs_by_id[id];
+  if ((k = kh_get(rib_attrs, rib->attrs, attrs)) != kh_end(rib->attrs)) {
+    kh_del(rib_attrs, rib->attrs, k);
+  }
+  rib->attrs_by_id[id] = NULL;
+  // free_ids has room for every ID handed out
+  rib->free_ids[rib->free_ids_cnt++] = id;
+  bgpstream_community_set_destroy(attrs->comms);
+  free(attrs);
+}
+
+/* Get a reference to the interned copy of the given attributes. Returns their
+ * ID, or 0 if an error occurred */
+static uint32_t attrs_get(bgpstream_rib_t *rib,
+                          const bgpstream_ip_addr_t *next_hop,
+                          bgpstream_community_set_t *comms)
+{
+  attrs_t key, *attrs = NULL;
+  attrs_t **by_id;
+  uint32_t *free_ids;
+  uint32_t id, alloc_cnt;
+  khiter_t k;
+  int khret;
+
+  bgpstream_addr_copy(&key.next_hop, next_hop);
+  key.comms = comms != NULL ? comms : rib->empty_comms;
+  if ((k = kh_get(rib_attrs, rib->attrs, &key)) != kh_end(rib->attrs)) {
+    attrs = kh_key(rib->attrs, k);
+    attrs->refcnt++;
+    return attrs->id;
+  }
+
+  if (rib->free_ids_cnt > 0) {
+    id = rib->free_ids[--rib->free_ids_cnt];
+  } else {
+    if (rib->next_attrs_id >= rib->attrs_alloc_cnt) {
+      alloc_cnt = rib->attrs_alloc_cnt * 2 + 16;
+      if ((by_id = realloc(rib->attrs_by_id, sizeof(attrs_t *) * alloc_cnt)) ==
+          NULL) {
+        return 0;
+      }
+      rib->attrs_by_id = by_id;
+      if ((free_ids = realloc(rib->free_ids, sizeof(uint32_t) * alloc_cnt)) ==
+          NULL) {
+        return 0;
+      }
+      rib->free_ids = free_ids;
+      rib->attrs_alloc_cnt = alloc_cnt;
+    }
+    id = rib->next_attrs_id++;
+  }
+
+  if ((attrs = malloc_zero(sizeof(attrs_t))) == NULL ||
+      (attrs->comms = bgpstream_community_set_create()) == NULL ||
+      bgpstream_community_set_copy(attrs->comms, key.comms) != 0) {
+    goto err;
+  }
+  bgpstream_addr_copy(&attrs->next_hop, next_hop);
+  attrs->id = id;
+  attrs->refcnt = 1;
+  k = kh_put(rib_attrs, rib->attrs, attrs, &khret);
+  if (khret < 0) {
+    goto err;
+  }
+  rib->attrs_by_id[id] = attrs;
+  return id;
+
+err:
+  if (attrs != NULL) {
+    bgpstream_community_set_destroy(attrs->comms);
+    free(attrs);
+  }
+  rib->free_ids[rib->free_ids_cnt++] = id;
+  return 0;
+}
+
+/* Destroy every interned attribute, regardless of their references */
+static void attrs_clear(bgpstream_rib_t *rib)
+{
+  uint32_t id;
+
+  for (id = 1; id < rib->next_attrs_id; id++) {
+    if (rib->attrs_by_id[id] != NULL) {
+      bgpstream_community_set_destroy(rib->attrs_by_id[id]->comms);
+      free(rib->attrs_by_id[id]);
+      rib->attrs_by_id[id] = NULL;
+    }
+  }
+  kh_clear(rib_attrs, rib->attrs);
+  rib->free_ids_cnt = 0;
+  rib->next_attrs_id = 1;
+}
+
+/* ==================== ROUTES ==================== */
+
+/* Save the state of a route before its first change since the mark */
+static int log_change(bgpstream_rib_t *rib, const bgpstream_pfx_t *pfx,
+                      bgpstream_peer_id_t peer_id,
+                      const bgpstream_rib_route_t *old)
+{
+  log_key_t key;
+  khiter_t k;
+  int khret;
+
+  if (!rib->marked) {
+    return 0;
+  }
+  memset(&key, 0, sizeof(key));
+  bgpstream_pfx_copy(&key.pfx, pfx);
+  key.peer_id = peer_id;
+  k = kh_put(rib_log, rib->log, key, &khret);
+  if (khret < 0) {
+    return -1;
+  }
+  if (khret == 0) {
+    // already saved
+    return 0;
+  }
+  if (old != NULL && old->attrs_id != RIB_TOMBSTONE) {
+    kh_val(rib->log, k).route = *old;
+    kh_val(rib->log, k).present = 1;
+    attrs_ref(rib, old->attrs_id);
+  } else {
+    kh_val(rib->log, k).present = 0;
+  }
+  return 0;
+}
+
+static void log_clear(bgpstream_rib_t *rib)
+{
+  khiter_t k;
+
+  for (k = kh_begin(rib->log); k != kh_end(rib->log); ++k) {
+    if (kh_exist(rib->log, k) && kh_val(rib->log, k).present) {
+      attrs_unref(rib, kh_val(rib->log, k).route.attrs_id);
+    }
+  }
+  kh_clear(rib_log, rib->log);
+}
+
+/* Count a route that was added to (add set) or removed from a list */
+static void account_route(bgpstream_rib_t *rib, route_list_t *list,
+                          const bgpstream_rib_route_t *route, int add)
+{
+  peer_t *peer = &rib->peers[route->peer_id];
+
+  if (route->attrs_id == RIB_TOMBSTONE) {
+    if (add) {
+      peer->tombs_cnt++;
+    } else {
+      peer->tombs_cnt--;
+    }
+    return;
+  }
+  if (add) {
+    peer->routes_cnt++;
+    rib->route_cnt++;
+    if (list->live_cnt++ == 0) {
+      rib->pfx_cnt++;
+    }
+  } else {
+    peer->routes_cnt--;
+    rib->route_cnt--;
+    if (--list->live_cnt == 0) {
+      rib->pfx_cnt--;
+    }
+  }
+}
+
+/* Set the route of a peer to a prefix, taking over the reference to the
+ * attributes of the route */
+static int set_route(bgpstream_rib_t *rib, const bgpstream_pfx_t *pfx,
+                     const bgpstream_rib_route_t *route)
+{
+  bgpstream_patricia_node_t *node;
+  bgpstream_rib_route_t *routes;
+  route_list_t *list;
+  uint32_t i, alloc_cnt;
+
+  if ((node = bgpstream_patricia_tree_search_exact(rib->pt, pfx)) == NULL &&
+      (node = bgpstream_patricia_tree_insert(rib->pt, pfx)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not insert RIB prefix");
+    return -1;
+  }
+  if ((list = bgpstream_patricia_tree_get_user(node)) == NULL) {
+    if ((list = malloc_zero(sizeof(route_list_t))) == NULL) {
+      return -1;
+    }
+    bgpstream_patricia_tree_set_user(rib->pt, node, list);
+  }
+
+  if (find_route(list, route->peer_id, &i)) {
+    if (log_change(rib, pfx, route->peer_id, &list->routes[i]) != 0) {
+      return -1;
+    }
+    account_route(rib, list, &list->routes[i], 0);
+    attrs_unref(rib, list->routes[i].attrs_id);
+    list->routes[i] = *route;
+    account_route(rib, list, route, 1);
+    return 0;
+  }
+
+  if (log_change(rib, pfx, route->peer_id, NULL) != 0) {
+    return -1;
+  }
+  if (list->routes_cnt == list->routes_alloc_cnt) {
+    alloc_cnt = list->routes_alloc_cnt * 2 + 1;
+    if ((routes = realloc(list->routes,
+                          sizeof(bgpstream_rib_route_t) * alloc_cnt)) ==
+        NULL) {
+      return -1;
+    }
+    list->routes = routes;
+    list->routes_alloc_cnt = alloc_cnt;
+  }
+  memmove(&list->routes[i + 1], &list->routes[i],
+          sizeof(bgpstream_rib_route_t) * (list->routes_cnt - i));
+  list->routes[i] = *route;
+  list->routes_cnt++;
+  account_route(rib, list, route, 1);
+  return 0;
+}
+
+/* Remove the route at index i of the list of a prefix. The caller removes the
+ * prefix from the tree if the list is left empty */
+static int remove_route(bgpstream_rib_t *rib, const bgpstream_pfx_t *pfx,
+                        route_list_t *list, uint32_t i)
+{
+  if (log_change(rib, pfx, list->routes[i].peer_id, &list->routes[i]) != 0) {
+    return -1;
+  }
+  account_route(rib, list, &list->routes[i], 0);
+  attrs_unref(rib, list->routes[i].attrs_id);
+  memmove(&list->routes[i], &list->routes[i + 1],
+          sizeof(bgpstream_rib_route_t) * (list->routes_cnt - i - 1));
+  list->routes_cnt--;
+  return 0;
+}
+
+static bgpstream_patricia_walk_cb_result_t
+purge_node(const bgpstream_patricia_tree_t *pt,
+           const bgpstream_patricia_node_t *node, void *data)
+{
+  purge_t *purge = data;
+  bgpstream_rib_t *rib = purge->rib;
+  route_list_t *list =
+    bgpstream_patricia_tree_get_user(bgpstream_nonconst_node(node));
+  const bgpstream_pfx_t *pfx = bgpstream_patricia_tree_get_pfx(node);
+  bgpstream_rib_route_t *route;
+  bgpstream_pfx_t *empty;
+  uint32_t i, alloc_cnt;
+  int mine;
+
+  if (list == NULL) {
+    return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+  }
+  i = 0;
+  while (i < list->routes_cnt) {
+    route = &list->routes[i];
+    mine = purge->peer_id != 0 ? route->peer_id == purge->peer_id
+                               : rib->peers[route->peer_id].coll == purge->coll;
+    if (!mine ||
+        (route->attrs_id != RIB_TOMBSTONE && route->time >= purge->before)) {
+      i++;
+      continue;
+    }
+    if (rib->purge_cb != NULL && route->attrs_id != RIB_TOMBSTONE &&
+        rib->purge_cb(pfx, route, rib->purge_user) != 0) {
+      purge->err = 1;
+      return BGPSTREAM_PATRICIA_WALK_END_ALL;
+    }
+    if (remove_route(rib, pfx, list, i) != 0) {
+      purge->err = 1;
+      return BGPSTREAM_PATRICIA_WALK_END_ALL;
+    }
+  }
+
+  if (list->routes_cnt == 0) {
+    if (purge->empty_cnt == purge->empty_alloc_cnt) {
+      alloc_cnt = purge->empty_alloc_cnt * 2 + 64;
+      if ((empty = realloc(purge->empty, sizeof(bgpstream_pfx_t) *
+                                           alloc_cnt)) == NULL) {
+        // the prefix is left in the tree, with no routes
+        return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+      }
+      purge->empty = empty;
+      purge->empty_alloc_cnt = alloc_cnt;
+    }
+    bgpstream_pfx_copy(&purge->empty[purge->empty_cnt++], pfx);
+  }
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+/* Remove the tombstones and the routes older than before, of one peer (if
+ * peer_id is not 0) or of every peer of a collector */
+static int purge_routes(bgpstream_rib_t *rib, bgpstream_peer_id_t peer_id,
+                        uint16_t coll, uint32_t before)
+{
+  purge_t purge;
+  uint32_t i;
+
+  memset(&purge, 0, sizeof(purge));
+  purge.rib = rib;
+  purge.peer_id = peer_id;
+  purge.coll = coll;
+  purge.before = before;
+  bgpstream_patricia_tree_walk(rib->pt, purge_node, &purge);
+
+  for (i = 0; i < purge.empty_cnt; i++) {
+    bgpstream_patricia_tree_remove(rib->pt, &purge.empty[i]);
+  }
+  free(purge.empty);
+
+  if (purge.err) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not purge RIB routes");
+    return -1;
+  }
+  return 0;
+}
+
+/* ==================== PEERS ==================== */
+
+/* Find (or add) a collector */
+static int get_coll_idx(bgpstream_rib_t *rib, const char *key, uint16_t *idx)
+{
+  coll_t *colls;
+  char *name;
+  khiter_t k;
+  int khret;
+
+  if ((k = kh_get(rib_coll, rib->coll_idx, (char *)key)) !=
+      kh_end(rib->coll_idx)) {
+    *idx = kh_val(rib->coll_idx, k);
+    return 0;
+  }
+
+  if (rib->colls_cnt == UINT16_MAX) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Too many collectors in the RIB");
+    return -1;
+  }
+  if ((colls = realloc(rib->colls, sizeof(coll_t) * (rib->colls_cnt + 1))) ==
+      NULL) {
+    return -1;
+  }
+  rib->colls = colls;
+  if ((name = strdup(key)) == NULL) {
+    return -1;
+  }
+  k = kh_put(rib_coll, rib->coll_idx, name, &khret);
+  if (khret < 0) {
+    free(name);
+    return -1;
+  }
+  memset(&rib->colls[rib->colls_cnt], 0, sizeof(coll_t));
+  *idx = kh_val(rib->coll_idx, k) = rib->colls_cnt++;
+  return 0;
+}
+
+/* Find (or add) the collector of a record */
+static int get_coll(bgpstream_rib_t *rib, const bgpstream_record_t *record,
+                    char *key, uint16_t *idx)
+{
+  if (record->router_name[0] != '\0') {
+    snprintf(key, RIB_COLL_KEY_LEN, "%s/%s", record->collector_name,
+             record->router_name);
+  } else {
+    snprintf(key, RIB_COLL_KEY_LEN, "%s", record->collector_name);
+  }
+  return get_coll_idx(rib, key, idx);
+}
+
+/* Make room for a peer, which is added to the given collector unless it is
+ * already known */
+static peer_t *alloc_peer(bgpstream_rib_t *rib, bgpstream_peer_id_t peer_id,
+                          uint16_t coll)
+{
+  peer_t *peers;
+  uint32_t alloc_cnt;
+
+  if (peer_id >= rib->peers_alloc_cnt) {
+    alloc_cnt = peer_id * 2 + 1;
+    if (alloc_cnt > (uint32_t)UINT16_MAX + 1) {
+      alloc_cnt = (uint32_t)UINT16_MAX + 1;
+    }
+    if ((peers = realloc(rib->peers, sizeof(peer_t) * alloc_cnt)) == NULL) {
+      return NULL;
+    }
+    memset(&peers[rib->peers_alloc_cnt], 0,
+           sizeof(peer_t) * (alloc_cnt - rib->peers_alloc_cnt));
+    rib->peers = peers;
+    rib->peers_alloc_cnt = alloc_cnt;
+  }
+  if (!rib->peers[peer_id].known) {
+    rib->peers[peer_id].known = 1;
+    rib->peers[peer_id].coll = coll;
+  }
+  return &rib->peers[peer_id];
+}
+
+static void colls_clear(bgpstream_rib_t *rib)
+{
+  khiter_t k;
+
+  for (k = kh_begin(rib->coll_idx); k != kh_end(rib->coll_idx); ++k) {
+    if (kh_exist(rib->coll_idx, k)) {
+      free(kh_key(rib->coll_idx, k));
+    }
+  }
+  kh_clear(rib_coll, rib->coll_idx);
+  rib->colls_cnt = 0;
+}
+
+/* Get the peer of an elem, which must be of the current record */
+static peer_t *get_peer(bgpstream_rib_t *rib, const bgpstream_record_t *record,
+                        bgpstream_elem_t *elem, bgpstream_peer_id_t *peer_id)
+{
+  if (record->router_name[0] == '\0') {
+    *peer_id = bgpstream_peer_sig_map_get_id_cached(
+      rib->peer_sigs, record->collector_id, rib->cur_coll_key, &elem->peer_ip,
+      elem->peer_asn);
+  } else {
+    *peer_id = bgpstream_peer_sig_map_get_id(
+      rib->peer_sigs, rib->cur_coll_key, &elem->peer_ip, elem->peer_asn);
+  }
+  if (*peer_id == 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not get the ID of a RIB peer");
+    return NULL;
+  }
+  return alloc_peer(rib, *peer_id, rib->cur_coll);
+}
+
+/* Returns 1 if the route of the peer changed, 0 if it did not, and -1 if an
+ * error occurred. old is the current route of the peer (or tombstone), if it
+ * has one */
+static int add_route(bgpstream_rib_t *rib, bgpstream_peer_id_t peer_id,
+                     const bgpstream_record_t *record, bgpstream_elem_t *elem,
+                     const bgpstream_rib_route_t *old)
+{
+  bgpstream_rib_route_t route;
+  bgpstream_as_path_t *path;
+  int changed;
+
+  memset(&route, 0, sizeof(route));
+  route.peer_id = peer_id;
+  route.time = record->time_sec;
+  if ((path = bgpstream_elem_get_as_path(elem)) == NULL) {
+    path = rib->empty_path;
+  }
+  if (bgpstream_as_path_store_get_path_id(rib->path_store, path,
+                                          elem->peer_asn, &route.path_id) !=
+      0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not store RIB AS path");
+    return -1;
+  }
+  if ((route.attrs_id = attrs_get(rib, &elem->nexthop,
+                                  bgpstream_elem_get_communities(elem))) ==
+      0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not store RIB route attributes");
+    return -1;
+  }
+  // attributes are interned, so equal IDs mean equal attributes
+  changed = old == NULL || !route_equal(old, &route);
+  if (set_route(rib, &elem->prefix, &route) != 0) {
+    attrs_unref(rib, route.attrs_id);
+    return -1;
+  }
+  return changed;
+}
+
+static int withdraw_route(bgpstream_rib_t *rib, bgpstream_peer_id_t peer_id,
+                          const bgpstream_record_t *record,
+                          bgpstream_elem_t *elem)
+{
+  bgpstream_patricia_node_t *node;
+  bgpstream_rib_route_t tomb;
+  route_list_t *list;
+  uint32_t i;
+  int found, changed;
+
+  found =
+    (node = bgpstream_patricia_tree_search_exact(rib->pt, &elem->prefix)) !=
+      NULL &&
+    (list = bgpstream_patricia_tree_get_user(node)) != NULL &&
+    find_route(list, peer_id, &i);
+  changed = found && list->routes[i].attrs_id != RIB_TOMBSTONE;
+
+  if (rib->colls[rib->peers[peer_id].coll].syncing) {
+    // keep the withdrawal, so that the RIB dump does not bring the route back
+    memset(&tomb, 0, sizeof(tomb));
+    tomb.peer_id = peer_id;
+    tomb.time = record->time_sec;
+    tomb.attrs_id = RIB_TOMBSTONE;
+    return set_route(rib, &elem->prefix, &tomb) != 0 ? -1 : changed;
+  }
+
+  if (!found) {
+    return 0;
+  }
+  if (remove_route(rib, &elem->prefix, list, i) != 0) {
+    return -1;
+  }
+  if (list->routes_cnt == 0) {
+    bgpstream_patricia_tree_remove_node(rib->pt, node);
+  }
+  return changed;
+}
+
+/* End the RIB dump being applied to a collector. Routes that are not in the
+ * dump are only removed if the end of the dump was seen */
+static int end_dump(bgpstream_rib_t *rib, uint16_t coll, int complete)
+{
+  coll_t *c = &rib->colls[coll];
+
+  c->syncing = 0;
+  return purge_routes(rib, 0, coll, complete ? c->dump_time : 0);
+}
+
+/* ==================== PUBLIC FUNCTIONS ==================== */
+
+bgpstream_rib_t *bgpstream_rib_create(void)
+{
+  bgpstream_rib_t *rib;
+
+  if ((rib = malloc_zero(sizeof(bgpstream_rib_t))) == NULL) {
+    return NULL;
+  }
+  if ((rib->pt = bgpstream_patricia_tree_create(route_list_destroy)) == NULL ||
+      (rib->path_store = bgpstream_as_path_store_create()) == NULL ||
+      (rib->peer_sigs = bgpstream_peer_sig_map_create()) == NULL ||
+      (rib->coll_idx = kh_init(rib_coll)) == NULL ||
+      (rib->attrs = kh_init(rib_attrs)) == NULL ||
+      (rib->log = kh_init(rib_log)) == NULL ||
+      (rib->empty_comms = bgpstream_community_set_create()) == NULL ||
+      (rib->empty_path = bgpstream_as_path_create()) == NULL) {
+    goto err;
+  }
+  // attribute ID 0 is for tombstones
+  rib->next_attrs_id = 1;
+  rib->cur_coll_key[0] = '\0';
+  return rib;
+
+err:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create RIB");
+  bgpstream_rib_destroy(rib);
+  return NULL;
+}
+
+void bgpstream_rib_destroy(bgpstream_rib_t *rib)
+{
+  if (rib == NULL) {
+    return;
+  }
+  if (rib->pt != NULL) {
+    bgpstream_patricia_tree_destroy(rib->pt);
+  }
+  bgpstream_as_path_store_destroy(rib->path_store);
+  bgpstream_peer_sig_map_destroy(rib->peer_sigs);
+  if (rib->coll_idx != NULL) {
+    colls_clear(rib);
+    kh_destroy(rib_coll, rib->coll_idx);
+  }
+  if (rib->attrs != NULL) {
+    attrs_clear(rib);
+    kh_destroy(rib_attrs, rib->attrs);
+  }
+  if (rib->log != NULL) {
+    kh_destroy(rib_log, rib->log);
+  }
+  bgpstream_community_set_destroy(rib->empty_comms);
+  bgpstream_as_path_destroy(rib->empty_path);
+  free(rib->attrs_by_id);
+  free(rib->free_ids);
+  free(rib->peers);
+  free(rib->colls);
+  free(rib);
+}
+
+int bgpstream_rib_begin_record(bgpstream_rib_t *rib,
+                               const bgpstream_record_t *record)
+{
+  coll_t *c;
+
+  rib->cur_record = record;
+  if (get_coll(rib, record, rib->cur_coll_key, &rib->cur_coll) != 0) {
+    rib->cur_record = NULL;
+    return -1;
+  }
+  if (record->time_sec > rib->last_time) {
+    rib->last_time = record->time_sec;
+  }
+  if (record->type != BGPSTREAM_RIB) {
+    return 0;
+  }
+  c = &rib->colls[rib->cur_coll];
+
+  if (record->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+    // part of the dump is missing, so we cannot tell which routes are gone
+    return c->syncing ? end_dump(rib, rib->cur_coll, 0) : 0;
+  }
+  if (c->syncing && c->dump_time == record->dump_time_sec) {
+    return 0;
+  }
+  // a dump with a single record only has its end position
+  if (record->dump_pos == BGPSTREAM_DUMP_START ||
+      record->dump_pos == BGPSTREAM_DUMP_END) {
+    if (c->syncing && end_dump(rib, rib->cur_coll, 0) != 0) {
+      return -1;
+    }
+    c->syncing = 1;
+    c->dump_time = record->dump_time_sec;
+  }
+  return 0;
+}
+
+int bgpstream_rib_add_elem(bgpstream_rib_t *rib,
+                           const bgpstream_record_t *record,
+                           bgpstream_elem_t *elem)
+{
+  bgpstream_patricia_node_t *node;
+  bgpstream_rib_route_t *old = NULL;
+  route_list_t *list;
+  bgpstream_peer_id_t peer_id;
+  peer_t *peer;
+  uint32_t i;
+
+  if (record != rib->cur_record &&
+      bgpstream_rib_begin_record(rib, record) != 0) {
+    return -1;
+  }
+  if ((peer = get_peer(rib, record, elem, &peer_id)) == NULL) {
+    return -1;
+  }
+  peer->last_time = record->time_sec;
+
+  switch (elem->type) {
+  case BGPSTREAM_ELEM_TYPE_RIB:
+  case BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT:
+    if ((node = bgpstream_patricia_tree_search_exact(rib->pt,
+                                                     &elem->prefix)) != NULL &&
+        (list = bgpstream_patricia_tree_get_user(node)) != NULL &&
+        find_route(list, peer_id, &i)) {
+      old = &list->routes[i];
+    }
+    // do not replace routes (or withdrawals) newer than the dump
+    if (elem->type == BGPSTREAM_ELEM_TYPE_RIB && old != NULL &&
+        old->time > record->time_sec) {
+      return 0;
+    }
+    return add_route(rib, peer_id, record, elem, old);
+
+  case BGPSTREAM_ELEM_TYPE_WITHDRAWAL:
+    return withdraw_route(rib, peer_id, record, elem);
+
+  case BGPSTREAM_ELEM_TYPE_PEERSTATE:
+    peer->state = elem->new_state;
+    if (elem->new_state == BGPSTREAM_ELEM_PEERSTATE_ESTABLISHED) {
+      // routes not announced again by the End-of-RIB marker are stale
+      peer->session_syncing = 1;
+      peer->session_time = record->time_sec;
+      return 0;
+    }
+    peer->session_syncing = 0;
+    if (peer->routes_cnt == 0 && peer->tombs_cnt == 0) {
+      return 0;
+    }
+    return purge_routes(rib, peer_id, 0, UINT32_MAX);
+
+  case BGPSTREAM_ELEM_TYPE_END_OF_RIB:
+    if (!peer->session_syncing) {
+      return 0;
+    }
+    peer->session_syncing = 0;
+    return purge_routes(rib, peer_id, 0, peer->session_time);
+
+  default:
+    return 0;
+  }
+}
+
+int bgpstream_rib_end_record(bgpstream_rib_t *rib,
+                             const bgpstream_record_t *record)
+{
+  coll_t *c;
+
+  if (record != rib->cur_record ||
+      record->type != BGPSTREAM_RIB ||
+      record->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD ||
+      record->dump_pos != BGPSTREAM_DUMP_END) {
+    return 0;
+  }
+  c = &rib->colls[rib->cur_coll];
+  if (!c->syncing || c->dump_time != record->dump_time_sec) {
+    return 0;
+  }
+  return end_dump(rib, rib->cur_coll, 1);
+}
+
+void bgpstream_rib_set_purge_cb(bgpstream_rib_t *rib,
+                                bgpstream_rib_route_cb_t *cb, void *user)
+{
+  rib->purge_cb = cb;
+  rib->purge_user = user;
+}
+
+int bgpstream_rib_add_record(bgpstream_rib_t *rib,
+                             bgpstream_record_t *record)
+{
+  bgpstream_elem_t *elem;
+  int rc;
+
+  if (bgpstream_rib_begin_record(rib, record) != 0) {
+    return -1;
+  }
+  while ((rc = bgpstream_record_get_next_elem(record, &elem)) > 0) {
+    if (bgpstream_rib_add_elem(rib, record, elem) < 0) {
+      return -1;
+    }
+  }
+  if (rc < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not read the elems of a record");
+    return -1;
+  }
+  return bgpstream_rib_end_record(rib, record);
+}
+
+int bgpstream_rib_get_route(bgpstream_rib_t *rib, bgpstream_peer_id_t peer_id,
+                            const bgpstream_pfx_t *pfx,
+                            bgpstream_rib_route_t *route)
+{
+  bgpstream_patricia_node_t *node;
+  route_list_t *list;
+  uint32_t i;
+
+  if ((node = bgpstream_patricia_tree_search_exact(rib->pt, pfx)) == NULL ||
+      (list = bgpstream_patricia_tree_get_user(node)) == NULL ||
+      !find_route(list, peer_id, &i) ||
+      list->routes[i].attrs_id == RIB_TOMBSTONE) {
+    return 0;
+  }
+  *route = list->routes[i];
+  return 1;
+}
+
+static bgpstream_patricia_walk_cb_result_t
+walk_node(const bgpstream_patricia_tree_t *pt,
+          const bgpstream_patricia_node_t *node, void *data)
+{
+  walk_t *walk = data;
+  route_list_t *list =
+    bgpstream_patricia_tree_get_user(bgpstream_nonconst_node(node));
+  const bgpstream_pfx_t *pfx = bgpstream_patricia_tree_get_pfx(node);
+  uint32_t i;
+
+  if (list == NULL) {
+    return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+  }
+  if (walk->peer_id != 0) {
+    if (find_route(list, walk->peer_id, &i) &&
+        list->routes[i].attrs_id != RIB_TOMBSTONE &&
+        (walk->ret = walk->cb(pfx, &list->routes[i], walk->user)) != 0) {
+      return BGPSTREAM_PATRICIA_WALK_END_ALL;
+    }
+    return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+  }
+  for (i = 0; i < list->routes_cnt; i++) {
+    if (list->routes[i].attrs_id != RIB_TOMBSTONE &&
+        (walk->ret = walk->cb(pfx, &list->routes[i], walk->user)) != 0) {
+      return BGPSTREAM_PATRICIA_WALK_END_ALL;
+    }
+  }
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+int bgpstream_rib_walk(bgpstream_rib_t *rib, bgpstream_peer_id_t peer_id,
+                       bgpstream_rib_route_cb_t *cb, void *user)
+{
+  walk_t walk;
+
+  walk.peer_id = peer_id;
+  walk.cb = cb;
+  walk.user = user;
+  walk.ret = 0;
+  bgpstream_patricia_tree_walk(rib->pt, walk_node, &walk);
+  return walk.ret;
+}
+
+uint64_t bgpstream_rib_get_pfx_cnt(bgpstream_rib_t *rib)
+{
+  return rib->pfx_cnt;
+}
+
+uint64_t bgpstream_rib_get_route_cnt(bgpstream_rib_t *rib)
+{
+  return rib->route_cnt;
+}
+
+uint32_t bgpstream_rib_get_last_time(bgpstream_rib_t *rib)
+{
+  return rib->last_time;
+}
+
+int bgpstream_rib_get_peer_info(bgpstream_rib_t *rib,
+                                bgpstream_peer_id_t peer_id,
+                                bgpstream_rib_peer_info_t *info)
+{
+  peer_t *peer;
+
+  if (peer_id >= rib->peers_alloc_cnt || !rib->peers[peer_id].known) {
+    return -1;
+  }
+  peer = &rib->peers[peer_id];
+  info->state = peer->state;
+  info->routes_cnt = peer->routes_cnt;
+  info->last_time = peer->last_time;
+  info->syncing = peer->session_syncing || rib->colls[peer->coll].syncing;
+  return 0;
+}
+
+bgpstream_peer_sig_map_t *bgpstream_rib_get_peer_sig_map(bgpstream_rib_t *rib)
+{
+  return rib->peer_sigs;
+}
+
+bgpstream_as_path_t *
+bgpstream_rib_get_as_path(bgpstream_rib_t *rib,
+                          const bgpstream_rib_route_t *route)
+{
+  bgpstream_as_path_store_path_t *spath;
+  bgpstream_peer_sig_t *sig;
+
+  if ((spath = bgpstream_as_path_store_get_store_path(rib->path_store,
+                                                      route->path_id)) ==
+        NULL ||
+      (sig = bgpstream_peer_sig_map_get_sig(rib->peer_sigs,
+                                            route->peer_id)) == NULL) {
+    return NULL;
+  }
+  return bgpstream_as_path_store_path_get_path(spath, sig->peer_asnumber);
+}
+
+bgpstream_as_path_store_t *bgpstream_rib_get_path_store(bgpstream_rib_t *rib)
+{
+  return rib->path_store;
+}
+
+const bgpstream_ip_addr_t *
+bgpstream_rib_get_next_hop(bgpstream_rib_t *rib,
+                           const bgpstream_rib_route_t *route)
+{
+  if (route->attrs_id == RIB_TOMBSTONE ||
+      route->attrs_id >= rib->next_attrs_id ||
+      rib->attrs_by_id[route->attrs_id] == NULL) {
+    return NULL;
+  }
+  return &rib->attrs_by_id[route->attrs_id]->next_hop;
+}
+
+const bgpstream_community_set_t *
+bgpstream_rib_get_communities(bgpstream_rib_t *rib,
+                              const bgpstream_rib_route_t *route)
+{
+  if (route->attrs_id == RIB_TOMBSTONE ||
+      route->attrs_id >= rib->next_attrs_id ||
+      rib->attrs_by_id[route->attrs_id] == NULL) {
+    return NULL;
+  }
+  return rib->attrs_by_id[route->attrs_id]->comms;
+}
+
+int bgpstream_rib_mark(bgpstream_rib_t *rib)
+{
+  log_clear(rib);
+  rib->marked = 1;
+  return 0;
+}
+
+int bgpstream_rib_diff(bgpstream_rib_t *rib, bgpstream_rib_diff_cb_t *cb,
+                       void *user)
+{
+  bgpstream_rib_route_t route;
+  const bgpstream_rib_route_t *old_route, *new_route;
+  log_key_t *key;
+  khiter_t k;
+  int ret;
+
+  if (!rib->marked) {
+    return -1;
+  }
+  for (k = kh_begin(rib->log); k != kh_end(rib->log); ++k) {
+    if (!kh_exist(rib->log, k)) {
+      continue;
+    }
+    key = &kh_key(rib->log, k);
+    old_route = kh_val(rib->log, k).present ? &kh_val(rib->log, k).route : NULL;
+    new_route =
+      bgpstream_rib_get_route(rib, key->peer_id, &key->pfx, &route) ? &route
+                                                                    : NULL;
+    if (old_route == NULL && new_route == NULL) {
+      continue;
+    }
+    if (old_route != NULL && new_route != NULL &&
+        route_equal(old_route, new_route)) {
+      continue;
+    }
+    if ((ret = cb(&key->pfx, key->peer_id, old_route, new_route, user)) !=
+        0) {
+      return ret;
+    }
+  }
+  return 0;
+}
+
+/* ==================== SAVE AND LOAD ==================== */
+
+typedef struct save {
+
+  FILE *f;
+
+  uint64_t pfxs_cnt;
+
+  int err;
+
+} save_t;
+
+static int write_all(FILE *f, const void *buf, size_t len)
+{
+  return (len != 0 && fwrite(buf, 1, len, f) != len) ? -1 : 0;
+}
+
+static int read_all(FILE *f, void *buf, size_t len)
+{
+  return (len != 0 && fread(buf, 1, len, f) != len) ? -1 : 0;
+}
+
+static bgpstream_patricia_walk_cb_result_t
+save_node(const bgpstream_patricia_tree_t *pt,
+          const bgpstream_patricia_node_t *node, void *data)
+{
+  save_t *save = data;
+  route_list_t *list =
+    bgpstream_patricia_tree_get_user(bgpstream_nonconst_node(node));
+  rib_file_pfx_t fpfx;
+
+  if (list == NULL || list->routes_cnt == 0) {
+    return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+  }
+  memset(&fpfx, 0, sizeof(fpfx));
+  bgpstream_pfx_copy(&fpfx.pfx, bgpstream_patricia_tree_get_pfx(node));
+  fpfx.routes_cnt = list->routes_cnt;
+  if (write_all(save->f, &fpfx, sizeof(fpfx)) != 0 ||
+      write_all(save->f, list->routes,
+                sizeof(bgpstream_rib_route_t) * list->routes_cnt) != 0) {
+    save->err = 1;
+    return BGPSTREAM_PATRICIA_WALK_END_ALL;
+  }
+  save->pfxs_cnt++;
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+static int save_state(bgpstream_rib_t *rib, FILE *f)
+{
+  rib_file_hdr_t hdr;
+  rib_file_coll_t fcoll;
+  rib_file_peer_t fpeer;
+  rib_file_attrs_t fattrs;
+  bgpstream_peer_sig_t *sig;
+  const char **names;
+  attrs_t *attrs;
+  save_t save;
+  khiter_t k;
+  uint32_t i;
+  int j;
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = RIB_FILE_MAGIC;
+  hdr.version = RIB_FILE_VERSION;
+  hdr.byte_order = RIB_FILE_BYTE_ORDER;
+  hdr.last_time = rib->last_time;
+  hdr.colls_cnt = rib->colls_cnt;
+  hdr.attrs_cnt = kh_size(rib->attrs);
+  hdr.attrs_max_id = rib->next_attrs_id;
+  for (i = 0; i < rib->peers_alloc_cnt; i++) {
+    hdr.peers_cnt += rib->peers[i].known;
+  }
+  // the prefixes are counted as they are written
+  if (write_all(f, &hdr, sizeof(hdr)) != 0) {
+    return -1;
+  }
+
+  if ((names = malloc(sizeof(char *) * (rib->colls_cnt + 1))) == NULL) {
+    return -1;
+  }
+  for (k = kh_begin(rib->coll_idx); k != kh_end(rib->coll_idx); ++k) {
+    if (kh_exist(rib->coll_idx, k)) {
+      names[kh_val(rib->coll_idx, k)] = kh_key(rib->coll_idx, k);
+    }
+  }
+  for (i = 0; i < rib->colls_cnt; i++) {
+    memset(&fcoll, 0, sizeof(fcoll));
+    fcoll.dump_time = rib->colls[i].dump_time;
+    fcoll.syncing = rib->colls[i].syncing;
+    fcoll.name_len = strlen(names[i]);
+    if (write_all(f, &fcoll, sizeof(fcoll)) != 0 ||
+        write_all(f, names[i], fcoll.name_len) != 0) {
+      free(names);
+      return -1;
+    }
+  }
+  free(names);
+
+  for (i = 0; i < rib->peers_alloc_cnt; i++) {
+    if (!rib->peers[i].known) {
+      continue;
+    }
+    if ((sig = bgpstream_peer_sig_map_get_sig(rib->peer_sigs, i)) == NULL) {
+      return -1;
+    }
+    memset(&fpeer, 0, sizeof(fpeer));
+    bgpstream_addr_copy(&fpeer.peer_ip, &sig->peer_ip_addr);
+    fpeer.peer_asn = sig->peer_asnumber;
+    fpeer.last_time = rib->peers[i].last_time;
+    fpeer.session_time = rib->peers[i].session_time;
+    fpeer.peer_id = i;
+    fpeer.coll = rib->peers[i].coll;
+    fpeer.state = rib->peers[i].state;
+    fpeer.session_syncing = rib->peers[i].session_syncing;
+    if (write_all(f, &fpeer, sizeof(fpeer)) != 0) {
+      return -1;
+    }
+  }
+
+  for (i = 1; i < rib->next_attrs_id; i++) {
+    if ((attrs = rib->attrs_by_id[i]) == NULL) {
+      continue;
+    }
+    memset(&fattrs, 0, sizeof(fattrs));
+    bgpstream_addr_copy(&fattrs.next_hop, &attrs->next_hop);
+    fattrs.id = i;
+    fattrs.comms_cnt = bgpstream_community_set_size(attrs->comms);
+    fattrs.large_comms_cnt = bgpstream_community_set_large_size(attrs->comms);
+    if (write_all(f, &fattrs, sizeof(fattrs)) != 0) {
+      return -1;
+    }
+    for (j = 0; j < (int)fattrs.comms_cnt; j++) {
+      if (write_all(f, bgpstream_community_set_get(attrs->comms, j),
+                    sizeof(bgpstream_community_t)) != 0) {
+        return -1;
+      }
+    }
+    for (j = 0; j < (int)fattrs.large_comms_cnt; j++) {
+      if (write_all(f, bgpstream_community_set_get_large(attrs->comms, j),
+                    sizeof(bgpstream_large_community_t)) != 0) {
+        return -1;
+      }
+    }
+  }
+
+  memset(&save, 0, sizeof(save));
+  save.f = f;
+  bgpstream_patricia_tree_walk(rib->pt, save_node, &save);
+  if (save.err) {
+    return -1;
+  }
+  hdr.pfxs_cnt = save.pfxs_cnt;
+  if (fseek(f, 0, SEEK_SET) != 0 || write_all(f, &hdr, sizeof(hdr)) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+int bgpstream_rib_save(bgpstream_rib_t *rib, const char *filename)
+{
+  char *paths_path = NULL, *temp_path = NULL;
+  FILE *f = NULL;
+  size_t len;
+
+  len = strlen(filename) + sizeof(RIB_FILE_PATHS_SUFFIX);
+  if ((paths_path = malloc(len)) == NULL) {
+    goto err;
+  }
+  snprintf(paths_path, len, "%s%s", filename, RIB_FILE_PATHS_SUFFIX);
+  len = strlen(filename) + sizeof(RIB_FILE_TEMP_SUFFIX);
+  if ((temp_path = malloc(len)) == NULL) {
+    goto err;
+  }
+  snprintf(temp_path, len, "%s%s", filename, RIB_FILE_TEMP_SUFFIX);
+
+  // the paths are saved first: paths keep their IDs, so a newer path file
+  // still has every path of an older RIB file
+  if (bgpstream_as_path_store_save(rib->path_store, paths_path) != 0) {
+    goto err;
+  }
+
+  if ((f = fopen(temp_path, "wb")) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create RIB file %s: %s",
+                  temp_path, strerror(errno));
+    goto err;
+  }
+  if (save_state(rib, f) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not write RIB file %s: %s",
+                  temp_path, strerror(errno));
+    goto err;
+  }
+  if (fclose(f) != 0) {
+    f = NULL;
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not write RIB file %s: %s",
+                  temp_path, strerror(errno));
+    goto err;
+  }
+  f = NULL;
+  if (rename(temp_path, filename) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not rename %s: %s", temp_path,
+                  strerror(errno));
+    goto err;
+  }
+
+  free(paths_path);
+  free(temp_path);
+  return 0;
+
+err:
+  if (f != NULL) {
+    fclose(f);
+  }
+  if (temp_path != NULL) {
+    unlink(temp_path);
+  }
+  free(paths_path);
+  free(temp_path);
+  return -1;
+}
+
+/* State of a RIB file being loaded */
+typedef struct load {
+
+  /* New IDs of the peers, indexed by their ID in the file */
+  bgpstream_peer_id_t *peer_ids;
+
+  /* Names of the collectors (borrowed from the RIB), indexed by their ID */
+  const char **coll_names;
+
+  uint16_t colls_cnt;
+
+  /* Attributes, indexed by their ID in the file */
+  attrs_t **attrs;
+
+  uint32_t attrs_max_id;
+
+} load_t;
+
+static int load_colls(bgpstream_rib_t *rib, FILE *f, load_t *load,
+                      const rib_file_hdr_t *hdr)
+{
+  rib_file_coll_t fcoll;
+  char name[RIB_COLL_KEY_LEN];
+  uint16_t idx;
+  uint32_t i;
+
+  if (hdr->colls_cnt >= UINT16_MAX ||
+      (load->coll_names = malloc(sizeof(char *) * (hdr->colls_cnt + 1))) ==
+        NULL) {
+    return -1;
+  }
+  for (i = 0; i < hdr->colls_cnt; i++) {
+    if (read_all(f, &fcoll, sizeof(fcoll)) != 0 ||
+        fcoll.name_len >= RIB_COLL_KEY_LEN ||
+        read_all(f, name, fcoll.name_len) != 0) {
+      return -1;
+    }
+    name[fcoll.name_len] = '\0';
+    // the collectors are added in the order they were saved in
+    if (get_coll_idx(rib, name, &idx) != 0 || idx != i) {
+      return -1;
+    }
+    rib->colls[idx].dump_time = fcoll.dump_time;
+    rib->colls[idx].syncing = fcoll.syncing;
+    load->coll_names[idx] =
+      kh_key(rib->coll_idx, kh_get(rib_coll, rib->coll_idx, name));
+    load->colls_cnt++;
+  }
+  return 0;
+}
+
+static int load_peers(bgpstream_rib_t *rib, FILE *f, load_t *load,
+                      const rib_file_hdr_t *hdr)
+{
+  rib_file_peer_t fpeer;
+  bgpstream_peer_id_t peer_id;
+  peer_t *peer;
+  uint32_t i;
+
+  for (i = 0; i < hdr->peers_cnt; i++) {
+    if (read_all(f, &fpeer, sizeof(fpeer)) != 0 || fpeer.peer_id == 0 ||
+        fpeer.coll >= load->colls_cnt) {
+      return -1;
+    }
+    if ((peer_id = bgpstream_peer_sig_map_get_id(
+           rib->peer_sigs, load->coll_names[fpeer.coll], &fpeer.peer_ip,
+           fpeer.peer_asn)) == 0 ||
+        (peer = alloc_peer(rib, peer_id, fpeer.coll)) == NULL) {
+      return -1;
+    }
+    peer->last_time = fpeer.last_time;
+    peer->session_time = fpeer.session_time;
+    peer->state = fpeer.state;
+    peer->session_syncing = fpeer.session_syncing;
+    load->peer_ids[fpeer.peer_id] = peer_id;
+  }
+  return 0;
+}
+
+static int load_attrs(bgpstream_rib_t *rib, FILE *f, load_t *load,
+                      const rib_file_hdr_t *hdr)
+{
+  rib_file_attrs_t fattrs;
+  bgpstream_community_t comm;
+  bgpstream_large_community_t large_comm;
+  attrs_t *attrs;
+  uint32_t i, j;
+
+  load->attrs_max_id = hdr->attrs_max_id;
+  if ((load->attrs = malloc_zero(sizeof(attrs_t *) * hdr->attrs_max_id)) ==
+      NULL) {
+    return -1;
+  }
+  for (i = 0; i < hdr->attrs_cnt; i++) {
+    if (read_all(f, &fattrs, sizeof(fattrs)) != 0 || fattrs.id == 0 ||
+        fattrs.id >= hdr->attrs_max_id || load->attrs[fattrs.id] != NULL ||
+        (attrs = malloc_zero(sizeof(attrs_t))) == NULL) {
+      return -1;
+    }
+    load->attrs[fattrs.id] = attrs;
+    bgpstream_addr_copy(&attrs->next_hop, &fattrs.next_hop);
+    if ((attrs->comms = bgpstream_community_set_create()) == NULL) {
+      return -1;
+    }
+    for (j = 0; j < fattrs.comms_cnt; j++) {
+      if (read_all(f, &comm, sizeof(comm)) != 0 ||
+          bgpstream_community_set_insert(attrs->comms, &comm) != 0) {
+        return -1;
+      }
+    }
+    for (j = 0; j < fattrs.large_comms_cnt; j++) {
+      if (read_all(f, &large_comm, sizeof(large_comm)) != 0 ||
+          bgpstream_community_set_insert_large(attrs->comms, &large_comm) !=
+            0) {
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+static int load_pfxs(bgpstream_rib_t *rib, FILE *f, load_t *load,
+                     const rib_file_hdr_t *hdr)
+{
+  rib_file_pfx_t fpfx;
+  bgpstream_rib_route_t route;
+  attrs_t *attrs;
+  uint64_t i;
+  uint32_t j, old_id;
+
+  for (i = 0; i < hdr->pfxs_cnt; i++) {
+    if (read_all(f, &fpfx, sizeof(fpfx)) != 0 ||
+        (fpfx.pfx.address.version != BGPSTREAM_ADDR_VERSION_IPV4 &&
+         fpfx.pfx.address.version != BGPSTREAM_ADDR_VERSION_IPV6) ||
+        fpfx.pfx.mask_len >
+          (fpfx.pfx.address.version == BGPSTREAM_ADDR_VERSION_IPV4 ? 32
+                                                                    : 128)) {
+      return -1;
+    }
+    for (j = 0; j < fpfx.routes_cnt; j++) {
+      if (read_all(f, &route, sizeof(route)) != 0 ||
+          (route.peer_id = load->peer_ids[route.peer_id]) == 0) {
+        return -1;
+      }
+      if ((old_id = route.attrs_id) != RIB_TOMBSTONE) {
+        if (old_id >= load->attrs_max_id ||
+            (attrs = load->attrs[old_id]) == NULL ||
+            (route.attrs_id = attrs_get(rib, &attrs->next_hop, attrs->comms)) ==
+              0) {
+          return -1;
+        }
+      }
+      if (set_route(rib, &fpfx.pfx, &route) != 0) {
+        attrs_unref(rib, route.attrs_id);
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+int bgpstream_rib_load(bgpstream_rib_t *rib, const char *filename)
+{
+  char *paths_path = NULL;
+  rib_file_hdr_t hdr;
+  load_t load;
+  FILE *f = NULL;
+  size_t len;
+  uint32_t i;
+  int rc = -1;
+
+  memset(&load, 0, sizeof(load));
+  if (rib->colls_cnt != 0 || rib->pfx_cnt != 0 ||
+      bgpstream_as_path_store_get_size(rib->path_store) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "RIB files can only be loaded into a new "
+                                     "RIB");
+    return -1;
+  }
+
+  len = strlen(filename) + sizeof(RIB_FILE_PATHS_SUFFIX);
+  if ((paths_path = malloc(len)) == NULL) {
+    goto out;
+  }
+  snprintf(paths_path, len, "%s%s", filename, RIB_FILE_PATHS_SUFFIX);
+
+  if ((f = fopen(filename, "rb")) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open RIB file %s: %s",
+                  filename, strerror(errno));
+    goto out;
+  }
+  if (read_all(f, &hdr, sizeof(hdr)) != 0 || hdr.magic != RIB_FILE_MAGIC ||
+      hdr.version != RIB_FILE_VERSION ||
+      hdr.byte_order != RIB_FILE_BYTE_ORDER) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "%s is not a RIB file", filename);
+    goto out;
+  }
+  if (bgpstream_as_path_store_load(rib->path_store, paths_path) != 0) {
+    goto out;
+  }
+
+  if ((load.peer_ids = malloc_zero(sizeof(bgpstream_peer_id_t) *
+                                   ((uint32_t)UINT16_MAX + 1))) == NULL ||
+      load_colls(rib, f, &load, &hdr) != 0 ||
+      load_peers(rib, f, &load, &hdr) != 0 ||
+      load_attrs(rib, f, &load, &hdr) != 0 ||
+      load_pfxs(rib, f, &load, &hdr) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not load RIB file %s", filename);
+    goto out;
+  }
+  rib->last_time = hdr.last_time;
+  rc = 0;
+
+out:
+  if (f != NULL) {
+    fclose(f);
+  }
+  if (load.attrs != NULL) {
+    for (i = 0; i < load.attrs_max_id; i++) {
+      if (load.attrs[i] != NULL) {
+        bgpstream_community_set_destroy(load.attrs[i]->comms);
+        free(load.attrs[i]);
+      }
+    }
+    free(load.attrs);
+  }
+  free(load.coll_names);
+  free(load.peer_ids);
+  free(paths_path);
+  return rc;
+}
+
+void bgpstream_rib_clear(bgpstream_rib_t *rib)
+{
+  bgpstream_patricia_tree_clear(rib->pt);
+  kh_clear(rib_log, rib->log);
+  attrs_clear(rib);
+  bgpstream_peer_sig_map_clear(rib->peer_sigs);
+  colls_clear(rib);
+
+  if (rib->peers != NULL) {
+    memset(rib->peers, 0, sizeof(peer_t) * rib->peers_alloc_cnt);
+  }
+  rib->cur_record = NULL;
+  rib->last_time = 0;
+  rib->pfx_cnt = 0;
+  rib->route_cnt = 0;
+}
@@ -0,0 +1,411 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_UTILS_RIB_H
+#define __BGPSTREAM_UTILS_RIB_H
+
+#include <stdint.h>
+
+#include "bgpstream_elem.h"
+#include "bgpstream_record.h"
+#include "bgpstream_utils_as_path_store.h"
+#include "bgpstream_utils_community.h"
+#include "bgpstream_utils_peer_sig_map.h"
+#include "bgpstream_utils_pfx.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of the BGP Stream RIB:
+ * the routing tables of every peer, kept up to date from the elems of a
+ * stream (RIB dumps, then announcements, withdrawals and peer state changes).
+ *
+ * Peers are identified with a peer signature map, and each prefix is a node of
+ * a Patricia Tree holding the routes of the peers that announce it. A route is
+ * a few bytes: the ID of its AS path in an AS path store, the ID of its
+ * (interned) next hop and communities, and the time it was last updated.
+ *
+ * A RIB dump replaces the routes of the peers of its collector: routes that
+ * are older than the dump and are not in it are removed once the dump ends,
+ * while routes that were updated after the dump was taken are not overwritten
+ * by it. A peer whose session goes down loses its routes, and once it is
+ * established again, the routes it does not announce again before its
+ * End-of-RIB marker are removed.
+ *
+ * Changes may be tracked from a point in time (see bgpstream_rib_mark), and
+ * then listed with the state of each changed route at that point and now (see
+ * bgpstream_rib_diff).
+ *
+ * A RIB can be saved to disk and loaded again (see bgpstream_rib_save) so that
+ * a restarted process can carry on from where it stopped, rather than rebuild
+ * the RIB from the last dump and all the updates since.
+ */
+
+/**
+ * @name Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure containing a RIB instance */
+typedef struct bgpstream_rib bgpstream_rib_t;
+
+/** @} */
+
+/**
+ * @name Public Data Structures
+ *
+ * @{ */
+
+/** A route of a peer to a prefix */
+typedef struct bgpstream_rib_route {
+
+  /** ID of the AS path of the route (see bgpstream_rib_get_as_path) */
+  bgpstream_as_path_store_path_id_t path_id;
+
+  /** ID of the next hop and communities of the route (see
+   * bgpstream_rib_get_next_hop and bgpstream_rib_get_communities) */
+  uint32_t attrs_id;
+
+  /** Time (of the record) that the route was last announced at */
+  uint32_t time;
+
+  /** ID of the peer (in the peer signature map of the RIB) */
+  bgpstream_peer_id_t peer_id;
+
+} bgpstream_rib_route_t;
+
+/** State of a peer of the RIB */
+typedef struct bgpstream_rib_peer_info {
+
+  /** The last known state of the session (BGPSTREAM_ELEM_PEERSTATE_UNKNOWN
+   * until a peer state elem has been seen) */
+  bgpstream_elem_peerstate_t state;
+
+  /** Number of routes of the peer */
+  uint32_t routes_cnt;
+
+  /** Time of the last elem of the peer */
+  uint32_t last_time;
+
+  /** Non-zero while the table of the peer is being refreshed by a RIB dump or
+   * after the session was established (before its End-of-RIB marker) */
+  uint8_t syncing;
+
+} bgpstream_rib_peer_info_t;
+
+/** Callback for the routes visited by bgpstream_rib_walk
+ *
+ * @param pfx           the prefix of the route
+ * @param route         the route
+ * @param user          the pointer given to bgpstream_rib_walk
+ * @return 0 to continue the walk, any other value to stop it
+ */
+typedef int(bgpstream_rib_route_cb_t)(const bgpstream_pfx_t *pfx,
+                                      const bgpstream_rib_route_t *route,
+                                      void *user);
+
+/** Callback for the routes that have changed, visited by bgpstream_rib_diff
+ *
+ * @param pfx           the prefix of the route
+ * @param peer_id       the peer of the route
+ * @param old_route     the route when the RIB was marked, or NULL if there was
+ *                      none
+ * @param new_route     the route now, or NULL if there is none
+ * @param user          the pointer given to bgpstream_rib_diff
+ * @return 0 to continue, any other value to stop
+ */
+typedef int(bgpstream_rib_diff_cb_t)(const bgpstream_pfx_t *pfx,
+                                     bgpstream_peer_id_t peer_id,
+                                     const bgpstream_rib_route_t *old_route,
+                                     const bgpstream_rib_route_t *new_route,
+                                     void *user);
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new RIB
+ *
+ * @return a pointer to the RIB if successful, NULL otherwise
+ */
+bgpstream_rib_t *bgpstream_rib_create(void);
+
+/** Destroy the given RIB
+ *
+ * @param rib           pointer to the RIB to destroy
+ */
+void bgpstream_rib_destroy(bgpstream_rib_t *rib);
+
+/** Start applying a record to the RIB
+ *
+ * @param rib           pointer to the RIB
+ * @param record        the record whose elems are to be applied
+ * @return 0 if successful, -1 otherwise
+ *
+ * Must be called for every record, before its elems are given to
+ * bgpstream_rib_add_elem, so that the start of RIB dumps is seen.
+ */
+int bgpstream_rib_begin_record(bgpstream_rib_t *rib,
+                               const bgpstream_record_t *record);
+
+/** Apply an elem to the RIB
+ *
+ * @param rib           pointer to the RIB
+ * @param record        the record that the elem belongs to
+ * @param elem          the elem to apply
+ * @return 1 if the elem changed the route of its peer to its prefix, 0 if it
+ * did not, -1 if an error occurred
+ *
+ * RIB and announcement elems set the route of their peer to their prefix,
+ * withdrawals remove it, and peer state and End-of-RIB elems update the state
+ * of the peer. A RIB elem that repeats the route the peer already has (e.g.,
+ * from the previous dump of its collector) does not change it, so only RIB
+ * elems that return 1 need to be passed on by a consumer that is only
+ * interested in what a dump changes. The routes that a dump removes are given
+ * to the purge callback (see bgpstream_rib_set_purge_cb).
+ */
+int bgpstream_rib_add_elem(bgpstream_rib_t *rib,
+                           const bgpstream_record_t *record,
+                           bgpstream_elem_t *elem);
+
+/** Finish applying a record to the RIB
+ *
+ * @param rib           pointer to the RIB
+ * @param record        the record whose elems were applied
+ * @return 0 if successful, -1 otherwise
+ *
+ * Must be called for every record, once its elems have been given to
+ * bgpstream_rib_add_elem, so that the end of RIB dumps is seen.
+ */
+int bgpstream_rib_end_record(bgpstream_rib_t *rib,
+                             const bgpstream_record_t *record);
+
+/** Set the function called for the routes that are removed by a purge
+ *
+ * @param rib           pointer to the RIB
+ * @param cb            callback to call for each removed route, or NULL
+ * @param user          pointer passed to the callback
+ *
+ * Routes are purged when the end of a RIB dump is reached and they were not
+ * in it (from bgpstream_rib_end_record), when the session of their peer goes
+ * down, and when their peer does not announce them again before its
+ * End-of-RIB marker (from bgpstream_rib_add_elem). The callback is called
+ * just before the route is removed, and must not change the RIB. If it
+ * returns a value other than 0, the purge stops and fails.
+ */
+void bgpstream_rib_set_purge_cb(bgpstream_rib_t *rib,
+                                bgpstream_rib_route_cb_t *cb, void *user);
+
+/** Apply a record, and all of its elems, to the RIB
+ *
+ * @param rib           pointer to the RIB
+ * @param record        the record to apply
+ * @return 0 if successful, -1 otherwise
+ *
+ * This reads the elems of the record (see bgpstream_record_get_next_elem), so
+ * callers that also need the elems should use bgpstream_rib_begin_record,
+ * bgpstream_rib_add_elem and bgpstream_rib_end_record instead.
+ */
+int bgpstream_rib_add_record(bgpstream_rib_t *rib,
+                             bgpstream_record_t *record);
+
+/** Get the route of a peer to a prefix
+ *
+ * @param rib           pointer to the RIB
+ * @param peer_id       the peer
+ * @param pfx           the prefix
+ * @param[out] route    filled with the route, if there is one
+ * @return 1 if the peer has a route to the prefix, 0 otherwise
+ */
+int bgpstream_rib_get_route(bgpstream_rib_t *rib, bgpstream_peer_id_t peer_id,
+                            const bgpstream_pfx_t *pfx,
+                            bgpstream_rib_route_t *route);
+
+/** Visit the routes of the RIB, in the order of a walk of the prefixes
+ *
+ * @param rib           pointer to the RIB
+ * @param peer_id       the peer whose routes to visit, or 0 for every peer
+ * @param cb            callback to call for each route
+ * @param user          pointer passed to the callback
+ * @return 0 if every route was visited, or the non-zero value returned by the
+ * callback that stopped the walk
+ *
+ * The RIB must not be changed by the callback.
+ */
+int bgpstream_rib_walk(bgpstream_rib_t *rib, bgpstream_peer_id_t peer_id,
+                       bgpstream_rib_route_cb_t *cb, void *user);
+
+/** Get the number of prefixes that at least one peer has a route to
+ *
+ * @param rib           pointer to the RIB
+ * @return the number of prefixes
+ */
+uint64_t bgpstream_rib_get_pfx_cnt(bgpstream_rib_t *rib);
+
+/** Get the number of routes of the RIB
+ *
+ * @param rib           pointer to the RIB
+ * @return the number of routes, summed over every peer
+ */
+uint64_t bgpstream_rib_get_route_cnt(bgpstream_rib_t *rib);
+
+/** Get the latest time of the records applied to the RIB
+ *
+ * @param rib           pointer to the RIB
+ * @return the latest record time, or 0 if no record was applied
+ *
+ * A stream that carries on from a saved RIB (see bgpstream_rib_load) should
+ * start at this time. Records of that second may then be applied again, which
+ * leaves the routes unchanged unless the same route was both announced and
+ * withdrawn within that second.
+ */
+uint32_t bgpstream_rib_get_last_time(bgpstream_rib_t *rib);
+
+/** Get the state of a peer
+ *
+ * @param rib           pointer to the RIB
+ * @param peer_id       the peer
+ * @param[out] info     filled with the state of the peer
+ * @return 0 if the peer is known to the RIB, -1 otherwise
+ */
+int bgpstream_rib_get_peer_info(bgpstream_rib_t *rib,
+                                bgpstream_peer_id_t peer_id,
+                                bgpstream_rib_peer_info_t *info);
+
+/** Get the peer signature map of the RIB
+ *
+ * @param rib           pointer to the RIB
+ * @return borrowed pointer to the map, which gives the signature of each peer
+ * ID (and the ID of a known peer)
+ *
+ * Peers whose elems come from a router (e.g., BMP) are identified by the
+ * collector name and the router name, separated by a '/'.
+ */
+bgpstream_peer_sig_map_t *bgpstream_rib_get_peer_sig_map(bgpstream_rib_t *rib);
+
+/** Get the AS path of a route
+ *
+ * @param rib           pointer to the RIB
+ * @param route         the route
+ * @return a new AS path, which the caller must destroy with
+ * bgpstream_as_path_destroy, or NULL if an error occurred
+ */
+bgpstream_as_path_t *
+bgpstream_rib_get_as_path(bgpstream_rib_t *rib,
+                          const bgpstream_rib_route_t *route);
+
+/** Get the AS path store of the RIB
+ *
+ * @param rib           pointer to the RIB
+ * @return borrowed pointer to the store that the path IDs of the routes refer
+ * to, whose store paths can be used without copying the paths
+ */
+bgpstream_as_path_store_t *bgpstream_rib_get_path_store(bgpstream_rib_t *rib);
+
+/** Get the next hop of a route
+ *
+ * @param rib           pointer to the RIB
+ * @param route         the route
+ * @return borrowed pointer to the next hop
+ */
+const bgpstream_ip_addr_t *
+bgpstream_rib_get_next_hop(bgpstream_rib_t *rib,
+                           const bgpstream_rib_route_t *route);
+
+/** Get the communities of a route
+ *
+ * @param rib           pointer to the RIB
+ * @param route         the route
+ * @return borrowed pointer to the community set, which is shared by all the
+ * routes with the same next hop and communities
+ */
+const bgpstream_community_set_t *
+bgpstream_rib_get_communities(bgpstream_rib_t *rib,
+                              const bgpstream_rib_route_t *route);
+
+/** Start tracking the changes to the RIB from now on
+ *
+ * @param rib           pointer to the RIB
+ * @return 0 if successful, -1 otherwise
+ *
+ * Any changes tracked since the last mark are forgotten.
+ */
+int bgpstream_rib_mark(bgpstream_rib_t *rib);
+
+/** Visit the routes that have changed since the RIB was marked
+ *
+ * @param rib           pointer to the RIB
+ * @param cb            callback to call for each changed route
+ * @param user          pointer passed to the callback
+ * @return 0 if every change was visited, -1 if the RIB was not marked, or the
+ * non-zero value returned by the callback that stopped the diff
+ *
+ * Only routes that differ (in path, next hop or communities) are visited, so
+ * a route that was withdrawn and then announced again is not. The changes are
+ * visited in no particular order, and keep being tracked until the next mark.
+ */
+int bgpstream_rib_diff(bgpstream_rib_t *rib, bgpstream_rib_diff_cb_t *cb,
+                       void *user);
+
+/** Save the RIB to a file
+ *
+ * @param rib           pointer to the RIB to save
+ * @param filename      path of the file to write
+ * @return 0 if the RIB was saved successfully, -1 otherwise
+ *
+ * The AS paths are saved to a second file, named after the first with a
+ * ".paths" suffix (see bgpstream_as_path_store_save), which is written
+ * first. Each file is written under a temporary name and then renamed, so
+ * that a RIB file is always complete and its paths are in the path file, even
+ * when a save is interrupted. The changes tracked since the last mark are not
+ * saved.
+ */
+int bgpstream_rib_save(bgpstream_rib_t *rib, const char *filename);
+
+/** Load a RIB saved with bgpstream_rib_save into a new RIB
+ *
+ * @param rib           pointer to a RIB that nothing has been added to
+ * @param filename      path of the file written by bgpstream_rib_save
+ * @return 0 if the RIB was loaded successfully, -1 otherwise
+ *
+ * Peers get the IDs that the peer signature map of the RIB gives them, which
+ * are not necessarily the ones they had when the RIB was saved, while the AS
+ * path IDs are kept. If loading fails the RIB may hold part of the file, and
+ * should be destroyed.
+ */
+int bgpstream_rib_load(bgpstream_rib_t *rib, const char *filename);
+
+/** Remove every route and peer from the RIB
+ *
+ * @param rib           pointer to the RIB
+ */
+void bgpstream_rib_clear(bgpstream_rib_t *rib);
+
+/** @} */
+
+#endif /* __BGPSTREAM_UTILS_RIB_H */
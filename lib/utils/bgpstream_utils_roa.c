@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wandio.h>
+
+#include "bgpstream_log.h"
+#include "bgpstream_utils_patricia.h"
+#include "bgpstream_utils_roa.h"
+#include "utils.h"
+
+/* Longest line accepted by bgpstream_roa_index_load_csv */
+#define ROA_LINE_LEN 1024
+
+/* Upper bound on the number of prefixes that can cover a prefix (one per
+ * mask length, IPv6 included) */
+#define ROA_MAX_COVER 129
+
+typedef struct roa {
+
+  /* Origin ASN authorized by the ROA */
+  uint32_t asn;
+
+  /* Maximum length of the ROA */
+  uint8_t max_len;
+
+} roa_t;
+
+/* ROAs of one prefix, stored as the user pointer of its patricia node */
+typedef struct roa_list {
+
+  roa_t *roas;
+
+  uint32_t roas_cnt;
+
+  uint32_t roas_alloc_cnt;
+
+} roa_list_t;
+
+struct bgpstream_roa_index {
+
+  /* Patricia tree of the ROA prefixes */
+  bgpstream_patricia_tree_t *pt;
+
+  /* Number of ROAs in the index */
+  uint64_t roa_cnt;
+};
+
+/* The ROA lists of every prefix that covers a given prefix */
+typedef struct roa_cover {
+
+  const roa_list_t *lists[ROA_MAX_COVER];
+
+  int lists_cnt;
+
+} roa_cover_t;
+
+static void roa_list_destroy(void *user)
+{
+  roa_list_t *list = user;
+
+  if (list == NULL) {
+    return;
+  }
+  free(list->roas);
+  free(list);
+}
+
+static bgpstream_patricia_walk_cb_result_t
+collect_cover(const bgpstream_patricia_tree_t *pt,
+              const bgpstream_patricia_node_t *node, void *data)
+{
+  roa_cover_t *cover = data;
+  const roa_list_t *list =
+    bgpstream_patricia_tree_get_user(bgpstream_nonconst_node(node));
+
+  if (list != NULL && cover->lists_cnt < ROA_MAX_COVER) {
+    cover->lists[cover->lists_cnt++] = list;
+  }
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+static void find_cover(const bgpstream_roa_index_t *idx,
+                       const bgpstream_pfx_t *pfx, roa_cover_t *cover)
+{
+  cover->lists_cnt = 0;
+  bgpstream_patricia_tree_walk_up_down(idx->pt, pfx, collect_cover,
+                                       collect_cover, NULL, cover);
+}
+
+/* RFC 6811, section 2: a route is valid if any covering ROA matches its
+ * origin and length, and invalid if it is covered but no ROA matches */
+static bgpstream_roa_validity_t check_cover(const roa_cover_t *cover,
+                                            uint8_t mask_len, uint32_t origin)
+{
+  bgpstream_roa_validity_t res = BGPSTREAM_ROA_NOT_FOUND;
+  const roa_list_t *list;
+  uint32_t j;
+  int i;
+
+  for (i = 0; i < cover->lists_cnt; i++) {
+    list = cover->lists[i];
+    for (j = 0; j < list->roas_cnt; j++) {
+      if (list->roas[j].asn != origin || origin == 0) {
+        if (res == BGPSTREAM_ROA_NOT_FOUND) {
+          res = BGPSTREAM_ROA_INVALID_ASN;
+        }
+      } else if (mask_len <= list->roas[j].max_len) {
+        return BGPSTREAM_ROA_VALID;
+      } else {
+        res = BGPSTREAM_ROA_INVALID_LENGTH;
+      }
+    }
+  }
+  return res;
+}
+
+/* ==================== PUBLIC FUNCTIONS ==================== */
+
+bgpstream_roa_index_t *bgpstream_roa_index_create(void)
+{
+  bgpstream_roa_index_t *idx;
+
+  if ((idx = malloc_zero(sizeof(bgpstream_roa_index_t))) == NULL) {
+    return NULL;
+  }
+  if ((idx->pt = bgpstream_patricia_tree_create(roa_list_destroy)) == NULL) {
+    free(idx);
+    return NULL;
+  }
+  return idx;
+}
+
+int bgpstream_roa_index_add(bgpstream_roa_index_t *idx,
+                            const bgpstream_pfx_t *pfx, uint8_t max_len,
+                            uint32_t asn)
+{
+  bgpstream_patricia_node_t *node;
+  roa_list_t *list;
+  roa_t *roas;
+  uint32_t i;
+  int addr_bits =
+    pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV4 ? 32 : 128;
+
+  if (max_len < pfx->mask_len || max_len > addr_bits) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Invalid ROA maximum length %d for a /%d",
+                  max_len, pfx->mask_len);
+    return -1;
+  }
+
+  if ((node = bgpstream_patricia_tree_search_exact(idx->pt, pfx)) == NULL &&
+      (node = bgpstream_patricia_tree_insert(idx->pt, pfx)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not insert ROA prefix");
+    return -1;
+  }
+  if ((list = bgpstream_patricia_tree_get_user(node)) == NULL) {
+    if ((list = malloc_zero(sizeof(roa_list_t))) == NULL) {
+      return -1;
+    }
+    bgpstream_patricia_tree_set_user(idx->pt, node, list);
+  }
+
+  for (i = 0; i < list->roas_cnt; i++) {
+    if (list->roas[i].asn == asn && list->roas[i].max_len == max_len) {
+      return 0;
+    }
+  }
+  if (list->roas_cnt == list->roas_alloc_cnt) {
+    if ((roas = realloc(list->roas, sizeof(roa_t) *
+                                      (list->roas_alloc_cnt * 2 + 1))) ==
+        NULL) {
+      return -1;
+    }
+    list->roas = roas;
+    list->roas_alloc_cnt = list->roas_alloc_cnt * 2 + 1;
+  }
+  list->roas[list->roas_cnt].asn = asn;
+  list->roas[list->roas_cnt].max_len = max_len;
+  list->roas_cnt++;
+  idx->roa_cnt++;
+  return 0;
+}
+
+int bgpstream_roa_index_load_csv(bgpstream_roa_index_t *idx,
+                                 const char *filename)
+{
+  io_t *fh;
+  char line[ROA_LINE_LEN];
+  char *asn_str, *pfx_str, *len_str, *c, *end;
+  bgpstream_pfx_t pfx;
+  unsigned long asn, max_len;
+  int64_t rc;
+  int lineno = 0, cnt = 0;
+
+  if ((fh = wandio_create(filename)) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open ROA file %s", filename);
+    return -1;
+  }
+
+  while ((rc = wandio_fgets(fh, line, ROA_LINE_LEN, 1)) > 0) {
+    lineno++;
+    c = line;
+    asn_str = strsep(&c, ",");
+    pfx_str = strsep(&c, ",");
+    len_str = strsep(&c, ",");
+
+    if (strncasecmp(asn_str, "AS", 2) == 0) {
+      asn_str += 2;
+    }
+    if (!isdigit((unsigned char)*asn_str)) {
+      // header or comment line
+      continue;
+    }
+    asn = strtoul(asn_str, &end, 10);
+    if (*end != '\0' || asn > UINT32_MAX || pfx_str == NULL ||
+        len_str == NULL || bgpstream_str2pfx(pfx_str, &pfx) == NULL) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Malformed ROA at %s:%d", filename,
+                    lineno);
+      goto err;
+    }
+    max_len = strtoul(len_str, &end, 10);
+    if (*end != '\0' || max_len > 128) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Malformed ROA at %s:%d", filename,
+                    lineno);
+      goto err;
+    }
+    if (bgpstream_roa_index_add(idx, &pfx, max_len, asn) != 0) {
+      goto err;
+    }
+    cnt++;
+  }
+  if (rc < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not read ROA file %s", filename);
+    goto err;
+  }
+
+  wandio_destroy(fh);
+  return cnt;
+
+err:
+  wandio_destroy(fh);
+  return -1;
+}
+
+uint64_t bgpstream_roa_index_get_roa_cnt(const bgpstream_roa_index_t *idx)
+{
+  return idx->roa_cnt;
+}
+
+bgpstream_roa_validity_t
+bgpstream_roa_index_validate(const bgpstream_roa_index_t *idx,
+                             const bgpstream_pfx_t *pfx, uint32_t origin)
+{
+  roa_cover_t cover;
+
+  find_cover(idx, pfx, &cover);
+  return check_cover(&cover, pfx->mask_len, origin);
+}
+
+void bgpstream_roa_index_validate_batch(const bgpstream_roa_index_t *idx,
+                                        const bgpstream_pfx_t **pfxs,
+                                        const uint32_t *origins, int cnt,
+                                        bgpstream_roa_validity_t *results)
+{
+  roa_cover_t cover;
+  const bgpstream_pfx_t *last = NULL;
+  int i;
+
+  for (i = 0; i < cnt; i++) {
+    if (last == NULL || !bgpstream_pfx_equal(last, pfxs[i])) {
+      find_cover(idx, pfxs[i], &cover);
+      last = pfxs[i];
+    }
+    // most routes have no ROA at all
+    results[i] = cover.lists_cnt == 0 ?
+                   BGPSTREAM_ROA_NOT_FOUND :
+                   check_cover(&cover, pfxs[i]->mask_len, origins[i]);
+  }
+}
+
+void bgpstream_roa_index_validate_elems(const bgpstream_roa_index_t *idx,
+                                        bgpstream_elem_t **elems, int cnt,
+                                        bgpstream_roa_validity_t *results)
+{
+  roa_cover_t cover;
+  const bgpstream_pfx_t *last = NULL;
+  bgpstream_as_path_t *path;
+  uint32_t origin;
+  int i;
+
+  for (i = 0; i < cnt; i++) {
+    if ((elems[i]->type != BGPSTREAM_ELEM_TYPE_RIB &&
+         elems[i]->type != BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT) ||
+        (path = bgpstream_elem_get_as_path(elems[i])) == NULL) {
+      results[i] = BGPSTREAM_ROA_NOT_FOUND;
+      continue;
+    }
+    if (last == NULL || !bgpstream_pfx_equal(last, &elems[i]->prefix)) {
+      find_cover(idx, &elems[i]->prefix, &cover);
+      last = &elems[i]->prefix;
+    }
+    if (cover.lists_cnt == 0) {
+      results[i] = BGPSTREAM_ROA_NOT_FOUND;
+      continue;
+    }
+    // an origin that is not a single ASN matches no ROA (ASN 0 never does)
+    if (bgpstream_as_path_get_origin_val(path, &origin) != 0) {
+      origin = 0;
+    }
+    results[i] = check_cover(&cover, elems[i]->prefix.mask_len, origin);
+  }
+}
+
+void bgpstream_roa_index_clear(bgpstream_roa_index_t *idx)
+{
+  bgpstream_patricia_tree_clear(idx->pt);
+  idx->roa_cnt = 0;
+}
+
+void bgpstream_roa_index_destroy(bgpstream_roa_index_t *idx)
+{
+  if (idx == NULL) {
+    return;
+  }
+  bgpstream_patricia_tree_destroy(idx->pt);
+  free(idx);
+}
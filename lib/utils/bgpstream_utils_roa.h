@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_UTILS_ROA_H
+#define __BGPSTREAM_UTILS_ROA_H
+
+#include <stdint.h>
+
+#include "bgpstream_elem.h"
+#include "bgpstream_utils_pfx.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of the BGP Stream ROA
+ * index: an in-memory set of Route Origin Authorizations (prefix, maximum
+ * length and origin ASN) that routes can be validated against locally, as
+ * described in RFC 6811.
+ *
+ * The index is filled from a ROA snapshot (either one ROA at a time, or from a
+ * CSV file as exported by common RPKI validators), and is cleared and refilled
+ * whenever a new snapshot becomes available.
+ */
+
+/**
+ * @name Public Enums
+ *
+ * @{ */
+
+/** Result of the origin validation of a route */
+typedef enum {
+
+  /** No ROA covers the prefix */
+  BGPSTREAM_ROA_NOT_FOUND = 0,
+
+  /** A ROA covering the prefix authorizes the origin ASN */
+  BGPSTREAM_ROA_VALID = 1,
+
+  /** ROAs cover the prefix, but none of them is for the origin ASN */
+  BGPSTREAM_ROA_INVALID_ASN = 2,
+
+  /** A ROA for the origin ASN covers the prefix, but its maximum length is
+      shorter than the prefix */
+  BGPSTREAM_ROA_INVALID_LENGTH = 3,
+
+} bgpstream_roa_validity_t;
+
+/** @} */
+
+/**
+ * @name Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure containing a ROA index instance */
+typedef struct bgpstream_roa_index bgpstream_roa_index_t;
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Create a new, empty, ROA index
+ *
+ * @return a pointer to the index, or NULL if an error occurred
+ */
+bgpstream_roa_index_t *bgpstream_roa_index_create(void);
+
+/** Add a ROA to the index
+ *
+ * @param idx           pointer to the index
+ * @param pfx           pointer to the prefix of the ROA
+ * @param max_len       maximum length of the ROA
+ * @param asn           origin ASN authorized by the ROA
+ * @return 0 if the ROA was added successfully, -1 otherwise
+ *
+ * The maximum length must be between the length of the prefix and the length
+ * of its address. A ROA that is already in the index is only stored once. As
+ * specified by RFC 6483, a ROA for AS 0 never validates any route.
+ */
+int bgpstream_roa_index_add(bgpstream_roa_index_t *idx,
+                            const bgpstream_pfx_t *pfx, uint8_t max_len,
+                            uint32_t asn);
+
+/** Add the ROAs of a CSV file to the index
+ *
+ * @param idx           pointer to the index
+ * @param filename      name of the file to read (any format that wandio can
+ *                      read)
+ * @return the number of ROAs read, or -1 if an error occurred
+ *
+ * Each line of the file holds one ROA as `ASN,prefix,max length`, optionally
+ * followed by more fields (e.g. the trust anchor), which are ignored. The ASN
+ * may be prefixed by "AS". Lines whose first field is not an ASN (e.g. the
+ * header line) are skipped.
+ */
+int bgpstream_roa_index_load_csv(bgpstream_roa_index_t *idx,
+                                 const char *filename);
+
+/** Get the number of ROAs in the index
+ *
+ * @param idx           pointer to the index
+ * @return the number of ROAs
+ */
+uint64_t bgpstream_roa_index_get_roa_cnt(const bgpstream_roa_index_t *idx);
+
+/** Validate the origin of a route
+ *
+ * @param idx           pointer to the index
+ * @param pfx           pointer to the prefix of the route
+ * @param origin        origin ASN of the route
+ * @return the validity of the route
+ */
+bgpstream_roa_validity_t
+bgpstream_roa_index_validate(const bgpstream_roa_index_t *idx,
+                             const bgpstream_pfx_t *pfx, uint32_t origin);
+
+/** Validate the origin of many routes
+ *
+ * @param idx           pointer to the index
+ * @param pfxs          array of cnt pointers to the prefixes of the routes
+ * @param origins       array of cnt origin ASNs of the routes
+ * @param cnt           number of routes
+ * @param results       array of cnt results, filled with the validity of each
+ *                      route
+ *
+ * The ROAs covering a prefix are only looked up once for consecutive routes
+ * with the same prefix (e.g. the elems of a RIB record), so this is faster
+ * than validating each route on its own.
+ */
+void bgpstream_roa_index_validate_batch(const bgpstream_roa_index_t *idx,
+                                        const bgpstream_pfx_t **pfxs,
+                                        const uint32_t *origins, int cnt,
+                                        bgpstream_roa_validity_t *results);
+
+/** Validate the origin of many elems
+ *
+ * @param idx           pointer to the index
+ * @param elems         array of cnt pointers to the elems to validate
+ * @param cnt           number of elems
+ * @param results       array of cnt results, filled with the validity of each
+ *                      elem
+ *
+ * Elems other than RIB entries and announcements are reported as not found.
+ * Elems whose origin is not a single ASN (e.g. an AS set) are never valid, as
+ * specified by RFC 6811.
+ */
+void bgpstream_roa_index_validate_elems(const bgpstream_roa_index_t *idx,
+                                        bgpstream_elem_t **elems, int cnt,
+                                        bgpstream_roa_validity_t *results);
+
+/** Remove all ROAs from the index
+ *
+ * @param idx           pointer to the index to clear
+ */
+void bgpstream_roa_index_clear(bgpstream_roa_index_t *idx);
+
+/** Destroy the given ROA index
+ *
+ * @param idx           pointer to the index to destroy
+ */
+void bgpstream_roa_index_destroy(bgpstream_roa_index_t *idx);
+
+/** @} */
+
+#endif /* __BGPSTREAM_UTILS_ROA_H */
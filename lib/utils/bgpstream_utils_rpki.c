@@ -127,7 +127,9 @@ int bgpstream_rpki_validate(bgpstream_elem_t const *elem, char *result,
   /* Validate the BGP elem only if the origin ASN is a simple ASN value
      (i.e. not a set). If the validation function of the ROAFetchlib
      returns 0 -> a valid result (val_rst = 1) is available */
-  if (!bgpstream_as_path_get_origin_val(elem->as_path, &asn)) {
+  bgpstream_as_path_t *path =
+    bgpstream_elem_get_as_path((bgpstream_elem_t *)elem);
+  if (path != NULL && !bgpstream_as_path_get_origin_val(path, &asn)) {
     if (!rpki_validate(elem->annotations.cfg, elem->annotations.timestamp, asn,
                        prefix, elem->prefix.mask_len, result, size)) {
       val_rst = 1;
@@ -0,0 +1,655 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bgpstream_log.h"
+#include "bgpstream_utils_snapshot.h"
+#include "utils.h"
+
+/** Snapshot file magic number ("BSPS") and version */
+#define SNAPSHOT_MAGIC 0x42535053
+#define SNAPSHOT_VERSION 1
+
+/** Written in host byte order, so that hosts with a different byte order can
+    tell the file is not for them */
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+#define TEMP_FILE_SUFFIX ".temp"
+
+/* all sections start on an 8-byte boundary, so that the mapped file can be
+   accessed in place */
+#define ALIGN8(x) (((x) + 7) & ~(uint64_t)7)
+
+/** Header at the start of a snapshot file. All offsets are from the start of
+    the file, so the file can be mapped anywhere */
+typedef struct snapshot_hdr {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t byte_order;
+
+  /** Number of prefixes (and entries) */
+  uint32_t pfx_cnt;
+
+  /** Offset of the array of pfx_cnt entries */
+  uint64_t entries_off;
+
+  /** Offset of the array of pfx_cnt + 1 user data offsets (relative to
+      data_off), or 0 if the snapshot has no user data */
+  uint64_t user_off;
+
+  /** Offset and length of the user data */
+  uint64_t data_off;
+  uint64_t data_len;
+
+  /** Length of the whole file */
+  uint64_t file_len;
+} snapshot_hdr_t;
+
+/** A prefix of a snapshot. Entries are sorted by version, (masked) address
+    and mask length, which puts every prefix right before the prefixes it
+    covers, i.e., in the order of a walk of a Patricia Tree */
+typedef struct snapshot_entry {
+  uint8_t addr[16];
+  uint8_t mask_len;
+
+  /** 4 or 6 */
+  uint8_t version;
+  uint8_t _pad[2];
+
+  /** Index of the most specific prefix covering this one, or
+      BGPSTREAM_SNAPSHOT_NONE. Always lower than the index of the entry */
+  uint32_t parent;
+} snapshot_entry_t;
+
+struct bgpstream_snapshot {
+  uint8_t *map;
+  size_t map_len;
+
+  const snapshot_hdr_t *hdr;
+  const snapshot_entry_t *entries;
+  const uint64_t *user_offs;
+  const uint8_t *data;
+};
+
+/* a prefix to be written, with the user pointer of its Patricia Tree node */
+typedef struct write_pfx {
+  snapshot_entry_t entry;
+  const void *user;
+} write_pfx_t;
+
+typedef struct write_state {
+  write_pfx_t *pfxs;
+  uint32_t pfxs_cnt;
+  uint32_t pfxs_alloc;
+  int rc;
+} write_state_t;
+
+static void pfx2entry(const bgpstream_pfx_t *pfx, snapshot_entry_t *entry)
+{
+  bgpstream_pfx_t masked;
+
+  bgpstream_pfx_copy(&masked, pfx);
+  bgpstream_addr_mask(&masked.address, masked.mask_len);
+
+  memset(entry, 0, sizeof(*entry));
+  entry->mask_len = masked.mask_len;
+  if (masked.address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
+    entry->version = 4;
+    memcpy(entry->addr, &masked.bs_ipv4.address.addr, 4);
+  } else {
+    entry->version = 6;
+    memcpy(entry->addr, &masked.bs_ipv6.address.addr, 16);
+  }
+  entry->parent = BGPSTREAM_SNAPSHOT_NONE;
+}
+
+static int entry_cmp(const snapshot_entry_t *a, const snapshot_entry_t *b)
+{
+  int rc;
+
+  if (a->version != b->version) {
+    return a->version < b->version ? -1 : 1;
+  }
+  if ((rc = memcmp(a->addr, b->addr, sizeof(a->addr))) != 0) {
+    return rc;
+  }
+  return (int)a->mask_len - (int)b->mask_len;
+}
+
+static int write_pfx_cmp(const void *a, const void *b)
+{
+  return entry_cmp(&((const write_pfx_t *)a)->entry,
+                   &((const write_pfx_t *)b)->entry);
+}
+
+/* does (masked) entry outer cover (or equal) entry inner? */
+static int entry_contains(const snapshot_entry_t *outer,
+                          const snapshot_entry_t *inner)
+{
+  int bytes = outer->mask_len / 8;
+  int bits = outer->mask_len % 8;
+
+  if (outer->version != inner->version || outer->mask_len > inner->mask_len ||
+      memcmp(outer->addr, inner->addr, bytes) != 0) {
+    return 0;
+  }
+  return bits == 0 ||
+         ((outer->addr[bytes] ^ inner->addr[bytes]) >> (8 - bits)) == 0;
+}
+
+static int add_write_pfx(write_state_t *state, const bgpstream_pfx_t *pfx,
+                         const void *user)
+{
+  write_pfx_t *pfxs;
+
+  if (state->pfxs_cnt == BGPSTREAM_SNAPSHOT_NONE) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Too many prefixes for a snapshot");
+    return -1;
+  }
+  if (state->pfxs_cnt == state->pfxs_alloc) {
+    state->pfxs_alloc = state->pfxs_alloc == 0 ? 1024 : state->pfxs_alloc * 2;
+    if ((pfxs = realloc(state->pfxs, sizeof(write_pfx_t) *
+                                       state->pfxs_alloc)) == NULL) {
+      return -1;
+    }
+    state->pfxs = pfxs;
+  }
+  pfx2entry(pfx, &state->pfxs[state->pfxs_cnt].entry);
+  state->pfxs[state->pfxs_cnt].user = user;
+  state->pfxs_cnt++;
+  return 0;
+}
+
+static int write_all(FILE *f, const void *buf, size_t len, uint64_t *off)
+{
+  static const uint8_t zeros[8] = {0};
+  size_t pad = ALIGN8(*off + len) - (*off + len);
+
+  if ((len != 0 && fwrite(buf, 1, len, f) != len) ||
+      fwrite(zeros, 1, pad, f) != pad) {
+    return -1;
+  }
+  *off += len + pad;
+  return 0;
+}
+
+/* sort the collected prefixes, link each to its parent and write them (and
+   their serialized user data) to filename */
+static int write_snapshot(const char *filename, write_state_t *state,
+                          bgpstream_snapshot_serialize_user_t *serialize,
+                          void *data)
+{
+  snapshot_hdr_t hdr;
+  uint32_t *stack = NULL;
+  uint64_t *user_offs = NULL;
+  uint8_t *buf = NULL, *tmp;
+  size_t buf_len = 0, buf_alloc = 0;
+  snapshot_entry_t *entries;
+  char *temp_path = NULL;
+  FILE *f = NULL;
+  uint64_t off = 0;
+  uint32_t i, depth = 0;
+  ssize_t len;
+
+  qsort(state->pfxs, state->pfxs_cnt, sizeof(write_pfx_t), write_pfx_cmp);
+
+  // the enclosing prefixes of each entry are on the stack
+  if ((stack = malloc(sizeof(uint32_t) * (state->pfxs_cnt + 1))) == NULL) {
+    goto err;
+  }
+  for (i = 0; i < state->pfxs_cnt; i++) {
+    while (depth > 0 && !entry_contains(&state->pfxs[stack[depth - 1]].entry,
+                                        &state->pfxs[i].entry)) {
+      depth--;
+    }
+    state->pfxs[i].entry.parent =
+      depth > 0 ? stack[depth - 1] : BGPSTREAM_SNAPSHOT_NONE;
+    stack[depth++] = i;
+  }
+
+  if (serialize != NULL) {
+    if ((user_offs = malloc(sizeof(uint64_t) * (state->pfxs_cnt + 1))) ==
+        NULL) {
+      goto err;
+    }
+    for (i = 0; i < state->pfxs_cnt; i++) {
+      user_offs[i] = buf_len;
+      while ((len = serialize(state->pfxs[i].user, buf + buf_len,
+                              buf_alloc - buf_len, data)) >= 0 &&
+             (size_t)len > buf_alloc - buf_len) {
+        buf_alloc = buf_alloc == 0 ? 4096 : buf_alloc;
+        while ((size_t)len > buf_alloc - buf_len) {
+          buf_alloc *= 2;
+        }
+        if ((tmp = realloc(buf, buf_alloc)) == NULL) {
+          goto err;
+        }
+        buf = tmp;
+      }
+      if (len < 0) {
+        bgpstream_log(BGPSTREAM_LOG_ERR,
+                      "Could not serialize the user data of a prefix");
+        goto err;
+      }
+      buf_len += len;
+    }
+    user_offs[state->pfxs_cnt] = buf_len;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = SNAPSHOT_MAGIC;
+  hdr.version = SNAPSHOT_VERSION;
+  hdr.byte_order = SNAPSHOT_BYTE_ORDER;
+  hdr.pfx_cnt = state->pfxs_cnt;
+  hdr.entries_off = ALIGN8(sizeof(hdr));
+  off = hdr.entries_off + sizeof(snapshot_entry_t) * (uint64_t)hdr.pfx_cnt;
+  if (serialize != NULL) {
+    hdr.user_off = ALIGN8(off);
+    off = hdr.user_off + sizeof(uint64_t) * ((uint64_t)hdr.pfx_cnt + 1);
+  }
+  hdr.data_off = ALIGN8(off);
+  hdr.data_len = buf_len;
+  hdr.file_len = ALIGN8(hdr.data_off + hdr.data_len);
+
+  // entries are written in place, over the (larger) write_pfx_t array
+  entries = (snapshot_entry_t *)state->pfxs;
+  for (i = 0; i < state->pfxs_cnt; i++) {
+    memmove(&entries[i], &state->pfxs[i].entry, sizeof(snapshot_entry_t));
+  }
+
+  len = strlen(filename) + sizeof(TEMP_FILE_SUFFIX);
+  if ((temp_path = malloc(len)) == NULL) {
+    goto err;
+  }
+  snprintf(temp_path, len, "%s%s", filename, TEMP_FILE_SUFFIX);
+  if ((f = fopen(temp_path, "wb")) == NULL) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not create snapshot %s: %s",
+                  temp_path, strerror(errno));
+    goto err;
+  }
+  off = 0;
+  if (write_all(f, &hdr, sizeof(hdr), &off) != 0 ||
+      write_all(f, entries, sizeof(snapshot_entry_t) * hdr.pfx_cnt, &off) !=
+        0 ||
+      (user_offs != NULL &&
+       write_all(f, user_offs, sizeof(uint64_t) * (hdr.pfx_cnt + 1), &off) !=
+         0) ||
+      write_all(f, buf, buf_len, &off) != 0 || fclose(f) != 0) {
+    f = NULL;
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not write snapshot %s: %s",
+                  temp_path, strerror(errno));
+    goto err;
+  }
+  f = NULL;
+  if (rename(temp_path, filename) != 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not rename %s: %s", temp_path,
+                  strerror(errno));
+    goto err;
+  }
+
+  free(temp_path);
+  free(buf);
+  free(user_offs);
+  free(stack);
+  return 0;
+
+err:
+  if (f != NULL) {
+    fclose(f);
+  }
+  if (temp_path != NULL) {
+    unlink(temp_path);
+    free(temp_path);
+  }
+  free(buf);
+  free(user_offs);
+  free(stack);
+  return -1;
+}
+
+static bgpstream_patricia_walk_cb_result_t
+write_patricia_node(const bgpstream_patricia_tree_t *pt,
+                    const bgpstream_patricia_node_t *node, void *data)
+{
+  write_state_t *state = data;
+
+  if (add_write_pfx(
+        state, bgpstream_patricia_tree_get_pfx(node),
+        bgpstream_patricia_tree_get_user(bgpstream_nonconst_node(node))) !=
+      0) {
+    state->rc = -1;
+    return BGPSTREAM_PATRICIA_WALK_END_ALL;
+  }
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+int bgpstream_snapshot_write_patricia(const char *filename,
+                                      const bgpstream_patricia_tree_t *pt,
+                                      bgpstream_snapshot_serialize_user_t
+                                        *serialize,
+                                      void *data)
+{
+  write_state_t state = {NULL, 0, 0, 0};
+  int rc = -1;
+
+  bgpstream_patricia_tree_walk(pt, write_patricia_node, &state);
+  if (state.rc == 0) {
+    rc = write_snapshot(filename, &state, serialize, data);
+  }
+  free(state.pfxs);
+  return rc;
+}
+
+static void write_set_pfx(bgpstream_pfx_t *pfx, void *data)
+{
+  write_state_t *state = data;
+
+  if (state->rc == 0 && add_write_pfx(state, pfx, NULL) != 0) {
+    state->rc = -1;
+  }
+}
+
+int bgpstream_snapshot_write_pfx_set(const char *filename,
+                                     bgpstream_pfx_set_t *set)
+{
+  write_state_t state = {NULL, 0, 0, 0};
+  int rc = -1;
+
+  if (bgpstream_pfx_set_iterate(set, write_set_pfx, &state) == 0 &&
+      state.rc == 0) {
+    rc = write_snapshot(filename, &state, NULL, NULL);
+  }
+  free(state.pfxs);
+  return rc;
+}
+
+bgpstream_snapshot_t *bgpstream_snapshot_open(const char *filename)
+{
+  bgpstream_snapshot_t *snap;
+  const snapshot_hdr_t *hdr;
+  struct stat st;
+  uint64_t user_end;
+  int fd;
+
+  if ((snap = malloc_zero(sizeof(bgpstream_snapshot_t))) == NULL) {
+    return NULL;
+  }
+  snap->map = MAP_FAILED;
+
+  if ((fd = open(filename, O_RDONLY)) < 0) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not open snapshot %s: %s",
+                  filename, strerror(errno));
+    goto err;
+  }
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    goto err;
+  }
+  if ((size_t)st.st_size < sizeof(snapshot_hdr_t)) {
+    close(fd);
+    goto corrupt;
+  }
+  snap->map_len = st.st_size;
+  snap->map = mmap(NULL, snap->map_len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (snap->map == MAP_FAILED) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Could not map snapshot %s: %s",
+                  filename, strerror(errno));
+    goto err;
+  }
+
+  // only the header is checked here, the rest is checked as it is used
+  hdr = snap->hdr = (const snapshot_hdr_t *)snap->map;
+  if (hdr->magic != SNAPSHOT_MAGIC || hdr->version != SNAPSHOT_VERSION ||
+      hdr->byte_order != SNAPSHOT_BYTE_ORDER) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Snapshot %s has an unsupported format",
+                  filename);
+    goto err;
+  }
+  user_end = hdr->user_off + sizeof(uint64_t) * ((uint64_t)hdr->pfx_cnt + 1);
+  if (hdr->file_len != snap->map_len ||
+      hdr->entries_off != ALIGN8(sizeof(snapshot_hdr_t)) ||
+      hdr->entries_off + sizeof(snapshot_entry_t) * (uint64_t)hdr->pfx_cnt >
+        hdr->file_len ||
+      (hdr->user_off != 0 &&
+       (hdr->user_off % 8 != 0 || hdr->user_off < hdr->entries_off ||
+        user_end > hdr->file_len)) ||
+      hdr->data_off > hdr->file_len ||
+      hdr->data_len > hdr->file_len - hdr->data_off) {
+    goto corrupt;
+  }
+  snap->entries = (const snapshot_entry_t *)(snap->map + hdr->entries_off);
+  if (hdr->user_off != 0) {
+    snap->user_offs = (const uint64_t *)(snap->map + hdr->user_off);
+  }
+  snap->data = snap->map + hdr->data_off;
+
+  return snap;
+
+corrupt:
+  bgpstream_log(BGPSTREAM_LOG_ERR, "Snapshot %s is corrupt", filename);
+err:
+  bgpstream_snapshot_close(snap);
+  return NULL;
+}
+
+uint32_t bgpstream_snapshot_get_pfx_cnt(const bgpstream_snapshot_t *snap)
+{
+  return snap->hdr->pfx_cnt;
+}
+
+int bgpstream_snapshot_get_pfx(const bgpstream_snapshot_t *snap, uint32_t idx,
+                               bgpstream_pfx_t *pfx)
+{
+  const snapshot_entry_t *entry;
+
+  if (idx >= snap->hdr->pfx_cnt) {
+    return -1;
+  }
+  entry = &snap->entries[idx];
+  memset(pfx, 0, sizeof(*pfx));
+  if (entry->version == 4 && entry->mask_len <= 32) {
+    bgpstream_ipv4_addr_init(&pfx->address, entry->addr);
+  } else if (entry->version == 6 && entry->mask_len <= 128) {
+    bgpstream_ipv6_addr_init(&pfx->address, entry->addr);
+  } else {
+    return -1;
+  }
+  pfx->mask_len = entry->mask_len;
+  return 0;
+}
+
+const uint8_t *
+bgpstream_snapshot_get_user_data(const bgpstream_snapshot_t *snap, uint32_t idx,
+                                 size_t *len_p)
+{
+  uint64_t start, end;
+
+  if (snap->user_offs == NULL || idx >= snap->hdr->pfx_cnt) {
+    return NULL;
+  }
+  start = snap->user_offs[idx];
+  end = snap->user_offs[idx + 1];
+  if (start > end || end > snap->hdr->data_len) {
+    return NULL;
+  }
+  *len_p = end - start;
+  return snap->data + start;
+}
+
+/* index of the last entry that sorts before (or equal to) key, or
+   BGPSTREAM_SNAPSHOT_NONE */
+static uint32_t find_pred(const bgpstream_snapshot_t *snap,
+                          const snapshot_entry_t *key)
+{
+  uint32_t lo = 0, hi = snap->hdr->pfx_cnt, mid;
+
+  // find the first entry greater than key
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (entry_cmp(&snap->entries[mid], key) <= 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo == 0 ? BGPSTREAM_SNAPSHOT_NONE : lo - 1;
+}
+
+uint32_t bgpstream_snapshot_search_exact(const bgpstream_snapshot_t *snap,
+                                         const bgpstream_pfx_t *pfx)
+{
+  snapshot_entry_t key;
+  uint32_t idx;
+
+  pfx2entry(pfx, &key);
+  if ((idx = find_pred(snap, &key)) != BGPSTREAM_SNAPSHOT_NONE &&
+      entry_cmp(&snap->entries[idx], &key) == 0) {
+    return idx;
+  }
+  return BGPSTREAM_SNAPSHOT_NONE;
+}
+
+uint32_t bgpstream_snapshot_lookup(const bgpstream_snapshot_t *snap,
+                                   const bgpstream_pfx_t *pfx)
+{
+  snapshot_entry_t key;
+  uint32_t idx, parent;
+
+  // every prefix covering pfx sorts before it, and covers all the prefixes
+  // in between, so the most specific one is the closest preceding entry or
+  // one of its ancestors
+  pfx2entry(pfx, &key);
+  idx = find_pred(snap, &key);
+  while (idx != BGPSTREAM_SNAPSHOT_NONE &&
+         !entry_contains(&snap->entries[idx], &key)) {
+    parent = snap->entries[idx].parent;
+    if (parent != BGPSTREAM_SNAPSHOT_NONE && parent >= idx) {
+      // corrupt snapshot, don't loop forever
+      return BGPSTREAM_SNAPSHOT_NONE;
+    }
+    idx = parent;
+  }
+  return idx;
+}
+
+bgpstream_patricia_tree_t *bgpstream_snapshot_load_patricia(
+  const bgpstream_snapshot_t *snap,
+  bgpstream_patricia_tree_destroy_user_t *destructor,
+  bgpstream_snapshot_deserialize_user_t *deserialize, void *data)
+{
+  bgpstream_patricia_tree_t *pt = NULL;
+  bgpstream_patricia_node_t **nodes = NULL;
+  bgpstream_pfx_t *pfxs = NULL;
+  uint32_t i, cnt = snap->hdr->pfx_cnt;
+  const uint8_t *buf;
+  void *user;
+  size_t len;
+
+  if (cnt > INT_MAX) {
+    bgpstream_log(BGPSTREAM_LOG_ERR, "Snapshot is too large for a tree");
+    return NULL;
+  }
+  if ((pt = bgpstream_patricia_tree_create(destructor)) == NULL ||
+      (pfxs = malloc(sizeof(bgpstream_pfx_t) * (cnt + 1))) == NULL ||
+      (nodes = malloc(sizeof(bgpstream_patricia_node_t *) * (cnt + 1))) ==
+        NULL) {
+    goto err;
+  }
+  for (i = 0; i < cnt; i++) {
+    if (bgpstream_snapshot_get_pfx(snap, i, &pfxs[i]) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Snapshot is corrupt");
+      goto err;
+    }
+  }
+  if (bgpstream_patricia_tree_insert_bulk(pt, pfxs, cnt, nodes, 1) != 0) {
+    goto err;
+  }
+
+  if (deserialize != NULL) {
+    for (i = 0; i < cnt; i++) {
+      if ((buf = bgpstream_snapshot_get_user_data(snap, i, &len)) == NULL) {
+        bgpstream_log(BGPSTREAM_LOG_ERR, "Snapshot has no valid user data");
+        goto err;
+      }
+      user = NULL;
+      if (deserialize(buf, len, &user, data) != 0) {
+        bgpstream_log(BGPSTREAM_LOG_ERR,
+                      "Could not deserialize the user data of a prefix");
+        goto err;
+      }
+      bgpstream_patricia_tree_set_user(pt, nodes[i], user);
+    }
+  }
+
+  free(nodes);
+  free(pfxs);
+  return pt;
+
+err:
+  free(nodes);
+  free(pfxs);
+  bgpstream_patricia_tree_destroy(pt);
+  return NULL;
+}
+
+int bgpstream_snapshot_load_pfx_set(const bgpstream_snapshot_t *snap,
+                                    bgpstream_pfx_set_t *set)
+{
+  bgpstream_pfx_t pfx;
+  uint32_t i;
+
+  for (i = 0; i < snap->hdr->pfx_cnt; i++) {
+    if (bgpstream_snapshot_get_pfx(snap, i, &pfx) != 0) {
+      bgpstream_log(BGPSTREAM_LOG_ERR, "Snapshot is corrupt");
+      return -1;
+    }
+    if (bgpstream_pfx_set_insert(set, &pfx) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void bgpstream_snapshot_close(bgpstream_snapshot_t *snap)
+{
+  if (snap == NULL) {
+    return;
+  }
+  if (snap->map != MAP_FAILED) {
+    munmap(snap->map, snap->map_len);
+  }
+  free(snap);
+}
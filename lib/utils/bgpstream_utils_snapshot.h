@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_UTILS_SNAPSHOT_H
+#define __BGPSTREAM_UTILS_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "bgpstream_utils_patricia.h"
+#include "bgpstream_utils_pfx.h"
+#include "bgpstream_utils_pfx_set.h"
+
+/** @file
+ *
+ * @brief Header file that exposes the public interface of BGP Stream prefix
+ * snapshots: files holding the prefixes of a Patricia Tree (with a serialized
+ * copy of the user data of each node) or of a prefix set.
+ *
+ * Snapshots are opened by mapping the file read-only, so they can be queried
+ * straight away, without being parsed or loaded, and the mapped pages are
+ * shared by every process that opens the same snapshot. They can also be
+ * loaded back into a Patricia Tree or prefix set.
+ *
+ * Snapshots use the byte order of the host that wrote them, and are rejected
+ * by hosts with a different byte order.
+ */
+
+/**
+ * @name Public Constants
+ *
+ * @{ */
+
+/** Index returned by snapshot lookups that find no prefix */
+#define BGPSTREAM_SNAPSHOT_NONE UINT32_MAX
+
+/** @} */
+
+/**
+ * @name Opaque Data Structures
+ *
+ * @{ */
+
+/** Opaque structure containing an open snapshot */
+typedef struct bgpstream_snapshot bgpstream_snapshot_t;
+
+/** @} */
+
+/**
+ * @name Public Data Structures
+ *
+ * @{ */
+
+/** Callback that serializes the user data of a Patricia Tree node
+ *
+ * @param user          the user pointer of the node (may be NULL)
+ * @param buf           buffer to write the serialized data into
+ * @param len           length of the buffer
+ * @param data          the pointer given to bgpstream_snapshot_write_patricia
+ * @return the number of bytes of the serialized data, or -1 if an error
+ * occurred. Like snprintf, if the buffer is too small the size it would need
+ * is returned (and the callback is called again with a larger buffer).
+ */
+typedef ssize_t(bgpstream_snapshot_serialize_user_t)(const void *user,
+                                                     uint8_t *buf, size_t len,
+                                                     void *data);
+
+/** Callback that rebuilds the user data of a Patricia Tree node
+ *
+ * @param buf           the serialized data
+ * @param len           length of the serialized data
+ * @param user_p        set to the user pointer of the node
+ * @param data          the pointer given to bgpstream_snapshot_load_patricia
+ * @return 0 if the data was rebuilt successfully, -1 otherwise
+ */
+typedef int(bgpstream_snapshot_deserialize_user_t)(const uint8_t *buf,
+                                                   size_t len, void **user_p,
+                                                   void *data);
+
+/** @} */
+
+/**
+ * @name Public API Functions
+ *
+ * @{ */
+
+/** Write a snapshot of a Patricia Tree
+ *
+ * @param filename      path of the snapshot file to write
+ * @param pt            pointer to the patricia tree
+ * @param serialize     callback that serializes the user data of each node,
+ *                      or NULL to leave the user data out
+ * @param data          pointer passed to the callback
+ * @return 0 if the snapshot was written successfully, -1 otherwise
+ *
+ * The snapshot is written to a temporary file which then replaces filename, so
+ * processes that have the previous snapshot open are not affected.
+ */
+int bgpstream_snapshot_write_patricia(const char *filename,
+                                      const bgpstream_patricia_tree_t *pt,
+                                      bgpstream_snapshot_serialize_user_t
+                                        *serialize,
+                                      void *data);
+
+/** Write a snapshot of a prefix set
+ *
+ * @param filename      path of the snapshot file to write
+ * @param set           pointer to the prefix set
+ * @return 0 if the snapshot was written successfully, -1 otherwise
+ */
+int bgpstream_snapshot_write_pfx_set(const char *filename,
+                                     bgpstream_pfx_set_t *set);
+
+/** Open a snapshot
+ *
+ * @param filename      path of the snapshot file to open
+ * @return a pointer to the snapshot, or NULL if the file could not be opened
+ * or is not a valid snapshot
+ */
+bgpstream_snapshot_t *bgpstream_snapshot_open(const char *filename);
+
+/** Get the number of prefixes in a snapshot
+ *
+ * @param snap          pointer to the snapshot
+ * @return the number of prefixes
+ */
+uint32_t bgpstream_snapshot_get_pfx_cnt(const bgpstream_snapshot_t *snap);
+
+/** Get a prefix of a snapshot
+ *
+ * @param snap          pointer to the snapshot
+ * @param idx           index of the prefix (less than the number of prefixes)
+ * @param pfx           pointer to the prefix to fill
+ * @return 0 if the prefix was read successfully, -1 if the snapshot is corrupt
+ *
+ * Prefixes are in the order of a walk of a Patricia Tree, IPv4 first.
+ */
+int bgpstream_snapshot_get_pfx(const bgpstream_snapshot_t *snap, uint32_t idx,
+                               bgpstream_pfx_t *pfx);
+
+/** Get the serialized user data of a prefix of a snapshot
+ *
+ * @param snap          pointer to the snapshot
+ * @param idx           index of the prefix (less than the number of prefixes)
+ * @param len_p         set to the length of the data
+ * @return a pointer to the data (within the mapped file), or NULL if the
+ * snapshot has no user data or is corrupt
+ */
+const uint8_t *
+bgpstream_snapshot_get_user_data(const bgpstream_snapshot_t *snap, uint32_t idx,
+                                 size_t *len_p);
+
+/** Find a prefix in a snapshot
+ *
+ * @param snap          pointer to the snapshot
+ * @param pfx           pointer to the prefix to look for
+ * @return the index of the prefix, or BGPSTREAM_SNAPSHOT_NONE if it is not in
+ * the snapshot
+ */
+uint32_t bgpstream_snapshot_search_exact(const bgpstream_snapshot_t *snap,
+                                         const bgpstream_pfx_t *pfx);
+
+/** Find the most specific prefix of a snapshot that covers (or is equal to) a
+ * prefix
+ *
+ * @param snap          pointer to the snapshot
+ * @param pfx           pointer to the prefix (e.g., a /32 or /128 to look up an
+ *                      address)
+ * @return the index of the covering prefix, or BGPSTREAM_SNAPSHOT_NONE if no
+ * prefix of the snapshot covers pfx
+ */
+uint32_t bgpstream_snapshot_lookup(const bgpstream_snapshot_t *snap,
+                                   const bgpstream_pfx_t *pfx);
+
+/** Load the prefixes of a snapshot into a new Patricia Tree
+ *
+ * @param snap          pointer to the snapshot
+ * @param destructor    function that destroys the user data of the tree nodes
+ * @param deserialize   callback that rebuilds the user data of each node from
+ *                      its serialized data, or NULL to leave the user data
+ *                      out
+ * @param data          pointer passed to the callback
+ * @return a pointer to the tree, or NULL if an error occurred
+ */
+bgpstream_patricia_tree_t *bgpstream_snapshot_load_patricia(
+  const bgpstream_snapshot_t *snap,
+  bgpstream_patricia_tree_destroy_user_t *destructor,
+  bgpstream_snapshot_deserialize_user_t *deserialize, void *data);
+
+/** Add the prefixes of a snapshot to a prefix set
+ *
+ * @param snap          pointer to the snapshot
+ * @param set           pointer to the prefix set
+ * @return 0 if the prefixes were added successfully, -1 otherwise
+ */
+int bgpstream_snapshot_load_pfx_set(const bgpstream_snapshot_t *snap,
+                                    bgpstream_pfx_set_t *set);
+
+/** Close a snapshot
+ *
+ * @param snap          pointer to the snapshot to close
+ */
+void bgpstream_snapshot_close(bgpstream_snapshot_t *snap);
+
+/** @} */
+
+#endif /* __BGPSTREAM_UTILS_SNAPSHOT_H */
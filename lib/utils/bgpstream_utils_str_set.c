@@ -30,6 +30,7 @@
 #include "khash.h"
 #include "utils.h"
 
+#include "bgpstream_utils_mphf_int.h"
 #include "bgpstream_utils_str_set.h"
 
 /* PRIVATE */
@@ -40,8 +41,36 @@ KHASH_INIT(bgpstream_str_set, char *, char, 0, kh_str_hash_func,
 struct bgpstream_str_set_t {
   khiter_t k;
   khash_t(bgpstream_str_set) * hash;
+
+  /* lookup table built by bgpstream_str_set_freeze, used until the set is
+     modified: the strings (borrowed from the hash) in the slots of a
+     perfect hash function */
+  int frozen;
+  char **frozen_strs;
+  bs_mphf_t mphf;
 };
 
+// 64-bit FNV-1a
+static inline uint64_t str_hash(const char *s)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (; *s != '\0'; s++) {
+    h = (h ^ (uint8_t)*s) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static void thaw(bgpstream_str_set_t *set)
+{
+  if (set->frozen == 0) {
+    return;
+  }
+  free(set->frozen_strs);
+  set->frozen_strs = NULL;
+  bs_mphf_destroy(&set->mphf);
+  set->frozen = 0;
+}
+
 /* PUBLIC FUNCTIONS */
 
 bgpstream_str_set_t *bgpstream_str_set_create()
@@ -52,6 +81,9 @@ bgpstream_str_set_t *bgpstream_str_set_create()
       NULL) {
     return NULL;
   }
+  set->frozen = 0;
+  set->frozen_strs = NULL;
+  memset(&set->mphf, 0, sizeof(set->mphf));
 
   if ((set->hash = kh_init(bgpstream_str_set)) == NULL) {
     bgpstream_str_set_destroy(set);
@@ -67,6 +99,7 @@ int bgpstream_str_set_insert(bgpstream_str_set_t *set, const char *val)
   int khret;
   khiter_t k;
   char *cpy;
+  thaw(set);
   if ((cpy = strdup(val)) == NULL) {
     return -1;
   }
@@ -83,6 +116,7 @@ int bgpstream_str_set_insert(bgpstream_str_set_t *set, const char *val)
 int bgpstream_str_set_remove(bgpstream_str_set_t *set, char *val)
 {
   khiter_t k;
+  thaw(set);
   bgpstream_str_set_rewind(set);
   if ((k = kh_get(bgpstream_str_set, set->hash, val)) != kh_end(set->hash)) {
     // free memory allocated for the key (string)
@@ -97,6 +131,11 @@ int bgpstream_str_set_remove(bgpstream_str_set_t *set, char *val)
 int bgpstream_str_set_exists(bgpstream_str_set_t *set, char *val)
 {
   khiter_t k;
+  if (set->frozen != 0) {
+    return set->mphf.disp != NULL &&
+           strcmp(set->frozen_strs[bs_mphf_slot(&set->mphf, str_hash(val))],
+                  val) == 0;
+  }
   if ((k = kh_get(bgpstream_str_set, set->hash, val)) == kh_end(set->hash)) {
     return 0;
   }
@@ -143,9 +182,58 @@ char *bgpstream_str_set_next(bgpstream_str_set_t *set)
   return v;
 }
 
+int bgpstream_str_set_freeze(bgpstream_str_set_t *set)
+{
+  uint64_t *hashes = NULL;
+  char **strs = NULL;
+  khiter_t k;
+  uint32_t i = 0, j;
+  int rc;
+
+  thaw(set);
+  if ((hashes = malloc(sizeof(uint64_t) * (kh_size(set->hash) + 1))) ==
+        NULL ||
+      (strs = malloc(sizeof(char *) * (kh_size(set->hash) + 1))) == NULL) {
+    goto err;
+  }
+  for (k = kh_begin(set->hash); k != kh_end(set->hash); ++k) {
+    if (kh_exist(set->hash, k)) {
+      hashes[i++] = str_hash(kh_key(set->hash, k));
+    }
+  }
+
+  if (i != 0) {
+    if ((rc = bs_mphf_build(&set->mphf, hashes, i)) < 0) {
+      goto err;
+    }
+    if (rc != 0) {
+      // two strings share a hash, so keep using the hash table
+      free(hashes);
+      free(strs);
+      return 0;
+    }
+    for (k = kh_begin(set->hash), j = 0; k != kh_end(set->hash); ++k) {
+      if (kh_exist(set->hash, k)) {
+        strs[bs_mphf_slot(&set->mphf, hashes[j++])] = kh_key(set->hash, k);
+      }
+    }
+  }
+
+  free(hashes);
+  set->frozen_strs = strs;
+  set->frozen = 1;
+  return 0;
+
+err:
+  free(hashes);
+  free(strs);
+  return -1;
+}
+
 void bgpstream_str_set_clear(bgpstream_str_set_t *set)
 {
   khiter_t k;
+  thaw(set);
   bgpstream_str_set_rewind(set);
   for (k = kh_begin(set->hash); k != kh_end(set->hash); ++k) {
     if (kh_exist(set->hash, k)) {
@@ -158,6 +246,7 @@ void bgpstream_str_set_clear(bgpstream_str_set_t *set)
 void bgpstream_str_set_destroy(bgpstream_str_set_t *set)
 {
   khiter_t k;
+  thaw(set);
   if (set->hash != NULL) {
     for (k = kh_begin(set->hash); k != kh_end(set->hash); ++k) {
       if (kh_exist(set->hash, k)) {
@@ -121,6 +121,18 @@ char *bgpstream_str_set_next(bgpstream_str_set_t *set);
  */
 void bgpstream_str_set_clear(bgpstream_str_set_t *set);
 
+/** Freeze the string set for faster lookups
+ *
+ * Builds a read-only lookup table (a minimal perfect hash) that
+ * bgpstream_str_set_exists uses until the set is next modified, which drops
+ * the table again. Meant for sets that are built once and then only queried,
+ * like filters.
+ *
+ * @param set           pointer to the string set
+ * @return 0 if the set was frozen successfully, -1 otherwise
+ */
+int bgpstream_str_set_freeze(bgpstream_str_set_t *set);
+
 /** Destroy the given string set
  *
  * @param set           pointer to the string set to destroy
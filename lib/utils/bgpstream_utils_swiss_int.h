@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __BGPSTREAM_UTILS_SWISS_INT_H
+#define __BGPSTREAM_UTILS_SWISS_INT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** @file
+ *
+ * @brief Header file that exposes the private interface of BGP Stream hash
+ * sets: open-addressing sets in the style of Swiss tables, instantiated for
+ * a key type by BS_SWISS_SET_INIT (much like KHASH_INIT)
+ *
+ * Slots are arranged in groups of BS_SWISS_GROUP_SIZE, each with one control
+ * byte per slot that is either BS_SWISS_EMPTY or 7 bits of the hash of the
+ * key in the slot. A lookup compares the control bytes of a whole group
+ * against the hash of the key at once (with SSE2 where available) and only
+ * compares the keys whose control byte matches, so nearly every lookup reads
+ * one group of control bytes and at most one key. Groups are probed
+ * quadratically until one with an empty slot is found.
+ *
+ * Keys cannot be removed (none of the sets need it), so there are no
+ * tombstones.
+ */
+
+/**
+ * @name Private Constants
+ *
+ * @{ */
+
+/** Number of slots in a group */
+#define BS_SWISS_GROUP_SIZE 16
+
+/** Control byte of an empty slot */
+#define BS_SWISS_EMPTY 0x80
+
+/** @} */
+
+/**
+ * @name Private API Functions
+ *
+ * @{ */
+
+/** Get the bitmask of the control bytes of a group that are equal to c */
+static inline uint32_t bs_swiss_group_match(const uint8_t *ctrl, uint8_t c)
+{
+#ifdef __SSE2__
+  __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(c)));
+#else
+  uint32_t mask = 0;
+  int i;
+  for (i = 0; i < BS_SWISS_GROUP_SIZE; i++) {
+    mask |= (uint32_t)(ctrl[i] == c) << i;
+  }
+  return mask;
+#endif
+}
+
+/** Get the bitmask of the empty slots of a group */
+static inline uint32_t bs_swiss_group_match_empty(const uint8_t *ctrl)
+{
+#ifdef __SSE2__
+  // empty slots are the only ones with the high bit set
+  return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+  return bs_swiss_group_match(ctrl, BS_SWISS_EMPTY);
+#endif
+}
+
+/** Spread the bits of a hash value (some key hashes, e.g. of ids, are the
+ * key itself) */
+static inline uint64_t bs_swiss_mix(uint64_t hash)
+{
+  return (hash ^ (hash >> 32)) * 0x9E3779B97F4A7C15ULL;
+}
+
+/** Group of the probe sequence of a (mixed) hash */
+#define BS_SWISS_H1(h) ((uint32_t)((h) >> 32))
+
+/** Control byte of a (mixed) hash */
+#define BS_SWISS_H2(h) ((uint8_t)((h) >> 57))
+
+/** Index of the lowest bit set in a (non-zero) match bitmask */
+#define BS_SWISS_FIRST(mask) __builtin_ctz(mask)
+
+/** Iterate over the slots of a set (use with BS_SWISS_FULL) */
+#define bs_swiss_begin(s) 0
+#define bs_swiss_end(s) ((s)->cap)
+#define BS_SWISS_FULL(s, i) (((s)->ctrl[(i)] & BS_SWISS_EMPTY) == 0)
+#define bs_swiss_key(s, i) ((s)->keys[(i)])
+#define bs_swiss_size(s) ((s)->size)
+
+/** Instantiate a hash set of keys of type key_t
+ *
+ * @param name          name of the set type (bs_swiss_<name>_t)
+ * @param key_t         type of the keys (copied into the set)
+ * @param hash_func     function (or macro) giving a 64 bit hash of a key
+ * @param equal_func    function (or macro) telling if two keys are equal
+ *
+ * Both functions take keys by value, like those given to KHASH_INIT.
+ */
+#define BS_SWISS_SET_INIT(name, key_t, hash_func, equal_func)                  \
+  typedef struct {                                                             \
+    uint8_t *ctrl;                                                             \
+    key_t *keys;                                                               \
+    /* number of slots (0 or a power of two multiple of the group size) */     \
+    uint32_t cap;                                                              \
+    uint32_t size;                                                             \
+    /* keys that can be added before the set must grow */                      \
+    uint32_t growth_left;                                                      \
+  } bs_swiss_##name##_t;                                                       \
+                                                                               \
+  static inline __attribute__((__unused__)) void bs_swiss_##name##_init(       \
+    bs_swiss_##name##_t *s)                                                    \
+  {                                                                            \
+    memset(s, 0, sizeof(*s));                                                  \
+  }                                                                            \
+                                                                               \
+  static inline __attribute__((__unused__)) void bs_swiss_##name##_destroy(    \
+    bs_swiss_##name##_t *s)                                                    \
+  {                                                                            \
+    free(s->ctrl);                                                             \
+    free(s->keys);                                                             \
+    memset(s, 0, sizeof(*s));                                                  \
+  }                                                                            \
+                                                                               \
+  static inline __attribute__((__unused__)) void bs_swiss_##name##_clear(      \
+    bs_swiss_##name##_t *s)                                                    \
+  {                                                                            \
+    if (s->cap != 0) {                                                         \
+      memset(s->ctrl, BS_SWISS_EMPTY, s->cap);                                 \
+    }                                                                          \
+    s->size = 0;                                                               \
+    s->growth_left = s->cap - s->cap / 8;                                      \
+  }                                                                            \
+                                                                               \
+  /* index of the slot of key (whose mixed hash is h), or s->cap if it is not \
+     in the set */                                                             \
+  static inline __attribute__((__unused__)) uint32_t                           \
+    bs_swiss_##name##_get_hashed(const bs_swiss_##name##_t *s, key_t key,      \
+                                 uint64_t h)                                   \
+  {                                                                            \
+    uint32_t gmask = s->cap / BS_SWISS_GROUP_SIZE - 1;                         \
+    uint32_t g = BS_SWISS_H1(h), step, match, i;                               \
+    const uint8_t *ctrl;                                                       \
+                                                                               \
+    if (s->cap == 0) {                                                         \
+      return s->cap;                                                           \
+    }                                                                          \
+    for (step = 1;; step++) {                                                  \
+      g &= gmask;                                                              \
+      ctrl = s->ctrl + g * BS_SWISS_GROUP_SIZE;                                \
+      for (match = bs_swiss_group_match(ctrl, BS_SWISS_H2(h)); match != 0;     \
+           match &= match - 1) {                                               \
+        i = g * BS_SWISS_GROUP_SIZE + BS_SWISS_FIRST(match);                   \
+        if (equal_func(s->keys[i], key)) {                                     \
+          return i;                                                            \
+        }                                                                      \
+      }                                                                        \
+      if (bs_swiss_group_match_empty(ctrl) != 0) {                             \
+        return s->cap;                                                         \
+      }                                                                        \
+      g += step;                                                               \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  /* index of the slot of key, or s->cap if it is not in the set */            \
+  static inline __attribute__((__unused__)) uint32_t bs_swiss_##name##_get(    \
+    const bs_swiss_##name##_t *s, key_t key)                                   \
+  {                                                                            \
+    return bs_swiss_##name##_get_hashed(s, key, bs_swiss_mix(hash_func(key))); \
+  }                                                                            \
+                                                                               \
+  /* store a key that is not in the set (which has room for it) */             \
+  static inline __attribute__((__unused__)) uint32_t                           \
+    bs_swiss_##name##_put_new(bs_swiss_##name##_t *s, key_t key, uint64_t h)   \
+  {                                                                            \
+    uint32_t gmask = s->cap / BS_SWISS_GROUP_SIZE - 1;                         \
+    uint32_t g = BS_SWISS_H1(h), step, empty, i;                               \
+                                                                               \
+    for (step = 1;; step++) {                                                  \
+      g &= gmask;                                                              \
+      empty = bs_swiss_group_match_empty(s->ctrl + g * BS_SWISS_GROUP_SIZE);   \
+      if (empty != 0) {                                                        \
+        i = g * BS_SWISS_GROUP_SIZE + BS_SWISS_FIRST(empty);                   \
+        s->ctrl[i] = BS_SWISS_H2(h);                                           \
+        s->keys[i] = key;                                                      \
+        s->size++;                                                             \
+        s->growth_left--;                                                      \
+        return i;                                                              \
+      }                                                                        \
+      g += step;                                                               \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  static inline __attribute__((__unused__)) int bs_swiss_##name##_resize(      \
+    bs_swiss_##name##_t *s, uint32_t cap)                                      \
+  {                                                                            \
+    bs_swiss_##name##_t old = *s;                                              \
+    uint32_t i;                                                                \
+                                                                               \
+    if ((s->ctrl = malloc(cap)) == NULL ||                                     \
+        (s->keys = malloc(sizeof(key_t) * cap)) == NULL) {                     \
+      free(s->ctrl);                                                           \
+      *s = old;                                                                \
+      return -1;                                                               \
+    }                                                                          \
+    memset(s->ctrl, BS_SWISS_EMPTY, cap);                                      \
+    s->cap = cap;                                                              \
+    s->size = 0;                                                               \
+    s->growth_left = cap - cap / 8;                                            \
+    for (i = 0; i < old.cap; i++) {                                            \
+      if (BS_SWISS_FULL(&old, i)) {                                            \
+        bs_swiss_##name##_put_new(s, old.keys[i],                              \
+                                  bs_swiss_mix(hash_func(old.keys[i])));       \
+      }                                                                        \
+    }                                                                          \
+    free(old.ctrl);                                                            \
+    free(old.keys);                                                            \
+    return 0;                                                                  \
+  }                                                                            \
+                                                                               \
+  /* returns 1 if the key was added, 0 if it was already in the set, -1 if an  \
+     error occurred */                                                         \
+  static inline __attribute__((__unused__)) int bs_swiss_##name##_put(         \
+    bs_swiss_##name##_t *s, key_t key)                                         \
+  {                                                                            \
+    uint64_t h = bs_swiss_mix(hash_func(key));                                 \
+                                                                               \
+    if (bs_swiss_##name##_get_hashed(s, key, h) != s->cap) {                   \
+      return 0;                                                                \
+    }                                                                          \
+    if (s->growth_left == 0) {                                                 \
+      if (s->cap >= (UINT32_C(1) << 31) ||                                     \
+          bs_swiss_##name##_resize(                                            \
+            s, s->cap == 0 ? BS_SWISS_GROUP_SIZE : s->cap * 2) != 0) {         \
+        return -1;                                                             \
+      }                                                                        \
+    }                                                                          \
+    bs_swiss_##name##_put_new(s, key, h);                                      \
+    return 1;                                                                  \
+  }
+
+/** @} */
+
+#endif /* __BGPSTREAM_UTILS_SWISS_INT_H */
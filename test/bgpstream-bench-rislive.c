@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2015 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Throughput benchmark for the RIS Live format: replicates the lines of
+ * ris-live-stream.json into a temporary file and times reading it back
+ * through the singlefile data interface.
+ *
+ * Usage: bgpstream-bench-rislive [copies] [input]
+ */
+
+#include "bgpstream.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_COPIES 20000
+#define DEFAULT_INPUT "ris-live-stream.json"
+
+static char line[65536];
+
+static int make_input(const char *input, int copies, char *path)
+{
+  FILE *in = NULL, *out = NULL;
+  int fd, i;
+
+  if ((fd = mkstemp(path)) < 0 || (out = fdopen(fd, "w")) == NULL) {
+    fprintf(stderr, "ERROR: Could not create %s\n", path);
+    goto err;
+  }
+  if ((in = fopen(input, "r")) == NULL) {
+    fprintf(stderr, "ERROR: Could not open %s\n", input);
+    goto err;
+  }
+  for (i = 0; i < copies; i++) {
+    rewind(in);
+    while (fgets(line, sizeof(line), in) != NULL) {
+      fputs(line, out);
+    }
+  }
+  fclose(in);
+  if (fclose(out) != 0) {
+    return -1;
+  }
+  return 0;
+
+err:
+  if (in != NULL) {
+    fclose(in);
+  }
+  if (out != NULL) {
+    fclose(out);
+  }
+  return -1;
+}
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+  int copies = argc > 1 ? atoi(argv[1]) : DEFAULT_COPIES;
+  const char *input = argc > 2 ? argv[2] : DEFAULT_INPUT;
+  char path[] = "/tmp/bgpstream-bench-rislive.XXXXXX";
+  bgpstream_t *bs = NULL;
+  bgpstream_data_interface_id_t di_id;
+  bgpstream_data_interface_option_t *option;
+  bgpstream_record_t *rec;
+  bgpstream_elem_t *elem;
+  uint64_t rec_cnt = 0, elem_cnt = 0;
+  double start, elapsed;
+  int rc = -1;
+
+  if (copies <= 0 || make_input(input, copies, path) != 0) {
+    return -1;
+  }
+
+  if ((bs = bgpstream_create()) == NULL) {
+    goto done;
+  }
+  di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile");
+  bgpstream_set_data_interface(bs, di_id);
+  if ((option = bgpstream_get_data_interface_option_by_name(
+         bs, di_id, "upd-type")) == NULL ||
+      bgpstream_set_data_interface_option(bs, option, "ris-live") != 0 ||
+      (option = bgpstream_get_data_interface_option_by_name(
+         bs, di_id, "upd-file")) == NULL ||
+      bgpstream_set_data_interface_option(bs, option, path) != 0) {
+    fprintf(stderr, "ERROR: Could not configure singlefile interface\n");
+    goto done;
+  }
+  if (bgpstream_start(bs) < 0) {
+    fprintf(stderr, "ERROR: Could not start BGPStream\n");
+    goto done;
+  }
+
+  start = now();
+  while (bgpstream_get_next_record(bs, &rec) > 0) {
+    rec_cnt++;
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      elem_cnt++;
+    }
+  }
+  elapsed = now() - start;
+
+  printf("%" PRIu64 " records, %" PRIu64 " elems in %.3fs "
+         "(%.0f records/s)\n",
+         rec_cnt, elem_cnt, elapsed, elapsed > 0 ? rec_cnt / elapsed : 0);
+  rc = 0;
+
+done:
+  bgpstream_destroy(bs);
+  unlink(path);
+  return rc;
+}
@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Set benchmark: collects the prefixes and origin ASNs of every elem of the
+ * bundled RIB dump (or the file given on the command line) and times building
+ * and probing a set of them, a number of times, with the bgpstream id and
+ * prefix sets and with plain khash sets like the ones they used to wrap.
+ *
+ * Usage: bgpstream-bench-sets [-r rounds] [file]
+ */
+
+#include "bgpstream.h"
+#include "khash.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_ROUNDS 5
+
+#define DEFAULT_FILE "ris.rrc06.ribs.1427846400.gz"
+
+KHASH_INIT(bench_id_set, uint32_t, char, 0, kh_int_hash_func,
+           kh_int_hash_equal)
+
+KHASH_INIT(bench_ipv4_pfx_set, bgpstream_ipv4_pfx_t, char, 0,
+           bgpstream_ipv4_pfx_hash_val, bgpstream_ipv4_pfx_equal_val)
+
+KHASH_INIT(bench_ipv6_pfx_set, bgpstream_ipv6_pfx_t, char, 0,
+           bgpstream_ipv6_pfx_hash_val, bgpstream_ipv6_pfx_equal_val)
+
+// keys in the order they appear in the dump, duplicates included
+static bgpstream_pfx_t *pfxs = NULL;
+static uint32_t *asns = NULL;
+static int64_t key_cnt = 0;
+static int64_t key_alloc = 0;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int add_key(bgpstream_elem_t *elem)
+{
+  uint32_t asn = 0;
+
+  if (key_cnt == key_alloc) {
+    key_alloc = key_alloc == 0 ? 1024 * 1024 : key_alloc * 2;
+    if ((pfxs = realloc(pfxs, sizeof(*pfxs) * key_alloc)) == NULL ||
+        (asns = realloc(asns, sizeof(*asns) * key_alloc)) == NULL) {
+      return -1;
+    }
+  }
+  bgpstream_as_path_get_origin_val(elem->as_path, &asn);
+  pfxs[key_cnt] = elem->prefix;
+  asns[key_cnt] = asn;
+  key_cnt++;
+  return 0;
+}
+
+// read the whole file once, returns 0 if all keys were collected
+static int load_keys(const char *file)
+{
+  bgpstream_t *bs;
+  bgpstream_data_interface_id_t di_id;
+  bgpstream_data_interface_option_t *option;
+  bgpstream_record_t *rec;
+  bgpstream_elem_t *elem;
+  int rc = -1;
+
+  if ((bs = bgpstream_create()) == NULL) {
+    return -1;
+  }
+  di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile");
+  bgpstream_set_data_interface(bs, di_id);
+  if ((option = bgpstream_get_data_interface_option_by_name(
+         bs, di_id, "rib-file")) == NULL ||
+      bgpstream_set_data_interface_option(bs, option, file) != 0) {
+    fprintf(stderr, "ERROR: Could not configure singlefile interface\n");
+    goto done;
+  }
+  if (bgpstream_start(bs) < 0) {
+    fprintf(stderr, "ERROR: Could not start BGPStream\n");
+    goto done;
+  }
+
+  while (bgpstream_get_next_record(bs, &rec) > 0) {
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      if (elem->type == BGPSTREAM_ELEM_TYPE_RIB && add_key(elem) != 0) {
+        goto done;
+      }
+    }
+  }
+  rc = 0;
+
+done:
+  bgpstream_destroy(bs);
+  return rc;
+}
+
+// each run inserts every key and then looks every key up again, returning
+// the number of hits so that the lookups can not be optimized away
+
+static int64_t run_khash_id(void)
+{
+  khash_t(bench_id_set) *h = kh_init(bench_id_set);
+  int64_t i, hits = 0;
+  int ret;
+
+  for (i = 0; i < key_cnt; i++) {
+    kh_put(bench_id_set, h, asns[i], &ret);
+  }
+  for (i = 0; i < key_cnt; i++) {
+    hits += kh_get(bench_id_set, h, asns[i]) != kh_end(h);
+  }
+  kh_destroy(bench_id_set, h);
+  return hits;
+}
+
+static int64_t run_bgpstream_id(void)
+{
+  bgpstream_id_set_t *set = bgpstream_id_set_create();
+  int64_t i, hits = 0;
+
+  for (i = 0; i < key_cnt; i++) {
+    bgpstream_id_set_insert(set, asns[i]);
+  }
+  for (i = 0; i < key_cnt; i++) {
+    hits += bgpstream_id_set_exists(set, asns[i]);
+  }
+  bgpstream_id_set_destroy(set);
+  return hits;
+}
+
+static int64_t run_khash_pfx(void)
+{
+  khash_t(bench_ipv4_pfx_set) *h4 = kh_init(bench_ipv4_pfx_set);
+  khash_t(bench_ipv6_pfx_set) *h6 = kh_init(bench_ipv6_pfx_set);
+  int64_t i, hits = 0;
+  int ret;
+
+  for (i = 0; i < key_cnt; i++) {
+    if (pfxs[i].address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
+      kh_put(bench_ipv4_pfx_set, h4, pfxs[i].bs_ipv4, &ret);
+    } else {
+      kh_put(bench_ipv6_pfx_set, h6, pfxs[i].bs_ipv6, &ret);
+    }
+  }
+  for (i = 0; i < key_cnt; i++) {
+    if (pfxs[i].address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
+      hits += kh_get(bench_ipv4_pfx_set, h4, pfxs[i].bs_ipv4) != kh_end(h4);
+    } else {
+      hits += kh_get(bench_ipv6_pfx_set, h6, pfxs[i].bs_ipv6) != kh_end(h6);
+    }
+  }
+  kh_destroy(bench_ipv4_pfx_set, h4);
+  kh_destroy(bench_ipv6_pfx_set, h6);
+  return hits;
+}
+
+static int64_t run_bgpstream_pfx(void)
+{
+  bgpstream_pfx_set_t *set = bgpstream_pfx_set_create();
+  int64_t i, hits = 0;
+
+  for (i = 0; i < key_cnt; i++) {
+    bgpstream_pfx_set_insert(set, &pfxs[i]);
+  }
+  for (i = 0; i < key_cnt; i++) {
+    hits += bgpstream_pfx_set_exists(set, &pfxs[i]);
+  }
+  bgpstream_pfx_set_destroy(set);
+  return hits;
+}
+
+static int bench(const char *name, int64_t (*run)(void), int rounds)
+{
+  double start, elapsed;
+  int64_t hits;
+  int r;
+
+  start = now();
+  for (r = 0; r < rounds; r++) {
+    if ((hits = run()) != key_cnt) {
+      fprintf(stderr, "ERROR: %s found %" PRId64 " of %" PRId64 " keys\n", name,
+              hits, key_cnt);
+      return -1;
+    }
+  }
+  elapsed = now() - start;
+  printf("%-16s %.3fs (%.0f keys/s)\n", name, elapsed,
+         elapsed > 0 ? 2.0 * rounds * key_cnt / elapsed : 0);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  const char *file = DEFAULT_FILE;
+  int rounds = DEFAULT_ROUNDS;
+  int rc = -1;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "r:")) >= 0) {
+    switch (opt) {
+    case 'r':
+      rounds = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-r rounds] [file]\n", argv[0]);
+      return -1;
+    }
+  }
+  if (rounds <= 0) {
+    fprintf(stderr, "ERROR: Invalid number of rounds %d\n", rounds);
+    return -1;
+  }
+  if (optind < argc) {
+    file = argv[optind];
+  }
+
+  if (load_keys(file) != 0) {
+    goto done;
+  }
+  printf("%s: %" PRId64 " keys, %d rounds\n", file, key_cnt, rounds);
+
+  if (bench("khash id", run_khash_id, rounds) != 0 ||
+      bench("bgpstream id", run_bgpstream_id, rounds) != 0 ||
+      bench("khash pfx", run_khash_pfx, rounds) != 0 ||
+      bench("bgpstream pfx", run_bgpstream_pfx, rounds) != 0) {
+    goto done;
+  }
+  rc = 0;
+
+done:
+  free(pfxs);
+  free(asns);
+  return rc;
+}
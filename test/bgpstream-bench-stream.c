@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * End-to-end benchmark suite: runs a fixed set of workloads (decoding only,
+ * decoding with each type of elem filter, and rendering elems as text) over
+ * each of the bundled dumps (or the files given on the command line), reading
+ * them through the singlefile data interface a number of times. Each run is
+ * reported as one JSON object per line, with the records and elems per
+ * second, the nanoseconds per elem decoded, and the peak RSS of the process,
+ * so that results can be compared across commits.
+ *
+ * The peak RSS only grows within a process, so run a single workload (-w) on a
+ * single file when it matters.
+ *
+ * Usage: bgpstream-bench-stream [-r rounds] [-w workload] [file...]
+ */
+
+#include "bgpstream.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_ROUNDS 3
+
+// rendered text is discarded once this much of it is buffered
+#define FORMAT_FLUSH_LEN 65536
+
+// workloads that do not use a filter
+#define NO_FILTER -1
+
+enum {
+  FORMAT_NONE,
+  FORMAT_DEFAULT,
+  FORMAT_BGPDUMP,
+};
+
+typedef struct workload {
+  const char *name;
+
+  // elem filter to add (NO_FILTER for none), and its value
+  int filter_type;
+  const char *filter_value;
+
+  // how elems are rendered as text
+  int format;
+} workload_t;
+
+static const workload_t workloads[] = {
+  {"decode", NO_FILTER, NULL, FORMAT_NONE},
+  {"filter-elem-type", BGPSTREAM_FILTER_TYPE_ELEM_TYPE, "announcements",
+   FORMAT_NONE},
+  {"filter-ip-version", BGPSTREAM_FILTER_TYPE_ELEM_IP_VERSION, "6",
+   FORMAT_NONE},
+  {"filter-peer", BGPSTREAM_FILTER_TYPE_ELEM_PEER_ASN, "25152", FORMAT_NONE},
+  {"filter-not-peer", BGPSTREAM_FILTER_TYPE_ELEM_NOT_PEER_ASN, "25152",
+   FORMAT_NONE},
+  {"filter-origin", BGPSTREAM_FILTER_TYPE_ELEM_ORIGIN_ASN, "15169",
+   FORMAT_NONE},
+  {"filter-prefix", BGPSTREAM_FILTER_TYPE_ELEM_PREFIX, "202.0.0.0/8",
+   FORMAT_NONE},
+  {"filter-community", BGPSTREAM_FILTER_TYPE_ELEM_COMMUNITY, "2914:*",
+   FORMAT_NONE},
+  {"filter-aspath", BGPSTREAM_FILTER_TYPE_ELEM_ASPATH, "_2914_",
+   FORMAT_NONE},
+  {"format-elems", NO_FILTER, NULL, FORMAT_DEFAULT},
+  {"format-bgpdump", NO_FILTER, NULL, FORMAT_BGPDUMP},
+  {NULL, NO_FILTER, NULL, FORMAT_NONE},
+};
+
+static const char *default_files[] = {
+  "ris.rrc06.ribs.1427846400.gz",
+  "ris.rrc06.updates.1427846400.gz",
+  "routeviews.route-views.jinx.ribs.1427846400.bz2",
+  "routeviews.route-views.jinx.updates.1427846400.bz2",
+  "ris-live-stream.json",
+  NULL,
+};
+
+typedef struct result {
+  uint64_t records;
+  uint64_t elems;
+  uint64_t elems_decoded;
+} result_t;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long peak_rss_kb()
+{
+  struct rusage ru;
+
+  if (getrusage(RUSAGE_SELF, &ru) != 0) {
+    return -1;
+  }
+  return ru.ru_maxrss;
+}
+
+static int set_option(bgpstream_t *bs, bgpstream_data_interface_id_t di_id,
+                      const char *name, const char *value)
+{
+  bgpstream_data_interface_option_t *option;
+
+  if ((option = bgpstream_get_data_interface_option_by_name(bs, di_id,
+                                                            name)) == NULL ||
+      bgpstream_set_data_interface_option(bs, option, value) != 0) {
+    fprintf(stderr, "ERROR: Could not set singlefile option %s\n", name);
+    return -1;
+  }
+  return 0;
+}
+
+// read the whole file once, adding to the counts of res
+static int run_file(const workload_t *w, const char *file, result_t *res)
+{
+  bgpstream_t *bs;
+  bgpstream_data_interface_id_t di_id;
+  bgpstream_record_t *rec;
+  bgpstream_elem_t *elem;
+  bgpstream_elem_formatter_t *fmt = NULL;
+  bgpstream_perf_stats_t stats;
+  const char *out;
+  int ris_live = strstr(file, ".json") != NULL;
+  int rc = -1;
+
+  if ((bs = bgpstream_create()) == NULL) {
+    return -1;
+  }
+  di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile");
+  bgpstream_set_data_interface(bs, di_id);
+  if ((ris_live && set_option(bs, di_id, "upd-type", "ris-live") != 0) ||
+      set_option(bs, di_id, "upd-file", file) != 0) {
+    goto done;
+  }
+  if (w->filter_type != NO_FILTER &&
+      bgpstream_add_filter(bs, w->filter_type, w->filter_value) == 0) {
+    fprintf(stderr, "ERROR: Could not add the %s filter\n", w->name);
+    goto done;
+  }
+  if ((w->format == FORMAT_DEFAULT &&
+       (fmt = bgpstream_elem_formatter_create(NULL)) == NULL) ||
+      (w->format == FORMAT_BGPDUMP &&
+       (fmt = bgpstream_elem_formatter_create_bgpdump()) == NULL)) {
+    fprintf(stderr, "ERROR: Could not create the elem formatter\n");
+    goto done;
+  }
+  if (bgpstream_start(bs) < 0) {
+    fprintf(stderr, "ERROR: Could not start BGPStream\n");
+    goto done;
+  }
+
+  while (bgpstream_get_next_record(bs, &rec) > 0) {
+    res->records++;
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      res->elems++;
+      if (fmt == NULL) {
+        continue;
+      }
+      if (bgpstream_elem_formatter_add_elem(fmt, rec, elem) != 0) {
+        fprintf(stderr, "ERROR: Could not render an elem\n");
+        goto done;
+      }
+      if (bgpstream_elem_formatter_get_output(fmt, &out) >=
+          FORMAT_FLUSH_LEN) {
+        bgpstream_elem_formatter_clear(fmt);
+      }
+    }
+  }
+  bgpstream_get_perf_stats(bs, &stats);
+  res->elems_decoded += stats.elems;
+  rc = 0;
+
+done:
+  bgpstream_elem_formatter_destroy(fmt);
+  bgpstream_destroy(bs);
+  return rc;
+}
+
+static int run(const workload_t *w, const char *file, int rounds)
+{
+  result_t res;
+  double start, elapsed;
+  int r;
+
+  memset(&res, 0, sizeof(res));
+  start = now();
+  for (r = 0; r < rounds; r++) {
+    if (run_file(w, file, &res) != 0) {
+      return -1;
+    }
+  }
+  elapsed = now() - start;
+
+  printf("{\"workload\":\"%s\",\"file\":\"%s\",\"rounds\":%d,"
+         "\"records\":%" PRIu64 ",\"elems\":%" PRIu64
+         ",\"elems_decoded\":%" PRIu64 ",\"seconds\":%.6f,"
+         "\"records_per_sec\":%.0f,\"elems_per_sec\":%.0f,"
+         "\"ns_per_elem\":%.1f,\"peak_rss_kb\":%ld}\n",
+         w->name, file, rounds, res.records, res.elems, res.elems_decoded,
+         elapsed, elapsed > 0 ? res.records / elapsed : 0,
+         elapsed > 0 ? res.elems / elapsed : 0,
+         res.elems_decoded > 0 ? elapsed * 1e9 / res.elems_decoded : 0,
+         peak_rss_kb());
+  fflush(stdout);
+  return 0;
+}
+
+static void usage(const char *name)
+{
+  int i;
+
+  fprintf(stderr,
+          "Usage: %s [-r rounds] [-w workload] [file...]\n"
+          "Workloads:",
+          name);
+  for (i = 0; workloads[i].name != NULL; i++) {
+    fprintf(stderr, " %s", workloads[i].name);
+  }
+  fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv)
+{
+  const char **files = default_files;
+  const char *only_workload = NULL;
+  int rounds = DEFAULT_ROUNDS;
+  int opt, i, j, runs = 0;
+
+  while ((opt = getopt(argc, argv, "r:w:")) >= 0) {
+    switch (opt) {
+    case 'r':
+      rounds = atoi(optarg);
+      break;
+    case 'w':
+      only_workload = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (rounds <= 0) {
+    fprintf(stderr, "ERROR: Invalid number of rounds %d\n", rounds);
+    return -1;
+  }
+  if (optind < argc) {
+    files = (const char **)(argv + optind);
+  }
+
+  for (i = 0; workloads[i].name != NULL; i++) {
+    if (only_workload != NULL &&
+        strcmp(workloads[i].name, only_workload) != 0) {
+      continue;
+    }
+    for (j = 0; files[j] != NULL; j++) {
+      if (run(&workloads[i], files[j], rounds) != 0) {
+        return -1;
+      }
+      runs++;
+    }
+  }
+  if (runs == 0) {
+    fprintf(stderr, "ERROR: No workload matches\n");
+    usage(argv[0]);
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2015 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Elem extraction benchmark for MRT updates: reads each of the bundled update
+ * dumps (or the files given on the command line) through the singlefile data
+ * interface, a number of times, and reports elems per second.
+ *
+ * Usage: bgpstream-bench-updates [-r rounds] [file...]
+ */
+
+#include "bgpstream.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_ROUNDS 5
+
+static const char *default_files[] = {
+  "routeviews.route-views.jinx.updates.1427846400.bz2",
+  "ris.rrc06.updates.1427846400.gz",
+  NULL,
+};
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// read the whole file once, returns the number of elems or -1 on error
+static int64_t run_file(const char *file)
+{
+  bgpstream_t *bs;
+  bgpstream_data_interface_id_t di_id;
+  bgpstream_data_interface_option_t *option;
+  bgpstream_record_t *rec;
+  bgpstream_elem_t *elem;
+  int64_t elem_cnt = -1;
+
+  if ((bs = bgpstream_create()) == NULL) {
+    return -1;
+  }
+  di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile");
+  bgpstream_set_data_interface(bs, di_id);
+  if ((option = bgpstream_get_data_interface_option_by_name(
+         bs, di_id, "upd-file")) == NULL ||
+      bgpstream_set_data_interface_option(bs, option, file) != 0) {
+    fprintf(stderr, "ERROR: Could not configure singlefile interface\n");
+    goto done;
+  }
+  if (bgpstream_start(bs) < 0) {
+    fprintf(stderr, "ERROR: Could not start BGPStream\n");
+    goto done;
+  }
+
+  elem_cnt = 0;
+  while (bgpstream_get_next_record(bs, &rec) > 0) {
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      elem_cnt++;
+    }
+  }
+
+done:
+  bgpstream_destroy(bs);
+  return elem_cnt;
+}
+
+int main(int argc, char **argv)
+{
+  const char **files = default_files;
+  int rounds = DEFAULT_ROUNDS;
+  int64_t elem_cnt, total;
+  double start, elapsed;
+  int opt, i, r;
+
+  while ((opt = getopt(argc, argv, "r:")) >= 0) {
+    switch (opt) {
+    case 'r':
+      rounds = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-r rounds] [file...]\n", argv[0]);
+      return -1;
+    }
+  }
+  if (rounds <= 0) {
+    fprintf(stderr, "ERROR: Invalid number of rounds %d\n", rounds);
+    return -1;
+  }
+  if (optind < argc) {
+    files = (const char **)(argv + optind);
+  }
+
+  for (i = 0; files[i] != NULL; i++) {
+    total = 0;
+    start = now();
+    for (r = 0; r < rounds; r++) {
+      if ((elem_cnt = run_file(files[i])) < 0) {
+        return -1;
+      }
+      total += elem_cnt;
+    }
+    elapsed = now() - start;
+    printf("%s: %" PRId64 " elems in %.3fs (%.0f elems/s)\n", files[i], total,
+           elapsed, elapsed > 0 ? total / elapsed : 0);
+  }
+
+  return 0;
+}
@@ -0,0 +1,756 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Utils microbenchmarks: times inserting, looking up, iterating over and
+ * clearing the items of each of the utils data structures at the sizes they
+ * hold in practice: a full IPv4 and IPv6 table (patricia tree, prefix set and
+ * IP counter), a set of 100k ASNs, a store of 10M AS paths, and the community
+ * sets of 1M elems. The items are synthetic, drawn from a PRNG with a fixed
+ * seed, so that every run (and every commit) works on the same data. Each
+ * operation on each structure is reported as one JSON object per line, with
+ * the nanoseconds per item over all rounds.
+ *
+ * At full size the benchmarks need a few GB of memory, -s scales all of the
+ * sizes (in percent). The peak RSS only grows within a process, so run a
+ * single structure (-b) when it matters.
+ *
+ * Usage: bgpstream-bench-utils [-r rounds] [-s percent] [-b structure]
+ */
+
+#include "bgpstream.h"
+#include "bgpstream_utils_as_path_int.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_ROUNDS 3
+
+#define SEED 0x5eed5eed5eed5eedULL
+
+// sizes at 100%
+#define IPV4_PFX_CNT 1000000
+#define IPV6_PFX_CNT 200000
+#define ASN_CNT 100000
+#define PATH_CNT 10000000
+#define COMM_SET_CNT 1000000
+
+// AS paths are drawn from this many ASNs, and seen by this many peers
+#define PATH_ASN_CNT 80000
+#define PATH_PEER_CNT 64
+#define PATH_MAX_LEN 10
+
+// elems have up to this many communities
+#define COMM_MAX_CNT 32
+
+// community sets are filled (and cleared) this many at a time
+#define COMM_BATCH 1024
+
+enum {
+  OP_INSERT,
+  OP_LOOKUP,
+  OP_ITERATE,
+  OP_CLEAR,
+  OP_CNT,
+};
+
+static const char *op_names[] = {"insert", "lookup", "iterate", "clear"};
+
+// time and number of items of each operation, over all rounds
+typedef struct result {
+  double seconds[OP_CNT];
+  uint64_t items[OP_CNT];
+} result_t;
+
+typedef struct structure {
+  const char *name;
+  int (*run)(result_t *res);
+} structure_t;
+
+static uint64_t rng = SEED;
+
+// results that are computed only to be thrown away
+static volatile uint64_t sink;
+
+// the data, generated once
+static bgpstream_pfx_t *pfxs = NULL;
+static int pfx_cnt = 0;
+static uint32_t *asns = NULL;
+static int asn_cnt = 0;
+static uint32_t *path_asns = NULL;
+static uint8_t *path_lens = NULL;
+static int path_cnt = 0;
+static bgpstream_community_t *comms = NULL;
+static uint8_t *comm_cnts = NULL;
+static int comm_set_cnt = 0;
+
+static double now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long peak_rss_kb()
+{
+  struct rusage ru;
+
+  if (getrusage(RUSAGE_SELF, &ru) != 0) {
+    return -1;
+  }
+  return ru.ru_maxrss;
+}
+
+// splitmix64
+static uint64_t next_rand()
+{
+  uint64_t z = (rng += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// records the time since *start as spent on op, and restarts the clock
+static void lap(result_t *res, int op, uint64_t items, double *start)
+{
+  double t = now();
+
+  res->seconds[op] += t - *start;
+  res->items[op] += items;
+  *start = t;
+}
+
+// mask lengths roughly as they are distributed in a full table
+static uint8_t ipv4_mask_len()
+{
+  int r = next_rand() % 100;
+
+  if (r < 58) {
+    return 24;
+  } else if (r < 85) {
+    return 19 + next_rand() % 5;
+  }
+  return 8 + next_rand() % 11;
+}
+
+static uint8_t ipv6_mask_len()
+{
+  int r = next_rand() % 100;
+
+  if (r < 45) {
+    return 48;
+  } else if (r < 80) {
+    return 32 + next_rand() % 16;
+  }
+  return 19 + next_rand() % 13;
+}
+
+static void gen_pfx(bgpstream_pfx_t *pfx, int ipv6)
+{
+  uint8_t *addr;
+  int i, len;
+
+  memset(pfx, 0, sizeof(*pfx));
+  if (ipv6 == 0) {
+    pfx->address.version = BGPSTREAM_ADDR_VERSION_IPV4;
+    pfx->mask_len = ipv4_mask_len();
+    addr = (uint8_t *)&pfx->bs_ipv4.address.addr;
+    len = 4;
+  } else {
+    pfx->address.version = BGPSTREAM_ADDR_VERSION_IPV6;
+    pfx->mask_len = ipv6_mask_len();
+    addr = (uint8_t *)&pfx->bs_ipv6.address.addr;
+    len = 16;
+  }
+  for (i = 0; i < len; i++) {
+    if (i * 8 + 8 <= pfx->mask_len) {
+      addr[i] = next_rand();
+    } else if (i * 8 < pfx->mask_len) {
+      addr[i] = next_rand() & (0xff << (8 - (pfx->mask_len - i * 8)));
+    }
+  }
+  if (ipv6 != 0) {
+    // global unicast
+    addr[0] = 0x20 | (addr[0] & 0x1f);
+  }
+}
+
+static int generate(int percent)
+{
+  int ipv4_cnt = (int64_t)IPV4_PFX_CNT * percent / 100;
+  int64_t i, j = 0, k, asns_total = 0;
+  int comms_total = 0;
+
+  pfx_cnt = ipv4_cnt + (int64_t)IPV6_PFX_CNT * percent / 100;
+  asn_cnt = (int64_t)ASN_CNT * percent / 100;
+  path_cnt = (int64_t)PATH_CNT * percent / 100;
+  comm_set_cnt = (int64_t)COMM_SET_CNT * percent / 100;
+
+  if ((pfxs = malloc(sizeof(*pfxs) * (pfx_cnt + 1))) == NULL ||
+      (asns = malloc(sizeof(*asns) * (asn_cnt + 1))) == NULL ||
+      (path_lens = malloc(path_cnt + 1)) == NULL ||
+      (comm_cnts = malloc(comm_set_cnt + 1)) == NULL) {
+    return -1;
+  }
+
+  // IPv4 and IPv6 prefixes interleaved, as they are in a dump
+  for (i = 0; i < pfx_cnt; i++) {
+    gen_pfx(&pfxs[i], next_rand() % pfx_cnt >= ipv4_cnt);
+  }
+
+  // ASNs spread over the 16 and 32 bit ranges
+  for (i = 0; i < asn_cnt; i++) {
+    asns[i] = next_rand() % 4 == 0 ? 1 + next_rand() % 65534
+                                   : 131072 + next_rand() % 300000;
+  }
+
+  // paths of 2 to PATH_MAX_LEN ASNs, the first one being the peer
+  for (i = 0; i < path_cnt; i++) {
+    path_lens[i] = 2 + next_rand() % (PATH_MAX_LEN - 1);
+    asns_total += path_lens[i];
+  }
+  if ((path_asns = malloc(sizeof(*path_asns) * (asns_total + 1))) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < path_cnt; i++) {
+    path_asns[j++] = 64512 + next_rand() % PATH_PEER_CNT;
+    for (k = 1; k < path_lens[i]; k++) {
+      path_asns[j++] = 1 + next_rand() % PATH_ASN_CNT;
+    }
+  }
+
+  for (i = 0; i < comm_set_cnt; i++) {
+    comm_cnts[i] = next_rand() % (COMM_MAX_CNT + 1);
+    comms_total += comm_cnts[i];
+  }
+  if ((comms = malloc(sizeof(*comms) * (comms_total + 1))) == NULL) {
+    return -1;
+  }
+  for (i = 0; i < comms_total; i++) {
+    comms[i].asn = 1 + next_rand() % 65534;
+    comms[i].value = next_rand() % 1000;
+  }
+  return 0;
+}
+
+static bgpstream_patricia_walk_cb_result_t
+count_node(const bgpstream_patricia_tree_t *pt,
+           const bgpstream_patricia_node_t *node, void *data)
+{
+  (*(uint64_t *)data)++;
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+static int query_patricia(bgpstream_patricia_tree_t *pt, result_t *res,
+                          double *start)
+{
+  uint64_t cnt, walked = 0;
+  int i;
+
+  for (i = 0; i < pfx_cnt; i++) {
+    if (bgpstream_patricia_tree_search_exact(pt, &pfxs[i]) == NULL) {
+      fprintf(stderr, "ERROR: Prefix missing from the patricia tree\n");
+      return -1;
+    }
+  }
+  lap(res, OP_LOOKUP, pfx_cnt, start);
+
+  bgpstream_patricia_tree_walk(pt, count_node, &walked);
+  lap(res, OP_ITERATE, walked, start);
+
+  cnt = bgpstream_patricia_prefix_count(pt, BGPSTREAM_ADDR_VERSION_IPV4) +
+        bgpstream_patricia_prefix_count(pt, BGPSTREAM_ADDR_VERSION_IPV6);
+  if (walked != cnt) {
+    fprintf(stderr, "ERROR: Walked %" PRIu64 " of %" PRIu64 " prefixes\n",
+            walked, cnt);
+    return -1;
+  }
+
+  *start = now();
+  bgpstream_patricia_tree_clear(pt);
+  lap(res, OP_CLEAR, cnt, start);
+  return 0;
+}
+
+// each run builds a structure from all of the items, looks every item up
+// again, iterates over the structure, and clears it
+
+static int run_patricia(result_t *res)
+{
+  bgpstream_patricia_tree_t *pt;
+  double start;
+  int i, rc = -1;
+
+  if ((pt = bgpstream_patricia_tree_create(NULL)) == NULL) {
+    return -1;
+  }
+  start = now();
+  for (i = 0; i < pfx_cnt; i++) {
+    if (bgpstream_patricia_tree_insert(pt, &pfxs[i]) == NULL) {
+      goto done;
+    }
+  }
+  lap(res, OP_INSERT, pfx_cnt, &start);
+  rc = query_patricia(pt, res, &start);
+
+done:
+  bgpstream_patricia_tree_destroy(pt);
+  return rc;
+}
+
+static int run_patricia_bulk(result_t *res)
+{
+  bgpstream_patricia_tree_t *pt;
+  double start;
+  int rc = -1;
+
+  if ((pt = bgpstream_patricia_tree_create(NULL)) == NULL) {
+    return -1;
+  }
+  start = now();
+  if (bgpstream_patricia_tree_insert_bulk(pt, pfxs, pfx_cnt, NULL, 0) != 0) {
+    goto done;
+  }
+  lap(res, OP_INSERT, pfx_cnt, &start);
+  rc = query_patricia(pt, res, &start);
+
+done:
+  bgpstream_patricia_tree_destroy(pt);
+  return rc;
+}
+
+static void count_pfx(bgpstream_pfx_t *pfx, void *data)
+{
+  (*(uint64_t *)data)++;
+}
+
+static int run_pfx_set(result_t *res)
+{
+  bgpstream_pfx_set_t *set;
+  uint64_t cnt = 0;
+  double start;
+  int i, rc = -1;
+
+  if ((set = bgpstream_pfx_set_create()) == NULL) {
+    return -1;
+  }
+  start = now();
+  for (i = 0; i < pfx_cnt; i++) {
+    if (bgpstream_pfx_set_insert(set, &pfxs[i]) < 0) {
+      goto done;
+    }
+  }
+  lap(res, OP_INSERT, pfx_cnt, &start);
+
+  for (i = 0; i < pfx_cnt; i++) {
+    if (bgpstream_pfx_set_exists(set, &pfxs[i]) != 1) {
+      fprintf(stderr, "ERROR: Prefix missing from the prefix set\n");
+      goto done;
+    }
+  }
+  lap(res, OP_LOOKUP, pfx_cnt, &start);
+
+  if (bgpstream_pfx_set_iterate(set, count_pfx, &cnt) != 0) {
+    goto done;
+  }
+  lap(res, OP_ITERATE, cnt, &start);
+  if (cnt != (uint64_t)bgpstream_pfx_set_size(set)) {
+    fprintf(stderr, "ERROR: Iterated over %" PRIu64 " of %d prefixes\n", cnt,
+            bgpstream_pfx_set_size(set));
+    goto done;
+  }
+
+  start = now();
+  bgpstream_pfx_set_clear(set);
+  lap(res, OP_CLEAR, cnt, &start);
+  rc = 0;
+
+done:
+  bgpstream_pfx_set_destroy(set);
+  return rc;
+}
+
+static int run_id_set(result_t *res)
+{
+  bgpstream_id_set_t *set;
+  uint64_t cnt = 0;
+  double start;
+  int i, rc = -1;
+
+  if ((set = bgpstream_id_set_create()) == NULL) {
+    return -1;
+  }
+  start = now();
+  for (i = 0; i < asn_cnt; i++) {
+    if (bgpstream_id_set_insert(set, asns[i]) < 0) {
+      goto done;
+    }
+  }
+  lap(res, OP_INSERT, asn_cnt, &start);
+
+  for (i = 0; i < asn_cnt; i++) {
+    if (bgpstream_id_set_exists(set, asns[i]) != 1) {
+      fprintf(stderr, "ERROR: ASN missing from the ID set\n");
+      goto done;
+    }
+  }
+  lap(res, OP_LOOKUP, asn_cnt, &start);
+
+  bgpstream_id_set_rewind(set);
+  while (bgpstream_id_set_next(set) != NULL) {
+    cnt++;
+  }
+  lap(res, OP_ITERATE, cnt, &start);
+  if (cnt != (uint64_t)bgpstream_id_set_size(set)) {
+    fprintf(stderr, "ERROR: Iterated over %" PRIu64 " of %d ASNs\n", cnt,
+            bgpstream_id_set_size(set));
+    goto done;
+  }
+
+  start = now();
+  bgpstream_id_set_clear(set);
+  lap(res, OP_CLEAR, cnt, &start);
+  rc = 0;
+
+done:
+  bgpstream_id_set_destroy(set);
+  return rc;
+}
+
+// looks every path up in the store, adding the ones that are not there yet
+static int get_path_ids(bgpstream_as_path_store_t *store,
+                        bgpstream_as_path_t *path)
+{
+  bgpstream_as_path_store_path_id_t id;
+  uint32_t *p = path_asns;
+  int i;
+
+  for (i = 0; i < path_cnt; i++) {
+    bgpstream_as_path_clear(path);
+    if (bgpstream_as_path_append(path, BGPSTREAM_AS_PATH_SEG_ASN, p,
+                                 path_lens[i]) != 0 ||
+        bgpstream_as_path_store_get_path_id(store, path, p[0], &id) != 0) {
+      return -1;
+    }
+    p += path_lens[i];
+  }
+  return 0;
+}
+
+static int run_as_path_store(result_t *res)
+{
+  bgpstream_as_path_store_t *store = NULL;
+  bgpstream_as_path_store_iter_t *iter = NULL;
+  bgpstream_as_path_t *path;
+  uint64_t cnt = 0;
+  uint32_t size;
+  double start;
+  int rc = -1;
+
+  if ((path = bgpstream_as_path_create()) == NULL) {
+    return -1;
+  }
+  if ((store = bgpstream_as_path_store_create()) == NULL) {
+    goto done;
+  }
+  start = now();
+  if (get_path_ids(store, path) != 0) {
+    goto done;
+  }
+  lap(res, OP_INSERT, path_cnt, &start);
+  size = bgpstream_as_path_store_get_size(store);
+
+  if (get_path_ids(store, path) != 0) {
+    goto done;
+  }
+  lap(res, OP_LOOKUP, path_cnt, &start);
+  if (bgpstream_as_path_store_get_size(store) != size) {
+    fprintf(stderr, "ERROR: Path missing from the AS path store\n");
+    goto done;
+  }
+
+  if ((iter = bgpstream_as_path_store_iter_create(store)) == NULL) {
+    goto done;
+  }
+  start = now();
+  while (bgpstream_as_path_store_iter_next(iter, NULL) != NULL) {
+    cnt++;
+  }
+  lap(res, OP_ITERATE, cnt, &start);
+  if (cnt != size) {
+    fprintf(stderr, "ERROR: Iterated over %" PRIu64 " of %" PRIu32 " paths\n",
+            cnt, size);
+    goto done;
+  }
+  bgpstream_as_path_store_iter_destroy(iter);
+  iter = NULL;
+
+  // stores can not be cleared, only destroyed
+  start = now();
+  bgpstream_as_path_store_destroy(store);
+  store = NULL;
+  lap(res, OP_CLEAR, cnt, &start);
+  rc = 0;
+
+done:
+  bgpstream_as_path_store_iter_destroy(iter);
+  bgpstream_as_path_store_destroy(store);
+  bgpstream_as_path_destroy(path);
+  return rc;
+}
+
+static int run_community_set(result_t *res)
+{
+  bgpstream_community_set_t *sets[COMM_BATCH];
+  bgpstream_community_t *batch_comms, *c;
+  uint64_t cnt, sum = 0;
+  double start;
+  int first, last, i, j, rc = -1;
+
+  memset(sets, 0, sizeof(sets));
+  for (i = 0; i < COMM_BATCH; i++) {
+    if ((sets[i] = bgpstream_community_set_create()) == NULL) {
+      goto done;
+    }
+  }
+
+  // the sets are reused from one batch of elems to the next, as the
+  // communities of elems are
+  batch_comms = comms;
+  for (first = 0; first < comm_set_cnt; first = last) {
+    last = first + COMM_BATCH < comm_set_cnt ? first + COMM_BATCH
+                                             : comm_set_cnt;
+    start = now();
+    c = batch_comms;
+    for (i = first, cnt = 0; i < last; i++) {
+      for (j = 0; j < comm_cnts[i]; j++, c++) {
+        if (bgpstream_community_set_insert(sets[i - first], c) != 0) {
+          goto done;
+        }
+      }
+      cnt += comm_cnts[i];
+    }
+    lap(res, OP_INSERT, cnt, &start);
+
+    c = batch_comms;
+    for (i = first; i < last; i++) {
+      for (j = 0; j < comm_cnts[i]; j++, c++) {
+        if (bgpstream_community_set_exists(sets[i - first], c) != 1) {
+          fprintf(stderr, "ERROR: Community missing from the community set\n");
+          goto done;
+        }
+      }
+    }
+    lap(res, OP_LOOKUP, cnt, &start);
+
+    for (i = first; i < last; i++) {
+      for (j = 0; j < bgpstream_community_set_size(sets[i - first]); j++) {
+        sum += bgpstream_community_set_get(sets[i - first], j)->ui32;
+      }
+    }
+    lap(res, OP_ITERATE, cnt, &start);
+
+    for (i = first; i < last; i++) {
+      bgpstream_community_set_clear(sets[i - first]);
+    }
+    lap(res, OP_CLEAR, cnt, &start);
+    batch_comms = c;
+  }
+  // so that the iteration can not be optimized away
+  sink = sum;
+  rc = 0;
+
+done:
+  for (i = 0; i < COMM_BATCH && sets[i] != NULL; i++) {
+    bgpstream_community_set_destroy(sets[i]);
+  }
+  return rc;
+}
+
+static int run_ip_counter(result_t *res)
+{
+  bgpstream_ip_counter_t *ipc;
+  uint8_t more_specific;
+  double start;
+  int i, rc = -1;
+
+  if ((ipc = bgpstream_ip_counter_create()) == NULL) {
+    return -1;
+  }
+  start = now();
+  for (i = 0; i < pfx_cnt; i++) {
+    if (bgpstream_ip_counter_add(ipc, &pfxs[i]) != 0) {
+      goto done;
+    }
+  }
+  lap(res, OP_INSERT, pfx_cnt, &start);
+
+  // counting merges the intervals added so far, so that lookups do not
+  if (bgpstream_ip_counter_get_ipcount(ipc, BGPSTREAM_ADDR_VERSION_IPV4) ==
+        0 ||
+      bgpstream_ip_counter_get_ipcount(ipc, BGPSTREAM_ADDR_VERSION_IPV6) ==
+        0) {
+    fprintf(stderr, "ERROR: The IP counter is empty\n");
+    goto done;
+  }
+  lap(res, OP_ITERATE, 2, &start);
+
+  for (i = 0; i < pfx_cnt; i++) {
+    if (bgpstream_ip_counter_is_overlapping(ipc, &pfxs[i], &more_specific) ==
+        0) {
+      fprintf(stderr, "ERROR: Prefix missing from the IP counter\n");
+      goto done;
+    }
+  }
+  lap(res, OP_LOOKUP, pfx_cnt, &start);
+
+  bgpstream_ip_counter_clear(ipc);
+  lap(res, OP_CLEAR, pfx_cnt, &start);
+  rc = 0;
+
+done:
+  bgpstream_ip_counter_destroy(ipc);
+  return rc;
+}
+
+static const structure_t structures[] = {
+  {"patricia", run_patricia},
+  {"patricia-bulk", run_patricia_bulk},
+  {"pfx-set", run_pfx_set},
+  {"id-set", run_id_set},
+  {"as-path-store", run_as_path_store},
+  {"community-set", run_community_set},
+  {"ip-counter", run_ip_counter},
+  {NULL, NULL},
+};
+
+static int run(const structure_t *s, int rounds, int percent)
+{
+  result_t res;
+  int r, op;
+
+  memset(&res, 0, sizeof(res));
+  for (r = 0; r < rounds; r++) {
+    if (s->run(&res) != 0) {
+      fprintf(stderr, "ERROR: Could not run the %s benchmark\n", s->name);
+      return -1;
+    }
+  }
+
+  for (op = 0; op < OP_CNT; op++) {
+    printf("{\"structure\":\"%s\",\"op\":\"%s\",\"scale\":%d,\"rounds\":%d,"
+           "\"items\":%" PRIu64 ",\"seconds\":%.6f,\"ns_per_item\":%.1f,"
+           "\"peak_rss_kb\":%ld}\n",
+           s->name, op_names[op], percent, rounds, res.items[op],
+           res.seconds[op],
+           res.items[op] > 0 ? res.seconds[op] * 1e9 / res.items[op] : 0,
+           peak_rss_kb());
+  }
+  fflush(stdout);
+  return 0;
+}
+
+static void usage(const char *name)
+{
+  int i;
+
+  fprintf(stderr,
+          "Usage: %s [-r rounds] [-s percent] [-b structure]\n"
+          "Structures:",
+          name);
+  for (i = 0; structures[i].name != NULL; i++) {
+    fprintf(stderr, " %s", structures[i].name);
+  }
+  fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv)
+{
+  const char *only_structure = NULL;
+  int rounds = DEFAULT_ROUNDS;
+  int percent = 100;
+  int opt, i, runs = 0, rc = -1;
+
+  while ((opt = getopt(argc, argv, "b:r:s:")) >= 0) {
+    switch (opt) {
+    case 'b':
+      only_structure = optarg;
+      break;
+    case 'r':
+      rounds = atoi(optarg);
+      break;
+    case 's':
+      percent = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return -1;
+    }
+  }
+  if (rounds <= 0) {
+    fprintf(stderr, "ERROR: Invalid number of rounds %d\n", rounds);
+    return -1;
+  }
+  if (percent <= 0 || percent > 1000) {
+    fprintf(stderr, "ERROR: Invalid scale %d%%\n", percent);
+    return -1;
+  }
+
+  if (generate(percent) != 0) {
+    fprintf(stderr, "ERROR: Could not generate the benchmark data\n");
+    goto done;
+  }
+
+  for (i = 0; structures[i].name != NULL; i++) {
+    if (only_structure != NULL &&
+        strcmp(structures[i].name, only_structure) != 0) {
+      continue;
+    }
+    if (run(&structures[i], rounds, percent) != 0) {
+      goto done;
+    }
+    runs++;
+  }
+  if (runs == 0) {
+    fprintf(stderr, "ERROR: No structure matches\n");
+    usage(argv[0]);
+    goto done;
+  }
+  rc = 0;
+
+done:
+  free(pfxs);
+  free(asns);
+  free(path_asns);
+  free(path_lens);
+  free(comms);
+  free(comm_cnts);
+  return rc;
+}
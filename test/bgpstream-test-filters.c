@@ -29,7 +29,9 @@
 #include "utils.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <wandio.h>
 
 #ifdef WITH_DATA_INTERFACE_BROKER
@@ -110,8 +112,39 @@ static void process_records()
   CHECK("elem total count", !expected_results[counter]);
 }
 
+// write a temporary filter file, whose path is written to the template
+static int write_filter_file(char *path, const void *data, size_t len)
+{
+  int fd;
+
+  if ((fd = mkstemp(path)) == -1) {
+    return -1;
+  }
+  if (write(fd, data, len) != (ssize_t)len) {
+    close(fd);
+    return -1;
+  }
+  return close(fd);
+}
+
 static int test_bgpstream_filters()
 {
+  static const char peers[] = "# RIS and RouteViews peers\n"
+                              "25152\n"
+                              "\n"
+                              "AS37105 # jinx\n";
+  static const char comms[] = "2914:*\n"
+                              "*:300\n";
+  // 2620:110:9004::/40, 154.73.128.0/17 and 202.70.88.0/21
+  static const char pfxs[] = BGPSTREAM_FILTER_FILE_MAGIC
+    "\x06\x28\x26\x20\x01\x10\x90\x04\x00\x00"
+    "\x00\x00\x00\x00\x00\x00\x00\x00"
+    "\x04\x11\x9a\x49\x80\x00"
+    "\x04\x15\xca\x46\x58\x00";
+  char peers_path[] = "/tmp/bgpstream-test-filters-XXXXXX";
+  char comms_path[] = "/tmp/bgpstream-test-filters-XXXXXX";
+  char pfxs_path[] = "/tmp/bgpstream-test-filters-XXXXXX";
+
   SETUP;
 
   CHECK_SET_INTERFACE(broker);
@@ -155,6 +188,41 @@ static int test_bgpstream_filters()
   process_records();
 
   TEARDOWN;
+
+
+  CHECK("write filter files",
+        write_filter_file(peers_path, peers, sizeof(peers) - 1) == 0 &&
+          write_filter_file(comms_path, comms, sizeof(comms) - 1) == 0 &&
+          write_filter_file(pfxs_path, pfxs, sizeof(pfxs) - 1) == 0);
+
+  SETUP;
+
+  CHECK_SET_INTERFACE(broker);
+
+  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_COLLECTOR, "rrc06");
+  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_COLLECTOR, "route-views.jinx");
+
+  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_RECORD_TYPE, "updates");
+
+  bgpstream_add_interval_filter(bs, 1427846847, 1427846874);
+
+  CHECK("peer filter file",
+        bgpstream_add_filter_file(bs, BGPSTREAM_FILTER_TYPE_ELEM_PEER_ASN,
+                                  peers_path));
+  CHECK("prefix filter file",
+        bgpstream_add_filter_file(bs, BGPSTREAM_FILTER_TYPE_ELEM_PREFIX,
+                                  pfxs_path));
+  CHECK("community filter file",
+        bgpstream_add_filter_file(bs, BGPSTREAM_FILTER_TYPE_ELEM_COMMUNITY,
+                                  comms_path));
+
+  process_records();
+
+  TEARDOWN;
+
+  unlink(peers_path);
+  unlink(comms_path);
+  unlink(pfxs_path);
   return 0;
 }
 
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+#include "bgpstream_utils_agg.h"
+#include "bgpstream_utils_as_path_int.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PEER "192.0.2.1"
+#define PEER_ASN 64500
+
+#define HEAVY_PFX "10.0.0.0/8"
+#define HEAVY_CNT 50
+#define DISTINCT_CNT 1000
+
+static bgpstream_elem_t *elem;
+static bgpstream_record_t record;
+
+// set elem to an announcement of the given prefix
+static bgpstream_elem_t *announce(const char *prefix, uint32_t origin)
+{
+  uint32_t asns[2] = {PEER_ASN, origin};
+
+  bgpstream_elem_clear(elem);
+  elem->type = BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT;
+  bgpstream_str2addr(PEER, &elem->peer_ip);
+  elem->peer_asn = PEER_ASN;
+  bgpstream_str2pfx(prefix, &elem->prefix);
+  bgpstream_as_path_append(elem->as_path, BGPSTREAM_AS_PATH_SEG_ASN, asns, 2);
+  return elem;
+}
+
+// announce the n-th of the 10.x.y.0/24 prefixes
+static bgpstream_elem_t *announce_nth(int n)
+{
+  char buf[64];
+
+  snprintf(buf, sizeof(buf), "10.%d.%d.0/24", n / 256, n % 256);
+  return announce(buf, 64600 + n % 10);
+}
+
+static bgpstream_agg_key_t *pfx_key(const char *prefix)
+{
+  static bgpstream_agg_key_t key;
+
+  memset(&key, 0, sizeof(key));
+  key.type = BGPSTREAM_AGG_KEY_PFX;
+  bgpstream_str2pfx(prefix, &key.pfx);
+  return &key;
+}
+
+static int test_agg_states()
+{
+  bgpstream_agg_state_t *state, *other, *approx;
+  bgpstream_agg_count_t top[2];
+  bgpstream_agg_key_t key;
+  uint64_t cnt;
+  int i;
+
+  CHECK("elem create", (elem = bgpstream_elem_create()) != NULL);
+
+  CHECK("exact state create",
+        (state = bgpstream_agg_state_create(BGPSTREAM_AGG_KEY_PFX, 0)) !=
+            NULL &&
+          (other = bgpstream_agg_state_create(BGPSTREAM_AGG_KEY_PFX, 0)) !=
+            NULL);
+  for (i = 0; i < 3; i++) {
+    bgpstream_agg_state_add_elem(state, announce(HEAVY_PFX, 64600));
+  }
+  bgpstream_agg_state_add_elem(state, announce("11.0.0.0/8", 64601));
+  elem->type = BGPSTREAM_ELEM_TYPE_WITHDRAWAL;
+  bgpstream_agg_state_add_elem(state, elem);
+  CHECK("exact counts",
+        bgpstream_agg_state_get_elem_cnt(state) == 4 &&
+          bgpstream_agg_state_get_count(state, pfx_key(HEAVY_PFX)) == 3 &&
+          bgpstream_agg_state_get_count(state, pfx_key("12.0.0.0/8")) == 0 &&
+          bgpstream_agg_state_get_pfx_cnt(state) == 2 &&
+          bgpstream_agg_state_get_origin_cnt(state) == 2);
+  CHECK("exact top",
+        bgpstream_agg_state_get_top(state, top, 2) == 2 &&
+          top[0].count == 3 && top[1].count == 1 &&
+          bgpstream_pfx_equal(&top[0].key.pfx, &pfx_key(HEAVY_PFX)->pfx));
+
+  bgpstream_agg_state_add_elem(other, announce("11.0.0.0/8", 64601));
+  bgpstream_agg_state_add_elem(other, announce("12.0.0.0/8", 64602));
+  CHECK("exact merge",
+        bgpstream_agg_state_merge(state, other) == 0 &&
+          bgpstream_agg_state_get_elem_cnt(state) == 6 &&
+          bgpstream_agg_state_get_count(state, pfx_key("11.0.0.0/8")) == 2 &&
+          bgpstream_agg_state_get_pfx_cnt(state) == 3 &&
+          bgpstream_agg_state_get_origin_cnt(state) == 3);
+  bgpstream_agg_state_destroy(other);
+
+  CHECK("approximate state create",
+        (approx = bgpstream_agg_state_create(BGPSTREAM_AGG_KEY_PFX, 64)) !=
+            NULL &&
+          (other = bgpstream_agg_state_create(BGPSTREAM_AGG_KEY_PFX, 64)) !=
+            NULL);
+  CHECK("merge needs the same configuration",
+        bgpstream_agg_state_merge(state, approx) != 0);
+  bgpstream_agg_state_destroy(state);
+
+  // half of the prefixes in each state, and the heavy hitter in both
+  for (i = 0; i < DISTINCT_CNT; i++) {
+    bgpstream_agg_state_add_elem(i % 2 == 0 ? approx : other,
+                                 announce_nth(i));
+  }
+  for (i = 0; i < HEAVY_CNT; i++) {
+    bgpstream_agg_state_add_elem(i % 2 == 0 ? approx : other,
+                                 announce(HEAVY_PFX, 64600));
+  }
+  CHECK("approximate merge", bgpstream_agg_state_merge(approx, other) == 0);
+  cnt = bgpstream_agg_state_get_pfx_cnt(approx);
+  CHECK("approximate distinct prefixes",
+        cnt > (DISTINCT_CNT + 1) * 95 / 100 &&
+          cnt < (DISTINCT_CNT + 1) * 105 / 100 &&
+          bgpstream_agg_state_get_origin_cnt(approx) == 10);
+  CHECK("approximate top",
+        bgpstream_agg_state_get_top(approx, top, 1) == 1 &&
+          top[0].count >= HEAVY_CNT && top[0].count < HEAVY_CNT * 2 &&
+          bgpstream_pfx_equal(&top[0].key.pfx, &pfx_key(HEAVY_PFX)->pfx));
+  key = top[0].key;
+  CHECK("approximate count",
+        bgpstream_agg_state_get_count(approx, &key) == top[0].count &&
+          bgpstream_agg_state_get_elem_cnt(approx) ==
+            DISTINCT_CNT + HEAVY_CNT);
+
+  bgpstream_agg_state_destroy(approx);
+  bgpstream_agg_state_destroy(other);
+  bgpstream_elem_destroy(elem);
+  return 0;
+}
+
+typedef struct windows {
+  uint32_t start[8];
+  uint32_t end[8];
+  uint64_t cnt[8];
+  int windows_cnt;
+} windows_t;
+
+static int save_window(uint32_t start, uint32_t end,
+                       bgpstream_agg_state_t *state, void *user)
+{
+  windows_t *w = user;
+
+  if (w->windows_cnt == 8) {
+    return -1;
+  }
+  w->start[w->windows_cnt] = start;
+  w->end[w->windows_cnt] = end;
+  w->cnt[w->windows_cnt++] = bgpstream_agg_state_get_elem_cnt(state);
+  return 0;
+}
+
+static void add_at(bgpstream_agg_t *agg, uint32_t time)
+{
+  record.time_sec = time;
+  bgpstream_agg_add_elem(agg, &record, announce(HEAVY_PFX, 64600));
+}
+
+static int test_agg_windows()
+{
+  bgpstream_agg_t *agg;
+  windows_t w;
+
+  CHECK("elem create", (elem = bgpstream_elem_create()) != NULL);
+  CHECK("invalid window",
+        bgpstream_agg_create(BGPSTREAM_AGG_KEY_PFX, 0, 90, 60, save_window,
+                             &w) == NULL);
+
+  memset(&w, 0, sizeof(w));
+  CHECK("tumbling create",
+        (agg = bgpstream_agg_create(BGPSTREAM_AGG_KEY_ORIGIN, 0, 60, 60,
+                                    save_window, &w)) != NULL);
+  add_at(agg, 1000);
+  add_at(agg, 1010);
+  add_at(agg, 1090);
+  add_at(agg, 1050); // too late
+  add_at(agg, 1500);
+  CHECK("tumbling windows",
+        w.windows_cnt == 2 && w.start[0] == 960 && w.end[0] == 1020 &&
+          w.cnt[0] == 2 && w.start[1] == 1080 && w.end[1] == 1140 &&
+          w.cnt[1] == 1);
+  CHECK("tumbling flush",
+        bgpstream_agg_flush(agg) == 0 && w.windows_cnt == 3 &&
+          w.start[2] == 1500 && w.cnt[2] == 1);
+  bgpstream_agg_destroy(agg);
+
+  memset(&w, 0, sizeof(w));
+  CHECK("sliding create",
+        (agg = bgpstream_agg_create(BGPSTREAM_AGG_KEY_PEER, 0, 120, 60,
+                                    save_window, &w)) != NULL);
+  add_at(agg, 1000);
+  add_at(agg, 1030);
+  add_at(agg, 1090);
+  add_at(agg, 1500);
+  // each slide is in two windows
+  CHECK("sliding windows",
+        w.windows_cnt == 4 && w.start[0] == 900 && w.cnt[0] == 1 &&
+          w.start[1] == 960 && w.end[1] == 1080 && w.cnt[1] == 2 &&
+          w.start[2] == 1020 && w.cnt[2] == 2 && w.start[3] == 1080 &&
+          w.cnt[3] == 1);
+  CHECK("sliding flush",
+        bgpstream_agg_flush(agg) == 0 && w.windows_cnt == 5 &&
+          w.start[4] == 1440 && w.end[4] == 1560 && w.cnt[4] == 1);
+  bgpstream_agg_destroy(agg);
+
+  bgpstream_elem_destroy(elem);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("aggregation states", test_agg_states() == 0);
+  CHECK_SECTION("aggregation windows", test_agg_windows() == 0);
+  ENDTEST;
+  return 0;
+}
@@ -26,11 +26,117 @@
 
 #include "bgpstream_test.h"
 #include "bgpstream_utils_as_path_int.h"
+#include "bgpstream_utils_as_path_match.h"
+#include "bgpstream_utils_as_path_store.h"
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// more paths than the old 16-bit per-origin limit
+#define STORE_TEST_PATH_CNT 70000
+
+// threads adding the same paths to a concurrent store, in different orders
+#define CONCURRENT_TEST_THREADS 4
+#define CONCURRENT_TEST_PATH_CNT 20000
+
+#define STORE_TEST_FILE "bgpstream-test-path-store.bin"
+
+typedef struct {
+  bgpstream_as_path_store_t *store;
+  int thread;
+  bgpstream_as_path_store_path_id_t ids[CONCURRENT_TEST_PATH_CNT];
+  int failed;
+} concurrent_test_t;
+
+static void concurrent_path(bgpstream_as_path_t *path, uint32_t i)
+{
+  // spread the paths over many origins, and so over the shards
+  uint32_t asns[] = {174, 100000 + i, 200000 + (i & 0x1ff)};
+  bgpstream_as_path_clear(path);
+  bgpstream_as_path_append(path, BGPSTREAM_AS_PATH_SEG_ASN, asns, 3);
+}
+
+static void *concurrent_add(void *user)
+{
+  concurrent_test_t *t = user;
+  bgpstream_as_path_t *path = bgpstream_as_path_create();
+  uint32_t i, j;
+
+  for (j = 0; j < CONCURRENT_TEST_PATH_CNT; j++) {
+    i = (t->thread & 1) != 0 ? CONCURRENT_TEST_PATH_CNT - 1 - j : j;
+    concurrent_path(path, i);
+    if (bgpstream_as_path_store_get_path_id(t->store, path, 0, &t->ids[i]) !=
+        0) {
+      t->failed++;
+    }
+  }
+  bgpstream_as_path_destroy(path);
+  return NULL;
+}
+
+static int test_concurrent_store()
+{
+  static concurrent_test_t tests[CONCURRENT_TEST_THREADS];
+  pthread_t threads[CONCURRENT_TEST_THREADS];
+  bgpstream_as_path_store_t *store;
+  bgpstream_as_path_store_iter_t *iter;
+  bgpstream_as_path_store_path_id_t id;
+  bgpstream_as_path_store_path_t *spath;
+  bgpstream_as_path_t *path = bgpstream_as_path_create();
+  int t, i, failed = 0, bad_ids = 0, bad_paths = 0, iterated = 0;
+
+  CHECK("concurrent store create",
+        (store = bgpstream_as_path_store_create_concurrent()) != NULL);
+  for (t = 0; t < CONCURRENT_TEST_THREADS; t++) {
+    tests[t].store = store;
+    tests[t].thread = t;
+    pthread_create(&threads[t], NULL, concurrent_add, &tests[t]);
+  }
+  for (t = 0; t < CONCURRENT_TEST_THREADS; t++) {
+    pthread_join(threads[t], NULL);
+    failed += tests[t].failed;
+  }
+  CHECK("concurrent store add", failed == 0);
+
+  // every thread got the same ID for each path
+  for (i = 0; i < CONCURRENT_TEST_PATH_CNT; i++) {
+    for (t = 1; t < CONCURRENT_TEST_THREADS; t++) {
+      if (memcmp(&tests[t].ids[i], &tests[0].ids[i], sizeof(id)) != 0) {
+        bad_ids++;
+      }
+    }
+    concurrent_path(path, i);
+    spath = bgpstream_as_path_store_get_store_path(store, tests[0].ids[i]);
+    if (spath == NULL ||
+        !bgpstream_as_path_equal(
+          bgpstream_as_path_store_path_get_int_path(spath), path)) {
+      bad_paths++;
+    }
+  }
+  CHECK("concurrent store IDs", bad_ids == 0);
+  CHECK("concurrent store paths", bad_paths == 0);
+  CHECK("concurrent store size",
+        bgpstream_as_path_store_get_size(store) == CONCURRENT_TEST_PATH_CNT);
+
+  CHECK("concurrent store iter create",
+        (iter = bgpstream_as_path_store_iter_create(store)) != NULL);
+  bad_paths = 0;
+  while ((spath = bgpstream_as_path_store_iter_next(iter, &id)) != NULL) {
+    iterated++;
+    if (bgpstream_as_path_store_get_store_path(store, id) != spath) {
+      bad_paths++;
+    }
+  }
+  CHECK("concurrent store iter",
+        iterated == CONCURRENT_TEST_PATH_CNT && bad_paths == 0);
+  bgpstream_as_path_store_iter_destroy(iter);
+
+  bgpstream_as_path_store_destroy(store);
+  bgpstream_as_path_destroy(path);
+  return 0;
+}
 
 static struct {
   bgpstream_as_path_seg_type_t type;
@@ -46,6 +152,32 @@ static struct {
   { 0,                                0, { 0 },              NULL },
 };
 
+// expressions matched on the ASNs of "174 3356 64512 64513"
+static struct {
+  const char *expr;
+  int native;
+  int match;
+} testexprs[] = {
+  { "_3356_",              1, 1 },
+  { "_335_",               1, 0 },
+  { "_64513$",             1, 1 },
+  { "_64512$",             1, 0 },
+  { "^174_",               1, 1 },
+  { "^_174_3356_",         1, 1 },
+  { "^3356_",              1, 0 },
+  { "_3356_64512_",        1, 1 },
+  { "_174_64512_",         1, 0 },
+  { "_(701|3356)_",        1, 1 },
+  { "_6451[0-2]$",         1, 0 },
+  { "_645[0-9]+_$",        1, 1 },
+  { "^[0-9]+_[0-9]+_",     1, 1 },
+  { "^174_3356_64512_64513$", 1, 1 },
+  { "3356",                0, 0 },
+  { "_3356_.*_64513_",     0, 0 },
+  { "_1*_",                0, 0 },
+  { NULL,                  0, 0 },
+};
+
 int main(int argc, char *argv[])
 {
   int test_cnt = 0;
@@ -84,6 +216,136 @@ int main(int argc, char *argv[])
 
   CHECK("as_path len", bgpstream_as_path_get_len(path1) == test_cnt);
 
+  // a path that borrows its data gets a copy of its own before growing
+  uint8_t *data1, *data2;
+  uint16_t len1 = bgpstream_as_path_get_data(path1, &data1);
+  uint32_t extra_asn = 65000;
+  bgpstream_as_path_populate_from_data_zc(path2, data1, len1);
+  CHECK("as_path zero-copy equal", bgpstream_as_path_equal(path1, path2));
+  CHECK("as_path append to zero-copy",
+        bgpstream_as_path_append(path2, BGPSTREAM_AS_PATH_SEG_ASN, &extra_asn,
+                                 1) == 0 &&
+          bgpstream_as_path_get_data(path2, &data2) == len1 + 5 &&
+          data2 != data1 && memcmp(data1, data2, len1) == 0 &&
+          bgpstream_as_path_get_len(path1) == test_cnt);
+
+  uint32_t asns[BGPSTREAM_AS_PATH_MATCH_MAX_ASNS];
+  uint32_t path_asns[] = { 174, 3356, 64512, 64513 };
+  bgpstream_as_path_match_t *match;
+  int asns_cnt;
+
+  CHECK("as_path match (sets need a regex)",
+        bgpstream_as_path_match_get_asns(path1, asns,
+                                         BGPSTREAM_AS_PATH_MATCH_MAX_ASNS) < 0);
+  bgpstream_as_path_clear(path2);
+  CHECK("as_path append ASNs",
+        bgpstream_as_path_append(path2, BGPSTREAM_AS_PATH_SEG_ASN, path_asns,
+                                 4) == 0);
+  asns_cnt = bgpstream_as_path_match_get_asns(path2, asns,
+                                              BGPSTREAM_AS_PATH_MATCH_MAX_ASNS);
+  CHECK("as_path match get ASNs", asns_cnt == 4 && asns[3] == 64513);
+  for (int i = 0; testexprs[i].expr != NULL; i++) {
+    match = bgpstream_as_path_match_create(testexprs[i].expr);
+    CHECK("as_path match create", (match != NULL) == testexprs[i].native);
+    if (match != NULL) {
+      CHECK("as_path match exec",
+            bgpstream_as_path_match_exec(match, asns, asns_cnt) ==
+              testexprs[i].match);
+    }
+    bgpstream_as_path_match_destroy(match);
+  }
+
+  // prepending is collapsed, but an ASN that comes back later is a loop
+  uint32_t prepended[] = { 174, 3356, 3356, 3356, 64512 };
+  uint32_t looped = 3356;
+  bgpstream_as_path_t *path3 = bgpstream_as_path_create();
+  bgpstream_as_path_clear(path2);
+  bgpstream_as_path_append(path2, BGPSTREAM_AS_PATH_SEG_ASN, prepended, 5);
+  CHECK("as_path unique len", bgpstream_as_path_get_unique_len(path2) == 3);
+  CHECK("as_path copy collapsed",
+        path3 != NULL && bgpstream_as_path_copy_collapsed(path3, path2) == 0 &&
+          bgpstream_as_path_get_len(path3) == 3 &&
+          bgpstream_as_path_get_unique_len(path3) == 3);
+  CHECK("as_path contains ASN",
+        bgpstream_as_path_contains_asn(path2, 64512) == 1 &&
+          bgpstream_as_path_contains_asn(path2, 701) == 0 &&
+          bgpstream_as_path_contains_asn(path1, 42) == 1);
+  CHECK("as_path prepending is not a loop",
+        bgpstream_as_path_has_loop(path2) == 0);
+  bgpstream_as_path_append(path2, BGPSTREAM_AS_PATH_SEG_ASN, &looped, 1);
+  CHECK("as_path loop", bgpstream_as_path_has_loop(path2) == 1);
+  // long enough to be sorted, and to be flattened on the heap
+  bgpstream_as_path_clear(path2);
+  for (uint32_t i = 0; i < 400; i++) {
+    looped = 1000 + i;
+    bgpstream_as_path_append(path2, BGPSTREAM_AS_PATH_SEG_ASN, &looped, 1);
+  }
+  CHECK("as_path long path has no loop",
+        bgpstream_as_path_has_loop(path2) == 0 &&
+          bgpstream_as_path_contains_asn(path2, 1399) == 1);
+  looped = 1200;
+  bgpstream_as_path_append(path2, BGPSTREAM_AS_PATH_SEG_ASN, &looped, 1);
+  CHECK("as_path long path loop", bgpstream_as_path_has_loop(path2) == 1);
+  bgpstream_as_path_destroy(path3);
+
+  // all paths share their first and last ASNs, and so their pathset
+  bgpstream_as_path_store_t *store = bgpstream_as_path_store_create();
+  bgpstream_as_path_store_path_id_t id;
+  bgpstream_as_path_store_path_t *spath;
+  int bad_ids = 0, bad_paths = 0;
+  CHECK("as_path store create", store != NULL);
+  for (int pass = 0; pass < 2; pass++) {
+    for (uint32_t i = 0; i < STORE_TEST_PATH_CNT; i++) {
+      path_asns[1] = 100000 + i;
+      bgpstream_as_path_clear(path2);
+      bgpstream_as_path_append(path2, BGPSTREAM_AS_PATH_SEG_ASN, path_asns, 4);
+      if (bgpstream_as_path_store_get_path_id(store, path2, 0, &id) != 0 ||
+          id.path_id != i) {
+        bad_ids++;
+      }
+      spath = bgpstream_as_path_store_get_store_path(store, id);
+      if (spath == NULL ||
+          !bgpstream_as_path_equal(
+            bgpstream_as_path_store_path_get_int_path(spath), path2)) {
+        bad_paths++;
+      }
+    }
+  }
+  CHECK("as_path store path IDs", bad_ids == 0);
+  CHECK("as_path store paths", bad_paths == 0);
+  CHECK("as_path store size",
+        bgpstream_as_path_store_get_size(store) == STORE_TEST_PATH_CNT);
+
+  // a saved store loads back with the same IDs, into either kind of store
+  CHECK("as_path store save",
+        bgpstream_as_path_store_save(store, STORE_TEST_FILE) == 0);
+  bgpstream_as_path_store_destroy(store);
+  for (int concurrent = 0; concurrent < 2; concurrent++) {
+    store = concurrent ? bgpstream_as_path_store_create_concurrent()
+                       : bgpstream_as_path_store_create();
+    CHECK("as_path store load",
+          store != NULL &&
+            bgpstream_as_path_store_load(store, STORE_TEST_FILE) == 0);
+    CHECK("as_path store loaded size",
+          bgpstream_as_path_store_get_size(store) == STORE_TEST_PATH_CNT);
+    bad_ids = 0;
+    for (uint32_t i = 0; i <= STORE_TEST_PATH_CNT; i++) {
+      path_asns[1] = 100000 + i;
+      bgpstream_as_path_clear(path2);
+      bgpstream_as_path_append(path2, BGPSTREAM_AS_PATH_SEG_ASN, path_asns, 4);
+      if (bgpstream_as_path_store_get_path_id(store, path2, 0, &id) != 0 ||
+          id.path_id != i) {
+        bad_ids++;
+      }
+    }
+    CHECK("as_path store loaded IDs", bad_ids == 0);
+    CHECK("as_path store load into non-empty store",
+          bgpstream_as_path_store_load(store, STORE_TEST_FILE) != 0);
+    bgpstream_as_path_store_destroy(store);
+  }
+
+  CHECK_SECTION("concurrent as_path store", test_concurrent_store() == 0);
+
   ENDTEST;
   return 0;
 }
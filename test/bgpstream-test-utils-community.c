@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int test_communities()
+{
+  bgpstream_community_t comm;
+
+  CHECK("community from string",
+        bgpstream_str2community("2914:410", &comm) ==
+            BGPSTREAM_COMMUNITY_FILTER_EXACT &&
+          comm.asn == 2914 && comm.value == 410);
+
+  CHECK("community from string (wildcard ASN)",
+        bgpstream_str2community("*:666", &comm) ==
+            BGPSTREAM_COMMUNITY_FILTER_VALUE &&
+          comm.value == 666);
+
+  CHECK("community from string (wildcard value)",
+        bgpstream_str2community("65535:*", &comm) ==
+          BGPSTREAM_COMMUNITY_FILTER_ASN);
+
+  CHECK("community from string (out of range)",
+        bgpstream_str2community("65536:1", &comm) == -1);
+
+  comm.asn = 2914;
+  comm.value = 410;
+  CHECK_SNPRINTF("community to string", "2914:410", 32, int,
+                 bgpstream_community_snprintf(cs_buf, cs_len, &comm));
+
+  return 0;
+}
+
+static int test_large_communities()
+{
+  bgpstream_large_community_t lc;
+
+  CHECK("large community from string",
+        bgpstream_str2large_community("4200000000:1:4294967295", &lc) ==
+            BGPSTREAM_LARGE_COMMUNITY_FILTER_EXACT &&
+          lc.global_admin == 4200000000U && lc.local_1 == 1 &&
+          lc.local_2 == 4294967295U);
+
+  CHECK("large community from string (wildcards)",
+        bgpstream_str2large_community("64512:*:666", &lc) ==
+            (BGPSTREAM_LARGE_COMMUNITY_FILTER_GLOBAL |
+             BGPSTREAM_LARGE_COMMUNITY_FILTER_LOCAL2) &&
+          lc.global_admin == 64512 && lc.local_1 == 0 && lc.local_2 == 666);
+
+  CHECK("large community from string (all wildcards)",
+        bgpstream_str2large_community("*:*:*", &lc) == 0);
+
+  CHECK("large community from string (too few parts)",
+        bgpstream_str2large_community("64512:1", &lc) == -1);
+
+  CHECK("large community from string (too many parts)",
+        bgpstream_str2large_community("64512:1:2:3", &lc) == -1);
+
+  CHECK("large community from string (out of range)",
+        bgpstream_str2large_community("4294967296:1:2", &lc) == -1);
+
+  lc.global_admin = 64512;
+  lc.local_1 = 1;
+  lc.local_2 = 2;
+  CHECK_SNPRINTF("large community to string", "64512:1:2", 32, int,
+                 bgpstream_large_community_snprintf(cs_buf, cs_len, &lc));
+
+  return 0;
+}
+
+static int test_community_sets()
+{
+  bgpstream_community_set_t *set, *copy;
+  bgpstream_community_t comm;
+  bgpstream_large_community_t lc = {64512, 1, 2};
+
+  CHECK("community set create",
+        (set = bgpstream_community_set_create()) != NULL &&
+          (copy = bgpstream_community_set_create()) != NULL);
+
+  bgpstream_str2community("2914:410", &comm);
+  CHECK("community set insert",
+        bgpstream_community_set_insert(set, &comm) == 0 &&
+          bgpstream_community_set_insert_large(set, &lc) == 0 &&
+          bgpstream_community_set_size(set) == 1 &&
+          bgpstream_community_set_large_size(set) == 1);
+
+  CHECK_SNPRINTF("community set to string", "2914:410 64512:1:2", 64, int,
+                 bgpstream_community_set_snprintf(cs_buf, cs_len, set));
+
+  CHECK("community set copy",
+        bgpstream_community_set_copy(copy, set) == 0 &&
+          bgpstream_community_set_large_size(copy) == 1 &&
+          bgpstream_large_community_equal_value(
+            *bgpstream_community_set_get_large(copy, 0), lc));
+  CHECK("community set equal", bgpstream_community_set_equal(copy, set));
+
+  // borrowed large communities are copied once the set is changed
+  bgpstream_large_community_t borrowed[2] = {{64512, 3, 4}, {64512, 5, 6}};
+  CHECK("community set populate large (zero-copy)",
+        bgpstream_community_set_populate_large_from_array_zc(set, borrowed,
+                                                             2) == 0 &&
+          bgpstream_community_set_size(set) == 1 &&
+          bgpstream_community_set_large_size(set) == 2 &&
+          bgpstream_community_set_get_large(set, 1) == &borrowed[1]);
+  CHECK("community set insert large into borrowed",
+        bgpstream_community_set_insert_large(set, &lc) == 0 &&
+          bgpstream_community_set_large_size(set) == 3 &&
+          bgpstream_community_set_get_large(set, 1) != &borrowed[1] &&
+          bgpstream_large_community_equal_value(
+            *bgpstream_community_set_get_large(set, 1), borrowed[1]));
+
+  bgpstream_community_set_clear(set);
+  CHECK("community set clear",
+        bgpstream_community_set_size(set) == 0 &&
+          bgpstream_community_set_large_size(set) == 0 &&
+          bgpstream_community_set_get_large(set, 0) == NULL);
+
+  bgpstream_community_set_destroy(set);
+  bgpstream_community_set_destroy(copy);
+  return 0;
+}
+
+static int test_community_set_index()
+{
+  bgpstream_community_set_t *set, *big;
+  bgpstream_community_t comm, queries[3];
+  uint8_t matched[3];
+  int i, mask, indexed, unindexed, mismatches = 0;
+
+  CHECK("community set create",
+        (set = bgpstream_community_set_create()) != NULL &&
+          (big = bgpstream_community_set_create()) != NULL);
+
+  // a route server sized set: 100 communities of 10 ASNs
+  for (i = 0; i < 100; i++) {
+    comm.asn = 64500 + (i % 10) * 3;
+    comm.value = i * 7;
+    bgpstream_community_set_insert(set, &comm);
+  }
+  CHECK("community set index", bgpstream_community_set_copy(big, set) == 0 &&
+                                 bgpstream_community_set_index(big) == 0);
+
+  // the index must give the same answers as scanning the set
+  for (i = 0; i < 2000; i++) {
+    comm.asn = 64495 + (i % 40);
+    comm.value = i % 750;
+    for (mask = 0; mask <= BGPSTREAM_COMMUNITY_FILTER_EXACT; mask++) {
+      indexed = bgpstream_community_set_match(big, &comm, mask);
+      unindexed = bgpstream_community_set_match(set, &comm, mask);
+      mismatches += indexed != unindexed;
+    }
+  }
+  CHECK("community set index matches scan", mismatches == 0);
+
+  bgpstream_str2community("64527:*", &queries[0]);
+  bgpstream_str2community("64528:*", &queries[1]);
+  bgpstream_str2community("64500:0", &queries[2]);
+  CHECK("community set match bulk (ASN)",
+        bgpstream_community_set_match_bulk(big, queries, 3,
+                                           BGPSTREAM_COMMUNITY_FILTER_ASN,
+                                           matched) == 2 &&
+          matched[0] == 1 && matched[1] == 0 && matched[2] == 1);
+
+  // changing the set drops the index
+  bgpstream_str2community("64528:1", &comm);
+  bgpstream_community_set_insert(big, &comm);
+  CHECK("community set insert after index",
+        bgpstream_community_set_exists(big, &comm) == 1 &&
+          bgpstream_community_set_match(big, &queries[1],
+                                        BGPSTREAM_COMMUNITY_FILTER_ASN) == 1);
+
+  bgpstream_community_set_destroy(set);
+  bgpstream_community_set_destroy(big);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("communities", test_communities() == 0);
+  CHECK_SECTION("large communities", test_large_communities() == 0);
+  CHECK_SECTION("community sets", test_community_sets() == 0);
+  CHECK_SECTION("community set index", test_community_set_index() == 0);
+  ENDTEST;
+  return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define IPV4_TEST_PFX_A "192.0.43.0/24"
+#define IPV4_TEST_PFX_B "130.217.0.0/16"
+#define IPV4_TEST_PFX_B_CHILD "130.217.250.0/24"
+#define IPV4_TEST_PFX_B_HALF "130.217.0.0/17"
+#define IPV4_TEST_PFX_NONE "10.0.0.0/8"
+
+#define IPV6_TEST_PFX_A "2001:500:88::/48"
+#define IPV6_TEST_PFX_A_CHILD "2001:500:88:beef::/64"
+#define IPV6_TEST_PFX_B "2001:db8::/126"
+#define IPV6_TEST_PFX_B_SAME64 "2001:db8::8/126"
+
+#define RANDOM_TEST_PFX_CNT 5000
+
+static void add(bgpstream_ip_counter_t *ipc, const char *str)
+{
+  bgpstream_pfx_t pfx;
+  bgpstream_ip_counter_add(ipc, bgpstream_str2pfx(str, &pfx));
+}
+
+static uint64_t overlap(bgpstream_ip_counter_t *ipc, const char *str,
+                        uint8_t *more_specific)
+{
+  bgpstream_pfx_t pfx;
+  return bgpstream_ip_counter_is_overlapping(
+    ipc, bgpstream_str2pfx(str, &pfx), more_specific);
+}
+
+static int test_ip_counter()
+{
+  bgpstream_ip_counter_t *ipc;
+  uint8_t more_specific;
+
+  CHECK("IP Counter create", (ipc = bgpstream_ip_counter_create()) != NULL);
+
+  add(ipc, IPV4_TEST_PFX_B_CHILD);
+  add(ipc, IPV4_TEST_PFX_A);
+  add(ipc, IPV4_TEST_PFX_B);
+  add(ipc, IPV6_TEST_PFX_A_CHILD);
+  add(ipc, IPV6_TEST_PFX_A);
+  add(ipc, IPV6_TEST_PFX_B);
+  add(ipc, IPV6_TEST_PFX_B_SAME64);
+
+  CHECK("IP Counter IPv4 count",
+        bgpstream_ip_counter_get_ipcount(ipc, BGPSTREAM_ADDR_VERSION_IPV4) ==
+          65536 + 256);
+  CHECK("IP Counter IPv6 count (/64s)",
+        bgpstream_ip_counter_get_ipcount(ipc, BGPSTREAM_ADDR_VERSION_IPV6) ==
+          65536 + 1);
+
+  CHECK("IP Counter IPv4 overlap (more specific)",
+        overlap(ipc, IPV4_TEST_PFX_B_HALF, &more_specific) == 32768 &&
+        more_specific == 1);
+  CHECK("IP Counter IPv4 overlap (less specific)",
+        overlap(ipc, "130.0.0.0/8", &more_specific) == 65536 &&
+        more_specific == 0);
+  CHECK("IP Counter IPv4 overlap (none)",
+        overlap(ipc, IPV4_TEST_PFX_NONE, &more_specific) == 0 &&
+        more_specific == 0);
+  CHECK("IP Counter IPv6 overlap",
+        overlap(ipc, "2001:500::/32", &more_specific) == 65536 &&
+        more_specific == 0);
+
+  bgpstream_ip_counter_clear(ipc);
+  CHECK("IP Counter clear",
+        bgpstream_ip_counter_get_ipcount(ipc, BGPSTREAM_ADDR_VERSION_IPV4) ==
+          0);
+
+  bgpstream_ip_counter_destroy(ipc);
+  return 0;
+}
+
+static int test_ip_counter_bulk()
+{
+  bgpstream_ip_counter_t *one, *bulk;
+  bgpstream_pfx_t *pfxs;
+  uint8_t ms_one, ms_bulk;
+  int i, ok = 1;
+
+  pfxs = malloc(sizeof(bgpstream_pfx_t) * RANDOM_TEST_PFX_CNT);
+  one = bgpstream_ip_counter_create();
+  bulk = bgpstream_ip_counter_create();
+
+  srand(42);
+  for (i = 0; i < RANDOM_TEST_PFX_CNT; i++) {
+    bgpstream_str2pfx("10.0.0.0/8", &pfxs[i]);
+    pfxs[i].bs_ipv4.address.addr.s_addr =
+      htonl(0x0a000000 | (rand() & 0xffff) << 8);
+    pfxs[i].mask_len = 8 + rand() / (RAND_MAX / 25 + 1);
+    bgpstream_ip_counter_add(one, &pfxs[i]);
+  }
+  CHECK("IP Counter bulk add",
+        bgpstream_ip_counter_add_bulk(bulk, pfxs, RANDOM_TEST_PFX_CNT) == 0 &&
+        bgpstream_ip_counter_get_ipcount(bulk, BGPSTREAM_ADDR_VERSION_IPV4) ==
+          bgpstream_ip_counter_get_ipcount(one, BGPSTREAM_ADDR_VERSION_IPV4));
+
+  for (i = 0; i < RANDOM_TEST_PFX_CNT; i++) {
+    pfxs[i].mask_len = 16 + rand() / (RAND_MAX / 17 + 1);
+    if (bgpstream_ip_counter_is_overlapping(one, &pfxs[i], &ms_one) !=
+          bgpstream_ip_counter_is_overlapping(bulk, &pfxs[i], &ms_bulk) ||
+        ms_one != ms_bulk) {
+      ok = 0;
+    }
+  }
+  CHECK("IP Counter bulk add overlaps", ok != 0);
+
+  bgpstream_ip_counter_destroy(one);
+  bgpstream_ip_counter_destroy(bulk);
+  free(pfxs);
+  return 0;
+}
+
+static void bitmap_add(bgpstream_ipv4_bitmap_t *bm, const char *str)
+{
+  bgpstream_pfx_t pfx;
+  bgpstream_ipv4_bitmap_add(bm, bgpstream_str2pfx(str, &pfx));
+}
+
+static uint64_t bitmap_overlap(bgpstream_ipv4_bitmap_t *bm, const char *str)
+{
+  bgpstream_pfx_t pfx;
+  return bgpstream_ipv4_bitmap_get_overlap(bm, bgpstream_str2pfx(str, &pfx));
+}
+
+static int test_ipv4_bitmap()
+{
+  bgpstream_ipv4_bitmap_t *a, *b;
+
+  CHECK("IPv4 Bitmap create",
+        (a = bgpstream_ipv4_bitmap_create()) != NULL &&
+        (b = bgpstream_ipv4_bitmap_create()) != NULL);
+
+  bitmap_add(a, IPV4_TEST_PFX_B);
+  bitmap_add(a, IPV4_TEST_PFX_B_CHILD);
+  bitmap_add(a, "192.0.43.128/25");
+  bitmap_add(a, IPV6_TEST_PFX_A);
+  bitmap_add(b, IPV4_TEST_PFX_B_HALF);
+  bitmap_add(b, IPV4_TEST_PFX_NONE);
+
+  CHECK("IPv4 Bitmap count",
+        bgpstream_ipv4_bitmap_get_count(a) == 256 + 1 &&
+        bgpstream_ipv4_bitmap_get_count(b) == 65536 + 128);
+  CHECK("IPv4 Bitmap overlap",
+        bitmap_overlap(a, "130.0.0.0/8") == 256 &&
+        bitmap_overlap(a, IPV4_TEST_PFX_A) == 1 &&
+        bitmap_overlap(a, "130.217.250.0/23") == 2 &&
+        bitmap_overlap(a, "130.217.251.0/24") == 1 &&
+        bitmap_overlap(a, IPV4_TEST_PFX_NONE) == 0);
+  CHECK("IPv4 Bitmap AND count", bgpstream_ipv4_bitmap_and_count(a, b) == 128);
+
+  bgpstream_ipv4_bitmap_or(b, a);
+  CHECK("IPv4 Bitmap OR",
+        bgpstream_ipv4_bitmap_get_count(b) == 65536 + 256 + 1);
+  bgpstream_ipv4_bitmap_andnot(b, a);
+  CHECK("IPv4 Bitmap ANDNOT", bgpstream_ipv4_bitmap_get_count(b) == 65536);
+  bgpstream_ipv4_bitmap_and(a, b);
+  CHECK("IPv4 Bitmap AND", bgpstream_ipv4_bitmap_get_count(a) == 0);
+
+  CHECK("IPv4 Bitmap copy",
+        bgpstream_ipv4_bitmap_copy(a, b) == 0 &&
+        bgpstream_ipv4_bitmap_and_count(a, b) == 65536);
+  bgpstream_ipv4_bitmap_clear(a);
+  CHECK("IPv4 Bitmap clear", bgpstream_ipv4_bitmap_get_count(a) == 0);
+
+  bgpstream_ipv4_bitmap_destroy(a);
+  bgpstream_ipv4_bitmap_destroy(b);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("IP Counter", test_ip_counter() == 0);
+  CHECK_SECTION("IP Counter bulk", test_ip_counter_bulk() == 0);
+  CHECK_SECTION("IPv4 Bitmap", test_ipv4_bitmap() == 0);
+  ENDTEST;
+  return 0;
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IPV4_TEST_PFX_B "130.217.0.0/16"
+#define IPV4_TEST_PFX_B_CHILD "130.217.250.0/24"
+#define IPV4_TEST_PFX_B_GRANDCHILD "130.217.250.128/25"
+#define IPV4_TEST_ADDR_B "130.217.1.1"
+#define IPV4_TEST_ADDR_B_CHILD "130.217.250.1"
+#define IPV4_TEST_ADDR_B_GRANDCHILD "130.217.250.129"
+#define IPV4_TEST_ADDR_NONE "192.0.2.1"
+
+#define IPV6_TEST_PFX_A "2001:500:88::/48"
+#define IPV6_TEST_PFX_A_CHILD "2001:500:88:beef::/64"
+#define IPV6_TEST_ADDR_A "2001:500:88:1::1"
+#define IPV6_TEST_ADDR_A_CHILD "2001:500:88:beef::1"
+
+// random prefixes and addresses checked against a linear scan
+#define RANDOM_TEST_PFX_CNT 2000
+#define RANDOM_TEST_ADDR_CNT 5000
+
+static int pfx_is(const bgpstream_lpm_t *lpm, uint32_t idx, const char *str)
+{
+  bgpstream_pfx_t pfx;
+  return idx != BGPSTREAM_LPM_NONE &&
+         bgpstream_pfx_equal(bgpstream_lpm_get_pfx(lpm, idx),
+                             bgpstream_str2pfx(str, &pfx));
+}
+
+static int test_lpm()
+{
+  bgpstream_patricia_tree_t *pt;
+  bgpstream_lpm_t *lpm;
+  bgpstream_ip_addr_t addr;
+  bgpstream_pfx_t pfx;
+
+  pt = bgpstream_patricia_tree_create(NULL);
+  bgpstream_patricia_tree_insert(pt, bgpstream_str2pfx(IPV4_TEST_PFX_B, &pfx));
+  bgpstream_patricia_tree_insert(
+    pt, bgpstream_str2pfx(IPV4_TEST_PFX_B_CHILD, &pfx));
+  bgpstream_patricia_tree_insert(
+    pt, bgpstream_str2pfx(IPV4_TEST_PFX_B_GRANDCHILD, &pfx));
+  bgpstream_patricia_tree_insert(pt, bgpstream_str2pfx(IPV6_TEST_PFX_A, &pfx));
+  bgpstream_patricia_tree_insert(
+    pt, bgpstream_str2pfx(IPV6_TEST_PFX_A_CHILD, &pfx));
+
+  CHECK("LPM create from Patricia Tree",
+        (lpm = bgpstream_lpm_create()) != NULL &&
+        bgpstream_lpm_add_patricia(lpm, pt) == 0 &&
+        bgpstream_lpm_get_pfx_cnt(lpm) == 5 &&
+        bgpstream_lpm_build(lpm) == 0);
+  bgpstream_patricia_tree_destroy(pt);
+
+  CHECK("LPM IPv4 lookup",
+        pfx_is(lpm,
+               bgpstream_lpm_lookup(lpm, bgpstream_str2addr(IPV4_TEST_ADDR_B,
+                                                            &addr)),
+               IPV4_TEST_PFX_B) &&
+        pfx_is(lpm,
+               bgpstream_lpm_lookup(
+                 lpm, bgpstream_str2addr(IPV4_TEST_ADDR_B_CHILD, &addr)),
+               IPV4_TEST_PFX_B_CHILD) &&
+        pfx_is(lpm,
+               bgpstream_lpm_lookup(
+                 lpm, bgpstream_str2addr(IPV4_TEST_ADDR_B_GRANDCHILD, &addr)),
+               IPV4_TEST_PFX_B_GRANDCHILD));
+  CHECK("LPM IPv4 lookup (no match)",
+        bgpstream_lpm_lookup(lpm, bgpstream_str2addr(IPV4_TEST_ADDR_NONE,
+                                                     &addr)) ==
+          BGPSTREAM_LPM_NONE);
+  CHECK("LPM IPv6 lookup",
+        pfx_is(lpm,
+               bgpstream_lpm_lookup(lpm, bgpstream_str2addr(IPV6_TEST_ADDR_A,
+                                                            &addr)),
+               IPV6_TEST_PFX_A) &&
+        pfx_is(lpm,
+               bgpstream_lpm_lookup(
+                 lpm, bgpstream_str2addr(IPV6_TEST_ADDR_A_CHILD, &addr)),
+               IPV6_TEST_PFX_A_CHILD));
+
+  bgpstream_lpm_destroy(lpm);
+  return 0;
+}
+
+static int test_lpm_random()
+{
+  bgpstream_lpm_t *lpm;
+  bgpstream_pfx_t *pfxs, host;
+  bgpstream_ip_addr_t *addrs;
+  uint32_t *results, *v4_addrs, *v4_results;
+  uint32_t best;
+  int i, j, v4_cnt = 0, single_ok = 1, scan_ok = 1, v4_ok = 1;
+
+  pfxs = malloc(sizeof(bgpstream_pfx_t) * RANDOM_TEST_PFX_CNT);
+  addrs = malloc(sizeof(bgpstream_ip_addr_t) * RANDOM_TEST_ADDR_CNT);
+  results = malloc(sizeof(uint32_t) * RANDOM_TEST_ADDR_CNT);
+  v4_addrs = malloc(sizeof(uint32_t) * RANDOM_TEST_ADDR_CNT);
+  v4_results = malloc(sizeof(uint32_t) * RANDOM_TEST_ADDR_CNT);
+  lpm = bgpstream_lpm_create();
+
+  // addresses are drawn from a small space so that prefixes overlap
+  srand(42);
+  for (i = 0; i < RANDOM_TEST_PFX_CNT; i++) {
+    if (i & 1) {
+      bgpstream_str2pfx("10.0.0.0/8", &pfxs[i]);
+      pfxs[i].bs_ipv4.address.addr.s_addr =
+        htonl(0x0a000000 | (rand() & 0xffff));
+      pfxs[i].mask_len = 8 + rand() / (RAND_MAX / 25 + 1);
+    } else {
+      bgpstream_str2pfx("2001:db8::/32", &pfxs[i]);
+      pfxs[i].bs_ipv6.address.addr.s6_addr[4] = rand();
+      pfxs[i].bs_ipv6.address.addr.s6_addr[5] = rand();
+      pfxs[i].bs_ipv6.address.addr.s6_addr[6] = rand();
+      pfxs[i].mask_len = 32 + rand() / (RAND_MAX / 33 + 1);
+    }
+    bgpstream_addr_mask(&pfxs[i].address, pfxs[i].mask_len);
+    bgpstream_lpm_add(lpm, &pfxs[i], NULL);
+  }
+  CHECK("LPM build (random prefixes)", bgpstream_lpm_build(lpm) == 0);
+
+  for (i = 0; i < RANDOM_TEST_ADDR_CNT; i++) {
+    j = rand() / (RAND_MAX / RANDOM_TEST_PFX_CNT + 1);
+    bgpstream_pfx_copy(&host, &pfxs[j]);
+    if (host.address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
+      host.bs_ipv4.address.addr.s_addr ^= htonl(rand() & 0x3ff);
+      v4_addrs[v4_cnt++] = host.bs_ipv4.address.addr.s_addr;
+    } else {
+      host.bs_ipv6.address.addr.s6_addr[7] ^= rand();
+      host.bs_ipv6.address.addr.s6_addr[15] ^= rand();
+    }
+    bgpstream_addr_copy(&addrs[i], &host.address);
+  }
+  bgpstream_lpm_lookup_batch(lpm, addrs, RANDOM_TEST_ADDR_CNT, results);
+  bgpstream_lpm_lookup_ipv4_batch(lpm, v4_addrs, v4_cnt, v4_results);
+
+  v4_cnt = 0;
+  for (i = 0; i < RANDOM_TEST_ADDR_CNT; i++) {
+    if (bgpstream_lpm_lookup(lpm, &addrs[i]) != results[i]) {
+      single_ok = 0;
+    }
+    if (addrs[i].version == BGPSTREAM_ADDR_VERSION_IPV4 &&
+        v4_results[v4_cnt++] != results[i]) {
+      v4_ok = 0;
+    }
+    // the longest prefix containing the address, the last one added if
+    // there are several
+    bgpstream_addr_copy(&host.address, &addrs[i]);
+    host.mask_len =
+      (addrs[i].version == BGPSTREAM_ADDR_VERSION_IPV4) ? 32 : 128;
+    best = BGPSTREAM_LPM_NONE;
+    for (j = 0; j < RANDOM_TEST_PFX_CNT; j++) {
+      if (bgpstream_pfx_contains(&pfxs[j], &host) &&
+          (best == BGPSTREAM_LPM_NONE ||
+           pfxs[j].mask_len >= pfxs[best].mask_len)) {
+        best = j;
+      }
+    }
+    if (best != results[i]) {
+      scan_ok = 0;
+    }
+  }
+  CHECK("LPM batch lookup (random addresses)", scan_ok != 0);
+  CHECK("LPM single lookup (random addresses)", single_ok != 0);
+  CHECK("LPM IPv4 batch lookup (random addresses)", v4_ok != 0);
+
+  bgpstream_lpm_destroy(lpm);
+  free(pfxs);
+  free(addrs);
+  free(results);
+  free(v4_addrs);
+  free(v4_results);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("LPM", test_lpm() == 0);
+  CHECK_SECTION("LPM random", test_lpm_random() == 0);
+  ENDTEST;
+  return 0;
+}
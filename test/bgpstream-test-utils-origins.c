@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+#include "bgpstream_utils_as_path_int.h"
+#include "bgpstream_utils_origins.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PEER_A "192.0.2.1"
+#define PEER_B "192.0.2.2"
+#define PEER_ASN 64500
+
+#define PFX "10.0.0.0/8"
+#define SUBPFX "10.1.0.0/16"
+
+// more than fit in one word of peer bits
+#define MANY_PEERS 100
+
+#define EVENTS_MAX 8
+
+typedef struct events {
+  bgpstream_origins_event_t events[EVENTS_MAX];
+  int cnt;
+} events_t;
+
+static bgpstream_elem_t *elem;
+static bgpstream_record_t record;
+static events_t ev;
+
+static int save_event(const bgpstream_origins_event_t *event, void *user)
+{
+  events_t *e = user;
+
+  if (e->cnt == EVENTS_MAX) {
+    return -1;
+  }
+  e->events[e->cnt++] = *event;
+  return 0;
+}
+
+// add an elem of the given type to the monitor, forgetting earlier events
+static int add(bgpstream_origins_t *origins, bgpstream_elem_type_t type,
+               const char *peer, const char *prefix, uint32_t origin)
+{
+  uint32_t asns[2] = {PEER_ASN, origin};
+
+  ev.cnt = 0;
+  bgpstream_elem_clear(elem);
+  elem->type = type;
+  bgpstream_str2addr(peer, &elem->peer_ip);
+  elem->peer_asn = PEER_ASN;
+  if (type == BGPSTREAM_ELEM_TYPE_PEERSTATE) {
+    elem->old_state = BGPSTREAM_ELEM_PEERSTATE_ESTABLISHED;
+    elem->new_state = BGPSTREAM_ELEM_PEERSTATE_IDLE;
+  } else {
+    bgpstream_str2pfx(prefix, &elem->prefix);
+  }
+  if (type == BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT) {
+    bgpstream_as_path_append(elem->as_path, BGPSTREAM_AS_PATH_SEG_ASN, asns,
+                             2);
+  }
+  record.time_sec++;
+  return bgpstream_origins_add_elem(origins, &record, elem);
+}
+
+static int event_is(int i, bgpstream_origins_event_type_t type,
+                    const char *prefix, uint32_t origin, int origins_cnt)
+{
+  bgpstream_pfx_t pfx;
+
+  bgpstream_str2pfx(prefix, &pfx);
+  return i < ev.cnt && ev.events[i].type == type &&
+         bgpstream_pfx_equal(&ev.events[i].pfx, &pfx) &&
+         ev.events[i].origin == origin &&
+         ev.events[i].origins_cnt == origins_cnt &&
+         ev.events[i].time == record.time_sec;
+}
+
+static int test_origins()
+{
+  bgpstream_origins_t *origins;
+  bgpstream_peer_sig_t *sig;
+  bgpstream_pfx_t pfx, covering;
+  uint32_t asns[2];
+
+  CHECK("elem create", (elem = bgpstream_elem_create()) != NULL);
+  strcpy(record.collector_name, "rrc00");
+  record.collector_id = 1;
+  record.status = BGPSTREAM_RECORD_STATUS_VALID_RECORD;
+  record.time_sec = 1000;
+
+  CHECK("origins create",
+        (origins = bgpstream_origins_create(save_event, &ev)) != NULL);
+
+  CHECK("new prefix",
+        add(origins, BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT, PEER_A, PFX, 64600) ==
+            0 &&
+          ev.cnt == 1 &&
+          event_is(0, BGPSTREAM_ORIGINS_EVENT_NEW_PFX, PFX, 64600, 1) &&
+          (sig = bgpstream_origins_get_peer_sig(
+             origins, ev.events[0].peer_id)) != NULL &&
+          strcmp(sig->collector_str, "rrc00") == 0);
+  CHECK("same origin from another peer",
+        add(origins, BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT, PEER_B, PFX, 64600) ==
+            0 &&
+          ev.cnt == 0);
+
+  bgpstream_str2pfx(PFX, &covering);
+  CHECK("new sub-prefix",
+        add(origins, BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT, PEER_A, SUBPFX,
+            64666) == 0 &&
+          ev.cnt == 1 &&
+          event_is(0, BGPSTREAM_ORIGINS_EVENT_NEW_SUBPFX, SUBPFX, 64666, 1) &&
+          bgpstream_pfx_equal(&ev.events[0].covering, &covering));
+
+  CHECK("new origin",
+        add(origins, BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT, PEER_B, PFX, 64601) ==
+            0 &&
+          ev.cnt == 1 &&
+          event_is(0, BGPSTREAM_ORIGINS_EVENT_NEW_ORIGIN, PFX, 64601, 2) &&
+          bgpstream_origins_get_moas_cnt(origins) == 1);
+  bgpstream_str2pfx(PFX, &pfx);
+  CHECK("MOAS origins",
+        bgpstream_origins_get(origins, &pfx, asns, 2) == 2 &&
+          asns[0] == 64600 && asns[1] == 64601);
+
+  CHECK("origin withdrawn",
+        add(origins, BGPSTREAM_ELEM_TYPE_WITHDRAWAL, PEER_A, PFX, 0) == 0 &&
+          ev.cnt == 1 &&
+          event_is(0, BGPSTREAM_ORIGINS_EVENT_ORIGIN_WITHDRAWN, PFX, 64600,
+                   1) &&
+          bgpstream_origins_get_moas_cnt(origins) == 0);
+
+  // the sub-prefix of peer A is kept
+  CHECK("peer down",
+        add(origins, BGPSTREAM_ELEM_TYPE_PEERSTATE, PEER_B, NULL, 0) == 0 &&
+          ev.cnt == 1 &&
+          event_is(0, BGPSTREAM_ORIGINS_EVENT_ORIGIN_WITHDRAWN, PFX, 64601,
+                   0) &&
+          bgpstream_origins_get(origins, &pfx, asns, 2) == 0 &&
+          bgpstream_origins_get_pfx_cnt(origins) == 1);
+
+  bgpstream_origins_destroy(origins);
+  return 0;
+}
+
+static int test_origins_many_peers()
+{
+  bgpstream_origins_t *origins;
+  bgpstream_pfx_t pfx;
+  char peer[64];
+  uint32_t asn;
+  int i, added = 0, events = 0;
+
+  CHECK("origins create (many peers)",
+        (origins = bgpstream_origins_create(save_event, &ev)) != NULL);
+  for (i = 0; i < MANY_PEERS; i++) {
+    snprintf(peer, sizeof(peer), "192.0.2.%d", i + 1);
+    if (add(origins, BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT, peer, PFX, 64600) ==
+        0) {
+      added++;
+      events += ev.cnt;
+    }
+  }
+  CHECK("origin of many peers", added == MANY_PEERS && events == 1);
+
+  // an origin is withdrawn once its last peer withdraws it
+  for (i = 1; i < MANY_PEERS; i++) {
+    snprintf(peer, sizeof(peer), "192.0.2.%d", i + 1);
+    add(origins, BGPSTREAM_ELEM_TYPE_WITHDRAWAL, peer, PFX, 0);
+    events += ev.cnt;
+  }
+  bgpstream_str2pfx(PFX, &pfx);
+  CHECK("withdrawn by all but one peer",
+        events == 1 && bgpstream_origins_get(origins, &pfx, &asn, 1) == 1 &&
+          asn == 64600);
+  CHECK("withdrawn by the last peer",
+        add(origins, BGPSTREAM_ELEM_TYPE_WITHDRAWAL, "192.0.2.1", PFX, 0) ==
+            0 &&
+          event_is(0, BGPSTREAM_ORIGINS_EVENT_ORIGIN_WITHDRAWN, PFX, 64600,
+                   0) &&
+          bgpstream_origins_get_pfx_cnt(origins) == 0);
+
+  bgpstream_origins_destroy(origins);
+  bgpstream_elem_destroy(elem);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("origin changes", test_origins() == 0);
+  CHECK_SECTION("origins of many peers", test_origins_many_peers() == 0);
+  ENDTEST;
+  return 0;
+}
@@ -29,6 +29,7 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -48,6 +49,30 @@
 #define IPV6_TEST_PFX_B_CHILD "2001:48d0:101:501:beef::/96"
 #define IPV6_TEST_64_CNT 65537
 
+// more /24s than fit in one chunk of tree nodes
+#define CHUNK_TEST_PFX_CNT 3000
+
+// enough prefixes of each version for bulk loading to build both in parallel
+#define BULK_TEST_PFX_CNT 5000
+
+// churn of /24s under a fixed set of /16s while readers look them up
+#define CONCURRENT_TEST_16_CNT 64
+#define CONCURRENT_TEST_ROUNDS 50
+#define CONCURRENT_TEST_READERS 2
+
+typedef struct walk_pfxs {
+  bgpstream_pfx_t *pfxs;
+  int cnt;
+} walk_pfxs_t;
+
+static bgpstream_patricia_walk_cb_result_t
+walk_count(const bgpstream_patricia_tree_t *pt,
+           const bgpstream_patricia_node_t *node, void *data)
+{
+  (*(int *)data)++;
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
 static int test_patricia()
 {
   bgpstream_patricia_tree_t *pt;
@@ -146,6 +171,24 @@ static int test_patricia()
         (pfxp = BPT_get_pfx(node)) != NULL &&
         bgpstream_pfx_equal(pfxp, s2p(IPV4_TEST_PFX_B)) != 0);
 
+  /* The same queries without a result set */
+  int walked = 0;
+  node = BPT_search_exact(pt, s2p(IPV4_TEST_PFX_B));
+  bgpstream_patricia_tree_walk_more_specifics(pt, node, walk_count, &walked);
+  CHECK("Patricia Tree v4 walk more specifics",
+        node != NULL &&
+        bgpstream_patricia_tree_get_more_specifics(pt, node, res) == 0 &&
+        walked == bgpstream_patricia_tree_result_set_count(res) &&
+        walked > 0);
+  walked = 0;
+  node = BPT_search_exact(pt, s2p(IPV4_TEST_PFX_B_CHILD));
+  bgpstream_patricia_tree_walk_less_specifics(pt, node, walk_count, &walked);
+  CHECK("Patricia Tree v4 walk less specifics", walked == 1);
+  walked = 0;
+  bgpstream_patricia_tree_walk_minimum_coverage(
+    pt, BGPSTREAM_ADDR_VERSION_IPV6, walk_count, &walked);
+  CHECK("Patricia Tree v6 walk minimum coverage", walked == 2);
+
   bgpstream_patricia_tree_destroy(pt);
   bgpstream_patricia_tree_result_set_destroy(&res);
 
@@ -166,14 +209,250 @@ static int test_patricia()
   for (int i = 0; pfxs[i]; i++){
     INSERT(4, pfxs[i], i+1);
   }
+
+  // nodes come from chunks that are kept across a clear, and removed nodes are
+  // reused, so fill the tree with more than a chunk of nodes a few times over
+  bgpstream_patricia_tree_clear(pt);
+  CHECK("Patricia Tree clear",
+        BPT_pfx_count(pt, BGPSTREAM_ADDR_VERSION_IPV4) == 0 &&
+        BPT_search_exact(pt, s2p(pfxs[0])) == NULL);
+  int reuse_ok = 1;
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < CHUNK_TEST_PFX_CNT; i++) {
+      s2p("10.0.0.0/24");
+      pfx.bs_ipv4.address.addr.s_addr = htonl(0x0a000000 | (i << 8));
+      if (BPT_insert(pt, &pfx) == NULL) {
+        reuse_ok = 0;
+      }
+    }
+    for (int i = 0; i < CHUNK_TEST_PFX_CNT; i += 2) {
+      s2p("10.0.0.0/24");
+      pfx.bs_ipv4.address.addr.s_addr = htonl(0x0a000000 | (i << 8));
+      bgpstream_patricia_tree_remove(pt, &pfx);
+    }
+    if (BPT_pfx_count(pt, BGPSTREAM_ADDR_VERSION_IPV4) !=
+          CHUNK_TEST_PFX_CNT / 2 ||
+        BPT_search_exact(pt, s2p("10.0.1.0/24")) == NULL ||
+        BPT_search_exact(pt, s2p("10.0.2.0/24")) != NULL) {
+      reuse_ok = 0;
+    }
+    if (round != 2) {
+      bgpstream_patricia_tree_clear(pt);
+    }
+  }
+  CHECK("Patricia Tree node reuse", reuse_ok != 0);
+  bgpstream_patricia_tree_destroy(pt);
+
+  return 0;
+}
+
+static bgpstream_patricia_walk_cb_result_t
+walk_collect(const bgpstream_patricia_tree_t *pt,
+             const bgpstream_patricia_node_t *node, void *data)
+{
+  walk_pfxs_t *walk = data;
+  walk->pfxs[walk->cnt++] = *bgpstream_patricia_tree_get_pfx(node);
+  return BGPSTREAM_PATRICIA_WALK_CONTINUE;
+}
+
+static int test_patricia_bulk()
+{
+  bgpstream_patricia_tree_t *pt, *bulk_pt;
+  bgpstream_patricia_node_t **nodes;
+  bgpstream_pfx_t *pfxs;
+  walk_pfxs_t walk, bulk_walk;
+  int cnt = 0, i, ok;
+
+  // a mix of IPv4 and IPv6, nested prefixes and duplicates, in an order that
+  // needs sorting
+  pfxs = malloc(sizeof(bgpstream_pfx_t) * 3 * BULK_TEST_PFX_CNT);
+  nodes = malloc(sizeof(bgpstream_patricia_node_t *) * 3 * BULK_TEST_PFX_CNT);
+  for (i = BULK_TEST_PFX_CNT - 1; i >= 0; i--) {
+    bgpstream_str2pfx("10.0.0.0/24", &pfxs[cnt]);
+    pfxs[cnt++].bs_ipv4.address.addr.s_addr = htonl(0x0a000000 | (i << 8));
+    bgpstream_str2pfx("2001:db8::/48", &pfxs[cnt]);
+    pfxs[cnt].bs_ipv6.address.addr.s6_addr[4] = i >> 8;
+    pfxs[cnt++].bs_ipv6.address.addr.s6_addr[5] = i;
+    if ((i & 0x3f) == 0) {
+      bgpstream_str2pfx("10.0.0.0/18", &pfxs[cnt]);
+      pfxs[cnt++].bs_ipv4.address.addr.s_addr = htonl(0x0a000000 | (i << 8));
+      pfxs[cnt] = pfxs[cnt - 3];
+      cnt++;
+    }
+  }
+  bgpstream_str2pfx("0.0.0.0/0", &pfxs[cnt++]);
+
+  pt = bgpstream_patricia_tree_create(NULL);
+  bulk_pt = bgpstream_patricia_tree_create(NULL);
+  for (i = 0; i < cnt; i++) {
+    bgpstream_patricia_tree_insert(pt, &pfxs[i]);
+  }
+  CHECK("Patricia Tree bulk insert",
+        bgpstream_patricia_tree_insert_bulk(bulk_pt, pfxs, cnt, nodes, 1) == 0);
+
+  // every prefix got its node, and the trees are the same
+  ok = 1;
+  for (i = 0; i < cnt; i++) {
+    if (nodes[i] == NULL ||
+        bgpstream_patricia_tree_search_exact(bulk_pt, &pfxs[i]) != nodes[i]) {
+      ok = 0;
+    }
+  }
+  walk.pfxs = malloc(sizeof(bgpstream_pfx_t) * cnt);
+  walk.cnt = 0;
+  bulk_walk.pfxs = malloc(sizeof(bgpstream_pfx_t) * cnt);
+  bulk_walk.cnt = 0;
+  bgpstream_patricia_tree_walk(pt, walk_collect, &walk);
+  bgpstream_patricia_tree_walk(bulk_pt, walk_collect, &bulk_walk);
+  CHECK("Patricia Tree bulk insert nodes", ok != 0);
+  ok = (walk.cnt == bulk_walk.cnt);
+  for (i = 0; ok != 0 && i < walk.cnt; i++) {
+    ok = bgpstream_pfx_equal(&walk.pfxs[i], &bulk_walk.pfxs[i]);
+  }
+  CHECK("Patricia Tree bulk insert walk",
+        ok != 0 &&
+        bgpstream_patricia_prefix_count(pt, BGPSTREAM_ADDR_VERSION_IPV4) ==
+          bgpstream_patricia_prefix_count(bulk_pt,
+                                          BGPSTREAM_ADDR_VERSION_IPV4) &&
+        bgpstream_patricia_tree_count_24subnets(pt) ==
+          bgpstream_patricia_tree_count_24subnets(bulk_pt));
+
+  // once the tree is not empty, the prefixes are inserted one by one
+  CHECK("Patricia Tree bulk insert into non-empty tree",
+        bgpstream_patricia_tree_insert_bulk(bulk_pt, pfxs, cnt, NULL, 0) == 0 &&
+        bgpstream_patricia_prefix_count(bulk_pt,
+                                        BGPSTREAM_ADDR_VERSION_IPV6) ==
+          BULK_TEST_PFX_CNT);
+
+  free(walk.pfxs);
+  free(bulk_walk.pfxs);
+  free(nodes);
+  free(pfxs);
   bgpstream_patricia_tree_destroy(pt);
+  bgpstream_patricia_tree_destroy(bulk_pt);
+  return 0;
+}
+
+typedef struct concurrent_reader {
+  bgpstream_patricia_tree_t *pt;
+  volatile int *done;
+  int errors;
+} concurrent_reader_t;
+
+static void concurrent_pfx(bgpstream_pfx_t *pfx, int i, int len)
+{
+  bgpstream_str2pfx("10.0.0.0/16", pfx);
+  pfx->bs_ipv4.address.addr.s_addr = htonl(0x0a000000 | (i << 8));
+  pfx->mask_len = len;
+}
+
+static void *concurrent_read(void *user)
+{
+  concurrent_reader_t *cr = user;
+  bgpstream_patricia_tree_reader_t *reader;
+  bgpstream_patricia_tree_result_set_t *res;
+  bgpstream_patricia_node_t *node;
+  bgpstream_pfx_t pfx;
+  int *value;
+  int i;
+
+  reader = bgpstream_patricia_tree_reader_create(cr->pt);
+  res = bgpstream_patricia_tree_result_set_create();
+  if (reader == NULL || res == NULL) {
+    cr->errors++;
+    return NULL;
+  }
+  while (!__atomic_load_n(cr->done, __ATOMIC_ACQUIRE)) {
+    bgpstream_patricia_tree_read_lock(reader);
+    for (i = 0; i < CONCURRENT_TEST_16_CNT * 256; i++) {
+      // the /16s are always there, and cover whatever /24 is
+      concurrent_pfx(&pfx, i & ~0xff, 16);
+      if (bgpstream_patricia_tree_search_exact(cr->pt, &pfx) == NULL) {
+        cr->errors++;
+      }
+      concurrent_pfx(&pfx, i, 24);
+      if ((node = bgpstream_patricia_tree_search_exact(cr->pt, &pfx)) == NULL) {
+        continue;
+      }
+      if ((value = bgpstream_patricia_tree_get_user(node)) != NULL &&
+          *value != i) {
+        cr->errors++;
+      }
+      concurrent_pfx(&pfx, i & ~0xff, 16);
+      if (bgpstream_patricia_tree_get_mincovering_prefix(cr->pt, node, res) !=
+            0 ||
+          bgpstream_patricia_tree_result_set_count(res) != 1 ||
+          !bgpstream_pfx_equal(bgpstream_patricia_tree_get_pfx(
+                                 bgpstream_patricia_tree_result_set_next(res)),
+                               &pfx)) {
+        cr->errors++;
+      }
+    }
+    bgpstream_patricia_tree_read_unlock(reader);
+  }
+  bgpstream_patricia_tree_result_set_destroy(&res);
+  bgpstream_patricia_tree_reader_destroy(reader);
+  return NULL;
+}
+
+static int test_patricia_concurrent()
+{
+  bgpstream_patricia_tree_t *pt;
+  concurrent_reader_t readers[CONCURRENT_TEST_READERS];
+  pthread_t threads[CONCURRENT_TEST_READERS];
+  bgpstream_patricia_node_t *node;
+  bgpstream_pfx_t pfx;
+  volatile int done = 0;
+  int round, i, errors = 0;
+  int *value;
+
+  CHECK("Create concurrent Patricia Tree",
+        (pt = bgpstream_patricia_tree_create_concurrent(free)) != NULL);
+  for (i = 0; i < CONCURRENT_TEST_16_CNT; i++) {
+    concurrent_pfx(&pfx, i << 8, 16);
+    bgpstream_patricia_tree_insert(pt, &pfx);
+  }
 
+  for (i = 0; i < CONCURRENT_TEST_READERS; i++) {
+    readers[i].pt = pt;
+    readers[i].done = &done;
+    readers[i].errors = 0;
+    pthread_create(&threads[i], NULL, concurrent_read, &readers[i]);
+  }
+
+  // add and remove /24s (and replace their user data) under the readers
+  for (round = 0; round < CONCURRENT_TEST_ROUNDS; round++) {
+    for (i = round & 1; i < CONCURRENT_TEST_16_CNT * 256; i += 3) {
+      concurrent_pfx(&pfx, i, 24);
+      if ((node = bgpstream_patricia_tree_search_exact(pt, &pfx)) != NULL) {
+        bgpstream_patricia_tree_remove_node(pt, node);
+      } else if ((node = bgpstream_patricia_tree_insert(pt, &pfx)) == NULL ||
+                 (value = malloc(sizeof(int))) == NULL) {
+        errors++;
+      } else {
+        *value = i;
+        bgpstream_patricia_tree_set_user(pt, node, value);
+      }
+    }
+  }
+
+  __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+  for (i = 0; i < CONCURRENT_TEST_READERS; i++) {
+    pthread_join(threads[i], NULL);
+    errors += readers[i].errors;
+  }
+  bgpstream_patricia_tree_synchronize(pt);
+  CHECK("Concurrent Patricia Tree readers", errors == 0);
+
+  bgpstream_patricia_tree_destroy(pt);
   return 0;
 }
 
 int main()
 {
   CHECK_SECTION("Patricia Tree", test_patricia() == 0);
+  CHECK_SECTION("Patricia Tree bulk insert", test_patricia_bulk() == 0);
+  CHECK_SECTION("Concurrent Patricia Tree", test_patricia_concurrent() == 0);
   ENDTEST;
   return 0;
 }
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PEER_CNT 1000
+#define THREAD_CNT 4
+
+// the peer IP of the i'th test peer
+static void peer_ip(int i, bgpstream_ip_addr_t *addr)
+{
+  char buf[32];
+
+  snprintf(buf, sizeof(buf), "192.0.%d.%d", i / 256, i % 256);
+  bgpstream_str2addr(buf, addr);
+}
+
+static int test_peer_sig_map()
+{
+  bgpstream_peer_sig_map_t *map;
+  bgpstream_peer_id_t ids[PEER_CNT], id, id2;
+  bgpstream_ip_addr_t addr;
+  bgpstream_peer_sig_t *sig;
+  int i, pass, bad = 0;
+
+  CHECK("peer sig map create", (map = bgpstream_peer_sig_map_create()) != NULL);
+
+  for (i = 0; i < PEER_CNT; i++) {
+    peer_ip(i, &addr);
+    ids[i] = bgpstream_peer_sig_map_get_id(map, "rrc00", &addr, 64500 + i);
+    bad += ids[i] == 0;
+  }
+  CHECK("peer sig map get ID", bad == 0 &&
+                                 bgpstream_peer_sig_map_get_size(map) ==
+                                   PEER_CNT);
+
+  peer_ip(0, &addr);
+  id = bgpstream_peer_sig_map_get_id(map, "rrc01", &addr, 64500);
+  sig = bgpstream_peer_sig_map_get_sig(map, ids[0]);
+  CHECK("peer sig map collectors have their own peers",
+        id != 0 && id != ids[0] && sig != NULL &&
+          strcmp(sig->collector_str, "rrc00") == 0 &&
+          bgpstream_peer_sig_map_get_size(map) == PEER_CNT + 1);
+
+  // the cache gives the same IDs, whether the peer is in it or not
+  bad = 0;
+  for (pass = 0; pass < 2; pass++) {
+    for (i = 0; i < PEER_CNT; i++) {
+      peer_ip(i, &addr);
+      if (bgpstream_peer_sig_map_get_id_cached(map, 1, "rrc00", &addr,
+                                               64500 + i) != ids[i]) {
+        bad++;
+      }
+    }
+  }
+  peer_ip(0, &addr);
+  id2 = bgpstream_peer_sig_map_get_id_cached(map, 2, "rrc01", &addr, 64500);
+  CHECK("peer sig map get ID (cached)",
+        bad == 0 && id2 == id &&
+          bgpstream_peer_sig_map_get_size(map) == PEER_CNT + 1);
+
+  bgpstream_peer_sig_map_clear(map);
+  CHECK("peer sig map clear",
+        bgpstream_peer_sig_map_get_size(map) == 0 &&
+          bgpstream_peer_sig_map_get_id_cached(map, 1, "rrc00", &addr,
+                                               64500) != ids[0] &&
+          bgpstream_peer_sig_map_get_size(map) == 1);
+
+  bgpstream_peer_sig_map_destroy(map);
+  return 0;
+}
+
+static int test_peer_sig_map_merge()
+{
+  bgpstream_peer_sig_map_t *dst, *src;
+  bgpstream_peer_id_t *remap = NULL;
+  bgpstream_ip_addr_t addr;
+  bgpstream_peer_id_t src_ids[3];
+  int i, remap_cnt;
+
+  CHECK("peer sig map create",
+        (dst = bgpstream_peer_sig_map_create()) != NULL &&
+          (src = bgpstream_peer_sig_map_create()) != NULL);
+
+  // dst has peers 0 and 1, src has peers 1, 2 and 3
+  for (i = 0; i < 2; i++) {
+    peer_ip(i, &addr);
+    bgpstream_peer_sig_map_get_id(dst, "rrc00", &addr, 64500 + i);
+  }
+  for (i = 1; i < 4; i++) {
+    peer_ip(i, &addr);
+    src_ids[i - 1] = bgpstream_peer_sig_map_get_id(src, "rrc00", &addr,
+                                                   64500 + i);
+  }
+
+  remap_cnt = bgpstream_peer_sig_map_merge(dst, src, &remap);
+  peer_ip(1, &addr);
+  CHECK("peer sig map merge",
+        remap_cnt == 4 && bgpstream_peer_sig_map_get_size(dst) == 4 &&
+          remap[0] == 0 &&
+          remap[src_ids[0]] ==
+            bgpstream_peer_sig_map_get_id(dst, "rrc00", &addr, 64501) &&
+          remap[src_ids[1]] != 0 && remap[src_ids[2]] != 0 &&
+          remap[src_ids[1]] != remap[src_ids[2]] &&
+          bgpstream_peer_sig_map_get_size(src) == 3);
+
+  free(remap);
+  bgpstream_peer_sig_map_destroy(dst);
+  bgpstream_peer_sig_map_destroy(src);
+  return 0;
+}
+
+typedef struct concurrent_test {
+  bgpstream_peer_sig_map_t *map;
+  int offset;
+  bgpstream_peer_id_t ids[PEER_CNT];
+} concurrent_test_t;
+
+// every thread looks up all the peers, starting at a different one
+static void *concurrent_lookup(void *user)
+{
+  concurrent_test_t *test = user;
+  bgpstream_ip_addr_t addr;
+  int i, peer;
+
+  for (i = 0; i < PEER_CNT; i++) {
+    peer = (i + test->offset) % PEER_CNT;
+    peer_ip(peer, &addr);
+    test->ids[peer] = bgpstream_peer_sig_map_get_id_cached(
+      test->map, 1, "rrc00", &addr, 64500 + peer);
+  }
+  return NULL;
+}
+
+static int test_concurrent_peer_sig_map()
+{
+  static concurrent_test_t tests[THREAD_CNT];
+  pthread_t threads[THREAD_CNT];
+  bgpstream_peer_sig_map_t *map;
+  int t, i, failed = 0, bad = 0;
+
+  CHECK("concurrent peer sig map create",
+        (map = bgpstream_peer_sig_map_create_concurrent()) != NULL);
+
+  for (t = 0; t < THREAD_CNT; t++) {
+    tests[t].map = map;
+    tests[t].offset = t * (PEER_CNT / THREAD_CNT);
+    failed += pthread_create(&threads[t], NULL, concurrent_lookup,
+                             &tests[t]) != 0;
+  }
+  for (t = 0; t < THREAD_CNT; t++) {
+    pthread_join(threads[t], NULL);
+  }
+  CHECK("concurrent peer sig map threads", failed == 0);
+
+  for (t = 1; t < THREAD_CNT; t++) {
+    for (i = 0; i < PEER_CNT; i++) {
+      bad += tests[t].ids[i] == 0 || tests[t].ids[i] != tests[0].ids[i];
+    }
+  }
+  CHECK("concurrent peer sig map IDs",
+        bad == 0 && bgpstream_peer_sig_map_get_size(map) == PEER_CNT);
+
+  bgpstream_peer_sig_map_destroy(map);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("peer signature map", test_peer_sig_map() == 0);
+  CHECK_SECTION("peer signature map merge", test_peer_sig_map_merge() == 0);
+  CHECK_SECTION("concurrent peer signature map",
+                test_concurrent_peer_sig_map() == 0);
+  ENDTEST;
+  return 0;
+}
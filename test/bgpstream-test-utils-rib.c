@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+#include "bgpstream_utils_as_path_int.h"
+#include "bgpstream_utils_rib.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PEER_A "192.0.2.1"
+#define PEER_A_ASN 64500
+#define PEER_B "192.0.2.2"
+#define PEER_B_ASN 64501
+
+#define RIB_FILE "bgpstream-test-rib.bin"
+
+static bgpstream_rib_t *rib;
+static bgpstream_record_t record;
+static bgpstream_elem_t *elem;
+
+static bgpstream_pfx_t *pfx(const char *str)
+{
+  static bgpstream_pfx_t p[4];
+  static int i = 0;
+
+  i = (i + 1) % 4;
+  return bgpstream_str2pfx(str, &p[i]);
+}
+
+static void begin(bgpstream_record_type_t type, uint32_t time,
+                  bgpstream_dump_position_t dump_pos)
+{
+  memset(&record, 0, sizeof(record));
+  strcpy(record.collector_name, "rrc00");
+  record.collector_id = 1;
+  record.type = type;
+  record.status = BGPSTREAM_RECORD_STATUS_VALID_RECORD;
+  record.time_sec = time;
+  record.dump_time_sec = type == BGPSTREAM_RIB ? 1000 * (time / 1000) : time;
+  record.dump_pos = dump_pos;
+  bgpstream_rib_begin_record(rib, &record);
+}
+
+// apply an elem of the current record
+static int add(bgpstream_elem_type_t type, const char *peer, uint32_t peer_asn,
+               const char *prefix, uint32_t origin)
+{
+  uint32_t asns[2] = {peer_asn, origin};
+  bgpstream_community_t comm;
+
+  bgpstream_elem_clear(elem);
+  elem->type = type;
+  bgpstream_str2addr(peer, &elem->peer_ip);
+  elem->peer_asn = peer_asn;
+  if (prefix != NULL) {
+    bgpstream_str2pfx(prefix, &elem->prefix);
+    bgpstream_str2addr(peer, &elem->nexthop);
+    bgpstream_as_path_append(elem->as_path, BGPSTREAM_AS_PATH_SEG_ASN, asns,
+                             2);
+    bgpstream_str2community("64500:100", &comm);
+    bgpstream_community_set_insert(elem->communities, &comm);
+  }
+  return bgpstream_rib_add_elem(rib, &record, elem);
+}
+
+static int peerstate(const char *peer, uint32_t peer_asn,
+                     bgpstream_elem_peerstate_t state)
+{
+  bgpstream_elem_clear(elem);
+  elem->type = BGPSTREAM_ELEM_TYPE_PEERSTATE;
+  bgpstream_str2addr(peer, &elem->peer_ip);
+  elem->peer_asn = peer_asn;
+  elem->new_state = state;
+  return bgpstream_rib_add_elem(rib, &record, elem);
+}
+
+static bgpstream_peer_id_t peer_id(const char *peer, uint32_t peer_asn)
+{
+  bgpstream_ip_addr_t addr;
+
+  bgpstream_str2addr(peer, &addr);
+  return bgpstream_peer_sig_map_get_id(bgpstream_rib_get_peer_sig_map(rib),
+                                       "rrc00", &addr, peer_asn);
+}
+
+static int has_route(const char *peer, uint32_t peer_asn, const char *prefix)
+{
+  bgpstream_rib_route_t route;
+
+  return bgpstream_rib_get_route(rib, peer_id(peer, peer_asn), pfx(prefix),
+                                 &route);
+}
+
+static int count_diff(const bgpstream_pfx_t *p, bgpstream_peer_id_t peer,
+                      const bgpstream_rib_route_t *old_route,
+                      const bgpstream_rib_route_t *new_route, void *user)
+{
+  int *cnt = user;
+
+  cnt[old_route == NULL ? 0 : new_route == NULL ? 1 : 2]++;
+  return 0;
+}
+
+static int count_route(const bgpstream_pfx_t *p,
+                       const bgpstream_rib_route_t *route, void *user)
+{
+  (*(int *)user)++;
+  return 0;
+}
+
+static int test_rib_dump()
+{
+  bgpstream_rib_route_t route;
+  bgpstream_as_path_t *path;
+  uint32_t origin = 0;
+  int diff[3] = {0, 0, 0};
+  int cnt = 0;
+
+  CHECK("RIB create", (rib = bgpstream_rib_create()) != NULL);
+  CHECK("RIB elem create", (elem = bgpstream_elem_create()) != NULL);
+
+  begin(BGPSTREAM_RIB, 1000, BGPSTREAM_DUMP_START);
+  CHECK("RIB add dump elems",
+        add(BGPSTREAM_ELEM_TYPE_RIB, PEER_A, PEER_A_ASN, "10.0.0.0/8", 1) ==
+            1 &&
+          add(BGPSTREAM_ELEM_TYPE_RIB, PEER_B, PEER_B_ASN, "10.0.0.0/8", 1) ==
+            1);
+  bgpstream_rib_end_record(rib, &record);
+  begin(BGPSTREAM_RIB, 1000, BGPSTREAM_DUMP_END);
+  add(BGPSTREAM_ELEM_TYPE_RIB, PEER_A, PEER_A_ASN, "10.1.0.0/16", 2);
+  bgpstream_rib_end_record(rib, &record);
+  CHECK("RIB dump counts", bgpstream_rib_get_pfx_cnt(rib) == 2 &&
+                             bgpstream_rib_get_route_cnt(rib) == 3);
+
+  CHECK("RIB get route", bgpstream_rib_get_route(rib, peer_id(PEER_A,
+                                                              PEER_A_ASN),
+                                                 pfx("10.1.0.0/16"),
+                                                 &route) == 1);
+  path = bgpstream_rib_get_as_path(rib, &route);
+  CHECK("RIB route path",
+        path != NULL && bgpstream_as_path_get_origin_val(path, &origin) == 0 &&
+          origin == 2);
+  bgpstream_as_path_destroy(path);
+  CHECK("RIB route attributes",
+        bgpstream_rib_get_next_hop(rib, &route) != NULL &&
+          bgpstream_community_set_size(
+            bgpstream_rib_get_communities(rib, &route)) == 1);
+
+  CHECK("RIB mark", bgpstream_rib_mark(rib) == 0);
+  begin(BGPSTREAM_UPDATE, 1010, BGPSTREAM_DUMP_START);
+  add(BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT, PEER_A, PEER_A_ASN, "10.2.0.0/16", 3);
+  add(BGPSTREAM_ELEM_TYPE_WITHDRAWAL, PEER_A, PEER_A_ASN, "10.0.0.0/8", 0);
+  // announced again, unchanged
+  add(BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT, PEER_A, PEER_A_ASN, "10.1.0.0/16", 2);
+  // changed origin
+  add(BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT, PEER_B, PEER_B_ASN, "10.0.0.0/8", 4);
+  bgpstream_rib_end_record(rib, &record);
+  CHECK("RIB updates", bgpstream_rib_get_route_cnt(rib) == 3 &&
+                         !has_route(PEER_A, PEER_A_ASN, "10.0.0.0/8") &&
+                         has_route(PEER_A, PEER_A_ASN, "10.2.0.0/16"));
+  CHECK("RIB diff",
+        bgpstream_rib_diff(rib, count_diff, diff) == 0 && diff[0] == 1 &&
+          diff[1] == 1 && diff[2] == 1);
+
+  CHECK("RIB walk", bgpstream_rib_walk(rib, 0, count_route, &cnt) == 0 &&
+                      cnt == 3);
+  cnt = 0;
+  CHECK("RIB walk peer",
+        bgpstream_rib_walk(rib, peer_id(PEER_A, PEER_A_ASN), count_route,
+                           &cnt) == 0 &&
+          cnt == 2);
+  return 0;
+}
+
+static int test_rib_resync()
+{
+  bgpstream_rib_peer_info_t info;
+
+  // a withdrawal seen while the dump is applied is not undone by it
+  begin(BGPSTREAM_RIB, 2000, BGPSTREAM_DUMP_START);
+  add(BGPSTREAM_ELEM_TYPE_RIB, PEER_B, PEER_B_ASN, "10.0.0.0/8", 1);
+  bgpstream_rib_end_record(rib, &record);
+  begin(BGPSTREAM_UPDATE, 2005, BGPSTREAM_DUMP_START);
+  add(BGPSTREAM_ELEM_TYPE_WITHDRAWAL, PEER_A, PEER_A_ASN, "10.1.0.0/16", 0);
+  bgpstream_rib_end_record(rib, &record);
+  begin(BGPSTREAM_RIB, 2000, BGPSTREAM_DUMP_END);
+  add(BGPSTREAM_ELEM_TYPE_RIB, PEER_A, PEER_A_ASN, "10.1.0.0/16", 2);
+  bgpstream_rib_end_record(rib, &record);
+  CHECK("RIB dump replaces routes",
+        bgpstream_rib_get_route_cnt(rib) == 1 &&
+          bgpstream_rib_get_pfx_cnt(rib) == 1 &&
+          has_route(PEER_B, PEER_B_ASN, "10.0.0.0/8") &&
+          !has_route(PEER_A, PEER_A_ASN, "10.1.0.0/16") &&
+          !has_route(PEER_A, PEER_A_ASN, "10.2.0.0/16"));
+
+  // routes not announced again before the End-of-RIB marker are stale
+  begin(BGPSTREAM_UPDATE, 3000, BGPSTREAM_DUMP_START);
+  peerstate(PEER_B, PEER_B_ASN, BGPSTREAM_ELEM_PEERSTATE_ESTABLISHED);
+  add(BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT, PEER_B, PEER_B_ASN, "10.3.0.0/16", 1);
+  CHECK("RIB peer syncing",
+        bgpstream_rib_get_peer_info(rib, peer_id(PEER_B, PEER_B_ASN), &info) ==
+            0 &&
+          info.syncing && info.routes_cnt == 2);
+  add(BGPSTREAM_ELEM_TYPE_END_OF_RIB, PEER_B, PEER_B_ASN, NULL, 0);
+  CHECK("RIB End-of-RIB", !has_route(PEER_B, PEER_B_ASN, "10.0.0.0/8") &&
+                            has_route(PEER_B, PEER_B_ASN, "10.3.0.0/16"));
+
+  peerstate(PEER_B, PEER_B_ASN, BGPSTREAM_ELEM_PEERSTATE_IDLE);
+  bgpstream_rib_end_record(rib, &record);
+  CHECK("RIB peer down",
+        bgpstream_rib_get_peer_info(rib, peer_id(PEER_B, PEER_B_ASN), &info) ==
+            0 &&
+          info.state == BGPSTREAM_ELEM_PEERSTATE_IDLE &&
+          info.routes_cnt == 0 && bgpstream_rib_get_route_cnt(rib) == 0 &&
+          bgpstream_rib_get_pfx_cnt(rib) == 0);
+
+  bgpstream_rib_clear(rib);
+  CHECK("RIB clear", bgpstream_rib_get_peer_info(rib, 1, &info) != 0);
+
+  bgpstream_elem_destroy(elem);
+  bgpstream_rib_destroy(rib);
+  return 0;
+}
+
+static int test_rib_save()
+{
+  bgpstream_rib_t *saved;
+  bgpstream_rib_route_t route;
+  bgpstream_rib_peer_info_t info;
+  int cnt = 0;
+
+  CHECK("RIB create", (rib = bgpstream_rib_create()) != NULL);
+  CHECK("RIB elem create", (elem = bgpstream_elem_create()) != NULL);
+  begin(BGPSTREAM_RIB, 1000, BGPSTREAM_DUMP_START);
+  add(BGPSTREAM_ELEM_TYPE_RIB, PEER_A, PEER_A_ASN, "10.0.0.0/8", 1);
+  add(BGPSTREAM_ELEM_TYPE_RIB, PEER_B, PEER_B_ASN, "10.0.0.0/8", 1);
+  add(BGPSTREAM_ELEM_TYPE_RIB, PEER_B, PEER_B_ASN, "2001:db8::/32", 2);
+  bgpstream_rib_end_record(rib, &record);
+  begin(BGPSTREAM_UPDATE, 1500, BGPSTREAM_DUMP_START);
+  peerstate(PEER_A, PEER_A_ASN, BGPSTREAM_ELEM_PEERSTATE_ESTABLISHED);
+  bgpstream_rib_end_record(rib, &record);
+
+  CHECK("RIB save", bgpstream_rib_save(rib, RIB_FILE) == 0);
+  saved = rib;
+  CHECK("RIB load", (rib = bgpstream_rib_create()) != NULL &&
+                      bgpstream_rib_load(rib, RIB_FILE) == 0);
+  CHECK("RIB load into used RIB", bgpstream_rib_load(saved, RIB_FILE) != 0);
+  bgpstream_rib_destroy(saved);
+
+  CHECK("RIB loaded counts",
+        bgpstream_rib_get_pfx_cnt(rib) == 2 &&
+          bgpstream_rib_get_route_cnt(rib) == 3 &&
+          bgpstream_rib_walk(rib, 0, count_route, &cnt) == 0 && cnt == 3 &&
+          bgpstream_rib_get_last_time(rib) == 1500);
+  CHECK("RIB loaded route",
+        bgpstream_rib_get_route(rib, peer_id(PEER_B, PEER_B_ASN),
+                                pfx("2001:db8::/32"), &route) == 1 &&
+          bgpstream_community_set_size(
+            bgpstream_rib_get_communities(rib, &route)) == 1);
+  // the dump was still being applied when the RIB was saved
+  CHECK("RIB loaded peers",
+        bgpstream_rib_get_peer_info(rib, peer_id(PEER_A, PEER_A_ASN), &info) ==
+            0 &&
+          info.state == BGPSTREAM_ELEM_PEERSTATE_ESTABLISHED &&
+          info.syncing && info.routes_cnt == 1);
+
+  // carry on applying the dump
+  begin(BGPSTREAM_RIB, 1000, BGPSTREAM_DUMP_END);
+  add(BGPSTREAM_ELEM_TYPE_RIB, PEER_A, PEER_A_ASN, "10.1.0.0/16", 1);
+  bgpstream_rib_end_record(rib, &record);
+  CHECK("RIB loaded dump end", bgpstream_rib_get_route_cnt(rib) == 4);
+
+  bgpstream_elem_destroy(elem);
+  bgpstream_rib_destroy(rib);
+  remove(RIB_FILE);
+  remove(RIB_FILE ".paths");
+  return 0;
+}
+
+static int test_rib_delta()
+{
+  int purged = 0;
+
+  CHECK("RIB create", (rib = bgpstream_rib_create()) != NULL);
+  CHECK("RIB elem create", (elem = bgpstream_elem_create()) != NULL);
+  bgpstream_rib_set_purge_cb(rib, count_route, &purged);
+
+  begin(BGPSTREAM_RIB, 1000, BGPSTREAM_DUMP_START);
+  CHECK("first dump changes routes",
+        add(BGPSTREAM_ELEM_TYPE_RIB, PEER_A, PEER_A_ASN, "10.0.0.0/8", 1) ==
+            1 &&
+          add(BGPSTREAM_ELEM_TYPE_RIB, PEER_A, PEER_A_ASN, "11.0.0.0/8", 1) ==
+            1 &&
+          add(BGPSTREAM_ELEM_TYPE_RIB, PEER_A, PEER_A_ASN, "12.0.0.0/8", 1) ==
+            1);
+  record.dump_pos = BGPSTREAM_DUMP_END;
+  bgpstream_rib_end_record(rib, &record);
+
+  begin(BGPSTREAM_RIB, 2000, BGPSTREAM_DUMP_START);
+  CHECK("unchanged route",
+        add(BGPSTREAM_ELEM_TYPE_RIB, PEER_A, PEER_A_ASN, "10.0.0.0/8", 1) ==
+          0);
+  CHECK("changed route",
+        add(BGPSTREAM_ELEM_TYPE_RIB, PEER_A, PEER_A_ASN, "11.0.0.0/8", 2) ==
+          1);
+  CHECK("new route",
+        add(BGPSTREAM_ELEM_TYPE_RIB, PEER_A, PEER_A_ASN, "13.0.0.0/8", 1) ==
+          1);
+  record.dump_pos = BGPSTREAM_DUMP_END;
+  bgpstream_rib_end_record(rib, &record);
+  CHECK("route not in the dump purged",
+        purged == 1 && !has_route(PEER_A, PEER_A_ASN, "12.0.0.0/8") &&
+          bgpstream_rib_get_route_cnt(rib) == 3);
+
+  begin(BGPSTREAM_UPDATE, 2500, BGPSTREAM_DUMP_START);
+  CHECK("withdrawals",
+        add(BGPSTREAM_ELEM_TYPE_WITHDRAWAL, PEER_A, PEER_A_ASN, "10.0.0.0/8",
+            0) == 1 &&
+          add(BGPSTREAM_ELEM_TYPE_WITHDRAWAL, PEER_A, PEER_A_ASN,
+              "10.0.0.0/8", 0) == 0);
+  CHECK("session down purges routes",
+        peerstate(PEER_A, PEER_A_ASN, BGPSTREAM_ELEM_PEERSTATE_IDLE) == 0 &&
+          purged == 3 && bgpstream_rib_get_route_cnt(rib) == 0);
+
+  bgpstream_elem_destroy(elem);
+  bgpstream_rib_destroy(rib);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("RIB dump and updates", test_rib_dump() == 0);
+  CHECK_SECTION("RIB resync", test_rib_resync() == 0);
+  CHECK_SECTION("RIB save and load", test_rib_save() == 0);
+  CHECK_SECTION("RIB dump deltas", test_rib_delta() == 0);
+  ENDTEST;
+  return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+#include "bgpstream_utils_roa.h"
+
+#include <stdio.h>
+
+#define ROA_CSV "bgpstream-test-roa.csv"
+
+static bgpstream_pfx_t *pfx(const char *str)
+{
+  static bgpstream_pfx_t p[4];
+  static int i = 0;
+
+  i = (i + 1) % 4;
+  return bgpstream_str2pfx(str, &p[i]);
+}
+
+static int test_roa_index()
+{
+  bgpstream_roa_index_t *idx;
+
+  CHECK("ROA index create", (idx = bgpstream_roa_index_create()) != NULL);
+
+  CHECK("ROA index add",
+        bgpstream_roa_index_add(idx, pfx("192.0.2.0/24"), 24, 64500) == 0 &&
+          bgpstream_roa_index_add(idx, pfx("198.51.0.0/16"), 20, 64501) == 0 &&
+          bgpstream_roa_index_add(idx, pfx("198.51.100.0/24"), 24, 64502) ==
+            0 &&
+          bgpstream_roa_index_add(idx, pfx("10.0.0.0/8"), 8, 0) == 0 &&
+          bgpstream_roa_index_add(idx, pfx("2001:db8::/32"), 48, 64503) == 0);
+  CHECK("ROA index add duplicate",
+        bgpstream_roa_index_add(idx, pfx("192.0.2.0/24"), 24, 64500) == 0 &&
+          bgpstream_roa_index_get_roa_cnt(idx) == 5);
+  CHECK("ROA index add bad max length",
+        bgpstream_roa_index_add(idx, pfx("192.0.2.0/24"), 23, 64500) != 0 &&
+          bgpstream_roa_index_add(idx, pfx("192.0.2.0/24"), 33, 64500) != 0);
+
+  CHECK("ROA validate valid",
+        bgpstream_roa_index_validate(idx, pfx("192.0.2.0/24"), 64500) ==
+            BGPSTREAM_ROA_VALID &&
+          bgpstream_roa_index_validate(idx, pfx("198.51.16.0/20"), 64501) ==
+            BGPSTREAM_ROA_VALID &&
+          bgpstream_roa_index_validate(idx, pfx("198.51.100.0/24"), 64502) ==
+            BGPSTREAM_ROA_VALID &&
+          bgpstream_roa_index_validate(idx, pfx("2001:db8:1::/48"), 64503) ==
+            BGPSTREAM_ROA_VALID);
+  CHECK("ROA validate invalid ASN",
+        bgpstream_roa_index_validate(idx, pfx("192.0.2.0/24"), 64501) ==
+            BGPSTREAM_ROA_INVALID_ASN &&
+          bgpstream_roa_index_validate(idx, pfx("10.1.0.0/16"), 0) ==
+            BGPSTREAM_ROA_INVALID_ASN);
+  CHECK("ROA validate invalid length",
+        bgpstream_roa_index_validate(idx, pfx("192.0.2.128/25"), 64500) ==
+            BGPSTREAM_ROA_INVALID_LENGTH &&
+          bgpstream_roa_index_validate(idx, pfx("198.51.100.0/24"), 64501) ==
+            BGPSTREAM_ROA_INVALID_LENGTH);
+  CHECK("ROA validate not found",
+        bgpstream_roa_index_validate(idx, pfx("203.0.113.0/24"), 64500) ==
+            BGPSTREAM_ROA_NOT_FOUND &&
+          bgpstream_roa_index_validate(idx, pfx("192.0.0.0/16"), 64500) ==
+            BGPSTREAM_ROA_NOT_FOUND &&
+          bgpstream_roa_index_validate(idx, pfx("2001:db9::/32"), 64503) ==
+            BGPSTREAM_ROA_NOT_FOUND);
+
+  bgpstream_roa_index_clear(idx);
+  CHECK("ROA index clear",
+        bgpstream_roa_index_get_roa_cnt(idx) == 0 &&
+          bgpstream_roa_index_validate(idx, pfx("192.0.2.0/24"), 64500) ==
+            BGPSTREAM_ROA_NOT_FOUND);
+
+  bgpstream_roa_index_destroy(idx);
+  return 0;
+}
+
+static int test_roa_index_batch()
+{
+  bgpstream_roa_index_t *idx;
+  bgpstream_pfx_t p[3];
+  const bgpstream_pfx_t *pfxs[5] = {&p[0], &p[0], &p[0], &p[1], &p[2]};
+  uint32_t origins[5] = {64500, 64501, 64500, 64500, 64500};
+  bgpstream_roa_validity_t res[5];
+  FILE *f;
+
+  CHECK("ROA CSV write", (f = fopen(ROA_CSV, "w")) != NULL);
+  fprintf(f, "ASN,IP Prefix,Max Length,Trust Anchor\n"
+             "AS64500,192.0.2.0/24,24,test\n"
+             "64501,198.51.100.0/22,24,test\n");
+  fclose(f);
+
+  CHECK("ROA index create", (idx = bgpstream_roa_index_create()) != NULL);
+  CHECK("ROA index load CSV",
+        bgpstream_roa_index_load_csv(idx, ROA_CSV) == 2 &&
+          bgpstream_roa_index_get_roa_cnt(idx) == 2);
+
+  bgpstream_str2pfx("192.0.2.0/24", &p[0]);
+  bgpstream_str2pfx("198.51.101.0/24", &p[1]);
+  bgpstream_str2pfx("203.0.113.0/24", &p[2]);
+  bgpstream_roa_index_validate_batch(idx, pfxs, origins, 5, res);
+  CHECK("ROA validate batch",
+        res[0] == BGPSTREAM_ROA_VALID && res[1] == BGPSTREAM_ROA_INVALID_ASN &&
+          res[2] == BGPSTREAM_ROA_VALID &&
+          res[3] == BGPSTREAM_ROA_INVALID_ASN &&
+          res[4] == BGPSTREAM_ROA_NOT_FOUND);
+
+  bgpstream_roa_index_destroy(idx);
+  remove(ROA_CSV);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("ROA index", test_roa_index() == 0);
+  CHECK_SECTION("ROA index batch", test_roa_index_batch() == 0);
+  ENDTEST;
+  return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RANDOM_TEST_ID_CNT 5000
+
+static const int id_set_sizes[] = {0, 1, 7, 32, 33, 1000, RANDOM_TEST_ID_CNT};
+
+// check every id in [0, max) against a plain array
+static int check_ids(bgpstream_id_set_t *set, const uint32_t *ids, int cnt,
+                     uint32_t max)
+{
+  uint32_t id;
+  int i, found;
+
+  for (id = 0; id < max; id++) {
+    for (i = 0, found = 0; i < cnt && found == 0; i++) {
+      found = ids[i] == id;
+    }
+    if (bgpstream_id_set_exists(set, id) != found) {
+      return -1;
+    }
+  }
+  for (i = 0; i < cnt; i++) {
+    if (bgpstream_id_set_exists(set, ids[i]) == 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int test_id_set_freeze()
+{
+  bgpstream_id_set_t *set;
+  uint32_t ids[RANDOM_TEST_ID_CNT + 1];
+  int s, i, cnt;
+
+  srand(42);
+  for (s = 0; s < (int)(sizeof(id_set_sizes) / sizeof(int)); s++) {
+    CHECK("ID set create", (set = bgpstream_id_set_create()) != NULL);
+    for (cnt = 0; cnt < id_set_sizes[s];) {
+      ids[cnt] = rand() & 0x7fff;
+      cnt += bgpstream_id_set_insert(set, ids[cnt]);
+    }
+    // a large id, to exercise the end of the sorted array
+    if (cnt != 0) {
+      ids[cnt - 1] = UINT32_MAX;
+      bgpstream_id_set_insert(set, UINT32_MAX);
+      bgpstream_id_set_clear(set);
+      for (i = 0; i < cnt; i++) {
+        bgpstream_id_set_insert(set, ids[i]);
+      }
+    }
+
+    CHECK("ID set freeze", bgpstream_id_set_freeze(set) == 0);
+    CHECK("ID set frozen size", bgpstream_id_set_size(set) == cnt);
+    CHECK("ID set frozen lookups", check_ids(set, ids, cnt, 0x8000) == 0);
+    CHECK("ID set frozen missing max",
+          cnt != 0 || bgpstream_id_set_exists(set, UINT32_MAX) == 0);
+
+    // modifying the set drops the frozen table
+    ids[cnt] = 0x8000;
+    CHECK("ID set insert after freeze",
+          bgpstream_id_set_insert(set, ids[cnt]) == 1);
+    CHECK("ID set lookups after insert",
+          check_ids(set, ids, cnt + 1, 0x8001) == 0);
+
+    CHECK("ID set refreeze", bgpstream_id_set_freeze(set) == 0);
+    CHECK("ID set refrozen lookups",
+          check_ids(set, ids, cnt + 1, 0x8001) == 0);
+
+    bgpstream_id_set_clear(set);
+    CHECK("ID set clear after freeze",
+          bgpstream_id_set_exists(set, ids[cnt]) == 0);
+    bgpstream_id_set_destroy(set);
+  }
+
+  return 0;
+}
+
+static int test_str_set_freeze()
+{
+  bgpstream_str_set_t *set;
+  char buf[16];
+  int i, ok;
+
+  CHECK("String set create", (set = bgpstream_str_set_create()) != NULL);
+  CHECK("String set freeze empty", bgpstream_str_set_freeze(set) == 0);
+  CHECK("String set frozen empty lookup",
+        bgpstream_str_set_exists(set, "rrc00") == 0);
+
+  for (i = 0; i < 100; i += 2) {
+    snprintf(buf, sizeof(buf), "rrc%02d", i);
+    bgpstream_str_set_insert(set, buf);
+  }
+  CHECK("String set freeze", bgpstream_str_set_freeze(set) == 0);
+  for (i = 0, ok = 1; i < 100; i++) {
+    snprintf(buf, sizeof(buf), "rrc%02d", i);
+    ok &= bgpstream_str_set_exists(set, buf) == ((i & 1) == 0);
+  }
+  CHECK("String set frozen lookups", ok);
+  CHECK("String set frozen lookup prefix",
+        bgpstream_str_set_exists(set, "rrc") == 0);
+
+  CHECK("String set remove after freeze",
+        bgpstream_str_set_remove(set, "rrc00") == 1);
+  CHECK("String set lookup after remove",
+        bgpstream_str_set_exists(set, "rrc00") == 0 &&
+          bgpstream_str_set_exists(set, "rrc02") == 1);
+
+  bgpstream_str_set_destroy(set);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("ID set freeze", test_id_set_freeze() == 0);
+  CHECK_SECTION("String set freeze", test_str_set_freeze() == 0);
+  ENDTEST;
+  return 0;
+}
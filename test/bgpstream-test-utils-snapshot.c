@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bgpstream_test.h"
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAPSHOT_FILE "bgpstream-test-snapshot.bin"
+
+#define IPV4_TEST_PFX_B "130.217.0.0/16"
+#define IPV4_TEST_PFX_B_CHILD "130.217.250.0/24"
+#define IPV4_TEST_PFX_B_GRANDCHILD "130.217.250.128/25"
+#define IPV4_TEST_HOST_B "130.217.1.1/32"
+#define IPV4_TEST_HOST_B_GRANDCHILD "130.217.250.129/32"
+#define IPV4_TEST_HOST_NONE "192.0.2.1/32"
+
+#define IPV6_TEST_PFX_A "2001:500:88::/48"
+#define IPV6_TEST_PFX_A_CHILD "2001:500:88:beef::/64"
+#define IPV6_TEST_HOST_A_CHILD "2001:500:88:beef::1/128"
+
+// random prefixes and lookups checked against a linear scan
+#define RANDOM_TEST_PFX_CNT 2000
+#define RANDOM_TEST_LOOKUP_CNT 5000
+
+static ssize_t serialize_user(const void *user, uint8_t *buf, size_t len,
+                              void *data)
+{
+  if (len >= sizeof(uint32_t)) {
+    memcpy(buf, user, sizeof(uint32_t));
+  }
+  return sizeof(uint32_t);
+}
+
+static int deserialize_user(const uint8_t *buf, size_t len, void **user_p,
+                            void *data)
+{
+  if (len != sizeof(uint32_t) || (*user_p = malloc(len)) == NULL) {
+    return -1;
+  }
+  memcpy(*user_p, buf, len);
+  return 0;
+}
+
+static void insert_user(bgpstream_patricia_tree_t *pt, const char *str,
+                        uint32_t value)
+{
+  bgpstream_patricia_node_t *node;
+  bgpstream_pfx_t pfx;
+  uint32_t *user = malloc(sizeof(uint32_t));
+
+  *user = value;
+  node = bgpstream_patricia_tree_insert(pt, bgpstream_str2pfx(str, &pfx));
+  bgpstream_patricia_tree_set_user(pt, node, user);
+}
+
+static int pfx_is(const bgpstream_snapshot_t *snap, uint32_t idx,
+                  const char *str)
+{
+  bgpstream_pfx_t pfx, expected;
+  return idx != BGPSTREAM_SNAPSHOT_NONE &&
+         bgpstream_snapshot_get_pfx(snap, idx, &pfx) == 0 &&
+         bgpstream_pfx_equal(&pfx, bgpstream_str2pfx(str, &expected));
+}
+
+static uint32_t lookup(const bgpstream_snapshot_t *snap, const char *str)
+{
+  bgpstream_pfx_t pfx;
+  return bgpstream_snapshot_lookup(snap, bgpstream_str2pfx(str, &pfx));
+}
+
+static int user_is(const bgpstream_snapshot_t *snap, uint32_t idx,
+                   uint32_t value)
+{
+  const uint8_t *buf;
+  size_t len;
+  return (buf = bgpstream_snapshot_get_user_data(snap, idx, &len)) != NULL &&
+         len == sizeof(uint32_t) && memcmp(buf, &value, len) == 0;
+}
+
+static int test_snapshot_patricia()
+{
+  bgpstream_patricia_tree_t *pt;
+  bgpstream_patricia_node_t *node;
+  bgpstream_snapshot_t *snap;
+  bgpstream_pfx_t pfx;
+
+  pt = bgpstream_patricia_tree_create(free);
+  insert_user(pt, IPV4_TEST_PFX_B, 1);
+  insert_user(pt, IPV4_TEST_PFX_B_CHILD, 2);
+  insert_user(pt, IPV4_TEST_PFX_B_GRANDCHILD, 3);
+  insert_user(pt, IPV6_TEST_PFX_A, 4);
+  insert_user(pt, IPV6_TEST_PFX_A_CHILD, 5);
+
+  CHECK("Snapshot write (Patricia Tree)",
+        bgpstream_snapshot_write_patricia(SNAPSHOT_FILE, pt, serialize_user,
+                                          NULL) == 0);
+  bgpstream_patricia_tree_destroy(pt);
+
+  CHECK("Snapshot open",
+        (snap = bgpstream_snapshot_open(SNAPSHOT_FILE)) != NULL &&
+        bgpstream_snapshot_get_pfx_cnt(snap) == 5);
+
+  CHECK("Snapshot search exact",
+        user_is(snap,
+                bgpstream_snapshot_search_exact(
+                  snap, bgpstream_str2pfx(IPV4_TEST_PFX_B_CHILD, &pfx)),
+                2) &&
+        bgpstream_snapshot_search_exact(
+          snap, bgpstream_str2pfx(IPV4_TEST_HOST_B, &pfx)) ==
+          BGPSTREAM_SNAPSHOT_NONE);
+
+  CHECK("Snapshot lookup",
+        pfx_is(snap, lookup(snap, IPV4_TEST_HOST_B), IPV4_TEST_PFX_B) &&
+        pfx_is(snap, lookup(snap, IPV4_TEST_HOST_B_GRANDCHILD),
+               IPV4_TEST_PFX_B_GRANDCHILD) &&
+        pfx_is(snap, lookup(snap, IPV4_TEST_PFX_B_CHILD),
+               IPV4_TEST_PFX_B_CHILD) &&
+        pfx_is(snap, lookup(snap, IPV6_TEST_HOST_A_CHILD),
+               IPV6_TEST_PFX_A_CHILD) &&
+        user_is(snap, lookup(snap, IPV6_TEST_HOST_A_CHILD), 5));
+  CHECK("Snapshot lookup (no match)",
+        lookup(snap, IPV4_TEST_HOST_NONE) == BGPSTREAM_SNAPSHOT_NONE);
+
+  CHECK("Snapshot load (Patricia Tree)",
+        (pt = bgpstream_snapshot_load_patricia(snap, free, deserialize_user,
+                                               NULL)) != NULL &&
+        bgpstream_patricia_prefix_count(pt, BGPSTREAM_ADDR_VERSION_IPV4) ==
+          3 &&
+        bgpstream_patricia_prefix_count(pt, BGPSTREAM_ADDR_VERSION_IPV6) ==
+          2 &&
+        (node = bgpstream_patricia_tree_search_exact(
+           pt, bgpstream_str2pfx(IPV4_TEST_PFX_B_GRANDCHILD, &pfx))) != NULL &&
+        *(uint32_t *)bgpstream_patricia_tree_get_user(node) == 3);
+
+  bgpstream_patricia_tree_destroy(pt);
+  bgpstream_snapshot_close(snap);
+  return 0;
+}
+
+static int test_snapshot_random()
+{
+  bgpstream_patricia_tree_t *pt;
+  bgpstream_snapshot_t *snap;
+  bgpstream_pfx_t *pfxs, host, found;
+  int i, j, best, ok = 1;
+  uint32_t idx;
+
+  pfxs = malloc(sizeof(bgpstream_pfx_t) * RANDOM_TEST_PFX_CNT);
+  pt = bgpstream_patricia_tree_create(NULL);
+
+  // addresses are drawn from a small space so that prefixes overlap
+  srand(42);
+  for (i = 0; i < RANDOM_TEST_PFX_CNT; i++) {
+    if (i & 1) {
+      bgpstream_str2pfx("10.0.0.0/8", &pfxs[i]);
+      pfxs[i].bs_ipv4.address.addr.s_addr =
+        htonl(0x0a000000 | (rand() & 0xffff));
+      pfxs[i].mask_len = 8 + rand() / (RAND_MAX / 25 + 1);
+    } else {
+      bgpstream_str2pfx("2001:db8::/32", &pfxs[i]);
+      pfxs[i].bs_ipv6.address.addr.s6_addr[4] = rand();
+      pfxs[i].bs_ipv6.address.addr.s6_addr[5] = rand();
+      pfxs[i].mask_len = 32 + rand() / (RAND_MAX / 33 + 1);
+    }
+    bgpstream_addr_mask(&pfxs[i].address, pfxs[i].mask_len);
+    bgpstream_patricia_tree_insert(pt, &pfxs[i]);
+  }
+  CHECK("Snapshot write (random prefixes)",
+        bgpstream_snapshot_write_patricia(SNAPSHOT_FILE, pt, NULL, NULL) ==
+          0 &&
+        (snap = bgpstream_snapshot_open(SNAPSHOT_FILE)) != NULL);
+  bgpstream_patricia_tree_destroy(pt);
+
+  for (i = 0; i < RANDOM_TEST_LOOKUP_CNT; i++) {
+    // an address or a prefix near one of the prefixes
+    j = rand() / (RAND_MAX / RANDOM_TEST_PFX_CNT + 1);
+    bgpstream_pfx_copy(&host, &pfxs[j]);
+    if (host.address.version == BGPSTREAM_ADDR_VERSION_IPV4) {
+      host.bs_ipv4.address.addr.s_addr ^= htonl(rand() & 0x3ff);
+      host.mask_len = 16 + rand() / (RAND_MAX / 17 + 1);
+    } else {
+      host.bs_ipv6.address.addr.s6_addr[7] ^= rand();
+      host.mask_len = 48 + rand() / (RAND_MAX / 81 + 1);
+    }
+    bgpstream_addr_mask(&host.address, host.mask_len);
+
+    best = -1;
+    for (j = 0; j < RANDOM_TEST_PFX_CNT; j++) {
+      if (bgpstream_pfx_contains(&pfxs[j], &host) &&
+          (best < 0 || pfxs[j].mask_len > pfxs[best].mask_len)) {
+        best = j;
+      }
+    }
+    idx = bgpstream_snapshot_lookup(snap, &host);
+    if (best < 0 ? idx != BGPSTREAM_SNAPSHOT_NONE
+                 : (bgpstream_snapshot_get_pfx(snap, idx, &found) != 0 ||
+                    !bgpstream_pfx_equal(&found, &pfxs[best]))) {
+      ok = 0;
+    }
+  }
+  CHECK("Snapshot lookup (random prefixes)", ok != 0);
+
+  bgpstream_snapshot_close(snap);
+  free(pfxs);
+  return 0;
+}
+
+static int test_snapshot_pfx_set()
+{
+  bgpstream_pfx_set_t *set;
+  bgpstream_snapshot_t *snap = NULL;
+  bgpstream_pfx_t pfx;
+  FILE *f;
+
+  set = bgpstream_pfx_set_create();
+  bgpstream_pfx_set_insert(set, bgpstream_str2pfx(IPV4_TEST_PFX_B, &pfx));
+  bgpstream_pfx_set_insert(set, bgpstream_str2pfx(IPV4_TEST_PFX_B_CHILD, &pfx));
+  bgpstream_pfx_set_insert(set, bgpstream_str2pfx(IPV6_TEST_PFX_A, &pfx));
+
+  CHECK("Snapshot write (prefix set)",
+        bgpstream_snapshot_write_pfx_set(SNAPSHOT_FILE, set) == 0 &&
+        (snap = bgpstream_snapshot_open(SNAPSHOT_FILE)) != NULL &&
+        bgpstream_snapshot_get_pfx_cnt(snap) == 3 &&
+        bgpstream_snapshot_get_user_data(snap, 0, NULL) == NULL);
+  bgpstream_pfx_set_clear(set);
+
+  CHECK("Snapshot load (prefix set)",
+        snap != NULL && bgpstream_snapshot_load_pfx_set(snap, set) == 0 &&
+        bgpstream_pfx_set_size(set) == 3 &&
+        bgpstream_pfx_set_exists(
+          set, bgpstream_str2pfx(IPV4_TEST_PFX_B_CHILD, &pfx)) == 1);
+  bgpstream_snapshot_close(snap);
+  bgpstream_pfx_set_destroy(set);
+
+  // a file that is not a snapshot is rejected
+  f = fopen(SNAPSHOT_FILE, "w");
+  fprintf(f, "this is not a snapshot, although it is long enough to hold "
+             "a snapshot header\n");
+  fclose(f);
+  CHECK("Snapshot open (invalid file)",
+        bgpstream_snapshot_open(SNAPSHOT_FILE) == NULL);
+
+  remove(SNAPSHOT_FILE);
+  return 0;
+}
+
+int main()
+{
+  CHECK_SECTION("Snapshot Patricia Tree", test_snapshot_patricia() == 0);
+  CHECK_SECTION("Snapshot random", test_snapshot_random() == 0);
+  CHECK_SECTION("Snapshot prefix set", test_snapshot_pfx_set() == 0);
+  ENDTEST;
+  return 0;
+}
@@ -26,16 +26,25 @@
 
 #include "bgpstream_test.h"
 
+#include "bgpstream_elem_generator.h"
+#include "bgpstream_record_int.h"
+#include "bgpstream_reorder.h"
+#include "bgpstream_utils_as_path_int.h"
 #include "utils.h"
 
+#include <fcntl.h>
+#include <poll.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <wandio.h>
 
 #define singlefile_RECORDS 537347
 #define csvfile_RECORDS 559424
 #define sqlite_RECORDS 538308
 #define broker_RECORDS 2153
+#define directory_RECORDS 559424
 
 static bgpstream_t *bs;
 static bgpstream_record_t *rec;
@@ -57,6 +66,52 @@ static bgpstream_data_interface_option_t *option;
           counter == interface##_RECORDS);                                     \
   } while (0)
 
+#define BATCH_SIZE 256
+
+#define RUN_BATCH(interface)                                                   \
+  do {                                                                         \
+    bgpstream_record_t *recs[BATCH_SIZE];                                      \
+    int ret;                                                                   \
+    int i;                                                                     \
+    int counter = 0;                                                           \
+    CHECK("stream start (" STR(interface) ")", bgpstream_start(bs) == 0);      \
+    CHECK("empty batch (" STR(interface) ")",                                  \
+          bgpstream_get_next_records(bs, recs, 0) == -1);                      \
+    while ((ret = bgpstream_get_next_records(bs, recs, BATCH_SIZE)) > 0) {     \
+      for (i = 0; i < ret; i++) {                                              \
+        if (recs[i]->status == BGPSTREAM_RECORD_STATUS_VALID_RECORD) {         \
+          counter++;                                                           \
+        }                                                                      \
+      }                                                                        \
+    }                                                                          \
+    CHECK("final return code (" STR(interface) ")", ret == 0);                 \
+    CHECK("read records (" STR(interface) ")",                                 \
+          counter == interface##_RECORDS);                                     \
+  } while (0)
+
+// as RUN, but waits on the stream's fd whenever it would block
+#define RUN_NONBLOCKING(interface)                                             \
+  do {                                                                         \
+    struct pollfd pfd;                                                         \
+    int ret;                                                                   \
+    int counter = 0;                                                           \
+    CHECK("stream start (" STR(interface) ")", bgpstream_start(bs) == 0);      \
+    CHECK("get fd (" STR(interface) ")",                                       \
+          (pfd.fd = bgpstream_get_fd(bs)) >= 0);                               \
+    pfd.events = POLLIN;                                                       \
+    while ((ret = bgpstream_get_next_record(bs, &rec)) > 0 ||                  \
+           ret == BGPSTREAM_WOULD_BLOCK) {                                     \
+      if (ret == BGPSTREAM_WOULD_BLOCK) {                                      \
+        poll(&pfd, 1, 1000);                                                   \
+      } else if (rec->status == BGPSTREAM_RECORD_STATUS_VALID_RECORD) {        \
+        counter++;                                                             \
+      }                                                                        \
+    }                                                                          \
+    CHECK("final return code (" STR(interface) ")", ret == 0);                 \
+    CHECK("read records (" STR(interface) ")",                                 \
+          counter == interface##_RECORDS);                                     \
+  } while (0)
+
 #define SETUP                                                                  \
   do {                                                                         \
     bs = bgpstream_create();                                                   \
@@ -76,40 +131,1983 @@ static bgpstream_data_interface_option_t *option;
     bgpstream_set_data_interface(bs, di_id);                                   \
   } while (0)
 
-static int test_bgpstream()
+static int test_bgpstream()
+{
+  CHECK("BGPStream create", (bs = bgpstream_create()) != NULL);
+
+  TEARDOWN;
+  return 0;
+}
+
+#define CHECKPOINT_FILE "bgpstream-test.checkpoint"
+#define CHECKPOINT_TIME 1427846400
+
+static int test_checkpoint()
+{
+  uint32_t time = 0;
+  FILE *f;
+
+  SETUP;
+  CHECK("add RIB period filter",
+        bgpstream_add_rib_period_filter(bs, 3600) == 0);
+  CHECK("save checkpoint",
+        bgpstream_save_checkpoint(bs, CHECKPOINT_FILE, CHECKPOINT_TIME) == 0);
+  TEARDOWN;
+
+  SETUP;
+  CHECK("add RIB period filter",
+        bgpstream_add_rib_period_filter(bs, 3600) == 0);
+  CHECK("load checkpoint",
+        bgpstream_load_checkpoint(bs, CHECKPOINT_FILE, &time) == 0 &&
+          time == CHECKPOINT_TIME);
+  TEARDOWN;
+
+  // files that are not checkpoints are refused
+  CHECK("write invalid checkpoint",
+        (f = fopen(CHECKPOINT_FILE, "w")) != NULL &&
+          fputs("time 1427846400\n", f) >= 0 && fclose(f) == 0);
+  SETUP;
+  CHECK("load invalid checkpoint",
+        bgpstream_load_checkpoint(bs, CHECKPOINT_FILE, &time) != 0);
+  TEARDOWN;
+
+  remove(CHECKPOINT_FILE);
+  return 0;
+}
+
+// enough elems to need several blocks (16, 16, 32, 64, 128)
+#define GENERATOR_ELEMS 200
+
+/* fill the generator with GENERATOR_ELEMS elems, each with an AS path ending
+ * in the given origin and peer ASN i */
+static int fill_generator(bgpstream_elem_generator_t *gen, uint32_t origin,
+                          bgpstream_elem_t **elems)
+{
+  bgpstream_elem_t *el;
+  uint32_t asns[2] = {3356, origin};
+  int i;
+
+  bgpstream_elem_generator_empty(gen);
+  for (i = 0; i < GENERATOR_ELEMS; i++) {
+    if ((el = bgpstream_elem_generator_get_new_elem(gen)) == NULL ||
+        bgpstream_as_path_append(el->as_path, BGPSTREAM_AS_PATH_SEG_ASN, asns,
+                                 2) != 0) {
+      return -1;
+    }
+    el->peer_asn = i;
+    bgpstream_elem_generator_commit_elem(gen, el);
+    elems[i] = el;
+  }
+  return 0;
+}
+
+/* check that the generator returns the elems of fill_generator in order */
+static int check_generator(bgpstream_elem_generator_t *gen, uint32_t origin,
+                           bgpstream_elem_t **elems)
+{
+  bgpstream_elem_t *el;
+  uint32_t asn;
+  int i;
+
+  for (i = 0; i < GENERATOR_ELEMS; i++) {
+    if ((el = bgpstream_elem_generator_get_next_elem(gen)) != elems[i] ||
+        el->peer_asn != (uint32_t)i ||
+        bgpstream_as_path_get_len(el->as_path) != 2 ||
+        bgpstream_as_path_get_origin_val(el->as_path, &asn) != 0 ||
+        asn != origin) {
+      return -1;
+    }
+  }
+  return bgpstream_elem_generator_get_next_elem(gen) == NULL ? 0 : -1;
+}
+
+static int test_elem_generator()
+{
+  bgpstream_elem_generator_t *gen;
+  bgpstream_elem_t *first[GENERATOR_ELEMS];
+  bgpstream_elem_t *second[GENERATOR_ELEMS];
+
+  CHECK("elem generator create",
+        (gen = bgpstream_elem_generator_create()) != NULL &&
+          !bgpstream_elem_generator_is_populated(gen));
+
+  CHECK("elem generator fill (several blocks)",
+        fill_generator(gen, 15169, first) == 0 &&
+          bgpstream_elem_generator_is_populated(gen));
+  CHECK("elem generator iterate",
+        check_generator(gen, 15169, first) == 0);
+
+  bgpstream_elem_generator_clear(gen);
+  CHECK("elem generator clear",
+        !bgpstream_elem_generator_is_populated(gen));
+
+  // the elems (and their AS paths) are reused, in the same order, and no
+  // stale path segments survive the clear
+  CHECK("elem generator refill",
+        fill_generator(gen, 13335, second) == 0 &&
+          memcmp(first, second, sizeof(first)) == 0);
+  CHECK("elem generator iterate (refilled)",
+        check_generator(gen, 13335, second) == 0);
+
+  bgpstream_elem_generator_destroy(gen);
+  return 0;
+}
+
+#define REORDER_RECS 6
+
+/* pop every record that can be taken out, and check that they are the given
+   ones, in order */
+static int check_reorder_pop(bgpstream_reorder_t *reorder, int flush,
+                             bgpstream_record_t **expected, int cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++) {
+    if (bgpstream_reorder_pop(reorder, flush) != expected[i]) {
+      return -1;
+    }
+  }
+  return bgpstream_reorder_pop(reorder, flush) == NULL ? 0 : -1;
+}
+
+static int test_reorder()
+{
+  bgpstream_reorder_t *reorder;
+  bgpstream_record_t *recs[REORDER_RECS];
+  // a record without a time is ordered at the latest time (105) seen so far
+  uint32_t times[REORDER_RECS] = {100, 105, 95, 0, 103, 120};
+  int i;
+
+  for (i = 0; i < REORDER_RECS; i++) {
+    CHECK("reorder record create",
+          (recs[i] = bgpstream_record_create(NULL)) != NULL);
+    recs[i]->time_sec = times[i];
+  }
+
+  CHECK("reorder create (no room)", bgpstream_reorder_create(10, 0) == NULL);
+  CHECK("reorder create",
+        (reorder = bgpstream_reorder_create(10, 100)) != NULL);
+
+  CHECK("reorder push (first)", bgpstream_reorder_push(reorder, recs[0]) == 0);
+  CHECK("reorder pop (within skew)", bgpstream_reorder_pop(reorder, 0) == NULL);
+
+  for (i = 1; i < 5; i++) {
+    CHECK("reorder push (out of order)",
+          bgpstream_reorder_push(reorder, recs[i]) == 0);
+  }
+  CHECK("reorder count", bgpstream_reorder_get_cnt(reorder) == 5);
+  CHECK("reorder pop (behind the skew)",
+        check_reorder_pop(reorder, 0, (bgpstream_record_t *[]){recs[2]}, 1) ==
+          0);
+
+  // 100, 103 and both records at 105 (in the order they were added) are now
+  // at least 10s behind
+  CHECK("reorder push (later)", bgpstream_reorder_push(reorder, recs[5]) == 0);
+  CHECK("reorder pop (ordered, zero time)",
+        check_reorder_pop(reorder, 0,
+                          (bgpstream_record_t *[]){recs[0], recs[4], recs[1],
+                                                   recs[3]},
+                          4) == 0);
+  CHECK("reorder count (latest held)", bgpstream_reorder_get_cnt(reorder) == 1);
+
+  bgpstream_reorder_release(reorder);
+  CHECK("reorder pop (flush)",
+        check_reorder_pop(reorder, 1, (bgpstream_record_t *[]){recs[5]}, 1) ==
+          0);
+  CHECK("reorder count (flushed)", bgpstream_reorder_get_cnt(reorder) == 0);
+  bgpstream_reorder_destroy(reorder);
+
+  // once the buffer is full, the earliest record (103, as the one without a
+  // time is now ordered at 120) comes out even though it is well within the
+  // skew
+  CHECK("reorder create (bounded)",
+        (reorder = bgpstream_reorder_create(1000, 3)) != NULL);
+  for (i = 0; i < 3; i++) {
+    CHECK("reorder push (bounded)",
+          bgpstream_reorder_push(reorder, recs[5 - i]) == 0);
+  }
+  CHECK("reorder pop (full)",
+        check_reorder_pop(reorder, 0, (bgpstream_record_t *[]){recs[4]}, 1) ==
+          0);
+  CHECK("reorder count (bounded)", bgpstream_reorder_get_cnt(reorder) == 2);
+
+  // the records still held are released with the buffer
+  bgpstream_reorder_destroy(reorder);
+  for (i = 0; i < REORDER_RECS; i++) {
+    bgpstream_record_release(recs[i]);
+  }
+  return 0;
+}
+
+#ifdef WITH_DATA_INTERFACE_SINGLEFILE
+#define SET_SINGLEFILE_OPTIONS                                                 \
+  do {                                                                         \
+    CHECK("get option (rib-file)",                                             \
+          (option = bgpstream_get_data_interface_option_by_name(               \
+             bs, di_id, "rib-file")) != NULL);                                 \
+    CHECK("set option (rib-file)",                                             \
+          bgpstream_set_data_interface_option(                                 \
+            bs, option, "routeviews.route-views.jinx.ribs.1427846400.bz2") ==  \
+            0);                                                                \
+    CHECK("get option (upd-file)",                                             \
+          (option = bgpstream_get_data_interface_option_by_name(               \
+             bs, di_id, "upd-file")) != NULL);                                 \
+    CHECK("set option (upd-file)",                                             \
+          bgpstream_set_data_interface_option(                                 \
+            bs, option, "ris.rrc06.updates.1427846400.gz") == 0);              \
+  } while (0)
+
+#define SINGLEFILE_BATCH 0x2
+#define SINGLEFILE_UNORDERED 0x4
+#define SINGLEFILE_MAX_OPEN 0x8
+#define SINGLEFILE_NONBLOCKING 0x10
+#define SINGLEFILE_PREFETCH 0x20
+#define SINGLEFILE_DECODE_THREADS 0x40
+
+static int run_singlefile(int readahead, int flags)
+{
+  SETUP;
+
+  CHECK_SET_INTERFACE(singlefile);
+
+  CHECK("set reader read-ahead",
+        bgpstream_set_reader_readahead(bs, readahead) == 0);
+  if ((flags & SINGLEFILE_UNORDERED) != 0) {
+    bgpstream_set_unordered(bs);
+  }
+  if ((flags & SINGLEFILE_MAX_OPEN) != 0) {
+    CHECK("set open resource limit",
+          bgpstream_set_max_open_resources(bs, 1) == 0);
+  }
+  if ((flags & SINGLEFILE_NONBLOCKING) != 0) {
+    bgpstream_set_nonblocking(bs);
+  }
+  if ((flags & SINGLEFILE_PREFETCH) != 0) {
+    bgpstream_set_prefetch(bs, 900);
+  }
+  if ((flags & SINGLEFILE_DECODE_THREADS) != 0) {
+    CHECK("set decode threads", bgpstream_set_decode_threads(bs, 4) == 0);
+  }
+
+  SET_SINGLEFILE_OPTIONS;
+
+  if ((flags & SINGLEFILE_BATCH) != 0) {
+    RUN_BATCH(singlefile);
+  } else if ((flags & SINGLEFILE_NONBLOCKING) != 0) {
+    RUN_NONBLOCKING(singlefile);
+  } else {
+    RUN(singlefile);
+  }
+
+  TEARDOWN;
+  return 0;
+}
+
+static int test_singlefile()
+{
+  return run_singlefile(0, 0);
+}
+
+static int test_singlefile_readahead()
+{
+  return run_singlefile(64, 0);
+}
+
+/* read the files, checking that records come in time order, with the RIB
+ * records of a second before its updates, and folding the raw bytes of every
+ * record into a digest of the merge order */
+static int run_singlefile_order(int heap_merge, uint64_t *digest)
+{
+  const uint8_t *raw;
+  size_t raw_len, i;
+  uint32_t last_time = 0, last_upd_time = 0;
+  int ret, counter = 0, out_of_order = 0, rib_after_upd = 0;
+
+  // FNV-1a
+  *digest = 0xcbf29ce484222325ULL;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  if (heap_merge != 0) {
+    bgpstream_set_heap_merge(bs);
+  }
+  bgpstream_set_raw_records(bs);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (merge order)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status == BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      counter++;
+    }
+    if (rec->time_sec != 0) {
+      if (rec->time_sec < last_time) {
+        out_of_order++;
+      }
+      last_time = rec->time_sec;
+      if (rec->type == BGPSTREAM_UPDATE) {
+        last_upd_time = rec->time_sec;
+      } else if (rec->time_sec == last_upd_time) {
+        rib_after_upd++;
+      }
+    }
+    *digest = (*digest ^ (rec->time_sec ^ ((uint64_t)rec->type << 32) ^
+                          ((uint64_t)rec->status << 40))) *
+              0x100000001b3ULL;
+    raw_len = bgpstream_record_get_raw(rec, &raw);
+    for (i = 0; i < raw_len; i++) {
+      *digest = (*digest ^ raw[i]) * 0x100000001b3ULL;
+    }
+  }
+  CHECK("final return code (merge order)", ret == 0);
+  CHECK("read records (merge order)", counter == singlefile_RECORDS);
+  CHECK("records in time order", out_of_order == 0);
+  CHECK("RIB records before updates of the same time", rib_after_upd == 0);
+  TEARDOWN;
+  return 0;
+}
+
+// the heap must merge the files in exactly the order of the linked list
+static int test_singlefile_heap_merge()
+{
+  uint64_t list_digest, heap_digest;
+
+  if (run_singlefile_order(0, &list_digest) != 0 ||
+      run_singlefile_order(1, &heap_digest) != 0) {
+    return -1;
+  }
+  CHECK("heap merge order matches list merge", heap_digest == list_digest);
+  return 0;
+}
+
+static int test_singlefile_batch()
+{
+  return run_singlefile(0, SINGLEFILE_BATCH);
+}
+
+static int test_singlefile_unordered()
+{
+  return run_singlefile(0, SINGLEFILE_UNORDERED);
+}
+
+static int test_singlefile_max_open()
+{
+  return run_singlefile(0, SINGLEFILE_MAX_OPEN);
+}
+
+static int test_singlefile_nonblocking()
+{
+  return run_singlefile(0, SINGLEFILE_NONBLOCKING);
+}
+
+static int test_singlefile_prefetch()
+{
+  return run_singlefile(0, SINGLEFILE_PREFETCH);
+}
+
+static int test_singlefile_decode_threads()
+{
+  return run_singlefile(0, SINGLEFILE_DECODE_THREADS);
+}
+
+#define START_LAZY_RIB                                                         \
+  do {                                                                         \
+    CHECK("BGPStream create (lazy)", (lazy_bs = bgpstream_create()) != NULL);  \
+    bgpstream_set_data_interface(lazy_bs, di_id);                              \
+    CHECK("get option (rib-file)",                                             \
+          (option = bgpstream_get_data_interface_option_by_name(               \
+             lazy_bs, di_id, "rib-file")) != NULL);                            \
+    CHECK("set option (rib-file)",                                             \
+          bgpstream_set_data_interface_option(                                 \
+            lazy_bs, option,                                                   \
+            "routeviews.route-views.jinx.ribs.1427846400.bz2") == 0);          \
+    bgpstream_set_lazy_elems(lazy_bs);                                         \
+    CHECK("stream start (lazy)", bgpstream_start(lazy_bs) == 0);               \
+  } while (0)
+
+// reads the same files with and without lazy elems, comparing every elem
+static int test_singlefile_lazy_elems()
+{
+  bgpstream_t *lazy_bs;
+  bgpstream_record_t *lazy_rec;
+  bgpstream_elem_t *elem, *lazy_elem;
+  char buf[65536], lazy_buf[65536];
+  int ret, lazy_ret;
+  int mismatches = 0;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (singlefile)", bgpstream_start(bs) == 0);
+
+  START_LAZY_RIB;
+
+  // the lazy stream only reads the RIB, which is read first by both streams
+  while ((lazy_ret = bgpstream_get_next_record(lazy_bs, &lazy_rec)) > 0) {
+    CHECK("next record", bgpstream_get_next_record(bs, &rec) > 0);
+    while ((lazy_ret = bgpstream_record_get_next_elem(lazy_rec, &lazy_elem)) >
+           0) {
+      CHECK("next elem", bgpstream_record_get_next_elem(rec, &elem) > 0);
+      if (bgpstream_elem_snprintf(buf, sizeof(buf), elem) == NULL ||
+          bgpstream_elem_snprintf(lazy_buf, sizeof(lazy_buf), lazy_elem) ==
+            NULL ||
+          strcmp(buf, lazy_buf) != 0) {
+        mismatches++;
+      }
+    }
+    CHECK("elem return code (lazy)", lazy_ret == 0);
+  }
+  CHECK("final return code (lazy)", lazy_ret == 0);
+  CHECK("lazy elems match", mismatches == 0);
+
+  // accessors decode the attributes of a lazy elem that was not printed
+  bgpstream_destroy(lazy_bs);
+  START_LAZY_RIB;
+  do {
+    CHECK("next record (lazy)",
+          bgpstream_get_next_record(lazy_bs, &lazy_rec) > 0);
+  } while ((ret = bgpstream_record_get_next_elem(lazy_rec, &lazy_elem)) == 0);
+  CHECK("RIB elem (lazy)", ret > 0 &&
+                             lazy_elem->type == BGPSTREAM_ELEM_TYPE_RIB);
+  CHECK("AS path (lazy)",
+        bgpstream_elem_get_as_path(lazy_elem) != NULL &&
+          bgpstream_as_path_get_len(lazy_elem->as_path) > 0);
+  CHECK("communities (lazy)",
+        bgpstream_elem_get_communities(lazy_elem) == lazy_elem->communities);
+
+  bgpstream_destroy(lazy_bs);
+  TEARDOWN;
+  return 0;
+}
+
+#define FILTER_PEER_ASN 25152
+
+// the compiled elem filters pass exactly the elems they describe, however
+// their checks get reordered along the way
+// reads the RIB with the attribute cache and with lazy elems, checking that
+// entries with the same attributes share their AS path and communities, and
+// that copies of the elems outlive the entry (and record) they came from
+static int test_singlefile_attr_cache()
+{
+  bgpstream_t *lazy_bs;
+  bgpstream_record_t *lazy_rec;
+  bgpstream_elem_t *elem, *lazy_elem, *copy, *lazy_copy;
+  bgpstream_as_path_t *prev_path;
+  bgpstream_community_set_t *prev_comms;
+  char buf[65536], lazy_buf[65536], copy_buf[65536];
+  int lazy_ret, copied = 0;
+  int shared = 0, bad_shares = 0, bad_copies = 0, mismatches = 0;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  CHECK("get option (rib-file)",
+        (option = bgpstream_get_data_interface_option_by_name(
+           bs, di_id, "rib-file")) != NULL);
+  CHECK("set option (rib-file)",
+        bgpstream_set_data_interface_option(
+          bs, option, "routeviews.route-views.jinx.ribs.1427846400.bz2") == 0);
+  CHECK("stream start (singlefile)", bgpstream_start(bs) == 0);
+
+  START_LAZY_RIB;
+
+  CHECK("elem create (copies)", (copy = bgpstream_elem_create()) != NULL &&
+                                  (lazy_copy = bgpstream_elem_create()) !=
+                                    NULL);
+
+  while ((lazy_ret = bgpstream_get_next_record(lazy_bs, &lazy_rec)) > 0) {
+    CHECK("next record", bgpstream_get_next_record(bs, &rec) > 0);
+    // the entries of the cache are re-used once the previous record is cleared
+    prev_path = NULL;
+    prev_comms = NULL;
+    while ((lazy_ret = bgpstream_record_get_next_elem(lazy_rec, &lazy_elem)) >
+           0) {
+      CHECK("next elem", bgpstream_record_get_next_elem(rec, &elem) > 0);
+
+      // the copies of the previous elems must not point into the cache (or
+      // the message) that the elems were decoded from
+      if (copied != 0 &&
+          (bgpstream_elem_snprintf(buf, sizeof(buf), copy) == NULL ||
+           bgpstream_elem_snprintf(lazy_buf, sizeof(lazy_buf), lazy_copy) ==
+             NULL ||
+           strcmp(buf, copy_buf) != 0 || strcmp(lazy_buf, copy_buf) != 0)) {
+        bad_copies++;
+      }
+
+      // the previous elem of the record had the same attributes (as far as
+      // its copy tells), so the objects should be shared, while different
+      // attributes must never be decoded into the same objects
+      if (prev_path != NULL &&
+          bgpstream_as_path_equal(copy->as_path, elem->as_path) &&
+          bgpstream_community_set_equal(copy->communities,
+                                        elem->communities)) {
+        shared += (elem->as_path == prev_path &&
+                   elem->communities == prev_comms);
+      } else if (prev_path != NULL && (elem->as_path == prev_path ||
+                                       elem->communities == prev_comms)) {
+        bad_shares++;
+      }
+
+      if (bgpstream_elem_snprintf(buf, sizeof(buf), elem) == NULL ||
+          bgpstream_elem_snprintf(lazy_buf, sizeof(lazy_buf), lazy_elem) ==
+            NULL ||
+          strcmp(buf, lazy_buf) != 0) {
+        mismatches++;
+      }
+
+      CHECK("elem copy", bgpstream_elem_copy(copy, elem) != NULL &&
+                           bgpstream_elem_copy(lazy_copy, lazy_elem) != NULL);
+      strcpy(copy_buf, buf);
+      copied = 1;
+      prev_path = elem->as_path;
+      prev_comms = elem->communities;
+    }
+    CHECK("elem return code (lazy)", lazy_ret == 0);
+  }
+  CHECK("final return code (lazy)", lazy_ret == 0);
+  CHECK("cached elems match (lazy)", mismatches == 0);
+  CHECK("equal attributes shared", shared > 0 && bad_shares == 0);
+  CHECK("elem copies outlive the cache", bad_copies == 0);
+
+  bgpstream_elem_destroy(copy);
+  bgpstream_elem_destroy(lazy_copy);
+  bgpstream_destroy(lazy_bs);
+  TEARDOWN;
+  return 0;
+}
+
+static int test_singlefile_elem_filters()
+{
+  bgpstream_elem_t *elem;
+  int filtered = 0, expected = 0;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_ELEM_TYPE, "ribs");
+  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_ELEM_TYPE, "announcements");
+  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_ELEM_IP_VERSION, "4");
+  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_ELEM_NOT_PEER_ASN,
+                       STR(FILTER_PEER_ASN));
+  CHECK("stream start (elem filters)", bgpstream_start(bs) == 0);
+  while (bgpstream_get_next_record(bs, &rec) > 0) {
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      filtered++;
+    }
+  }
+  TEARDOWN;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (no elem filters)", bgpstream_start(bs) == 0);
+  while (bgpstream_get_next_record(bs, &rec) > 0) {
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      if ((elem->type == BGPSTREAM_ELEM_TYPE_RIB ||
+           elem->type == BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT) &&
+          elem->prefix.address.version == BGPSTREAM_ADDR_VERSION_IPV4 &&
+          elem->peer_asn != FILTER_PEER_ASN) {
+        expected++;
+      }
+    }
+  }
+  TEARDOWN;
+
+  CHECK("filtered elems", filtered > 0 && filtered == expected);
+  return 0;
+}
+
+// path attributes behind undeclared elem fields are not decoded
+static int test_singlefile_elem_fields()
+{
+  bgpstream_elem_t *elem;
+  int ret;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  CHECK("get option (rib-file)",
+        (option = bgpstream_get_data_interface_option_by_name(
+           bs, di_id, "rib-file")) != NULL);
+  CHECK("set option (rib-file)",
+        bgpstream_set_data_interface_option(
+          bs, option, "routeviews.route-views.jinx.ribs.1427846400.bz2") == 0);
+  bgpstream_set_elem_fields(bs, BGPSTREAM_ELEM_FIELD_NEXTHOP);
+  CHECK("stream start (elem fields)", bgpstream_start(bs) == 0);
+
+  do {
+    CHECK("next record", bgpstream_get_next_record(bs, &rec) > 0);
+  } while ((ret = bgpstream_record_get_next_elem(rec, &elem)) == 0);
+  CHECK("RIB elem", ret > 0 && elem->type == BGPSTREAM_ELEM_TYPE_RIB);
+  CHECK("next-hop decoded", elem->nexthop.version != 0);
+  CHECK("AS path skipped", bgpstream_as_path_get_len(elem->as_path) == 0);
+  CHECK("communities skipped",
+        bgpstream_community_set_size(elem->communities) == 0);
+
+  TEARDOWN;
+  return 0;
+}
+
+#define MRT_OUT_FILE "bgpstream-test.mrt.gz"
+
+// counts the IPv6 elems of a stream, writing the records that have any
+#define RUN_IPV6(label, writer)                                                \
+  do {                                                                         \
+    CHECK("add filter (" label ")",                                            \
+          bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_ELEM_IP_VERSION,      \
+                               "6") != 0);                                     \
+    CHECK("stream start (" label ")", bgpstream_start(bs) == 0);               \
+    while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {                  \
+      rec_elem_cnt = 0;                                                        \
+      while (bgpstream_record_get_next_elem(rec, &elem) > 0) {                 \
+        rec_elem_cnt++;                                                        \
+      }                                                                        \
+      elem_cnt += rec_elem_cnt;                                                \
+      if ((writer) != NULL && rec_elem_cnt > 0) {                              \
+        CHECK("write record", bgpstream_mrt_writer_write((writer), rec) == 1); \
+        written_cnt++;                                                         \
+      }                                                                        \
+    }                                                                          \
+    CHECK("final return code (" label ")", ret == 0);                          \
+  } while (0)
+
+// records written to an MRT file yield the same elems when read back
+static int test_singlefile_mrt_writer()
+{
+  bgpstream_mrt_writer_t *writer;
+  bgpstream_elem_t *elem;
+  int ret, rec_elem_cnt;
+  int elem_cnt = 0, written_cnt = 0, reread_cnt;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  bgpstream_set_raw_records(bs);
+  CHECK("create MRT writer",
+        (writer = bgpstream_mrt_writer_create(MRT_OUT_FILE)) != NULL);
+  RUN_IPV6("filtered", writer);
+  bgpstream_mrt_writer_destroy(writer);
+  TEARDOWN;
+  CHECK("records written", written_cnt > 0 && elem_cnt > 0);
+
+  reread_cnt = elem_cnt;
+  elem_cnt = 0;
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  CHECK("get option (upd-file)",
+        (option = bgpstream_get_data_interface_option_by_name(
+           bs, di_id, "upd-file")) != NULL);
+  CHECK("set option (upd-file)",
+        bgpstream_set_data_interface_option(bs, option, MRT_OUT_FILE) == 0);
+  RUN_IPV6("re-read", (bgpstream_mrt_writer_t *)NULL);
+  TEARDOWN;
+  CHECK("re-read elems", elem_cnt == reread_cnt);
+
+  return 0;
+}
+
+#define BINARY_OUT_FILE "bgpstream-test.bsbf.gz"
+
+// reads the updates file (or a binary copy of it), totalling the elems and the
+// length of their text form, and encoding them when a writer is given
+#define RUN_BINARY(label, file, type, writer)                                  \
+  do {                                                                         \
+    CHECK_SET_INTERFACE(singlefile);                                           \
+    CHECK("get option (upd-file)",                                             \
+          (option = bgpstream_get_data_interface_option_by_name(               \
+             bs, di_id, "upd-file")) != NULL);                                 \
+    CHECK("set option (upd-file)",                                             \
+          bgpstream_set_data_interface_option(bs, option, (file)) == 0);       \
+    CHECK("get option (upd-type)",                                             \
+          (option = bgpstream_get_data_interface_option_by_name(               \
+             bs, di_id, "upd-type")) != NULL);                                 \
+    CHECK("set option (upd-type)",                                             \
+          bgpstream_set_data_interface_option(bs, option, (type)) == 0);       \
+    CHECK("stream start (" label ")", bgpstream_start(bs) == 0);               \
+    while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {                  \
+      if ((writer) != NULL) {                                                  \
+        CHECK("begin record",                                                  \
+              bgpstream_binary_writer_begin_record((writer), rec) == 0);       \
+      }                                                                        \
+      rec_elem_cnt = 0;                                                        \
+      while (bgpstream_record_get_next_elem(rec, &elem) > 0) {                 \
+        rec_elem_cnt++;                                                        \
+        CHECK("elem to string",                                                \
+              bgpstream_elem_snprintf(buf, sizeof(buf), elem) != NULL);        \
+        text_len += strlen(buf);                                               \
+        if ((writer) != NULL) {                                                \
+          CHECK("add elem",                                                    \
+                bgpstream_binary_writer_add_elem((writer), elem) == 0);        \
+        }                                                                      \
+      }                                                                        \
+      elem_cnt += rec_elem_cnt;                                                \
+      if ((writer) != NULL && rec_elem_cnt > 0) {                              \
+        CHECK("end record",                                                    \
+              (len = bgpstream_binary_writer_end_record((writer), &bin)) > 0); \
+        CHECK("write record", wandio_wwrite(iow, bin, len) == len);            \
+      }                                                                        \
+    }                                                                          \
+    CHECK("final return code (" label ")", ret == 0);                          \
+  } while (0)
+
+// elems encoded in the binary format decode to the same text when read back
+static int test_singlefile_binary()
+{
+  bgpstream_binary_writer_t *writer;
+  bgpstream_elem_t *elem;
+  iow_t *iow;
+  const uint8_t *bin;
+  ssize_t len;
+  char buf[65536];
+  int ret, rec_elem_cnt;
+  uint64_t elem_cnt = 0, text_len = 0, encoded_cnt, encoded_len;
+
+  CHECK("create binary writer",
+        (writer = bgpstream_binary_writer_create()) != NULL);
+  CHECK("create binary file",
+        (iow = wandio_wcreate(BINARY_OUT_FILE,
+                              wandio_detect_compression_type(BINARY_OUT_FILE),
+                              6, O_CREAT)) != NULL);
+  SETUP;
+  RUN_BINARY("encode", "ris.rrc06.updates.1427846400.gz", "mrt", writer);
+  TEARDOWN;
+  wandio_wdestroy(iow);
+  bgpstream_binary_writer_destroy(writer);
+  CHECK("elems encoded", elem_cnt > 0);
+
+  encoded_cnt = elem_cnt;
+  encoded_len = text_len;
+  elem_cnt = text_len = 0;
+  SETUP;
+  RUN_BINARY("decode", BINARY_OUT_FILE, "binary",
+             (bgpstream_binary_writer_t *)NULL);
+  TEARDOWN;
+  CHECK("decoded elems", elem_cnt == encoded_cnt);
+  CHECK("decoded elem text", text_len == encoded_len);
+
+  return 0;
+}
+
+#define SHMRING_NAME "bgpstream-test"
+
+// totals the elems read from the ring (and the length of their text form). this
+// runs in the reader process, so it reports errors instead of checking
+static int read_shmring(uint64_t *totals)
+{
+  bgpstream_elem_t *elem;
+  char buf[65536];
+  int ret = -1;
+
+  if ((bs = bgpstream_create()) == NULL ||
+      (di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile")) ==
+        0) {
+    goto done;
+  }
+  bgpstream_set_data_interface(bs, di_id);
+  if ((option = bgpstream_get_data_interface_option_by_name(
+         bs, di_id, "upd-file")) == NULL ||
+      bgpstream_set_data_interface_option(bs, option,
+                                          "shm://" SHMRING_NAME) != 0 ||
+      (option = bgpstream_get_data_interface_option_by_name(
+         bs, di_id, "upd-type")) == NULL ||
+      bgpstream_set_data_interface_option(bs, option, "binary") != 0 ||
+      bgpstream_start(bs) != 0) {
+    goto done;
+  }
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      if (bgpstream_elem_snprintf(buf, sizeof(buf), elem) == NULL) {
+        ret = -1;
+        goto done;
+      }
+      totals[0]++;
+      totals[1] += strlen(buf);
+    }
+  }
+
+done:
+  TEARDOWN;
+  return ret;
+}
+
+// elems written to a shared-memory ring are read by another process as they
+// were written
+static int test_singlefile_shmring()
+{
+  bgpstream_shmring_writer_t *writer;
+  bgpstream_elem_t *elem;
+  uint64_t totals[2] = {0, 0}, read_totals[2] = {0, 0};
+  char buf[65536];
+  int fds[2], ret, rec_elem_cnt, status, wait_ms;
+  pid_t pid;
+
+  CHECK("create shared memory ring writer",
+        (writer = bgpstream_shmring_writer_create(SHMRING_NAME, 0)) != NULL);
+  CHECK("create pipe", pipe(fds) == 0);
+  CHECK("fork reader", (pid = fork()) >= 0);
+  if (pid == 0) {
+    close(fds[0]);
+    ret = read_shmring(read_totals);
+    _exit(ret == 0 && write(fds[1], read_totals, sizeof(read_totals)) ==
+                        sizeof(read_totals)
+            ? 0
+            : 1);
+  }
+  close(fds[1]);
+
+  // the reader only reads the records written once it has attached
+  for (wait_ms = 0; bgpstream_shmring_writer_get_readers_cnt(writer) == 0 &&
+                    wait_ms < 10000;
+       wait_ms += 10) {
+    usleep(10000);
+  }
+  CHECK("reader attached",
+        bgpstream_shmring_writer_get_readers_cnt(writer) == 1);
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  CHECK("get option (upd-file)",
+        (option = bgpstream_get_data_interface_option_by_name(
+           bs, di_id, "upd-file")) != NULL);
+  CHECK("set option (upd-file)",
+        bgpstream_set_data_interface_option(
+          bs, option, "ris.rrc06.updates.1427846400.gz") == 0);
+  CHECK("stream start (shmring)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    CHECK("begin record",
+          bgpstream_shmring_writer_begin_record(writer, rec) == 0);
+    rec_elem_cnt = 0;
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      rec_elem_cnt++;
+      CHECK("elem to string",
+            bgpstream_elem_snprintf(buf, sizeof(buf), elem) != NULL);
+      totals[0]++;
+      totals[1] += strlen(buf);
+      CHECK("add elem", bgpstream_shmring_writer_add_elem(writer, elem) == 0);
+    }
+    CHECK("end record", bgpstream_shmring_writer_end_record(writer) == 0);
+  }
+  CHECK("final return code (shmring)", ret == 0);
+  TEARDOWN;
+  // the reader reaches the end of its stream once the writer is gone
+  bgpstream_shmring_writer_destroy(writer);
+
+  CHECK("read reader totals",
+        read(fds[0], read_totals, sizeof(read_totals)) == sizeof(read_totals));
+  close(fds[0]);
+  CHECK("reader exit", waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+                         WEXITSTATUS(status) == 0);
+  CHECK("elems read from the ring",
+        totals[0] > 0 && read_totals[0] == totals[0]);
+  CHECK("elem text read from the ring", read_totals[1] == totals[1]);
+
+  return 0;
+}
+
+#define SUMMARY_UPD_FILE "ris.rrc06.updates.1427846400.gz"
+
+// count the records of the summarized updates file that a stream with the
+// given elem filter returns
+static int count_summarized(bgpstream_filter_type_t type, const char *value,
+                            int summaries)
+{
+  int ret;
+  int counter = 0;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  CHECK("get option (upd-file)",
+        (option = bgpstream_get_data_interface_option_by_name(
+           bs, di_id, "upd-file")) != NULL);
+  CHECK("set option (upd-file)",
+        bgpstream_set_data_interface_option(bs, option, SUMMARY_UPD_FILE) ==
+          0);
+  CHECK("add filter (summaries)", bgpstream_add_filter(bs, type, value) != 0);
+  if (summaries != 0) {
+    bgpstream_set_resource_summaries(bs);
+  }
+  CHECK("stream start (summaries)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    counter++;
+  }
+  CHECK("final return code (summaries)", ret == 0);
+  TEARDOWN;
+  return counter;
+}
+
+static int test_singlefile_summaries()
+{
+  bgpstream_summary_t *summary;
+  bgpstream_elem_t *elem;
+  int ret, added = 1, unfiltered;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  CHECK("get option (upd-file)",
+        (option = bgpstream_get_data_interface_option_by_name(
+           bs, di_id, "upd-file")) != NULL);
+  CHECK("set option (upd-file)",
+        bgpstream_set_data_interface_option(bs, option, SUMMARY_UPD_FILE) ==
+          0);
+  CHECK("create summary", (summary = bgpstream_summary_create()) != NULL);
+  CHECK("stream start (summary)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      added &= bgpstream_summary_add_elem(summary, elem) == 0;
+    }
+  }
+  CHECK("final return code (summary)", ret == 0);
+  CHECK("add elems to summary", added);
+  CHECK("write summary",
+        bgpstream_summary_write(summary,
+                                SUMMARY_UPD_FILE BGPSTREAM_SUMMARY_SUFFIX) ==
+          0);
+  bgpstream_summary_destroy(summary);
+  TEARDOWN;
+
+  // records without matching elems are still returned when nothing is skipped
+  unfiltered =
+    count_summarized(BGPSTREAM_FILTER_TYPE_ELEM_PEER_ASN, "64496", 0);
+  CHECK("records without summaries", unfiltered > 0);
+  CHECK("records of a summarized peer",
+        count_summarized(BGPSTREAM_FILTER_TYPE_ELEM_PEER_ASN, "25152", 1) ==
+          unfiltered);
+  CHECK("records of a peer missing from the summary",
+        count_summarized(BGPSTREAM_FILTER_TYPE_ELEM_PEER_ASN, "64496", 1) ==
+          0);
+  CHECK("records of a prefix missing from the summary",
+        count_summarized(BGPSTREAM_FILTER_TYPE_ELEM_PREFIX, "240.0.0.0/8",
+                         1) == 0);
+
+  return 0;
+}
+
+#define FILTER_SETS_UPD_FILE "ris.rrc06.updates.1427846400.gz"
+
+// count the elems of the updates file that pass the given filter string
+static int count_filtered(const char *fstring)
+{
+  bgpstream_elem_t *elem;
+  int ret;
+  int counter = 0;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  CHECK("get option (upd-file)",
+        (option = bgpstream_get_data_interface_option_by_name(
+           bs, di_id, "upd-file")) != NULL);
+  CHECK("set option (upd-file)",
+        bgpstream_set_data_interface_option(bs, option,
+                                            FILTER_SETS_UPD_FILE) == 0);
+  CHECK("parse filter string", bgpstream_parse_filter_string(bs, fstring));
+  CHECK("stream start (filtered)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      counter++;
+    }
+  }
+  CHECK("final return code (filtered)", ret == 0);
+  TEARDOWN;
+  return counter;
+}
+
+static int test_singlefile_filter_sets()
 {
-  CHECK("BGPStream create", (bs = bgpstream_create()) != NULL);
+  static const char *filters[] = {"ipversion 4", "ipversion 6",
+                                  "peer 25152 and elemtype announcements"};
+  int expected[ARR_CNT(filters)];
+  int counts[ARR_CNT(filters)] = {0};
+  bgpstream_elem_t *elem;
+  uint64_t sets;
+  int ret, i, untagged = 0;
+
+  for (i = 0; i < ARR_CNT(filters); i++) {
+    expected[i] = count_filtered(filters[i]);
+  }
+  CHECK("elems per filter", expected[0] > 0 && expected[1] > 0 &&
+                              expected[2] > 0);
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  CHECK("get option (upd-file)",
+        (option = bgpstream_get_data_interface_option_by_name(
+           bs, di_id, "upd-file")) != NULL);
+  CHECK("set option (upd-file)",
+        bgpstream_set_data_interface_option(bs, option,
+                                            FILTER_SETS_UPD_FILE) == 0);
+  CHECK("add filter set (v4)", bgpstream_add_filter_set(bs, "v4") == 0);
+  CHECK("add filter set (v6)", bgpstream_add_filter_set(bs, "v6") == 1);
+  CHECK("add filter set (peer)", bgpstream_add_filter_set(bs, "peer") == 2);
+  CHECK("reject duplicate filter set", bgpstream_add_filter_set(bs, "v4") < 0);
+  CHECK("reject non-elem set filter",
+        bgpstream_add_set_filter(bs, 0, BGPSTREAM_FILTER_TYPE_COLLECTOR,
+                                 "rrc06") == 0);
+  for (i = 0; i < ARR_CNT(filters); i++) {
+    CHECK("parse set filter string",
+          bgpstream_parse_set_filter_string(bs, i, filters[i]));
+  }
+  CHECK("filter set name",
+        strcmp(bgpstream_get_filter_set_name(bs, 1), "v6") == 0 &&
+          bgpstream_get_filter_set_name(bs, 3) == NULL);
 
+  CHECK("stream start (filter sets)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      if ((sets = bgpstream_record_get_elem_filter_sets(rec)) == 0) {
+        untagged++;
+      }
+      for (i = 0; i < ARR_CNT(filters); i++) {
+        counts[i] += (sets >> i) & 1;
+      }
+    }
+  }
+  CHECK("final return code (filter sets)", ret == 0);
   TEARDOWN;
+
+  CHECK("elems pass a filter set", untagged == 0);
+  for (i = 0; i < ARR_CNT(filters); i++) {
+    CHECK("elems per filter set", counts[i] == expected[i]);
+  }
+
   return 0;
 }
 
-#ifdef WITH_DATA_INTERFACE_SINGLEFILE
-static int test_singlefile()
+#define FILTER_RELOAD_ELEMS 100
+
+// filters replaced on a running stream apply from the next elem on
+static int test_singlefile_filter_reload()
 {
-  SETUP;
+  bgpstream_elem_t *elem;
+  int ret, v4 = 0, v6 = 0, wrong = 0, reloaded = 0;
 
+  SETUP;
   CHECK_SET_INTERFACE(singlefile);
-
-  CHECK("get option (rib-file)",
+  CHECK("get option (upd-file)",
         (option = bgpstream_get_data_interface_option_by_name(
-           bs, di_id, "rib-file")) != NULL);
-  CHECK("set option (rib-file)",
-        bgpstream_set_data_interface_option(
-          bs, option, "routeviews.route-views.jinx.ribs.1427846400.bz2") == 0);
+           bs, di_id, "upd-file")) != NULL);
+  CHECK("set option (upd-file)",
+        bgpstream_set_data_interface_option(bs, option,
+                                            FILTER_SETS_UPD_FILE) == 0);
+  CHECK("parse filter string",
+        bgpstream_parse_filter_string(bs, "ipversion 4"));
+  CHECK("stream start (filter reload)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      if (elem->prefix.address.version == BGPSTREAM_ADDR_VERSION_IPV4 &&
+          reloaded == 0) {
+        v4++;
+      } else if (elem->prefix.address.version == BGPSTREAM_ADDR_VERSION_IPV6 &&
+                 reloaded != 0) {
+        v6++;
+      } else {
+        wrong++;
+      }
+    }
+    if (reloaded == 0 && v4 >= FILTER_RELOAD_ELEMS) {
+      // an aborted reload leaves the filters alone
+      CHECK("begin filter reload (abort)",
+            bgpstream_begin_filter_reload(bs) == 0);
+      CHECK("parse reloaded filter string (abort)",
+            bgpstream_parse_filter_string(bs, "ipversion 6"));
+      bgpstream_abort_filter_reload(bs);
+
+      CHECK("begin filter reload", bgpstream_begin_filter_reload(bs) == 0);
+      CHECK("parse reloaded filter string",
+            bgpstream_parse_filter_string(bs, "ipversion 6"));
+      CHECK("commit filter reload", bgpstream_commit_filter_reload(bs) == 0);
+      reloaded = 1;
+    }
+  }
+  CHECK("final return code (filter reload)", ret == 0);
+  TEARDOWN;
+
+  CHECK("elems before the reload", v4 >= FILTER_RELOAD_ELEMS);
+  CHECK("elems after the reload", v6 > 0);
+  CHECK("elems pass the filters in use", wrong == 0);
+  return 0;
+}
+
+// prefix filters match the same elems as comparing against each prefix
+static int test_singlefile_prefix_filters()
+{
+  static const struct {
+    uint8_t matches;
+    const char *pfx;
+  } filters[] = {
+    {BGPSTREAM_PREFIX_MATCH_MORE, "202.70.0.0/16"},
+    {BGPSTREAM_PREFIX_MATCH_LESS, "154.73.136.0/25"},
+    {BGPSTREAM_PREFIX_MATCH_EXACT, "2620:110:9004::/48"},
+    {BGPSTREAM_PREFIX_MATCH_ANY, "2a00::/12"},
+  };
+  bgpstream_pfx_t pfxs[ARR_CNT(filters)];
+  bgpstream_elem_t *elem;
+  int ret, i, passed;
+  int filtered, expected = 0;
 
+  for (i = 0; i < ARR_CNT(filters); i++) {
+    CHECK("parse prefix", bgpstream_str2pfx(filters[i].pfx, &pfxs[i]) != NULL);
+  }
+  filtered = count_filtered("prefix more 202.70.0.0/16 less 154.73.136.0/25 "
+                            "exact 2620:110:9004::/48 any 2a00::/12");
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
   CHECK("get option (upd-file)",
         (option = bgpstream_get_data_interface_option_by_name(
            bs, di_id, "upd-file")) != NULL);
   CHECK("set option (upd-file)",
-        bgpstream_set_data_interface_option(
-          bs, option, "ris.rrc06.updates.1427846400.gz") == 0);
+        bgpstream_set_data_interface_option(bs, option,
+                                            FILTER_SETS_UPD_FILE) == 0);
+  CHECK("stream start (no prefix filters)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      if (elem->type == BGPSTREAM_ELEM_TYPE_PEERSTATE) {
+        continue;
+      }
+      passed = 0;
+      for (i = 0; i < ARR_CNT(filters) && !passed; i++) {
+        switch (filters[i].matches) {
+        case BGPSTREAM_PREFIX_MATCH_MORE:
+          passed = bgpstream_pfx_contains(&pfxs[i], &elem->prefix);
+          break;
+        case BGPSTREAM_PREFIX_MATCH_LESS:
+          passed = bgpstream_pfx_contains(&elem->prefix, &pfxs[i]);
+          break;
+        case BGPSTREAM_PREFIX_MATCH_EXACT:
+          passed = bgpstream_pfx_equal(&pfxs[i], &elem->prefix);
+          break;
+        default:
+          passed = bgpstream_pfx_contains(&pfxs[i], &elem->prefix) ||
+                   bgpstream_pfx_contains(&elem->prefix, &pfxs[i]);
+          break;
+        }
+      }
+      expected += passed;
+    }
+  }
+  CHECK("final return code (no prefix filters)", ret == 0);
+  TEARDOWN;
+
+  CHECK("prefix filtered elems", filtered > 0 && filtered == expected);
+  return 0;
+}
+
+#define UNCOMPRESSED_OUT_FILE "bgpstream-test.mrt"
+
+// an uncompressed (i.e., mapped) copy of the updates file gives the same elems
+// sums of the fields that elem columns hold, so that a row-wise and a
+// columnar read of the same stream can be compared
+typedef struct elem_sums {
+  uint64_t cnt;
+  uint64_t type;
+  uint64_t time_sec;
+  uint64_t peer_asn;
+  uint64_t origin_asn;
+  uint64_t v6_prefixes;
+  uint64_t prefix_len;
+} elem_sums_t;
+
+static void add_elem_sums(elem_sums_t *sums, bgpstream_elem_type_t type,
+                          uint32_t time_sec, uint32_t peer_asn,
+                          uint32_t origin_asn, const bgpstream_pfx_t *pfx)
+{
+  sums->cnt++;
+  sums->type += type;
+  sums->time_sec += time_sec;
+  sums->peer_asn += peer_asn;
+  sums->origin_asn += origin_asn;
+  sums->v6_prefixes += (pfx->address.version == BGPSTREAM_ADDR_VERSION_IPV6);
+  sums->prefix_len += pfx->mask_len;
+}
+
+// the columns of a batch of records hold the same fields as their elems
+static int test_singlefile_elem_columns()
+{
+  bgpstream_record_t *recs[BATCH_SIZE];
+  bgpstream_elem_t *elem;
+  bgpstream_elem_columns_t *cols;
+  bgpstream_as_path_store_t *store;
+  bgpstream_pfx_t no_pfx, *pfx;
+  elem_sums_t row_sums, col_sums;
+  uint32_t origin_asn;
+  int ret, i, bad_paths = 0, bad_records = 0;
+
+  memset(&no_pfx, 0, sizeof(no_pfx));
+  memset(&row_sums, 0, sizeof(row_sums));
+  memset(&col_sums, 0, sizeof(col_sums));
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (rows)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      pfx = &no_pfx;
+      origin_asn = 0;
+      switch (elem->type) {
+      case BGPSTREAM_ELEM_TYPE_RIB:
+      case BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT:
+        if (bgpstream_as_path_get_origin_val(elem->as_path, &origin_asn) !=
+            0) {
+          origin_asn = 0;
+        }
+        // fall through
+      case BGPSTREAM_ELEM_TYPE_WITHDRAWAL:
+        pfx = &elem->prefix;
+        break;
+      default:
+        break;
+      }
+      add_elem_sums(&row_sums, elem->type, rec->time_sec, elem->peer_asn,
+                    origin_asn, pfx);
+    }
+  }
+  CHECK("final return code (rows)", ret == 0);
+  TEARDOWN;
+  CHECK("row elems", row_sums.cnt > 0);
+
+  CHECK("create path store",
+        (store = bgpstream_as_path_store_create()) != NULL);
+  CHECK("create elem columns",
+        (cols = bgpstream_elem_columns_create(store)) != NULL);
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (columns)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_records(bs, recs, BATCH_SIZE)) > 0) {
+    bgpstream_elem_columns_clear(cols);
+    CHECK("get elem columns",
+          bgpstream_records_get_elem_columns(recs, ret, cols) == cols->cnt);
+    for (i = 0; i < cols->cnt; i++) {
+      add_elem_sums(&col_sums, cols->type[i], cols->time_sec[i],
+                    cols->peer_asn[i], cols->origin_asn[i], &cols->prefix[i]);
+      if (cols->record_idx[i] < 0 || cols->record_idx[i] >= ret ||
+          recs[cols->record_idx[i]]->time_sec != cols->time_sec[i]) {
+        bad_records++;
+      }
+      if ((cols->type[i] == BGPSTREAM_ELEM_TYPE_RIB ||
+           cols->type[i] == BGPSTREAM_ELEM_TYPE_ANNOUNCEMENT) &&
+          bgpstream_as_path_store_get_store_path(store, cols->path_id[i]) ==
+            NULL) {
+        bad_paths++;
+      }
+    }
+  }
+  CHECK("final return code (columns)", ret == 0);
+  TEARDOWN;
+
+  CHECK("column sums match", memcmp(&row_sums, &col_sums,
+                                    sizeof(elem_sums_t)) == 0);
+  CHECK("column record indexes", bad_records == 0);
+  CHECK("column path IDs", bad_paths == 0 &&
+                             bgpstream_as_path_store_get_size(store) > 0);
+
+  bgpstream_elem_columns_destroy(cols);
+  bgpstream_as_path_store_destroy(store);
+  return 0;
+}
+
+// counts the elems it is given, and stops the iteration once it has been given
+// `limit` of them (if set)
+typedef struct elem_visit {
+  int cnt;
+  int limit;
+} elem_visit_t;
+
+static int visit_elem(bgpstream_record_t *record, bgpstream_elem_t *elem,
+                      void *user)
+{
+  elem_visit_t *visit = user;
+  visit->cnt++;
+  return visit->limit != 0 && visit->cnt == visit->limit;
+}
+
+// visiting the elems of the stream gives the same elems as getting them
+static int test_singlefile_foreach_elem()
+{
+  bgpstream_elem_t *elem;
+  elem_visit_t visit = {0, 0};
+  int ret, elem_cnt = 0, rec_visits = 0;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (get)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      elem_cnt++;
+    }
+  }
+  CHECK("final return code (get)", ret == 0);
+  TEARDOWN;
+  CHECK("elems", elem_cnt > 0);
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (foreach)", bgpstream_start(bs) == 0);
+  CHECK("foreach elem", bgpstream_foreach_elem(bs, visit_elem, &visit) == 0);
+  TEARDOWN;
+  CHECK("visited elems", visit.cnt == elem_cnt);
+
+  // stop half-way through the stream, then visit the rest record by record
+  visit.cnt = 0;
+  visit.limit = elem_cnt / 2;
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (stop)", bgpstream_start(bs) == 0);
+  CHECK("foreach elem stops",
+        bgpstream_foreach_elem(bs, visit_elem, &visit) == 1 &&
+          visit.cnt == visit.limit);
+  visit.limit = 0;
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (bgpstream_record_foreach_elem(rec, visit_elem, &visit) == 0) {
+      rec_visits++;
+    }
+  }
+  CHECK("final return code (stop)", ret == 0);
+  TEARDOWN;
+  CHECK("visited records", rec_visits > 0 && visit.cnt <= elem_cnt);
+
+  return 0;
+}
+
+// the name IDs of every record stand for its names
+static int test_singlefile_name_ids()
+{
+  const char *project, *collector;
+  int ret, bad_names = 0;
+  bgpstream_name_id_t collector_id = 0;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (name IDs)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    project = bgpstream_record_get_name(rec->project_id);
+    collector = bgpstream_record_get_name(rec->collector_id);
+    if (project == NULL || strcmp(project, rec->project_name) != 0 ||
+        collector == NULL || strcmp(collector, rec->collector_name) != 0 ||
+        rec->router_id != 0) {
+      bad_names++;
+    }
+    // both files are from the same collector
+    if (collector_id != 0 && rec->collector_id != collector_id) {
+      bad_names++;
+    }
+    collector_id = rec->collector_id;
+  }
+  CHECK("final return code (name IDs)", ret == 0);
+  TEARDOWN;
+  CHECK("record name IDs", bad_names == 0 && collector_id != 0);
+  CHECK("unknown name ID", bgpstream_record_get_name(UINT32_MAX) == NULL &&
+                             strcmp(bgpstream_record_get_name(0), "") == 0);
+
+  return 0;
+}
+
+#define FORMATTER_CUSTOM_TEMPLATE "%{peer_asn}%%"
+#define FORMATTER_INVALID_TEMPLATE "%{no_such_field}"
+
+// the formatter renders elems exactly as the snprintf functions do
+static int test_singlefile_elem_formatter()
+{
+  bgpstream_elem_formatter_t *fmt, *bgpdump, *custom;
+  bgpstream_elem_t *elem;
+  const char *out;
+  char expect[65536];
+  int ret, elem_cnt = 0, bad_elems = 0;
+
+  CHECK("elem formatter create",
+        (fmt = bgpstream_elem_formatter_create(NULL)) != NULL &&
+          (bgpdump = bgpstream_elem_formatter_create_bgpdump()) != NULL &&
+          (custom = bgpstream_elem_formatter_create(
+             FORMATTER_CUSTOM_TEMPLATE)) != NULL);
+  CHECK("elem formatter invalid template",
+        bgpstream_elem_formatter_create(FORMATTER_INVALID_TEMPLATE) == NULL);
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (elem formatter)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      elem_cnt++;
+      bgpstream_elem_formatter_clear(fmt);
+      if (bgpstream_record_elem_snprintf(expect, sizeof(expect), rec, elem) ==
+            NULL ||
+          bgpstream_elem_formatter_add_elem(fmt, rec, elem) != 0 ||
+          bgpstream_elem_formatter_get_output(fmt, &out) !=
+            strlen(expect) + 1 ||
+          strncmp(out, expect, strlen(expect)) != 0) {
+        bad_elems++;
+      }
+      bgpstream_elem_formatter_clear(bgpdump);
+      if (bgpstream_record_elem_bgpdump_snprintf(expect, sizeof(expect), rec,
+                                                 elem) == NULL ||
+          bgpstream_elem_formatter_add_elem(bgpdump, rec, elem) != 0 ||
+          bgpstream_elem_formatter_get_output(bgpdump, &out) !=
+            (expect[0] == '\0' ? 0 : strlen(expect) + 1) ||
+          strncmp(out, expect, strlen(expect)) != 0) {
+        bad_elems++;
+      }
+      bgpstream_elem_formatter_clear(custom);
+      snprintf(expect, sizeof(expect), "%" PRIu32 "%c\n", elem->peer_asn,
+               '%');
+      if (bgpstream_elem_formatter_add_elem(custom, rec, elem) != 0 ||
+          bgpstream_elem_formatter_get_output(custom, &out) == 0 ||
+          strcmp(out, expect) != 0) {
+        bad_elems++;
+      }
+    }
+  }
+  CHECK("final return code (elem formatter)", ret == 0);
+  TEARDOWN;
+  CHECK("formatted elems", elem_cnt > 0 && bad_elems == 0);
+
+  bgpstream_elem_formatter_destroy(fmt);
+  bgpstream_elem_formatter_destroy(bgpdump);
+  bgpstream_elem_formatter_destroy(custom);
+  return 0;
+}
+
+// routes in the deduplication table
+#define DEDUP_ENTRIES (1 << 20)
+
+// reads the files with and without deduplication, checking that the elems
+// dropped as duplicates are accounted for
+static int test_singlefile_dedup()
+{
+  bgpstream_perf_stats_t stats;
+  bgpstream_mem_stats_t mem_stats;
+  bgpstream_elem_t *elem;
+  int all = 0, kept = 0;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (no dedup)", bgpstream_start(bs) == 0);
+  while (bgpstream_get_next_record(bs, &rec) > 0) {
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      all++;
+    }
+  }
+  bgpstream_get_perf_stats(bs, &stats);
+  CHECK("no duplicates without dedup", stats.elems_duplicate == 0);
+  TEARDOWN;
+
+  // remember every route, so that repeated announcements are dropped too
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("dedup set", bgpstream_set_dedup(bs, 0, DEDUP_ENTRIES) == 0 &&
+                       bgpstream_set_dedup(bs, 0, 0) != 0);
+  CHECK("stream start (dedup)", bgpstream_start(bs) == 0);
+  while (bgpstream_get_next_record(bs, &rec) > 0) {
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      kept++;
+    }
+  }
+  bgpstream_get_perf_stats(bs, &stats);
+  bgpstream_get_mem_stats(bs, &mem_stats);
+  CHECK("duplicates dropped", stats.elems_duplicate != 0 &&
+                                stats.elems_duplicate + kept == (uint64_t)all);
+  CHECK("dedup table accounted", mem_stats.used[BGPSTREAM_MEM_DEDUP] >=
+                                   DEDUP_ENTRIES * sizeof(uint64_t));
+  TEARDOWN;
+  return 0;
+}
+
+// reads the files with a tiny memory limit, checking the stats along the way
+static int test_singlefile_mem_stats()
+{
+  bgpstream_mem_stats_t stats, peak_stats;
+  int ret, counter = 0, in_use = 0;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  bgpstream_set_mem_limit(bs, 1);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (memory stats)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status == BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      counter++;
+    }
+    bgpstream_get_mem_stats(bs, &stats);
+    if (stats.used[BGPSTREAM_MEM_READERS] != 0 &&
+        stats.used[BGPSTREAM_MEM_DECODE] != 0 &&
+        stats.used[BGPSTREAM_MEM_ELEMS] != 0 &&
+        stats.used[BGPSTREAM_MEM_FILTERS] != 0 &&
+        stats.total >= stats.used[BGPSTREAM_MEM_DECODE] &&
+        stats.peak >= stats.total) {
+      in_use++;
+    }
+  }
+  CHECK("final return code (memory stats)", ret == 0);
+  // records still come in order, just with fewer resources open
+  CHECK("read records (memory stats)", counter == singlefile_RECORDS);
+  CHECK("memory in use while reading", in_use > 0);
+  bgpstream_get_mem_stats(bs, &peak_stats);
+  CHECK("memory limit and peak",
+        peak_stats.limit == 1 && peak_stats.peak >= stats.total);
+  TEARDOWN;
+  return 0;
+}
+
+// reads the files with the decode workers pinned to CPUs, which only changes
+// where the work is done
+static int test_singlefile_thread_affinity()
+{
+  int ret, counter = 0;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  CHECK("thread affinity (invalid CPU list)",
+        bgpstream_set_thread_affinity(bs, BGPSTREAM_THREAD_AFFINITY_CPU,
+                                      "0-x") != 0);
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+  CHECK("thread affinity",
+        bgpstream_set_thread_affinity(bs, BGPSTREAM_THREAD_AFFINITY_CPU,
+                                      NULL) == 0);
+#endif
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (thread affinity)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status == BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      counter++;
+    }
+  }
+  CHECK("final return code (thread affinity)", ret == 0);
+  CHECK("read records (thread affinity)", counter == singlefile_RECORDS);
+  TEARDOWN;
+  return 0;
+}
+
+// reads the files with elem filters and timing, checking that the throughput
+// stats add up
+static int test_singlefile_perf_stats()
+{
+  bgpstream_perf_stats_t stats;
+  bgpstream_collector_stats_t collectors[8];
+  uint64_t collector_records = 0;
+  bgpstream_elem_t *elem;
+  int counter = 0, passed = 0;
+  int collectors_cnt, i;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_ELEM_TYPE, "announcements");
+  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_ELEM_NOT_PEER_ASN,
+                       STR(FILTER_PEER_ASN));
+  bgpstream_set_perf_timing(bs);
+  CHECK("stream start (perf stats)", bgpstream_start(bs) == 0);
+  while (bgpstream_get_next_record(bs, &rec) > 0) {
+    counter++;
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      passed++;
+    }
+  }
+  bgpstream_get_perf_stats(bs, &stats);
+  CHECK("records counted", stats.records == (uint64_t)counter);
+  CHECK("elems counted", stats.elems_passed == (uint64_t)passed &&
+                            stats.elems >= stats.elems_passed);
+  CHECK("filter runs counted",
+        stats.filter_runs[BGPSTREAM_PERF_FILTER_ELEM_TYPE] == stats.elems &&
+          stats.filter_runs[BGPSTREAM_PERF_FILTER_NOT_PEER_ASN] != 0 &&
+          stats.filter_runs[BGPSTREAM_PERF_FILTER_PEER_ASN] == 0);
+  CHECK("bytes read counted",
+        stats.transport_bytes[BGPSTREAM_PERF_TRANSPORT_FILE] != 0 &&
+          stats.transport_bytes[BGPSTREAM_PERF_TRANSPORT_HTTP] == 0);
+  CHECK("reads timed",
+        stats.transport_reads[BGPSTREAM_PERF_TRANSPORT_FILE] != 0 &&
+          stats.transport_read_ns[BGPSTREAM_PERF_TRANSPORT_FILE] != 0 &&
+          stats.transport_reads[BGPSTREAM_PERF_TRANSPORT_HTTP] == 0);
+  CHECK("data interface queries counted", stats.di_queries != 0);
+  CHECK("stages timed",
+        stats.stage_ns[BGPSTREAM_PERF_STAGE_OPEN] != 0 &&
+          stats.stage_ns[BGPSTREAM_PERF_STAGE_READ] != 0 &&
+          stats.stage_ns[BGPSTREAM_PERF_STAGE_DECOMPRESS] != 0 &&
+          stats.stage_ns[BGPSTREAM_PERF_STAGE_DECODE] != 0 &&
+          stats.stage_ns[BGPSTREAM_PERF_STAGE_ELEMS] != 0 &&
+          stats.stage_ns[BGPSTREAM_PERF_STAGE_MERGE] != 0);
+  CHECK("no resources left open", stats.open_resources == 0);
+  collectors_cnt = bgpstream_get_collector_stats(bs, collectors, 8);
+  CHECK("collectors counted", collectors_cnt > 0 && collectors_cnt <= 8);
+  for (i = 0; i < collectors_cnt; i++) {
+    collector_records += collectors[i].records;
+  }
+  CHECK("collector records add up", collector_records == stats.records);
+  CHECK("metrics written",
+        bgpstream_write_metrics(bs, "bgpstream-test.prom") == 0 &&
+          remove("bgpstream-test.prom") == 0);
+  TEARDOWN;
+  return 0;
+}
+
+// reads the files through the reorder buffer, checking that records come out
+// in time order
+static int test_singlefile_max_skew()
+{
+  int ret, counter = 0, out_of_order = 0;
+  uint32_t last_time = 0;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  CHECK("set max skew", bgpstream_set_max_skew(bs, 30) == 0);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (max skew)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if (rec->status == BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      counter++;
+    }
+    if (rec->time_sec != 0) {
+      if (rec->time_sec < last_time) {
+        out_of_order++;
+      }
+      last_time = rec->time_sec;
+    }
+  }
+  CHECK("final return code (max skew)", ret == 0);
+  CHECK("read records (max skew)", counter == singlefile_RECORDS);
+  CHECK("records in time order", out_of_order == 0);
+  TEARDOWN;
+  return 0;
+}
+
+// reads the files while logging asynchronously
+static int test_singlefile_async_log()
+{
+  int counter = 0;
+
+  CHECK("start async log", bgpstream_start_async_log() == 0);
+  CHECK("async log already started", bgpstream_start_async_log() != 0);
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (async log)", bgpstream_start(bs) == 0);
+  while (bgpstream_get_next_record(bs, &rec) > 0) {
+    counter++;
+  }
+  TEARDOWN;
+  bgpstream_stop_async_log();
+  CHECK("records read (async log)", counter > 0);
+  CHECK("restart async log", bgpstream_start_async_log() == 0);
+  bgpstream_stop_async_log();
+  return 0;
+}
+
+#define RETAIN_MAX 256
+
+// records retained while the stream moves on (and after their reader is gone)
+// still hold the same elems
+static int test_singlefile_retain()
+{
+  bgpstream_record_t *kept[RETAIN_MAX];
+  bgpstream_elem_t *elem;
+  uint32_t times[RETAIN_MAX];
+  int elem_cnts[RETAIN_MAX];
+  int ret, i, cnt, rec_idx = 0, kept_cnt = 0, bad_records = 0;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (count)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if ((rec_idx++ & 3) != 0 || kept_cnt == RETAIN_MAX) {
+      continue;
+    }
+    elem_cnts[kept_cnt] = 0;
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      elem_cnts[kept_cnt]++;
+    }
+    times[kept_cnt++] = rec->time_sec;
+  }
+  CHECK("final return code (count)", ret == 0);
+  TEARDOWN;
+  CHECK("records to retain", kept_cnt > 0);
+
+  rec_idx = kept_cnt = 0;
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (retain)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    if ((rec_idx++ & 3) == 0 && kept_cnt < RETAIN_MAX) {
+      kept[kept_cnt++] = bgpstream_record_retain(rec);
+    }
+  }
+  CHECK("final return code (retain)", ret == 0);
+
+  // only read the elems once the stream has finished
+  for (i = 0; i < kept_cnt; i++) {
+    cnt = 0;
+    while (bgpstream_record_get_next_elem(kept[i], &elem) > 0) {
+      cnt++;
+    }
+    if (kept[i]->time_sec != times[i] || cnt != elem_cnts[i]) {
+      bad_records++;
+    }
+    bgpstream_record_release(kept[i]);
+  }
+  TEARDOWN;
+  CHECK("retained records", bad_records == 0);
+
+  return 0;
+}
+
+#define ARROW_OUT_FILE "bgpstream-test.arrow"
+
+// every elem of the stream is written to the Arrow stream, whose messages
+// (padded to 8 bytes) start with the schema and end with an end-of-stream
+// marker
+static int test_singlefile_arrow_writer()
+{
+  bgpstream_arrow_writer_t *writer;
+  bgpstream_elem_t *elem;
+  io_t *in;
+  uint8_t frame[8];
+  uint32_t meta_len;
+  int ret, written, rec_cnt = 0, elem_cnt = 0, written_cnt = 0, eos = 0;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("create Arrow writer",
+        (writer = bgpstream_arrow_writer_create(ARROW_OUT_FILE)) != NULL);
+  CHECK("unknown Arrow column",
+        bgpstream_arrow_writer_set_columns(writer, "time,bogus") != 0);
+  CHECK("set Arrow columns",
+        bgpstream_arrow_writer_set_columns(writer, "prefix,time,as_path") ==
+          0);
+  CHECK("stream start (Arrow)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    // alternate between writing whole records and adding single elems
+    if ((rec_cnt++ % 2) == 0) {
+      CHECK("write record",
+            (written = bgpstream_arrow_writer_write(writer, rec)) >= 0);
+      elem_cnt += written;
+      written_cnt += written;
+      continue;
+    }
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      elem_cnt++;
+      if (bgpstream_arrow_writer_add_elem(writer, rec, elem) == 0) {
+        written_cnt++;
+      }
+    }
+  }
+  CHECK("final return code (Arrow)", ret == 0);
+  CHECK("Arrow columns are fixed",
+        bgpstream_arrow_writer_set_columns(writer, "time") != 0);
+  bgpstream_arrow_writer_destroy(writer);
+  TEARDOWN;
+  CHECK("elems written", written_cnt == elem_cnt && elem_cnt > 0);
+
+  CHECK("open Arrow file", (in = wandio_create(ARROW_OUT_FILE)) != NULL);
+  CHECK("read schema frame", wandio_read(in, frame, 8) == 8);
+  memcpy(&meta_len, frame + 4, sizeof(meta_len));
+  CHECK("schema frame", memcmp(frame, "\xff\xff\xff\xff", 4) == 0 &&
+                          meta_len > 0 && (meta_len & 7) == 0);
+  while ((ret = wandio_read(in, frame, 8)) == 8) {
+    eos = memcmp(frame, "\xff\xff\xff\xff\0\0\0\0", 8) == 0;
+  }
+  wandio_destroy(in);
+  CHECK("Arrow stream ends", ret == 0 && eos != 0);
+
+  return 0;
+}
+
+static int test_singlefile_uncompressed()
+{
+  bgpstream_elem_t *elem;
+  io_t *in;
+  iow_t *iow;
+  const uint8_t *bin;
+  ssize_t len;
+  char buf[65536];
+  int ret, rec_elem_cnt;
+  uint64_t elem_cnt = 0, text_len = 0, compressed_cnt, compressed_len;
 
-  RUN(singlefile);
+  CHECK("open updates file",
+        (in = wandio_create("ris.rrc06.updates.1427846400.gz")) != NULL);
+  CHECK("create uncompressed file",
+        (iow = wandio_wcreate(UNCOMPRESSED_OUT_FILE, WANDIO_COMPRESS_NONE, 0,
+                              O_CREAT)) != NULL);
+  while ((len = wandio_read(in, buf, sizeof(buf))) > 0) {
+    CHECK("write uncompressed file", wandio_wwrite(iow, buf, len) == len);
+  }
+  CHECK("read updates file", len == 0);
+  wandio_destroy(in);
+  wandio_wdestroy(iow);
 
+  SETUP;
+  RUN_BINARY("compressed", "ris.rrc06.updates.1427846400.gz", "mrt",
+             (bgpstream_binary_writer_t *)NULL);
+  TEARDOWN;
+  CHECK("compressed elems", elem_cnt > 0);
+
+  compressed_cnt = elem_cnt;
+  compressed_len = text_len;
+  elem_cnt = text_len = 0;
+  SETUP;
+  RUN_BINARY("uncompressed", UNCOMPRESSED_OUT_FILE, "mrt",
+             (bgpstream_binary_writer_t *)NULL);
+  TEARDOWN;
+  CHECK("uncompressed elems", elem_cnt == compressed_cnt);
+  CHECK("uncompressed elem text", text_len == compressed_len);
+
+  return 0;
+}
+
+#define SHARD_CNT 3
+
+static int test_singlefile_shards()
+{
+  int shard;
+  int ret;
+  int counter = 0;
+
+  // every record must be in exactly one of the shards
+  for (shard = 0; shard < SHARD_CNT; shard++) {
+    SETUP;
+
+    CHECK_SET_INTERFACE(singlefile);
+    CHECK("add shard filter",
+          bgpstream_add_shard_filter(bs, shard, SHARD_CNT, 0) == 1);
+
+    SET_SINGLEFILE_OPTIONS;
+
+    CHECK("stream start (singlefile shard)", bgpstream_start(bs) == 0);
+    while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+      if (rec->status == BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+        counter++;
+      }
+    }
+    CHECK("final return code (singlefile shard)", ret == 0);
+
+    TEARDOWN;
+  }
+
+  CHECK("read records (singlefile shards)", counter == singlefile_RECORDS);
+
+  SETUP;
+  CHECK("reject invalid shard",
+        bgpstream_add_shard_filter(bs, SHARD_CNT, SHARD_CNT, 0) == 0);
+  TEARDOWN;
+
+  return 0;
+}
+
+#define SAMPLE_SLICE_CNT 2
+
+// adds the elems of one sample slice to elems, returning 0 if there are none
+static int sample_elems(bgpstream_sample_key_t key, uint32_t slice,
+                        uint64_t *elems)
+{
+  bgpstream_elem_t *elem;
+  uint64_t cnt = 0;
+  int ret;
+
+  SETUP;
+  CHECK_SET_INTERFACE(singlefile);
+  CHECK("add sample filter",
+        bgpstream_add_sample_filter(bs, key, slice, SAMPLE_SLICE_CNT) == 1);
+  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_ELEM_TYPE, "ribs");
+  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_ELEM_TYPE, "announcements");
+  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_ELEM_TYPE, "withdrawals");
+  SET_SINGLEFILE_OPTIONS;
+  CHECK("stream start (singlefile sample)", bgpstream_start(bs) == 0);
+  while ((ret = bgpstream_get_next_record(bs, &rec)) > 0) {
+    while (bgpstream_record_get_next_elem(rec, &elem) > 0) {
+      cnt++;
+    }
+  }
+  CHECK("final return code (singlefile sample)", ret == 0);
+  TEARDOWN;
+  *elems += cnt;
+  return cnt != 0;
+}
+
+// the slices of a sample must together hold every elem, whatever the key
+static int test_singlefile_sample()
+{
+  uint64_t pfx_elems = 0, peer_elems = 0;
+  uint32_t slice;
+
+  for (slice = 0; slice < SAMPLE_SLICE_CNT; slice++) {
+    CHECK("prefix sample slice not empty",
+          sample_elems(BGPSTREAM_SAMPLE_KEY_PREFIX, slice, &pfx_elems));
+    CHECK("peer sample slice not empty",
+          sample_elems(BGPSTREAM_SAMPLE_KEY_PEER_ASN, slice, &peer_elems));
+  }
+  CHECK("sample slices add up", pfx_elems == peer_elems);
+
+  SETUP;
+  CHECK("reject invalid sample",
+        bgpstream_add_sample_filter(bs, BGPSTREAM_SAMPLE_KEY_PREFIX,
+                                    SAMPLE_SLICE_CNT, SAMPLE_SLICE_CNT) == 0);
   TEARDOWN;
   return 0;
 }
+
+#define CONTEXT_STREAM_CNT 2
+
+// streams of one context, read in turns, must each read every record
+static int test_singlefile_context()
+{
+  bgpstream_context_t *ctx;
+  bgpstream_t *streams[CONTEXT_STREAM_CNT];
+  int counters[CONTEXT_STREAM_CNT];
+  int rets[CONTEXT_STREAM_CNT];
+  int i, running;
+
+  CHECK("context create", (ctx = bgpstream_context_create()) != NULL);
+  CHECK("set context worker threads",
+        bgpstream_context_set_worker_threads(ctx, 4) == 0);
+
+  for (i = 0; i < CONTEXT_STREAM_CNT; i++) {
+    CHECK("BGPStream create (context)",
+          (bs = bgpstream_create_with_context(ctx)) != NULL);
+    CHECK("reject stream worker threads (context)",
+          bgpstream_set_worker_threads(bs, 2) != 0);
+    CHECK_SET_INTERFACE(singlefile);
+    SET_SINGLEFILE_OPTIONS;
+    CHECK("stream start (context)", bgpstream_start(bs) == 0);
+    streams[i] = bs;
+    counters[i] = 0;
+    rets[i] = 1;
+  }
+  bs = NULL;
+
+  // the streams hold the context until they are destroyed
+  bgpstream_context_destroy(ctx);
+  CHECK("reject worker threads once started",
+        bgpstream_context_set_worker_threads(ctx, 8) != 0);
+
+  do {
+    running = 0;
+    for (i = 0; i < CONTEXT_STREAM_CNT; i++) {
+      if (rets[i] <= 0) {
+        continue;
+      }
+      if ((rets[i] = bgpstream_get_next_record(streams[i], &rec)) > 0) {
+        if (rec->status == BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+          counters[i]++;
+        }
+        running = 1;
+      }
+    }
+  } while (running != 0);
+
+  for (i = 0; i < CONTEXT_STREAM_CNT; i++) {
+    CHECK("final return code (context)", rets[i] == 0);
+    CHECK("read records (context)", counters[i] == singlefile_RECORDS);
+    bgpstream_destroy(streams[i]);
+  }
+
+  return 0;
+}
 #endif
 
 #ifdef WITH_DATA_INTERFACE_CSVFILE
@@ -133,6 +2131,28 @@ static int test_csvfile()
 }
 #endif
 
+#ifdef WITH_DATA_INTERFACE_DIRECTORY
+static int test_directory()
+{
+  SETUP;
+
+  CHECK_SET_INTERFACE(directory);
+
+  CHECK("get option (dir)",
+        (option = bgpstream_get_data_interface_option_by_name(
+           bs, di_id, "dir")) != NULL);
+  bgpstream_set_data_interface_option(bs, option, ".");
+
+  // the same dumps the csvfile test reads, found by their names
+  bgpstream_add_filter(bs, BGPSTREAM_FILTER_TYPE_COLLECTOR, "rrc06");
+
+  RUN(directory);
+
+  TEARDOWN;
+  return 0;
+}
+#endif
+
 #ifdef WITH_DATA_INTERFACE_SQLITE
 static int test_sqlite()
 {
@@ -184,11 +2204,115 @@ static int test_broker()
 int main()
 {
   CHECK_SECTION("BGPStream", test_bgpstream() == 0);
+  CHECK_SECTION("BGPStream checkpoints", test_checkpoint() == 0);
+  CHECK_SECTION("elem generator", test_elem_generator() == 0);
+  CHECK_SECTION("reorder buffer", test_reorder() == 0);
 
 #ifdef WITH_DATA_INTERFACE_SINGLEFILE
   CHECK_SECTION("singlefile data interface", test_singlefile() == 0);
+  CHECK_SECTION("singlefile data interface (read-ahead)",
+                test_singlefile_readahead() == 0);
+  CHECK_SECTION("singlefile data interface (heap merge)",
+                test_singlefile_heap_merge() == 0);
+  CHECK_SECTION("singlefile data interface (batch)",
+                test_singlefile_batch() == 0);
+  CHECK_SECTION("singlefile data interface (unordered)",
+                test_singlefile_unordered() == 0);
+  CHECK_SECTION("singlefile data interface (open limit)",
+                test_singlefile_max_open() == 0);
+  CHECK_SECTION("singlefile data interface (shards)",
+                test_singlefile_shards() == 0);
+  CHECK_SECTION("singlefile data interface (sample)",
+                test_singlefile_sample() == 0);
+  CHECK_SECTION("singlefile data interface (non-blocking)",
+                test_singlefile_nonblocking() == 0);
+  CHECK_SECTION("singlefile data interface (prefetch)",
+                test_singlefile_prefetch() == 0);
+  CHECK_SECTION("singlefile data interface (lazy elems)",
+                test_singlefile_lazy_elems() == 0);
+  CHECK_SECTION("singlefile data interface (attribute cache)",
+                test_singlefile_attr_cache() == 0);
+  CHECK_SECTION("singlefile data interface (decode threads)",
+                test_singlefile_decode_threads() == 0);
+  CHECK_SECTION("singlefile data interface (elem filters)",
+                test_singlefile_elem_filters() == 0);
+  CHECK_SECTION("singlefile data interface (elem fields)",
+                test_singlefile_elem_fields() == 0);
+  CHECK_SECTION("singlefile data interface (MRT writer)",
+                test_singlefile_mrt_writer() == 0);
+  CHECK_SECTION("singlefile data interface (binary)",
+                test_singlefile_binary() == 0);
+  CHECK_SECTION("singlefile data interface (shared memory ring)",
+                test_singlefile_shmring() == 0);
+  CHECK_SECTION("singlefile data interface (summaries)",
+                test_singlefile_summaries() == 0);
+  CHECK_SECTION("singlefile data interface (filter sets)",
+                test_singlefile_filter_sets() == 0);
+  CHECK_SECTION("singlefile data interface (filter reload)",
+                test_singlefile_filter_reload() == 0);
+  CHECK_SECTION("singlefile data interface (prefix filters)",
+                test_singlefile_prefix_filters() == 0);
+  CHECK_SECTION("singlefile data interface (elem columns)",
+                test_singlefile_elem_columns() == 0);
+  CHECK_SECTION("singlefile data interface (Arrow writer)",
+                test_singlefile_arrow_writer() == 0);
+  CHECK_SECTION("singlefile data interface (foreach elem)",
+                test_singlefile_foreach_elem() == 0);
+  CHECK_SECTION("singlefile data interface (retained records)",
+                test_singlefile_retain() == 0);
+  CHECK_SECTION("singlefile data interface (name IDs)",
+                test_singlefile_name_ids() == 0);
+  CHECK_SECTION("singlefile data interface (elem formatter)",
+                test_singlefile_elem_formatter() == 0);
+  CHECK_SECTION("singlefile data interface (memory stats)",
+                test_singlefile_mem_stats() == 0);
+  CHECK_SECTION("singlefile data interface (thread affinity)",
+                test_singlefile_thread_affinity() == 0);
+  CHECK_SECTION("singlefile data interface (perf stats)",
+                test_singlefile_perf_stats() == 0);
+  CHECK_SECTION("singlefile data interface (dedup)",
+                test_singlefile_dedup() == 0);
+  CHECK_SECTION("singlefile data interface (max skew)",
+                test_singlefile_max_skew() == 0);
+  CHECK_SECTION("singlefile data interface (uncompressed)",
+                test_singlefile_uncompressed() == 0);
+  CHECK_SECTION("singlefile data interface (async log)",
+                test_singlefile_async_log() == 0);
+  CHECK_SECTION("singlefile data interface (context)",
+                test_singlefile_context() == 0);
 #else
   SKIPPED_SECTION("singlefile data interface");
+  SKIPPED_SECTION("singlefile data interface (read-ahead)");
+  SKIPPED_SECTION("singlefile data interface (heap merge)");
+  SKIPPED_SECTION("singlefile data interface (batch)");
+  SKIPPED_SECTION("singlefile data interface (unordered)");
+  SKIPPED_SECTION("singlefile data interface (open limit)");
+  SKIPPED_SECTION("singlefile data interface (shards)");
+  SKIPPED_SECTION("singlefile data interface (non-blocking)");
+  SKIPPED_SECTION("singlefile data interface (prefetch)");
+  SKIPPED_SECTION("singlefile data interface (lazy elems)");
+  SKIPPED_SECTION("singlefile data interface (attribute cache)");
+  SKIPPED_SECTION("singlefile data interface (decode threads)");
+  SKIPPED_SECTION("singlefile data interface (elem filters)");
+  SKIPPED_SECTION("singlefile data interface (elem fields)");
+  SKIPPED_SECTION("singlefile data interface (MRT writer)");
+  SKIPPED_SECTION("singlefile data interface (binary)");
+  SKIPPED_SECTION("singlefile data interface (summaries)");
+  SKIPPED_SECTION("singlefile data interface (filter sets)");
+  SKIPPED_SECTION("singlefile data interface (filter reload)");
+  SKIPPED_SECTION("singlefile data interface (prefix filters)");
+  SKIPPED_SECTION("singlefile data interface (elem columns)");
+  SKIPPED_SECTION("singlefile data interface (Arrow writer)");
+  SKIPPED_SECTION("singlefile data interface (foreach elem)");
+  SKIPPED_SECTION("singlefile data interface (retained records)");
+  SKIPPED_SECTION("singlefile data interface (name IDs)");
+  SKIPPED_SECTION("singlefile data interface (elem formatter)");
+  SKIPPED_SECTION("singlefile data interface (memory stats)");
+  SKIPPED_SECTION("singlefile data interface (perf stats)");
+  SKIPPED_SECTION("singlefile data interface (max skew)");
+  SKIPPED_SECTION("singlefile data interface (uncompressed)");
+  SKIPPED_SECTION("singlefile data interface (async log)");
+  SKIPPED_SECTION("singlefile data interface (context)");
 #endif
 
 #ifdef WITH_DATA_INTERFACE_CSVFILE
@@ -197,6 +2321,12 @@ int main()
   SKIPPED_SECTION("csvfile data interface");
 #endif
 
+#ifdef WITH_DATA_INTERFACE_DIRECTORY
+  CHECK_SECTION("directory data interface", test_directory() == 0);
+#else
+  SKIPPED_SECTION("directory data interface");
+#endif
+
 #ifdef WITH_DATA_INTERFACE_SQLITE
   CHECK_SECTION("sqlite data interface", test_sqlite() == 0);
 #else
@@ -39,11 +39,13 @@
 #include <time.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
 #include <sys/ioctl.h> // for TIOCGWINSZ
 #ifdef WITH_RPKI
 #include "utils/bgpstream_utils_rpki.h"
 #endif
 #include "bgpstream.h"
+#include "utils/bgpstream_utils_rib.h"
 #include "utils.h"
 #include "getopt.h"
 
@@ -78,6 +80,37 @@ enum rpki_options {
   RPKI_OPTION_DEFAULT = 504
 };
 
+enum reader_options {
+  READER_OPTION_READAHEAD = 600,
+  READER_OPTION_WORKER_THREADS = 601,
+  READER_OPTION_HEAP_MERGE = 602,
+  READER_OPTION_UNORDERED = 603,
+  READER_OPTION_SHARD = 604,
+  READER_OPTION_MAX_OPEN = 605,
+  READER_OPTION_PREFETCH = 606,
+  READER_OPTION_DECODE_THREADS = 607,
+  READER_OPTION_MRT_OUT = 608,
+  READER_OPTION_OUTPUT_BINARY = 609,
+  READER_OPTION_SUMMARIES = 610,
+  READER_OPTION_ARROW_OUT = 611,
+  READER_OPTION_MEM_LIMIT = 612,
+  READER_OPTION_MAX_SKEW = 613,
+  READER_OPTION_THREADS = 614,
+  READER_OPTION_ARROW_COLUMNS = 615,
+  READER_OPTION_STATS = 616,
+  READER_OPTION_CHECKPOINT = 617,
+  READER_OPTION_RIB_DELTA = 618,
+  READER_OPTION_DEDUP = 619,
+  READER_OPTION_METRICS = 620,
+  READER_OPTION_ASYNC_LOG = 621,
+  READER_OPTION_FILTER_FILE = 622,
+  READER_OPTION_THREAD_AFFINITY = 623,
+  READER_OPTION_SAMPLE = 624,
+  READER_OPTION_KAFKA_OUT = 625,
+  READER_OPTION_KAFKA_OUT_OPTION = 626,
+  READER_OPTION_SHM_OUT = 627,
+};
+
 struct bs_options_t {
   struct option option;
   const char *usage;
@@ -127,6 +160,24 @@ static struct bs_options_t bs_opts[] =
   {{"rib-period", required_argument, 0, 'P'},
    "<period>",
    "process a rib files every <period> seconds (bgp time)"},
+  {{"rib-delta", no_argument, 0, READER_OPTION_RIB_DELTA},
+   "",
+   "only output the RIB elems whose route differs from the previous RIB dump "
+   "of the collector (and the updates since), followed by a withdrawal for "
+   "each route that is no longer in the dump"},
+  {{"dedup", required_argument, 0, READER_OPTION_DEDUP},
+   "<sec>[,<routes>]",
+   "drop elems that repeat the last elem of their peer and prefix from the "
+   "last <sec> seconds (0 for no limit), e.g., copies of an update from other "
+   "collectors, remembering up to <routes> routes (default: 1048576)"},
+  {{"shard", required_argument, 0, READER_OPTION_SHARD},
+   "<shard>/<count>[/<span>]",
+   "process only shard <shard> (from 0) of <count> shards, made of time "
+   "slices of <span> seconds of each collector (default: 28800)"},
+  {{"sample", required_argument, 0, READER_OPTION_SAMPLE},
+   "<key>/<slice>/<count>",
+   "return only the elems whose <key> (prefix or peer-asn) hashes to slice "
+   "<slice> (from 0) of <count>, e.g., prefix/0/64 for 1/64 of the prefixes"},
   {{"peer-asn", required_argument, 0, 'j'},
    "<peer ASN>",
    "return elems received by a given peer ASN*"},
@@ -142,13 +193,62 @@ static struct bs_options_t bs_opts[] =
   {{"community", required_argument, 0, 'y'},
    "<community>",
    "return elems with the specified community* "
-   "(format: asn:value. the '*' metacharacter is recognized)"},
+   "(format: asn:value or global:local1:local2 for large communities. "
+   "the '*' metacharacter is recognized)"},
   {{"aspath", required_argument, 0, 'A'},
    "<regex>",
    "return elems that match the aspath regex*"},
+  {{"filter-file", required_argument, 0, READER_OPTION_FILTER_FILE},
+   "<type>:<file>",
+   "return elems matching any of the values listed in <file>, one per line, "
+   "where <type> is one of peer-asn, not-peer-asn, origin-asn, prefix, "
+   "prefix-exact, prefix-more, prefix-less, prefix-any or community*"},
   {{"count", required_argument, 0, 'n'},
    "<rec-cnt>",
    "process at most <rec-cnt> records"},
+  {{"readahead", required_argument, 0, READER_OPTION_READAHEAD},
+   "<rec-cnt>",
+   "decode up to <rec-cnt> records ahead of the output in a separate thread "
+   "for each open resource (default: 0, disabled)"},
+  {{"worker-threads", required_argument, 0, READER_OPTION_WORKER_THREADS},
+   "<threads>",
+   "use <threads> threads to open and decode resources (default: 16)"},
+  {{"thread-affinity", required_argument, 0, READER_OPTION_THREAD_AFFINITY},
+   "<policy>[:<cpus>]",
+   "place the worker threads on the CPUs in <cpus> (e.g. 0-7,16), where "
+   "<policy> is none, node (keep each worker on the NUMA node it starts on) "
+   "or cpu (pin each worker to a CPU) (default: none, Linux only)"},
+  {{"heap-merge", no_argument, 0, READER_OPTION_HEAP_MERGE},
+   "",
+   "merge records from open resources using a heap (faster when many "
+   "resources are open at once)"},
+  {{"max-open", required_argument, 0, READER_OPTION_MAX_OPEN},
+   "<res-cnt>",
+   "open at most <res-cnt> resources at once, where possible (default: 0, no "
+   "limit)"},
+  {{"mem-limit", required_argument, 0, READER_OPTION_MEM_LIMIT},
+   "<MiB>",
+   "open fewer resources at once once <MiB> MiB are in use, where possible "
+   "(default: 0, no limit)"},
+  {{"prefetch", required_argument, 0, READER_OPTION_PREFETCH},
+   "<sec>",
+   "open resources up to <sec> seconds before they are needed (default: 0, "
+   "disabled)"},
+  {{"decode-threads", required_argument, 0, READER_OPTION_DECODE_THREADS},
+   "<threads>",
+   "use <threads> threads to decode each RIB dump (default: 1)"},
+  {{"summaries", no_argument, 0, READER_OPTION_SUMMARIES},
+   "",
+   "skip dump files whose summary (see bgpsummary) shows that no elem can "
+   "pass the peer, origin, prefix and IP version filters"},
+  {{"unordered", no_argument, 0, READER_OPTION_UNORDERED},
+   "",
+   "output records as soon as they are decoded, in no particular order "
+   "across resources"},
+  {{"max-skew", required_argument, 0, READER_OPTION_MAX_SKEW},
+   "<sec>",
+   "put records that are up to <sec> seconds out of order back into time "
+   "order (default: disabled)"},
   {{"live", no_argument, 0, 'l'},
    "",
    "enable live mode (make blocking requests for BGP records); "
@@ -165,6 +265,61 @@ static struct bs_options_t bs_opts[] =
    "",
    "print info "
    "for each BGP record (used mostly for debugging BGPStream)"},
+  {{"mrt-out", required_argument, 0, READER_OPTION_MRT_OUT},
+   "<file>",
+   "write the MRT records that have elems matching the filters to <file> "
+   "(compressed according to its extension); no elems are printed unless "
+   "an output format is also given"},
+  {{"arrow-out", required_argument, 0, READER_OPTION_ARROW_OUT},
+   "<file>",
+   "write the elems matching the filters to <file> as an Apache Arrow IPC "
+   "stream (compressed according to its extension); no elems are printed "
+   "unless an output format is also given"},
+  {{"arrow-columns", required_argument, 0, READER_OPTION_ARROW_COLUMNS},
+   "<col>[,<col>...]",
+   "write only the given columns to the Arrow stream (type, time, project, "
+   "collector, peer_asn, prefix, origin_asn, as_path; default: all)"},
+  {{"output-binary", no_argument, 0, READER_OPTION_OUTPUT_BINARY},
+   "",
+   "write each BGP record that has elems, and its elems, to stdout in the "
+   "BGPStream binary format"},
+  {{"kafka-out", required_argument, 0, READER_OPTION_KAFKA_OUT},
+   "<brokers>/<topic>[/<enc>[/<key>]]",
+   "produce each record that has elems (<enc> binary, the default) or each of "
+   "its elems (json) to the Kafka <topic>, keyed on the collector (the "
+   "default), prefix or peer; no elems are printed unless an output format is "
+   "also given"},
+  {{"kafka-out-option", required_argument, 0, READER_OPTION_KAFKA_OUT_OPTION},
+   "<name>=<value>",
+   "set a librdkafka option of the --kafka-out producer (e.g., linger.ms=500 "
+   "or compression.codec=zstd)"},
+  {{"shm-out", required_argument, 0, READER_OPTION_SHM_OUT},
+   "<name>[/<MiB>]",
+   "write each record that has elems to the shared-memory ring <name> (of "
+   "<MiB> MiB, default: 64), which local processes read with -d singlefile "
+   "-o upd-type=binary -o upd-file=shm://<name>; no elems are printed unless "
+   "an output format is also given"},
+  {{"threads", required_argument, 0, READER_OPTION_THREADS},
+   "<threads>",
+   "render the -e, -m and -r output with <threads> threads; the output is "
+   "the same, in the same order (default: 0, render in the main thread)"},
+  {{"stats", required_argument, 0, READER_OPTION_STATS},
+   "<sec>",
+   "print the record and elem rates, bytes read, open resources, filter "
+   "rejections and time spent in each stage to stderr every <sec> seconds"},
+  {{"checkpoint", required_argument, 0, READER_OPTION_CHECKPOINT},
+   "<file>[,<sec>]",
+   "carry on from the time saved in <file> (if it exists), and save the time "
+   "of the last record output to it every <sec> seconds (default: 60) and "
+   "at the end of the stream"},
+  {{"metrics", required_argument, 0, READER_OPTION_METRICS},
+   "<file>[,<sec>]",
+   "write the stream statistics, including the lag of each collector, to "
+   "<file> in the Prometheus text format every <sec> seconds (default: 15)"},
+  {{"async-log", no_argument, 0, READER_OPTION_ASYNC_LOG},
+   "",
+   "write log messages from a background thread, collapsing repeats and "
+   "rate limiting them, so that bursts of warnings do not slow the stream"},
   {{"output-headers", no_argument, 0, 'i'},
    "",
    "print format information before output"},
@@ -202,7 +357,26 @@ static char short_options[OPTIONS_CNT * 2 + 1];
 
 static char buf[65536];
 
+// renders elems for -e and -m, whose output is written once this much of it
+// has been buffered
+static bgpstream_elem_formatter_t *elem_fmt = NULL;
+#define ELEM_OUTPUT_FLUSH_LEN 65536
+
+// routes remembered by --dedup, unless given
+#define DEDUP_DEFAULT_ROUTES (1 << 20)
+
 static bgpstream_t *bs;
+
+// produces the elems for --kafka-out
+static bgpstream_kafka_writer_t *kafka_writer = NULL;
+#define KAFKA_OPTIONS_MAX 32
+// how long a checkpoint or the end of the stream waits for the messages
+// produced so far to be delivered
+#define KAFKA_FLUSH_MSEC 30000
+
+// writes the elems for --shm-out
+static bgpstream_shmring_writer_t *shm_writer = NULL;
+
 static bgpstream_data_interface_id_t di_id_default = 0;
 static bgpstream_data_interface_id_t di_id = 0;
 static bgpstream_data_interface_info_t *di_info = NULL;
@@ -311,26 +485,912 @@ static void usage()
     if (fprintf(stderr, "--%-*s  ", longopt_width - 2, bs_opts[k].option.name) > longopt_width + 2)
       fprintf(stderr, "\n%*s", optarg_col, "");
 
-    // optarg
-    if (fprintf(stderr, "%-*s  ", optarg_width, bs_opts[k].usage) > optarg_width + 2)
-      fprintf(stderr, "\n%*s", expl_col, "");
+    // optarg
+    if (fprintf(stderr, "%-*s  ", optarg_width, bs_opts[k].usage) > optarg_width + 2)
+      fprintf(stderr, "\n%*s", expl_col, "");
+
+    // explanatory text
+    wrap(bs_opts[k].expl, expl_col, expl_col);
+    fprintf(stderr, "\n");
+    if (bs_opts[k].option.val == 'd') {
+      data_if_usage();
+    }
+  }
+  fprintf(stderr, "* denotes an option that can be given multiple times\n");
+}
+
+// print / utility functions
+
+static int print_record(bgpstream_record_t *record);
+static int print_elem(bgpstream_record_t *record, bgpstream_elem_t *elem);
+static int flush_elems(void);
+
+/* parallel formatting (--threads)
+ *
+ * Records are retained and handed to a pool of formatter threads in batches
+ * that are numbered in stream order. Each batch is rendered into its own
+ * buffer, and the batches are then written out (and their records
+ * acknowledged and released) by the main thread, strictly in order.
+ */
+
+// records per batch, and batches in flight per formatter thread
+#define FMT_BATCH_RECORDS 256
+#define FMT_BATCHES_PER_THREAD 4
+
+typedef struct fmt_batch {
+  bgpstream_record_t *records[FMT_BATCH_RECORDS];
+  int records_cnt;
+
+  // text rendered for the records of the batch
+  char *out;
+  size_t out_len;
+  size_t out_alloc;
+
+  // set once the batch has been rendered (err if that failed)
+  int done;
+  int err;
+} fmt_batch_t;
+
+typedef struct fmt_pool {
+  pthread_t *threads;
+  int threads_cnt;
+
+  // ring of batches, indexed by sequence number
+  fmt_batch_t *batches;
+  int batches_cnt;
+
+  // sequence numbers of the next batch to fill, to render and to write
+  uint64_t fill_seq;
+  uint64_t render_seq;
+  uint64_t write_seq;
+
+  // number of records per batch
+  int batch_records;
+
+  // what to render
+  int records_on;
+  int elems_on;
+  int bgpdump;
+
+  int shutdown;
+  pthread_mutex_t mutex;
+  pthread_cond_t render_cond;
+  pthread_cond_t done_cond;
+} fmt_pool_t;
+
+static int batch_append(fmt_batch_t *batch, const char *str, size_t len)
+{
+  size_t alloc;
+  char *out;
+
+  if (batch->out_len + len > batch->out_alloc) {
+    alloc = batch->out_alloc == 0 ? ELEM_OUTPUT_FLUSH_LEN : batch->out_alloc;
+    while (alloc < batch->out_len + len) {
+      alloc *= 2;
+    }
+    if ((out = realloc(batch->out, alloc)) == NULL) {
+      return -1;
+    }
+    batch->out = out;
+    batch->out_alloc = alloc;
+  }
+  memcpy(batch->out + batch->out_len, str, len);
+  batch->out_len += len;
+  return 0;
+}
+
+// move the elems rendered so far into the batch
+static int batch_append_elems(fmt_batch_t *batch,
+                              bgpstream_elem_formatter_t *fmt)
+{
+  const char *out;
+  size_t len;
+
+  if (fmt == NULL) {
+    return 0;
+  }
+  len = bgpstream_elem_formatter_get_output(fmt, &out);
+  if (len != 0 && batch_append(batch, out, len) != 0) {
+    return -1;
+  }
+  bgpstream_elem_formatter_clear(fmt);
+  return 0;
+}
+
+static int batch_append_record(fmt_batch_t *batch,
+                               bgpstream_elem_formatter_t *fmt,
+                               bgpstream_record_t *record, char *line,
+                               size_t line_len)
+{
+  size_t len;
+
+  if (bgpstream_record_snprintf(line, line_len - 1, record) == NULL) {
+    fprintf(stderr, "ERROR: Could not convert record to string\n");
+    return -1;
+  }
+  len = strlen(line);
+  line[len++] = '\n';
+  return batch_append_elems(batch, fmt) != 0 ||
+         batch_append(batch, line, len) != 0 ? -1 : 0;
+}
+
+// same output as the single-threaded loop in main for -e, -m and -r
+static int batch_render(fmt_pool_t *pool, fmt_batch_t *batch,
+                        bgpstream_elem_formatter_t *fmt, char *line,
+                        size_t line_len)
+{
+  bgpstream_record_t *record;
+  bgpstream_elem_t *elem;
+  int i, rc;
+
+  for (i = 0; i < batch->records_cnt; i++) {
+    record = batch->records[i];
+    if (pool->records_on &&
+        batch_append_record(batch, fmt, record, line, line_len) != 0) {
+      return -1;
+    }
+    if (record->type == BGPSTREAM_RIB &&
+        record->dump_pos == BGPSTREAM_DUMP_START &&
+        batch_append_record(batch, fmt, record, line, line_len) != 0) {
+      return -1;
+    }
+    if (fmt != NULL) {
+      while ((rc = bgpstream_record_get_next_elem(record, &elem)) > 0) {
+        if (bgpstream_elem_formatter_add_elem(fmt, record, elem) != 0) {
+          fprintf(stderr, "ERROR: Could not convert record/elem to string\n");
+          return -1;
+        }
+      }
+      if (rc != 0) {
+        fprintf(stderr, "ERROR: Failed to get elem from record\n");
+        return -1;
+      }
+      if (record->type == BGPSTREAM_RIB &&
+          record->dump_pos == BGPSTREAM_DUMP_END &&
+          batch_append_record(batch, fmt, record, line, line_len) != 0) {
+        return -1;
+      }
+    }
+  }
+  return fmt == NULL ? 0 : batch_append_elems(batch, fmt);
+}
+
+static void *fmt_thread(void *user)
+{
+  fmt_pool_t *pool = user;
+  bgpstream_elem_formatter_t *fmt = NULL;
+  fmt_batch_t *batch;
+  char *line;
+  int err = 0;
+
+  if ((line = malloc(sizeof(buf))) == NULL ||
+      (pool->bgpdump &&
+       (fmt = bgpstream_elem_formatter_create_bgpdump()) == NULL) ||
+      (pool->elems_on &&
+       (fmt = bgpstream_elem_formatter_create(NULL)) == NULL)) {
+    fprintf(stderr, "ERROR: Could not create elem formatter\n");
+    err = 1;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  while (1) {
+    while (!pool->shutdown && pool->render_seq == pool->fill_seq) {
+      pthread_cond_wait(&pool->render_cond, &pool->mutex);
+    }
+    if (pool->shutdown) {
+      break;
+    }
+    batch = &pool->batches[pool->render_seq++ % pool->batches_cnt];
+    pthread_mutex_unlock(&pool->mutex);
+
+    batch->err = err || batch_render(pool, batch, fmt, line, sizeof(buf));
+    if (fmt != NULL) {
+      bgpstream_elem_formatter_clear(fmt);
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    batch->done = 1;
+    pthread_cond_broadcast(&pool->done_cond);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  bgpstream_elem_formatter_destroy(fmt);
+  free(line);
+  return NULL;
+}
+
+static int write_all(const char *out, size_t len)
+{
+  ssize_t rc;
+
+  while (len > 0) {
+    if ((rc = write(STDOUT_FILENO, out, len)) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fprintf(stderr, "ERROR: Could not write elems: %s\n", strerror(errno));
+      return -1;
+    }
+    out += rc;
+    len -= rc;
+  }
+  return 0;
+}
+
+// write out the oldest batch once it has been rendered. returns 1 if a batch
+// was written, and 0 if there is none (or, when not waiting, none is ready)
+static int fmt_pool_write_batch(fmt_pool_t *pool, int wait)
+{
+  fmt_batch_t *batch;
+  int done, i, rc = 1;
+
+  pthread_mutex_lock(&pool->mutex);
+  if (pool->write_seq == pool->fill_seq) {
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+  }
+  batch = &pool->batches[pool->write_seq % pool->batches_cnt];
+  while (wait && !batch->done) {
+    pthread_cond_wait(&pool->done_cond, &pool->mutex);
+  }
+  done = batch->done;
+  pthread_mutex_unlock(&pool->mutex);
+  if (!done) {
+    return 0;
+  }
+
+  if (batch->err || write_all(batch->out, batch->out_len) != 0) {
+    rc = -1;
+  }
+  for (i = 0; i < batch->records_cnt; i++) {
+    /* the record has been output, so a restarted stream may skip it */
+    if (rc == 1 && bgpstream_record_ack(batch->records[i]) != 0) {
+      fprintf(stderr, "ERROR: Could not acknowledge record\n");
+      rc = -1;
+    }
+    bgpstream_record_release(batch->records[i]);
+  }
+  batch->records_cnt = 0;
+  batch->out_len = 0;
+  batch->done = batch->err = 0;
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->write_seq++;
+  pthread_mutex_unlock(&pool->mutex);
+  return rc;
+}
+
+static void fmt_pool_submit(fmt_pool_t *pool)
+{
+  pthread_mutex_lock(&pool->mutex);
+  pool->fill_seq++;
+  pthread_cond_signal(&pool->render_cond);
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+static void fmt_pool_destroy(fmt_pool_t *pool)
+{
+  int i, j;
+
+  if (pool == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&pool->mutex);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->render_cond);
+  pthread_mutex_unlock(&pool->mutex);
+  for (i = 0; i < pool->threads_cnt; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  // drop whatever was not written out
+  for (i = 0; pool->batches != NULL && i < pool->batches_cnt; i++) {
+    for (j = 0; j < pool->batches[i].records_cnt; j++) {
+      bgpstream_record_release(pool->batches[i].records[j]);
+    }
+    free(pool->batches[i].out);
+  }
+  if (pool->threads_cnt > 0 || pool->batches != NULL) {
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->render_cond);
+    pthread_cond_destroy(&pool->done_cond);
+  }
+  free(pool->batches);
+  free(pool->threads);
+  free(pool);
+}
+
+static fmt_pool_t *fmt_pool_create(int threads_cnt, int records_on,
+                                   int elems_on, int bgpdump, int live)
+{
+  fmt_pool_t *pool;
+
+  if ((pool = malloc_zero(sizeof(fmt_pool_t))) == NULL ||
+      (pool->threads = malloc_zero(sizeof(pthread_t) * threads_cnt)) ==
+        NULL ||
+      (pool->batches = malloc_zero(sizeof(fmt_batch_t) * threads_cnt *
+                                   FMT_BATCHES_PER_THREAD)) == NULL) {
+    goto err;
+  }
+  pool->batches_cnt = threads_cnt * FMT_BATCHES_PER_THREAD;
+  // live elems are not held back waiting for a batch to fill up
+  pool->batch_records = live ? 1 : FMT_BATCH_RECORDS;
+  pool->records_on = records_on;
+  pool->elems_on = elems_on;
+  pool->bgpdump = bgpdump;
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->render_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+
+  for (; pool->threads_cnt < threads_cnt; pool->threads_cnt++) {
+    if (pthread_create(&pool->threads[pool->threads_cnt], NULL, fmt_thread,
+                       pool) != 0) {
+      goto err;
+    }
+  }
+  return pool;
+
+err:
+  fprintf(stderr, "ERROR: Could not create formatter threads\n");
+  fmt_pool_destroy(pool);
+  return NULL;
+}
+
+// hand a record over to the pool, and write out the batches that are ready
+static int fmt_pool_add_record(fmt_pool_t *pool, bgpstream_record_t *record,
+                               int live)
+{
+  fmt_batch_t *batch;
+  int rc;
+
+  // wait for the oldest batch to be written if every batch is in flight
+  if (pool->fill_seq - pool->write_seq == (uint64_t)pool->batches_cnt &&
+      fmt_pool_write_batch(pool, 1) < 0) {
+    return -1;
+  }
+  batch = &pool->batches[pool->fill_seq % pool->batches_cnt];
+  batch->records[batch->records_cnt++] = bgpstream_record_retain(record);
+  if (batch->records_cnt == pool->batch_records) {
+    fmt_pool_submit(pool);
+  }
+
+  while ((rc = fmt_pool_write_batch(pool, live)) > 0)
+    ;
+  return rc;
+}
+
+// write out every record handed to the pool so far
+static int fmt_pool_flush(fmt_pool_t *pool)
+{
+  int rc;
+
+  if (pool->batches[pool->fill_seq % pool->batches_cnt].records_cnt != 0) {
+    fmt_pool_submit(pool);
+  }
+  while ((rc = fmt_pool_write_batch(pool, 1)) > 0)
+    ;
+  return rc;
+}
+
+/* throughput statistics (--stats)
+ *
+ * The statistics of the stream are sampled every interval, and the rates
+ * since the previous sample are printed to stderr, along with a summary of
+ * the whole run at the end.
+ */
+
+static const char *stats_transport_names[] = {
+  "file", "kafka", "cache", "http", "websocket", "shmring",
+};
+
+static const char *stats_filter_names[] = {
+  "elem-type", "ipversion", "peer", "not-peer",
+  "origin",    "prefix",    "community", "aspath",   "sample",
+};
+
+static const char *stats_stage_names[] = {
+  "broker", "open",  "open-wait", "read", "decompress",
+  "decode", "elems", "merge",     "wait",
+};
+
+typedef struct stats_state {
+  // seconds between reports (0 if disabled)
+  int interval;
+
+  // when the stream started, and when the last sample was taken
+  uint64_t start_ms;
+  uint64_t last_ms;
+
+  // the first and the last sample
+  bgpstream_perf_stats_t first;
+  bgpstream_perf_stats_t last;
+} stats_state_t;
+
+// counts may restart when the filters are reloaded
+#define STATS_DIFF(cur, prev) ((cur) > (prev) ? (cur) - (prev) : 0)
+
+static void stats_print(const char *label, const bgpstream_perf_stats_t *cur,
+                        const bgpstream_perf_stats_t *prev, uint64_t ms)
+{
+  double sec = ms == 0 ? 0.001 : ms / 1000.0;
+  uint64_t elems = STATS_DIFF(cur->elems, prev->elems);
+  uint64_t runs, rejects, reads;
+  int i;
+
+  fprintf(stderr,
+          "STATS: %s %.1fs: %.0f records/s, %.0f elems/s (%.0f passed/s), "
+          "%" PRIu32 " open resources\n",
+          label, sec, STATS_DIFF(cur->records, prev->records) / sec,
+          elems / sec, STATS_DIFF(cur->elems_passed, prev->elems_passed) / sec,
+          cur->open_resources);
+
+  if (cur->elems_duplicate != 0 || cur->dedup_evictions != 0) {
+    fprintf(stderr,
+            "STATS:   dedup: %.0f duplicates/s, %.0f evictions/s\n",
+            STATS_DIFF(cur->elems_duplicate, prev->elems_duplicate) / sec,
+            STATS_DIFF(cur->dedup_evictions, prev->dedup_evictions) / sec);
+  }
+
+  fprintf(stderr, "STATS:   read:");
+  for (i = 0; i < _BGPSTREAM_PERF_TRANSPORT_CNT; i++) {
+    if (cur->transport_bytes[i] != 0) {
+      fprintf(
+        stderr, " %s %.2f MiB/s", stats_transport_names[i],
+        STATS_DIFF(cur->transport_bytes[i], prev->transport_bytes[i]) /
+          (1048576.0 * sec));
+      reads = STATS_DIFF(cur->transport_reads[i], prev->transport_reads[i]);
+      if (cur->transport_read_ns[i] != 0 && reads != 0) {
+        fprintf(stderr, " (%.1f us/read)",
+                STATS_DIFF(cur->transport_read_ns[i],
+                           prev->transport_read_ns[i]) /
+                  (1e3 * reads));
+      }
+    }
+  }
+  fprintf(stderr, "\n");
+
+  // the rejection rate of each filter is out of the elems that it checked
+  fprintf(stderr, "STATS:   rejected:");
+  for (i = 0; i < _BGPSTREAM_PERF_FILTER_CNT; i++) {
+    runs = STATS_DIFF(cur->filter_runs[i], prev->filter_runs[i]);
+    rejects = STATS_DIFF(cur->filter_rejects[i], prev->filter_rejects[i]);
+    if (cur->filter_runs[i] != 0) {
+      fprintf(stderr, " %s %.1f%%", stats_filter_names[i],
+              runs == 0 ? 0.0 : 100.0 * rejects / runs);
+    }
+  }
+  fprintf(stderr, "\n");
+
+  // time is summed over threads, so stages may add up to more than 100%
+  fprintf(stderr, "STATS:   time:");
+  for (i = 0; i < _BGPSTREAM_PERF_STAGE_CNT; i++) {
+    fprintf(stderr, " %s %.1f%%", stats_stage_names[i],
+            STATS_DIFF(cur->stage_ns[i], prev->stage_ns[i]) / (1e7 * sec));
+  }
+  fprintf(stderr, "\n");
+}
+
+static void stats_start(stats_state_t *st)
+{
+  st->start_ms = st->last_ms = epoch_msec();
+  bgpstream_get_perf_stats(bs, &st->first);
+  st->last = st->first;
+}
+
+// report the statistics if the interval has elapsed
+static void stats_check(stats_state_t *st)
+{
+  bgpstream_perf_stats_t cur;
+  uint64_t now = epoch_msec();
+
+  if (now - st->last_ms < (uint64_t)st->interval * 1000) {
+    return;
+  }
+  bgpstream_get_perf_stats(bs, &cur);
+  stats_print("interval", &cur, &st->last, now - st->last_ms);
+  st->last = cur;
+  st->last_ms = now;
+}
+
+// report the statistics of the whole run
+static void stats_finish(stats_state_t *st)
+{
+  bgpstream_perf_stats_t cur;
+
+  bgpstream_get_perf_stats(bs, &cur);
+  stats_print("total", &cur, &st->first, epoch_msec() - st->start_ms);
+}
+
+/* checkpoints (--checkpoint)
+ *
+ * The time of the last record that has been output is saved periodically,
+ * along with the RIB period state of the stream, so that a restarted reader
+ * only reads the data that came after it. Records of the checkpoint second
+ * are output again.
+ */
+
+#define CHECKPOINT_DEFAULT_INTERVAL 60
+
+typedef struct checkpoint_state {
+  // file to load and save (NULL if disabled)
+  const char *path;
+
+  // seconds between saves
+  int interval;
+
+  // when the last checkpoint was saved
+  uint64_t last_ms;
+
+  // time of the last record handed to the output
+  uint32_t time;
+} checkpoint_state_t;
+
+static int checkpoint_parse(checkpoint_state_t *ck, char *arg)
+{
+  char *sec;
+
+  ck->path = arg;
+  ck->interval = CHECKPOINT_DEFAULT_INTERVAL;
+  if ((sec = strrchr(arg, ',')) != NULL) {
+    *(sec++) = '\0';
+    if ((ck->interval = atoi(sec)) <= 0) {
+      fprintf(stderr, "ERROR: Invalid checkpoint interval '%s'\n", sec);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// write out the records handed to the output so far, and save their time
+static int checkpoint_save(checkpoint_state_t *ck, fmt_pool_t *pool)
+{
+  if (ck->time == 0) {
+    return 0;
+  }
+  if ((pool != NULL && fmt_pool_flush(pool) < 0) ||
+      flush_elems() != 0 || fflush(stdout) != 0) {
+    return -1;
+  }
+  if (kafka_writer != NULL &&
+      bgpstream_kafka_writer_flush(kafka_writer, KAFKA_FLUSH_MSEC) != 0) {
+    fprintf(stderr, "ERROR: Could not deliver Kafka messages\n");
+    return -1;
+  }
+  if (bgpstream_save_checkpoint(bs, ck->path, ck->time) != 0) {
+    fprintf(stderr, "ERROR: Could not save checkpoint to %s\n", ck->path);
+    return -1;
+  }
+  ck->last_ms = epoch_msec();
+  return 0;
+}
+
+// save a checkpoint if the interval has elapsed
+static int checkpoint_check(checkpoint_state_t *ck, fmt_pool_t *pool)
+{
+  if (epoch_msec() - ck->last_ms < (uint64_t)ck->interval * 1000) {
+    return 0;
+  }
+  return checkpoint_save(ck, pool);
+}
+
+/* metrics (--metrics)
+ *
+ * The statistics of the stream are written to a file periodically, to be
+ * exported by the textfile collector of the Prometheus node exporter.
+ */
+
+#define METRICS_DEFAULT_INTERVAL 15
+
+typedef struct metrics_state {
+  // file to write (NULL if disabled)
+  const char *path;
+
+  // seconds between writes
+  int interval;
+
+  // when the file was last written
+  uint64_t last_ms;
+} metrics_state_t;
+
+static int metrics_parse(metrics_state_t *ms, char *arg)
+{
+  char *sec;
+
+  ms->path = arg;
+  ms->interval = METRICS_DEFAULT_INTERVAL;
+  if ((sec = strrchr(arg, ',')) != NULL) {
+    *(sec++) = '\0';
+    if ((ms->interval = atoi(sec)) <= 0) {
+      fprintf(stderr, "ERROR: Invalid metrics interval '%s'\n", sec);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static struct {
+  const char *name;
+  bgpstream_filter_type_t type;
+} filter_file_types[] = {
+  {"peer-asn", BGPSTREAM_FILTER_TYPE_ELEM_PEER_ASN},
+  {"not-peer-asn", BGPSTREAM_FILTER_TYPE_ELEM_NOT_PEER_ASN},
+  {"origin-asn", BGPSTREAM_FILTER_TYPE_ELEM_ORIGIN_ASN},
+  {"prefix", BGPSTREAM_FILTER_TYPE_ELEM_PREFIX},
+  {"prefix-exact", BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_EXACT},
+  {"prefix-more", BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_MORE},
+  {"prefix-less", BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_LESS},
+  {"prefix-any", BGPSTREAM_FILTER_TYPE_ELEM_PREFIX_ANY},
+  {"community", BGPSTREAM_FILTER_TYPE_ELEM_COMMUNITY},
+};
+
+// add the filters of a "<type>:<file>" argument
+static int filter_file_add(char *arg)
+{
+  char *path;
+  unsigned i;
+
+  if ((path = strchr(arg, ':')) == NULL) {
+    fprintf(stderr, "ERROR: Invalid filter file '%s'\n", arg);
+    return -1;
+  }
+  *(path++) = '\0';
+  for (i = 0; i < ARR_CNT(filter_file_types); i++) {
+    if (strcmp(arg, filter_file_types[i].name) == 0) {
+      break;
+    }
+  }
+  if (i == ARR_CNT(filter_file_types)) {
+    fprintf(stderr, "ERROR: Invalid filter file type '%s'\n", arg);
+    return -1;
+  }
+  if (!bgpstream_add_filter_file(bs, filter_file_types[i].type, path)) {
+    fprintf(stderr, "ERROR: Could not load filter file %s\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+// create the Kafka writer of a "<brokers>/<topic>[/<enc>[/<key>]]" argument,
+// with the "<name>=<value>" options given
+static int kafka_out_create(char *arg, char **options, int options_cnt)
+{
+  bgpstream_kafka_writer_encoding_t encoding = BGPSTREAM_KAFKA_WRITER_BINARY;
+  bgpstream_kafka_writer_partition_t partition =
+    BGPSTREAM_KAFKA_WRITER_BY_COLLECTOR;
+  char *brokers, *topic, *enc, *key, *value;
+  int i;
+
+  brokers = strsep(&arg, "/");
+  topic = strsep(&arg, "/");
+  enc = strsep(&arg, "/");
+  key = strsep(&arg, "/");
+  if (topic == NULL || *brokers == '\0' || *topic == '\0' || arg != NULL) {
+    fprintf(stderr, "ERROR: Invalid Kafka output '%s'\n", brokers);
+    return -1;
+  }
+  if (enc != NULL && strcmp(enc, "json") == 0) {
+    encoding = BGPSTREAM_KAFKA_WRITER_JSON;
+  } else if (enc != NULL && strcmp(enc, "binary") != 0) {
+    fprintf(stderr, "ERROR: Invalid Kafka output encoding '%s'\n", enc);
+    return -1;
+  }
+  if (key != NULL && strcmp(key, "prefix") == 0) {
+    partition = BGPSTREAM_KAFKA_WRITER_BY_PREFIX;
+  } else if (key != NULL && strcmp(key, "peer") == 0) {
+    partition = BGPSTREAM_KAFKA_WRITER_BY_PEER;
+  } else if (key != NULL && strcmp(key, "collector") != 0) {
+    fprintf(stderr, "ERROR: Invalid Kafka output key '%s'\n", key);
+    return -1;
+  }
+
+  if ((kafka_writer = bgpstream_kafka_writer_create(brokers, topic, encoding,
+                                                    partition)) == NULL) {
+    fprintf(stderr, "ERROR: Could not create Kafka writer for %s\n", topic);
+    return -1;
+  }
+  for (i = 0; i < options_cnt; i++) {
+    if ((value = strchr(options[i], '=')) == NULL) {
+      fprintf(stderr, "ERROR: Invalid Kafka option '%s'\n", options[i]);
+      return -1;
+    }
+    *(value++) = '\0';
+    if (bgpstream_kafka_writer_set_option(kafka_writer, options[i], value) !=
+        0) {
+      fprintf(stderr, "ERROR: Could not set Kafka option %s\n", options[i]);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// create the shared-memory ring writer of a "<name>[/<MiB>]" argument
+static int shm_out_create(char *arg)
+{
+  char *name, *size_str, *end;
+  unsigned long size_mb = 0;
+
+  name = strsep(&arg, "/");
+  size_str = arg;
+  if (*name == '\0') {
+    fprintf(stderr, "ERROR: Invalid shared memory output '%s'\n", name);
+    return -1;
+  }
+  if (size_str != NULL) {
+    size_mb = strtoul(size_str, &end, 10);
+    if (*size_str == '\0' || *end != '\0' || size_mb == 0 ||
+        size_mb > SIZE_MAX / (1024 * 1024)) {
+      fprintf(stderr, "ERROR: Invalid shared memory ring size '%s'\n",
+              size_str);
+      return -1;
+    }
+  }
+
+  if ((shm_writer = bgpstream_shmring_writer_create(
+         name, (size_t)size_mb * 1024 * 1024)) == NULL) {
+    fprintf(stderr, "ERROR: Could not create shared memory ring %s\n", name);
+    return -1;
+  }
+  return 0;
+}
+
+// add the sample filter of a "<key>/<slice>/<count>" argument
+static int sample_add(char *arg)
+{
+  bgpstream_sample_key_t key;
+  uint32_t slice, slice_cnt;
+  char *nums;
+
+  if ((nums = strchr(arg, '/')) == NULL ||
+      sscanf(nums + 1, "%" SCNu32 "/%" SCNu32, &slice, &slice_cnt) != 2) {
+    fprintf(stderr, "ERROR: Invalid sample '%s'\n", arg);
+    return -1;
+  }
+  *nums = '\0';
+  if (strcmp(arg, "prefix") == 0) {
+    key = BGPSTREAM_SAMPLE_KEY_PREFIX;
+  } else if (strcmp(arg, "peer-asn") == 0) {
+    key = BGPSTREAM_SAMPLE_KEY_PEER_ASN;
+  } else {
+    fprintf(stderr, "ERROR: Invalid sample key '%s'\n", arg);
+    return -1;
+  }
+  if (!bgpstream_add_sample_filter(bs, key, slice, slice_cnt)) {
+    fprintf(stderr, "ERROR: Could not add sample filter\n");
+    return -1;
+  }
+  return 0;
+}
+
+// set the thread placement of a "<policy>[:<cpus>]" argument
+static int thread_affinity_set(char *arg)
+{
+  bgpstream_thread_affinity_t policy;
+  char *cpus;
+
+  if ((cpus = strchr(arg, ':')) != NULL) {
+    *(cpus++) = '\0';
+  }
+  if (strcmp(arg, "none") == 0) {
+    policy = BGPSTREAM_THREAD_AFFINITY_NONE;
+  } else if (strcmp(arg, "node") == 0) {
+    policy = BGPSTREAM_THREAD_AFFINITY_NODE;
+  } else if (strcmp(arg, "cpu") == 0) {
+    policy = BGPSTREAM_THREAD_AFFINITY_CPU;
+  } else {
+    fprintf(stderr, "ERROR: Invalid thread affinity policy '%s'\n", arg);
+    return -1;
+  }
+  if (bgpstream_set_thread_affinity(bs, policy, cpus) != 0) {
+    fprintf(stderr, "ERROR: Could not set thread affinity\n");
+    return -1;
+  }
+  return 0;
+}
+
+// write the metrics file. failing to is not fatal, the stream carries on
+static void metrics_write(metrics_state_t *ms)
+{
+  if (bgpstream_write_metrics(bs, ms->path) != 0) {
+    fprintf(stderr, "WARN: Could not write metrics to %s\n", ms->path);
+  }
+  ms->last_ms = epoch_msec();
+}
+
+// write the metrics file if the interval has elapsed
+static void metrics_check(metrics_state_t *ms)
+{
+  if (epoch_msec() - ms->last_ms >= (uint64_t)ms->interval * 1000) {
+    metrics_write(ms);
+  }
+}
+
+/* RIB deltas (--rib-delta)
+ *
+ * Every record is applied to a RIB. The RIB elems that leave the route of
+ * their peer unchanged are not output, and the routes that the end of a dump
+ * removes are output as withdrawals of the record that ended the dump. The
+ * first dump of each collector is output whole.
+ */
+
+typedef struct rib_delta {
+  // RIB rebuilt from the stream (NULL if disabled)
+  bgpstream_rib_t *rib;
+
+  // record being output, and elem used for the withdrawals
+  bgpstream_record_t *record;
+  bgpstream_elem_t *elem;
+
+  bgpstream_arrow_writer_t *arrow_writer;
+} rib_delta_t;
+
+static int rib_delta_output(rib_delta_t *delta, bgpstream_elem_t *elem)
+{
+  if (elem_fmt != NULL && print_elem(delta->record, elem) != 0) {
+    return -1;
+  }
+  if (delta->arrow_writer != NULL &&
+      bgpstream_arrow_writer_add_elem(delta->arrow_writer, delta->record,
+                                      elem) != 0) {
+    fprintf(stderr, "ERROR: Failed to write Arrow elem\n");
+    return -1;
+  }
+  if (kafka_writer != NULL &&
+      bgpstream_kafka_writer_add_elem(kafka_writer, elem) != 0) {
+    fprintf(stderr, "ERROR: Failed to produce Kafka elem\n");
+    return -1;
+  }
+  if (shm_writer != NULL &&
+      bgpstream_shmring_writer_add_elem(shm_writer, elem) != 0) {
+    fprintf(stderr, "ERROR: Failed to write shared memory elem\n");
+    return -1;
+  }
+  return 0;
+}
+
+// output a route that a RIB dump removed (see bgpstream_rib_set_purge_cb)
+static int rib_delta_purged(const bgpstream_pfx_t *pfx,
+                            const bgpstream_rib_route_t *route, void *user)
+{
+  rib_delta_t *delta = user;
+  bgpstream_peer_sig_t *sig;
 
-    // explanatory text
-    wrap(bs_opts[k].expl, expl_col, expl_col);
-    fprintf(stderr, "\n");
-    if (bs_opts[k].option.val == 'd') {
-      data_if_usage();
-    }
+  // the peer state elems of updates already tell that the routes are gone
+  if (delta->record->type != BGPSTREAM_RIB) {
+    return 0;
   }
-  fprintf(stderr, "* denotes an option that can be given multiple times\n");
+  if ((sig = bgpstream_peer_sig_map_get_sig(
+         bgpstream_rib_get_peer_sig_map(delta->rib), route->peer_id)) ==
+      NULL) {
+    return -1;
+  }
+  bgpstream_elem_clear(delta->elem);
+  delta->elem->type = BGPSTREAM_ELEM_TYPE_WITHDRAWAL;
+  delta->elem->orig_time_sec = delta->record->time_sec;
+  delta->elem->orig_time_usec = 0;
+  bgpstream_addr_copy(&delta->elem->peer_ip, &sig->peer_ip_addr);
+  delta->elem->peer_asn = sig->peer_asnumber;
+  bgpstream_pfx_copy(&delta->elem->prefix, pfx);
+  return rib_delta_output(delta, delta->elem);
 }
 
-// print / utility functions
+static int rib_delta_create(rib_delta_t *delta,
+                            bgpstream_arrow_writer_t *arrow_writer)
+{
+  if ((delta->rib = bgpstream_rib_create()) == NULL ||
+      (delta->elem = bgpstream_elem_create()) == NULL) {
+    fprintf(stderr, "ERROR: Could not create RIB\n");
+    return -1;
+  }
+  delta->arrow_writer = arrow_writer;
+  bgpstream_rib_set_purge_cb(delta->rib, rib_delta_purged, delta);
+  return 0;
+}
 
-static int print_record(bgpstream_record_t *record);
-static int print_elem(bgpstream_record_t *record, bgpstream_elem_t *elem);
-static int print_elem_bgpdump(bgpstream_record_t *record,
-                              bgpstream_elem_t *elem);
+static void rib_delta_destroy(rib_delta_t *delta)
+{
+  bgpstream_rib_destroy(delta->rib);
+  bgpstream_elem_destroy(delta->elem);
+}
 
 int main(int argc, char *argv[])
 {
@@ -354,14 +1414,52 @@ int main(int argc, char *argv[])
   uint32_t interval_start = 0;
   uint32_t interval_end = BGPSTREAM_FOREVER;
   int rib_period = 0;
+  uint32_t shard = 0;
+  uint32_t shard_cnt = 0;
+  uint32_t shard_span = 0;
   int live = 0;
   int output_info = 0;
   int record_output_on = 0;
   int record_bgpdump_output_on = 0;
   int elem_output_on = 0;
+  int binary_output_on = 0;
   int exitstatus = -1; // fail, until proven otherwise
 
   int rec_limit = -1;
+  int readahead = 0;
+  int worker_threads = 0;
+  int heap_merge = 0;
+  int unordered = 0;
+  int async_log = 0;
+  int max_skew = -1;
+  int max_open = 0;
+  uint64_t mem_limit = 0;
+  int prefetch = 0;
+  int decode_threads = 0;
+  int summaries = 0;
+  const char *mrt_out_path = NULL;
+  bgpstream_mrt_writer_t *mrt_writer = NULL;
+  const char *arrow_out_path = NULL;
+  const char *arrow_columns = NULL;
+  bgpstream_arrow_writer_t *arrow_writer = NULL;
+  bgpstream_binary_writer_t *bin_writer = NULL;
+  char *kafka_out = NULL;
+  char *kafka_options[KAFKA_OPTIONS_MAX];
+  int kafka_options_cnt = 0;
+  char *shm_out = NULL;
+  int fmt_threads = 0;
+  fmt_pool_t *fmt_pool = NULL;
+  stats_state_t stats = {0};
+  checkpoint_state_t checkpoint = {0};
+  metrics_state_t metrics = {0};
+  uint32_t checkpoint_time;
+  int rib_delta_on = 0;
+  rib_delta_t rib_delta = {0};
+  int dedup_on = 0;
+  uint32_t dedup_window = 0;
+  uint32_t dedup_routes = DEDUP_DEFAULT_ROUTES;
+  const uint8_t *bin_buf;
+  ssize_t bin_len;
 
   bgpstream_data_interface_option_t *option;
 
@@ -476,6 +1574,29 @@ int main(int argc, char *argv[])
     case 'P':
       rib_period = atoi(optarg);
       break;
+    case READER_OPTION_RIB_DELTA:
+      rib_delta_on = 1;
+      break;
+
+    case READER_OPTION_DEDUP:
+      dedup_on = 1;
+      dedup_window = strtoul(optarg, &endp, 10);
+      if (*endp == ',') {
+        dedup_routes = strtoul(endp + 1, &endp, 10);
+      }
+      if (endp == optarg || *endp != '\0' || dedup_routes == 0) {
+        fprintf(stderr, "ERROR: Invalid dedup option '%s'\n", optarg);
+        error_cnt++;
+      }
+      break;
+    case READER_OPTION_SHARD:
+      if (sscanf(optarg, "%" SCNu32 "/%" SCNu32 "/%" SCNu32, &shard,
+                 &shard_cnt, &shard_span) < 2 ||
+          shard_cnt == 0) {
+        fprintf(stderr, "ERROR: bad shard '%s'\n", optarg);
+        goto done;
+      }
+      break;
     case 'd':
       if ((di_id = bgpstream_get_data_interface_id_by_name(bs, optarg)) == 0) {
         fprintf(stderr, "ERROR: Invalid data interface name '%s'\n", optarg);
@@ -489,6 +1610,94 @@ int main(int argc, char *argv[])
       fprintf(stderr, "INFO: Processing at most %d records\n", rec_limit);
       break;
 
+    case READER_OPTION_READAHEAD:
+      readahead = atoi(optarg);
+      break;
+    case READER_OPTION_WORKER_THREADS:
+      worker_threads = atoi(optarg);
+      break;
+    case READER_OPTION_HEAP_MERGE:
+      heap_merge = 1;
+      break;
+    case READER_OPTION_UNORDERED:
+      unordered = 1;
+      break;
+    case READER_OPTION_MAX_SKEW:
+      max_skew = atoi(optarg);
+      break;
+    case READER_OPTION_MAX_OPEN:
+      max_open = atoi(optarg);
+      break;
+    case READER_OPTION_MEM_LIMIT:
+      mem_limit = strtoull(optarg, NULL, 10) << 20;
+      break;
+
+    case READER_OPTION_PREFETCH:
+      prefetch = atoi(optarg);
+      break;
+
+    case READER_OPTION_DECODE_THREADS:
+      decode_threads = atoi(optarg);
+      break;
+
+    case READER_OPTION_SUMMARIES:
+      summaries = 1;
+      break;
+
+    case READER_OPTION_MRT_OUT:
+      mrt_out_path = optarg;
+      break;
+
+    case READER_OPTION_ARROW_OUT:
+      arrow_out_path = optarg;
+      break;
+
+    case READER_OPTION_ARROW_COLUMNS:
+      arrow_columns = optarg;
+      break;
+
+    case READER_OPTION_THREADS:
+      fmt_threads = atoi(optarg);
+      break;
+
+    case READER_OPTION_STATS:
+      stats.interval = atoi(optarg);
+      break;
+
+    case READER_OPTION_CHECKPOINT:
+      if (checkpoint_parse(&checkpoint, optarg) != 0) {
+        error_cnt++;
+      }
+      break;
+
+    case READER_OPTION_METRICS:
+      if (metrics_parse(&metrics, optarg) != 0) {
+        error_cnt++;
+      }
+      break;
+
+    case READER_OPTION_FILTER_FILE:
+      if (filter_file_add(optarg) != 0) {
+        error_cnt++;
+      }
+      break;
+
+    case READER_OPTION_THREAD_AFFINITY:
+      if (thread_affinity_set(optarg) != 0) {
+        error_cnt++;
+      }
+      break;
+
+    case READER_OPTION_SAMPLE:
+      if (sample_add(optarg) != 0) {
+        error_cnt++;
+      }
+      break;
+
+    case READER_OPTION_ASYNC_LOG:
+      async_log = 1;
+      break;
+
     case 'l':
       live = 1;
       break;
@@ -501,6 +1710,24 @@ int main(int argc, char *argv[])
     case 'e':
       elem_output_on = 1;
       break;
+    case READER_OPTION_OUTPUT_BINARY:
+      binary_output_on = 1;
+      break;
+    case READER_OPTION_KAFKA_OUT:
+      kafka_out = optarg;
+      break;
+    case READER_OPTION_KAFKA_OUT_OPTION:
+      if (kafka_options_cnt == KAFKA_OPTIONS_MAX) {
+        fprintf(stderr, "ERROR: At most %d Kafka options can be set\n",
+                KAFKA_OPTIONS_MAX);
+        error_cnt++;
+        break;
+      }
+      kafka_options[kafka_options_cnt++] = optarg;
+      break;
+    case READER_OPTION_SHM_OUT:
+      shm_out = optarg;
+      break;
     case 'i':
       output_info = 1;
       break;
@@ -581,11 +1808,63 @@ int main(int argc, char *argv[])
     error_cnt++;
   }
 
+  // binary output cannot share stdout with the text formats
+  if (binary_output_on &&
+      (elem_output_on || record_output_on || record_bgpdump_output_on)) {
+    fprintf(stderr, "ERROR: Cannot output in both binary (--output-binary) "
+                    "and a text format (-e, -m or -r).\n");
+    error_cnt++;
+  }
+
   // if the user did not specify any output format, default to per elem
-  if (!record_output_on && !elem_output_on && !record_bgpdump_output_on) {
+  if (!record_output_on && !elem_output_on && !record_bgpdump_output_on &&
+      !binary_output_on && mrt_out_path == NULL && arrow_out_path == NULL &&
+      kafka_out == NULL && shm_out == NULL) {
     elem_output_on = 1;
   }
 
+  // the formatter threads read the elems, so nothing else may
+  if (fmt_threads < 0) {
+    fprintf(stderr, "ERROR: Invalid number of formatter threads %d\n",
+            fmt_threads);
+    error_cnt++;
+  } else if (fmt_threads > 0 &&
+             (binary_output_on || mrt_out_path != NULL ||
+              arrow_out_path != NULL || kafka_out != NULL ||
+              shm_out != NULL)) {
+    fprintf(stderr, "ERROR: Formatter threads (--threads) can only be used "
+                    "with the text formats (-e, -m and -r).\n");
+    error_cnt++;
+  }
+#ifdef WITH_RPKI
+  if (fmt_threads > 0 && rpki_input != NULL && rpki_input->rpki_active) {
+    fprintf(stderr, "ERROR: Formatter threads (--threads) cannot be used with "
+                    "RPKI validation.\n");
+    error_cnt++;
+  }
+#endif
+
+  if (stats.interval < 0) {
+    fprintf(stderr, "ERROR: Invalid statistics interval %d\n", stats.interval);
+    error_cnt++;
+  }
+
+  // the RIB needs the records in time order, and decides which elems to output
+  if (rib_delta_on &&
+      (unordered != 0 || fmt_threads > 0 || binary_output_on ||
+       mrt_out_path != NULL)) {
+    fprintf(stderr, "ERROR: RIB deltas (--rib-delta) can only be output as "
+                    "elems (-e, -m, --arrow-out, --kafka-out or --shm-out), "
+                    "without --threads or --unordered.\n");
+    error_cnt++;
+  }
+
+  if (checkpoint.path != NULL && unordered != 0) {
+    fprintf(stderr, "ERROR: Checkpoints (--checkpoint) need records in time "
+                    "order, and cannot be used with --unordered.\n");
+    error_cnt++;
+  }
+
   // Parse the filter string
   if (filterstring) {
     if (!bgpstream_parse_filter_string(bs, filterstring)) {
@@ -593,6 +1872,30 @@ int main(int argc, char *argv[])
     }
   }
 
+  /* frequencies */
+  if (rib_period > 0) {
+    if (!bgpstream_add_rib_period_filter(bs, rib_period))
+      error_cnt++;
+  }
+
+  /* carry on from a checkpoint (needs the RIB period filter) */
+  if (checkpoint.path != NULL && access(checkpoint.path, F_OK) == 0) {
+    if (intervalstring) {
+      fprintf(stderr, "ERROR: A checkpoint cannot be resumed with -I, use -w "
+                      "instead\n");
+      error_cnt++;
+    } else if (bgpstream_load_checkpoint(bs, checkpoint.path,
+                                         &checkpoint_time) != 0) {
+      fprintf(stderr, "ERROR: Could not load checkpoint %s\n",
+              checkpoint.path);
+      error_cnt++;
+    } else if (checkpoint_time > interval_start) {
+      fprintf(stderr, "INFO: Resuming from checkpoint at %" PRIu32 "\n",
+              checkpoint_time);
+      interval_start = checkpoint_time;
+    }
+  }
+
   if (intervalstring) {
     if (!bgpstream_add_recent_interval_filter(bs, intervalstring, live))
       error_cnt++;
@@ -604,9 +1907,9 @@ int main(int argc, char *argv[])
       error_cnt++;
   }
 
-  /* frequencies */
-  if (rib_period > 0) {
-    if (!bgpstream_add_rib_period_filter(bs, rib_period))
+  /* shards */
+  if (shard_cnt > 0) {
+    if (!bgpstream_add_shard_filter(bs, shard, shard_cnt, shard_span))
       error_cnt++;
   }
 
@@ -643,6 +1946,135 @@ int main(int argc, char *argv[])
     bgpstream_set_live_mode(bs);
   }
 
+  /* read-ahead */
+  if (readahead != 0 && bgpstream_set_reader_readahead(bs, readahead) != 0) {
+    fprintf(stderr, "ERROR: Invalid read-ahead depth %d\n", readahead);
+    goto done;
+  }
+
+  /* heap merge */
+  if (heap_merge != 0) {
+    bgpstream_set_heap_merge(bs);
+  }
+
+  /* open budget */
+  if (max_open != 0 && bgpstream_set_max_open_resources(bs, max_open) != 0) {
+    fprintf(stderr, "ERROR: Invalid open resource limit %d\n", max_open);
+    goto done;
+  }
+
+  /* memory limit */
+  if (mem_limit != 0) {
+    bgpstream_set_mem_limit(bs, mem_limit);
+  }
+
+  /* deduplication */
+  if (dedup_on != 0 &&
+      bgpstream_set_dedup(bs, dedup_window, dedup_routes) != 0) {
+    fprintf(stderr, "ERROR: Could not set up deduplication\n");
+    goto done;
+  }
+
+  /* prefetch */
+  if (prefetch > 0) {
+    bgpstream_set_prefetch(bs, prefetch);
+  }
+
+  /* decode threads */
+  if (decode_threads != 0 &&
+      bgpstream_set_decode_threads(bs, decode_threads) != 0) {
+    fprintf(stderr, "ERROR: Invalid number of decode threads %d\n",
+            decode_threads);
+    goto done;
+  }
+
+  /* resource summaries */
+  if (summaries != 0) {
+    bgpstream_set_resource_summaries(bs);
+  }
+
+  /* unordered */
+  if (unordered != 0) {
+    bgpstream_set_unordered(bs);
+  }
+
+  /* reorder buffer */
+  if (max_skew >= 0 && bgpstream_set_max_skew(bs, max_skew) != 0) {
+    goto done;
+  }
+
+  /* MRT output */
+  if (mrt_out_path != NULL) {
+    bgpstream_set_raw_records(bs);
+    if ((mrt_writer = bgpstream_mrt_writer_create(mrt_out_path)) == NULL) {
+      fprintf(stderr, "ERROR: Could not create MRT output file %s\n",
+              mrt_out_path);
+      goto done;
+    }
+  }
+
+  /* Arrow output */
+  if (arrow_out_path != NULL &&
+      (arrow_writer = bgpstream_arrow_writer_create(arrow_out_path)) ==
+        NULL) {
+    fprintf(stderr, "ERROR: Could not create Arrow output file %s\n",
+            arrow_out_path);
+    goto done;
+  }
+  if (arrow_columns != NULL &&
+      (arrow_writer == NULL ||
+       bgpstream_arrow_writer_set_columns(arrow_writer, arrow_columns) != 0)) {
+    fprintf(stderr, "ERROR: Invalid Arrow columns '%s' (or no --arrow-out)\n",
+            arrow_columns);
+    goto done;
+  }
+
+  /* elem output */
+  if (fmt_threads == 0 &&
+      ((elem_output_on &&
+        (elem_fmt = bgpstream_elem_formatter_create(NULL)) == NULL) ||
+       (record_bgpdump_output_on &&
+        (elem_fmt = bgpstream_elem_formatter_create_bgpdump()) == NULL))) {
+    fprintf(stderr, "ERROR: Could not create elem formatter\n");
+    goto done;
+  }
+
+  /* RIB deltas */
+  if (rib_delta_on && rib_delta_create(&rib_delta, arrow_writer) != 0) {
+    goto done;
+  }
+
+  /* binary output */
+  if (binary_output_on &&
+      (bin_writer = bgpstream_binary_writer_create()) == NULL) {
+    fprintf(stderr, "ERROR: Could not create binary writer\n");
+    goto done;
+  }
+
+  /* Kafka output */
+  if (kafka_out != NULL &&
+      kafka_out_create(kafka_out, kafka_options, kafka_options_cnt) != 0) {
+    goto done;
+  }
+
+  /* shared-memory output */
+  if (shm_out != NULL && shm_out_create(shm_out) != 0) {
+    goto done;
+  }
+
+  /* worker threads */
+  if (worker_threads != 0 &&
+      bgpstream_set_worker_threads(bs, worker_threads) != 0) {
+    fprintf(stderr, "ERROR: Invalid number of worker threads %d\n",
+            worker_threads);
+    goto done;
+  }
+
+  /* throughput statistics */
+  if (stats.interval > 0) {
+    bgpstream_set_perf_timing(bs);
+  }
+
   /* turn on interface */
   if (bgpstream_start(bs) < 0) {
     return -1;
@@ -657,8 +2089,18 @@ int main(int argc, char *argv[])
     }
   }
 
+  /* formatter threads, which write to stdout directly */
+  if (fmt_threads > 0) {
+    fflush(stdout);
+    if ((fmt_pool = fmt_pool_create(fmt_threads, record_output_on,
+                                    elem_output_on, record_bgpdump_output_on,
+                                    live)) == NULL) {
+      goto done;
+    }
+  }
+
   /* use the interface */
-  int rrc = 0, erc = 0, rec_cnt = 0;
+  int rrc = 0, erc = 0, drc, rec_cnt = 0, rec_elem_cnt;
   bgpstream_elem_t *bs_elem;
 
 #ifdef WITH_RPKI
@@ -672,24 +2114,90 @@ int main(int argc, char *argv[])
   }
 #endif
 
+  if (async_log && bgpstream_start_async_log() != 0) {
+    fprintf(stderr, "WARN: Could not start async logging\n");
+  }
+  if (stats.interval > 0) {
+    stats_start(&stats);
+  }
+  checkpoint.last_ms = epoch_msec();
+  if (metrics.path != NULL) {
+    metrics_write(&metrics);
+  }
+
   while ((rec_limit < 0 || rec_cnt < rec_limit) &&
          (rrc = bgpstream_get_next_record(bs, &bs_record)) > 0) {
     rec_cnt++;
 
+    if (stats.interval > 0) {
+      stats_check(&stats);
+    }
+    if (metrics.path != NULL) {
+      metrics_check(&metrics);
+    }
+
+    // the previous records have all been handed to the output
+    if (checkpoint.path != NULL) {
+      if (bs_record->time_sec != checkpoint.time &&
+          checkpoint_check(&checkpoint, fmt_pool) != 0) {
+        goto done;
+      }
+      checkpoint.time = bs_record->time_sec;
+    }
+
+    if (fmt_pool != NULL) {
+      if (fmt_pool_add_record(fmt_pool, bs_record, live) < 0) {
+        goto done;
+      }
+      continue;
+    }
+
     if (record_output_on && print_record(bs_record) != 0) {
       goto done;
     }
 
     /* check if the record is of type RIB, in case extract the ID */
     /* print the RIB start line */
-    if (bs_record->type == BGPSTREAM_RIB &&
+    if (bin_writer == NULL && bs_record->type == BGPSTREAM_RIB &&
         bs_record->dump_pos == BGPSTREAM_DUMP_START &&
         print_record(bs_record) != 0) {
       goto done;
     }
 
-    if (record_bgpdump_output_on || elem_output_on) {
+    if (record_bgpdump_output_on || elem_output_on || mrt_writer != NULL ||
+        arrow_writer != NULL || bin_writer != NULL || kafka_writer != NULL ||
+        shm_writer != NULL) {
+      if ((bin_writer != NULL &&
+           bgpstream_binary_writer_begin_record(bin_writer, bs_record) != 0) ||
+          (kafka_writer != NULL &&
+           bgpstream_kafka_writer_begin_record(kafka_writer, bs_record) !=
+             0) ||
+          (shm_writer != NULL &&
+           bgpstream_shmring_writer_begin_record(shm_writer, bs_record) !=
+             0)) {
+        fprintf(stderr, "ERROR: Could not encode record\n");
+        goto done;
+      }
+      rec_elem_cnt = 0;
+      if (rib_delta.rib != NULL) {
+        rib_delta.record = bs_record;
+        if (bgpstream_rib_begin_record(rib_delta.rib, bs_record) != 0) {
+          fprintf(stderr, "ERROR: Could not apply record to the RIB\n");
+          goto done;
+        }
+      }
       while ((erc = bgpstream_record_get_next_elem(bs_record, &bs_elem)) > 0) {
+        if (rib_delta.rib != NULL) {
+          if ((drc = bgpstream_rib_add_elem(rib_delta.rib, bs_record,
+                                           bs_elem)) < 0) {
+            fprintf(stderr, "ERROR: Could not apply elem to the RIB\n");
+            goto done;
+          }
+          if (drc == 0 && bs_elem->type == BGPSTREAM_ELEM_TYPE_RIB) {
+            continue;
+          }
+        }
+        rec_elem_cnt++;
 #ifdef WITH_RPKI
         if (rpki_input != NULL && rpki_input->rpki_active) {
           bs_elem->annotations.cfg = cfg;
@@ -697,11 +2205,28 @@ int main(int argc, char *argv[])
           bs_elem->annotations.timestamp = bs_record->time_sec;
         }
 #endif
-        // print record following bgpdump format
-        if (record_bgpdump_output_on &&
-            print_elem_bgpdump(bs_record, bs_elem) != 0) {
+        // print elem in bgpstream or bgpdump format
+        if (elem_fmt != NULL && print_elem(bs_record, bs_elem) != 0) {
           goto done;
-        } else if (elem_output_on && print_elem(bs_record, bs_elem) != 0) {
+        } else if (bin_writer != NULL &&
+                   bgpstream_binary_writer_add_elem(bin_writer, bs_elem) != 0) {
+          fprintf(stderr, "ERROR: Could not encode elem\n");
+          goto done;
+        }
+        if (arrow_writer != NULL &&
+            bgpstream_arrow_writer_add_elem(arrow_writer, bs_record,
+                                            bs_elem) != 0) {
+          fprintf(stderr, "ERROR: Failed to write Arrow elem\n");
+          goto done;
+        }
+        if (kafka_writer != NULL &&
+            bgpstream_kafka_writer_add_elem(kafka_writer, bs_elem) != 0) {
+          fprintf(stderr, "ERROR: Failed to produce Kafka elem\n");
+          goto done;
+        }
+        if (shm_writer != NULL &&
+            bgpstream_shmring_writer_add_elem(shm_writer, bs_elem) != 0) {
+          fprintf(stderr, "ERROR: Failed to write shared memory elem\n");
           goto done;
         }
       }
@@ -711,22 +2236,91 @@ int main(int argc, char *argv[])
         goto done;
       }
 
+      /* output the routes that the end of a RIB dump removes */
+      if (rib_delta.rib != NULL &&
+          bgpstream_rib_end_record(rib_delta.rib, bs_record) != 0) {
+        fprintf(stderr, "ERROR: Could not apply record to the RIB\n");
+        goto done;
+      }
+
+      /* don't hold back the elems of a live stream */
+      if (live && flush_elems() != 0) {
+        goto done;
+      }
+
+      /* only keep the records that have elems matching the filters */
+      if (mrt_writer != NULL && rec_elem_cnt > 0 &&
+          bgpstream_mrt_writer_write(mrt_writer, bs_record) < 0) {
+        fprintf(stderr, "ERROR: Failed to write MRT record\n");
+        goto done;
+      }
+
+      if (bin_writer != NULL && rec_elem_cnt > 0 &&
+          ((bin_len = bgpstream_binary_writer_end_record(bin_writer,
+                                                         &bin_buf)) < 0 ||
+           fwrite(bin_buf, 1, bin_len, stdout) != (size_t)bin_len)) {
+        fprintf(stderr, "ERROR: Failed to write binary record\n");
+        goto done;
+      }
+
+      if (kafka_writer != NULL &&
+          bgpstream_kafka_writer_end_record(kafka_writer) != 0) {
+        fprintf(stderr, "ERROR: Failed to produce Kafka record\n");
+        goto done;
+      }
+
+      if (shm_writer != NULL &&
+          bgpstream_shmring_writer_end_record(shm_writer) != 0) {
+        fprintf(stderr, "ERROR: Failed to write shared memory record\n");
+        goto done;
+      }
+
       /* check if end of RIB has been reached */
-      if (bs_record->type == BGPSTREAM_RIB &&
+      if (bin_writer == NULL && bs_record->type == BGPSTREAM_RIB &&
           bs_record->dump_pos == BGPSTREAM_DUMP_END &&
           print_record(bs_record) != 0) {
         goto done;
       }
     }
+
+    /* the record has been output, so a restarted stream may skip it */
+    if (bgpstream_record_ack(bs_record) != 0) {
+      fprintf(stderr, "ERROR: Could not acknowledge record\n");
+      goto done;
+    }
   }
 
   if (rrc < 0) {
     fprintf(stderr, "ERROR: Failed to get record from stream\n");
-  } else {
+  } else if (checkpoint.path == NULL ||
+             checkpoint_save(&checkpoint, fmt_pool) == 0) {
     exitstatus = 0; // success
   }
 
 done:
+  /* write out whatever elems are still buffered */
+  if (flush_elems() != 0) {
+    exitstatus = -1;
+  }
+  if (fmt_pool != NULL && exitstatus == 0 && fmt_pool_flush(fmt_pool) < 0) {
+    exitstatus = -1;
+  }
+  fmt_pool_destroy(fmt_pool);
+  if (kafka_writer != NULL && exitstatus == 0 &&
+      bgpstream_kafka_writer_flush(kafka_writer, KAFKA_FLUSH_MSEC) != 0) {
+    fprintf(stderr, "ERROR: Could not deliver Kafka messages\n");
+    exitstatus = -1;
+  }
+  bgpstream_kafka_writer_destroy(kafka_writer);
+  bgpstream_shmring_writer_destroy(shm_writer);
+
+  if (stats.start_ms != 0) {
+    stats_finish(&stats);
+  }
+  if (metrics.path != NULL && metrics.last_ms != 0) {
+    metrics_write(&metrics);
+  }
+
 #ifdef WITH_RPKI
   if (rpki_input != NULL && rpki_input->rpki_active) {
     bgpstream_rpki_destroy_cfg(cfg);
@@ -734,8 +2328,15 @@ done:
   }
 #endif
 
+  rib_delta_destroy(&rib_delta);
+  bgpstream_mrt_writer_destroy(mrt_writer);
+  bgpstream_arrow_writer_destroy(arrow_writer);
+  bgpstream_binary_writer_destroy(bin_writer);
+  bgpstream_elem_formatter_destroy(elem_fmt);
+
   /* deallocate memory for interface */
   bgpstream_destroy(bs);
+  bgpstream_stop_async_log();
   return exitstatus;
 }
 
@@ -748,36 +2349,36 @@ static int print_record(bgpstream_record_t *record)
     return -1;
   }
 
+  /* keep the record in order with the elems printed before it */
+  if (flush_elems() != 0) {
+    return -1;
+  }
   printf("%s\n", buf);
   return 0;
 }
 
 static int print_elem(bgpstream_record_t *record, bgpstream_elem_t *elem)
 {
-  if (bgpstream_record_elem_snprintf(buf, sizeof(buf), record, elem) == NULL) {
+  const char *out;
+
+  if (bgpstream_elem_formatter_add_elem(elem_fmt, record, elem) != 0) {
     fprintf(stderr, "ERROR: Could not convert record/elem to string\n");
     return -1;
   }
 
-  printf("%s\n", buf);
+  if (bgpstream_elem_formatter_get_output(elem_fmt, &out) >=
+      ELEM_OUTPUT_FLUSH_LEN) {
+    return flush_elems();
+  }
   return 0;
 }
 
-static int print_elem_bgpdump(bgpstream_record_t *record,
-                              bgpstream_elem_t *elem)
+static int flush_elems(void)
 {
-  if (bgpstream_record_elem_bgpdump_snprintf(buf, sizeof(buf), record, elem) ==
-      NULL) {
-    fprintf(stderr, "ERROR: Could not convert record/elem to string\n");
+  if (elem_fmt != NULL &&
+      bgpstream_elem_formatter_write(elem_fmt, stdout) != 0) {
+    fprintf(stderr, "ERROR: Could not write elems\n");
     return -1;
   }
-
-  /* Some elem types (e.g. End-of-RIB markers) have no representation in the
-   * bgpdump output format and produce an empty string; skip them. */
-  if (buf[0] == '\0') {
-    return 0;
-  }
-
-  printf("%s\n", buf);
   return 0;
 }
@@ -62,9 +62,41 @@ def create_tables(db_conn):
                  bgp_type_id integer,
                  time_span integer,
                  PRIMARY KEY(collector_id, bgp_type_id))''')
+    create_indexes(db_conn)
     db_conn.commit()
 
 
+# indexes used by the bgpstream sqlite data interface: new files are found by
+# ts (live polling), historical ones by file_time
+INDEXES = {
+    'bgp_data_ts_idx': 'bgp_data(ts)',
+    'bgp_data_file_time_idx': 'bgp_data(file_time)',
+    'collectors_name_idx': 'collectors(project, name)',
+}
+
+
+def create_indexes(db_conn):
+    c = db_conn.cursor()
+    for name, cols in INDEXES.items():
+        c.execute('CREATE INDEX IF NOT EXISTS ' + name + ' ON ' + cols)
+    c.execute('ANALYZE')
+    db_conn.commit()
+
+
+def check_indexes(db_conn):
+    c = db_conn.cursor()
+    missing = 0
+    for name, cols in sorted(INDEXES.items()):
+        c.execute('''SELECT sql FROM sqlite_master WHERE type='index' AND name=?''',
+                  [name])
+        if c.fetchone() is None:
+            print "Missing index " + name + " on " + cols
+            missing += 1
+        else:
+            print "Found index " + name + " on " + cols
+    return missing
+
+
 def add_new_bgp_data(db_conn, mrt_file, project, collector, bgp_type, file_time, updates_time_span):
     c = db_conn.cursor()
     col_id = 0
@@ -140,14 +172,25 @@ parser.add_argument("-T","--file_time", help="time associated with the mrt file"
                     default=-1, action='store',type=int)
 parser.add_argument("-u","--updates_time_span", help="updates time span",
                     default=-1, action='store',type=int)
+parser.add_argument("-i","--check_indexes", help="check the indexes used by bgpstream (exit status is the number missing)",
+                     action="store_true")
+parser.add_argument("-w","--wal", help="switch the database to WAL mode (so that readers do not block additions)",
+                     action="store_true")
 args = parser.parse_args()
 
 # connect to the database
 conn = sqlite3.connect(args.sqlite_db)
 
-# create tables (if they do not exist)
+if args.check_indexes:
+    # only check, so that a read-only database can be verified
+    exit(check_indexes(conn))
+
+# create tables (and indexes) if they do not exist
 create_tables(conn)
 
+if args.wal:
+    conn.execute('PRAGMA journal_mode=WAL')
+
 if not args.list_files and not args.add_mrt_file:
     print "No actions required, creating the database file " + args.sqlite_db
 
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2026 The Regents of the University of California.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bgpstream.h"
+
+static void usage(void)
+{
+  fprintf(stderr,
+          "Usage: bgpsummary [-t <type>] <dump-file> [<dump-file>...]\n"
+          "Writes the summary of each dump file to "
+          "<dump-file>" BGPSTREAM_SUMMARY_SUFFIX ", for use by\n"
+          "bgpreader --summaries\n"
+          "Available options are:\n"
+          " -t <type>  type of the dump files (mrt/bmp/ris-live/binary) "
+          "(default: mrt)\n");
+}
+
+// read every elem of the file into a new summary, and write it next to the
+// file
+static int summarize(const char *file, const char *type)
+{
+  bgpstream_t *bs = NULL;
+  bgpstream_data_interface_id_t di_id;
+  bgpstream_data_interface_option_t *option;
+  bgpstream_record_t *record;
+  bgpstream_elem_t *elem;
+  bgpstream_summary_t *summary = NULL;
+  char *path = NULL;
+  int rc = -1;
+  int ret;
+
+  if ((bs = bgpstream_create()) == NULL ||
+      (summary = bgpstream_summary_create()) == NULL) {
+    fprintf(stderr, "ERROR: Could not create the stream\n");
+    goto done;
+  }
+
+  // read the file as an updates file, whatever it holds
+  di_id = bgpstream_get_data_interface_id_by_name(bs, "singlefile");
+  bgpstream_set_data_interface(bs, di_id);
+  if ((option = bgpstream_get_data_interface_option_by_name(
+         bs, di_id, "upd-file")) == NULL ||
+      bgpstream_set_data_interface_option(bs, option, file) != 0 ||
+      (option = bgpstream_get_data_interface_option_by_name(
+         bs, di_id, "upd-type")) == NULL ||
+      bgpstream_set_data_interface_option(bs, option, type) != 0) {
+    fprintf(stderr, "ERROR: Could not configure the stream for %s\n", file);
+    goto done;
+  }
+
+  if (bgpstream_start(bs) < 0) {
+    fprintf(stderr, "ERROR: Could not start the stream for %s\n", file);
+    goto done;
+  }
+  while ((ret = bgpstream_get_next_record(bs, &record)) > 0) {
+    if (record->status != BGPSTREAM_RECORD_STATUS_VALID_RECORD) {
+      continue;
+    }
+    while ((ret = bgpstream_record_get_next_elem(record, &elem)) > 0) {
+      if (bgpstream_summary_add_elem(summary, elem) != 0) {
+        fprintf(stderr, "ERROR: Could not add an elem to the summary\n");
+        goto done;
+      }
+    }
+    if (ret < 0) {
+      break;
+    }
+  }
+  if (ret < 0) {
+    fprintf(stderr, "ERROR: Could not read %s\n", file);
+    goto done;
+  }
+
+  if ((path = malloc(strlen(file) + sizeof(BGPSTREAM_SUMMARY_SUFFIX))) ==
+      NULL) {
+    goto done;
+  }
+  strcpy(path, file);
+  strcat(path, BGPSTREAM_SUMMARY_SUFFIX);
+  if (bgpstream_summary_write(summary, path) != 0) {
+    goto done;
+  }
+  rc = 0;
+
+done:
+  free(path);
+  bgpstream_summary_destroy(summary);
+  if (bs != NULL) {
+    bgpstream_destroy(bs);
+  }
+  return rc;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *type = "mrt";
+  int rc = 0;
+  int opt;
+  int i;
+
+  while ((opt = getopt(argc, argv, "t:h?")) >= 0) {
+    switch (opt) {
+    case 't':
+      type = optarg;
+      break;
+
+    case 'h':
+    case '?':
+    default:
+      usage();
+      return -1;
+    }
+  }
+
+  if (optind == argc) {
+    usage();
+    return -1;
+  }
+
+  for (i = optind; i < argc; i++) {
+    if (summarize(argv[i], type) != 0) {
+      rc = -1;
+    }
+  }
+  return rc;
+}